@@ -29,6 +29,18 @@ def acct_password_prompt(sock):
 def acct_wait_dns_prompt(sock):
     sock.send_raw(" Resolving your internet address, please have patience... ")
 
+def acct_wait_password_prompt(sock):
+    return
+
+def sock_is_open(sock):
+    '''passwords are checked off of the game thread, and the socket may have
+       closed by the time the check is done'''
+    try:
+        sock.uid
+        return True
+    except:
+        return False
+
 def try_create_account(sock, name, psswd):
     if mudsys.account_exists(name):
         return False
@@ -46,34 +58,54 @@ def try_create_account(sock, name, psswd):
             return False
         else:
             mudsys.attach_account_socket(acct, sock)
-            mudsys.set_password(acct, psswd)
             sock.pop_ih()
-            sock.push_ih(acct_menu_handler, acct_main_menu)
+            sock.push_ih(acct_wait_password_handler, acct_wait_password_prompt)
 
-            #sock.push_ih(acct_finish_handler, acct_finish_prompt)
+            # hashing the password is slow, so it's done off of the game
+            # thread. The account is registered once it has one
+            def password_set(done):
+                # log that the account created
+                mud.log_string("New account '" + acct.name + "' has created.")
 
-            # log that the account created
-            mud.log_string("New account '" + acct.name + "' has created.")
+                # register and save the account to disk
+                mudsys.do_register(acct)
 
-            # register and save the account to disk
-            mudsys.do_register(acct)
+                if sock_is_open(sock):
+                    sock.pop_ih()
+                    sock.push_ih(acct_menu_handler, acct_main_menu)
+                    #sock.push_ih(acct_finish_handler, acct_finish_prompt)
+                    # nothing was typed, so the menu must be asked for
+                    sock.bust_prompt()
 
+            mudsys.set_password(acct, psswd, password_set)
             return True
     return False
 
 def try_load_account(sock, name, psswd):
-    '''Attempt to load an account with the given name and password.'''
+    '''Attempt to load an account with the given name and password. The
+       password is checked off of the game thread; the socket waits until it
+       is, and is told then if it was wrong.'''
     if not mudsys.account_exists(name):
         return False
     else:
         acct = mudsys.load_account(name)
-        if not mudsys.password_matches(acct, psswd):
-            return False
 
-        # successful load
-        mudsys.attach_account_socket(acct, sock)
-        sock.pop_ih()
-        sock.push_ih(acct_menu_handler, acct_main_menu)
+        def password_checked(matches):
+            if not sock_is_open(sock):
+                return
+            sock.pop_ih()
+            if not matches:
+                sock.send("{cInvalid account name or password.{n\r\n")
+                return
+
+            # successful load
+            mudsys.attach_account_socket(acct, sock)
+            sock.pop_ih()
+            sock.push_ih(acct_menu_handler, acct_main_menu)
+            sock.bust_prompt()
+
+        sock.push_ih(acct_wait_password_handler, acct_wait_password_prompt)
+        mudsys.password_matches(acct, psswd, password_checked)
         return True
     return False
 
@@ -115,34 +147,46 @@ def acct_wait_dns_handler(sock, arg):
     # do nothing
     return
 
+def acct_wait_password_handler(sock, arg):
+    # do nothing until our password has been checked
+    return
+
 def acct_new_password_handler(sock, arg):
     '''asks a new account for a password'''
     sock.send_raw(unsquelch)
     if len(arg) > 0:
         # put in mudsys to prevent scripts from messing with passwords
-        mudsys.set_password(sock.account, arg)
-        sock.pop_ih()
+        def password_set(done):
+            if sock_is_open(sock):
+                sock.pop_ih()
+                sock.pop_ih()
+                sock.bust_prompt()
+        sock.push_ih(acct_wait_password_handler, acct_wait_password_prompt)
+        mudsys.set_password(sock.account, arg, password_set)
 
 def acct_password_handler(sock, arg):
     '''asks an account to verify its password'''
     # password functions put in mudsys to prevent scripts from
     # messing with passwords
     sock.send_raw(unsquelch)
-    if not mudsys.password_matches(sock.account, arg):
-        sock.send("Incorrect password.")
-        sock.close()
-    else:
-        # password matches, pop our handler and go down a level
+    def password_checked(matches):
+        if not sock_is_open(sock):
+            return
         sock.pop_ih()
+        if not matches:
+            sock.send("Incorrect password.")
+            sock.close()
+        else:
+            # password matches, pop our handler and go down a level
+            sock.pop_ih()
+            sock.bust_prompt()
+    sock.push_ih(acct_wait_password_handler, acct_wait_password_prompt)
+    mudsys.password_matches(sock.account, arg, password_checked)
 
 def find_reconnect(name):
     '''searches through the character list for a PC whose name matches the
        supplied name'''
-    name = name.lower()
-    for ch in char.char_list():
-        if ch.is_pc and name == ch.name.lower():
-            return ch
-    return None
+    return mudsys.find_player(name)
 
 def acct_load_char(sock, name):
     '''loads a character attached to the account. Argument supplied must be a
@@ -40,8 +40,11 @@ try:
     from . import commands
     import auxiliary
     
-    # Install auxiliary data using Python's auxiliary system
-    auxiliary.install("attribute_data", attribute_aux.AttributeAuxData, "character")
+    # attributes live in characters' stat blocks. This only reads what
+    # characters were saved with before that, so it can be moved in. It's read
+    # straight away, so what's waiting to be moved gets counted as it loads
+    auxiliary.install("attribute_data", attribute_aux.LegacyAttributeData,
+                      "character", eager=True)
     mud.log_string("Attributes: Auxiliary data installed on characters")
     
     # Register commands
@@ -1,68 +1,127 @@
 """
 Attribute Auxiliary Data
 =========================
-Manages character attribute data storage using NakedMud's auxiliary system.
-This attaches attribute values to character objects.
+Character attributes, kept in the stat block every character has in C (see
+mud.register_stat), so reading one is an indexed read instead of a lookup of
+auxiliary data. Characters saved before that have their attributes moved in
+the first time they're asked for.
 """
 
 import random
-import mudsys
+import mud
 import storage
 from . import attribute_data
 
 
-class AttributeAuxData:
+# each attribute, and the TDP counters, are stats in the character's stat
+# block, read by number
+STATS = {name: mud.register_stat(name, 10)
+         for name in attribute_data.get_attribute_names()}
+TDP_AVAILABLE = mud.register_stat("tdp_available", 0)
+TDP_SPENT = mud.register_stat("tdp_spent", 0)
+INITIALIZED = mud.register_stat("attributes_initialized", 0)
+
+
+# what characters saved before the stat block hold, so they can be read in
+# one call, and the stat each is moved into
+ATTRIBUTE_SCHEMA = {
+    "strength": int, "reflex": int, "agility": int, "charisma": int,
+    "discipline": int, "wisdom": int, "intelligence": int, "stamina": int,
+    "tdp_available": int, "tdp_spent": int, "initialized": bool,
+}
+storage.register_schema("attribute_data", ATTRIBUTE_SCHEMA)
+LEGACY_STATS = dict(STATS, tdp_available=TDP_AVAILABLE, tdp_spent=TDP_SPENT)
+
+# how many characters have been loaded with attributes from before the stat
+# block, that haven't had them moved in yet
+_legacy_pending = 0
+
+
+class LegacyAttributeData:
     """
-    Stores a character's attribute values and TDP.
-    This class gets attached to each character as auxiliary data.
+    The attributes a character was saved with before they moved into the
+    stat block. Moved in the first time the character's attributes are asked
+    for, and never saved again.
     """
-    
+
     def __init__(self, set=None):
-        """
-        Initialize with baseline human values or from a storage set.
-        """
-        if set is None:
-            # Default values
-            self.strength = 10
-            self.reflex = 10
-            self.agility = 10
-            self.charisma = 10
-            self.discipline = 10
-            self.wisdom = 10
-            self.intelligence = 10
-            self.stamina = 10
-            self.tdp_available = 0
-            self.tdp_spent = 0
-            self.initialized = False
-        else:
-            # Load from storage set
-            self.strength = set.readInt("strength")
-            self.reflex = set.readInt("reflex")
-            self.agility = set.readInt("agility")
-            self.charisma = set.readInt("charisma")
-            self.discipline = set.readInt("discipline")
-            self.wisdom = set.readInt("wisdom")
-            self.intelligence = set.readInt("intelligence")
-            self.stamina = set.readInt("stamina")
-            self.tdp_available = set.readInt("tdp_available")
-            self.tdp_spent = set.readInt("tdp_spent")
-            self.initialized = set.readBool("initialized")
-    
-    
+        global _legacy_pending
+        self.values = None
+        if set is not None:
+            values = set.to_dict("attribute_data")
+            if values.get("initialized"):
+                self.values = values
+                _legacy_pending += 1
+
+    def copyTo(self, other):
+        pass
+
+    def copy(self):
+        return LegacyAttributeData()
+
+    def store(self):
+        return storage.StorageSet()
+
+
+def _migrate(ch):
+    """Move the attributes a character was saved with into its stat block."""
+    global _legacy_pending
+    legacy = ch.getAuxiliary("attribute_data")
+    if legacy is None or legacy.values is None:
+        return
+    for key, val in legacy.values.items():
+        num = LEGACY_STATS.get(key)
+        if num is not None:
+            ch.set_stat(num, int(val))
+    ch.set_stat(INITIALIZED, 1)
+    legacy.values = None
+    _legacy_pending -= 1
+
+
+def _stat_property(num):
+    return property(lambda self: self.ch.stat(num),
+                    lambda self, val: self.ch.set_stat(num, val))
+
+
+class AttributeAuxData:
+    """
+    A character's attribute values and TDP. The values live in the
+    character's stat block, so this is only a view onto them: cheap to make,
+    and never saved or copied itself.
+    """
+    __slots__ = ("ch",)
+
+    def __init__(self, ch):
+        self.ch = ch
+
+    tdp_available = _stat_property(TDP_AVAILABLE)
+    tdp_spent = _stat_property(TDP_SPENT)
+
+    @property
+    def initialized(self):
+        return self.ch.stat(INITIALIZED) != 0
+
+    @initialized.setter
+    def initialized(self, val):
+        self.ch.set_stat(INITIALIZED, 1 if val else 0)
+
+
     def get_attribute(self, attr_name):
         """Get the value of an attribute by name."""
-        return getattr(self, attr_name, None)
-    
-    
+        num = STATS.get(attr_name)
+        return None if num is None else self.ch.stat(num)
+
+
     def set_attribute(self, attr_name, value):
         """Set an attribute value (with validation)."""
+        num = STATS.get(attr_name)
+        if num is None:
+            return False
         validated_value = attribute_data.validate_attribute_value(attr_name, value)
-        if hasattr(self, attr_name):
-            setattr(self, attr_name, validated_value)
-            return True
-        return False
-    
-    
+        self.ch.set_stat(num, validated_value)
+        return True
+
+
     def modify_attribute(self, attr_name, amount):
         """Add or subtract from an attribute."""
         current = self.get_attribute(attr_name)
@@ -71,27 +130,19 @@ class AttributeAuxData:
         new_value = current + amount
         self.set_attribute(attr_name, new_value)
         return self.get_attribute(attr_name)
-    
-    
+
+
     def get_all_attributes(self):
         """Get a dictionary of all current attribute values."""
-        return {
-            "strength": self.strength,
-            "reflex": self.reflex,
-            "agility": self.agility,
-            "charisma": self.charisma,
-            "discipline": self.discipline,
-            "wisdom": self.wisdom,
-            "intelligence": self.intelligence,
-            "stamina": self.stamina
-        }
-    
-    
+        stat = self.ch.stat
+        return {name: stat(num) for name, num in STATS.items()}
+
+
     def add_tdp(self, amount):
         """Grant TDP to the character."""
         self.tdp_available += amount
-    
-    
+
+
     def spend_tdp(self, amount):
         """Spend TDP (e.g., training an attribute)."""
         if self.tdp_available >= amount:
@@ -99,104 +150,68 @@ class AttributeAuxData:
             self.tdp_spent += amount
             return True
         return False
-    
-    
+
+
     def train_attribute(self, attr_name, points=1):
         """Train an attribute using TDP."""
         current_value = self.get_attribute(attr_name)
         if current_value is None:
             return (False, 0, "Invalid attribute.")
-        
+
         cost = attribute_data.calculate_tdp_cost(current_value, current_value + points)
-        
+
         if cost > self.tdp_available:
             return (False, cost, f"You need {cost} TDP but only have {self.tdp_available}.")
-        
+
         if not self.spend_tdp(cost):
             return (False, cost, "Failed to spend TDP.")
-        
+
         new_value = self.modify_attribute(attr_name, points)
         return (True, cost, f"Trained {attr_name} from {current_value} to {new_value} for {cost} TDP.")
-    
-    
+
+
     def initialize_for_race(self, race_name):
         """Set starting attributes based on race."""
         try:
             import entities.entity_config as entity_config
             race_config = entity_config.get_race_config()
             race = race_config.get_race(race_name)
-            
+
             if race and hasattr(race, 'base_attributes'):
                 racial_bases = race.base_attributes
             else:
                 racial_bases = attribute_data.HUMAN_BASELINE.copy()
         except (ImportError, AttributeError):
             racial_bases = attribute_data.HUMAN_BASELINE.copy()
-        
+
         variance = attribute_data.RACIAL_VARIANCE
         for attr_name in attribute_data.get_attribute_names():
             base_value = racial_bases.get(attr_name, 10)
             rolled_value = random.randint(base_value - variance, base_value + variance)
             self.set_attribute(attr_name, rolled_value)
-        
+
         starting_tdp = attribute_data.calculate_starting_tdp(self.get_all_attributes())
         self.tdp_available = starting_tdp
         self.initialized = True
-    
-    
-    def copyTo(self, other):
-        """Copy this data to another AttributeAuxData instance."""
-        other.strength = self.strength
-        other.reflex = self.reflex
-        other.agility = self.agility
-        other.charisma = self.charisma
-        other.discipline = self.discipline
-        other.wisdom = self.wisdom
-        other.intelligence = self.intelligence
-        other.stamina = self.stamina
-        other.tdp_available = self.tdp_available
-        other.tdp_spent = self.tdp_spent
-        other.initialized = self.initialized
-    
-    
-    def copy(self):
-        """Create a copy of this auxiliary data."""
-        new_aux = AttributeAuxData()
-        self.copyTo(new_aux)
-        return new_aux
-    
-    
-    def store(self):
-        """Convert this data to a format that can be saved to disk."""
-        set = storage.StorageSet()
-        set.storeInt("strength", self.strength)
-        set.storeInt("reflex", self.reflex)
-        set.storeInt("agility", self.agility)
-        set.storeInt("charisma", self.charisma)
-        set.storeInt("discipline", self.discipline)
-        set.storeInt("wisdom", self.wisdom)
-        set.storeInt("intelligence", self.intelligence)
-        set.storeInt("stamina", self.stamina)
-        set.storeInt("tdp_available", self.tdp_available)
-        set.storeInt("tdp_spent", self.tdp_spent)
-        set.storeBool("initialized", self.initialized)
-        return set
+
+
+# strength, wisdom, and the rest, as properties
+for _name, _num in STATS.items():
+    setattr(AttributeAuxData, _name, _stat_property(_num))
 
 
 def get_attributes(ch):
     """
-    Get a character's attribute auxiliary data.
+    Get a character's attributes.
     """
-    return ch.getAuxiliary("attribute_data")
+    if _legacy_pending and not ch.stat(INITIALIZED):
+        _migrate(ch)
+    return AttributeAuxData(ch)
 
 
 def ensure_attributes(ch):
     """
-    Make sure a character has attribute data installed.
+    Make sure a character has attribute data. Every character has a stat
+    block, so this is the same as get_attributes.
     """
-    aux = get_attributes(ch)
-    if aux is None:
-        # In Python, auxiliary data is auto-created when accessed
-        # if it's been properly installed
-        return ch.getAuxiliary("attribute_data")
-    return aux
+    return get_attributes(ch)
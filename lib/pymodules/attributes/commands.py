@@ -6,6 +6,7 @@ Player and admin commands for viewing and training attributes.
 
 import mudsys
 import mud
+import hooks
 from . import attribute_data
 from . import attribute_aux
 
@@ -295,6 +296,7 @@ def train_confirm_handler(sock, arg):
                 sock.send("{cYour vitality has been recalculated based on your new attributes.{n")
             except ImportError:
                 pass  # Vitality module not loaded yet
+            hooks.run("attributes_changed", hooks.build_info("ch", (sock.ch,)))
         else:
             sock.send(f"{{RFailed:{{n {message}")
     else:
@@ -482,6 +484,7 @@ def cmd_setattr(ch, cmd, arg):
         ch.send(f"Recalculated {target.name}'s vitality.")
     except ImportError:
         pass
+    hooks.run("attributes_changed", hooks.build_info("ch", (target,)))
 
 
 def cmd_grantdp(ch, cmd, arg):
@@ -562,7 +565,7 @@ def cmd_mobattributes(ch, cmd, arg):
         return
     
     # Check if target has attributes
-    attr_aux = target.getAuxiliary("attribute_data")
+    attr_aux = attribute_aux.get_attributes(target)
     if not attr_aux:
         ch.send("%s has no attribute data." % target.name)
         return
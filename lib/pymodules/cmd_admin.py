@@ -67,8 +67,22 @@ def cmd_shutdown_net(ch, cmd, arg):
     ch.send("You must spell out shutdown completely!")
 
 def cmd_copyover(ch, cmd, arg):
-    '''Restarts the mud, and keep all sockets connected.''' 
-    mudsys.do_copyover()
+    '''Usage: copyover [hot]
+
+       Restarts the mud, and keep all sockets connected. A hot copyover also
+       keeps the world as it is, instead of reloading and resetting it.'''
+    mudsys.do_copyover(arg.strip().lower() == "hot")
+
+def cmd_upgrade(ch, cmd, arg):
+    '''Usage: upgrade
+
+       Starts the mud up again alongside the running one, and once it has
+       booted, hands it everyone's connection. Unlike a copyover, the game
+       carries on while the new one boots, and nobody is turned away.'''
+    if mudsys.do_upgrade():
+        ch.send("The new mud is booting. It will take over once it is ready.")
+    else:
+        ch.send("An upgrade is already underway, or could not be started.")
 
 def cmd_copyover_net(ch, cmd, arg):
     '''A trap to make sure we spell copyover out completely.'''
@@ -620,6 +634,7 @@ mudsys.add_cmd("shutdow",     None, cmd_shutdown_net, "admin",   False)
 mudsys.add_cmd("shutdown",    None, cmd_shutdown,     "admin",   False)
 mudsys.add_cmd("copyove",     None, cmd_copyover_net, "admin",   False)
 mudsys.add_cmd("copyover",    None, cmd_copyover,     "admin",   False)
+mudsys.add_cmd("upgrade",     None, cmd_upgrade,      "admin",   False)
 mudsys.add_cmd("at",          None, cmd_at,           "wizard",  False)
 mudsys.add_cmd("lockdown",    None, cmd_lockdown,     "admin",   False)
 mudsys.add_cmd("pulserate",   None, cmd_pulserate,    "admin",   False)
@@ -6,7 +6,7 @@ characters, and NPCs.
 '''
 from mud import *
 from mudsys import add_cmd, add_cmd_check
-import mudsys, mud, inform, hooks, mudsock, history
+import mudsys, mud, inform, hooks, history
 
 
 
@@ -63,19 +63,18 @@ def cmd_chat(ch, cmd, arg):
         ch.send("Chat what?")
     else:
         arg  = arg.replace("$", "$$")
-        mssg = "{y$n chats, '" + arg + "'{n"
-        mud.message(ch, None, None, None, False, "to_world", mssg)
+        mud.channel_message("chat", ch, "{y$n chats, '" + arg + "'{n",
+                            "{y%-10s: %s{n" % (ch.name, arg))
         mud.message(ch, None, None, None,False,"to_char", "{yyou chat, '"+arg+"'{n")
-        history.add_history(ch, "chat", "{y%-10s: %s{n" % (ch.name, arg))
 
 def cmd_wiz(ch, cmd, arg):
     if arg == '':
         ch.send("WizChat what?")
     else:
-        mssg = "{b%s WizChats, '{c%s{b'{n" % (ch.name, arg)
-        for sock in mudsock.socket_list():
-            if sock.ch != None and sock.ch.isInGroup("wizard"):
-                sock.ch.send(mssg)
+        arg  = arg.replace("$", "$$")
+        mssg = "{b$n WizChats, '{c" + arg + "{b'{n"
+        mud.channel_message("wizard", ch, mssg)
+        mud.message(ch, None, None, None, False, "to_char", mssg)
 
 def cmd_say(ch, cmd, arg):
     '''Usage: say <message>
@@ -205,7 +204,12 @@ def chk_room_communication(ch, cmd):
 for cmd in ["ask", "say", "'", "greet", "approach", "emote", ":"]:
     mudsys.add_cmd_check(cmd, chk_room_communication)
 
+# everyone is on chat, and wizards are on wizchat, for as long as they're
+# in the game
+mud.set_channel_group("chat",   "player")
+mud.set_channel_group("wizard", "wizard")
+
 # register our history handling
-history.register_comm_history("chat", lambda ch: "chat")
+history.register_channel_history("chat", "chat")
 # history.register_comm_history("say",  lambda ch: ch.name)
 history.register_comm_history("tell", lambda ch: ch.name)
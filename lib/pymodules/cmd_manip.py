@@ -144,6 +144,14 @@ def cmd_drop(ch, cmd, arg):
         for obj in found:
             do_drop(ch, obj)
 
+def removed(ch, obj):
+    '''tells everyone an item has been removed, and runs our hooks'''
+    mud.message(ch, None, obj, None, True, "to_char", "You remove $o.")
+    mud.message(ch, None, obj, None, True, "to_room", "$n removes $o.")
+
+    # run our hooks
+    hooks.run("remove", hooks.build_info("ch obj", (ch, obj)))
+
 def do_remove(ch, obj):
     '''handles equipment removing'''
     # try to put it to our inventory
@@ -153,11 +161,7 @@ def do_remove(ch, obj):
     if obj.carrier != ch:
         ch.send("You were unable to remove " + ch.see_as(obj) + ".")
     else:
-        mud.message(ch, None, obj, None, True, "to_char", "You remove $o.")
-        mud.message(ch, None, obj, None, True, "to_room", "$n removes $o.")
-
-        # run our hooks
-        hooks.run("remove", hooks.build_info("ch obj", (ch, obj)))
+        removed(ch, obj)
 
 def cmd_remove(ch, cmd, arg):
     '''Usage: remove <item | all>
@@ -184,8 +188,13 @@ def cmd_remove(ch, cmd, arg):
     if multi == False:
         do_remove(ch, found)
     else:
+        # take it all off in one go, then tell everyone about it
+        off = ch.unequip_many(found)
         for obj in found:
-            do_remove(ch, obj)
+            if obj in off:
+                removed(ch, obj)
+            else:
+                ch.send("You were unable to remove " + ch.see_as(obj) + ".")
 
 def expand_where_to_posnames(ch, obj, where):
     '''Expand body position types to specific position names using built-in C APIs'''
@@ -196,49 +205,8 @@ def expand_where_to_posnames(ch, obj, where):
         else:
             return None
     
-    # Build type-to-parts mapping from character's actual body configuration
-    type_to_parts = {}
-    for part in ch.bodyparts:
-        part_type = ch.get_bodypart_type(part)
-        if part_type:
-            if part_type not in type_to_parts:
-                type_to_parts[part_type] = []
-            type_to_parts[part_type].append(part)
-    
-    # Parse comma-separated position list
-    positions = [pos.strip() for pos in where.split(',')]
-    resolved_positions = []
-    used_parts = set()  # Track which parts have already been selected
-    
-    for pos in positions:
-        # If it's already a specific position name, use it directly
-        if pos in ch.bodyparts:
-            if pos not in used_parts:
-                resolved_positions.append(pos)
-                used_parts.add(pos)
-        # If it's a type, find the first free position of that type
-        elif pos in type_to_parts:
-            found_free = False
-            for part_name in type_to_parts[pos]:
-                if part_name not in used_parts and not ch.get_equip(part_name):  # Check if slot is free and not already used
-                    resolved_positions.append(part_name)
-                    used_parts.add(part_name)
-                    found_free = True
-                    break
-            if not found_free:
-                # Try to find any unused part of this type, even if occupied
-                for part_name in type_to_parts[pos]:
-                    if part_name not in used_parts:
-                        resolved_positions.append(part_name)
-                        used_parts.add(part_name)
-                        break
-        else:
-            # Unknown position type, pass through as-is
-            if pos not in used_parts:
-                resolved_positions.append(pos)
-                used_parts.add(pos)
-    
-    return ', '.join(resolved_positions)
+    # the body keeps its parts indexed by type, and knows which are free
+    return ch.resolve_positions(where)
 
 def do_wear(ch, obj, where):
     '''handles object wearing'''
@@ -250,11 +218,15 @@ def do_wear(ch, obj, where):
     expanded_where = expand_where_to_posnames(ch, obj, where)
     
     if ch.equip(obj, expanded_where):
-        mud.message(ch, None, obj, None, True, "to_char", "You wear $o.")
-        mud.message(ch, None, obj, None, True, "to_room", "$n wears $o.")
+        worn(ch, obj)
 
-        # run our wear hook
-        hooks.run("wear", hooks.build_info("ch obj", (ch, obj)))
+def worn(ch, obj):
+    '''tells everyone an item has been worn, and runs our hooks'''
+    mud.message(ch, None, obj, None, True, "to_char", "You wear $o.")
+    mud.message(ch, None, obj, None, True, "to_room", "$n wears $o.")
+
+    # run our wear hook
+    hooks.run("wear", hooks.build_info("ch obj", (ch, obj)))
 
 def cmd_wear(ch, cmd, arg):
     '''Usage: wear <item> [where]
@@ -290,8 +262,15 @@ def cmd_wear(ch, cmd, arg):
     if multi == False:
         do_wear(ch, found, where)
     else:
+        # slots are picked for everything in one pass, as each item goes on
+        items = []
         for obj in found:
-            do_wear(ch, obj, where)
+            if not obj.istype("worn"):
+                ch.send("But " + ch.see_as(obj) + " is not wearable.")
+            else:
+                items.append((obj, where or obj.worn_locs))
+        for obj in ch.equip_many(items):
+            worn(ch, obj)
 
 def do_put(ch, obj, cont):
     '''handles the putting of objects'''
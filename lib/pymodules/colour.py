@@ -1,10 +1,13 @@
 """
 colour.py
 
-NakedMud's base colour module. Contains functions for outbound text processing
-to add ASCII colour codes to the text.
+NakedMud's base colour module. Colour codes in outbound text are turned into
+ASCII colour codes by the mud itself, right before text is sent. This module
+just tells it what each code stands for. Codes can be added or changed with
+mud.set_colour, and sockets can be told what colours they can show by setting
+their colour_mode to 'ansi', '256', 'html', or 'none'.
 """
-import mud, mudsock, hooks
+import mud
 
 
 
@@ -39,57 +42,13 @@ base_colours = { c_none    : '0',
 
 
 ################################################################################
-# colour processing hooks
+# setting up our colour codes
 ################################################################################
-def process_colour_hook(info):
-    """When outbound text is being processed, find colour codes and replace them
-       by the proper colour escape sequences."""
-    sock,  = hooks.parse_info(info)
-    buf = sock.outbound_text
-    newbuf = []
-
-    # go through our outbound text and process all of the colour codes
-    i = 0
-    while i < len(buf):
-        try:
-            if buf[i] == base_colour_marker and i + 1 < len(buf):
-                i = i + 1
-                char  = buf[i]
-
-                # upper case is bright, lower case is dark
-                shade = cLIGHT
-                if char == char.lower():
-                    shade = cDARK
-
-                # if it's a valid colour code, build it
-                if char.lower() in base_colours:
-                    newbuf.append(colour_start + shade + ';' + \
-                                base_colours[char.lower()] + 'm')
-
-                # if it was an invalid code, ignore it
-                else:
-                    newbuf.append(base_colour_marker)
-                    if not char == base_colour_marker:
-                        i = i - 1
-
-            else:
-                newbuf.append(buf[i])
-            i += 1
-        except UnicodeDecodeError as e:
-            newbuf.append('�') 
-            i += 1
-    # replace our outbound buffer with the processed text
-    sock.outbound_text = ''.join(newbuf)
-
-
-
-################################################################################
-# initializing and unloading our hooks
-################################################################################
-hooks.add("process_outbound_text",   process_colour_hook)
-hooks.add("process_outbound_prompt", process_colour_hook)
-
-def __unload__():
-    '''detaches our colour module from the game'''
-    hooks.remove("process_outbound_text",   process_colour_hook)
-    hooks.remove("process_outbound_prompt", process_colour_hook)
+def set_colours():
+    """Tells the mud what each of our colour codes stands for. Upper case codes
+       are bright, and lower case codes are dark."""
+    for char, num in base_colours.items():
+        mud.set_colour(char,         colour_start + cDARK  + ';' + num + 'm')
+        mud.set_colour(char.upper(), colour_start + cLIGHT + ';' + num + 'm')
+
+set_colours()
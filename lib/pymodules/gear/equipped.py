@@ -184,82 +184,63 @@ def expand_where_to_posnames(ch, obj, where):
         else:
             return None
     
-    # Build type-to-parts mapping from character's actual body configuration
-    type_to_parts = {}
-    for part in ch.bodyparts:
-        part_type = ch.get_bodypart_type(part)
-        if part_type:
-            if part_type not in type_to_parts:
-                type_to_parts[part_type] = []
-            type_to_parts[part_type].append(part)
-    
-    # Parse comma-separated position list
-    positions = [pos.strip() for pos in where.split(',')]
-    resolved_positions = []
-    used_parts = set()  # Track which parts have already been selected
-    
-    for pos in positions:
-        # If it's already a specific position name, use it directly
-        if pos in ch.bodyparts:
-            if pos not in used_parts:
-                resolved_positions.append(pos)
-                used_parts.add(pos)
-        # If it's a type, find the first free position of that type
-        elif pos in type_to_parts:
-            found_free = False
-            for part_name in type_to_parts[pos]:
-                if part_name not in used_parts and not ch.get_equip(part_name):  # Check if slot is free and not already used
-                    resolved_positions.append(part_name)
-                    used_parts.add(part_name)
-                    found_free = True
-                    break
-            if not found_free:
-                # Try to find any unused part of this type, even if occupied
-                for part_name in type_to_parts[pos]:
-                    if part_name not in used_parts:
-                        resolved_positions.append(part_name)
-                        used_parts.add(part_name)
-                        break
-        else:
-            # Unknown position type, pass through as-is
-            if pos not in used_parts:
-                resolved_positions.append(pos)
-                used_parts.add(pos)
-    
-    return ', '.join(resolved_positions)
+    # the body keeps its parts indexed by type, and knows which are free
+    return ch.resolve_positions(where)
 
-def do_equip(ch, obj, where=None):
-    """Equip an object to a character, forcing it if necessary."""
+def equip_positions(ch, obj, where=None):
+    """Where an object would be equipped, or None (after telling ch) if it
+    can't be."""
         
     # Get equipped data to check worn_type
     data = obj.get_type_data("equipped")
     if not data or not data.worn_type:
         ch.send("This does not look like something you can equip.")
-        return
+        return None
     
     # Get positions this item wants to occupy
     from . import gear_config
     needed_positions = gear_config.get_worn_type_positions(data.worn_type)
     if not needed_positions:
         ch.send("This doesn't appear to be wearable.")
-        return
+        return None
     
     # Use provided where or default to the item's worn_type positions
     if where is None:
         where = ", ".join(needed_positions)
+    return where
+
+def equipped(ch, obj):
+    """Tell everyone an object has been equipped, and run our hooks."""
+    import mud
+    mud.message(ch, None, obj, None, True, "to_char", "You equip $o.")
+    mud.message(ch, None, obj, None, True, "to_room", "$n equips $o.")
+    
+    # Run equip hook
+    hooks.run("equip", hooks.build_info("ch obj", (ch, obj)))
+
+def do_equip(ch, obj, where=None):
+    """Equip an object to a character, forcing it if necessary."""
+    where = equip_positions(ch, obj, where)
+    if where is None:
+        return
     
     # Expand body position types to specific position names
     expanded_where = expand_where_to_posnames(ch, obj, where)
     # Attempt to equip with forced=True and equipment_type='equipped' for layering
     result = ch.equip(obj, expanded_where, False, 'equipped')
     if result:
-        import mud
-        mud.message(ch, None, obj, None, True, "to_char", "You equip $o.")
-        mud.message(ch, None, obj, None, True, "to_room", "$n equips $o.")
-        
-        # Run equip hook
-        import hooks
-        hooks.run("equip", hooks.build_info("ch obj", (ch, obj)))
+        equipped(ch, obj)
+
+def do_equip_many(ch, objs, where=None):
+    """Equip a list of objects to a character, picking all of their slots in
+    one pass."""
+    items = []
+    for obj in objs:
+        obj_where = equip_positions(ch, obj, where)
+        if obj_where is not None:
+            items.append((obj, obj_where))
+    for obj in ch.equip_many(items, False, 'equipped'):
+        equipped(ch, obj)
 
 def cmd_equip(ch, cmd, arg):
     """Usage: equip <item> [where]
@@ -291,8 +272,7 @@ def cmd_equip(ch, cmd, arg):
     if multi == False:
         do_equip(ch, found, where)
     else:
-        for obj in found:
-            do_equip(ch, obj, where)
+        do_equip_many(ch, found, where)
 
 # Initialize immediately when module loads (after scripts are initialized)
 init_equipped()
@@ -4,7 +4,7 @@ history.py
 a little database module for storing communication histories. Can store by
 arbitrary groupings e.g., for guild, global, zone, or personal communications.
 '''
-import mudsys
+import mudsys, mud
 
 
 
@@ -19,6 +19,10 @@ comm_table = { }
 # what is the maximum length of our history logs
 MAX_HISTORY_LEN = 20
 
+# types of communication that go over a channel, and are remembered by it
+# instead of by us. Maps type to channel
+channel_table = { }
+
 
 
 ################################################################################
@@ -29,8 +33,15 @@ def register_comm_history(type, group_func):
     if not type in comm_table:
         comm_table[type] = (group_func, { })
 
+def register_channel_history(type, channel):
+    '''register a type of history that is the history of a channel, as kept
+       by mud.channel_message.'''
+    channel_table[type] = channel
+
 def get_history(ch, type):
     '''return the communication history for a character.'''
+    if type in channel_table:
+        return mud.channel_history(channel_table[type])
     group_func, table = comm_table[type]
     key = group_func(ch)
     if not key in table:
@@ -38,6 +49,8 @@ def get_history(ch, type):
     return table[key]
 
 def add_history(ch, type, mssg):
+    if type in channel_table:
+        return
     group_func, table = comm_table[type]
     key = group_func(ch)
     if key != None:
@@ -59,10 +72,16 @@ def cmd_history(ch, cmd, arg):
        communication you have used, you can use the history command.'''
     arg = arg.lower()
     if arg == "":
-        opts = list(comm_table.keys())
+        opts = list(comm_table.keys()) + list(channel_table.keys())
         opts.sort()
         ch.send("History logs available to you are:")
         ch.send("  " + ", ".join(opts))
+    elif arg in channel_table:
+        mssgs = mud.channel_history(channel_table[arg])
+        if len(mssgs) == 0:
+            ch.send("Your history is empty.")
+        else:
+            ch.page("\r\n".join(mssgs) + "\r\n")
     elif not arg in comm_table:
         ch.send("There is no history log for that type of communication.")
     else:
@@ -189,6 +189,82 @@ def try_move(ch, dir, mssg = False):
     # return the exit we found (if we found any)
     return ex, success
 
+def group_names(looker, chars):
+    '''the names of the characters looker can see, as looker sees them,
+       made into one phrase ("Bob, Sue, and Tom"), and how many there were'''
+    names = [looker.see_as(c) for c in chars if looker.cansee(c)]
+    if len(names) <= 2:
+        return " and ".join(names), len(names)
+    return ", ".join(names[:-1]) + ", and " + names[-1], len(names)
+
+def group_mssg(room, chars, singular, plural):
+    '''tell everyone in the room but the group that it came or went. Each
+       onlooker gets one message for the whole group'''
+    for looker in room.chars:
+        if looker in chars:
+            continue
+        names, count = group_names(looker, chars)
+        if count > 0:
+            verb = (singular if count == 1 else plural)
+            looker.send(names[0].upper() + names[1:] + " " + verb)
+
+def try_move_group(chars, dir, mssg = False):
+    '''Moves a group of characters who are in the same room through an exit
+       together. The first is the leader, whose exit is used and who hears
+       about it if the move can't be made. Onlookers get one message for the
+       whole group, and enter and exit triggers are set off once for it (see
+       mud.move_group). Returns the exit found and whether the group moved.'''
+    leader  = chars[0]
+    ex      = leader.room.exit(dir)
+    success = False
+
+    exname = "it"
+    if ex != None and ex.name != "":
+        exname = ex.name
+
+    if ex == None or not leader.cansee(ex):
+        leader.send("Alas, there is no exit in that direction.")
+    elif ex.is_closed:
+        leader.send("You will have to open " + exname + " first.")
+    elif ex.dest == None:
+        leader.send("It doesn't look like " + exname + " leads anywhere!")
+    else:
+        old_room = leader.room
+        dirnum   = dir_index(dir)
+
+        if mssg == True:
+            if ex.leave_mssg != '':
+                for ch in chars:
+                    mud.message(ch, None, None, None, True, "to_room",
+                                ex.leave_mssg)
+            elif dirnum == -1:
+                group_mssg(old_room, chars, "leaves.", "leave.")
+            else:
+                group_mssg(old_room, chars, "leaves " + dir_name[dirnum] + ".",
+                           "leave " + dir_name[dirnum] + ".")
+
+        # runs everyone's exit and enter hooks, as well
+        mud.move_group(chars, ex.dest, ex)
+        arrived = [ch for ch in chars if ch.room == ex.dest]
+        for ch in arrived:
+            hooks.run("pre_enter", hooks.build_info("ch rm", (ch, ch.room)))
+            ch.act("look")
+
+        if mssg == True and len(arrived) > 0:
+            if ex.enter_mssg != '':
+                for ch in arrived:
+                    mud.message(ch, None, None, None, True, "to_room",
+                                ex.enter_mssg)
+            elif dirnum == -1:
+                group_mssg(ex.dest, arrived, "has arrived.", "have arrived.")
+            else:
+                frm = dir_name[dir_opp[dirnum]]
+                group_mssg(ex.dest, arrived, "arrives from the " + frm + ".",
+                           "arrive from the " + frm + ".")
+        success = len(arrived) > 0
+
+    return ex, success
+
 def cmd_move(ch, cmd, arg):
     '''A basic movement command, relocating you to another room in the
        specified direction.'''
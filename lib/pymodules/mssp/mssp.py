@@ -4,7 +4,7 @@ MSSP (Mud Server Status Protocol) implementation for NakedMud.
 This module handles MSSP requests via the receive_iac hook and automatically
 responds with server status information.
 """
-import mud, char, hooks, mudsys, storage
+import mud, hooks, mudsys, storage
 import time
 import struct
 import os
@@ -17,6 +17,15 @@ SE = 240   # Subnegotiation End
 MSSP_VAR = 1  # Variable marker
 MSSP_VAL = 2  # Value marker
 
+# the variables that change between requests; everything else is encoded once
+DYNAMIC_VARS = ('PLAYERS', 'UPTIME')
+
+
+def encode_mssp_var(var, val):
+    """Encode one MSSP variable and its value"""
+    return (bytes([MSSP_VAR]) + var.encode('utf-8') +
+            bytes([MSSP_VAL]) + val.encode('utf-8'))
+
 class MSSPData:
     """MSSP server data configuration"""
     
@@ -42,6 +51,7 @@ class MSSPData:
             'SUBGENRE': 'High Fantasy'
         }
         self.start_time = time.time()
+        self.static_response = b''
         self.load_from_mudsettings()
     
     def load_from_mudsettings(self):
@@ -71,17 +81,23 @@ class MSSPData:
         except Exception as e:
             # Silently ignore errors loading from mudsettings
             pass
+        self.rebuild()
+    
+    def rebuild(self):
+        """
+        Encode everything but the dynamic variables, once. Call this after
+        changing self.data.
+        """
+        response = bytearray([IAC, SB, MSSP])
+        for var, val in self.data.items():
+            if var not in DYNAMIC_VARS:
+                response.extend(encode_mssp_var(var, val))
+        self.static_response = bytes(response)
     
     def update_dynamic_data(self):
         """Update dynamic MSSP data like player count and uptime"""
-        # Get current player count using char.char_list()
-        player_count = 0
-        for ch in char.char_list():
-            # Only count player characters (those with sockets/accounts)
-            if ch.is_pc:
-                player_count += 1
-        
-        self.data['PLAYERS'] = str(player_count)
+        # the mud keeps count of the PCs in the game as they come and go
+        self.data['PLAYERS'] = str(mudsys.count_players())
         
         # Calculate uptime in seconds
         uptime = int(time.time() - self.start_time)
@@ -90,18 +106,10 @@ class MSSPData:
     def generate_mssp_response(self):
         """Generate MSSP response data"""
         self.update_dynamic_data()
-        
-        response = bytearray()
-        response.extend([IAC, SB, MSSP])
-        
-        for var, val in self.data.items():
-            response.append(MSSP_VAR)
-            response.extend(var.encode('utf-8'))
-            response.append(MSSP_VAL)
-            response.extend(val.encode('utf-8'))
-        
-        response.extend([IAC, SE])
-        return bytes(response)
+        return b''.join([self.static_response] +
+                        [encode_mssp_var(var, self.data[var])
+                         for var in DYNAMIC_VARS] +
+                        [bytes([IAC, SE])])
 
 class MSSPConfig:
     """MSSP Configuration class using StorageSet"""
@@ -261,8 +269,6 @@ def handle_receive_iac(info):
             iac_bytes[1] == 253 and  # DO
             iac_bytes[2] == MSSP):
 
-            # Update dynamic data before sending
-            mssp_data.update_dynamic_data()
             # Generate and send full MSSP response
             response = mssp_data.generate_mssp_response()
             sock.send_binary(response)
@@ -310,11 +316,7 @@ def configure_mssp(name=None, contact=None, website=None, **kwargs):
     for key, value in kwargs.items():
         if key.upper() in mssp_data.data:
             mssp_data.data[key.upper()] = str(value)
-
-def heartbeat_update(info):
-    """Heartbeat hook handler to update dynamic MSSP data"""
-    global mssp_data
-    mssp_data.update_dynamic_data()
+    mssp_data.rebuild()
 
 def cmd_mssp(ch, cmd, arg):
     """MSSP test command - sends MSSP data to the character's client"""
@@ -339,5 +341,4 @@ def cmd_mssp(ch, cmd, arg):
 
 # Register the hook handlers
 hooks.add("receive_iac", handle_receive_iac)
-hooks.add("heartbeat", heartbeat_update)
 mudsys.add_cmd("mssp", None, cmd_mssp, "admin", False)
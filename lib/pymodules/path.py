@@ -13,10 +13,7 @@ import mud, mudsys, room
 ################################################################################
 def leads_to(frm, to):
     '''returns whether from leads directly to to'''
-    for ex in frm.exnames:
-        if frm.exit(ex).dest == to:
-            return True
-    return False
+    return frm.dir_to(to) != None
 
 def shortest_path_bfs(frm, to, ignore_doors = False, stay_zone = True,
                       ignore = None):
@@ -27,58 +24,11 @@ def shortest_path_bfs(frm, to, ignore_doors = False, stay_zone = True,
     if frm == to:
         return [ frm ]
 
-    depth = [ [ frm ] ]
-
-    if ignore == None:
-        ignore = set()
-    ignore.add(frm)
-
-    # figure out what zone we're doing this from
-    zone = None
-    if stay_zone:
-        zone = frm.locale
-
-    # keep going until we find to, or we can't go any deeper
-    found = False
-    while not found:
-        layer = [ ]
-        for room in depth[-1]:
-            for dir in room.exnames:
-                dest = room.exit(dir).dest
-                if dest == None or dest in ignore:
-                    pass
-                elif zone != None and dest.locale != zone:
-                    pass
-                elif dest == to:
-                    found = True
-                    layer = [ ]
-                    break
-                else:
-                    layer.append(dest)
-                ignore.add(dest)
-            if found == True:
-                break
-        if len(layer) > 0:
-            depth.append(layer)
-        if found == True or len(layer) == 0:
-            break
-
-    # no path found
-    if found == False:
-        return None
-
-    # find the rooms that link each other, in reverse order
-    path  = [ to ]
-    order = list(range(len(depth)))
-    order.reverse()
-    for i in order:
-        for room in depth[i]:
-            if leads_to(room, path[-1]):
-                path.append(room)
-                break
-
-    path.reverse()
-    return path
+    # rooms can walk the world themselves, without hashing their way through
+    # exits, and remember the routes they've found. Doors have never stopped
+    # this search, and still don't
+    return frm.path_to(to, ignore_doors = True, stay_zone = stay_zone,
+                       ignore = ignore)
 
 def shortest_path_dfs(frm, to, ignore_doors = False, stay_zone = True,
                       ignore = None):
@@ -138,14 +88,12 @@ shortest_path = shortest_path_bfs
 
 def path_to_dirs(path):
     '''takes a path of rooms and converts it to directions'''
-
     dirs = []
     i    = 0
     while i < len(path) - 1:
-        for ex in path[i].exnames:
-            if path[i].exit(ex).dest == path[i+1]:
-                dirs.append(ex)
-                break
+        dir = path[i].dir_to(path[i+1])
+        if dir != None:
+            dirs.append(dir)
         i = i + 1
 
     # return the directions we generated, if any
@@ -172,7 +120,7 @@ def step(frm, to, ignore_doors = False, stay_zone = True):
     steps = shortest_path(frm, to, ignore_doors, stay_zone)
     if steps == None or len(steps) <= 1:
         return None
-    return path_to_dirs(steps)[0]
+    return steps[0].dir_to(steps[1])
 
 
 
@@ -11,7 +11,6 @@ import importlib
 import mud
 import auxiliary
 import storage
-from . import yaml_parser as yaml
 
 mud.log_string("Progression: Starting module initialization...")
 
@@ -109,7 +108,8 @@ __all__ = []
 # Compile list of modules in dependency order
 # CRITICAL: tdp must come before experience (experience imports tdp)
 _modules = [
-    'skills',        # Base skill definitions (no dependencies)
+    'config',        # Config registry (no dependencies)
+    'skills',        # Base skill definitions (depends on config)        # Base skill definitions (no dependencies)
     'tdp',           # TDP management (depends on attributes, but imported lazily)
     'experience',    # Experience pools (depends on skills, tdp)
     'leveling',      # Level progression (depends on skills)
@@ -159,6 +159,12 @@ from .skills import (
     get_skills_in_category,
 )
 
+from .config import (
+    get_config,
+    get_class_config,
+    list_classes,
+)
+
 from .experience import (
     get_experience_manager,
     add_skill_exp,
@@ -177,7 +183,6 @@ from .integration import (
     setup_progression,
     on_character_login,
     on_character_logout,
-    on_heartbeat,
     on_skill_rank_gained,
 )
 
@@ -199,12 +204,10 @@ Quick Integration Guide:
 
 1. CHARACTER CREATION (with class selection):
    ──────────────────────────────────────────
-   from progression import setup_progression
-   import yaml
+   from progression import setup_progression, get_class_config
    
-   # Load class config
-   with open('config/classes/warrior.yml', 'r') as f:
-       class_config = yaml.safe_load(f)
+   # Class configs are parsed once, and shared (they are read-only)
+   class_config = get_class_config("warrior")
    
    setup_progression(character, class_config)
 
@@ -218,10 +221,11 @@ Quick Integration Guide:
    from progression import on_character_logout
    on_character_logout(character)
 
-4. CHARACTER HEARTBEAT:
-   ─────────────────────
-   from progression import on_heartbeat
-   on_heartbeat(character)
+4. SKILL PULSES:
+   ─────────────
+   Nothing to call. Each skill group's next pulse is queued up as an event
+   when field exp is added, and moved when Wisdom or Discipline change
+   (run the attributes_changed hook after changing them).
 
 5. SKILL RANK INCREASE (from combat/crafting/etc):
    ────────────────────────────────────────────────
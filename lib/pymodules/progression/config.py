@@ -0,0 +1,202 @@
+"""
+Progression Config Registry
+===========================
+Every YAML config progression is driven by (config/skills.yaml, and the class
+configs under config/classes) is loaded through here, once.
+
+The first time a file is asked for, it is parsed and the result is pickled
+under misc/config_cache, stamped with the file's mtime and size. Later boots
+unpickle that instead of parsing the YAML again, for as long as the file is
+unchanged. What callers get back is frozen: dicts are read-only mappings and
+lists are tuples, so one copy is shared by everyone that looks it up.
+
+reload() checks each loaded file's stamp and only re-reads the ones that
+changed; the progreload admin command runs it.
+"""
+
+import os
+import pickle
+import types
+import mud
+from . import yaml_parser
+
+
+CONFIG_DIR = "./config"
+CLASS_DIR = os.path.join(CONFIG_DIR, "classes")
+CACHE_DIR = "./misc/config_cache"
+
+# bumped whenever what is pickled changes shape
+CACHE_VERSION = 1
+
+# path -> (stamp, frozen config)
+_configs = {}
+
+# class_id -> path of its config, once the class directories are scanned
+_class_paths = None
+
+
+def freeze(data):
+    """
+    Make a frozen copy of parsed YAML: dicts become read-only mappings, and
+    lists become tuples.
+    """
+    if isinstance(data, dict):
+        return types.MappingProxyType({k: freeze(v) for k, v in data.items()})
+    if isinstance(data, list):
+        return tuple(freeze(v) for v in data)
+    return data
+
+
+def _stamp(path):
+    """What a cached parse of a file is checked against, or None if missing."""
+    try:
+        st = os.stat(path)
+    except OSError:
+        return None
+    return (st.st_mtime_ns, st.st_size)
+
+
+def _cache_path(path):
+    rel = os.path.relpath(path, CONFIG_DIR)
+    return os.path.join(CACHE_DIR, rel.replace(os.sep, "__") + ".pickle")
+
+
+def _read_cache(path, stamp):
+    """The pickled parse of a file, if there is one for this version of it."""
+    try:
+        with open(_cache_path(path), "rb") as f:
+            version, cached_stamp, data = pickle.load(f)
+    except Exception:
+        return None
+    if version != CACHE_VERSION or cached_stamp != stamp:
+        return None
+    return data
+
+
+def _write_cache(path, stamp, data):
+    cache = _cache_path(path)
+    try:
+        os.makedirs(CACHE_DIR, exist_ok=True)
+        tmp = cache + ".tmp"
+        with open(tmp, "wb") as f:
+            pickle.dump((CACHE_VERSION, stamp, data), f, pickle.HIGHEST_PROTOCOL)
+        os.replace(tmp, cache)
+    except Exception as e:
+        mud.log_string("CONFIG: Could not cache %s: %s" % (path, str(e)))
+
+
+def _load(path, stamp):
+    """Read a file from its cached parse, or parse and cache it."""
+    data = _read_cache(path, stamp)
+    if data is None:
+        data = yaml_parser.load(path)
+        _write_cache(path, stamp, data)
+    frozen = freeze(data)
+    _configs[path] = (stamp, frozen)
+    return frozen
+
+
+def get_config(name):
+    """
+    Get a config, by its path under config/ (e.g. "skills.yaml").
+
+    Returns:
+        The frozen config, or None if it doesn't exist or can't be parsed
+    """
+    path = os.path.join(CONFIG_DIR, name)
+    entry = _configs.get(path)
+    if entry is not None:
+        return entry[1]
+
+    stamp = _stamp(path)
+    if stamp is None:
+        mud.log_string("CONFIG: %s does not exist" % path)
+        return None
+    try:
+        return _load(path, stamp)
+    except Exception as e:
+        mud.log_string("CONFIG: Failed to load %s: %s" % (path, str(e)))
+        return None
+
+
+def _scan_classes():
+    """Find each class's config, by the class's id (its file name)."""
+    global _class_paths
+    _class_paths = {}
+    for root, dirs, files in os.walk(CLASS_DIR):
+        dirs.sort()
+        for fname in sorted(files):
+            class_id, ext = os.path.splitext(fname)
+            if ext in (".yaml", ".yml"):
+                _class_paths.setdefault(class_id,
+                    os.path.relpath(os.path.join(root, fname), CONFIG_DIR))
+
+
+def get_class_config(class_id):
+    """
+    Get a class's config, by id (e.g. "warrior").
+
+    Returns:
+        The frozen config, or None if there is no such class
+    """
+    if _class_paths is None:
+        _scan_classes()
+    name = _class_paths.get(class_id.lower())
+    return get_config(name) if name else None
+
+
+def list_classes():
+    """The ids of all the classes with configs."""
+    if _class_paths is None:
+        _scan_classes()
+    return sorted(_class_paths.keys())
+
+
+def preload():
+    """Load every progression config. Called once, at boot."""
+    get_config("skills.yaml")
+    for class_id in list_classes():
+        get_class_config(class_id)
+    mud.log_string("CONFIG: Loaded %d progression configs" % len(_configs))
+
+
+def reload():
+    """
+    Re-read the configs whose files have changed since they were loaded, and
+    look for classes that were added or removed.
+
+    Returns:
+        list: the paths of the configs that changed
+    """
+    changed = []
+    for path, (stamp, frozen) in list(_configs.items()):
+        new_stamp = _stamp(path)
+        if new_stamp == stamp:
+            continue
+        changed.append(path)
+        del _configs[path]
+        if new_stamp is not None:
+            try:
+                _load(path, new_stamp)
+            except Exception as e:
+                mud.log_string("CONFIG: Failed to reload %s: %s" % (path, str(e)))
+    _scan_classes()
+    return changed
+
+
+def cmd_progreload(ch, cmd, arg):
+    """
+    Usage: progreload
+    Re-read any progression configs that have changed on disk.
+    """
+    changed = reload()
+    if not changed:
+        ch.send("No progression configs have changed.")
+    else:
+        ch.send("Reloaded: %s" % ", ".join(changed))
+
+
+def register_config_commands():
+    """Register config commands"""
+    import mudsys
+    mudsys.add_cmd("progreload", None, cmd_progreload, "admin", False)
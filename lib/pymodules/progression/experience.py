@@ -4,16 +4,25 @@ Phase 2: Experience Pool and Pulsing System
 Manages field experience generation, pool sizing, and skill rank advancement.
 Integrates with existing Attributes system (Intelligence, Wisdom, Discipline).
 
-Pulse system converts field exp to ranks periodically.
+Pulse system converts field exp to ranks periodically. Each skill group with
+field exp waiting has one event queued for when it is next due, so groups
+with nothing to pulse cost nothing. Due times only change when the character
+gains field exp, or their Wisdom or Discipline change.
 Uses your 8-attribute system for calculations.
 """
 
 import time
 import math
 import mud
+import hooks
+import event
 from . import skills
 from . import tdp
-from . import yaml_parser
+
+try:
+    import attributes.attribute_aux as attribute_aux
+except ImportError:
+    attribute_aux = None
 
 
 # Configuration
@@ -25,6 +34,54 @@ PULSE_TIME_BASELINE = 5 * 60  # 5 minutes in seconds
 PULSE_TIME_MINIMUM = 2 * 60   # 2 minutes minimum
 
 
+def get_pulse_attributes(ch):
+    """
+    Get the Wisdom and Discipline pulse timing is worked out from.
+    
+    Returns:
+        tuple: (wisdom, discipline), 10 each if there are no attributes
+    """
+    attr_aux = attribute_aux.get_attributes(ch) if attribute_aux else None
+    if not attr_aux:
+        return (10, 10)
+    return (attr_aux.wisdom, attr_aux.discipline)
+
+
+def calculate_pulse_time_for(wis_value, disc_value):
+    """
+    Calculate pulse time from Wisdom and Discipline.
+    Range: 5 minutes (baseline) down to 2 minutes (high Wisdom/Discipline).
+    
+    Returns:
+        int: Pulse time in seconds
+    """
+    # Wisdom modifier: linear (0-100% bonus at attr 10-100)
+    wis_modifier = max(0.0, (wis_value - 10) / 90.0)
+    
+    # Discipline modifier: 10% efficiency
+    disc_modifier = max(0.0, (disc_value - 10) / 90.0)
+    disc_contribution = (disc_modifier * 0.1)  # 10% efficiency
+    
+    # Total reduction: Wisdom + Discipline (weighted)
+    total_modifier = wis_modifier + disc_contribution
+    
+    # Reduce pulse time by up to 3 minutes based on modifier
+    time_reduction = total_modifier * (PULSE_TIME_BASELINE - PULSE_TIME_MINIMUM)
+    pulse_time = PULSE_TIME_BASELINE - time_reduction
+    
+    # Clamp to valid range
+    pulse_time = max(PULSE_TIME_MINIMUM, min(PULSE_TIME_BASELINE, pulse_time))
+    
+    return int(pulse_time)
+
+
+def calculate_drain_modifier_for(wis_value, disc_value):
+    """The Wisdom modifier a pulse's drain is calculated with."""
+    wis_mod = max(0.0, (wis_value - 10) / 90.0)
+    disc_mod = max(0.0, (disc_value - 10) / 90.0) * 0.1
+    return wis_mod + disc_mod
+
+
 class ExperienceManager:
     """
     Manages character experience tracking and pool draining.
@@ -36,6 +93,15 @@ class ExperienceManager:
         self.last_login = time.time()
         self.last_logout = None
         self.last_offline_drain = time.time()
+        
+        # pulse timing, and the attributes it was worked out from
+        self.pulse_attributes = None
+        self.pulse_time = PULSE_TIME_BASELINE
+        self.drain_modifier = 0.0
+        
+        # bumped each time a group's pulse is scheduled, so the events for
+        # older schedules know to do nothing when they go off
+        self.pulse_tokens = {}
     
     def add_field_exp(self, skill_name, amount):
         """
@@ -59,9 +125,10 @@ class ExperienceManager:
         skill.last_trained = time.time()
         
         # Start pulse timer if not already running
-        group = skills.get_skill_registry().get_group_for_skill(skill_name)
-        if group and group.last_pulse_time is None:
-            group.last_pulse_time = time.time()
+        for key, group in skills.get_skills(self.ch).items():
+            if group.get_skill(skill_name) and group.last_pulse_time is None:
+                group.last_pulse_time = time.time()
+                self.schedule_pulse(key, group)
         
         return True
     
@@ -101,20 +168,14 @@ class ExperienceManager:
         base_pool = (constant * rank) / (rank + divisor) + offset
         
         # Get character's attributes for modifiers
-        try:
-            from . import attribute_aux
-            attr_aux = attribute_aux.get_attributes(self.ch)
-            if not attr_aux:
-                # No attributes? Use baseline (shouldn't happen)
-                int_value = 10
-                disc_value = 10
-            else:
-                int_value = attr_aux.intelligence
-                disc_value = attr_aux.discipline
-        except ImportError:
-            # Attributes not available
+        attr_aux = attribute_aux.get_attributes(self.ch) if attribute_aux else None
+        if not attr_aux:
+            # No attributes? Use baseline (shouldn't happen)
             int_value = 10
             disc_value = 10
+        else:
+            int_value = attr_aux.intelligence
+            disc_value = attr_aux.discipline
         
         # Intelligence bonus: linear (0-100% bonus at attr 10-100)
         # Formula: (int - 10) / 90 = modifier, then base_pool *= (1 + modifier * 0.3)
@@ -138,69 +199,78 @@ class ExperienceManager:
         Returns:
             int: Pulse time in seconds
         """
-        try:
-            from . import attribute_aux
-            attr_aux = attribute_aux.get_attributes(self.ch)
-            if not attr_aux:
-                wis_value = 10
-                disc_value = 10
-            else:
-                wis_value = attr_aux.wisdom
-                disc_value = attr_aux.discipline
-        except ImportError:
-            wis_value = 10
-            disc_value = 10
-        
-        # Wisdom modifier: linear (0-100% bonus at attr 10-100)
-        wis_modifier = max(0.0, (wis_value - 10) / 90.0)
-        
-        # Discipline modifier: 10% efficiency
-        disc_modifier = max(0.0, (disc_value - 10) / 90.0)
-        disc_contribution = (disc_modifier * 0.1)  # 10% efficiency
-        
-        # Total reduction: Wisdom + Discipline (weighted)
-        total_modifier = wis_modifier + disc_contribution
-        
-        # Reduce pulse time by up to 3 minutes based on modifier
-        time_reduction = total_modifier * (PULSE_TIME_BASELINE - PULSE_TIME_MINIMUM)
-        pulse_time = PULSE_TIME_BASELINE - time_reduction
-        
-        # Clamp to valid range
-        pulse_time = max(PULSE_TIME_MINIMUM, min(PULSE_TIME_BASELINE, pulse_time))
+        return calculate_pulse_time_for(*get_pulse_attributes(self.ch))
+    
+    def refresh_pulse_timing(self):
+        """
+        Work pulse timing out again, if Wisdom or Discipline have changed
+        since it was last worked out.
         
-        return int(pulse_time)
+        Returns:
+            bool: True if it changed
+        """
+        attrs = get_pulse_attributes(self.ch)
+        if attrs == self.pulse_attributes:
+            return False
+        self.pulse_attributes = attrs
+        self.pulse_time = calculate_pulse_time_for(*attrs)
+        self.drain_modifier = calculate_drain_modifier_for(*attrs)
+        return True
     
-    def check_pulse_all_groups(self):
+    def schedule_pulse(self, key, group):
         """
-        Check if any skill groups should pulse and execute pulse if needed.
-        Called from character heartbeat.
+        Queue up the event for a group's next pulse, replacing any already
+        queued. Groups with no pulse timer running get no event.
+        
+        Args:
+            key: The group's key in the character's skill groups
+            group: SkillGroup object
         """
-        groups = skills.get_skills(self.ch)
-        current_time = time.time()
-        pulse_time = self.calculate_pulse_time()
-        
-        # Get Wisdom modifier for pulse drain calculation
-        try:
-            from . import attribute_aux
-            attr_aux = attribute_aux.get_attributes(self.ch)
-            if attr_aux:
-                wis_value = attr_aux.wisdom
-                disc_value = attr_aux.discipline
-            else:
-                wis_value = 10
-                disc_value = 10
-        except ImportError:
-            wis_value = 10
-            disc_value = 10
+        if self.pulse_attributes is None:
+            self.refresh_pulse_timing()
+        token = self.pulse_tokens.get(key, 0) + 1
+        self.pulse_tokens[key] = token
+        if group.last_pulse_time is None:
+            return
+        delay = max(0, group.last_pulse_time + self.pulse_time - time.time())
+        event.start_event(self.ch, delay, group_pulse_event, (key, token))
+    
+    def schedule_all_pulses(self):
+        """Queue up the next pulse of each group with a pulse timer running."""
+        self.refresh_pulse_timing()
+        for key, group in skills.get_skills(self.ch).items():
+            self.schedule_pulse(key, group)
+    
+    def on_attributes_changed(self):
+        """Move pulses to their new due times, if pulse timing has changed."""
+        if self.refresh_pulse_timing():
+            self.schedule_all_pulses()
+    
+    def pulse_group(self, key, token):
+        """
+        A group's pulse is due. Convert its field exp to ranks, and queue up
+        its next pulse if it still has field exp waiting.
         
-        wis_mod = max(0.0, (wis_value - 10) / 90.0)
-        disc_mod = max(0.0, (disc_value - 10) / 90.0) * 0.1
+        Args:
+            key: The group's key in the character's skill groups
+            token: What the group's pulse token was when this was scheduled
+        """
+        if self.pulse_tokens.get(key) != token:
+            return
+        group = skills.get_skills(self.ch).get(key)
+        if group is None:
+            return
         
-        for group in groups.values():
-            if group.should_pulse(current_time, pulse_time):
-                group.pulse(current_time, wis_mod + disc_mod)
-                mud.log_string("PULSE: %s's %s group pulsed (field exp -> ranks)" % 
-                             (self.ch.name, group.name))
+        current_time = time.time()
+        if group.should_pulse(current_time, self.pulse_time):
+            group.pulse(current_time, self.drain_modifier, self.pulse_time)
+            mud.log_string("PULSE: %s's %s group pulsed (field exp -> ranks)" % 
+                         (self.ch.name, group.name))
+        
+        # nothing left to pulse; the timer starts again with more field exp
+        if not any(skill.field_exp > 0 for skill in group.get_all_skills()):
+            group.last_pulse_time = None
+        self.schedule_pulse(key, group)
     
     def check_offline_drain(self):
         """
@@ -276,6 +346,29 @@ def get_experience_manager(ch):
     return None
 
 
+def group_pulse_event(owner, data, arg):
+    """The event a skill group's next pulse is queued up as."""
+    manager = get_experience_manager(owner)
+    if manager:
+        manager.pulse_group(*data)
+
+
+def pulse_to_game_hook(info):
+    """Pulses are events, so they are queued up again when players return."""
+    ch, = hooks.parse_info(info)
+    manager = get_experience_manager(ch) if ch else None
+    if manager:
+        manager.schedule_all_pulses()
+
+
+def pulse_attributes_changed_hook(info):
+    """Due times change with Wisdom and Discipline."""
+    ch, = hooks.parse_info(info)
+    manager = get_experience_manager(ch) if ch else None
+    if manager:
+        manager.on_attributes_changed()
+
+
 def add_skill_exp(ch, skill_name, amount, source="unknown"):
     """
     Add field experience to a skill.
@@ -423,4 +516,6 @@ def register_experience_commands():
     import mudsys
     mudsys.add_cmd("exp", None, cmd_exp, "player", False)
     mudsys.add_cmd("add_exp", None, cmd_add_exp, "admin", False)
+    hooks.add("char_to_game",       pulse_to_game_hook)
+    hooks.add("attributes_changed", pulse_attributes_changed_hook)
     mud.log_string("Experience commands registered")
\ No newline at end of file
@@ -11,7 +11,7 @@ import hooks
 from . import skills as progression_skills
 from . import experience as progression_experience
 from . import leveling as progression_leveling
-from . import yaml_parser
+from . import config as progression_config
 
 # Configuration
 OFFLINE_DRAIN_DELAY = 8 * 60 * 60  # 8 hours before offline drain starts
@@ -93,22 +93,6 @@ def on_character_logout(ch):
         mud.log_string("ERROR: on_character_logout failed for %s: %s" % (ch.name, str(e)))
 
 
-def on_heartbeat(ch):
-    """
-    Called every heartbeat (typically 1-5 seconds).
-    Checks if skill groups should pulse and converts field exp to ranks.
-    
-    Args:
-        ch: Character to pulse
-    """
-    try:
-        exp_manager = progression_experience.get_experience_manager(ch)
-        if exp_manager:
-            exp_manager.check_pulse_all_groups()
-    except Exception as e:
-        mud.log_string("ERROR: on_heartbeat failed for %s: %s" % (ch.name, str(e)))
-
-
 def on_skill_rank_gained(ch, skill_name, old_rank, new_rank):
     """
     Called when a skill gains a rank (from pulse or other source).
@@ -147,6 +131,9 @@ def init_progression():
     mud.log_string("PROGRESSION: Initializing progression module...")
     
     try:
+        # Parse every config once, up front
+        progression_config.preload()
+        
         # Load skill registry from config
         skill_registry = progression_skills.get_skill_registry()
         if not skill_registry.skills:
@@ -418,6 +405,7 @@ def register_all_commands():
         # Register commands
         progression_experience.register_experience_commands()
         progression_leveling.register_leveling_commands()
+        progression_config.register_config_commands()
         register_progression_commands()
         mud.log_string("PROGRESSION: All commands registered")
     except Exception as e:
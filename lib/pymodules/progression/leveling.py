@@ -10,7 +10,6 @@ New approach: Each class has its own level requirements in class config
 
 import mud
 from . import skills
-from . import yaml_parser
 
 # Level constants
 LEVEL_MIN = 1
@@ -12,13 +12,12 @@ Old approach: Hard-coded placement in skill system
 New approach: Placement defined per-class in class YAML config
 """
 
-from . import yaml_parser as yaml
+from collections.abc import Mapping
+from . import config as progression_config
 import mud
-import os
 
 
-CONFIG_DIR = "./config"
-SKILLS_CONFIG = os.path.join(CONFIG_DIR, "skills.yaml")
+SKILLS_CONFIG = "skills.yaml"
 
 # Skill rank constants
 SKILL_MIN_RANK = 0
@@ -145,9 +144,9 @@ class SkillGroup:
         check_interval = pulse_interval if pulse_interval is not None else self.pulse_interval
         return time_since_pulse >= check_interval
     
-    def pulse(self, current_time, wisdom_modifier=0.0):
+    def pulse(self, current_time, wisdom_modifier=0.0, pulse_interval=None):
         """Execute pulse: convert field exp to ranks for all skills"""
-        if not self.should_pulse(current_time):
+        if not self.should_pulse(current_time, pulse_interval):
             return
         
         pulse_size = self.calculate_pulse_size(wisdom_modifier)
@@ -204,28 +203,23 @@ class SkillRegistry:
     
     def __init__(self):
         self.skills = {}  # skill_name -> skill metadata
+        self.config = None  # the config the skills were loaded from
     
-    def load_from_yaml(self, filepath):
-        """Load skill definitions from YAML config"""
-        try:
-            with open(filepath, 'r') as f:
-                config = yaml.safe_load(f)
-        except Exception as e:
-            mud.log_string("ERROR: Failed to load skills config: %s" % str(e))
-            return False
-    
+    def load_from_config(self, config):
+        """Load skill definitions from the (frozen) skills config"""
+        self.config = config
         if not config or 'skills' not in config:
             mud.log_string("ERROR: Invalid skills config format")
             return False
     
         skills_list = config['skills']
-        if not isinstance(skills_list, list):
+        if not isinstance(skills_list, tuple):
             mud.log_string("ERROR: skills is not a list, it's: %s" % type(skills_list))
             return False
     
         for idx, skill_data in enumerate(skills_list):
             # Debug: check what we got
-            if not isinstance(skill_data, dict):
+            if not isinstance(skill_data, Mapping):
                 mud.log_string("WARNING: Skill item %d is not a dict, it's %s: %s" % 
                               (idx, type(skill_data), skill_data))
                 continue
@@ -275,11 +269,15 @@ _skill_registry = None
 
 
 def get_skill_registry():
-    """Get or initialize the global skill registry"""
+    """
+    Get the global skill registry, initializing it again if the skills
+    config has been reloaded since it was last initialized.
+    """
     global _skill_registry
-    if _skill_registry is None:
+    config = progression_config.get_config(SKILLS_CONFIG)
+    if _skill_registry is None or _skill_registry.config is not config:
         _skill_registry = SkillRegistry()
-        if not _skill_registry.load_from_yaml(SKILLS_CONFIG):
+        if not _skill_registry.load_from_config(config):
             mud.log_string("WARNING: Skill registry initialization failed")
     return _skill_registry
 
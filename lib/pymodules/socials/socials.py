@@ -4,8 +4,10 @@ package: socials
 socials are commonly used emotes (e.g. smiling, grinning, laughing). Instead
 making people have to write out an entire emote every time they would like
 to express such an emote, they can simply use one of these simple commands
-to perform a pre-made emote. This is essentially a copy of the c module written
-in python. There are no changes good or bad.
+to perform a pre-made emote. The socials themselves are kept and edited here;
+each is handed to the mud's social table with mudsys.add_social, which is
+what performs them. Socials are not commands. They are tried once no command
+goes by the word that was typed, and check their min_pos and max_pos there.
 
 Description of module concepts:
  cmds are the list of commands that trigger the social. More than one cmd
@@ -45,8 +47,7 @@ Description of module concepts:
  per performed from, respectively.
 
 """
-from mudsys import add_cmd, remove_cmd
-from cmd_checks import chk_conscious, chk_can_move, chk_grounded, chk_supine
+from mudsys import add_cmd
 import mud, storage, char, auxiliary, time, string, hooks, mudsys
 
 # This stores all the socials themselves, before unlinking
@@ -211,17 +212,8 @@ def link_social(new_cmd, old_cmd, save=True):
     del social_table[cmds]
     social_table[new_cmds] = social_data
 
-    # add the command to the system
-    add_cmd(new_cmd, None, cmd_social, "player", False)
-    # this needs to be rewritten
-    if social_data.get_min_pos() == "sitting":
-        mudsys.add_cmd_check(new_cmd, chk_conscious)
-    elif social_data.get_min_pos() == "standing":
-        mudsys.add_cmd_check(new_cmd, chk_can_move)
-    elif social_data.get_max_pos() == "standing":
-        mudsys.add_cmd_check(new_cmd, chk_grounded)
-    elif social_data.get_max_pos() == "sitting":
-        mudsys.add_cmd_check(new_cmd, chk_supine)
+    # hand it back to the social table, under all of its commands
+    mudsys.add_social(social_data)
 
     if save is True:
         save_socials()
@@ -240,7 +232,7 @@ def unlink_social(social_cmd, save=True):
             result = [x.strip() for x in cmds.split(',')]
             # remove the original cmd from the command list
             result.remove(social_cmd)
-            remove_cmd(social_cmd)
+            mudsys.remove_social(social_cmd)
             # if there are still commands left re-add
             if len(result) > 0:
                 social_data.set_cmds(','.join(result))
@@ -256,17 +248,9 @@ def add_social(social_data, save=True):
     result = [x.strip() for x in cmds.split(',')]
     for res in result:
         unlink_social(res)
-        add_cmd(res, None, cmd_social, "player", False)
-        if social_data.get_min_pos() == "sitting":
-            mudsys.add_cmd_check(res, chk_conscious)
-        elif social_data.get_min_pos() == "standing":
-            mudsys.add_cmd_check(res, chk_can_move)
-        elif social_data.get_max_pos() == "standing":
-            mudsys.add_cmd_check(res, chk_grounded)
-        elif social_data.get_max_pos() == "sitting":
-            mudsys.add_cmd_check(res, chk_supine)
         socials[res] = cmds
     social_table[cmds] = social_data
+    mudsys.add_social(social_data)
     if save:
         save_socials()
 
@@ -303,16 +287,8 @@ def load_socials():
         result = [x.strip() for x in cmds.split(',')]
         social_table[cmds] = social_data
         for res in result:
-            add_cmd(res, None, cmd_social, "player", False)
-            if social_data.get_min_pos() == "sitting":
-                mudsys.add_cmd_check(res, chk_conscious)
-            elif social_data.get_min_pos() == "standing":
-                mudsys.add_cmd_check(res, chk_can_move)
-            elif social_data.get_max_pos() == "standing":
-                mudsys.add_cmd_check(res, chk_grounded)
-            elif social_data.get_max_pos() == "sitting":
-                mudsys.add_cmd_check(res, chk_supine)
             socials[res] = cmds
+        mudsys.add_social(social_data)
     storeSet.close()
     return
 
@@ -348,7 +324,7 @@ def cmd_socials(ch, cmd, arg):
     specific social will look if used, the adverbs, and any synonyms.
     '''
     buf = [ ]
-    socs = sorted(__socials__.keys())
+    socs = sorted(socials.keys())
     count = 0
     for soc in socs:
         count = count + 1
@@ -389,136 +365,6 @@ def cmd_socunlink(ch, cmd, arg):
     ch.send("The %s social was unlinked." % arg)
     mud.log_string("%s unlinked the social %s." % (ch.name, arg))
 
-def process_social_message(msg, modifier, data):
-    """Helper function to process social message with proper $X/$x replacement"""
-    if not msg:
-        return msg
-    
-    # Replace $x with adjective (always from social data)
-    if "$x" in msg and data.get_adjective():
-        msg = msg.replace("$x", data.get_adjective())
-    
-    # Replace $X with modifier (user provided) or default adverb
-    if "$X" in msg:
-        if modifier:
-            msg = msg.replace("$X", modifier)
-        elif data.get_adverb():
-            msg = msg.replace("$X", data.get_adverb())
-    
-    return msg
-
-
-# One generic command for handling socials. Does table lookup on all of
-# the existing socials and executes the proper one.
-def cmd_social(ch, cmd, arg):
-    data = get_social(cmd)
-    
-    # Parse arguments to extract modifier and target
-    # Social syntax supports two formats:
-    #   1. Explicit: "modifier at target" (e.g., "grin evilly at mysty")
-    #   2. Implicit: "modifier target" (e.g., "grin evilly mysty")
-    
-    args = arg.split(" at ", 1)
-    has_explicit_at = len(args) >= 2
-    
-    if has_explicit_at:
-        # Format: "modifier at target"
-        # Everything before " at " becomes the modifier
-        # Everything after " at " becomes the target
-        modifier = args[0].strip()
-        target_name = args[1].strip()
-    else:
-        # Format: "modifier target" or single word or empty
-        # Parse by splitting on spaces and using positional logic
-        words = arg.strip().split()
-        
-        if len(words) >= 2:
-            # Multiple words: "very evilly mysty" -> modifier="very evilly", target="mysty"
-            # All words except the last become the modifier
-            # Last word becomes the target to search for
-            modifier = " ".join(words[:-1])
-            target_name = words[-1]
-        elif len(words) == 1:
-            # Single word: "mysty" or "evilly"
-            # Try as target first, fallback to modifier if target not found
-            modifier = ""
-            target_name = words[0]
-        else:
-            # Empty command: "grin"
-            # No modifier, no target - will use social defaults
-            modifier = ""
-            target_name = ""
-    
-    # does the social exist? Do we have a problem? DO WE?
-    if data:
-        # Search for target if we have a target name
-        tgt = None
-        type = None
-        if target_name:
-            try:
-                tgt, type = mud.generic_find(ch, target_name, "all", "immediate", False)
-            except UnicodeDecodeError:
-                # mud.generic_find failed due to encoding issues, treat as no target found
-                tgt = None
-                type = None
-            
-        # If we found no target, handle fallback logic
-        if tgt is None and not has_explicit_at:
-            if len(arg.strip().split()) == 1:
-                # Single word that wasn't found as target - treat as modifier
-                modifier = arg.strip()
-                target_name = ""
-            # For multi-word cases, modifier and target_name are already set correctly
-        elif tgt is not None and type != "char":
-            # Found something but it's not a character
-            ch.send("That individual does not seem to be here.")
-            return
-
-        # Set default modifier if no modifier provided but adverb exists
-        # This happens AFTER fallback logic so user modifiers take precedence
-        if not modifier and data.get_adverb():
-            modifier = data.get_adverb()
-
-        # No target was supplied, the emote is to ourselves.
-        if tgt is None:
-            if data.get_to_char_notgt():
-                msg = process_social_message(data.get_to_char_notgt(), modifier, data)
-                mud.message(ch, None, None, None, True, "to_char", msg)
-            if data.get_to_room_notgt():
-                msg = process_social_message(data.get_to_room_notgt(), modifier, data)
-                mud.message(ch, None, None, None, True, "to_room", msg)
-            return
-        # a target was supplied and it is us
-        elif ch == tgt:
-            if data.get_to_char_self():
-                msg = process_social_message(data.get_to_char_self(), modifier, data)
-                mud.message(ch, None, None, None, True, "to_char", msg)
-            elif data.get_to_char_notgt():
-                msg = process_social_message(data.get_to_char_notgt(), modifier, data)
-                mud.message(ch, None, None, None, True, "to_char", msg)
-            if data.get_to_room_self():
-                msg = process_social_message(data.get_to_room_self(), modifier, data)
-                mud.message(ch, None, None, None, True, "to_room", msg)
-            elif data.get_to_room_notgt():
-                msg = process_social_message(data.get_to_room_notgt(), modifier, data)
-                mud.message(ch, None, None, None, True, "to_room", msg)
-            return
-        # a target was supplied and it is not us
-        else:
-            if data.get_to_char_tgt():
-                msg = process_social_message(data.get_to_char_tgt(), modifier, data)
-                mud.message(ch, tgt, None, None, True, "to_char", msg)
-            if data.get_to_vict_tgt():
-                msg = process_social_message(data.get_to_vict_tgt(), modifier, data)
-                mud.message(ch, tgt, None, None, True, "to_vict", msg)
-            if data.get_to_room_tgt():
-                msg = process_social_message(data.get_to_room_tgt(), modifier, data)
-                mud.message(ch, tgt, None, None, True, "to_room", msg)
-    else:
-        mud.log_string("ERROR: %s tried social, %s, but no such social exists!" % (ch.name, cmd))
-    return
-            
-
 load_socials()
 add_cmd("socials", None, cmd_socials, "player", False)
 add_cmd("socunlink", None, cmd_socunlink, "builder", False)
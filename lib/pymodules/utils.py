@@ -112,6 +112,20 @@ def get_count(str):
     except:
         return 1, str
 
+def group_list(list, s_func):
+    '''collapses the things in a list that share a description into groups.
+       Returns a list of (thing, count) pairs, one for the first thing in each
+       group, in the order the groups first appear. s_func is only called
+       once for each thing'''
+    groups = { }
+    for thing in list:
+        desc = s_func(thing)
+        if desc in groups:
+            groups[desc][1] += 1
+        else:
+            groups[desc] = [thing, 1]
+    return [(thing, count) for thing, count in groups.values()]
+
 def build_show_list(ch, list, s_func, m_func = None, joiner = "\r\n",
                     and_end=False):
     '''builds a list of things to show a character. s_func is the description if
@@ -121,30 +135,14 @@ def build_show_list(ch, list, s_func, m_func = None, joiner = "\r\n",
     # the outbound info
     buf = [ ]
 
-    # maps descriptions to counts
-    counts = { }
-
-    # build up our counts
-    for thing in list:
-        if s_func(thing) in counts:
-            counts[s_func(thing)] = counts[s_func(thing)] + 1
+    # print out our groups
+    for thing, count in group_list(list, s_func):
+        if count == 1:
+            buf.append(s_func(thing))
+        elif m_func == None or m_func(thing) == "":
+            buf.append("(" + str(count) + ") " + s_func(thing))
         else:
-            counts[s_func(thing)] = 1
-
-    # print out our counts
-    for thing in list:
-        # only display > 0 counts. Otherwise it has been displayed
-        if s_func(thing) in counts:
-            count = counts.pop(s_func(thing))
-
-            # display our item(s)
-            if count == 1:
-                buf.append(s_func(thing))
-            elif m_func == None or m_func(thing) == "":
-                buf.append("(" + str(count) + ") " + s_func(thing))
-            else:
-                buf.append(m_func(thing) % (count,))
-        else: pass
+            buf.append(m_func(thing) % (count,))
 
     # do we have to put "and" at the end?
     if and_end and len(buf) > 1:
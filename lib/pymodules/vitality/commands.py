@@ -61,6 +61,7 @@ def cmd_damage(ch, cmd, arg):
     
     old_hp = vit_aux.hp
     vitality_damage.take_damage(target, damage_amount, "admin_command", ch)
+    vitality_core.send_gmcp_vitals(target)
     ch.send("You deal %d damage to %s. HP: %.1f -> %.1f" % 
              (damage_amount, target.name, old_hp, vit_aux.hp))
     
@@ -148,6 +149,9 @@ def cmd_heal(ch, cmd, arg):
         if injury_aux and hasattr(injury_aux, 'wounds'):
             wounds_removed = len(injury_aux.wounds)
             injury_aux.wounds = {}
+            target.forget_derived("injuries")
+    
+    vitality_core.send_gmcp_vitals(target)
     
     # Build response message
     if heal_type == "all":
@@ -27,14 +27,42 @@ except ImportError:
     mud.log_string("vitality_core: Attributes module not available")
 
 
+# the pools that regenerate, each kept by the character's regenerator
+VITALITY_POOLS = ("hp", "sp", "ep")
+
+# max HP, SP, and EP, remembered by the character until one of the
+# attributes they come from changes
+MAX_HP = mud.register_derived("max_hp")
+MAX_SP = mud.register_derived("max_sp")
+MAX_EP = mud.register_derived("max_ep")
+
+
+def _pool_property(pool, getter, setter):
+    """A property read from and written to one of the regenerator's pools."""
+    return property(lambda self: getattr(self.regen, getter)(pool),
+                    lambda self, val: getattr(self.regen, setter)(pool, val))
+
+
 class VitalityAuxData:
     """
     Stores character vitality data (HP, SP, EP).
     Attached to characters as auxiliary data.
+    
+    Current and max values live in a regenerator (see mud.regenerator), so
+    the mud can tick them back up without running any Python, and only
+    the characters that aren't full are looked at.
     """
     
+    hp     = _pool_property("hp", "get",     "set")
+    max_hp = _pool_property("hp", "get_max", "set_max")
+    sp     = _pool_property("sp", "get",     "set")
+    max_sp = _pool_property("sp", "get_max", "set_max")
+    ep     = _pool_property("ep", "get",     "set")
+    max_ep = _pool_property("ep", "get_max", "set_max")
+    
     def __init__(self, set=None):
         """Initialize with default values or load from storage set."""
+        self.regen = mud.regenerator(VITALITY_POOLS, "Char.Vitals")
         if set is None:
             # Default values - will be recalculated from attributes
             self.hp = 100.0
@@ -57,13 +85,14 @@ class VitalityAuxData:
             # Status flags
             self.initialized = False
         else:
-            # Load from storage set
-            self.hp = set.readDouble("hp")
+            # Load from storage set. Maxes first, so the regenerator never
+            # sees a pool over its max
             self.max_hp = set.readDouble("max_hp")
-            self.sp = set.readDouble("sp")
+            self.hp = set.readDouble("hp")
             self.max_sp = set.readDouble("max_sp")
-            self.ep = set.readDouble("ep")
+            self.sp = set.readDouble("sp")
             self.max_ep = set.readDouble("max_ep")
+            self.ep = set.readDouble("ep")
             self.last_regen_tick = set.readInt("last_regen_tick")
             self.is_dead = set.readBool("is_dead")
             self.death_count = set.readInt("death_count")
@@ -76,6 +105,16 @@ class VitalityAuxData:
                 # TODO: Parse injury data when injury.py is implemented
     
     
+    @property
+    def is_dead(self):
+        """The dead don't regenerate."""
+        return self.regen.paused
+    
+    @is_dead.setter
+    def is_dead(self, val):
+        self.regen.paused = bool(val)
+    
+    
     def copyTo(self, other):
         """Copy this data to another VitalityAuxData instance."""
         other.hp = self.hp
@@ -84,6 +123,8 @@ class VitalityAuxData:
         other.max_sp = self.max_sp
         other.ep = self.ep
         other.max_ep = self.max_ep
+        for pool in VITALITY_POOLS:
+            other.regen.set_rate(pool, self.regen.get_rate(pool))
         other.last_regen_tick = self.last_regen_tick
         other.is_dead = self.is_dead
         other.death_count = self.death_count
@@ -132,6 +173,29 @@ def get_vitality(ch):
     return ch.getAuxiliary("vitality_data")
 
 
+def send_gmcp_vitals(ch):
+    """
+    Update the Char.Vitals GMCP package for a character's client. Only the
+    values that changed since the client was last sent them go out, once
+    per pulse, so this is cheap to call whenever vitality might change.
+    
+    Args:
+        ch: Character object
+    """
+    sock = ch.socket
+    if sock is None or not sock.gmcp:
+        return
+    aux = get_vitality(ch)
+    if aux is None:
+        return
+    sock.gmcp_set("Char.Vitals", "hp",    int(aux.hp))
+    sock.gmcp_set("Char.Vitals", "maxhp", int(aux.max_hp))
+    sock.gmcp_set("Char.Vitals", "sp",    int(aux.sp))
+    sock.gmcp_set("Char.Vitals", "maxsp", int(aux.max_sp))
+    sock.gmcp_set("Char.Vitals", "ep",    int(aux.ep))
+    sock.gmcp_set("Char.Vitals", "maxep", int(aux.max_ep))
+
+
 def ensure_vitality(ch):
     """
     Ensure a character has vitality data installed.
@@ -210,10 +274,13 @@ def calculate_max_hp(ch):
     attr_aux = attribute_aux.get_attributes(ch)
     if not attr_aux:
         return 100.0
+    cached = ch.derived(MAX_HP)
+    if cached is not None:
+        return int(cached)
     
-    stamina = attr_aux.get_attribute("stamina")
-    strength = attr_aux.get_attribute("strength")
-    discipline = attr_aux.get_attribute("discipline")
+    stamina = attr_aux.stamina
+    strength = attr_aux.strength
+    discipline = attr_aux.discipline
     
     result = stamina + ((strength + discipline) * 0.125)
     
@@ -221,7 +288,9 @@ def calculate_max_hp(ch):
     # TODO: Add equipment bonuses
     # TODO: Add temporary buffs
     
-    return math.ceil(result)
+    result = math.ceil(result)
+    ch.set_derived(MAX_HP, result)
+    return result
 
 
 def calculate_max_sp(ch):
@@ -241,10 +310,13 @@ def calculate_max_sp(ch):
     attr_aux = attribute_aux.get_attributes(ch)
     if not attr_aux:
         return 100.0
+    cached = ch.derived(MAX_SP)
+    if cached is not None:
+        return int(cached)
     
-    intelligence = attr_aux.get_attribute("intelligence")
-    discipline = attr_aux.get_attribute("discipline")
-    wisdom = attr_aux.get_attribute("wisdom")
+    intelligence = attr_aux.intelligence
+    discipline = attr_aux.discipline
+    wisdom = attr_aux.wisdom
     
     result = intelligence + ((discipline + wisdom) * 0.25)
     
@@ -252,7 +324,9 @@ def calculate_max_sp(ch):
     # TODO: Add equipment bonuses
     # TODO: Add temporary buffs
     
-    return math.ceil(result)
+    result = math.ceil(result)
+    ch.set_derived(MAX_SP, result)
+    return result
 
 
 def calculate_max_ep(ch):
@@ -272,12 +346,15 @@ def calculate_max_ep(ch):
     attr_aux = attribute_aux.get_attributes(ch)
     if not attr_aux:
         return 100.0
+    cached = ch.derived(MAX_EP)
+    if cached is not None:
+        return int(cached)
     
-    stamina = attr_aux.get_attribute("stamina")
-    discipline = attr_aux.get_attribute("discipline")
-    reflex = attr_aux.get_attribute("reflex")
-    strength = attr_aux.get_attribute("strength")
-    agility = attr_aux.get_attribute("agility")
+    stamina = attr_aux.stamina
+    discipline = attr_aux.discipline
+    reflex = attr_aux.reflex
+    strength = attr_aux.strength
+    agility = attr_aux.agility
     
     result = stamina + ((discipline + reflex + strength + agility) * 0.125)
     
@@ -285,7 +362,9 @@ def calculate_max_ep(ch):
     # TODO: Add equipment bonuses
     # TODO: Add temporary buffs
     
-    return math.ceil(result)
+    result = math.ceil(result)
+    ch.set_derived(MAX_EP, result)
+    return result
 
 
 def recalculate_vitality(ch):
@@ -334,6 +413,10 @@ def recalculate_vitality(ch):
     vit_aux.max_sp = new_max_sp
     vit_aux.max_ep = new_max_ep
     
+    # regeneration rates come from the same attributes
+    from . import vitality_regen
+    vitality_regen.update_regen_rates(ch)
+    
     mud.log_string(f"Recalculated vitality for {ch.name}: HP {old_max_hp:.0f}→{new_max_hp:.0f}, "
                    f"SP {old_max_sp:.0f}→{new_max_sp:.0f}, EP {old_max_ep:.0f}→{new_max_ep:.0f}")
 
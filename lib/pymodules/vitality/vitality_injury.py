@@ -29,6 +29,10 @@ SEVERITY_LEVELS = [
     "critical"        # 8
 ]
 
+# whether a character's scar penalties are still what was last worked out.
+# The penalties themselves are kept with their injuries
+SCAR_PENALTIES = mud.register_derived("scar_penalties", "injuries")
+
 
 def setup_injury_system():
     """Initialize injury system on character load"""
@@ -145,6 +149,7 @@ def apply_wound(ch, body_part=None, wound_type="surface", severity=3):
         mud.log_string("INJURY: %s received %s %s wound on %s (severity %d)" % 
                        (ch.name, SEVERITY_LEVELS[severity], wound_type, body_part, severity))
     
+    ch.forget_derived("injuries")
     return True
 
 
@@ -175,6 +180,7 @@ def add_wound_status(ch, body_part, status):
     if status not in wound["status"]:
         wound["status"].append(status)
         mud.log_string("INJURY: %s wound on %s is now %s" % (ch.name, body_part, status))
+        ch.forget_derived("injuries")
         return True
     
     return False
@@ -232,6 +238,7 @@ def check_wound_progression(ch):
     
     # Reset counter
     injury_aux.progression_counter = 0
+    ch.forget_derived("injuries")
     
     # Check each wound for progression
     for body_part, wound in injury_aux.wounds.items():
@@ -299,12 +306,19 @@ def get_scar_penalties(ch):
     if not injury_aux or not hasattr(injury_aux, 'scars'):
         return penalties
     
+    # still the same as last worked out, if their injuries haven't changed
+    cached = getattr(injury_aux, "scar_penalties", None)
+    if cached is not None and ch.derived(SCAR_PENALTIES) is not None:
+        return cached
+    
     # Iterate through scars and accumulate penalties
     for body_part, scar_severity in injury_aux.scars.items():
         part_penalties = injury_penalties.get_penalties(body_part, scar_severity)
         for skill, penalty in part_penalties.items():
             penalties[skill] = penalties.get(skill, 0) + penalty
     
+    injury_aux.scar_penalties = penalties
+    ch.set_derived(SCAR_PENALTIES, len(penalties))
     return penalties
 
 def setup_injuries(ch):
@@ -323,6 +337,7 @@ def setup_injuries(ch):
         injury_aux.wounds = {}           # body_part -> wound dict
         injury_aux.scars = {}            # body_part -> scar severity
         injury_aux.progression_counter = 0
+        ch.forget_derived("injuries")
         mud.log_string("INJURY: Initialized injury system for %s" % ch.name)
     else:
         # Ensure required attributes exist (for old characters)
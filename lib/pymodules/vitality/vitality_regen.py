@@ -3,8 +3,12 @@ Vitality Regeneration Module
 =============================
 Handles HP, SP, and EP regeneration over time.
 
-This module hooks into the MUD's pulse system to regenerate vitality
-based on character attributes, position, and status.
+Regeneration is ticked by the mud itself (see mud.regenerator), over only
+the characters with a pool below max. This module sets the rates from
+character attributes and position, and hands players to the mud as they
+enter the game. Scripts hear about regeneration through the
+vitality_regenerated hook, run when a pool passes a quarter of the way to
+its max.
 
 Regeneration Rates:
 - Base rates calculated from attributes
@@ -29,12 +33,12 @@ except ImportError:
     mud.log_string("vitality_regen: Required modules not available")
 
 
-# Regeneration tick rate (in seconds)
-REGEN_TICK_RATE = 10  # Regenerate every 10 seconds
+# regen rates, remembered by the character until what they come from changes
+HP_REGEN     = mud.register_derived("hp_regen",     "stats")
+SP_REGEN     = mud.register_derived("sp_regen",     "stats")
+EP_REGEN     = mud.register_derived("ep_regen",     "stats")
+POSITION_MOD = mud.register_derived("position_mod", "position")
 
-# Flag to track if we've registered the hook
-_hook_registered = False
-_pulse_count = 0
 
 # Position modifiers for regeneration rates
 POSITION_MODIFIERS = {
@@ -65,12 +69,17 @@ def calculate_hp_regen_rate(ch):
         attr_aux = attribute_aux.get_attributes(ch)
         if not attr_aux:
             return 1.0
+        cached = ch.derived(HP_REGEN)
+        if cached is not None:
+            return cached
         
-        stamina = attr_aux.get_attribute("stamina")
-        discipline = attr_aux.get_attribute("discipline")
+        stamina = attr_aux.stamina
+        discipline = attr_aux.discipline
         
         base_regen = (stamina * 0.1) + (discipline * 0.05)
-        return max(0.1, base_regen)
+        base_regen = max(0.1, base_regen)
+        ch.set_derived(HP_REGEN, base_regen)
+        return base_regen
     except:
         return 1.0
 
@@ -93,12 +102,17 @@ def calculate_sp_regen_rate(ch):
         attr_aux = attribute_aux.get_attributes(ch)
         if not attr_aux:
             return 1.0
+        cached = ch.derived(SP_REGEN)
+        if cached is not None:
+            return cached
         
-        intelligence = attr_aux.get_attribute("intelligence")
-        wisdom = attr_aux.get_attribute("wisdom")
+        intelligence = attr_aux.intelligence
+        wisdom = attr_aux.wisdom
         
         base_regen = (intelligence * 0.15) + (wisdom * 0.1)
-        return max(0.1, base_regen)
+        base_regen = max(0.1, base_regen)
+        ch.set_derived(SP_REGEN, base_regen)
+        return base_regen
     except:
         return 1.0
 
@@ -121,12 +135,17 @@ def calculate_ep_regen_rate(ch):
         attr_aux = attribute_aux.get_attributes(ch)
         if not attr_aux:
             return 1.0
+        cached = ch.derived(EP_REGEN)
+        if cached is not None:
+            return cached
         
-        stamina = attr_aux.get_attribute("stamina")
-        discipline = attr_aux.get_attribute("discipline")
+        stamina = attr_aux.stamina
+        discipline = attr_aux.discipline
         
         base_regen = (stamina * 0.12) + (discipline * 0.08)
-        return max(0.1, base_regen)
+        base_regen = max(0.1, base_regen)
+        ch.set_derived(EP_REGEN, base_regen)
+        return base_regen
     except:
         return 1.0
 
@@ -142,23 +161,29 @@ def get_position_modifier(ch):
         float: Position modifier (0.0 to 2.0)
     """
     try:
-        position = ch.pos.lower()
-        
         # Check for death first
         vit_aux = vitality_core.get_vitality(ch)
         if vit_aux and vit_aux.is_dead:
             return POSITION_MODIFIERS["dead"]
         
+        mod = ch.derived(POSITION_MOD)
+        if mod is not None:
+            return mod
+        position = ch.pos.lower()
+        
         # Return position modifier or default to standing
-        return POSITION_MODIFIERS.get(position, POSITION_MODIFIERS["standing"])
+        mod = POSITION_MODIFIERS.get(position, POSITION_MODIFIERS["standing"])
+        ch.set_derived(POSITION_MOD, mod)
+        return mod
     except:
         return POSITION_MODIFIERS["standing"]
 
 
-def regenerate_vitality(ch):
+def update_regen_rates(ch):
     """
-    Regenerate HP, SP, and EP for a character.
-    Called by the pulse system every tick.
+    Set how much each of a character's pools regenerates a tick, from their
+    attributes. Called when they enter the game, and whenever their
+    attributes change.
     
     Args:
         ch: Character object
@@ -166,128 +191,74 @@ def regenerate_vitality(ch):
     if not MODULES_AVAILABLE:
         return
     
-    try:
-        vit_aux = vitality_core.get_vitality(ch)
-        if not vit_aux:
-            return
-        
-        # Don't regenerate if dead
-        if vit_aux.is_dead:
-            return
-        
-        # Get position modifier
-        position_mod = get_position_modifier(ch)
-        
-        # Calculate regeneration amounts
-        hp_regen = calculate_hp_regen_rate(ch) * position_mod
-        sp_regen = calculate_sp_regen_rate(ch) * position_mod
-        ep_regen = calculate_ep_regen_rate(ch) * position_mod
-        
-        # Apply regeneration
-        old_hp = vit_aux.hp
-        old_sp = vit_aux.sp
-        old_ep = vit_aux.ep
-        
-        vit_aux.hp = min(vit_aux.max_hp, vit_aux.hp + hp_regen)
-        vit_aux.sp = min(vit_aux.max_sp, vit_aux.sp + sp_regen)
-        vit_aux.ep = min(vit_aux.max_ep, vit_aux.ep + ep_regen)
-        
-        # Notify if significant regeneration occurred (for future feedback)
-        hp_gained = vit_aux.hp - old_hp
-        sp_gained = vit_aux.sp - old_sp
-        ep_gained = vit_aux.ep - old_ep
-        
-        # Hook: Allow other systems to react to regeneration
-        if hp_gained > 0 or sp_gained > 0 or ep_gained > 0:
-            hooks.run("vitality_regenerated", hooks.build_info("ch dbl dbl dbl", 
-                      (ch, hp_gained, sp_gained, ep_gained)))
-    
-    except Exception as e:
-        mud.log_string(f"Error regenerating vitality for character: {str(e)}")
+    vit_aux = vitality_core.get_vitality(ch)
+    if not vit_aux:
+        return
+    vit_aux.regen.set_rate("hp", calculate_hp_regen_rate(ch))
+    vit_aux.regen.set_rate("sp", calculate_sp_regen_rate(ch))
+    vit_aux.regen.set_rate("ep", calculate_ep_regen_rate(ch))
 
 
-def regenerate_all_characters():
-    """
-    Regenerate vitality for all active characters.
-    Called by the pulse system.
+def start_regen(ch):
     """
-    global _pulse_count, _hook_registered
+    Start a character regenerating. From then on, the mud ticks their pools
+    whenever one of them is below max, and they are alive.
     
-    _pulse_count += 1
-    
-    # Skip first 5 pulses to let world stabilize
-    if _pulse_count < 5:
+    Args:
+        ch: Character object
+    """
+    if not MODULES_AVAILABLE:
         return
     
-    # Register hook on first successful pulse
-    if not _hook_registered:
-        try:
-            _hook_registered = True
-            mud.log_string(f"Vitality: Regeneration activated on pulse {_pulse_count}")
-        except:
-            pass
-    
-    try:
-        char_list = mudsys.character_list()
-        
-        if char_list is None:
-            return
-        
-        if len(char_list) == 0:
-            return
-        
-        for idx in range(len(char_list)):
-            try:
-                ch = char_list[idx]
-            except:
-                continue
-            
-            if ch is None:
-                continue
-            
-            try:
-                if not hasattr(ch, 'is_npc'):
-                    continue
-                
-                if ch.is_npc:
-                    continue
-                
-                regenerate_vitality(ch)
-                
-            except Exception as e:
-                mud.log_string(f"Error regenerating character: {str(e)}")
-                continue
-    
-    except Exception as e:
-        mud.log_string(f"Error in regenerate_all_characters: {str(e)}")
+    vit_aux = vitality_core.get_vitality(ch)
+    if not vit_aux:
+        return
+    update_regen_rates(ch)
+    vit_aux.regen.owner = ch
 
 
-def pulse_hook(info):
+def regen_to_game_hook(info):
+    """Players regenerate while they are in the game."""
+    ch, = hooks.parse_info(info)
+    if ch is not None and not ch.is_npc:
+        start_regen(ch)
+
+
+def regen_threshold_hook(info):
     """
-    Hook function called by the MUD's pulse system.
-    
-    Args:
-        info: Pulse info (may be None or invalid during early startup)
+    A pool regenerated past a quarter of the way to its max. Other systems
+    listen for vitality_regenerated to react; it is run with the character,
+    the pool, and the fraction of its max it reached (0.25, 0.5, 0.75, 1.0).
     """
-    try:
-        regenerate_all_characters()
-    except Exception as e:
-        mud.log_string(f"CRITICAL ERROR in pulse_hook: {str(e)}")
-        import traceback
-        mud.log_string(traceback.format_exc())
+    ch, pool, fraction = hooks.parse_info(info)
+    if ch is not None and pool in vitality_core.VITALITY_POOLS:
+        hooks.run("vitality_regenerated", hooks.build_info("ch str dbl",
+                  (ch, pool, fraction)))
 
 
 def register_regen_pulse():
     """
-    Register the regeneration pulse with the MUD's hook system.
-    
-    TEMPORARILY DISABLED for debugging - the crash is happening during hook registration
+    Set up regeneration. The ticking itself is done by the mud, every
+    regen_seconds, over only the characters with a pool below max; this
+    tells it how positions change the rates, and hands it the players.
     """
     try:
-        # DISABLED: This is causing crashes during startup
-        # hooks.add("pulse", pulse_hook)
-        mud.log_string(f"Vitality regeneration TEMPORARILY DISABLED for debugging")
-        mud.log_string("(pulse hook registration skipped)")
+        # positions the mud doesn't have (e.g. resting, fighting) are only
+        # used for show_regen_info
+        for position, mod in POSITION_MODIFIERS.items():
+            try:
+                mud.regen_position_mod(position, mod)
+            except ValueError:
+                pass
+        
+        hooks.add("char_to_game",    regen_to_game_hook)
+        hooks.add("regen_threshold", regen_threshold_hook)
+        
+        # anyone already here, if we are being reloaded
+        for ch in mudsys.character_list():
+            if not ch.is_npc:
+                start_regen(ch)
+        mud.log_string("Vitality regeneration enabled")
     except Exception as e:
         mud.log_string(f"Failed to register regeneration pulse: {str(e)}")
         import traceback
@@ -13,6 +13,8 @@
 //
 //*****************************************************************************
 
+#include <crypt.h>
+
 #include "mud.h"
 #include "utils.h"
 #include "auxiliary.h"
@@ -24,6 +26,11 @@
 //*****************************************************************************
 // local datastructures, variables, defines, and functions
 //*****************************************************************************
+// passwords are hashed with sha512-crypt. Accounts made before then have the
+// old DES crypt hashes, salted with their account's name
+#define PASSWORD_PREFIX       "$6$"
+#define PASSWORD_SALT_LEN     16
+
 struct account_data {
   char          *name; // the name of our account
   char      *password; // our password to log on
@@ -126,6 +133,10 @@ void *accountGetAuxiliaryData(ACCOUNT_DATA *account, const char *data) {
   return auxiliaryGet(account->aux, data);
 }
 
+void *accountGetAuxiliarySlot(ACCOUNT_DATA *account, int slot) {
+  return auxiliaryGetSlot(account->aux, slot);
+}
+
 void accountSetPassword(ACCOUNT_DATA *account, const char *password) {
   if(account->password) free(account->password);
   account->password = strdupsafe(password);
@@ -143,3 +154,52 @@ void accountSetName(ACCOUNT_DATA *account, const char *name) {
 const char *accountGetName(ACCOUNT_DATA *account) {
   return account->name;
 }
+
+
+
+//*****************************************************************************
+// password hashing
+//*****************************************************************************
+char *passwordNewSetting(void) {
+  static const char *salt_chars = 
+    "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+  unsigned char salt[PASSWORD_SALT_LEN];
+  char setting[sizeof(PASSWORD_PREFIX) + PASSWORD_SALT_LEN + 1];
+  FILE *fl = fopen("/dev/urandom", "rb");
+  int    i = 0;
+
+  if(fl == NULL || fread(salt, 1, sizeof(salt), fl) != sizeof(salt))
+    for(i = 0; i < PASSWORD_SALT_LEN; i++)
+      salt[i] = rand_number(0, 255);
+  if(fl != NULL)
+    fclose(fl);
+
+  strcpy(setting, PASSWORD_PREFIX);
+  for(i = 0; i < PASSWORD_SALT_LEN; i++)
+    setting[strlen(PASSWORD_PREFIX) + i] = salt_chars[salt[i] % 64];
+  setting[strlen(PASSWORD_PREFIX) + i]     = '$';
+  setting[strlen(PASSWORD_PREFIX) + i + 1] = '\0';
+  return strdup(setting);
+}
+
+char *passwordHash(const char *password, const char *setting) {
+  struct crypt_data *data = calloc(1, sizeof(struct crypt_data));
+  const char        *hash = crypt_r(password, setting, data);
+  char               *ret = strdup(hash && *hash != '*' ? hash : "");
+  free(data);
+  return ret;
+}
+
+bool passwordMatches(const char *password, const char *hash,
+		     const char *name) {
+  if(hash == NULL || !*hash)
+    return FALSE;
+  char *tried = passwordHash(password, (passwordIsCurrent(hash) ? hash : name));
+  bool  match = (*tried && !strcmp(tried, hash));
+  free(tried);
+  return match;
+}
+
+bool passwordIsCurrent(const char *hash) {
+  return !strncmp(hash, PASSWORD_PREFIX, strlen(PASSWORD_PREFIX));
+}
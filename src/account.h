@@ -25,9 +25,25 @@ void            accountPutChar(ACCOUNT_DATA *account, const char *name);
 void         accountRemoveChar(ACCOUNT_DATA *account, const char *name);
 LIST          *accountGetChars(ACCOUNT_DATA *account);
 void  *accountGetAuxiliaryData(ACCOUNT_DATA *account, const char *data);
+void  *accountGetAuxiliarySlot(ACCOUNT_DATA *account, int slot);
 void        accountSetPassword(ACCOUNT_DATA *account, const char *password);
 const char *accountGetPassword(ACCOUNT_DATA *account);
 void            accountSetName(ACCOUNT_DATA *account, const char *name);
 const char     *accountGetName(ACCOUNT_DATA *account);
 
+//
+// hashing and checking passwords. Strong hashes are slow on purpose, so
+// everything but passwordNewSetting is safe to call off of the game thread
+// (see offload.h), and should be during logins. passwordNewSetting makes a
+// new random salt to hash a password with. passwordMatches checks a
+// password against an account's hash, old or new; the account's name is what
+// old hashes were salted with. passwordIsCurrent is whether a hash is the
+// kind we make now, or one that should be replaced next time the password is
+// known. The strings returned must be freed
+char        *passwordNewSetting(void);
+char              *passwordHash(const char *password, const char *setting);
+bool            passwordMatches(const char *password, const char *hash,
+				const char *name);
+bool          passwordIsCurrent(const char *hash);
+
 #endif // ACCOUNT_H
@@ -33,21 +33,60 @@
 #include "character.h"
 #include "action.h"
 #include "hooks.h"
+#include "shard.h"
 
 #ifdef MODULE_FACULTY
 #include "faculty/faculty.h"
 #endif
 
 typedef struct action_data ACTION_DATA;
+typedef struct actor_data   ACTOR_DATA;
+
+//
+// every character taking actions has a list of them in the actors map, so we
+// can find them again for is_acting and interrupt_action. The actions
+// themselves are also kept in a min-heap, ordered by the pulse they are due
+// to go off on, so pulsing actions only looks at the ones that are due, and
+// runs them in the order of their remaining delay. Characters who are not
+// acting cost nothing per pulse.
 MAP *actors = NULL;
+ACTION_DATA **actions = NULL;
+int       num_actions = 0;
+int      actions_size = 0;
+
+// how many pulses have gone by, and how many actions have been started
+long long action_pulse = 0;
+long long   action_seq = 0;
+
+//
+// finished actions are kept on a free list to be reused instead of going
+// back to malloc. Short args are kept inside of the action itself
+#define ACTION_ARG_INLINE      32
+#define MAX_FREE_ACTIONS     1024
+ACTION_DATA *free_actions = NULL;
+int      num_free_actions = 0;
+
+//
+// what a character in the actors map is doing. busy is all of the faculties
+// used by the character's actions OR'd together, so is_acting and
+// interrupt_action don't have to look at the actions themselves
+struct actor_data {
+  LIST   *actions;
+  bitvector_t busy;
+};
 
 struct action_data {
   void (*  on_complete)(void *ch, void *data, bitvector_t where, char *arg);
   void (* on_interrupt)(void *ch, void *data, bitvector_t where, char *arg);
   bitvector_t where; // which bodyparts are participating in the action?
-  int   delay;       // how much longer until the action is complete?
+  long long     due; // the pulse the action completes on
+  long long     seq; // when we were started, relative to other actions
+  int        heap_i; // where we are in the action heap
+  CHAR_DATA     *ch; // the character taking the action
   void *data;  // data for the action (e.g. spell data, char mining state)
   char *arg;   // an argument supplied to an action (e.g. the target of a kick)
+  char  arg_buf[ACTION_ARG_INLINE]; // where arg lives when it is short
+  ACTION_DATA *next_free; // the next action in the free list
 };
 
 
@@ -55,24 +94,53 @@ struct action_data {
 //*****************************************************************************
 // single action handling
 //*****************************************************************************
+
+//
+// copy an arg into the action's inline buffer if it fits, or onto the heap
+// if it doesn't
+char *action_arg_copy(char *buf, const char *arg) {
+  int len = (arg ? strlen(arg) : 0);
+  if(len >= ACTION_ARG_INLINE)
+    return strdup(arg);
+  if(len > 0)
+    memcpy(buf, arg, len);
+  buf[len] = '\0';
+  return buf;
+}
+
 ACTION_DATA *newAction(int delay, 	
 		       bitvector_t where,
 		       void *on_complete,
 		       void *on_interrupt,
 		       void *data, const char *arg) {
-  struct action_data *action = malloc(sizeof(ACTION_DATA));
+  ACTION_DATA *action = free_actions;
+  if(action != NULL) {
+    free_actions = action->next_free;
+    num_free_actions--;
+  }
+  else
+    action = malloc(sizeof(ACTION_DATA));
   action->on_complete  = on_complete;
   action->on_interrupt = on_interrupt;
-  action->delay        = delay;
+  action->due          = action_pulse + MAX(delay, 1);
+  action->seq          = action_seq++;
+  action->heap_i       = -1;
+  action->ch           = NULL;
   action->data         = data;
-  action->arg          = strdupsafe(arg);
+  action->arg          = action_arg_copy(action->arg_buf, arg);
   action->where        = where;
   return action;
 }
 
 void deleteAction(ACTION_DATA *action) {
-  if(action->arg) free(action->arg);
-  free(action);
+  if(action->arg != action->arg_buf) free(action->arg);
+  if(num_free_actions >= MAX_FREE_ACTIONS)
+    free(action);
+  else {
+    action->next_free = free_actions;
+    free_actions      = action;
+    num_free_actions++;
+  }
 }
 
 void run_action(void *ch, ACTION_DATA *action) {
@@ -99,6 +167,94 @@ void stop_actions_hook(const char *info) {
 
 
 
+//*****************************************************************************
+// the action heap
+//*****************************************************************************
+
+//
+// does action a complete before action b?
+bool action_before(ACTION_DATA *a, ACTION_DATA *b) {
+  return (a->due < b->due || (a->due == b->due && a->seq < b->seq));
+}
+
+void action_heap_set(int i, ACTION_DATA *action) {
+  actions[i]     = action;
+  action->heap_i = i;
+}
+
+void action_heap_up(int i) {
+  ACTION_DATA *action = actions[i];
+  while(i > 0 && action_before(action, actions[(i - 1) / 2])) {
+    action_heap_set(i, actions[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  action_heap_set(i, action);
+}
+
+void action_heap_down(int i) {
+  ACTION_DATA *action = actions[i];
+  for(;;) {
+    int child = i * 2 + 1;
+    if(child >= num_actions)
+      break;
+    if(child + 1 < num_actions && 
+       action_before(actions[child + 1], actions[child]))
+      child++;
+    if(!action_before(actions[child], action))
+      break;
+    action_heap_set(i, actions[child]);
+    i = child;
+  }
+  action_heap_set(i, action);
+}
+
+void action_heap_put(ACTION_DATA *action) {
+  if(num_actions >= actions_size) {
+    actions_size = MAX(actions_size * 2, 64);
+    actions      = realloc(actions, sizeof(ACTION_DATA *) * actions_size);
+  }
+  action_heap_set(num_actions++, action);
+  action_heap_up(num_actions - 1);
+}
+
+void action_heap_remove(ACTION_DATA *action) {
+  int i = action->heap_i;
+  action->heap_i = -1;
+  if(--num_actions == i)
+    return;
+  action_heap_set(i, actions[num_actions]);
+  action_heap_up(i);
+  action_heap_down(actions[i]->heap_i);
+}
+
+//
+// take the action off of its character's list, and out of the heap
+void action_detach(ACTION_DATA *action) {
+  ACTOR_DATA *actor = mapGet(actors, action->ch);
+  if(actor != NULL) {
+    listRemove(actor->actions, action);
+    if(listSize(actor->actions) == 0) {
+      mapRemove(actors, action->ch);
+      deleteList(actor->actions);
+      free(actor);
+    }
+    // actions can overlap if interrupt handlers start new ones, so figure
+    // out what we're still busy with from what's left
+    else {
+      LIST_ITERATOR *act_i = newListIterator(actor->actions);
+      ACTION_DATA     *act = NULL;
+      actor->busy = 0;
+      ITERATE_LIST(act, act_i) {
+	SET_BIT(actor->busy, act->where);
+      } deleteListIterator(act_i);
+    }
+  }
+  if(action->heap_i >= 0)
+    action_heap_remove(action);
+}
+
+
+
 //*****************************************************************************
 // actor list handling
 //*****************************************************************************
@@ -111,61 +267,33 @@ void init_actions() {
 }
 
 bool is_acting(void *ch, bitvector_t where) {
-  LIST *actions = mapGet(actors, ch);
-  if(actions == NULL || listSize(actions) == 0)
-    return FALSE;
-
-  bool action_found    = FALSE;
-  LIST_ITERATOR *act_i = newListIterator(actions);
-  ACTION_DATA  *action = NULL;
-
-  // iterate across all of our current actions and see if any
-  // involve the faculties of "where"
-  ITERATE_LIST(action, act_i) {
-    if(IS_SET(action->where, where)) {
-      action_found = TRUE;
-      break;
-    }
-  } deleteListIterator(act_i);
-
-  return action_found;
+  ACTOR_DATA *actor = mapGet(actors, ch);
+  return (actor != NULL && IS_SET(actor->busy, where));
 }
 
 void interrupt_action(void *ch, bitvector_t where) {
   // get the list of all the actions we're performing
-  LIST *actions = mapGet(actors, ch);
-  if(actions == NULL)
+  ACTOR_DATA *actor = mapGet(actors, ch);
+  if(actor == NULL || !IS_SET(actor->busy, where))
     return;
 
-  // if we have actions, go through and stop 'em all
-  if(listSize(actions) > 0) {
-    LIST_ITERATOR *act_i = newListIterator(actions);
-    ACTION_DATA *action  = NULL;
-
-    ITERATE_LIST(action, act_i) {
-      // check to see if we've found an action that needs interruption
-      if(IS_SET(action->where, where)) {
-	if(action->on_interrupt)
-	  action->on_interrupt(ch, action->data, action->where, action->arg);
-	listRemove(actions, action);
-	deleteAction(action);
-      }
-    } deleteListIterator(act_i);
-  }
+  // find everything that needs interrupting, and detach it before any
+  // interrupt handlers run; they might start or interrupt actions themselves
+  LIST   *interrupted = newList();
+  LIST_ITERATOR *act_i = newListIterator(actor->actions);
+  ACTION_DATA  *action = NULL;
+  ITERATE_LIST(action, act_i) {
+    if(IS_SET(action->where, where))
+      listQueue(interrupted, action);
+  } deleteListIterator(act_i);
 
-  // if all of the actions are gone, delete the list
-  if(listSize(actions) == 0) {
-    /*
-     * Nope! We can't do this. If we interrupt an action midway through
-     * processing actions and the list gets deleted, the iterator over it will
-     * blow up when we try to delete it. Instead, deletion will now occur when
-     * we try to process actions and realize there is nothing in the list to
-     * process.
-     *
-    mapRemove(actors, ch);
-    deleteList(actions);
-    */
+  while((action = listPop(interrupted)) != NULL) {
+    action_detach(action);
+    if(action->on_interrupt)
+      action->on_interrupt(ch, action->data, action->where, action->arg);
+    deleteAction(action);
   }
+  deleteList(interrupted);
 }
 
 void start_action(void           *ch, 
@@ -178,53 +306,39 @@ void start_action(void           *ch,
   interrupt_action(ch, where);
   ACTION_DATA *newact = newAction(delay, where, on_complete, 
 				  on_interrupt, data, arg);
-  // get the current list
-  LIST *curr_acts     = mapGet(actors, ch);
+  newact->ch          = ch;
+
+  // get what we're currently doing
+  ACTOR_DATA *actor   = mapGet(actors, ch);
   
   // if it's null, make a new one and add it to the map of actions
-  if(curr_acts == NULL) {
-    curr_acts = newList();
-    mapPut(actors, ch, curr_acts);
+  if(actor == NULL) {
+    actor          = malloc(sizeof(ACTOR_DATA));
+    actor->actions = newList();
+    actor->busy    = 0;
+    mapPut(actors, ch, actor);
   }
 
-  listPut(curr_acts, newact);
+  listPut(actor->actions, newact);
+  SET_BIT(actor->busy, where);
+  action_heap_put(newact);
+}
+
+int count_actions(void) {
+  return num_actions;
 }
 
 void pulse_actions(int time) {
-  MAP_ITERATOR    *ch_i = newMapIterator(actors);
-  ACTION_DATA   *action = NULL;
-  LIST_ITERATOR  *act_i = NULL;
-  LIST         *actions = NULL;
-  const CHAR_DATA *map_actor = NULL;
-  CHAR_DATA         *ch = NULL;
-
-  ITERATE_MAP(map_actor, actions, ch_i) {
-    actions = mapIteratorCurrentVal(ch_i);
-
-    // weird, we shouldn't be in here
-    if(listSize(actions) == 0) {
-      mapRemove(actors, map_actor);
-      deleteList(actions);
-    }
-    // if we have actions, then go through 'em all
-    else {
-      // eek... small problem. The key for maps is constant, but we need
-      // a non-constant character to send to run_action. Let's get the char's
-      // UID, and re-look him up in the player table
-      ch = propertyTableGet(mob_table, charGetUID(map_actor));
-
-      act_i = newListIterator(actions);
-
-      ITERATE_LIST(action, act_i) {
-	// decrement the delay
-	action->delay -= time;
-	// pop the action from the list, and run it
-	if(action->delay <= 0) {
-	  listRemove(actions, action);
-	  run_action(ch, action);
-	  deleteAction(action);
-	}
-      } deleteListIterator(act_i);
-    }
-  } deleteMapIterator(ch_i);
+  ACTION_DATA *action = NULL;
+  action_pulse += time;
+
+  // go through everything that's due, in the order it is due
+  while(num_actions > 0 && actions[0]->due <= action_pulse) {
+    action = actions[0];
+    action_detach(action);
+    shardBegin(charGetRoom(action->ch));
+    run_action(action->ch, action);
+    shardEnd();
+    deleteAction(action);
+  }
 }
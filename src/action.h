@@ -26,6 +26,12 @@ void init_actions();
 void pulse_actions(int time);
 
 
+//
+// how many actions are underway
+//
+int count_actions(void);
+
+
 //
 // Interrupt whatever action the character is taking. Do nothing if
 // the character is not taking an action currently. "where" is used
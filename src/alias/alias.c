@@ -28,12 +28,107 @@
 
 
 
+//*****************************************************************************
+// compiled aliases
+//*****************************************************************************
+
+// the kinds of pieces an alias is made of
+#define ALIAS_TEXT           0  // text that is used as-is
+#define ALIAS_ARG            1  // $1 through $9, one word of the argument
+#define ALIAS_ALL_ARGS       2  // $*, the whole argument
+
+typedef struct {
+  int     type;
+  int    start; // where our text starts in the alias, for ALIAS_TEXT
+  int      len;
+  int      num; // which word of the argument, for ALIAS_ARG
+} ALIAS_PART;
+
+//
+// an alias, split into its text and the places its argument goes, when it is
+// set. Expanding it is then just a matter of putting the pieces together
+typedef struct {
+  char        *text;
+  ALIAS_PART *parts;
+  int     num_parts;
+  bool     embedded; // might we have [embedded aliases] to expand?
+} ALIAS;
+
+void alias_add_part(ALIAS *alias, int type, int start, int len, int num) {
+  if(type == ALIAS_TEXT && len == 0)
+    return;
+  alias->parts = realloc(alias->parts, sizeof(ALIAS_PART)*(alias->num_parts+1));
+  ALIAS_PART *part = &alias->parts[alias->num_parts++];
+  part->type  = type;
+  part->start = start;
+  part->len   = len;
+  part->num   = num;
+}
+
+ALIAS *newAlias(const char *text) {
+  ALIAS *alias     = calloc(1, sizeof(ALIAS));
+  alias->text      = strdup(text);
+  int start = 0, i;
+  for(i = 0; text[i] != '\0'; i++) {
+    if(text[i] != '$' || !(text[i+1] == '*' || isdigit(text[i+1])) || 
+       text[i+1] == '0')
+      continue;
+    alias_add_part(alias, ALIAS_TEXT, start, i - start, 0);
+    if(text[i+1] == '*')
+      alias_add_part(alias, ALIAS_ALL_ARGS, 0, 0, 0);
+    else
+      alias_add_part(alias, ALIAS_ARG, 0, 0, text[i+1] - '0');
+    start = i + 2;
+    i++;
+  }
+  alias_add_part(alias, ALIAS_TEXT, start, i - start, 0);
+
+  // arguments can bring embedded aliases in with them, so we only know we
+  // have none if we have no brackets and take no arguments
+  alias->embedded = (strchr(text, '[') != NULL);
+  for(i = 0; i < alias->num_parts; i++)
+    if(alias->parts[i].type != ALIAS_TEXT)
+      alias->embedded = TRUE;
+  return alias;
+}
+
+void deleteAlias(ALIAS *alias) {
+  free(alias->text);
+  if(alias->parts)
+    free(alias->parts);
+  free(alias);
+}
+
+//
+// put the alias's pieces together with the argument it was given
+void alias_fill(ALIAS *alias, const char *arg, BUFFER *buf) {
+  char one_arg[SMALL_BUFFER];
+  int i;
+  for(i = 0; i < alias->num_parts; i++) {
+    ALIAS_PART *part = &alias->parts[i];
+    switch(part->type) {
+    case ALIAS_TEXT:
+      bufferCatLen(buf, alias->text + part->start, part->len);
+      break;
+    case ALIAS_ARG:
+      arg_num(arg, one_arg, part->num);
+      bufferCat(buf, one_arg);
+      break;
+    case ALIAS_ALL_ARGS:
+      bufferCat(buf, arg);
+      break;
+    }
+  }
+}
+
+
+
 //*****************************************************************************
 // auxiliary data
 //*****************************************************************************
 typedef struct alias_aux_data {
-  HASHTABLE *aliases;
-  int    alias_queue;
+  HASHTABLE *aliases;    // name -> ALIAS
+  int      expanding;    // are we running the first command of an alias?
 } ALIAS_AUX_DATA;
 
 
@@ -53,14 +148,7 @@ newAliasAuxData() {
 void
 deleteAliasAuxData(ALIAS_AUX_DATA *data) {
   if(data->aliases) {
-    HASH_ITERATOR *hash_i = newHashIterator(data->aliases);
-    const char     *alias = NULL;
-    char             *cmd = NULL;
-
-    ITERATE_HASH(alias, cmd, hash_i) 
-      free(cmd);
-    deleteHashIterator(hash_i);
-    deleteHashtable(data->aliases);
+    deleteHashtableWith(data->aliases, deleteAlias);
   }
   free(data);
 }
@@ -93,13 +181,13 @@ STORAGE_SET *aliasAuxDataStore(ALIAS_AUX_DATA *data) {
   STORAGE_SET_LIST *list = new_storage_list();
   HASH_ITERATOR  *hash_i = newHashIterator(data->aliases);
   const char       *name = NULL;
-  const char        *cmd = NULL;
+  ALIAS           *alias = NULL;
 
   store_list(set, "aliases", list);
-  ITERATE_HASH(name, cmd, hash_i) {
+  ITERATE_HASH(name, alias, hash_i) {
     STORAGE_SET *alias_set = new_storage_set();
     store_string(alias_set, "key", name);
-    store_string(alias_set, "val", hashIteratorCurrentVal(hash_i));
+    store_string(alias_set, "val", alias->text);
     storage_list_put(list, alias_set);
   }
   deleteHashIterator(hash_i);
@@ -119,7 +207,7 @@ ALIAS_AUX_DATA *aliasAuxDataRead(STORAGE_SET *set) {
 
   while( (var = storage_list_next(list)) != NULL)
     hashPut(data->aliases, read_string(var, "key"), 
-	    strdup(read_string(var, "val")));
+	    newAlias(read_string(var, "val")));
   return data;
 }
 
@@ -135,11 +223,18 @@ LIST *charGetAliases(CHAR_DATA *ch) {
   return hashCollect(data->aliases);
 }
 
-const char *charGetAlias(CHAR_DATA *ch, const char *alias) {
+//
+// the compiled form of one of the character's aliases, or NULL
+ALIAS *char_get_alias(CHAR_DATA *ch, const char *name) {
   ALIAS_AUX_DATA *data = charGetAuxiliaryData(ch, "alias_aux_data");
   if(data->aliases == NULL)
     return NULL;
-  return hashGet(data->aliases, alias);
+  return hashGet(data->aliases, name);
+}
+
+const char *charGetAlias(CHAR_DATA *ch, const char *name) {
+  ALIAS *alias = char_get_alias(ch, name);
+  return (alias == NULL ? NULL : alias->text);
 }
 
 void charClearAliases(CHAR_DATA *ch) {
@@ -159,54 +254,54 @@ void charSetAlias(CHAR_DATA *ch, const char *alias, const char *cmd){
     data->aliases = newHashtable();
 
   // pull out the last one
-  char *oldcmd = hashRemove(data->aliases, alias);
+  ALIAS *old = hashRemove(data->aliases, alias);
 
-  if(oldcmd != NULL)
-    free(oldcmd);
+  if(old != NULL)
+    deleteAlias(old);
 
   // put in the new one if it exists
   if(cmd && *cmd) {
-    hashPut(data->aliases, alias, strdup(cmd));
+    hashPut(data->aliases, alias, newAlias(cmd));
   }
 }
 
-int charGetAliasesQueued(CHAR_DATA *ch) {
-  ALIAS_AUX_DATA *data = charGetAuxiliaryData(ch, "alias_aux_data");
-  return data->alias_queue;
-}
-
-void charSetAliasesQueued(CHAR_DATA *ch, int amnt) {
-  ALIAS_AUX_DATA *data = charGetAuxiliaryData(ch, "alias_aux_data");
-  data->alias_queue = amnt;
-}
-
-BUFFER *expand_alias(CHAR_DATA *ch, const char *alias, const char *arg) {
+BUFFER *expand_alias(CHAR_DATA *ch, ALIAS *format, const char *arg) {
   static int func_depth      = 0;
   static int MAX_ALIAS_DEPTH = 10;
   BUFFER *cmd = newBuffer(SMALL_BUFFER);
+
   func_depth++;
+  if(func_depth > MAX_ALIAS_DEPTH) {
+    func_depth--;
+    return cmd;
+  }
 
-  BUFFER *filled_alias = newBuffer(SMALL_BUFFER);
-  bufferCat(filled_alias, alias);
-  // now, replace all of our parameters 
-  int i;
-  for(i = 1; i < 10; i++) {
-    char param[3];
-    char one_arg[SMALL_BUFFER];
-    sprintf(param, "$%d", i);
-    arg_num(arg, one_arg, i);
-    bufferReplace(filled_alias, param, one_arg, TRUE);
+  // nothing to put in, and nothing embedded in us? Then we are our own
+  // expansion
+  if(!format->embedded) {
+    bufferCat(cmd, format->text);
+    func_depth--;
+    return cmd;
   }
 
-  // then we replace the wildcard
-  bufferReplace(filled_alias, "$*", arg, TRUE);
-  alias = bufferString(filled_alias);
+  BUFFER *filled_alias = newBuffer(SMALL_BUFFER);
+  alias_fill(format, arg, filled_alias);
+  const char *alias = bufferString(filled_alias);
+  int i;
 
-  if(func_depth <= MAX_ALIAS_DEPTH) {
+  // no brackets after filling it in? We're done
+  if(!strchr(alias, '['))
+    bufferCat(cmd, alias);
+  else {
     for(i = 0; alias[i] != '\0'; i++) {
       // do we have an embedded alias or not?
-      if(alias[i] != '[')
-	bprintf(cmd, "%c", alias[i]);
+      if(alias[i] != '[') {
+	int len = next_letter_in(alias + i, '[');
+	if(len == -1)
+	  len = strlen(alias + i);
+	bufferCatLen(cmd, alias + i, len);
+	i += len - 1;
+      }
 
       else {
 	// figure out the start and end of the embedded alias
@@ -226,11 +321,11 @@ BUFFER *expand_alias(CHAR_DATA *ch, const char *alias, const char *arg) {
 	  newstring[i-start-2] = '\0';
 	  char newcmd[SMALL_BUFFER];
 	  char *newarg = one_arg(newstring, newcmd);
-	  const char *format = charGetAlias(ch, newcmd);
+	  ALIAS *embedded = char_get_alias(ch, newcmd);
 	  
 	  // do we have a format? if so, expand the new alias and cat it in
-	  if(format != NULL) {
-	    BUFFER *newbuf = expand_alias(ch, format, newarg);
+	  if(embedded != NULL) {
+	    BUFFER *newbuf = expand_alias(ch, embedded, newarg);
 	    bufferCat(cmd, bufferString(newbuf));
 	    deleteBuffer(newbuf);
 	  }
@@ -272,7 +367,7 @@ COMMAND(cmd_alias) {
       const char        *key = NULL;
 
       ITERATE_LIST(key, key_i) {
-	send_to_char(ch, "  %-20s %s\r\n", key, (char *)hashGet(data->aliases, key));
+	send_to_char(ch, "  %-20s %s\r\n", key, charGetAlias(ch, key));
       } deleteListIterator(key_i);
       deleteListWith(keys, free);
     }
@@ -395,21 +490,20 @@ bool try_alias(CHAR_DATA *ch, char *command, char *arg) {
   // is this command from an alias that executes multi commands?
   // if it is, don't let it trigger any further aliases, or else we might
   // get stuck in an infinite loop
-  bool    aliases_ok = TRUE;
-  int aliases_queued = charGetAliasesQueued(ch);
-  if(aliases_queued > 0) {
+  ALIAS_AUX_DATA *data = charGetAuxiliaryData(ch, "alias_aux_data");
+  if(charGetSocket(ch) && socketCmdIsExpanded(charGetSocket(ch))) {
     // this command came from an alias. ergo, there is going to be no echo
     // of the command. send the socket a newline so we don't print on the
     // person's prompt
     send_to_char(ch, "\r\n");
-    aliases_ok = FALSE;
+    return FALSE;
   }
 
   // make sure it didn't come from another alias
-  if(!aliases_ok)
+  if(data->expanding > 0)
     return FALSE;
   else {
-    const char *alias = charGetAlias(ch, command);
+    ALIAS *alias = char_get_alias(ch, command);
     // see if the alias exists
     if(alias == NULL)
       return FALSE;
@@ -419,17 +513,15 @@ bool try_alias(CHAR_DATA *ch, char *command, char *arg) {
       LIST      *cmds = parse_strings(bufferString(buf), ';');
       char     *first = listPop(cmds);
       
-      // queue all of our commands after the first onto the command list
-      if(charGetSocket(ch) && listSize(cmds) > 0) {
-	LIST_ITERATOR *cmd_i = newListIterator(cmds);
-	char            *cmd = NULL;
-	ITERATE_LIST(cmd, cmd_i) {
-	  socketQueueCommand(charGetSocket(ch), cmd);
-	} deleteListIterator(cmd_i);
-	charSetAliasesQueued(ch, listSize(cmds) + 1);
-      }
-      if(first != NULL)
+      // queue all of our commands after the first onto the command list, in
+      // one go. They're run one per pulse, like anything else that's typed
+      if(charGetSocket(ch) && listSize(cmds) > 0)
+	socketQueueExpansion(charGetSocket(ch), cmds);
+      if(first != NULL) {
+	data->expanding++;
 	do_cmd(ch, first, FALSE);
+	data->expanding--;
+      }
 
       deleteListWith(cmds, free);
       if(first) free(first);
@@ -24,11 +24,6 @@ void init_aliases();
 // case, the function calling this one should terminate
 bool try_alias(CHAR_DATA *ch, char *command, char *arg);
 
-//
-// for use by socket.c to see if we need to do anything special w/ aliases
-int charGetAliasesQueued(CHAR_DATA *ch);
-void charSetAliasesQueued(CHAR_DATA *ch, int amnt);
-
 //
 // access aliases the character has. Returned lists and contents must be
 // deleted after used.
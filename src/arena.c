@@ -0,0 +1,169 @@
+//*****************************************************************************
+//
+// arena.c
+//
+// a bump allocator for short-lived temporaries. See arena.h for details
+//
+//*****************************************************************************
+
+#include <stdlib.h>
+#include <string.h>
+#include "mud.h"
+#include "utils.h"
+#include "arena.h"
+
+
+
+//*****************************************************************************
+// local datastructures, functions, and variables
+//*****************************************************************************
+
+// how big are the scratch arena's blocks?
+#define SCRATCH_BLOCK_SIZE      (64 * 1024)
+
+// everything we hand out is aligned to this
+#define ARENA_ALIGN             16
+
+typedef struct arena_block {
+  struct arena_block *next; // the block after us. Unused if we're current
+  int                 size; // how much room we have
+  int                 used; // how much of it is used
+  long double        align; // makes sure data is aligned
+  char              data[];
+} ARENA_BLOCK;
+
+struct arena {
+  ARENA_BLOCK *first; // our oldest block
+  ARENA_BLOCK  *curr; // the block we are allocating from
+  int    block_size;
+  int          used;  // how many bytes are allocated
+  int          peak;  // the most bytes that have been allocated at once
+};
+
+ARENA *scratch = NULL;
+
+ARENA_BLOCK *newArenaBlock(int size) {
+  ARENA_BLOCK *block = malloc(sizeof(ARENA_BLOCK) + size);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+//
+// blocks past the current one are kept around so we don't have to keep
+// asking for memory, but only if they are the normal size. Anything bigger
+// was made for one large allocation, and is let go of
+void arena_trim(ARENA *arena) {
+  ARENA_BLOCK **link = &arena->curr->next;
+  while(*link != NULL) {
+    ARENA_BLOCK *block = *link;
+    if(block->size > arena->block_size) {
+      *link = block->next;
+      free(block);
+    }
+    else
+      link = &block->next;
+  }
+}
+
+
+
+//*****************************************************************************
+// implementation of arena.h
+//*****************************************************************************
+ARENA *newArena(int block_size) {
+  ARENA *arena      = malloc(sizeof(ARENA));
+  arena->block_size = block_size;
+  arena->first      = newArenaBlock(block_size);
+  arena->curr       = arena->first;
+  arena->used       = 0;
+  arena->peak       = 0;
+  return arena;
+}
+
+void deleteArena(ARENA *arena) {
+  while(arena->first != NULL) {
+    ARENA_BLOCK *next = arena->first->next;
+    free(arena->first);
+    arena->first = next;
+  }
+  free(arena);
+}
+
+void *arenaAlloc(ARENA *arena, int size) {
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  // do we need to move on to a new block?
+  if(arena->curr->used + size > arena->curr->size) {
+    ARENA_BLOCK *next = arena->curr->next;
+    // we have a spare block we can use
+    if(next != NULL && next->size >= size)
+      next->used = 0;
+    // make a new one, just big enough for us if we're oversized
+    else {
+      next       = newArenaBlock(MAX(size, arena->block_size));
+      next->next = arena->curr->next;
+      arena->curr->next = next;
+    }
+    arena->curr = next;
+  }
+
+  void *ptr = arena->curr->data + arena->curr->used;
+  arena->curr->used += size;
+  arena->used       += size;
+  if(arena->used > arena->peak)
+    arena->peak = arena->used;
+  return ptr;
+}
+
+void *arenaCalloc(ARENA *arena, int size) {
+  return memset(arenaAlloc(arena, size), 0, size);
+}
+
+char *arenaStrndup(ARENA *arena, const char *str, int len) {
+  char *copy = arenaAlloc(arena, len + 1);
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+char *arenaStrdup(ARENA *arena, const char *str) {
+  return arenaStrndup(arena, str, strlen(str));
+}
+
+ARENA_MARK arenaMark(ARENA *arena) {
+  ARENA_MARK mark;
+  mark.block = arena->curr;
+  mark.used  = arena->curr->used;
+  mark.total = arena->used;
+  return mark;
+}
+
+void arenaRelease(ARENA *arena, ARENA_MARK mark) {
+  arena->curr       = mark.block;
+  arena->curr->used = mark.used;
+  arena->used       = mark.total;
+  arena_trim(arena);
+}
+
+void arenaReset(ARENA *arena) {
+  arena->curr       = arena->first;
+  arena->curr->used = 0;
+  arena->used       = 0;
+  arena_trim(arena);
+}
+
+int arenaUsed(ARENA *arena) {
+  return arena->used;
+}
+
+int arenaPeak(ARENA *arena) {
+  return arena->peak;
+}
+
+ARENA *scratch_arena(void) {
+  if(scratch == NULL)
+    scratch = newArena(SCRATCH_BLOCK_SIZE);
+  return scratch;
+}
@@ -0,0 +1,74 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+//*****************************************************************************
+//
+// arena.h
+//
+// a bump allocator for short-lived temporaries. Allocations are carved off
+// the end of a big block of memory, and are never freed on their own.
+// Instead, a mark is taken before the temporaries are made, and when they
+// are no longer needed, everything allocated since the mark is released at
+// once. Marks nest, so something that uses the arena can call something
+// else that uses it too.
+//
+// The mud keeps one scratch arena for the temporaries made while handling
+// one command, parsing its arguments, parsing hook info, and the like.
+// Anything allocated from it must not outlive the mark it was made under:
+//
+//   ARENA_MARK mark = arenaMark(scratch_arena());
+//   LIST *tables = newListArena(scratch_arena());
+//   ...
+//   arenaRelease(scratch_arena(), mark);
+//
+//*****************************************************************************
+
+typedef struct arena        ARENA;
+typedef struct arena_mark   ARENA_MARK;
+
+//
+// laid out here so marks can be kept on the stack. Don't touch the fields
+struct arena_mark {
+  struct arena_block *block; // the block we were allocating from
+  int                   used; // how much of it had been used
+  int                  total; // how much of the whole arena had been used
+};
+
+//
+// create and delete an arena. The block size is how big the chunks of memory
+// it allocates are; anything bigger than that gets its own chunk
+ARENA *newArena(int block_size);
+void deleteArena(ARENA *arena);
+
+//
+// allocate memory from the arena. arenaCalloc zeroes it out first
+void *arenaAlloc (ARENA *arena, int size);
+void *arenaCalloc(ARENA *arena, int size);
+
+//
+// make a copy of a string (or the first len characters of a string)
+// in the arena
+char *arenaStrdup (ARENA *arena, const char *str);
+char *arenaStrndup(ARENA *arena, const char *str, int len);
+
+//
+// take a mark of the arena's current position, and release everything
+// allocated since the mark was taken. Marks must be released in the
+// opposite order they were taken in
+ARENA_MARK arenaMark   (ARENA *arena);
+void       arenaRelease(ARENA *arena, ARENA_MARK mark);
+
+//
+// release everything in the arena
+void arenaReset(ARENA *arena);
+
+//
+// how many bytes are currently allocated from the arena, and the most that
+// have been allocated from it at once
+int arenaUsed(ARENA *arena);
+int arenaPeak(ARENA *arena);
+
+//
+// the mud's scratch arena, for per-command temporaries
+ARENA *scratch_arena(void);
+
+#endif // __ARENA_H
@@ -26,9 +26,34 @@
 //*****************************************************************************
 
 //
-// the function sets used for loading and saving 
-// auxiliary functions on our datatypes
-HASHTABLE *auxiliary_manip_funcs = NULL;
+// every installed auxiliary has its own slot, numbered from 0 in the order
+// they were installed. An auxiliary that's uninstalled keeps its slot, in case
+// it is ever installed again (Python modules are reloaded, for instance)
+typedef struct {
+  char            *name;
+  AUXILIARY_FUNCS *funcs;
+} AUX_SLOT;
+
+AUX_SLOT     *aux_slots = NULL;
+int       num_aux_slots = 0;
+int      aux_slots_size = 0;
+
+//
+// the slot for each name, plus one (so no slot is ever NULL)
+HASHTABLE *aux_slot_table = NULL;
+
+//
+// entities keep their auxiliary data by slot. Nothing is made until it is
+// first asked for, and a table has no array at all until then. After that,
+// its array has room for every slot there was at the time, or up to the
+// highest slot that has data put in it since. Data that was read in is kept
+// as the set it was stored as, and only read when it's first asked for
+struct auxiliary_table {
+  bitvector_t aux_type;  // what kind of entity we're on
+  int             size;
+  void          **data;
+  STORAGE_SET    **raw;  // sets to read each slot from, if it hasn't been
+};
 
 struct auxiliary_functions {
   bitvector_t aux_type;
@@ -39,8 +64,112 @@ struct auxiliary_functions {
   void        *(*  copy)(void *data);
   STORAGE_SET *(* store)(void *data);
   void        *(*  read)(STORAGE_SET *set);
+  bool           eager;  // read when the entity is, instead of when needed
 };
 
+//
+// make a new instance of the auxiliary data in a slot
+void *aux_slot_new(int slot) {
+  AUXILIARY_FUNCS *funcs = aux_slots[slot].funcs;
+  // are we dealing with python data or not?
+  if(!funcs->is_py)
+    return funcs->new();
+  else {
+    // recast the new function
+    void *(* new)(const char *) = (void *)funcs->new;
+    return new(aux_slots[slot].name);
+  }
+}
+
+//
+// read a slot's data in from the set it was stored as
+void *aux_slot_read(int slot, STORAGE_SET *set) {
+  AUXILIARY_FUNCS *funcs = aux_slots[slot].funcs;
+  // are we dealing with python data or not?
+  if(!funcs->is_py)
+    return funcs->read(set);
+  else {
+    // recast the read function
+    void *(* read)(const char *, STORAGE_SET *) = (void *)funcs->read;
+    return read(aux_slots[slot].name, set);
+  }
+}
+
+//
+// make an empty table for the type of entity
+AUX_TABLE *newAuxTable(bitvector_t aux_type) {
+  AUX_TABLE *table = malloc(sizeof(AUX_TABLE));
+  table->aux_type  = aux_type;
+  table->size      = 0;
+  table->data      = NULL;
+  table->raw       = NULL;
+  return table;
+}
+
+//
+// make sure a table has room for a slot
+void aux_table_grow(AUX_TABLE *table, int slot) {
+  if(slot >= table->size) {
+    int size    = MAX(slot + 1, num_aux_slots);
+    table->data = realloc(table->data, sizeof(void *) * size);
+    table->raw  = realloc(table->raw,  sizeof(STORAGE_SET *) * size);
+    memset(table->data + table->size, 0, 
+	   sizeof(void *) * (size - table->size));
+    memset(table->raw + table->size, 0, 
+	   sizeof(STORAGE_SET *) * (size - table->size));
+    table->size = size;
+  }
+}
+
+//
+// put data in one of a table's slots, growing the table if it's too short
+void aux_table_put(AUX_TABLE *table, int slot, void *data) {
+  aux_table_grow(table, slot);
+  table->data[slot] = data;
+}
+
+//
+// keep the set a slot's data was stored as, to read it from when it's needed
+void aux_table_put_raw(AUX_TABLE *table, int slot, STORAGE_SET *set) {
+  aux_table_grow(table, slot);
+  if(table->raw[slot] != NULL)
+    storage_close(table->raw[slot]);
+  table->raw[slot] = set;
+}
+
+//
+// if a slot hasn't been read in from its set yet, do so now. Does nothing if
+// we've since been uninstalled; the set is kept until we're installed again
+void aux_table_hydrate(AUX_TABLE *table, int slot) {
+  if(slot >= table->size || table->raw[slot] == NULL ||
+     aux_slots[slot].funcs == NULL)
+    return;
+  STORAGE_SET *set = table->raw[slot];
+  table->raw[slot] = NULL;
+  if(table->data[slot] == NULL)
+    table->data[slot] = aux_slot_read(slot, set);
+  storage_close(set);
+}
+
+//
+// delete everything that's in a table's slots, but leave the table
+void aux_table_clear(AUX_TABLE *table) {
+  int slot;
+  for(slot = 0; slot < table->size; slot++) {
+    if(table->data[slot] == NULL)
+      continue;
+    // if we've been uninstalled, there's nothing we can delete with
+    if(aux_slots[slot].funcs != NULL)
+      aux_slots[slot].funcs->delete(table->data[slot]);
+    table->data[slot] = NULL;
+  }
+  for(slot = 0; slot < table->size; slot++) {
+    if(table->raw[slot] != NULL)
+      storage_close(table->raw[slot]);
+    table->raw[slot] = NULL;
+  }
+}
+
 
 
 //*****************************************************************************
@@ -51,7 +180,7 @@ struct auxiliary_functions {
 //*****************************************************************************
 
 void init_auxiliaries() {
-  auxiliary_manip_funcs = newHashtable();
+  aux_slot_table = newHashtable();
 }
 
 AUXILIARY_FUNCS *
@@ -59,6 +188,7 @@ newAuxiliaryFuncs(bitvector_t aux_type, void *new, void *delete,
 		  void *copyTo, void *copy, void *store, void *read) {
   AUXILIARY_FUNCS *newfuncs = malloc(sizeof(AUXILIARY_FUNCS));
   newfuncs->is_py    = FALSE;
+  newfuncs->eager    = FALSE;
   newfuncs->aux_type = aux_type;
   newfuncs->new      = new;
   newfuncs->delete   = delete;
@@ -78,168 +208,181 @@ void auxiliaryFuncSetIsPy(AUXILIARY_FUNCS *funcs, bool val) {
   funcs->is_py = val;
 }
 
-void
+void auxiliaryFuncSetEager(AUXILIARY_FUNCS *funcs, bool val) {
+  funcs->eager = val;
+}
+
+int
 auxiliariesInstall(const char *name, AUXILIARY_FUNCS *funcs) {
-  hashPut(auxiliary_manip_funcs, name, funcs);
+  int slot = auxiliariesGetSlot(name);
+  if(slot < 0) {
+    if(num_aux_slots == aux_slots_size) {
+      aux_slots_size = MAX(16, aux_slots_size * 2);
+      aux_slots      = realloc(aux_slots, sizeof(AUX_SLOT) * aux_slots_size);
+    }
+    slot = num_aux_slots++;
+    aux_slots[slot].name  = strdup(name);
+    aux_slots[slot].funcs = NULL;
+    hashPut(aux_slot_table, name, (void *)(long)(slot + 1));
+  }
+  // installing over top of something frees what was there before
+  else if(aux_slots[slot].funcs != NULL && aux_slots[slot].funcs != funcs)
+    deleteAuxiliaryFuncs(aux_slots[slot].funcs);
+  aux_slots[slot].funcs = funcs;
+  return slot;
 }
 
 
 void
 auxiliariesUninstall(const char *name) {
-  AUXILIARY_FUNCS *funcs = hashRemove(auxiliary_manip_funcs, name);
-  if(funcs != NULL)
-    deleteAuxiliaryFuncs(funcs);
+  int slot = auxiliariesGetSlot(name);
+  if(slot >= 0 && aux_slots[slot].funcs != NULL) {
+    deleteAuxiliaryFuncs(aux_slots[slot].funcs);
+    aux_slots[slot].funcs = NULL;
+  }
+}
+
+
+int
+auxiliariesGetSlot(const char *name) {
+  return (int)(long)hashGet(aux_slot_table, name) - 1;
 }
 
 
 AUXILIARY_FUNCS *
 auxiliariesGetFuncs(const char *name) {
-  return hashGet(auxiliary_manip_funcs, name);
+  int slot = auxiliariesGetSlot(name);
+  return (slot < 0 ? NULL : aux_slots[slot].funcs);
+}
+
+
+LIST *
+auxiliariesGetNames(void) {
+  LIST *names = newList();
+  int    slot;
+  for(slot = 0; slot < num_aux_slots; slot++)
+    if(aux_slots[slot].funcs != NULL)
+      listQueue(names, strdup(aux_slots[slot].name));
+  return names;
 }
 
 
 AUX_TABLE *
 newAuxiliaryData(bitvector_t aux_type) {
-  AUX_TABLE        *data = newHashtable();
-  HASH_ITERATOR  *hash_i = newHashIterator(auxiliary_manip_funcs);
-  AUXILIARY_FUNCS *funcs = NULL;
-  const char       *name = NULL;
-
-  ITERATE_HASH(name, funcs, hash_i) {
-    if(IS_SET(funcs->aux_type, aux_type)) {
-      // are we dealing with python data or not?
-      if(!funcs->is_py) 
-	hashPut(data, name, funcs->new());
-      else {
-	// recast the new function
-	void *(* new)(const char *) = (void *)funcs->new;
-	hashPut(data, name, new(name));
-      }
-    }
-  } deleteHashIterator(hash_i);
-  return data;
+  return newAuxTable(aux_type);
 }
 
 
 void
 auxiliaryEnsureDataComplete(AUX_TABLE *data, bitvector_t aux_type) {
-  HASH_ITERATOR  *hash_i = newHashIterator(auxiliary_manip_funcs);
-  AUXILIARY_FUNCS *funcs = NULL;
-  const char       *name = NULL;
-
-  ITERATE_HASH(name, funcs, hash_i) {
-    if(IS_SET(funcs->aux_type, aux_type) && !hashGet(data, name)) {
-      // are we dealing with python data or not?
-      if(!funcs->is_py) 
-	hashPut(data, name, funcs->new());
-      else {
-	// recast the new function
-	void *(* new)(const char *) = (void *)funcs->new;
-	hashPut(data, name, new(name));
-      }
-    }
-  } deleteHashIterator(hash_i);
+  int slot;
+  for(slot = 0; slot < num_aux_slots; slot++) {
+    AUXILIARY_FUNCS *funcs = aux_slots[slot].funcs;
+    if(funcs == NULL || !IS_SET(funcs->aux_type, aux_type))
+      continue;
+    aux_table_hydrate(data, slot);
+    if(slot >= data->size || data->data[slot] == NULL)
+      aux_table_put(data, slot, aux_slot_new(slot));
+  }
 }
 
 
 void
 deleteAuxiliaryData(AUX_TABLE *data) {
-  // go across all of the data in the hashtable, and delete it
-  AUXILIARY_FUNCS *funcs  = NULL;
-  HASH_ITERATOR   *hash_i = newHashIterator(data);
-  void            *entry  = NULL;
-  const char      *name   = NULL;
-
-  ITERATE_HASH(name, entry, hash_i) {
-    funcs = auxiliariesGetFuncs(name);
-    funcs->delete(entry);
-  } deleteHashIterator(hash_i);
-  deleteHashtable(data);
+  aux_table_clear(data);
+  if(data->data != NULL)
+    free(data->data);
+  if(data->raw != NULL)
+    free(data->raw);
+  free(data);
 }
 
 
 STORAGE_SET *
 auxiliaryDataStore(AUX_TABLE *data) {
   STORAGE_SET *set = new_storage_set();
-  AUXILIARY_FUNCS *funcs  = NULL;
-  HASH_ITERATOR   *hash_i = newHashIterator(data);
-  void            *entry  = NULL;
-  const char      *name   = NULL;
-
-  ITERATE_HASH(name, entry, hash_i) {
-    funcs = auxiliariesGetFuncs(name);
-    if(funcs->store) 
-      store_set(set, name, funcs->store(entry));
-  } deleteHashIterator(hash_i);
+  int         slot;
+  for(slot = 0; slot < data->size; slot++) {
+    AUXILIARY_FUNCS *funcs = aux_slots[slot].funcs;
+    if(funcs == NULL || funcs->store == NULL)
+      continue;
+    // anything never asked for is stored just as it was read
+    if(data->data[slot] != NULL)
+      store_set(set, aux_slots[slot].name, funcs->store(data->data[slot]));
+    else if(data->raw[slot] != NULL)
+      store_set(set, aux_slots[slot].name, storage_set_copy(data->raw[slot]));
+  }
   return set;
 }
 
 
 AUX_TABLE *
 auxiliaryDataRead(STORAGE_SET *set, bitvector_t aux_type) {
-  AUX_TABLE       *data = newHashtable();
-  HASH_ITERATOR  *hash_i = newHashIterator(auxiliary_manip_funcs);
-  AUXILIARY_FUNCS *funcs = NULL;
-  const char       *name = NULL;
-
-  ITERATE_HASH(name, funcs, hash_i) {
-    if(!IS_SET(funcs->aux_type, aux_type))
+  AUX_TABLE *data = newAuxTable(aux_type);
+  int        slot;
+  for(slot = 0; slot < num_aux_slots; slot++) {
+    AUXILIARY_FUNCS *funcs = aux_slots[slot].funcs;
+    const char       *name = aux_slots[slot].name;
+    // anything that wasn't saved is made when it's first asked for, like it
+    // would be for a new entity
+    if(funcs == NULL || !IS_SET(funcs->aux_type, aux_type) ||
+       funcs->read == NULL || !storage_contains(set, name))
       continue;
-    // are we dealing with python data or not?
-    if(!funcs->is_py && funcs->read)
-      hashPut(data, name, funcs->read(read_set(set, name)));
-    else if(funcs->read) {
-      // recast the read function
-      void *(* read)(const char *, STORAGE_SET *) = (void *)funcs->read;
-      hashPut(data, name, read(name, read_set(set, name)));
-    }
-    // are we dealing with python data or not?
-    else if(!funcs->is_py) 
-      hashPut(data, name, funcs->new());
-    else {
-      // recast the new function
-      void *(* new)(const char *) = (void *)funcs->new;
-      hashPut(data, name, new(name));
-    }
-  } deleteHashIterator(hash_i);
+    // and anything that was is read when it's first asked for, too
+    if(funcs->eager)
+      aux_table_put(data, slot, aux_slot_read(slot, read_set(set, name)));
+    else
+      aux_table_put_raw(data, slot, storage_set_copy(read_set(set, name)));
+  }
   return data;
 }
 
 
 void
 auxiliaryDataCopyTo(AUX_TABLE *from, AUX_TABLE *to) {
-  AUXILIARY_FUNCS *funcs = NULL;
-  HASH_ITERATOR  *hash_i = NULL;
-  void            *entry = NULL;
-  const char       *name = NULL;
+  int slot;
 
   // first, delete all of the old data
-  if(hashSize(to) > 0) {
-    hash_i = newHashIterator(to);
-    ITERATE_HASH(name, entry, hash_i) {
-      funcs = auxiliariesGetFuncs(name);
-      funcs->delete(entry);
-    } deleteHashIterator(hash_i);
-  }
-
-  // now, copy in all of the new data
-  if(hashSize(from) > 0) {
-    hash_i = newHashIterator(from);
-    ITERATE_HASH(name, entry, hash_i) {
-      funcs = auxiliariesGetFuncs(name);
-      hashPut(to, name, funcs->copy(entry));
-    } deleteHashIterator(hash_i);
+  aux_table_clear(to);
+
+  // now, copy in all of the new data. Whatever hasn't been read in yet is
+  // copied as the set it'll be read from
+  for(slot = 0; slot < from->size; slot++) {
+    AUXILIARY_FUNCS *funcs = aux_slots[slot].funcs;
+    if(from->data[slot] != NULL && funcs != NULL)
+      aux_table_put(to, slot, funcs->copy(from->data[slot]));
+    else if(from->raw[slot] != NULL)
+      aux_table_put_raw(to, slot, storage_set_copy(from->raw[slot]));
   }
 }
 
 
 AUX_TABLE *
 auxiliaryDataCopy(AUX_TABLE *data) {
-  AUX_TABLE *newdata = newHashtableSize(hashSize(data));
+  AUX_TABLE *newdata = newAuxTable(data->aux_type);
   auxiliaryDataCopyTo(data, newdata);
   return newdata;
 }
 
 void *auxiliaryGet(AUX_TABLE *table, const char *key) {
-  return hashGet(table, key);
+  return auxiliaryGetSlot(table, auxiliariesGetSlot(key));
+}
+
+void *auxiliaryGetSlot(AUX_TABLE *table, int slot) {
+  if(slot < table->size && slot >= 0 && table->data[slot] != NULL)
+    return table->data[slot];
+  if(slot < 0 || slot >= num_aux_slots)
+    return NULL;
+
+  // read it in, or make it, the first time it's asked for, if it's
+  // something we should have
+  AUXILIARY_FUNCS *funcs = aux_slots[slot].funcs;
+  if(funcs == NULL || !IS_SET(funcs->aux_type, table->aux_type))
+    return NULL;
+  aux_table_hydrate(table, slot);
+  if(slot < table->size && table->data[slot] != NULL)
+    return table->data[slot];
+  void *data = aux_slot_new(slot);
+  aux_table_put(table, slot, data);
+  return data;
 }
@@ -23,8 +23,11 @@
 
 
 //
-// how do we store auxiliary data?
-typedef HASHTABLE AUX_TABLE;
+// how do we store auxiliary data? Every installed auxiliary is given a slot
+// number when it is installed, and an entity's data is kept in an array
+// indexed by slot. Looking data up by name costs a hash of the name first;
+// code that looks up the same data often should keep its slot and use that
+typedef struct auxiliary_table AUX_TABLE;
 
 
 //
@@ -85,6 +88,15 @@ newAuxiliaryFuncs(bitvector_t aux_type, void *newfunc, void *deleter,
 void auxiliaryFuncSetIsPy(AUXILIARY_FUNCS *funcs, bool val);
 
 
+//
+// Auxiliary data that has been stored is not read back in when its entity
+// is, but kept as the storage set it was stored as until it is first asked
+// for. Data whose read() function has to be called when its entity is read
+// (e.g. because it does something more than just read itself in) can be made
+// eager, and will be read along with everything else on the entity.
+void auxiliaryFuncSetEager(AUXILIARY_FUNCS *funcs, bool val);
+
+
 //
 // clear up memory used to hold the functions for handling auxiliary data
 //
@@ -96,8 +108,10 @@ deleteAuxiliaryFuncs(AUXILIARY_FUNCS *funcs);
 // install the functions used for handling auxiliary data. "name" should be
 // a unique tag for holding the auxiliary data in the datastructure and funcs 
 // should be the set of functions used to load/save the auxiliary data.
+// Returns the slot the data is kept in. A name always keeps the same slot,
+// even if it is uninstalled and installed again
 //
-void
+int
 auxiliariesInstall(const char *name, AUXILIARY_FUNCS *funcs);
 
 
@@ -105,7 +119,15 @@ auxiliariesInstall(const char *name, AUXILIARY_FUNCS *funcs);
 // remove the functions for manipulating the auxiliary data
 //
 void
-auxiliariesUnintall(const char *name);
+auxiliariesUninstall(const char *name);
+
+
+//
+// return the slot the named auxiliary data is kept in, or -1 if nothing by
+// that name was ever installed
+//
+int
+auxiliariesGetSlot(const char *name);
 
 
 //
@@ -117,15 +139,32 @@ auxiliariesGetFuncs(const char *name);
 
 
 //
-// Create a new hashtable of auxiliary data for the 
-// datatype specified in aux_type 
+// Return a list of the names of every installed auxiliary. The list and its
+// names must be freed after use. Try: deleteListWith(list, free)
+//
+LIST *
+auxiliariesGetNames(void);
+
+
+//
+// Create a new table of auxiliary data for the 
+// datatype specified in aux_type. The table starts empty; each piece of
+// auxiliary data is made the first time it is asked for
 //
 AUX_TABLE *
 newAuxiliaryData(bitvector_t aux_type);
 
 
 //
-// when a room/obj/char needs to be deleted, a hashtable with their auxiliary
+// make every piece of auxiliary data for the datatype that hasn't been made
+// yet, as if it had all been asked for
+//
+void
+auxiliaryEnsureDataComplete(AUX_TABLE *data, bitvector_t aux_type);
+
+
+//
+// when a room/obj/char needs to be deleted, a table with their auxiliary
 // data is passed into here and we handle it.
 //
 void
@@ -133,21 +172,24 @@ deleteAuxiliaryData(AUX_TABLE *data);
 
 
 //
-// Put all of the auxiliary data into a storage set
+// Put all of the auxiliary data into a storage set. Data that has never been
+// asked for is left out; it is made fresh when the set is read back in
 //
 STORAGE_SET *
 auxiliaryDataStore(AUX_TABLE *data);
 
 
 //
-// read the auxiliary data for a specified datatype in from the set
+// read the auxiliary data for a specified datatype in from the set. What
+// each piece of data was stored as is copied out of the set, to be read when
+// the data is first asked for (see auxiliaryFuncSetEager)
 //
 AUX_TABLE *
 auxiliaryDataRead(STORAGE_SET *set, bitvector_t aux_type);
 
 
 //
-// Copy the auxiliary data from one hashtable to another
+// Copy the auxiliary data from one table to another
 //
 void
 auxiliaryDataCopyTo(AUX_TABLE *from, AUX_TABLE *to);
@@ -161,7 +203,10 @@ auxiliaryDataCopy(AUX_TABLE *data);
 
 
 //
-// return data from the auxiliary table
+// return data from the auxiliary table, by name or by slot, making it if this
+// is the first time it's been asked for. NULL if no such auxiliary data is
+// installed for the table's datatype
 void *auxiliaryGet(AUX_TABLE *table, const char *key);
+void *auxiliaryGetSlot(AUX_TABLE *table, int slot);
 
 #endif // __AUXILIARY_H
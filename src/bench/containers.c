@@ -0,0 +1,662 @@
+//*****************************************************************************
+//
+// containers.c
+//
+// microbenchmarks for the containers every hot path in the mud is built on:
+// lists, hashtables, maps, sets, property tables, near-maps, buffers and
+// bitvectors. This is a program of its own, built by make bench (or scons
+// bench), and links in nothing but the containers and strutil.c.
+//
+// Keys are made to look like the ones the mud uses them for: prototype keys
+// (key@zone) read out of the world directory, command names and the
+// abbreviations players type for them, and UIDs handed out in increasing
+// order. Each container is timed inserting, looking up, iterating over, and
+// removing its keys, and every result is printed as one tab-separated line,
+//
+//   container  keys  size  op  ops  best_ns  mean_ns
+//
+// where best_ns and mean_ns are nanoseconds per operation, the best of all
+// the rounds and the average of them. Lines starting with # are comments.
+// Random choices are made from a fixed seed, so runs are comparable.
+//
+// usage: containerbench [-n size] [-r rounds] [-w world path]
+//
+//*****************************************************************************
+#include <dirent.h>
+#include <time.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../near_map.h"
+#include "../bitvector.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the defaults, if we aren't told otherwise
+#define DFLT_BENCH_SIZE      10000
+#define DFLT_BENCH_ROUNDS    5
+#define DFLT_BENCH_WORLD     "../lib/world"
+
+// the kinds of prototypes we take keys from
+const char *bench_proto_types[] = {
+  "mproto", "oproto", "rproto", "trigger", NULL
+};
+
+// the commands everyone uses, core and Python alike
+const char *bench_cmds[] = {
+  "north", "south", "east", "west", "up", "down", "northeast", "northwest",
+  "southeast", "southwest", "look", "say", "tell", "chat", "emote", "get",
+  "drop", "give", "put", "wear", "remove", "wield", "inventory", "equipment",
+  "score", "who", "where", "help", "quit", "save", "open", "close", "lock",
+  "unlock", "sit", "stand", "sleep", "wake", "examine", "commands", "alias",
+  "back", "more", "compress", "time", "write", "notepad", "hedit", "zedit",
+  "redit", "medit", "oedit", "mpedit", "opedit", "rpedit", "dig", "fill",
+  "instantiate", "mlist", "olist", "rlist", "zlist", "zreset", "mview",
+  "oview", "rview", "attach", "detach", "tedit", "tstat", "tlist", "set",
+  "goto", "transfer", "load", "purge", "force", "shutdown", "copyover",
+  "pulsestats", "hookstat", "cmdstat", "outputstat", "inputstat", "sample",
+  NULL
+};
+
+// a room description, about as long as the ones in our world
+const char *bench_desc =
+  "You are standing in the entrance of a dimly lit tavern. A worn wooden bar "
+  "runs along the far wall, and the smell of stale ale hangs in the air. A "
+  "fire crackles in a stone fireplace to the north, and a small stage sits "
+  "in the corner, empty for now.\r\n";
+
+// something UIDs can go into a property table on, like our game data does
+typedef struct bench_thing {
+  int uid;
+} BENCH_THING;
+
+// which round we are on, how many there are, and the times taken by the op
+// being run across all of them
+int       bench_rounds = DFLT_BENCH_ROUNDS;
+long long *bench_times = NULL;
+
+// an xorshift generator, so every run picks the same keys in the same order
+unsigned long long bench_seed = 0x2545F4914F6CDD1DULL;
+
+unsigned long long bench_rand(void) {
+  bench_seed ^= bench_seed << 13;
+  bench_seed ^= bench_seed >> 7;
+  bench_seed ^= bench_seed << 17;
+  return bench_seed;
+}
+
+//
+// shuffle an array of pointers, so lookups don't go in insertion order
+void bench_shuffle(void **elems, int num) {
+  int i;
+  for(i = num - 1; i > 0; i--) {
+    int   j = bench_rand() % (i + 1);
+    void *e = elems[i];
+    elems[i] = elems[j];
+    elems[j] = e;
+  }
+}
+
+long long bench_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+//
+// print one result; times holds how long each round took to do ops things
+void bench_report(const char *container, const char *keys, int size,
+		  const char *op, int ops) {
+  long long best = bench_times[0], total = 0;
+  int i;
+  for(i = 0; i < bench_rounds; i++) {
+    best   = MIN(best, bench_times[i]);
+    total += bench_times[i];
+  }
+  printf("%s\t%s\t%d\t%s\t%d\t%.1f\t%.1f\n", container, keys, size, op, ops,
+	 (double)best / MAX(1, ops),
+	 (double)total / bench_rounds / MAX(1, ops));
+}
+
+// time a block of code, once per round, and remember how long it took
+#define BENCH_TIME(round, code)                     \
+  do {                                              \
+    long long bench_start = bench_clock();          \
+    code;                                           \
+    bench_times[round] = bench_clock() - bench_start; \
+  } while(0)
+
+
+
+//*****************************************************************************
+// key sets
+//*****************************************************************************
+
+//
+// read the keys of every prototype and trigger in the world. They are in
+// <world>/zones/<zone>/<type>/<key>
+LIST *bench_world_keys(const char *world) {
+  LIST      *keys = newList();
+  char path[MAX_BUFFER];
+  struct dirent *zone = NULL, *entry = NULL;
+  DIR *zones = NULL, *dir = NULL;
+  int i;
+
+  snprintf(path, sizeof(path), "%s/zones", world);
+  if((zones = opendir(path)) == NULL)
+    return keys;
+  while((zone = readdir(zones)) != NULL) {
+    if(*zone->d_name == '.')
+      continue;
+    for(i = 0; bench_proto_types[i] != NULL; i++) {
+      snprintf(path, sizeof(path), "%s/zones/%s/%s", world, zone->d_name,
+	       bench_proto_types[i]);
+      if((dir = opendir(path)) == NULL)
+	continue;
+      while((entry = readdir(dir)) != NULL) {
+	if(*entry->d_name == '.')
+	  continue;
+	snprintf(path, sizeof(path), "%s@%s", entry->d_name, zone->d_name);
+	listQueue(keys, strdup(path));
+      }
+      closedir(dir);
+    }
+  }
+  closedir(zones);
+  return keys;
+}
+
+//
+// make size prototype keys. Real ones come first; past those, the real ones
+// are reused with a number on the end, the way builders name variants of a
+// thing. If there is no world to read from, keys are made up in the same
+// shape
+char **bench_proto_keys(const char *world, int size) {
+  LIST  *real = bench_world_keys(world);
+  int num_real = listSize(real);
+  char   **keys = malloc(sizeof(char *) * size);
+  char    *key = NULL;
+  char  **base = malloc(sizeof(char *) * MAX(1, num_real));
+  int i = 0;
+
+  while((key = listPop(real)) != NULL)
+    base[i++] = key;
+  deleteList(real);
+  printf("# %d prototype keys read from %s\n", num_real, world);
+
+  for(i = 0; i < size; i++) {
+    char buf[SMALL_BUFFER];
+    if(num_real == 0)
+      snprintf(buf, sizeof(buf), "thing%d@zone%d", i, i % 20);
+    else if(i < num_real)
+      snprintf(buf, sizeof(buf), "%s", base[i]);
+    else {
+      const char *real_key = base[i % num_real];
+      int          key_len = next_letter_in(real_key, '@');
+      snprintf(buf, sizeof(buf), "%.*s_%d%s", key_len, real_key, i / num_real,
+	       real_key + key_len);
+    }
+    keys[i] = strdup(buf);
+  }
+
+  for(i = 0; i < num_real; i++)
+    free(base[i]);
+  free(base);
+  return keys;
+}
+
+//
+// make size abbreviations of our commands, the way players type them: mostly
+// short, sometimes whole
+char **bench_cmd_abbrevs(int size) {
+  char **abbrevs = malloc(sizeof(char *) * size);
+  int num_cmds = 0, i;
+  while(bench_cmds[num_cmds] != NULL)
+    num_cmds++;
+  for(i = 0; i < size; i++) {
+    const char *cmd = bench_cmds[bench_rand() % num_cmds];
+    int         len = strlen(cmd);
+    int        want = (bench_rand() % 4 == 0 ? len : 1+bench_rand() % MIN(len,3));
+    abbrevs[i] = strndup(cmd, want);
+  }
+  return abbrevs;
+}
+
+//
+// make size things with UIDs, handed out in order as the mud does
+BENCH_THING **bench_uid_things(int size) {
+  BENCH_THING **things = malloc(sizeof(BENCH_THING *) * size);
+  int i;
+  for(i = 0; i < size; i++) {
+    things[i]      = malloc(sizeof(BENCH_THING));
+    things[i]->uid = START_UID + i;
+  }
+  return things;
+}
+
+int bench_thing_uid(BENCH_THING *thing) {
+  return thing->uid;
+}
+
+
+
+//*****************************************************************************
+// the benchmarks
+//*****************************************************************************
+
+//
+// lists are queued onto, searched (by address, as listIn does), iterated
+// over, and emptied from the front and by removal from the middle. Searches
+// are linear, so we only do so many of them
+void bench_list(BENCH_THING **things, int size) {
+  BENCH_THING **order = malloc(sizeof(BENCH_THING *) * size);
+  int   lookups = MIN(size, 1000), round, i;
+  volatile long sink = 0;
+  memcpy(order, things, sizeof(BENCH_THING *) * size);
+  bench_shuffle((void **)order, size);
+
+  LIST *lists[bench_rounds];
+  for(round = 0; round < bench_rounds; round++) {
+    lists[round] = newList();
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        listQueue(lists[round], things[i]));
+  }
+  bench_report("list", "uid", size, "queue", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < lookups; i++)
+		        sink += listIn(lists[round], order[i]));
+  bench_report("list", "uid", size, "in", lookups);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, {
+	LIST_ITERATOR *list_i = newListIterator(lists[round]);
+	BENCH_THING    *thing = NULL;
+	ITERATE_LIST(thing, list_i) {
+	  sink += thing->uid;
+	} deleteListIterator(list_i);
+      });
+  }
+  bench_report("list", "uid", size, "iterate", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < lookups; i++)
+		        listRemove(lists[round], order[i]));
+  bench_report("list", "uid", size, "remove", lookups);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, while(listPop(lists[round]) != NULL));
+    deleteList(lists[round]);
+  }
+  bench_report("list", "uid", size, "pop", size - lookups);
+  free(order);
+}
+
+//
+// hashtables are keyed by prototype key. Lookups are half hits and half
+// misses that differ from a real key by case, and by a letter
+void bench_hashtable(char **keys, int size) {
+  char **order = malloc(sizeof(char *) * size);
+  char **miss  = malloc(sizeof(char *) * size);
+  int round, i;
+  volatile long sink = 0;
+  memcpy(order, keys, sizeof(char *) * size);
+  bench_shuffle((void **)order, size);
+  for(i = 0; i < size; i++) {
+    miss[i] = strdup(order[i]);
+    miss[i][0] = toupper(miss[i][0]);
+    miss[i][strlen(miss[i]) - 1] ^= 1;
+  }
+
+  HASHTABLE *tables[bench_rounds];
+  for(round = 0; round < bench_rounds; round++) {
+    tables[round] = newHashtable();
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        hashPut(tables[round], keys[i], keys[i]));
+  }
+  bench_report("hashtable", "proto", size, "put", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += (hashGet(tables[round], order[i]) != NULL));
+  bench_report("hashtable", "proto", size, "get_hit", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += (hashGet(tables[round], miss[i]) != NULL));
+  bench_report("hashtable", "proto", size, "get_miss", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, {
+	HASH_ITERATOR *hash_i = newHashIterator(tables[round]);
+	const char       *key = NULL;
+	void             *val = NULL;
+	ITERATE_HASH(key, val, hash_i) {
+	  sink += (long)val;
+	} deleteHashIterator(hash_i);
+      });
+  }
+  bench_report("hashtable", "proto", size, "iterate", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        hashRemove(tables[round], order[i]));
+    deleteHashtable(tables[round]);
+  }
+  bench_report("hashtable", "proto", size, "remove", size);
+
+  for(i = 0; i < size; i++)
+    free(miss[i]);
+  free(miss);
+  free(order);
+}
+
+//
+// maps and sets are keyed by the address of a thing, as they are when the
+// mud keeps track of which characters or objects something is tied to
+void bench_map(BENCH_THING **things, int size) {
+  BENCH_THING **order = malloc(sizeof(BENCH_THING *) * size);
+  int round, i;
+  volatile long sink = 0;
+  memcpy(order, things, sizeof(BENCH_THING *) * size);
+  bench_shuffle((void **)order, size);
+
+  MAP *maps[bench_rounds];
+  for(round = 0; round < bench_rounds; round++) {
+    maps[round] = newMap(NULL, NULL);
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        mapPut(maps[round], things[i], things[i]));
+  }
+  bench_report("map", "ptr", size, "put", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += (mapGet(maps[round], order[i]) != NULL));
+  bench_report("map", "ptr", size, "get_hit", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, {
+	MAP_ITERATOR *map_i = newMapIterator(maps[round]);
+	const void     *key = NULL;
+	BENCH_THING  *thing = NULL;
+	ITERATE_MAP(key, thing, map_i) {
+	  sink += thing->uid;
+	} deleteMapIterator(map_i);
+      });
+  }
+  bench_report("map", "ptr", size, "iterate", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        mapRemove(maps[round], order[i]));
+    deleteMap(maps[round]);
+  }
+  bench_report("map", "ptr", size, "remove", size);
+  free(order);
+}
+
+void bench_set(BENCH_THING **things, int size) {
+  BENCH_THING **order = malloc(sizeof(BENCH_THING *) * size);
+  int round, i;
+  volatile long sink = 0;
+  memcpy(order, things, sizeof(BENCH_THING *) * size);
+  bench_shuffle((void **)order, size);
+
+  SET *sets[bench_rounds];
+  for(round = 0; round < bench_rounds; round++) {
+    sets[round] = newSet();
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        setPut(sets[round], things[i]));
+  }
+  bench_report("set", "ptr", size, "put", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += setIn(sets[round], order[i]));
+  bench_report("set", "ptr", size, "in", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, {
+	SET_ITERATOR *set_i = newSetIterator(sets[round]);
+	BENCH_THING  *thing = NULL;
+	ITERATE_SET(thing, set_i) {
+	  sink += thing->uid;
+	} deleteSetIterator(set_i);
+      });
+  }
+  bench_report("set", "ptr", size, "iterate", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        setRemove(sets[round], order[i]));
+    deleteSet(sets[round]);
+  }
+  bench_report("set", "ptr", size, "remove", size);
+  free(order);
+}
+
+//
+// property tables are keyed by UID, which are handed out in order. Lookups
+// go in a random order, the way commands and scripts look things up
+void bench_property_table(BENCH_THING **things, int size) {
+  BENCH_THING **order = malloc(sizeof(BENCH_THING *) * size);
+  int round, i;
+  volatile long sink = 0;
+  memcpy(order, things, sizeof(BENCH_THING *) * size);
+  bench_shuffle((void **)order, size);
+
+  PROPERTY_TABLE *tables[bench_rounds];
+  for(round = 0; round < bench_rounds; round++) {
+    tables[round] = newPropertyTable(bench_thing_uid, 1000);
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        propertyTablePut(tables[round], things[i]));
+  }
+  bench_report("property_table", "uid", size, "put", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += (propertyTableGet(tables[round],
+						  order[i]->uid) != NULL));
+  bench_report("property_table", "uid", size, "get_hit", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += (propertyTableGet(tables[round],
+						  START_UID + size + i) != NULL));
+  bench_report("property_table", "uid", size, "get_miss", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, {
+	PROPERTY_TABLE_ITERATOR *prop_i = newPropertyTableIterator(tables[round]);
+	BENCH_THING *thing = NULL;
+	for(thing = propertyTableIteratorCurrent(prop_i); thing != NULL;
+	    thing = propertyTableIteratorNext(prop_i))
+	  sink += thing->uid;
+	deletePropertyTableIterator(prop_i);
+      });
+  }
+  bench_report("property_table", "uid", size, "iterate", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        propertyTableRemove(tables[round], order[i]->uid));
+    deletePropertyTable(tables[round]);
+  }
+  bench_report("property_table", "uid", size, "remove", size);
+  free(order);
+}
+
+//
+// near-maps hold our commands, and are looked up by what players type
+void bench_near_map(char **abbrevs, int size) {
+  int num_cmds = 0, round, i;
+  volatile long sink = 0;
+  while(bench_cmds[num_cmds] != NULL)
+    num_cmds++;
+
+  NEAR_MAP *maps[bench_rounds];
+  for(round = 0; round < bench_rounds; round++) {
+    maps[round] = newNearMap();
+    BENCH_TIME(round, for(i = 0; i < num_cmds; i++)
+		        nearMapPut(maps[round], bench_cmds[i], NULL,
+				   (void *)bench_cmds[i]));
+  }
+  bench_report("near_map", "cmd", num_cmds, "put", num_cmds);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += (nearMapGet(maps[round], abbrevs[i], TRUE)!=NULL));
+  bench_report("near_map", "cmd", num_cmds, "get_abbrev", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += (nearMapGet(maps[round], bench_cmds[i % num_cmds],
+					    FALSE) != NULL));
+  bench_report("near_map", "cmd", num_cmds, "get_exact", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, {
+	NEAR_ITERATOR *near_i = newNearIterator(maps[round]);
+	const char    *abbrev = NULL;
+	void             *val = NULL;
+	ITERATE_NEARMAP(abbrev, val, near_i) {
+	  sink += (long)val;
+	} deleteNearIterator(near_i);
+      });
+  }
+  bench_report("near_map", "cmd", num_cmds, "iterate", num_cmds);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, for(i = 0; i < num_cmds; i++)
+		        nearMapRemove(maps[round], bench_cmds[i]));
+    deleteNearMap(maps[round]);
+  }
+  bench_report("near_map", "cmd", num_cmds, "remove", num_cmds);
+}
+
+//
+// buffers are built up out of room descriptions and formatted lines, the way
+// output is, and cleared for the next go
+void bench_buffer(char **keys, int size) {
+  BUFFER *buf = newBuffer(MAX_BUFFER);
+  int round, i;
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, for(i = 0; i < size; i++) {
+	bufferCat(buf, bench_desc);
+	if(bufferLength(buf) > MAX_BUFFER * 4)
+	  bufferClear(buf);
+      });
+    bufferClear(buf);
+  }
+  bench_report("buffer", "desc", size, "cat", size);
+
+  for(round = 0; round < bench_rounds; round++) {
+    BENCH_TIME(round, for(i = 0; i < size; i++) {
+	bprintf(buf, "%-30s [%6d] %s\r\n", keys[i], START_UID + i, "here");
+	if(bufferLength(buf) > MAX_BUFFER * 4)
+	  bufferClear(buf);
+      });
+    bufferClear(buf);
+  }
+  bench_report("buffer", "proto", size, "bprintf", size);
+  deleteBuffer(buf);
+}
+
+//
+// bitvectors are the ones the mud makes when it boots, with bits checked by
+// name and by compiled mask
+void bench_bitvector(int size) {
+  const char *bits[] = { "nowander", "safe", "darkness", "underwater",
+			 "midair", "no_magic", "no_telepot", "no_portal",
+			 "no_combat", NULL };
+  BITVECTOR   *v = bitvectorInstanceOf("room_bits");
+  BIT_MASK *mask = bitvectorCompileMask("room_bits", "darkness, no_combat");
+  int num_bits = 0, round, i;
+  volatile long sink = 0;
+  while(bits[num_bits] != NULL)
+    num_bits++;
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++) {
+	const char *bit = bits[i % num_bits];
+	if(i & 1) bitSet(v, bit); else bitRemove(v, bit);
+      });
+  bench_report("bitvector", "room_bits", num_bits, "set_remove", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += bitIsSet(v, bits[i % num_bits]));
+  bench_report("bitvector", "room_bits", num_bits, "is_set", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += bitIsOneSet(v, "darkness, no_combat"));
+  bench_report("bitvector", "room_bits", num_bits, "is_one_set", size);
+
+  for(round = 0; round < bench_rounds; round++)
+    BENCH_TIME(round, for(i = 0; i < size; i++)
+		        sink += bitMaskIsSet(v, mask));
+  bench_report("bitvector", "room_bits", num_bits, "mask_is_set", size);
+  deleteBitvector(v);
+}
+
+
+
+//*****************************************************************************
+// and the program itself
+//*****************************************************************************
+int main(int argc, char **argv) {
+  const char *world = DFLT_BENCH_WORLD;
+  int          size = DFLT_BENCH_SIZE;
+  int i;
+
+  for(i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-n") && i + 1 < argc)
+      size = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-r") && i + 1 < argc)
+      bench_rounds = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-w") && i + 1 < argc)
+      world = argv[++i];
+    else {
+      fprintf(stderr, "usage: %s [-n size] [-r rounds] [-w world path]\n",
+	      argv[0]);
+      return 1;
+    }
+  }
+  size         = MAX(1, size);
+  bench_rounds = MAX(1, bench_rounds);
+  bench_times  = calloc(bench_rounds, sizeof(long long));
+
+  init_bitvectors();
+  char        **keys = bench_proto_keys(world, size);
+  char     **abbrevs = bench_cmd_abbrevs(size);
+  BENCH_THING **things = bench_uid_things(size);
+
+  printf("# size %d, best and mean of %d rounds, in ns per op\n",
+	 size, bench_rounds);
+  printf("container\tkeys\tsize\top\tops\tbest_ns\tmean_ns\n");
+  bench_list(things, size);
+  bench_hashtable(keys, size);
+  bench_map(things, size);
+  bench_set(things, size);
+  bench_property_table(things, size);
+  bench_near_map(abbrevs, size);
+  bench_buffer(keys, size);
+  bench_bitvector(size);
+
+  for(i = 0; i < size; i++) {
+    free(keys[i]);
+    free(abbrevs[i]);
+    free(things[i]);
+  }
+  free(keys);
+  free(abbrevs);
+  free(things);
+  free(bench_times);
+  return 0;
+}
@@ -0,0 +1,384 @@
+//*****************************************************************************
+//
+// strings.c
+//
+// microbenchmarks for the scans the hot string helpers are built on (see
+// strscan.h), and for the helpers in string_utils.c that use them. This is a
+// program of its own, built by make bench (or scons bench), and links in
+// nothing but strscan.c and string_utils.c.
+//
+// Each scan is timed against the byte-at-a-time loop it replaced, over the
+// kinds of text the mud runs it over: the commands players type, keyword
+// lists, and room descriptions. Every result is one tab-separated line,
+//
+//   scan  input  len  impl  ops  best_ns  mean_ns
+//
+// where impl is bytewise, scan, or (for what libc also has) libc, len is the average length of the input,
+// and best_ns and mean_ns are nanoseconds per operation, the best of all the
+// rounds and the average of them. Lines starting with # are comments.
+//
+// usage: stringbench [-n ops] [-r rounds]
+//
+//*****************************************************************************
+#include <ctype.h>
+#include <strings.h>
+#include <time.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../strscan.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the defaults, if we aren't told otherwise
+#define DFLT_BENCH_OPS       100000
+#define DFLT_BENCH_ROUNDS    5
+
+// what players type
+const char *bench_lines[] = {
+  "n", "look", "get all.sword", "put 2.bread in bag", "say Hello there!",
+  "tell bob  the orcs are coming, meet me at the gate",
+  "give 'long sword' guard", "   emote waves happily.", "inventory",
+  "chat is anyone around to help me with the cave quest?", NULL
+};
+
+// the keyword lists of things, and the words looked for in them
+const char *bench_keywords[] = {
+  "sword, long sword, steel sword", "bread, loaf", "guard, city guard, man",
+  "chest, wooden chest, iron-bound chest, old chest", "bag, sack", NULL
+};
+const char *bench_words[] = {
+  "sword", "loaf", "man", "chest", "sack", "gate", "Steel sword", NULL
+};
+
+// room descriptions, about as long as the ones in our world
+const char *bench_descs[] = {
+  "You are standing in the entrance of a dimly lit tavern. A worn wooden bar "
+  "runs along the far wall, and the smell of stale ale hangs in the air. A "
+  "fire crackles in a stone fireplace to the north, and a small stage sits "
+  "in the corner, empty for now.\r\n",
+  "   The road {gnarrows{n here, squeezed between two hills. Tall grass "
+  "sways in the wind on either side, and far off to the east the walls of "
+  "the city can just be made out.\r\n\r\n   A signpost stands by the road.\r\n",
+  NULL
+};
+
+// which round we are on, how many there are, and the times taken by the op
+// being run across all of them
+int       bench_rounds = DFLT_BENCH_ROUNDS;
+long long *bench_times = NULL;
+
+// results go here, so the compiler can't throw the work away
+volatile long bench_sink = 0;
+
+long long bench_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+//
+// the average length of a set of inputs
+int bench_avg_len(const char **inputs) {
+  int i, total = 0;
+  for(i = 0; inputs[i] != NULL; i++)
+    total += strlen(inputs[i]);
+  return (i > 0 ? total / i : 0);
+}
+
+//
+// print one result; times holds how long each round took to do ops things
+void bench_report(const char *scan, const char *input, int len,
+		  const char *impl, int ops) {
+  long long best = bench_times[0], total = 0;
+  int i;
+  for(i = 0; i < bench_rounds; i++) {
+    best   = MIN(best, bench_times[i]);
+    total += bench_times[i];
+  }
+  printf("%s\t%s\t%d\t%s\t%d\t%.1f\t%.1f\n", scan, input, len, impl, ops,
+	 (double)best / MAX(1, ops),
+	 (double)total / bench_rounds / MAX(1, ops));
+}
+
+// time a block of code, once per round, and remember how long it took
+#define BENCH_TIME(round, code)                     \
+  do {                                              \
+    long long bench_start = bench_clock();          \
+    code;                                           \
+    bench_times[round] = bench_clock() - bench_start; \
+  } while(0)
+
+//
+// time one op over a set of inputs, going through them in order
+#define BENCH_OVER(inputs, ops, code)					\
+  do {									\
+    int bench_num = 0, round, i;					\
+    while((inputs)[bench_num] != NULL)					\
+      bench_num++;							\
+    for(round = 0; round < bench_rounds; round++)			\
+      BENCH_TIME(round, for(i = 0; i < (ops); i++) {			\
+	  const char *in = (inputs)[i % bench_num];			\
+	  code;								\
+	});								\
+  } while(0)
+
+
+
+//*****************************************************************************
+// the byte-at-a-time loops the scans replaced
+//*****************************************************************************
+
+// they lived in other files, so they shouldn't get inlined here either
+#define BENCH_NOINLINE __attribute__((noinline))
+
+BENCH_NOINLINE
+const char *bytewise_find(const char *str, char ch) {
+  while(*str != '\0' && *str != ch)
+    str++;
+  return str;
+}
+
+BENCH_NOINLINE
+const char *bytewise_to_space(const char *str) {
+  while(*str != '\0' && !isspace(*str))
+    str++;
+  return str;
+}
+
+BENCH_NOINLINE
+const char *bytewise_skip_space(const char *str) {
+  while(isspace(*str))
+    str++;
+  return str;
+}
+
+BENCH_NOINLINE
+int bytewise_count(const char *str, int len, char ch) {
+  int i, n;
+  for(i = n = 0; i < len; i++)
+    if(str[i] == ch)
+      n++;
+  return n;
+}
+
+//
+// compares() and is_prefix() as they were
+BENCH_NOINLINE
+bool bytewise_caseeq(const char *a, const char *b, int len) {
+  int i;
+  for(i = 0; i < len; i++)
+    if(tolower(a[i]) != tolower(b[i]))
+      return FALSE;
+  return TRUE;
+}
+
+BENCH_NOINLINE
+char *bytewise_one_arg(char *fStr, char *bStr) {
+  while(isspace(*fStr))
+    fStr++;
+  char arg_end = ' ';
+  if(*fStr == '"' || *fStr == '\'') {
+    arg_end = *fStr;
+    fStr++;
+  }
+  while(*fStr != '\0') {
+    if(*fStr == arg_end) {
+      fStr++;
+      break;
+    }
+    *bStr++ = *fStr++;
+  }
+  *bStr = '\0';
+  while(isspace(*fStr))
+    fStr++;
+  return fStr;
+}
+
+//
+// is_keyword as it was, with strncasecmp
+BENCH_NOINLINE
+bool bytewise_is_keyword(const char *keywords, const char *word) {
+  int word_len = strlen(word);
+  while(*keywords != '\0') {
+    while(isspace(*keywords) || *keywords == ',')
+      keywords++;
+    int keyword_len = bytewise_find(keywords, ',') - keywords;
+    if(keyword_len == word_len && !strncasecmp(keywords, word, keyword_len))
+      return TRUE;
+    while(*keywords != '\0' && *keywords != ',')
+      keywords++;
+  }
+  return FALSE;
+}
+
+//
+// and as it is now, with strscan
+BENCH_NOINLINE
+bool scan_is_keyword(const char *keywords, const char *word) {
+  int word_len = strlen(word);
+  while(*keywords != '\0') {
+    while(isspace(*keywords) || *keywords == ',')
+      keywords++;
+    const char *end = scan_find(keywords, ',');
+    if(end - keywords == word_len && scan_caseeq(keywords, word, word_len))
+      return TRUE;
+    keywords = end;
+  }
+  return FALSE;
+}
+
+
+
+//*****************************************************************************
+// the benchmarks
+//*****************************************************************************
+
+//
+// finding the end of the first argument of a command, and of each word in a
+// description, as bufferFormat does
+void bench_find(int ops) {
+  int len = bench_avg_len(bench_lines);
+  BENCH_OVER(bench_lines, ops, bench_sink += *bytewise_find(in, '.'));
+  bench_report("find", "cmd", len, "bytewise", ops);
+  BENCH_OVER(bench_lines, ops, bench_sink += *scan_find(in, '.'));
+  bench_report("find", "cmd", len, "scan", ops);
+
+  len = bench_avg_len(bench_descs);
+  BENCH_OVER(bench_descs, ops, bench_sink += *bytewise_find(in, '\n'));
+  bench_report("find", "desc", len, "bytewise", ops);
+  BENCH_OVER(bench_descs, ops, bench_sink += *scan_find(in, '\n'));
+  bench_report("find", "desc", len, "scan", ops);
+
+  BENCH_OVER(bench_descs, ops, {
+      const char *word = in;
+      while(*(word = bytewise_to_space(word)) != '\0')
+	word = bytewise_skip_space(word);
+      bench_sink += word - in;
+    });
+  bench_report("words", "desc", len, "bytewise", ops);
+  BENCH_OVER(bench_descs, ops, {
+      const char *word = in;
+      while(*(word = scan_to_space(word)) != '\0')
+	word = scan_skip_space(word);
+      bench_sink += word - in;
+    });
+  bench_report("words", "desc", len, "scan", ops);
+}
+
+//
+// counting the newlines and quotes in a description, as count_letters does
+void bench_count(int ops) {
+  int len = bench_avg_len(bench_descs);
+  BENCH_OVER(bench_descs, ops,
+	     bench_sink += bytewise_count(in, strlen(in), '\n'));
+  bench_report("count", "desc", len, "bytewise", ops);
+  BENCH_OVER(bench_descs, ops,
+	     bench_sink += scan_count(in, strlen(in), '\n'));
+  bench_report("count", "desc", len, "scan", ops);
+}
+
+//
+// comparing without case, over a word and over a whole description. Words
+// are compared for as long as they are, as is_keyword does
+void bench_caseeq(int ops) {
+  int len = bench_avg_len(bench_words), i;
+  BENCH_OVER(bench_words, ops,
+	     bench_sink += bytewise_caseeq(in, "STEEL SWORD", strlen(in)));
+  bench_report("caseeq", "word", len, "bytewise", ops);
+  BENCH_OVER(bench_words, ops,
+	     bench_sink += !strncasecmp(in, "STEEL SWORD", strlen(in)));
+  bench_report("caseeq", "word", len, "libc", ops);
+  BENCH_OVER(bench_words, ops,
+	     bench_sink += scan_caseeq(in, "STEEL SWORD", strlen(in)));
+  bench_report("caseeq", "word", len, "scan", ops);
+
+  // descriptions are compared to an uppercase copy of themselves, so
+  // nothing can tell they're the same without looking at them
+  const char *upper[] = { NULL, NULL, NULL };
+  for(i = 0; bench_descs[i] != NULL; i++) {
+    char *copy = strdup(bench_descs[i]), *c;
+    for(c = copy; *c; c++)
+      *c = toupper(*c);
+    upper[i] = copy;
+  }
+  len = bench_avg_len(bench_descs);
+  BENCH_OVER(bench_descs, ops,
+	     bench_sink += bytewise_caseeq(in, upper[i % 2], strlen(in)));
+  bench_report("caseeq", "desc", len, "bytewise", ops);
+  BENCH_OVER(bench_descs, ops,
+	     bench_sink += !strncasecmp(in, upper[i % 2], strlen(in)));
+  bench_report("caseeq", "desc", len, "libc", ops);
+  BENCH_OVER(bench_descs, ops,
+	     bench_sink += scan_caseeq(in, upper[i % 2], strlen(in)));
+  bench_report("caseeq", "desc", len, "scan", ops);
+  for(i = 0; upper[i] != NULL; i++)
+    free((char *)upper[i]);
+}
+
+//
+// splitting commands into arguments, and looking words up in keyword lists
+void bench_helpers(int ops) {
+  char arg[MAX_BUFFER], line[MAX_BUFFER];
+  int len = bench_avg_len(bench_lines);
+  BENCH_OVER(bench_lines, ops, {
+      strcpy(line, in);
+      bench_sink += *bytewise_one_arg(line, arg);
+    });
+  bench_report("one_arg", "cmd", len, "bytewise", ops);
+  BENCH_OVER(bench_lines, ops, {
+      strcpy(line, in);
+      bench_sink += *one_arg(line, arg);
+    });
+  bench_report("one_arg", "cmd", len, "scan", ops);
+
+  len = bench_avg_len(bench_keywords);
+  BENCH_OVER(bench_keywords, ops,
+	     bench_sink += bytewise_is_keyword(in, bench_words[i % 7]));
+  bench_report("is_keyword", "keywords", len, "bytewise", ops);
+  BENCH_OVER(bench_keywords, ops,
+	     bench_sink += scan_is_keyword(in, bench_words[i % 7]));
+  bench_report("is_keyword", "keywords", len, "scan", ops);
+}
+
+
+
+//*****************************************************************************
+// and the program itself
+//*****************************************************************************
+int main(int argc, char **argv) {
+  int ops = DFLT_BENCH_OPS;
+  int i;
+
+  for(i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-n") && i + 1 < argc)
+      ops = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-r") && i + 1 < argc)
+      bench_rounds = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [-n ops] [-r rounds]\n", argv[0]);
+      return 1;
+    }
+  }
+  ops          = MAX(10, ops);
+  bench_rounds = MAX(1, bench_rounds);
+  bench_times  = calloc(bench_rounds, sizeof(long long));
+
+#if defined(STRSCAN_SCALAR)
+  printf("# scans are scalar (STRSCAN_SCALAR)\n");
+#endif
+  printf("# %d ops, best and mean of %d rounds, in ns per op\n",
+	 ops, bench_rounds);
+  printf("scan\tinput\tlen\timpl\tops\tbest_ns\tmean_ns\n");
+  bench_find(ops);
+  bench_count(ops);
+  bench_caseeq(ops);
+  bench_helpers(ops);
+
+  free(bench_times);
+  return 0;
+}
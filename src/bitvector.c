@@ -44,6 +44,8 @@
 
 
 
+
+
 //*****************************************************************************
 // local functions, datastructures, and defines
 //*****************************************************************************
@@ -51,23 +53,124 @@
 // data assocciated with them (i.e. bit:value mappings)
 HASHTABLE *bitvector_table = NULL;
 
+// bits are stored, and tested, a whole word at a time
+#define BITS_PER_WORD       (sizeof(unsigned long) * 8)
+#define BIT_WORD(val)       ((val) / BITS_PER_WORD)
+#define BIT_FLAG(val)       (1UL << ((val) % BITS_PER_WORD))
+
+// past this many different strings, we stop caching masks for a bitvector
+// type, and compile throwaway ones instead. Keeps arbitrary strings passed
+// in by scripts from growing the cache forever
+#define MAX_CACHED_MASKS    512
+
 typedef struct bitvector_data {
   HASHTABLE *bitmap; // a mapping from bit name to bit number
+  HASHTABLE  *masks; // a mapping from bit lists to their compiled masks
   char        *name; // which bitvector is this?
+  int       version; // bumped whenever any vector of ours changes its bits
 } BITVECTOR_DATA;
 
 struct bitvector {
   BITVECTOR_DATA *data; // the data corresponding to this bitvector
-  char           *bits; // the bits we have set/unset
+  int        num_words; // how many words of bits do we have?
+  unsigned long  *bits; // the bits we have set/unset
+};
+
+struct bitvector_mask {
+  BITVECTOR_DATA *data; // the type of bitvector we're a mask for
+  int        num_words; // how many words of bits do we have?
+  unsigned long  *bits; // the bits we name
+  bool         unknown; // did we name any bits that don't exist?
+  bool       temporary; // are we in the cache, or do we get thrown out?
 };
 
 BITVECTOR_DATA *newBitvectorData(const char *name) {
   BITVECTOR_DATA *data = malloc(sizeof(BITVECTOR_DATA));
   data->bitmap = newHashtable();
-  data->name   = strdup(name);
+  data->masks  = newHashtable();
+  data->name    = strdup(name);
+  data->version = 0;
   return data;
 }
 
+//
+// how many words do we need to hold every bit of this type of bitvector?
+// Bits are numbered from 1, with 0 meaning 'not a bit'
+int bitvector_words_for(BITVECTOR_DATA *data) {
+  return BIT_WORD(hashSize(data->bitmap)) + 1;
+}
+
+//
+// make sure a vector has room for at least num_words of bits. Bits can be
+// added to a type after vectors of it have been made
+void bitvector_grow(BITVECTOR *v, int num_words) {
+  if(v->num_words < num_words) {
+    v->bits = realloc(v->bits, sizeof(unsigned long) * num_words);
+    memset(v->bits + v->num_words, 0,
+	   sizeof(unsigned long) * (num_words - v->num_words));
+    v->num_words = num_words;
+  }
+}
+
+bool bitvector_test(BITVECTOR *v, int val) {
+  return (BIT_WORD(val) < v->num_words &&
+	  (v->bits[BIT_WORD(val)] & BIT_FLAG(val)) != 0);
+}
+
+//
+// (re)fill a mask with the bits named in a comma-separated list
+void bit_mask_compile(BIT_MASK *mask, const char *bits) {
+  LIST    *names = parse_keywords(bits);
+  char *one_bit = NULL;
+  mask->num_words = bitvector_words_for(mask->data);
+  mask->bits      = realloc(mask->bits, sizeof(unsigned long)*mask->num_words);
+  mask->unknown   = FALSE;
+  memset(mask->bits, 0, sizeof(unsigned long) * mask->num_words);
+
+  while( (one_bit = listPop(names)) != NULL) {
+    long val = (long)hashGet(mask->data->bitmap, one_bit);
+    free(one_bit);
+    // 0 is a filler meaning 'this is not an actual name for a bit'
+    if(val == 0)
+      mask->unknown = TRUE;
+    else
+      mask->bits[BIT_WORD(val)] |= BIT_FLAG(val);
+  }
+  deleteListWith(names, free);
+}
+
+BIT_MASK *newBitMask(BITVECTOR_DATA *data, const char *bits) {
+  BIT_MASK *mask = calloc(1, sizeof(BIT_MASK));
+  mask->data     = data;
+  bit_mask_compile(mask, bits);
+  return mask;
+}
+
+void deleteBitMask(BIT_MASK *mask) {
+  if(mask->bits) free(mask->bits);
+  free(mask);
+}
+
+//
+// find the compiled mask for a list of bits, compiling it if we have to. 
+// Once bitvector_done_mask is called, the mask must not be used again
+BIT_MASK *bitvector_get_mask(BITVECTOR_DATA *data, const char *bits) {
+  BIT_MASK *mask = hashGet(data->masks, bits);
+  if(mask == NULL) {
+    mask = newBitMask(data, bits);
+    if(hashSize(data->masks) < MAX_CACHED_MASKS)
+      hashPut(data->masks, bits, mask);
+    else
+      mask->temporary = TRUE;
+  }
+  return mask;
+}
+
+void bitvector_done_mask(BIT_MASK *mask) {
+  if(mask->temporary)
+    deleteBitMask(mask);
+}
+
 
 
 
@@ -117,8 +220,17 @@ void init_bitvectors() {
 
 void bitvectorAddBit(const char *name, const char *bit) {
   BITVECTOR_DATA *data = hashGet(bitvector_table, name);
-  if(data != NULL)
-    hashPut(data->bitmap, bit, (void *)(hashSize(data->bitmap) + 1));
+  if(data != NULL) {
+    hashPut(data->bitmap, bit, (void *)(long)(hashSize(data->bitmap) + 1));
+
+    // masks that have already been handed out may name the new bit
+    LOCAL_HASH_ITERATOR(mask_i, data->masks);
+    const char *bits = NULL;
+    BIT_MASK   *mask = NULL;
+    ITERATE_HASH(bits, mask, mask_i) {
+      bit_mask_compile(mask, bits);
+    } hashIteratorFinish(mask_i);
+  }
 }
 
 void bitvectorCreate(const char *name) {
@@ -135,10 +247,10 @@ BITVECTOR   *bitvectorInstanceOf(const char *name) {
   BITVECTOR_DATA *data = hashGet(bitvector_table, name);
   BITVECTOR    *vector = NULL;
   if(data != NULL) {
-    int vector_len = hashSize(data->bitmap)/8 + 1;
     vector = newBitvector();
-    vector->data = data;
-    vector->bits = calloc(vector_len, sizeof(char));
+    vector->data      = data;
+    vector->num_words = bitvector_words_for(data);
+    vector->bits      = calloc(vector->num_words, sizeof(unsigned long));
   }
   return vector;
 }
@@ -149,11 +261,12 @@ void         deleteBitvector(BITVECTOR *v) {
 }
 
 void         bitvectorCopyTo(BITVECTOR *from, BITVECTOR *to) {
-  int bit_len = 1 + hashSize(from->data->bitmap)/8;
-  to->data = from->data;
+  from->data->version++;
+  to->data      = from->data;
+  to->num_words = from->num_words;
   if(to->bits) free(to->bits);
-  to->bits = malloc(sizeof(char) * bit_len);
-  to->bits = memcpy(to->bits, from->bits, bit_len);
+  to->bits = malloc(sizeof(unsigned long) * from->num_words);
+  memcpy(to->bits, from->bits, sizeof(unsigned long) * from->num_words);
 }
 
 BITVECTOR   *bitvectorCopy(BITVECTOR *v) {
@@ -162,101 +275,115 @@ BITVECTOR   *bitvectorCopy(BITVECTOR *v) {
   return newvector;
 }
 
-bool bitIsSet(BITVECTOR *v, const char *bit) {
-  LIST    *bits = parse_keywords(bit);
-  char *one_bit = NULL; 
-  bool    found = FALSE;
+BIT_MASK *bitvectorCompileMask(const char *name, const char *bits) {
+  BITVECTOR_DATA *data = hashGet(bitvector_table, name);
+  if(data == NULL)
+    return NULL;
+  BIT_MASK *mask = hashGet(data->masks, bits);
+  if(mask == NULL) {
+    mask = newBitMask(data, bits);
+    hashPut(data->masks, bits, mask);
+  }
+  return mask;
+}
 
-  // check for one
-  while( !found && (one_bit = listPop(bits)) != NULL) {
-    found = bitIsOneSet(v, one_bit);
-    free(one_bit);
+bool bitMaskIsSet(BITVECTOR *v, BIT_MASK *mask) {
+  int i, num_words = MIN(v->num_words, mask->num_words);
+  for(i = 0; i < num_words; i++)
+    if(v->bits[i] & mask->bits[i])
+      return TRUE;
+  return FALSE;
+}
+
+bool bitMaskIsAllSet(BITVECTOR *v, BIT_MASK *mask) {
+  if(mask->unknown)
+    return FALSE;
+  int i;
+  for(i = 0; i < mask->num_words; i++) {
+    unsigned long bits = (i < v->num_words ? v->bits[i] : 0);
+    if((bits & mask->bits[i]) != mask->bits[i])
+      return FALSE;
   }
-  
-  // clean up our mess
-  deleteListWith(bits, free);
-  return found;
+  return TRUE;
 }
 
-bool bitIsAllSet(BITVECTOR *v, const char *bit) {
-  LIST    *bits = parse_keywords(bit);
-  char *one_bit = NULL;
-  bool    found = TRUE;
+void bitMaskSet(BITVECTOR *v, BIT_MASK *mask) {
+  int i;
+  v->data->version++;
+  bitvector_grow(v, mask->num_words);
+  for(i = 0; i < mask->num_words; i++)
+    v->bits[i] |= mask->bits[i];
+}
 
-  // check for each one
-  while( found && (one_bit = listPop(bits)) != NULL) {
-    found = bitIsOneSet(v, one_bit);
-    free(one_bit);
+void bitMaskRemove(BITVECTOR *v, BIT_MASK *mask) {
+  int i, num_words = MIN(v->num_words, mask->num_words);
+  v->data->version++;
+  for(i = 0; i < num_words; i++)
+    v->bits[i] &= ~mask->bits[i];
+}
+
+void bitMaskToggle(BITVECTOR *v, BIT_MASK *mask) {
+  int i;
+  v->data->version++;
+  bitvector_grow(v, mask->num_words);
+  for(i = 0; i < mask->num_words; i++)
+    v->bits[i] ^= mask->bits[i];
+}
+
+bool bitvectorContains(BITVECTOR *v, BITVECTOR *sub) {
+  int i;
+  for(i = 0; i < sub->num_words; i++) {
+    unsigned long bits = (i < v->num_words ? v->bits[i] : 0);
+    if((bits & sub->bits[i]) != sub->bits[i])
+      return FALSE;
   }
+  return TRUE;
+}
+
+bool bitIsSet(BITVECTOR *v, const char *bit) {
+  BIT_MASK *mask = bitvector_get_mask(v->data, bit);
+  bool     found = bitMaskIsSet(v, mask);
+  bitvector_done_mask(mask);
+  return found;
+}
 
-  // clean up our mess
-  deleteListWith(bits, free);
+bool bitIsAllSet(BITVECTOR *v, const char *bit) {
+  BIT_MASK *mask = bitvector_get_mask(v->data, bit);
+  bool     found = bitMaskIsAllSet(v, mask);
+  bitvector_done_mask(mask);
   return found;
 }
 
 bool bitIsOneSet(BITVECTOR *v, const char *bit) {
-  int val = (int)hashGet(v->data->bitmap, bit);
-  return IS_SET(v->bits[val/8], (1 << (val % 8)));
+  return bitvector_test(v, (long)hashGet(v->data->bitmap, bit));
 }
 
 void bitSet(BITVECTOR *v, const char *name) {
-  LIST    *bits = parse_keywords(name);
-  char *one_bit = NULL;
-
-  // set each one
-  while( (one_bit = listPop(bits)) != NULL) {
-    int val = (int)hashGet(v->data->bitmap, one_bit);
-    free(one_bit);
-    // 0 is a filler meaning 'this is not an actual name for a bit'
-    if(val == 0) continue;
-    SET_BIT(v->bits[val/8], (1 << (val % 8)));
-  }
-
-  // garbage collection
-  deleteListWith(bits, free);
+  BIT_MASK *mask = bitvector_get_mask(v->data, name);
+  bitMaskSet(v, mask);
+  bitvector_done_mask(mask);
 }
 
 void bitClear(BITVECTOR *v) {
-  int i;
-  for(i = 1; i <= hashSize(v->data->bitmap); i++)
-    REMOVE_BIT(v->bits[i/8], (1 << (i % 8)));
+  v->data->version++;
+  memset(v->bits, 0, sizeof(unsigned long) * v->num_words);
 }
 
 void bitRemove(BITVECTOR *v, const char *name) {
-  LIST    *bits = parse_keywords(name);
-  char *one_bit = NULL;
-
-  // remove each one
-  while( (one_bit = listPop(bits)) != NULL) {
-    int val = (int)hashGet(v->data->bitmap, one_bit);
-    REMOVE_BIT(v->bits[val/8], (1 << (val % 8)));
-    free(one_bit);
-  }
-
-  // garbage collection
-  deleteListWith(bits, free);
+  BIT_MASK *mask = bitvector_get_mask(v->data, name);
+  bitMaskRemove(v, mask);
+  bitvector_done_mask(mask);
 }
 
 void bitToggle(BITVECTOR *v, const char *name) {
-  LIST    *bits = parse_keywords(name);
-  char *one_bit = NULL;
-
-  // toggle each one
-  while( (one_bit = listPop(bits)) != NULL) {
-    int val = (int)hashGet(v->data->bitmap, one_bit);
-    free(one_bit);
-    // 0 is a filler meaning 'this is not an actual name for a bit'
-    if(val == 0) continue;
-    TOGGLE_BIT(v->bits[val/8], (1 << (val % 8)));
-  }
-
-  // garbage collection
-  deleteListWith(bits, free);
+  BIT_MASK *mask = bitvector_get_mask(v->data, name);
+  bitMaskToggle(v, mask);
+  bitvector_done_mask(mask);
 }
 
 const char *bitvectorGetBits(BITVECTOR *v) {
   static char bits[MAX_BUFFER];
-  HASH_ITERATOR *hash_i = newHashIterator(v->data->bitmap);
+  LOCAL_HASH_ITERATOR(hash_i, v->data->bitmap);
   const char *key = NULL;
   void *val       = NULL;
   int bit_i       = 0;
@@ -264,15 +391,36 @@ const char *bitvectorGetBits(BITVECTOR *v) {
 
   // add each set bit to our list to store
   ITERATE_HASH(key, val, hash_i) {
-    if(bitIsOneSet(v, key)) {
+    if(bitvector_test(v, (long)val)) {
       bit_i += snprintf(bits+bit_i, MAX_BUFFER-bit_i, "%s%s", 
 			(bit_i == 0 ? "" : ", "), key);
     }
   }
-  deleteHashIterator(hash_i);
+  hashIteratorFinish(hash_i);
   return bits;
 }
 
+const char *bitvectorGetKey(BITVECTOR *v) {
+  static char key[SMALL_BUFFER];
+  int     num_words = v->num_words, i, len = 0;
+
+  // words past the last one with bits set don't change what the key says
+  while(num_words > 0 && v->bits[num_words - 1] == 0)
+    num_words--;
+  *key = '\0';
+  for(i = 0; i < num_words && len < SMALL_BUFFER - 20; i++)
+    len += sprintf(key + len, "%s%lx", (i == 0 ? "" : "."), v->bits[i]);
+  return key;
+}
+
+int bitvectorGetVersion(const char *name) {
+  // nothing has been made yet, if we're asked before bitvectors are set up
+  if(bitvector_table == NULL)
+    return 0;
+  BITVECTOR_DATA *data = hashGet(bitvector_table, name);
+  return (data ? data->version : 0);
+}
+
 int bitvectorSize(BITVECTOR *v) {
   return hashSize(v->data->bitmap);
 }
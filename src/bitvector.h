@@ -39,7 +39,8 @@
 //
 //*****************************************************************************
 
-typedef struct bitvector BITVECTOR;
+typedef struct bitvector      BITVECTOR;
+typedef struct bitvector_mask  BIT_MASK;
 
 //
 // prepare bitvector systems for use
@@ -97,10 +98,48 @@ void bitClear(BITVECTOR *v);
 // toggle the specified bits on or off... whichever one they are not, currently
 void bitToggle(BITVECTOR *v, const char *name);
 
+//
+// checks to see if every bit set on sub is also set on v
+bool bitvectorContains(BITVECTOR *v, BITVECTOR *sub);
+
+//
+// The functions above that take a list of bit names have to look up each
+// name every time they are called. Code that checks the same bits over and
+// over (e.g. checking if rooms are dark) can compile the list into a mask
+// once instead, and use the mask functions below, which work on whole words
+// of bits at a time. Masks are owned by the bitvector type and are never
+// freed, so it is safe to keep them around in a static variable. Asking for
+// the same list twice returns the same mask. The name-based functions above
+// use a cache of compiled masks themselves. Returns NULL if no bitvector
+// with the given name exists
+BIT_MASK *bitvectorCompileMask(const char *name, const char *bits);
+
+//
+// mask equivalents of bitIsSet, bitIsAllSet, bitSet, bitRemove, and
+// bitToggle. The mask must have been compiled for v's type of bitvector
+bool bitMaskIsSet   (BITVECTOR *v, BIT_MASK *mask);
+bool bitMaskIsAllSet(BITVECTOR *v, BIT_MASK *mask);
+void bitMaskSet     (BITVECTOR *v, BIT_MASK *mask);
+void bitMaskRemove  (BITVECTOR *v, BIT_MASK *mask);
+void bitMaskToggle  (BITVECTOR *v, BIT_MASK *mask);
+
 //
 // return a comma-separated list of the bits the vector has set
 const char *bitvectorGetBits(BITVECTOR *v);
 
+//
+// return a short string that is the same for any two vectors of the same type
+// with the same bits set, and different otherwise. Cheaper than getting the
+// bits, for when the set is being used as a key. The string is only good
+// until the next call
+const char *bitvectorGetKey(BITVECTOR *v);
+
+//
+// returns a number that changes whenever the bits on any vector of the named
+// type change. For caching things that are worked out from which vectors of
+// a type have which bits set
+int bitvectorGetVersion(const char *name);
+
 //
 // returns the number of possible bits that can be set on this bitvector
 int bitvectorSize(BITVECTOR *v);
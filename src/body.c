@@ -17,14 +17,50 @@ struct bodypart_data {
   char          *name;       // the name of the position
   char          *type;       // what kind of position type is this?
   int            size;       // how big is it, relative to other positions?
-  LIST     *equipment;       // list of objects being worn here (for layering)
+  int            slot;       // where we are in our body's slot bitmaps
 };
 
 typedef struct bodypart_data   BODYPART;
 
+//
+// a set of a body's parts, one bit per slot. Parts get slots in the order
+// they are added to the body, and a body's part list is kept newest first
+typedef struct body_slots {
+  unsigned long *bits;
+  int            words;
+} BODY_SLOTS;
+
+#define SLOT_BITS       (8 * (int)sizeof(unsigned long))
+
+//
+// the parts a body has, and our indexes over them. Copies of a body (every
+// body made for a race, for one) share their shape, until one of them adds,
+// changes, or removes a part and gets a shape of its own. What is worn is
+// kept on the body, by slot, so bodies sharing a shape never share equipment
+typedef struct body_shape {
+  int        refcount;       // how many bodies have this shape?
+  LIST      *parts;          // a list of all the parts on the body
+  HASHTABLE *part_table;     // our parts, by name
+  HASHTABLE *type_table;     // the slots of our parts, by type
+  HASHTABLE *type_names;     // the names of our parts, by type, once asked for
+  int        num_slots;      // how many slots we've handed out
+} BODY_SHAPE;
+
+//
+// the names of a shape's parts of one type, in the order of its part list.
+// The names are the parts' own, and go when the shape's parts change
+typedef struct body_type_parts {
+  const char **names;
+  int          num;
+} BODY_TYPE_PARTS;
+
 struct body_data {
-  LIST   *parts;             // a list of all the parts on the body
+  BODY_SHAPE *shape;         // our parts, maybe shared with other bodies
   int      size;             // how big is our body?
+  BODY_SLOTS *occupied;      // the slots that have equipment on them
+  LIST  **worn;              // what's worn on each slot, or NULL for nothing
+  int     worn_slots;        // how many slots worn has room for
+  LIST   *eq;                // everything we're wearing, once it's asked for
 };
 
 
@@ -60,12 +96,61 @@ static const char *default_bodypos[] = {
 };
 
 
+BODY_SLOTS *newBodySlots(void) {
+  return calloc(1, sizeof(BODY_SLOTS));
+}
+
+void deleteBodySlots(BODY_SLOTS *slots) {
+  if(slots->bits) free(slots->bits);
+  free(slots);
+}
+
+void bodySlotsSet(BODY_SLOTS *slots, int slot, bool val) {
+  int word = slot / SLOT_BITS;
+  if(word >= slots->words) {
+    if(!val)
+      return;
+    slots->bits = realloc(slots->bits, sizeof(unsigned long) * (word + 1));
+    memset(slots->bits + slots->words, 0, 
+	   sizeof(unsigned long) * (word + 1 - slots->words));
+    slots->words = word + 1;
+  }
+  if(val)
+    slots->bits[word] |=  (1UL << (slot % SLOT_BITS));
+  else
+    slots->bits[word] &= ~(1UL << (slot % SLOT_BITS));
+}
+
+bool bodySlotsIn(BODY_SLOTS *slots, int slot) {
+  int word = slot / SLOT_BITS;
+  return (word < slots->words &&
+	  (slots->bits[word] & (1UL << (slot % SLOT_BITS))) != 0);
+}
+
+//
+// returns the newest slot in slots that isn't in used (or also, if it isn't
+// NULL), or -1 if they are all used. Part lists are kept newest first, so this
+// is the part a walk over the list would have found first
+int bodySlotsLastFree(BODY_SLOTS *slots, BODY_SLOTS *used, BODY_SLOTS *also) {
+  int word = slots->words - 1;
+  for(; word >= 0; word--) {
+    unsigned long bits = slots->bits[word];
+    if(word < used->words)
+      bits &= ~used->bits[word];
+    if(also != NULL && word < also->words)
+      bits &= ~also->bits[word];
+    if(bits != 0)
+      return word * SLOT_BITS + (SLOT_BITS - 1 - __builtin_clzl(bits));
+  }
+  return -1;
+}
+
 /**
  * Create a new bodypart_data
  */
 BODYPART *newBodypart(const char *name, const char *type, int size) {
   BODYPART *P = malloc(sizeof(BODYPART));
-  P->equipment = newList();
+  P->slot      = -1;
   P->type = strdupsafe(type);
   P->size = MAX(0, size); // parts of size 0 cannot be hit
   P->name = strdup((name ? name : "nothing"));
@@ -79,22 +164,219 @@ BODYPART *newBodypart(const char *name, const char *type, int size) {
 void deleteBodypart(BODYPART *P) {
   if(P->name) free(P->name);
   if(P->type) free(P->type);
-  if(P->equipment) deleteList(P->equipment);
   free(P);
 };
 
 /**
- * Copy a bodypart
+ * Copy a bodypart. The copy keeps the part's slot
  */
 BODYPART *bodypartCopy(BODYPART *P) {
   BODYPART *p_new = malloc(sizeof(BODYPART));
-  p_new->equipment = newList();
   p_new->type      = strdupsafe(P->type);
   p_new->size      = P->size;
+  p_new->slot      = P->slot;
   p_new->name      = strdup(P->name);
   return p_new;
 }
 
+void deleteBodyTypeParts(BODY_TYPE_PARTS *parts) {
+  free(parts->names);
+  free(parts);
+}
+
+//
+// the shape's parts have changed. Forget what we had cached about them
+void shape_parts_changed(BODY_SHAPE *S) {
+  if(S->type_names != NULL) {
+    deleteHashtableWith(S->type_names, deleteBodyTypeParts);
+    S->type_names = NULL;
+  }
+}
+
+//
+// the names of the shape's parts of a type, building the index over all of
+// its types if we don't have one yet. NULL if it has none of that type
+BODY_TYPE_PARTS *shape_type_parts(BODY_SHAPE *S, const char *type) {
+  if(S->type_names == NULL) {
+    LIST_ITERATOR *part_i = newListIterator(S->parts);
+    BODYPART        *part = NULL;
+    S->type_names = newHashtable();
+    ITERATE_LIST(part, part_i) {
+      BODY_TYPE_PARTS *parts = hashGet(S->type_names, part->type);
+      if(parts == NULL) {
+	parts = calloc(1, sizeof(BODY_TYPE_PARTS));
+	hashPut(S->type_names, part->type, parts);
+      }
+      parts->names = realloc(parts->names, sizeof(char *) * (parts->num + 1));
+      parts->names[parts->num++] = part->name;
+    } deleteListIterator(part_i);
+  }
+  return hashGet(S->type_names, type);
+}
+
+//
+// the part in a slot. The list is newest first, so slots count down as we
+// go along
+BODYPART *shape_slot_part(BODY_SHAPE *S, int slot) {
+  LIST_ITERATOR *part_i = newListIterator(S->parts);
+  BODYPART        *part = NULL;
+  ITERATE_LIST(part, part_i)
+    if(part->slot == slot)
+      break;
+  deleteListIterator(part_i);
+  return part;
+}
+
+//
+// put a part in a shape's list and indexes, in the slot it already has
+void shape_index_part(BODY_SHAPE *S, BODYPART *part) {
+  shape_parts_changed(S);
+  BODY_SLOTS *slots = hashGet(S->type_table, part->type);
+  if(slots == NULL) {
+    slots = newBodySlots();
+    hashPut(S->type_table, part->type, slots);
+  }
+  bodySlotsSet(slots, part->slot, TRUE);
+  hashPut(S->part_table, part->name, part);
+  listPut(S->parts, part);
+}
+
+BODY_SHAPE *newBodyShape(void) {
+  BODY_SHAPE *S = malloc(sizeof(BODY_SHAPE));
+  S->refcount   = 1;
+  S->parts      = newList();
+  S->part_table = newHashtable();
+  S->type_table = newHashtable();
+  S->type_names = NULL;
+  S->num_slots  = 0;
+  return S;
+}
+
+//
+// let go of a shape, and delete it if no other body has it
+void bodyShapeRelease(BODY_SHAPE *S) {
+  if(--S->refcount > 0)
+    return;
+  deleteListWith(S->parts, deleteBodypart);
+  deleteHashtable(S->part_table);
+  deleteHashtableWith(S->type_table, deleteBodySlots);
+  shape_parts_changed(S);
+  free(S);
+}
+
+//
+// copy a shape. Parts keep their slots, so what is worn on them stays put
+BODY_SHAPE *bodyShapeCopy(BODY_SHAPE *S) {
+  BODY_SHAPE *S_new = newBodyShape();
+  // our list is newest first. Add from the back, so the order stays the same
+  LIST_ITERATOR *part_i = newListIterator(S->parts);
+  LIST             *rev = newList();
+  BODYPART        *part = NULL;
+  ITERATE_LIST(part, part_i)
+    listPut(rev, part);
+  deleteListIterator(part_i);
+  while((part = listPop(rev)) != NULL)
+    shape_index_part(S_new, bodypartCopy(part));
+  deleteList(rev);
+  S_new->num_slots = S->num_slots;
+  return S_new;
+}
+
+//
+// make sure no other body has our shape, before we change it
+void body_own_shape(BODY_DATA *B) {
+  if(B->shape->refcount > 1) {
+    BODY_SHAPE *own = bodyShapeCopy(B->shape);
+    bodyShapeRelease(B->shape);
+    B->shape = own;
+  }
+}
+
+//
+// what is worn on a part. NULL if nothing ever has been
+LIST *body_worn(const BODY_DATA *B, const BODYPART *part) {
+  return (part->slot < B->worn_slots ? B->worn[part->slot] : NULL);
+}
+
+int body_num_worn(const BODY_DATA *B, const BODYPART *part) {
+  LIST *worn = body_worn(B, part);
+  return (worn ? listSize(worn) : 0);
+}
+
+bool body_wears(const BODY_DATA *B, const BODYPART *part, const OBJ_DATA *obj) {
+  LIST *worn = body_worn(B, part);
+  return (worn && listIn(worn, obj));
+}
+
+//
+// what is worn on a part, making the list if there isn't one yet
+LIST *body_worn_list(BODY_DATA *B, const BODYPART *part) {
+  if(part->slot >= B->worn_slots) {
+    int slots = MAX(part->slot + 1, B->shape->num_slots);
+    B->worn   = realloc(B->worn, sizeof(LIST *) * slots);
+    memset(B->worn + B->worn_slots, 0, sizeof(LIST *)*(slots - B->worn_slots));
+    B->worn_slots = slots;
+  }
+  if(B->worn[part->slot] == NULL)
+    B->worn[part->slot] = newList();
+  return B->worn[part->slot];
+}
+
+//
+// our equipment has changed. Forget what we had cached
+void body_eq_changed(BODY_DATA *B) {
+  if(B->eq != NULL) {
+    deleteList(B->eq);
+    B->eq = NULL;
+  }
+}
+
+//
+// add a new part to the body's list and indexes, giving it the next slot.
+// The body must already have its own shape
+void body_add_part(BODY_DATA *B, BODYPART *part) {
+  part->slot = B->shape->num_slots++;
+  shape_index_part(B->shape, part);
+}
+
+//
+// take a part out of the body's list and indexes, and forget what was worn on
+// it. Does not delete it. The body must already have its own shape. The slot
+// is not reused, so that slots stay in the same order as the part list
+void body_remove_part(BODY_DATA *B, BODYPART *part) {
+  shape_parts_changed(B->shape);
+  BODY_SLOTS *slots = hashGet(B->shape->type_table, part->type);
+  if(slots != NULL)
+    bodySlotsSet(slots, part->slot, FALSE);
+  bodySlotsSet(B->occupied, part->slot, FALSE);
+  hashRemove(B->shape->part_table, part->name);
+  listRemove(B->shape->parts, part);
+  LIST *worn = body_worn(B, part);
+  if(worn != NULL) {
+    if(listSize(worn) > 0)
+      body_eq_changed(B);
+    deleteList(worn);
+    B->worn[part->slot] = NULL;
+  }
+}
+
+//
+// put a piece of equipment on a part, or take it off
+void bodypart_wear(BODY_DATA *B, BODYPART *part, OBJ_DATA *obj) {
+  listPut(body_worn_list(B, part), obj);
+  bodySlotsSet(B->occupied, part->slot, TRUE);
+  body_eq_changed(B);
+}
+
+void bodypart_unwear(BODY_DATA *B, BODYPART *part, const OBJ_DATA *obj) {
+  LIST *worn = body_worn(B, part);
+  if(worn != NULL)
+    listRemove(worn, obj);
+  if(body_num_worn(B, part) == 0)
+    bodySlotsSet(B->occupied, part->slot, FALSE);
+  body_eq_changed(B);
+}
+
 
 
 //*****************************************************************************
@@ -156,24 +438,33 @@ int bodysizeGetNum(const char *size) {
 // Removed bodyposGetName() and bodyposGetNum() - using direct string storage now
 
 BODY_DATA *newBody() {
-  struct body_data*B = malloc(sizeof(BODY_DATA));
-  B->parts = newList();
+  struct body_data*B = calloc(1, sizeof(BODY_DATA));
+  B->shape      = newBodyShape();
+  B->occupied   = newBodySlots();
 
   return B;
 }
 
 void deleteBody(BODY_DATA *B) {
-  // delete all of the bodyparts
-  deleteListWith(B->parts, deleteBodypart);
+  int slot;
+  // let go of our parts, and forget what was worn on them
+  bodyShapeRelease(B->shape);
+  for(slot = 0; slot < B->worn_slots; slot++)
+    if(B->worn[slot]) deleteList(B->worn[slot]);
+  if(B->worn) free(B->worn);
+  deleteBodySlots(B->occupied);
+  if(B->eq) deleteList(B->eq);
   // free us
   free(B);
 }
 
 BODY_DATA *bodyCopy(const BODY_DATA *B) {
-  BODY_DATA *Bnew = newBody();
-  deleteListWith(Bnew->parts, deleteBodypart);
-  Bnew->parts = listCopyWith(B->parts, bodypartCopy);
-  Bnew->size  = B->size;
+  // the copy shares our shape until one of us changes it
+  BODY_DATA *Bnew = calloc(1, sizeof(BODY_DATA));
+  Bnew->shape     = B->shape;
+  Bnew->shape->refcount++;
+  Bnew->occupied  = newBodySlots();
+  Bnew->size      = B->size;
 
   return Bnew;
 }
@@ -190,15 +481,7 @@ void bodySetSize(BODY_DATA *B, int size) {
 // Find a bodypart on the body with the given name
 //
 BODYPART *findBodypart(const BODY_DATA *B, const char *pos) {
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
-  BODYPART *part = NULL;
-
-  ITERATE_LIST(part, part_i)
-    if(!strcasecmp(part->name, pos))
-      break;
-  deleteListIterator(part_i);
-
-  return part;
+  return hashGet(B->shape->part_table, pos);
 }
 
 //
@@ -206,30 +489,39 @@ BODYPART *findBodypart(const BODY_DATA *B, const char *pos) {
 // is not yet equipped with an item
 //
 BODYPART *findFreeBodypart(BODY_DATA *B, const char *type) {
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
-  BODYPART *part = NULL;
-  ITERATE_LIST(part, part_i)
-    if(part->type && !strcasecmp(part->type, type) && listSize(part->equipment) == 0)
-      break;
-  deleteListIterator(part_i);
-
-  return part;
+  BODY_SLOTS *slots = hashGet(B->shape->type_table, type);
+  int          slot = (slots ? bodySlotsLastFree(slots, B->occupied, NULL) : -1);
+  return (slot < 0 ? NULL : shape_slot_part(B->shape, slot));
 }
 
 void bodyAddPosition(BODY_DATA *B, const char *pos, const char *type, int size) {
   BODYPART *part = findBodypart(B, pos);
 
+  // nothing would change; don't go making our own shape for it
+  if(part && part->size == size && type && !strcmp(part->type, type))
+    return;
+
+  body_own_shape(B);
+  part = findBodypart(B, pos);
+
   // if we've already found the part, just modify it
   if(part) {
+    shape_parts_changed(B->shape);
+    BODY_SLOTS *slots = hashGet(B->shape->type_table, part->type);
+    if(slots != NULL)
+      bodySlotsSet(slots, part->slot, FALSE);
     if(part->type) free(part->type);
     part->type = strdupsafe(type);
     part->size = size;
+    if((slots = hashGet(B->shape->type_table, part->type)) == NULL) {
+      slots = newBodySlots();
+      hashPut(B->shape->type_table, part->type, slots);
+    }
+    bodySlotsSet(slots, part->slot, TRUE);
   }
   // otherwise, create a new one
-  else {
-    part = newBodypart(pos, type, size);
-    listPut(B->parts, part);
-  }
+  else
+    body_add_part(B, newBodypart(pos, type, size));
 }
 
 void bodyAddPositionByName(BODY_DATA *B, const char *pos, const char *type_name, int size) {
@@ -237,12 +529,12 @@ void bodyAddPositionByName(BODY_DATA *B, const char *pos, const char *type_name,
 }
 
 bool bodyRemovePosition(BODY_DATA *B, const char *pos) {
-  BODYPART *part = findBodypart(B, pos);
-
-  if(!part)
+  if(!findBodypart(B, pos))
     return FALSE;
 
-  listRemove(B->parts, part);
+  body_own_shape(B);
+  BODYPART *part = findBodypart(B, pos);
+  body_remove_part(B, part);
   deleteBodypart(part);
   return TRUE;
 }
@@ -255,7 +547,7 @@ const char *bodyGetPart(const BODY_DATA *B, const char *pos) {
 
 
 double bodyPartRatio(const BODY_DATA *B, const char *pos) {
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
+  LIST_ITERATOR *part_i = newListIterator(B->shape->parts);
   BODYPART        *part = NULL;
   double      part_size = 0.0;
   double      body_size = 0.0;
@@ -274,7 +566,7 @@ double bodyPartRatio(const BODY_DATA *B, const char *pos) {
 
 
 const char *bodyRandPart(const BODY_DATA *B, const char *pos) {
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
+  LIST_ITERATOR *part_i = newListIterator(B->shape->parts);
   BODYPART *part = NULL;
   char     *name = NULL;
   int   size_sum = 0;
@@ -297,7 +589,7 @@ const char *bodyRandPart(const BODY_DATA *B, const char *pos) {
   pos_roll = rand_number(1, size_sum);
   
   // find the position the roll corresponds to
-  part_i = newListIterator(B->parts);
+  part_i = newListIterator(B->shape->parts);
   ITERATE_LIST(part, part_i) {
     // if we have a list of positions to draw from, only factor in those
     if(pos && *pos && !is_keyword(pos, part->name, FALSE))
@@ -313,10 +605,10 @@ const char *bodyRandPart(const BODY_DATA *B, const char *pos) {
 
 
 const char **bodyGetParts(const BODY_DATA *B, bool sort, int *num_pos) {
-  *num_pos = listSize(B->parts);
+  *num_pos = listSize(B->shape->parts);
 
   const char **parts = malloc(sizeof(char *) * *num_pos);
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
+  LIST_ITERATOR *part_i = newListIterator(B->shape->parts);
   BODYPART *part = NULL;
   int i = 0;
 
@@ -331,6 +623,65 @@ const char **bodyGetParts(const BODY_DATA *B, bool sort, int *num_pos) {
 }
 
 
+const char **bodyGetPartsOfType(const BODY_DATA *B, const char *type,
+				int *num_pos) {
+  BODY_TYPE_PARTS *parts = shape_type_parts(B->shape, type);
+  *num_pos = (parts ? parts->num : 0);
+  return (parts ? parts->names : NULL);
+}
+
+char *bodyResolvePositions(BODY_DATA *B, const char *positions) {
+  LIST      *pos_list = parse_keywords(positions);
+  BODY_SLOTS    *used = newBodySlots();
+  HASHTABLE  *unknown = newHashtable();
+  BUFFER         *buf = newBuffer(1);
+  BODYPART      *part = NULL;
+
+  LIST_ITERATOR *pos_i = newListIterator(pos_list);
+  char            *pos = NULL;
+  ITERATE_LIST(pos, pos_i) {
+    BODY_SLOTS *slots = NULL;
+    const char  *name = NULL;
+    int          slot = -1;
+
+    // parts by name are taken as they are
+    if((part = findBodypart(B, pos)) != NULL) {
+      if(!bodySlotsIn(used, part->slot))
+	name = part->name;
+    }
+    // types go to our newest free part of the type, or if all of them have
+    // something on already, the newest we haven't picked yet
+    else if((slots = hashGet(B->shape->type_table, pos)) != NULL &&
+	    shape_type_parts(B->shape, pos) != NULL) {
+      if((slot = bodySlotsLastFree(slots, used, B->occupied)) < 0)
+	slot = bodySlotsLastFree(slots, used, NULL);
+      if(slot >= 0 && (part = shape_slot_part(B->shape, slot)) != NULL)
+	name = part->name;
+    }
+    // whatever else it is, whoever is equipping us can decide
+    else if(!hashIn(unknown, pos)) {
+      hashPut(unknown, pos, NULL);
+      name = pos;
+    }
+
+    if(name != NULL) {
+      if(part != NULL)
+	bodySlotsSet(used, part->slot, TRUE);
+      if(*bufferString(buf))
+	bufferCat(buf, ", ");
+      bufferCat(buf, name);
+    }
+  } deleteListIterator(pos_i);
+
+  char *resolved = strdup(bufferString(buf));
+  deleteBuffer(buf);
+  deleteHashtable(unknown);
+  deleteBodySlots(used);
+  deleteListWith(pos_list, free);
+  return resolved;
+}
+
+
 bool bodyEquipPostypes(BODY_DATA *B, OBJ_DATA *obj, const char *types) {
   LIST  *pos_list = parse_keywords(types);
   LIST     *parts = NULL;
@@ -355,8 +706,8 @@ bool bodyEquipPostypes(BODY_DATA *B, OBJ_DATA *obj, const char *types) {
 
   ITERATE_LIST(pos, pos_i) {
     part = findFreeBodypart(B, pos);
-    if(part && listSize(part->equipment) == 0) {
-      listPut(part->equipment, obj);
+    if(part && body_num_worn(B, part) == 0) {
+      bodypart_wear(B, part, obj);
       listPut(parts, part);
     }
   } deleteListIterator(pos_i);
@@ -365,7 +716,7 @@ bool bodyEquipPostypes(BODY_DATA *B, OBJ_DATA *obj, const char *types) {
   if(listSize(pos_list) != listSize(parts)) {
     // remove equipment for every part we put it on
     while((part = listPop(parts)) != NULL)
-      listRemove(part->equipment, obj);
+      bodypart_unwear(B, part, obj);
     success = FALSE;
   }
 
@@ -397,7 +748,7 @@ bool bodyEquipPosnames(BODY_DATA *B, OBJ_DATA *obj, const char *positions) {
   char            *pos = NULL;
   ITERATE_LIST(pos, pos_i) {
     part = findBodypart(B, pos);
-    if(part && listSize(part->equipment) == 0 && !listIn(parts, part))
+    if(part && body_num_worn(B, part) == 0 && !listIn(parts, part))
       listPut(parts, part);
   } deleteListIterator(pos_i);
 
@@ -407,7 +758,7 @@ bool bodyEquipPosnames(BODY_DATA *B, OBJ_DATA *obj, const char *positions) {
 
   // fill in all of the parts that need to be filled
   while( (part = listPop(parts)) != NULL)
-    listPut(part->equipment, obj);
+    bodypart_wear(B, part, obj);
 
   // clean up our garbage
   deleteListWith(pos_list, free);
@@ -450,14 +801,14 @@ bool bodyEquipPosnamesEx(BODY_DATA *B, OBJ_DATA *obj, const char *positions,
     if(force) {
       // Force mode: always allow equipping
       can_equip = TRUE;
-    } else if(listSize(part->equipment) == 0) {
+    } else if(body_num_worn(B, part) == 0) {
       // No equipment: always allow
       can_equip = TRUE;
     } else if(equipment_type) {
       // Type filtering: check if existing equipment matches our type
       // If no existing equipment of this type, we can layer over it
       bool has_same_type = FALSE;
-      LIST_ITERATOR *eq_i = newListIterator(part->equipment);
+      LIST_ITERATOR *eq_i = newListIterator(body_worn(B, part));
       OBJ_DATA *existing_obj = NULL;
       ITERATE_LIST(existing_obj, eq_i) {
         if(objIsType(existing_obj, equipment_type)) {
@@ -485,7 +836,7 @@ bool bodyEquipPosnamesEx(BODY_DATA *B, OBJ_DATA *obj, const char *positions,
 
   // fill in all of the parts that need to be filled
   while( (part = listPop(parts)) != NULL)
-    listPut(part->equipment, obj);
+    bodypart_wear(B, part, obj);
 
   // clean up our garbage
   deleteListWith(pos_list, free);
@@ -498,12 +849,12 @@ const char *bodyEquippedWhere(BODY_DATA *B, OBJ_DATA *obj) {
   static char buf[SMALL_BUFFER];
   *buf = '\0';
 
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
+  LIST_ITERATOR *part_i = newListIterator(B->shape->parts);
   BODYPART *part = NULL;
   // go through the list of all parts, and print the name of any one
   // with the piece of equipment on it, onto the buf
   ITERATE_LIST(part, part_i) {
-    if(listIn(part->equipment, obj)) {
+    if(body_wears(B, part, obj)) {
       // if we've already printed something, add a comma
       if(*buf)
 	strcat(buf, ", ");
@@ -515,64 +866,83 @@ const char *bodyEquippedWhere(BODY_DATA *B, OBJ_DATA *obj) {
 
 LIST *bodyGetEquipment(BODY_DATA *B, const char *pos) {
   BODYPART *part = findBodypart(B, pos);
-  return (part ? part->equipment : NULL);
+  return (part ? body_worn_list(B, part) : NULL);
 }
 
 bool bodyUnequip(BODY_DATA *B, const OBJ_DATA *obj) {
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
+  LIST_ITERATOR *part_i = newListIterator(B->shape->parts);
   BODYPART      *part   = NULL;
   bool           found  = FALSE;
 
   ITERATE_LIST(part, part_i) {
-    if(listIn(part->equipment, obj)) {
-      listRemove(part->equipment, obj);
+    if(body_wears(B, part, obj)) {
+      bodypart_unwear(B, part, obj);
       found = TRUE;
     }
   } deleteListIterator(part_i);
   return found;
 }
 
-LIST *bodyGetAllEq(BODY_DATA *B) {
-  LIST *equipment = newList();
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
-  BODYPART *part = NULL;
+LIST *bodyGetEqList(BODY_DATA *B) {
+  if(B->eq == NULL) {
+    LIST_ITERATOR *part_i = newListIterator(B->shape->parts);
+    BODYPART        *part = NULL;
+    SET             *seen = newSet();
+    B->eq = newList();
+
+    ITERATE_LIST(part, part_i) {
+      if(body_num_worn(B, part) > 0) {
+	LIST_ITERATOR *eq_i = newListIterator(body_worn(B, part));
+	OBJ_DATA *obj = NULL;
+	ITERATE_LIST(obj, eq_i) {
+	  if(!setIn(seen, obj)) {
+	    setPut(seen, obj);
+	    listPut(B->eq, obj);
+	  }
+	} deleteListIterator(eq_i);
+      }
+    } deleteListIterator(part_i);
+    deleteSet(seen);
+  }
+  return B->eq;
+}
 
-  ITERATE_LIST(part, part_i) {
-    if(listSize(part->equipment) > 0) {
-      LIST_ITERATOR *eq_i = newListIterator(part->equipment);
-      OBJ_DATA *obj = NULL;
-      ITERATE_LIST(obj, eq_i) {
-        if(!listIn(equipment, obj))
-          listPut(equipment, obj);
-      } deleteListIterator(eq_i);
-    }
-  } deleteListIterator(part_i);
+LIST *bodyGetAllEq(BODY_DATA *B) {
+  LIST      *equipment = newList();
+  LIST_ITERATOR  *eq_i = newListIterator(bodyGetEqList(B));
+  OBJ_DATA        *obj = NULL;
+  ITERATE_LIST(obj, eq_i)
+    listQueue(equipment, obj);
+  deleteListIterator(eq_i);
   return equipment;
 }
 
 LIST *bodyUnequipAll(BODY_DATA *B) {
   LIST *equipment = newList();
-  LIST_ITERATOR *part_i = newListIterator(B->parts);
+  LIST_ITERATOR *part_i = newListIterator(B->shape->parts);
   BODYPART *part = NULL;
 
   ITERATE_LIST(part, part_i) {
-    if(listSize(part->equipment) > 0) {
-      LIST_ITERATOR *eq_i = newListIterator(part->equipment);
+    if(body_num_worn(B, part) > 0) {
+      LIST_ITERATOR *eq_i = newListIterator(body_worn(B, part));
       OBJ_DATA *obj = NULL;
       ITERATE_LIST(obj, eq_i) {
         if(!listIn(equipment, obj))
           listPut(equipment, obj);
       } deleteListIterator(eq_i);
       // Clear the equipment list for this part
-      deleteList(part->equipment);
-      part->equipment = newList();
+      deleteList(B->worn[part->slot]);
+      B->worn[part->slot] = NULL;
     }
   } deleteListIterator(part_i);
+  deleteBodySlots(B->occupied);
+  B->occupied = newBodySlots();
+  body_eq_changed(B);
   return equipment;
 }
 
 int numBodyparts(const BODY_DATA *B) {
-  return listSize(B->parts);
+  return listSize(B->shape->parts);
 }
 
 //*****************************************************************************
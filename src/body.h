@@ -64,7 +64,8 @@ void deleteBody(BODY_DATA *B);
 
 
 /**
- * Copy the body (minus equipment)
+ * Copy the body (minus equipment). The copy shares the original's parts
+ * until one of the two adds, changes, or removes a part, so copying is cheap
  */
 BODY_DATA *bodyCopy(const BODY_DATA *B);
 
@@ -125,6 +126,26 @@ double bodyPartRatio(const BODY_DATA *B, const char *pos);
 const char **bodyGetParts(const BODY_DATA *B, bool sort, int *num_pos);
 
 
+/**
+ * get the names of all the bodyparts of one type, in the order bodyGetParts
+ * lists them. The list is the body's own, made the first time it's asked for
+ * and kept until a part is added, changed, or removed. It must not be freed,
+ * or kept past a change to the body's parts. NULL if there are none.
+ */
+const char **bodyGetPartsOfType(const BODY_DATA *B, const char *type,
+				int *num_pos);
+
+
+/**
+ * Turn a comma-separated list of positions into a list of bodypart names.
+ * Names are kept as they are. Types become the first part of the type that
+ * has nothing on it, or if there is none, the first part of the type that
+ * isn't already in the list. Anything else is kept as it is. The string
+ * returned must be freed after use.
+ */
+char *bodyResolvePositions(BODY_DATA *B, const char *positions);
+
+
 /**
  * Equip the object to the first available, valid body positions. If
  * none exist, return false. Otherwise, return true.
@@ -181,6 +202,14 @@ LIST *bodyUnequipAll(BODY_DATA *B);
  */
 LIST *bodyGetAllEq(BODY_DATA *B);
 
+/**
+ * the same as bodyGetAllEq, but returns the body's own list instead of a
+ * copy. The list is kept until the body's equipment changes, and must not
+ * be modified or deleted. Don't equip or unequip anything while going
+ * through it.
+ */
+LIST *bodyGetEqList(BODY_DATA *B);
+
 
 /**
  * Return how many positions are on the body
@@ -15,67 +15,170 @@
 #include "mud.h"
 #include "utils.h"
 #include "buffer.h"
+#include "arena.h"
+#include "intern.h"
+#include "memstat.h"
+#include "strscan.h"
 
 
 struct buffer_data {
   char *data;   // what we're holding
   int  maxlen;  // what's the maximum storage capacity of data
   int  len;     // what's the current content length of data
+  ARENA *arena; // where our memory comes from, or NULL for malloc
+  bool shared;  // is data a shared string (see intern.h) we can't write to?
 };
 
+//
+// if we're holding onto a shared string, make our own copy of it before we
+// write anything to it
+#define buffer_writable(buf)				\
+  if((buf)->shared) buffer_unshare(buf)
+
+void buffer_unshare(BUFFER *buf) {
+  char *data  = malloc(sizeof(char) * (buf->len + 1));
+  memcpy(data, buf->data, buf->len + 1);
+  memNote(MEM_BUFFER, 0, buf->len + 1);
+  strRelease(buf->data);
+  buf->data   = data;
+  buf->maxlen = buf->len + 1;
+  buf->shared = FALSE;
+}
+
+//
+// let go of whatever we're holding onto
+void buffer_release(BUFFER *buf) {
+  if(buf->shared)
+    strRelease(buf->data);
+  else if(buf->data) {
+    memNote(MEM_BUFFER, 0, -buf->maxlen);
+    free(buf->data);
+  }
+}
+
 BUFFER    *newBuffer   (int start_capacity) {
-  BUFFER *buf = malloc(sizeof(BUFFER));
+  BUFFER *buf = memAlloc(MEM_BUFFER, sizeof(BUFFER));
   if(start_capacity <= 0) start_capacity = 1;
+  memNote(MEM_BUFFER, 0, start_capacity);
   buf->data   = malloc(sizeof(char) * start_capacity);
   *buf->data  = '\0';
   buf->maxlen = start_capacity;
   buf->len    = 0;
+  buf->arena  = NULL;
+  buf->shared = FALSE;
+  return buf;
+}
+
+BUFFER    *newBufferArena(ARENA *arena, int start_capacity) {
+  BUFFER *buf = arenaAlloc(arena, sizeof(BUFFER));
+  if(start_capacity <= 0) start_capacity = 1;
+  buf->data   = arenaAlloc(arena, sizeof(char) * start_capacity);
+  *buf->data  = '\0';
+  buf->maxlen = start_capacity;
+  buf->len    = 0;
+  buf->arena  = arena;
+  buf->shared = FALSE;
   return buf;
 }
 
 void        deleteBuffer(BUFFER *buf) {
-  if(buf->data) free(buf->data);
-  free(buf);
+  // arena buffers are freed along with their arena
+  if(buf->arena != NULL)
+    return;
+  buffer_release(buf);
+  memFree(MEM_BUFFER, buf, sizeof(BUFFER));
+}
+
+void        bufferShare (BUFFER *buf, const char *txt) {
+  // arena buffers can outlive shared strings, so they just take a copy
+  if(buf->arena != NULL) {
+    bufferClear(buf);
+    bufferCat(buf, txt);
+    return;
+  }
+  const char *data = strShare(txt);
+  buffer_release(buf);
+  buf->data   = (char *)data;
+  buf->len    = strlen(data);
+  buf->maxlen = buf->len + 1;
+  buf->shared = TRUE;
 }
 
 void        bufferExpand(BUFFER *buf, int newsize) {
-  char *newdata = malloc(sizeof(char) * newsize);
-  strcpy(newdata, buf->data);
-  free(buf->data);
+  buffer_writable(buf);
+  if(buf->arena == NULL) {
+    memNote(MEM_BUFFER, 0, newsize - buf->maxlen);
+    buf->data = realloc(buf->data, sizeof(char) * newsize);
+  }
+  // arenas can't grow things in place. Move to a new spot, and leave the
+  // old one for the arena to clean up
+  else {
+    char *data = arenaAlloc(buf->arena, sizeof(char) * newsize);
+    memcpy(data, buf->data, MIN(buf->maxlen, newsize));
+    buf->data  = data;
+  }
   buf->maxlen = newsize;
-  buf->data = newdata;
+}
+
+//
+// make sure we have room for len characters of content (plus the terminating
+// NUL). We at least double in size each time we grow, so building a buffer up
+// one piece at a time only ever copies it a handful of times
+void        bufferReserve(BUFFER *buf, int len) {
+  buffer_writable(buf);
+  if(len >= buf->maxlen)
+    bufferExpand(buf, MAX(buf->maxlen * 2, len + 1));
 }
 
 void        bufferCat   (BUFFER *buf, const char *txt) {
-  int txtlen = strlen(txt);
-  // see if we need to expand the size of the buffer
-  if(txtlen + buf->len >= buf->maxlen)
-    bufferExpand(buf, ((txtlen + buf->len) * 5) / 4 + 20); 
+  bufferCatLen(buf, txt, strlen(txt));
+}
+
+void        bufferCatLen(BUFFER *buf, const char *txt, int len) {
+  bufferReserve(buf, buf->len + len);
   // copy the new text over
-  strcat(buf->data+buf->len, txt);
-  buf->len += txtlen;
+  memcpy(buf->data+buf->len, txt, len);
+  buf->len += len;
+  buf->data[buf->len] = '\0';
 }
 
 void        bufferCatCh (BUFFER *buf, const char ch) {
-  static char tmp[2];
-  tmp[0] = ch; tmp[1] = '\0';
-  bufferCat(buf, tmp);
+  bufferReserve(buf, buf->len + 1);
+  buf->data[buf->len++] = ch;
+  buf->data[buf->len]   = '\0';
 }
 
 void        bufferClear (BUFFER *buf) {
+  // no sense copying a shared string just to throw it out
+  if(buf->shared) {
+    strRelease(buf->data);
+    memNote(MEM_BUFFER, 0, 1);
+    buf->data   = malloc(sizeof(char));
+    buf->maxlen = 1;
+    buf->shared = FALSE;
+  }
   *buf->data = '\0';
   buf->len = 0;
 }
 
 BUFFER    *bufferCopy  (BUFFER *buf) {
-  BUFFER *newbuf = newBuffer(bufferLength(buf)+1);
+  BUFFER *newbuf = newBuffer(buf->shared ? 1 : bufferLength(buf)+1);
   bufferCopyTo(buf, newbuf);
   return newbuf;
 }
 
 void        bufferCopyTo(BUFFER *from, BUFFER *to) {
+  // copies of shared text share it too
+  if(from->shared && to->arena == NULL) {
+    buffer_release(to);
+    to->data   = (char *)strInternRef(from->data);
+    to->len    = from->len;
+    to->maxlen = from->maxlen;
+    to->shared = TRUE;
+    return;
+  }
   bufferClear(to);
-  bufferCat(to, bufferString(from));
+  bufferCatLen(to, from->data, from->len);
 }
 
 const char *bufferString(BUFFER *buf) {
@@ -87,15 +190,24 @@ int         bufferLength(BUFFER *buf) {
 }
 
 int vbprintf(BUFFER *buf, const char *fmt, va_list va) {
-  static int printsize = 8192;
-  char buftmp[printsize];
-  int res = vsnprintf(buftmp, printsize, fmt, va);
+  // print straight onto our end. If there wasn't room, we now know exactly
+  // how much we need; grow, and print again
+  va_list again;
+  buffer_writable(buf);
+  va_copy(again, va);
+  int room = buf->maxlen - buf->len;
+  int  res = vsnprintf(buf->data + buf->len, room, fmt, va);
+
+  if(res >= room) {
+    bufferReserve(buf, buf->len + res);
+    vsnprintf(buf->data + buf->len, buf->maxlen - buf->len, fmt, again);
+  }
+  va_end(again);
 
-  if (res >= printsize - 1)
-    *buftmp = '\0';
+  if(res > 0)
+    buf->len += res;
   else
-    bufferCat(buf, buftmp);
-   
+    buf->data[buf->len] = '\0';
   return res;
 }
 
@@ -113,6 +225,7 @@ int bufferReplace(BUFFER *buf, const char *a, const char *b, int all) {
   int len_needed = buf->maxlen;
   int replaced = 0;
 
+  buffer_writable(buf);
   // Handle edge case: if search string is empty, do nothing
   if (a_len == 0) {
     return 0;
@@ -168,10 +281,8 @@ int bufferReplace(BUFFER *buf, const char *a, const char *b, int all) {
     buf->len = tmp_i;
   }
   else {
-    free(buf->data);
-    buf->data = malloc(len_needed);
+    bufferExpand(buf, len_needed);
     strcpy(buf->data, buftmp);
-    buf->maxlen = len_needed;
     buf->len    = tmp_i;
   }
 
@@ -182,8 +293,7 @@ int bufferReplace(BUFFER *buf, const char *a, const char *b, int all) {
 int bufferInsert(BUFFER *buf, const char *newline, int line) {
   // first, check if we'll need to expand the size of the buffer
   int line_len = strlen(newline);
-  if(line_len + buf->len + 2 >= buf->maxlen) // +2 for \r\n
-    bufferExpand(buf, ((line_len + buf->len + 2) * 5)/4 + 20);
+  bufferReserve(buf, line_len + buf->len + 2); // +2 for \r\n
 
   // insert it in
   char *start = line_start(buf->data, line);
@@ -200,6 +310,7 @@ int bufferInsert(BUFFER *buf, const char *newline, int line) {
 }
 
 int bufferRemove(BUFFER *buf, int line) {
+  buffer_writable(buf);
   char *start = line_start(buf->data, line);
   if(start == NULL) 
     return FALSE;
@@ -238,15 +349,102 @@ void bufferFormatFromPy(BUFFER *buf) {
   bufferReplace(buf, "\\\"", "\"", TRUE);
 }
 
+//
+// formatting the same text the same way over and over (descriptions, every
+// time they are looked at) is common, so results are kept in a small
+// direct-mapped cache keyed by the text and how it was formatted. Texts longer
+// than FORMAT_CACHE_MAX_LEN aren't kept
+#define FORMAT_CACHE_SIZE      256
+#define FORMAT_CACHE_MAX_LEN  8192
+
+typedef struct {
+  char     *src; // what we were given
+  int     width; // and how we formatted it
+  int    indent;
+  char     *out; // what it became
+  int   out_len;
+} FORMAT_ENTRY;
+
+FORMAT_ENTRY format_cache[FORMAT_CACHE_SIZE];
+
+//
+// where we are in the word bufferFormat is working through, so how wide the
+// rest of it is can be found without rescanning the word at every character
+typedef struct {
+  int   end; // where the word ends: the next whitespace, or the end of text
+  int   pos; // the position width is measured from
+  int width; // how many columns are from pos to end, not counting colour codes
+} WORD_CURSOR;
+
+//
+// how many columns does the character at pos take up? Colour codes don't
+// take up any
+#define format_char_width(data, pos)					\
+  ((data)[pos] == '{' || ((pos) > 0 && (data)[(pos)-1] == '{') ? 0 : 1)
+
+//
+// how wide is the rest of the word the text at pos is in?
+int format_word_width(const char *data, WORD_CURSOR *cur, int pos) {
+  // we've moved past the last word. Find the end of the next one
+  if(pos > cur->end) {
+    cur->end   = cur->pos = pos;
+    cur->width = 0;
+    for(; data[cur->end] != '\0' && !isspace(data[cur->end]); cur->end++)
+      cur->width += format_char_width(data, cur->end);
+  }
+  for(; cur->pos < pos; cur->pos++)
+    cur->width -= format_char_width(data, cur->pos);
+  return cur->width;
+}
+
+//
+// If a new paragraph starts at index, return where its text starts. Otherwise
+// return index. Whitespace we've already found holds no paragraph break is
+// remembered in checked_to, so runs of it are only scanned once
+int format_paragraph_at(const char *data, int index, int *checked_to) {
+  if(index < *checked_to || !isspace(data[index]))
+    return index;
+  int i = scan_skip_space(data + index) - data;
+  if(scan_count(data + index, i - index, '\n') > 1)
+    return i;
+  *checked_to = i;
+  return index;
+}
+
+//
+// copy a finished format into the buffer
+void buffer_set_formatted(BUFFER *buf, const char *formatted, int len) {
+  bufferReserve(buf, len);
+  memcpy(buf->data, formatted, len + 1);
+  buf->len = len;
+}
+
 void bufferFormat(BUFFER *buf, int max_width, int indent) {
-  // Ensure minimum buffer size to prevent zero-length array
+  // have we formatted this text this way before?
+  FORMAT_ENTRY *entry = NULL;
+  if(buf->len <= FORMAT_CACHE_MAX_LEN) {
+    unsigned long long hash = 14695981039346656037ULL;
+    int i;
+    for(i = 0; i < buf->len; i++)
+      hash = (hash ^ (unsigned char)buf->data[i]) * 1099511628211ULL;
+    hash  = (hash ^ (unsigned int)max_width) * 1099511628211ULL;
+    hash  = (hash ^ (unsigned int)indent)    * 1099511628211ULL;
+    entry = &format_cache[hash % FORMAT_CACHE_SIZE];
+    if(entry->src != NULL && entry->width == max_width && 
+       entry->indent == indent && !strcmp(entry->src, buf->data)) {
+      buffer_set_formatted(buf, entry->out, entry->out_len);
+      return;
+    }
+  }
+
   // Account for potential indent space and formatting overhead
-  int formatted_size = (buf->len * 3) / 2 + indent + 100;
-  if (formatted_size < 100) formatted_size = 100;
-  char formatted[formatted_size];
+  int formatted_size = buf->len * 3 + indent + 100;
+  char *formatted = malloc(formatted_size);
   bool needs_capital = TRUE, needs_indent = FALSE;
   bool preserve_formatting = FALSE;
-  int fmt_i = 0, buf_i = 0, col = 0, next_space = 0;
+  int fmt_i = 0, buf_i = 0, col = 0, next_space = 0, para_checked = 0;
+  WORD_CURSOR word = { -1, 0, 0 };
+  buffer_writable(buf);
 
   // check for preserve formatting prefix @@@
   if(buf->len >= 3 && strncmp(buf->data, "@@@", 3) == 0) {
@@ -273,9 +471,7 @@ void bufferFormat(BUFFER *buf, int max_width, int indent) {
     // we have to put a newline in because the word won't fit on the line
     // (but only do word-wrapping if not preserving formatting)
     if(!preserve_formatting) {
-      next_space = next_space_in(buf->data + buf_i);
-      if(next_space == -1)
-        next_space = buf->len - buf_i;
+      next_space = format_word_width(buf->data, &word, buf_i);
       if(col + next_space > max_width-1) {
         formatted[fmt_i] = '\r'; fmt_i++;
         formatted[fmt_i] = '\n'; fmt_i++;
@@ -287,7 +483,8 @@ void bufferFormat(BUFFER *buf, int max_width, int indent) {
     int para_start = -1;
 
     // try to preserve our paragraph structure
-    if((para_start = is_paragraph_marker(buf->data, buf_i)) > buf_i) {
+    if((para_start = format_paragraph_at(buf->data, buf_i, &para_checked)) >
+       buf_i) {
       formatted[fmt_i] = '\r'; fmt_i++;
       formatted[fmt_i] = '\n'; fmt_i++;
       formatted[fmt_i] = '\r'; fmt_i++;
@@ -336,9 +533,7 @@ void bufferFormat(BUFFER *buf, int max_width, int indent) {
       // check if indenting will make it so we don't
       // have enough room to print the word. If that's the
       // case, then skip down to a new line instead
-      next_space = next_space_in(buf->data + buf_i);
-      if(next_space == -1)
-	next_space = buf->len - buf_i;
+      next_space = format_word_width(buf->data, &word, buf_i);
       if(col + 2 + next_space > max_width-1) {
 	formatted[fmt_i] = '\r'; fmt_i++;
 	formatted[fmt_i] = '\n'; fmt_i++;
@@ -382,11 +577,16 @@ void bufferFormat(BUFFER *buf, int max_width, int indent) {
     fmt_i = 0;
   }
 
-  // make sure we have enough room to copy everything over
-  if(fmt_i >= buf->maxlen)
-    bufferExpand(buf, (fmt_i * 5)/4 + 20);
-  
-  // copy over our changes
-  strcpy(buf->data, formatted);
-  buf->len = fmt_i;
+  // remember what we became, and copy over our changes
+  if(entry != NULL) {
+    if(entry->src) free(entry->src);
+    if(entry->out) free(entry->out);
+    entry->src     = strdup(buf->data);
+    entry->width   = max_width;
+    entry->indent  = indent;
+    entry->out     = strdup(formatted);
+    entry->out_len = fmt_i;
+  }
+  buffer_set_formatted(buf, formatted, fmt_i);
+  free(formatted);
 }
@@ -10,16 +10,31 @@
 //*****************************************************************************
 
 typedef struct buffer_data BUFFER;
+struct arena;
 
 // allocate/deallocate a buffer. start capacity must be supplied, but the
 // buffer can grow indefinitely.
 BUFFER *newBuffer(int start_capacity);
 void deleteBuffer(BUFFER *buf);
 
+// allocate a buffer from an arena (see arena.h). deleteBuffer does nothing to
+// it; it is freed along with the memory it came from, so it must not outlive
+// the arena mark it was made under
+BUFFER *newBufferArena(struct arena *arena, int start_capacity);
+
+// set the buffer's contents to a shared copy of txt (see strShare in
+// intern.h). Buffers holding the same shared text, and copies of them, all
+// point at one copy of it. The first time the buffer is written to, it
+// makes its own copy to write to
+void        bufferShare (BUFFER *buf, const char *txt);
+
 // concatinate the text to the end of the buffer
 void        bufferCat   (BUFFER *buf, const char *txt);
 void        bufferCatCh (BUFFER *buf, const char ch);
 
+// concatinate the first len characters of txt to the end of the buffer
+void        bufferCatLen(BUFFER *buf, const char *txt, int len);
+
 // clear the buffer's contents
 void bufferClear(BUFFER *buf);
 
@@ -38,7 +53,8 @@ int bufferLength(BUFFER *buf);
 // do a formatted print onto the buffer (concats it)
 int bprintf(BUFFER *buf, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
 
-// bprintf with a variable list and format supplied
+// bprintf with a variable list and format supplied. Output is never
+// truncated; the buffer grows to fit whatever is printed
 int vbprintf(BUFFER *buf, const char *fmt, va_list va);
 
 // replace 'a' with 'b'. Return back how many occurences were replaced. If
@@ -56,7 +72,11 @@ int bufferRemove(BUFFER *buf, int line);
 // successful and FALSE otherwise.
 int bufferReplaceLine(BUFFER *buf, const char *newline, int line);
 
-// format a string with the given arguments
+// format the buffer's text into a description: wrapped to max_width columns
+// (colour codes take up none), sentences capitalized, and the first line
+// indented by indent spaces. Text that starts with @@@ keeps its own line
+// breaks. Runs in time linear in the text, and recently formatted text comes
+// out of a cache
 void bufferFormat(BUFFER *buf, int max_width, int indent);
 
 // format our buffer to be a viable Python string
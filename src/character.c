@@ -11,13 +11,19 @@
 // IS STRONGLY SUGGESTED YOU DO SO THROUGH AUXILIARY DATA (see auxiliary.h).
 //
 //*****************************************************************************
+#include <stddef.h>
+
 #include "mud.h"
 #include "utils.h"
+#include "intern.h"
+#include "memstat.h"
 #include "body.h"
 #include "races.h"
 #include "auxiliary.h"
 #include "storage.h"
 #include "character.h"
+#include "socket.h"
+#include "stats.h"
 
 const char *sex_names[NUM_SEXES] = {
   "male",
@@ -82,61 +88,118 @@ int poscmp(int pos1, int pos2) {
 }
 
 
+//
+// appearance customization. Most characters never have any of it set, so it
+// is kept out of the way, and only made the first time some of it is. The
+// strings are shared (see strShare), and come first, from hair_color to
+// beard_style, so they can be gone through in order
+typedef struct {
+  const char * hair_color;
+  const char * hair_style;
+  const char * fur_color;
+  const char * feather_color;
+  const char * scale_color;
+  const char * scale_marking;
+  const char * marking_color;
+  const char * tail_style;
+  const char * mane_style;
+  const char * build;
+  const char * skin_tone;
+  const char * eye_color;
+  const char * eye_color_right;
+  const char * beard_style;
+  int          heterochromia;
+} CHAR_LOOKS;
+
 struct char_data {
-  // data for PCs only
-  char                 * loadroom;
-  char                 * hair_color;
-  char                 * hair_style;
-  char                 * fur_color;
-  char                 * feather_color;
-  char                 * scale_color;
-  char                 * scale_marking;
-  char                 * marking_color;
-  char                 * tail_style;
-  char                 * mane_style;
-  char                 * build;
-  char                 * skin_tone;
-  char                 * eye_color;
-  char                 * eye_color_right;
-  int                    heterochromia;
-  char                 * beard_style;
-  // shared data for PCs and NPCs
+  // what the game looks at every pulse, kept together at the front
+  ROOM_DATA            * room;
+  LIST_NODE            * room_node;
+  SOCKET_DATA          * socket;
+  LIST                 * inventory;
+  OBJ_DATA             * furniture;
+  BODY_DATA            * body;
+  AUX_TABLE            * auxiliary_data;
+  int                    position;
+  int                    hidden;
   int                    uid;
-  time_t                 birth;
+  int                    sex;
+  const char           * name;
+  const char           * keywords;
+  const char           * prototypes;
+  const char           * class;
+  BITVECTOR            * bits;
+  BITVECTOR            * prfs;
+  BITVECTOR            * user_groups;
+  LIST_NODE            * game_node;
+  bool                   extracted;
 
-  BODY_DATA            * body;
+  // the rest of the data shared by PCs and NPCs
+  time_t                 birth;
   char                 * race;
-  char                 * prototypes;
-  char                 * class;
-
-  SOCKET_DATA          * socket;
-  ROOM_DATA            * room;
   ROOM_DATA            * last_room;
-  OBJ_DATA             * furniture;
   BUFFER               * desc;
   BUFFER               * look_buf;
-  char                 * name;
-  int                    sex;
-  int                    position;
-  int                    hidden;
   double                 weight;
-
-  LIST                 * inventory;
-  AUX_TABLE            * auxiliary_data;
-  BITVECTOR            * prfs;
-  BITVECTOR            * bits;
-  BITVECTOR            * user_groups;
+  double                 carried;  // inventory and equipment, contents and all
+  CHAR_LOOKS           * looks;
 
   // data for NPCs only
-  char                 * rdesc;
-  char                 * multi_name;
-  char                 * multi_rdesc;
-  char                 * keywords;
+  const char           * rdesc;
+  const char           * multi_name;
+  const char           * multi_rdesc;
+
+  // data for PCs only
+  char                 * loadroom;
+
+  // the next deleted character waiting to be made again
+  CHAR_DATA            * next_free;
 };
 
 
+//
+// deleted characters are kept around to be made again, with their lists,
+// bits, and buffers still allocated
+#define MAX_FREE_CHARS      256
+CHAR_DATA *free_chars = NULL;
+int    num_free_chars = 0;
+
 CHAR_DATA *newChar() {
-  CHAR_DATA *ch   = calloc(1, sizeof(CHAR_DATA));
+  CHAR_DATA *ch = free_chars;
+  if(ch != NULL) {
+    free_chars = ch->next_free;
+    num_free_chars--;
+    memNote(MEM_CHAR_POOL, -1, -(long long)sizeof(CHAR_DATA));
+    memNote(MEM_CHAR,       1,  sizeof(CHAR_DATA));
+
+    LIST     *inventory = ch->inventory;
+    BUFFER        *desc = ch->desc;
+    BUFFER    *look_buf = ch->look_buf;
+    BITVECTOR     *prfs = ch->prfs;
+    BITVECTOR     *bits = ch->bits;
+    BITVECTOR   *groups = ch->user_groups;
+    memset(ch, 0, sizeof(CHAR_DATA));
+    ch->inventory   = inventory;
+    ch->desc        = desc;
+    ch->look_buf    = look_buf;
+    ch->prfs        = prfs;
+    ch->bits        = bits;
+    ch->user_groups = groups;
+    bufferClear(desc);
+    bufferClear(look_buf);
+    bitClear(prfs);
+    bitClear(bits);
+    bitClear(groups);
+  }
+  else {
+    ch = memCalloc(MEM_CHAR, sizeof(CHAR_DATA));
+    ch->desc        = newBuffer(1);
+    ch->look_buf    = newBuffer(1);
+    ch->inventory   = newList();
+    ch->prfs        = bitvectorInstanceOf("char_prfs");
+    ch->bits        = bitvectorInstanceOf("char_bits");
+    ch->user_groups = bitvectorInstanceOf("user_groups");
+  }
 
   ch->loadroom      = strdup("");
   ch->uid           = NOBODY;
@@ -148,22 +211,16 @@ CHAR_DATA *newChar() {
   ch->last_room     = NULL;
   ch->furniture     = NULL;
   ch->socket        = NULL;
-  ch->desc          = newBuffer(1);
-  ch->look_buf      = newBuffer(1);
-  ch->name          = strdup("");
+  ch->name          = strShare("");
   ch->sex           = SEX_NEUTRAL;
   ch->position      = POS_STANDING;
-  ch->inventory     = newList();
-
-  ch->class         = strdup("");
-  ch->prototypes    = strdup("");
-  ch->rdesc         = strdup("");
-  ch->keywords      = strdup("");
-  ch->multi_rdesc   = strdup("");
-  ch->multi_name    = strdup("");
-  ch->prfs          = bitvectorInstanceOf("char_prfs");
-  ch->bits          = bitvectorInstanceOf("char_bits");
-  ch->user_groups   = bitvectorInstanceOf("user_groups");
+
+  ch->class         = strIntern("");
+  ch->prototypes    = strIntern("");
+  ch->rdesc         = strShare("");
+  ch->keywords      = strShare("");
+  ch->multi_rdesc   = strShare("");
+  ch->multi_name    = strShare("");
   bitSet(ch->user_groups, DFLT_USER_GROUP);
 
   ch->auxiliary_data = newAuxiliaryData(AUXILIARY_TYPE_CHAR);
@@ -177,22 +234,25 @@ CHAR_DATA *newChar() {
 // utility functions
 //*****************************************************************************
 void charSetRdesc(CHAR_DATA *ch, const char *rdesc) {
-  if(ch->rdesc) free(ch->rdesc);
-  ch->rdesc =   strdupsafe(rdesc);
+  const char *old = ch->rdesc;
+  ch->rdesc = strShare(rdesc);
+  strRelease(old);
 }
 
 void charSetMultiRdesc(CHAR_DATA *ch, const char *multi_rdesc) {
-  if(ch->multi_rdesc) free(ch->multi_rdesc);
-  ch->multi_rdesc =   strdupsafe(multi_rdesc);
+  const char *old = ch->multi_rdesc;
+  ch->multi_rdesc = strShare(multi_rdesc);
+  strRelease(old);
 }
 
 void charSetMultiName(CHAR_DATA *ch, const char *multi_name) {
-  if(ch->multi_name) free(ch->multi_name);
-  ch->multi_name =   strdupsafe(multi_name);
+  const char *old = ch->multi_name;
+  ch->multi_name = strShare(multi_name);
+  strRelease(old);
 }
 
 bool charIsInstance(CHAR_DATA *ch, const char *prototype) {
-  return is_keyword(ch->prototypes, prototype, FALSE);
+  return strInternHasWord(ch->prototypes, strInternFind(prototype));
 }
 
 bool charIsNPC( CHAR_DATA *ch) {
@@ -201,7 +261,7 @@ bool charIsNPC( CHAR_DATA *ch) {
 
 bool charIsName( CHAR_DATA *ch, const char *name) {
   if(charIsNPC(ch))
-    return is_keyword(ch->keywords, name, TRUE);
+    return strIsKeyword(ch->keywords, name, TRUE);
   else
     return !strncasecmp(ch->name, name, strlen(name));
 }
@@ -226,6 +286,18 @@ ROOM_DATA *charGetLastRoom(CHAR_DATA *ch) {
   return ch->last_room;
 }
 
+LIST_NODE *charGetRoomNode(CHAR_DATA *ch) {
+  return ch->room_node;
+}
+
+LIST_NODE *charGetGameNode(CHAR_DATA *ch) {
+  return ch->game_node;
+}
+
+bool charIsExtracted(CHAR_DATA *ch) {
+  return ch->extracted;
+}
+
 const char *charGetClass(CHAR_DATA *ch) {
   return ch->class;
 }
@@ -265,138 +337,159 @@ const char  *charGetMultiName( CHAR_DATA *ch) {
 
 
 // Appearance functions
+
+//
+// get a character's appearance, making it if it doesn't exist yet
+CHAR_LOOKS *charGetLooksMade(CHAR_DATA *ch) {
+  if(ch->looks == NULL) {
+    ch->looks = memCalloc(MEM_CHAR_LOOKS, sizeof(CHAR_LOOKS));
+    const char **str = &ch->looks->hair_color;
+    for(; str <= &ch->looks->beard_style; str++)
+      *str = strShare("");
+  }
+  return ch->looks;
+}
+
+void deleteCharLooks(CHAR_LOOKS *looks) {
+  const char **str = &looks->hair_color;
+  for(; str <= &looks->beard_style; str++)
+    strRelease(*str);
+  memFree(MEM_CHAR_LOOKS, looks, sizeof(CHAR_LOOKS));
+}
+
+//
+// set one of the strings of a character's appearance. Setting a string to
+// nothing doesn't make the appearance if it isn't there yet
+void charSetLook(CHAR_DATA *ch, size_t offset, const char *val) {
+  if(ch->looks == NULL && (val == NULL || !*val))
+    return;
+  const char **str = (const char **)((char *)charGetLooksMade(ch) + offset);
+  const char  *old = *str;
+  *str = strShare(val ? val : "");
+  strRelease(old);
+}
+
+#define CHAR_LOOK(ch, field) ((ch)->looks ? (ch)->looks->field : "")
+
 void charSetHairColor(CHAR_DATA *ch, const char *color) {
-  if(ch->hair_color) free(ch->hair_color);
-  ch->hair_color = strdupsafe(color);
+  charSetLook(ch, offsetof(CHAR_LOOKS, hair_color), color);
 }
 
 const char *charGetHairColor(CHAR_DATA *ch) {
-  return ch->hair_color;
+  return CHAR_LOOK(ch, hair_color);
 }
 
 void charSetHairStyle(CHAR_DATA *ch, const char *style) {
-  if(ch->hair_style) free(ch->hair_style);
-  ch->hair_style = strdupsafe(style);
+  charSetLook(ch, offsetof(CHAR_LOOKS, hair_style), style);
 }
 
 const char *charGetHairStyle(CHAR_DATA *ch) {
-  return ch->hair_style;
+  return CHAR_LOOK(ch, hair_style);
 }
 
 void charSetFurColor(CHAR_DATA *ch, const char *color) {
-  if(ch->fur_color) free(ch->fur_color);
-  ch->fur_color = strdupsafe(color);
+  charSetLook(ch, offsetof(CHAR_LOOKS, fur_color), color);
 }
 
 const char *charGetFurColor(CHAR_DATA *ch) {
-  return ch->fur_color;
+  return CHAR_LOOK(ch, fur_color);
 }
 
 void charSetFeatherColor(CHAR_DATA *ch, const char *color) {
-  if(ch->feather_color) free(ch->feather_color);
-  ch->feather_color = strdupsafe(color);
+  charSetLook(ch, offsetof(CHAR_LOOKS, feather_color), color);
 }
 
 const char *charGetFeatherColor(CHAR_DATA *ch) {
-  return ch->feather_color;
+  return CHAR_LOOK(ch, feather_color);
 }
 
 void charSetScaleColor(CHAR_DATA *ch, const char *color) {
-  if(ch->scale_color) free(ch->scale_color);
-  ch->scale_color = strdupsafe(color);
+  charSetLook(ch, offsetof(CHAR_LOOKS, scale_color), color);
 }
 
 const char *charGetScaleColor(CHAR_DATA *ch) {
-  return ch->scale_color;
+  return CHAR_LOOK(ch, scale_color);
 }
 
 void charSetScaleMarking(CHAR_DATA *ch, const char *marking) {
-  if(ch->scale_marking) free(ch->scale_marking);
-  ch->scale_marking = strdupsafe(marking);
+  charSetLook(ch, offsetof(CHAR_LOOKS, scale_marking), marking);
 }
 
 const char *charGetScaleMarking(CHAR_DATA *ch) {
-  return ch->scale_marking;
+  return CHAR_LOOK(ch, scale_marking);
 }
 
 void charSetMarkingColor(CHAR_DATA *ch, const char *color) {
-  if(ch->marking_color) free(ch->marking_color);
-  ch->marking_color = strdupsafe(color);
+  charSetLook(ch, offsetof(CHAR_LOOKS, marking_color), color);
 }
 
 const char *charGetMarkingColor(CHAR_DATA *ch) {
-  return ch->marking_color;
+  return CHAR_LOOK(ch, marking_color);
 }
 
 void charSetTailStyle(CHAR_DATA *ch, const char *style) {
-  if(ch->tail_style) free(ch->tail_style);
-  ch->tail_style = strdupsafe(style);
+  charSetLook(ch, offsetof(CHAR_LOOKS, tail_style), style);
 }
 
 const char *charGetTailStyle(CHAR_DATA *ch) {
-  return ch->tail_style;
+  return CHAR_LOOK(ch, tail_style);
 }
 
 void charSetManeStyle(CHAR_DATA *ch, const char *style) {
-  if(ch->mane_style) free(ch->mane_style);
-  ch->mane_style = strdupsafe(style);
+  charSetLook(ch, offsetof(CHAR_LOOKS, mane_style), style);
 }
 
 const char *charGetManeStyle(CHAR_DATA *ch) {
-  return ch->mane_style;
+  return CHAR_LOOK(ch, mane_style);
 }
 
 void charSetBuild(CHAR_DATA *ch, const char *build) {
-  if(ch->build) free(ch->build);
-  ch->build = strdupsafe(build);
+  charSetLook(ch, offsetof(CHAR_LOOKS, build), build);
 }
 
 const char *charGetBuild(CHAR_DATA *ch) {
-  return ch->build;
+  return CHAR_LOOK(ch, build);
 }
 
 void charSetSkinTone(CHAR_DATA *ch, const char *tone) {
-  if(ch->skin_tone) free(ch->skin_tone);
-  ch->skin_tone = strdupsafe(tone);
+  charSetLook(ch, offsetof(CHAR_LOOKS, skin_tone), tone);
 }
 
 const char *charGetSkinTone(CHAR_DATA *ch) {
-  return ch->skin_tone;
+  return CHAR_LOOK(ch, skin_tone);
 }
 
 void charSetEyeColor(CHAR_DATA *ch, const char *color) {
-  if(ch->eye_color) free(ch->eye_color);
-  ch->eye_color = strdupsafe(color);
+  charSetLook(ch, offsetof(CHAR_LOOKS, eye_color), color);
 }
 
 const char *charGetEyeColor(CHAR_DATA *ch) {
-  return ch->eye_color;
+  return CHAR_LOOK(ch, eye_color);
 }
 
 void charSetEyeColorRight(CHAR_DATA *ch, const char *color) {
-  if(ch->eye_color_right) free(ch->eye_color_right);
-  ch->eye_color_right = strdupsafe(color);
+  charSetLook(ch, offsetof(CHAR_LOOKS, eye_color_right), color);
 }
 
 const char *charGetEyeColorRight(CHAR_DATA *ch) {
-  return ch->eye_color_right;
+  return CHAR_LOOK(ch, eye_color_right);
 }
 
 void charSetHeterochromia(CHAR_DATA *ch, int heterochromia) {
-  ch->heterochromia = heterochromia;
+  if(ch->looks != NULL || heterochromia != 0)
+    charGetLooksMade(ch)->heterochromia = heterochromia;
 }
 
 int charGetHeterochromia(CHAR_DATA *ch) {
-  return ch->heterochromia;
+  return (ch->looks ? ch->looks->heterochromia : 0);
 }
 
 void charSetBeardStyle(CHAR_DATA *ch, const char *style) {
-  if(ch->beard_style) free(ch->beard_style);
-  ch->beard_style = strdupsafe(style);
+  charSetLook(ch, offsetof(CHAR_LOOKS, beard_style), style);
 }
 
 const char *charGetBeardStyle(CHAR_DATA *ch) {
-  return ch->beard_style;
+  return CHAR_LOOK(ch, beard_style);
 }
 
 int charGetSex(CHAR_DATA *ch) {
@@ -415,6 +508,10 @@ double charGetWeight(const CHAR_DATA *ch) {
   return ch->weight;
 }
 
+double charGetCarriedWeight(const CHAR_DATA *ch) {
+  return ch->carried;
+}
+
 BODY_DATA *charGetBody(CHAR_DATA *ch) {
   return ch->body;
 }
@@ -439,6 +536,10 @@ void *charGetAuxiliaryData(const CHAR_DATA *ch, const char *name) {
   return auxiliaryGet(ch->auxiliary_data, name);
 }
 
+void *charGetAuxiliarySlot(const CHAR_DATA *ch, int slot) {
+  return auxiliaryGetSlot(ch->auxiliary_data, slot);
+}
+
 OBJ_DATA *charGetFurniture(CHAR_DATA *ch) {
   return ch->furniture;
 }
@@ -457,33 +558,53 @@ BITVECTOR *charGetUserGroups(CHAR_DATA *ch) {
 
 void         charSetSocket    ( CHAR_DATA *ch, SOCKET_DATA *socket) {
   ch->socket = socket;
+  socketIndexChanged();
 }
 
 void         charSetRoom      ( CHAR_DATA *ch, ROOM_DATA *room) {
   ch->room   = room;
+  sightChanged();
 }
 
 void charSetLastRoom(CHAR_DATA *ch, ROOM_DATA *room) {
   ch->last_room = room;
 }
 
+void charSetRoomNode(CHAR_DATA *ch, LIST_NODE *node) {
+  ch->room_node = node;
+}
+
+void charSetGameNode(CHAR_DATA *ch, LIST_NODE *node) {
+  ch->game_node = node;
+}
+
+void charSetExtracted(CHAR_DATA *ch, bool extracted) {
+  ch->extracted = extracted;
+}
+
 void charSetClass(CHAR_DATA *ch, const char *prototype) {
-  if(ch->class) free(ch->class);
-  ch->class = strdupsafe(prototype);
+  const char *old = ch->class;
+  ch->class = strIntern(prototype);
+  strRelease(old);
 }
 
 void charSetPrototypes(CHAR_DATA *ch, const char *prototypes) {
-  if(ch->prototypes) free(ch->prototypes);
-  ch->prototypes = strdupsafe(prototypes);
+  const char *old = ch->prototypes;
+  ch->prototypes = strIntern(prototypes);
+  strRelease(old);
 }
 
 void charAddPrototype(CHAR_DATA *ch, const char *prototype) {
-  add_keyword(&ch->prototypes, prototype);
+  char *prototypes = strdup(ch->prototypes);
+  add_keyword(&prototypes, prototype);
+  charSetPrototypes(ch, prototypes);
+  free(prototypes);
 }
 
 void         charSetName      ( CHAR_DATA *ch, const char *name) {
-  if(ch->name) free(ch->name);
-  ch->name = strdupsafe(name);
+  const char *old = ch->name;
+  ch->name = strShare(name);
+  strRelease(old);
 }
 
 void         charSetSex       ( CHAR_DATA *ch, int sex) {
@@ -492,19 +613,32 @@ void         charSetSex       ( CHAR_DATA *ch, int sex) {
 
 void         charSetPos       ( CHAR_DATA *ch, int pos) {
   ch->position = pos;
+  charForgetDerivedOn(ch, DERIVED_ON_POSITION);
+  sightChanged();
 }
 
 void         charSetHidden    ( CHAR_DATA *ch, int amnt) {
   ch->hidden = amnt;
+  sightChanged();
 }
 
 void charSetWeight(CHAR_DATA *ch, double amnt) {
   ch->weight = amnt;
 }
 
+void charAddCarriedWeight(CHAR_DATA *ch, double amnt) {
+  ch->carried += amnt;
+  // once everything is gone, what's left should be nothing, not rounding error
+  if(ch->carried > -1e-9 && ch->carried < 1e-9)
+    ch->carried = 0;
+}
+
+void         charSetBirth     ( CHAR_DATA *ch, time_t birth) {
+  ch->birth = birth;
+}
+
 void         charSetDesc      ( CHAR_DATA *ch, const char *desc) {
-  bufferClear(ch->desc);
-  bufferCat(ch->desc, (desc ? desc : ""));
+  bufferShare(ch->desc, desc);
 }
 
 void         charSetBody      ( CHAR_DATA *ch, BODY_DATA *body) {
@@ -553,25 +687,38 @@ void deleteChar( CHAR_DATA *mob) {
   // it is assumed we've already unequipped
   // all of the items that are on our body (extract_char)
   if(mob->body) deleteBody(mob->body);
-  // it's also assumed we've extracted our inventory
-  deleteList(mob->inventory);
-
-  if(mob->class)       free(mob->class);
-  if(mob->prototypes)  free(mob->prototypes);
-  if(mob->name)        free(mob->name);
-  if(mob->desc)        deleteBuffer(mob->desc);
-  if(mob->look_buf)    deleteBuffer(mob->look_buf);
-  if(mob->rdesc)       free(mob->rdesc);
-  if(mob->multi_rdesc) free(mob->multi_rdesc);
-  if(mob->multi_name)  free(mob->multi_name);
-  if(mob->keywords)    free(mob->keywords);
+
+  strRelease(mob->class);
+  strRelease(mob->prototypes);
+  strRelease(mob->name);
+  strRelease(mob->rdesc);
+  strRelease(mob->multi_rdesc);
+  strRelease(mob->multi_name);
+  strRelease(mob->keywords);
   if(mob->loadroom)    free(mob->loadroom);
+  if(mob->looks)       deleteCharLooks(mob->looks);
   if(mob->race)        free(mob->race);
-  if(mob->prfs)        deleteBitvector(mob->prfs);
-  if(mob->user_groups) deleteBitvector(mob->user_groups);
   deleteAuxiliaryData(mob->auxiliary_data);
 
-  free(mob);
+  // it's also assumed we've extracted our inventory
+  if(num_free_chars < MAX_FREE_CHARS) {
+    while(listPop(mob->inventory) != NULL)
+      ;
+    mob->next_free = free_chars;
+    free_chars     = mob;
+    num_free_chars++;
+    memNote(MEM_CHAR,     -1, -(long long)sizeof(CHAR_DATA));
+    memNote(MEM_CHAR_POOL, 1,  sizeof(CHAR_DATA));
+  }
+  else {
+    deleteList(mob->inventory);
+    deleteBuffer(mob->desc);
+    deleteBuffer(mob->look_buf);
+    deleteBitvector(mob->prfs);
+    deleteBitvector(mob->bits);
+    deleteBitvector(mob->user_groups);
+    memFree(MEM_CHAR, mob, sizeof(CHAR_DATA));
+  }
 }
 
 
@@ -657,22 +804,24 @@ STORAGE_SET *charStore(CHAR_DATA *mob) {
   store_double(set, "weight",     mob->weight);
   store_long  (set, "birth",      mob->birth);
   
-  // Appearance customization
-  store_string(set, "hair_color",      mob->hair_color);
-  store_string(set, "hair_style",      mob->hair_style);
-  store_string(set, "fur_color",       mob->fur_color);
-  store_string(set, "feather_color",   mob->feather_color);
-  store_string(set, "scale_color",     mob->scale_color);
-  store_string(set, "scale_marking",   mob->scale_marking);
-  store_string(set, "marking_color",   mob->marking_color);
-  store_string(set, "tail_style",      mob->tail_style);
-  store_string(set, "mane_style",      mob->mane_style);
-  store_string(set, "build",           mob->build);
-  store_string(set, "skin_tone",       mob->skin_tone);
-  store_string(set, "eye_color",       mob->eye_color);
-  store_string(set, "eye_color_right", mob->eye_color_right);
-  store_int   (set, "heterochromia",   mob->heterochromia);
-  store_string(set, "beard_style",     mob->beard_style);
+  // Appearance customization, for those who have any
+  if(mob->looks != NULL) {
+    store_string(set, "hair_color",      mob->looks->hair_color);
+    store_string(set, "hair_style",      mob->looks->hair_style);
+    store_string(set, "fur_color",       mob->looks->fur_color);
+    store_string(set, "feather_color",   mob->looks->feather_color);
+    store_string(set, "scale_color",     mob->looks->scale_color);
+    store_string(set, "scale_marking",   mob->looks->scale_marking);
+    store_string(set, "marking_color",   mob->looks->marking_color);
+    store_string(set, "tail_style",      mob->looks->tail_style);
+    store_string(set, "mane_style",      mob->looks->mane_style);
+    store_string(set, "build",           mob->looks->build);
+    store_string(set, "skin_tone",       mob->looks->skin_tone);
+    store_string(set, "eye_color",       mob->looks->eye_color);
+    store_string(set, "eye_color_right", mob->looks->eye_color_right);
+    store_int   (set, "heterochromia",   mob->looks->heterochromia);
+    store_string(set, "beard_style",     mob->looks->beard_style);
+  }
 
   // PC-only data
   if(!charIsNPC(mob)) {
@@ -719,7 +868,7 @@ void charCopyTo( CHAR_DATA *from, CHAR_DATA *to) {
   charSetBeardStyle(to, charGetBeardStyle(from));
   
   bitvectorCopyTo   (from->prfs, to->prfs);
-  bitvectorCopyTo   (from->prfs, to->prfs);
+  bitvectorCopyTo   (from->bits, to->bits);
   to->birth = from->birth;
 
   auxiliaryDataCopyTo(from->auxiliary_data, to->auxiliary_data);
@@ -738,8 +887,9 @@ CHAR_DATA *charCopy( CHAR_DATA *mob) {
 // mob set and get functions
 //*****************************************************************************
 void charSetKeywords(CHAR_DATA *ch, const char *keywords) {
-  if(ch->keywords) free(ch->keywords);
-  ch->keywords = strdupsafe(keywords);
+  const char *old = ch->keywords;
+  ch->keywords = strShare(keywords);
+  strRelease(old);
 }
 
 const char  *charGetKeywords   ( CHAR_DATA *ch) {
@@ -55,6 +55,7 @@ void         charResetBody    (CHAR_DATA *ch);
 // output functions
 //*****************************************************************************
 void  text_to_char          (CHAR_DATA *dMob, const char *txt );
+void  text_to_char_shared   (CHAR_DATA *ch, OUT_FRAG *frag);
 void  send_to_char          (CHAR_DATA *ch, const char *format, ...) 
 __attribute__ ((format (printf, 2, 3)));
 void  send_to_list          (LIST *list, const char *format, ...) 
@@ -72,6 +73,9 @@ __attribute__ ((format (printf, 2, 3)));
 SOCKET_DATA *charGetSocket    (CHAR_DATA *ch);
 ROOM_DATA   *charGetRoom      (CHAR_DATA *ch);
 ROOM_DATA   *charGetLastRoom  (CHAR_DATA *ch);
+LIST_NODE   *charGetRoomNode  (CHAR_DATA *ch);
+LIST_NODE   *charGetGameNode  (CHAR_DATA *ch);
+bool         charIsExtracted  (CHAR_DATA *ch);
 const char  *charGetClass     (CHAR_DATA *ch);
 const char  *charGetPrototypes(CHAR_DATA *ch);
 const char  *charGetName      (CHAR_DATA *ch);
@@ -126,7 +130,9 @@ int          charGetUID       (const CHAR_DATA *ch);
 time_t       charGetBirth     (const CHAR_DATA *ch);
 int          charGetHidden    (const CHAR_DATA *ch);
 double       charGetWeight    (const CHAR_DATA *ch);
+double       charGetCarriedWeight(const CHAR_DATA *ch);
 void        *charGetAuxiliaryData(const CHAR_DATA *ch, const char *name);
+void        *charGetAuxiliarySlot(const CHAR_DATA *ch, int slot);
 BITVECTOR   *charGetPrfs      (CHAR_DATA *ch);
 BITVECTOR   *charGetUserGroups(CHAR_DATA *ch);
 
@@ -136,6 +142,9 @@ void         charSetPrototypes(CHAR_DATA *ch, const char *prototypes);
 void         charSetSocket    (CHAR_DATA *ch, SOCKET_DATA *socket);
 void         charSetRoom      (CHAR_DATA *ch, ROOM_DATA *room);
 void         charSetLastRoom  (CHAR_DATA *ch, ROOM_DATA *room);
+void         charSetRoomNode  (CHAR_DATA *ch, LIST_NODE *node);
+void         charSetGameNode  (CHAR_DATA *ch, LIST_NODE *node);
+void         charSetExtracted (CHAR_DATA *ch, bool extracted);
 void         charSetName      (CHAR_DATA *ch, const char *name);
 void         charSetSex       (CHAR_DATA *ch, int sex);
 void         charSetDesc      (CHAR_DATA *ch, const char *desc);
@@ -151,6 +160,13 @@ void         charSetPos       (CHAR_DATA *ch, int pos);
 void         charSetHidden    (CHAR_DATA *ch, int amnt);
 void         charSetWeight    (CHAR_DATA *ch, double amnt);
 
+//
+// what the character is carrying and wearing has gotten heavier (or lighter)
+// by amnt. Kept up to date by objects as they are given to, taken from, worn
+// by, and removed from the character, and as anything on them changes weight
+void         charAddCarriedWeight(CHAR_DATA *ch, double amnt);
+void         charSetBirth     (CHAR_DATA *ch, time_t birth);
+
 
 
 //*****************************************************************************
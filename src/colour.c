@@ -0,0 +1,169 @@
+//*****************************************************************************
+//
+// colour.c
+//
+// turns the colour codes in outbound text into the escape sequences terminals
+// understand. See colour.h for more information.
+//
+//*****************************************************************************
+
+#include "mud.h"
+#include "utils.h"
+#include "colour.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// what each code becomes, for each mode. NULL if it isn't a code
+char *colour_table[NUM_COLOUR_MODES][256];
+
+const char *colour_mode_names[NUM_COLOUR_MODES] = {
+  "none", "ansi", "256", "html"
+};
+
+// the colours we start off with. Lower case codes are dark, and upper case
+// codes are bright
+const char *default_colours[][2] = {
+  { "n", "0"  },
+  { "d", "30" },
+  { "r", "31" },
+  { "g", "32" },
+  { "y", "33" },
+  { "b", "34" },
+  { "p", "35" },
+  { "c", "36" },
+  { "w", "37" },
+  { NULL, NULL }
+};
+
+
+
+//*****************************************************************************
+// implementation of colour.h
+//*****************************************************************************
+void init_colour(void) {
+  char seq[SMALL_BUFFER];
+  int i;
+  for(i = 0; default_colours[i][0] != NULL; i++) {
+    char code = *default_colours[i][0];
+    sprintf(seq, "\033[0;%sm", default_colours[i][1]);
+    colourSetCode(code, seq, NULL);
+    sprintf(seq, "\033[1;%sm", default_colours[i][1]);
+    colourSetCode(toupper(code), seq, NULL);
+  }
+}
+
+void colourSetCode(char code, const char *ansi, const char *xterm) {
+  unsigned char c = code;
+  int mode;
+  // our marker always stands for itself, after another marker
+  if(c == COLOUR_MARKER || c == '\0')
+    return;
+  for(mode = 0; mode < NUM_COLOUR_MODES; mode++) {
+    if(colour_table[mode][c] != NULL)
+      free(colour_table[mode][c]);
+    colour_table[mode][c] = NULL;
+  }
+  if(ansi == NULL)
+    return;
+  colour_table[COLOUR_NONE][c] = strdup("");
+  colour_table[COLOUR_ANSI][c] = strdup(ansi);
+  colour_table[COLOUR_256][c]  = strdup(xterm ? xterm : ansi);
+
+  // web clients style codes themselves
+  char html[SMALL_BUFFER];
+  snprintf(html, sizeof(html), "</span><span class=\"c-%c\">", c);
+  colour_table[COLOUR_HTML][c] = strdup(html);
+}
+
+const char *colourGetCode(char code, int mode) {
+  if(mode < 0 || mode >= NUM_COLOUR_MODES)
+    return NULL;
+  return colour_table[mode][(unsigned char)code];
+}
+
+const char *colourModeName(int mode) {
+  if(mode < 0 || mode >= NUM_COLOUR_MODES)
+    return NULL;
+  return colour_mode_names[mode];
+}
+
+int colourModeFromName(const char *name) {
+  int mode;
+  for(mode = 0; mode < NUM_COLOUR_MODES; mode++)
+    if(!strcasecmp(name, colour_mode_names[mode]))
+      return mode;
+  return -1;
+}
+
+//
+// append len bytes of text to out, with what HTML reserves made into entities
+void colour_html_escape(BUFFER *out, const char *text, int len) {
+  const char *end = text + len, *from = text;
+  for(; text < end; text++) {
+    const char *entity = (*text == '<' ? "&lt;" : *text == '>' ? "&gt;" :
+			  *text == '&' ? "&amp;" : NULL);
+    if(entity == NULL)
+      continue;
+    bufferCatLen(out, from, text - from);
+    bufferCat(out, entity);
+    from = text + 1;
+  }
+  bufferCatLen(out, from, end - from);
+}
+
+//
+// append text up to a colour marker (or the end of the text) to out
+void colour_cat_plain(BUFFER *out, const char *text, int len, int mode) {
+  if(mode == COLOUR_HTML)
+    colour_html_escape(out, text, len);
+  else
+    bufferCatLen(out, text, len);
+}
+
+bool colourTranslate(const char *text, int len, BUFFER *out, int mode) {
+  const char  *end = text + len;
+  const char *mark = memchr(text, COLOUR_MARKER, len);
+  if(mode < 0 || mode >= NUM_COLOUR_MODES)
+    mode = COLOUR_ANSI;
+  if(mark == NULL && (mode != COLOUR_HTML || (!memchr(text, '<', len) &&
+					      !memchr(text, '>', len) &&
+					      !memchr(text, '&', len))))
+    return FALSE;
+
+  char **table = colour_table[mode];
+  if(mode == COLOUR_HTML)
+    bufferCat(out, "<span>");
+  while(mark != NULL) {
+    // everything up to the marker goes as-is
+    colour_cat_plain(out, text, mark - text, mode);
+    text = mark + 1;
+
+    // a marker at the very end is just a marker
+    if(text >= end)
+      bufferCatLen(out, mark, 1);
+    // two in a row is an escaped marker
+    else if(*text == COLOUR_MARKER) {
+      bufferCatLen(out, mark, 1);
+      text++;
+    }
+    // a colour code
+    else if(table[(unsigned char)*text] != NULL) {
+      bufferCat(out, table[(unsigned char)*text]);
+      text++;
+    }
+    // not a code; leave the marker and what follows it alone
+    else
+      bufferCatLen(out, mark, 1);
+
+    mark = (text < end ? memchr(text, COLOUR_MARKER, end - text) : NULL);
+  }
+  if(text < end)
+    colour_cat_plain(out, text, end - text, mode);
+  if(mode == COLOUR_HTML)
+    bufferCat(out, "</span>");
+  return TRUE;
+}
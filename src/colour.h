@@ -0,0 +1,60 @@
+#ifndef __COLOUR_H
+#define __COLOUR_H
+//*****************************************************************************
+//
+// colour.h
+//
+// turns the colour codes in outbound text ({r, {G, etc...) into the escape
+// sequences terminals understand. This is done to every socket's text and
+// prompt right before it is sent, after the process_outbound hooks have run.
+// Which sequence each code becomes is kept in a table, indexed by the
+// character after the colour marker. Codes can have one sequence for plain
+// ANSI terminals, and another for terminals that understand 256 colours. A
+// marker followed by something that isn't a code is left alone, and two
+// markers in a row become one.
+//
+// Web clients can be sent HTML instead. Their text has its <, > and & made
+// into entities, and is always in a <span>; each code closes the span it is
+// in, and opens one with the class c-<code> (e.g. c-r, or c-R for {R).
+//
+//*****************************************************************************
+
+// what comes before every colour code
+#define COLOUR_MARKER           '{'
+
+// what sockets can be sent. Sockets with no colour have their codes stripped
+#define COLOUR_NONE             0
+#define COLOUR_ANSI             1
+#define COLOUR_256              2
+#define COLOUR_HTML             3
+#define NUM_COLOUR_MODES        4
+
+//
+// set up the default colour codes
+void init_colour(void);
+
+//
+// set what a colour code becomes, for ANSI and 256-colour terminals. If the
+// 256-colour sequence is NULL, the ANSI one is used for both. If the ANSI
+// sequence is NULL, the code is removed and becomes plain text again
+void colourSetCode(char code, const char *ansi, const char *xterm);
+
+//
+// returns what a colour code becomes for the given mode, or NULL if it is
+// not a colour code
+const char *colourGetCode(char code, int mode);
+
+//
+// the name of a colour mode ("none", "ansi", "256", "html"), and the mode with
+// a name.
+// colourModeFromName returns -1 if no mode has the name
+const char *colourModeName(int mode);
+int colourModeFromName(const char *name);
+
+//
+// translate the colour codes in text of len bytes for the given mode, and
+// append the result to out. Returns FALSE, and appends nothing, if the text
+// has no colour markers in it (and, for HTML, nothing that must be escaped)
+bool colourTranslate(const char *text, int len, BUFFER *out, int mode);
+
+#endif // __COLOUR_H
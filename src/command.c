@@ -15,6 +15,8 @@
 #include "utils.h"
 #include "action.h"
 #include "character.h"
+#include "pulse.h"
+#include "shard.h"
 
 
 
@@ -24,12 +26,22 @@
 #include "scripts/scripts.h"
 #include "scripts/pyplugs.h"
 #include "scripts/pychar.h"
+#include "scripts/sampler.h"
 
 
 
 //*****************************************************************************
 // local structs, defines, and functions
 //*****************************************************************************
+typedef struct cmd_check_data {
+  CMD_CHK_PTR(func);
+  PyObject *pyfunc;
+  long long  calls; // how many times we've been run
+  long long  fails; // how many times we stopped the command
+  long long  total; // microseconds spent in us, while profiling
+  long long    max;
+} CMD_CHK_DATA;
+
 struct cmd_data {
   char       *name;
   CMD_PTR(func);
@@ -37,12 +49,18 @@ struct cmd_data {
   char *user_group;
   bool  interrupts;
   LIST     *checks;
+
+  // our checks, split into C checks and then Python checks. Made from
+  // checks the first time they are needed after they change
+  CMD_CHK_DATA **run_checks;
+  int        num_run_checks;
+  bool       checks_changed;
+  int               running; // how many of us are running our checks
+  PyObject          *pyname; // our name, for passing to Python checks
 };
 
-typedef struct cmd_check_data {
-  CMD_CHK_PTR(func);
-  PyObject *pyfunc;
-} CMD_CHK_DATA;
+// are we timing how long command checks take?
+bool cmd_profiling = FALSE;
 
 
 
@@ -50,14 +68,14 @@ typedef struct cmd_check_data {
 // functions for manipulating CMD_CHK_DATA
 //*****************************************************************************
 CMD_CHK_DATA *newCmdCheck(CMD_CHK(func)) {
-  CMD_CHK_DATA *data = malloc(sizeof(CMD_CHK_DATA));
+  CMD_CHK_DATA *data = calloc(1, sizeof(CMD_CHK_DATA));
   data->func   = func;
   data->pyfunc = NULL;
   return data;
 }
 
 CMD_CHK_DATA *newPyCmdCheck(PyObject *pyfunc) {
-  CMD_CHK_DATA *data = malloc(sizeof(CMD_CHK_DATA));
+  CMD_CHK_DATA *data = calloc(1, sizeof(CMD_CHK_DATA));
   data->func   = NULL;
   data->pyfunc = pyfunc;
   Py_XINCREF(data->pyfunc);
@@ -83,6 +101,51 @@ void cmdCheckCopyTo(CMD_CHK_DATA *from, CMD_CHK_DATA *to) {
   Py_XINCREF(to->pyfunc);
 }
 
+//
+// split our checks up into the order they are run in: C checks first, since
+// they are cheap and most often the ones that say no, and then Python checks.
+// Each kind keeps the order it was added in
+void cmd_compile_checks(CMD_DATA *cmd) {
+  int num = listSize(cmd->checks), i = 0;
+  cmd->run_checks = realloc(cmd->run_checks, sizeof(CMD_CHK_DATA *) * (num+1));
+  cmd->num_run_checks = num;
+  cmd->checks_changed = FALSE;
+
+  LOCAL_LIST_ITERATOR(chk_i, cmd->checks);
+  CMD_CHK_DATA *chk = NULL;
+  ITERATE_LIST(chk, chk_i) {
+    if(chk->func)
+      cmd->run_checks[i++] = chk;
+  }
+  listIteratorReset(chk_i);
+  ITERATE_LIST(chk, chk_i) {
+    if(!chk->func)
+      cmd->run_checks[i++] = chk;
+  } listIteratorFinish(chk_i);
+}
+
+//
+// run one check. Python checks are handed their arguments directly, so no
+// argument tuple has to be built for them
+bool cmd_run_check(CMD_DATA *cmd, CMD_CHK_DATA *chk, CHAR_DATA *ch) {
+  if(chk->func)
+    return (chk->func)(ch, cmd->name);
+
+  if(cmd->pyname == NULL)
+    cmd->pyname = PyUnicode_FromString(cmd->name);
+  PyObject *args[2] = { charGetPyFormBorrowed(ch), cmd->pyname };
+  PyObject *retval  = (cmd->pyname == NULL ? NULL :
+		       PyObject_Vectorcall(chk->pyfunc, args, 2, NULL));
+  bool ok = TRUE;
+  // check for an error:
+  if(retval == NULL)
+    log_pyerr("Error running Python command check, %s:", cmd->name);
+  else if(retval == Py_False)
+    ok = FALSE;
+  Py_XDECREF(retval);
+  return ok;
+}
+
 
 
 //*****************************************************************************
@@ -93,6 +156,7 @@ CMD_DATA *newCmd(const char *name, COMMAND(func), const char *user_group,
   CMD_DATA *cmd = calloc(1, sizeof(CMD_DATA));
   cmd->name     = strdupsafe(name);
   cmd->checks   = newList();
+  cmd->checks_changed = TRUE;
   cmdUpdate(cmd, func, user_group, interrupts);
   return cmd;
 }
@@ -102,6 +166,7 @@ CMD_DATA *newPyCmd(const char *name, void *pyfunc, const char *user_group,
   CMD_DATA *cmd   = calloc(1, sizeof(CMD_DATA));
   cmd->name       = strdupsafe(name);
   cmd->checks     = newList();
+  cmd->checks_changed = TRUE;
   cmdPyUpdate(cmd, pyfunc, user_group, interrupts);
   return cmd;
 }
@@ -131,6 +196,8 @@ void deleteCmd(CMD_DATA *cmd) {
   if(cmd->user_group) free(cmd->user_group);
   if(cmd->pyfunc)     { Py_DECREF(cmd->pyfunc); }
   if(cmd->checks)     deleteListWith(cmd->checks, deleteCmdCheck);
+  if(cmd->run_checks) free(cmd->run_checks);
+  Py_XDECREF(cmd->pyname);
   free(cmd);
 }
 
@@ -144,6 +211,7 @@ CMD_DATA *cmdCopy(CMD_DATA *cmd) {
   // copy over the checks
   deleteList(newcmd->checks);
   newcmd->checks = listCopyWith(cmd->checks, cmdCheckCopy);
+  newcmd->checks_changed = TRUE;
   return newcmd;
 }
 
@@ -151,6 +219,8 @@ void cmdCopyTo(CMD_DATA *from, CMD_DATA *to) {
   if(to->name)       free(to->name);
   if(to->user_group) free(to->user_group);
   if(to->pyfunc)     { Py_DECREF(to->pyfunc); }
+  Py_XDECREF(to->pyname);
+  to->pyname       = NULL;
   to->name         = strdup(from->name);
   to->user_group   = strdup(from->user_group);
   to->pyfunc       = from->pyfunc;
@@ -159,6 +229,7 @@ void cmdCopyTo(CMD_DATA *from, CMD_DATA *to) {
   to->interrupts   = from->interrupts;
   if(to->checks)     { deleteListWith(to->checks, deleteCmdCheck); }
   to->checks       = listCopyWith(from->checks, cmdCheckCopy);
+  to->checks_changed = TRUE;
 }
 
 const char *cmdGetName(CMD_DATA *cmd) {
@@ -179,10 +250,51 @@ LIST *cmdGetChecks(CMD_DATA *cmd) {
 
 void cmdAddCheck(CMD_DATA *cmd, CMD_CHK(func)) {
   listPut(cmdGetChecks(cmd), newCmdCheck(func));
+  cmd->checks_changed = TRUE;
 }
 
 void cmdAddPyCheck(CMD_DATA *cmd, void *pyfunc) {
   listPut(cmdGetChecks(cmd), newPyCmdCheck(pyfunc));
+  cmd->checks_changed = TRUE;
+}
+
+int cmdGetNumChecks(CMD_DATA *cmd) {
+  return listSize(cmd->checks);
+}
+
+void cmdGetCheckStat(CMD_DATA *cmd, int num, CMD_CHK_STAT *stat) {
+  CMD_CHK_DATA *chk = listGet(cmd->checks, num);
+  stat->calls = chk->calls;
+  stat->fails = chk->fails;
+  stat->total = chk->total;
+  stat->max   = chk->max;
+  if(chk->func)
+    snprintf(stat->name, sizeof(stat->name), "C check %p", (void *)chk->func);
+  else {
+    PyObject *name = PyObject_GetAttrString(chk->pyfunc, "__qualname__");
+    snprintf(stat->name, sizeof(stat->name), "%s",
+	     (name && PyUnicode_Check(name) ? PyUnicode_AsUTF8(name) :
+	      "Python check"));
+    if(name == NULL)
+      PyErr_Clear();
+    Py_XDECREF(name);
+  }
+}
+
+void cmdResetStats(CMD_DATA *cmd) {
+  LOCAL_LIST_ITERATOR(chk_i, cmd->checks);
+  CMD_CHK_DATA *chk = NULL;
+  ITERATE_LIST(chk, chk_i) {
+    chk->calls = chk->fails = chk->total = chk->max = 0;
+  } listIteratorFinish(chk_i);
+}
+
+void cmdSetProfiling(bool on) {
+  cmd_profiling = on;
+}
+
+bool cmdGetProfiling(void) {
+  return cmd_profiling;
 }
 
 //
@@ -252,35 +364,60 @@ bool max_pos_ok(CHAR_DATA *ch, int minpos) {
 }
 
 bool cmdTryChecks(CHAR_DATA *ch, CMD_DATA *cmd) {
-  bool cmd_ok = TRUE;
-  if(listSize(cmd->checks) > 0) {
-    LIST_ITERATOR *chk_i = newListIterator(cmd->checks);
-    CMD_CHK_DATA    *chk = NULL;
-    ITERATE_LIST(chk, chk_i) {
-      if(chk->func)
-	cmd_ok = (chk->func)(ch, cmd->name);
-      else {
-	PyObject *arglist = Py_BuildValue("Os", charGetPyFormBorrowed(ch), 
-					  cmd->name);
-	PyObject *retval  = PyEval_CallObject(chk->pyfunc, arglist);
-	// check for an error:
-	if(retval == NULL)
-	  log_pyerr("Error running Python command check, %s:", cmd->name);
-	else if(retval == Py_False)
-	  cmd_ok = FALSE;
-
-	// garbage collection
-	Py_XDECREF(retval);
-	Py_XDECREF(arglist);
-      }
-
-      if(cmd_ok == FALSE)
-	break;
-    } deleteListIterator(chk_i);
+  // checks added while one of our checks is running wait until nobody is
+  // running them before they are put in with the rest
+  if(cmd->checks_changed && cmd->running == 0)
+    cmd_compile_checks(cmd);
+
+  int  num_checks = cmd->num_run_checks, i;
+  bool     cmd_ok = TRUE;
+  if(num_checks == 0)
+    return TRUE;
+
+  cmd->running++;
+  for(i = 0; i < num_checks && cmd_ok; i++) {
+    CMD_CHK_DATA *chk = cmd->run_checks[i];
+    long long   start = (cmd_profiling ? pulse_clock() : 0);
+    cmd_ok = cmd_run_check(cmd, chk, ch);
+    chk->calls++;
+    if(!cmd_ok)
+      chk->fails++;
+    if(cmd_profiling) {
+      long long usecs = pulse_clock() - start;
+      chk->total += usecs;
+      if(usecs > chk->max)
+	chk->max = usecs;
+    }
   }
+  cmd->running--;
   return cmd_ok;
 }
 
+bool cmdSame(CMD_DATA *cmd1, CMD_DATA *cmd2) {
+  if(cmd1->func != cmd2->func || cmd1->pyfunc != cmd2->pyfunc ||
+     cmd1->interrupts != cmd2->interrupts ||
+     listSize(cmd1->checks) != listSize(cmd2->checks) ||
+     strcmp(cmd1->name, cmd2->name) ||
+     strcmp(cmd1->user_group, cmd2->user_group))
+    return FALSE;
+
+  // the same checks, in the same order
+  LOCAL_LIST_ITERATOR(chk1_i, cmd1->checks);
+  LOCAL_LIST_ITERATOR(chk2_i, cmd2->checks);
+  CMD_CHK_DATA *chk1 = NULL, *chk2 = NULL;
+  bool          same = TRUE;
+  ITERATE_LIST(chk1, chk1_i) {
+    chk2 = listIteratorCurrent(chk2_i);
+    if(chk1->func != chk2->func || chk1->pyfunc != chk2->pyfunc) {
+      same = FALSE;
+      break;
+    }
+    listIteratorNext(chk2_i);
+  } listIteratorFinish(chk1_i);
+  listIteratorFinish(chk2_i);
+  return same;
+}
+
 bool cmdHasFunc(CMD_DATA *cmd) {
   return (cmd->func != NULL || cmd->pyfunc != NULL);
 }
@@ -303,14 +440,23 @@ int charTryCmd(CHAR_DATA *ch, CMD_DATA *cmd, char *arg) {
 #endif
     }
     if(cmd->func) {
+      shardBegin(charGetRoom(ch));
+      samplerEnter("cmd", cmd->name);
       (cmd->func)(ch, cmd->name, arg);
+      samplerLeave();
+      shardEnd();
       return TRUE;
     }
     else if(cmd->pyfunc) {
+      shardBegin(charGetRoom(ch));
+      samplerEnter("cmd", cmd->name);
       PyObject *arglist = Py_BuildValue("Oss", charGetPyFormBorrowed(ch), 
 					cmd->name, arg);
-      PyObject *retval  = PyEval_CallObject(cmd->pyfunc, arglist);
+      PyObject *retval  = (arglist == NULL ? NULL :
+			   PyObject_CallObject(cmd->pyfunc, arglist));
       int result = TRUE;
+      samplerLeave();
+      shardEnd();
       
       // check for an error:
       if(retval == NULL)
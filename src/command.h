@@ -39,6 +39,11 @@ void     deleteCmd(CMD_DATA *cmd);
 CMD_DATA  *cmdCopy(CMD_DATA *cmd);
 void     cmdCopyTo(CMD_DATA *from, CMD_DATA *to);
 
+//
+// would the two commands do the same thing? Same name, function, user group,
+// and checks. Their stats aren't compared
+bool       cmdSame(CMD_DATA *cmd1, CMD_DATA *cmd2);
+
 //
 // -1     did not attempt; no command but all checks passed (fail)
 //  0     attempted, but a check stopped it (success)
@@ -51,6 +56,24 @@ bool       cmdGetInterrupts(CMD_DATA *cmd);
 void            cmdAddCheck(CMD_DATA *cmd, CMD_CHK(func));
 void          cmdAddPyCheck(CMD_DATA *cmd, void *pyfunc);
 
+//
+// how a command's checks have been doing. C checks are run before Python
+// checks. Checks are always counted; how long they take is only measured
+// while profiling is on, which the cmdstat command turns on and off
+typedef struct {
+  char       name[64]; // the Python check's name, or the C check's address
+  long long     calls;
+  long long     fails; // how many times the check stopped the command
+  long long     total; // microseconds
+  long long       max;
+} CMD_CHK_STAT;
+
+int       cmdGetNumChecks(CMD_DATA *cmd);
+void      cmdGetCheckStat(CMD_DATA *cmd, int num, CMD_CHK_STAT *stat);
+void        cmdResetStats(CMD_DATA *cmd);
+void      cmdSetProfiling(bool on);
+bool      cmdGetProfiling(void);
+
 //
 // do we have an associated function, or are we just a list of command checks?
 bool cmdHasFunc(CMD_DATA *cmd);
@@ -60,4 +83,9 @@ CMD_CHK(chk_conscious);    // ensures the person is conscious
 CMD_CHK(chk_grounded);     // ensures the person is on the ground
 CMD_CHK(chk_not_mob);      // ensures the person is not an NPC
 
+//
+// is the person in at least (or at most) the position? If not, they are told
+bool min_pos_ok(CHAR_DATA *ch, int minpos);
+bool max_pos_ok(CHAR_DATA *ch, int maxpos);
+
 #endif // COMMAND_H
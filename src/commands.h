@@ -11,8 +11,11 @@
 
 COMMAND(cmd_commands);
 COMMAND(cmd_compress);
+COMMAND(cmd_compressstat);
 COMMAND(cmd_look);
 COMMAND(cmd_groupcmds);
+COMMAND(cmd_inputstat);
+COMMAND(cmd_outputstat);
 COMMAND(cmd_more);
 COMMAND(cmd_back);
 
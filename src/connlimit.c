@@ -0,0 +1,182 @@
+//*****************************************************************************
+//
+// connlimit.c
+//
+// per-address token buckets for limiting how fast people can connect to us.
+// See connlimit.h for the details. Buckets are only kept for addresses that
+// have used some of their tokens; a bucket that has refilled is the same as
+// no bucket at all, so those get thrown out now and again.
+//
+//*****************************************************************************
+
+#include <arpa/inet.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "pulse.h"
+#include "connlimit.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how often we throw out buckets that have refilled, in microseconds
+#define CONNLIMIT_PRUNE_INTERVAL   (60 * 1000000LL)
+
+typedef struct conn_bucket {
+  double    tokens; // how many connections the address can still make
+  long long   last; // when we last topped up tokens
+} CONN_BUCKET;
+
+// maps addresses (as strings) to their buckets
+HASHTABLE *conn_buckets = NULL;
+long long    last_prune = 0;
+
+// our counters
+long long conn_accepted = 0;
+long long conn_rejected = 0;
+long long   conn_errors = 0;
+int      conn_max_batch = 0;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// top up a bucket with the tokens it has earned since it was last topped up.
+// Returns TRUE if the bucket is now full
+bool conn_bucket_refill(CONN_BUCKET *bucket, long long now, 
+			double rate, double burst) {
+  bucket->tokens += rate * (now - bucket->last) / (60 * 1000000.0);
+  bucket->last    = now;
+  if(bucket->tokens >= burst) {
+    bucket->tokens = burst;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+//
+// throw out all of the buckets that have refilled
+void conn_buckets_prune(long long now, double rate, double burst) {
+  LIST          *full = newList();
+  HASH_ITERATOR *hash_i = newHashIterator(conn_buckets);
+  CONN_BUCKET   *bucket = NULL;
+  const char       *key = NULL;
+  char          *oldkey = NULL;
+
+  ITERATE_HASH(key, bucket, hash_i) {
+    if(conn_bucket_refill(bucket, now, rate, burst))
+      listPut(full, strdup(key));
+  } deleteHashIterator(hash_i);
+
+  while((oldkey = listPop(full)) != NULL) {
+    free(hashRemove(conn_buckets, oldkey));
+    free(oldkey);
+  }
+  deleteList(full);
+  last_prune = now;
+}
+
+COMMAND(cmd_connstats) {
+  if(*arg && !strcasecmp(arg, "reset")) {
+    connlimitResetStats();
+    send_to_char(ch, "Connection statistics reset.\r\n");
+    return;
+  }
+
+  send_to_char(ch,
+	       "Connection limit: %d per minute, bursts of up to %d.\r\n"
+	       "Accepted: %lld. Rejected: %lld. Accept errors: %lld.\r\n"
+	       "Most accepted in one pulse: %d. Addresses being limited: %d.\r\n",
+	       mudsettingGetInt("connect_rate"), 
+	       mudsettingGetInt("connect_burst"),
+	       conn_accepted, conn_rejected, conn_errors, conn_max_batch,
+	       hashSize(conn_buckets));
+}
+
+
+
+//*****************************************************************************
+// implementation of connlimit.h
+//*****************************************************************************
+void init_connection_limits(void) {
+  conn_buckets = newHashtable();
+  add_cmd("connstats", NULL, cmd_connstats, "admin", FALSE);
+}
+
+bool connlimitAllow(const char *addr) {
+  double        rate = mudsettingGetInt("connect_rate");
+  double       burst = mudsettingGetInt("connect_burst");
+  const char    *key = addr;
+  CONN_BUCKET *bucket = NULL;
+  long long      now = pulse_clock();
+
+  // limiting is turned off
+  if(rate <= 0) {
+    conn_accepted++;
+    return TRUE;
+  }
+  if(burst < 1)
+    burst = 1;
+
+  if(now - last_prune >= CONNLIMIT_PRUNE_INTERVAL)
+    conn_buckets_prune(now, rate, burst);
+
+  // a new address starts off with a full bucket
+  if((bucket = hashGet(conn_buckets, key)) == NULL) {
+    bucket         = malloc(sizeof(CONN_BUCKET));
+    bucket->tokens = burst;
+    bucket->last   = now;
+    hashPut(conn_buckets, key, bucket);
+  }
+  else
+    conn_bucket_refill(bucket, now, rate, burst);
+
+  if(bucket->tokens < 1) {
+    conn_rejected++;
+    return FALSE;
+  }
+  bucket->tokens -= 1;
+  conn_accepted++;
+  return TRUE;
+}
+
+void connlimitRecordBatch(int accepted, bool error) {
+  if(accepted > conn_max_batch)
+    conn_max_batch = accepted;
+  if(error)
+    conn_errors++;
+}
+
+long long connlimitGetAccepted(void) {
+  return conn_accepted;
+}
+
+long long connlimitGetRejected(void) {
+  return conn_rejected;
+}
+
+long long connlimitGetErrors(void) {
+  return conn_errors;
+}
+
+int connlimitGetMaxBatch(void) {
+  return conn_max_batch;
+}
+
+int connlimitGetTracked(void) {
+  return hashSize(conn_buckets);
+}
+
+void connlimitResetStats(void) {
+  conn_accepted  = 0;
+  conn_rejected  = 0;
+  conn_errors    = 0;
+  conn_max_batch = 0;
+}
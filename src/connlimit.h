@@ -0,0 +1,41 @@
+#ifndef __CONNLIMIT_H
+#define __CONNLIMIT_H
+//*****************************************************************************
+//
+// connlimit.h
+//
+// limits how quickly new connections are accepted from any one address. Each
+// address gets a token bucket that holds up to connect_burst tokens, and
+// refills at connect_rate tokens per minute; every connection takes a token,
+// and connections that find an empty bucket are turned away before we spend
+// anything on them. Setting connect_rate to 0 turns limiting off. We also
+// keep counters of how many connections we've accepted and rejected, which
+// admins can view with the connstats command.
+//
+//*****************************************************************************
+
+//
+// prepare connection limiting for use
+void init_connection_limits(void);
+
+//
+// a connection has been accepted from addr, a numeric IPv4 or IPv6 address
+// (see addrToString in listener.h). Returns TRUE if we should keep it, and
+// FALSE if it has gone over its rate limit and should be closed
+bool connlimitAllow(const char *addr);
+
+//
+// record how many connections we accepted in one go, and whether we stopped
+// accepting because of an error other than there being nobody left to accept
+void connlimitRecordBatch(int accepted, bool error);
+
+//
+// counters for admins
+long long connlimitGetAccepted(void);
+long long connlimitGetRejected(void);
+long long connlimitGetErrors  (void);
+int       connlimitGetMaxBatch(void);
+int       connlimitGetTracked (void);
+void      connlimitResetStats (void);
+
+#endif // __CONNLIMIT_H
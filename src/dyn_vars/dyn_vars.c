@@ -17,6 +17,8 @@
 #include "../object.h"
 #include "../storage.h"
 #include "../auxiliary.h"
+#include "../journal.h"
+#include "../intern.h"
 
 #include "dyn_vars.h"
 
@@ -36,127 +38,242 @@ const char *dyn_var_types[] = {
   "double"
 };
 
+// the auxiliary slot our variables are kept in
+int dyn_var_slot = -1;
 
+// most things have only a few variables, which are kept in a plain array and
+// found by walking it. Once something has more than this, its variables are
+// indexed by a hashtable as well
+#define DYN_VAR_INDEX_AT         8
+
+//
+// numbers are kept as numbers, and only turned into text when they are asked
+// for as strings (or saved). Keys are interned, and so are shared between
+// everything that has a variable of the same name
 typedef struct dyn_var {
-  char *str_val;
-  int   type;
+  const char *key;
+  int        type;
+  union {
+    int      i;
+    long     l;
+    double   d;
+  } num;
+  char   *str_val; // a string's value, or a number's text once it's been made
 } DYN_VAR;
 
-
-DYN_VAR *newDynVarString(const char *str) {
-  DYN_VAR *data = malloc(sizeof(DYN_VAR));
-  data->str_val = strdupsafe(str);
-  data->type    = DYN_VAR_STRING;
-  return data;
+//
+// returns the variable's value as text
+const char *dynVarText(DYN_VAR *var) {
+  if(var->str_val == NULL) {
+    char buf[SMALL_BUFFER];
+    if(var->type == DYN_VAR_INT)
+      snprintf(buf, sizeof(buf), "%d",  var->num.i);
+    else if(var->type == DYN_VAR_LONG)
+      snprintf(buf, sizeof(buf), "%ld", var->num.l);
+    else if(var->type == DYN_VAR_DOUBLE)
+      snprintf(buf, sizeof(buf), "%lf", var->num.d);
+    else
+      *buf = '\0';
+    var->str_val = strdup(buf);
+  }
+  return var->str_val;
 }
 
-DYN_VAR *newDynVarInt(int val) {
-  DYN_VAR  *data = malloc(sizeof(DYN_VAR));
-  char str_val[20]; sprintf(str_val, "%d", val);
-  data->str_val  = strdup(str_val);
-  data->type     = DYN_VAR_INT;
-  return data;
+//
+// set the variable's value from text, for whatever type it is
+void dynVarParse(DYN_VAR *var, const char *text) {
+  if(var->type == DYN_VAR_INT)
+    var->num.i = atoi(text);
+  else if(var->type == DYN_VAR_LONG)
+    var->num.l = atol(text);
+  else if(var->type == DYN_VAR_DOUBLE)
+    var->num.d = atof(text);
+  else
+    var->str_val = strdup(text);
+}
+
+int dynVarInt(DYN_VAR *var) {
+  switch(var->type) {
+  case DYN_VAR_INT:    return var->num.i;
+  case DYN_VAR_LONG:   return (int)var->num.l;
+  case DYN_VAR_DOUBLE: return (int)var->num.d;
+  default:             return atoi(var->str_val);
+  }
 }
 
-DYN_VAR *newDynVarLong(long val) {
-  DYN_VAR *data = malloc(sizeof(DYN_VAR));
-  char str_val[20]; sprintf(str_val, "%ld", val);
-  data->str_val  = strdup(str_val);
-  data->type     = DYN_VAR_LONG;
-  return data;
+long dynVarLong(DYN_VAR *var) {
+  switch(var->type) {
+  case DYN_VAR_INT:    return var->num.i;
+  case DYN_VAR_LONG:   return var->num.l;
+  case DYN_VAR_DOUBLE: return (long)var->num.d;
+  default:             return atol(var->str_val);
+  }
 }
 
-DYN_VAR *newDynVarDouble(double val) {
-  DYN_VAR  *data = malloc(sizeof(DYN_VAR));
-  char str_val[20]; sprintf(str_val, "%lf", val);
-  data->str_val  = strdup(str_val);
-  data->type     = DYN_VAR_DOUBLE;
-  return data;
+double dynVarDouble(DYN_VAR *var) {
+  switch(var->type) {
+  case DYN_VAR_INT:    return var->num.i;
+  case DYN_VAR_LONG:   return var->num.l;
+  case DYN_VAR_DOUBLE: return var->num.d;
+  default:             return atof(var->str_val);
+  }
 }
 
-void deleteDynVar(DYN_VAR *data) {
-  if(data->str_val) free(data->str_val);
-  free(data);
-}
 
-DYN_VAR *dynVarCopy(DYN_VAR *data) {
-  DYN_VAR *new_data = malloc(sizeof(DYN_VAR));
-  new_data->str_val = strdup(data->str_val);
-  new_data->type    = data->type;
-  return new_data;
-}
 
+//*****************************************************************************
 //
-// delete a hashtable of vars
+// dyn_var auxiliary data
 //
-void deleteDynVarTable(HASHTABLE *table) {
-  HASH_ITERATOR *hash_i = newHashIterator(table);
-  const char       *key = NULL;
-  DYN_VAR          *val = NULL;
-  
-  ITERATE_HASH(key, val, hash_i) {
-    deleteDynVar(val);
-  } deleteHashIterator(hash_i);
-  deleteHashtable(table);
+//*****************************************************************************
+typedef struct dyn_var_aux_data {
+  DYN_VAR       *vars;
+  int        num_vars;
+  int       vars_size;
+  HASHTABLE    *index; // position + 1 of each var, if we have lots of them
+  bool          dirty; // have our rooms' variables changed since they were made?
+} DYN_VAR_AUX_DATA;
+
+
+//
+// index all of our variables by key, or throw our index away if we're small
+// enough not to need one
+void dyn_var_reindex(DYN_VAR_AUX_DATA *data) {
+  if(data->index != NULL)
+    deleteHashtable(data->index);
+  data->index = NULL;
+  if(data->num_vars > DYN_VAR_INDEX_AT) {
+    int i;
+    data->index = newHashtableSize(data->num_vars * 2);
+    for(i = 0; i < data->num_vars; i++)
+      hashPut(data->index, data->vars[i].key, (void *)(long)(i + 1));
+  }
 }
 
+//
+// returns the position of the variable with the given key, or -1
+int dyn_var_find(DYN_VAR_AUX_DATA *data, const char *key) {
+  int i;
+  if(data->index != NULL)
+    return (int)(long)hashGet(data->index, key) - 1;
+  for(i = 0; i < data->num_vars; i++)
+    if(data->vars[i].key == key || !strcasecmp(data->vars[i].key, key))
+      return i;
+  return -1;
+}
 
+DYN_VAR *dyn_var_get(DYN_VAR_AUX_DATA *data, const char *key) {
+  int pos = dyn_var_find(data, key);
+  return (pos < 0 ? NULL : &data->vars[pos]);
+}
 
-//*****************************************************************************
 //
-// dyn_var auxiliary data
+// returns the variable with the given key, emptied out and set to the given
+// type. It is made if it doesn't already exist
+DYN_VAR *dyn_var_put(DYN_VAR_AUX_DATA *data, const char *key, int type) {
+  int  pos = dyn_var_find(data, key);
+  DYN_VAR *var = NULL;
+  if(pos >= 0) {
+    var = &data->vars[pos];
+    if(var->str_val != NULL)
+      free(var->str_val);
+  }
+  else {
+    if(data->num_vars == data->vars_size) {
+      data->vars_size = (data->vars_size == 0 ? 2 : data->vars_size * 2);
+      data->vars = realloc(data->vars, sizeof(DYN_VAR) * data->vars_size);
+    }
+    var      = &data->vars[data->num_vars++];
+    var->key = strIntern(key);
+    if(data->index != NULL)
+      hashPut(data->index, var->key, (void *)(long)data->num_vars);
+    else if(data->num_vars > DYN_VAR_INDEX_AT)
+      dyn_var_reindex(data);
+  }
+  var->type    = type;
+  var->str_val = NULL;
+  var->num.l   = 0;
+  return var;
+}
+
 //
-//*****************************************************************************
-typedef struct dyn_var_aux_data {
-  HASHTABLE *dyn_vars;
-} DYN_VAR_AUX_DATA;
+// remove a variable. Our last variable takes its place
+void dyn_var_remove(DYN_VAR_AUX_DATA *data, const char *key) {
+  int pos = dyn_var_find(data, key);
+  if(pos < 0)
+    return;
+  DYN_VAR *var = &data->vars[pos];
+  if(data->index != NULL)
+    hashRemove(data->index, var->key);
+  strRelease(var->key);
+  if(var->str_val != NULL)
+    free(var->str_val);
+
+  data->num_vars--;
+  if(pos != data->num_vars) {
+    *var = data->vars[data->num_vars];
+    if(data->index != NULL)
+      hashPut(data->index, var->key, (void *)(long)(pos + 1));
+  }
+  if(data->index != NULL && data->num_vars <= DYN_VAR_INDEX_AT / 2)
+    dyn_var_reindex(data);
+}
+
+//
+// delete all of our variables
+void dyn_var_clear(DYN_VAR_AUX_DATA *data) {
+  int i;
+  for(i = 0; i < data->num_vars; i++) {
+    strRelease(data->vars[i].key);
+    if(data->vars[i].str_val != NULL)
+      free(data->vars[i].str_val);
+  }
+  if(data->vars != NULL)
+    free(data->vars);
+  if(data->index != NULL)
+    deleteHashtable(data->index);
+  data->vars      = NULL;
+  data->index     = NULL;
+  data->num_vars  = 0;
+  data->vars_size = 0;
+}
 
 
 DYN_VAR_AUX_DATA *
 newDynVarAuxData() {
-  DYN_VAR_AUX_DATA *data = malloc(sizeof(DYN_VAR_AUX_DATA));
-  // Hashtables can take up lots of storage space. Because of this, let's
-  // not create any tables until it's actually needed. This will cut down
-  // on lots of memory usage w.r.t. NPCs who do not use character variables
-  //  data->dyn_vars        = newHashtable();
-  data->dyn_vars         = NULL;
+  // nothing has any room for variables until it has some; most NPCs never
+  // have any at all
+  DYN_VAR_AUX_DATA *data = calloc(1, sizeof(DYN_VAR_AUX_DATA));
+  data->dirty            = FALSE;
   return data;
 }
 
 
 void
 deleteDynVarAuxData(DYN_VAR_AUX_DATA *data) {
-  if(data->dyn_vars)
-    deleteDynVarTable(data->dyn_vars);
+  dyn_var_clear(data);
   free(data);
 }
 
 
 void
 dynVarAuxDataCopyTo(DYN_VAR_AUX_DATA *from, DYN_VAR_AUX_DATA *to) {
-  int from_size = (from->dyn_vars ? hashSize(from->dyn_vars) : 0);
-  int to_size   = (to->dyn_vars   ? hashSize(to->dyn_vars)   : 0);
+  int i;
 
   // clear out our current data
-  if(to_size > 0) {
-    deleteDynVarTable(to->dyn_vars);
-    to->dyn_vars = NULL;
-  }
-
-  // check to see if the "from" table exists
-  if(from_size > 0) {
-    // make sure the "to" table exists
-    if(to->dyn_vars == NULL)
-      to->dyn_vars = newHashtable();
-
-    // copy everything over
-    HASH_ITERATOR *from_i = newHashIterator(from->dyn_vars);
-    const char       *key = NULL;
-    DYN_VAR         *val = NULL;
-
-    ITERATE_HASH(key, val, from_i)
-      hashPut(to->dyn_vars, key, dynVarCopy(val));
-    deleteHashIterator(from_i);
+  dyn_var_clear(to);
+
+  // copy everything over. Numbers will make their own text if they need it
+  if(from->num_vars > 0) {
+    to->vars      = malloc(sizeof(DYN_VAR) * from->num_vars);
+    to->vars_size = to->num_vars = from->num_vars;
+    for(i = 0; i < from->num_vars; i++) {
+      DYN_VAR *var = &to->vars[i];
+      *var         = from->vars[i];
+      var->key     = strInternRef(var->key);
+      var->str_val = (var->type == DYN_VAR_STRING ? strdup(var->str_val):NULL);
+    }
+    dyn_var_reindex(to);
   }
 }
 
@@ -170,26 +287,24 @@ dynVarAuxDataCopy(DYN_VAR_AUX_DATA *data) {
 
 
 STORAGE_SET *dynVarAuxDataStore(DYN_VAR_AUX_DATA *data) {
-  // first, check if the table even exists
-  if(data->dyn_vars == NULL || hashSize(data->dyn_vars) == 0)
+  // first, check if we have anything to store
+  if(data->num_vars == 0)
     return new_storage_set();
 
   STORAGE_SET       *set = new_storage_set();
-  HASH_ITERATOR  *hash_i = newHashIterator(data->dyn_vars);
   STORAGE_SET_LIST *list = new_storage_list();
-  const char        *key = NULL;
-  DYN_VAR          *val = NULL;
+  int                  i;
 
   store_list(set, "variables", list);
   // iterate across all the entries and add them
-  ITERATE_HASH(key, val, hash_i) {
+  for(i = 0; i < data->num_vars; i++) {
+    DYN_VAR         *var = &data->vars[i];
     STORAGE_SET *var_set = new_storage_set();
-    store_string(var_set, "key",  key);
-    store_string(var_set, "val",  val->str_val);
-    store_string(var_set, "type", dyn_var_types[val->type]);
+    store_string(var_set, "key",  var->key);
+    store_string(var_set, "val",  dynVarText(var));
+    store_string(var_set, "type", dyn_var_types[var->type]);
     storage_list_put(list, var_set);
   }
-  deleteHashIterator(hash_i);
   return set;
 }
 
@@ -213,22 +328,20 @@ DYN_VAR_AUX_DATA *dynVarAuxDataRead(STORAGE_SET *set) {
   DYN_VAR_AUX_DATA *data = newDynVarAuxData();
   STORAGE_SET_LIST  *list = read_list(set, "variables");
   STORAGE_SET    *var_set = NULL;
-  data->dyn_vars         = newHashtable();
   
   while( (var_set = storage_list_next(list)) != NULL) {
     const char *var_type = read_string(var_set, "type");
+    const char      *key = read_string(var_set, "key");
     if(!strcasecmp(var_type, "int"))
-      hashPut(data->dyn_vars, read_string(var_set, "key"),
-	      newDynVarInt(read_int(var_set, "val")));
+      dyn_var_put(data, key, DYN_VAR_INT)->num.i = read_int(var_set, "val");
     else if(!strcasecmp(var_type, "long"))
-      hashPut(data->dyn_vars, read_string(var_set, "key"),
-	      newDynVarLong(read_long(var_set, "val")));
+      dyn_var_put(data, key, DYN_VAR_LONG)->num.l = read_long(var_set, "val");
     else if(!strcasecmp(var_type, "double"))
-      hashPut(data->dyn_vars, read_string(var_set, "key"),
-	      newDynVarDouble(read_double(var_set, "val")));
+      dyn_var_put(data, key, DYN_VAR_DOUBLE)->num.d =
+	read_double(var_set, "val");
     else if(!strcasecmp(var_type, "string"))
-      hashPut(data->dyn_vars, read_string(var_set, "key"),
-	      newDynVarString(read_string(var_set, "val")));
+      dyn_var_put(data, key, DYN_VAR_STRING)->str_val =
+	strdup(read_string(var_set, "val"));
     else
       log_string("ERROR: Tried to read unknown dyn_var type, %s.", var_type);
   }
@@ -237,6 +350,48 @@ DYN_VAR_AUX_DATA *dynVarAuxDataRead(STORAGE_SET *set) {
 }
 
 
+//
+// players' variables are journaled as they change, so they survive a crash
+// between saves. A record is the variable's type, key, and value, each on a
+// line of its own; one with no type is a variable being deleted
+void dyn_var_journal(CHAR_DATA *ch, const char *key) {
+  DYN_VAR_AUX_DATA *data = charGetAuxiliarySlot(ch, dyn_var_slot);
+  DYN_VAR           *var = dyn_var_get(data, key);
+  BUFFER        *record = newBuffer(SMALL_BUFFER);
+  if(var == NULL)
+    bprintf(record, "\n%s\n", key);
+  else
+    bprintf(record, "%s\n%s\n%s", dyn_var_types[var->type], key,
+	    dynVarText(var));
+  journalAppend(ch, "dyn_var", bufferString(record));
+  deleteBuffer(record);
+}
+
+void dyn_var_replay(CHAR_DATA *ch, const char *record) {
+  DYN_VAR_AUX_DATA *data = charGetAuxiliarySlot(ch, dyn_var_slot);
+  const char       *key = strchr(record, '\n');
+  const char       *val = (key ? strchr(key + 1, '\n') : NULL);
+  int              type = 0;
+  if(val == NULL)
+    return;
+
+  char name[val - key];
+  strncpy(name, key + 1, val - key - 1);
+  name[val - key - 1] = '\0';
+  dyn_var_remove(data, name);
+
+  // find the variable's type. If it has none, it was deleted
+  for(type = 0; type <= DYN_VAR_DOUBLE; type++)
+    if(!strncmp(record, dyn_var_types[type], key - record) &&
+       dyn_var_types[type][key - record] == '\0')
+      break;
+  if(type > DYN_VAR_DOUBLE)
+    return;
+
+  dynVarParse(dyn_var_put(data, name, type), val + 1);
+}
+
+
 void init_dyn_vars() {
   // install dyn vars on the character datastructure
   auxiliariesInstall("dyn_var_aux_data",
@@ -246,6 +401,8 @@ void init_dyn_vars() {
 				       newDynVarAuxData, deleteDynVarAuxData,
 				       dynVarAuxDataCopyTo, dynVarAuxDataCopy,
 				       dynVarAuxDataStore,dynVarAuxDataRead));
+  dyn_var_slot = auxiliariesGetSlot("dyn_var_aux_data");
+  journalAddReplayer("dyn_var", dyn_var_replay);
 }
 
 
@@ -257,207 +414,221 @@ void init_dyn_vars() {
 //
 //*****************************************************************************
 int dynGetVarType(DYN_VAR_AUX_DATA *data, const char *key) {
-  DYN_VAR *var = (data->dyn_vars ? hashGet(data->dyn_vars, key) : NULL);
+  DYN_VAR *var = dyn_var_get(data, key);
   return (var ? var->type : DYN_VAR_INT);
 }  
 
 int dynGetInt(DYN_VAR_AUX_DATA *data, const char *key) {
-  DYN_VAR *var = (data->dyn_vars ? hashGet(data->dyn_vars, key) : NULL);
-  return (var ? atoi(var->str_val) : 0);
+  DYN_VAR *var = dyn_var_get(data, key);
+  return (var ? dynVarInt(var) : 0);
 }
 
 long dynGetLong(DYN_VAR_AUX_DATA *data, const char *key) {
-  DYN_VAR *var = (data->dyn_vars ? hashGet(data->dyn_vars, key) : NULL);
-  return (var ? atol(var->str_val) : 0);
+  DYN_VAR *var = dyn_var_get(data, key);
+  return (var ? dynVarLong(var) : 0);
 }
 
 double dynGetDouble(DYN_VAR_AUX_DATA *data, const char *key) {
-  DYN_VAR *var = (data->dyn_vars ? hashGet(data->dyn_vars, key) : NULL);
-  return (var ? atof(var->str_val) : 0);
+  DYN_VAR *var = dyn_var_get(data, key);
+  return (var ? dynVarDouble(var) : 0);
 }
 
 const char *dynGetString(DYN_VAR_AUX_DATA *data, const char *key) {
-  DYN_VAR *var = (data->dyn_vars ? hashGet(data->dyn_vars, key) : NULL);
-  return (var ? var->str_val : "");
+  DYN_VAR *var = dyn_var_get(data, key);
+  return (var ? dynVarText(var) : "");
 }
 
 void dynSetInt(DYN_VAR_AUX_DATA *data, const char *key, int val) {
-  DYN_VAR *old = (data->dyn_vars ? hashRemove(data->dyn_vars, key) : NULL);
-  if(data->dyn_vars == NULL && val != 0)
-    data->dyn_vars = newHashtable();
-  if(old != NULL) 
-    deleteDynVar(old);
-  if(val != 0)
-    hashPut(data->dyn_vars, key, newDynVarInt(val));
+  if(val == 0)
+    dyn_var_remove(data, key);
+  else
+    dyn_var_put(data, key, DYN_VAR_INT)->num.i = val;
 }
 
 void dynSetLong(DYN_VAR_AUX_DATA *data, const char *key, long val) {
-  DYN_VAR *old = (data->dyn_vars ? hashRemove(data->dyn_vars, key) : NULL);
-  if(data->dyn_vars == NULL && val != 0)
-    data->dyn_vars = newHashtable();
-  if(old != NULL) 
-    deleteDynVar(old);
-  if(val != 0)
-    hashPut(data->dyn_vars, key, newDynVarLong(val));
+  if(val == 0)
+    dyn_var_remove(data, key);
+  else
+    dyn_var_put(data, key, DYN_VAR_LONG)->num.l = val;
 }
 
 void dynSetDouble(DYN_VAR_AUX_DATA *data, const char *key, double val) {
-  DYN_VAR *old = (data->dyn_vars ? hashRemove(data->dyn_vars, key) : NULL);
-  if(data->dyn_vars == NULL && val != 0)
-    data->dyn_vars = newHashtable();
-  if(old != NULL) 
-    deleteDynVar(old);
-  if(val != 0)
-    hashPut(data->dyn_vars, key, newDynVarDouble(val));
+  if(val == 0)
+    dyn_var_remove(data, key);
+  else
+    dyn_var_put(data, key, DYN_VAR_DOUBLE)->num.d = val;
 }
 
 void dynSetString(DYN_VAR_AUX_DATA *data, const char *key, const char *val) {
-  DYN_VAR *old = (data->dyn_vars ? hashRemove(data->dyn_vars, key) : NULL);
-  if(data->dyn_vars == NULL && *val != '\0') 
-    data->dyn_vars = newHashtable();
-  if(old != NULL) 
-    deleteDynVar(old);
-  if(*val != '\0')
-    hashPut(data->dyn_vars, key, newDynVarString(val));
+  if(*val == '\0')
+    dyn_var_remove(data, key);
+  else
+    dyn_var_put(data, key, DYN_VAR_STRING)->str_val = strdup(val);
 }
 
 bool dynHasVar(DYN_VAR_AUX_DATA *data, const char *key) {
-  return (data->dyn_vars ? hashIn(data->dyn_vars, key) : FALSE);
+  return (dyn_var_find(data, key) >= 0);
 }
 
 void dynDeleteVar(DYN_VAR_AUX_DATA *data, const char *key) {
-  DYN_VAR *var = (data->dyn_vars ? hashRemove(data->dyn_vars, key) : NULL);
-  if(var != NULL) deleteDynVar(var);
+  dyn_var_remove(data, key);
 }
 
 int charGetVarType(CHAR_DATA *ch, const char *key) {
-  return dynGetVarType(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key);
+  return dynGetVarType(charGetAuxiliarySlot(ch, dyn_var_slot), key);
 }
 
 int charGetInt(CHAR_DATA *ch, const char *key) {
-  return dynGetInt(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key);
+  return dynGetInt(charGetAuxiliarySlot(ch, dyn_var_slot), key);
 }
 
 long charGetLong(CHAR_DATA *ch, const char *key) {
-  return dynGetLong(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key);
+  return dynGetLong(charGetAuxiliarySlot(ch, dyn_var_slot), key);
 }
 
 double charGetDouble(CHAR_DATA *ch, const char *key) {
-  return dynGetDouble(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key);
+  return dynGetDouble(charGetAuxiliarySlot(ch, dyn_var_slot), key);
 }
 
 const char *charGetString(CHAR_DATA *ch, const char *key) {
-  return dynGetString(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key);
+  return dynGetString(charGetAuxiliarySlot(ch, dyn_var_slot), key);
 }
 
 void charSetInt(CHAR_DATA *ch, const char *key, int val) {
-  dynSetInt(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key, val);
+  dynSetInt(charGetAuxiliarySlot(ch, dyn_var_slot), key, val);
+  dyn_var_journal(ch, key);
 }
 
 void charSetLong(CHAR_DATA *ch, const char *key, long val) {
-  dynSetLong(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key, val);
+  dynSetLong(charGetAuxiliarySlot(ch, dyn_var_slot), key, val);
+  dyn_var_journal(ch, key);
 }
 
 void charSetDouble(CHAR_DATA *ch, const char *key, double val) {
-  dynSetDouble(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key, val);
+  dynSetDouble(charGetAuxiliarySlot(ch, dyn_var_slot), key, val);
+  dyn_var_journal(ch, key);
 }
 
 void charSetString(CHAR_DATA *ch, const char *key, const char *val) {
-  dynSetString(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key, val);
+  dynSetString(charGetAuxiliarySlot(ch, dyn_var_slot), key, val);
+  dyn_var_journal(ch, key);
 }
 
 bool charHasVar(CHAR_DATA *ch, const char *key) {
-  return dynHasVar(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key);
+  return dynHasVar(charGetAuxiliarySlot(ch, dyn_var_slot), key);
 }
 
 void charDeleteVar(CHAR_DATA *ch, const char *key) {
-  dynDeleteVar(charGetAuxiliaryData(ch, "dyn_var_aux_data"), key);
+  dynDeleteVar(charGetAuxiliarySlot(ch, dyn_var_slot), key);
+  dyn_var_journal(ch, key);
+}
+
+//
+// note that a room's variables are no longer the ones it was made with
+void room_vars_dirty(ROOM_DATA *rm) {
+  DYN_VAR_AUX_DATA *data = roomGetAuxiliarySlot(rm, dyn_var_slot);
+  data->dirty = TRUE;
+}
+
+bool roomVarsDirty(ROOM_DATA *rm) {
+  DYN_VAR_AUX_DATA *data = roomGetAuxiliarySlot(rm, dyn_var_slot);
+  return data->dirty;
+}
+
+void roomSetVarsClean(ROOM_DATA *rm) {
+  DYN_VAR_AUX_DATA *data = roomGetAuxiliarySlot(rm, dyn_var_slot);
+  data->dirty = FALSE;
 }
 
 int roomGetVarType(ROOM_DATA *rm, const char *key) {
-  return dynGetVarType(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key);
+  return dynGetVarType(roomGetAuxiliarySlot(rm, dyn_var_slot), key);
 }
 
 int roomGetInt(ROOM_DATA *rm, const char *key) {
-  return dynGetInt(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key);
+  return dynGetInt(roomGetAuxiliarySlot(rm, dyn_var_slot), key);
 }
 
 long roomGetLong(ROOM_DATA *rm, const char *key) {
-  return dynGetLong(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key);
+  return dynGetLong(roomGetAuxiliarySlot(rm, dyn_var_slot), key);
 }
 
 double roomGetDouble(ROOM_DATA *rm, const char *key) {
-  return dynGetDouble(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key);
+  return dynGetDouble(roomGetAuxiliarySlot(rm, dyn_var_slot), key);
 }
 
 const char *roomGetString(ROOM_DATA *rm, const char *key) {
-  return dynGetString(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key);
+  return dynGetString(roomGetAuxiliarySlot(rm, dyn_var_slot), key);
 }
 
 void roomSetInt(ROOM_DATA *rm, const char *key, int val) {
-  dynSetInt(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key, val);
+  dynSetInt(roomGetAuxiliarySlot(rm, dyn_var_slot), key, val);
+  room_vars_dirty(rm);
 }
 
 void roomSetLong(ROOM_DATA *rm, const char *key, long val) {
-  dynSetLong(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key, val);
+  dynSetLong(roomGetAuxiliarySlot(rm, dyn_var_slot), key, val);
+  room_vars_dirty(rm);
 }
 
 void roomSetDouble(ROOM_DATA *rm, const char *key, double val) {
-  dynSetDouble(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key, val);
+  dynSetDouble(roomGetAuxiliarySlot(rm, dyn_var_slot), key, val);
+  room_vars_dirty(rm);
 }
 
 void roomSetString(ROOM_DATA *rm, const char *key, const char *val) {
-  dynSetString(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key, val);
+  dynSetString(roomGetAuxiliarySlot(rm, dyn_var_slot), key, val);
+  room_vars_dirty(rm);
 }
 
 bool roomHasVar(ROOM_DATA *rm, const char *key) {
-  return dynHasVar(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key);
+  return dynHasVar(roomGetAuxiliarySlot(rm, dyn_var_slot), key);
 }
 
 void roomDeleteVar(ROOM_DATA *rm, const char *key) {
-  dynDeleteVar(roomGetAuxiliaryData(rm, "dyn_var_aux_data"), key);
+  dynDeleteVar(roomGetAuxiliarySlot(rm, dyn_var_slot), key);
+  room_vars_dirty(rm);
 }
 
 int objGetVarType(OBJ_DATA *ob, const char *key) {
-  return dynGetVarType(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key);
+  return dynGetVarType(objGetAuxiliarySlot(ob, dyn_var_slot), key);
 }
 
 int objGetInt(OBJ_DATA *ob, const char *key) {
-  return dynGetInt(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key);
+  return dynGetInt(objGetAuxiliarySlot(ob, dyn_var_slot), key);
 }
 
 long objGetLong(OBJ_DATA *ob, const char *key) {
-  return dynGetLong(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key);
+  return dynGetLong(objGetAuxiliarySlot(ob, dyn_var_slot), key);
 }
 
 double objGetDouble(OBJ_DATA *ob, const char *key) {
-  return dynGetDouble(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key);
+  return dynGetDouble(objGetAuxiliarySlot(ob, dyn_var_slot), key);
 }
 
 const char *objGetString(OBJ_DATA *ob, const char *key) {
-  return dynGetString(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key);
+  return dynGetString(objGetAuxiliarySlot(ob, dyn_var_slot), key);
 }
 
 void objSetInt(OBJ_DATA *ob, const char *key, int val) {
-  dynSetInt(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key, val);
+  dynSetInt(objGetAuxiliarySlot(ob, dyn_var_slot), key, val);
 }
 
 void objSetLong(OBJ_DATA *ob, const char *key, long val) {
-  dynSetLong(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key, val);
+  dynSetLong(objGetAuxiliarySlot(ob, dyn_var_slot), key, val);
 }
 
 void objSetDouble(OBJ_DATA *ob, const char *key, double val) {
-  dynSetDouble(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key, val);
+  dynSetDouble(objGetAuxiliarySlot(ob, dyn_var_slot), key, val);
 }
 
 void objSetString(OBJ_DATA *ob, const char *key, const char *val) {
-  dynSetString(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key, val);
+  dynSetString(objGetAuxiliarySlot(ob, dyn_var_slot), key, val);
 }
 
 bool objHasVar(OBJ_DATA *ob, const char *key) {
-  return dynHasVar(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key);
+  return dynHasVar(objGetAuxiliarySlot(ob, dyn_var_slot), key);
 }
 
 void objDeleteVar(OBJ_DATA *ob, const char *key) {
-  dynDeleteVar(objGetAuxiliaryData(ob, "dyn_var_aux_data"), key);
+  dynDeleteVar(objGetAuxiliarySlot(ob, dyn_var_slot), key);
 }
@@ -68,4 +68,11 @@ void         roomSetString    (ROOM_DATA *ch, const char *key, const char *val);
 bool         roomHasVar       (ROOM_DATA *ch, const char *key);
 void         roomDeleteVar    (ROOM_DATA *ch, const char *key);
 
+//
+// have a room's variables been set or deleted since it was last marked clean?
+// Rooms made from their prototype are marked clean once they are made, so
+// anything their prototype sets doesn't count
+bool         roomVarsDirty    (ROOM_DATA *rm);
+void         roomSetVarsClean (ROOM_DATA *rm);
+
 #endif // __DYN_VARS_H
@@ -26,13 +26,154 @@
 
 
 
+//*****************************************************************************
+// line-indexed text
+//*****************************************************************************
+// the text being edited is kept line by line (each line keeps its own newline,
+// if it has one), with a gap left at the last place a line was added or taken
+// out. Edits near each other only move the lines that lie between them, and
+// nothing has to copy the whole text until something wants to see all of it.
+typedef struct editor_lines {
+  char    **lines;
+  int        size; // how many slots lines has
+  int   gap_start; // slots gap_start up to gap_end are unused
+  int     gap_end;
+} EDITOR_LINES;
+
+// which slot holds a line
+#define ELINES_SLOT(el, i) \
+  ((i) < (el)->gap_start ? (i) : (i) + (el)->gap_end - (el)->gap_start)
+
+EDITOR_LINES *newEditorLines(void) {
+  EDITOR_LINES *el = calloc(1, sizeof(EDITOR_LINES));
+  return el;
+}
+
+int editor_lines_count(EDITOR_LINES *el) {
+  return el->size - (el->gap_end - el->gap_start);
+}
+
+char *editor_lines_get(EDITOR_LINES *el, int i) {
+  return el->lines[ELINES_SLOT(el, i)];
+}
+
+//
+// does the last line end with a newline? No text counts as ended, too
+bool editor_lines_ended(EDITOR_LINES *el) {
+  int count = editor_lines_count(el);
+  if(count == 0)
+    return TRUE;
+  char *last = editor_lines_get(el, count - 1);
+  return (*last && last[strlen(last) - 1] == '\n');
+}
+
+//
+// move the gap so it starts right before line i
+void editor_lines_move_gap(EDITOR_LINES *el, int i) {
+  if(i < el->gap_start) {
+    int num = el->gap_start - i;
+    memmove(el->lines + el->gap_end - num, el->lines + i, num * sizeof(char *));
+    el->gap_start -= num;
+    el->gap_end   -= num;
+  }
+  else if(i > el->gap_start) {
+    int num = i - el->gap_start;
+    memmove(el->lines + el->gap_start, el->lines + el->gap_end,
+	    num * sizeof(char *));
+    el->gap_start += num;
+    el->gap_end   += num;
+  }
+}
+
+//
+// put a line before line i; the line is the list's to free, afterwards
+void editor_lines_insert(EDITOR_LINES *el, int i, char *line) {
+  editor_lines_move_gap(el, i);
+  if(el->gap_start == el->gap_end) {
+    int new_size = MAX(16, el->size * 2);
+    int    after = el->size - el->gap_end;
+    el->lines = realloc(el->lines, new_size * sizeof(char *));
+    memmove(el->lines + new_size - after, el->lines + el->gap_end,
+	    after * sizeof(char *));
+    el->gap_end = new_size - after;
+    el->size    = new_size;
+  }
+  el->lines[el->gap_start++] = line;
+}
+
+void editor_lines_remove(EDITOR_LINES *el, int i) {
+  editor_lines_move_gap(el, i);
+  free(el->lines[el->gap_end++]);
+}
+
+void editor_lines_clear(EDITOR_LINES *el) {
+  int i, count = editor_lines_count(el);
+  for(i = 0; i < count; i++)
+    free(editor_lines_get(el, i));
+  el->gap_start = 0;
+  el->gap_end   = el->size;
+}
+
+void deleteEditorLines(EDITOR_LINES *el) {
+  editor_lines_clear(el);
+  if(el->lines) free(el->lines);
+  free(el);
+}
+
+//
+// add text onto the end. If the last line hasn't ended yet, the text's first
+// line goes onto it
+void editor_lines_cat(EDITOR_LINES *el, const char *txt) {
+  const char *end = NULL;
+  int len;
+
+  if(*txt && !editor_lines_ended(el)) {
+    int     last = editor_lines_count(el) - 1;
+    char   *line = editor_lines_get(el, last);
+    int line_len = strlen(line);
+    end  = strchr(txt, '\n');
+    len  = (end ? end - txt + 1 : strlen(txt));
+    line = realloc(line, line_len + len + 1);
+    memcpy(line + line_len, txt, len);
+    line[line_len + len] = '\0';
+    el->lines[ELINES_SLOT(el, last)] = line;
+    txt += len;
+  }
+
+  while(*txt) {
+    end = strchr(txt, '\n');
+    len = (end ? end - txt + 1 : strlen(txt));
+    editor_lines_insert(el, editor_lines_count(el), strndup(txt, len));
+    txt += len;
+  }
+}
+
+void editor_lines_set(EDITOR_LINES *el, const char *txt) {
+  editor_lines_clear(el);
+  editor_lines_cat(el, txt);
+}
+
+//
+// put the lines back together into one string
+void editor_lines_to_buffer(EDITOR_LINES *el, BUFFER *buf) {
+  int i, count = editor_lines_count(el);
+  bufferClear(buf);
+  for(i = 0; i < count; i++)
+    bufferCat(buf, editor_lines_get(el, i));
+}
+
+
+
 //*****************************************************************************
 // auxiliary data for sockets
 //*****************************************************************************
 typedef struct editor_aux_data {
-  EDITOR   *editor;      // the editor we're using
-  BUFFER   *buf;         // the buffer we're editing (if any)
-  BUFFER   *working_buf; // the buffer where we do our work
+  EDITOR       *editor; // the editor we're using
+  BUFFER          *buf; // the buffer we're editing (if any)
+  EDITOR_LINES  *lines; // the text we're working on
+  BUFFER  *working_buf; // the lines put together, for what needs all the text
+  bool       buf_stale; // have the lines changed since working_buf was made?
+  BUFFER   *append_buf; // where the editor's append puts new text
   PyObject *py_complete; // python function to call on completion of editing
   void    (* on_complete)(SOCKET_DATA *sock, const char *str);
 } EDITOR_AUX_DATA;
@@ -40,27 +181,54 @@ typedef struct editor_aux_data {
 EDITOR_AUX_DATA *newEditorAuxData() {
   EDITOR_AUX_DATA *data = malloc(sizeof(EDITOR_AUX_DATA));
   bzero(data, sizeof(EDITOR_AUX_DATA));
-  return data; // the buffer, working buffer, and editor are null 'til needed
+  return data; // the buffers, lines, and editor are null 'til needed
 }
 
 void deleteEditorAuxData(EDITOR_AUX_DATA *data) {
-  // if we have a working buf, free it. Don't touch anything else. that
+  // if we have working text, free it. Don't touch anything else. that
   // stuff will be needed by the rest of the program
+  if(data->lines)       deleteEditorLines(data->lines);
   if(data->working_buf) deleteBuffer(data->working_buf);
+  if(data->append_buf)  deleteBuffer(data->append_buf);
   if(data->py_complete) { Py_DECREF(data->py_complete); }
   free(data);
 }
 
 void clearEditorAuxData(EDITOR_AUX_DATA *data) {
+  if(data->lines)       deleteEditorLines(data->lines);
   if(data->working_buf) deleteBuffer(data->working_buf);
+  if(data->append_buf)  deleteBuffer(data->append_buf);
   if(data->py_complete) { Py_DECREF(data->py_complete); }
+  data->lines       = NULL;
   data->working_buf = NULL;
+  data->append_buf  = NULL;
+  data->buf_stale   = FALSE;
   data->editor      = NULL;
   data->buf         = NULL;
   data->on_complete = NULL;
   data->py_complete = NULL;
 }
 
+//
+// set up the text a socket is about to start editing
+void editor_start_text(EDITOR_AUX_DATA *data, const char *dflt) {
+  data->lines       = newEditorLines();
+  data->working_buf = newBuffer(1);
+  data->append_buf  = newBuffer(1);
+  editor_lines_set(data->lines, dflt);
+  data->buf_stale   = TRUE;
+}
+
+//
+// the whole of the text being edited
+BUFFER *editor_text(EDITOR_AUX_DATA *data) {
+  if(data->buf_stale) {
+    editor_lines_to_buffer(data->lines, data->working_buf);
+    data->buf_stale = FALSE;
+  }
+  return data->working_buf;
+}
+
 
 
 //*****************************************************************************
@@ -85,16 +253,18 @@ typedef struct command_data {
   void (* func)(SOCKET_DATA *sock, char *arg, BUFFER *buf);
   char *desc;    // the one-line helpfile description
   bool reserved; // is this command protected from being written over?
+  bool uses_buf; // does it work on the whole text, and not the lines?
 } ECMD_DATA;
 
 ECMD_DATA *
 newEditorCommand(const char *desc, 
 		 void func(SOCKET_DATA *sock, char *arg, BUFFER *buf),
-		 bool reserved) {
+		 bool reserved, bool uses_buf) {
   ECMD_DATA *cmd = malloc(sizeof(ECMD_DATA));
   cmd->desc     = strdup(desc ? desc : "");
   cmd->func     = func;
   cmd->reserved = reserved;
+  cmd->uses_buf = uses_buf;
   return cmd;
 }
 
@@ -137,13 +307,32 @@ void editorDefaultAppend(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
 // the function for appending text to a dialog buffer. 
 //
 void editorDialogAppend(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
-  // if the buffer isn't empty, cat a space
-  if(bufferLength(buf) > 0)
+  EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data");
+  // if the dialog isn't empty, cat a space
+  if(editor_lines_count(data->lines) > 0)
     bufferCat(buf, " ");
   bufferCat(buf, arg);
 }
 
 
+//
+// run an editor command. Commands that work on the whole text get it put
+// together into one buffer, and the lines are split back out of it after
+//
+void editor_run_cmd(SOCKET_DATA *sock, EDITOR_AUX_DATA *data, ECMD_DATA *cmd,
+		    char *arg) {
+  if(!cmd->uses_buf)
+    cmd->func(sock, arg, NULL);
+  else {
+    BUFFER *buf = editor_text(data);
+    cmd->func(sock, arg, buf);
+    // make sure it didn't quit the editor on us
+    if(data->working_buf == buf)
+      editor_lines_set(data->lines, bufferString(buf));
+  }
+}
+
+
 //
 // The function that takes in a new command and figures out what to
 // do with it
@@ -162,10 +351,14 @@ void editorInputHandler(SOCKET_DATA *sock, char *arg) {
     if(cmd == NULL)
       text_to_buffer(sock, "Invalid command.\r\n");
     else
-      cmd->func(sock, arg, data->working_buf);
+      editor_run_cmd(sock, data, cmd, arg);
+  }
+  else {
+    bufferClear(data->append_buf);
+    data->editor->append(sock, arg, data->append_buf);
+    editor_lines_cat(data->lines, bufferString(data->append_buf));
+    data->buf_stale = TRUE;
   }
-  else
-    data->editor->append(sock, arg, data->working_buf);
 }
 
 
@@ -175,12 +368,12 @@ void editorInputHandler(SOCKET_DATA *sock, char *arg) {
 void editorQuit(SOCKET_DATA *sock, char *arg, BUFFER *buf) { 
   // save the current changes
   EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data");
+  const char       *txt = bufferString(editor_text(data));
   if(data->on_complete)
-    data->on_complete(sock, bufferString(buf));
+    data->on_complete(sock, txt);
   else if(data->py_complete) {
     PyObject *ret = PyObject_CallFunction(data->py_complete, "Os", 
-					  socketGetPyFormBorrowed(sock),
-					  bufferString(buf));
+					  socketGetPyFormBorrowed(sock), txt);
     if(ret == NULL)
       log_pyerr("Error quitting the buffer editor.");
     Py_XDECREF(ret);
@@ -215,7 +408,7 @@ void editorDeleteLine(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
   char tmp[SMALL_BUFFER];
   arg = one_arg(arg, tmp);
   int line = atoi(tmp);
-  if(!isdigit(*tmp) || !bufferRemove(buf, line))
+  if(!isdigit(*tmp) || !socketEditorRemoveLine(sock, line))
     text_to_buffer(sock, "Line does not exist.\r\n");
   else
     text_to_buffer(sock, "Line deleted.\r\n");
@@ -225,7 +418,7 @@ void editorEditLine(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
   char tmp[SMALL_BUFFER];
   arg = one_arg(arg, tmp);
   int line = atoi(tmp);
-  if(!isdigit(*tmp) || !bufferReplaceLine(buf, arg, line))
+  if(!isdigit(*tmp) || !socketEditorReplaceLine(sock, line, arg, "\r\n"))
     text_to_buffer(sock, "Line does not exist.\r\n");
   else
     text_to_buffer(sock, "Line replaced.\r\n");
@@ -235,20 +428,22 @@ void editorInsertLine(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
   char tmp[SMALL_BUFFER];
   arg = one_arg(arg, tmp);
   int line = atoi(tmp);
-  if(!isdigit(*tmp) || !bufferInsert(buf, arg, line))
+  if(!isdigit(*tmp) || !socketEditorInsertLine(sock, line, arg, "\r\n"))
     text_to_buffer(sock, "Insertion failed.\r\n");
   else
     text_to_buffer(sock, "Line inserted.\r\n");
 }
 
 void editorListDialogBuffer(SOCKET_DATA *sock, char *arg, BUFFER *buf) { 
-  if(*bufferString(buf))
-    send_to_socket(sock, "%s\r\n", bufferString(buf));
+  const char *txt = socketGetEditorText(sock);
+  if(*txt)
+    send_to_socket(sock, "%s\r\n", txt);
 }
 
 void editorListBuffer(SOCKET_DATA *sock, char *arg, BUFFER *buf) { 
-  if(*bufferString(buf))
-    text_to_buffer(sock, bufferString(buf));
+  const char *txt = socketGetEditorText(sock);
+  if(*txt)
+    text_to_buffer(sock, txt);
 }
 
 void editorReplace(SOCKET_DATA *sock, char *arg, BUFFER *buf, bool all) {
@@ -288,7 +483,9 @@ void editorReplaceAllString(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
 }
 
 void editorClear(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
-  bufferClear(buf);
+  EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data");
+  editor_lines_clear(data->lines);
+  data->buf_stale = TRUE;
   text_to_buffer(sock, "Buffer cleared.\r\n");
 }
 
@@ -312,9 +509,9 @@ void init_editor() {
   dialog_editor = newEditor();
   editorSetAppend(dialog_editor, editorDialogAppend);
   editorRemoveCommand(dialog_editor, "f");
-  editorAddCommand(dialog_editor, "l", 
-		   "        List the current buffer contents",
-		   editorListDialogBuffer);
+  editorAddLineCommand(dialog_editor, "l", 
+		       "        List the current buffer contents",
+		       editorListDialogBuffer);
 }
 
 EDITOR *newEditor() {
@@ -323,37 +520,37 @@ EDITOR *newEditor() {
   editor->cmds = newHashtable();
   hashPut(editor->cmds, "q", 
 	  newEditorCommand("        Quit editor and save changes",
-			   editorQuit, TRUE));
+			   editorQuit, TRUE, FALSE));
   hashPut(editor->cmds, "a", 
 	  newEditorCommand("        Quit editor and don't save",
-			   editorAbort, TRUE));
+			   editorAbort, TRUE, FALSE));
   hashPut(editor->cmds, "h", 
 	  newEditorCommand("        Display editor commands",
-			   editorDisplayHelp, TRUE));
+			   editorDisplayHelp, TRUE, FALSE));
   hashPut(editor->cmds, "c", 
 	  newEditorCommand("        Clear the contents of the buffer",
-			   editorClear, TRUE));
+			   editorClear, TRUE, FALSE));
   hashPut(editor->cmds, "l",
 	  newEditorCommand("        List the current buffer contents",
-			   editorListBuffer, FALSE));
+			   editorListBuffer, FALSE, FALSE));
   hashPut(editor->cmds, "d", 
 	  newEditorCommand("#       Delete line with the specified number", 
-			   editorDeleteLine, FALSE));
+			   editorDeleteLine, FALSE, FALSE));
   hashPut(editor->cmds, "e", 
 	  newEditorCommand("# <txt> Sets the text at the specified line to the new text",
-			   editorEditLine, FALSE));
+			   editorEditLine, FALSE, FALSE));
   hashPut(editor->cmds, "i", 
 	  newEditorCommand("# <txt> Insert new text at the specified line number",
-			   editorInsertLine, FALSE));
+			   editorInsertLine, FALSE, FALSE));
   hashPut(editor->cmds, "f",
 	  newEditorCommand("        Formats your text into a paragraph",
-			   editorFormatBuffer, FALSE));
+			   editorFormatBuffer, FALSE, TRUE));
   hashPut(editor->cmds, "r",
 	  newEditorCommand("'a' 'b' replace first occurence of 'a' with 'b'",
-			   editorReplaceString, FALSE));
+			   editorReplaceString, FALSE, TRUE));
   hashPut(editor->cmds, "ra",
 	  newEditorCommand("'a' 'b' repalce all occurences of 'a' with 'b'",
-			   editorReplaceAllString, FALSE));
+			   editorReplaceAllString, FALSE, TRUE));
 
   // set up the default prompt, header, and appending function
   editor->prompt = editorDefaultPrompt;
@@ -380,7 +577,16 @@ void editorAddCommand(EDITOR *editor, const char *cmd, const char *desc,
   ECMD_DATA *old_cmd = hashGet(editor->cmds, cmd);
   // make sure we're not trying to replace a reserved command
   if(!old_cmd || !old_cmd->reserved) {
-    hashPut(editor->cmds, cmd, newEditorCommand(desc, func, FALSE));
+    hashPut(editor->cmds, cmd, newEditorCommand(desc, func, FALSE, TRUE));
+    if(old_cmd) deleteEditorCommand(old_cmd);
+  }
+}
+
+void editorAddLineCommand(EDITOR *editor, const char *cmd, const char *desc, 
+			  void func(SOCKET_DATA *sock, char *arg, BUFFER *buf)){
+  ECMD_DATA *old_cmd = hashGet(editor->cmds, cmd);
+  if(!old_cmd || !old_cmd->reserved) {
+    hashPut(editor->cmds, cmd, newEditorCommand(desc, func, FALSE, FALSE));
     if(old_cmd) deleteEditorCommand(old_cmd);
   }
 }
@@ -409,9 +615,9 @@ void begin_editor(SOCKET_DATA *sock) {
   // if we have a "list" command, execute it. Otherwise, cat the buf
   ECMD_DATA *list = NULL;
   if((list = hashGet(data->editor->cmds, "l")) != NULL)
-    list->func(sock, "", data->working_buf);
+    editor_run_cmd(sock, data, list, "");
   else
-    text_to_buffer(sock, bufferString(data->working_buf));
+    text_to_buffer(sock, bufferString(editor_text(data)));
 
   socketPushInputHandler(sock, editorInputHandler, data->editor->prompt, 
 			 "text editor");
@@ -420,8 +626,7 @@ void begin_editor(SOCKET_DATA *sock) {
 void socketStartPyEditorFunc(SOCKET_DATA *sock, EDITOR *editor,const char *dflt,
 			     void *py_complete) {
   EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data"); 
-  data->working_buf = newBuffer(1);
-  bufferCat(data->working_buf, dflt);
+  editor_start_text(data, dflt);
   data->editor      = editor;
   data->py_complete = py_complete;
   Py_XINCREF(data->py_complete);
@@ -431,8 +636,7 @@ void socketStartPyEditorFunc(SOCKET_DATA *sock, EDITOR *editor,const char *dflt,
 void socketStartEditorFunc(SOCKET_DATA *sock, EDITOR *editor, const char *dflt,
 			   void (* on_complete)(SOCKET_DATA *, const char *)) {
   EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data"); 
-  data->working_buf = newBuffer(1);
-  bufferCat(data->working_buf, dflt);
+  editor_start_text(data, dflt);
   data->editor      = editor;
   data->on_complete = on_complete;
   if(editor->init) editor->init(sock);
@@ -449,3 +653,42 @@ EDITOR *socketGetEditor(SOCKET_DATA *sock) {
   EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data");
   return data->editor;
 }
+
+const char *socketGetEditorText(SOCKET_DATA *sock) {
+  EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data");
+  return (data->lines ? bufferString(editor_text(data)) : "");
+}
+
+//
+// line is 1-based, as line numbers are listed. Lines can be put in after the
+// last line, as long as it has ended
+bool socketEditorInsertLine(SOCKET_DATA *sock, int line, const char *txt,
+			    const char *newline) {
+  EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data");
+  if(data->lines == NULL)
+    return FALSE;
+  int count = editor_lines_count(data->lines);
+  if(line < 1 || line > count + 1 ||
+     (line == count + 1 && !editor_lines_ended(data->lines)))
+    return FALSE;
+  char *str = malloc(strlen(txt) + strlen(newline) + 1);
+  sprintf(str, "%s%s", txt, newline);
+  editor_lines_insert(data->lines, line - 1, str);
+  data->buf_stale = TRUE;
+  return TRUE;
+}
+
+bool socketEditorRemoveLine(SOCKET_DATA *sock, int line) {
+  EDITOR_AUX_DATA *data = socketGetAuxiliaryData(sock, "editor_aux_data");
+  if(data->lines == NULL || line < 1 || line > editor_lines_count(data->lines))
+    return FALSE;
+  editor_lines_remove(data->lines, line - 1);
+  data->buf_stale = TRUE;
+  return TRUE;
+}
+
+bool socketEditorReplaceLine(SOCKET_DATA *sock, int line, const char *txt,
+			     const char *newline) {
+  return (socketEditorRemoveLine(sock, line) &&
+	  socketEditorInsertLine(sock, line, txt, newline));
+}
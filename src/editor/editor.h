@@ -54,7 +54,8 @@ void editorSetInit(EDITOR *editor, void init(SOCKET_DATA *sock));
 //
 // change the function that appends data to the buffer. This may be useful in
 // some cases where previous input determines how the next input is appended.
-// So, for instance, if/else blocks for scripts.
+// So, for instance, if/else blocks for scripts. The buffer it is handed is
+// empty; whatever it puts there is added onto the end of the text.
 void editorSetAppend(EDITOR *editor,
 		     void append(SOCKET_DATA *sock, char *arg, BUFFER *buf));
 
@@ -68,6 +69,15 @@ void editorSetAppend(EDITOR *editor,
 void editorAddCommand(EDITOR *editor, const char *cmd, const char *desc, 
 		      void func(SOCKET_DATA *sock, char *arg, BUFFER *buf));
 
+//
+// The text being edited is kept line by line, and only put together into one
+// buffer for commands that need all of it. Commands added with editorAddCommand
+// are handed the whole text, and it is split back into lines after they run.
+// Commands that only look at lines, or change them with the functions below,
+// should be added with this instead; they are handed a NULL buffer.
+void editorAddLineCommand(EDITOR *editor, const char *cmd, const char *desc, 
+			  void func(SOCKET_DATA *sock, char *arg, BUFFER *buf));
+
 //
 // Remove a command from the text editor. None of the reserved commands can be
 // removed. This is basically intended to allow programmers to remove
@@ -91,4 +101,19 @@ void socketStartPyEditorFunc(SOCKET_DATA *sock, EDITOR *editor,const char *dflt,
 // get a pointer to the current editor the socket is using, if any
 EDITOR *socketGetEditor(SOCKET_DATA *sock);
 
+//
+// the whole of the text the socket is editing
+const char *socketGetEditorText(SOCKET_DATA *sock);
+
+//
+// change one line of the text the socket is editing. Lines are numbered from
+// 1, and new lines can go in after the last one. The text is followed by
+// newline, which is whatever the editor ends its lines with. Each returns
+// FALSE if there is no such line
+bool socketEditorInsertLine (SOCKET_DATA *sock, int line, const char *txt,
+			     const char *newline);
+bool socketEditorReplaceLine(SOCKET_DATA *sock, int line, const char *txt,
+			     const char *newline);
+bool socketEditorRemoveLine (SOCKET_DATA *sock, int line);
+
 #endif // EDITOR_H
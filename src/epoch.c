@@ -0,0 +1,217 @@
+//*****************************************************************************
+//
+// epoch.c
+//
+// epoch-based reclamation of things that have been taken out of the game.
+// See epoch.h for details. There are three batches of retired things: the
+// one for the current epoch, the one for the epoch before it, and the one for
+// the epoch before that. Once every participant has caught up to the current
+// epoch, the epoch is moved forward, and the oldest batch (which nobody can
+// be looking at any more) is freed and reused for the new epoch.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "epoch.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how many batches we keep around. Must be 3; see above
+#define EPOCH_BATCHES               3
+
+// how many classes of retired things there can be
+#define MAX_EPOCH_CLASSES          16
+
+// how many threads can participate at once
+#define MAX_EPOCH_PARTICIPANTS     32
+
+struct epoch_class {
+  void (* func)(void *data); // what we free our retired things with
+  int           index;       // which list in a batch is ours
+};
+
+struct epoch_participant {
+  bool      registered; // is this slot in use?
+  bool          active; // is the participant inside an epoch right now?
+  unsigned long  epoch; // the epoch it entered
+};
+
+// everything below is protected by epoch_lock
+pthread_mutex_t                  epoch_lock = PTHREAD_MUTEX_INITIALIZER;
+unsigned long                  epoch_global = 0;
+LIST *epoch_batches[EPOCH_BATCHES][MAX_EPOCH_CLASSES];
+EPOCH_CLASS *epoch_classes[MAX_EPOCH_CLASSES];
+int                       epoch_num_classes = 0;
+EPOCH_PARTICIPANT epoch_parts[MAX_EPOCH_PARTICIPANTS];
+SET                          *epoch_retired = NULL; // everything pending
+int                           epoch_pending = 0;
+
+//
+// which batch are things retired during an epoch put in?
+#define epoch_batch_of(epoch)       ((int)((epoch) % EPOCH_BATCHES))
+
+//
+// free everything in a batch, one class at a time. Freeing something can
+// retire more things (a character being finalized can extract things, for
+// instance), so the lock is only held while we take the next thing off
+void epoch_free_batch(int batch) {
+  int i;
+  for(i = 0; i < epoch_num_classes; i++) {
+    EPOCH_CLASS *cls = epoch_classes[i];
+    void       *data = NULL;
+    for(;;) {
+      pthread_mutex_lock(&epoch_lock);
+      if((data = listPop(epoch_batches[batch][i])) != NULL) {
+	setRemove(epoch_retired, data);
+	epoch_pending--;
+      }
+      pthread_mutex_unlock(&epoch_lock);
+      if(data == NULL)
+	break;
+      cls->func(data);
+    }
+  }
+}
+
+//
+// returns TRUE if nothing has been retired into the batch. Only used by the
+// game thread, between frees
+bool epoch_batch_empty(int batch) {
+  bool empty = TRUE;
+  int i;
+  pthread_mutex_lock(&epoch_lock);
+  for(i = 0; i < epoch_num_classes && empty; i++)
+    empty = (listSize(epoch_batches[batch][i]) == 0);
+  pthread_mutex_unlock(&epoch_lock);
+  return empty;
+}
+
+
+
+//*****************************************************************************
+// implementation of epoch.h
+//*****************************************************************************
+void init_epoch(void) {
+  epoch_retired = newSet();
+}
+
+EPOCH_CLASS *newEpochClass(void *func) {
+  if(epoch_num_classes >= MAX_EPOCH_CLASSES) {
+    log_string("ERROR: too many epoch classes! Increase MAX_EPOCH_CLASSES.");
+    return NULL;
+  }
+
+  EPOCH_CLASS *cls = malloc(sizeof(EPOCH_CLASS));
+  int            i = 0;
+  cls->func        = func;
+  pthread_mutex_lock(&epoch_lock);
+  cls->index       = epoch_num_classes;
+  for(i = 0; i < EPOCH_BATCHES; i++)
+    epoch_batches[i][cls->index] = newList();
+  epoch_classes[epoch_num_classes++] = cls;
+  pthread_mutex_unlock(&epoch_lock);
+  return cls;
+}
+
+void epochRetire(EPOCH_CLASS *cls, void *data) {
+  pthread_mutex_lock(&epoch_lock);
+  listPut(epoch_batches[epoch_batch_of(epoch_global)][cls->index], data);
+  setPut(epoch_retired, data);
+  epoch_pending++;
+  pthread_mutex_unlock(&epoch_lock);
+}
+
+bool epochIsRetired(void *data) {
+  pthread_mutex_lock(&epoch_lock);
+  bool retired = setIn(epoch_retired, data);
+  pthread_mutex_unlock(&epoch_lock);
+  return retired;
+}
+
+EPOCH_PARTICIPANT *epochRegister(void) {
+  EPOCH_PARTICIPANT *part = NULL;
+  int i;
+  pthread_mutex_lock(&epoch_lock);
+  for(i = 0; i < MAX_EPOCH_PARTICIPANTS && part == NULL; i++) {
+    if(!epoch_parts[i].registered) {
+      part             = &epoch_parts[i];
+      part->registered = TRUE;
+      part->active     = FALSE;
+    }
+  }
+  pthread_mutex_unlock(&epoch_lock);
+  return part;
+}
+
+void epochUnregister(EPOCH_PARTICIPANT *part) {
+  pthread_mutex_lock(&epoch_lock);
+  part->registered = FALSE;
+  part->active     = FALSE;
+  pthread_mutex_unlock(&epoch_lock);
+}
+
+void epochEnter(EPOCH_PARTICIPANT *part) {
+  pthread_mutex_lock(&epoch_lock);
+  part->active = TRUE;
+  part->epoch  = epoch_global;
+  pthread_mutex_unlock(&epoch_lock);
+}
+
+void epochExit(EPOCH_PARTICIPANT *part) {
+  pthread_mutex_lock(&epoch_lock);
+  part->active = FALSE;
+  pthread_mutex_unlock(&epoch_lock);
+}
+
+void epochAdvance(void) {
+  unsigned long epoch = 0;
+  bool          quiet = TRUE;
+  int               i = 0;
+
+  do {
+    // everyone who is inside an epoch must have caught up to the current one
+    pthread_mutex_lock(&epoch_lock);
+    quiet = TRUE;
+    for(i = 0; i < MAX_EPOCH_PARTICIPANTS; i++) {
+      if(!epoch_parts[i].registered || !epoch_parts[i].active)
+	continue;
+      quiet = FALSE;
+      if(epoch_parts[i].epoch != epoch_global) {
+	pthread_mutex_unlock(&epoch_lock);
+	return;
+      }
+    }
+    epoch = ++epoch_global;
+    pthread_mutex_unlock(&epoch_lock);
+
+    // nobody can be looking at what was retired two epochs ago. If nobody
+    // was inside an epoch at all, what was retired last epoch is safe too
+    epoch_free_batch(epoch_batch_of(epoch + 1));
+    if(quiet)
+      epoch_free_batch(epoch_batch_of(epoch + 2));
+
+    // if freeing things retired more things and nobody was around to see
+    // them, go around again so they are freed this pulse as well
+  } while(quiet && !epoch_batch_empty(epoch_batch_of(epoch)));
+}
+
+unsigned long epochCurrent(void) {
+  pthread_mutex_lock(&epoch_lock);
+  unsigned long epoch = epoch_global;
+  pthread_mutex_unlock(&epoch_lock);
+  return epoch;
+}
+
+int epochPending(void) {
+  pthread_mutex_lock(&epoch_lock);
+  int pending = epoch_pending;
+  pthread_mutex_unlock(&epoch_lock);
+  return pending;
+}
@@ -0,0 +1,72 @@
+#ifndef __EPOCH_H
+#define __EPOCH_H
+//*****************************************************************************
+//
+// epoch.h
+//
+// epoch-based reclamation of things that have been taken out of the game,
+// but that someone might still be holding a pointer to. Rather than being
+// freed right away, they are retired. Everything retired during one epoch is
+// kept in a batch, and the batch is freed once every thread that might have
+// seen those things has moved on to a later epoch.
+//
+// The game thread moves the epoch forward once per pulse, at the end of
+// update_handler, when it is not holding on to anything. Other threads that
+// want to look at game data (or borrow things the game thread hands them)
+// register as participants, and bracket the time they spend doing so with
+// epochEnter and epochExit. While no participant is inside an epoch, which
+// is the usual case, everything retired is freed at the end of the pulse.
+//
+// Retired things are grouped into classes, each with the function that
+// frees them. When a batch is freed, the classes are gone through in the
+// order they were made, and each class is emptied before the next one is
+// started, so e.g. characters are always finalized before objects.
+//
+//*****************************************************************************
+
+typedef struct epoch_class       EPOCH_CLASS;
+typedef struct epoch_participant EPOCH_PARTICIPANT;
+
+//
+// set up epoch reclamation. Must be called before anything else here
+void init_epoch(void);
+
+//
+// make a new class of retired things, which are freed with func
+EPOCH_CLASS *newEpochClass(void *func);
+
+//
+// retire something. It is freed with its class's function once nobody can
+// still be looking at it. Safe to call from any thread
+void epochRetire(EPOCH_CLASS *cls, void *data);
+
+//
+// returns TRUE if data has been retired, and is waiting to be freed
+bool epochIsRetired(void *data);
+
+//
+// register and unregister a thread as a participant. A participant must not
+// be inside an epoch when it is unregistered. Returns NULL if there are too
+// many participants already
+EPOCH_PARTICIPANT *epochRegister  (void);
+void               epochUnregister(EPOCH_PARTICIPANT *part);
+
+//
+// a participant must enter an epoch before it touches anything that could
+// be retired, and exit it when it is done. Nothing retired after it entered
+// will be freed until it exits
+void epochEnter(EPOCH_PARTICIPANT *part);
+void epochExit (EPOCH_PARTICIPANT *part);
+
+//
+// move the epoch forward if every participant has caught up to it, and free
+// the batches nobody can be looking at any more. Called by the game thread
+// once per pulse, when it is not holding on to anything that could be retired
+void epochAdvance(void);
+
+//
+// the current epoch, and how many things are waiting to be freed
+unsigned long epochCurrent(void);
+int           epochPending(void);
+
+#endif // __EPOCH_H
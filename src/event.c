@@ -22,17 +22,54 @@
 #include "event.h"
 
 typedef struct event_data EVENT_DATA;
-LIST    *events = NULL;
+
+//
+// events are kept in a min-heap, ordered by the pulse they are due to go off
+// on, so each pulse only has to look at the events that are due. Events due
+// on the same pulse go off in the order they were started, which means
+// events started with a delay of 0 while other events are going off are run
+// right after them, on the same pulse.
+EVENT_DATA **events = NULL;
+int      num_events = 0;
+int     events_size = 0;
+
+// how many pulses have gone by, and how many events have been started
+long long event_pulse = 0;
+long long   event_seq = 0;
+
+//
+// so interrupting events doesn't have to look at every event, each event is
+// indexed under its owner and everything else it was started as involving.
+// Events that supply a check_involvement function can't be indexed by what
+// they involve, and still have to be checked every time something is
+// interrupted
+MAP     *event_index = NULL;
+LIST *scanned_events = NULL;
+
+//
+// events are started and finished constantly, so finished events are kept
+// on a free list to be reused instead of going back to malloc. Short args are
+// kept inside of the event itself
+#define EVENT_ARG_INLINE       32
+#define MAX_FREE_EVENTS      1024
+EVENT_DATA  *free_events = NULL;
+int      num_free_events = 0;
 
 struct event_data {
   void *owner;   // who is the lucky person who owns this event?
   void (*  on_complete)(void *owner, void *data, char *arg);
+  void (* on_interrupt)(void *owner, void *data, char *arg);
   bool (*  check_involvement)(void *thing, void *data);
-  int   delay;   // how much longer until the event is complete?
+  long long due; // the pulse the event goes off on
+  long long seq; // when we were started, relative to other events
   int   tot_time;// what is the total delay before the event fires?
   void *data;    // data for the event
   char *arg;     // an argument supplied to an event
+  char  arg_buf[EVENT_ARG_INLINE]; // where arg lives when it is short
+  EVENT_DATA *next_free; // the next event in the free list
   bool  requeue; // is the event requeue'd after it goes off?
+  int   heap_i;  // where we are in the event heap
+  LIST *involves;// other things we are indexed under, besides our owner
 };
 
 
@@ -42,26 +79,60 @@ struct event_data {
 // event handling
 //
 //*****************************************************************************
+
+//
+// copy an arg into the event's inline buffer if it fits, or onto the heap
+// if it doesn't
+char *event_arg_copy(char *buf, const char *arg) {
+  int len = (arg ? strlen(arg) : 0);
+  if(len >= EVENT_ARG_INLINE)
+    return strdup(arg);
+  if(len > 0)
+    memcpy(buf, arg, len);
+  buf[len] = '\0';
+  return buf;
+}
+
 EVENT_DATA *newEvent(void *owner,
 		     int delay, 	
 		     void (*  on_complete)(void *owner, void *data, char *arg),
 		     bool (* check_involvement)(void *thing, void *data),
 		     void *data, const char *arg, bool requeue) {
-  EVENT_DATA *event        = malloc(sizeof(EVENT_DATA));
+  EVENT_DATA *event        = free_events;
+  if(event != NULL) {
+    free_events = event->next_free;
+    num_free_events--;
+  }
+  else
+    event = malloc(sizeof(EVENT_DATA));
   event->owner             = owner;
   event->on_complete       = on_complete;
+  event->on_interrupt      = NULL;
   event->check_involvement = check_involvement;
-  event->delay             = delay;
+  event->due               = 0;
+  event->seq               = 0;
   event->tot_time          = delay;
   event->data              = data;
-  event->arg               = strdupsafe(arg);
+  event->arg               = event_arg_copy(event->arg_buf, arg);
   event->requeue           = requeue;
+  event->heap_i            = -1;
+  event->involves          = NULL;
   return event;
 }
 
+void event_index_remove(EVENT_DATA *event);
+
 void deleteEvent(EVENT_DATA *event) {
-  if(event->arg) free(event->arg);
-  free(event);
+  event_index_remove(event);
+  if(event->involves) deleteList(event->involves);
+  if(event->arg != event->arg_buf) free(event->arg);
+  if(num_free_events >= MAX_FREE_EVENTS)
+    free(event);
+  else {
+    event->next_free = free_events;
+    free_events      = event;
+    num_free_events++;
+  }
 }
 
 void run_event(EVENT_DATA *event) {
@@ -90,10 +161,139 @@ void interrupt_events_room_hook(const char *info) {
 
 
 //*****************************************************************************
-// event list handling
+// the event heap
+//*****************************************************************************
+
+//
+// does event a go off before event b?
+bool event_before(EVENT_DATA *a, EVENT_DATA *b) {
+  return (a->due < b->due || (a->due == b->due && a->seq < b->seq));
+}
+
+void event_heap_set(int i, EVENT_DATA *event) {
+  events[i]     = event;
+  event->heap_i = i;
+}
+
+void event_heap_up(int i) {
+  EVENT_DATA *event = events[i];
+  while(i > 0 && event_before(event, events[(i - 1) / 2])) {
+    event_heap_set(i, events[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  event_heap_set(i, event);
+}
+
+void event_heap_down(int i) {
+  EVENT_DATA *event = events[i];
+  for(;;) {
+    int child = i * 2 + 1;
+    if(child >= num_events)
+      break;
+    if(child + 1 < num_events && event_before(events[child+1], events[child]))
+      child++;
+    if(!event_before(events[child], event))
+      break;
+    event_heap_set(i, events[child]);
+    i = child;
+  }
+  event_heap_set(i, event);
+}
+
+//
+// schedule the event to go off delay pulses from now
+void event_heap_put(EVENT_DATA *event, int delay) {
+  if(num_events >= events_size) {
+    events_size = MAX(events_size * 2, 64);
+    events      = realloc(events, sizeof(EVENT_DATA *) * events_size);
+  }
+  event->due = event_pulse + MAX(delay, 0);
+  event->seq = event_seq++;
+  event_heap_set(num_events++, event);
+  event_heap_up(num_events - 1);
+}
+
+//
+// take the event out of the heap
+void event_heap_remove(EVENT_DATA *event) {
+  int i = event->heap_i;
+  event->heap_i = -1;
+  if(--num_events == i)
+    return;
+  event_heap_set(i, events[num_events]);
+  event_heap_up(i);
+  event_heap_down(events[i]->heap_i);
+}
+
+
+
+//*****************************************************************************
+// the event index
+//*****************************************************************************
+void event_index_put(const void *thing, EVENT_DATA *event) {
+  LIST *list = mapGet(event_index, thing);
+  if(list == NULL) {
+    list = newList();
+    mapPut(event_index, thing, list);
+  }
+  listPut(list, event);
+}
+
+void event_index_take(const void *thing, EVENT_DATA *event) {
+  LIST *list = mapGet(event_index, thing);
+  if(list != NULL) {
+    listRemove(list, event);
+    if(listSize(list) == 0) {
+      mapRemove(event_index, thing);
+      deleteList(list);
+    }
+  }
+}
+
+//
+// index the event under its owner and everything it involves. An event is
+// only ever indexed once under the same thing
+void event_index_add(EVENT_DATA *event, LIST *involves) {
+  event_index_put(event->owner, event);
+  if(event->check_involvement != NULL)
+    listPut(scanned_events, event);
+  if(involves != NULL) {
+    LOCAL_LIST_ITERATOR(inv_i, involves);
+    void           *thing = NULL;
+    ITERATE_LIST(thing, inv_i) {
+      if(thing == event->owner)
+	continue;
+      if(event->involves == NULL)
+	event->involves = newList();
+      else if(listIn(event->involves, thing))
+	continue;
+      listPut(event->involves, thing);
+      event_index_put(thing, event);
+    } listIteratorFinish(inv_i);
+  }
+}
+
+void event_index_remove(EVENT_DATA *event) {
+  event_index_take(event->owner, event);
+  if(event->check_involvement != NULL)
+    listRemove(scanned_events, event);
+  if(event->involves != NULL) {
+    LOCAL_LIST_ITERATOR(inv_i, event->involves);
+    void           *thing = NULL;
+    ITERATE_LIST(thing, inv_i) {
+      event_index_take(thing, event);
+    } listIteratorFinish(inv_i);
+  }
+}
+
+
+
+//*****************************************************************************
+// event handling
 //*****************************************************************************
 void init_events() {
-  events = newList();
+  event_index    = newMap(NULL, NULL);
+  scanned_events = newList();
 
   // make sure all events involving the object/char are cancelled when
   // either is extracted from the game
@@ -106,20 +306,56 @@ void interrupt_event(EVENT_DATA *event) {
   deleteEvent(event);
 }
 
+bool has_events_involving(void *thing) {
+  if(mapIn(event_index, thing))
+    return TRUE;
+  if(listSize(scanned_events) > 0) {
+    LOCAL_LIST_ITERATOR(ev_i, scanned_events);
+    EVENT_DATA *event = NULL;
+    ITERATE_LIST(event, ev_i) {
+      if(event->check_involvement(thing, event->data)) {
+	listIteratorFinish(ev_i);
+	return TRUE;
+      }
+    } listIteratorFinish(ev_i);
+  }
+  return FALSE;
+}
+
 void interrupt_events_involving(void *thing) {
-  LIST_ITERATOR *ev_i = newListIterator(events);
+  LIST         *indexed = mapGet(event_index, thing);
+  LIST        *involved = newList();
   EVENT_DATA   *event = NULL;
 
-  ITERATE_LIST(event, ev_i) {
-    // if we've found involvement, pop it on out
-    if(event->owner == thing ||
-       (event->check_involvement != NULL && 
-	event->check_involvement(thing, event->data))) {
-      listRemove(events, event);
-      deleteEvent(event);
-    }
+  // copy what's indexed; deleting events takes them out of the index
+  if(indexed != NULL) {
+    LOCAL_LIST_ITERATOR(ev_i, indexed);
+    ITERATE_LIST(event, ev_i) {
+      listPut(involved, event);
+    } listIteratorFinish(ev_i);
+  }
+
+  // events we can't index by what they involve have to be asked
+  if(listSize(scanned_events) > 0) {
+    LOCAL_LIST_ITERATOR(ev_i, scanned_events);
+    ITERATE_LIST(event, ev_i) {
+      if(event->owner != thing && !listIn(involved, event) &&
+	 event->check_involvement(thing, event->data))
+	listPut(involved, event);
+    } listIteratorFinish(ev_i);
   }
-  deleteListIterator(ev_i);
+
+  // pop them on out. Events that are going off right now aren't in the
+  // heap, and can't be interrupted
+  while((event = listPop(involved)) != NULL) {
+    if(event->heap_i < 0)
+      continue;
+    event_heap_remove(event);
+    if(event->on_interrupt)
+      event->on_interrupt(event->owner, event->data, event->arg);
+    deleteEvent(event);
+  }
+  deleteList(involved);
 }
 
 void start_event(void *owner, 
@@ -129,14 +365,38 @@ void start_event(void *owner,
 		 void *data,
 		 const char *arg) {
   // some events might cause other events to activate. This is signaled by
-  // providing a delay of 0. In this case, we queue events to the back of the
-  // event list instead of push them on to the front
+  // providing a delay of 0. These go off after everything else that's due
+  // on the current pulse, in the order they were started
   EVENT_DATA *event = newEvent(owner, delay, on_complete, check_involvement,
 			       data, arg, FALSE);
-  if(delay == 0)
-    listQueue(events, event);
-  else
-    listPut(events, event);
+  event_index_add(event, NULL);
+  event_heap_put(event, delay);
+}
+
+void start_event_involving(void *owner,
+			   int   delay,
+			   void *on_complete,
+			   LIST *involves,
+			   void *data,
+			   const char *arg) {
+  EVENT_DATA *event = newEvent(owner, delay, on_complete, NULL, data, arg,
+			       FALSE);
+  event_index_add(event, involves);
+  event_heap_put(event, delay);
+}
+
+void start_event_interruptible(void *owner,
+				int   delay,
+				void *on_complete,
+				void *on_interrupt,
+				LIST *involves,
+				void *data,
+				const char *arg) {
+  EVENT_DATA *event = newEvent(owner, delay, on_complete, NULL, data, arg,
+			       FALSE);
+  event->on_interrupt = on_interrupt;
+  event_index_add(event, involves);
+  event_heap_put(event, delay);
 }
 
 void start_update(void *owner, 
@@ -146,37 +406,34 @@ void start_update(void *owner,
 		  void *data,
 		  const char *arg) {
   // some events might cause other events to activate. This is signaled by
-  // providing a delay of 0. In this case, we queue events to the back of the
-  // event list instead of push them on to the front
+  // providing a delay of 0. These go off after everything else that's due
+  // on the current pulse, in the order they were started
   EVENT_DATA *event = newEvent(owner, delay, on_complete, check_involvement,
 			       data, arg, TRUE);
-  if(delay == 0)
-    listQueue(events, event);
-  else
-    listPut(events, event);
+  event_index_add(event, NULL);
+  event_heap_put(event, delay);
+}
+
+int count_events(void) {
+  return num_events;
 }
 
 void pulse_events(int time) {
-  LIST_ITERATOR *ev_i = newListIterator(events);
-  EVENT_DATA   *event = NULL;
+  EVENT_DATA *event = NULL;
+  event_pulse += time;
 
-  // go over all of the events
-  ITERATE_LIST(event, ev_i) {
-    // decrement the delay
-    event->delay -= time;
-    // pop the character from the list, and run the event
-    if(event->delay <= 0) {
-      listRemove(events, event);
-      run_event(event);
-      // if we need to requeue, reset the timer 
-      // and put us back in the list
-      if(event->requeue) {
-	event->delay = event->tot_time;
-	listPut(events, event);
-      }
-      // otherwise, just delete the event
-      else
-	deleteEvent(event);
-    }
-  } deleteListIterator(ev_i);
+  // go over all of the events that are due
+  while(num_events > 0 && events[0]->due <= event_pulse) {
+    // pop the event from the heap, and run it
+    event = events[0];
+    event_heap_remove(event);
+    run_event(event);
+    // if we need to requeue, put us back in the heap. Updates always wait at
+    // least one pulse, so we can't get stuck running one over and over
+    if(event->requeue)
+      event_heap_put(event, MAX(event->tot_time, 1));
+    // otherwise, just delete the event
+    else
+      deleteEvent(event);
+  }
 }
@@ -31,6 +31,12 @@ void init_events();
 void pulse_events(int time);
 
 
+//
+// how many events are waiting to go off
+//
+int count_events(void);
+
+
 //
 // Stop all events involving "thing". "thing" can be anything that
 // might be involved in an event (either as the owner of the event
@@ -39,6 +45,13 @@ void pulse_events(int time);
 void interrupt_events_involving(void *thing);
 
 
+//
+// Are there any events waiting to go off that involve "thing", either
+// as their owner or some part of their data?
+//
+bool has_events_involving(void *thing);
+
+
 //
 // Put an event into the event handler. When the delay reaches 0, 
 // on_complete is called.
@@ -59,6 +72,36 @@ void start_event(void *owner,
 		 const char *arg);
 
 
+//
+// same deal as start_event, but instead of a check_involvement function,
+// takes a list of the things (other than the owner) the event involves.
+// Interrupting events involving any of them will interrupt this event. This
+// is much cheaper than check_involvement, since interrupting events only has
+// to look at the events that are actually tied to the thing being
+// interrupted. The list is copied, and can be deleted after the call
+//
+void start_event_involving(void *owner,
+			   int   delay,
+			   void *on_complete,
+			   LIST *involves,
+			   void *data,
+			   const char *arg);
+
+
+//
+// same deal as start_event_involving, but if the event is interrupted before
+// it goes off, on_interrupt is called with the owner, data, and arg, so the
+// data can be cleaned up. involves can be NULL
+//
+void start_event_interruptible(void *owner,
+			       int   delay,
+			       void *on_complete,
+			       void *on_interrupt,
+			       LIST *involves,
+			       void *data,
+			       const char *arg);
+
+
 //
 // same deal as start_event, but will automatically re-queue the event
 // after it has fired. Useful for events that are currently running (e.g.
@@ -9,6 +9,7 @@
 #include "mud.h"
 #include "utils.h"
 #include "storage.h"
+#include "room.h"
 #include "exit.h"
 
 #define EX_CLOSED            (1 << 0)
@@ -35,6 +36,10 @@ struct exit_data {
   int uid;                 // our unique identification number
 };
 
+// goes up whenever a door opens or closes anywhere
+int exit_door_generation = 0;
+
+
 
 
 EXIT_DATA *newExit() {
@@ -139,6 +144,10 @@ bool        exitIsClosable(const EXIT_DATA *exit) {
   return IS_SET(exit->status, EX_CLOSABLE);
 };
 
+int exitDoorGeneration(void) {
+  return exit_door_generation;
+}
+
 bool        exitIsClosed(const EXIT_DATA *exit) {
   return IS_SET(exit->status, EX_CLOSED);
 };
@@ -209,8 +218,12 @@ void        exitSetClosable(EXIT_DATA *exit, bool closable) {
 }
 
 void        exitSetClosed(EXIT_DATA *exit, bool closed) {
+  if(closed != exitIsClosed(exit))
+    exit_door_generation++;
   if(closed)    SET_BIT(exit->status, EX_CLOSED);
   else          REMOVE_BIT(exit->status, EX_CLOSED);
+  if(exit->room != NULL)
+    roomForgetExitListings(exit->room);
 }
 
 void        exitSetLocked(EXIT_DATA *exit, bool locked) {
@@ -225,6 +238,8 @@ void        exitSetKey(EXIT_DATA *exit, const char *key) {
 
 void        exitSetHidden(EXIT_DATA *exit, int hide_lev) {
   exit->hide_lev = hide_lev;
+  if(exit->room != NULL)
+    roomForgetExitListings(exit->room);
 }
 
 void        exitSetPickLev(EXIT_DATA *exit, int pick_lev) {
@@ -234,11 +249,15 @@ void        exitSetPickLev(EXIT_DATA *exit, int pick_lev) {
 void        exitSetTo(EXIT_DATA *exit, const char *room) {
   if(exit->to) free(exit->to);
   exit->to = strdupsafe(room);
+  if(exit->room != NULL)
+    roomForgetEdges(exit->room);
 }
 
 void        exitSetName(EXIT_DATA *exit, const char *name) {
   if(exit->name) free(exit->name);
   exit->name   = strdupsafe(name);
+  if(exit->room != NULL)
+    roomForgetExitListings(exit->room);
 }
 
 void        exitSetKeywords(EXIT_DATA *exit, const char *keywords) {
@@ -45,6 +45,12 @@ EXIT_DATA *exitRead(STORAGE_SET *set);
 STORAGE_SET *exitStore(EXIT_DATA *exit);
 
 
+//
+// goes up whenever any exit is opened or closed. Anything that remembers which
+// doors are closed can check it to see if what it remembers is out of date
+int exitDoorGeneration(void);
+
+
 //*****************************************************************************
 // is, get and set functions
 //*****************************************************************************
@@ -11,21 +11,194 @@
 
 #include "mud.h"
 #include "utils.h"
+#include "intern.h"
 #include "storage.h"
 #include "extra_descs.h"
 
+//
+// every keyword in a set, lowercased and merged into a trie. Looking up an
+// edesc and tagging a description both start at a position in some text and
+// walk down from the root, so neither has to go through the edescs one at a
+// time and parse each one's keywords
+typedef struct {
+  char      c; // the letter that leads here from our parent
+  int  child; // our first child, or -1
+  int  sibling; // our parent's next child, or -1
+  int  edesc; // the first edesc with a keyword ending here, or -1
+  int  sub_edesc; // the first edesc with a keyword at or below here, or -1
+} EDESC_NODE;
+
+typedef struct {
+  EDESC_NODE  *nodes; // nodes[0] is the root
+  int      num_nodes;
+  int      max_nodes;
+  EDESC_DATA **edescs; // our edescs, in the order they are in the set
+  int        version; // the version of the set we were built for
+  char   *tagged_from; // the last description tagged, and how it was tagged
+  char      *tagged;
+  char      *tagged_start;
+  char      *tagged_end;
+} EDESC_INDEX;
+
 struct edesc_set_data {
-  LIST *edescs;
+  LIST        *edescs;
+  int         version; // changes whenever our edescs or their keywords do
+  EDESC_INDEX   *index; // built when first needed, for the current version
 };
 
+// where edesc set versions come from. Every change gets a new one, so no two
+// sets ever share a version, even if one set replaces another
+int next_edesc_version = 0;
+
+//
+// note that a set's edescs or their keywords have changed
+void edesc_set_changed(EDESC_SET *set) {
+  if(set != NULL)
+    set->version = ++next_edesc_version;
+}
+
 struct edesc_data {
   EDESC_SET *set;
-  char      *keywords;
-  BUFFER    *desc;
+  const char *keywords;
+  BUFFER      *desc;
 };
 
 
 
+//*****************************************************************************
+// the keyword index
+//*****************************************************************************
+void delete_edesc_index(EDESC_INDEX *index) {
+  if(index->tagged_from)  free(index->tagged_from);
+  if(index->tagged)       free(index->tagged);
+  if(index->tagged_start) free(index->tagged_start);
+  if(index->tagged_end)   free(index->tagged_end);
+  free(index->nodes);
+  free(index->edescs);
+  free(index);
+}
+
+int edesc_index_add_node(EDESC_INDEX *index, int parent, char c) {
+  if(index->num_nodes == index->max_nodes) {
+    index->max_nodes *= 2;
+    index->nodes = realloc(index->nodes, sizeof(EDESC_NODE)*index->max_nodes);
+  }
+  EDESC_NODE *node = &index->nodes[index->num_nodes];
+  node->c         = c;
+  node->child     = -1;
+  node->sibling   = (parent < 0 ? -1 : index->nodes[parent].child);
+  node->edesc     = -1;
+  node->sub_edesc = -1;
+  if(parent >= 0)
+    index->nodes[parent].child = index->num_nodes;
+  return index->num_nodes++;
+}
+
+//
+// find which child of a node the letter leads to, or -1 if none does
+int edesc_index_child(const EDESC_INDEX *index, int node, char c) {
+  for(node = index->nodes[node].child; node >= 0; 
+      node = index->nodes[node].sibling)
+    if(index->nodes[node].c == c)
+      return node;
+  return -1;
+}
+
+void edesc_index_add_keyword(EDESC_INDEX *index, const char *word, int edesc){
+  int node = 0;
+  for(; *word; word++) {
+    if(index->nodes[node].sub_edesc < 0)
+      index->nodes[node].sub_edesc = edesc;
+    int next = edesc_index_child(index, node, tolower(*word));
+    node = (next >= 0 ? next : edesc_index_add_node(index,node,tolower(*word)));
+  }
+  // edescs are added in order, so the first to get somewhere keeps it
+  if(index->nodes[node].edesc < 0)
+    index->nodes[node].edesc = edesc;
+  if(index->nodes[node].sub_edesc < 0)
+    index->nodes[node].sub_edesc = edesc;
+}
+
+//
+// return the set's index, building it first if the set has changed
+EDESC_INDEX *edesc_set_index(EDESC_SET *set) {
+  if(set->index != NULL && set->index->version == set->version)
+    return set->index;
+  if(set->index != NULL)
+    delete_edesc_index(set->index);
+
+  EDESC_INDEX *index = calloc(1, sizeof(EDESC_INDEX));
+  index->version     = set->version;
+  index->max_nodes   = 16;
+  index->nodes       = malloc(sizeof(EDESC_NODE) * index->max_nodes);
+  index->edescs      = malloc(sizeof(EDESC_DATA *) * 
+			      MAX(1, edescGetSetSize(set)));
+  edesc_index_add_node(index, -1, '\0');
+
+  if(set->edescs != NULL) {
+    LIST_ITERATOR *edesc_i = newListIterator(set->edescs);
+    EDESC_DATA      *edesc = NULL;
+    int                num = 0;
+    ITERATE_LIST(edesc, edesc_i) {
+      LIST *words = parse_keywords(edesc->keywords);
+      char  *word = NULL;
+      while( (word = listPop(words)) != NULL) {
+	if(*word)
+	  edesc_index_add_keyword(index, word, num);
+	free(word);
+      } deleteList(words);
+      index->edescs[num++] = edesc;
+    } deleteListIterator(edesc_i);
+  }
+  set->index = index;
+  return index;
+}
+
+//
+// find the first edesc with a keyword the text starts with, and return the
+// length of its longest one. Returns 0 if there are none
+int edesc_index_match(const EDESC_INDEX *index, const char *text) {
+  int node = 0, len = 0, best = -1, best_len = 0;
+  while(text[len] != '\0' && 
+	(node = edesc_index_child(index, node, tolower(text[len]))) >= 0) {
+    len++;
+    int edesc = index->nodes[node].edesc;
+    if(edesc >= 0 && (best < 0 || edesc <= best)) {
+      best     = edesc;
+      best_len = len;
+    }
+  }
+  return best_len;
+}
+
+//
+// tag every keyword in the text, the same way tag_keywords does for one
+// edesc's keywords, but for all of our edescs in one pass. Keywords are
+// only looked for at the start of words, and right after other keywords
+void edesc_index_tag(const EDESC_INDEX *index, BUFFER *out, const char *text,
+		     const char *start_tag, const char *end_tag) {
+  while(*text) {
+    int len = edesc_index_match(index, text);
+    if(len > 0) {
+      bufferCat(out, start_tag);
+      bufferCatLen(out, text, len);
+      bufferCat(out, end_tag);
+      text += len;
+    }
+    // skip ahead one word, and the space after it
+    else {
+      const char *word = text;
+      while(*text != '\0' && !isspace(*text))
+	text++;
+      if(*text != '\0')
+	text++;
+      bufferCatLen(out, word, text - word);
+    }
+  }
+}
+
+
+
 //*****************************************************************************
 //
 // edesc set
@@ -34,6 +207,8 @@ struct edesc_data {
 EDESC_SET  *newEdescSet() {
   EDESC_SET *set = malloc(sizeof(EDESC_SET));
   set->edescs    = NULL;
+  set->index     = NULL;
+  edesc_set_changed(set);
   return set;
 }
 
@@ -85,6 +260,7 @@ void edescSetCopyTo(EDESC_SET *from, EDESC_SET *to) {
       edesc->set = to;
     } deleteListIterator(list_i);
   }
+  edesc_set_changed(to);
 }
 
 EDESC_SET *edescSetCopy(EDESC_SET *set) {
@@ -94,17 +270,18 @@ EDESC_SET *edescSetCopy(EDESC_SET *set) {
 }
 
 EDESC_DATA *edescSetGet(EDESC_SET *set, const char *keyword) {
-  if(set->edescs == NULL)
+  if(set->edescs == NULL || !*keyword)
     return NULL;
 
-  LIST_ITERATOR *edesc_i = newListIterator(set->edescs);
-  EDESC_DATA       *desc = NULL;
-
-  ITERATE_LIST(desc, edesc_i) {
-    if(edescIsKeyword(desc, keyword))
-      break;
-  } deleteListIterator(edesc_i);
-  return desc;
+  // keywords can be abbreviated, so we want the first edesc with any keyword
+  // at or below wherever the abbreviation takes us
+  EDESC_INDEX *index = edesc_set_index(set);
+  int           node = 0;
+  for(; *keyword && node >= 0; keyword++)
+    node = edesc_index_child(index, node, tolower(*keyword));
+  if(node < 0 || index->nodes[node].sub_edesc < 0)
+    return NULL;
+  return index->edescs[index->nodes[node].sub_edesc];
 }
 
 void edescSetPut(EDESC_SET *set, EDESC_DATA *edesc) {
@@ -112,6 +289,7 @@ void edescSetPut(EDESC_SET *set, EDESC_DATA *edesc) {
     set->edescs = newList();
   edesc->set = set;
   listQueue(set->edescs, edesc);
+  edesc_set_changed(set);
 }
 
 EDESC_DATA *edescSetGetNum(EDESC_SET *set, int num) {
@@ -121,16 +299,20 @@ EDESC_DATA *edescSetGetNum(EDESC_SET *set, int num) {
 }
 
 void removeEdesc(EDESC_SET *set, EDESC_DATA *edesc) {
-  if(set->edescs != NULL && listRemove(set->edescs, edesc))
+  if(set->edescs != NULL && listRemove(set->edescs, edesc)) {
     edesc->set = NULL;
+    edesc_set_changed(set);
+  }
 }
 
 EDESC_DATA *edescSetRemove(EDESC_SET *set, const char *keyword) {
   if(set->edescs == NULL)
     return NULL;
   EDESC_DATA *entry = edescSetGet(set, keyword);
-  if(entry && listRemove(set->edescs, entry))
+  if(entry && listRemove(set->edescs, entry)) {
     entry->set = NULL;
+    edesc_set_changed(set);
+  }
   return entry;
 }
 
@@ -139,14 +321,18 @@ EDESC_DATA *edescSetRemoveNum (EDESC_SET *set, int num) {
     return NULL;
 
   EDESC_DATA *entry = listRemoveNum(set->edescs, num);
-  if(entry)
+  if(entry) {
     entry->set = NULL;
+    edesc_set_changed(set);
+  }
   return entry;
 }
 
 void deleteEdescSet(EDESC_SET *set) {
   if(set->edescs)
     deleteListWith(set->edescs, deleteEdesc);
+  if(set->index)
+    delete_edesc_index(set->index);
   free(set);
 }
 
@@ -160,18 +346,34 @@ LIST *edescSetGetList(EDESC_SET *set) {
   return set->edescs;
 }
 
+int edescSetGetVersion(EDESC_SET *set) {
+  return set->version;
+}
+
 void edescTagDesc(BUFFER *buf, EDESC_SET *set, 
 		  const char *start_tag, const char *end_tag) {
-  if(set->edescs == NULL)
+  if(set->edescs == NULL || listSize(set->edescs) == 0)
     return;
 
-  LIST_ITERATOR *list_i = newListIterator(set->edescs);
-  EDESC_DATA    *edesc  = NULL;
-
-  // go through, and apply colors for each extra desc we have
-  ITERATE_LIST(edesc, list_i) {
-    buf_tag_keywords(buf, edesc->keywords, start_tag, end_tag);
-  } deleteListIterator(list_i);
+  // the same description is usually tagged over and over, as people look
+  EDESC_INDEX *index = edesc_set_index(set);
+  if(index->tagged == NULL || strcmp(index->tagged_from, bufferString(buf)) ||
+     strcmp(index->tagged_start, start_tag) || 
+     strcmp(index->tagged_end, end_tag)) {
+    BUFFER *tagged = newBuffer(bufferLength(buf) * 2);
+    edesc_index_tag(index, tagged, bufferString(buf), start_tag, end_tag);
+    if(index->tagged_from)  free(index->tagged_from);
+    if(index->tagged)       free(index->tagged);
+    if(index->tagged_start) free(index->tagged_start);
+    if(index->tagged_end)   free(index->tagged_end);
+    index->tagged_from  = strdup(bufferString(buf));
+    index->tagged       = strdup(bufferString(tagged));
+    index->tagged_start = strdup(start_tag);
+    index->tagged_end   = strdup(end_tag);
+    deleteBuffer(tagged);
+  }
+  bufferClear(buf);
+  bufferCat(buf, index->tagged);
 }
 
 
@@ -183,28 +385,29 @@ EDESC_DATA *newEdesc(const char *keywords, const char *desc) {
   EDESC_DATA *edesc = malloc(sizeof(struct edesc_data));
 
   edesc->set      = NULL;
-  edesc->keywords = strdupsafe(keywords);
+  edesc->keywords = strShare(keywords);
   edesc->desc     = newBuffer(1);
-  bufferCat(edesc->desc, (desc ? desc : ""));
+  bufferShare(edesc->desc, desc);
 
   return edesc;
 }
 
 void deleteEdesc(EDESC_DATA *edesc) {
-  if(edesc->keywords) free(edesc->keywords);
+  strRelease(edesc->keywords);
   if(edesc->desc)     deleteBuffer(edesc->desc);
   free(edesc);
 }
 
 EDESC_DATA *edescCopy(EDESC_DATA *edesc) {
-  return newEdesc(edesc->keywords, bufferString(edesc->desc));
+  EDESC_DATA *copy = newEdesc(edesc->keywords, NULL);
+  bufferCopyTo(edesc->desc, copy->desc);
+  return copy;
 }
 
 void edescCopyTo(EDESC_DATA *from, EDESC_DATA *to) {
   // copy over the new desc
   bufferCopyTo(from->desc, to->desc);
-  if(to->keywords) free(to->keywords);
-  to->keywords = strdupsafe(from->keywords);
+  edescSetKeywords(to, from->keywords);
 }
 
 const char *edescGetKeywords(EDESC_DATA *edesc) {
@@ -220,13 +423,14 @@ BUFFER *edescGetDescBuffer(EDESC_DATA *edesc) {
 }
 
 void edescSetKeywords(EDESC_DATA *edesc, const char *keywords) {
-  if(edesc->keywords) free(edesc->keywords);
-  edesc->keywords   = strdupsafe(keywords);
+  const char *old = edesc->keywords;
+  edesc->keywords = strShare(keywords);
+  strRelease(old);
+  edesc_set_changed(edesc->set);
 }
 
 void edescSetDesc(EDESC_DATA *edesc, const char *description) {
-  bufferClear(edesc->desc);
-  bufferCat(edesc->desc, (description ? description : ""));
+  bufferShare(edesc->desc, description);
 }
 
 EDESC_SET *edescGetSet(EDESC_DATA *edesc) {
@@ -30,6 +30,12 @@ EDESC_DATA *edescSetRemoveNum   (EDESC_SET *set, int num);
 void        removeEdesc         (EDESC_SET *set, EDESC_DATA *edesc);
 int         edescGetSetSize     (EDESC_SET *set);
 LIST       *edescSetGetList     (EDESC_SET *set);
+
+//
+// a number that changes whenever edescs are added to or removed from the set,
+// or their keywords change. No two sets ever have the same version
+int         edescSetGetVersion  (EDESC_SET *set);
+
 void        edescTagDesc        (BUFFER *buf, EDESC_SET *set,  
 				 const char *start_tag, const char *end_tag);
 
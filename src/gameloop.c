@@ -6,13 +6,20 @@
 //
 //*****************************************************************************
 #include <sys/time.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
+#include <sys/ioctl.h>
 
 #include "mud.h"
 #include "utils.h"
 #include "save.h"
+#include "save_queue.h"
+#include "intern.h"
+#include "log_queue.h"
+#include "journal.h"
 #include "socket.h"
 #include "world.h"
 #include "room.h"
@@ -28,6 +35,24 @@
 #include "races.h"
 #include "inform.h"
 #include "hooks.h"
+#include "poller.h"
+#include "resolver.h"
+#include "connlimit.h"
+#include "listener.h"
+#include "tls.h"
+#include "pulse.h"
+#include "metrics.h"
+#include "trace.h"
+#include "replay.h"
+#include "shard.h"
+#include "offload.h"
+#include "regen.h"
+#include "routine.h"
+#include "social.h"
+#include "stats.h"
+#include "colour.h"
+#include "gmcp.h"
+#include "upgrade.h"
 
 
 
@@ -62,13 +87,23 @@
 #include "gearskills/skills_verbs_aux.h"
 #endif
 
+// the most pulses we will run back-to-back to catch up after the game loop
+// falls behind. Anything past that is dropped, so one long stall doesn't
+// turn into a long burst of fast-forwarded game time
+#define MAX_CATCHUP_PULSES   5
+
+// the most connections we'll accept in a single pulse
+#define MAX_ACCEPTS_PER_PULSE 128
+
 // local procedures
-void game_loop    ( int control );
+void game_loop    ( void );
+void replay_loop  ( void );
+void accept_connections( int listener );
+bool restore_world_snapshot( void );
 bool gameloop_end = FALSE;
 
 // intialize shutdown state
 bool shut_down    = FALSE;
-int  control;
 
 // silent mode flag - when TRUE, suppress terminal output
 bool silent_mode  = TRUE;
@@ -106,12 +141,14 @@ LIST            *room_list = NULL; // the list of all existing rooms
 SET            *object_set = NULL; // same things, stored in a set
 SET            *mobile_set = NULL; // and mobiles
 SET              *room_set = NULL; // amd rooms
-
-LIST       *mobs_to_delete = NULL; // mobs pending final extraction
-LIST       *objs_to_delete = NULL; // objs pending final extraction
-LIST      *rooms_to_delete = NULL; // rooms pending final extraction
-LIST       *strs_to_delete = NULL; // strings waiting to be freed
-LIST       *bufs_to_delete = NULL; // buffers waiting to be freed
+HASHTABLE  *online_players = NULL; // and the PCs among the mobiles, by name
+
+EPOCH_CLASS  *mobs_to_delete = NULL; // mobs pending final extraction
+EPOCH_CLASS  *objs_to_delete = NULL; // objs pending final extraction
+EPOCH_CLASS *trees_to_delete = NULL; // same, along with their contents
+EPOCH_CLASS *rooms_to_delete = NULL; // rooms pending final extraction
+EPOCH_CLASS  *strs_to_delete = NULL; // strings waiting to be freed
+EPOCH_CLASS  *bufs_to_delete = NULL; // buffers waiting to be freed
 PROPERTY_TABLE  *mob_table = NULL; // a table of mobs by UID, for quick lookup
 PROPERTY_TABLE  *obj_table = NULL; // a table of objs by UID, for quick lookup
 PROPERTY_TABLE *room_table = NULL; // a table of rooms by UID, for quick lookup
@@ -127,9 +164,14 @@ static void setup_signal_handlers(void);
 // This is where it all starts, nothing special.
 int main(int argc, char **argv)
 {
-  extern fd_set fSet;
   int i;
   bool fCopyOver = FALSE;
+  bool      fHot = FALSE;
+  bool  fUpgrade = FALSE;
+  int upgrade_fd = -1;
+  bool    fBench = FALSE;
+  const char *record_file = NULL, *replay_file = NULL, *listener_fds = NULL;
+  int bench_rooms = 200, bench_socks = 100, bench_things = 5, bench_rounds = 20;
 
   /************************************************************/
   /*                      PARSE OPTIONS                       */
@@ -137,11 +179,31 @@ int main(int argc, char **argv)
   for(i = 1; i < argc; i++) {
     if(!strcasecmp(argv[i], "-copyover")) {
       fCopyOver = TRUE;
-      control = atoi(argv[++i]);
+      listener_fds = argv[++i];
+    }
+    else if(!strcasecmp(argv[i], "-upgrade")) {
+      fUpgrade   = TRUE;
+      upgrade_fd = atoi(argv[++i]);
+    }
+    else if(!strcasecmp(argv[i], "-hot")) {
+      fHot = TRUE;
     }
     else if(!strcasecmp(argv[i], "--silent") || !strcasecmp(argv[i], "-s")) {
       silent_mode = TRUE;
     }
+    else if(!strcasecmp(argv[i], "--benchmark")) {
+      // optionally followed by rooms,sockets,things,rounds
+      fBench = TRUE;
+      if(i + 1 < argc && strchr(argv[i+1], ','))
+	sscanf(argv[++i], "%d,%d,%d,%d", &bench_rooms, &bench_socks,
+	       &bench_things, &bench_rounds);
+    }
+    else if(!strcasecmp(argv[i], "--record") && i + 1 < argc) {
+      record_file = argv[++i];
+    }
+    else if(!strcasecmp(argv[i], "--replay") && i + 1 < argc) {
+      replay_file = argv[++i];
+    }
     else if(!strcasecmp(argv[i], "--mudlib-path")) {
       char *mudlib_path = argv[++i];
       struct stat st;
@@ -178,8 +240,16 @@ int main(int argc, char **argv)
     return 1;
   }
 
-  /* seed the random number generator */
-  srand(time(0));
+  /* seed the random number generator. Replays use the recording's seed */
+  unsigned int seed = time(0);
+  if(replay_file != NULL) {
+    if(!replayLoad(replay_file)) {
+      fprintf(stderr, "Error: could not read recording '%s'.\n", replay_file);
+      return 1;
+    }
+    seed = replayGetSeed();
+  }
+  srand(seed);
 
   /* get the current time */
   current_time = time(NULL);
@@ -190,6 +260,9 @@ int main(int argc, char **argv)
   /*           INITIALIZE ALL OUR LISTS AND TABLES            */
   /************************************************************/
 
+  // before anything else sets up what it does when we fork
+  init_intern();
+
   // lists for storing objects, sockets, and mobiles that are
   // currently loaded into the game
   object_list     = newList();
@@ -200,12 +273,16 @@ int main(int argc, char **argv)
   object_set      = newSet();
   mobile_set      = newSet();
   room_set        = newSet();
+  online_players  = newHashtable();
 
-  mobs_to_delete  = newList();
-  objs_to_delete  = newList();
-  rooms_to_delete = newList();
-  strs_to_delete  = newList();
-  bufs_to_delete  = newList();
+  // things pending deletion are freed in the order their classes are made
+  init_epoch();
+  mobs_to_delete  = newEpochClass(extract_mobile_final);
+  objs_to_delete  = newEpochClass(extract_obj_final);
+  trees_to_delete = newEpochClass(extract_obj_tree_final);
+  rooms_to_delete = newEpochClass(extract_room_final);
+  strs_to_delete  = newEpochClass(free);
+  bufs_to_delete  = newEpochClass(deleteBuffer);
 
   // tables for quick lookup of mobiles and objects by UID.
   // For optimal speed, the table sizes should be roughly
@@ -250,6 +327,9 @@ int main(int argc, char **argv)
 
   log_string("Initializing MUD settings.");
   init_mud_settings();
+
+  log_string("Starting the log writer.");
+  init_log_queue();
   
   // Log the MUD name after settings are loaded
   log_string("Starting %s on port %d", MUD_NAME, LISTENING_PORT);
@@ -260,6 +340,9 @@ int main(int argc, char **argv)
   log_string("Initializing command table.");
   init_commands();
 
+  log_string("Initializing social table.");
+  init_social_table();
+
   log_string("Initializing action handler.");
   init_actions();
 
@@ -269,8 +352,34 @@ int main(int argc, char **argv)
   log_string("Initializing logging system.");
   init_logs();
 
+  log_string("Initializing storage conversion.");
+  init_storage();
+  init_world_flush();
+  init_world_prefetch();
+  init_world_rooms();
+
+  log_string("Initializing colour codes.");
+  init_colour();
+
+  log_string("Initializing GMCP.");
+  init_gmcp();
+
+  log_string("Initializing pulse timing.");
+  init_pulse_timing();
+  init_hook_stats();
+  init_metrics();
+  init_trace();
+  init_shards();
+  init_benchmarks();
+  init_connection_limits();
+  init_offload();
+  init_regen();
+  init_routines();
+  init_stats();
+
   log_string("Initializing account and player database.");
   init_save();
+  init_journal();
 
 
 
@@ -344,9 +453,12 @@ int main(int argc, char **argv)
   log_string("Loading gameworld.");
   load_muddata();
 
+  // after a hot copyover, bring the world back as we left it. Otherwise,
   // force-pulse everything once
-  log_string("Force-resetting world");
-  worldForceReset(gameworld);
+  if(!fCopyOver || !fHot || !restore_world_snapshot()) {
+    log_string("Force-resetting world");
+    worldForceReset(gameworld);
+  }
 
   // run startup hooks for modules
   log_string("Running startup hooks");
@@ -358,24 +470,101 @@ int main(int argc, char **argv)
   else
     mudport = atoi(argv[i]);
 
+  // time the inform paths over a synthetic world, and report on stdout
+  // instead of ever listening for connections
+  if(fBench) {
+    init_poller();
+    init_socket_pool();
+    init_socket_hooks();
+    init_socket_idle();
+    BUFFER *report = newBuffer(MAX_BUFFER);
+    BUFFER  *plain = newBuffer(MAX_BUFFER);
+    inform_benchmark(report, MAX(1, bench_rooms), MAX(1, bench_socks),
+		     MAX(0, bench_things), MAX(1, bench_rounds));
+    if(!colourTranslate(bufferString(report), bufferLength(report), plain,
+			COLOUR_NONE))
+      bufferCat(plain, bufferString(report));
+    fputs(bufferString(plain), stdout);
+    deleteBuffer(report);
+    deleteBuffer(plain);
+    return 0;
+  }
+
+  // play back a recording as fast as we can, and report on stdout how long
+  // it took. Nothing ever listens for real connections
+  if(replay_file != NULL) {
+    init_poller();
+    init_socket_pool();
+    init_socket_hooks();
+    init_socket_idle();
+    log_string("Replaying %d pulses from %s", replayGetPulses(), replay_file);
+    replay_loop();
+    BUFFER *report = newBuffer(MAX_BUFFER);
+    replayReport(report);
+    fputs(bufferString(report), stdout);
+    deleteBuffer(report);
+    hookRun("shutdown", "");
+    journalFlush();
+    worldFlushDirty(gameworld);
+    saveQueueFlush();
+    logQueueFlush();
+    return 0;
+  }
+
+  // note everything that comes in, so it can be replayed later
+  if(record_file != NULL) {
+    if(!replayRecordStart(record_file, seed))
+      log_string("Could not record input to %s.", record_file);
+    else
+      log_string("Recording input to %s.", record_file);
+  }
+
   /**********************************************************************/
   /*                  HANDLE THE SOCKET STARTUP STUFF                   */
   /**********************************************************************/
+  /* set up TLS before listening for it, or taking its listeners back */
+  if (!init_tls())
+    log_string("Could not set up TLS. Connections to tls_ports won't work.");
+
   /* initialize the socket */
-  if (!fCopyOver) {
+  if (fCopyOver)
+    listenersResume(listener_fds);
+  else if (fUpgrade) {
+    if (!upgradeTakeover(upgrade_fd)) {
+      log_string("Could not take over from the old process. Exitting.");
+      logQueueFlush();
+      exit(1);
+    }
+    listenersResume(upgradeGetListeners());
+  }
+  else {
     log_string("Initializing sockets.");
-    control = init_socket();
+    init_listeners();
   }
 
-  /* clear out the file socket set */
-  FD_ZERO(&fSet);
+  /* set up our socket poller, and start listening on our listeners */
+  log_string("Initializing %s socket poller.", pollerGetBackend());
+  init_poller();
+  for (i = 0; i < listenerCount(); i++)
+    pollerAdd(listenerGetFd(i), NULL, POLLER_READ);
+
+  /* start up our input and compression threads, if we use them */
+  init_input_threads();
+  init_compress_threads();
 
-  /* add control to the set */
-  FD_SET(control, &fSet);
+  /* set aside some sockets for new connections to use */
+  init_socket_pool();
+  init_socket_hooks();
+  init_socket_idle();
+
+  /* start up the thread that looks up hostnames for new connections */
+  init_resolver();
 
   // attach our old sockets
   if(fCopyOver)
     copyover_recover();
+  else if(fUpgrade)
+    upgradeRecover();
 
 
 
@@ -387,16 +576,22 @@ int main(int argc, char **argv)
 
   // main game loop
   log_string("Entering game loop");
-  game_loop(control);
+  game_loop();
 
   // run our finalize hooks
   hookRun("shutdown", "");
 
-  // close down the socket
-  close(control);
+  // finish writing out anything that was saved on the way down
+  journalFlush();
+  worldFlushDirty(gameworld);
+  saveQueueFlush();
+
+  // close down the sockets we listen on
+  close_listeners();
 
   // terminated without errors
   log_string("Program terminated without errors.");
+  logQueueFlush();
 
   return 0;
 }
@@ -412,130 +607,226 @@ void update_handler()
   // increment the number of updates we've done
   num_updates++;
 
+  // time has gone by; anything could look different now
+  sightChanged();
+
   // pulse actions and events -> one pulse
   pulse_actions(1);
   pulse_events(1);
 
-  // pulse world
-  // we don't want to be on the same schedule as
-  // everything else, that updates every PULSES_PER_SECOND. 
-  // We want to be on a schedule that updates every minute or so.
-  if((num_updates % (1 MINUTE)) == 0)
-    worldPulse(gameworld);
+  // pulse world. Zones are still pulsed once a minute or so, but they are
+  // spread out across the minute, so the world has to hear about every pulse
+  worldPulse(gameworld);
 
   // heartbeat pulse
   if((num_updates % (2 SECOND)) == 0)
     hookRun("heartbeat", "");
   
-  // if we have final extractions pending, do them
-  CHAR_DATA *ch = NULL;
-  while((ch = (CHAR_DATA *)listPop(mobs_to_delete)) != NULL)
-    extract_mobile_final(ch);
-  OBJ_DATA *obj = NULL;
-  while((obj = (OBJ_DATA *)listPop(objs_to_delete)) != NULL)
-    extract_obj_final(obj);
-  ROOM_DATA *room = NULL;
-  while((room = (ROOM_DATA *)listPop(rooms_to_delete)) != NULL)
-    extract_room_final(room);
-  char *str = NULL;
-  while((str = (char *)listPop(strs_to_delete)) != NULL)
-    free(str);
-  BUFFER *buf = NULL;
-  while((buf = (BUFFER *)listPop(bufs_to_delete)) != NULL)
-    deleteBuffer(buf);
+  // if we have final extractions pending, do the ones nobody can be
+  // looking at any more
+  epochAdvance();
+
+  // deliver all the hooks that were batched up this pulse
+  hookRunBatches();
+
+  // write out this pulse's changes to players
+  journalFlush();
 }
 
 
 
-void game_loop(int control)   
+//
+// accept everyone waiting to connect on listener, until there is nobody left
+// (or we've taken in as many as we're willing to in one pulse). Connections
+// from addresses that are over their rate limit are closed before we spend
+// anything on them
+void accept_connections(int listener) {
+  struct sockaddr_storage sock;
+  char addr[INET6_ADDRSTRLEN];
+  socklen_t socksize;
+  int newConnection, accepted = 0;
+  bool error = FALSE;
+
+  while (accepted < MAX_ACCEPTS_PER_PULSE) {
+    socksize = sizeof(sock);
+    if ((newConnection = accept(listener, (struct sockaddr*) &sock, &socksize)) < 0) {
+      if (errno == EINTR)
+	continue;
+      error = (errno != EAGAIN && errno != EWOULDBLOCK);
+      break;
+    }
+    accepted++;
+
+    if (addrToString(&sock, addr, sizeof(addr)) != NULL &&
+	!connlimitAllow(addr)) {
+      close(newConnection);
+      continue;
+    }
+
+    SOCKET_DATA *newsock = new_socket(newConnection, listenerGetFlags(listener));
+    if(newsock != NULL) {
+      replayRecordConnect(newsock);
+      hookRunArgs("receive_connection", "sk", newsock);
+      socketBustPrompt(newsock);
+    }
+  }
+  connlimitRecordBatch(accepted, error);
+}
+
+//
+// read back the rooms we stored before a hot copyover. Returns FALSE if there
+// was nothing to read, and the world has to be reset the old-fashioned way
+bool restore_world_snapshot(void) {
+  STORAGE_SET *set = NULL;
+  int        rooms = 0;
+  struct stat   st;
+
+  if(stat(COPYOVER_WORLD_FILE, &st) != 0)
+    return FALSE;
+
+  log_string("Restoring world from hot copyover.");
+  set   = storage_read(COPYOVER_WORLD_FILE);
+  unlink(COPYOVER_WORLD_FILE);
+  rooms = worldReadRooms(gameworld, set);
+  storage_close(set);
+  log_string("Restored %d rooms.", rooms);
+  return TRUE;
+}
+
+void game_loop(void)
 {
-  static struct timeval tv;
-  struct timeval last_time, new_time;
-  extern fd_set fSet;
-  extern fd_set rFd;
-  long secs, usecs;
+  long long deadline, pulse_len, pulse_start, phase_start, now;
+  int i, behind, catchup;
 
-  /* set this for the first loop */
-  gettimeofday(&last_time, NULL);
+  // we keep absolute deadlines for every pulse, on a clock that never jumps
+  // around. Time spent doing work and sleeping always adds up to the pulse
+  // length, so we don't drift
+  deadline = pulse_clock();
 
   /* do this untill the program is shutdown */
   while (!shut_down) {
+    // the pulse rate can be changed while we're running
+    pulse_len = 1000000LL / PULSES_PER_SECOND;
+    deadline += pulse_len;
+
     /* set current_time */
     current_time = time(NULL);
+    pulse_start  = phase_start = pulse_clock();
+    traceBegin("pulse", "pulse");
+    replayPulseBegin();
 
-    /* copy the socket set */
-    memcpy(&rFd, &fSet, sizeof(fd_set));
-
-    /* wait for something to happen */
-    if (select(FD_SETSIZE, &rFd, NULL, NULL, &tv) < 0)
-      continue;
+    /* find out which sockets have something for us, without waiting. If we
+       are interrupted, there is simply nothing ready this pulse */
+    pollerWait(0);
 
     /* check for new connections */
-    if (FD_ISSET(control, &rFd)) {
-      struct sockaddr_in sock;
-      unsigned int socksize;
-      int newConnection;
-
-      socksize = sizeof(sock);
-      if ((newConnection = accept(control, (struct sockaddr*) &sock, &socksize)) >=0) {
-        SOCKET_DATA *newsock = new_socket(newConnection);
-	if(newsock != NULL) {
-	  hookRun("receive_connection", hookBuildInfo("sk", newsock));
-	  socketBustPrompt(newsock);
-	}
-      }
-    }
+    for (i = 0; i < pollerReadyCount(); i++)
+      if (isListener(pollerReadyFd(i)))
+	accept_connections(pollerReadyFd(i));
 
 
     /* check all of the sockets for input */
+    traceBegin("phase", "input_handler");
     input_handler();
+    traceEnd();
+    now = pulse_clock();
+    pulseRecordPhase(PULSE_PHASE_INPUT, now - phase_start);
+    phase_start = now;
 
     /* call the top-level update handler for events and actions */
+    traceBegin("phase", "update_handler");
     update_handler();
+    traceEnd();
+    now = pulse_clock();
+    pulseRecordPhase(PULSE_PHASE_UPDATE, now - phase_start);
+    phase_start = now;
 
     /* send socket output */
+    traceBegin("phase", "output_handler");
     output_handler();
-
-    /*
-     * Here we sleep out the rest of the pulse, thus forcing
-     * SocketMud(tm) (NakedMud) to run at PULSES_PER_SECOND pulses each second.
-     */
-    gettimeofday(&new_time, NULL);
-
-    // get the time right now, and calculate how long we should sleep
-    usecs = (int) (last_time.tv_usec -  new_time.tv_usec) + 1000000 / PULSES_PER_SECOND;
-    secs  = (int) (last_time.tv_sec  -  new_time.tv_sec);
-
+    traceEnd();
+    now = pulse_clock();
+    pulseRecordPhase(PULSE_PHASE_OUTPUT, now - phase_start);
+    pulseRecordPhase(PULSE_PHASE_TOTAL,  now - pulse_start);
+    traceEnd();
+    tracePulseDone(now - pulse_start);
+    shardNotePulse(now - pulse_start);
+
+    // 
+    // If we finished early, sleep out the rest of the pulse, thus forcing
+    // SocketMud(tm) (NakedMud) to run at PULSES_PER_SECOND pulses each second.
+    // If we ran over, we've encountered a laghole. Run the pulses we missed
+    // (without input and output) so game time keeps up with real time, but
+    // only up to a point; if we're too far behind, the rest are dropped.
     //
-    // Now we make sure that 0 <= usecs < 1.000.000
-    //
-    while (usecs < 0)
-    {
-      usecs += 1000000;
-      secs  -= 1;
+    if (now < deadline) {
+      struct timespec sleep_time;
+      sleep_time.tv_sec  = (deadline - now) / 1000000LL;
+      sleep_time.tv_nsec = ((deadline - now) % 1000000LL) * 1000;
+      nanosleep(&sleep_time, NULL);
     }
-    while (usecs >= 1000000)
-    {
-      usecs -= 1000000;
-      secs  += 1;
+    else {
+      behind = (int)((now - deadline) / pulse_len);
+      for (catchup = 0; catchup < behind && catchup < MAX_CATCHUP_PULSES;
+	   catchup++) {
+	deadline += pulse_len;
+	traceBegin("catchup", "update_handler");
+	update_handler();
+	traceEnd();
+      }
+      if (catchup > 0) {
+	pulseRecordCatchup(catchup);
+	replayRecordCatchup(catchup);
+      }
+
+      // still too far behind? Forget about the pulses we missed
+      now = pulse_clock();
+      if (now - deadline >= pulse_len) {
+	pulseRecordDropped((int)((now - deadline) / pulse_len));
+	deadline = now;
+      }
     }
 
-    // if secs < 0 we don't sleep, since we have encountered a laghole
-    if (secs > 0 || (secs == 0 && usecs > 0))
-    {
-      struct timeval sleep_time;
+    /* recycle sockets */
+    recycle_sockets();
 
-      sleep_time.tv_usec = usecs;
-      sleep_time.tv_sec  = secs;
+    /* hand everything over, if a new process is ready to take over */
+    upgradePoll();
+  }
+}
 
-      if (select(0, NULL, NULL, NULL, &sleep_time) < 0)
-        continue;
-    }
+//
+// run the pulses of a recording back-to-back, feeding each one the input it
+// got when it was recorded. Catch-up pulses are run where they were run in
+// the recording, no matter how long the replayed pulses take
+void replay_loop(void) {
+  long long pulse_start, phase_start, now;
+  int pulse, catchup;
+
+  for(pulse = 1; pulse <= replayGetPulses() && !shut_down; pulse++) {
+    pulse_start = phase_start = pulse_clock();
+    replayFeed(pulse);
+    pollerWait(0);
+
+    input_handler();
+    now = pulse_clock();
+    pulseRecordPhase(PULSE_PHASE_INPUT, now - phase_start);
+    phase_start = now;
 
-    /* reset the last time we where sleeping */
-    gettimeofday(&last_time, NULL);
+    update_handler();
+    now = pulse_clock();
+    pulseRecordPhase(PULSE_PHASE_UPDATE, now - phase_start);
+    phase_start = now;
 
-    /* recycle sockets */
+    output_handler();
+    now = pulse_clock();
+    pulseRecordPhase(PULSE_PHASE_OUTPUT, now - phase_start);
+    pulseRecordPhase(PULSE_PHASE_TOTAL,  now - pulse_start);
+    shardNotePulse(now - pulse_start);
+
+    for(catchup = replayFinish(pulse, now - pulse_start); catchup > 0;
+	catchup--)
+      update_handler();
     recycle_sockets();
   }
 }
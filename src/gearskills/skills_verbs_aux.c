@@ -6,12 +6,9 @@
 #include "../utils.h"
 #include "../storage.h"
 #include "../auxiliary.h"
+#include "../object.h"
 #include "skills_verbs_aux.h"
 
-//*****************************************************************************
-// Auxiliary data handlers (required by auxiliary system)
-//*****************************************************************************
-
 //*****************************************************************************
 // Skill assignment functions
 //*****************************************************************************
@@ -49,6 +46,136 @@ void svaux_set_active_skill_slot(SKILLS_VERBS_AUX *aux, int slot) {
   aux->active_skill_slot = slot;
 }
 
+//*****************************************************************************
+// Verb records and the cooldown wheel
+//*****************************************************************************
+
+// the auxiliary slot our data is kept in
+int svaux_slot = -1;
+
+// verbs that were used and haven't cooled down yet, by the second they are
+// ready again. A verb more than a lap away stays put until its lap comes
+#define SVAUX_WHEEL_SIZE  64
+
+LIST  *cooldown_wheel[SVAUX_WHEEL_SIZE];
+time_t    wheel_time = 0;   // the last second the wheel was moved up to
+
+SVAUX_VERB *newSvauxVerb(SKILLS_VERBS_AUX *owner, const char *verb,
+			 const char *script, int charges, int cooldown,
+			 time_t last_used) {
+  SVAUX_VERB *rec = malloc(sizeof(SVAUX_VERB));
+  rec->verb      = strdupsafe(verb);
+  rec->script    = strdupsafe(script);
+  rec->charges   = charges;
+  rec->cooldown  = cooldown;
+  rec->last_used = last_used;
+  rec->owner     = owner;
+  rec->cooling   = FALSE;
+  return rec;
+}
+
+void deleteSvauxVerb(SVAUX_VERB *rec) {
+  if(rec->verb)   free(rec->verb);
+  if(rec->script) free(rec->script);
+  free(rec);
+}
+
+/**
+ * take a verb off of the wheel or its owner's ready list, whichever it's on
+ */
+void svaux_verb_unlink(SVAUX_VERB *rec) {
+  if(rec->cooling) {
+    time_t ready_at = rec->last_used + rec->cooldown;
+    listRemove(cooldown_wheel[ready_at % SVAUX_WHEEL_SIZE], rec);
+    rec->cooling = FALSE;
+  }
+  else
+    listRemove(rec->owner->ready_verbs, rec);
+}
+
+/**
+ * put a verb where it belongs: on the wheel if it is still cooling down, or
+ * on its owner's ready list if it can be used. Verbs out of charges go on
+ * neither
+ */
+void svaux_verb_link(SVAUX_VERB *rec) {
+  time_t ready_at = rec->last_used + rec->cooldown;
+  if(rec->cooldown > 0 && ready_at > wheel_time) {
+    int bucket = ready_at % SVAUX_WHEEL_SIZE;
+    if(cooldown_wheel[bucket] == NULL)
+      cooldown_wheel[bucket] = newList();
+    listPut(cooldown_wheel[bucket], rec);
+    rec->cooling = TRUE;
+  }
+  else if(rec->charges != 0)
+    listPut(rec->owner->ready_verbs, rec);
+}
+
+/**
+ * move the wheel up to the current time, putting every verb that has cooled
+ * off back on its owner's ready list
+ */
+void svaux_advance_wheel(time_t current_time) {
+  if(current_time <= wheel_time)
+    return;
+
+  // if we've gone more than a lap, every bucket needs a look
+  time_t t = wheel_time + 1;
+  if(current_time - wheel_time > SVAUX_WHEEL_SIZE)
+    t = current_time - SVAUX_WHEEL_SIZE + 1;
+  wheel_time = current_time;
+
+  for(; t <= current_time; t++) {
+    LIST *bucket = cooldown_wheel[t % SVAUX_WHEEL_SIZE];
+    if(bucket == NULL || listSize(bucket) == 0)
+      continue;
+    LIST_ITERATOR *rec_i = newListIterator(bucket);
+    SVAUX_VERB      *rec = NULL;
+    ITERATE_LIST(rec, rec_i) {
+      if(rec->last_used + rec->cooldown <= current_time) {
+	listRemove(bucket, rec);
+	rec->cooling = FALSE;
+	svaux_verb_link(rec);
+      }
+    } deleteListIterator(rec_i);
+  }
+}
+
+/**
+ * remove and delete every verb on the aux data
+ */
+void svaux_clear_verbs(SKILLS_VERBS_AUX *aux) {
+  HASH_ITERATOR *iter = newHashIterator(aux->verb_handlers);
+  const char    *verb = NULL;
+  SVAUX_VERB     *rec = NULL;
+  ITERATE_HASH(verb, rec, iter) {
+    svaux_verb_unlink(rec);
+    deleteSvauxVerb(rec);
+  }
+  deleteHashIterator(iter);
+  deleteHashtable(aux->verb_handlers);
+  aux->verb_handlers = newHashtable();
+}
+
+/**
+ * add a verb record, replacing any verb by the same name
+ */
+void svaux_put_verb(SKILLS_VERBS_AUX *aux, SVAUX_VERB *rec) {
+  SVAUX_VERB *old = hashRemove(aux->verb_handlers, rec->verb);
+  if(old != NULL) {
+    svaux_verb_unlink(old);
+    deleteSvauxVerb(old);
+  }
+  hashPut(aux->verb_handlers, rec->verb, rec);
+  svaux_verb_link(rec);
+}
+
+
+
+//*****************************************************************************
+// Auxiliary data handlers (required by auxiliary system)
+//*****************************************************************************
+
 /**
  * Create new skills/verbs auxiliary data
  */
@@ -63,6 +190,7 @@ void *svaux_new(void) {
   
   // Initialize verb handlers
   aux->verb_handlers = newHashtable();
+  aux->ready_verbs   = newList();
   
   return aux;
 }
@@ -83,17 +211,9 @@ void svaux_delete(void *data) {
   }
   
   // Delete all verb handlers
-  if(aux->verb_handlers) {
-    HASH_ITERATOR *iter = newHashIterator(aux->verb_handlers);
-    const char *verb;
-    char *verb_data;
-    ITERATE_HASH(verb, verb_data, iter) {
-      if(verb_data)
-        free(verb_data);
-    }
-    deleteHashIterator(iter);
-    deleteHashtable(aux->verb_handlers);
-  }
+  svaux_clear_verbs(aux);
+  deleteHashtable(aux->verb_handlers);
+  deleteList(aux->ready_verbs);
   
   free(aux);
 }
@@ -117,13 +237,16 @@ void svaux_copyTo(void *from, void *to) {
   }
   to_aux->active_skill_slot = from_aux->active_skill_slot;
   
-  // Copy verb handlers
+  // Copy verb handlers, cooldowns and all
+  svaux_clear_verbs(to_aux);
   HASH_ITERATOR *iter = newHashIterator(from_aux->verb_handlers);
   const char *verb;
-  char *verb_data;
+  SVAUX_VERB *rec;
   
-  ITERATE_HASH(verb, verb_data, iter) {
-    hashPut(to_aux->verb_handlers, verb, strdupsafe(verb_data));
+  ITERATE_HASH(verb, rec, iter) {
+    svaux_put_verb(to_aux, newSvauxVerb(to_aux, rec->verb, rec->script,
+					rec->charges, rec->cooldown,
+					rec->last_used));
   }
   deleteHashIterator(iter);
 }
@@ -165,19 +288,17 @@ STORAGE_SET *svaux_store(void *data) {
   snprintf(temp_str, sizeof(temp_str), "%d", aux->active_skill_slot);
   store_string(set, "active_skill_slot", temp_str);
   
-  // Store verb handlers as comma-separated list: "verb|data,verb|data"
+  // Store verb handlers as comma-separated list:
+  //   "verb|script|charges|cooldown|last_used,..."
   BUFFER *verbs_buf = newBuffer(1);
   HASH_ITERATOR *iter = newHashIterator(aux->verb_handlers);
   const char *verb;
-  char *verb_data;
+  SVAUX_VERB *rec;
   bool first = TRUE;
   
-  ITERATE_HASH(verb, verb_data, iter) {
-    if(!first)
-      bufferCat(verbs_buf, ",");
-    bufferCat(verbs_buf, verb);
-    bufferCat(verbs_buf, "|");
-    bufferCat(verbs_buf, verb_data);
+  ITERATE_HASH(verb, rec, iter) {
+    bprintf(verbs_buf, "%s%s|%s|%d|%d|%ld", (first ? "" : ","), rec->verb,
+	    rec->script, rec->charges, rec->cooldown, (long)rec->last_used);
     first = FALSE;
   }
   deleteHashIterator(iter);
@@ -229,10 +350,13 @@ void *svaux_read(STORAGE_SET *set) {
     
     ITERATE_LIST(verb_pair, iter) {
       char verb[SMALL_BUFFER];
-      char verb_data[MAX_BUFFER];
-      if(sscanf(verb_pair, "%[^|]|%[^\n]", verb, verb_data) == 2) {
-        hashPut(aux->verb_handlers, verb, strdupsafe(verb_data));
-      }
+      char script[MAX_BUFFER];
+      int charges = -1, cooldown = 0;
+      long last_used = 0;
+      if(sscanf(verb_pair, "%[^|]|%[^|]|%d|%d|%ld", verb, script,
+		&charges, &cooldown, &last_used) >= 2)
+        svaux_put_verb(aux, newSvauxVerb(aux, verb, script, charges,
+					 cooldown, last_used));
     }
     deleteListIterator(iter);
     deleteListWith(verbs, free);
@@ -250,73 +374,40 @@ void svaux_add_verb(SKILLS_VERBS_AUX *aux, const char *verb, const char *script,
   if(!aux || !verb || !*verb)
     return;
   
-  BUFFER *buf = newBuffer(1);
-  char temp_str[32];
-  
-  bufferCat(buf, script ? script : "");
-  bufferCat(buf, "|");
-  snprintf(temp_str, sizeof(temp_str), "%d", charges);
-  bufferCat(buf, temp_str);
-  bufferCat(buf, "|");
-  snprintf(temp_str, sizeof(temp_str), "%d", cooldown);
-  bufferCat(buf, temp_str);
-  bufferCat(buf, "|0"); // last_used = 0
-  
-  char *verb_data = strdupsafe(bufferString(buf));
-  deleteBuffer(buf);
-  
-  hashPut(aux->verb_handlers, verb, verb_data);
+  svaux_put_verb(aux, newSvauxVerb(aux, verb, script, charges, cooldown, 0));
 }
 
 void svaux_remove_verb(SKILLS_VERBS_AUX *aux, const char *verb) {
   if(!aux || !verb || !*verb)
     return;
   
-  char *verb_data = hashRemove(aux->verb_handlers, verb);
-  if(verb_data)
-    free(verb_data);
+  SVAUX_VERB *rec = hashRemove(aux->verb_handlers, verb);
+  if(rec) {
+    svaux_verb_unlink(rec);
+    deleteSvauxVerb(rec);
+  }
 }
 
-const char *svaux_get_verb_script(SKILLS_VERBS_AUX *aux, const char *verb) {
+SVAUX_VERB *svaux_get_verb(SKILLS_VERBS_AUX *aux, const char *verb) {
   if(!aux || !verb || !*verb)
-    return "";
+    return NULL;
   
-  char *verb_data = hashGet(aux->verb_handlers, verb);
-  if(!verb_data)
-    return "";
-  
-  static char script[SMALL_BUFFER];
-  int charges, cooldown, last_used;
-  sscanf(verb_data, "%[^|]|%d|%d|%d", script, &charges, &cooldown, &last_used);
-  return script;
+  return hashGet(aux->verb_handlers, verb);
+}
+
+const char *svaux_get_verb_script(SKILLS_VERBS_AUX *aux, const char *verb) {
+  SVAUX_VERB *rec = svaux_get_verb(aux, verb);
+  return (rec ? rec->script : "");
 }
 
 int svaux_get_verb_charges(SKILLS_VERBS_AUX *aux, const char *verb) {
-  if(!aux || !verb || !*verb)
-    return 0;
-  
-  char *verb_data = hashGet(aux->verb_handlers, verb);
-  if(!verb_data)
-    return 0;
-  
-  char script[SMALL_BUFFER];
-  int charges, cooldown, last_used;
-  sscanf(verb_data, "%[^|]|%d|%d|%d", script, &charges, &cooldown, &last_used);
-  return charges;
+  SVAUX_VERB *rec = svaux_get_verb(aux, verb);
+  return (rec ? rec->charges : 0);
 }
 
 int svaux_get_verb_cooldown(SKILLS_VERBS_AUX *aux, const char *verb) {
-  if(!aux || !verb || !*verb)
-    return 0;
-  
-  char *verb_data = hashGet(aux->verb_handlers, verb);
-  if(!verb_data)
-    return 0;
-  
-  char script[SMALL_BUFFER];
-  int charges, cooldown, last_used;
-  sscanf(verb_data, "%[^|]|%d|%d|%d", script, &charges, &cooldown, &last_used);
-  return cooldown;
+  SVAUX_VERB *rec = svaux_get_verb(aux, verb);
+  return (rec ? rec->cooldown : 0);
 }
 
 LIST *svaux_get_verb_list(SKILLS_VERBS_AUX *aux) {
@@ -326,79 +417,60 @@ LIST *svaux_get_verb_list(SKILLS_VERBS_AUX *aux) {
   
   HASH_ITERATOR *iter = newHashIterator(aux->verb_handlers);
   const char *verb;
-  char *verb_data;  // This is required by ITERATE_HASH macro
-  ITERATE_HASH(verb, verb_data, iter) {
+  for(; (verb = hashIteratorCurrentKey(iter)) != NULL; hashIteratorNext(iter))
     listPut(list, strdupsafe(verb));
-  }
   deleteHashIterator(iter);
   return list;
 }
 
-bool svaux_verb_on_cooldown(SKILLS_VERBS_AUX *aux, const char *verb, time_t current_time) {
-  if(!aux || !verb || !*verb)
-    return FALSE;
-  
-  char *verb_data = hashGet(aux->verb_handlers, verb);
-  if(!verb_data)
-    return FALSE;
-  
-  char script[SMALL_BUFFER];
-  int charges, cooldown, last_used;
-  sscanf(verb_data, "%[^|]|%d|%d|%d", script, &charges, &cooldown, &last_used);
-  
-  if(cooldown <= 0)
+bool svaux_record_on_cooldown(SVAUX_VERB *rec, time_t current_time) {
+  if(!rec || rec->cooldown <= 0)
     return FALSE;
   
-  return (current_time - last_used) < cooldown;
+  return (current_time - rec->last_used) < rec->cooldown;
 }
 
-bool svaux_use_verb(SKILLS_VERBS_AUX *aux, const char *verb, time_t current_time) {
-  if(!aux || !verb || !*verb)
-    return FALSE;
-  
-  char *verb_data = hashGet(aux->verb_handlers, verb);
-  if(!verb_data)
+bool svaux_verb_on_cooldown(SKILLS_VERBS_AUX *aux, const char *verb, time_t current_time) {
+  return svaux_record_on_cooldown(svaux_get_verb(aux, verb), current_time);
+}
+
+bool svaux_use_record(SVAUX_VERB *rec, time_t current_time) {
+  if(!rec)
     return FALSE;
   
-  char script[SMALL_BUFFER];
-  int charges, cooldown, last_used;
-  sscanf(verb_data, "%[^|]|%d|%d|%d", script, &charges, &cooldown, &last_used);
-  
   // Check charges
-  if(charges >= 0) {
-    if(charges <= 0)
+  if(rec->charges >= 0) {
+    if(rec->charges <= 0)
       return FALSE;
-    charges--;
+    rec->charges--;
   }
   
-  // Update verb data
-  BUFFER *buf = newBuffer(1);
-  char temp_str[32];
-  
-  bufferCat(buf, script);
-  bufferCat(buf, "|");
-  snprintf(temp_str, sizeof(temp_str), "%d", charges);
-  bufferCat(buf, temp_str);
-  bufferCat(buf, "|");
-  snprintf(temp_str, sizeof(temp_str), "%d", cooldown);
-  bufferCat(buf, temp_str);
-  bufferCat(buf, "|");
-  snprintf(temp_str, sizeof(temp_str), "%ld", (long)current_time);
-  bufferCat(buf, temp_str);
-  
-  char *new_data = strdupsafe(bufferString(buf));
-  deleteBuffer(buf);
-  
-  free(verb_data);
-  hashPut(aux->verb_handlers, verb, new_data);
+  // Start the cooldown over
+  svaux_verb_unlink(rec);
+  rec->last_used = current_time;
+  svaux_advance_wheel(current_time);
+  svaux_verb_link(rec);
   
   return TRUE;
 }
 
+bool svaux_use_verb(SKILLS_VERBS_AUX *aux, const char *verb, time_t current_time) {
+  return svaux_use_record(svaux_get_verb(aux, verb), current_time);
+}
+
+LIST *svaux_get_ready_verbs(SKILLS_VERBS_AUX *aux, time_t current_time) {
+  svaux_advance_wheel(current_time);
+  return aux->ready_verbs;
+}
+
 //*****************************************************************************
 // Module initialization
 //*****************************************************************************
 
+SKILLS_VERBS_AUX *svaux_obj_aux(OBJ_DATA *obj) {
+  return objGetAuxiliarySlot(obj, svaux_slot);
+}
+
 void skills_verbs_aux_init(void) {
   AUXILIARY_FUNCS *funcs = newAuxiliaryFuncs(
     AUXILIARY_TYPE_OBJ,  // Only for objects
@@ -411,5 +483,6 @@ void skills_verbs_aux_init(void) {
   );
   
   auxiliariesInstall("skills_verbs", funcs);
+  svaux_slot = auxiliariesGetSlot("skills_verbs");
   log_string("Skills and Verbs auxiliary data system initialized");
 }
\ No newline at end of file
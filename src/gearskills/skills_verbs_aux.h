@@ -11,17 +11,38 @@
 // Provides skill assignment (5 slots per item) and custom verbs for objects.
 // Skills track which skill should receive XP when item is used.
 // Verbs provide custom actions on items.
+//
+// Each verb is one record, so a single lookup gets its script, charges, and
+// cooldown. Verbs that have been used and are cooling down sit on a wheel
+// of buckets by the second they are ready again; as time passes, they are
+// moved back onto their item's list of ready verbs.
 //*****************************************************************************
 
-typedef struct {
+typedef struct skills_verbs_aux SKILLS_VERBS_AUX;
+
+typedef struct svaux_verb {
+  char *verb;                 // the verb's name
+  char *script;               // Python code to run when it is used
+  int charges;                // uses left (-1 for unlimited)
+  int cooldown;               // seconds between uses
+  time_t last_used;           // when it was last used (0 if never)
+  SKILLS_VERBS_AUX *owner;    // the aux data we belong to
+  bool cooling;               // are we on the cooldown wheel?
+} SVAUX_VERB;
+
+struct skills_verbs_aux {
   char *skills[5];            // 5 skill slots (skill names, or empty strings)
   int active_skill_slot;      // currently active skill slot (0-4)
-  HASHTABLE *verb_handlers;   // verb_name -> verb_data string
-} SKILLS_VERBS_AUX;
+  HASHTABLE *verb_handlers;   // verb_name -> SVAUX_VERB
+  LIST *ready_verbs;          // verbs not cooling down, with charges left
+};
 
 // Initialize the auxiliary data module (call once at startup)
 void skills_verbs_aux_init();
 
+// the skills/verbs data for an object
+SKILLS_VERBS_AUX *svaux_obj_aux(OBJ_DATA *obj);
+
 // Skill assignment functions
 void         svaux_assign_skill            (SKILLS_VERBS_AUX *aux, int slot, const char *skill);
 const char  *svaux_get_skill               (SKILLS_VERBS_AUX *aux, int slot);
@@ -38,4 +59,13 @@ LIST        *svaux_get_verb_list           (SKILLS_VERBS_AUX *aux);
 bool         svaux_verb_on_cooldown        (SKILLS_VERBS_AUX *aux, const char *verb, time_t current_time);
 bool         svaux_use_verb                (SKILLS_VERBS_AUX *aux, const char *verb, time_t current_time);
 
+// the same, for a verb record that has already been looked up
+SVAUX_VERB  *svaux_get_verb                (SKILLS_VERBS_AUX *aux, const char *verb);
+bool         svaux_record_on_cooldown      (SVAUX_VERB *rec, time_t current_time);
+bool         svaux_use_record              (SVAUX_VERB *rec, time_t current_time);
+
+// the SVAUX_VERBs on the aux data that can be used right now. The list
+// belongs to the aux data, and must not be modified or deleted
+LIST        *svaux_get_ready_verbs         (SKILLS_VERBS_AUX *aux, time_t current_time);
+
 #endif // __SKILLS_VERBS_AUX_H
\ No newline at end of file
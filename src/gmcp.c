@@ -0,0 +1,562 @@
+//*****************************************************************************
+//
+// gmcp.c
+//
+// support for GMCP, the Generic Mud Communication Protocol. See gmcp.h for
+// more information.
+//
+//*****************************************************************************
+
+#include "mud.h"
+#include "utils.h"
+#include "socket.h"
+#include "character.h"
+#include "room.h"
+#include "exit.h"
+#include "object.h"
+#include "auxiliary.h"
+#include "hooks.h"
+#include "gmcp.h"
+
+
+
+//*****************************************************************************
+// mandatory modules
+//*****************************************************************************
+#include "scripts/scripts.h"
+#include "scripts/pysocket.h"
+
+
+
+//*****************************************************************************
+// auxiliary data for sockets
+//*****************************************************************************
+typedef struct {
+  char      *name;
+  char      *sent; // what the client was last sent for us, or NULL
+  char   *pending; // what we've changed to since, if anything
+} GMCP_FIELD;
+
+typedef struct {
+  char      *name;
+  LIST    *fields;
+  bool      dirty; // have any of our fields been changed since our last send?
+} GMCP_PACKAGE;
+
+typedef struct {
+  bool    enabled; // did the client agree to GMCP?
+  LIST  *packages; // the packages we have set fields for
+  LIST  *messages; // whole messages, waiting for our next flush
+} GMCP_DATA;
+
+void deleteGMCPField(GMCP_FIELD *field) {
+  if(field->sent)    free(field->sent);
+  if(field->pending) free(field->pending);
+  free(field->name);
+  free(field);
+}
+
+void deleteGMCPPackage(GMCP_PACKAGE *package) {
+  deleteListWith(package->fields, deleteGMCPField);
+  free(package->name);
+  free(package);
+}
+
+GMCP_DATA *newGMCPData(void) {
+  GMCP_DATA *data = malloc(sizeof(GMCP_DATA));
+  data->enabled   = FALSE;
+  data->packages  = newList();
+  data->messages  = newList();
+  return data;
+}
+
+void deleteGMCPData(GMCP_DATA *data) {
+  deleteListWith(data->packages, deleteGMCPPackage);
+  deleteListWith(data->messages, free);
+  free(data);
+}
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+const unsigned char gmcp_will[] = { IAC, WILL, TELOPT_GMCP, '\0' };
+
+// the auxiliary slot our socket data is kept in
+int gmcp_slot = -1;
+
+GMCP_DATA *socketGetGMCPData(SOCKET_DATA *sock) {
+  return socketGetAuxiliarySlot(sock, gmcp_slot);
+}
+
+//
+// find a package on the socket, making it if it doesn't exist yet and make
+// is TRUE. Package names are case-insensitive
+GMCP_PACKAGE *gmcp_get_package(GMCP_DATA *data, const char *name, bool make) {
+  LIST_ITERATOR *pack_i = newListIterator(data->packages);
+  GMCP_PACKAGE *package = NULL;
+  ITERATE_LIST(package, pack_i) {
+    if(!strcasecmp(package->name, name))
+      break;
+  } deleteListIterator(pack_i);
+
+  if(package == NULL && make) {
+    package         = malloc(sizeof(GMCP_PACKAGE));
+    package->name   = strdup(name);
+    package->fields = newList();
+    package->dirty  = FALSE;
+    listQueue(data->packages, package);
+  }
+  return package;
+}
+
+GMCP_FIELD *gmcp_get_field(GMCP_PACKAGE *package, const char *name) {
+  LIST_ITERATOR *field_i = newListIterator(package->fields);
+  GMCP_FIELD      *field = NULL;
+  ITERATE_LIST(field, field_i) {
+    if(!strcmp(field->name, name))
+      break;
+  } deleteListIterator(field_i);
+
+  if(field == NULL) {
+    field          = malloc(sizeof(GMCP_FIELD));
+    field->name    = strdup(name);
+    field->sent    = NULL;
+    field->pending = NULL;
+    listQueue(package->fields, field);
+  }
+  return field;
+}
+
+//
+// add a message to what we're sending, wrapped in a subnegotiation. IACs in
+// the message have to be doubled up
+void gmcp_frame(BUFFER *out, const char *mssg) {
+  bufferCatCh(out, (char) IAC);
+  bufferCatCh(out, (char) SB);
+  bufferCatCh(out, (char) TELOPT_GMCP);
+  for(; *mssg; mssg++) {
+    bufferCatCh(out, *mssg);
+    if(*mssg == (char) IAC)
+      bufferCatCh(out, (char) IAC);
+  }
+  bufferCatCh(out, (char) IAC);
+  bufferCatCh(out, (char) SE);
+}
+
+//
+// add a message holding a package's changed fields to what we're sending
+void gmcp_frame_package(BUFFER *out, BUFFER *mssg, GMCP_PACKAGE *package) {
+  LIST_ITERATOR *field_i = newListIterator(package->fields);
+  GMCP_FIELD      *field = NULL;
+  int            changed = 0;
+
+  bufferClear(mssg);
+  bprintf(mssg, "%s {", package->name);
+  ITERATE_LIST(field, field_i) {
+    if(field->pending == NULL)
+      continue;
+    if(changed++ > 0)
+      bufferCatCh(mssg, ',');
+    gmcpJSONString(mssg, field->name);
+    bufferCatCh(mssg, ':');
+    bufferCat(mssg, field->pending);
+    if(field->sent) free(field->sent);
+    field->sent    = field->pending;
+    field->pending = NULL;
+  } deleteListIterator(field_i);
+  bufferCatCh(mssg, '}');
+  package->dirty = FALSE;
+
+  if(changed > 0)
+    gmcp_frame(out, bufferString(mssg));
+}
+
+
+
+//*****************************************************************************
+// hooks
+//*****************************************************************************
+
+//
+// send everything that changed for the socket since its last flush, in one go
+void gmcp_flush_hook(HOOK_ARGS *args) {
+  SOCKET_DATA *sock = NULL;
+  hookParseArgs(args, &sock);
+  GMCP_DATA   *data = socketGetGMCPData(sock);
+  if(data == NULL || !data->enabled)
+    return;
+
+  BUFFER *out = NULL, *mssg = NULL;
+  if(listSize(data->messages) > 0) {
+    out = newBuffer(MAX_BUFFER);
+    char *queued = NULL;
+    while((queued = listPop(data->messages)) != NULL) {
+      gmcp_frame(out, queued);
+      free(queued);
+    }
+  }
+
+  LIST_ITERATOR *pack_i = newListIterator(data->packages);
+  GMCP_PACKAGE *package = NULL;
+  ITERATE_LIST(package, pack_i) {
+    if(!package->dirty)
+      continue;
+    if(out  == NULL) out  = newBuffer(MAX_BUFFER);
+    if(mssg == NULL) mssg = newBuffer(SMALL_BUFFER);
+    gmcp_frame_package(out, mssg, package);
+  } deleteListIterator(pack_i);
+
+  if(out != NULL && bufferLength(out) > 0)
+    binary_to_socket(sock, bufferString(out), bufferLength(out));
+  if(out  != NULL) deleteBuffer(out);
+  if(mssg != NULL) deleteBuffer(mssg);
+}
+
+//
+// offer GMCP to new connections, and ones that were copied over (their
+// client will be asked again, since what it said last time is gone)
+void gmcp_offer_hook(HOOK_ARGS *args) {
+  SOCKET_DATA *sock = NULL;
+  hookParseArgs(args, &sock);
+  text_to_socket(sock, (const char *) gmcp_will);
+}
+
+//
+// listen for the client agreeing to GMCP, and for messages from it
+void gmcp_iac_hook(HOOK_ARGS *args) {
+  SOCKET_DATA *sock = NULL;
+  char        *iac  = NULL;
+  int           len = 0;
+  hookParseArgs(args, &sock, &iac, &len);
+  GMCP_DATA   *data = socketGetGMCPData(sock);
+  if(data == NULL || len < 3 || (unsigned char) iac[0] != IAC ||
+     (unsigned char) iac[2] != TELOPT_GMCP)
+    return;
+
+  switch((unsigned char) iac[1]) {
+  case DO:
+    // send all of our state again, in case we were turned off and back on
+    if(!data->enabled) {
+      LIST_ITERATOR *pack_i = newListIterator(data->packages);
+      GMCP_PACKAGE *package = NULL;
+      ITERATE_LIST(package, pack_i) {
+	gmcpResetPackage(sock, package->name);
+      } deleteListIterator(pack_i);
+    }
+    data->enabled = TRUE;
+    break;
+
+  case DONT:
+    data->enabled = FALSE;
+    break;
+
+  case SB: {
+    // strip off IAC SB GMCP and IAC SE, and undo IAC doubling
+    if(len < 5)
+      return;
+    char *mssg = malloc(len);
+    int i, mssg_len = 0;
+    for(i = 3; i < len - 2; i++) {
+      mssg[mssg_len++] = iac[i];
+      if((unsigned char) iac[i] == IAC && (unsigned char) iac[i+1] == IAC)
+	i++;
+    }
+    mssg[mssg_len] = '\0';
+
+    // split the package off from its data
+    char *json = strchr(mssg, ' ');
+    if(json != NULL)
+      *json++ = '\0';
+    hookRunArgs("receive_gmcp", "sk str str", sock, mssg, (json ? json : ""));
+    free(mssg);
+    break;
+  }
+  }
+}
+
+//
+// tell people where they are when they move
+void gmcp_char_to_room_hook(HOOK_ARGS *args) {
+  CHAR_DATA   *ch = NULL;
+  ROOM_DATA *room = NULL;
+  hookParseArgs(args, &ch, &room);
+  if(charGetSocket(ch) == NULL || !socketGMCPEnabled(charGetSocket(ch)))
+    return;
+
+  SOCKET_DATA *sock = charGetSocket(ch);
+  BUFFER       *buf = newBuffer(SMALL_BUFFER);
+  gmcpJSONString(buf, roomGetClass(room));
+  gmcpSetField(sock, "Room.Info", "num", bufferString(buf));
+  bufferClear(buf);
+  gmcpJSONString(buf, roomGetName(room));
+  gmcpSetField(sock, "Room.Info", "name", bufferString(buf));
+  bufferClear(buf);
+  gmcpJSONString(buf, get_key_locale(roomGetClass(room)));
+  gmcpSetField(sock, "Room.Info", "zone", bufferString(buf));
+
+  // and where they can go from here
+  int i;
+  bufferClear(buf);
+  bufferCatCh(buf, '{');
+  for(i = 0; i < roomCountEdges(room); i++) {
+    if(i > 0)
+      bufferCatCh(buf, ',');
+    gmcpJSONString(buf, roomGetEdgeDir(room, i));
+    bufferCatCh(buf, ':');
+    gmcpJSONString(buf, exitGetToFull(roomGetEdgeExit(room, i)));
+  }
+  bufferCatCh(buf, '}');
+  gmcpSetField(sock, "Room.Info", "exits", bufferString(buf));
+  deleteBuffer(buf);
+}
+
+//
+// tell people about things going into and out of their inventory
+void gmcp_inventory_change(CHAR_DATA *ch, OBJ_DATA *obj, bool added) {
+  if(charGetSocket(ch) == NULL || !socketGMCPEnabled(charGetSocket(ch)))
+    return;
+  BUFFER *buf = newBuffer(SMALL_BUFFER);
+  bprintf(buf, "{\"location\":\"inv\",\"item\":{\"id\":\"%d\"", objGetUID(obj));
+  if(added) {
+    bufferCat(buf, ",\"name\":");
+    gmcpJSONString(buf, objGetName(obj));
+  }
+  bufferCat(buf, "}}");
+  gmcpQueue(charGetSocket(ch), (added ? "Char.Items.Add":"Char.Items.Remove"),
+	    bufferString(buf));
+  deleteBuffer(buf);
+}
+
+void gmcp_obj_to_char_hook(HOOK_ARGS *args) {
+  OBJ_DATA  *obj = NULL;
+  CHAR_DATA  *ch = NULL;
+  hookParseArgs(args, &obj, &ch);
+  gmcp_inventory_change(ch, obj, TRUE);
+}
+
+void gmcp_obj_from_char_hook(HOOK_ARGS *args) {
+  OBJ_DATA  *obj = NULL;
+  CHAR_DATA  *ch = NULL;
+  hookParseArgs(args, &obj, &ch);
+  gmcp_inventory_change(ch, obj, FALSE);
+}
+
+
+
+//*****************************************************************************
+// Python extensions
+//*****************************************************************************
+
+//
+// append a Python value to buf as JSON. Simple values are done here, and
+// anything else is handed to Python's json module. Returns FALSE, with a
+// Python error set, if the value can't be made into JSON
+bool gmcp_py_json(BUFFER *buf, PyObject *value) {
+  if(value == Py_None)
+    bufferCat(buf, "null");
+  else if(PyBool_Check(value))
+    bufferCat(buf, (value == Py_True ? "true" : "false"));
+  else if(PyLong_Check(value))
+    bprintf(buf, "%ld", PyLong_AsLong(value));
+  else if(PyFloat_Check(value))
+    bprintf(buf, "%.15g", PyFloat_AsDouble(value));
+  else if(PyUnicode_Check(value))
+    gmcpJSONString(buf, PyUnicode_AsUTF8(value));
+  else {
+    PyObject *json = PyImport_ImportModule("json");
+    PyObject *str  = (json ? PyObject_CallMethod(json,"dumps","O",value): NULL);
+    Py_XDECREF(json);
+    if(str == NULL)
+      return FALSE;
+    bufferCat(buf, PyUnicode_AsUTF8(str));
+    Py_DECREF(str);
+  }
+  return TRUE;
+}
+
+PyObject *PySocket_getgmcp(PyObject *self, void *closure) {
+  SOCKET_DATA *sock = PySocket_AsSocket(self);
+  if(sock == NULL)
+    return NULL;
+  return Py_BuildValue("i", socketGMCPEnabled(sock));
+}
+
+PyObject *PySocket_gmcp_set(PyObject *self, PyObject *args) {
+  char    *package = NULL;
+  char      *field = NULL;
+  PyObject  *value = NULL;
+  if(!PyArg_ParseTuple(args, "ssO", &package, &field, &value)) {
+    PyErr_Format(PyExc_TypeError, "gmcp_set takes a package, field, and value");
+    return NULL;
+  }
+  SOCKET_DATA *sock = PySocket_AsSocket(self);
+  if(sock == NULL) {
+    PyErr_Format(PyExc_RuntimeError, "Tried to set GMCP on a nonexistent "
+		 "socket.");
+    return NULL;
+  }
+  BUFFER *buf = newBuffer(SMALL_BUFFER);
+  bool     ok = gmcp_py_json(buf, value);
+  if(ok)
+    gmcpSetField(sock, package, field, bufferString(buf));
+  deleteBuffer(buf);
+  if(!ok)
+    return NULL;
+  return Py_BuildValue("i", 1);
+}
+
+PyObject *PySocket_gmcp_send(PyObject *self, PyObject *args) {
+  char    *package = NULL;
+  PyObject  *value = NULL;
+  if(!PyArg_ParseTuple(args, "s|O", &package, &value)) {
+    PyErr_Format(PyExc_TypeError, "gmcp_send takes a package, and a value");
+    return NULL;
+  }
+  SOCKET_DATA *sock = PySocket_AsSocket(self);
+  if(sock == NULL) {
+    PyErr_Format(PyExc_RuntimeError, "Tried to send GMCP to a nonexistent "
+		 "socket.");
+    return NULL;
+  }
+  if(value == NULL) {
+    gmcpQueue(sock, package, NULL);
+    return Py_BuildValue("i", 1);
+  }
+  BUFFER *buf = newBuffer(SMALL_BUFFER);
+  bool     ok = gmcp_py_json(buf, value);
+  if(ok)
+    gmcpQueue(sock, package, bufferString(buf));
+  deleteBuffer(buf);
+  if(!ok)
+    return NULL;
+  return Py_BuildValue("i", 1);
+}
+
+PyObject *PySocket_gmcp_reset(PyObject *self, PyObject *args) {
+  char *package = NULL;
+  if(!PyArg_ParseTuple(args, "s", &package)) {
+    PyErr_Format(PyExc_TypeError, "gmcp_reset takes a package name");
+    return NULL;
+  }
+  SOCKET_DATA *sock = PySocket_AsSocket(self);
+  if(sock == NULL) {
+    PyErr_Format(PyExc_RuntimeError, "Tried to reset GMCP on a nonexistent "
+		 "socket.");
+    return NULL;
+  }
+  gmcpResetPackage(sock, package);
+  return Py_BuildValue("i", 1);
+}
+
+
+
+//*****************************************************************************
+// implementation of gmcp.h
+//*****************************************************************************
+void init_gmcp(void) {
+  auxiliariesInstall("gmcp_data",
+		     newAuxiliaryFuncs(AUXILIARY_TYPE_SOCKET,
+				       newGMCPData, deleteGMCPData,
+				       NULL, NULL, NULL, NULL));
+  gmcp_slot = auxiliariesGetSlot("gmcp_data");
+
+  hookAddArgs("receive_connection", gmcp_offer_hook);
+  hookAddArgs("copyover_complete",  gmcp_offer_hook);
+  hookAddArgs("receive_iac",        gmcp_iac_hook);
+  hookAddArgs("flush",              gmcp_flush_hook);
+  hookAddArgs("char_to_room",       gmcp_char_to_room_hook);
+  hookAddArgs("obj_to_char",        gmcp_obj_to_char_hook);
+  hookAddArgs("obj_from_char",      gmcp_obj_from_char_hook);
+
+  PySocket_addGetSetter("gmcp", PySocket_getgmcp, NULL,
+    "True if the socket's client has agreed to use GMCP. Immutable.");
+  PySocket_addMethod("gmcp_set", PySocket_gmcp_set, METH_VARARGS,
+    "gmcp_set(package, field, value)\n\n"
+    "Set one field of a GMCP package, e.g. sock.gmcp_set('Char.Vitals',\n"
+    "'hp', 50). Changed fields are sent once per pulse, and only if they\n"
+    "differ from what the client was last sent. Values can be anything\n"
+    "Python's json module can encode.");
+  PySocket_addMethod("gmcp_send", PySocket_gmcp_send, METH_VARARGS,
+    "gmcp_send(package, value=None)\n\n"
+    "Queue a whole GMCP message for the socket's next flush. value, if\n"
+    "given, is encoded as JSON.");
+  PySocket_addMethod("gmcp_reset", PySocket_gmcp_reset, METH_VARARGS,
+    "gmcp_reset(package)\n\n"
+    "Forget what was last sent for a GMCP package's fields, so the next\n"
+    "change to any of them sends all of them.");
+}
+
+bool socketGMCPEnabled(SOCKET_DATA *sock) {
+  GMCP_DATA *data = socketGetGMCPData(sock);
+  return (data != NULL && data->enabled);
+}
+
+void gmcpSetField(SOCKET_DATA *sock, const char *package, const char *field,
+		  const char *json) {
+  GMCP_DATA *data = socketGetGMCPData(sock);
+  if(data == NULL)
+    return;
+  GMCP_PACKAGE *pack = gmcp_get_package(data, package, TRUE);
+  GMCP_FIELD  *entry = gmcp_get_field(pack, field);
+
+  if(entry->pending) free(entry->pending);
+  entry->pending = NULL;
+  // changing back to what the client already has is no change at all
+  if(entry->sent == NULL || strcmp(entry->sent, json)) {
+    entry->pending = strdup(json);
+    pack->dirty    = TRUE;
+  }
+}
+
+void gmcpResetPackage(SOCKET_DATA *sock, const char *package) {
+  GMCP_DATA *data = socketGetGMCPData(sock);
+  GMCP_PACKAGE *pack = (data ? gmcp_get_package(data, package, FALSE) : NULL);
+  if(pack == NULL)
+    return;
+
+  LIST_ITERATOR *field_i = newListIterator(pack->fields);
+  GMCP_FIELD      *field = NULL;
+  ITERATE_LIST(field, field_i) {
+    if(field->sent == NULL)
+      continue;
+    if(field->pending == NULL)
+      field->pending = field->sent;
+    else
+      free(field->sent);
+    field->sent = NULL;
+    pack->dirty = TRUE;
+  } deleteListIterator(field_i);
+}
+
+void gmcpQueue(SOCKET_DATA *sock, const char *package, const char *json) {
+  GMCP_DATA *data = socketGetGMCPData(sock);
+  if(data == NULL || !data->enabled)
+    return;
+  BUFFER *mssg = newBuffer(SMALL_BUFFER);
+  bufferCat(mssg, package);
+  if(json != NULL && *json) {
+    bufferCatCh(mssg, ' ');
+    bufferCat(mssg, json);
+  }
+  listQueue(data->messages, strdup(bufferString(mssg)));
+  deleteBuffer(mssg);
+}
+
+void gmcpJSONString(BUFFER *buf, const char *str) {
+  bufferCatCh(buf, '"');
+  for(; *str; str++) {
+    unsigned char ch = *str;
+    if(ch == '"' || ch == '\\') {
+      bufferCatCh(buf, '\\');
+      bufferCatCh(buf, ch);
+    }
+    else if(ch == '\n') bufferCat(buf, "\\n");
+    else if(ch == '\r') bufferCat(buf, "\\r");
+    else if(ch == '\t') bufferCat(buf, "\\t");
+    else if(ch < 0x20)  bprintf(buf, "\\u%04x", ch);
+    else                bufferCatCh(buf, ch);
+  }
+  bufferCatCh(buf, '"');
+}
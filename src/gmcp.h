@@ -0,0 +1,58 @@
+#ifndef __GMCP_H
+#define __GMCP_H
+//*****************************************************************************
+//
+// gmcp.h
+//
+// support for GMCP (Generic Mud Communication Protocol, telnet option 201), a
+// channel for sending clients structured data alongside the text they see.
+// Each message is a package name (e.g. Char.Vitals) followed by JSON data.
+//
+// Most of what goes over GMCP is state: hit points, where someone is, and so
+// on. State is sent by setting fields of a package on a socket. Each socket
+// remembers what it last sent for every field, and once per pulse, when the
+// socket is flushed, sends each package it has changed fields for as one
+// message holding only the changed fields. Setting a field to what it was
+// last sent, however many times, sends nothing. Things that aren't state
+// (items being picked up and dropped) are queued as whole messages, and go
+// out on the same flush.
+//
+// GMCP is offered to every socket when it connects. Nothing is sent to a
+// socket until its client agrees to use it. Messages from the client are
+// handed to the receive_gmcp hook with the socket, package, and data.
+//
+//*****************************************************************************
+
+// the telnet option number for GMCP
+#define TELOPT_GMCP           201
+
+//
+// set up GMCP, and the hooks it uses to track rooms and inventories
+void init_gmcp(void);
+
+//
+// has the socket's client agreed to use GMCP?
+bool socketGMCPEnabled(SOCKET_DATA *sock);
+
+//
+// set one field of a package to a value, which must already be JSON (strings
+// quoted, and so on). It is sent with the socket's next flush if it differs
+// from the last value sent for the field
+void gmcpSetField(SOCKET_DATA *sock, const char *package, const char *field,
+		  const char *json);
+
+//
+// forget what was last sent for every field of a package, so the next change
+// to any of them sends all of them again (e.g. when someone changes rooms)
+void gmcpResetPackage(SOCKET_DATA *sock, const char *package);
+
+//
+// queue up a message for the socket's next flush. json may be NULL, for
+// messages with no data
+void gmcpQueue(SOCKET_DATA *sock, const char *package, const char *json);
+
+//
+// append str to buf as a quoted and escaped JSON string
+void gmcpJSONString(BUFFER *buf, const char *str);
+
+#endif // __GMCP_H
@@ -18,8 +18,13 @@
 #include "body.h"
 #include "inform.h"
 #include "hooks.h"
+#include "intern.h"
+#include "map.h"
 #include "handler.h"
 #include "commands.h"
+#include "socket.h"
+#include "shard.h"
+#include "stats.h"
 
 
 
@@ -34,6 +39,89 @@
 
 
 
+//*****************************************************************************
+// instance sets
+//
+// which objects and mobiles of each prototype are in the game, so resets and
+// scripts can find or count them without going through everything in the
+// game. Things are put in the set of every prototype in their prototype list,
+// and remember the list they were put under, in case it changes while they're
+// in the game
+//*****************************************************************************
+
+// interned prototype key -> the set of its instances in the game
+MAP *obj_instances  = NULL;
+MAP *char_instances = NULL;
+
+// thing in the game -> the interned prototype list it was counted under
+MAP *obj_counted    = NULL;
+MAP *char_counted   = NULL;
+
+void instances_add(MAP **counts, MAP **counted, void *thing,
+		   const char *prototypes, int amount) {
+  if(*counts == NULL) {
+    *counts  = newMap(NULL, NULL);
+    *counted = newMap(NULL, NULL);
+  }
+
+  // when adding, remember what we counted; when removing, use what we did
+  if(amount > 0) {
+    if(prototypes == NULL || !*prototypes || mapIn(*counted, thing))
+      return;
+    mapPut(*counted, thing, (void *)strInternRef(prototypes));
+  }
+  else if((prototypes = mapRemove(*counted, thing)) == NULL)
+    return;
+
+  int i, num = strInternNumWords(prototypes);
+  for(i = 0; i < num; i++) {
+    const char *proto = strInternWord(prototypes, i);
+    SET    *instances = mapGet(*counts, proto);
+    if(amount > 0) {
+      if(instances == NULL) {
+	instances = newSet();
+	mapPut(*counts, proto, instances);
+      }
+      setPut(instances, thing);
+    }
+    else if(instances != NULL) {
+      setRemove(instances, thing);
+      if(setSize(instances) == 0) {
+	mapRemove(*counts, proto);
+	deleteSet(instances);
+      }
+    }
+  }
+
+  if(amount < 0)
+    strRelease(prototypes);
+}
+
+SET *instances_get(MAP *counts, const char *prototype) {
+  const char *proto = (prototype ? strInternFind(prototype) : NULL);
+  return (counts && proto ? mapGet(counts, proto) : NULL);
+}
+
+int count_obj_instances(const char *prototype) {
+  SET *instances = instances_get(obj_instances, prototype);
+  return (instances ? setSize(instances) : 0);
+}
+
+int count_char_instances(const char *prototype) {
+  SET *instances = instances_get(char_instances, prototype);
+  return (instances ? setSize(instances) : 0);
+}
+
+SET *obj_instances_of(const char *prototype) {
+  return instances_get(obj_instances, prototype);
+}
+
+SET *char_instances_of(const char *prototype) {
+  return instances_get(char_instances, prototype);
+}
+
+
+
 //*****************************************************************************
 // obj/char from/to functions
 //*****************************************************************************
@@ -59,22 +147,22 @@ void obj_exist(OBJ_DATA *obj) {
 
   // also add all contents
   if(listSize(objGetContents(obj)) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(objGetContents(obj));
+    LOCAL_LIST_ITERATOR(cont_i, objGetContents(obj));
     OBJ_DATA *cont = NULL;
     ITERATE_LIST(cont, cont_i)
       obj_exist(cont);
-    deleteListIterator(cont_i);
+    listIteratorFinish(cont_i);
   }
 }
 
 void obj_unexist(OBJ_DATA *obj) {
   // also unexist all contents
   if(listSize(objGetContents(obj)) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(objGetContents(obj));
+    LOCAL_LIST_ITERATOR(cont_i, objGetContents(obj));
     OBJ_DATA *cont = NULL;
     ITERATE_LIST(cont, cont_i)
       obj_unexist(cont);
-    deleteListIterator(cont_i);
+    listIteratorFinish(cont_i);
   }
 
   propertyTableRemove(obj_table, objGetUID(obj));
@@ -93,19 +181,20 @@ void obj_to_game(OBJ_DATA *obj) {
     obj_exist(obj);
 
   // set and list storage, for objects physically 'in' the game
-  listPut(object_list, obj);
+  objSetGameNode(obj, listPutNode(object_list, obj));
   setPut(object_set, obj);
+  instances_add(&obj_instances, &obj_counted, obj, objGetPrototypes(obj), 1);
 
   // execute all of our to_game hooks
-  hookRun("obj_to_game", hookBuildInfo("obj", obj));
+  hookRunArgs("obj_to_game", "obj", obj);
 
   // also add all contents
   if(listSize(objGetContents(obj)) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(objGetContents(obj));
+    LOCAL_LIST_ITERATOR(cont_i, objGetContents(obj));
     OBJ_DATA *cont = NULL;
     ITERATE_LIST(cont, cont_i)
       obj_to_game(cont);
-    deleteListIterator(cont_i);
+    listIteratorFinish(cont_i);
   }
 }
 
@@ -114,58 +203,58 @@ void room_exist(ROOM_DATA *room) {
 
   // add contents
   if(listSize(roomGetContents(room)) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(roomGetContents(room));
+    LOCAL_LIST_ITERATOR(cont_i, roomGetContents(room));
     OBJ_DATA        *cont = NULL;
     ITERATE_LIST(cont, cont_i)
       obj_exist(cont);
-    deleteListIterator(cont_i);
+    listIteratorFinish(cont_i);
   }
 
   // add its people
   if(listSize(roomGetCharacters(room)) > 0) {
-    LIST_ITERATOR *ch_i = newListIterator(roomGetCharacters(room));
+    LOCAL_LIST_ITERATOR(ch_i, roomGetCharacters(room));
     CHAR_DATA       *ch = NULL;
     ITERATE_LIST(ch, ch_i)
       char_exist(ch);
-    deleteListIterator(ch_i);
+    listIteratorFinish(ch_i);
   }
 
   // add its exits
   LIST       *ex_list = roomGetExitNames(room);
-  LIST_ITERATOR *ex_i = newListIterator(ex_list);
+  LOCAL_LIST_ITERATOR(ex_i, ex_list);
   char           *dir = NULL;
   ITERATE_LIST(dir, ex_i) {
     exit_exist(roomGetExit(room, dir));
-  } deleteListIterator(ex_i);
+  } listIteratorFinish(ex_i);
   deleteListWith(ex_list, free);
 }
 
 void room_unexist(ROOM_DATA *room) {
   // add contents
   if(listSize(roomGetContents(room)) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(roomGetContents(room));
+    LOCAL_LIST_ITERATOR(cont_i, roomGetContents(room));
     OBJ_DATA        *cont = NULL;
     ITERATE_LIST(cont, cont_i)
       obj_unexist(cont);
-    deleteListIterator(cont_i);
+    listIteratorFinish(cont_i);
   }
 
   // add its people
   if(listSize(roomGetCharacters(room)) > 0) {
-    LIST_ITERATOR *ch_i = newListIterator(roomGetCharacters(room));
+    LOCAL_LIST_ITERATOR(ch_i, roomGetCharacters(room));
     CHAR_DATA       *ch = NULL;
     ITERATE_LIST(ch, ch_i)
       char_unexist(ch);
-    deleteListIterator(ch_i);
+    listIteratorFinish(ch_i);
   }
 
   // add its exits
   LIST       *ex_list = roomGetExitNames(room);
-  LIST_ITERATOR *ex_i = newListIterator(ex_list);
+  LOCAL_LIST_ITERATOR(ex_i, ex_list);
   char           *dir = NULL;
   ITERATE_LIST(dir, ex_i) {
     exit_unexist(roomGetExit(room, dir));
-  } deleteListIterator(ex_i);
+  } listIteratorFinish(ex_i);
   deleteListWith(ex_list, free);
 
   propertyTableRemove(room_table, roomGetUID(room));
@@ -184,31 +273,32 @@ void room_to_game(ROOM_DATA *room) {
 
   setPut(room_set, room);
   listPut(room_list, room);
+  roomGraphChanged();
 
   // execute all of our to_game hooks
-  hookRun("room_to_game", hookBuildInfo("rm", room));
+  hookRunArgs("room_to_game", "rm", room);
 
   // add contents
   if(listSize(roomGetContents(room)) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(roomGetContents(room));
+    LOCAL_LIST_ITERATOR(cont_i, roomGetContents(room));
     OBJ_DATA        *cont = NULL;
     ITERATE_LIST(cont, cont_i)
       obj_to_game(cont);
-    deleteListIterator(cont_i);
+    listIteratorFinish(cont_i);
   }
 
   // add its people
   if(listSize(roomGetCharacters(room)) > 0) {
-    LIST_ITERATOR *ch_i = newListIterator(roomGetCharacters(room));
+    LOCAL_LIST_ITERATOR(ch_i, roomGetCharacters(room));
     CHAR_DATA       *ch = NULL;
     ITERATE_LIST(ch, ch_i)
       char_to_game(ch);
-    deleteListIterator(ch_i);
+    listIteratorFinish(ch_i);
   }
 
   // add its exits, and their room table commands as neccessary
   LIST       *ex_list = roomGetExitNames(room);
-  LIST_ITERATOR *ex_i = newListIterator(ex_list);
+  LOCAL_LIST_ITERATOR(ex_i, ex_list);
   char           *dir = NULL;
   ITERATE_LIST(dir, ex_i) {
     exit_to_game(roomGetExit(room, dir));
@@ -221,16 +311,16 @@ void room_to_game(ROOM_DATA *room) {
       CMD_DATA *cmd = newPyCmd(dir, get_cmd_move(), "player", TRUE);
 
       // add all of our movement checks
-      LIST_ITERATOR *chk_i = newListIterator(get_move_checks());
+      LOCAL_LIST_ITERATOR(chk_i, get_move_checks());
       PyObject        *chk = NULL;
       ITERATE_LIST(chk, chk_i) {
 	cmdAddPyCheck(cmd, chk);
-      } deleteListIterator(chk_i);
+      } listIteratorFinish(chk_i);
 
       //cmdAddCheck(cmd, chk_can_move);
       roomAddCmd(room, dir, NULL, cmd);
     }
-  } deleteListIterator(ex_i);
+  } listIteratorFinish(ex_i);
   deleteListWith(ex_list, free);
 }
 
@@ -239,21 +329,21 @@ void char_exist(CHAR_DATA *ch) {
 
   // also add inventory
   if(listSize(charGetInventory(ch)) > 0) {
-    LIST_ITERATOR *inv_i = newListIterator(charGetInventory(ch));
+    LOCAL_LIST_ITERATOR(inv_i, charGetInventory(ch));
     OBJ_DATA *obj = NULL;
     ITERATE_LIST(obj, inv_i)
       obj_exist(obj);
-    deleteListIterator(inv_i);
+    listIteratorFinish(inv_i);
   }
 
   // and equipped items
   LIST *eq = bodyGetAllEq(charGetBody(ch));
   if(listSize(eq) > 0) {
-    LIST_ITERATOR *eq_i = newListIterator(eq);
+    LOCAL_LIST_ITERATOR(eq_i, eq);
     OBJ_DATA *obj = NULL;
     ITERATE_LIST(obj, eq_i)
       obj_exist(obj);
-    deleteListIterator(eq_i);
+    listIteratorFinish(eq_i);
   }
   deleteList(eq);
 }
@@ -261,21 +351,21 @@ void char_exist(CHAR_DATA *ch) {
 void char_unexist(CHAR_DATA *ch) {
   // also unexist inventory
   if(listSize(charGetInventory(ch)) > 0) {
-    LIST_ITERATOR *inv_i = newListIterator(charGetInventory(ch));
+    LOCAL_LIST_ITERATOR(inv_i, charGetInventory(ch));
     OBJ_DATA *obj = NULL;
     ITERATE_LIST(obj, inv_i)
       obj_unexist(obj);
-    deleteListIterator(inv_i);
+    listIteratorFinish(inv_i);
   }
 
   // and equipped items
   LIST *eq = bodyGetAllEq(charGetBody(ch));
   if(listSize(eq) > 0) {
-    LIST_ITERATOR *eq_i = newListIterator(eq);
+    LOCAL_LIST_ITERATOR(eq_i, eq);
     OBJ_DATA *obj = NULL;
     ITERATE_LIST(obj, eq_i)
       obj_unexist(obj);
-    deleteListIterator(eq_i);
+    listIteratorFinish(eq_i);
   }
   deleteList(eq);
 
@@ -287,6 +377,37 @@ bool char_exists(CHAR_DATA *ch) {
   return propertyTableIn(mob_table, charGetUID(ch));
 }
 
+// how many PCs are in the game
+int num_players = 0;
+
+//
+// take a PC out of the player table. They're usually under their name, unless
+// they were renamed while in the game
+void player_from_table(CHAR_DATA *ch) {
+  if(hashGet(online_players, charGetName(ch)) == ch)
+    hashRemove(online_players, charGetName(ch));
+  else {
+    HASH_ITERATOR *pl_i = newHashIterator(online_players);
+    const char    *name = NULL;
+    CHAR_DATA       *pl = NULL;
+    ITERATE_HASH(name, pl, pl_i) {
+      if(pl == ch) {
+	hashRemove(online_players, name);
+	break;
+      }
+    } deleteHashIterator(pl_i);
+  }
+}
+
+CHAR_DATA *find_player(const char *name) {
+  CHAR_DATA *ch = hashGet(online_players, name);
+  return (ch != NULL && !strcasecmp(charGetName(ch), name) ? ch : NULL);
+}
+
+int count_players(void) {
+  return num_players;
+}
+
 void char_to_game(CHAR_DATA *ch) {
   if(setIn(mobile_set, ch))
     return;
@@ -295,28 +416,34 @@ void char_to_game(CHAR_DATA *ch) {
     char_exist(ch);
   
   setPut(mobile_set, ch);
-  listPut(mobile_list, ch);
+  charSetGameNode(ch, listPutNode(mobile_list, ch));
+  if(!charIsNPC(ch)) {
+    hashPut(online_players, charGetName(ch), ch);
+    num_players++;
+  }
+  socketIndexChanged();
+  instances_add(&char_instances, &char_counted, ch, charGetPrototypes(ch), 1);
 
   // execute all of our to_game hooks
-  hookRun("char_to_game", hookBuildInfo("ch", ch));
+  hookRunArgs("char_to_game", "ch", ch);
 
   // also add inventory
   if(listSize(charGetInventory(ch)) > 0) {
-    LIST_ITERATOR *inv_i = newListIterator(charGetInventory(ch));
+    LOCAL_LIST_ITERATOR(inv_i, charGetInventory(ch));
     OBJ_DATA *obj = NULL;
     ITERATE_LIST(obj, inv_i)
       obj_to_game(obj);
-    deleteListIterator(inv_i);
+    listIteratorFinish(inv_i);
   }
 
   // and equipped items
   LIST *eq = bodyGetAllEq(charGetBody(ch));
   if(listSize(eq) > 0) {
-    LIST_ITERATOR *eq_i = newListIterator(eq);
+    LOCAL_LIST_ITERATOR(eq_i, eq);
     OBJ_DATA *obj = NULL;
     ITERATE_LIST(obj, eq_i)
       obj_to_game(obj);
-    deleteListIterator(eq_i);
+    listIteratorFinish(eq_i);
   }
   deleteList(eq);
 }
@@ -327,51 +454,54 @@ void exit_from_game(EXIT_DATA *exit) {
 
 void obj_from_game(OBJ_DATA *obj) {
   // go through all of our fromgame hooks
-  hookRun("obj_from_game", hookBuildInfo("obj", obj));
+  hookRunArgs("obj_from_game", "obj", obj);
 
   // also remove everything that is contained within the object
   if(listSize(objGetContents(obj)) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(objGetContents(obj));
+    LOCAL_LIST_ITERATOR(cont_i, objGetContents(obj));
     OBJ_DATA *cont = NULL;
     ITERATE_LIST(cont, cont_i)
       obj_from_game(cont);
-    deleteListIterator(cont_i);
+    listIteratorFinish(cont_i);
   }
 
-  if(setRemove(object_set, obj))
-    listRemove(object_list, obj);
+  if(setRemove(object_set, obj)) {
+    listRemoveNode(object_list, objGetGameNode(obj));
+    objSetGameNode(obj, NULL);
+  }
+  instances_add(&obj_instances, &obj_counted, obj, NULL, -1);
   propertyTableRemove(obj_table, objGetUID(obj));
 }
 
 void room_from_game(ROOM_DATA *room) {
   // go through all of our fromgame hooks
-  hookRun("room_from_game", hookBuildInfo("rm", room));
+  hookRunArgs("room_from_game", "rm", room);
 
   // also remove all the objects contained within the room
   if(listSize(roomGetContents(room)) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(roomGetContents(room));
+    LOCAL_LIST_ITERATOR(cont_i, roomGetContents(room));
     OBJ_DATA        *cont = NULL;
     ITERATE_LIST(cont, cont_i)
       obj_from_game(cont);
-    deleteListIterator(cont_i);
+    listIteratorFinish(cont_i);
   }
 
   // and now all of the characters
   if(listSize(roomGetCharacters(room)) > 0) {
-    LIST_ITERATOR *ch_i = newListIterator(roomGetCharacters(room));
+    LOCAL_LIST_ITERATOR(ch_i, roomGetCharacters(room));
     CHAR_DATA       *ch = NULL;
     ITERATE_LIST(ch, ch_i)
       char_from_game(ch);
-    deleteListIterator(ch_i);
+    listIteratorFinish(ch_i);
   }
 
   // remove its exits
   LIST       *ex_list = roomGetExitNames(room);
-  LIST_ITERATOR *ex_i = newListIterator(ex_list);
+  LOCAL_LIST_ITERATOR(ex_i, ex_list);
   char           *dir = NULL;
   ITERATE_LIST(dir, ex_i)
     exit_from_game(roomGetExit(room, dir));
-  deleteListIterator(ex_i);
+  listIteratorFinish(ex_i);
   deleteListWith(ex_list, free);
 
   if(setRemove(room_set, room))
@@ -381,82 +511,101 @@ void room_from_game(ROOM_DATA *room) {
 
 void char_from_game(CHAR_DATA *ch) {
   // go through all of our fromgame hooks, then remove us from the mobile list
-  hookRun("char_from_game", hookBuildInfo("ch", ch));
+  hookRunArgs("char_from_game", "ch", ch);
 
   // also remove inventory
   if(listSize(charGetInventory(ch)) > 0) {
-    LIST_ITERATOR *inv_i = newListIterator(charGetInventory(ch));
+    LOCAL_LIST_ITERATOR(inv_i, charGetInventory(ch));
     OBJ_DATA *obj = NULL;
     ITERATE_LIST(obj, inv_i)
       obj_from_game(obj);
-    deleteListIterator(inv_i);
+    listIteratorFinish(inv_i);
   }
 
   // and equipped items
   LIST *eq = bodyGetAllEq(charGetBody(ch));
   if(listSize(eq) > 0) {
-    LIST_ITERATOR *eq_i = newListIterator(eq);
+    LOCAL_LIST_ITERATOR(eq_i, eq);
     OBJ_DATA *obj = NULL;
     ITERATE_LIST(obj, eq_i)
       obj_from_game(obj);
-    deleteListIterator(eq_i);
+    listIteratorFinish(eq_i);
   }
   deleteList(eq);
 
-  if(setRemove(mobile_set, ch))
-    listRemove(mobile_list, ch);
+  if(setRemove(mobile_set, ch)) {
+    listRemoveNode(mobile_list, charGetGameNode(ch));
+    charSetGameNode(ch, NULL);
+    if(!charIsNPC(ch)) {
+      player_from_table(ch);
+      num_players--;
+    }
+  }
+  socketIndexChanged();
+  instances_add(&char_instances, &char_counted, ch, NULL, -1);
   propertyTableRemove(mob_table, charGetUID(ch));
 }
 
+//
+// take an object out of the inventory or container list it is in. Objects
+// carry the list node they were put in with, so this is usually immediate
+void obj_from_list(OBJ_DATA *obj, LIST *list) {
+  if(objGetListNode(obj) != NULL)
+    listRemoveNode(list, objGetListNode(obj));
+  else
+    listRemove(list, obj);
+  objSetListNode(obj, NULL);
+}
+
 void obj_from_char(OBJ_DATA *obj) {
   if(objGetCarrier(obj)) {
     CHAR_DATA *ch = objGetCarrier(obj);
-    listRemove(charGetInventory(objGetCarrier(obj)), obj);
+    obj_from_list(obj, charGetInventory(ch));
     objSetCarrier(obj, NULL);
-    hookRun("obj_from_char", hookBuildInfo("obj ch", obj, ch));
+    hookRunArgs("obj_from_char", "obj ch", obj, ch);
   }
 }
 
 void obj_from_obj(OBJ_DATA *obj) {
   if(objGetContainer(obj)) {
     OBJ_DATA *container = objGetContainer(obj);
-    listRemove(objGetContents(objGetContainer(obj)), obj);
+    obj_from_list(obj, objGetContents(container));
     objSetContainer(obj, NULL);
-    hookRun("obj_from_obj", hookBuildInfo("obj obj", obj, container));
+    hookRunArgs("obj_from_obj", "obj obj", obj, container);
   }
 }
 
 void obj_from_room(OBJ_DATA *obj) {
   if(objGetRoom(obj)) {
     ROOM_DATA *room = objGetRoom(obj);
-    listRemove(roomGetContents(objGetRoom(obj)), obj);
+    roomRemoveObj(room, obj);
     objSetRoom(obj, NULL);
-    hookRun("obj_from_room", hookBuildInfo("obj rm", obj, room));
+    hookRunArgs("obj_from_room", "obj rm", obj, room);
   }
 }
 
 void obj_to_char(OBJ_DATA *obj, CHAR_DATA *ch) {
-  listPut(charGetInventory(ch), obj);
+  objSetListNode(obj, listPutNode(charGetInventory(ch), obj));
   objSetCarrier(obj, ch);
-  hookRun("obj_to_char", hookBuildInfo("obj ch", obj, ch));
+  hookRunArgs("obj_to_char", "obj ch", obj, ch);
 }
 
 void obj_to_obj(OBJ_DATA *obj, OBJ_DATA *to) {
-  listPut(objGetContents(to), obj);
+  objSetListNode(obj, listPutNode(objGetContents(to), obj));
   objSetContainer(obj, to);
-  hookRun("obj_to_obj", hookBuildInfo("obj obj", obj, to));
+  hookRunArgs("obj_to_obj", "obj obj", obj, to);
 }
 
 void obj_to_room(OBJ_DATA *obj, ROOM_DATA *room) {
-  listPut(roomGetContents(room), obj);
+  roomAddObj(room, obj);
   objSetRoom(obj, room);
-  hookRun("obj_to_room", hookBuildInfo("obj rm", obj, room));
+  hookRunArgs("obj_to_room", "obj rm", obj, room);
 }
 
 void char_from_room(CHAR_DATA *ch) {
   if(charGetRoom(ch) != NULL) {
     ROOM_DATA *room = charGetRoom(ch);
-    hookRun("char_from_room", hookBuildInfo("ch rm", ch, room));
+    hookRunArgs("char_from_room", "ch rm", ch, room);
     charSetLastRoom(ch, charGetRoom(ch));
     roomRemoveChar(charGetRoom(ch), ch);
     charSetRoom(ch, NULL);
@@ -464,11 +613,21 @@ void char_from_room(CHAR_DATA *ch) {
 }
 
 void char_to_room(CHAR_DATA *ch, ROOM_DATA *room) {
+  shardNoteMove(charGetRoom(ch), room);
   if(charGetRoom(ch))
     char_from_room(ch);
   roomAddChar(room, ch);
   charSetRoom(ch, room);
-  hookRun("char_to_room", hookBuildInfo("ch rm", ch, room));
+  hookRunArgs("char_to_room", "ch rm", ch, room);
+}
+
+void chars_to_room(LIST *chars, ROOM_DATA *room) {
+  LOCAL_LIST_ITERATOR(ch_i, chars);
+  CHAR_DATA *ch = NULL;
+  ITERATE_LIST(ch, ch_i) {
+    if(charGetRoom(ch) != room)
+      char_to_room(ch, room);
+  } listIteratorFinish(ch_i);
 }
 
 void char_from_furniture(CHAR_DATA *ch) {
@@ -504,6 +663,7 @@ bool do_equip_ex(CHAR_DATA *ch, OBJ_DATA *obj, const char *pos, bool by_name,
   if((by_name  && bodyEquipPosnamesEx(charGetBody(ch), obj, pos, equipment_type, force)) ||
      (!by_name && bodyEquipPostypes(charGetBody(ch), obj, pos))) {
     objSetWearer(obj, ch);
+    charForgetDerivedOn(ch, DERIVED_ON_EQUIPMENT);
     return TRUE;
   }
   return FALSE;
@@ -540,7 +700,7 @@ bool try_equip_ex(CHAR_DATA *ch, OBJ_DATA *obj, const char *wanted_pos,
     if(listSize(want_types) != listSize(need_types))
       match = FALSE;
     else {
-      LIST_ITERATOR *need_i = newListIterator(need_types);
+      LOCAL_LIST_ITERATOR(need_i, need_types);
       char        *one_need = NULL;
 
       // now, make sure that each our our needed positions is represented
@@ -551,7 +711,7 @@ bool try_equip_ex(CHAR_DATA *ch, OBJ_DATA *obj, const char *wanted_pos,
 	  break;
 	else
 	  free(found);
-      } deleteListIterator(need_i);
+      } listIteratorFinish(need_i);
 
       // make sure we accounted for all of our needed positions
       match = (listSize(want_types) == 0);
@@ -568,7 +728,7 @@ bool try_equip_ex(CHAR_DATA *ch, OBJ_DATA *obj, const char *wanted_pos,
   }
 
   if(success == TRUE)
-    hookRun("equip", hookBuildInfo("ch obj", ch, obj));
+    hookRunArgs("equip", "ch obj", ch, obj);
 
   return success;
 }
@@ -576,6 +736,7 @@ bool try_equip_ex(CHAR_DATA *ch, OBJ_DATA *obj, const char *wanted_pos,
 bool do_unequip(CHAR_DATA *ch, OBJ_DATA *obj) {
   if(bodyUnequip(charGetBody(ch), obj)) {
     objSetWearer(obj, NULL);
+    charForgetDerivedOn(ch, DERIVED_ON_EQUIPMENT);
     return TRUE;
   }
   return FALSE;
@@ -583,13 +744,13 @@ bool do_unequip(CHAR_DATA *ch, OBJ_DATA *obj) {
 
 bool try_unequip(CHAR_DATA *ch, OBJ_DATA *obj) {
   if(objGetWearer(obj) == ch) {
-    hookRun("pre_unequip", hookBuildInfo("ch obj", ch, obj));
+    hookRunArgs("pre_unequip", "ch obj", ch, obj);
 
     // if wearer == ch, this should never fail
     bool success = do_unequip(ch, obj);
 
     if(success == TRUE)
-      hookRun("unequip", hookBuildInfo("ch obj", ch, obj));
+      hookRunArgs("unequip", "ch obj", ch, obj);
     else
       log_string("ERROR: failed to unequip obj when wearer == ch");
     return success;
@@ -679,32 +840,125 @@ char *in_arg(char *arg) {
 }
 
 
+//
+// the state of one search for a target. What we are looking for is worked out
+// once, up front, and whether the looker can see something is remembered, so
+// scopes that overlap (the room and the world, for instance) never ask twice.
+// Each scope is walked once, counting matches off as they are passed, instead
+// of being counted first and then walked again to pick out the nth match
+typedef struct {
+  CHAR_DATA *looker;
+  const char  *name;   // what we're looking for. Empty matches nothing
+  int           uid;   // name as a uid, or NOTHING if it isn't one
+  bool     must_see;
+  MAP         *seen;   // thing -> FIND_SEEN or FIND_UNSEEN. Made when needed
+  MAP        *added;   // things a search for all has found. Made when needed
+} FIND_PASS;
+
+#define FIND_SEEN      ((void *)1)
+#define FIND_UNSEEN    ((void *)2)
+
+void find_pass_init(FIND_PASS *pass, CHAR_DATA *looker, const char *name,
+		    bitvector_t find_scope) {
+  pass->looker   = looker;
+  pass->name     = name;
+  pass->uid      = name_as_uid(name);
+  pass->must_see = IS_SET(find_scope, FIND_SCOPE_VISIBLE);
+  pass->seen     = NULL;
+  pass->added    = NULL;
+}
+
+void find_pass_finish(FIND_PASS *pass) {
+  if(pass->seen  != NULL) deleteMap(pass->seen);
+  if(pass->added != NULL) deleteMap(pass->added);
+}
+
+//
+// can the looker see the char or obj? Asked of each thing at most once
+bool find_pass_sees(FIND_PASS *pass, void *thing, bool is_char) {
+  if(pass->seen == NULL)
+    pass->seen = newMap(NULL, NULL);
+  void *seen = mapGet(pass->seen, thing);
+  if(seen == NULL) {
+    bool sees = (is_char ? can_see_char(pass->looker, thing) :
+		 can_see_obj(pass->looker, thing));
+    seen = (sees ? FIND_SEEN : FIND_UNSEEN);
+    mapPut(pass->seen, thing, seen);
+  }
+  return (seen == FIND_SEEN);
+}
+
+//
+// walk the list for the *num'th char or obj we're looking for. Every match we
+// pass is counted off of num, so if there are not enough here, num is what's
+// left to find in the next scope we search
+void *find_pass_one(FIND_PASS *pass, LIST *list, int *num, bool is_char) {
+  // we're looking for something by its uid. It's in the game tables
+  if(pass->uid != NOTHING) {
+    void *thing = (is_char ? propertyTableGet(mob_table, pass->uid) :
+		   propertyTableGet(obj_table, pass->uid));
+    bool     in = (is_char ? char_in_list(thing, list):obj_in_list(thing,list));
+    if(in && find_pass_sees(pass, thing, is_char) && --(*num) == 0)
+      return thing;
+    return NULL;
+  }
+  else if(!*pass->name)
+    return NULL;
+
+  LOCAL_LIST_ITERATOR(thing_i, list);
+  void *thing = NULL, *found = NULL;
+  ITERATE_LIST(thing, thing_i) {
+    if(pass->must_see && !find_pass_sees(pass, thing, is_char))
+      continue;
+    if((is_char ? charIsName(thing, pass->name) : objIsName(thing, pass->name))
+       && --(*num) == 0) {
+      found = thing;
+      break;
+    }
+  } listIteratorFinish(thing_i);
+  return found;
+}
+
+//
+// queue every char or obj in the list we're looking for onto found, unless an
+// earlier scope already found it. An empty name matches everything
+void find_pass_all(FIND_PASS *pass, LIST *list, LIST *found, bool is_char) {
+  if(pass->added == NULL)
+    pass->added = newMap(NULL, NULL);
+
+  LOCAL_LIST_ITERATOR(thing_i, list);
+  void *thing = NULL;
+  ITERATE_LIST(thing, thing_i) {
+    if(mapIn(pass->added, thing))
+      continue;
+    if(pass->must_see && !find_pass_sees(pass, thing, is_char))
+      continue;
+    if(!*pass->name ||
+       (is_char ? (charIsName(thing, pass->name) ||
+		   charGetUID(thing) == pass->uid) :
+	(objIsName(thing, pass->name) || objGetUID(thing) == pass->uid))) {
+      mapPut(pass->added, thing, thing);
+      listQueue(found, thing);
+    }
+  } listIteratorFinish(thing_i);
+}
+
+
 //
 // Can find: objects and extra descriptions
 //
-void *find_on_char(CHAR_DATA *looker,
-		   CHAR_DATA *on,
-		   int at_count, const char *at,
-		   bitvector_t find_types,
-		   bitvector_t find_scope,
+void *find_on_char(FIND_PASS *pass, CHAR_DATA *on, int at_count,
+		   bitvector_t find_types, bitvector_t find_scope,
 		   int *found_type) {
-  int count = 0;
-
   // see if it's equipment
   if(IS_SET(find_types, FIND_TYPE_OBJ)) {
-    LIST *equipment = bodyGetAllEq(charGetBody(on));
-    count += count_objs(looker, equipment, at, NULL,
-			(IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
+    LIST *equipment = bodyGetEqList(charGetBody(on));
+    OBJ_DATA   *obj = find_pass_one(pass, equipment, &at_count, FALSE);
+    if(obj != NULL) {
       if(found_type)
 	*found_type = FOUND_OBJ;
-      OBJ_DATA *obj = find_obj(looker, equipment, at_count, at, NULL, 
-			       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-      deleteList(equipment);
       return obj;
     }
-    else
-      deleteList(equipment);
   }
 
   // see if it's an extra description
@@ -721,38 +975,26 @@ void *find_on_char(CHAR_DATA *looker,
 //
 // Can find: extra descriptions, chars
 //
-void *find_on_obj(CHAR_DATA *looker,
-		  OBJ_DATA  *on,
-		  int at_count, const char *at,
-		  bitvector_t find_types,
-		  bitvector_t find_scope,
+void *find_on_obj(FIND_PASS *pass, OBJ_DATA *on, int at_count,
+		  bitvector_t find_types, bitvector_t find_scope,
 		  int *found_type) {
-  int count = 0;
-
   // see if it's a character
   if(IS_SET(find_types, FIND_TYPE_CHAR)) {
-    count = count_chars(looker, objGetUsers(on), at, NULL,
-			(IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
+    CHAR_DATA *ch = find_pass_one(pass, objGetUsers(on), &at_count, TRUE);
+    if(ch != NULL) {
       if(found_type)
 	*found_type = FOUND_CHAR;
-      return find_char(looker, objGetUsers(on), at_count, at, NULL,
-		       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
+      return ch;
     }
-    else
-      at_count -= count;
   }
 
   // see if it's an extra description
   if(IS_SET(find_types, FIND_TYPE_EDESC)) {
-    count = (objGetEdesc(on, at) != NULL);
-    if(count && at_count == 1) {
+    if(objGetEdesc(on, pass->name) != NULL && at_count == 1) {
       if(found_type)
 	*found_type = FOUND_EDESC;
-      return edescSetGet(objGetEdescs(on), at);
+      return edescSetGet(objGetEdescs(on), pass->name);
     }
-    else
-      at_count--;
   }
  
   if(found_type)
@@ -764,43 +1006,44 @@ void *find_on_obj(CHAR_DATA *looker,
 //
 // Can find: objects and extra descriptions
 //
-void *find_in_obj(CHAR_DATA *looker,
-		  OBJ_DATA *in,
-		  int at_count, const char *at,
+void *find_in_obj(FIND_PASS *pass, OBJ_DATA *in, int at_count,
 		  int on_count, const char *on,
-		  bitvector_t find_types,
-		  bitvector_t find_scope,
+		  bitvector_t find_types, bitvector_t find_scope,
 		  int *found_type) {		  
   if(found_type)
     *found_type = FOUND_NONE;
 
   // see if we're looking on anything
   if(on && *on && on_count > 0) {
-    OBJ_DATA *on_obj = find_obj(looker, objGetContents(in), on_count, on, NULL,
-				(IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
+    FIND_PASS on_pass;
+    find_pass_init(&on_pass, pass->looker, on, find_scope);
+    OBJ_DATA *on_obj = find_pass_one(&on_pass, objGetContents(in), &on_count,
+				     FALSE);
+    find_pass_finish(&on_pass);
     if(!on_obj)
       return NULL;
     else
-      return find_on_obj(looker, on_obj, at_count, at, 
+      return find_on_obj(pass, on_obj, at_count,
 			 find_types, find_scope, found_type);
   }
   else {
-    int count = count_objs(looker, objGetContents(in), at, NULL,
-			    (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
-      if(found_type)
-	*found_type = FOUND_OBJ;
-      return find_obj(looker, objGetContents(in), at_count, at, NULL,
-		      (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    }
-    else
-      return NULL;
+    OBJ_DATA *obj = find_pass_one(pass, objGetContents(in), &at_count, FALSE);
+    if(obj != NULL && found_type)
+      *found_type = FOUND_OBJ;
+    return obj;
   }
 }
 
 
-LIST *find_all(CHAR_DATA *looker, const char *at, bitvector_t find_types,
+//
+// chars and objs are found in scope order, but each scope's finds go in
+// front of the ones before it. Scopes are kept apart in segs until we know
+// what all of them found, and then put together that way
+LIST *find_all(FIND_PASS *pass, bitvector_t find_types,
 	       bitvector_t find_scope, int *found_type) {
+  LIST *segs[4] = { NULL, NULL, NULL, NULL };
+  int num_segs  = 0, i;
+
   if(found_type)
     *found_type = FOUND_LIST;
 
@@ -808,134 +1051,77 @@ LIST *find_all(CHAR_DATA *looker, const char *at, bitvector_t find_types,
   /*                        FIND ALL OBJS                     */
   /************************************************************/
   if(find_types == FIND_TYPE_OBJ) {
-    LIST *obj_list = newList();
-    
     // get everything from our inventory
     if(IS_SET(find_scope, FIND_SCOPE_INV)) {
-      LIST *inv_objs = find_all_objs(looker,charGetInventory(looker), at, NULL,
-				     (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-      OBJ_DATA *obj = NULL;
-      while( (obj = listPop(inv_objs)) != NULL)
-	if(!listIn(obj_list, obj))
-	  listPut(obj_list, obj);
-      deleteList(inv_objs);
+      segs[num_segs] = newList();
+      find_pass_all(pass, charGetInventory(pass->looker), segs[num_segs++],
+		    FALSE);
     }
 
     // get everything from the room
     if(IS_SET(find_scope, FIND_SCOPE_ROOM)) {
-      LIST *room_objs = find_all_objs(looker, 
-				      roomGetContents(charGetRoom(looker)),
-				      at, NULL,
-				     (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-      OBJ_DATA *obj = NULL;
-      while( (obj = listPop(room_objs)) != NULL)
-	if(!listIn(obj_list, obj))
-	  listPut(obj_list, obj);
-      deleteList(room_objs);
+      segs[num_segs] = newList();
+      find_pass_all(pass, roomGetContents(charGetRoom(pass->looker)),
+		    segs[num_segs++], FALSE);
     }
 
     // get everything we are wearing
     if(IS_SET(find_scope, FIND_SCOPE_WORN)) {
-      // we have to get a list of all eq as an intermediary step, and then
-      // delete the list after we search through it again for everything
-      // that we can see.
-      LIST *equipment = bodyGetAllEq(charGetBody(looker));
-      LIST *eq_objs = find_all_objs(looker, equipment, at, NULL,
-				    (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-      deleteList(equipment);
-      OBJ_DATA *obj = NULL;
-      while( (obj = listPop(eq_objs)) != NULL)
-	if(!listIn(obj_list, obj))
-	  listPut(obj_list, obj);
-      deleteList(eq_objs);
+      LIST *equipment = bodyGetEqList(charGetBody(pass->looker));
+      segs[num_segs]  = newList();
+      find_pass_all(pass, equipment, segs[num_segs++], FALSE);
     }
 
     // get everything in the world
     if(IS_SET(find_scope, FIND_SCOPE_WORLD)) {
-      LIST *wld_objs = find_all_objs(looker,
-				     object_list, at, NULL, 
-				     (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-      OBJ_DATA *obj = NULL;
-      while( (obj = listPop(wld_objs)) != NULL)
-	if(!listIn(obj_list, obj))
-	  listPut(obj_list, obj);
-      deleteList(wld_objs);
+      segs[num_segs] = newList();
+      find_pass_all(pass, object_list, segs[num_segs++], FALSE);
     }
-
-    // if we didn't find anything, return NULL
-    if(listSize(obj_list) < 1) {
-      deleteList(obj_list);
-      if(found_type)
-	*found_type = FOUND_NONE;
-      return NULL;
-    }
-    else
-      return obj_list;
   }
 
-  
   /************************************************************/
   /*                        FIND ALL CHARS                    */
   /************************************************************/
   else if(find_types == FIND_TYPE_CHAR) {
-    LIST *char_list = newList();
-
     // find everyone in the room
     if(IS_SET(find_scope, FIND_SCOPE_ROOM)) {
-      LIST *room_chars =find_all_chars(looker, 
-				       roomGetCharacters(charGetRoom(looker)),
-				       at, NULL,
-				       (IS_SET(find_scope,FIND_SCOPE_VISIBLE)));
-      CHAR_DATA *ch = NULL;
-      while( (ch = listPop(room_chars)) != NULL)
-	if(!listIn(char_list, ch))
-	  listPut(char_list, ch);
-      deleteList(room_chars);
+      segs[num_segs] = newList();
+      find_pass_all(pass, roomGetCharacters(charGetRoom(pass->looker)),
+		    segs[num_segs++], TRUE);
     }
 
     // find everyone in the world
     if(IS_SET(find_scope, FIND_SCOPE_WORLD)) {
-      LIST *wld_chars = find_all_chars(looker, 
-				       mobile_list,
-				       at, NULL,
-				       (IS_SET(find_scope,FIND_SCOPE_VISIBLE)));
-      CHAR_DATA *ch = NULL;
-      while( (ch = listPop(wld_chars)) != NULL)
-	if(!listIn(char_list, ch))
-	  listPut(char_list, ch);
-      deleteList(wld_chars);
+      segs[num_segs] = newList();
+      find_pass_all(pass, mobile_list, segs[num_segs++], TRUE);
     }
+  }
 
-    // if we didn't find anything, return NULL
-    if(listSize(char_list) < 1) {
-      deleteList(char_list);
-      if(found_type)
-	*found_type = FOUND_NONE;
-      return NULL;
-    }
-    else
-      return char_list;
+  // put the scopes together, last first
+  LIST *found = newList();
+  for(i = num_segs - 1; i >= 0; i--) {
+    void *thing = NULL;
+    while((thing = listPop(segs[i])) != NULL)
+      listQueue(found, thing);
+    deleteList(segs[i]);
   }
-  
 
-  /************************************************************/
-  /*                       FIND ALL EDESCS                    */
-  /************************************************************/
-  else {
+  // if we didn't find anything, return NULL
+  if(listSize(found) < 1) {
+    deleteList(found);
     if(found_type)
       *found_type = FOUND_NONE;
     return NULL;
   }
+  return found;
 }
 
 
-void *find_one(CHAR_DATA *looker, 
-	       int at_count, const char *at, 
-	       bitvector_t find_types,
+void *find_one(FIND_PASS *pass, int at_count, bitvector_t find_types,
 	       bitvector_t find_scope, int *found_type) {
-
-  // find what we're looking AT
-  int count = 0;
+  CHAR_DATA *looker = pass->looker;
+  const char    *at = pass->name;
+  void       *found = NULL;
 
   /************************************************************/
   /*                   PERSONAL SEARCHES                      */
@@ -954,37 +1140,24 @@ void *find_one(CHAR_DATA *looker,
   // search our equipment
   if(IS_SET(find_scope, FIND_SCOPE_WORN) &&
      IS_SET(find_types, FIND_TYPE_OBJ)) {
-    LIST *equipment = bodyGetAllEq(charGetBody(looker));
-    count = count_objs(looker, equipment, at, NULL, 
-		       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
+    LIST *equipment = bodyGetEqList(charGetBody(looker));
+    found = find_pass_one(pass, equipment, &at_count, FALSE);
+    if(found != NULL) {
       if(found_type)
 	*found_type = FOUND_OBJ;
-
-      OBJ_DATA *obj = find_obj(looker, equipment, at_count, at, NULL, 
-			       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-      deleteList(equipment);
-      return obj;
-    }
-    else {
-      deleteList(equipment);
-      at_count -= count;
+      return found;
     }
   }
 
   // seach our inventory
   if(IS_SET(find_scope, FIND_SCOPE_INV) && 
      IS_SET(find_types, FIND_TYPE_OBJ)) {
-    count = count_objs(looker, charGetInventory(looker), at, NULL, 
-		       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
+    if((found = find_pass_one(pass, charGetInventory(looker), &at_count,
+			      FALSE)) != NULL) {
       if(found_type)
 	*found_type = FOUND_OBJ;
-      return find_obj(looker, charGetInventory(looker), at_count, at, NULL,
-		      (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
+      return found;
     }
-    else
-      at_count -= count;
   }
 
 
@@ -1004,32 +1177,23 @@ void *find_one(CHAR_DATA *looker,
   // search objects in the room
   if(IS_SET(find_scope, FIND_SCOPE_ROOM) && 
      IS_SET(find_types, FIND_TYPE_OBJ)) {
-    count = count_objs(looker, roomGetContents(charGetRoom(looker)), at, NULL,
-		       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
+    if((found = find_pass_one(pass, roomGetContents(charGetRoom(looker)),
+			      &at_count, FALSE)) != NULL) {
       if(found_type)
 	*found_type = FOUND_OBJ;
-      return find_obj(looker, roomGetContents(charGetRoom(looker)), at_count,
-		      at, NULL, (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
+      return found;
     }
-    else
-      at_count -= count;
   }
 
   // seach the characters in the room
   if(IS_SET(find_scope, FIND_SCOPE_ROOM) &&
      IS_SET(find_types, FIND_TYPE_CHAR)) {
-    count = count_chars(looker, roomGetCharacters(charGetRoom(looker)), at,
-		       NULL, (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
+    if((found = find_pass_one(pass, roomGetCharacters(charGetRoom(looker)),
+			      &at_count, TRUE)) != NULL) {
       if(found_type)
 	*found_type = FOUND_CHAR;
-      return find_char(looker, roomGetCharacters(charGetRoom(looker)), 
-		       at_count, at, NULL,
-		       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
+      return found;
     }
-    else
-	at_count -= count;
   }
 
   // search for exits in the room
@@ -1053,7 +1217,7 @@ void *find_one(CHAR_DATA *looker,
     }
 
     LIST       *ex_list = roomGetExitNames(charGetRoom(looker));
-    LIST_ITERATOR *ex_i = newListIterator(ex_list);
+    LOCAL_LIST_ITERATOR(ex_i, ex_list);
     char           *dir = NULL;
 
     ITERATE_LIST(dir, ex_i) {
@@ -1062,25 +1226,26 @@ void *find_one(CHAR_DATA *looker,
 	if(!IS_SET(find_scope,FIND_SCOPE_VISIBLE) || can_see_exit(looker,exit)){
 	  at_count--;
 	  if(at_count == 0) {
-	    if(found_type)
-	      *found_type = FOUND_EXIT;
+	    found = exit;
 	    break;
 	  }
 	}
       }
-    } deleteListIterator(ex_i);
+    } listIteratorFinish(ex_i);
     deleteListWith(ex_list, free);
 
     // we found one
-    if(*found_type != FOUND_NONE)
-      return exit;
+    if(found != NULL) {
+      if(found_type)
+	*found_type = FOUND_EXIT;
+      return found;
+    }
   }
 
   // search extra descriptions in the room
   if(IS_SET(find_scope, FIND_SCOPE_ROOM) &&
      IS_SET(find_types, FIND_TYPE_EDESC)) {
-    count = (roomGetEdesc(charGetRoom(looker), at) != NULL);
-    if(count && at_count == 1) {
+    if(roomGetEdesc(charGetRoom(looker), at) != NULL && at_count == 1) {
       if(found_type)
 	*found_type = FOUND_EDESC;
       return edescSetGet(roomGetEdescs(charGetRoom(looker)), at);
@@ -1110,31 +1275,21 @@ void *find_one(CHAR_DATA *looker,
   // search objects in the world
   if(IS_SET(find_scope, FIND_SCOPE_WORLD) &&
      IS_SET(find_types, FIND_TYPE_OBJ)) {
-    count = count_objs(looker, object_list, at, NULL, 
-			 (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
+    if((found = find_pass_one(pass, object_list, &at_count, FALSE)) != NULL) {
       if(found_type)
 	*found_type = FOUND_OBJ;
-      return find_obj(looker, object_list, at_count, at, NULL, 
-		      (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
+      return found;
     }
-    else
-	at_count -= count;
   }
 
   // search characters in the world
   if(IS_SET(find_scope, FIND_SCOPE_WORLD) &&
      IS_SET(find_types, FIND_TYPE_CHAR)) {
-    count = count_chars(looker, mobile_list, at, NULL, 
-		       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
-    if(count >= at_count) {
+    if((found = find_pass_one(pass, mobile_list, &at_count, TRUE)) != NULL) {
       if(found_type)
 	*found_type = FOUND_CHAR;
-      return find_char(looker, mobile_list, at_count, at, NULL,
-		       (IS_SET(find_scope, FIND_SCOPE_VISIBLE)));
+      return found;
     }
-    else
-	at_count -= count;
   }
 
   // we didn't find anything!
@@ -1221,38 +1376,29 @@ void *generic_find(CHAR_DATA *looker, const char *arg,
 
 
 //
-// At is what we're looking for
-// On is the thing we're looking for it on (e.g. "on sword" "on joe")
-// In is the thing we're looking for it in (e.g. "in hole" "in bag")
-//
-void *find_specific(CHAR_DATA *looker,
-		    const char *full_at, 
-		    const char *full_on, 
-		    const char *full_in,
-		    bitvector_t find_types,
-		    bitvector_t find_scope,
-		    bool all_ok, int *found_type) {
-  // for stuff like 2.sword, all.woman, etc...
-  int at_count = 1;
-  int on_count = 1;
-  int in_count = 1;
-
-  // the buffers for storing at, in, on separate from their counts
-  char at[SMALL_BUFFER] = "";
-  char in[SMALL_BUFFER] = "";
-  char on[SMALL_BUFFER] = "";
-
-  // separate the names from their numbers
-  get_count(full_at, at, &at_count);
-  get_count(full_in, in, &in_count);
-  get_count(full_on, on, &on_count);
+// find_specific, once the names we're looking for have been separated from
+// their counts. What we look in and on is found by name and count directly,
+// so their counts never have to be printed back into them and pulled out again
+void *find_specific_counted(CHAR_DATA *looker,
+			    const char *at, int at_count,
+			    const char *on, int on_count,
+			    const char *in, int in_count,
+			    bitvector_t find_types,
+			    bitvector_t find_scope,
+			    bool all_ok, int *found_type) {
+  FIND_PASS pass;
+  void      *val = NULL;
 
   if(found_type)
     *found_type = FOUND_NONE;
 
   // are we trying to find all of something?
-  if(all_ok && at_count == COUNT_ALL && !*on && !*in)
-    return find_all(looker, at, find_types, find_scope, found_type);
+  if(all_ok && at_count == COUNT_ALL && !*on && !*in) {
+    find_pass_init(&pass, looker, at, find_scope);
+    val = find_all(&pass, find_types, find_scope, found_type);
+    find_pass_finish(&pass);
+    return val;
+  }
 
   else if(!*at || at_count == 0) {
     // we're trying to find what the contents of an item are?
@@ -1261,12 +1407,9 @@ void *find_specific(CHAR_DATA *looker,
        IS_SET(find_types, FIND_TYPE_IN_OBJ)) {
       void *tgt = NULL;
       int next_found_type = FOUND_NONE; // for finding in/on stuff
-      char new_at[strlen(in) + 20]; // +20 for digits
-      print_count(new_at, in, in_count);
-      tgt = find_specific(looker, 
-			  new_at, "", "",
-			  find_types, find_scope,
-			  all_ok, &next_found_type);
+      tgt = find_specific_counted(looker, in, in_count, "", 1, "", 1,
+				  find_types, find_scope,
+				  all_ok, &next_found_type);
 
       // we couldn't find the thing we were trying to look inside
       if(!tgt)
@@ -1296,30 +1439,27 @@ void *find_specific(CHAR_DATA *looker,
 
   else {
     void *tgt  = NULL; // used for finding what we're looking in/on
+    find_pass_init(&pass, looker, at, find_scope);
+
     /****************************************************/
     /*                   START LOOK IN                  */
     /****************************************************/
     // check out what we're looking in
     if(*in && in_count > 0) {
       int next_found_type = FOUND_NONE; // for finding in/on stuff
-      char new_at[strlen(in) + 20]; // +20 for digits
-      print_count(new_at, in, in_count);
-      tgt = find_specific(looker, 
-			  new_at, "", "",
-			  find_types, find_scope,
-			  all_ok, &next_found_type);
+      tgt = find_specific_counted(looker, in, in_count, "", 1, "", 1,
+				  find_types, find_scope,
+				  all_ok, &next_found_type);
       // we couldn't find the thing we were trying to look inside
       if(!tgt)
-	return NULL;
+	val = NULL;
       // we have to KILL someone before we can look inside of them ;)
       else if(next_found_type != FOUND_OBJ)
-	return NULL;
+	val = NULL;
       // apply another find, narrowing the scope to inside this object
       else
-	return find_in_obj(looker, tgt, 
-			   at_count, at, 
-			   on_count, on,
-			   find_types, find_scope, found_type);
+	val = find_in_obj(&pass, tgt, at_count, on_count, on,
+			  find_types, find_scope, found_type);
     }
 
 
@@ -1329,30 +1469,63 @@ void *find_specific(CHAR_DATA *looker,
     // find out what we're looking on
     else if(*on && on_count > 0) {
       int next_found_type = FOUND_NONE;
-      char new_at[strlen(on) + 20]; // +20 for digits
-      print_count(new_at, on, on_count);
-      tgt = find_specific(looker, 
-			  on, "", "",
-			  find_types, find_scope,
-			  all_ok, &next_found_type);
+      tgt = find_specific_counted(looker, on, on_count, "", 1, "", 1,
+				  find_types, find_scope,
+				  all_ok, &next_found_type);
       // couldn't find what we were trying to look on
       if(tgt == NULL)
-	return NULL;
+	val = NULL;
       else if(next_found_type == FOUND_CHAR)
-	return find_on_char(looker, tgt, at_count, at, 
-			    find_types, find_scope, found_type);
-      else if(next_found_type == FOUND_OBJ) {
-	return find_on_obj(looker, tgt, at_count, at, find_types, 
-			   find_scope, found_type);
-      }
+	val = find_on_char(&pass, tgt, at_count,
+			   find_types, find_scope, found_type);
+      else if(next_found_type == FOUND_OBJ)
+	val = find_on_obj(&pass, tgt, at_count,
+			  find_types, find_scope, found_type);
       else
-	return NULL;
+	val = NULL;
     }
 
 
     /****************************************************/
     /*                   START LOOK AT                  */
     /****************************************************/
-    return find_one(looker, at_count, at, find_types, find_scope, found_type);
+    else
+      val = find_one(&pass, at_count, find_types, find_scope, found_type);
+
+    find_pass_finish(&pass);
+    return val;
   }
 }
+
+
+//
+// At is what we're looking for
+// On is the thing we're looking for it on (e.g. "on sword" "on joe")
+// In is the thing we're looking for it in (e.g. "in hole" "in bag")
+//
+void *find_specific(CHAR_DATA *looker,
+		    const char *full_at, 
+		    const char *full_on, 
+		    const char *full_in,
+		    bitvector_t find_types,
+		    bitvector_t find_scope,
+		    bool all_ok, int *found_type) {
+  // for stuff like 2.sword, all.woman, etc...
+  int at_count = 1;
+  int on_count = 1;
+  int in_count = 1;
+
+  // the buffers for storing at, in, on separate from their counts
+  char at[SMALL_BUFFER] = "";
+  char in[SMALL_BUFFER] = "";
+  char on[SMALL_BUFFER] = "";
+
+  // separate the names from their numbers
+  get_count(full_at, at, &at_count);
+  get_count(full_in, in, &in_count);
+  get_count(full_on, on, &on_count);
+
+  return find_specific_counted(looker, at, at_count, on, on_count,
+			       in, in_count, find_types, find_scope,
+			       all_ok, found_type);
+}
@@ -22,11 +22,15 @@
 // For instance, when a brand new character has been made for character 
 // creation. Whenever something is put to_game, it is first make to exist.
 // Whenever something is remove from_game, it is also immediately unexisted.
+// find_player returns the PC in the game with the name (any case), or NULL,
+// and count_players how many PCs are in the game.
 void      char_exist        (CHAR_DATA *ch);
 void      char_unexist      (CHAR_DATA *ch);
 bool      char_exists       (CHAR_DATA *ch);
 void      char_to_game      (CHAR_DATA *ch);
 void      char_from_game    (CHAR_DATA *ch);
+CHAR_DATA *find_player      (const char *name);
+int       count_players     (void);
 void      obj_exist         (OBJ_DATA  *obj);
 void      obj_unexist       (OBJ_DATA  *obj);
 bool      obj_exists        (OBJ_DATA  *obj);
@@ -43,6 +47,21 @@ bool      exit_exists       (EXIT_DATA *exit);
 void      exit_to_game      (EXIT_DATA *exit);
 void      exit_from_game    (EXIT_DATA *exit);
 
+//
+// how many objects or mobiles in the game are instances of the prototype.
+// The same as counting through object_list or mobile_list with
+// objIsInstance/charIsInstance, but without the counting
+int  count_obj_instances(const char *prototype);
+int count_char_instances(const char *prototype);
+
+//
+// the objects or mobiles in the game that are instances of the prototype, or
+// NULL if there are none. The sets belong to the game and must not be
+// changed, and may be deleted once what is in them leaves the game; copy them
+// first if things might be extracted while going through them
+SET  *obj_instances_of   (const char *prototype);
+SET  *char_instances_of  (const char *prototype);
+
 
 // all of these things require that the character(s) and object(s) have
 // the right spatial relations to eachtoher (e.g. do_give requires the
@@ -66,6 +85,7 @@ void      obj_to_room         (OBJ_DATA *obj, ROOM_DATA *room);
 
 void      char_from_room      (CHAR_DATA *ch);
 void      char_to_room        (CHAR_DATA *ch, ROOM_DATA *room);
+void      chars_to_room       (LIST *chars, ROOM_DATA *room);
 void      char_from_furniture (CHAR_DATA *ch);
 void      char_to_furniture   (CHAR_DATA *ch, OBJ_DATA *furniture);
 
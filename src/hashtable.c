@@ -14,76 +14,123 @@
 #include "hashtable.h"
 #include "mud.h"
 #include "utils.h"
+#include "intern.h"
+#include "memstat.h"
 
 
 
-// how big of a size do our hashtables start out at?
-#define DEFAULT_HASH_SIZE        5
+//
+// hashtables are flat arrays of entries, with open addressing and linear
+// probing. Every entry caches the hash of its key, so probing only has to
+// compare keys whose hashes match. Short keys are kept inside of the entry,
+// and long ones are interned so tables sharing a key share one copy of it
+// (see intern.h). Removed entries leave a tombstone behind instead of moving
+// other entries around, so removing the current element while iterating over
+// a table is safe. Tombstones are cleaned up whenever the table is rebuilt.
+// Keys are case-insensitive
+//
 
-struct hashtable_iterator {
-  unsigned int curr_bucket;
-  HASHTABLE *table;
-  LIST_ITERATOR *bucket_i;
-};
+// how big of a size do our hashtables start out at? Must be a power of 2
+#define DEFAULT_HASH_SIZE        8
+
+// keys shorter than this are stored inside of the entry
+#define HASH_SHORT_KEY          24
+
+// the states an entry can be in
+#define HASH_EMPTY               0
+#define HASH_FULL                1
+#define HASH_DELETED             2
 
 typedef struct hashtable_entry {
-  char *key;
-  void *val;
+  unsigned int hash;
+  char        state;
+  const char   *key;
+  void         *val;
+  char    short_key[HASH_SHORT_KEY];
 } HASH_ENTRY;
 
 struct hashtable {
-  int size;
-  int num_buckets;
-  LIST **buckets;
+  int size;        // how many entries are full
+  int deleted;     // how many entries are tombstones
+  int num_buckets; // always a power of 2
+  HASH_ENTRY *buckets;
 };
 
-
 //
-// an internal form of hashGet that returns the entire entry (key and val)
-HASH_ENTRY *hashGetEntry(HASHTABLE *table, const char *key){
-  unsigned int bucket = string_hash(key) % table->num_buckets;
+// keys are case-insensitive; string_hash folds case for us
+#define hash_key(key)        ((unsigned int)string_hash(key))
 
-  if(table->buckets[bucket] == NULL)
-    return NULL;
-  else {
-    LIST_ITERATOR *list_i = newListIterator(table->buckets[bucket]);
-    HASH_ENTRY      *elem = NULL;
+//
+// the smallest power of 2 that can hold size entries without getting too full
+int hash_buckets_for(int size) {
+  int buckets = DEFAULT_HASH_SIZE;
+  while(buckets * 3 < size * 4)
+    buckets *= 2;
+  return buckets;
+}
 
-    for(;(elem = listIteratorCurrent(list_i)) != NULL; listIteratorNext(list_i))
-      if(!strcasecmp(key, elem->key))
-	break;
-    deleteListIterator(list_i);
+void hash_entry_free_key(HASH_ENTRY *entry) {
+  if(entry->key != entry->short_key)
+    strRelease(entry->key);
+  entry->key = NULL;
+}
 
-    return elem;
+void hash_entry_set_key(HASH_ENTRY *entry, const char *key) {
+  int len = strlen(key);
+  if(len < HASH_SHORT_KEY) {
+    memcpy(entry->short_key, key, len + 1);
+    entry->key = entry->short_key;
   }
+  else
+    entry->key = strIntern(key);
 }
 
-HASH_ENTRY *newHashtableEntry(const char *key, void *val) {
-  HASH_ENTRY *entry = malloc(sizeof(HASH_ENTRY));
-  entry->key = strdup(key);
-  entry->val = val;
-  return entry;
+//
+// an internal form of hashGet that returns the entire entry (key and val)
+HASH_ENTRY *hashGetEntryHash(HASHTABLE *table, const char *key, 
+			     unsigned int hash) {
+  unsigned int  mask = table->num_buckets - 1;
+  unsigned int     i = hash & mask;
+  for(;; i = (i + 1) & mask) {
+    HASH_ENTRY *entry = &table->buckets[i];
+    if(entry->state == HASH_EMPTY)
+      return NULL;
+    if(entry->state == HASH_FULL && entry->hash == hash && 
+       (key == entry->key || !strcasecmp(key, entry->key)))
+      return entry;
+  }
 }
 
-void deleteHashtableEntry(HASH_ENTRY *entry) {
-  if(entry->key) free(entry->key);
-  free(entry);
+HASH_ENTRY *hashGetEntry(HASHTABLE *table, const char *key) {
+  return hashGetEntryHash(table, key, hash_key(key));
 }
 
 //
-// Collect all of the HASH_ENTRYs in a hashtable into a single list
-LIST *hashCollectEntries(HASHTABLE *table) {
-  LIST *list = newList();
+// rebuild the table with a new number of buckets, dropping tombstones
+void hash_rebuild(HASHTABLE *table, int num_buckets) {
+  HASH_ENTRY *old = table->buckets;
+  int     old_num = table->num_buckets;
   int i;
-  for(i = 0; i < table->num_buckets; i++) {
-    if(table->buckets[i] == NULL) continue;
-    LIST_ITERATOR *list_i = newListIterator(table->buckets[i]);
-    HASH_ENTRY      *elem = NULL;
-    for(;(elem=listIteratorCurrent(list_i)) != NULL;listIteratorNext(list_i))
-      listPut(list, elem);
-    deleteListIterator(list_i);
+
+  memNote(MEM_HASHTABLE, 0,
+	  (long long)(num_buckets - old_num) * sizeof(HASH_ENTRY));
+  table->buckets     = calloc(num_buckets, sizeof(HASH_ENTRY));
+  table->num_buckets = num_buckets;
+  table->deleted     = 0;
+
+  for(i = 0; i < old_num; i++) {
+    if(old[i].state != HASH_FULL)
+      continue;
+    unsigned int mask = num_buckets - 1;
+    unsigned int    j = old[i].hash & mask;
+    while(table->buckets[j].state != HASH_EMPTY)
+      j = (j + 1) & mask;
+    table->buckets[j] = old[i];
+    // short keys live inside the entry, so they moved with it
+    if(old[i].key == old[i].short_key)
+      table->buckets[j].key = table->buckets[j].short_key;
   }
-  return list;
+  free(old);
 }
 
 
@@ -93,13 +140,12 @@ LIST *hashCollectEntries(HASHTABLE *table) {
 // documentation in hashtable.h
 //*****************************************************************************
 HASHTABLE *newHashtableSize(int num_buckets) {
-  int i;
-  HASHTABLE *table   = malloc(sizeof(HASHTABLE));
-  table->num_buckets = num_buckets;
+  HASHTABLE *table   = memAlloc(MEM_HASHTABLE, sizeof(HASHTABLE));
+  table->num_buckets = hash_buckets_for(num_buckets);
+  memNote(MEM_HASHTABLE, 0, table->num_buckets * sizeof(HASH_ENTRY));
   table->size        = 0;
-  table->buckets = malloc(sizeof(LIST *) * num_buckets);
-  for(i = 0; i < num_buckets; i++)
-    table->buckets[i] = NULL;
+  table->deleted     = 0;
+  table->buckets     = calloc(table->num_buckets, sizeof(HASH_ENTRY));
   return table;
 }
 
@@ -109,14 +155,11 @@ HASHTABLE *newHashtable(void) {
 
 
 void  deleteHashtable(HASHTABLE *table) {
-  int i;
-  for(i = 0; i < table->num_buckets; i++) {
-    if(table->buckets[i])
-      deleteListWith(table->buckets[i], deleteHashtableEntry);
-  }
-
+  hashClearWith(table, NULL);
+  memNote(MEM_HASHTABLE, 0,
+	  -(long long)(table->num_buckets * sizeof(HASH_ENTRY)));
   free(table->buckets);
-  free(table);
+  memFree(MEM_HASHTABLE, table, sizeof(HASHTABLE));
 }
 
 void deleteHashtableWith(HASHTABLE *table, void *func) {
@@ -127,56 +170,42 @@ void deleteHashtableWith(HASHTABLE *table, void *func) {
 //
 // expand a hashtable to the new size
 void hashExpand(HASHTABLE *table, int size) {
-  // collect all of the key:value pairs
-  LIST     *entries = hashCollectEntries(table);
-  HASH_ENTRY *entry = NULL;
-  int i;
-
-  // delete all of the current buckets
-  for(i = 0; i < table->num_buckets; i++) {
-    if(table->buckets[i] == NULL) continue;
-    deleteList(table->buckets[i]);
-  }
-  free(table->buckets);
-
-  // now, make new buckets and set them to NULL
-  table->buckets = calloc(size, sizeof(LIST *));
-  table->num_buckets = size;
-
-  // now, we put all of our entries back into the new buckets
-  while((entry = listPop(entries)) != NULL) {
-    unsigned int bucket = string_hash(entry->key) % table->num_buckets;
-    if(table->buckets[bucket] == NULL) table->buckets[bucket] = newList();
-    listPut(table->buckets[bucket], entry);
-  }
-  deleteList(entries);
+  int num_buckets = hash_buckets_for(MAX(size, table->size));
+  if(num_buckets > table->num_buckets)
+    hash_rebuild(table, num_buckets);
 }
 
 
 int hashPut(HASHTABLE *table, const char *key, void *val) {
-  HASH_ENTRY *elem = hashGetEntry(table, key);
+  unsigned int hash = hash_key(key);
+  HASH_ENTRY  *elem = hashGetEntryHash(table, key, hash);
 
   // if it's already in, update the value
   if(elem) {
     elem->val = val;
     return 1;
   }
-  else {
-    // first, see if we'll need to expand the table
-    if((table->size * 80)/100 > table->num_buckets)
-      hashExpand(table, (table->num_buckets * 150)/100);
-
-    unsigned int bucket = string_hash(key) % table->num_buckets;
 
-    // if the bucket doesn't exist yet, create it
-    if(table->buckets[bucket] == NULL)
-      table->buckets[bucket] = newList();
-
-    HASH_ENTRY *entry = newHashtableEntry(key, val);
-    listPut(table->buckets[bucket], entry);
-    table->size++;
-    return 1;
-  }
+  // first, see if we'll need to grow the table (or just clear out our
+  // tombstones) to keep it from getting too full
+  if((table->size + table->deleted + 1) * 4 > table->num_buckets * 3)
+    hash_rebuild(table, ((table->size + 1) * 2 > table->num_buckets ?
+			 table->num_buckets * 2 : table->num_buckets));
+
+  // take the first free entry along our probe
+  unsigned int mask = table->num_buckets - 1;
+  unsigned int    i = hash & mask;
+  while(table->buckets[i].state == HASH_FULL)
+    i = (i + 1) & mask;
+  elem = &table->buckets[i];
+  if(elem->state == HASH_DELETED)
+    table->deleted--;
+  elem->state = HASH_FULL;
+  elem->hash  = hash;
+  elem->val   = val;
+  hash_entry_set_key(elem, key);
+  table->size++;
+  return 1;
 }
 
 void *hashGet(HASHTABLE *table, const char *key) {
@@ -188,29 +217,16 @@ void *hashGet(HASHTABLE *table, const char *key) {
 }
 
 void *hashRemove(HASHTABLE *table, const char *key) {
-  unsigned int bucket = string_hash(key) % table->num_buckets;
-
-  if(table->buckets[bucket] == NULL)
+  HASH_ENTRY *elem = hashGetEntry(table, key);
+  if(elem == NULL)
     return NULL;
-  else {
-    LIST_ITERATOR *list_i = newListIterator(table->buckets[bucket]);
-    HASH_ENTRY *elem = NULL;
-
-    for(;(elem = listIteratorCurrent(list_i)) != NULL; listIteratorNext(list_i))
-      if(!strcasecmp(key, elem->key))
-	break;
-    deleteListIterator(list_i);
-
-    if(elem) {
-      void *val = elem->val;
-      listRemove(table->buckets[bucket], elem);
-      deleteHashtableEntry(elem);
-      table->size--;
-      return val;
-    }
-    else
-      return NULL;
-  }
+  void *val   = elem->val;
+  hash_entry_free_key(elem);
+  elem->state = HASH_DELETED;
+  elem->val   = NULL;
+  table->size--;
+  table->deleted++;
+  return val;
 }
 
 int   hashIn     (HASHTABLE *table, const char *key) {
@@ -224,15 +240,9 @@ int   hashSize   (HASHTABLE *table) {
 LIST *hashCollect(HASHTABLE *table) {
   LIST *list = newList();
   int i;
-
-  for(i = 0; i < table->num_buckets; i++) {
-    if(table->buckets[i] == NULL) continue;
-    LIST_ITERATOR *list_i = newListIterator(table->buckets[i]);
-    HASH_ENTRY      *elem = NULL;
-    for(;(elem=listIteratorCurrent(list_i)) != NULL;listIteratorNext(list_i))
-      listPut(list, strdup(elem->key));
-    deleteListIterator(list_i);
-  }
+  for(i = 0; i < table->num_buckets; i++)
+    if(table->buckets[i].state == HASH_FULL)
+      listPut(list, strdup(table->buckets[i].key));
   return list;
 }
 
@@ -245,14 +255,17 @@ void hashClearWith(HASHTABLE *table, void *func) {
   int i;
 
   for(i = 0; i < table->num_buckets; i++) {
-    if(table->buckets[i] == NULL) continue;
-    HASH_ENTRY *elem = NULL;
-    while( (elem = listPop(table->buckets[i])) != NULL) {
+    HASH_ENTRY *elem = &table->buckets[i];
+    if(elem->state == HASH_FULL) {
       if(free_func && elem->val)
 	free_func(elem->val);
-      deleteHashtableEntry(elem);
+      hash_entry_free_key(elem);
     }
+    elem->state = HASH_EMPTY;
+    elem->val   = NULL;
   }
+  table->size    = 0;
+  table->deleted = 0;
 }
 
 
@@ -261,81 +274,59 @@ void hashClearWith(HASHTABLE *table, void *func) {
 // implementation of the hashtable iterator
 // documentation in hashtable.h
 //*****************************************************************************
-HASH_ITERATOR *newHashIterator(HASHTABLE *table) {
-  HASH_ITERATOR *I = malloc(sizeof(HASH_ITERATOR));
+HASH_ITERATOR *hashIteratorInit(HASH_ITERATOR *I, HASHTABLE *table) {
   I->table = table;
-  I->bucket_i = NULL;
   hashIteratorReset(I);
-
   return I;
 }
 
+void        hashIteratorFinish     (HASH_ITERATOR *I) {
+  // nothing to clean up; removed entries are tombstones until the next put
+}
+
+HASH_ITERATOR *newHashIterator(HASHTABLE *table) {
+  HASH_ITERATOR *I = memAlloc(MEM_HASH_ITERATOR, sizeof(HASH_ITERATOR));
+  return hashIteratorInit(I, table);
+}
+
 void        deleteHashIterator     (HASH_ITERATOR *I) {
-  if(I->bucket_i) deleteListIterator(I->bucket_i);
-  free(I);
+  hashIteratorFinish(I);
+  memFree(MEM_HASH_ITERATOR, I, sizeof(HASH_ITERATOR));
 }
 
-void        hashIteratorReset      (HASH_ITERATOR *I) {
-  int i;
+//
+// move the iterator up to the next full entry, starting at where it is now
+void hash_iterator_seek(HASH_ITERATOR *I) {
+  while(I->curr_bucket < I->table->num_buckets &&
+	I->table->buckets[I->curr_bucket].state != HASH_FULL)
+    I->curr_bucket++;
+}
 
-  if(I->bucket_i) deleteListIterator(I->bucket_i);
-  I->bucket_i = NULL;
+void        hashIteratorReset      (HASH_ITERATOR *I) {
   I->curr_bucket = 0;
-
-  // bucket_i will be NULL if there are no elements
-  for(i = 0; i < I->table->num_buckets; i++) {
-    if(I->table->buckets[i] != NULL &&
-       listSize(I->table->buckets[i]) > 0) {
-      I->curr_bucket = i;
-      I->bucket_i = newListIterator(I->table->buckets[i]);
-      break;
-    }
-  }
+  hash_iterator_seek(I);
 }
 
 
 void        hashIteratorNext       (HASH_ITERATOR *I) {
-  // no elements in the hashtable
-  if(I->bucket_i == NULL) 
-    return;
-  // we're at the end of our list
-  else if(listIteratorNext(I->bucket_i) == NULL) {
-    deleteListIterator(I->bucket_i);
-    I->bucket_i = NULL;
+  if(I->curr_bucket < I->table->num_buckets) {
     I->curr_bucket++;
-    
-    for(; I->curr_bucket < I->table->num_buckets; I->curr_bucket++) {
-      if(I->table->buckets[I->curr_bucket] != NULL &&
-	 listSize(I->table->buckets[I->curr_bucket]) > 0) {
-	I->bucket_i = newListIterator(I->table->buckets[I->curr_bucket]);
-	break;
-      }
-    }
+    hash_iterator_seek(I);
   }
 }
 
 
 const char *hashIteratorCurrentKey (HASH_ITERATOR *I) {
-  if(!I->bucket_i) 
+  if(I->curr_bucket >= I->table->num_buckets ||
+     I->table->buckets[I->curr_bucket].state != HASH_FULL)
     return NULL;
-  else {
-    HASH_ENTRY *entry = listIteratorCurrent(I->bucket_i);
-    if(entry)
-      return entry->key;
-    else
-      return NULL;
-  }
+  return I->table->buckets[I->curr_bucket].key;
 }
 
 
 void       *hashIteratorCurrentVal (HASH_ITERATOR *I) {
-  if(!I->bucket_i) 
+  if(I->curr_bucket >= I->table->num_buckets ||
+     I->table->buckets[I->curr_bucket].state != HASH_FULL)
     return NULL;
-  else {
-    HASH_ENTRY *entry = listIteratorCurrent(I->bucket_i);
-    if(entry)
-      return entry->val;
-    else
-      return NULL;
-  }
+  return I->table->buckets[I->curr_bucket].val;
 }
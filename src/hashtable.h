@@ -70,8 +70,25 @@ void hashClearWith(HASHTABLE *table, void *func);
       hashIteratorNext(it), \
       key = hashIteratorCurrentKey(it), val = hashIteratorCurrentVal(it))
 
+//
+// laid out here only so hash iterators can live on the stack. Don't touch
+// the fields directly
+struct hashtable_iterator {
+  unsigned int curr_bucket;
+  HASHTABLE         *table;
+};
+
+//
+// declares a hash iterator named name that lives on the stack. It must be
+// finished with hashIteratorFinish instead of deleteHashIterator
+#define LOCAL_HASH_ITERATOR(name, table) \
+  HASH_ITERATOR name##_local; \
+  HASH_ITERATOR *name = hashIteratorInit(&name##_local, table)
+
 HASH_ITERATOR *newHashIterator     (HASHTABLE *table);
 void        deleteHashIterator     (HASH_ITERATOR *I);
+HASH_ITERATOR *hashIteratorInit    (HASH_ITERATOR *I, HASHTABLE *table);
+void        hashIteratorFinish     (HASH_ITERATOR *I);
 
 void        hashIteratorReset      (HASH_ITERATOR *I);
 void        hashIteratorNext       (HASH_ITERATOR *I);
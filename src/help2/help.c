@@ -9,11 +9,14 @@
 //*****************************************************************************
 
 #include <dirent.h>
+#include <sys/stat.h>
+#include <math.h>
 
 #include "../mud.h"
 #include "../utils.h"
 #include "../storage.h"
 #include "../character.h"
+#include "../intern.h"
 #include "help.h"
 #include "hedit.h"
 
@@ -50,16 +53,51 @@ char *get_old_help_file(void) {
 // where we store all of our helpfiles
 NEAR_MAP *help_table;
 
+// the file we keep the keywords, groups, and terms of every helpfile on disc
+// in, so they can be put in the help table at boot without reading the files
+#define HELP_INDEX_FILE   "index"
+
+// the most results a search will return
+#define HELP_SEARCH_MAX   20
+
+// how much more a word counts for in a search when it is one of the keywords
+#define HELP_KEYWORD_WEIGHT 5
+
+// a word in a helpfile, and how many times it shows up
+typedef struct help_term {
+  const char *term;  // interned
+  int        count;
+} HELP_TERM;
+
+// one helpfile a term shows up in
+typedef struct help_posting {
+  HELP_DATA *help;
+  int       count;
+} HELP_POSTING;
+
+// every term in a helpfile, mapped to a list of the postings for it
+HASHTABLE *help_terms = NULL;
+
+// how many helpfiles are in the term index
+int num_indexed_help = 0;
+
 struct help_data {
   char *keywords;    // words that bring up this helpfile
-  char *info;        // the information in the helpfile
+  char *info;        // the information in the helpfile. NULL if not read yet
   char *user_groups; // the user group the helpfile belongs to, if any
   char *related;     // a list of other helpfiles that are related
+  char *file;        // where our info can be read from, if it isn't yet
+  HELP_TERM *terms;  // the words in our keywords and info
+  int    num_terms;
+  bool     indexed;  // are we in the term index?
+  int search_stamp;  // the last search we were scored in
+  int matched;       // how many of the search's terms we have
+  double score;      // and how well we match them
 };
 
 HELP_DATA *newHelp(const char *keywords, const char *info, 
 		   const char *user_groups, const char *related) {
-  HELP_DATA *data   = malloc(sizeof(HELP_DATA));
+  HELP_DATA *data   = calloc(1, sizeof(HELP_DATA));
   data->keywords    = strdupsafe(keywords);
   data->info        = strdupsafe(info);
   data->user_groups = strdupsafe(user_groups);
@@ -67,14 +105,36 @@ HELP_DATA *newHelp(const char *keywords, const char *info,
   return data;
 }
 
+void help_unindex(HELP_DATA *data);
+
 void deleteHelp(HELP_DATA *data) {
+  help_unindex(data);
   if(data->keywords)    free(data->keywords);
   if(data->info)        free(data->info);
   if(data->user_groups) free(data->user_groups);
   if(data->related)     free(data->related);
+  if(data->file)        free(data->file);
+  if(data->terms) {
+    int i;
+    for(i = 0; i < data->num_terms; i++)
+      strRelease(data->terms[i].term);
+    free(data->terms);
+  }
   free(data);
 }
 
+//
+// read in our info from disc, if we haven't yet
+void help_load_info(HELP_DATA *data) {
+  if(data->info == NULL) {
+    STORAGE_SET *set = storage_read(data->file);
+    data->info = strdupsafe(read_string(set, "info"));
+    storage_close(set);
+    free(data->file);
+    data->file = NULL;
+  }
+}
+
 HELP_DATA *helpRead(STORAGE_SET *set) {
   return newHelp(read_string(set, "keywords"),
 		 read_string(set, "info"),
@@ -84,6 +144,7 @@ HELP_DATA *helpRead(STORAGE_SET *set) {
 
 STORAGE_SET *helpStore(HELP_DATA *data) {
   STORAGE_SET *set = new_storage_set();
+  help_load_info(data);
   store_string(set, "keywords",   data->keywords);
   store_string(set, "info",       data->info);
   store_string(set, "user_group", data->user_groups);
@@ -92,6 +153,134 @@ STORAGE_SET *helpStore(HELP_DATA *data) {
 }
 
 
+
+//*****************************************************************************
+// the term index
+//*****************************************************************************
+
+//
+// count up every word in the text, lower-cased, into counts. Colour codes
+// are skipped over
+void help_count_terms(HASHTABLE *counts, const char *text, int weight) {
+  char term[SMALL_BUFFER];
+  int   len = 0;
+  for(;; text++) {
+    if(*text == '{' && text[1] != '\0') {
+      text++;
+      continue;
+    }
+    if(isalnum(*text)) {
+      if(len < 32)
+	term[len++] = tolower(*text);
+      continue;
+    }
+    // we're at the end of a word
+    if(len > 1) {
+      term[len] = '\0';
+      hashPut(counts, term, (void *)((long)hashGet(counts, term) + weight));
+    }
+    len = 0;
+    if(*text == '\0')
+      break;
+  }
+}
+
+//
+// set our terms from a table of term counts
+void help_set_terms(HELP_DATA *data, HASHTABLE *counts) {
+  HASH_ITERATOR *hash_i = newHashIterator(counts);
+  const char      *term = NULL;
+  void           *count = NULL;
+  data->terms     = malloc(sizeof(HELP_TERM) * MAX(1, hashSize(counts)));
+  data->num_terms = 0;
+  ITERATE_HASH(term, count, hash_i) {
+    data->terms[data->num_terms].term  = strIntern(term);
+    data->terms[data->num_terms].count = (int)(long)count;
+    data->num_terms++;
+  } deleteHashIterator(hash_i);
+}
+
+//
+// figure out our terms from our keywords and info
+void help_find_terms(HELP_DATA *data) {
+  HASHTABLE *counts = newHashtable();
+  help_count_terms(counts, data->keywords, HELP_KEYWORD_WEIGHT);
+  help_count_terms(counts, data->info, 1);
+  help_set_terms(data, counts);
+  deleteHashtable(counts);
+}
+
+//
+// set our terms from how we stored them in the help index, as a string of
+// "term count term count ..."
+void help_read_terms(HELP_DATA *data, const char *str) {
+  HASHTABLE *counts = newHashtable();
+  char         term[SMALL_BUFFER];
+  int count, used;
+  while(sscanf(str, "%32s %d%n", term, &count, &used) == 2) {
+    hashPut(counts, term, (void *)(long)count);
+    str += used;
+  }
+  help_set_terms(data, counts);
+  deleteHashtable(counts);
+}
+
+void help_index(HELP_DATA *data) {
+  int i;
+  if(data->indexed)
+    return;
+  for(i = 0; i < data->num_terms; i++) {
+    LIST *postings = hashGet(help_terms, data->terms[i].term);
+    if(postings == NULL) {
+      postings = newList();
+      hashPut(help_terms, data->terms[i].term, postings);
+    }
+    HELP_POSTING *posting = malloc(sizeof(HELP_POSTING));
+    posting->help  = data;
+    posting->count = data->terms[i].count;
+    listPut(postings, posting);
+  }
+  data->indexed = TRUE;
+  num_indexed_help++;
+}
+
+void help_unindex(HELP_DATA *data) {
+  int i;
+  if(!data->indexed)
+    return;
+  for(i = 0; i < data->num_terms; i++) {
+    LIST *postings = hashGet(help_terms, data->terms[i].term);
+    if(postings == NULL)
+      continue;
+    LIST_ITERATOR *post_i = newListIterator(postings);
+    HELP_POSTING *posting = NULL;
+    ITERATE_LIST(posting, post_i) {
+      if(posting->help == data) {
+	listRemove(postings, posting);
+	free(posting);
+	break;
+      }
+    } deleteListIterator(post_i);
+    if(listSize(postings) == 0)
+      deleteList(hashRemove(help_terms, data->terms[i].term));
+  }
+  data->indexed = FALSE;
+  num_indexed_help--;
+}
+
+//
+// helpfiles that match more of the search's terms come first, and then the
+// ones that match them better
+int help_search_cmp(HELP_DATA *one, HELP_DATA *two) {
+  if(one->matched != two->matched)
+    return (two->matched - one->matched);
+  if(one->score == two->score)
+    return strcasecmp(one->keywords, two->keywords);
+  return (two->score > one->score ? 1 : -1);
+}
+
+
+
 //*****************************************************************************
 // local functions
 //*****************************************************************************
@@ -117,17 +306,55 @@ LIST *get_all_help(void) {
 }
 
 //
-// returns where the help file would be stored on disc if it exists
-const char *get_help_file(const char *keyword) {
-  static BUFFER *buf = NULL;
-  char        subdir = 'Z';   // Z is the default subdir for non-alpha kwds
-  if(buf == NULL)
-    buf = newBuffer(1);
-  bufferClear(buf);
+// writes where the help file would be stored on disc if it exists into buf,
+// and returns buf
+char *get_help_file(char *buf, const char *keyword) {
+  char subdir = 'Z';   // Z is the default subdir for non-alpha kwds
   if(isalpha(*keyword))
     subdir = toupper(*keyword);
-  bprintf(buf, "%s/%c/%s", HELP_DIR, subdir, keyword);
-  return bufferString(buf);
+  sprintf(buf, "%s/%c/%s", HELP_DIR, subdir, keyword);
+  return buf;
+}
+
+//
+// put a helpfile in the help table under all of its keywords, and in the
+// term index. If it replaces any other helpfiles, and they have no keywords
+// left that bring them up, they are deleted
+void help_put(HELP_DATA *data) {
+  LIST           *kwds = parse_keywords(data->keywords);
+  LIST_ITERATOR *kwd_i = newListIterator(kwds);
+  LIST        *olds = newList();
+  char            *kwd = NULL;
+  HELP_DATA       *old = NULL;
+  ITERATE_LIST(kwd, kwd_i) {
+    // remove any old copy we might of had
+    if((old = nearMapRemove(help_table, kwd)) != NULL && old != data &&
+       !listIn(olds, old))
+      listPut(olds, old);
+    
+    // put our new entry
+    nearMapPut(help_table, kwd, NULL, data);
+  } deleteListIterator(kwd_i);
+  deleteListWith(kwds, free);
+
+  // get rid of anything we replaced all of
+  while((old = listPop(olds)) != NULL) {
+    bool in_use = FALSE;
+    kwds  = parse_keywords(old->keywords);
+    kwd_i = newListIterator(kwds);
+    ITERATE_LIST(kwd, kwd_i) {
+      if(nearMapGet(help_table, kwd, FALSE) == old) {
+	in_use = TRUE;
+	break;
+      }
+    } deleteListIterator(kwd_i);
+    deleteListWith(kwds, free);
+    if(!in_use)
+      deleteHelp(old);
+  }
+  deleteList(olds);
+
+  help_index(data);
 }
 
 
@@ -166,8 +393,8 @@ COMMAND(cmd_help) {
 
     // Body from the "help" helpfile (if present)
     HELP_DATA *index_help = get_help("help", TRUE);
-    if(index_help && *index_help->info) {
-      bprintf(buf, "%s\r\n", index_help->info);
+    if(index_help && *helpGetInfo(index_help)) {
+      bprintf(buf, "%s\r\n", helpGetInfo(index_help));
     }
 
     // Don't show command list for main help - just the organized categories
@@ -222,6 +449,31 @@ COMMAND(cmd_help) {
     deleteListWith(viewable, free);
   }
 
+  // are we searching through the text of our helpfiles?
+  else if(!strncasecmp(kwd, "search ", 7) && *(kwd + 7) != '\0') {
+    LIST       *matches = search_help(kwd + 7);
+    LIST_ITERATOR *mt_i = newListIterator(matches);
+    BUFFER         *buf = newBuffer(1);
+    int           count = 0;
+    ITERATE_LIST(data, mt_i) {
+      if(*data->user_groups && !bitIsOneSet(charGetUserGroups(ch), 
+					    data->user_groups))
+	continue;
+      if(count == 0) {
+	bprintf(buf, "{WHelpfiles matching '%s'{n\r\n", kwd + 7);
+	bufferCat(buf, "{c--------------------------------------------------------------------------{n\r\n");
+      }
+      bprintf(buf, "%2d) %s\r\n", ++count, data->keywords);
+    } deleteListIterator(mt_i);
+    deleteList(matches);
+
+    if(count == 0)
+      send_to_char(ch, "No helpfiles mention that.\r\n");
+    else if(charGetSocket(ch))
+      page_string(charGetSocket(ch), bufferString(buf));
+    deleteBuffer(buf);
+  }
+
   // do we have a match?
   else if( (data = get_help(kwd, TRUE)) == NULL) {
     // Check for special command listing keywords
@@ -339,7 +591,7 @@ BUFFER *build_help(const char *keyword) {
     center_string(header, data->keywords, 79, 128, TRUE);
 
     // build the header and the info
-    bprintf(buf, "%s{n%s", header, data->info);
+    bprintf(buf, "%s{n%s", header, helpGetInfo(data));
 
     // do we have a reference list?
     if(*data->related)
@@ -352,30 +604,22 @@ void add_help(const char *keywords, const char *info, const char *user_groups,
 	      const char *related, bool persistent) {
   // build our help data
   HELP_DATA *data = newHelp(keywords, info, user_groups, related);
-  
-  // add it to the help table for all of our keywords
-  LIST           *kwds = parse_keywords(keywords);
-  LIST_ITERATOR *kwd_i = newListIterator(kwds);
-  char            *kwd = NULL;
-  ITERATE_LIST(kwd, kwd_i) {
-    // remove any old copy we might of had
-    // HELP_DATA *old = nearMapRemove(help_table, kwd);
-    // if(old != NULL)
-    //   deleteHelp(old);
-    nearMapRemove(help_table, kwd);
-    
-    // put our new entry
-    nearMapPut(help_table, kwd, NULL, data);
-  } deleteListIterator(kwd_i);
+  LIST      *kwds = parse_keywords(keywords);
+  help_find_terms(data);
 
-  // is this meant to be persistent?
+  // is this meant to be persistent? Do it before we're put in the help table,
+  // in case we replace something and it gets deleted
   if(persistent && listSize(kwds) > 0) {
+    char fname[SMALL_BUFFER];
     STORAGE_SET *set = helpStore(data);
     char    *primary = listGet(kwds, 0); 
-    storage_write(set, get_help_file(primary));
+    storage_write(set, get_help_file(fname, primary));
     storage_close(set);
   }
 
+  // add it to the help table for all of our keywords
+  help_put(data);
+
   // garbage collection
   deleteListWith(kwds, free);
 }
@@ -392,7 +636,8 @@ bool reload_help(const char *keyword) {
     LIST_ITERATOR *kwd_i = newListIterator(kwds);
     char            *kwd = NULL;
     char        *primary = listGet(kwds, 0);
-    char        *filename = get_help_file(primary);
+    char filename[SMALL_BUFFER];
+    get_help_file(filename, primary);
 
     // make sure the file exists on disk
     if(!file_exists(filename)) {
@@ -434,6 +679,7 @@ void remove_help(const char *keyword) {
     LIST_ITERATOR *kwd_i = newListIterator(kwds);
     char            *kwd = NULL;
     char        *primary = listGet(kwds, 0);
+    char fname[SMALL_BUFFER];
 
     // remove all of our data from the help table
     ITERATE_LIST(kwd, kwd_i) {
@@ -441,8 +687,8 @@ void remove_help(const char *keyword) {
     } deleteListIterator(kwd_i);
 
     // delete our primary file
-    if(file_exists(get_help_file(primary)))
-      unlink(get_help_file(primary));
+    if(file_exists(get_help_file(fname, primary)))
+      unlink(fname);
 
     // garbage collection
     deleteListWith(kwds, free);
@@ -456,6 +702,58 @@ HELP_DATA *get_help(const char *keyword, bool abbrev_ok) {
   return nearMapGet(help_table, keyword, abbrev_ok);
 }
 
+LIST *search_help(const char *terms) {
+  static int search_stamp = 0;
+  HASHTABLE    *query = newHashtable();
+  LIST       *matches = newList();
+  HASH_ITERATOR *q_i = NULL;
+  const char   *term = NULL;
+  void        *count = NULL;
+  HELP_DATA    *data = NULL;
+  search_stamp++;
+
+  // score every helpfile that has one of our terms. Rarer terms count more,
+  // and so do terms that were asked for more than once
+  help_count_terms(query, terms, 1);
+  q_i = newHashIterator(query);
+  ITERATE_HASH(term, count, q_i) {
+    LIST *postings = hashGet(help_terms, term);
+    if(postings == NULL)
+      continue;
+    double              idf = log(1.0 + (double)num_indexed_help / 
+				  listSize(postings)) * (long)count;
+    LIST_ITERATOR   *post_i = newListIterator(postings);
+    HELP_POSTING   *posting = NULL;
+    ITERATE_LIST(posting, post_i) {
+      data = posting->help;
+      if(data->search_stamp != search_stamp) {
+	data->search_stamp = search_stamp;
+	data->matched      = 0;
+	data->score        = 0;
+	listPut(matches, data);
+      }
+      data->matched++;
+      data->score += (1.0 + log(posting->count)) * idf;
+    } deleteListIterator(post_i);
+  } deleteHashIterator(q_i);
+  deleteHashtable(query);
+
+  // keep only the best of them
+  listSortWith(matches, help_search_cmp);
+  if(listSize(matches) > HELP_SEARCH_MAX) {
+    LIST          *best = newList();
+    LIST_ITERATOR *mt_i = newListIterator(matches);
+    ITERATE_LIST(data, mt_i) {
+      if(listSize(best) == HELP_SEARCH_MAX)
+	break;
+      listQueue(best, data);
+    } deleteListIterator(mt_i);
+    deleteList(matches);
+    matches = best;
+  }
+  return matches;
+}
+
 const char *helpGetKeywords(HELP_DATA *data) {
   return data->keywords;
 }
@@ -469,6 +767,7 @@ const char *helpGetRelated(HELP_DATA *data) {
 }
 
 const char *helpGetInfo(HELP_DATA *data) {
+  help_load_info(data);
   return data->info;
 }
 
@@ -515,6 +814,28 @@ PyObject *PyMudSys_get_help(PyObject *self, PyObject *args) {
 			 helpGetRelated(help));
 }
 
+PyObject *PyMudSys_search_help(PyObject *self, PyObject *args) {
+  char *terms = NULL;
+
+  if(!PyArg_ParseTuple(args, "s", &terms)) {
+    PyErr_Format(PyExc_TypeError, "Invalid arguments supplied to search_help");
+    return NULL;
+  }
+
+  // find our matches, and return the keywords of each
+  LIST       *matches = search_help(terms);
+  LIST_ITERATOR *mt_i = newListIterator(matches);
+  PyObject *pymatches = PyList_New(0);
+  HELP_DATA     *data = NULL;
+  ITERATE_LIST(data, mt_i) {
+    PyObject *pykwds = PyUnicode_FromString(data->keywords);
+    PyList_Append(pymatches, pykwds);
+    Py_DECREF(pykwds);
+  } deleteListIterator(mt_i);
+  deleteList(matches);
+  return pymatches;
+}
+
 PyObject *PyMudSys_list_help(PyObject *self, PyObject *args) {
   char  *keyword = NULL;
 
@@ -546,13 +867,55 @@ PyObject *PyMudSys_list_help(PyObject *self, PyObject *args) {
 //*****************************************************************************
 
 //
-// reads in all of our helpfiles from disc
+// make the entry for a helpfile in the help index
+STORAGE_SET *help_index_entry(const char *file, long mtime, HELP_DATA *data) {
+  STORAGE_SET *set = new_storage_set();
+  BUFFER    *terms = newBuffer(1);
+  int            i = 0;
+  for(i = 0; i < data->num_terms; i++)
+    bprintf(terms, "%s%s %d", (i > 0 ? " " : ""), data->terms[i].term,
+	    data->terms[i].count);
+  store_string(set, "file",       file);
+  store_long  (set, "mtime",      mtime);
+  store_string(set, "keywords",   data->keywords);
+  store_string(set, "user_group", data->user_groups);
+  store_string(set, "related",    data->related);
+  store_string(set, "terms",      bufferString(terms));
+  deleteBuffer(terms);
+  return set;
+}
+
+//
+// reads in all of our helpfiles from disc. Helpfiles that haven't changed
+// since the help index was written are put in the help table from the
+// index, and their info is read the first time someone looks at them.
+// Everything else is read in whole, and the index is rewritten
 void read_help() {
   // directory info for reading in helpfiles
-  char fname[SMALL_BUFFER];
+  char fname[MAX_BUFFER];
+  char  file[SMALL_BUFFER];
   struct dirent *entry = NULL;
   DIR             *dir = NULL;
   char          subdir = '\0';
+  struct stat   st;
+
+  // read in our index, and map each of its entries to its file
+  HASHTABLE    *index = newHashtable();
+  STORAGE_SET *iset  = NULL;
+  STORAGE_SET *ientry = NULL;
+  int        num_old = 0;
+  int        num_new = 0;
+  int        changed = 0;
+  sprintf(fname, "%s/%s", HELP_DIR, HELP_INDEX_FILE);
+  if(file_exists(fname)) {
+    iset = storage_read(fname);
+    STORAGE_SET_LIST *list = read_list(iset, "helpfiles");
+    while( (ientry = storage_list_next(list)) != NULL) {
+      hashPut(index, read_string(ientry, "file"), ientry);
+      num_old++;
+    }
+  }
+  STORAGE_SET_LIST *new_index = new_storage_list();
   
   // read in all of our help files from disc
   for(subdir = 'A'; subdir <= 'Z'; subdir++) {
@@ -567,20 +930,50 @@ void read_help() {
       for(entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
 	if(*entry->d_name == '.')
 	  continue;
-	sprintf(fname, "%s/%c/%s", HELP_DIR, subdir, entry->d_name);
-	if(file_exists(fname)) {
+	snprintf(file, SMALL_BUFFER, "%c/%s", subdir, entry->d_name);
+	sprintf(fname, "%s/%s", HELP_DIR, file);
+	if(stat(fname, &st) != 0 || !S_ISREG(st.st_mode))
+	  continue;
+
+	HELP_DATA *data = NULL;
+	ientry = hashGet(index, file);
+	// we haven't changed since the index was written
+	if(ientry != NULL && read_long(ientry, "mtime") == (long)st.st_mtime) {
+	  data = newHelp(read_string(ientry, "keywords"), NULL,
+			 read_string(ientry, "user_group"),
+			 read_string(ientry, "related"));
+	  free(data->info);
+	  data->info = NULL;
+	  data->file = strdup(fname);
+	  help_read_terms(data, read_string(ientry, "terms"));
+	}
+	// we're new, or have been changed
+	else {
 	  STORAGE_SET *set = storage_read(fname);
-	  add_help(read_string(set, "keywords"),
-		   read_string(set, "info"),
-		   read_string(set, "user_group"),
-		   read_string(set, "related"),
-		   FALSE);
+	  data = helpRead(set);
 	  storage_close(set);
+	  help_find_terms(data);
+	  changed++;
 	}
+	storage_list_put(new_index, help_index_entry(file, st.st_mtime, data));
+	num_new++;
+	help_put(data);
       }
       closedir(dir);
     }
   }
+
+  // if anything was added, changed, or removed, write a new index
+  STORAGE_SET *new_iset = new_storage_set();
+  store_list(new_iset, "helpfiles", new_index);
+  if(changed > 0 || num_new != num_old) {
+    sprintf(fname, "%s/%s", HELP_DIR, HELP_INDEX_FILE);
+    storage_write(new_iset, fname);
+  }
+  storage_close(new_iset);
+  if(iset != NULL)
+    storage_close(iset);
+  deleteHashtable(index);
 }
 
 //
@@ -614,6 +1007,7 @@ void read_old_help() {
 void init_help() {
   // create our help table
   help_table = newNearMap();
+  help_terms = newHashtable();
 
   // read in all of our helpfiles. Old helpfiles are read, merged into the
   // new system, and then deleted from disc as part of the old system
@@ -634,6 +1028,10 @@ void init_help() {
     "get_help(keyword)\n\n"
     "Returns a tuple of a helpfile's keywords, info, user_groups, and related\n"
     "or None if the helpfile does not exist.");
+  PyMudSys_addMethod("search_help", PyMudSys_search_help, METH_VARARGS,
+    "search_help(terms)\n\n"
+    "Returns the keywords of the helpfiles whose text best matches the\n"
+    "search terms, best match first.");
   PyMudSys_addMethod("list_help", PyMudSys_list_help, METH_VARARGS,
     "list_help(keyword='')\n\n"
     "Returns a list of helpfiles that match the specified keyword. If no\n"
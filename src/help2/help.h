@@ -8,6 +8,12 @@
 // It allows for help files to exist both on disc, and to be built on the fly
 // by other game modules (but not saved to disc). 
 //
+// Every word in every helpfile is kept in an index, so helpfiles can be
+// searched by their contents. The keywords, groups, and words of helpfiles
+// on disc are also kept in a file, so that at boot, files that haven't
+// changed don't have to be read; their info is read the first time someone
+// looks at them.
+//
 //*****************************************************************************
 
 //
@@ -59,4 +65,11 @@ const char *helpGetUserGroups(HELP_DATA *data);
 const char    *helpGetRelated(HELP_DATA *data);
 const char       *helpGetInfo(HELP_DATA *data);
 
+//
+// returns a list of the helpfiles whose keywords and info best match the
+// words in terms, best match first. Words that show up in fewer helpfiles
+// count for more. User groups are not checked. The list must be deleted
+// after use, but not its contents
+LIST *search_help(const char *terms);
+
 #endif // HELP2_H
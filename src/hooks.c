@@ -25,7 +25,10 @@
 #include "exit.h"
 #include "account.h"
 #include "socket.h"
+#include "pulse.h"
 #include "hooks.h"
+#include "memstat.h"
+#include "scripts/sampler.h"
 
 
 
@@ -33,15 +36,563 @@
 // local functions, variables, and definitions
 //*****************************************************************************
 
-// the table of all our installed hooks
+// the table of all our installed hooks, by name, and by id
 HASHTABLE *hook_table   = NULL;
+struct hook_type **hook_types = NULL;
+int            num_hook_types = 0;
+int           hook_types_size = 0;
 
 // the list of functions called whenever a hook is run
 LIST *monitors = NULL;
+LIST *args_monitors = NULL;
 
 // a buffer for building hook info on
 BUFFER      *info_buf = NULL;
 
+// the types of arguments a hook can be run with
+#define HOOK_ARG_CH        0
+#define HOOK_ARG_OBJ       1
+#define HOOK_ARG_ROOM      2
+#define HOOK_ARG_EXIT      3
+#define HOOK_ARG_SOCK      4
+#define HOOK_ARG_STR       5
+#define HOOK_ARG_BYTES     6
+#define HOOK_ARG_INT       7
+#define HOOK_ARG_DBL       8
+
+typedef struct {
+  int type;
+  union {
+    void       *ptr;
+    const char *str;
+    int         num;
+    double      dbl;
+  } val;
+  int  len; // how long our bytes are
+} HOOK_ARG;
+
+struct hook_args {
+  const char *type; // the type of hook being run
+  int          num; // how many args we have
+  HOOK_ARG     arg[HOOK_MAX_ARGS];
+  bool      parsed; // have our args been filled in yet?
+  char       *info; // our info string, once it's been built
+  LIST       *strs; // strings we copied while parsing an info string
+};
+
+// the hook types that have runs batched up, waiting to be delivered
+LIST *batched_types = NULL;
+
+//
+// info strings are counted in memstat, so runs that pile up in batches (or
+// leak) show up there
+char *hook_strdup(const char *str) {
+  memNote(MEM_HOOK_STRING, 1, strlen(str) + 1);
+  return strdup(str);
+}
+
+void hook_strfree(char *str) {
+  memNote(MEM_HOOK_STRING, -1, -(long long)(strlen(str) + 1));
+  free(str);
+}
+
+// someone listening to a hook, and whether they want typed args or a string
+typedef struct {
+  void *func;
+  bool typed;
+} HOOK_LISTENER;
+
+//
+// a type of hook that can be run. Its listeners are kept in an array that is
+// rebuilt whenever one is added or removed. If the hook is running when that
+// happens, the run carries on with the old array, and the array is freed
+// when the hook is done running
+typedef struct hook_type {
+  char                *name;
+  int                    id;
+  HOOK_LISTENER  *listeners;
+  int         num_listeners;
+  int               running; // how many runs of the hook are going on
+  LIST               *stale; // old listener arrays that are still being run
+  int              watchers; // how many times args monitors asked about us
+  LIST     *batch_listeners; // listeners that get our runs all at once...
+  LIST               *batch; // and the info of the runs they're waiting on
+  long long            runs; // how many times we've been run, with listeners
+  long long           calls; // profiling: how many times we've been run...
+  long long      total_time; // how long we've taken in total, in usecs...
+  long long        max_time; // and the longest we've taken to run once
+} HOOK_TYPE;
+
+//
+// when profiling is on, we keep timings for every hook type, and every
+// listener of every hook type. Listeners are keyed by hook type and
+// listener name (an address for C functions, a qualname for Python ones)
+bool hook_profiling = FALSE;
+HASHTABLE *listener_stats = NULL;
+
+typedef struct {
+  char        *type;
+  char    *listener;
+  long long   calls;
+  long long   total;
+  long long     max;
+} HOOK_STAT;
+
+//
+// find the hook type with the given name, making it if it doesn't exist
+HOOK_TYPE *hook_type_get(const char *name) {
+  HOOK_TYPE *type = hashGet(hook_table, name);
+  if(type == NULL) {
+    type                = malloc(sizeof(HOOK_TYPE));
+    type->name          = strdup(name);
+    type->id            = num_hook_types;
+    type->listeners     = NULL;
+    type->num_listeners = 0;
+    type->running       = 0;
+    type->stale         = newList();
+    type->watchers      = 0;
+    type->batch_listeners = newList();
+    type->batch           = newList();
+    type->runs          = 0;
+    type->calls         = 0;
+    type->total_time    = 0;
+    type->max_time      = 0;
+    hashPut(hook_table, name, type);
+    if(num_hook_types >= hook_types_size) {
+      hook_types_size = MAX(hook_types_size * 2, 64);
+      hook_types      = realloc(hook_types, sizeof(HOOK_TYPE *)*hook_types_size);
+    }
+    hook_types[num_hook_types++] = type;
+  }
+  return type;
+}
+
+//
+// swap in a new listener array for the hook type
+void hook_type_set_listeners(HOOK_TYPE *type, HOOK_LISTENER *listeners, 
+			     int num) {
+  if(type->listeners != NULL) {
+    if(type->running > 0)
+      listPut(type->stale, type->listeners);
+    else
+      free(type->listeners);
+  }
+  type->listeners     = listeners;
+  type->num_listeners = num;
+}
+
+//
+// is the token of a hook format the given kind?
+bool hook_token_is(const char *token, int len, const char *kind) {
+  return (strlen(kind) == len && !strncasecmp(token, kind, len));
+}
+
+//
+// fill up our args from a hookBuildInfo format and its values
+void hook_args_build(HOOK_ARGS *args, const char *format, va_list *vargs) {
+  while(*format && args->num < HOOK_MAX_ARGS) {
+    while(isspace(*format))
+      format++;
+    if(!*format)
+      break;
+
+    const char *token = format;
+    while(*format && !isspace(*format))
+      format++;
+    int           len = format - token;
+    HOOK_ARG     *arg = &args->arg[args->num];
+
+    if(hook_token_is(token, len, "ch")) {
+      arg->type    = HOOK_ARG_CH;
+      arg->val.ptr = va_arg(*vargs, CHAR_DATA *);
+    }
+    else if(hook_token_is(token, len, "obj")) {
+      arg->type    = HOOK_ARG_OBJ;
+      arg->val.ptr = va_arg(*vargs, OBJ_DATA *);
+    }
+    else if(hook_token_is(token, len, "rm") || 
+	    hook_token_is(token, len, "room")) {
+      arg->type    = HOOK_ARG_ROOM;
+      arg->val.ptr = va_arg(*vargs, ROOM_DATA *);
+    }
+    else if(hook_token_is(token, len, "ex") || 
+	    hook_token_is(token, len, "exit")) {
+      arg->type    = HOOK_ARG_EXIT;
+      arg->val.ptr = va_arg(*vargs, EXIT_DATA *);
+    }
+    else if(hook_token_is(token, len, "sk") || 
+	    hook_token_is(token, len, "sock")) {
+      arg->type    = HOOK_ARG_SOCK;
+      arg->val.ptr = va_arg(*vargs, SOCKET_DATA *);
+    }
+    else if(hook_token_is(token, len, "str")) {
+      arg->type    = HOOK_ARG_STR;
+      arg->val.str = va_arg(*vargs, char *);
+    }
+    else if(hook_token_is(token, len, "bytes")) {
+      arg->type    = HOOK_ARG_BYTES;
+      arg->val.str = va_arg(*vargs, char *);
+      arg->len     = va_arg(*vargs, int);
+    }
+    else if(hook_token_is(token, len, "int")) {
+      arg->type    = HOOK_ARG_INT;
+      arg->val.num = va_arg(*vargs, int);
+    }
+    else if(hook_token_is(token, len, "dbl")) {
+      arg->type    = HOOK_ARG_DBL;
+      arg->val.dbl = va_arg(*vargs, double);
+    }
+    // unknown type -- abort!
+    else
+      break;
+    args->num++;
+  }
+  args->parsed = TRUE;
+}
+
+//
+// print our args out as an info string
+void hook_args_render(HOOK_ARGS *args, BUFFER *buf) {
+  int i, j;
+  for(i = 0; i < args->num; i++) {
+    HOOK_ARG *arg = &args->arg[i];
+    switch(arg->type) {
+    case HOOK_ARG_CH:
+      bprintf(buf, "ch.%d", charGetUID(arg->val.ptr));
+      break;
+    case HOOK_ARG_OBJ:
+      bprintf(buf, "obj.%d", objGetUID(arg->val.ptr));
+      break;
+    case HOOK_ARG_ROOM:
+      bprintf(buf, "rm.%d", roomGetUID(arg->val.ptr));
+      break;
+    case HOOK_ARG_EXIT:
+      bprintf(buf, "ex.%d", exitGetUID(arg->val.ptr));
+      break;
+    case HOOK_ARG_SOCK:
+      bprintf(buf, "sk.%d", socketGetUID(arg->val.ptr));
+      break;
+    case HOOK_ARG_STR:
+      bprintf(buf, "%c%s%c", HOOK_STR_MARKER, arg->val.str, HOOK_STR_MARKER);
+      break;
+    case HOOK_ARG_BYTES:
+      bprintf(buf, "bytes:");
+      for(j = 0; j < arg->len; j++)
+        bprintf(buf, "%02x", (unsigned char)arg->val.str[j]);
+      break;
+    case HOOK_ARG_INT:
+      bprintf(buf, "%d", arg->val.num);
+      break;
+    case HOOK_ARG_DBL:
+      bprintf(buf, "%lf", arg->val.dbl);
+      break;
+    }
+
+    // add a space for the next token to be printed
+    if(i < args->num - 1)
+      bprintf(buf, " ");
+  }
+}
+
+//
+// fill up our args from our info string. Strings we pull out are kept
+// until the hook is done running
+void hook_args_parse(HOOK_ARGS *args) {
+  ARENA_MARK        mark = arenaMark(scratch_arena());
+  LIST *tokens           = parse_hook_info_tokens(args->info);
+  LIST_ITERATOR *token_i = newListIterator(tokens);
+  char *token            = NULL;
+  int id = 0;
+
+  args->parsed = TRUE;
+  args->strs   = newList();
+  ITERATE_LIST(token, token_i) {
+    if(args->num >= HOOK_MAX_ARGS)
+      break;
+    HOOK_ARG *arg = &args->arg[args->num];
+    arg->len      = 0;
+
+    if(startswith(token, "ch")) {
+      sscanf(token, "ch.%d", &id);
+      arg->type    = HOOK_ARG_CH;
+      arg->val.ptr = propertyTableGet(mob_table, id);
+    }
+    else if(startswith(token, "obj")) {
+      sscanf(token, "obj.%d", &id);
+      arg->type    = HOOK_ARG_OBJ;
+      arg->val.ptr = propertyTableGet(obj_table, id);
+    }
+    else if(startswith(token, "rm") || startswith(token, "room")) {
+      sscanf(token + next_letter_in(token, '.') + 1, "%d", &id);
+      arg->type    = HOOK_ARG_ROOM;
+      arg->val.ptr = propertyTableGet(room_table, id);
+    }
+    else if(startswith(token, "ex")) {
+      sscanf(token + next_letter_in(token, '.') + 1, "%d", &id);
+      arg->type    = HOOK_ARG_EXIT;
+      arg->val.ptr = propertyTableGet(exit_table, id);
+    }
+    else if(startswith(token, "sk") || startswith(token, "sock")) {
+      sscanf(token + next_letter_in(token, '.') + 1, "%d", &id);
+      arg->type    = HOOK_ARG_SOCK;
+      arg->val.ptr = propertyTableGet(sock_table, id);
+    }
+    else if(startswith(token, "bytes:")) {
+      int   len = strlen(token + 6) / 2, i;
+      char *data = malloc(len + 1);
+      unsigned int byte_val = 0;
+      for(i = 0; i < len; i++) {
+	byte_val = 0;
+	sscanf(token + 6 + i*2, "%2x", &byte_val);
+	data[i] = (char)byte_val;
+      }
+      data[len]    = '\0';
+      arg->type    = HOOK_ARG_BYTES;
+      arg->val.str = data;
+      arg->len     = len;
+      listPut(args->strs, data);
+    }
+    else if(*token == HOOK_STR_MARKER) {
+      char *str = strdup(token + 1);
+      str[strlen(str)-1] = '\0';
+      arg->type    = HOOK_ARG_STR;
+      arg->val.str = str;
+      listPut(args->strs, str);
+    }
+    else if(isdigit(*token)) {
+      // integer or double?
+      if(next_letter_in(token, '.') > -1) {
+	arg->type    = HOOK_ARG_DBL;
+	arg->val.dbl = atof(token);
+      }
+      else {
+	arg->type    = HOOK_ARG_INT;
+	arg->val.num = atoi(token);
+      }
+    }
+    else
+      continue;
+    args->num++;
+  } deleteListIterator(token_i);
+  arenaRelease(scratch_arena(), mark);
+}
+
+//
+// run all of the listeners and monitors of a hook
+void hook_run(HOOK_TYPE *type, HOOK_ARGS *args) {
+  long long start = (hook_profiling ? pulse_clock() : 0);
+  samplerEnter("hook", type->name);
+  type->runs++;
+  if(type->num_listeners > 0) {
+    HOOK_LISTENER *listeners = type->listeners;
+    int        num_listeners = type->num_listeners;
+    int i;
+    type->running++;
+    for(i = 0; i < num_listeners; i++) {
+      long long lstart = (hook_profiling ? pulse_clock() : 0);
+      if(listeners[i].typed)
+	((void (*)(HOOK_ARGS *))listeners[i].func)(args);
+      else
+	((void (*)(const char *))listeners[i].func)(hookArgsInfo(args));
+      if(hook_profiling) {
+	char name[SMALL_BUFFER];
+	snprintf(name, sizeof(name), "%p", listeners[i].func);
+	hookProfileListener(type->name, name, pulse_clock() - lstart);
+      }
+    }
+    // if our listeners changed while we were running, we can now get rid of
+    // the old ones
+    if(--type->running == 0 && listSize(type->stale) > 0) {
+      void *old = NULL;
+      while((old = listPop(type->stale)) != NULL)
+	free(old);
+    }
+  }
+
+  // run our monitors
+  if(listSize(monitors) > 0) {
+    LIST_ITERATOR *mon_i = newListIterator(monitors);
+    void (* mon)(const char *, const char *) = NULL;
+    ITERATE_LIST(mon, mon_i) {
+      mon(args->type, hookArgsInfo(args));
+    } deleteListIterator(mon_i);
+  }
+  if(type->watchers > 0 && listSize(args_monitors) > 0) {
+    LIST_ITERATOR *mon_i = newListIterator(args_monitors);
+    void (* mon)(HOOK_ARGS *) = NULL;
+    ITERATE_LIST(mon, mon_i) {
+      mon(args);
+    } deleteListIterator(mon_i);
+  }
+
+  // save the run for our batch listeners
+  if(listSize(type->batch_listeners) > 0) {
+    if(listSize(type->batch) == 0)
+      listQueue(batched_types, type);
+    listQueue(type->batch, hook_strdup(hookArgsInfo(args)));
+  }
+  samplerLeave();
+
+  if(hook_profiling) {
+    long long usecs = pulse_clock() - start;
+    type->calls++;
+    type->total_time += usecs;
+    if(usecs > type->max_time)
+      type->max_time = usecs;
+  }
+
+  // clean up everything we made
+  if(args->info) hook_strfree(args->info);
+  if(args->strs) deleteListWith(args->strs, free);
+}
+
+void hook_args_init(HOOK_ARGS *args, const char *type, const char *info) {
+  args->type   = type;
+  args->num    = 0;
+  args->parsed = FALSE;
+  args->info   = (info ? hook_strdup(info) : NULL);
+  args->strs   = NULL;
+}
+
+//
+// add a listener to a hook
+void hook_listen(const char *name, void *func, bool typed) {
+  HOOK_TYPE           *type = hook_type_get(name);
+  HOOK_LISTENER *listeners = malloc(sizeof(HOOK_LISTENER) * 
+				    (type->num_listeners + 1));
+  if(type->num_listeners > 0)
+    memcpy(listeners, type->listeners, 
+	   sizeof(HOOK_LISTENER) * type->num_listeners);
+  listeners[type->num_listeners].func  = func;
+  listeners[type->num_listeners].typed = typed;
+  hook_type_set_listeners(type, listeners, type->num_listeners + 1);
+}
+
+//
+// stop a listener from listening to a hook
+void hook_unlisten(const char *name, void *func, bool typed) {
+  HOOK_TYPE *type = hashGet(hook_table, name);
+  int i, j;
+  if(type == NULL)
+    return;
+  for(i = 0; i < type->num_listeners; i++)
+    if(type->listeners[i].func == func && type->listeners[i].typed == typed)
+      break;
+  if(i == type->num_listeners)
+    return;
+
+  HOOK_LISTENER *listeners = NULL;
+  if(type->num_listeners > 1) {
+    listeners = malloc(sizeof(HOOK_LISTENER) * (type->num_listeners - 1));
+    for(j = 0; j < type->num_listeners; j++)
+      if(j != i)
+	listeners[(j < i ? j : j - 1)] = type->listeners[j];
+  }
+  hook_type_set_listeners(type, listeners, type->num_listeners - 1);
+}
+
+//
+// run a hook, unless there is no one to hear it
+#define HOOK_UNHEARD(type) \
+  ((type)->num_listeners == 0 && (type)->watchers == 0 && \
+   listSize((type)->batch_listeners) == 0 && listSize(monitors) == 0)
+
+
+
+//
+// sort hook stats by how much time they've taken, most first
+int hookstat_cmp(HOOK_STAT *a, HOOK_STAT *b) {
+  return (a->total < b->total ? 1 : (a->total > b->total ? -1 : 0));
+}
+
+void deleteHookStat(HOOK_STAT *stat) {
+  if(stat->type)     free(stat->type);
+  if(stat->listener) free(stat->listener);
+  free(stat);
+}
+
+//
+// print out stats for the hooks and listeners that have taken the most time
+void hookstat_show(BUFFER *buf, LIST *stats, const char *header, int max) {
+  LIST_ITERATOR *stat_i = newListIterator(stats);
+  HOOK_STAT       *stat = NULL;
+  int           count = 0;
+  listSortWith(stats, hookstat_cmp);
+  bprintf(buf, "{c%-40s %10s %12s %10s %10s{n\r\n", 
+	  header, "Calls", "Total usec", "Avg usec", "Max usec");
+  ITERATE_LIST(stat, stat_i) {
+    if(count++ >= max)
+      break;
+    if(stat->listener)
+      bprintf(buf, "%-20.20s %-19.19s", stat->type, stat->listener);
+    else
+      bprintf(buf, "%-40.40s", stat->type);
+    bprintf(buf, " %10lld %12lld %10lld %10lld\r\n", stat->calls, 
+	    stat->total, (stat->calls > 0 ? stat->total / stat->calls : 0),
+	    stat->max);
+  } deleteListIterator(stat_i);
+}
+
+//
+// copies the stats of a hook type into a HOOK_STAT
+HOOK_STAT *hook_type_stat(HOOK_TYPE *type) {
+  HOOK_STAT *stat = calloc(1, sizeof(HOOK_STAT));
+  stat->type      = strdup(type->name);
+  stat->calls     = type->calls;
+  stat->total     = type->total_time;
+  stat->max       = type->max_time;
+  return stat;
+}
+
+COMMAND(cmd_hookstat) {
+  if(!strcasecmp(arg, "on") || !strcasecmp(arg, "off")) {
+    hookSetProfiling(!strcasecmp(arg, "on"));
+    send_to_char(ch, "Hook profiling is now %s.\r\n", arg);
+    return;
+  }
+  else if(!strcasecmp(arg, "reset")) {
+    hookResetStats();
+    send_to_char(ch, "Hook statistics reset.\r\n");
+    return;
+  }
+  else if(*arg) {
+    send_to_char(ch, "Usage: hookstat [on | off | reset]\r\n");
+    return;
+  }
+
+  BUFFER        *buf = newBuffer(MAX_BUFFER);
+  LIST        *types = newList();
+  LIST    *listeners = newList();
+  HOOK_STAT    *stat = NULL;
+  const char    *key = NULL;
+  int i;
+  for(i = 0; i < num_hook_types; i++)
+    if(hook_types[i]->calls > 0)
+      listPut(types, hook_type_stat(hook_types[i]));
+  HASH_ITERATOR *stat_i = newHashIterator(listener_stats);
+  ITERATE_HASH(key, stat, stat_i) {
+    HOOK_STAT *copy = malloc(sizeof(HOOK_STAT));
+    *copy           = *stat;
+    copy->type      = strdup(stat->type);
+    copy->listener  = strdup(stat->listener);
+    listPut(listeners, copy);
+  } deleteHashIterator(stat_i);
+
+  bprintf(buf, "Hook profiling is %s.\r\n\r\n", 
+	  (hook_profiling ? "on" : "off"));
+  hookstat_show(buf, types, "Hook", 30);
+  bprintf(buf, "\r\n");
+  hookstat_show(buf, listeners, "Hook                 Listener", 30);
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
+  deleteListWith(types, deleteHookStat);
+  deleteListWith(listeners, deleteHookStat);
+}
+
 
 
 //*****************************************************************************
@@ -50,140 +601,318 @@ BUFFER      *info_buf = NULL;
 void init_hooks(void) {
   // make our required variables
   hook_table = newHashtable();
+  listener_stats = newHashtable();
+  batched_types  = newList();
   info_buf   = newBuffer(1);
   monitors   = newList();
+  args_monitors = newList();
 }
 
 void hookRemove(const char *type, void (* func)(const char *)) {
-  LIST *list = hashGet(hook_table, type);
-  if(list != NULL) listRemove(list, func);
+  hook_unlisten(type, func, FALSE);
 }
 
 void hookAdd(const char *type, void (* func)(const char *)) {
-  LIST *list = hashGet(hook_table, type);
-  if(list == NULL) {
-    list = newList();
-    hashPut(hook_table, type, list);
+  hook_listen(type, func, FALSE);
+}
+
+void hookRemoveArgs(const char *type, void (* func)(HOOK_ARGS *)) {
+  hook_unlisten(type, func, TRUE);
+}
+
+void hookAddArgs(const char *type, void (* func)(HOOK_ARGS *)) {
+  hook_listen(type, func, TRUE);
+}
+
+void hookAddBatch(const char *type, void (* func)(const char *, LIST *)) {
+  listQueue(hook_type_get(type)->batch_listeners, func);
+}
+
+void hookRemoveBatch(const char *type, void (* func)(const char *, LIST *)) {
+  HOOK_TYPE *htype = hashGet(hook_table, type);
+  if(htype != NULL)
+    listRemove(htype->batch_listeners, func);
+}
+
+void hookRunBatches(void) {
+  // anything that gets batched while we're delivering waits for next time
+  LIST      *types = batched_types;
+  HOOK_TYPE  *type = NULL;
+  batched_types    = newList();
+
+  while((type = listPop(types)) != NULL) {
+    LIST *batch = type->batch;
+    type->batch = newList();
+    LIST_ITERATOR *func_i = newListIterator(type->batch_listeners);
+    void (* func)(const char *, LIST *) = NULL;
+    ITERATE_LIST(func, func_i) {
+      func(type->name, batch);
+    } deleteListIterator(func_i);
+    deleteListWith(batch, hook_strfree);
   }
-  listQueue(list, func);
+  deleteList(types);
 }
 
 void hookAddMonitor(void (* func)(const char *, const char *)) {
   listQueue(monitors, func);
 }
 
-void hookRun(const char *type, const char *info) {
-  LIST *list = hashGet(hook_table, type);
-  char *info_dup = strdup(info);
-  if(list != NULL) {
-    LIST_ITERATOR *list_i = newListIterator(list);
-    void (* func)(const char *) = NULL;
-    ITERATE_LIST(func, list_i) {
-      func(info_dup);
-    } deleteListIterator(list_i);
+void hookAddArgsMonitor(void (* func)(HOOK_ARGS *)) {
+  listQueue(args_monitors, func);
+}
+
+LIST *hookGetTypes(void) {
+  return hashCollect(hook_table);
+}
+
+void init_hook_stats(void) {
+  add_cmd("hookstat", NULL, cmd_hookstat, "admin", FALSE);
+}
+
+void hookSetProfiling(bool on) {
+  hook_profiling = on;
+}
+
+bool hookGetProfiling(void) {
+  return hook_profiling;
+}
+
+void hookProfileListener(const char *type, const char *listener, 
+			 long long usecs) {
+  char key[MAX_BUFFER];
+  snprintf(key, sizeof(key), "%s %s", type, listener);
+  HOOK_STAT *stat = hashGet(listener_stats, key);
+  if(stat == NULL) {
+    stat           = calloc(1, sizeof(HOOK_STAT));
+    stat->type     = strdup(type);
+    stat->listener = strdup(listener);
+    hashPut(listener_stats, key, stat);
   }
+  stat->calls++;
+  stat->total += usecs;
+  if(usecs > stat->max)
+    stat->max = usecs;
+}
 
-  // run our monitors
-  LIST_ITERATOR *mon_i = newListIterator(monitors);
-  void (* mon)(const char *, const char *) = NULL;
-  ITERATE_LIST(mon, mon_i) {
-    mon(type, info_dup);
-  } deleteListIterator(mon_i);
-  free(info_dup);
+void hookResetStats(void) {
+  int i;
+  for(i = 0; i < num_hook_types; i++) {
+    hook_types[i]->calls      = 0;
+    hook_types[i]->total_time = 0;
+    hook_types[i]->max_time   = 0;
+  }
+  hashClearWith(listener_stats, deleteHookStat);
 }
 
-const char *hookBuildInfo(const char *format, ...) {
-  // clear our workspace
-  bufferClear(info_buf);
+void hookForeachStat(void (* func)(const char *type, const char *listener,
+				   long long calls, long long total,
+				   long long max, void *data),
+		     void *data) {
+  HASH_ITERATOR *stat_i = NULL;
+  HOOK_STAT       *stat = NULL;
+  const char       *key = NULL;
+  int i;
+  for(i = 0; i < num_hook_types; i++)
+    if(hook_types[i]->calls > 0)
+      func(hook_types[i]->name, NULL, hook_types[i]->calls, 
+	   hook_types[i]->total_time, hook_types[i]->max_time, data);
+  stat_i = newHashIterator(listener_stats);
+  ITERATE_HASH(key, stat, stat_i) {
+    func(stat->type, stat->listener, stat->calls, stat->total, stat->max, data);
+  } deleteHashIterator(stat_i);
+}
 
-  // parse out all of our tokens
-  LIST *tokens           = parse_strings(format, ' ');
-  LIST_ITERATOR *token_i = newListIterator(tokens);
-  char *token            = NULL;
-  int   len              = listSize(tokens);
-  int   count            = 0;
+void hookForeachRun(void (* func)(const char *type, long long runs,
+				  void *data),
+		    void *data) {
+  int i;
+  for(i = 0; i < num_hook_types; i++)
+    if(hook_types[i]->runs > 0)
+      func(hook_types[i]->name, hook_types[i]->runs, data);
+}
 
-  // go through all of our tokens
+int hookRegister(const char *type) {
+  return hook_type_get(type)->id;
+}
+
+bool hookHasListeners(const char *type) {
+  HOOK_TYPE *htype = hashGet(hook_table, type);
+  return (htype ? !HOOK_UNHEARD(htype) : listSize(monitors) > 0);
+}
+
+bool hookHasListenersId(int id) {
+  return !HOOK_UNHEARD(hook_types[id]);
+}
+
+bool hookHasOnlyListenerId(int id, void *func) {
+  HOOK_TYPE *type = hook_types[id];
+  return (type->num_listeners == 1 && type->listeners[0].func == func &&
+	  type->watchers == 0 && listSize(type->batch_listeners) == 0 &&
+	  listSize(monitors) == 0);
+}
+
+void hookWatch(const char *type) {
+  hook_type_get(type)->watchers++;
+}
+
+void hookUnwatch(const char *type) {
+  HOOK_TYPE *htype = hashGet(hook_table, type);
+  if(htype != NULL && htype->watchers > 0)
+    htype->watchers--;
+}
+
+void hookRunId(int id, const char *info) {
+  HOOK_TYPE *type = hook_types[id];
+  if(HOOK_UNHEARD(type))
+    return;
+  HOOK_ARGS args;
+  hook_args_init(&args, type->name, info);
+  hook_run(type, &args);
+}
+
+void hookRunArgsId(int id, const char *format, ...) {
+  HOOK_TYPE *type = hook_types[id];
+  if(HOOK_UNHEARD(type))
+    return;
+  HOOK_ARGS args;
   va_list vargs;
+  hook_args_init(&args, type->name, NULL);
   va_start(vargs, format);
-  ITERATE_LIST(token, token_i) {
-    if(!strcasecmp(token, "ch"))
-      bprintf(info_buf, "ch.%d", charGetUID(va_arg(vargs, CHAR_DATA *)));
-    else if(!strcasecmp(token, "obj"))
-      bprintf(info_buf, "obj.%d", objGetUID(va_arg(vargs, OBJ_DATA *)));
-    else if(!strcasecmp(token, "rm") || !strcasecmp(token, "room"))
-      bprintf(info_buf, "rm.%d", roomGetUID(va_arg(vargs, ROOM_DATA *)));
-    else if(!strcasecmp(token, "ex") || !strcasecmp(token, "exit"))
-      bprintf(info_buf, "ex.%d", exitGetUID(va_arg(vargs, EXIT_DATA *)));
-    else if(!strcasecmp(token, "sk") || !strcasecmp(token, "sock"))
-      bprintf(info_buf, "sk.%d", socketGetUID(va_arg(vargs, SOCKET_DATA *)));
-    else if(!strcasecmp(token, "str"))
-      bprintf(info_buf, "%c%s%c", HOOK_STR_MARKER, va_arg(vargs, char *), HOOK_STR_MARKER);
-    else if(!strcasecmp(token, "bytes")) {
-      char *data = va_arg(vargs, char *);
-      int len = va_arg(vargs, int);
-      bprintf(info_buf, "bytes:");
-      for(int i = 0; i < len; i++)
-        bprintf(info_buf, "%02x", (unsigned char)data[i]);
-    }
-    else if(!strcasecmp(token, "int"))
-      bprintf(info_buf, "%d", va_arg(vargs, int));
-    else if(!strcasecmp(token, "dbl"))
-      bprintf(info_buf, "%lf", va_arg(vargs, double));
-    // unknown type -- abort!
-    else
+  hook_args_build(&args, format, &vargs);
+  va_end(vargs);
+  hook_run(type, &args);
+}
+
+void hookRun(const char *type, const char *info) {
+  hookRunId(hookRegister(type), info);
+}
+
+void hookRunArgs(const char *name, const char *format, ...) {
+  HOOK_TYPE *type = hook_type_get(name);
+  if(HOOK_UNHEARD(type))
+    return;
+  HOOK_ARGS args;
+  va_list vargs;
+  hook_args_init(&args, type->name, NULL);
+  va_start(vargs, format);
+  hook_args_build(&args, format, &vargs);
+  va_end(vargs);
+  hook_run(type, &args);
+}
+
+const char *hookArgsType(HOOK_ARGS *args) {
+  return args->type;
+}
+
+const char *hookArgsInfo(HOOK_ARGS *args) {
+  if(args->info == NULL) {
+    BUFFER *buf = newBuffer(1);
+    hook_args_render(args, buf);
+    args->info  = hook_strdup(bufferString(buf));
+    deleteBuffer(buf);
+  }
+  return args->info;
+}
+
+void hookParseArgs(HOOK_ARGS *args, ...) {
+  int i;
+  va_list vargs;
+  if(!args->parsed)
+    hook_args_parse(args);
+
+  va_start(vargs, args);
+  for(i = 0; i < args->num; i++) {
+    HOOK_ARG *arg = &args->arg[i];
+    switch(arg->type) {
+    case HOOK_ARG_CH:
+      *va_arg(vargs, CHAR_DATA **)   = arg->val.ptr;
+      break;
+    case HOOK_ARG_OBJ:
+      *va_arg(vargs, OBJ_DATA **)    = arg->val.ptr;
+      break;
+    case HOOK_ARG_ROOM:
+      *va_arg(vargs, ROOM_DATA **)   = arg->val.ptr;
+      break;
+    case HOOK_ARG_EXIT:
+      *va_arg(vargs, EXIT_DATA **)   = arg->val.ptr;
       break;
+    case HOOK_ARG_SOCK:
+      *va_arg(vargs, SOCKET_DATA **) = arg->val.ptr;
+      break;
+    case HOOK_ARG_STR:
+      *va_arg(vargs, const char **)  = arg->val.str;
+      break;
+    case HOOK_ARG_BYTES:
+      *va_arg(vargs, const char **)  = arg->val.str;
+      *va_arg(vargs, int *)          = arg->len;
+      break;
+    case HOOK_ARG_INT:
+      *va_arg(vargs, int *)          = arg->val.num;
+      break;
+    case HOOK_ARG_DBL:
+      *va_arg(vargs, double *)       = arg->val.dbl;
+      break;
+    }
+  }
+  va_end(vargs);
+}
 
-    // add a space for the next token to be printed
-    if(count < len - 1)
-      bprintf(info_buf, " ");
-    count++;
-  } deleteListIterator(token_i);
-  deleteListWith(tokens, free);
+const char *hookBuildInfo(const char *format, ...) {
+  HOOK_ARGS args;
+  va_list vargs;
+  hook_args_init(&args, NULL, NULL);
+  va_start(vargs, format);
+  hook_args_build(&args, format, &vargs);
   va_end(vargs);
+
+  // clear our workspace, and print out our args
+  bufferClear(info_buf);
+  hook_args_render(&args, info_buf);
   return bufferString(info_buf);
 }
 
 //
-// parses up info tokens
+// parses up info tokens. The tokens and their list live in the scratch arena
 LIST *parse_hook_info_tokens(const char *info) {
-  LIST *tokens = newList();
-  BUFFER  *buf = newBuffer(1);
+  LIST *tokens = newListArena(scratch_arena());
   while(*info) {
     // skip leading spaces
     while(isspace(*info))
       info++;
 
-    char marker = ' ';
-    bufferClear(buf);
-    
-    // are we parsing a string or something else?
+    // are we parsing a string or something else? Strings keep their markers
+    const char *start = info;
+    char       marker = ' ';
     if(*info == HOOK_STR_MARKER) {
       marker = HOOK_STR_MARKER;
-      bprintf(buf, "%c", HOOK_STR_MARKER);
       info++;
     }
 
     // fill up to the end marker
     for(;*info && *info != marker; info++)
-      bprintf(buf, "%c", *info);
+      ;
 
-    // were we parsing a string?
-    if(marker == HOOK_STR_MARKER)
-      bprintf(buf, "%c", HOOK_STR_MARKER);
+    // append our token
+    if(marker == HOOK_STR_MARKER) {
+      int  len = info - start;
+      char *tok = arenaAlloc(scratch_arena(), len + 2);
+      memcpy(tok, start, len);
+      tok[len]     = HOOK_STR_MARKER;
+      tok[len + 1] = '\0';
+      listQueue(tokens, tok);
+    }
+    else
+      listQueue(tokens, arenaStrndup(scratch_arena(), start, info - start));
 
     // skip past our marker
     if(*info) info++;
-    
-    // append our token
-    listQueue(tokens, strdup(bufferString(buf)));
   }
-  deleteBuffer(buf);
   return tokens;
 }
 
 void hookParseInfo(const char *info, ...) {
   // parse out all of our tokens
+  ARENA_MARK        mark = arenaMark(scratch_arena());
   LIST *tokens           = parse_hook_info_tokens(info);
   LIST_ITERATOR *token_i = newListIterator(tokens);
   char *token            = NULL;
@@ -240,6 +969,6 @@ void hookParseInfo(const char *info, ...) {
 	*va_arg(vargs, int *) = atoi(token);
     }
   } deleteListIterator(token_i);
-  deleteListWith(tokens, free);
+  arenaRelease(scratch_arena(), mark);
   va_end(vargs);
 }
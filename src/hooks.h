@@ -27,6 +27,18 @@
 // strings with escape sequences, this could be deadly.
 #define HOOK_STR_MARKER '\032'
 
+//
+// the most arguments a hook can be run with
+#define HOOK_MAX_ARGS    12
+
+//
+// the arguments a hook was run with. Hooks run with hookRunArgs hand their
+// arguments to typed listeners (see hookAddArgs) as-is; the info string
+// older listeners, monitors, and Python expect is only built if one of them
+// actually asks for it. Hooks run with hookRun have their info string parsed
+// into arguments if a typed listener asks for them
+typedef struct hook_args HOOK_ARGS;
+
 //
 // prepare hooks for use
 void init_hooks(void);
@@ -37,6 +49,122 @@ void hookAddMonitor(void (* func)(const char *, const char *));
 void hookRemove(const char *type, void (* func)(const char *));
 void hookParseInfo(const char *info, ...);
 const char *hookBuildInfo(const char *format, ...);
+
+//
+// splits hook info up into its tokens. The list and its tokens are
+// allocated from the scratch arena; take an arenaMark before calling this,
+// and release it when you are done with the tokens
 LIST *parse_hook_info_tokens(const char *info);
 
+//
+// batch listeners don't hear about a hook when it is run. Instead, the info
+// of each run is saved up, and delivered all at once as a list at the end of
+// the pulse, by hookRunBatches. This is good for listeners of hooks run in
+// bulk (e.g. obj_to_game during zone resets) that don't need to hear about
+// them right away. Things in the info strings may be gone by the time the
+// batch is delivered, and parse out as NULL. func is given the type of hook
+// and the list of info strings, which it must not change
+void hookAddBatch(const char *type, void (* func)(const char *, LIST *));
+void hookRemoveBatch(const char *type, void (* func)(const char *, LIST *));
+void hookRunBatches(void);
+
+//
+// get the id of a type of hook, registering the type if it doesn't exist
+// yet. Hooks that are run often should be registered once, and then run by
+// their id; it saves looking the type up by name every time it is run
+int hookRegister(const char *type);
+
+//
+// same as hookRun and hookRunArgs, but take an id from hookRegister
+void hookRunId(int id, const char *info);
+void hookRunArgsId(int id, const char *format, ...);
+
+//
+// run a hook with typed arguments. format is the same as for hookBuildInfo,
+// e.g. hookRunArgs("flush", "sk", sock)
+void hookRunArgs(const char *type, const char *format, ...);
+
+//
+// add or remove a listener that is handed the hook's arguments directly,
+// instead of an info string
+void hookAddArgs(const char *type, void (* func)(HOOK_ARGS *));
+void hookRemoveArgs(const char *type, void (* func)(HOOK_ARGS *));
+
+//
+// add a monitor that is handed the arguments of hooks that are run, after all
+// of the hook's listeners have been run. Monitors added this way only hear
+// about hooks that are being watched (see hookWatch)
+void hookAddArgsMonitor(void (* func)(HOOK_ARGS *));
+
+//
+// let monitors added with hookAddArgsMonitor hear about a type of hook. Each
+// call to hookWatch needs to be matched by a call to hookUnwatch when the
+// monitor no longer cares about the hook
+void hookWatch(const char *type);
+void hookUnwatch(const char *type);
+
+//
+// returns TRUE if anything will hear a type of hook being run: listeners,
+// monitors added with hookAddMonitor, or monitors watching the hook. Hooks
+// with no one listening cost nothing to run, but the arguments handed to
+// hookRun are still built; check this first if they are expensive to make
+bool hookHasListeners(const char *type);
+bool hookHasListenersId(int id);
+
+//
+// returns TRUE if func is the only thing that will hear a type of hook; it
+// is its one listener, and no monitors are listening in
+bool hookHasOnlyListenerId(int id, void *func);
+
+//
+// returns a list of the names of every type of hook that has been registered
+// or listened for. Must be deleted after use. Try: deleteListWith(list, free)
+LIST *hookGetTypes(void);
+
+//
+// pull out the arguments of a hook, the same way hookParseInfo would. Unlike
+// hookParseInfo, strings are NOT copied, and must not be freed. bytes need
+// a char ** and an int * for their length
+void hookParseArgs(HOOK_ARGS *args, ...);
+
+//
+// the type of hook the arguments are for, and the arguments as an info
+// string. The string is built the first time it is asked for, and lasts as
+// long as the hook is running
+const char *hookArgsType(HOOK_ARGS *args);
+const char *hookArgsInfo(HOOK_ARGS *args);
+
+//
+// hook profiling. When it is on, we keep call counts and timings for every
+// type of hook, and every listener of every type (C listeners by address,
+// Python ones by their qualname). Admins can see them with the hookstat
+// command. When profiling is off, it costs nothing more than a check
+void init_hook_stats(void);
+void hookSetProfiling(bool on);
+bool hookGetProfiling(void);
+void hookResetStats(void);
+
+//
+// record a run of a listener that hooks.c doesn't run itself (e.g. Python
+// hooks, which are run by a monitor). usecs is how long it took
+void hookProfileListener(const char *type, const char *listener,
+			 long long usecs);
+
+//
+// call func for the stats of every hook type and listener that has been run
+// while profiling. listener is NULL for the stats of a whole hook type.
+// Times are in microseconds
+void hookForeachStat(void (* func)(const char *type, const char *listener,
+				   long long calls, long long total,
+				   long long max, void *data),
+		     void *data);
+
+//
+// call func with how many times every hook type has been run with someone
+// listening to it, since the mud booted. These are counted whether or not
+// profiling is on
+void hookForeachRun(void (* func)(const char *type, long long runs,
+				  void *data),
+		    void *data);
+
 #endif // HOOKS_H
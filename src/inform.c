@@ -23,6 +23,7 @@
 #include "log.h"
 #include "inform.h"
 #include "hooks.h"
+#include "scripts/scripts.h"
 
 
 
@@ -34,6 +35,165 @@
 
 
 
+//*****************************************************************************
+// broadcast channels
+//*****************************************************************************
+
+//
+// the characters that often get sent a message all at once are kept in sets,
+// so the message only goes to them instead of being checked against everyone
+// in the game: everyone who is outdoors, everyone in each zone (keyed by the
+// zone's key), and everyone who has joined one of our named channels
+SET       *outdoor_chars = NULL;
+HASHTABLE    *zone_chars = NULL; // zone key     -> SET of characters
+HASHTABLE      *channels = NULL; // channel name -> SET of characters
+
+//
+// the last messages sent over a channel. They are kept in a ring, so adding
+// one past the last slot overwrites the oldest
+typedef struct {
+  char **mssgs;
+  int     size; // how many messages it holds at most
+  int    start; // the slot the oldest message is in
+  int      num; // how many messages it holds now
+} CHANNEL_LOG;
+
+HASHTABLE *channel_groups = NULL; // channel name -> user group kept on it
+HASHTABLE   *channel_logs = NULL; // channel name -> CHANNEL_LOG
+
+bool room_is_outdoors(ROOM_DATA *room) {
+  return (roomGetTerrain(room) != TERRAIN_INDOORS &&
+	  roomGetTerrain(room) != TERRAIN_CAVERN);
+}
+
+//
+// put a character in, or take them out of, a set kept in a table. Sets are
+// made as they are needed, and thrown out once they are empty
+void channel_set_put(HASHTABLE *table, const char *key, CHAR_DATA *ch) {
+  SET *set = hashGet(table, key);
+  if(set == NULL) {
+    set = newSet();
+    hashPut(table, key, set);
+  }
+  setPut(set, ch);
+}
+
+void channel_set_remove(HASHTABLE *table, const char *key, CHAR_DATA *ch) {
+  SET *set = hashGet(table, key);
+  if(set != NULL) {
+    setRemove(set, ch);
+    if(setSize(set) == 0)
+      deleteSet(hashRemove(table, key));
+  }
+}
+
+//
+// a character arrived in, or left, a room. Update who's outdoors and where
+void channel_enter_room(CHAR_DATA *ch, ROOM_DATA *room) {
+  channel_set_put(zone_chars, get_key_locale(roomGetClass(room)), ch);
+  if(room_is_outdoors(room))
+    setPut(outdoor_chars, ch);
+  else
+    setRemove(outdoor_chars, ch);
+}
+
+void channel_leave_room(CHAR_DATA *ch, ROOM_DATA *room) {
+  channel_set_remove(zone_chars, get_key_locale(roomGetClass(room)), ch);
+  setRemove(outdoor_chars, ch);
+}
+
+void channel_to_room_hook(HOOK_ARGS *args) {
+  CHAR_DATA   *ch = NULL;
+  ROOM_DATA *room = NULL;
+  hookParseArgs(args, &ch, &room);
+  channel_enter_room(ch, room);
+}
+
+void channel_from_room_hook(HOOK_ARGS *args) {
+  CHAR_DATA   *ch = NULL;
+  ROOM_DATA *room = NULL;
+  hookParseArgs(args, &ch, &room);
+  channel_leave_room(ch, room);
+}
+
+//
+// put a character on each channel that is kept for one of their user groups,
+// and take them off of the ones kept for groups they aren't in
+void channel_sync_groups(CHAR_DATA *ch) {
+  LOCAL_HASH_ITERATOR(grp_i, channel_groups);
+  const char *channel = NULL;
+  const char   *group = NULL;
+  ITERATE_HASH(channel, group, grp_i) {
+    if(bitIsSet(charGetUserGroups(ch), group))
+      channel_set_put(channels, channel, ch);
+    else
+      channel_set_remove(channels, channel, ch);
+  } hashIteratorFinish(grp_i);
+}
+
+//
+// characters read in along with their room (e.g. after a copyover) are put
+// there without char_to_room, so we catch them as they enter the game
+void channel_to_game_hook(HOOK_ARGS *args) {
+  CHAR_DATA *ch = NULL;
+  hookParseArgs(args, &ch);
+  if(charGetRoom(ch) != NULL)
+    channel_enter_room(ch, charGetRoom(ch));
+  channel_sync_groups(ch);
+}
+
+//
+// someone was put in or taken out of user groups. Characters that aren't in
+// the game yet are synced as they enter it
+void channel_user_groups_hook(HOOK_ARGS *args) {
+  CHAR_DATA *ch = NULL;
+  hookParseArgs(args, &ch);
+  if(listIn(mobile_list, ch))
+    channel_sync_groups(ch);
+}
+
+void channel_from_game_hook(HOOK_ARGS *args) {
+  CHAR_DATA *ch = NULL;
+  hookParseArgs(args, &ch);
+  if(charGetRoom(ch) != NULL)
+    channel_leave_room(ch, charGetRoom(ch));
+
+  // and leave every channel we've joined
+  LIST     *names = hashCollect(channels);
+  char      *name = NULL;
+  while((name = listPop(names)) != NULL) {
+    channel_set_remove(channels, name, ch);
+    free(name);
+  }
+  deleteList(names);
+}
+
+//
+// a room became indoors or outdoors with people in it
+void channel_terrain_hook(HOOK_ARGS *args) {
+  ROOM_DATA *room = NULL;
+  hookParseArgs(args, &room);
+  LOCAL_LIST_ITERATOR(ch_i, roomGetCharacters(room));
+  CHAR_DATA       *ch = NULL;
+  ITERATE_LIST(ch, ch_i) {
+    channel_enter_room(ch, room);
+  } listIteratorFinish(ch_i);
+}
+
+//
+// send text to everyone in a set of characters
+void send_to_set(SET *set, const char *txt) {
+  if(set == NULL)
+    return;
+  LOCAL_SET_ITERATOR(ch_i, set);
+  CHAR_DATA       *ch = NULL;
+  ITERATE_SET(ch, ch_i) {
+    text_to_char(ch, txt);
+  } setIteratorFinish(ch_i);
+}
+
+
+
 //*****************************************************************************
 // local functions
 //*****************************************************************************
@@ -64,12 +224,12 @@ void list_one_furniture(CHAR_DATA *ch, OBJ_DATA *furniture) {
 //
 void list_used_furniture(CHAR_DATA *ch, LIST *furniture) {
   OBJ_DATA *obj;
-  LIST_ITERATOR *obj_i = newListIterator(furniture);
+  LOCAL_LIST_ITERATOR(obj_i, furniture);
 
   ITERATE_LIST(obj, obj_i)
     // hmmm... how should we handle invisible furniture?
     list_one_furniture(ch, obj);
-  deleteListIterator(obj_i);
+  listIteratorFinish(obj_i);
 }
 
 
@@ -80,7 +240,7 @@ void list_used_furniture(CHAR_DATA *ch, LIST *furniture) {
 LIST *get_nofurniture_chars(CHAR_DATA *ch, LIST *list, 
 			    bool invis_ok, bool include_self) {
   LIST *newlist = newList();
-  LIST_ITERATOR *char_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(char_i, list);
   CHAR_DATA *i = NULL;
 
   ITERATE_LIST(i, char_i) {
@@ -94,7 +254,7 @@ LIST *get_nofurniture_chars(CHAR_DATA *ch, LIST *list,
       continue;
     listPut(newlist, i);
   };
-  deleteListIterator(char_i);
+  listIteratorFinish(char_i);
   return newlist;
 }
 
@@ -124,6 +284,139 @@ void list_room_contents(CHAR_DATA *ch, ROOM_DATA *room) {
 
 
 
+//
+// things made from the same prototypes mostly keep the description they were
+// made with, so reset-spawned NPCs and objects look the same as all the others
+// of their kind. If their descriptions are static, what they look like after
+// being tagged and formatted is kept by the prototypes they're made from, and
+// checked against their own description and extra descriptions before being
+// used. Colour is put in when it's sent, so one entry does for every viewer
+#define PROTO_DESC_CACHE_SIZE  1024
+
+typedef struct {
+  char          *protos; // the prototypes we're for
+  char             *raw; // the description we were made from
+  char      *edesc_keys; // the keywords we were tagged with, one per line
+  int  settings_version; // for the screen width and indent we were formatted
+  char       *formatted; //   with, and what we look like after all that
+} PROTO_DESC_ENTRY;
+
+PROTO_DESC_ENTRY char_desc_cache[PROTO_DESC_CACHE_SIZE];
+PROTO_DESC_ENTRY  obj_desc_cache[PROTO_DESC_CACHE_SIZE];
+
+// the hooks that build char and obj descriptions
+int preprocess_char_desc_hook = -1;
+int append_char_desc_hook     = -1;
+int preprocess_obj_desc_hook  = -1;
+int append_obj_desc_hook      = -1;
+
+void proto_desc_hooks_register(void) {
+  if(preprocess_char_desc_hook == -1) {
+    preprocess_char_desc_hook = hookRegister("preprocess_char_desc");
+    append_char_desc_hook     = hookRegister("append_char_desc");
+    preprocess_obj_desc_hook  = hookRegister("preprocess_obj_desc");
+    append_obj_desc_hook      = hookRegister("append_obj_desc");
+  }
+}
+
+//
+// are the edescs' keywords the ones an entry was tagged with?
+bool edesc_keys_match(EDESC_SET *edescs, const char *keys) {
+  if(edescSetGetList(edescs) == NULL)
+    return !*keys;
+  LIST_ITERATOR *edesc_i = newListIterator(edescSetGetList(edescs));
+  EDESC_DATA      *edesc = NULL;
+  bool           match = TRUE;
+  ITERATE_LIST(edesc, edesc_i) {
+    const char *kw = edescGetKeywords(edesc);
+    int        len = strlen(kw);
+    if(strncmp(keys, kw, len) || keys[len] != '\n') {
+      match = FALSE;
+      break;
+    }
+    keys += len + 1;
+  } deleteListIterator(edesc_i);
+  return (match && !*keys);
+}
+
+char *edesc_keys_join(EDESC_SET *edescs) {
+  if(edescSetGetList(edescs) == NULL)
+    return strdup("");
+  BUFFER          *buf = newBuffer(1);
+  LIST_ITERATOR *edesc_i = newListIterator(edescSetGetList(edescs));
+  EDESC_DATA      *edesc = NULL;
+  ITERATE_LIST(edesc, edesc_i) {
+    bufferCat(buf, edescGetKeywords(edesc));
+    bufferCat(buf, "\n");
+  } deleteListIterator(edesc_i);
+  char *keys = strdup(bufferString(buf));
+  deleteBuffer(buf);
+  return keys;
+}
+
+PROTO_DESC_ENTRY *proto_desc_entry(PROTO_DESC_ENTRY *cache,const char *protos){
+  return &cache[string_hash(protos) % PROTO_DESC_CACHE_SIZE];
+}
+
+//
+// returns the cache entry for things made from protos, if it's filled and up
+// to date for something with the description and edescs. Things with no
+// edescs to tag can pass NULL for them
+PROTO_DESC_ENTRY *proto_desc_cached(PROTO_DESC_ENTRY *cache,
+				    const char *protos, const char *raw,
+				    EDESC_SET *edescs) {
+  PROTO_DESC_ENTRY *entry = proto_desc_entry(cache, protos);
+  if(entry->raw != NULL && entry->settings_version == mud_settings.version &&
+     !strcmp(entry->protos, protos) && !strcmp(entry->raw, raw) &&
+     (edescs == NULL || edesc_keys_match(edescs, entry->edesc_keys)))
+    return entry;
+  return NULL;
+}
+
+//
+// remember what things made from protos look like
+void proto_desc_cache_put(PROTO_DESC_ENTRY *cache, const char *protos,
+			  const char *raw, EDESC_SET *edescs,
+			  const char *formatted) {
+  PROTO_DESC_ENTRY *entry = proto_desc_entry(cache, protos);
+  if(entry->protos)     free(entry->protos);
+  if(entry->raw)        free(entry->raw);
+  if(entry->edesc_keys) free(entry->edesc_keys);
+  if(entry->formatted)  free(entry->formatted);
+  entry->protos           = strdup(protos);
+  entry->raw              = strdup(raw);
+  entry->edesc_keys       = (edescs ? edesc_keys_join(edescs) : NULL);
+  entry->settings_version = mud_settings.version;
+  entry->formatted        = strdup(formatted);
+}
+
+//
+// will the NPC's description look the same to everyone, and to every other
+// NPC made from the same prototypes with the same description?
+bool char_desc_is_static(CHAR_DATA *ch) {
+  proto_desc_hooks_register();
+  return (charIsNPC(ch) && *charGetPrototypes(ch) &&
+	  !strchr(charGetDesc(ch), '[') &&
+	  (!hookHasListenersId(preprocess_char_desc_hook) ||
+	   hookHasOnlyListenerId(preprocess_char_desc_hook,
+				 expand_char_dynamic_descs)) &&
+	  !hookHasListenersId(append_char_desc_hook));
+}
+
+//
+// the same for objects, up until whatever is appended to their descriptions.
+// That's different for each object, so only objects nothing gets appended to
+// can use what's cached
+bool obj_desc_is_static(OBJ_DATA *obj) {
+  proto_desc_hooks_register();
+  return (*objGetPrototypes(obj) && !strchr(objGetDesc(obj), '[') &&
+	  (!hookHasListenersId(preprocess_obj_desc_hook) ||
+	   hookHasOnlyListenerId(preprocess_obj_desc_hook,
+				 expand_obj_dynamic_descs)));
+}
+
+
+
 //*****************************************************************************
 // implementaiton of inform.h
 // look_at_xxx and show_xxx functions.
@@ -132,25 +425,45 @@ void look_at_obj(CHAR_DATA *ch, OBJ_DATA *obj) {
   // make our working copy of the description
   bufferClear(charGetLookBuffer(ch));
   bufferCat(charGetLookBuffer(ch), objGetDesc(obj));
+  bool is_static = obj_desc_is_static(obj);
 
   // do all of the preprocessing on the new descriptions
-  hookRun("preprocess_obj_desc", hookBuildInfo("obj ch", obj, ch));
+  hookRunArgsId(preprocess_obj_desc_hook, "obj ch", obj, ch);
 
   // append anything that might also go onto it
-  hookRun("append_obj_desc", hookBuildInfo("obj ch", obj, ch));
+  hookRunArgsId(append_obj_desc_hook, "obj ch", obj, ch);
+
+  // if nothing went onto it, we might already know what it'll look like
+  is_static = (is_static &&
+	       !strcmp(bufferString(charGetLookBuffer(ch)), objGetDesc(obj)));
+  PROTO_DESC_ENTRY *entry = (!is_static ? NULL :
+			     proto_desc_cached(obj_desc_cache,
+					       objGetPrototypes(obj),
+					       objGetDesc(obj),
+					       objGetEdescs(obj)));
+  if(entry != NULL) {
+    bufferClear(charGetLookBuffer(ch));
+    bufferCat(charGetLookBuffer(ch), entry->formatted);
+  }
+  else {
+    // colorize all of the edescs
+    edescTagDesc(charGetLookBuffer(ch), objGetEdescs(obj), "{c", "{n");
 
-  // colorize all of the edescs
-  edescTagDesc(charGetLookBuffer(ch), objGetEdescs(obj), "{c", "{n");
+    // format the desc
+    bufferFormat(charGetLookBuffer(ch), SCREEN_WIDTH, PARA_INDENT);
 
-  // format the desc, and send it
-  bufferFormat(charGetLookBuffer(ch), SCREEN_WIDTH, PARA_INDENT);
+    if(is_static)
+      proto_desc_cache_put(obj_desc_cache, objGetPrototypes(obj),
+			   objGetDesc(obj), objGetEdescs(obj),
+			   bufferString(charGetLookBuffer(ch)));
+  }
 
   if(bufferLength(charGetLookBuffer(ch)) == 0)
     send_to_char(ch, "{n%s\r\n", NOTHING_SPECIAL);
   else
     send_to_char(ch, "{n%s", bufferString(charGetLookBuffer(ch)));
 
-  hookRun("look_at_obj", hookBuildInfo("obj ch", obj, ch));
+  hookRunArgs("look_at_obj", "obj ch", obj, ch);
   send_to_char(ch, "{n");
 }
 
@@ -161,10 +474,10 @@ void look_at_exit(CHAR_DATA *ch, EXIT_DATA *exit) {
   bufferCat(charGetLookBuffer(ch), exitGetDesc(exit));
 
   // do all of our preprocessing of the description before we show it
-  hookRun("preprocess_exit_desc", hookBuildInfo("ex ch", exit, ch));
+  hookRunArgs("preprocess_exit_desc", "ex ch", exit, ch);
 
   // append anything that might also go onto it
-  hookRun("append_exit_desc", hookBuildInfo("ex ch", exit, ch));
+  hookRunArgs("append_exit_desc", "ex ch", exit, ch);
 
   // colorize all of the edescs
   edescTagDesc(charGetLookBuffer(ch), roomGetEdescs(exitGetRoom(exit)), 
@@ -179,86 +492,206 @@ void look_at_exit(CHAR_DATA *ch, EXIT_DATA *exit) {
   else
     send_to_char(ch, "{n%s", bufferString(charGetLookBuffer(ch)));
 
-  hookRun("look_at_exit", hookBuildInfo("ex ch", exit, ch));
+  hookRunArgs("look_at_exit", "ex ch", exit, ch);
   send_to_char(ch, "{n");
 }
 
+//
+// write out a single exit the way a character sees it
+void exit_listing_add(BUFFER *buf, EXIT_DATA *exit, ROOM_DATA *dest,
+		      const char *dir, bool builder) {
+  char class[100] = "\0"; // for the room class
+  if(builder)
+    snprintf(class, 100, " [%s]", roomGetClass(dest));
+
+  bprintf(buf, "{n  %-10s :: %s%s\r\n", dir, class, 
+	  (exitIsClosed(exit) ? 
+	   // if it's closed, print the exit name
+	   (*exitGetName(exit) ? exitGetName(exit) : "closed" ) :
+	   // if it's open, print where it leads to
+	   roomGetName(dest)));
+}
+
+//
+// the exits of a room, in the order they are listed: normal directions
+// first, then the special exits
+LIST *room_listed_exits(ROOM_DATA *room) {
+  LIST *exits = newList();
+  int      i = 0;
+  for(i = 0; i < roomCountEdges(room); i++)
+    listQueue(exits, roomGetEdgeExit(room, i));
+  return exits;
+}
+
 //
 // shows a single exit to a character
 void list_one_exit(CHAR_DATA *ch, EXIT_DATA *exit, const char *dir) {
-  char   buf[100] = "\0"; // for the room class
+  BUFFER    *buf = newBuffer(1);
   ROOM_DATA *dest = worldGetRoom(gameworld, exitGetToFull(exit));
-
-  if(bitIsOneSet(charGetUserGroups(ch), "builder"))
-    snprintf(buf, 100, " [%s]", roomGetClass(dest));
-
-  send_to_char(ch, "{n  %-10s :: %s%s\r\n", dir, buf, 
-	       (exitIsClosed(exit) ? 
-		// if it's closed, print the exit name
-		(*exitGetName(exit) ? exitGetName(exit) : "closed" ) :
-		// if it's open, print where it leads to
-		roomGetName(dest)));
+  exit_listing_add(buf, exit, dest, dir,
+		   bitIsOneSet(charGetUserGroups(ch), "builder"));
+  send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
 }
 
 
+//
+// Everyone who sees the same exits of a room sees the same listing, so the
+// listing is written once for each kind of viewer and remembered by the room.
+// What kind of viewer someone is comes down to which exits they can see, and
+// whether they are a builder (who also see where exits lead)
 void list_room_exits(CHAR_DATA *ch, ROOM_DATA *room) {
+  LIST         *exits = room_listed_exits(room);
+  LIST_ITERATOR *ex_i = newListIterator(exits);
   EXIT_DATA     *exit = NULL;
-  ROOM_DATA       *to = NULL;
-  int               i = 0;
-  LIST       *ex_list = roomGetExitNames(room);
-  LIST_ITERATOR *ex_i = newListIterator(ex_list);
-  char           *dir = NULL;
-
-  // first, we list all of the normal exit
-  for(i = 0; i < NUM_DIRS; i++) {
-    if( (exit = roomGetExit(room, dirGetName(i))) != NULL) {
-      // make sure the destination exists
-      if( (to = worldGetRoom(gameworld, exitGetToFull(exit))) == NULL)
-	log_string("ERROR: room %s heads %s to room %s, which does not exist.",
-		   roomGetClass(room), dirGetName(i), exitGetTo(exit));
-      else if(can_see_exit(ch, exit))
-	list_one_exit(ch, exit, dirGetName(i));
-    }
+  bool        builder = bitIsOneSet(charGetUserGroups(ch), "builder");
+  unsigned long   key = (builder ? 1 : 0);
+  int            bit  = 1;
+  bool      cacheable = (listSize(exits) < (int)sizeof(unsigned long) * 8);
+  const char *listing = NULL;
+
+  ITERATE_LIST(exit, ex_i) {
+    if(can_see_exit(ch, exit) && cacheable)
+      key |= (1UL << bit);
+    bit++;
   }
 
-  // next, we list all of the special exits
-  ITERATE_LIST(dir, ex_i) {
-    if(dirGetNum(dir) == DIR_NONE) {
-      exit = roomGetExit(room, dir);
+  if(cacheable && (listing = roomGetExitListing(room, key)) != NULL)
+    send_to_char(ch, "%s", listing);
+  else {
+    BUFFER   *buf = newBuffer(MAX_BUFFER);
+    ROOM_DATA *to = NULL;
+    bit = 1;
+    listIteratorReset(ex_i);
+    ITERATE_LIST(exit, ex_i) {
+      const char *dir = roomGetExitDir(room, exit);
       // make sure the destination exists
       if( (to = worldGetRoom(gameworld, exitGetToFull(exit))) == NULL)
 	log_string("ERROR: room %s heads %s to room %s, which does not exist.",
 		   roomGetClass(room), dir, exitGetTo(exit));
-      else if(can_see_exit(ch, exit))
-	list_one_exit(ch, exit, dir);
+      else if(cacheable ? IS_SET(key, 1UL << bit) : can_see_exit(ch, exit))
+	exit_listing_add(buf, exit, to, dir, builder);
+      bit++;
     }
-  } deleteListIterator(ex_i);
-  deleteListWith(ex_list, free);
+    if(cacheable)
+      roomSetExitListing(room, key, bufferString(buf));
+    send_to_char(ch, "%s", bufferString(buf));
+    deleteBuffer(buf);
+  }
+  deleteListIterator(ex_i);
+  deleteList(exits);
 }
 
 
 void look_at_char(CHAR_DATA *ch, CHAR_DATA *vict) {
   bufferClear(charGetLookBuffer(ch));
-  bufferCat(charGetLookBuffer(ch), charGetDesc(vict));
-
-  // preprocess our desc before it it sent to the person
-  hookRun("preprocess_char_desc", hookBuildInfo("ch ch", vict, ch));
-
-  // append anything that might also go onto it
-  hookRun("append_char_desc", hookBuildInfo("ch ch", vict, ch));
+  bool            is_static = char_desc_is_static(vict);
+  PROTO_DESC_ENTRY   *entry = (!is_static ? NULL :
+				proto_desc_cached(char_desc_cache,
+						  charGetPrototypes(vict),
+						  charGetDesc(vict), NULL));
+  if(entry != NULL)
+    bufferCat(charGetLookBuffer(ch), entry->formatted);
+  else {
+    bufferCat(charGetLookBuffer(ch), charGetDesc(vict));
+
+    // preprocess our desc before it it sent to the person
+    hookRunArgsId(preprocess_char_desc_hook, "ch ch", vict, ch);
+
+    // append anything that might also go onto it
+    hookRunArgsId(append_char_desc_hook, "ch ch", vict, ch);
+
+    // format it
+    bufferFormat(charGetLookBuffer(ch), SCREEN_WIDTH, PARA_INDENT);
+
+    if(is_static)
+      proto_desc_cache_put(char_desc_cache, charGetPrototypes(vict),
+			   charGetDesc(vict), NULL,
+			   bufferString(charGetLookBuffer(ch)));
+  }
 
-  // format and send it
-  bufferFormat(charGetLookBuffer(ch), SCREEN_WIDTH, PARA_INDENT);
+  // and send it
 
   if(bufferLength(charGetLookBuffer(ch)) == 0)
     send_to_char(ch, "{n%s\r\n", NOTHING_SPECIAL);
   else
     send_to_char(ch, "{n%s{n", bufferString(charGetLookBuffer(ch)));
 
-  hookRun("look_at_char", hookBuildInfo("ch ch", vict, ch));
+  hookRunArgs("look_at_char", "ch ch", vict, ch);
 }
 
 
+//
+// a room's description looks the same to everyone once it has been tagged and
+// formatted, unless it has dynamic bits in it, or something that might make it
+// different for each viewer is listening to the hooks that build it. Those
+// that look the same are kept in a direct-mapped cache, and checked against
+// the room's description and extra descriptions before they're used
+#define ROOM_DESC_CACHE_SIZE   1024
+
+typedef struct {
+  ROOM_DATA       *room;
+  char             *raw; // the description we were made from
+  EDESC_SET     *edescs; // the edescs we were tagged with, at what version
+  int     edesc_version;
+  int  settings_version; // for the screen width and indent we were formatted
+  char       *formatted; //   with, and what we look like after all that
+} ROOM_DESC_ENTRY;
+
+ROOM_DESC_ENTRY room_desc_cache[ROOM_DESC_CACHE_SIZE];
+
+// the hooks that build room descriptions
+int preprocess_room_desc_hook  = -1;
+int append_room_desc_hook      = -1;
+int postprocess_room_desc_hook = -1;
+
+//
+// will the room's description look the same to everyone?
+bool room_desc_is_static(ROOM_DATA *room) {
+  if(preprocess_room_desc_hook == -1) {
+    preprocess_room_desc_hook  = hookRegister("preprocess_room_desc");
+    append_room_desc_hook      = hookRegister("append_room_desc");
+    postprocess_room_desc_hook = hookRegister("postprocess_room_desc");
+  }
+  return (!strchr(roomGetDesc(room), '[') &&
+	  (!hookHasListenersId(preprocess_room_desc_hook) ||
+	   hookHasOnlyListenerId(preprocess_room_desc_hook,
+				 expand_room_dynamic_descs)) &&
+	  !hookHasListenersId(append_room_desc_hook) &&
+	  !hookHasListenersId(postprocess_room_desc_hook));
+}
+
+//
+// returns the room's cache entry, if it's filled and up to date
+ROOM_DESC_ENTRY *room_desc_cached(ROOM_DATA *room) {
+  ROOM_DESC_ENTRY *entry = 
+    &room_desc_cache[((unsigned long)room / sizeof(void *)) %
+		     ROOM_DESC_CACHE_SIZE];
+  if(entry->room == room && entry->raw != NULL &&
+     entry->edescs == roomGetEdescs(room) &&
+     entry->edesc_version == edescSetGetVersion(roomGetEdescs(room)) &&
+     entry->settings_version == mud_settings.version &&
+     !strcmp(entry->raw, roomGetDesc(room)))
+    return entry;
+  return NULL;
+}
+
+//
+// remember what the room's description looks like
+void room_desc_cache_put(ROOM_DATA *room, const char *formatted) {
+  ROOM_DESC_ENTRY *entry = 
+    &room_desc_cache[((unsigned long)room / sizeof(void *)) %
+		     ROOM_DESC_CACHE_SIZE];
+  if(entry->raw)       free(entry->raw);
+  if(entry->formatted) free(entry->formatted);
+  entry->room             = room;
+  entry->raw              = strdup(roomGetDesc(room));
+  entry->edescs           = roomGetEdescs(room);
+  entry->edesc_version    = edescSetGetVersion(roomGetEdescs(room));
+  entry->settings_version = mud_settings.version;
+  entry->formatted        = strdup(formatted);
+}
+
 void look_at_room(CHAR_DATA *ch, ROOM_DATA *room) {
 
  
@@ -271,24 +704,31 @@ void look_at_room(CHAR_DATA *ch, ROOM_DATA *room) {
 
   // make the working copy of the description, and fill it up with info
   bufferClear(charGetLookBuffer(ch));
-  bufferCat(charGetLookBuffer(ch), roomGetDesc(room));
+  bool            is_static = room_desc_is_static(room);
+  ROOM_DESC_ENTRY    *entry = (is_static ? room_desc_cached(room) : NULL);
+  if(entry != NULL)
+    bufferCat(charGetLookBuffer(ch), entry->formatted);
+  else {
+    bufferCat(charGetLookBuffer(ch), roomGetDesc(room));
 
+    // do all of our preprocessing of the description before we show it
+    hookRunArgsId(preprocess_room_desc_hook, "rm ch", room, ch);
 
-  // do all of our preprocessing of the description before we show it
-  hookRun("preprocess_room_desc", hookBuildInfo("rm ch", room, ch));
+    // append anything that might also go onto it
+    hookRunArgsId(append_room_desc_hook, "rm ch", room, ch);
 
-  // append anything that might also go onto it
-  hookRun("append_room_desc", hookBuildInfo("rm ch", room, ch));
+    // colorize all of the edescs
+    edescTagDesc(charGetLookBuffer(ch), roomGetEdescs(room), "{C", "{n");
 
+    // format our description
+    bufferFormat(charGetLookBuffer(ch), SCREEN_WIDTH, PARA_INDENT);
 
-  // colorize all of the edescs
-  edescTagDesc(charGetLookBuffer(ch), roomGetEdescs(room), "{C", "{n");
+    // do any post-processing we might have
+    hookRunArgsId(postprocess_room_desc_hook, "rm ch", room, ch);
 
-  // format our description
-  bufferFormat(charGetLookBuffer(ch), SCREEN_WIDTH, PARA_INDENT);
-
-  // do any post-processing we might have
-  hookRun("postprocess_room_desc", hookBuildInfo("rm ch", room, ch));
+    if(is_static)
+      room_desc_cache_put(room, bufferString(charGetLookBuffer(ch)));
+  }
 
 
   if(bufferLength(charGetLookBuffer(ch)) == 0)
@@ -298,7 +738,7 @@ void look_at_room(CHAR_DATA *ch, ROOM_DATA *room) {
 
 
 
-  hookRun("look_at_room", hookBuildInfo("rm ch", room, ch));
+  hookRunArgs("look_at_room", "rm ch", room, ch);
 
 
   send_to_char(ch, "{n");
@@ -322,17 +762,116 @@ void send_outdoors(const char *format, ...) {
     va_end(args);
 
     // send it out to everyone
-    LIST_ITERATOR *list_i = newListIterator(mobile_list);
-    CHAR_DATA *ch = NULL;
-    ITERATE_LIST(ch, list_i)
-      if(charGetRoom(ch) != NULL &&
-	 roomGetTerrain(charGetRoom(ch)) != TERRAIN_INDOORS &&
-	 roomGetTerrain(charGetRoom(ch)) != TERRAIN_CAVERN)
-	text_to_char(ch, buf);
-    deleteListIterator(list_i);
+    send_to_set(outdoor_chars, buf);
+  }
+}
+
+void send_to_zone(const char *zone, const char *format, ...) {
+  if(format && *format) {
+    static char buf[MAX_BUFFER];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, MAX_BUFFER, format, args);
+    va_end(args);
+    send_to_set(hashGet(zone_chars, zone), buf);
+  }
+}
+
+void send_to_channel(const char *channel, const char *format, ...) {
+  if(format && *format) {
+    static char buf[MAX_BUFFER];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, MAX_BUFFER, format, args);
+    va_end(args);
+    send_to_set(hashGet(channels, channel), buf);
   }
 }
 
+void channelJoin(const char *channel, CHAR_DATA *ch) {
+  channel_set_put(channels, channel, ch);
+}
+
+void channelLeave(const char *channel, CHAR_DATA *ch) {
+  channel_set_remove(channels, channel, ch);
+}
+
+bool channelHasMember(const char *channel, CHAR_DATA *ch) {
+  SET *set = hashGet(channels, channel);
+  return (set != NULL && setIn(set, ch));
+}
+
+LIST *channelGetMembers(const char *channel) {
+  LIST *members = newList();
+  SET      *set = hashGet(channels, channel);
+  if(set != NULL) {
+    LOCAL_SET_ITERATOR(ch_i, set);
+    CHAR_DATA       *ch = NULL;
+    ITERATE_SET(ch, ch_i) {
+      listQueue(members, ch);
+    } setIteratorFinish(ch_i);
+  }
+  return members;
+}
+
+void channelSetGroup(const char *channel, const char *group) {
+  char   *old = hashRemove(channel_groups, channel);
+  bool had_group = (old != NULL);
+  if(old != NULL)
+    free(old);
+  if(group != NULL && *group)
+    hashPut(channel_groups, channel, strdup(group));
+
+  // bring the members of everyone in the game up to date
+  LIST_ITERATOR *ch_i = newListIterator(mobile_list);
+  CHAR_DATA       *ch = NULL;
+  ITERATE_LIST(ch, ch_i) {
+    if(group != NULL && *group && bitIsSet(charGetUserGroups(ch), group))
+      channel_set_put(channels, channel, ch);
+    else if(had_group)
+      channel_set_remove(channels, channel, ch);
+  } deleteListIterator(ch_i);
+}
+
+const char *channelGetGroup(const char *channel) {
+  return hashGet(channel_groups, channel);
+}
+
+void channelAddHistory(const char *channel, const char *mssg) {
+  CHANNEL_LOG *log = hashGet(channel_logs, channel);
+  if(log == NULL) {
+    log = calloc(1, sizeof(CHANNEL_LOG));
+    log->size  = MAX(1, mudsettingGetInt("channel_history"));
+    log->mssgs = calloc(log->size, sizeof(char *));
+    hashPut(channel_logs, channel, log);
+  }
+
+  // a full log loses its oldest message to make room
+  int slot = (log->start + log->num) % log->size;
+  if(log->num == log->size) {
+    free(log->mssgs[slot]);
+    log->start = (log->start + 1) % log->size;
+  }
+  else
+    log->num++;
+  log->mssgs[slot] = strdup(mssg);
+}
+
+LIST *channelGetHistory(const char *channel) {
+  LIST       *mssgs = newList();
+  CHANNEL_LOG  *log = hashGet(channel_logs, channel);
+  int i;
+  if(log != NULL)
+    for(i = 0; i < log->num; i++)
+      listQueue(mssgs, log->mssgs[(log->start + i) % log->size]);
+  return mssgs;
+}
+
+int zoneCountOccupants(const char *zone) {
+  SET *set = hashGet(zone_chars, zone);
+  return (set != NULL ? setSize(set) : 0);
+}
+
 
 void text_to_char(CHAR_DATA *ch, const char *txt) {
   //  if (txt && *txt && charGetSocket(ch) && 
@@ -349,6 +888,19 @@ void text_to_char(CHAR_DATA *ch, const char *txt) {
 }
 
 
+//
+// like text_to_char, but the character's socket shares the text with
+// everyone else it's being sent to instead of getting its own copy
+void text_to_char_shared(CHAR_DATA *ch, OUT_FRAG *frag) {
+  if(*outFragGetText(frag) && charGetSocket(ch)) {
+    text_to_buffer_shared(charGetSocket(ch), frag);
+    socketBustPrompt(charGetSocket(ch));
+  }
+  if(!charIsNPC(ch))
+    try_log(charGetName(ch), outFragGetText(frag));
+}
+
+
 void send_to_char(CHAR_DATA *ch, const char *format, ...) {
   if(charGetSocket(ch) && format && *format) {
     static char buf[MAX_BUFFER];
@@ -357,7 +909,8 @@ void send_to_char(CHAR_DATA *ch, const char *format, ...) {
     vsnprintf(buf, MAX_BUFFER, format, args);
     va_end(args);
     text_to_char(ch, buf);
-    hookRun("char_receive_text", hookBuildInfo("ch str", ch, buf));
+    if(hookHasListeners("char_receive_text"))
+      hookRun("char_receive_text", hookBuildInfo("ch str", ch, buf));
     return;
   }
 }
@@ -370,36 +923,42 @@ void send_around_char(CHAR_DATA *ch, bool hide_nosee, const char *format, ...) {
   vsnprintf(buf, MAX_BUFFER, format, args);
   va_end(args);
 
-  LIST_ITERATOR *room_i = newListIterator(roomGetCharacters(charGetRoom(ch)));
+  LOCAL_LIST_ITERATOR(room_i, roomGetCharacters(charGetRoom(ch)));
   CHAR_DATA       *vict = NULL;
+  OUT_FRAG        *frag = newOutFrag(buf);
 
   ITERATE_LIST(vict, room_i) {
     if(ch == vict)
       continue;
     if(hide_nosee && !can_see_char(vict, ch))
       continue;
-    text_to_char(vict, buf);
+    text_to_char_shared(vict, frag);
   }
-  deleteListIterator(room_i);
+  listIteratorFinish(room_i);
+  outFragUnref(frag);
   return;
 }
 
 
 void send_to_groups(const char *groups, const char *format, ...) {
+  // nobody to send to. We get logged from before the game is set up, too
+  if(socket_list == NULL || listSize(socket_list) == 0)
+    return;
+
   static char buf[MAX_BUFFER];
   va_list args;
   va_start(args, format);
   vsnprintf(buf, MAX_BUFFER, format, args);
   va_end(args);
 
-  LIST_ITERATOR *ch_i = newListIterator(mobile_list);
-  CHAR_DATA       *ch = NULL;
+  LOCAL_LIST_ITERATOR(sock_i, socketsInUserGroups(groups));
+  SOCKET_DATA   *sock = NULL;
+  OUT_FRAG      *frag = newOutFrag(buf);
 
-  ITERATE_LIST(ch, ch_i) {
-    if(!charGetSocket(ch) || !bitIsSet(charGetUserGroups(ch), groups))
-      continue;
-    text_to_char(ch, buf);
-  } deleteListIterator(ch_i);
+  ITERATE_LIST(sock, sock_i)
+    text_to_char_shared(socketGetChar(sock), frag);
+  listIteratorFinish(sock_i);
+  outFragUnref(frag);
 }
 
 
@@ -413,11 +972,13 @@ void send_to_list(LIST *list, const char *format, ...) {
     va_end(args);
 
     // send it out to everyone
-    LIST_ITERATOR *list_i = newListIterator(list);
+    LOCAL_LIST_ITERATOR(list_i, list);
     CHAR_DATA *ch = NULL;
+    OUT_FRAG *frag = newOutFrag(buf);
     ITERATE_LIST(ch, list_i)
-      text_to_char(ch, buf);
-    deleteListIterator(list_i);
+      text_to_char_shared(ch, frag);
+    listIteratorFinish(list_i);
+    outFragUnref(frag);
   }
 };
 
@@ -550,104 +1111,244 @@ COMMAND(cmd_commands) {
 //  $O = vobj name
 //  $a = a/an of obj
 //  $A = a/an of vobj
-void send_message(CHAR_DATA *to, 
-		  const char *str,
-		  CHAR_DATA *ch, CHAR_DATA *vict,
-		  OBJ_DATA *obj, OBJ_DATA *vobj) {
-  static char buf[MAX_BUFFER];
-  int i, j;
-  *buf = '\0';
+//
+// what someone getting a message can see of the things in it. We only need
+// to build a message's text once for everyone who sees the same things
+#define SEE_CH       (1 << 0)
+#define SEE_VICT     (1 << 1)
+#define SEE_OBJ      (1 << 2)
+#define SEE_VOBJ     (1 << 3)
+#define NUM_SEES          16
+
+int message_visibility(CHAR_DATA *to, CHAR_DATA *ch, CHAR_DATA *vict,
+		       OBJ_DATA *obj, OBJ_DATA *vobj) {
+  int vis = 0;
+  if(ch   && can_see_char(to, ch))   SET_BIT(vis, SEE_CH);
+  if(vict && can_see_char(to, vict)) SET_BIT(vis, SEE_VICT);
+  if(obj  && can_see_obj(to, obj))   SET_BIT(vis, SEE_OBJ);
+  if(vobj && can_see_obj(to, vobj))  SET_BIT(vis, SEE_VOBJ);
+  return vis;
+}
 
-  // if there's nothing to send the message to, don't go through all
-  // the work it takes to parse the string
-  if(charGetSocket(to) == NULL)
+//
+// messages are compiled into the literal spans and $ codes they are made of
+// the first time they are sent. Each recipient's text is then just those
+// pieces put together. Compiled messages are cached by their text, since
+// most messages are the same few strings sent over and over again. The
+// cache is direct-mapped; a message that lands in a taken slot replaces
+// whatever was there
+#define MSSG_CACHE_SIZE    1024
+
+typedef struct {
+  char     code; // the code after a $, or '\0' for literal text
+  int     start; // where our literal text starts in the message, and how
+  int       len; // long it is
+} MSSG_PART;
+
+typedef struct {
+  char        *str;
+  MSSG_PART *parts;
+  int    num_parts;
+  int         refs;
+} MSSG_TEMPLATE;
+
+MSSG_TEMPLATE *mssg_cache[MSSG_CACHE_SIZE];
+
+void mssg_template_unref(MSSG_TEMPLATE *tmpl) {
+  if(--tmpl->refs > 0)
     return;
+  free(tmpl->str);
+  if(tmpl->parts)
+    free(tmpl->parts);
+  free(tmpl);
+}
 
-  for(i = 0, j = 0; str[i] != '\0'; i++) {
-    if(str[i] != '$') {
-      buf[j] = str[i];
-      j++;
+void mssg_template_add(MSSG_TEMPLATE *tmpl, char code, int start, int len) {
+  if(code == '\0' && len == 0)
+    return;
+  // literal text that follows other literal text (e.g. after a $$) is
+  // merged into it
+  if(code == '\0' && tmpl->num_parts > 0) {
+    MSSG_PART *last = &tmpl->parts[tmpl->num_parts - 1];
+    if(last->code == '\0' && last->start + last->len == start) {
+      last->len += len;
+      return;
+    }
+  }
+  tmpl->parts = realloc(tmpl->parts, sizeof(MSSG_PART)*(tmpl->num_parts + 1));
+  MSSG_PART *part = &tmpl->parts[tmpl->num_parts++];
+  part->code  = code;
+  part->start = start;
+  part->len   = len;
+}
+
+//
+// split a message up into literal text and $ codes
+MSSG_TEMPLATE *mssg_template_compile(const char *str) {
+  MSSG_TEMPLATE *tmpl = calloc(1, sizeof(MSSG_TEMPLATE));
+  tmpl->str  = strdup(str);
+  tmpl->refs = 1;
+  int start = 0, i;
+  for(i = 0; str[i] != '\0'; i++) {
+    if(str[i] != '$')
+      continue;
+    mssg_template_add(tmpl, '\0', start, i - start);
+    // a $ at the very end stands for nothing
+    if(str[i+1] == '\0') {
+      start = i + 1;
+      break;
     }
+    // $$ is a dollar sign. The second one starts our next span of text
+    if(str[i+1] == '$')
+      start = i + 1;
     else {
-      i++;
-
-      switch(str[i]) {
-      case 'n':
-	if(!ch) break;
-	sprintf(buf+j, see_char_as(to, ch));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'N':
-	if(!vict) break;
-	sprintf(buf+j, see_char_as(to, vict));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'm':
-	if(!ch) break;
-	sprintf(buf+j, (can_see_char(to, ch) ? HIMHER(ch) : SOMEONE));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'M':
-	if(!vict) break;
-	sprintf(buf+j, (can_see_char(to, vict) ? HIMHER(vict) : SOMEONE));
-	while(buf[j] != '\0') j++;
-	break;
-      case 's':
-	if(!ch) break;
-	sprintf(buf+j, (can_see_char(to, ch) ? HISHER(ch) :"their"));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'S':
-	if(!vict) break;
-	sprintf(buf+j, (can_see_char(to, vict) ? HISHER(vict) :"their"));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'e':
-	if(!ch) break;
-	sprintf(buf+j, (can_see_char(to, ch) ? HESHE(ch) : SOMEONE));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'E':
-	if(!vict) break;
-	sprintf(buf+j, (can_see_char(to, vict) ? HESHE(vict) : SOMEONE));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'o':
-	if(!obj) break;
-	sprintf(buf+j, see_obj_as(to, obj));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'O':
-	if(!vobj) break;
-	sprintf(buf+j, see_obj_as(to, vobj));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'a':
-	if(!obj) break;
-	sprintf(buf+j, AN(see_obj_as(to, obj)));
-	while(buf[j] != '\0') j++;
-	break;
-      case 'A':
-	if(!vobj) break;
-	sprintf(buf+j, AN(see_obj_as(to, vobj)));
-	while(buf[j] != '\0') j++;
-	break;
-      case '$':
-	buf[j] = '$';
-	j++;
-	break;
-      default:
-	// do nothing
-	break;
-      }
+      mssg_template_add(tmpl, str[i+1], 0, 0);
+      start = i + 2;
+    }
+    i++;
+  }
+  mssg_template_add(tmpl, '\0', start, strlen(str) - start);
+  return tmpl;
+}
+
+//
+// returns the compiled form of a message, with a reference for the caller
+MSSG_TEMPLATE *mssg_template_get(const char *str) {
+  unsigned int hash = 2166136261u;
+  const char   *pos = NULL;
+  for(pos = str; *pos; pos++)
+    hash = (hash ^ (unsigned char)*pos) * 16777619u;
+  MSSG_TEMPLATE **slot = &mssg_cache[hash % MSSG_CACHE_SIZE];
+  if(*slot == NULL || strcmp((*slot)->str, str)) {
+    if(*slot != NULL)
+      mssg_template_unref(*slot);
+    *slot = mssg_template_compile(str);
+  }
+  (*slot)->refs++;
+  return *slot;
+}
+
+//
+// what a $ code turns into, as seen by someone who can see vis. NULL if the
+// code is unknown, or refers to something the message isn't about
+const char *message_sub(char code, int vis, CHAR_DATA *ch, CHAR_DATA *vict,
+			OBJ_DATA *obj, OBJ_DATA *vobj) {
+  bool           see_ch = IS_SET(vis, SEE_CH);
+  bool         see_vict = IS_SET(vis, SEE_VICT);
+  bool          see_obj = IS_SET(vis, SEE_OBJ);
+  bool         see_vobj = IS_SET(vis, SEE_VOBJ);
+
+  switch(code) {
+  case 'n': return (!ch   ? NULL : see_ch   ? charGetName(ch)   : SOMEONE);
+  case 'N': return (!vict ? NULL : see_vict ? charGetName(vict) : SOMEONE);
+  case 'm': return (!ch   ? NULL : see_ch   ? HIMHER(ch)        : SOMEONE);
+  case 'M': return (!vict ? NULL : see_vict ? HIMHER(vict)      : SOMEONE);
+  case 's': return (!ch   ? NULL : see_ch   ? HISHER(ch)        : "their");
+  case 'S': return (!vict ? NULL : see_vict ? HISHER(vict)      : "their");
+  case 'e': return (!ch   ? NULL : see_ch   ? HESHE(ch)         : SOMEONE);
+  case 'E': return (!vict ? NULL : see_vict ? HESHE(vict)       : SOMEONE);
+  case 'o': return (!obj  ? NULL : see_obj  ? objGetName(obj)   : SOMETHING);
+  case 'O': return (!vobj ? NULL : see_vobj ? objGetName(vobj)  : SOMETHING);
+  case 'a': return (!obj  ? NULL : AN((see_obj ? objGetName(obj):SOMETHING)));
+  case 'A': return (!vobj ? NULL : AN((see_vobj? objGetName(vobj):SOMETHING)));
+  default:  return NULL;
+  }
+}
+
+//
+// build a message's text, as seen by someone who can see vis. buf must be
+// MAX_BUFFER long; anything past that is cut off
+void build_message(char *buf, MSSG_TEMPLATE *tmpl, int vis,
+		   CHAR_DATA *ch, CHAR_DATA *vict,
+		   OBJ_DATA *obj, OBJ_DATA *vobj) {
+  static const char   end[] = "{n\r\n";
+  int                 room = MAX_BUFFER - sizeof(end);
+  int                  len = 0, i;
+
+  for(i = 0; i < tmpl->num_parts && len < room; i++) {
+    MSSG_PART  *part = &tmpl->parts[i];
+    const char  *txt = tmpl->str + part->start;
+    int      txt_len = part->len;
+    if(part->code != '\0') {
+      if((txt = message_sub(part->code, vis, ch, vict, obj, vobj)) == NULL)
+	continue;
+      txt_len = strlen(txt);
     }
+    txt_len = MIN(txt_len, room - len);
+    memcpy(buf + len, txt, txt_len);
+    len += txt_len;
   }
 
   //  buf[0] = toupper(buf[0]);
-  sprintf(buf+j, "{n\r\n");
-  text_to_char(to, buf);
+  memcpy(buf + len, end, sizeof(end));
 }
 
+//
+// Send a message out
+//
+// Converts the following symbols:
+//  $n = ch name
+//  $N = vict name
+//  $m = him/her of char
+//  $M = him/her of vict
+//  $s = his/hers of char
+//  $S = his/hers of vict
+//  $e = he/she of char
+//  $E = he/she of vict
+//
+//  $o = obj name
+//  $O = vobj name
+//  $a = a/an of obj
+//  $A = a/an of vobj
+//
+// texts holds the message as it has been built for each kind of visibility so
+// far, for sending the same message to many people. It can be NULL
+void send_message_shared(CHAR_DATA *to, 
+			 MSSG_TEMPLATE *tmpl,
+			 CHAR_DATA *ch, CHAR_DATA *vict,
+			 OBJ_DATA *obj, OBJ_DATA *vobj, OUT_FRAG **texts) {
+  static char buf[MAX_BUFFER];
+
+  // if there's nothing to send the message to, don't go through all
+  // the work it takes to build the string
+  if(charGetSocket(to) == NULL)
+    return;
+
+  int vis = message_visibility(to, ch, vict, obj, vobj);
+  if(texts == NULL) {
+    build_message(buf, tmpl, vis, ch, vict, obj, vobj);
+    text_to_char(to, buf);
+  }
+  else {
+    if(texts[vis] == NULL) {
+      build_message(buf, tmpl, vis, ch, vict, obj, vobj);
+      texts[vis] = newOutFrag(buf);
+    }
+    text_to_char_shared(to, texts[vis]);
+  }
+}
+
+void send_message(CHAR_DATA *to, 
+		  const char *str,
+		  CHAR_DATA *ch, CHAR_DATA *vict,
+		  OBJ_DATA *obj, OBJ_DATA *vobj) {
+  if(charGetSocket(to) == NULL)
+    return;
+  MSSG_TEMPLATE *tmpl = mssg_template_get(str);
+  send_message_shared(to, tmpl, ch, vict, obj, vobj, NULL);
+  mssg_template_unref(tmpl);
+}
+
+//
+// can a recipient of a message sent to many people see enough to get it?
+bool message_seen(CHAR_DATA *rec, int hide_nosee, CHAR_DATA *ch,
+		  OBJ_DATA *obj) {
+  return (!hide_nosee ||
+	  // make sure the vict can see the character, or the
+	  // object if there is no character
+	  ((!ch || can_see_char(rec, ch)) &&
+	   (ch  || (!obj || can_see_obj(rec, obj)))));
+}
 
 void message(CHAR_DATA *ch,  CHAR_DATA *vict,
 	     OBJ_DATA  *obj, OBJ_DATA  *vobj,
@@ -656,48 +1357,90 @@ void message(CHAR_DATA *ch,  CHAR_DATA *vict,
   if(!mssg || !*mssg)
     return;
 
+  // our message is only split up once, for everyone who gets it
+  MSSG_TEMPLATE *tmpl = mssg_template_get(mssg);
+
   // what's our scope?
-  if(IS_SET(range, TO_VICT) && vict &&
-     (!hide_nosee ||
-      // make sure the vict can the character, or the
-      // object if there is no character
-      ((!ch || can_see_char(vict, ch)) &&
-       (ch  || (!obj || can_see_obj(vict, obj))))))
-    send_message(vict, mssg, ch, vict, obj, vobj);
+  if(IS_SET(range, TO_VICT) && vict && message_seen(vict, hide_nosee, ch, obj))
+    send_message_shared(vict, tmpl, ch, vict, obj, vobj, NULL);
 
   // characters can always see themselves. No need to do checks here
   if(IS_SET(range, TO_CHAR) && ch)
-    send_message(ch, mssg, ch, vict, obj, vobj);
+    send_message_shared(ch, tmpl, ch, vict, obj, vobj, NULL);
+
+  // everyone else gets the message built once per kind of visibility
+  OUT_FRAG *texts[NUM_SEES] = { NULL };
+  int i;
 
-  LIST *recipients = NULL;
   // check if the scope of this message is everyone in the world
-  if(IS_SET(range, TO_WORLD))
-    recipients = mobile_list;
-  else if(IS_SET(range, TO_ROOM) && charGetRoom(ch) != NULL)
-    recipients = roomGetCharacters(charGetRoom(ch));
-
-  // if we have a list to send the message to, do it
-  if(recipients != NULL) {
-    LIST_ITERATOR *rec_i = newListIterator(recipients);
-    CHAR_DATA *rec = NULL;
-
-    // go through everyone in the list
-    ITERATE_LIST(rec, rec_i) {
-      // if we wanted to send to ch or vict, we would have already...
-      if(rec == vict || rec == ch)
-	continue;
-      // skip by people who are in the game but not in the world yet
-      if(charGetRoom(rec) == NULL)
-	continue;
-      if(rec == ch ||
-	 (!hide_nosee ||
-	  // make sure the vict can see the character, or the
-	  // object if there is no character
-	  ((!ch || can_see_char(rec, ch)) &&
-	   (ch  || (!obj || can_see_obj(rec, obj))))))
-      send_message(rec, mssg, ch, vict, obj, vobj);
-    } deleteListIterator(rec_i);
+  if(IS_SET(range, TO_WORLD) || IS_SET(range, TO_ROOM)) {
+    LIST *recipients = NULL;
+    if(IS_SET(range, TO_WORLD))
+      recipients = mobile_list;
+    else if(charGetRoom(ch) != NULL)
+      recipients = roomGetCharacters(charGetRoom(ch));
+
+    if(recipients != NULL) {
+      LOCAL_LIST_ITERATOR(rec_i, recipients);
+      CHAR_DATA *rec = NULL;
+
+      // go through everyone in the list
+      ITERATE_LIST(rec, rec_i) {
+	// if we wanted to send to ch or vict, we would have already...
+	if(rec == vict || rec == ch)
+	  continue;
+	// skip by people who are in the game but not in the world yet
+	if(charGetRoom(rec) == NULL)
+	  continue;
+	if(message_seen(rec, hide_nosee, ch, obj))
+	  send_message_shared(rec, tmpl, ch, vict, obj, vobj, texts);
+      } listIteratorFinish(rec_i);
+    }
   }
+
+  // or everyone in the character's zone
+  else if(IS_SET(range, TO_ZONE) && ch && charGetRoom(ch) != NULL) {
+    SET *recipients = hashGet(zone_chars,
+			      get_key_locale(roomGetClass(charGetRoom(ch))));
+    if(recipients != NULL) {
+      LOCAL_SET_ITERATOR(rec_i, recipients);
+      CHAR_DATA *rec = NULL;
+      ITERATE_SET(rec, rec_i) {
+	if(rec != vict && rec != ch && message_seen(rec, hide_nosee, ch, obj))
+	  send_message_shared(rec, tmpl, ch, vict, obj, vobj, texts);
+      } setIteratorFinish(rec_i);
+    }
+  }
+
+  for(i = 0; i < NUM_SEES; i++)
+    if(texts[i] != NULL)
+      outFragUnref(texts[i]);
+  mssg_template_unref(tmpl);
+}
+
+void channelMessage(const char *channel, CHAR_DATA *ch, CHAR_DATA *vict,
+		    OBJ_DATA *obj, OBJ_DATA *vobj, int hide_nosee,
+		    const char *mssg) {
+  SET *recipients = hashGet(channels, channel);
+  if(!mssg || !*mssg || recipients == NULL)
+    return;
+
+  // like message(), each kind of visibility only gets the message built once
+  MSSG_TEMPLATE    *tmpl = mssg_template_get(mssg);
+  OUT_FRAG *texts[NUM_SEES] = { NULL };
+  int i;
+
+  LOCAL_SET_ITERATOR(rec_i, recipients);
+  CHAR_DATA *rec = NULL;
+  ITERATE_SET(rec, rec_i) {
+    if(rec != vict && rec != ch && message_seen(rec, hide_nosee, ch, obj))
+      send_message_shared(rec, tmpl, ch, vict, obj, vobj, texts);
+  } setIteratorFinish(rec_i);
+
+  for(i = 0; i < NUM_SEES; i++)
+    if(texts[i] != NULL)
+      outFragUnref(texts[i]);
+  mssg_template_unref(tmpl);
 }
 
 void mssgprintf(CHAR_DATA *ch, CHAR_DATA *vict, 
@@ -723,27 +1466,29 @@ void mssgprintf(CHAR_DATA *ch, CHAR_DATA *vict,
 //
 // appends all of our exit extra descriptions to the room description.
 void exit_append_room_hook(BUFFER *buf, ROOM_DATA *room, CHAR_DATA *ch) {
-  LIST       *exnames = roomGetExitNames(room);
   LIST       *ex_same = newList(); // leads to room w/ same name
   LIST       *ex_diff = newList(); // leads to room w/ diff name
   LIST     *ex_closed = newList(); // there is a closed door blocking us
-  LIST_ITERATOR *ex_i = newListIterator(exnames);
-  char            *ex = NULL;
+  LIST_ITERATOR *ex_i = NULL;
+  const char      *ex = NULL;
+  int       num_exits = roomCountEdges(room);
+  int               i = 0;
 
   // figure out our exits that lead to same-room-name 
   // or different-room-name destinations.
-  ITERATE_LIST(ex, ex_i) {
-    EXIT_DATA *exit = roomGetExit(room, ex);
+  for(i = 0; i < num_exits; i++) {
+    EXIT_DATA *exit = roomGetEdgeExit(room, i);
     ROOM_DATA *dest = worldGetRoom(gameworld, exitGetToFull(exit));
+    ex = roomGetEdgeDir(room, i);
     if(dest && can_see_exit(ch, exit) && dirGetNum(ex) != DIR_NONE) {
       if(exitIsClosed(exit))
-	listPut(ex_closed, ex);
+	listPut(ex_closed, (char *)ex);
       else if(!strcasecmp(roomGetName(room), roomGetName(dest)))
-	listPush(ex_same, ex);
+	listPush(ex_same, (char *)ex);
       else
-	listQueue(ex_diff, ex);
+	listQueue(ex_diff, (char *)ex);
     }
-  } deleteListIterator(ex_i);
+  }
 
   // append info for dirs that are blocked by doors
   ex_i = newListIterator(ex_closed);
@@ -772,7 +1517,7 @@ void exit_append_room_hook(BUFFER *buf, ROOM_DATA *room, CHAR_DATA *ch) {
     // else display in bulk
     else {
       bprintf(buf, " All %sdiretions continue to %s.", 
-	      (listSize(ex_same) == listSize(exnames) ? "" : "other "),
+	      (listSize(ex_same) == num_exits ? "" : "other "),
 	      roomGetName(room));
     }
   }
@@ -781,7 +1526,6 @@ void exit_append_room_hook(BUFFER *buf, ROOM_DATA *room, CHAR_DATA *ch) {
   deleteList(ex_diff);
   deleteList(ex_same);
   deleteList(ex_closed);
-  deleteListWith(exnames, free);
 }
 
 void exit_append_hook(const char *info) {
@@ -793,19 +1537,10 @@ void exit_append_hook(const char *info) {
   BUFFER         *buf = charGetLookBuffer(ch);
   ROOM_DATA     *room = exitGetRoom(exit);
   ROOM_DATA     *dest = worldGetRoom(gameworld, exitGetToFull(exit));
-  LIST       *exnames = roomGetExitNames(room);
-  LIST_ITERATOR *ex_i = newListIterator(exnames);
-  char            *ex = NULL;
-  char           *dir = NULL;
 
   // figure out which direction we came from
-  ITERATE_LIST(ex, ex_i) {
-    if(roomGetExit(room, ex) == exit) {
-      dir = strdup(ex);
-      break;
-    }
-  } deleteListIterator(ex_i);
-  deleteListWith(exnames, free);
+  const char      *ex = roomGetExitDir(room, exit);
+  char           *dir = (ex ? strdup(ex) : NULL);
 
   // tell us where it would take us
   if(dest && !*exitGetDesc(exit) && !exitIsClosed(exit)) {
@@ -854,7 +1589,19 @@ void room_look_hook(const char *info) {
 // initialization of inform.h
 //*****************************************************************************
 void init_inform(void) {
+  outdoor_chars = newSet();
+  zone_chars    = newHashtable();
+  channels      = newHashtable();
+  channel_groups = newHashtable();
+  channel_logs   = newHashtable();
+
   // attach hooks
+  hookAddArgs("char_to_room",   channel_to_room_hook);
+  hookAddArgs("char_from_room", channel_from_room_hook);
+  hookAddArgs("char_to_game",   channel_to_game_hook);
+  hookAddArgs("char_from_game", channel_from_game_hook);
+  hookAddArgs("user_groups_changed", channel_user_groups_hook);
+  hookAddArgs("room_terrain",   channel_terrain_hook);
   hookAdd("append_exit_desc", exit_append_hook);
   // enable if you want exits to append to the end of room descs
   //  hookAdd("append_room_desc", exit_append_room_hook);
@@ -24,6 +24,7 @@ void init_inform(void);
 #define TO_VICT		(1 << 1) // just to the victim
 #define TO_CHAR		(1 << 2) // just the character
 #define TO_WORLD        (1 << 3) // like TO_ROOM, but to all chars
+#define TO_ZONE         (1 << 4) // like TO_ROOM, but to all chars in the zone
 
 //
 // Send a message out
@@ -62,6 +63,50 @@ void  send_outdoors(const char *format, ...)
 __attribute__ ((format (printf, 1, 2)));
 
 
+//
+// send a message to everyone in a zone, by the zone's key
+//
+void  send_to_zone (const char *zone, const char *format, ...)
+__attribute__ ((format (printf, 2, 3)));
+
+
+//
+// characters can be joined to named channels, and sent messages all at once.
+// Characters leave every channel when they leave the game. Who is outdoors
+// and who is in each zone are kept track of the same way, as characters
+// move; send_outdoors, send_to_zone, and message() (with TO_ZONE) only go
+// through the characters that will get the message
+//
+void  send_to_channel  (const char *channel, const char *format, ...)
+__attribute__ ((format (printf, 2, 3)));
+void  channelJoin      (const char *channel, CHAR_DATA *ch);
+void  channelLeave     (const char *channel, CHAR_DATA *ch);
+bool  channelHasMember (const char *channel, CHAR_DATA *ch);
+LIST *channelGetMembers(const char *channel);
+int   zoneCountOccupants(const char *zone);
+
+//
+// a channel can be kept for a user group (e.g. "wizard"): everyone in the
+// group is on it while they are in the game, and is put on or taken off of
+// it as their groups change. NULL or "" stops keeping it for a group
+void        channelSetGroup(const char *channel, const char *group);
+const char *channelGetGroup(const char *channel);
+
+//
+// message() to everyone on a channel except ch and vict. Each kind of
+// visibility only gets the message built once, however many see it
+void  channelMessage   (const char *channel, CHAR_DATA *ch, CHAR_DATA *vict,
+			OBJ_DATA *obj, OBJ_DATA *vobj, int hide_nosee,
+			const char *mssg);
+
+//
+// channels remember the last channel_history lines added to them, dropping
+// the oldest as new ones come in. channelGetHistory lists them oldest first;
+// the list must be deleted, but not the strings in it
+void  channelAddHistory(const char *channel, const char *mssg);
+LIST *channelGetHistory(const char *channel);
+
+
 //
 // send a message to a list of characters
 //
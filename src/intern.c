@@ -0,0 +1,373 @@
+//*****************************************************************************
+//
+// intern.c
+//
+// global pools of shared, read-only strings. See intern.h for details
+//
+//*****************************************************************************
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "mud.h"
+#include "utils.h"
+#include "intern.h"
+
+
+
+//*****************************************************************************
+// local datastructures, functions, and variables
+//*****************************************************************************
+
+// how many buckets does the pool start out with? Must be a power of 2
+#define INTERN_START_SIZE     1024
+
+typedef struct intern_entry {
+  struct intern_entry *next;  // the next entry in our bucket
+  unsigned long        hash;
+  int              refcount;
+  bool                exact;  // are we in the case-sensitive pool?
+  int             num_words;  // 0 if we are a single keyword
+  const char         **words; // our comma-separated keywords, interned
+  struct keyword_set   *keys; // our keywords split and lowered, for matching
+  char              str[];    // the string itself lives at our end
+} INTERN_ENTRY;
+
+//
+// a keyword list split up for strIsKeyword. The keywords' text is kept
+// lowercase, one after the other, at the end of the set
+typedef struct keyword_set {
+  int            num_keys;
+  struct {
+    int               len;
+    const char      *word;
+  } key[];
+} KEYWORD_SET;
+
+typedef struct intern_pool {
+  INTERN_ENTRY **table;
+  int      num_buckets;
+  int            count;
+} INTERN_POOL;
+
+// the case-insensitive pool, for keys, and the case-sensitive one, for text
+INTERN_POOL intern_pool = { NULL, 0, 0 };
+INTERN_POOL  share_pool = { NULL, 0, 0 };
+int         intern_refs = 0;
+
+// the pools are used by the game thread, and by the threads that parse
+// storage files while the world boots
+pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// a thread that forks must not do so while another thread is in the middle of
+// using the pools, or the child would be left with a lock nobody will ever
+// release. Take the lock while forking, and let go of it on both sides after
+void intern_atfork_prepare(void) {
+  pthread_mutex_lock(&intern_lock);
+}
+
+void intern_atfork_release(void) {
+  pthread_mutex_unlock(&intern_lock);
+}
+
+//
+// find the entry an interned string belongs to
+#define intern_entry_of(ptr)						\
+  ((INTERN_ENTRY *)((char *)(ptr) - offsetof(INTERN_ENTRY, str)))
+
+//
+// string_hash ignores case; shared text needs a hash that doesn't
+unsigned long share_hash(const char *str) {
+  unsigned long hash = 2166136261UL;
+  for(; *str; str++)
+    hash = (hash ^ (unsigned char)*str) * 16777619UL;
+  return hash;
+}
+
+void intern_grow(INTERN_POOL *pool) {
+  int num_buckets = (pool->num_buckets == 0 ? INTERN_START_SIZE :
+		     pool->num_buckets * 2);
+  INTERN_ENTRY **table = calloc(num_buckets, sizeof(INTERN_ENTRY *));
+  int i;
+  for(i = 0; i < pool->num_buckets; i++) {
+    while(pool->table[i] != NULL) {
+      INTERN_ENTRY *entry = pool->table[i];
+      pool->table[i]      = entry->next;
+      int          bucket = entry->hash & (num_buckets - 1);
+      entry->next         = table[bucket];
+      table[bucket]       = entry;
+    }
+  }
+  if(pool->table != NULL)
+    free(pool->table);
+  pool->table       = table;
+  pool->num_buckets = num_buckets;
+}
+
+INTERN_ENTRY *intern_lookup(INTERN_POOL *pool, const char *str,
+			    unsigned long hash) {
+  if(pool->table == NULL)
+    return NULL;
+  INTERN_ENTRY *entry = pool->table[hash & (pool->num_buckets - 1)];
+  for(; entry != NULL; entry = entry->next)
+    if(entry->hash == hash &&
+       (entry->exact ? !strcmp(entry->str, str) : !strcasecmp(entry->str,str)))
+      return entry;
+  return NULL;
+}
+
+//
+// add a new string to a pool. Its reference count starts at 0
+INTERN_ENTRY *intern_add(INTERN_POOL *pool, const char *str,
+			 unsigned long hash) {
+  if(pool->count >= pool->num_buckets)
+    intern_grow(pool);
+  int                 len = strlen(str);
+  INTERN_ENTRY     *entry = malloc(sizeof(INTERN_ENTRY) + len + 1);
+  entry->hash      = hash;
+  entry->refcount  = 0;
+  entry->exact     = (pool == &share_pool);
+  entry->num_words = 0;
+  entry->words     = NULL;
+  entry->keys      = NULL;
+  memcpy(entry->str, str, len + 1);
+  int           bucket = hash & (pool->num_buckets - 1);
+  entry->next      = pool->table[bucket];
+  pool->table[bucket] = entry;
+  pool->count++;
+  return entry;
+}
+
+const char *intern_str(const char *str);
+
+//
+// split an entry up into its comma-separated keywords, the same way
+// is_keyword does
+void intern_split_words(INTERN_ENTRY *entry) {
+  const char *keywords = entry->str;
+  int            count = 0;
+  int              max = 1;
+  entry->words         = malloc(sizeof(char *) * max);
+
+  while(*keywords != '\0') {
+    while(isspace(*keywords) || *keywords == ',')
+      keywords++;
+    if(*keywords == '\0')
+      break;
+    int len = next_letter_in(keywords, ',');
+    if(len == -1)
+      len = strlen(keywords);
+
+    char buf[len + 1];
+    strncpy(buf, keywords, len);
+    buf[len] = '\0';
+    if(count == max) {
+      max *= 2;
+      entry->words = realloc(entry->words, sizeof(char *) * max);
+    }
+    entry->words[count++] = intern_str(buf);
+    keywords += len;
+  }
+  entry->num_words = count;
+}
+
+//
+// the unlocked versions of strIntern and strRelease
+const char *intern_str(const char *str) {
+  if(str == NULL)
+    str = "";
+  unsigned long hash = string_hash(str);
+  INTERN_ENTRY *entry = intern_lookup(&intern_pool, str, hash);
+  if(entry == NULL) {
+    entry = intern_add(&intern_pool, str, hash);
+
+    // keyword lists are split up right away, so that their keywords are in
+    // the pool for anyone who wants to look them up with strInternFind
+    if(strchr(str, ',') || isspace(*str))
+      intern_split_words(entry);
+  }
+  entry->refcount++;
+  intern_refs++;
+  return entry->str;
+}
+
+void intern_release(const char *str) {
+  if(str == NULL)
+    return;
+  INTERN_ENTRY *entry = intern_entry_of(str);
+  intern_refs--;
+  if(--entry->refcount > 0)
+    return;
+
+  // unlink ourself from our bucket
+  INTERN_POOL   *pool = (entry->exact ? &share_pool : &intern_pool);
+  INTERN_ENTRY **link = &pool->table[entry->hash & (pool->num_buckets - 1)];
+  while(*link != entry)
+    link = &(*link)->next;
+  *link = entry->next;
+  pool->count--;
+
+  // let go of our keywords
+  int i;
+  for(i = 0; i < entry->num_words; i++)
+    intern_release(entry->words[i]);
+  if(entry->words != NULL)
+    free(entry->words);
+  if(entry->keys != NULL)
+    free(entry->keys);
+  free(entry);
+}
+
+//
+// split a keyword list up the way is_keyword reads it, but lowercase and
+// without the spaces that trail each keyword
+KEYWORD_SET *keyword_set_make(const char *keywords) {
+  int    len = strlen(keywords), num = 1, i;
+  for(i = 0; i < len; i++)
+    if(keywords[i] == ',')
+      num++;
+
+  KEYWORD_SET *set = malloc(sizeof(KEYWORD_SET) + sizeof(set->key[0]) * num +
+			    len + num);
+  char       *text = (char *)&set->key[num];
+  set->num_keys    = 0;
+
+  while(*keywords != '\0') {
+    while(isspace(*keywords) || *keywords == ',')
+      keywords++;
+    if(*keywords == '\0')
+      break;
+    int key_len = next_letter_in(keywords, ',');
+    if(key_len == -1)
+      key_len = strlen(keywords);
+    int word_len = key_len;
+    while(word_len > 0 && isspace(keywords[word_len - 1]))
+      word_len--;
+
+    set->key[set->num_keys].len  = word_len;
+    set->key[set->num_keys].word = text;
+    set->num_keys++;
+    for(i = 0; i < word_len; i++)
+      *text++ = tolower(keywords[i]);
+    *text++ = '\0';
+    keywords += key_len;
+  }
+  return set;
+}
+
+
+
+//*****************************************************************************
+// implementation of intern.h
+//*****************************************************************************
+void init_intern(void) {
+  pthread_atfork(intern_atfork_prepare, intern_atfork_release,
+		 intern_atfork_release);
+}
+
+const char *strIntern(const char *str) {
+  pthread_mutex_lock(&intern_lock);
+  str = intern_str(str);
+  pthread_mutex_unlock(&intern_lock);
+  return str;
+}
+
+const char *strShare(const char *str) {
+  if(str == NULL)
+    str = "";
+  unsigned long hash = share_hash(str);
+  pthread_mutex_lock(&intern_lock);
+  INTERN_ENTRY *entry = intern_lookup(&share_pool, str, hash);
+  if(entry == NULL)
+    entry = intern_add(&share_pool, str, hash);
+  entry->refcount++;
+  intern_refs++;
+  pthread_mutex_unlock(&intern_lock);
+  return entry->str;
+}
+
+const char *strInternRef(const char *str) {
+  pthread_mutex_lock(&intern_lock);
+  intern_entry_of(str)->refcount++;
+  intern_refs++;
+  pthread_mutex_unlock(&intern_lock);
+  return str;
+}
+
+void strRelease(const char *str) {
+  if(str == NULL)
+    return;
+  pthread_mutex_lock(&intern_lock);
+  intern_release(str);
+  pthread_mutex_unlock(&intern_lock);
+}
+
+const char *strInternFind(const char *str) {
+  unsigned long hash = string_hash(str);
+  pthread_mutex_lock(&intern_lock);
+  INTERN_ENTRY *entry = intern_lookup(&intern_pool, str, hash);
+  pthread_mutex_unlock(&intern_lock);
+  return (entry ? entry->str : NULL);
+}
+
+bool strInternHasWord(const char *list, const char *word) {
+  if(list == NULL || word == NULL || !*word)
+    return FALSE;
+  if(list == word)
+    return TRUE;
+  INTERN_ENTRY *entry = intern_entry_of(list);
+  int i;
+  for(i = 0; i < entry->num_words; i++)
+    if(entry->words[i] == word)
+      return TRUE;
+  return FALSE;
+}
+
+bool strIsKeyword(const char *list, const char *word, bool abbrev_ok) {
+  int word_len = strlen(word), i, j;
+  if(word_len < 1 || list == NULL)
+    return FALSE;
+
+  // only the game thread matches keywords, so the set needs no lock
+  INTERN_ENTRY *entry = intern_entry_of(list);
+  if(entry->keys == NULL)
+    entry->keys = keyword_set_make(entry->str);
+
+  KEYWORD_SET *set = entry->keys;
+  for(i = 0; i < set->num_keys; i++) {
+    if(set->key[i].len < word_len ||
+       (!abbrev_ok && set->key[i].len != word_len))
+      continue;
+    const char *key = set->key[i].word;
+    for(j = 0; j < word_len && key[j] == tolower(word[j]); j++)
+      ;
+    if(j == word_len)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+int strInternNumWords(const char *list) {
+  if(list == NULL || !*list)
+    return 0;
+  INTERN_ENTRY *entry = intern_entry_of(list);
+  return (entry->words != NULL ? entry->num_words : 1);
+}
+
+const char *strInternWord(const char *list, int num) {
+  INTERN_ENTRY *entry = intern_entry_of(list);
+  if(entry->words == NULL)
+    return (num == 0 ? list : NULL);
+  return (num >= 0 && num < entry->num_words ? entry->words[num] : NULL);
+}
+
+int strInternCount(void) {
+  return intern_pool.count + share_pool.count;
+}
+
+int strInternRefs(void) {
+  return intern_refs;
+}
@@ -0,0 +1,90 @@
+#ifndef __INTERN_H
+#define __INTERN_H
+//*****************************************************************************
+//
+// intern.h
+//
+// a global pool of shared, read-only strings. Things like prototype keys,
+// class names, trigger keys, and auxiliary data names get copied onto
+// thousands of characters, objects, and rooms. Rather than each of them
+// having its own strdup'd copy, they can intern the string and all point at
+// the same copy. The pool is case-insensitive: "Guard@town" and "guard@town"
+// intern to the same string (whichever casing was interned first). Interned
+// strings are reference counted; every strIntern or strInternRef must be
+// paired with a strRelease. Because every copy of an interned string is the
+// same pointer, two interned strings are equal (case-insensitively) if and
+// only if their pointers are equal. The pools are locked, so strings can be
+// interned and released from any thread.
+//
+//*****************************************************************************
+
+//
+// makes the pools safe to fork with. Everything that is locked while strings
+// are interned or released has to be locked before the pools are, when we
+// fork, and fork handlers are run in the opposite order they were set up in.
+// So, this must be called before any other module sets up its own
+void init_intern(void);
+
+//
+// returns the pooled copy of str, adding it to the pool if needed. The
+// string's reference count is incremented. NULL is treated like ""
+const char *strIntern(const char *str);
+
+//
+// the same as strIntern, but for text whose case matters, like the names and
+// descriptions of things spawned from a prototype. These go in their own
+// pool, which is case-sensitive; "A coin" and "a coin" are shared separately.
+// Shared strings are released with strRelease like interned ones. Objects,
+// rooms, and mobs keep their text this way, so that a thousand copper coins
+// all hold the same copy of "a copper coin" instead of one each. Setting
+// something's text shares the new value and releases the old, which is as
+// good as copying on write, since shared strings are never changed in place
+const char *strShare(const char *str);
+
+//
+// increments the reference count of an already-interned (or shared) string, and
+// returns it. Handy for listCopyWith
+const char *strInternRef(const char *str);
+
+//
+// decrements the reference count of an interned string, and frees it if
+// this was the last reference. Safe to call on NULL
+void strRelease(const char *str);
+
+//
+// returns the pooled copy of str if one exists, or NULL otherwise. The
+// reference count is not touched; this is for lookups, like seeing if
+// something is an instance of a prototype. If the prototype's key was never
+// interned, nothing can be an instance of it
+const char *strInternFind(const char *str);
+
+//
+// interned strings that are comma-separated keyword lists, like prototype
+// lists, are split into their (also interned) keywords when they are first
+// added to the pool. Returns TRUE if word is one of list's keywords. Both
+// list and word must be interned, so the check is only pointer comparisons.
+// This is the interned equivalent of is_keyword(list, word, FALSE)
+bool strInternHasWord(const char *list, const char *word);
+
+//
+// the equivalent of is_keyword for a keyword list that is interned or shared,
+// like the keywords of chars and objs. The first time a list is matched
+// against, it is split into lowercase keywords that are kept with it, so
+// matching never has to parse the list again. Every char and obj with the
+// same keywords uses the same split
+bool strIsKeyword(const char *list, const char *word, bool abbrev_ok);
+
+//
+// the keywords of an interned keyword list, by number. A list that is a
+// single keyword is its own first and only keyword. Like strInternHasWord,
+// this is only a matter of following pointers
+int   strInternNumWords(const char *list);
+const char *strInternWord(const char *list, int num);
+
+//
+// how many distinct strings are in the pools, and how many references to
+// them are being held
+int strInternCount(void);
+int strInternRefs (void);
+
+#endif // __INTERN_H
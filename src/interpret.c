@@ -13,6 +13,7 @@
 #include "commands.h"
 #include "action.h"
 #include "hooks.h"
+#include "social.h"
 
 
 
@@ -41,8 +42,110 @@
 //*****************************************************************************
 NEAR_MAP *cmd_table = NULL;
 
+//
+// what a word typed by someone in a combination of user groups resolves to in
+// cmd_table, worked out the first time it is typed. The combination's key ->
+// HASHTABLE of word -> CMD_DATA, or CMD_UNRESOLVED if nothing usable matches.
+// Everything is forgotten whenever the command table changes
+HASHTABLE *cmd_resolutions = NULL;
+
+// the most words we'll remember for one combination of user groups. Keeps
+// people typing garbage from growing the cache forever
+#define MAX_CMD_RESOLUTIONS  2048
+
+#define CMD_UNRESOLVED       ((void *)1)
+
+void forget_cmd_resolutions(void) {
+  if(cmd_resolutions != NULL)
+    hashClearWith(cmd_resolutions, deleteHashtable);
+}
+
+//
+// one row of cmdstat: a check, and the command it is on
+typedef struct {
+  const char     *cmd;
+  CMD_CHK_STAT    stat;
+} CMDSTAT_ROW;
+
+//
+// sort checks by how much time they've taken, and then by how often they've
+// been run, most first
+int cmdstat_cmp(CMDSTAT_ROW *a, CMDSTAT_ROW *b) {
+  if(a->stat.total != b->stat.total)
+    return (a->stat.total < b->stat.total ? 1 : -1);
+  return (a->stat.calls < b->stat.calls ? 1 :
+	  (a->stat.calls > b->stat.calls ? -1 : 0));
+}
+
+//
+// show which command checks are run the most, and take the longest
+COMMAND(cmd_cmdstat) {
+  if(!strcasecmp(arg, "on") || !strcasecmp(arg, "off")) {
+    cmdSetProfiling(!strcasecmp(arg, "on"));
+    send_to_char(ch, "Command check profiling is now %s.\r\n", arg);
+    return;
+  }
+
+  bool         reset = !strcasecmp(arg, "reset");
+  if(*arg && !reset) {
+    send_to_char(ch, "Usage: cmdstat [on | off | reset]\r\n");
+    return;
+  }
+
+  BUFFER        *buf = newBuffer(MAX_BUFFER);
+  LIST         *rows = newList();
+  NEAR_ITERATOR *near_i = newNearIterator(cmd_table);
+  const char *abbrev = NULL;
+  CMD_DATA     *data = NULL;
+  int i, count = 0;
+  ITERATE_NEARMAP(abbrev, data, near_i) {
+    if(reset) {
+      cmdResetStats(data);
+      continue;
+    }
+    for(i = 0; i < cmdGetNumChecks(data); i++) {
+      CMDSTAT_ROW *row = malloc(sizeof(CMDSTAT_ROW));
+      row->cmd = cmdGetName(data);
+      cmdGetCheckStat(data, i, &row->stat);
+      if(row->stat.calls > 0)
+	listPut(rows, row);
+      else
+	free(row);
+    }
+  } deleteNearIterator(near_i);
+
+  if(reset)
+    send_to_char(ch, "Command check statistics reset.\r\n");
+  else {
+    bprintf(buf, "Command check profiling is %s.\r\n\r\n",
+	    (cmdGetProfiling() ? "on" : "off"));
+    bprintf(buf, "{c%-12s %-27s %9s %9s %11s %8s %8s{n\r\n", "Command",
+	    "Check", "Calls", "Fails", "Total usec", "Avg usec", "Max usec");
+    listSortWith(rows, cmdstat_cmp);
+    LIST_ITERATOR *row_i = newListIterator(rows);
+    CMDSTAT_ROW     *row = NULL;
+    ITERATE_LIST(row, row_i) {
+      if(count++ >= 30)
+	break;
+      bprintf(buf, "%-12.12s %-27.27s %9lld %9lld %11lld %8lld %8lld\r\n",
+	      row->cmd, row->stat.name, row->stat.calls, row->stat.fails,
+	      row->stat.total,
+	      (row->stat.calls > 0 ? row->stat.total / row->stat.calls : 0),
+	      row->stat.max);
+    } deleteListIterator(row_i);
+
+    if(charGetSocket(ch))
+      page_string(charGetSocket(ch), bufferString(buf));
+    else
+      send_to_char(ch, "%s", bufferString(buf));
+  }
+  deleteBuffer(buf);
+  deleteListWith(rows, free);
+}
+
 void init_commands() {
-  cmd_table = newNearMap();
+  cmd_table       = newNearMap();
+  cmd_resolutions = newHashtable();
 
   //***************************************************************************
   // This is for core functions ONLY! If you have a module that adds new
@@ -50,9 +153,13 @@ void init_commands() {
   // associated with your module.
   //***************************************************************************
   add_cmd("back",       NULL, cmd_back,        "player", FALSE);
+  add_cmd("cmdstat",    NULL, cmd_cmdstat,     "admin",  FALSE);
   add_cmd("commands",   NULL, cmd_commands,    "player", FALSE);
   add_cmd("compress",   NULL, cmd_compress,    "player", FALSE);
+  add_cmd("compressstat", NULL, cmd_compressstat, "admin", FALSE);
   add_cmd("groupcmds",  NULL, cmd_groupcmds,   "player", FALSE);
+  add_cmd("inputstat",  NULL, cmd_inputstat,   "admin",  FALSE);
+  add_cmd("outputstat", NULL, cmd_outputstat,  "admin",  FALSE);
   add_cmd("look",       "l",  cmd_look,        "player", FALSE);
   add_cmd("more",       NULL, cmd_more,        "player", FALSE);
   add_cmd_check("look",        chk_conscious);
@@ -63,6 +170,7 @@ bool cmd_exists(const char *cmd) {
 }
 
 CMD_DATA *remove_cmd(const char *cmd) {
+  forget_cmd_resolutions();
   return nearMapRemove(cmd_table, cmd);
 }
 
@@ -103,6 +211,7 @@ void add_py_cmd(const char *cmd, const char *sort_by, void *pyfunc,
 }
 
 void add_cmd_check(const char *cmd, CMD_CHK(func)) {
+  forget_cmd_resolutions();
   CMD_DATA *data = nearMapGet(cmd_table, cmd, FALSE);
 
   // make a temp container for just the checks
@@ -115,6 +224,7 @@ void add_cmd_check(const char *cmd, CMD_CHK(func)) {
 }
 
 void add_py_cmd_check(const char *cmd, void *pyfunc) {
+  forget_cmd_resolutions();
   CMD_DATA *data = nearMapGet(cmd_table, cmd, FALSE);
 
   // make a temp container just for the checks
@@ -165,14 +275,21 @@ void show_commands(CHAR_DATA *ch, const char *user_groups) {
   deleteBuffer(buf);
 }
 
+//
+// is the character in the command's user group? Groups are single bits, so
+// this is one lookup instead of turning the character's groups into a string
+// and looking through it
+bool in_cmd_group(CHAR_DATA *ch, CMD_DATA *cmd) {
+  return bitIsOneSet(charGetUserGroups(ch), cmdGetUserGroup(cmd));
+}
+
 //
 // return whether the command is usable by the character
 bool is_usable_cmd(CHAR_DATA *ch, CMD_DATA *cmd) {
   // this is a check, not a command
   if(*cmdGetUserGroup(cmd) == '\0')
     return FALSE;
-  return is_keyword(bitvectorGetBits(charGetUserGroups(ch)),
-		    cmdGetUserGroup(cmd), FALSE);
+  return in_cmd_group(ch, cmd);
 }
 
 //
@@ -189,56 +306,64 @@ CMD_DATA *find_check(CHAR_DATA *ch, NEAR_MAP *table, const char *name) {
   return check;
 }
 
+//
+// what we're looking for when we go through a table's abbreviations
+typedef struct {
+  CHAR_DATA     *ch;
+  const char  *name; // when set, skip commands with exactly this name
+  CMD_DATA     *cmd; // the first usable command we found
+  bool    checks_ok; // do commands without a user group count as usable?
+} CMD_MATCH;
+
+bool find_cmd_match(const char *key, CMD_DATA *cmd, CMD_MATCH *match) {
+  if(match->name != NULL && !strcasecmp(key, match->name))
+    return TRUE;
+  if((match->checks_ok && !*cmdGetUserGroup(cmd)) || 
+     (*cmdGetUserGroup(cmd) && in_cmd_group(match->ch, cmd))) {
+    match->cmd = cmd;
+    return FALSE;
+  }
+  return TRUE;
+}
+
 //
 // tries to find the relevant command, usable by the character
 CMD_DATA *find_cmd(CHAR_DATA *ch, NEAR_MAP *table, const char *name, 
 		   bool abbrev_ok) {
-  if(abbrev_ok == FALSE) {
-    CMD_DATA *cmd = nearMapGet(table, name, FALSE);
-    // no command exists
-    if(cmd == NULL || !is_usable_cmd(ch, cmd))
-      return NULL;
+  // exact matches always come first
+  CMD_DATA *cmd = nearMapGet(table, name, FALSE);
+  if(cmd != NULL && is_usable_cmd(ch, cmd))
     return cmd;
-  }
+  else if(abbrev_ok == FALSE)
+    return NULL;
   else {
-    // try to look up the possible commands
-    LIST *cmdname_list = nearMapGetAllMatches(table, name);
-    CMD_DATA  *cmd = NULL;
-    if(cmdname_list != NULL) {
-      LIST_ITERATOR *cmdname_i = newListIterator(cmdname_list);
-      const char      *cmdname = NULL;
-      
-      // First pass: look for exact matches
-      ITERATE_LIST(cmdname, cmdname_i) {
-        if(strcasecmp(cmdname, name) == 0) {  // exact match
-          cmd = nearMapGet(table, cmdname, FALSE);
-          if(is_usable_cmd(ch, cmd))
-            break;
-          else
-            cmd = NULL;
-        }
-      }
-      
-      // Second pass: if no exact match found, use partial matches
-      if(cmd == NULL) {
-        deleteListIterator(cmdname_i);
-        cmdname_i = newListIterator(cmdname_list);
-        ITERATE_LIST(cmdname, cmdname_i) {
-          if(strcasecmp(cmdname, name) != 0) {  // partial match only
-            cmd = nearMapGet(table, cmdname, FALSE);
-            if(is_usable_cmd(ch, cmd))
-              break;
-            else
-              cmd = NULL;
-          }
-        }
-      }
-      
-      deleteListIterator(cmdname_i);
-      deleteListWith(cmdname_list, free);
-    }
-    return cmd;
+    // then, the best usable abbreviation
+    CMD_MATCH match = { ch, name, NULL, FALSE };
+    nearMapForeachMatch(table, name, (void *)find_cmd_match, &match);
+    return match.cmd;
+  }
+}
+
+//
+// find_cmd for the game's command table, with abbreviations. What people in
+// the same user groups get for the same word never changes until the table
+// does, so we only ever look it up once
+CMD_DATA *resolve_cmd(CHAR_DATA *ch, const char *name) {
+  const char    *key = bitvectorGetKey(charGetUserGroups(ch));
+  HASHTABLE *words = hashGet(cmd_resolutions, key);
+  if(words == NULL) {
+    words = newHashtable();
+    hashPut(cmd_resolutions, key, words);
+  }
+
+  CMD_DATA *cmd = hashGet(words, name);
+  if(cmd == NULL) {
+    cmd = find_cmd(ch, cmd_table, name, TRUE);
+    if(hashSize(words) >= MAX_CMD_RESOLUTIONS)
+      hashClear(words);
+    hashPut(words, name, (cmd == NULL ? CMD_UNRESOLVED : cmd));
   }
+  return (cmd == CMD_UNRESOLVED ? NULL : cmd);
 }
 
 // tries to pull a usable command from the near-table and use it. Returns
@@ -249,9 +374,7 @@ bool try_use_cmd_table(CHAR_DATA *ch, NEAR_MAP *table, const char *command,
     CMD_DATA *cmd = nearMapGet(table, command, FALSE);
     if(cmd == NULL)
       return FALSE;
-    else if(!*cmdGetUserGroup(cmd) || 
-	    is_keyword(bitvectorGetBits(charGetUserGroups(ch)),
-		       cmdGetUserGroup(cmd), FALSE)) {
+    else if(!*cmdGetUserGroup(cmd) || in_cmd_group(ch, cmd)) {
       if(charTryCmd(ch, cmd, arg) == -1)
 	return FALSE;
       return TRUE;
@@ -260,26 +383,11 @@ bool try_use_cmd_table(CHAR_DATA *ch, NEAR_MAP *table, const char *command,
       return FALSE;
   }
   else {
-    // try to look up the possible commands
-    LIST *cmdname_list = nearMapGetAllMatches(table, command);
-    bool           ret = FALSE;
-    if(cmdname_list != NULL) {
-      LIST_ITERATOR *cmdname_i = newListIterator(cmdname_list);
-      CMD_DATA            *cmd = NULL;
-      const char      *cmdname = NULL;
-      ITERATE_LIST(cmdname, cmdname_i) {
-	cmd = nearMapGet(table, cmdname, FALSE);
-	if(!*cmdGetUserGroup(cmd) ||
-	   is_keyword(bitvectorGetBits(charGetUserGroups(ch)), 
-		      cmdGetUserGroup(cmd), FALSE)) {
-	  if(charTryCmd(ch, cmd, arg) != -1)
-	    ret = TRUE;
-	  break;
-	}
-      } deleteListIterator(cmdname_i);
-      deleteListWith(cmdname_list, free);
-    }
-    return ret;
+    // try to look up the best usable command. We don't try it until we're
+    // done looking; commands are allowed to change the table
+    CMD_MATCH match = { ch, NULL, NULL, TRUE };
+    nearMapForeachMatch(table, command, (void *)find_cmd_match, &match);
+    return (match.cmd != NULL && charTryCmd(ch, match.cmd, arg) != -1);
   }
 }
 
@@ -322,14 +430,23 @@ void do_cmd(CHAR_DATA *ch, char *arg, bool aliases_ok)  {
     return;
 #endif
 
+  // everything we make from the scratch arena while handling this command
+  // (and anything the command itself makes there) is let go of at the end
+  ARENA_MARK scratch_mark = arenaMark(scratch_arena());
+
+  // whatever happened since the last command may have changed what can be
+  // seen, in ways nothing told us about
+  sightChanged();
+
   // figure out what tables we need to look over
-  LIST *cmd_tables = newList();
+  NEAR_MAP *cmd_tables[2];
+  int   num_cmd_tables = 0;
   // item-specific commands here? <---
   // character-specific commands here? <---
   if(charGetRoom(ch) && roomHasCmds(charGetRoom(ch)))
-    listQueue(cmd_tables, roomGetCmdTable(charGetRoom(ch)));
+    cmd_tables[num_cmd_tables++] = roomGetCmdTable(charGetRoom(ch));
   // zone-specific commands here? <---
-  listQueue(cmd_tables, cmd_table);
+  cmd_tables[num_cmd_tables++] = cmd_table;
 
   // go through each table in the list, in order. Check if the command exists
   // in any of the tables. Only allow abbreviations in the last table (the
@@ -337,20 +454,20 @@ void do_cmd(CHAR_DATA *ch, char *arg, bool aliases_ok)  {
   // included on any of the previous tables
   int  i, j, ret;
   bool found = FALSE;
-  for(i = 0; i < listSize(cmd_tables); i++) {
-    NEAR_MAP *table = listGet(cmd_tables, i);
-    CMD_DATA   *cmd = find_cmd(ch, table, command, 
-			       (i == listSize(cmd_tables)-1 ? TRUE : FALSE));
+  for(i = 0; i < num_cmd_tables; i++) {
+    NEAR_MAP *table = cmd_tables[i];
+    CMD_DATA   *cmd = (table == cmd_table ? resolve_cmd(ch, command) :
+		       find_cmd(ch, table, command, FALSE));
     if(cmd != NULL) {
       // first, run checks on all our previous tables
       for(j = 0; j < i; j++) {
-	CMD_DATA *check = find_check(ch,listGet(cmd_tables,j),cmdGetName(cmd));
+	CMD_DATA *check = find_check(ch, cmd_tables[j], cmdGetName(cmd));
 	if(check != NULL) {
 	  // run the check
 	  if((ret = charTryCmd(ch, check, arg)) != -1) {
 	    if(ret == TRUE)
-	      hookRun("command", hookBuildInfo("ch str str",
-					       ch,cmdGetName(cmd),arg));
+	      hookRunArgs("command", "ch str str",
+					       ch,cmdGetName(cmd),arg);
  	    found = TRUE;
 	    break;
 	  }
@@ -362,29 +479,38 @@ void do_cmd(CHAR_DATA *ch, char *arg, bool aliases_ok)  {
       break;
     else if(cmd != NULL) {
       // run pre_command hook before executing the command
-      hookRun("pre_command", hookBuildInfo("ch str str int", ch, cmdGetName(cmd), arg, 1));
-      if(charGetInt(ch, "pc_block_command")) {
-        // trigger set block flag, skip normal execution and reset flag
-        charSetInt(ch, "pc_block_command", 0);
+      if(run_pre_command(ch, cmdGetName(cmd), arg, TRUE)) {
+        // a trigger handled the command, skip normal execution
         found = TRUE;
         break;
       }
       // execute the command
       if((ret = charTryCmd(ch, cmd, arg)) != -1) {
 	if(ret == TRUE)
-	  hookRun("command",hookBuildInfo("ch str str",ch,cmdGetName(cmd),arg));
+	  hookRunArgs("command","ch str str",ch,cmdGetName(cmd),arg);
 	found = TRUE;
 	break;
       }
     }
   }
 
+  // socials go by words nothing else does. Like any command, triggers get to
+  // see them first. What they do may change the socials, so keep our own copy
+  // of the name
+  const char *social = (found ? NULL : socialGetCmd(command));
+  if(social != NULL) {
+    char social_cmd[SMALL_BUFFER];
+    snprintf(social_cmd, sizeof(social_cmd), "%s", social);
+    found = TRUE;
+    if(!run_pre_command(ch, social_cmd, arg, TRUE) &&
+       socialPerform(ch, social_cmd, arg))
+      hookRunArgs("command", "ch str str", ch, social_cmd, arg);
+  }
+
   // nothing usable was found - try pre_command hook for unknown commands
   if(found == FALSE) {
-    hookRun("pre_command", hookBuildInfo("ch str str int", ch, command, arg, 0));
-    if(charGetInt(ch, "pc_block_command")) {
-      // trigger set block flag, handled the unknown command and reset flag
-      charDeleteVar(ch, "pc_block_command");
+    if(run_pre_command(ch, command, arg, FALSE)) {
+      // a trigger handled the unknown command
       found = TRUE;
     } else {
       text_to_char(ch, "No such command.\r\n");
@@ -392,7 +518,7 @@ void do_cmd(CHAR_DATA *ch, char *arg, bool aliases_ok)  {
   }
 
   // garbage collection
-  deleteList(cmd_tables);
+  arenaRelease(scratch_arena(), scratch_mark);
 
   /*
   // try the command
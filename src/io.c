@@ -13,6 +13,7 @@
 /* include main header file */
 #include "mud.h"
 #include "utils.h"
+#include "log_queue.h"
 
 //extern FILE *stderr;
 time_t current_time;
@@ -25,7 +26,6 @@ time_t current_time;
  */
 void log_string(const char *txt, ...)
 {
-  FILE *fp;
   char logfile[MAX_BUFFER];
   char buf[MAX_BUFFER];
   char *strtime = get_time();
@@ -38,21 +38,10 @@ void log_string(const char *txt, ...)
   /* point to the correct logfile */
   snprintf(logfile, MAX_BUFFER, "../log/%6.6s.log", strtime);
 
-  /* try to open logfile */
-  if ((fp = fopen(logfile, "a")) == NULL)
-  {
-    communicate(NULL, "log: cannot open logfile", COMM_LOG);
-    return;
-  }
-
-  fprintf(fp, "%s: %s\n", strtime, buf);
-  fclose(fp);
-
-  /* output to terminal unless in silent mode */
-  if (!silent_mode) {
-    printf("%s: %s\n", strtime, buf);
-    fflush(stdout);
-  }
+  /* the log writer puts it in the file, and on the terminal */
+  logQueuePut(logfile, "log", buf,
+	      LOGQ_NEWLINE | LOGQ_COLLAPSE | LOGQ_STRUCTURED |
+	      (silent_mode ? 0 : LOGQ_STDOUT));
 
   communicate(NULL, buf, COMM_LOG);
 }
@@ -65,30 +54,17 @@ void log_string(const char *txt, ...)
  */
 void bug(const char *txt, ...)
 {
-  FILE *fp;
   char buf[MAX_BUFFER];
   va_list args;
-  char *strtime = get_time();
 
   va_start(args, txt);
   vsnprintf(buf, MAX_BUFFER, txt, args);
   va_end(args);
 
-  /* try to open logfile */
-  if ((fp = fopen("../log/bugs.txt", "a")) == NULL)
-  {
-    communicate(NULL, "bug: cannot open bugfile", COMM_LOG);
-    return;
-  }
-
-  fprintf(fp, "%s: %s\n", strtime, buf);
-  fclose(fp);
-
-  /* output to terminal unless in silent mode */
-  if (!silent_mode) {
-    fprintf(stderr, "BUG %s: %s\n", strtime, buf);
-    fflush(stderr);
-  }
+  /* the log writer puts it in the file, and on the terminal */
+  logQueuePut("../log/bugs.txt", "bug", buf,
+	      LOGQ_NEWLINE | LOGQ_COLLAPSE | LOGQ_STRUCTURED |
+	      (silent_mode ? 0 : LOGQ_STDERR));
 
   communicate(NULL, buf, COMM_LOG);
 }
@@ -44,6 +44,9 @@ typedef struct container_data {
   bool   locked;
 } CONTAINER_DATA;
 
+// our item type id
+int container_type = -1;
+
 CONTAINER_DATA *newContainerData() {
   CONTAINER_DATA *data = malloc(sizeof(CONTAINER_DATA));
   data->capacity  = 0;
@@ -98,63 +101,63 @@ CONTAINER_DATA *containerDataRead(STORAGE_SET *set) {
 // functions for interacting with containers
 //*****************************************************************************
 double containerGetCapacity(OBJ_DATA *obj) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   return data->capacity;
 }
 
 void containerSetCapacity(OBJ_DATA *obj, double capacity) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   data->capacity = capacity;
 }
 
 bool containerIsClosable (OBJ_DATA *obj) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   return data->closable;
 }
 
 bool containerIsClosed   (OBJ_DATA *obj) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   return data->closed;
 }
 
 bool containerIsLocked   (OBJ_DATA *obj) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   return data->locked;
 }
 
 const char *containerGetKey(OBJ_DATA *obj) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   return data->key;
 }
 
 int  containerGetPicKDiff(OBJ_DATA *obj) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   return data->pick_diff;
 }
 
 void containerSetClosed  (OBJ_DATA *obj, bool closed) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   data->closed = closed;
 }
 
 void   containerSetClosable(OBJ_DATA *obj, bool closable) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   data->closable = closable;
 }
 
 void containerSetLocked  (OBJ_DATA *obj, bool locked) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   data->locked = locked;
 }
 
 void containerSetKey(OBJ_DATA *obj, const char *key) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   if(data->key) free(data->key);
   data->key = strdup(key);
 }
 
 void containerSetPickDiff(OBJ_DATA *obj, int  diff) {
-  CONTAINER_DATA *data = objGetTypeData(obj, "container");
+  CONTAINER_DATA *data = objGetTypeDataId(obj, container_type);
   data->pick_diff = diff;
 }
 
@@ -234,7 +237,7 @@ PyObject *PyObj_getcontainercapacity(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "container"))
+  else if(objIsTypeId(obj, container_type))
     return Py_BuildValue("d", containerGetCapacity(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get capacity for container.");
@@ -249,7 +252,7 @@ int PyObj_setcontainercapacity(PyObject *self, PyObject *value, void *closure) {
 		 "container, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "container")) {
+  else if(!objIsTypeId(obj, container_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set capacity for non-container, %s",
 		 objGetClass(obj));
     return -1;
@@ -268,7 +271,7 @@ PyObject *PyObj_getcontainerkey(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "container"))
+  else if(objIsTypeId(obj, container_type))
     return Py_BuildValue("s", containerGetKey(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get keys for containers.");
@@ -284,7 +287,7 @@ int PyObj_setcontainerkey(PyObject *self, PyObject *value, void *closure) {
 		 "container, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "container")) {
+  else if(!objIsTypeId(obj, container_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set key for non-container, %s",
 		 objGetClass(obj));
     return -1;
@@ -316,7 +319,7 @@ int PyObj_setcontainerkey(PyObject *self, PyObject *value, void *closure) {
 PyObject *PyObj_getcontainerclosable(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL) return NULL;
-  else if(objIsType(obj, "container"))
+  else if(objIsTypeId(obj, container_type))
     return Py_BuildValue("i", containerIsClosable(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only check if containers are closable.");
@@ -327,7 +330,7 @@ PyObject *PyObj_getcontainerclosable(PyObject *self, void *closure) {
 PyObject *PyObj_getcontainerclosed  (PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL) return NULL;
-  else if(objIsType(obj, "container"))
+  else if(objIsTypeId(obj, container_type))
     return Py_BuildValue("i", containerIsClosed(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only check if containers are closed.");
@@ -338,7 +341,7 @@ PyObject *PyObj_getcontainerclosed  (PyObject *self, void *closure) {
 PyObject *PyObj_getcontainerlocked  (PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL) return NULL;
-  else if(objIsType(obj, "container"))
+  else if(objIsTypeId(obj, container_type))
     return Py_BuildValue("i", containerIsLocked(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only check if containers are locked.");
@@ -349,7 +352,7 @@ PyObject *PyObj_getcontainerlocked  (PyObject *self, void *closure) {
 PyObject *PyObj_getcontainerpickdiff(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL) return NULL;
-  else if(objIsType(obj, "container"))
+  else if(objIsTypeId(obj, container_type))
     return Py_BuildValue("i", containerGetPicKDiff(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only check pick diffs on containers.");
@@ -364,7 +367,7 @@ int PyObj_setcontainerpickdiff(PyObject *self, PyObject *value, void *closure) {
 		 "container, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "container")) {
+  else if(!objIsTypeId(obj, container_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set pick for non-container, %s",
 		 objGetClass(obj));
     return -1;
@@ -386,7 +389,7 @@ int PyObj_setcontainerclosable(PyObject *self, PyObject *value, void *closure) {
 		 "container, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "container")) {
+  else if(!objIsTypeId(obj, container_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set closable for non-container, %s",
 		 objGetClass(obj));
     return -1;
@@ -412,7 +415,7 @@ int PyObj_setcontainerclosed  (PyObject *self, PyObject *value, void *closure) {
 		 "container, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "container")) {
+  else if(!objIsTypeId(obj, container_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set closed for non-container, %s",
 		 objGetClass(obj));
     return -1;
@@ -438,7 +441,7 @@ int PyObj_setcontainerlocked  (PyObject *self, PyObject *value, void *closure) {
 		 "container, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "container")) {
+  else if(!objIsTypeId(obj, container_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set locked for non-container, %s",
 		 objGetClass(obj));
     return -1;
@@ -478,7 +481,7 @@ void container_append_hook(const char *info) {
   CHAR_DATA *ch = NULL;
   hookParseInfo(info, &obj, &ch);
 
-  if(objIsType(obj, "container")) {
+  if(objIsTypeId(obj, container_type)) {
     bprintf(charGetLookBuffer(ch), " It is %s%s.", 
 	    (containerIsClosed(obj) ? "closed":"open"),
 	    (containerIsLocked(obj) ? " and locked" : ""));
@@ -490,7 +493,7 @@ void container_look_hook(const char *info) {
   CHAR_DATA *ch = NULL;
   hookParseInfo(info, &obj, &ch);
 
-  if(objIsType(obj, "container") && !containerIsClosed(obj)) {
+  if(objIsTypeId(obj, container_type) && !containerIsClosed(obj)) {
     LIST *vis_contents = find_all_objs(ch, objGetContents(obj), "", 
 				       NULL, TRUE);
       // make sure we can still see things
@@ -515,6 +518,7 @@ void init_container(void) {
   		newContainerData, deleteContainerData,
   		containerDataCopyTo, containerDataCopy, 
   		containerDataStore, containerDataRead);
+  container_type = itemTypeGetId("container");
 
   // add our hooks
   hookAdd("append_obj_desc", container_append_hook);
@@ -39,6 +39,9 @@ typedef struct furniture_data {
   int type;
 } FURNITURE_DATA;
 
+// our item type id
+int furniture_type = -1;
+
 FURNITURE_DATA *newFurnitureData() {
   FURNITURE_DATA *data = malloc(sizeof(FURNITURE_DATA));
   data->capacity  = 0;
@@ -80,22 +83,22 @@ FURNITURE_DATA *furnitureDataRead(STORAGE_SET *set) {
 // functions for interacting with furnitures
 //*****************************************************************************
 int furnitureGetCapacity(OBJ_DATA *obj) {
-  FURNITURE_DATA *data = objGetTypeData(obj, "furniture");
+  FURNITURE_DATA *data = objGetTypeDataId(obj, furniture_type);
   return data->capacity;
 }
 
 void furnitureSetCapacity(OBJ_DATA *obj, int capacity) {
-  FURNITURE_DATA *data = objGetTypeData(obj, "furniture");
+  FURNITURE_DATA *data = objGetTypeDataId(obj, furniture_type);
   data->capacity = capacity;
 }
 
 int furnitureGetType(OBJ_DATA *obj) {
-  FURNITURE_DATA *data = objGetTypeData(obj, "furniture");
+  FURNITURE_DATA *data = objGetTypeDataId(obj, furniture_type);
   return data->type;
 }  
 
 void furnitureSetType(OBJ_DATA *obj, int type) {
-  FURNITURE_DATA *data = objGetTypeData(obj, "furniture");
+  FURNITURE_DATA *data = objGetTypeDataId(obj, furniture_type);
   data->type = type;
 }  
 
@@ -183,7 +186,7 @@ PyObject *PyObj_getfurncapacity(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "furniture"))
+  else if(objIsTypeId(obj, furniture_type))
     return Py_BuildValue("i", furnitureGetCapacity(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get capacity for furniture.");
@@ -198,7 +201,7 @@ int PyObj_setfurncapacity(PyObject *self, PyObject *value, void *closure) {
 		 "furniture, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "furniture")) {
+  else if(!objIsTypeId(obj, furniture_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set capacity for non-furniture, %s",
 		 objGetClass(obj));
     return -1;
@@ -217,7 +220,7 @@ PyObject *PyObj_getfurntype(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "furniture"))
+  else if(objIsTypeId(obj, furniture_type))
     return Py_BuildValue("s", furnitureTypeGetName(furnitureGetType(obj)));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get furniture type for furniture.");
@@ -232,7 +235,7 @@ int PyObj_setfurntype(PyObject *self, PyObject *value, void *closure) {
 		 "nonexistent furniture, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "furniture")) {
+  else if(!objIsTypeId(obj, furniture_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set furniture type for "
 		 "non-furniture, %s", objGetClass(obj));
     return -1;
@@ -262,7 +265,7 @@ void furniture_append_hook(const char *info) {
   CHAR_DATA *ch = NULL;
   hookParseInfo(info, &obj, &ch);
 
-  if(objIsType(obj, "furniture")) {
+  if(objIsTypeId(obj, furniture_type)) {
     int num_sitters = listSize(objGetUsers(obj));
 
     // print out how much room there is left on the furniture
@@ -302,6 +305,7 @@ void init_furniture(void) {
   		newFurnitureData, deleteFurnitureData,
   		furnitureDataCopyTo, furnitureDataCopy, 
   		furnitureDataStore, furnitureDataRead);
+  furniture_type = itemTypeGetId("furniture");
 
   // add our hooks
   hookAdd("append_obj_desc", furniture_append_hook);
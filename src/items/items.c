@@ -19,6 +19,7 @@
 #include "../auxiliary.h"
 #include "../storage.h"
 #include "../hooks.h"
+#include "../intern.h"
 
 #include "items.h"
 #include "iedit.h"
@@ -39,9 +40,19 @@
 //*****************************************************************************
 // local functions, datastructures, and defines
 //*****************************************************************************
-// a table of all our item types, and their assocciated new/delete/etc.. funcs
+// the most item types we can have. Each one gets a bit in an object's mask
+#define MAX_ITEM_TYPES       64
+
+// which item types an object has, one bit per type id
+typedef unsigned long long ITEM_TYPE_MASK;
+#define ITEM_TYPE_BIT(id)    (((ITEM_TYPE_MASK)1) << (id))
+
+// maps the name of an item type to its id, plus one
 HASHTABLE *type_table = NULL;
 
+// the auxiliary slot an object's item types are kept in
+int type_data_slot = -1;
+
 #define ITYPE_C   0
 #define ITYPE_PY  1
 
@@ -169,50 +180,37 @@ void deleteItemFuncData(ITEM_FUNC_DATA *data) {
 }
 
 //
-// goes through an object's item table and deletes everything in it. Does
-// not delete the table itself
-void clearItemTable(HASHTABLE *table) {
-  // if our hashtable isn't empty, we have to make sure 
-  // we delete all of the data within it
-  if(hashSize(table) > 0) {
-    HASH_ITERATOR *hash_i = newHashIterator(table);
-    const char       *key = NULL;
-    void             *val = NULL;
-    // delete the contents of our hashtable
-    ITERATE_HASH(key, val, hash_i) {
-      ITEM_FUNC_DATA *funcs = hashGet(type_table, key);
-      ifunc_delete(funcs, hashRemove(table, key));
-    }
-    deleteHashIterator(hash_i);
-  }
-}
+// every item type we have, by id. Ids are handed out in the order types are
+// added, and a type that is added again keeps the id it had
+typedef struct item_type {
+  char           *name;
+  ITEM_FUNC_DATA *funcs;
+} ITEM_TYPE;
+
+ITEM_TYPE item_types[MAX_ITEM_TYPES];
+int   num_item_types = 0;
 
 //
-// copies the contents of one item table over to another. clears the destination
-// table first.
-void copyItemTableTo(HASHTABLE *from, HASHTABLE *to) {
-  clearItemTable(to);
-  // if the table we're copying has contents, go throug hand copy them all
-  if(hashSize(from) > 0) {
-    HASH_ITERATOR *hash_i = newHashIterator(from);
-    const char       *key = NULL;
-    void             *val = NULL;
-    // copy all the contents
-    ITERATE_HASH(key, val, hash_i) {
-      ITEM_FUNC_DATA *funcs = hashGet(type_table, key);
-      hashPut(to, key, ifunc_copy(funcs, val));
+// set the functions for an item type, giving it an id if it is new. Returns
+// the type's id, or -1 if there is no room for more types
+int item_type_put(const char *type, ITEM_FUNC_DATA *funcs) {
+  int id = (int)(long)hashGet(type_table, type) - 1;
+  if(id < 0) {
+    if(num_item_types >= MAX_ITEM_TYPES) {
+      log_string("ERROR: cannot add item type %s; there are already %d.",
+		 type, MAX_ITEM_TYPES);
+      deleteItemFuncData(funcs);
+      return -1;
     }
-    deleteHashIterator(hash_i);
+    id = num_item_types++;
+    item_types[id].name = strdup(type);
+    hashPut(type_table, type, (void *)(long)(id + 1));
   }
-}
-
-//
-// Creates a new item table and copies the contents of the old one 
-// over to the new one 
-HASHTABLE *copyItemTable(HASHTABLE *table) {
-  HASHTABLE *newtable = newHashtable();
-  copyItemTableTo(table, newtable);
-  return newtable;
+  // if a type by this name already exists, replace its functions
+  else if(item_types[id].funcs != NULL)
+    deleteItemFuncData(item_types[id].funcs);
+  item_types[id].funcs = funcs;
+  return id;
 }
 
 
@@ -221,23 +219,99 @@ HASHTABLE *copyItemTable(HASHTABLE *table) {
 // auxiliary data
 //*****************************************************************************
 typedef struct item_data {
-  HASHTABLE *item_table;
+  ITEM_TYPE_MASK types;     // which item types we are
+  void         **data;      // our type data, one for each bit in types
+  const char    *type_list; // the names of our types, once someone asks
 } ITEM_DATA;
 
+//
+// where an item type's data would be in our data array. Types are kept in
+// order of their ids, so it is the number of our types with lower ids
+int item_data_pos(ITEM_DATA *data, int id) {
+  return __builtin_popcountll(data->types & (ITEM_TYPE_BIT(id) - 1));
+}
+
+void *item_data_get(ITEM_DATA *data, int id) {
+  if(id < 0 || !(data->types & ITEM_TYPE_BIT(id)))
+    return NULL;
+  return data->data[item_data_pos(data, id)];
+}
+
+//
+// add type data for an item type we are not already
+void item_data_put(ITEM_DATA *data, int id, void *type_data) {
+  int num = __builtin_popcountll(data->types);
+  int pos = item_data_pos(data, id);
+  data->data = realloc(data->data, sizeof(void *) * (num + 1));
+  memmove(data->data + pos + 1, data->data + pos, sizeof(void *) * (num-pos));
+  data->data[pos] = type_data;
+  data->types    |= ITEM_TYPE_BIT(id);
+  if(data->type_list != NULL) {
+    strRelease(data->type_list);
+    data->type_list = NULL;
+  }
+}
+
+//
+// remove an item type from us, and return its data
+void *item_data_remove(ITEM_DATA *data, int id) {
+  if(id < 0 || !(data->types & ITEM_TYPE_BIT(id)))
+    return NULL;
+  int        num = __builtin_popcountll(data->types);
+  int        pos = item_data_pos(data, id);
+  void *type_data = data->data[pos];
+  memmove(data->data + pos, data->data + pos + 1, sizeof(void *)*(num-pos-1));
+  data->types &= ~ITEM_TYPE_BIT(id);
+  if(data->type_list != NULL) {
+    strRelease(data->type_list);
+    data->type_list = NULL;
+  }
+  return type_data;
+}
+
+//
+// delete all of our type data, leaving us with no item types
+void item_data_clear(ITEM_DATA *data) {
+  ITEM_TYPE_MASK types = data->types;
+  int              pos = 0;
+  for(; types != 0; types &= types - 1, pos++) {
+    int id = __builtin_ctzll(types);
+    ifunc_delete(item_types[id].funcs, data->data[pos]);
+  }
+  if(data->data != NULL)
+    free(data->data);
+  if(data->type_list != NULL)
+    strRelease(data->type_list);
+  data->types     = 0;
+  data->data      = NULL;
+  data->type_list = NULL;
+}
+
 ITEM_DATA *newItemData() {
-  ITEM_DATA *data  = malloc(sizeof(ITEM_DATA));
-  data->item_table = newHashtable();
+  ITEM_DATA *data = calloc(1, sizeof(ITEM_DATA));
   return data;
 }
 
 void deleteItemData(ITEM_DATA *data) {
-  clearItemTable(data->item_table);
-  deleteHashtable(data->item_table);
+  item_data_clear(data);
   free(data);
 }
 
 void itemDataCopyTo(ITEM_DATA *from, ITEM_DATA *to) {
-  copyItemTableTo(from->item_table, to->item_table);
+  item_data_clear(to);
+  int num = __builtin_popcountll(from->types);
+  if(num > 0) {
+    ITEM_TYPE_MASK types = from->types;
+    int              pos = 0;
+    to->data = malloc(sizeof(void *) * num);
+    for(; types != 0; types &= types - 1, pos++) {
+      int id = __builtin_ctzll(types);
+      to->data[pos] = ifunc_copy(item_types[id].funcs, from->data[pos]);
+    }
+  }
+  to->types = from->types;
+  if(from->type_list != NULL)
+    to->type_list = strInternRef(from->type_list);
 }
 
 ITEM_DATA *itemDataCopy(ITEM_DATA *data) {
@@ -249,22 +323,20 @@ ITEM_DATA *itemDataCopy(ITEM_DATA *data) {
 STORAGE_SET *itemDataStore(ITEM_DATA *data) {
   STORAGE_SET       *set = new_storage_set();
   // if we have a type or more, go through them all and store 'em
-  if(hashSize(data->item_table) > 0) {
+  if(data->types != 0) {
     STORAGE_SET_LIST *list = new_storage_list();
-    HASH_ITERATOR  *hash_i = newHashIterator(data->item_table);
-    ITEM_FUNC_DATA  *funcs = NULL;
-    const char        *key = NULL;
-    void              *val = NULL;
+    ITEM_TYPE_MASK   types = data->types;
+    int                pos = 0;
 
     // store all of our item type data
-    ITERATE_HASH(key, val, hash_i) {
-      STORAGE_SET *one_set = new_storage_set();
-      funcs = hashGet(type_table, key);
-      store_string(one_set, "type", key);
-      store_set(one_set, "data", ifunc_store(funcs, val));
+    for(; types != 0; types &= types - 1, pos++) {
+      int                id = __builtin_ctzll(types);
+      STORAGE_SET  *one_set = new_storage_set();
+      store_string(one_set, "type", item_types[id].name);
+      store_set(one_set, "data", ifunc_store(item_types[id].funcs, 
+					      data->data[pos]));
       storage_list_put(list, one_set);
     }
-    deleteHashIterator(hash_i);
 
     store_list(set, "types", list);
   }
@@ -275,17 +347,16 @@ STORAGE_SET *itemDataStore(ITEM_DATA *data) {
 ITEM_DATA *itemDataRead(STORAGE_SET *set) {
   ITEM_DATA         *data = newItemData();
   STORAGE_SET_LIST *types = read_list(set, "types");
-  ITEM_FUNC_DATA   *funcs = NULL;
   STORAGE_SET  *one_entry = NULL;
 
   // go through each entry and parse the item type
   while( (one_entry = storage_list_next(types)) != NULL) {
-    const char      *type = read_string(one_entry, "type");
-    // make sure the type is valid
-    if((funcs = hashGet(type_table, type)) == NULL) 
+    int id = itemTypeGetId(read_string(one_entry, "type"));
+    // make sure the type is valid, and we don't have it twice
+    if(id < 0 || (data->types & ITEM_TYPE_BIT(id)))
       continue;
     STORAGE_SET *type_set = read_set(one_entry, "data");
-    hashPut(data->item_table, type, ifunc_read(funcs, type_set));
+    item_data_put(data, id, ifunc_read(item_types[id].funcs, type_set));
   }
   return data;
 }
@@ -295,14 +366,8 @@ ITEM_DATA *itemDataRead(STORAGE_SET *set) {
 //*****************************************************************************
 // Python implementation
 //*****************************************************************************
-void item_add_pytype(const char *type, PyObject *pyfuncs) {
-  ITEM_FUNC_DATA *funcs = NULL;
-  // first, make sure no item type by this name already
-  // exists. If one does, delete it so it can be replaced
-  if((funcs = hashRemove(type_table, type)) != NULL)
-    deleteItemFuncData(funcs);
-  funcs = newPyItemFuncData(pyfuncs);
-  hashPut(type_table, type, funcs);
+int item_add_pytype(const char *type, PyObject *pyfuncs) {
+  return item_type_put(type, newPyItemFuncData(pyfuncs));
 }
 
 PyObject *PyMudSys_ItemAddType(PyObject *self, PyObject *args) {
@@ -351,12 +416,12 @@ PyObject *PyObj_GetTypeData(PyObject *self, PyObject *args) {
   }
 
   // make sure it's Python data
-  fdata = hashGet(type_table, type);
-  if(fdata == NULL || fdata->type == ITYPE_C)
+  int id = itemTypeGetId(type);
+  if(id < 0 || (fdata = item_types[id].funcs)->type == ITYPE_C)
     return Py_BuildValue("");
   
   // make sure this item actually has the relevant type data
-  PyObject *tdata = objGetTypeData(obj, type);
+  PyObject *tdata = objGetTypeDataId(obj, id);
   return Py_BuildValue("O", (tdata == NULL ? Py_None : tdata));
 }
 
@@ -429,6 +494,7 @@ void init_items(void) {
 				       deleteItemData, itemDataCopyTo,
 				       itemDataCopy, itemDataStore, 
 				       itemDataRead));
+  type_data_slot = auxiliariesGetSlot("type_data");
 
   // initialize Python mudsys methods
   PyMudSys_addMethod("item_add_type", PyMudSys_ItemAddType, METH_VARARGS,
@@ -468,76 +534,74 @@ void init_items(void) {
   extern void init_worn();      init_worn();
 
   // run hook for Python item type initialization
-  hookRun("init_item_types", hookBuildInfo(""));
+  hookRunArgs("init_item_types", "");
+}
+
+int item_add_type(const char *type, 
+		  void *new,    void *delete,
+		  void *copyTo, void *copy, 
+		  void *store,  void *read) {
+  return item_type_put(type, newItemFuncData(new, delete, copyTo, copy,
+					     store, read));
 }
 
-void item_add_type(const char *type, 
-		   void *new,    void *delete,
-		   void *copyTo, void *copy, 
-		   void *store,  void *read) {
-  ITEM_FUNC_DATA *funcs = NULL;
-  // first, make sure no item type by this name already
-  // exists. If one does, delete it so it can be replaced
-  if((funcs = hashRemove(type_table, type)) != NULL)
-    deleteItemFuncData(funcs);
-  funcs = newItemFuncData(new, delete, copyTo, copy, store, read);
-  hashPut(type_table, type, funcs);
+int itemTypeGetId(const char *type) {
+  return (int)(long)hashGet(type_table, type) - 1;
 }
 
 LIST *itemTypeList(void) {
   LIST *list = newList();
-  HASH_ITERATOR *hash_i = newHashIterator(type_table);
-  const char       *key = NULL;
-  void             *val = NULL;
-  ITERATE_HASH(key, val, hash_i)
-    listPutWith(list, strdup(key), strcasecmp);
-  deleteHashIterator(hash_i);
+  int     id = 0;
+  for(; id < num_item_types; id++)
+    listPutWith(list, strdup(item_types[id].name), strcasecmp);
   return list;
 }
 
+void *objGetTypeDataId(OBJ_DATA *obj, int id) {
+  return item_data_get(objGetAuxiliarySlot(obj, type_data_slot), id);
+}
+
 void *objGetTypeData(OBJ_DATA *obj, const char *type) {
-  ITEM_DATA *data = objGetAuxiliaryData(obj, "type_data");
-  return hashGet(data->item_table, type);
+  return objGetTypeDataId(obj, itemTypeGetId(type));
 }
 
 void objSetType(OBJ_DATA *obj, const char *type) {
-  ITEM_FUNC_DATA *funcs = hashGet(type_table, type);
-  ITEM_DATA       *data = objGetAuxiliaryData(obj, "type_data");
-  void   *old_item_data = hashGet(data->item_table, type);
+  int          id = itemTypeGetId(type);
+  ITEM_DATA *data = objGetAuxiliarySlot(obj, type_data_slot);
   // if the type exists and we're not already of the type, set it on us
-  if(funcs != NULL && old_item_data == NULL) 
-    hashPut(data->item_table, type, ifunc_new(funcs));
+  if(id >= 0 && !(data->types & ITEM_TYPE_BIT(id)))
+    item_data_put(data, id, ifunc_new(item_types[id].funcs));
 }
 
 void objDeleteType(OBJ_DATA *obj, const char *type) {
-  ITEM_FUNC_DATA *funcs = hashGet(type_table, type);
-  ITEM_DATA *data       = objGetAuxiliaryData(obj, "type_data");
-  void *old_item_data   = hashRemove(data->item_table, type);
-  if(old_item_data) ifunc_delete(funcs, old_item_data);
+  int               id = itemTypeGetId(type);
+  ITEM_DATA      *data = objGetAuxiliarySlot(obj, type_data_slot);
+  void *old_item_data = item_data_remove(data, id);
+  if(old_item_data) ifunc_delete(item_types[id].funcs, old_item_data);
+}
+
+bool objIsTypeId(OBJ_DATA *obj, int id) {
+  ITEM_DATA *data = objGetAuxiliarySlot(obj, type_data_slot);
+  return (id >= 0 && (data->types & ITEM_TYPE_BIT(id)) != 0);
 }
 
 bool objIsType(OBJ_DATA *obj, const char *type) {
-  ITEM_DATA *data = objGetAuxiliaryData(obj, "type_data");
-  return hashIn(data->item_table, type);
+  return objIsTypeId(obj, itemTypeGetId(type));
 }
 
 const char *objGetTypes(OBJ_DATA *obj) {
-  static char buf[MAX_BUFFER];
-  ITEM_DATA *data = objGetAuxiliaryData(obj, "type_data");
-  if(hashSize(data->item_table) == 0)
-    sprintf(buf, "none");
-  else {
-    *buf = '\0';
-    HASH_ITERATOR *hash_i = newHashIterator(data->item_table);
-    const char       *key = NULL;
-    void             *val = NULL;
-    int             count = 0;
-
-    ITERATE_HASH(key, val, hash_i) {
-      sprintf(buf, "%s%s%s", buf, (count > 0 ? ", " : ""), key);
-      count++;
-    }
-    deleteHashIterator(hash_i);
+  ITEM_DATA *data = objGetAuxiliarySlot(obj, type_data_slot);
+  if(data->types == 0)
+    return "none";
+  // build our list the first time it is asked for after our types change
+  if(data->type_list == NULL) {
+    BUFFER          *buf = newBuffer(SMALL_BUFFER);
+    ITEM_TYPE_MASK types = data->types;
+    for(; types != 0; types &= types - 1)
+      bprintf(buf, "%s%s", (bufferLength(buf) > 0 ? ", " : ""), 
+	      item_types[__builtin_ctzll(types)].name);
+    data->type_list = strShare(bufferString(buf));
+    deleteBuffer(buf);
   }
-  return buf;
+  return data->type_list;
 }
@@ -13,6 +13,11 @@
 // Objects can be multi-typed (e.g. a desk with a drawer can be both a piece
 // of furniture and a container).
 //
+// Each item type is given a small id when it is added. Objects keep a bitmask
+// of the ids they are, so checking whether an object is some type is one bit
+// test. C item types that check themselves often should look their id up
+// once, and use the Id versions of the functions below.
+//
 //*****************************************************************************
 
 //
@@ -49,10 +54,17 @@ void init_items(void);
 // read should take in a storage set and, from it, parse a new instance
 // of itemdata. The function should take a form as follows:
 //    itemdata *itemDataRead(STORAGE_SET *set)
-void item_add_type(const char *type, 
-		   void *newfunc,void *deleter,
-		   void *copyTo, void *copy, 
-		   void *store,  void *read);
+//
+// returns the id of the item type, or -1 if there is no room for more types.
+// Adding a type that already exists replaces its functions, but keeps its id
+int item_add_type(const char *type, 
+		  void *newfunc,void *deleter,
+		  void *copyTo, void *copy, 
+		  void *store,  void *read);
+
+//
+// returns the id of the named item type, or -1 if there is no such type
+int itemTypeGetId(const char *type);
 
 //
 // Build a list of all the current item types. Item types are listed in
@@ -65,6 +77,7 @@ LIST *itemTypeList(void);
 // returns the item data with the specified type for the object. 
 // if the object is not of type item, return NULL.
 void *objGetTypeData(OBJ_DATA *obj, const char *type);
+void *objGetTypeDataId(OBJ_DATA *obj, int id);
 
 //
 // Set the item to be of the specified type. 
@@ -79,11 +92,13 @@ void objDeleteType(OBJ_DATA *obj, const char *type);
 //
 // returns TRUE if the object is the specified type of object
 bool objIsType(OBJ_DATA *obj, const char *type);
+bool objIsTypeId(OBJ_DATA *obj, int id);
 
 //
 // returns a comma-separated list of the item types this object currently
-// has. the list is written to a static buffer, so players don't have to
-// worry about freeing the string after use
+// has, in the order the types were added. The list is kept with the object
+// until its types change, so it must not be freed, or held onto after the
+// object's types are changed
 const char *objGetTypes(OBJ_DATA *obj);
 
 #endif // ITEMS_H
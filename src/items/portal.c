@@ -44,6 +44,9 @@ typedef struct portal_data {
   char  *enter_mssg;
 } PORTAL_DATA;
 
+// our item type id
+int portal_type = -1;
+
 PORTAL_DATA *newPortalData() {
   PORTAL_DATA *data = malloc(sizeof(PORTAL_DATA));
   data->dest       = strdup("");
@@ -97,41 +100,41 @@ PORTAL_DATA *portalDataRead(STORAGE_SET *set) {
 // functions for interacting with portals
 //*****************************************************************************
 const char *portalGetDest(OBJ_DATA *obj) {
-  PORTAL_DATA *data = objGetTypeData(obj, "portal");
+  PORTAL_DATA *data = objGetTypeDataId(obj, portal_type);
   return data->dest;
 }
 
 const char *portalGetSmartDest(OBJ_DATA *obj) {
-  PORTAL_DATA *data = objGetTypeData(obj, "portal");
+  PORTAL_DATA *data = objGetTypeDataId(obj, portal_type);
   if(objGetRoom(obj))
     return get_fullkey_relative(data->dest, get_key_locale(roomGetClass(objGetRoom(obj))));
   return get_fullkey_relative(data->dest, get_key_locale(objGetClass(obj)));
 }
 
 const char *portalGetLeaveMssg(OBJ_DATA *obj) {
-  PORTAL_DATA *data = objGetTypeData(obj, "portal");
+  PORTAL_DATA *data = objGetTypeDataId(obj, portal_type);
   return data->leave_mssg;
 }
 
 const char *portalGetEnterMssg(OBJ_DATA *obj) {
-  PORTAL_DATA *data = objGetTypeData(obj, "portal");
+  PORTAL_DATA *data = objGetTypeDataId(obj, portal_type);
   return data->enter_mssg;
 }
 
 void portalSetDest(OBJ_DATA *obj, const char *dest) {
-  PORTAL_DATA *data = objGetTypeData(obj, "portal");
+  PORTAL_DATA *data = objGetTypeDataId(obj, portal_type);
   if(data->dest) free(data->dest);
   data->dest = strdupsafe(dest);
 }
 
 void portalSetLeaveMssg(OBJ_DATA *obj, const char *mssg) {
-  PORTAL_DATA *data = objGetTypeData(obj, "portal");
+  PORTAL_DATA *data = objGetTypeDataId(obj, portal_type);
   if(data->leave_mssg) free(data->leave_mssg);
   data->leave_mssg = strdupsafe(mssg);
 }
 
 void portalSetEnterMssg(OBJ_DATA *obj, const char *mssg) {
-  PORTAL_DATA *data = objGetTypeData(obj, "portal");
+  PORTAL_DATA *data = objGetTypeDataId(obj, portal_type);
   if(data->enter_mssg) free(data->enter_mssg);
   data->enter_mssg = strdupsafe(mssg);
 }
@@ -150,7 +153,7 @@ COMMAND(cmd_enter) {
     return;
 
   // we're trying to enter a portal
-  if(!objIsType(obj, "portal"))
+  if(!objIsTypeId(obj, portal_type))
     send_to_char(ch, "You cannot seem to find an entrance.\r\n");
   else {
     ROOM_DATA *dest = worldGetRoom(gameworld, portalGetSmartDest(obj));
@@ -173,8 +176,8 @@ COMMAND(cmd_enter) {
       else
 	message(ch, NULL, obj, NULL, TRUE, TO_ROOM,
 		"$n arrives after travelling through $o.");
-      hookRun("enter_portal", hookBuildInfo("ch obj", ch, obj));
-      hookRun("enter", hookBuildInfo("ch rm", ch, dest));
+      hookRunArgs("enter_portal", "ch obj", ch, obj);
+      hookRunArgs("enter", "ch rm", ch, dest);
     }
   }
 }
@@ -253,7 +256,7 @@ PyObject *PyObj_getportaldest(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "portal"))
+  else if(objIsTypeId(obj, portal_type))
     return Py_BuildValue("s", portalGetSmartDest(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get destination for portals.");
@@ -265,7 +268,7 @@ PyObject *PyObj_getportalleavemssg(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "portal"))
+  else if(objIsTypeId(obj, portal_type))
     return Py_BuildValue("s", portalGetLeaveMssg(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get leave message for portals.");
@@ -277,7 +280,7 @@ PyObject *PyObj_getportalentermssg(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "portal"))
+  else if(objIsTypeId(obj, portal_type))
     return Py_BuildValue("s", portalGetEnterMssg(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get enter message for portals.");
@@ -292,7 +295,7 @@ int PyObj_setportaldest(PyObject *self, PyObject *value, void *closure) {
 		 "nonexistent portal, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "portal")) {
+  else if(!objIsTypeId(obj, portal_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set destination for non-portal, %s",
 		 objGetClass(obj));
     return -1;
@@ -317,7 +320,7 @@ int PyObj_setportalleavemssg(PyObject *self, PyObject *value, void *closure) {
 		 "nonexistent portal, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "portal")) {
+  else if(!objIsTypeId(obj, portal_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set leave mssg for non-portal, %s",
 		 objGetClass(obj));
     return -1;
@@ -340,7 +343,7 @@ int PyObj_setportalentermssg(PyObject *self, PyObject *value, void *closure) {
 		 "nonexistent portal, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "portal")) {
+  else if(!objIsTypeId(obj, portal_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set enter mssg for non-portal, %s",
 		 objGetClass(obj));
     return -1;
@@ -366,7 +369,7 @@ void portal_look_hook(const char *info) {
   CHAR_DATA *ch = NULL;
   hookParseInfo(info, &obj, &ch);
 
-  if(objIsType(obj, "portal")) {
+  if(objIsTypeId(obj, portal_type)) {
     ROOM_DATA *dest = worldGetRoom(gameworld, portalGetSmartDest(obj));
     //get_fullkey_relative(portalGetDest(obj), get_key_locale(objGetClass(obj))));
     if(dest != NULL) {
@@ -389,6 +392,7 @@ void init_portal(void) {
 		newPortalData, deletePortalData,
 		portalDataCopyTo, portalDataCopy, 
 		portalDataStore, portalDataRead);
+  portal_type = itemTypeGetId("portal");
 
   // set up our hooks
   hookAdd("look_at_obj", portal_look_hook);
@@ -52,6 +52,9 @@
 //*****************************************************************************
 HASHTABLE *worn_table = NULL;
 
+// our item type id
+int worn_type = -1;
+
 typedef struct worn_entry {
   char *type;
   char *positions;
@@ -82,7 +85,7 @@ void append_worn_hook(const char *info) {
   CHAR_DATA *ch = NULL;
   hookParseInfo(info, &obj, &ch);
 
-  if(objIsType(obj, "worn")) {
+  if(objIsTypeId(obj, worn_type)) {
     bprintf(charGetLookBuffer(ch),"When worn, this item covers bodyparts: %s.",
 	    wornGetPositions(obj));
   }
@@ -137,17 +140,17 @@ WORN_DATA *wornDataRead(STORAGE_SET *set) {
 // functions for interacting with worns
 //*****************************************************************************
 const char *wornGetType(OBJ_DATA *obj) {
-  WORN_DATA *data = objGetTypeData(obj, "worn");
+  WORN_DATA *data = objGetTypeDataId(obj, worn_type);
   return data->type;
 }
 
 const char *wornGetPositions(OBJ_DATA *obj) {
-  WORN_DATA *data = objGetTypeData(obj, "worn");
+  WORN_DATA *data = objGetTypeDataId(obj, worn_type);
   return wornTypeGetPositions(data->type);
 }
 
 void wornSetType(OBJ_DATA *obj, const char *type) {
-  WORN_DATA *data = objGetTypeData(obj, "worn");
+  WORN_DATA *data = objGetTypeDataId(obj, worn_type);
   if(data->type) free(data->type);
   data->type = strdupsafe(type);
 }
@@ -235,7 +238,7 @@ PyObject *PyObj_getwornlocs(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "worn"))
+  else if(objIsTypeId(obj, worn_type))
     return Py_BuildValue("s", wornGetPositions(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get wornlocs for wearable items.");
@@ -247,7 +250,7 @@ PyObject *PyObj_getworntype(PyObject *self, void *closure) {
   OBJ_DATA *obj = PyObj_AsObj(self);
   if(obj == NULL)
     return NULL;
-  else if(objIsType(obj, "worn"))
+  else if(objIsTypeId(obj, worn_type))
     return Py_BuildValue("s", wornGetType(obj));
   else {
     PyErr_Format(PyExc_TypeError, "Can only get worntype for wearable items.");
@@ -262,7 +265,7 @@ int PyObj_setworntype(PyObject *self, PyObject *value, void *closure) {
 		 "clothing, %d", PyObj_AsUid(self));
     return -1;
   }
-  else if(!objIsType(obj, "worn")) {
+  else if(!objIsTypeId(obj, worn_type)) {
     PyErr_Format(PyExc_TypeError, "Tried to set worntype for non-clothing, %s",
 		 objGetClass(obj));
     return -1;
@@ -426,6 +429,7 @@ void init_worn(void) {
 		newWornData, deleteWornData,
 		wornDataCopyTo, wornDataCopy, 
 		wornDataStore, wornDataRead);
+  worn_type = itemTypeGetId("worn");
 
   // set up the worn OLC too
   item_add_olc("worn", iedit_worn_menu, iedit_worn_chooser, iedit_worn_parser,
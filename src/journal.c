@@ -0,0 +1,368 @@
+//*****************************************************************************
+//
+// journal.c
+//
+// an append-only journal of small changes to players. See journal.h for how
+// it is used. There is one journal for every player, kept in one file so that
+// a pulse's worth of records can be written and synced at once. Each record
+// is a line of its own:
+//
+//   <seq> <checksum> <player> <kind> <data>
+//
+// with backslashes and newlines in the data escaped. A record that was only
+// partly written when we crashed fails its checksum, and is skipped.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "object.h"
+#include "handler.h"
+#include "hooks.h"
+#include "save.h"
+#include "journal.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// where the journal lives
+#define JOURNAL_FILE           "%s/players/journal"
+
+// how big the journal can get before we throw out what's been saved since
+#define JOURNAL_COMPACT_SIZE   (256 * 1024)
+
+// the records added this pulse, waiting to be written
+BUFFER           *journal_pending = NULL;
+
+// the players whose objects need saving at the end of the pulse
+LIST                *journal_objs = NULL;
+
+// what we call to replay each kind of record
+HASHTABLE      *journal_replayers = NULL;
+
+// the last sequence number handed out
+long                  journal_seq = 0;
+
+// are we replaying records right now? If so, new ones are ignored
+bool            journal_replaying = FALSE;
+
+// player name -> the sequence number their pfile on disk was saved at. The
+// save writer thread tells us about pfiles, so this needs a lock
+HASHTABLE          *journal_saved = NULL;
+pthread_mutex_t      journal_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+  void (* func)(CHAR_DATA *ch, const char *data);
+} JOURNAL_REPLAYER;
+
+const char *journal_file(void) {
+  static char buf[MAX_BUFFER];
+  snprintf(buf, MAX_BUFFER, JOURNAL_FILE, MUDLIB_PATH);
+  return buf;
+}
+
+//
+// the checksum of a record's contents, so torn writes can be noticed
+unsigned long journal_checksum(const char *str, int len) {
+  unsigned long hash = 2166136261UL;
+  int i;
+  for(i = 0; i < len; i++)
+    hash = ((hash ^ (unsigned char)str[i]) * 16777619UL) & 0xFFFFFFFFUL;
+  return hash;
+}
+
+//
+// split a line of the journal up into its parts. Returns FALSE if the line is
+// not a whole, good record. The player, kind, and data are written over the
+// line itself, and the data is unescaped
+bool journal_parse(char *line, long *seq, char **player, char **kind,
+		   char **data) {
+  unsigned long checksum = 0;
+  char *body = NULL, *in = NULL, *out = NULL;
+  if(sscanf(line, "%ld %lx", seq, &checksum) != 2 ||
+     (body = strchr(line, ' ')) == NULL || (body = strchr(body+1, ' ')) == NULL)
+    return FALSE;
+  body++;
+  if(journal_checksum(body, strlen(body)) != checksum)
+    return FALSE;
+
+  *player = body;
+  if((*kind = strchr(*player, ' ')) == NULL)
+    return FALSE;
+  *(*kind)++ = '\0';
+  if((*data = strchr(*kind, ' ')) == NULL)
+    return FALSE;
+  *(*data)++ = '\0';
+
+  for(in = out = *data; *in; in++, out++) {
+    if(*in == '\\' && in[1] == 'n')
+      *out = '\n', in++;
+    else if(*in == '\\' && in[1] == '\\')
+      *out = '\\', in++;
+    else
+      *out = *in;
+  }
+  *out = '\0';
+  return TRUE;
+}
+
+//
+// go through every good record in the journal. func is handed each one, and
+// returns whether the record should be kept if we are compacting. Returns
+// the largest sequence number seen
+long journal_scan(bool (* func)(const char *line, long seq, const char *player,
+				const char *kind, const char *data, void *arg),
+		  void *arg, BUFFER *keep) {
+  FILE *fl = fopen(journal_file(), "r");
+  char *line = NULL;
+  size_t len = 0;
+  long  max_seq = 0;
+  if(fl == NULL)
+    return 0;
+
+  while(getline(&line, &len, fl) > 0) {
+    char  *nl = strchr(line, '\n');
+    char *player = NULL, *kind = NULL, *data = NULL;
+    long   seq = 0;
+    if(nl == NULL)  // a record we crashed in the middle of writing
+      break;
+    *nl = '\0';
+    char copy[strlen(line) + 1];
+    strcpy(copy, line);
+    if(!journal_parse(line, &seq, &player, &kind, &data))
+      continue;
+    max_seq = MAX(max_seq, seq);
+    if(func(copy, seq, player, kind, data, arg) && keep != NULL)
+      bprintf(keep, "%s\n", copy);
+  }
+  if(line != NULL)
+    free(line);
+  fclose(fl);
+  return max_seq;
+}
+
+//
+// the writer thread could be holding our lock when the world save forks.
+// Saved pfiles are put in a hashtable, which interns its keys, so this is
+// locked before the intern pools are
+void journal_atfork_prepare(void) {
+  pthread_mutex_lock(&journal_lock);
+}
+
+void journal_atfork_release(void) {
+  pthread_mutex_unlock(&journal_lock);
+}
+
+//
+// keep a record if its player has not been saved since it was made
+bool journal_keep_unsaved(const char *line, long seq, const char *player,
+			  const char *kind, const char *data, void *arg) {
+  pthread_mutex_lock(&journal_lock);
+  long saved = (long)hashGet(journal_saved, player);
+  pthread_mutex_unlock(&journal_lock);
+  return (seq > saved);
+}
+
+bool journal_note_seq(const char *line, long seq, const char *player,
+		      const char *kind, const char *data, void *arg) {
+  return TRUE;
+}
+
+//
+// replay a record, if it's for the character and newer than their pfile
+bool journal_replay_one(const char *line, long seq, const char *player,
+			const char *kind, const char *data, void *arg) {
+  void **args = arg;
+  CHAR_DATA  *ch = args[0];
+  long    *since = args[1];
+  if(seq > *since && !strcasecmp(player, charGetName(ch))) {
+    JOURNAL_REPLAYER *replayer = hashGet(journal_replayers, kind);
+    if(replayer != NULL)
+      replayer->func(ch, data);
+  }
+  return TRUE;
+}
+
+//
+// throw out everything in the journal that has been saved since. The new
+// journal is written beside the old one and moved into place
+void journal_compact(void) {
+  const char *file = journal_file();
+  char   tmp[MAX_BUFFER + sizeof(".tmp")];
+  BUFFER *keep = NULL;
+  int      fd = -1;
+
+  // never write the new journal somewhere other than beside the old one
+  if(snprintf(tmp, sizeof(tmp), "%s.tmp", file) >= (int)sizeof(tmp)) {
+    log_string("ERROR: journal path %s is too long to compact beside", file);
+    return;
+  }
+
+  keep = newBuffer(MAX_BUFFER);
+  journal_scan(journal_keep_unsaved, NULL, keep);
+  if((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) >= 0) {
+    bool ok = (write(fd, bufferString(keep), bufferLength(keep)) ==
+	       bufferLength(keep));
+    ok = (fsync(fd) == 0 && ok);
+    close(fd);
+    if(!ok || rename(tmp, file) < 0)
+      unlink(tmp);
+  }
+  deleteBuffer(keep);
+}
+
+//
+// find who ends up holding an object, through any containers it's in
+CHAR_DATA *journal_obj_owner(OBJ_DATA *obj) {
+  while(obj != NULL && objGetContainer(obj) != NULL)
+    obj = objGetContainer(obj);
+  if(obj == NULL)
+    return NULL;
+  return (objGetCarrier(obj) ? objGetCarrier(obj) : objGetWearer(obj));
+}
+
+void journal_obj_char_hook(HOOK_ARGS *args) {
+  OBJ_DATA  *obj = NULL;
+  CHAR_DATA  *ch = NULL;
+  hookParseArgs(args, &obj, &ch);
+  journalObjectsChanged(ch);
+}
+
+void journal_char_obj_hook(HOOK_ARGS *args) {
+  CHAR_DATA  *ch = NULL;
+  OBJ_DATA  *obj = NULL;
+  hookParseArgs(args, &ch, &obj);
+  journalObjectsChanged(ch);
+}
+
+void journal_obj_obj_hook(HOOK_ARGS *args) {
+  OBJ_DATA *obj = NULL, *container = NULL;
+  hookParseArgs(args, &obj, &container);
+  journalObjectsChanged(journal_obj_owner(container));
+}
+
+
+
+//*****************************************************************************
+// implementation of journal.h
+//*****************************************************************************
+void init_journal(void) {
+  journal_pending   = newBuffer(MAX_BUFFER);
+  journal_objs      = newList();
+  journal_replayers = newHashtable();
+  journal_saved     = newHashtable();
+  pthread_atfork(journal_atfork_prepare, journal_atfork_release,
+		 journal_atfork_release);
+
+  // sequence numbers must keep going up across reboots, even if the journal
+  // has been emptied out; pfiles remember the last one they were saved at
+  journal_seq = MAX(journal_scan(journal_note_seq, NULL, NULL),
+		    (long)time(NULL) * 1000000L);
+
+  hookAddArgs("obj_to_char",   journal_obj_char_hook);
+  hookAddArgs("obj_from_char", journal_obj_char_hook);
+  hookAddArgs("obj_to_obj",    journal_obj_obj_hook);
+  hookAddArgs("obj_from_obj",  journal_obj_obj_hook);
+  hookAddArgs("equip",         journal_char_obj_hook);
+  hookAddArgs("unequip",       journal_char_obj_hook);
+}
+
+void journalAddReplayer(const char *kind, void (* func)(CHAR_DATA *ch,
+							 const char *data)) {
+  JOURNAL_REPLAYER *replayer = hashGet(journal_replayers, kind);
+  if(replayer == NULL) {
+    replayer = malloc(sizeof(JOURNAL_REPLAYER));
+    hashPut(journal_replayers, kind, replayer);
+  }
+  replayer->func = func;
+}
+
+void journalAppend(CHAR_DATA *ch, const char *kind, const char *data) {
+  // only players in the game are journaled. Offline players that scripts
+  // load and change must be saved by whoever changes them, like always
+  if(journal_replaying || ch == NULL || charIsNPC(ch) || !char_exists(ch))
+    return;
+
+  BUFFER *body = newBuffer(SMALL_BUFFER);
+  bprintf(body, "%s %s ", charGetName(ch), kind);
+  for(; *data; data++) {
+    if(*data == '\n')
+      bufferCat(body, "\\n");
+    else if(*data == '\\')
+      bufferCat(body, "\\\\");
+    else
+      bufferCatCh(body, *data);
+  }
+  bprintf(journal_pending, "%ld %lx %s\n", ++journal_seq,
+	  journal_checksum(bufferString(body), bufferLength(body)),
+	  bufferString(body));
+  deleteBuffer(body);
+}
+
+void journalObjectsChanged(CHAR_DATA *ch) {
+  if(journal_replaying || ch == NULL || charIsNPC(ch) || !char_exists(ch))
+    return;
+  if(!listGetWith(journal_objs, charGetName(ch), strcasecmp))
+    listQueue(journal_objs, strdup(charGetName(ch)));
+}
+
+void journalFlush(void) {
+  char *name = NULL;
+
+  if(bufferLength(journal_pending) > 0) {
+    int fd = open(journal_file(), O_WRONLY | O_CREAT | O_APPEND,
+		  S_IRUSR | S_IWUSR);
+    struct stat st;
+    if(fd < 0)
+      log_string("ERROR: could not open the player journal, %s.",
+		 journal_file());
+    else {
+      if(write(fd, bufferString(journal_pending),
+	       bufferLength(journal_pending)) != bufferLength(journal_pending))
+	log_string("ERROR: could not write to the player journal.");
+      fsync(fd);
+      if(fstat(fd, &st) == 0 && st.st_size >= JOURNAL_COMPACT_SIZE) {
+	close(fd);
+	journal_compact();
+      }
+      else
+	close(fd);
+    }
+    bufferClear(journal_pending);
+  }
+
+  // players whose objects moved get their objects saved
+  while((name = listPop(journal_objs)) != NULL) {
+    save_player_objects(name);
+    free(name);
+  }
+}
+
+long journalGetSeq(void) {
+  return journal_seq;
+}
+
+void journalReplay(CHAR_DATA *ch, long seq) {
+  void *args[2] = { ch, &seq };
+  journalFlush();
+  journal_replaying = TRUE;
+  journal_scan(journal_replay_one, args, NULL);
+  journal_replaying = FALSE;
+  journalSaved(charGetName(ch), seq);
+}
+
+void journalSaved(const char *name, long seq) {
+  pthread_mutex_lock(&journal_lock);
+  if((long)hashGet(journal_saved, name) < seq)
+    hashPut(journal_saved, name, (void *)seq);
+  pthread_mutex_unlock(&journal_lock);
+}
@@ -0,0 +1,66 @@
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+//*****************************************************************************
+//
+// journal.h
+//
+// an append-only journal of small changes to players, kept between their full
+// saves so a crash doesn't lose everything since the last one. Modules add
+// records for the changes they care about (dyn_vars records variables being
+// set and deleted, for instance), along with a replayer that applies a record
+// back to a character. Records are written out and synced to disk in one
+// batch at the end of every pulse.
+//
+// Every record has a sequence number, and a player's pfile remembers the last
+// sequence number it was saved at. When a player is loaded, the records for
+// them that are newer than their pfile are replayed. Once a pfile has been
+// written, the journal forgets everything older than it, and the journal file
+// is compacted when it grows large enough.
+//
+// Changes to what a player is carrying are not journaled record by record.
+// Instead, anyone whose inventory or equipment changed has their objects
+// saved (through the save queue) at the end of the pulse.
+//
+//*****************************************************************************
+
+//
+// set up the journal, and the hooks that notice inventory changes
+void init_journal(void);
+
+//
+// add a replayer for a kind of record. When a record of that kind is replayed
+// on a character, func(ch, data) is called with the data it was added with.
+// Records added while replaying are ignored
+void journalAddReplayer(const char *kind, void (* func)(CHAR_DATA *ch,
+							 const char *data));
+
+//
+// add a record of a change to a player. NPCs are ignored. data can be any
+// string, newlines included
+void journalAppend(CHAR_DATA *ch, const char *kind, const char *data);
+
+//
+// note that what a player is carrying or wearing has changed
+void journalObjectsChanged(CHAR_DATA *ch);
+
+//
+// write out and sync everything recorded this pulse. Called once per pulse by
+// the game loop, and before shutdown and copyover
+void journalFlush(void);
+
+//
+// the sequence number of the last record added. A pfile saved now contains
+// every change up to this point
+long journalGetSeq(void);
+
+//
+// replay the records for ch that are newer than seq, the sequence number its
+// pfile was saved at. Called when a player is loaded
+void journalReplay(CHAR_DATA *ch, long seq);
+
+//
+// let the journal know that a player's pfile, saved at seq, is safely on disk
+// and anything older for them can be thrown out. Safe to call from any thread
+void journalSaved(const char *name, long seq);
+
+#endif // __JOURNAL_H
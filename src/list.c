@@ -11,27 +11,35 @@
 // the list until the iterator count goes down to 0; until then, the items are
 // flagged as removed so they are not touched.
 //
+// Nodes are doubly linked, so that things which keep hold of the node they
+// were added with (see listPutNode) can be taken back out in constant time.
+// Nodes flagged as removed are also chained together, so cleaning up after
+// the last iterator only visits the nodes that were removed, never the whole
+// list; each removal costs a constant amount, however long the list is.
+//
+// Lists made with newListArena get themselves and their nodes from an arena
+// instead of malloc, and never free them; the arena does that in bulk.
+//
 //*****************************************************************************
 
 #include <stdlib.h>
 #include <stdarg.h>
 #include "list.h"
+#include "arena.h"
+#include "memstat.h"
 
 #ifndef FALSE
 #define FALSE   0
 #define TRUE    !(FALSE)
 #endif
 
-typedef struct list_node {
+struct list_node {
   void *elem;              // the data we contain
   struct list_node *next;  // the next node in the list
+  struct list_node *prev;  // the previous node in the list
+  struct list_node *next_removed; // the next node waiting to be cleaned up
   char removed;            // has the item been removed from the list? 
                            // char == bool
-} LIST_NODE;
-
-struct list_iterator {
-  struct list      *L;     // the list we're iterating over
-  LIST_NODE *curr;         // the current element we're iterating on
 };
 
 struct list {
@@ -39,27 +47,43 @@ struct list {
   LIST_NODE *tail;         // last element in the list
   int size;                // how many elements are in the list?
   int iterators;           // how many iterators are going over us?
-  char remove_pending;     // do we have to do a remove when the iterators die?
+  LIST_NODE *removed;      // nodes to clean up when the iterators die
+  ARENA *arena;            // where our nodes come from, or NULL for malloc
 };
 
 
 //
-// Delete a list node, and all nodes attached to it
+// give a node we got from malloc back
 //
-void deleteListNode(LIST_NODE *N) {
-  if(N->next) deleteListNode(N->next);
+void listFreeNode(LIST_NODE *N) {
+  memNote(MEM_LIST, 0, -(long long)sizeof(LIST_NODE));
   free(N);
+}
+
+//
+// Delete a list node, and all nodes attached to it. We walk instead of
+// recursing, so long lists can't run us out of stack
+//
+void deleteListNode(LIST_NODE *N) {
+  while(N != NULL) {
+    LIST_NODE *next = N->next;
+    listFreeNode(N);
+    N = next;
+  }
 };
 
 //
 // delete the list node, plus it's element using the supplied function
 //
 void deleteListNodeWith(LIST_NODE *N, void (*delete_func)(void *)) {
-  if(N->next) deleteListNodeWith(N->next, delete_func);
-  // we only want to delete elements that are actually in the list
-  if(!N->removed)
-    delete_func(N->elem);
-  free(N);
+  while(N != NULL) {
+    LIST_NODE *next = N->next;
+    // we only want to delete elements that are actually in the list
+    if(!N->removed)
+      delete_func(N->elem);
+    listFreeNode(N);
+    N = next;
+  }
 }
 
 //
@@ -67,56 +91,70 @@ void deleteListNodeWith(LIST_NODE *N, void (*delete_func)(void *)) {
 //
 LIST_NODE *newListNode(void *elem) {
   LIST_NODE *N = malloc(sizeof(LIST_NODE));
+  memNote(MEM_LIST, 0, sizeof(LIST_NODE));
   N->elem    = elem;
   N->next    = NULL;
+  N->prev    = NULL;
+  N->next_removed = NULL;
   N->removed = FALSE;
   return N;
 };
 
 
+//
+// create a new node for the list, from wherever the list gets its nodes
+//
+LIST_NODE *listNewNode(LIST *L, void *elem) {
+  if(L->arena == NULL)
+    return newListNode(elem);
+  LIST_NODE *N    = arenaAlloc(L->arena, sizeof(LIST_NODE));
+  N->elem         = elem;
+  N->next         = NULL;
+  N->prev         = NULL;
+  N->next_removed = NULL;
+  N->removed      = FALSE;
+  return N;
+}
+
+
+//
+// take the node out of the list's chain and delete it
+//
+void listUnlinkNode(LIST *L, LIST_NODE *N) {
+  if(N->prev) N->prev->next = N->next;
+  else        L->head       = N->next;
+  if(N->next) N->next->prev = N->prev;
+  else        L->tail       = N->prev;
+  if(L->arena == NULL)
+    listFreeNode(N);
+}
+
+
+//
+// remove a node that is still in the list. If anything is iterating over 
+// the list, we only flag it as removed and clean it up afterwards
+//
+void listRemoveLiveNode(LIST *L, LIST_NODE *N) {
+  L->size--;
+  if(L->iterators > 0) {
+    N->removed      = TRUE;
+    N->next_removed = L->removed;
+    L->removed      = N;
+  }
+  else
+    listUnlinkNode(L, N);
+}
+
+
 //
 // take out all of the nodes that have been flagged as "removed"
 // from the list.
 //
 void listCleanRemoved(LIST *L) {
-  // go through and kill all of the elements we removed if removes are pending
-  if(L->remove_pending) {
-    LIST_NODE *node = L->head;
-    L->remove_pending = FALSE;
-
-    // while our head is a removed element, 
-    // pop it off and delete the list node
-    while(node && node->removed) {
-      L->head = node->next;
-      node->next = NULL;
-      deleteListNode(node);
-      node = L->head;
-    }
-    
-    // go through the rest of the list
-    if(node != NULL) {
-      while(node->next != NULL) {
-	// is our next element to be removed?
-	if(node->next->removed) {
-	  LIST_NODE *removed = node->next;
-	  node->next = removed->next;
-	  removed->next = NULL;
-	  deleteListNode(removed);
-	  // if we just removed the last element in the list, our next 
-	  // node should be NULL and we cannot keep do our next loop, 
-	  // as we'll try to assign NULL to the current node
-	  if(node->next == NULL) break;
-	}
-	node = node->next;
-      }
-    }
-    
-    // reset the tail of our list
-    L->tail = node;
-    
-    // if we have no elements left, clear our head and tail
-    if(L->size == 0)
-      L->head = L->tail = NULL;
+  while(L->removed != NULL) {
+    LIST_NODE *node = L->removed;
+    L->removed = node->next_removed;
+    listUnlinkNode(L, node);
   }
 }
 
@@ -128,54 +166,99 @@ void listCleanRemoved(LIST *L) {
 //
 //*****************************************************************************
 LIST *newList() {
-  LIST *L    = malloc(sizeof(LIST));
+  LIST *L    = memAlloc(MEM_LIST, sizeof(LIST));
   L->head           = NULL;
   L->tail           = NULL;
   L->size           = 0;
   L->iterators      = 0;
-  L->remove_pending = FALSE;
+  L->removed        = NULL;
+  L->arena          = NULL;
   return L;
 };
 
 
+LIST *newListArena(ARENA *arena) {
+  LIST *L           = arenaAlloc(arena, sizeof(LIST));
+  L->head           = NULL;
+  L->tail           = NULL;
+  L->size           = 0;
+  L->iterators      = 0;
+  L->removed        = NULL;
+  L->arena          = arena;
+  return L;
+}
+
+
 void deleteList(LIST *L) {
+  // arena lists are freed along with their arena
+  if(L->arena != NULL)
+    return;
   if(L->head) deleteListNode(L->head);
-  free(L);
+  memFree(MEM_LIST, L, sizeof(LIST));
 };
 
 void deleteListWith(LIST *L, void *func) {
+  if(L->arena != NULL) {
+    void (*delete_func)(void *) = func;
+    LIST_NODE *N;
+    for(N = L->head; N != NULL; N = N->next)
+      if(!N->removed)
+	delete_func(N->elem);
+    return;
+  }
   if(L->head) deleteListNodeWith(L->head, func);
-  free(L);
+  memFree(MEM_LIST, L, sizeof(LIST));
 }
 
-void listPut(LIST *L, void *elem) {
+LIST_NODE *listPutNode(LIST *L, void *elem) {
   //  if(listIn(L, elem))
   //    return;
 
-  LIST_NODE *N = newListNode(elem);
+  LIST_NODE *N = listNewNode(L, elem);
   N->next = L->head;
+  if(L->head != NULL)
+    L->head->prev = N;
   L->head = N;
   L->size++;
   if(L->tail == NULL)
     L->tail = N;
+  return N;
 };
 
 
-void listQueue(LIST *L, void *elem) {
+LIST_NODE *listQueueNode(LIST *L, void *elem) {
   //  if(listIn(L, elem))
   //    return;
 
-  LIST_NODE *N = newListNode(elem);
+  LIST_NODE *N = listNewNode(L, elem);
 
   if(L->head == NULL) {
     L->head = N;
     L->tail = N;
   }
   else {
+    N->prev       = L->tail;
     L->tail->next = N;
     L->tail       = N;
   }
   L->size++;
+  return N;
+}
+
+
+void listPut(LIST *L, void *elem) {
+  listPutNode(L, elem);
+}
+
+
+void listQueue(LIST *L, void *elem) {
+  listQueueNode(L, elem);
+}
+
+
+void listRemoveNode(LIST *L, LIST_NODE *node) {
+  if(!node->removed)
+    listRemoveLiveNode(L, node);
 }
 
 
@@ -203,57 +286,16 @@ int listIn(LIST *L, const void *elem) {
 
 
 int listRemove(LIST *L, const void *elem) {
-  LIST_NODE *N = L->head;
+  LIST_NODE *N = NULL;
 
-  // we don't have any contents
-  if(N == NULL)
-    return FALSE;
-
-  // we first have to check if it is the head
-  if(!N->removed && N->elem == elem) {
-    // check to see if there's an iterator on us
-    if(L->iterators > 0) {
-      N->removed = TRUE;
-      L->size--;
-      L->remove_pending = TRUE;
-      return TRUE;
-    }
-    else {
-      L->head = N->next;
-      N->next = NULL;
-      deleteListNode(N);
-      L->size--;
-      if(L->size == 0)
-	L->tail = NULL;
+  for(N = L->head; N != NULL; N = N->next) {
+    // we found it ... remove it now
+    if(!N->removed && N->elem == elem) {
+      listRemoveLiveNode(L, N);
       return TRUE;
     }
   }
-  // otherwise, we can check if it's another element
-  else {
-    while(N->next) {
-      // we found it ... remove it now
-      if(!N->next->removed && N->next->elem == elem) {
-	// check to see if there's an iterator on us
-	if(L->iterators > 0) {
-	  N->next->removed = TRUE;
-	  L->remove_pending = TRUE;
-	  L->size--;
-	  return TRUE;
-	}
-	else {
-	  if(N->next == L->tail)
-	    L->tail = N;
-	  LIST_NODE *tmp = N->next;
-	  N->next = tmp->next;
-	  tmp->next = NULL;
-	  deleteListNode(tmp);
-	  L->size--;
-	  return TRUE;
-	}
-      }
-      N = N->next;
-    }
-  }
+
   // we didn't find it
   return FALSE;
 };
@@ -312,60 +354,17 @@ void *listGetWith(LIST *L, const void *cmpto, void *func) {
 
 void *listRemoveWith(LIST *L, const void *cmpto, void *func) {
   int (* comparator)(const void *, const void *) = func;
-  LIST_NODE *N = L->head;
+  LIST_NODE *N = NULL;
 
-  // we don't have any contents
-  if(N == NULL)
-    return NULL;
-
-  // we first have to check if it is the head
-  if(!N->removed && !comparator(cmpto, N->elem)) {
-    // check to see if there's an iterator on us
-    if(L->iterators > 0) {
-      N->removed = TRUE;
-      L->remove_pending = TRUE;
-      L->size--;
-      return N->elem;
-    }
-    else {
+  for(N = L->head; N != NULL; N = N->next) {
+    // we found it ... remove it now
+    if(!N->removed && !comparator(cmpto, N->elem)) {
       void *elem = N->elem;
-      L->head = N->next;
-      N->next = NULL;
-      deleteListNode(N);
-      L->size--;
-      if(L->size == 0)
-	L->tail = NULL;
+      listRemoveLiveNode(L, N);
       return elem;
     }
   }
 
-  // otherwise, we can check if it's another element
-  else {
-    while(N->next) {
-      // we found it ... remove it now
-      if(!N->next->removed && !comparator(cmpto, N->next->elem)) {
-	// check to see if there's an iterator on us
-	if(L->iterators > 0) {
-	  N->next->removed = TRUE;
-	  L->remove_pending = TRUE;
-	  L->size--;
-	  return N->next->elem;
-	}
-	else {
-	  void *elem = N->next->elem;
-	  if(N->next == L->tail)
-	    L->tail = N;
-	  LIST_NODE *tmp = N->next;
-	  N->next = tmp->next;
-	  tmp->next = NULL;
-	  deleteListNode(tmp);
-	  L->size--;
-	  return elem;
-	}
-      }
-      N = N->next;
-    }
-  }
   // we didn't find it
   return NULL;
 }
@@ -388,8 +387,10 @@ void listPutWith(LIST *L, void *elem, void *func) {
 	int val = comparator(elem, N->next->elem);
 	// we're less than or equal to it... sneak in
 	if(val <= 0) {
-	  LIST_NODE *new_node = newListNode(elem);
+	  LIST_NODE *new_node = listNewNode(L, elem);
 	  new_node->next = N->next;
+	  new_node->prev = N;
+	  N->next->prev  = new_node;
 	  N->next = new_node;
 	  L->size++;
 	  return;
@@ -398,7 +399,8 @@ void listPutWith(LIST *L, void *elem, void *func) {
       N = N->next;
     }
     // if we've gotten this far, then we need to attach ourself to the end
-    N->next = newListNode(elem);
+    N->next = listNewNode(L, elem);
+    N->next->prev = N;
     L->tail = N->next;
     L->size++;
   }
@@ -409,19 +411,21 @@ void listSortWith(LIST *L, void *func) {
   // make a new list, and just pop our elements
   // into it while we still have 'em
   LIST *new_list = newList();
+  new_list->arena = L->arena;
 
   while(listSize(L) > 0)
     listPutWith(new_list, listPop(L), func);
 
   // kill all of our removed nodes
-  if(L->head) deleteListNode(L->head);
+  if(L->head && L->arena == NULL) deleteListNode(L->head);
+  L->removed = NULL;
 
   L->head = new_list->head;
   L->tail = new_list->tail;
   L->size = new_list->size;
   // FREE ... not delete. Delete would kill the things
   // we just transferred over to the old list
-  free(new_list);
+  memFree(MEM_LIST, new_list, sizeof(LIST));
 }
 
 
@@ -454,20 +458,28 @@ void listParse(LIST *L, int n, ...) {
 // The functions for the list iterator interface. Documentation is in list.h
 //
 //*****************************************************************************
-LIST_ITERATOR *newListIterator(LIST *L) {
-  LIST_ITERATOR *I = malloc(sizeof(LIST_ITERATOR));
+LIST_ITERATOR *listIteratorInit(LIST_ITERATOR *I, LIST *L) {
   I->L    = L;
   I->curr = I->L->head;
   L->iterators++;
   return I;
 };
 
-void deleteListIterator(LIST_ITERATOR *I) {
+void listIteratorFinish(LIST_ITERATOR *I) {
   I->L->iterators--;
   // if we're at 0 iterators, clean the list of all removed elements
   if(I->L->iterators == 0)
     listCleanRemoved(I->L);
-  free(I);
+};
+
+LIST_ITERATOR *newListIterator(LIST *L) {
+  LIST_ITERATOR *I = memAlloc(MEM_LIST_ITERATOR, sizeof(LIST_ITERATOR));
+  return listIteratorInit(I, L);
+};
+
+void deleteListIterator(LIST_ITERATOR *I) {
+  listIteratorFinish(I);
+  memFree(MEM_LIST_ITERATOR, I, sizeof(LIST_ITERATOR));
 };
 
 void *listIteratorNext(LIST_ITERATOR *I) {
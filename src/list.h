@@ -15,6 +15,8 @@
 
 typedef struct list                       LIST;
 typedef struct list_iterator              LIST_ITERATOR;
+typedef struct list_node                  LIST_NODE;
+struct arena;
 
 //
 // Create a new list
@@ -22,6 +24,15 @@ typedef struct list_iterator              LIST_ITERATOR;
 LIST *newList();
 
 
+//
+// Create a new list that gets itself and its nodes from an arena (see
+// arena.h). deleteList does nothing to it; it is freed along with the memory
+// it came from, so it must not outlive the arena mark it was made under.
+// deleteListWith still deletes its contents
+//
+LIST *newListArena(struct arena *arena);
+
+
 //
 // Delete an existing list
 //
@@ -48,6 +59,23 @@ void listPut(LIST *L, void *elem);
 void listQueue(LIST *L, void *elem);
 
 
+//
+// the same as listPut and listQueue, but hand back the node the element was
+// put in. Whoever holds onto the node can take the element back out of the
+// list in constant time with listRemoveNode. The node is only good until the
+// element is removed from the list, by whatever means; anything holding a
+// node must make sure the element only ever leaves through listRemoveNode
+//
+LIST_NODE *listPutNode  (LIST *L, void *elem);
+LIST_NODE *listQueueNode(LIST *L, void *elem);
+
+
+//
+// remove the element held in the node from the list, in constant time
+//
+void listRemoveNode(LIST *L, LIST_NODE *node);
+
+
 //
 // Return true if the element is in the list. False otherwise
 //
@@ -163,6 +191,28 @@ void listParse(LIST *L, int n, ...);
 #define ITERATE_LIST(val, it) \
   for(val = listIteratorCurrent(it); val != NULL; val = listIteratorNext(it))
 
+//
+// the iterator is only laid out here so that it can live on the stack; its
+// fields should never be touched directly
+struct list_iterator {
+  struct list          *L; // the list we're iterating over
+  struct list_node  *curr; // the current element we're iterating on
+};
+
+//
+// declares an iterator named name over the list, that lives on the stack
+// instead of being malloc'd. It is just as safe to remove things from the
+// list while it is running, and it must be finished with listIteratorFinish
+// instead of deleteListIterator:
+//
+//   LOCAL_LIST_ITERATOR(ch_i, list);
+//   ITERATE_LIST(ch, ch_i) {
+//     ...
+//   } listIteratorFinish(ch_i);
+#define LOCAL_LIST_ITERATOR(name, list) \
+  LIST_ITERATOR name##_local; \
+  LIST_ITERATOR *name = listIteratorInit(&name##_local, list)
+
 //
 // Create an iterator to go over the list
 //
@@ -175,6 +225,14 @@ LIST_ITERATOR *newListIterator(LIST *L);
 void deleteListIterator(LIST_ITERATOR *I);
 
 
+//
+// set up an iterator we have space for, and finish with it when we're done.
+// It is usually easier to use LOCAL_LIST_ITERATOR than to call these yourself
+//
+LIST_ITERATOR *listIteratorInit(LIST_ITERATOR *I, LIST *L);
+void         listIteratorFinish(LIST_ITERATOR *I);
+
+
 //
 // Point the list iterator back at the head of the list
 //
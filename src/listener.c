@@ -0,0 +1,269 @@
+//*****************************************************************************
+//
+// listener.c
+//
+// the sockets we listen for new connections on. See listener.h for how they
+// are set up.
+//
+//*****************************************************************************
+
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "listener.h"
+#include "tls.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+int listeners[MAX_LISTENERS];
+int listener_flags[MAX_LISTENERS];
+int num_listeners = 0;
+
+// what listenersGetFds hands back
+char listener_fds[MAX_LISTENERS * 14];
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// set the options every listener has. Returns FALSE if one couldn't be set
+bool listener_setopts(int fd, bool ipv6) {
+  int reuse = 1, v6only = 0;
+  if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0)
+    return FALSE;
+  if(mudsettingGetBool("listen_reuseport")) {
+#ifdef SO_REUSEPORT
+    if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
+      return FALSE;
+#else
+    log_string("listen_reuseport is set, but SO_REUSEPORT isn't supported "
+	       "here.");
+#endif
+  }
+  if(ipv6 &&
+     setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) < 0)
+    return FALSE;
+  return TRUE;
+}
+
+//
+// start listening on port. Tries dualstack IPv6 first if we want it, and
+// IPv4 if that doesn't work. Returns the socket, or -1 if we couldn't
+int listener_open(int port) {
+  int backlog = mudsettingGetInt("listen_backlog");
+  bool   ipv6 = mudsettingGetBool("listen_ipv6");
+  int      fd = -1;
+
+  if(backlog <= 0)
+    backlog = SOMAXCONN;
+
+  if(ipv6) {
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr   = in6addr_any;
+    addr.sin6_port   = htons(port);
+
+    if((fd = socket(AF_INET6, SOCK_STREAM, 0)) >= 0 &&
+       (!listener_setopts(fd, TRUE) ||
+	bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	listen(fd, backlog) < 0)) {
+      log_string("Could not listen for IPv6 on port %d (%s). Trying IPv4.",
+		 port, strerror(errno));
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  if(fd < 0) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port        = htons(port);
+
+    if((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+      return -1;
+    if(!listener_setopts(fd, FALSE) ||
+       bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+       listen(fd, backlog) < 0) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+//
+// the port a listener is listening on
+int listener_port(int fd) {
+  struct sockaddr_storage addr;
+  socklen_t size = sizeof(addr);
+  if(getsockname(fd, (struct sockaddr *) &addr, &size) < 0)
+    return -1;
+  if(addr.ss_family == AF_INET6)
+    return ntohs(((struct sockaddr_in6 *) &addr)->sin6_port);
+  return ntohs(((struct sockaddr_in *) &addr)->sin_port);
+}
+
+//
+// start using fd as a listener
+void listener_add(int fd, int flags) {
+  int argp = 1;
+  // we accept connections until there are none left, so we can't block
+  ioctl(fd, FIONBIO, &argp);
+  listener_flags[num_listeners] = flags;
+  listeners[num_listeners++]    = fd;
+}
+
+//
+// listen on each port in a comma-separated list, skipping the ones we
+// already are. Everyone who connects to them speaks what flags say
+void listener_open_all(const char *list, int flags) {
+  LIST           *ports = parse_keywords(list);
+  LIST_ITERATOR *port_i = newListIterator(ports);
+  char            *port = NULL;
+  int           i, fd;
+
+  ITERATE_LIST(port, port_i) {
+    int num = atoi(port);
+    if(num <= 0 || num == mudport)
+      continue;
+    for(i = 0; i < num_listeners; i++)
+      if(listener_port(listeners[i]) == num)
+	break;
+    if(i < num_listeners)
+      continue;
+    if(num_listeners == MAX_LISTENERS) {
+      log_string("Can't listen on more than %d ports. Skipping %d.",
+		 MAX_LISTENERS, num);
+      continue;
+    }
+    if((fd = listener_open(num)) < 0)
+      log_string("Could not listen on port %d: %s.", num, strerror(errno));
+    else {
+      listener_add(fd, flags);
+      log_string("Listening on port %d%s%s.", num,
+		 (flags & LISTENER_WS ? " for WebSockets" : ""),
+		 (flags & LISTENER_TLS ? " over TLS" : ""));
+    }
+  } deleteListIterator(port_i);
+  deleteListWith(ports, free);
+}
+
+
+
+//*****************************************************************************
+// implementation of listener.h
+//*****************************************************************************
+void init_listeners(void) {
+  int fd = listener_open(mudport);
+  if(fd < 0) {
+    perror("Error opening our listening socket");
+    exit(1);
+  }
+  listener_add(fd, 0);
+  log_string("Listening on port %d.", mudport);
+
+  listener_open_all(mudsettingGetString("listen_extra_ports"), 0);
+  listener_open_all(mudsettingGetString("ws_ports"), LISTENER_WS);
+  if(tlsEnabled()) {
+    listener_open_all(mudsettingGetString("tls_ports"), LISTENER_TLS);
+    listener_open_all(mudsettingGetString("wss_ports"),
+		      LISTENER_TLS | LISTENER_WS);
+  }
+  else if(*mudsettingGetString("tls_ports") ||
+	  *mudsettingGetString("wss_ports"))
+    log_string("TLS could not be set up. Not listening on tls_ports or "
+	       "wss_ports.");
+}
+
+void listenersResume(const char *fds) {
+  while(*fds && num_listeners < MAX_LISTENERS) {
+    int fd = atoi(fds), flags = 0;
+    while(isdigit(*fds))
+      fds++;
+    for(; *fds == 't' || *fds == 'w'; fds++)
+      flags |= (*fds == 't' ? LISTENER_TLS : LISTENER_WS);
+    // if we can't speak TLS any more, nobody on the port will understand us
+    if(!(flags & LISTENER_TLS) || tlsEnabled())
+      listener_add(fd, flags);
+    else {
+      log_string("TLS could not be set up. No longer listening for TLS.");
+      close(fd);
+    }
+    while(*fds && *fds != ',')
+      fds++;
+    if(*fds == ',')
+      fds++;
+  }
+}
+
+const char *listenersGetFds(void) {
+  int i, len = 0;
+  *listener_fds = '\0';
+  for(i = 0; i < num_listeners; i++)
+    len += snprintf(listener_fds + len, sizeof(listener_fds) - len,"%s%d%s%s",
+		    (i > 0 ? "," : ""), listeners[i],
+		    (listener_flags[i] & LISTENER_TLS ? "t" : ""),
+		    (listener_flags[i] & LISTENER_WS  ? "w" : ""));
+  return listener_fds;
+}
+
+int listenerCount(void) {
+  return num_listeners;
+}
+
+int listenerGetFd(int num) {
+  return (num >= 0 && num < num_listeners ? listeners[num] : -1);
+}
+
+bool isListener(int fd) {
+  int i;
+  for(i = 0; i < num_listeners; i++)
+    if(listeners[i] == fd)
+      return TRUE;
+  return FALSE;
+}
+
+int listenerGetFlags(int fd) {
+  int i;
+  for(i = 0; i < num_listeners; i++)
+    if(listeners[i] == fd)
+      return listener_flags[i];
+  return 0;
+}
+
+void close_listeners(void) {
+  while(num_listeners > 0)
+    close(listeners[--num_listeners]);
+}
+
+const char *addrToString(const struct sockaddr_storage *addr,
+			 char *buf, size_t len) {
+  if(addr->ss_family == AF_INET6) {
+    const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *) addr;
+    // IPv4 that came in over a dualstack socket
+    if(IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr))
+      return inet_ntop(AF_INET, &in6->sin6_addr.s6_addr[12], buf, len);
+    return inet_ntop(AF_INET6, &in6->sin6_addr, buf, len);
+  }
+  else if(addr->ss_family == AF_INET)
+    return inet_ntop(AF_INET, &((const struct sockaddr_in *) addr)->sin_addr,
+		     buf, len);
+  return NULL;
+}
+
+bool addrIsLoopback(const char *addr) {
+  return (!strncmp(addr, "127.", 4) || !strcmp(addr, "::1"));
+}
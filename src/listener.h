@@ -0,0 +1,78 @@
+#ifndef __LISTENER_H
+#define __LISTENER_H
+//*****************************************************************************
+//
+// listener.h
+//
+// the sockets we listen for new connections on. There is always one for the
+// port we were started on, and one more for each port in listen_extra_ports
+// (e.g. "4001, 23"). If listen_ipv6 is set, each is a dualstack IPv6 socket
+// that takes IPv4 connections as well; if the host has no IPv6, we fall back
+// to IPv4 alone. Each listens with a backlog of listen_backlog (0 for as big
+// as the system allows), and, if listen_reuseport is set, with SO_REUSEPORT
+// so that another process can listen on the same ports while this one winds
+// down or shares the load. The ports in tls_ports are listened on the same
+// way, and everyone who connects to them speaks TLS (see tls.h). Everyone who
+// connects to the ports in ws_ports speaks WebSockets (see websocket.h), and
+// to the ports in wss_ports, WebSockets over TLS.
+//
+// Addresses are handled as numeric strings, e.g. 10.0.0.1 or 2001:db8::1.
+// IPv4 addresses that come in over a dualstack socket are written the IPv4
+// way, so that one address looks the same whichever way it connected.
+//
+//*****************************************************************************
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// the most sockets we'll listen on
+#define MAX_LISTENERS          8
+
+// what the connections on a listener speak, as listenerGetFlags says
+#define LISTENER_TLS           1
+#define LISTENER_WS            2
+
+//
+// open all of our listeners, and make them non-blocking. Exits if we can't
+// listen on the port we were started on
+void init_listeners(void);
+
+//
+// take back the listeners a copyover left us, as made by listenersGetFds
+void listenersResume(const char *fds);
+
+//
+// the listeners' file descriptors, comma-separated, for handing over to the
+// next process on a copyover. TLS listeners have a t after them, and
+// WebSocket listeners a w
+const char *listenersGetFds(void);
+
+//
+// how many listeners we have, and each one's file descriptor
+int  listenerCount(void);
+int  listenerGetFd(int num);
+
+//
+// is fd one of our listeners?
+bool isListener(int fd);
+
+//
+// what the connections on the listener with this fd speak. LISTENER_TLS
+// and LISTENER_WS, or'd together, or 0 for plain telnet
+int listenerGetFlags(int fd);
+
+//
+// stop listening on all of our sockets
+void close_listeners(void);
+
+//
+// write addr as a numeric string into buf, the way this file describes.
+// Returns buf, or NULL if addr isn't an IPv4 or IPv6 address
+const char *addrToString(const struct sockaddr_storage *addr,
+			 char *buf, size_t len);
+
+//
+// is the numeric address one of ours?
+bool addrIsLoopback(const char *addr);
+
+#endif // __LISTENER_H
@@ -12,12 +12,20 @@
 // You can turn off logging for a specific character by not supplying a
 // keyword list.
 //
+// Output is checked against every line sent to a logged character, so each
+// log's keywords are compiled once, when they are set, into an Aho-Corasick
+// automaton: a table of which state each byte moves us to, with the misses
+// already folded in. Checking a line is then one step per byte of it, no
+// matter how many keywords there are. Matched lines are handed to the log
+// writer rather than being written here.
+//
 //*****************************************************************************
 
 #include "mud.h"
 #include "utils.h"
 #include "character.h"
 #include "storage.h"
+#include "log_queue.h"
 #include "log.h"
 
 char *get_log_dir(void) {
@@ -34,11 +42,112 @@ char *get_log_list(void) {
 #define LOG_LIST get_log_list()
 
 
+// a log's keywords, as they were given and compiled for matching
+typedef struct log_keys {
+  char *keywords; // what we were given, for saving
+  bool       all; // do we log everything?
+  int    *states; // 256 next states for every state. State 0 is the start
+  bool     *hits; // does reaching a state mean we've found a keyword?
+} LOG_KEYS;
+
 // a map from filenames to the keywords we try to log
 HASHTABLE *logkeys = NULL;
 
 
 
+//*****************************************************************************
+// compiling and matching keywords
+//*****************************************************************************
+
+//
+// compile a list of keywords for matching
+LOG_KEYS *newLogKeys(const char *keywords) {
+  LOG_KEYS     *lkeys = calloc(1, sizeof(LOG_KEYS));
+  lkeys->keywords     = strdup(keywords);
+  if((lkeys->all = is_keyword(keywords, "all", FALSE)) == TRUE)
+    return lkeys;
+
+  LIST       *keys = parse_keywords(keywords);
+  LIST_ITERATOR *key_i = newListIterator(keys);
+  const char   *key = NULL;
+  int  max_states = 1, num_states = 1, *fail = NULL, *order = NULL;
+  int    head = 0, tail = 0, state = 0, c = 0;
+
+  ITERATE_LIST(key, key_i) {
+    max_states += strlen(key);
+  } deleteListIterator(key_i);
+  lkeys->states = malloc(sizeof(int) * 256 * max_states);
+  lkeys->hits   = calloc(max_states, sizeof(bool));
+  memset(lkeys->states, -1, sizeof(int) * 256 * max_states);
+
+  // build a trie of our keywords
+  key_i = newListIterator(keys);
+  ITERATE_LIST(key, key_i) {
+    const unsigned char *ch = (const unsigned char *)key;
+    for(state = 0; *ch; ch++) {
+      int *next = &lkeys->states[state * 256 + *ch];
+      if(*next < 0)
+	*next = num_states++;
+      state = *next;
+    }
+    lkeys->hits[state] = TRUE;
+  } deleteListIterator(key_i);
+  deleteListWith(keys, free);
+
+  // go over the trie shallowest-first, and wherever there is no edge for a
+  // byte, point it where the longest suffix we'd still have would go
+  fail  = calloc(num_states, sizeof(int));
+  order = malloc(sizeof(int) * num_states);
+  for(c = 0; c < 256; c++) {
+    int *next = &lkeys->states[c];
+    if(*next < 0)
+      *next = 0;
+    else
+      order[tail++] = *next;
+  }
+  while(head < tail) {
+    state = order[head++];
+    lkeys->hits[state] = lkeys->hits[state] || lkeys->hits[fail[state]];
+    for(c = 0; c < 256; c++) {
+      int *next = &lkeys->states[state * 256 + c];
+      int  miss = lkeys->states[fail[state] * 256 + c];
+      if(*next < 0)
+	*next = miss;
+      else {
+	fail[*next]   = miss;
+	order[tail++] = *next;
+      }
+    }
+  }
+  free(fail);
+  free(order);
+  return lkeys;
+}
+
+void deleteLogKeys(LOG_KEYS *lkeys) {
+  if(lkeys->states) free(lkeys->states);
+  if(lkeys->hits)   free(lkeys->hits);
+  free(lkeys->keywords);
+  free(lkeys);
+}
+
+//
+// does the string have any of the keywords in it?
+bool logKeysMatch(LOG_KEYS *lkeys, const char *string) {
+  if(lkeys->all)
+    return TRUE;
+  const unsigned char *ch = (const unsigned char *)string;
+  int              state = 0;
+  if(lkeys->hits[0])
+    return TRUE;
+  for(; *ch; ch++)
+    if(lkeys->hits[state = lkeys->states[state * 256 + *ch]])
+      return TRUE;
+  return FALSE;
+}
+
+
+
 //
 // Begin logging the appearance of specific keywords when they come up
 // on a certain character's output. Supplying no keywords turns off logging
@@ -78,13 +187,13 @@ void save_logkeys() {
   STORAGE_SET_LIST *log_list = new_storage_list();
   HASH_ITERATOR      *hash_i = newHashIterator(logkeys);
   const char *log   = NULL;
-  const char *words = NULL;
+  LOG_KEYS  *lkeys = NULL;
 
   store_list(set, "logs", log_list);
-  ITERATE_HASH(log, words, hash_i) {
+  ITERATE_HASH(log, lkeys, hash_i) {
     STORAGE_SET *one_log = new_storage_set();
     store_string(one_log, "log",      log);
-    store_string(one_log, "keywords", words);
+    store_string(one_log, "keywords", lkeys->keywords);
     storage_list_put(log_list, one_log);
   }
   deleteHashIterator(hash_i);
@@ -103,8 +212,8 @@ void init_logs() {
     STORAGE_SET_LIST *list = read_list(set, "logs");
     STORAGE_SET *one_log = NULL;
     while( (one_log = storage_list_next(list)) != NULL)
-      hashPut(logkeys, strdup(read_string(one_log, "log")),
-	               strdup(read_string(one_log, "keywords")));
+      hashPut(logkeys, read_string(one_log, "log"),
+	      newLogKeys(read_string(one_log, "keywords")));
     storage_close(set);
   }
 
@@ -114,15 +223,16 @@ void init_logs() {
 
 void log_keywords(const char *file, const char *keywords) {
   // remove the old keywords
-  char *keys = hashRemove(logkeys, file);
-  if(keys) free(keys);
+  LOG_KEYS *lkeys = hashRemove(logkeys, file);
+  if(lkeys) deleteLogKeys(lkeys);
 
-  keys = strdupsafe(keywords);
+  char *keys = strdupsafe(keywords);
   trim(keys);
 
   // put the new keywords in
   if(*keys)
-    hashPut(logkeys, file, keys);
+    hashPut(logkeys, file, newLogKeys(keys));
+  free(keys);
 
   // save the changes
   save_logkeys();
@@ -130,43 +240,10 @@ void log_keywords(const char *file, const char *keywords) {
 
 
 void try_log(const char *file, const char *string) {
-  char *keywords = hashGet(logkeys, file);
-  // didn't find anything
-  if(!keywords || !*keywords)
-    return;
-  else {
-    bool found = FALSE;
-
-    if(is_keyword(keywords, "all", FALSE))
-      found = TRUE;
-    // for each key, see if it exists in the string
-    else {
-      LIST           *keys = parse_keywords(keywords);
-      LIST_ITERATOR *key_i = newListIterator(keys);
-      char            *key = NULL;
-
-      ITERATE_LIST(key, key_i) {
-	// found one
-	if(strstr(string, key)) {
-	  found = TRUE;
-	  break;
-	}
-      } deleteListIterator(key_i);
-      deleteListWith(keys, free);
-    }
-
-    if(found) {
-      char fname[MAX_BUFFER];
-      FILE *fl = NULL;
-      sprintf(fname, "%s/%s", LOG_DIR, file);
-      
-      // couldn't open the file for appending
-      if((fl = fopen(fname, "a+")) == NULL)
-	return;
-      
-      // write the string and close the file
-      fprintf(fl, "%s: %s", get_time(), string);
-      fclose(fl);
-    }
+  LOG_KEYS *lkeys = hashGet(logkeys, file);
+  if(lkeys != NULL && logKeysMatch(lkeys, string)) {
+    char fname[MAX_BUFFER];
+    snprintf(fname, MAX_BUFFER, "%s/%s", LOG_DIR, file);
+    logQueuePut(fname, file, string, 0);
   }
 }
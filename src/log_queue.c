@@ -0,0 +1,285 @@
+//*****************************************************************************
+//
+// log_queue.c
+//
+// a write-behind queue for log lines. See log_queue.h for how it is used.
+// Lines go onto an spsc_queue; since more than one thread can log, whoever
+// is pushing holds an atomic flag while they do it. The writer sleeps on a
+// semaphore between batches, and wakes up once a second regardless, to note
+// repeats that have ended. Everything the writer keeps track of -- open files
+// and the last collapsible line of each file -- is touched by it alone.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "spsc_queue.h"
+#include "gmcp.h"
+#include "log_queue.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how many lines can be waiting to be written before we start dropping them
+#define LOG_QUEUE_SIZE     8192
+
+typedef struct log_line {
+  char     *fname; // where it goes
+  char     *level; // what kind of line it is
+  char       *text; // what it says
+  char  stamp[16]; // and when it was logged
+  int        flags;
+} LOG_LINE;
+
+// the last collapsible line written to a file, and how many times it has
+// come in again since then
+typedef struct log_repeat {
+  LOG_LINE   *line;
+  time_t  written;
+  int     repeats;
+} LOG_REPEAT;
+
+SPSC_QUEUE          *log_queue = NULL;
+sem_t                log_ready; // posted once for every line pushed
+atomic_flag        log_pushing = ATOMIC_FLAG_INIT;
+atomic_bool       log_flushing = FALSE;
+atomic_int         log_dropped = 0;
+bool               log_running = FALSE;
+
+// set before the writer starts, and never changed after
+bool                  log_json = FALSE;
+int         log_repeat_seconds = 0;
+
+// only ever touched by the writer
+HASHTABLE           *log_files = NULL; // fname -> FILE, open for this batch
+HASHTABLE         *log_repeats = NULL; // fname -> LOG_REPEAT
+
+LOG_LINE *newLogLine(const char *fname, const char *level, const char *text,
+		     int flags) {
+  LOG_LINE *line = malloc(sizeof(LOG_LINE));
+  line->fname    = strdup(fname);
+  line->level    = strdupsafe(level);
+  line->text     = strdupsafe(text);
+  line->flags    = flags;
+  snprintf(line->stamp, sizeof(line->stamp), "%s", get_time());
+  return line;
+}
+
+void deleteLogLine(LOG_LINE *line) {
+  free(line->fname);
+  free(line->level);
+  free(line->text);
+  free(line);
+}
+
+//
+// write a line to an open file. If the line has been repeated, write a note
+// of how many times instead of the line itself
+void log_write(FILE *fl, LOG_LINE *line, int repeats) {
+  if(log_json && IS_SET(line->flags, LOGQ_STRUCTURED)) {
+    BUFFER *buf = newBuffer(MAX_BUFFER);
+    bufferCat(buf, "{\"time\":");
+    gmcpJSONString(buf, line->stamp);
+    bufferCat(buf, ",\"level\":");
+    gmcpJSONString(buf, line->level);
+    bufferCat(buf, ",\"msg\":");
+    gmcpJSONString(buf, line->text);
+    if(repeats > 0)
+      bprintf(buf, ",\"repeats\":%d", repeats);
+    bufferCat(buf, "}\n");
+    fputs(bufferString(buf), fl);
+    deleteBuffer(buf);
+  }
+  else if(repeats > 0)
+    fprintf(fl, "%s: (last message repeated %d times)\n",line->stamp,repeats);
+  else
+    fprintf(fl, "%s: %s%s", line->stamp, line->text,
+	    (IS_SET(line->flags, LOGQ_NEWLINE) ? "\n" : ""));
+}
+
+//
+// echo a line out to the terminal, if it wants to be
+void log_echo(LOG_LINE *line) {
+  if(IS_SET(line->flags, LOGQ_STDOUT)) {
+    printf("%s: %s\n", line->stamp, line->text);
+    fflush(stdout);
+  }
+  else if(IS_SET(line->flags, LOGQ_STDERR)) {
+    fprintf(stderr, "BUG %s: %s\n", line->stamp, line->text);
+    fflush(stderr);
+  }
+}
+
+//
+// the file a line goes to, opened for the rest of this batch
+FILE *log_file(const char *fname) {
+  FILE *fl = hashGet(log_files, fname);
+  if(fl == NULL && (fl = fopen(fname, "a")) != NULL)
+    hashPut(log_files, fname, fl);
+  return fl;
+}
+
+//
+// write out a note of a line's repeats, if it has had any since it was last
+// written
+void log_repeat_end(const char *fname, LOG_REPEAT *rep, time_t now) {
+  FILE *fl = NULL;
+  if(rep->repeats > 0 && (fl = log_file(fname)) != NULL)
+    log_write(fl, rep->line, rep->repeats);
+  rep->repeats = 0;
+  rep->written = now;
+}
+
+//
+// note the repeats that have gone on longer than we hold them for. If all is
+// TRUE, note every repeat no matter how recent
+void log_repeats_expire(bool all) {
+  if(hashSize(log_repeats) == 0)
+    return;
+  HASH_ITERATOR *rep_i = newHashIterator(log_repeats);
+  const char    *fname = NULL;
+  LOG_REPEAT      *rep = NULL;
+  time_t           now = time(NULL);
+  ITERATE_HASH(fname, rep, rep_i) {
+    if(rep->repeats > 0 && (all || now - rep->written >= log_repeat_seconds))
+      log_repeat_end(fname, rep, now);
+  } deleteHashIterator(rep_i);
+}
+
+//
+// write a line taken off of the queue, unless it is a repeat we are holding
+// back
+void log_line_write(LOG_LINE *line) {
+  FILE *fl = NULL;
+  int dropped = atomic_exchange(&log_dropped, 0);
+
+  // let whoever reads the log know there is a gap in it
+  if(dropped > 0 && (fl = log_file(line->fname)) != NULL)
+    fprintf(fl, "%s: (%d log lines were dropped)\n", line->stamp, dropped);
+
+  if(log_repeat_seconds > 0 && IS_SET(line->flags, LOGQ_COLLAPSE)) {
+    LOG_REPEAT *rep = hashGet(log_repeats, line->fname);
+    time_t      now = time(NULL);
+    if(rep != NULL && !strcmp(rep->line->text, line->text) &&
+       now - rep->written < log_repeat_seconds) {
+      rep->repeats++;
+      snprintf(rep->line->stamp, sizeof(rep->line->stamp), "%s", line->stamp);
+      return;
+    }
+    // something new. Finish off the old line's repeats, and keep this one
+    if(rep != NULL)
+      log_repeat_end(line->fname, rep, now);
+    else {
+      rep = calloc(1, sizeof(LOG_REPEAT));
+      rep->line = newLogLine(line->fname, line->level, NULL, line->flags);
+      hashPut(log_repeats, line->fname, rep);
+    }
+    free(rep->line->text);
+    rep->line->text = strdup(line->text);
+    rep->written    = now;
+  }
+
+  if((fl = log_file(line->fname)) != NULL)
+    log_write(fl, line, 0);
+  log_echo(line);
+}
+
+//
+// the loop our writer thread runs: wait for lines, write all there are, note
+// any repeats that have ended, and close up the files until next time
+void *log_queue_loop(void *arg) {
+  LOG_LINE *line = NULL;
+  for(;;) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += 1;
+    sem_timedwait(&log_ready, &until);
+
+    // look before we drain, so every line pushed before the flush was asked
+    // for is written before we say it is done
+    bool flushing = atomic_load(&log_flushing);
+    while((line = spscQueuePop(log_queue)) != NULL) {
+      log_line_write(line);
+      deleteLogLine(line);
+    }
+    log_repeats_expire(flushing);
+    hashClearWith(log_files, fclose);
+    if(flushing)
+      atomic_store(&log_flushing, FALSE);
+  }
+  return NULL;
+}
+
+
+
+//*****************************************************************************
+// implementation of log_queue.h
+//*****************************************************************************
+void init_log_queue(void) {
+  pthread_attr_t attr;
+  pthread_t    thread;
+
+  log_json           = (mudsettingGetInt("log_json") != 0);
+  log_repeat_seconds = MAX(0, mudsettingGetInt("log_repeat_seconds"));
+  log_queue          = newSPSCQueue(LOG_QUEUE_SIZE);
+  log_files          = newHashtable();
+  log_repeats        = newHashtable();
+  sem_init(&log_ready, 0, 0);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  log_running = TRUE;
+  if(pthread_create(&thread, &attr, log_queue_loop, NULL) != 0) {
+    log_running = FALSE;
+    log_string("Could not start the log writer thread. Logs will be written "
+	       "right away.");
+  }
+  pthread_attr_destroy(&attr);
+}
+
+void logQueuePut(const char *fname, const char *level, const char *text,
+		 int flags) {
+  LOG_LINE *line = newLogLine(fname, level, text, flags);
+  bool    pushed = FALSE;
+
+  // no writer; do it ourself, as the logs always used to be done
+  if(!log_running) {
+    FILE *fl = fopen(fname, "a");
+    if(fl != NULL) {
+      log_write(fl, line, 0);
+      fclose(fl);
+    }
+    log_echo(line);
+    deleteLogLine(line);
+    return;
+  }
+
+  while(atomic_flag_test_and_set_explicit(&log_pushing, memory_order_acquire))
+    ;
+  pushed = spscQueuePush(log_queue, line);
+  atomic_flag_clear_explicit(&log_pushing, memory_order_release);
+
+  if(pushed)
+    sem_post(&log_ready);
+  else {
+    atomic_fetch_add(&log_dropped, 1);
+    deleteLogLine(line);
+  }
+}
+
+void logQueueFlush(void) {
+  if(!log_running)
+    return;
+  atomic_store(&log_flushing, TRUE);
+  sem_post(&log_ready);
+  while(atomic_load(&log_flushing))
+    usleep(1000);
+}
@@ -0,0 +1,48 @@
+#ifndef __LOG_QUEUE_H
+#define __LOG_QUEUE_H
+//*****************************************************************************
+//
+// log_queue.h
+//
+// a write-behind queue for log lines. Whoever logs something stamps it with
+// the time and pushes it onto a lock-free ring, and a writer thread of our own
+// takes lines off of the ring, writes them to their files (and the terminal),
+// and closes the files again once the ring is empty. Lines that can be
+// collapsed are only written once if they repeat within log_repeat_seconds of
+// each other; one "repeated N times" line is written when the repeats end. If
+// log_json is set, lines that are marked structured are written as one JSON
+// object per line. If the ring is ever full, lines are dropped and a count of
+// them is written when there is room again.
+//
+// Lines can be put on the queue from any thread. Until init_log_queue has
+// been called, or if the writer thread can't be started, they are written
+// right away instead. Everything must be written out with logQueueFlush
+// before the mud shuts down or copyovers.
+//
+//*****************************************************************************
+
+// what can be done with a line
+#define LOGQ_NEWLINE      (1 << 0) // end the line with a newline
+#define LOGQ_COLLAPSE     (1 << 1) // collapse repeats of it
+#define LOGQ_STRUCTURED   (1 << 2) // may be written as JSON
+#define LOGQ_STDOUT       (1 << 3) // also echo it to the terminal
+#define LOGQ_STDERR       (1 << 4) //   or to stderr, as a bug
+
+//
+// start up the writer thread, with the log_json and log_repeat_seconds
+// settings as they are now
+void init_log_queue(void);
+
+//
+// queue up text to be written to fname, stamped with the current time. level
+// is what kind of line it is ("log", "bug"), for JSON output
+void logQueuePut(const char *fname, const char *level, const char *text,
+		 int flags);
+
+//
+// wait until every line that has been queued up has been written, and any
+// repeats being held back have been noted. Only to be used from the game
+// thread
+void logQueueFlush(void);
+
+#endif // __LOG_QUEUE_H
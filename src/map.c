@@ -4,6 +4,13 @@
 //
 // similar to a hashtable, but keys as well as values can be can be anything.
 //
+// maps are flat arrays of key:value entries, with open addressing and linear
+// probing. Almost every map is keyed by plain pointers, so unless a hashing
+// or comparison function was supplied, keys are hashed and compared by
+// address directly instead of through function pointers. Removed entries
+// leave a tombstone behind, so removing entries while iterating over a map
+// is safe.
+//
 //*****************************************************************************
 
 #include <stdlib.h>
@@ -11,119 +18,94 @@
 #include "map.h"
 
 
-// how big of a size does our map start out at?
-#define DEFAULT_MAP_SIZE        5
-
+// how big of a size does our map start out at? Must be a power of 2
+#define DEFAULT_MAP_SIZE        8
 
-int gen_hash_cmp(const void *key1, const void *key2) {
-  int val = (key2 - key1);
-  if(val < 0)      return -1;
-  else if(val > 0) return  1;
-  else             return  0;
-  return val;
-}
-
-unsigned long gen_hash_func(const void *key) {
-  return (unsigned long)key;
-}
+// what an entry's key is after the entry has been removed
+#define MAP_DELETED        ((const void *)&map_deleted)
+char map_deleted;
 
 struct map_iterator {
   int curr_bucket;
   MAP *map;
-  LIST_ITERATOR *bucket_i;
 };
 
 typedef struct map_entry {
-  const void *key;
+  const void *key; // NULL if the entry is empty, MAP_DELETED if removed
   void *val;
 } MAP_ENTRY;
 
 struct map_data {
   int size;
-  int num_buckets;
-  struct list **buckets;
-  unsigned long (* hash_func)(const void *key);
+  int used;          // how many entries are full or tombstones
+  int num_buckets;   // always a power of 2
+  MAP_ENTRY *buckets;
+  unsigned long (* hash_func)(const void *key); // NULL for pointer hashing
   int           (*  compares)(const void *key1, const void *key2);
 };
 
 
 //
-// an internal form of hashGet that returns the entire entry (key and val)
-//
-MAP_ENTRY *mapGetEntry(MAP *map, const void *key) {
-  unsigned int bucket = map->hash_func(key) % map->num_buckets;
-
-  if(map->buckets[bucket] == NULL)
-    return NULL;
-  else {
-    LIST_ITERATOR *list_i = newListIterator(map->buckets[bucket]);
-    MAP_ENTRY     *elem   = NULL;
-
-    ITERATE_LIST(elem, list_i) {
-      if(!map->compares(key, elem->key))
-	break;
-    } deleteListIterator(list_i);
-
-    return elem;
-  }
+// spread the bits of a pointer out. The low bits are mostly alignment
+static inline unsigned long map_ptr_hash(const void *key) {
+  unsigned long h = ((unsigned long)key >> 3) * 0x9E3779B97F4A7C15ULL;
+  return h ^ (h >> 29);
 }
 
-
-MAP_ENTRY *newMapEntry(const void *key, void *val) {
-  MAP_ENTRY *entry = malloc(sizeof(MAP_ENTRY));
-  entry->key = key;
-  entry->val = val;
-  return entry;
-}
-
-void deleteMapEntry(MAP_ENTRY *entry) {
-  free(entry);
+static inline unsigned long map_hash(MAP *map, const void *key) {
+  return (map->hash_func ? map->hash_func(key) : map_ptr_hash(key));
 }
 
-
 //
-// Collect all of the MAP_ENTRYs in a map into a single list
-LIST *mapCollectEntries(MAP *map) {
-  LIST *list = newList();
-  int i;
-  for(i = 0; i < map->num_buckets; i++) {
-    if(map->buckets[i] == NULL) continue;
-    LIST_ITERATOR *list_i = newListIterator(map->buckets[i]);
-    MAP_ENTRY       *elem = NULL;
-    ITERATE_LIST(elem, list_i) {
-      listPut(list, elem);
-    } deleteListIterator(list_i);
+// an internal form of hashGet that returns the entire entry (key and val)
+//
+static inline MAP_ENTRY *mapGetEntry(MAP *map, const void *key) {
+  unsigned int mask = map->num_buckets - 1;
+  unsigned int    i = map_hash(map, key) & mask;
+  if(map->compares == NULL) {
+    for(; map->buckets[i].key != NULL; i = (i + 1) & mask)
+      if(map->buckets[i].key == key)
+	return &map->buckets[i];
   }
-  return list;
+  else {
+    for(; map->buckets[i].key != NULL; i = (i + 1) & mask)
+      if(map->buckets[i].key != MAP_DELETED &&
+	 !map->compares(key, map->buckets[i].key))
+	return &map->buckets[i];
+  }
+  return NULL;
 }
 
+//
+// put an entry we know isn't in the map into its bucket
+void map_insert(MAP *map, const void *key, void *val) {
+  unsigned int mask = map->num_buckets - 1;
+  unsigned int    i = map_hash(map, key) & mask;
+  while(map->buckets[i].key != NULL && map->buckets[i].key != MAP_DELETED)
+    i = (i + 1) & mask;
+  if(map->buckets[i].key == NULL)
+    map->used++;
+  map->buckets[i].key = key;
+  map->buckets[i].val = val;
+  map->size++;
+}
 
 //
-// expand a map to the new size
+// expand a map to the new size, dropping tombstones
 void mapExpand(MAP *map, int size) {
-  // collect all of the key:value pairs
-  LIST     *entries = mapCollectEntries(map);
-  MAP_ENTRY  *entry = NULL;
+  MAP_ENTRY *old     = map->buckets;
+  int        old_num = map->num_buckets;
   int i;
 
-  // delete all of the current buckets
-  for(i = 0; i < map->num_buckets; i++) {
-    if(map->buckets[i] == NULL) continue;
-    deleteList(map->buckets[i]);
-  }
-  free(map->buckets);
-
-  // now, make new buckets and set them to NULL
-  map->buckets = calloc(size, sizeof(LIST *));
+  map->buckets     = calloc(size, sizeof(MAP_ENTRY));
   map->num_buckets = size;
+  map->size        = 0;
+  map->used        = 0;
 
-  // now, we put all of our entries back into the new buckets
-  while((entry = listPop(entries)) != NULL) {
-    unsigned int bucket = map->hash_func(entry->key) % map->num_buckets;
-    if(map->buckets[bucket] == NULL) map->buckets[bucket] = newList();
-    listPut(map->buckets[bucket], entry);
-  }
-  deleteList(entries);
+  for(i = 0; i < old_num; i++)
+    if(old[i].key != NULL && old[i].key != MAP_DELETED)
+      map_insert(map, old[i].key, old[i].val);
+  free(old);
 }
 
 
@@ -137,10 +119,13 @@ void mapExpand(MAP *map, int size) {
 MAP *newMapSize(void *hash_func, void *compares, int size) {
   MAP *map = malloc(sizeof(MAP));
   map->size        = 0;
-  map->num_buckets = size;
-  map->hash_func   = (hash_func ? hash_func : gen_hash_func);
-  map->compares    = (compares  ? compares  : gen_hash_cmp);
-  map->buckets     = calloc(map->num_buckets, sizeof(LIST *));
+  map->used        = 0;
+  map->num_buckets = DEFAULT_MAP_SIZE;
+  while(map->num_buckets * 3 < size * 4)
+    map->num_buckets *= 2;
+  map->hash_func   = hash_func;
+  map->compares    = compares;
+  map->buckets     = calloc(map->num_buckets, sizeof(MAP_ENTRY));
   return map;
 }
 
@@ -149,11 +134,6 @@ MAP *newMap(void *hash_func, void *compares) {
 }
 
 void deleteMap(MAP *map) {
-  int i;
-  for(i = 0; i < map->num_buckets; i++) {
-    if(map->buckets[i])
-      deleteListWith(map->buckets[i], deleteMapEntry);
-  }
   free(map->buckets);
   free(map);
 }
@@ -165,19 +145,12 @@ int mapPut(MAP *map, const void *key, void *val) {
   if(elem)
     elem->val = val;
   else {
-    // first, see if we'll need to expand the map
-    if((map->size * 80)/100 > map->num_buckets)
-      mapExpand(map, (map->num_buckets * 150)/100);
-
-    unsigned int bucket = map->hash_func(key) % map->num_buckets;
-
-    // if the bucket doesn't exist yet, create it
-    if(map->buckets[bucket] == NULL)
-      map->buckets[bucket] = newList();
-
-    MAP_ENTRY *entry = newMapEntry(key, val);
-    listPut(map->buckets[bucket], entry);
-    map->size++;
+    // keep us no more than 3/4 full, counting tombstones. If we are mostly
+    // tombstones, we can clean up without growing
+    if((map->used + 1) * 4 > map->num_buckets * 3)
+      mapExpand(map, ((map->size + 1) * 2 > map->num_buckets ?
+		      map->num_buckets * 2 : map->num_buckets));
+    map_insert(map, key, val);
   }
 
   return 1;
@@ -192,28 +165,14 @@ void *mapGet(MAP *map, const void *key) {
 }
 
 void *mapRemove(MAP *map, const void *key) {
-  unsigned int bucket = map->hash_func(key) % map->num_buckets;
-
-  if(map->buckets[bucket] == NULL)
+  MAP_ENTRY *elem = mapGetEntry(map, key);
+  if(elem == NULL)
     return NULL;
-  else {
-    LIST_ITERATOR *list_i = newListIterator(map->buckets[bucket]);
-    MAP_ENTRY       *elem = NULL;
-
-    ITERATE_LIST(elem, list_i) {
-      if(!map->compares(key, elem->key))
-	break;
-    } deleteListIterator(list_i);
-
-    if(elem == NULL)
-      return NULL;
-
-    void *val = elem->val;
-    listRemove(map->buckets[bucket], elem);
-    deleteMapEntry(elem);
-    map->size--;
-    return val;
-  }
+  void *val = elem->val;
+  elem->key = MAP_DELETED;
+  elem->val = NULL;
+  map->size--;
+  return val;
 }
 
 int mapIn(MAP *map, const void *key) {
@@ -232,79 +191,52 @@ int mapSize(MAP *map) {
 // documentation in hashmap.h
 //
 //*****************************************************************************
+
+//
+// move the iterator up to the next full entry, starting with the one it's on
+void map_iterator_skip(MAP_ITERATOR *I) {
+  while(I->curr_bucket < I->map->num_buckets &&
+	(I->map->buckets[I->curr_bucket].key == NULL ||
+	 I->map->buckets[I->curr_bucket].key == MAP_DELETED))
+    I->curr_bucket++;
+}
+
 MAP_ITERATOR *newMapIterator(MAP *map) {
   MAP_ITERATOR *I = malloc(sizeof(MAP_ITERATOR));
   I->map = map;
-  I->bucket_i = NULL;
   mapIteratorReset(I);
 
   return I;
 }
 
 void        deleteMapIterator     (MAP_ITERATOR *I) {
-  if(I->bucket_i) deleteListIterator(I->bucket_i);
   free(I);
 }
 
 void        mapIteratorReset      (MAP_ITERATOR *I) {
-  int i;
-
-  if(I->bucket_i) deleteListIterator(I->bucket_i);
-  I->bucket_i = NULL;
   I->curr_bucket = 0;
-
-  // bucket_i will be NULL if there are no elements
-  for(i = 0; i < I->map->num_buckets; i++) {
-    if(I->map->buckets[i] != NULL &&
-       listSize(I->map->buckets[i]) > 0) {
-      I->curr_bucket = i;
-      I->bucket_i = newListIterator(I->map->buckets[i]);
-      break;
-    }
-  }
+  map_iterator_skip(I);
 }
 
 
 void        mapIteratorNext       (MAP_ITERATOR *I) {
-  // no elements in the hashmap
-  if(I->bucket_i == NULL)
-    return;
-  // we're at the end of our list
-  else if(listIteratorNext(I->bucket_i) == NULL) {
-    deleteListIterator(I->bucket_i);
-    I->bucket_i = NULL;
+  if(I->curr_bucket < I->map->num_buckets) {
     I->curr_bucket++;
-    
-    for(; I->curr_bucket < I->map->num_buckets; I->curr_bucket++) {
-      if(I->map->buckets[I->curr_bucket] != NULL &&
-	 listSize(I->map->buckets[I->curr_bucket]) > 0) {
-	I->bucket_i = newListIterator(I->map->buckets[I->curr_bucket]);
-	break;
-      }
-    }
+    map_iterator_skip(I);
   }
 }
 
 const void *mapIteratorCurrentKey(MAP_ITERATOR *I) {
-  if(!I->bucket_i)
+  // the current entry may have been removed since we last moved
+  map_iterator_skip(I);
+  if(I->curr_bucket >= I->map->num_buckets)
     return NULL;
-  else {
-    MAP_ENTRY *entry = ((MAP_ENTRY *) listIteratorCurrent(I->bucket_i));
-    if(entry)
-      return entry->key;
-    else
-      return NULL;
-  }
+  return I->map->buckets[I->curr_bucket].key;
 }
 
 void       *mapIteratorCurrentVal (MAP_ITERATOR *I) {
-  if(!I->bucket_i) 
+  map_iterator_skip(I);
+  if(I->curr_bucket >= I->map->num_buckets)
     return NULL;
-  else {
-    MAP_ENTRY *entry = ((MAP_ENTRY *) listIteratorCurrent(I->bucket_i));
-    if(entry)
-      return entry->val;
-    else
-      return NULL;
-  }
+  return I->map->buckets[I->curr_bucket].val;
 }
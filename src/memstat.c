@@ -0,0 +1,90 @@
+//*****************************************************************************
+//
+// memstat.c
+//
+// counts of what the core datastructures are holding on to. See memstat.h.
+// This file depends on nothing else in the mud, so the standalone benchmarks
+// can link the datastructures with it.
+//
+//*****************************************************************************
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "memstat.h"
+
+
+
+//*****************************************************************************
+// local variables
+//*****************************************************************************
+
+// names of the tags, in the order they appear in MEM_TAG
+const char *mem_tag_names[NUM_MEM_TAGS] = {
+  "buffer",
+  "list",
+  "list_iterator",
+  "hashtable",
+  "hash_iterator",
+  "storage_set",
+  "obj",
+  "char",
+  "char_looks",
+  "char_pool",
+  "obj_pool",
+  "room",
+  "proto",
+  "proto_code",
+  "hook_string",
+};
+
+// the counts can change on any thread, but nothing needs them to be seen in
+// any particular order, so they are only ever relaxed atomics
+atomic_llong mem_live [NUM_MEM_TAGS];
+atomic_llong mem_bytes[NUM_MEM_TAGS];
+atomic_llong mem_made [NUM_MEM_TAGS];
+
+
+
+//*****************************************************************************
+// implementation of memstat.h
+//*****************************************************************************
+void memNote(MEM_TAG tag, int count, long long bytes) {
+  if(count != 0)
+    atomic_fetch_add_explicit(&mem_live[tag], count, memory_order_relaxed);
+  if(count > 0)
+    atomic_fetch_add_explicit(&mem_made[tag], count, memory_order_relaxed);
+  if(bytes != 0)
+    atomic_fetch_add_explicit(&mem_bytes[tag], bytes, memory_order_relaxed);
+}
+
+void *memAlloc(MEM_TAG tag, size_t bytes) {
+  memNote(tag, 1, bytes);
+  return malloc(bytes);
+}
+
+void *memCalloc(MEM_TAG tag, size_t bytes) {
+  memNote(tag, 1, bytes);
+  return calloc(1, bytes);
+}
+
+void memFree(MEM_TAG tag, void *ptr, size_t bytes) {
+  memNote(tag, -1, -(long long)bytes);
+  free(ptr);
+}
+
+const char *memTagName(MEM_TAG tag) {
+  return mem_tag_names[tag];
+}
+
+long long memTagLive(MEM_TAG tag) {
+  return atomic_load_explicit(&mem_live[tag], memory_order_relaxed);
+}
+
+long long memTagBytes(MEM_TAG tag) {
+  return atomic_load_explicit(&mem_bytes[tag], memory_order_relaxed);
+}
+
+long long memTagMade(MEM_TAG tag) {
+  return atomic_load_explicit(&mem_made[tag], memory_order_relaxed);
+}
@@ -0,0 +1,61 @@
+#ifndef __MEMSTAT_H
+#define __MEMSTAT_H
+//*****************************************************************************
+//
+// memstat.h
+//
+// memory accounting for the mud's core datastructures. Each kind of thing
+// gets a tag, and its constructors and destructors note how many of it are
+// alive and how many bytes they are holding on to, so it can be told whether
+// the mud is growing because of rooms, objects, buffers, hook strings, or
+// iterators someone forgot to delete. Only what the tagged structure itself
+// mallocs is counted; a character's buffers are counted as buffers, its
+// lists as lists, and so on. Things allocated from an arena are not counted,
+// since the arena frees them all at once.
+//
+// The counts can be noted from any thread. They are shown by the memstat
+// admin command, and served on the metrics port.
+//
+//*****************************************************************************
+
+typedef enum {
+  MEM_BUFFER,
+  MEM_LIST,
+  MEM_LIST_ITERATOR,
+  MEM_HASHTABLE,
+  MEM_HASH_ITERATOR,
+  MEM_STORAGE_SET,
+  MEM_OBJ,
+  MEM_CHAR,
+  MEM_CHAR_LOOKS,
+  MEM_CHAR_POOL,
+  MEM_OBJ_POOL,
+  MEM_ROOM,
+  MEM_PROTO,
+  MEM_PROTO_CODE,
+  MEM_HOOK_STRING,
+  NUM_MEM_TAGS
+} MEM_TAG;
+
+//
+// malloc, calloc, or free something, and note it under the tag. The free
+// must be told how big the thing was
+void *memAlloc (MEM_TAG tag, size_t bytes);
+void *memCalloc(MEM_TAG tag, size_t bytes);
+void  memFree  (MEM_TAG tag, void *ptr, size_t bytes);
+
+//
+// note that things have been made (a positive count) or deleted (a negative
+// one) without going through the wrappers, or that the bytes held by
+// something tagged have grown or shrunk (a count of 0)
+void memNote(MEM_TAG tag, int count, long long bytes);
+
+//
+// what a tag is called, how many things under it are alive, how many bytes
+// they hold, and how many have ever been made
+const char *memTagName (MEM_TAG tag);
+long long   memTagLive (MEM_TAG tag);
+long long   memTagBytes(MEM_TAG tag);
+long long   memTagMade (MEM_TAG tag);
+
+#endif // __MEMSTAT_H
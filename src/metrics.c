@@ -0,0 +1,370 @@
+//*****************************************************************************
+//
+// metrics.c
+//
+// serves a snapshot of the mud's vital signs on a port of its own. See
+// metrics.h for how it is used. The snapshot is a plain string; the game
+// thread builds a new one and swaps it in under a mutex, and the metrics
+// thread copies out whichever one is current when a scrape comes in. Scrapes
+// are answered one at a time, and a client gets a few seconds to send its
+// request and read its answer before we hang up on it.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "hooks.h"
+#include "pulse.h"
+#include "event.h"
+#include "action.h"
+#include "socket.h"
+#include "memstat.h"
+#include "metrics.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how many seconds a scraper has to send its request, and read our answer
+#define METRICS_TIMEOUT        5
+
+// the most of a request we'll look at before answering it
+#define METRICS_REQUEST_SIZE   1024
+
+// the latest snapshot, and what guards it when it is swapped
+char        *metrics_snapshot = NULL;
+pthread_mutex_t metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// the port we listen on, and the functions that add to our snapshot
+int           metrics_control = -1;
+LIST         *metrics_sources = NULL;
+
+//
+// write the durations of one pulse phase onto a histogram. Our buckets hold
+// counts of their own; the text format wants each to include the ones below
+void metrics_pulse_phase(BUFFER *buf, int phase) {
+  BUFFER *labels = newBuffer(SMALL_BUFFER);
+  long long  sum = 0;
+  int bucket;
+  for(bucket = 0; bucket < NUM_PULSE_BUCKETS; bucket++) {
+    long long bound = pulseBucketGetBound(bucket);
+    sum += pulsePhaseGetBucket(phase, bucket);
+    bufferClear(labels);
+    bprintf(labels, "phase=\"%s\",le=", pulsePhaseGetName(phase));
+    if(bound < 0)
+      bufferCat(labels, "\"+Inf\"");
+    else
+      bprintf(labels, "\"%g\"", bound / 1000000.0);
+    metricsValue(buf, "nakedmud_pulse_phase_seconds_bucket",
+		 bufferString(labels), sum);
+  }
+  bufferClear(labels);
+  bprintf(labels, "phase=\"%s\"", pulsePhaseGetName(phase));
+  metricsValue(buf, "nakedmud_pulse_phase_seconds_sum", bufferString(labels),
+	       pulsePhaseGetTotal(phase) / 1000000.0);
+  metricsValue(buf, "nakedmud_pulse_phase_seconds_count", bufferString(labels),
+	       pulsePhaseGetCount(phase));
+  deleteBuffer(labels);
+}
+
+//
+// write how many times a hook has been run
+void metrics_hook_run(const char *type, long long runs, void *buf) {
+  BUFFER *labels = newBuffer(SMALL_BUFFER);
+  bufferCat(labels, "hook=");
+  metricsLabelValue(labels, type);
+  metricsValue(buf, "nakedmud_hook_runs_total", bufferString(labels), runs);
+  deleteBuffer(labels);
+}
+
+//
+// what each tag of memstat is holding on to
+void metrics_memory(BUFFER *buf) {
+  const char *names[] = { "nakedmud_memory_live", "nakedmud_memory_bytes",
+			  "nakedmud_memory_made_total" };
+  long long (* funcs[])(MEM_TAG) = { memTagLive, memTagBytes, memTagMade };
+  int i, tag;
+
+  metricsDeclare(buf, names[0], "gauge",
+		 "Core datastructures alive, by tag.");
+  metricsDeclare(buf, names[1], "gauge",
+		 "Bytes held by core datastructures, by tag.");
+  metricsDeclare(buf, names[2], "counter",
+		 "Core datastructures ever made, by tag.");
+  for(i = 0; i < 3; i++) {
+    for(tag = 0; tag < NUM_MEM_TAGS; tag++) {
+      char labels[SMALL_BUFFER];
+      snprintf(labels, sizeof(labels), "tag=\"%s\"", memTagName(tag));
+      metricsValue(buf, names[i], labels, funcs[i](tag));
+    }
+  }
+}
+
+//
+// write out everything the core of the mud has to say about itself
+void metrics_core(BUFFER *buf) {
+  long long raw = socketTotalMCCPRaw();
+  long long  compressed = socketTotalMCCPCompressed();
+  int phase;
+
+  metricsDeclare(buf, "nakedmud_pulse_phase_seconds", "histogram",
+		 "How long each phase of a pulse took.");
+  for(phase = 0; phase < NUM_PULSE_PHASES; phase++)
+    metrics_pulse_phase(buf, phase);
+  metricsDeclare(buf, "nakedmud_pulse_phase_last_seconds", "gauge",
+		 "How long each phase of the last pulse took.");
+  for(phase = 0; phase < NUM_PULSE_PHASES; phase++) {
+    char labels[SMALL_BUFFER];
+    snprintf(labels, sizeof(labels), "phase=\"%s\"", pulsePhaseGetName(phase));
+    metricsValue(buf, "nakedmud_pulse_phase_last_seconds", labels,
+		 pulsePhaseGetLast(phase) / 1000000.0);
+  }
+  metricsDeclare(buf, "nakedmud_pulse_catchup_total", "counter",
+		 "Pulses run back-to-back to catch up after lagging.");
+  metricsValue(buf, "nakedmud_pulse_catchup_total", NULL,
+	       pulseGetCatchupCount());
+  metricsDeclare(buf, "nakedmud_pulse_dropped_total", "counter",
+		 "Pulses given up on because the game was too far behind.");
+  metricsValue(buf, "nakedmud_pulse_dropped_total", NULL,
+	       pulseGetDroppedCount());
+
+  metricsDeclare(buf, "nakedmud_events_queued", "gauge",
+		 "Events waiting to go off.");
+  metricsValue(buf, "nakedmud_events_queued", NULL, count_events());
+  metricsDeclare(buf, "nakedmud_actions_queued", "gauge",
+		 "Actions underway.");
+  metricsValue(buf, "nakedmud_actions_queued", NULL, count_actions());
+
+  metricsDeclare(buf, "nakedmud_sockets", "gauge", "Connected sockets.");
+  metricsValue(buf, "nakedmud_sockets", NULL, listSize(socket_list));
+  metricsDeclare(buf, "nakedmud_rooms", "gauge", "Rooms in the game.");
+  metricsValue(buf, "nakedmud_rooms", NULL, listSize(room_list));
+  metricsDeclare(buf, "nakedmud_objects", "gauge", "Objects in the game.");
+  metricsValue(buf, "nakedmud_objects", NULL, listSize(object_list));
+  metricsDeclare(buf, "nakedmud_mobiles", "gauge", "Mobiles in the game.");
+  metricsValue(buf, "nakedmud_mobiles", NULL, listSize(mobile_list));
+
+  metricsDeclare(buf, "nakedmud_bytes_read_total", "counter",
+		 "Bytes read from all sockets.");
+  metricsValue(buf, "nakedmud_bytes_read_total", NULL,
+	       socketTotalBytesRead());
+  metricsDeclare(buf, "nakedmud_bytes_written_total", "counter",
+		 "Bytes written to all sockets.");
+  metricsValue(buf, "nakedmud_bytes_written_total", NULL,
+	       socketTotalBytesWritten());
+  metricsDeclare(buf, "nakedmud_mccp_raw_bytes_total", "counter",
+		 "Bytes of output that went into MCCP compression.");
+  metricsValue(buf, "nakedmud_mccp_raw_bytes_total", NULL, raw);
+  metricsDeclare(buf, "nakedmud_mccp_compressed_bytes_total", "counter",
+		 "Bytes of output that came out of MCCP compression.");
+  metricsValue(buf, "nakedmud_mccp_compressed_bytes_total", NULL, compressed);
+  metricsDeclare(buf, "nakedmud_mccp_ratio", "gauge",
+		 "How many bytes of output MCCP has turned into one.");
+  metricsValue(buf, "nakedmud_mccp_ratio", NULL,
+	       (compressed > 0 ? (double)raw / compressed : 0));
+  metricsDeclare(buf, "nakedmud_mccp_cpu_seconds_total", "counter",
+		 "CPU time spent on MCCP compression.");
+  metricsValue(buf, "nakedmud_mccp_cpu_seconds_total", NULL,
+	       socketTotalMCCPUsec() / 1000000.0);
+
+  metricsDeclare(buf, "nakedmud_hook_runs_total", "counter",
+		 "Runs of each hook that had someone listening.");
+  hookForeachRun(metrics_hook_run, buf);
+
+  metrics_memory(buf);
+}
+
+//
+// build a new snapshot, and swap it in for the old one
+void metrics_snapshot_build(void) {
+  BUFFER              *buf = newBuffer(MAX_BUFFER * 4);
+  LIST_ITERATOR *source_i = newListIterator(metrics_sources);
+  void (* source)(BUFFER *) = NULL;
+  char                *old = NULL;
+
+  ITERATE_LIST(source, source_i) {
+    source(buf);
+  } deleteListIterator(source_i);
+
+  pthread_mutex_lock(&metrics_mutex);
+  old              = metrics_snapshot;
+  metrics_snapshot = strdup(bufferString(buf));
+  pthread_mutex_unlock(&metrics_mutex);
+
+  if(old != NULL)
+    free(old);
+  deleteBuffer(buf);
+}
+
+void metrics_heartbeat(const char *info) {
+  metrics_snapshot_build();
+}
+
+//
+// write everything we have to a scraper. Returns FALSE if it hung up
+bool metrics_write(int fd, const char *data, int len) {
+  while(len > 0) {
+    int sent = send(fd, data, len, MSG_NOSIGNAL);
+    if(sent <= 0)
+      return FALSE;
+    data += sent;
+    len  -= sent;
+  }
+  return TRUE;
+}
+
+//
+// answer one scrape. We only wait for the first line of the request, since
+// that is all we care about
+void metrics_answer(int fd) {
+  char request[METRICS_REQUEST_SIZE];
+  char  header[SMALL_BUFFER];
+  int      len = 0;
+  char   *body = NULL;
+
+  while(len < METRICS_REQUEST_SIZE - 1 && memchr(request, '\n', len) == NULL){
+    int got = recv(fd, request + len, METRICS_REQUEST_SIZE - 1 - len, 0);
+    if(got <= 0)
+      return;
+    len += got;
+  }
+  request[len] = '\0';
+
+  if(strncmp(request, "GET /metrics ", 13) && strncmp(request, "GET / ", 6)) {
+    const char *missing = "HTTP/1.0 404 Not Found\r\n"
+      "Content-Type: text/plain\r\nContent-Length: 10\r\n\r\nNot found\n";
+    metrics_write(fd, missing, strlen(missing));
+    return;
+  }
+
+  pthread_mutex_lock(&metrics_mutex);
+  body = strdupsafe(metrics_snapshot);
+  pthread_mutex_unlock(&metrics_mutex);
+
+  snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\n"
+	   "Content-Type: text/plain; version=0.0.4\r\n"
+	   "Content-Length: %d\r\n\r\n", (int)strlen(body));
+  if(metrics_write(fd, header, strlen(header)))
+    metrics_write(fd, body, strlen(body));
+  free(body);
+}
+
+//
+// the loop our metrics thread runs: take scrapes one at a time, forever
+void *metrics_loop(void *arg) {
+  struct timeval timeout = { METRICS_TIMEOUT, 0 };
+  for(;;) {
+    int fd = accept(metrics_control, NULL, NULL);
+    if(fd < 0)
+      continue;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    metrics_answer(fd);
+    close(fd);
+  }
+  return NULL;
+}
+
+//
+// open up the port we answer scrapes on. It is closed across copyovers, so
+// the new process can open it again, and shared on an upgrade, while the old
+// process waits to hand over. Returns -1 if it couldn't be opened
+int metrics_listen(int port) {
+  struct sockaddr_in addr;
+  int fd = socket(AF_INET, SOCK_STREAM, 0), reuse = 1;
+  if(fd < 0)
+    return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port        = htons(port);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#ifdef SO_REUSEPORT
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+#endif
+  if(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+     listen(fd, SOMAXCONN) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+
+//*****************************************************************************
+// implementation of metrics.h
+//*****************************************************************************
+void init_metrics(void) {
+  pthread_attr_t attr;
+  pthread_t    thread;
+  int            port = mudsettingGetInt("metrics_port");
+
+  metrics_sources = newList();
+  listQueue(metrics_sources, metrics_core);
+  if(port <= 0)
+    return;
+
+  if((metrics_control = metrics_listen(port)) < 0) {
+    log_string("Could not open metrics port %d.", port);
+    return;
+  }
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if(pthread_create(&thread, &attr, metrics_loop, NULL) != 0) {
+    log_string("Could not start the metrics thread.");
+    close(metrics_control);
+    metrics_control = -1;
+  }
+  else {
+    log_string("Serving metrics on port %d.", port);
+    hookAdd("heartbeat", metrics_heartbeat);
+  }
+  pthread_attr_destroy(&attr);
+}
+
+void metricsAddSource(void (* func)(BUFFER *buf)) {
+  listQueue(metrics_sources, func);
+}
+
+void metricsDeclare(BUFFER *buf, const char *name, const char *type,
+		    const char *help) {
+  bprintf(buf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metricsValue(BUFFER *buf, const char *name, const char *labels,
+		  double val) {
+  if(labels != NULL && *labels)
+    bprintf(buf, "%s{%s} ", name, labels);
+  else
+    bprintf(buf, "%s ", name);
+  // counts are written out whole, however big they get
+  if(val == (long long)val)
+    bprintf(buf, "%lld\n", (long long)val);
+  else
+    bprintf(buf, "%g\n", val);
+}
+
+void metricsLabelValue(BUFFER *buf, const char *val) {
+  bufferCat(buf, "\"");
+  for(; *val; val++) {
+    if(*val == '\\' || *val == '"')
+      bprintf(buf, "\\%c", *val);
+    else if(*val == '\n')
+      bufferCat(buf, "\\n");
+    else
+      bprintf(buf, "%c", *val);
+  }
+  bufferCat(buf, "\"");
+}
@@ -0,0 +1,46 @@
+#ifndef __METRICS_H
+#define __METRICS_H
+//*****************************************************************************
+//
+// metrics.h
+//
+// an optional second port that serves the mud's vital signs -- pulse
+// timings, event and action queue lengths, socket and world counts, bytes
+// in and out, hook runs -- in the Prometheus text format, for monitoring
+// tools to scrape. It is turned on by giving the metrics_port setting a
+// port number; 0 leaves it off.
+//
+// The game thread builds a snapshot of everything every heartbeat, and a
+// thread of our own answers scrapes with the latest snapshot, so a scrape
+// never waits on the game, and the game never waits on a scrape. Modules
+// can add their own metrics to the snapshot with metricsAddSource.
+//
+//*****************************************************************************
+
+//
+// open up the metrics port, if there is one, and start answering scrapes
+void init_metrics(void);
+
+//
+// add a function that writes metrics onto the snapshot. It is called from
+// the game thread every time a snapshot is built. Each metric should be
+// declared with metricsDeclare before its samples are written
+void metricsAddSource(void (* func)(BUFFER *buf));
+
+//
+// write the HELP and TYPE lines of a metric. type is "counter", "gauge", or
+// "histogram"
+void metricsDeclare(BUFFER *buf, const char *name, const char *type,
+		    const char *help);
+
+//
+// write one sample of a metric. labels are written as they are, and can be
+// NULL; values in them should be escaped with metricsLabelValue
+void metricsValue(BUFFER *buf, const char *name, const char *labels,
+		  double val);
+
+//
+// write a label value onto buf, quoted and escaped as the text format wants
+void metricsLabelValue(BUFFER *buf, const char *val);
+
+#endif // __METRICS_H
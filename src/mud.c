@@ -33,6 +33,38 @@ STORAGE_SET *settings = NULL;
 // the path to our mudlib directory
 char *mudlib_path = NULL;
 
+//
+// typed copies of our hot settings. These hold the defaults until our
+// settings are loaded, so nothing that runs before then divides by zero
+MUD_SETTINGS_CACHE mud_settings = {
+  0,                        // version
+  DFLT_PULSES_PER_SECOND,
+  DFLT_LISTEN_PORT,
+  DFLT_SCREEN_WIDTH,
+  DFLT_PARA_INDENT,
+  DFLT_OUTPUT_HIGH_WATER,
+  DFLT_OUTPUT_OVERFLOW,
+  DFLT_COMPRESS_LEVEL,
+  DFLT_COMPRESS_MEM_LEVEL,
+  DFLT_COMPRESS_WINDOW_BITS,
+  DFLT_COMPRESS_MIN_BYTES,
+  DFLT_COMPRESS_BUSY_LEVEL,
+  DFLT_COMPRESS_BUSY_PERCENT,
+  DFLT_START_ROOM,
+  DFLT_WORLD_PATH,
+  DFLT_MUD_NAME,
+  DFLT_SOMEWHERE,
+  DFLT_SOMETHING,
+  DFLT_SOMEONE,
+  DFLT_NOTHING_SPECIAL,
+  DFLT_WHAT,
+};
+
+//
+// have we made our own copies of the cached strings yet? Until we have, they
+// point to the string literals above and must not be freed
+bool mud_settings_strs_copied = FALSE;
+
 //
 // for generating unique IDs to characters, rooms, objects, exits, etc
 int next_available_uid = START_UID;
@@ -59,6 +91,72 @@ void set_mudlib_path(const char *path) {
   mudlib_path = strdup(path);
 }
 
+//*****************************************************************************
+// the settings cache
+//*****************************************************************************
+
+//
+// replace one of our cached strings with a copy of the setting's value
+void mud_settings_cache_string(const char **cached, const char *key) {
+  char *old = (mud_settings_strs_copied ? (char *)*cached : NULL);
+  *cached = strdup(read_string(settings, key));
+  if(old) free(old);
+}
+
+//
+// bring our cached copies of hot settings up to date with the storage set
+void mud_settings_refresh(void) {
+  if(settings == NULL)
+    return;
+  mud_settings.pulses_per_second = read_int(settings, "pulses_per_second");
+  mud_settings.listening_port    = read_int(settings, "listening_port");
+  mud_settings.screen_width      = read_int(settings, "screen_width");
+  mud_settings.paragraph_indent  = read_int(settings, "paragraph_indent");
+  mud_settings.output_high_water = read_int(settings, "output_high_water");
+  mud_settings_cache_string(&mud_settings.output_overflow, "output_overflow");
+  mud_settings.compress_level    = read_int(settings, "compress_level");
+  mud_settings.compress_mem_level= read_int(settings, "compress_mem_level");
+  mud_settings.compress_window_bits =
+    read_int(settings, "compress_window_bits");
+  mud_settings.compress_min_bytes= read_int(settings, "compress_min_bytes");
+  mud_settings.compress_busy_level = read_int(settings, "compress_busy_level");
+  mud_settings.compress_busy_percent =
+    read_int(settings, "compress_busy_percent");
+  mud_settings_cache_string(&mud_settings.start_room,      "start_room");
+  mud_settings_cache_string(&mud_settings.world_path,      "world_path");
+  mud_settings_cache_string(&mud_settings.mud_name,        "mud_name");
+  mud_settings_cache_string(&mud_settings.message_somewhere,
+			    "message_somewhere");
+  mud_settings_cache_string(&mud_settings.message_something,
+			    "message_something");
+  mud_settings_cache_string(&mud_settings.message_someone,
+			    "message_someone");
+  mud_settings_cache_string(&mud_settings.message_nothing_special,
+			    "message_nothing_special");
+  mud_settings_cache_string(&mud_settings.message_what, "message_what");
+  mud_settings_strs_copied = TRUE;
+
+  // a pulse rate of zero would have us dividing by zero all over the place
+  if(mud_settings.pulses_per_second <= 0)
+    mud_settings.pulses_per_second = DFLT_PULSES_PER_SECOND;
+  // zlib only understands levels 0-9, memory levels 1-9, and windows of
+  // 2^9 to 2^15 bytes
+  if(mud_settings.compress_level < 0 || mud_settings.compress_level > 9)
+    mud_settings.compress_level = DFLT_COMPRESS_LEVEL;
+  if(mud_settings.compress_mem_level < 1 || 
+     mud_settings.compress_mem_level > 9)
+    mud_settings.compress_mem_level = DFLT_COMPRESS_MEM_LEVEL;
+  if(mud_settings.compress_busy_level < 0 ||
+     mud_settings.compress_busy_level > 9)
+    mud_settings.compress_busy_level = DFLT_COMPRESS_BUSY_LEVEL;
+  if(mud_settings.compress_window_bits < 9 ||
+     mud_settings.compress_window_bits > 15)
+    mud_settings.compress_window_bits = DFLT_COMPRESS_WINDOW_BITS;
+  mud_settings.version++;
+}
+
+
+
 //*****************************************************************************
 // implementation of functions in mud.h
 //*****************************************************************************
@@ -102,36 +200,166 @@ void init_mud_settings() {
     mudsettingSetString("message_what", DFLT_WHAT);
   if(!*mudsettingGetString("mud_name"))
     mudsettingSetString("mud_name", DFLT_MUD_NAME);
+  if(mudsettingGetInt("output_high_water") == 0)
+    mudsettingSetInt("output_high_water", DFLT_OUTPUT_HIGH_WATER);
+  if(!*mudsettingGetString("output_overflow"))
+    mudsettingSetString("output_overflow", DFLT_OUTPUT_OVERFLOW);
+  if(!*mudsettingGetString("input_threads"))
+    mudsettingSetInt("input_threads", 0);
+  if(!*mudsettingGetString("compress_threads"))
+    mudsettingSetInt("compress_threads", 0);
+  if(!*mudsettingGetString("compress_level"))
+    mudsettingSetInt("compress_level", DFLT_COMPRESS_LEVEL);
+  if(!*mudsettingGetString("compress_mem_level"))
+    mudsettingSetInt("compress_mem_level", DFLT_COMPRESS_MEM_LEVEL);
+  if(!*mudsettingGetString("compress_window_bits"))
+    mudsettingSetInt("compress_window_bits", DFLT_COMPRESS_WINDOW_BITS);
+  if(!*mudsettingGetString("compress_min_bytes"))
+    mudsettingSetInt("compress_min_bytes", DFLT_COMPRESS_MIN_BYTES);
+  if(!*mudsettingGetString("compress_busy_level"))
+    mudsettingSetInt("compress_busy_level", DFLT_COMPRESS_BUSY_LEVEL);
+  if(!*mudsettingGetString("compress_busy_percent"))
+    mudsettingSetInt("compress_busy_percent", DFLT_COMPRESS_BUSY_PERCENT);
+  if(!*mudsettingGetString("listen_ipv6"))
+    mudsettingSetInt("listen_ipv6", DFLT_LISTEN_IPV6);
+  if(!*mudsettingGetString("listen_backlog"))
+    mudsettingSetInt("listen_backlog", DFLT_LISTEN_BACKLOG);
+  if(!*mudsettingGetString("listen_reuseport"))
+    mudsettingSetInt("listen_reuseport", DFLT_LISTEN_REUSEPORT);
+  if(!*mudsettingGetString("tls_cert_file"))
+    mudsettingSetString("tls_cert_file", DFLT_TLS_CERT_FILE);
+  if(!*mudsettingGetString("tls_key_file"))
+    mudsettingSetString("tls_key_file", DFLT_TLS_KEY_FILE);
+  if(!*mudsettingGetString("tls_ticket_file"))
+    mudsettingSetString("tls_ticket_file", DFLT_TLS_TICKET_FILE);
+  if(!*mudsettingGetString("tls_ktls"))
+    mudsettingSetInt("tls_ktls", DFLT_TLS_KTLS);
+  if(!*mudsettingGetString("ws_deflate"))
+    mudsettingSetInt("ws_deflate", DFLT_WS_DEFLATE);
+  if(!*mudsettingGetString("upgrade_timeout"))
+    mudsettingSetInt("upgrade_timeout", DFLT_UPGRADE_TIMEOUT);
+  if(!*mudsettingGetString("connect_rate"))
+    mudsettingSetInt("connect_rate", DFLT_CONNECT_RATE);
+  if(!*mudsettingGetString("connect_burst"))
+    mudsettingSetInt("connect_burst", DFLT_CONNECT_BURST);
+  if(!*mudsettingGetString("socket_pool_size"))
+    mudsettingSetInt("socket_pool_size", DFLT_SOCKET_POOL_SIZE);
+  if(!*mudsettingGetString("login_timeout"))
+    mudsettingSetInt("login_timeout", DFLT_LOGIN_TIMEOUT);
+  if(!*mudsettingGetString("afk_seconds"))
+    mudsettingSetInt("afk_seconds", DFLT_AFK_SECONDS);
+  if(!*mudsettingGetString("idle_disconnect"))
+    mudsettingSetInt("idle_disconnect", DFLT_IDLE_DISCONNECT);
+  if(!*mudsettingGetString("dns_cache_ttl"))
+    mudsettingSetInt("dns_cache_ttl", DFLT_DNS_CACHE_TTL);
+  if(!*mudsettingGetString("heartbeat_spread"))
+    mudsettingSetInt("heartbeat_spread", DFLT_HEARTBEAT_SPREAD);
+  if(!*mudsettingGetString("zone_resets_per_pulse"))
+    mudsettingSetInt("zone_resets_per_pulse", DFLT_ZONE_RESETS_PER_PULSE);
+  if(!*mudsettingGetString("reset_visited_only"))
+    mudsettingSetInt("reset_visited_only", DFLT_RESET_VISITED_ONLY);
+  if(!*mudsettingGetString("world_flush_interval"))
+    mudsettingSetInt("world_flush_interval", DFLT_WORLD_FLUSH_INTERVAL);
+  if(!*mudsettingGetString("world_save_wait_secs"))
+    mudsettingSetInt("world_save_wait_secs", DFLT_WORLD_SAVE_WAIT_SECS);
+  if(!*mudsettingGetString("room_idle_minutes"))
+    mudsettingSetInt("room_idle_minutes", DFLT_ROOM_IDLE_MINUTES);
+  if(!*mudsettingGetString("save_cache_size"))
+    mudsettingSetInt("save_cache_size", DFLT_SAVE_CACHE_SIZE);
+  if(!*mudsettingGetString("save_cache_kb"))
+    mudsettingSetInt("save_cache_kb", DFLT_SAVE_CACHE_KB);
+  if(!*mudsettingGetString("world_lru_kb"))
+    mudsettingSetInt("world_lru_kb", DFLT_WORLD_LRU_KB);
+  if(!*mudsettingGetString("prefetch_threads"))
+    mudsettingSetInt("prefetch_threads", DFLT_PREFETCH_THREADS);
+  if(!*mudsettingGetString("offload_threads"))
+    mudsettingSetInt("offload_threads", DFLT_OFFLOAD_THREADS);
+  if(!*mudsettingGetString("script_budget_ms"))
+    mudsettingSetInt("script_budget_ms", DFLT_SCRIPT_BUDGET_MS);
+  if(!*mudsettingGetString("log_repeat_seconds"))
+    mudsettingSetInt("log_repeat_seconds", DFLT_LOG_REPEAT_SECONDS);
+  if(!*mudsettingGetString("log_json"))
+    mudsettingSetInt("log_json", DFLT_LOG_JSON);
+  if(!*mudsettingGetString("regen_seconds"))
+    mudsettingSetInt("regen_seconds", DFLT_REGEN_SECONDS);
+  if(!*mudsettingGetString("gc_threshold0"))
+    mudsettingSetInt("gc_threshold0", DFLT_GC_THRESHOLD0);
+  if(!*mudsettingGetString("gc_threshold1"))
+    mudsettingSetInt("gc_threshold1", DFLT_GC_THRESHOLD1);
+  if(!*mudsettingGetString("gc_threshold2"))
+    mudsettingSetInt("gc_threshold2", DFLT_GC_THRESHOLD2);
+  if(!*mudsettingGetString("gc_pause_log_msecs"))
+    mudsettingSetInt("gc_pause_log_msecs", DFLT_GC_PAUSE_LOG_MSECS);
+  if(!*mudsettingGetString("channel_history"))
+    mudsettingSetInt("channel_history", DFLT_CHANNEL_HISTORY);
+  if(!*mudsettingGetString("metrics_port"))
+    mudsettingSetInt("metrics_port", DFLT_METRICS_PORT);
+  if(!*mudsettingGetString("trace_events"))
+    mudsettingSetInt("trace_events", DFLT_TRACE_EVENTS);
+  if(!*mudsettingGetString("trace_spike_msecs"))
+    mudsettingSetInt("trace_spike_msecs", DFLT_TRACE_SPIKE_MSECS);
+  if(!*mudsettingGetString("zone_shards"))
+    mudsettingSetInt("zone_shards", DFLT_ZONE_SHARDS);
+  if(!*mudsettingGetString("commands_per_pulse"))
+    mudsettingSetInt("commands_per_pulse", DFLT_COMMANDS_PER_PULSE);
+  if(!*mudsettingGetString("command_budget_usec"))
+    mudsettingSetInt("command_budget_usec", DFLT_COMMAND_BUDGET_USEC);
+  if(!*mudsettingGetString("input_lines_per_second"))
+    mudsettingSetInt("input_lines_per_second", DFLT_INPUT_LINES_PER_SECOND);
+  if(!*mudsettingGetString("input_burst"))
+    mudsettingSetInt("input_burst", DFLT_INPUT_BURST);
+  if(!*mudsettingGetString("input_snooze_strikes"))
+    mudsettingSetInt("input_snooze_strikes", DFLT_INPUT_SNOOZE_STRIKES);
+  if(!*mudsettingGetString("input_snooze_seconds"))
+    mudsettingSetInt("input_snooze_seconds", DFLT_INPUT_SNOOZE_SECONDS);
+  if(!*mudsettingGetString("input_coalesce_cmds"))
+    mudsettingSetString("input_coalesce_cmds", DFLT_INPUT_COALESCE_CMDS);
+  if(!*mudsettingGetString("command_history"))
+    mudsettingSetInt("command_history", DFLT_COMMAND_HISTORY);
+  if(!*mudsettingGetString("output_coalesce_bytes"))
+    mudsettingSetInt("output_coalesce_bytes", DFLT_OUTPUT_COALESCE_BYTES);
+  if(!*mudsettingGetString("output_coalesce_usec"))
+    mudsettingSetInt("output_coalesce_usec", DFLT_OUTPUT_COALESCE_USEC);
+  if(!*mudsettingGetString("boot_threads"))
+    mudsettingSetInt("boot_threads", 0);
+  if(!*mudsettingGetString("storage_format"))
+    mudsettingSetString("storage_format", "text");
   if(!*mudsettingGetString("required_pymodules"))
     mudsettingSetString("required_pymodules", "account_handler,char_gen,display,utils,inform,colour");
 
   // Save the settings to create the file if it didn't exist
   storage_write(settings, MUD_DATA);
+  mud_settings_refresh();
 }
 
 void mudsettingSetString(const char *key, const char *val) {
   store_string(settings,  key, val);
   storage_write(settings, MUD_DATA);  
+  mud_settings_refresh();
 }
 
 void mudsettingSetDouble(const char *key, double val) {
   store_double(settings, key, val);
   storage_write(settings, MUD_DATA);
+  mud_settings_refresh();
 }
 
 void mudsettingSetInt(const char *key, int val) {
   store_int(settings, key, val);
   storage_write(settings, MUD_DATA);
+  mud_settings_refresh();
 }
 
 void mudsettingSetLong(const char *key, long val) {
   store_long(settings, key, val);
   storage_write(settings, MUD_DATA);
+  mud_settings_refresh();
 }
 
 void mudsettingSetBool(const char *key, bool val) {
   store_bool(settings, key, val);
   storage_write(settings, MUD_DATA);
+  mud_settings_refresh();
 }
 
 const char *mudsettingGetString(const char *key) {
@@ -40,6 +40,7 @@
 // that is used lots, put a typedef for it in here.
 //*****************************************************************************
 typedef struct socket_data                SOCKET_DATA;
+typedef struct out_frag                   OUT_FRAG;
 typedef struct account_data               ACCOUNT_DATA;
 typedef struct char_data                  CHAR_DATA;  
 typedef struct storage_set                STORAGE_SET;
@@ -54,6 +55,7 @@ typedef struct response_data              RESPONSE_DATA;
 typedef struct script_data                SCRIPT_DATA;
 typedef struct world_data                 WORLD_DATA;
 typedef struct zone_data                  ZONE_DATA;
+typedef struct world_key                  WORLD_KEY;
 typedef struct room_data                  ROOM_DATA;
 typedef struct exit_data                  EXIT_DATA;
 typedef struct object_data                OBJ_DATA;
@@ -73,6 +75,8 @@ typedef unsigned char                     bool;
 // the typedefs.
 #include "numbers.h"
 #include "property_table.h"
+#include "arena.h"
+#include "epoch.h"
 #include "list.h"
 #include "map.h"
 #include "near_map.h"
@@ -103,7 +107,7 @@ typedef unsigned char                     bool;
 
 /* A few globals */
 #define DFLT_PULSES_PER_SECOND 10
-#define PULSES_PER_SECOND   mudsettingGetInt("pulses_per_second")
+#define PULSES_PER_SECOND   (mud_settings.pulses_per_second)
 #define SECOND              * PULSES_PER_SECOND   /* used for figuring out how many pulses in a second*/
 #define SECONDS             SECOND                /* same as above */
 #define MINUTE              * 60 SECONDS          /* one minute */
@@ -131,48 +135,215 @@ typedef unsigned char                     bool;
 
 
 // the room that new characters are dropped into
-#define START_ROOM         mudsettingGetString("start_room")
+#define START_ROOM         (mud_settings.start_room)
 #define DFLT_START_ROOM    "tavern_entrance@examples"
 
 // copyover and executable path, probably safe to leav for now
 #define COPYOVER_FILE      "../.copyover.dat"     /* tempfile to store copyover data    */
+#define COPYOVER_WORLD_FILE "../.copyover_world.dat" /* the world, on a hot copyover  */
 #define EXE_FILE           "../src/NakedMud"       /* the name of the mud binary         */
 
 /* the default port we run on */
 #define DFLT_LISTEN_PORT   4000
-#define LISTENING_PORT     mudsettingGetInt("listening_port") 
+#define LISTENING_PORT     (mud_settings.listening_port)
+
+/* whether we listen for IPv6 as well as IPv4, how many connections can    */
+/* wait to be accepted (0 for as many as the system allows), and whether   */
+/* other processes can listen on the same ports at once (SO_REUSEPORT).    */
+/* listen_extra_ports are more ports to listen on, e.g. "4001, 23"         */
+#define DFLT_LISTEN_IPV6        1
+#define DFLT_LISTEN_BACKLOG     0
+#define DFLT_LISTEN_REUSEPORT   0
+
+/* tls_ports are ports to listen on for TLS, e.g. "4443". Our certificate  */
+/* chain and key, as PEM, the keys session tickets are made with (written  */
+/* the first time we need them), and whether the kernel can do encryption */
+#define DFLT_TLS_CERT_FILE      "../lib/misc/tls_cert.pem"
+#define DFLT_TLS_KEY_FILE       "../lib/misc/tls_key.pem"
+#define DFLT_TLS_TICKET_FILE    "../lib/misc/tls_tickets"
+#define DFLT_TLS_KTLS           1
+
+/* ws_ports and wss_ports are ports to listen on for WebSockets, plain and */
+/* over TLS, e.g. "4080". Do we compress messages if the client lets us?  */
+#define DFLT_WS_DEFLATE         1
+
+/* how long, in seconds, a new process started by an upgrade has to boot */
+/* and ask for our sockets before we give up on it                       */
+#define DFLT_UPGRADE_TIMEOUT  300
+
+/* how much output we'll queue for a client that is slow to read it, and */
+/* what we do when it goes over that: disconnect them, or drop new output */
+#define DFLT_OUTPUT_HIGH_WATER (256 * 1024)
+#define DFLT_OUTPUT_OVERFLOW   "disconnect"
+#define OUTPUT_HIGH_WATER      (mud_settings.output_high_water)
+#define OUTPUT_OVERFLOW        (mud_settings.output_overflow)
+
+/* MCCP tuning: how hard deflate works, how much memory it uses per socket, */
+/* and how big a flush must be before we bother compressing it at all.     */
+/* Smaller flushes are sent as stored (uncompressed) blocks in the stream.  */
+/* Each stream takes 2^(window_bits+2) + 2^(mem_level+9) bytes; 256KB at   */
+/* the defaults. When the last pulse took more than busy_percent of its    */
+/* time (0 never), we compress at no more than busy_level until it's back  */
+/* under half that                                                         */
+#define DFLT_COMPRESS_LEVEL        9
+#define DFLT_COMPRESS_MEM_LEVEL    8
+#define DFLT_COMPRESS_WINDOW_BITS 15
+#define DFLT_COMPRESS_MIN_BYTES    0
+#define DFLT_COMPRESS_BUSY_LEVEL   1
+#define DFLT_COMPRESS_BUSY_PERCENT 80
+#define COMPRESS_LEVEL         (mud_settings.compress_level)
+#define COMPRESS_MEM_LEVEL     (mud_settings.compress_mem_level)
+#define COMPRESS_WINDOW_BITS   (mud_settings.compress_window_bits)
+#define COMPRESS_MIN_BYTES     (mud_settings.compress_min_bytes)
+#define COMPRESS_BUSY_LEVEL    (mud_settings.compress_busy_level)
+#define COMPRESS_BUSY_PERCENT  (mud_settings.compress_busy_percent)
+
+/* how many connections an address can make per minute, and in one burst */
+#define DFLT_CONNECT_RATE      30
+#define DFLT_CONNECT_BURST     10
+
+/* how many unused sockets we keep around for new connections */
+#define DFLT_SOCKET_POOL_SIZE  16
+
+/* how many seconds a socket can sit idle at login before it's closed, and  */
+/* how many seconds a socket playing a character can sit idle before it's   */
+/* marked afk, and before it's disconnected. 0 turns each one off           */
+#define DFLT_LOGIN_TIMEOUT     0
+#define DFLT_AFK_SECONDS       0
+#define DFLT_IDLE_DISCONNECT   0
+
+/* how many seconds we remember the hostnames of addresses for */
+#define DFLT_DNS_CACHE_TTL     3600
+
+/* spread heartbeat triggers across the heartbeat period instead of running
+   them all on the same pulse? */
+#define DFLT_HEARTBEAT_SPREAD  0
+
+/* how many zones can reset on one pulse. 0 for no limit */
+#define DFLT_ZONE_RESETS_PER_PULSE 2
+
+/* do zones only reset rooms if a player has been in the zone since its last
+   reset? If not, rooms that need resetting are reset even in empty zones */
+#define DFLT_RESET_VISITED_ONLY 0
+
+/* how many seconds saved zone contents can wait before they are written */
+#define DFLT_WORLD_FLUSH_INTERVAL 30
+
+/* how many seconds a background world save can take before anything that */
+/* has to wait for it gives up on it, and kills it                          */
+#define DFLT_WORLD_SAVE_WAIT_SECS 60
+
+/* how many minutes a room with nothing in it but what its resets loaded can */
+/* sit before it is unloaded, to be made again when wanted. 0 never unloads  */
+#define DFLT_ROOM_IDLE_MINUTES    0
+
+/* how many KB of entries a type kept in an LRU can take up, and how many */
+/* threads read the world's files in ahead of when they are wanted        */
+#define DFLT_WORLD_LRU_KB         4096
+#define DFLT_PREFETCH_THREADS     1
+
+/* how many threads run work scripts hand off with mudsys.submit. 0 runs it */
+/* on the game thread, right when it is submitted                           */
+#define DFLT_OFFLOAD_THREADS      2
+
+/* how many offline players and accounts with no references we keep loaded */
+/* in case they are wanted again, and roughly how many KB they can take up  */
+#define DFLT_SAVE_CACHE_SIZE   64
+#define DFLT_SAVE_CACHE_KB     2048
+
+/* how many milliseconds one script can run before it is stopped. Trigger */
+/* types can have their own limit with script_budget_ms_<type>. 0 is none */
+#define DFLT_SCRIPT_BUDGET_MS  1000
+
+/* how many commands one socket can run on a pulse, and how many microseconds */
+/* it can spend running them before the rest wait for the next pulse. 0 is   */
+/* no time limit. Whatever the limits, at least one command is run           */
+#define DFLT_COMMANDS_PER_PULSE   4
+#define DFLT_COMMAND_BUDGET_USEC  20000
+
+/* how many lines a second a socket can send us, and how many it can send  */
+/* at once before it is held to that. 0 lines a second is no limit. One    */
+/* that is held back for input_snooze_strikes seconds in a row has nothing */
+/* it sends read for input_snooze_seconds. 0 strikes never snoozes anyone. */
+/* While throttled, repeats of these commands are dropped, not run again   */
+#define DFLT_INPUT_LINES_PER_SECOND 10
+#define DFLT_INPUT_BURST            40
+#define DFLT_INPUT_SNOOZE_STRIKES   60
+#define DFLT_INPUT_SNOOZE_SECONDS   30
+#define DFLT_INPUT_COALESCE_CMDS    "look, l, glance, exits, score, who, "\
+                                    "inventory, inv, i, equipment, eq, time"
+
+/* how many of the commands it has run a socket remembers */
+#define DFLT_COMMAND_HISTORY      100
+
+/* output that isn't an answer to a command is held back until this many     */
+/* bytes are waiting, or the oldest has waited this many microseconds. 0     */
+/* bytes sends everything on the pulse it was made, like it used to be       */
+#define DFLT_OUTPUT_COALESCE_BYTES  512
+#define DFLT_OUTPUT_COALESCE_USEC   200000
+
+/* identical log lines that come in this many seconds apart or less are only */
+/* written once, with a count of their repeats. 0 writes every line. If     */
+/* log_json is set, the logs are written as one JSON object per line        */
+#define DFLT_LOG_REPEAT_SECONDS   10
+#define DFLT_LOG_JSON             0
+
+/* how many seconds apart regenerators that aren't full are ticked */
+#define DFLT_REGEN_SECONDS        10
+
+/* the thresholds of Python's garbage collector, and how long a collection  */
+/* can take, in msecs, before it is logged. 0 doesn't log them               */
+#define DFLT_GC_THRESHOLD0        5000
+#define DFLT_GC_THRESHOLD1        20
+#define DFLT_GC_THRESHOLD2        20
+#define DFLT_GC_PAUSE_LOG_MSECS   5
+
+/* how many of the last messages sent over each channel are remembered      */
+#define DFLT_CHANNEL_HISTORY      20
+
+/* the port metrics are served on, for monitoring tools to scrape. 0 is off  */
+#define DFLT_METRICS_PORT         0
+
+/* how many spans pulsetrace keeps, and how long a pulse can take, in msecs, */
+/* before the trace is saved on its own. 0 never saves it on its own         */
+#define DFLT_TRACE_EVENTS         65536
+#define DFLT_TRACE_SPIKE_MSECS    250
+
+/* how many shards the shards command plans zones out over, if not told.    */
+/* Zones are never actually run on shards                                   */
+#define DFLT_ZONE_SHARDS          16
 
 /* the width of a term screen */
 #define DFLT_SCREEN_WIDTH  80
 #define DFLT_PARA_INDENT   4
-#define SCREEN_WIDTH       mudsettingGetInt("screen_width")                    
-#define PARA_INDENT        mudsettingGetInt("paragraph_indent")
+#define SCREEN_WIDTH       (mud_settings.screen_width)
+#define PARA_INDENT        (mud_settings.paragraph_indent)
 
 /* Default Text Responses */
 #define DFLT_SOMEWHERE         "somewhere"
-#define SOMEWHERE              mudsettingGetString("message_somewhere")
+#define SOMEWHERE              (mud_settings.message_somewhere)
 #define DFLT_SOMETHING         "something"
-#define SOMETHING              mudsettingGetString("message_something")
+#define SOMETHING              (mud_settings.message_something)
 #define DFLT_SOMEONE           "someone"
-#define SOMEONE                mudsettingGetString("message_someone")
+#define SOMEONE                (mud_settings.message_someone)
 #define DFLT_NOTHING_SPECIAL   "You see nothing special."
-#define NOTHING_SPECIAL        mudsettingGetString("message_nothing_special")
+#define NOTHING_SPECIAL        (mud_settings.message_nothing_special)
 #define DFLT_WHAT              "What?"
-#define WHAT                   mudsettingGetString("message_what")
+#define WHAT                   (mud_settings.message_what)
 
 /* MUD Identity Settings */
 #define DFLT_MUD_NAME          "NakedMud"
-#define MUD_NAME               mudsettingGetString("mud_name")
+#define MUD_NAME               (mud_settings.mud_name)
 
 /* Location to world path */
 #define DFLT_WORLD_PATH    "../lib/world"
-#define WORLD_PATH         mudsettingGetString("world_path")
+#define WORLD_PATH         (mud_settings.world_path)
 
 /* MUD Library Path */
 #define MUDLIB_PATH        get_mudlib_path()
 
 // the room that new characters are dropped into
-#define START_ROOM      mudsettingGetString("start_room")
+#define START_ROOM      (mud_settings.start_room)
 #define DFLT_START_ROOM "tavern_entrance@examples"
 
 //*****************************************************************************
@@ -220,6 +391,40 @@ int         mudsettingGetInt   (const char *key);
 long        mudsettingGetLong  (const char *key);
 bool        mudsettingGetBool  (const char *key);
 
+//
+// the settings above are kept in a storage set, and looking them up means
+// hashing their names. Many of them are used several times every pulse
+// (PULSES_PER_SECOND, SOMEONE, etc...) so we also keep typed copies of them
+// here, which the macros above read directly. The copies are refreshed
+// whenever a setting is changed through mudsettingSet*, which also bumps
+// the version number so anything that caches values derived from settings
+// can tell when it needs to recompute them.
+typedef struct mud_settings_cache {
+  int         version;
+  int         pulses_per_second;
+  int         listening_port;
+  int         screen_width;
+  int         paragraph_indent;
+  int         output_high_water;
+  const char *output_overflow;
+  int         compress_level;
+  int         compress_mem_level;
+  int         compress_window_bits;
+  int         compress_min_bytes;
+  int         compress_busy_level;
+  int         compress_busy_percent;
+  const char *start_room;
+  const char *world_path;
+  const char *mud_name;
+  const char *message_somewhere;
+  const char *message_something;
+  const char *message_someone;
+  const char *message_nothing_special;
+  const char *message_what;
+} MUD_SETTINGS_CACHE;
+
+extern MUD_SETTINGS_CACHE mud_settings;
+
 //
 // returns the next available UID for mobs, objs, room, exits
 #define START_UID      1000000
@@ -239,14 +444,16 @@ extern  LIST               *room_list; // all rooms currently in the game
 extern  SET               *object_set; // objects, set form
 extern  SET               *mobile_set; // mobiles, set form
 extern  SET                 *room_set; // rooms, set form
+extern  HASHTABLE     *online_players; // PCs in the game, by name
 
-extern  LIST          *mobs_to_delete; // mobs/objs/rooms that have had
-extern  LIST          *objs_to_delete; // extraction and now need 
-extern  LIST         *rooms_to_delete; // extract_final
-extern  LIST          *strs_to_delete; // strings we didn't want deleted at 
+extern  EPOCH_CLASS   *mobs_to_delete; // mobs/objs/rooms that have had
+extern  EPOCH_CLASS   *objs_to_delete; // extraction and now need 
+extern  EPOCH_CLASS  *trees_to_delete; // (objs along with their contents)
+extern  EPOCH_CLASS  *rooms_to_delete; // extract_final
+extern  EPOCH_CLASS   *strs_to_delete; // strings we didn't want deleted at 
                                        // the time, but do now. This is for
                                        // get_fullkey and see_xxx_as
-extern  LIST          *bufs_to_delete; // same for buffers
+extern  EPOCH_CLASS   *bufs_to_delete; // same for buffers. See epoch.h
 
 extern  PROPERTY_TABLE     *mob_table; // a mapping between uid and mob
 extern  PROPERTY_TABLE     *obj_table; // a mapping between uid and obj
@@ -259,7 +466,6 @@ extern  bool              silent_mode; // used for silent mode (no terminal outp
 extern  int                   mudport; // What port are we running on?
 extern  BUFFER              *greeting; // the welcome greeting
 extern  BUFFER                  *motd; // the MOTD message
-extern  int                   control; // boot control socket thingy
 extern  time_t           current_time; // let's cut down on calls to time()
 
 extern  WORLD_DATA         *gameworld; // database and thing that holds rooms
@@ -307,6 +513,9 @@ char   *strfind               (char *txt, char *sub);
 /* mccp.c */
 bool  compressStart     ( SOCKET_DATA *dsock, unsigned char teleopt );
 bool  compressEnd       ( SOCKET_DATA *dsock, unsigned char teleopt, bool forced );
+bool  compressSuspend   ( SOCKET_DATA *dsock, unsigned long *adler );
+bool  compressResume    ( SOCKET_DATA *dsock, unsigned char teleopt, 
+			  unsigned long adler );
 
 /* socket.c */
 #define NUM_LINES_PER_PAGE  21
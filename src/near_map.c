@@ -6,14 +6,20 @@
 // value can only be retreived by using the key. However, there's some cases
 // where we'd like to be lazy about providing the proper key and instead be
 // provided with the "best match". For instance, looking up help files or
-// commands. For the north command, we'd like "n", "no", "nor", nort", and 
+// commands. For the north command, we'd like "n", "no", "nor", nort", and
 // "north" to all be viable commands. This is what a near-map tries to
 // accomplish.
 //
+// Keys are kept in a trie, one node per (lowercased) character. Every node
+// remembers the best entry - the one with the lowest min_abbrev - found
+// anywhere beneath it, so resolving an abbreviation only means walking down
+// as many nodes as the abbreviation has characters.
+//
 //*****************************************************************************
 
 #include "mud.h"
 #include "utils.h"
+#include "intern.h"
 #include "near_map.h"
 
 
@@ -21,59 +27,180 @@
 //*****************************************************************************
 // local datastructures, functions, and defines
 //*****************************************************************************
-#define NUM_NEAR_MAP_BUCKETS   27 // 26 for letters, 1 for non-alpha
+typedef struct near_map_elem {
+  const char           *key; // interned; command tables share their keys
+  const char    *min_abbrev;
+  void                *data;
+  long long             seq; // when were we put in? Newer entries win ties
+  bool              removed; // taken out while someone was iterating?
+  struct near_map_elem *next; // the next entry with the same key
+} NEAR_MAP_ELEM;
+
+typedef struct near_node {
+  char                    ch; // the (lowercase) character we represent
+  struct near_node   *parent;
+  struct near_node     **kids; // sorted by ch
+  int               num_kids;
+  NEAR_MAP_ELEM       *elems; // entries whose key ends here, best first
+  NEAR_MAP_ELEM        *best; // the best entry here or below us
+} NEAR_NODE;
 
 struct near_map {
-  LIST *bucket[NUM_NEAR_MAP_BUCKETS];
+  NEAR_NODE             root;
+  int                   size;
+  long long              seq;
+  int              iterators; // how many iterators are going over us?
+  LIST              *removed; // entries to delete when the iterators finish
+  NEAR_MAP_ELEM   **matches; // scratch space for listing matches
+  int          matches_size;
+  bool             matching; // is the scratch space in use?
 };
 
 struct near_iterator {
   NEAR_MAP         *map;
-  LIST_ITERATOR *curr_i;
-  int         curr_buck;
+  NEAR_MAP_ELEM **elems; // everything in the map when we started
+  int         num_elems;
+  int              curr;
 };
 
-typedef struct {
-  char        *key;
-  char *min_abbrev;
-  void       *data;
-} NEAR_MAP_ELEM;
-
 
-NEAR_MAP_ELEM *newNearMapElem(void *data, const char *key, 
+NEAR_MAP_ELEM *newNearMapElem(void *data, const char *key,
 			      const char *min_abbrev) {
-  NEAR_MAP_ELEM *elem = malloc(sizeof(NEAR_MAP_ELEM));
+  NEAR_MAP_ELEM *elem = calloc(1, sizeof(NEAR_MAP_ELEM));
   elem->data          = data;
-  elem->key           = strdupsafe(key);
-  elem->min_abbrev    = strdupsafe(min_abbrev ? min_abbrev : key);
+  elem->key           = strIntern(key);
+  elem->min_abbrev    = strIntern(min_abbrev ? min_abbrev : key);
   return elem;
 }
 
 void deleteNearMapElem(NEAR_MAP_ELEM *elem) {
-  if(elem->key)        free(elem->key);
-  if(elem->min_abbrev) free(elem->min_abbrev);
+  strRelease(elem->key);
+  strRelease(elem->min_abbrev);
   free(elem);
 }
 
 //
-// returns the bucket that the key should map into
-int get_nearmap_bucket(const char *key) {
-  if(isalpha(*key))
-    return 1 + tolower(*key) - 'a';
-  else
-    return 0;
+// is elem1 a better match than elem2? Entries are ordered by their minimum
+// abbreviations; when those are the same, the newest entry wins
+bool near_elem_before(NEAR_MAP_ELEM *elem1, NEAR_MAP_ELEM *elem2) {
+  int cmp = strcasecmp(elem1->min_abbrev, elem2->min_abbrev);
+  return (cmp < 0 || (cmp == 0 && elem1->seq > elem2->seq));
+}
+
+int near_elem_cmp(const void *elem1, const void *elem2) {
+  return (near_elem_before(*(NEAR_MAP_ELEM **)elem1,
+			   *(NEAR_MAP_ELEM **)elem2) ? -1 : 1);
+}
+
+//
+// find the kid of the node for the character. If it doesn't exist and
+// create is TRUE, add it in
+NEAR_NODE *near_node_kid(NEAR_NODE *node, char ch, bool create) {
+  int lo = 0, hi = node->num_kids;
+  while(lo < hi) {
+    int mid = (lo + hi) / 2;
+    if(node->kids[mid]->ch == ch)
+      return node->kids[mid];
+    else if(node->kids[mid]->ch < ch)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if(!create)
+    return NULL;
+
+  NEAR_NODE *kid = calloc(1, sizeof(NEAR_NODE));
+  kid->ch        = ch;
+  kid->parent    = node;
+  node->kids     = realloc(node->kids, sizeof(NEAR_NODE*)*(node->num_kids+1));
+  memmove(node->kids + lo + 1, node->kids + lo,
+	  sizeof(NEAR_NODE *) * (node->num_kids - lo));
+  node->kids[lo] = kid;
+  node->num_kids++;
+  return kid;
+}
+
+//
+// walk down to the node for the key
+NEAR_NODE *near_node_find(NEAR_MAP *map, const char *key, bool create) {
+  NEAR_NODE *node = &map->root;
+  for(; node != NULL && *key; key++)
+    node = near_node_kid(node, tolower((unsigned char)*key), create);
+  return node;
+}
+
+//
+// after the node has changed, figure out the best entry for it and everything
+// above it again. Nodes left with nothing in or below them are pruned
+void near_node_update(NEAR_NODE *node) {
+  while(node != NULL) {
+    NEAR_NODE *parent = node->parent;
+    int i;
+
+    if(parent != NULL && node->elems == NULL && node->num_kids == 0) {
+      for(i = 0; parent->kids[i] != node; i++)
+	;
+      memmove(parent->kids + i, parent->kids + i + 1,
+	      sizeof(NEAR_NODE *) * (parent->num_kids - i - 1));
+      parent->num_kids--;
+      if(node->kids) free(node->kids);
+      free(node);
+    }
+    else {
+      NEAR_MAP_ELEM *best = node->elems;
+      for(i = 0; i < node->num_kids; i++)
+	if(best == NULL || near_elem_before(node->kids[i]->best, best))
+	  best = node->kids[i]->best;
+      node->best = best;
+    }
+    node = parent;
+  }
 }
 
-int nearmapsortbycmp(NEAR_MAP_ELEM *elem1, NEAR_MAP_ELEM *elem2) {
-  return strcasecmp(elem1->min_abbrev, elem2->min_abbrev);
+//
+// delete a node and everything below it, plus all of their entries
+void delete_near_node(NEAR_NODE *node) {
+  int i;
+  for(i = 0; i < node->num_kids; i++) {
+    delete_near_node(node->kids[i]);
+    free(node->kids[i]);
+  }
+  if(node->kids) free(node->kids);
+  while(node->elems != NULL) {
+    NEAR_MAP_ELEM *elem = node->elems;
+    node->elems = elem->next;
+    deleteNearMapElem(elem);
+  }
 }
 
-int is_near_map_abbrev(const char *abbrev, NEAR_MAP_ELEM *elem) {
-  return strncasecmp(abbrev, elem->key, strlen(abbrev));
+//
+// collect every entry at or below the node into the array, in key order
+void near_node_collect(NEAR_NODE *node, NEAR_MAP_ELEM ***elems, int *num,
+		       int *size) {
+  NEAR_MAP_ELEM *elem = NULL;
+  int i;
+  for(elem = node->elems; elem != NULL; elem = elem->next) {
+    if(*num >= *size) {
+      *size  = MAX(16, *size * 2);
+      *elems = realloc(*elems, sizeof(NEAR_MAP_ELEM *) * *size);
+    }
+    (*elems)[(*num)++] = elem;
+  }
+  for(i = 0; i < node->num_kids; i++)
+    near_node_collect(node->kids[i], elems, num, size);
 }
 
-int is_near_map_elem(const char *key, NEAR_MAP_ELEM *elem) {
-  return strcasecmp(key, elem->key);
+//
+// entries taken out while something was iterating over us get deleted
+// once the last iterator is done
+void near_map_finish_iterating(NEAR_MAP *map) {
+  map->iterators--;
+  if(map->iterators == 0 && map->removed != NULL) {
+    NEAR_MAP_ELEM *elem = NULL;
+    while((elem = listPop(map->removed)) != NULL)
+      deleteNearMapElem(elem);
+  }
 }
 
 
@@ -87,38 +214,34 @@ NEAR_MAP *newNearMap(void) {
 }
 
 void deleteNearMap(NEAR_MAP *map) {
-  int i;
-  for(i = 0; i < NUM_NEAR_MAP_BUCKETS; i++)
-    if(map->bucket[i] != NULL)
-      deleteListWith(map->bucket[i], deleteNearMapElem);
+  delete_near_node(&map->root);
+  if(map->removed) deleteListWith(map->removed, deleteNearMapElem);
+  if(map->matches) free(map->matches);
   free(map);
 }
 
 void *nearMapGet(NEAR_MAP *map, const char *key, bool abbrev_ok) {
-  // find the bucket
-  LIST *buck = map->bucket[get_nearmap_bucket(key)];
-  if(buck == NULL)
-    return NULL;
-  else {
-    NEAR_MAP_ELEM *elem = NULL;
-    if(abbrev_ok)
-      elem = listGetWith(buck, key, is_near_map_abbrev);
-    else
-      elem = listGetWith(buck, key, is_near_map_elem);
-    return (elem ? elem->data : NULL);
-  }
+  NEAR_NODE *node = near_node_find(map, key, FALSE);
+  NEAR_MAP_ELEM *elem = NULL;
+  if(node != NULL)
+    elem = (abbrev_ok ? node->best : node->elems);
+  return (elem ? elem->data : NULL);
 }
 
-void nearMapPut(NEAR_MAP *map, const char *key, const char *min_abbrev, 
+void nearMapPut(NEAR_MAP *map, const char *key, const char *min_abbrev,
 		void *elem) {
-  // find the bucket
-  int buck_num = get_nearmap_bucket(key);
-  LIST   *buck = map->bucket[buck_num];
-  if(buck == NULL)
-    map->bucket[buck_num] = buck = newList();
-
-  NEAR_MAP_ELEM *e = newNearMapElem(elem, key, min_abbrev);
-  listPutWith(buck, e, nearmapsortbycmp);
+  NEAR_NODE    *node = near_node_find(map, key, TRUE);
+  NEAR_MAP_ELEM   *e = newNearMapElem(elem, key, min_abbrev);
+  NEAR_MAP_ELEM **at = &node->elems;
+  e->seq             = map->seq++;
+
+  // entries with the same key are kept best first
+  while(*at != NULL && near_elem_before(*at, e))
+    at = &(*at)->next;
+  e->next = *at;
+  *at     = e;
+  map->size++;
+  near_node_update(node);
 }
 
 bool nearMapKeyExists(NEAR_MAP *map, const char *key) {
@@ -126,54 +249,98 @@ bool nearMapKeyExists(NEAR_MAP *map, const char *key) {
 }
 
 void *nearMapRemove(NEAR_MAP *map, const char *key) {
-  LIST *buck = map->bucket[get_nearmap_bucket(key)];
-  if(buck == NULL)
+  NEAR_NODE *node = near_node_find(map, key, FALSE);
+  if(node == NULL || node->elems == NULL)
     return NULL;
   else {
-    NEAR_MAP_ELEM *elem = listRemoveWith(buck, key, is_near_map_elem);
-    void          *data = NULL;
-    if(elem != NULL) {
-      data = elem->data;
-      deleteNearMapElem(elem);
+    NEAR_MAP_ELEM *elem = node->elems;
+    void          *data = elem->data;
+    node->elems = elem->next;
+    map->size--;
+    near_node_update(node);
+
+    // if someone is iterating over us, they might still have a hold of it
+    if(map->iterators > 0) {
+      if(map->removed == NULL)
+	map->removed = newList();
+      elem->removed = TRUE;
+      listPut(map->removed, elem);
     }
+    else
+      deleteNearMapElem(elem);
     return data;
   }
 }
 
+void nearMapForeachMatch(NEAR_MAP *map, const char *key,
+			 bool (* func)(const char *key, void *val, void *data),
+			 void *data) {
+  NEAR_NODE *node = near_node_find(map, key, FALSE);
+  if(node == NULL || node->best == NULL)
+    return;
+
+  // anything func takes out of us sticks around until we're done
+  map->iterators++;
+
+  // the best match is usually all anyone wants; don't sort for it
+  NEAR_MAP_ELEM *first = node->best;
+  if(!func(first->key, first->data, data) ||
+     (node = near_node_find(map, key, FALSE)) == NULL) {
+    near_map_finish_iterating(map);
+    return;
+  }
+
+  // if we're being asked for matches from within one of our own callbacks,
+  // we can't use our scratch space
+  NEAR_MAP_ELEM **elems = NULL;
+  int        num_elems = 0, size = 0, i;
+  bool         scratch = !map->matching;
+  if(scratch) {
+    elems = map->matches;
+    size  = map->matches_size;
+    map->matching = TRUE;
+  }
+
+  near_node_collect(node, &elems, &num_elems, &size);
+  qsort(elems, num_elems, sizeof(NEAR_MAP_ELEM *), near_elem_cmp);
+
+  for(i = 0; i < num_elems; i++)
+    if(elems[i] != first && !elems[i]->removed &&
+       !func(elems[i]->key, elems[i]->data, data))
+      break;
+  near_map_finish_iterating(map);
+
+  if(scratch) {
+    map->matches      = elems;
+    map->matches_size = size;
+    map->matching     = FALSE;
+  }
+  else if(elems != NULL)
+    free(elems);
+}
+
+//
+// used by nearMapGetAllMatches to collect the keys
+bool near_map_collect_key(const char *key, void *val, void *keys) {
+  listQueue(keys, strdup(key));
+  return TRUE;
+}
+
 LIST *nearMapGetAllMatches(NEAR_MAP *map, const char *key) {
-  // find the bucket
-  LIST    *buck = map->bucket[get_nearmap_bucket(key)];
-  if(buck == NULL)
-    return NULL;
-  else {
-    LIST         *matches = newList();
-    LIST_ITERATOR *elem_i = newListIterator(buck);
-    NEAR_MAP_ELEM   *elem = NULL;
-    ITERATE_LIST(elem, elem_i) {
-      if(startswith(elem->key, key))
-	// changed to return keys instead of vals, 
-	// so this is a little more intuitive (if not a little slower)
-	listQueue(matches, strdup(elem->key)); // elem->data);
-    } deleteListIterator(elem_i);
-
-    // did we not find anything?
-    if(listSize(matches) == 0) {
-      deleteList(matches);
-      matches = NULL;
-    }
+  LIST *matches = newList();
+  nearMapForeachMatch(map, key, near_map_collect_key, matches);
 
-    return matches;
+  // did we not find anything?
+  if(listSize(matches) == 0) {
+    deleteList(matches);
+    matches = NULL;
   }
+  return matches;
 }
 
 // how big are we?
 int nearMapSize(NEAR_MAP *map) {
-  int size = 0, i;
-  for(i = 0; i < NUM_NEAR_MAP_BUCKETS; i++) {
-    if(map->bucket[i] != NULL)
-      size += listSize(map->bucket[i]);
-  }
-  return size;
+  return map->size;
 }
 
 
@@ -184,77 +351,58 @@ int nearMapSize(NEAR_MAP *map) {
 NEAR_ITERATOR *newNearIterator(NEAR_MAP *map) {
   NEAR_ITERATOR *iter = calloc(1, sizeof(NEAR_ITERATOR));
   iter->map           = map;
+  map->iterators++;
   nearIteratorReset(iter);
   return iter;
 }
 
 void deleteNearIterator(NEAR_ITERATOR *iter) {
-  if(iter->curr_i)
-    deleteListIterator(iter->curr_i);
+  near_map_finish_iterating(iter->map);
+  if(iter->elems)
+    free(iter->elems);
   free(iter);
 }
 
 void nearIteratorReset(NEAR_ITERATOR *iter) {
-  int i;
-
-  if(iter->curr_i)
-    deleteListIterator(iter->curr_i);
-  iter->curr_i = NULL;
-  iter->curr_buck = 0;
-
-  // curr_i will be NULL if there are no elems
-  for(i = 0; i < NUM_NEAR_MAP_BUCKETS; i++) {
-    if(iter->map->bucket[i] != NULL && listSize(iter->map->bucket[i]) > 0) {
-      iter->curr_i = newListIterator(iter->map->bucket[i]);
-      iter->curr_buck = i;
-      break;
-    }
-  }
+  int size = 0;
+  if(iter->elems)
+    free(iter->elems);
+  iter->elems     = NULL;
+  iter->num_elems = 0;
+  iter->curr      = 0;
+  near_node_collect(&iter->map->root, &iter->elems, &iter->num_elems, &size);
+
+  // skip up to our first entry that's still around
+  while(iter->curr < iter->num_elems && iter->elems[iter->curr]->removed)
+    iter->curr++;
 }
 
 void nearIteratorNext(NEAR_ITERATOR *iter) {
-  // no more elements left
-  if(iter->curr_i == NULL)
-    return;
-  // we're at the end of our list
-  else if(listIteratorNext(iter->curr_i) == NULL) {
-    deleteListIterator(iter->curr_i);
-    iter->curr_i = NULL;
-    iter->curr_buck++;
-
-    for(; iter->curr_buck < NUM_NEAR_MAP_BUCKETS; iter->curr_buck++) {
-      if(iter->map->bucket[iter->curr_buck] != NULL &&
-	 listSize(iter->map->bucket[iter->curr_buck]) > 0) {
-	iter->curr_i = newListIterator(iter->map->bucket[iter->curr_buck]);
-	break;
-      }
-    }
-  }
+  if(iter->curr < iter->num_elems)
+    iter->curr++;
+  while(iter->curr < iter->num_elems && iter->elems[iter->curr]->removed)
+    iter->curr++;
+}
+
+//
+// the entry the iterator is on, or NULL if we're out of them
+NEAR_MAP_ELEM *near_iterator_elem(NEAR_ITERATOR *iter) {
+  while(iter->curr < iter->num_elems && iter->elems[iter->curr]->removed)
+    iter->curr++;
+  return (iter->curr < iter->num_elems ? iter->elems[iter->curr] : NULL);
 }
 
 const char *nearIteratorCurrentKey(NEAR_ITERATOR *iter) {
-  if(iter->curr_i == NULL)
-    return NULL;
-  else {
-    NEAR_MAP_ELEM *elem = listIteratorCurrent(iter->curr_i);
-    return (elem ? elem->key : NULL);
-  }
+  NEAR_MAP_ELEM *elem = near_iterator_elem(iter);
+  return (elem ? elem->key : NULL);
 }
 
 const char *nearIteratorCurrentAbbrev(NEAR_ITERATOR *iter) {
-  if(iter->curr_i == NULL)
-    return NULL;
-  else {
-    NEAR_MAP_ELEM *elem = listIteratorCurrent(iter->curr_i);
-    return (elem ? elem->min_abbrev : NULL);
-  }
+  NEAR_MAP_ELEM *elem = near_iterator_elem(iter);
+  return (elem ? elem->min_abbrev : NULL);
 }
 
 void *nearIteratorCurrentVal(NEAR_ITERATOR *iter) {
-  if(iter->curr_i == NULL)
-    return NULL;
-  else {
-    NEAR_MAP_ELEM *elem = listIteratorCurrent(iter->curr_i);
-    return (elem ? elem->data : NULL);
-  }
+  NEAR_MAP_ELEM *elem = near_iterator_elem(iter);
+  return (elem ? elem->data : NULL);
 }
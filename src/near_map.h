@@ -27,6 +27,17 @@ void         *nearMapRemove(NEAR_MAP *map, const char *key);
 LIST  *nearMapGetAllMatches(NEAR_MAP *map, const char *key);
 int             nearMapSize(NEAR_MAP *map);
 
+//
+// call func for every entry whose key starts with key, best match first (the
+// same order nearMapGet prefers them in). Keys are borrowed, and nothing is
+// copied; return FALSE from func to stop. Entries may be removed from the
+// map while this is going on. nearMapGetAllMatches is the same, but hands
+// back a list of copied keys that must be freed
+void     nearMapForeachMatch(NEAR_MAP *map, const char *key,
+			     bool (* func)(const char *key, void *val,
+					   void *data),
+			     void *data);
+
 
 
 //*****************************************************************************
@@ -14,24 +14,28 @@
 #include "mud.h"
 #include "extra_descs.h"
 #include "utils.h"
+#include "intern.h"
+#include "memstat.h"
 #include "handler.h"
 #include "storage.h"
 #include "auxiliary.h"
 #include "object.h"
+#include "character.h"
 
 struct object_data {
   int      uid;                  // our unique identifier
   double   weight;               // how much do we weigh, minus contents
+  double   contents_weight;      // and what our contents weigh, theirs and all
   int      hidden;               // how hard is it to see this object?
   time_t   birth;                // the time at which we were created
   
-  char *name;                    // our name - e.g. "a shirt"
-  char *prototypes;              // a list of the types we're instances of
-  char *class;                   // the prototype we most directly inherit from
-  char *keywords;                // words to reference us by
-  char *rdesc;                   // our room description
-  char *multi_name;              // our name when more than 1 appears
-  char *multi_rdesc;             // our rdesc when more than 1 appears
+  const char *name;              // our name - e.g. "a shirt"
+  const char *prototypes;        // a list of the types we're instances of
+  const char *class;             // the prototype we most directly inherit from
+  const char *keywords;          // words to reference us by
+  const char *rdesc;             // our room description
+  const char *multi_name;        // our name when more than 1 appears
+  const char *multi_rdesc;       // our rdesc when more than 1 appears
   BUFFER *desc;                  // the description when we are looked at
   BITVECTOR *bits;               // the object bits we have turned on
 
@@ -40,6 +44,9 @@ struct object_data {
   ROOM_DATA *room;               // the room we are in
   CHAR_DATA *carrier;            // who has us in their inventory 
   CHAR_DATA *wearer;             // who is wearing us
+  LIST_NODE *list_node;          // our node in the container/room/inventory
+  LIST_NODE *game_node;          // our node in object_list
+  bool       extracted;          // are we waiting to be deleted?
 
   LIST      *contents;           // other objects within us
   LIST      *users;              // the people using us (furniture and stuff)
@@ -47,27 +54,68 @@ struct object_data {
   EDESC_SET  *edescs;            // special descriptions that can be seen on us
 
   AUX_TABLE  *auxiliary_data;    // data modules have installed in us
+  OBJ_DATA        *next_free;    // the next deleted object to be made again
 };
 
 
+//
+// deleted objects are kept around to be made again, with their lists, bits,
+// and description still allocated
+#define MAX_FREE_OBJS       1024
+OBJ_DATA   *free_objs = NULL;
+int     num_free_objs = 0;
+
+//
+// an object has gotten heavier (or lighter) by delta. So has everything it is
+// in, and whoever is carrying or wearing the outermost of them
+void obj_weight_changed(OBJ_DATA *obj, double delta) {
+  for(; obj->container != NULL; obj = obj->container)
+    obj->container->contents_weight += delta;
+  if(obj->carrier != NULL)
+    charAddCarriedWeight(obj->carrier, delta);
+  if(obj->wearer != NULL)
+    charAddCarriedWeight(obj->wearer, delta);
+}
+
 OBJ_DATA *newObj() {
-  OBJ_DATA *obj = calloc(1, sizeof(OBJ_DATA));
+  OBJ_DATA *obj = free_objs;
+  if(obj != NULL) {
+    free_objs = obj->next_free;
+    num_free_objs--;
+    memNote(MEM_OBJ_POOL, -1, -(long long)sizeof(OBJ_DATA));
+    memNote(MEM_OBJ,       1,  sizeof(OBJ_DATA));
+
+    LIST   *contents = obj->contents;
+    LIST      *users = obj->users;
+    BUFFER     *desc = obj->desc;
+    BITVECTOR  *bits = obj->bits;
+    memset(obj, 0, sizeof(OBJ_DATA));
+    obj->contents    = contents;
+    obj->users       = users;
+    obj->desc        = desc;
+    obj->bits        = bits;
+    bufferClear(desc);
+    bitClear(bits);
+  }
+  else {
+    obj = memCalloc(MEM_OBJ, sizeof(OBJ_DATA));
+    obj->bits        = bitvectorInstanceOf("obj_bits");
+    obj->desc        = newBuffer(1);
+    obj->contents    = newList();
+    obj->users       = newList();
+  }
+
   obj->uid            = next_uid();
   obj->birth          = current_time;
   obj->weight         = 0.1;
 
-  obj->bits           = bitvectorInstanceOf("obj_bits");
-  obj->prototypes     = strdup("");
-  obj->class          = strdup("");
-  obj->name           = strdup("");
-  obj->keywords       = strdup("");
-  obj->rdesc          = strdup("");
-  obj->multi_name     = strdup("");
-  obj->multi_rdesc    = strdup("");
-  obj->desc           = newBuffer(1);
-
-  obj->contents       = newList();
-  obj->users          = newList();
+  obj->prototypes     = strIntern("");
+  obj->class          = strIntern("");
+  obj->name           = strShare("");
+  obj->keywords       = strShare("");
+  obj->rdesc          = strShare("");
+  obj->multi_name     = strShare("");
+  obj->multi_rdesc    = strShare("");
 
   obj->edescs         = newEdescSet();
   obj->auxiliary_data = newAuxiliaryData(AUXILIARY_TYPE_OBJ);
@@ -77,25 +125,37 @@ OBJ_DATA *newObj() {
 
 
 void deleteObj(OBJ_DATA *obj) {
-  // don't remove the objects from this container.
-  // it is assumed this has been done already (extract_obj)
-  deleteList(obj->contents);
-  // same goes for users
-  deleteList(obj->users);
-
-  if(obj->class)      free(obj->class);
-  if(obj->prototypes) free(obj->prototypes);
-  if(obj->name)       free(obj->name);
-  if(obj->keywords)   free(obj->keywords);
-  if(obj->rdesc)      free(obj->rdesc);
-  if(obj->desc)       deleteBuffer(obj->desc);
-  if(obj->multi_name) free(obj->multi_name);
-  if(obj->multi_rdesc)free(obj->multi_rdesc);
-  if(obj->bits)     deleteBitvector(obj->bits);
+  strRelease(obj->class);
+  strRelease(obj->prototypes);
+  strRelease(obj->name);
+  strRelease(obj->keywords);
+  strRelease(obj->rdesc);
+  strRelease(obj->multi_name);
+  strRelease(obj->multi_rdesc);
   if(obj->edescs)   deleteEdescSet(obj->edescs);
   deleteAuxiliaryData(obj->auxiliary_data);
 
-  free(obj);
+  // our contents and users aren't taken out of us here. It is assumed that
+  // has been done already (extract_obj), or that they are being deleted
+  // along with us (extract_obj_tree)
+  if(num_free_objs < MAX_FREE_OBJS) {
+    while(listPop(obj->contents) != NULL)
+      ;
+    while(listPop(obj->users) != NULL)
+      ;
+    obj->next_free = free_objs;
+    free_objs      = obj;
+    num_free_objs++;
+    memNote(MEM_OBJ,     -1, -(long long)sizeof(OBJ_DATA));
+    memNote(MEM_OBJ_POOL, 1,  sizeof(OBJ_DATA));
+  }
+  else {
+    deleteList(obj->contents);
+    deleteList(obj->users);
+    deleteBuffer(obj->desc);
+    deleteBitvector(obj->bits);
+    memFree(MEM_OBJ, obj, sizeof(OBJ_DATA));
+  }
 }
 
 
@@ -179,11 +239,11 @@ OBJ_DATA *objCopy(OBJ_DATA *obj) {
 }
 
 bool objIsInstance(OBJ_DATA *obj, const char *prototype) {
-  return is_keyword(obj->prototypes, prototype, FALSE);
+  return strInternHasWord(obj->prototypes, strInternFind(prototype));
 }
 
 bool objIsName(OBJ_DATA *obj, const char *name) {
-  return is_keyword(obj->keywords, name, TRUE);
+  return strIsKeyword(obj->keywords, name, TRUE);
 }
 
 void objAddChar(OBJ_DATA *obj, CHAR_DATA *ch) {
@@ -271,6 +331,18 @@ ROOM_DATA *objGetRoom(OBJ_DATA *obj) {
   return obj->room;
 }
 
+LIST_NODE *objGetListNode(OBJ_DATA *obj) {
+  return obj->list_node;
+}
+
+LIST_NODE *objGetGameNode(OBJ_DATA *obj) {
+  return obj->game_node;
+}
+
+bool objIsExtracted(OBJ_DATA *obj) {
+  return obj->extracted;
+}
+
 int objGetUID(OBJ_DATA *obj) {
   return obj->uid;
 }
@@ -284,16 +356,7 @@ double objGetWeightRaw(OBJ_DATA *obj) {
 }
 
 double objGetWeight(OBJ_DATA *obj) {
-  double tot_weight = obj->weight;
-  if(listSize(obj->contents) > 0) {
-    LIST_ITERATOR *cont_i = newListIterator(obj->contents);
-    OBJ_DATA *cont = NULL;
-
-    ITERATE_LIST(cont, cont_i)
-      tot_weight += objGetWeight(cont);
-    deleteListIterator(cont_i);
-  }
-  return tot_weight;
+  return obj->weight + obj->contents_weight;
 }
 
 int objGetHidden(OBJ_DATA *obj) {
@@ -308,48 +371,61 @@ void *objGetAuxiliaryData(const OBJ_DATA *obj, const char *name) {
   return auxiliaryGet(obj->auxiliary_data, name);
 }
 
+void *objGetAuxiliarySlot(const OBJ_DATA *obj, int slot) {
+  return auxiliaryGetSlot(obj->auxiliary_data, slot);
+}
+
 void objSetKeywords(OBJ_DATA *obj, const char *keywords) {
-  if(obj->keywords) free(obj->keywords);
-  obj->keywords = strdupsafe(keywords);
+  const char *old = obj->keywords;
+  obj->keywords = strShare(keywords);
+  strRelease(old);
 }
 
 void objSetRdesc(OBJ_DATA *obj, const char *rdesc) {
-  if(obj->rdesc) free(obj->rdesc);
-  obj->rdesc = strdupsafe(rdesc);
+  const char *old = obj->rdesc;
+  obj->rdesc = strShare(rdesc);
+  strRelease(old);
 }
 
 void objSetClass(OBJ_DATA *obj, const char *prototype) {
-  if(obj->class) free(obj->class);
-  obj->class = strdupsafe(prototype);
+  const char *old = obj->class;
+  obj->class = strIntern(prototype);
+  strRelease(old);
 }
 
 void objSetPrototypes(OBJ_DATA *obj, const char *prototypes) {
-  if(obj->prototypes) free(obj->prototypes);
-  obj->prototypes = strdupsafe(prototypes);
+  const char *old = obj->prototypes;
+  obj->prototypes = strIntern(prototypes);
+  strRelease(old);
 }
 
 void objAddPrototype(OBJ_DATA *obj, const char *prototype) {
-  add_keyword(&obj->prototypes, prototype);
+  char *prototypes = strdup(obj->prototypes);
+  add_keyword(&prototypes, prototype);
+  objSetPrototypes(obj, prototypes);
+  free(prototypes);
 }
 
 void objSetName(OBJ_DATA *obj, const char *name) {
-  if(obj->name) free(obj->name);
-  obj->name = strdupsafe(name);
+  const char *old = obj->name;
+  obj->name = strShare(name);
+  strRelease(old);
 }
 
 void objSetDesc(OBJ_DATA *obj, const char *desc) {
-  bufferClear(obj->desc);
-  bufferCat(obj->desc, (desc ? desc : ""));
+  bufferShare(obj->desc, desc);
 }
 
 void objSetMultiName(OBJ_DATA *obj, const char *multi_name) {
-  if(obj->multi_name) free(obj->multi_name);
-  obj->multi_name = strdupsafe(multi_name);
+  const char *old = obj->multi_name;
+  obj->multi_name = strShare(multi_name);
+  strRelease(old);
 }
 
 void objSetMultiRdesc(OBJ_DATA *obj, const char *multi_rdesc) {
-  if(obj->multi_rdesc) free(obj->multi_rdesc);
-  obj->multi_rdesc = strdupsafe(multi_rdesc);
+  const char *old = obj->multi_rdesc;
+  obj->multi_rdesc = strShare(multi_rdesc);
+  strRelease(old);
 }
 
 void objSetEdescs(OBJ_DATA *obj, EDESC_SET *edescs) {
@@ -358,25 +434,61 @@ void objSetEdescs(OBJ_DATA *obj, EDESC_SET *edescs) {
 }
 
 void objSetCarrier(OBJ_DATA *obj, CHAR_DATA *ch) {
+  if(obj->carrier != NULL)
+    charAddCarriedWeight(obj->carrier, -objGetWeight(obj));
   obj->carrier = ch;
+  if(ch != NULL)
+    charAddCarriedWeight(ch, objGetWeight(obj));
+  sightChanged();
 }
 
 void objSetWearer(OBJ_DATA *obj, CHAR_DATA *ch) {
+  if(obj->wearer != NULL)
+    charAddCarriedWeight(obj->wearer, -objGetWeight(obj));
   obj->wearer = ch;
+  if(ch != NULL)
+    charAddCarriedWeight(ch, objGetWeight(obj));
+  sightChanged();
 }
 
 void objSetContainer(OBJ_DATA *obj, OBJ_DATA  *cont) {
+  if(obj->container != NULL)
+    obj_weight_changed(obj, -objGetWeight(obj));
   obj->container = cont;
+  if(cont != NULL)
+    obj_weight_changed(obj, objGetWeight(obj));
+  sightChanged();
 }
 
 void objSetRoom(OBJ_DATA *obj, ROOM_DATA *room) {
   obj->room = room;
+  sightChanged();
+}
+
+void objSetListNode(OBJ_DATA *obj, LIST_NODE *node) {
+  obj->list_node = node;
+}
+
+void objSetGameNode(OBJ_DATA *obj, LIST_NODE *node) {
+  obj->game_node = node;
+}
+
+void objSetExtracted(OBJ_DATA *obj) {
+  obj->extracted = TRUE;
 }
 
 void objSetWeightRaw(OBJ_DATA *obj, double weight) {
-  obj->weight = weight;
+  double delta = weight - obj->weight;
+  obj->weight  = weight;
+  if(delta != 0)
+    obj_weight_changed(obj, delta);
 }
 
 void objSetHidden(OBJ_DATA *obj, int amnt) {
   obj->hidden = amnt;
+  sightChanged();
+}
+
+void objSetBirth(OBJ_DATA *obj, time_t birth) {
+  obj->birth = birth;
 }
@@ -49,6 +49,9 @@ CHAR_DATA   *objGetCarrier   (OBJ_DATA *obj);
 CHAR_DATA   *objGetWearer    (OBJ_DATA *obj);
 OBJ_DATA    *objGetContainer (OBJ_DATA *obj);
 ROOM_DATA   *objGetRoom      (OBJ_DATA *obj);
+LIST_NODE   *objGetListNode  (OBJ_DATA *obj);
+LIST_NODE   *objGetGameNode  (OBJ_DATA *obj);
+bool         objIsExtracted  (OBJ_DATA *obj);
 LIST        *objGetContents  (OBJ_DATA *obj);
 LIST        *objGetUsers     (OBJ_DATA *obj);
 int          objGetUID       (OBJ_DATA *obj);
@@ -56,6 +59,7 @@ time_t       objGetBirth     (OBJ_DATA *obj);
 double       objGetWeight    (OBJ_DATA *obj);
 double       objGetWeightRaw (OBJ_DATA *obj);
 void        *objGetAuxiliaryData(const OBJ_DATA *obj, const char *name);
+void        *objGetAuxiliarySlot(const OBJ_DATA *obj, int slot);
 BITVECTOR   *objGetBits      (OBJ_DATA *obj);
 int          objGetHidden    (OBJ_DATA *Obj);
 
@@ -73,7 +77,11 @@ void         objSetCarrier   (OBJ_DATA *obj, CHAR_DATA *ch);
 void         objSetWearer    (OBJ_DATA *obj, CHAR_DATA *ch);
 void         objSetContainer (OBJ_DATA *obj, OBJ_DATA  *cont);
 void         objSetRoom      (OBJ_DATA *obj, ROOM_DATA *room);
+void         objSetListNode  (OBJ_DATA *obj, LIST_NODE *node);
+void         objSetGameNode  (OBJ_DATA *obj, LIST_NODE *node);
+void         objSetExtracted (OBJ_DATA *obj);
 void         objSetWeightRaw (OBJ_DATA *obj, double weight);
 void         objSetHidden    (OBJ_DATA *obj, int amnt);
+void         objSetBirth     (OBJ_DATA *obj, time_t birth);
 
 #endif // __OBJECT_H
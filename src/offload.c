@@ -0,0 +1,107 @@
+//*****************************************************************************
+//
+// offload.c
+//
+// running jobs on worker threads, and delivering them back to the game
+// thread. See offload.h
+//
+//*****************************************************************************
+
+#include <pthread.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "event.h"
+#include "worker_pool.h"
+#include "offload.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+typedef struct {
+  void (*  run)(void *data);
+  void (* done)(void *data);
+  void    *data;
+} OFFLOAD_JOB;
+
+WORKER_POOL *offload_pool = NULL;
+
+// jobs our workers have finished, waiting for the game thread
+pthread_mutex_t offload_lock = PTHREAD_MUTEX_INITIALIZER;
+LIST           *offload_done = NULL;
+
+// jobs submitted and not delivered
+int offload_pending = 0;
+
+// what our events belong to. Not NULL, so scripts interrupting the events
+// that belong to nothing don't take ours with them
+int offload_owner = 0;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// the job our workers run
+void offload_run(OFFLOAD_JOB *job) {
+  job->run(job->data);
+  pthread_mutex_lock(&offload_lock);
+  listQueue(offload_done, job);
+  pthread_mutex_unlock(&offload_lock);
+}
+
+//
+// hand a finished job back to whoever submitted it
+void offload_deliver(void *owner, OFFLOAD_JOB *job, const char *arg) {
+  offload_pending--;
+  job->done(job->data);
+  free(job);
+}
+
+//
+// every pulse, before its other events go off, start a zero-delay event for
+// each job that has finished since the last
+void offload_collect(void *owner, void *data, const char *arg) {
+  OFFLOAD_JOB *job = NULL;
+  pthread_mutex_lock(&offload_lock);
+  LIST *done   = offload_done;
+  offload_done = newList();
+  pthread_mutex_unlock(&offload_lock);
+  while((job = listPop(done)) != NULL)
+    start_event(&offload_owner, 0, offload_deliver, NULL, job, NULL);
+  deleteList(done);
+}
+
+
+
+//*****************************************************************************
+// implementation of offload.h
+//*****************************************************************************
+void init_offload(void) {
+  int threads  = mudsettingGetInt("offload_threads");
+  offload_done = newList();
+  if(threads > 0 && (offload_pool = newWorkerPool("offload", threads)) != NULL)
+    log_string("Running offloaded jobs on %d worker threads.",
+	       workerPoolGetSize(offload_pool));
+  start_update(&offload_owner, 1, offload_collect, NULL, NULL, NULL);
+}
+
+void offloadSubmit(void *run, void *done, void *data) {
+  OFFLOAD_JOB *job = malloc(sizeof(OFFLOAD_JOB));
+  job->run  = run;
+  job->done = done;
+  job->data = data;
+  offload_pending++;
+  if(offload_pool != NULL)
+    workerPoolAdd(offload_pool, offload_run, job);
+  else
+    offload_run(job);
+}
+
+int offloadPending(void) {
+  return offload_pending;
+}
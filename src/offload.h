@@ -0,0 +1,29 @@
+#ifndef __OFFLOAD_H
+#define __OFFLOAD_H
+//*****************************************************************************
+//
+// offload.h
+//
+// running pure computations off of the game thread. A job is a function that
+// works only on the data it is handed (see worker_pool.h for what that rules
+// out), and a function to call with the same data once it is done. Jobs run
+// on a pool of offload_threads workers. When one finishes, its done function
+// is called on the game thread by a zero-delay event, along with the next
+// pulse's other events. If there are no workers, jobs are run when they are
+// submitted, but their done functions still wait for the event.
+//
+//*****************************************************************************
+
+//
+// set up the workers, and the event that delivers finished jobs
+void init_offload(void);
+
+//
+// run run(data) off of the game thread, and then done(data) back on it
+void offloadSubmit(void *run, void *done, void *data);
+
+//
+// how many jobs have been submitted and not delivered yet
+int offloadPending(void);
+
+#endif // __OFFLOAD_H
@@ -79,7 +79,11 @@ bool accedit_parser(SOCKET_DATA *sock, ACCOUNT_DATA *acct, int choice,
     if(strlen(arg) < 4 || strlen(arg) > 12)
       return FALSE;
     else {
-      accountSetPassword(acct, crypt(arg, accountGetName(acct)));
+      char *setting = passwordNewSetting();
+      char    *hash = passwordHash(arg, setting);
+      accountSetPassword(acct, hash);
+      free(setting);
+      free(hash);
       return TRUE;
     }
   default:
@@ -374,6 +374,8 @@ void save_obj_olc(OBJ_OLC *data) {
   if(old_proto == NULL)
     worldPutType(gameworld, "oproto", protoGetKey(new_proto), new_proto);
   else {
+    // the editor doesn't know about snapshots; keep what we had
+    protoSetSnapshot(new_proto, protoIsSnapshot(old_proto));
     protoCopyTo(new_proto, old_proto);
     deleteProto(new_proto);
   }
@@ -71,6 +71,9 @@ typedef struct olc_data {
   void          *data;
   void  *working_copy;
   int             cmd;
+
+  // the menu as it was last drawn. NULL if it needs to be drawn again
+  BUFFER   *menu_cache;
 } OLC_DATA;
 
 OLC_DATA *newOLC(void    (* menu)(SOCKET_DATA *, void *),
@@ -99,9 +102,21 @@ void deleteOLC(OLC_DATA *olc) {
   // are we working with C functions or Python functions?
   if(olc->deleter)
     olc->deleter(olc->working_copy);
+  if(olc->menu_cache)
+    deleteBuffer(olc->menu_cache);
   free(olc);
 }
 
+//
+// what we're editing may have changed; draw the menu again next time it is
+// displayed, instead of sending the one we drew last
+void olc_menu_changed(OLC_DATA *olc) {
+  if(olc->menu_cache != NULL) {
+    deleteBuffer(olc->menu_cache);
+    olc->menu_cache = NULL;
+  }
+}
+
 
 
 //*****************************************************************************
@@ -131,7 +146,9 @@ deleteOLCAuxData(OLC_AUX_DATA *data) {
 //*****************************************************************************
 
 //
-// display the current menu to the socket, as well as the generic prompt
+// display the current menu to the socket, as well as the generic prompt. The
+// menu is shown every time the prompt is, but only drawn when what we're
+// editing might have changed. Otherwise, what was drawn last time is sent
 //
 void olc_menu(SOCKET_DATA *sock) {
   // send the current menu
@@ -140,7 +157,17 @@ void olc_menu(SOCKET_DATA *sock) {
   // don't display then menu if we've made a menu choice
   if(olc->cmd == MENU_NOCHOICE) {
     text_to_buffer(sock, CLEAR_SCREEN);
-    olc->menu(sock, olc->working_copy);
+    if(olc->menu_cache != NULL)
+      text_to_buffer(sock, bufferString(olc->menu_cache));
+    else {
+      // menus draw straight to the socket; keep a copy of what they sent
+      BUFFER *out = socketGetOutbound(sock);
+      int   start = bufferLength(out);
+      olc->menu(sock, olc->working_copy);
+      olc->menu_cache = newBuffer(MAX(1, bufferLength(out) - start));
+      if(bufferLength(out) > start)
+	bufferCat(olc->menu_cache, bufferString(out) + start);
+    }
 #ifdef MODULE_HELP2
     text_to_buffer(sock, "\r\n{gEnter choice, ? [topic] for help, or Q to quit: ");
 #else
@@ -179,6 +206,10 @@ void *olc_exit(SOCKET_DATA *sock, bool save) {
   // if it's not the same as our main copy)
   deleteOLC(olc);
 
+  // whatever we were editing was part of what the next OLC down is editing
+  if(listSize(aux_olc->olc_stack) > 0)
+    olc_menu_changed(listGet(aux_olc->olc_stack, 0));
+
   // if our OLC stack is empty, pop the OLC input handler
   if(listSize(aux_olc->olc_stack) == 0)
     socketPopInputHandler(sock);
@@ -197,6 +228,8 @@ void olc_handler(SOCKET_DATA *sock, char *arg) {
 
   // we're giving an argument for a menu choice we've already selected
   if(olc->cmd > MENU_NOCHOICE) {
+    // even a change that didn't go right may have done part of its work
+    olc_menu_changed(olc);
     // the change went alright. Re-display the menu
     if(olc->parser(sock, olc->working_copy, olc->cmd, arg))
       olc->cmd = MENU_NOCHOICE;
@@ -263,6 +296,10 @@ void olc_handler(SOCKET_DATA *sock, char *arg) {
 
     default: {
       int cmd = olc->chooser(sock, olc->working_copy, arg);
+      // choices can change things on their own (e.g. toggles), or open up
+      // another OLC. Invalid ones leave everything as it was
+      if(cmd != MENU_CHOICE_INVALID)
+	olc_menu_changed(olc);
       // the menu choice we entered wasn't a valid one. redisplay the menu
       if(cmd == MENU_CHOICE_INVALID)
 	;//olc_menu(sock);
@@ -363,7 +400,7 @@ void reload_mobile(const char *key, bool replace_room, bool replace_all, CHAR_DA
       // transfer inventory from old to new
       LIST *inv = charGetInventory(mob);
       OBJ_DATA *obj = NULL;
-      while((obj = listPop(inv)) != NULL) {
+      while((obj = listHead(inv)) != NULL) {
         obj_from_char(obj);
         obj_to_char(obj, new_mob);
       }
@@ -430,7 +467,7 @@ void reload_object(const char *key, bool replace_room, bool replace_all, CHAR_DA
       // transfer contents from old to new (for containers/furniture)
       LIST *contents = objGetContents(obj);
       OBJ_DATA *content = NULL;
-      while((content = listPop(contents)) != NULL) {
+      while((content = listHead(contents)) != NULL) {
         obj_from_obj(content);
         obj_to_obj(content, new_obj);
       }
@@ -763,10 +800,12 @@ void view_proto(CHAR_DATA *ch, const char *type, const char *key) {
 		     "Key          : %s\r\n"
 		     "Parents      : %s\r\n"
 		     "Abstract     : %s\r\n"
+		     "Snapshot     : %s\r\n"
 		     "--------------------------------------------------------------------------------\r\n",
 		     protoGetKey(proto), 
 		     protoGetParents(proto),
-		     YESNO(protoIsAbstract(proto)));
+		     YESNO(protoIsAbstract(proto)),
+		     YESNO(protoIsSnapshot(proto)));
       script_display(charGetSocket(ch), protoGetScript(proto), FALSE);
     }
   }
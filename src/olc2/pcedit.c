@@ -13,6 +13,7 @@
 #include "../races.h"
 #include "../handler.h"
 #include "../save.h"
+#include "../hooks.h"
 
 #include "olc.h"
 
@@ -125,6 +126,7 @@ bool pcedit_parser(SOCKET_DATA *sock, CHAR_DATA *mob, int choice,
   case PCEDIT_USER_GROUPS:
     bitClear(charGetUserGroups(mob));
     bitToggle(charGetUserGroups(mob), arg);
+    hookRunArgs("user_groups_changed", "ch", mob);
     return TRUE;
   case PCEDIT_RACE:
     if(!isRace(arg))
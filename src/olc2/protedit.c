@@ -36,9 +36,11 @@ void protedit_menu(SOCKET_DATA *sock, PROTO_DATA *data) {
 		 "{y[{c%s{y]\r\n"
 		 "{g1) parents : {c%s\r\n"
 		 "{g2) abstract: {c%s\r\n"
-		 "{g3) prototype code\r\n",
+		 "{g3) prototype code\r\n"
+		 "{g4) snapshot: {c%s\r\n",
 		 protoGetKey(data), protoGetParents(data), 
-		 (protoIsAbstract(data) ? "yes" : "no"));
+		 (protoIsAbstract(data) ? "yes" : "no"),
+		 (protoIsSnapshot(data) ? "yes" : "no"));
   script_display(sock, protoGetScript(data), FALSE);
 }
 
@@ -53,6 +55,9 @@ int protedit_chooser(SOCKET_DATA *sock, PROTO_DATA *data, const char *option) {
   case '3':
     socketStartEditor(sock, script_editor, protoGetScriptBuffer(data));
     return MENU_NOCHOICE;
+  case '4':
+    protoSetSnapshot(data, (protoIsSnapshot(data) + 1) % 2);
+    return MENU_NOCHOICE;
   default:
     return MENU_CHOICE_INVALID;
   }
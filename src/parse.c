@@ -62,12 +62,36 @@ typedef struct {
 
 
 //
-// create a new parse token of the specified type
+// a syntax, compiled down into its tokens. Compiling the same syntax for
+// every command that's typed is most of the work of parsing its arguments, so
+// compiled formats are kept for reuse (see parseFormatGet). Each has an arena
+// of its own that its tokens (and everything they hold) are taken from, so it
+// can be thrown out in one go when nobody wants it anymore
+struct parse_format {
+  ARENA       *arena;
+  LIST       *tokens; // NULL if the syntax had an error in it
+  int        py_args; // how many values Py_parse_args returns for us
+  int           refs;
+};
+
+// the most compiled formats we keep around before starting over
+#define MAX_PARSE_FORMATS   1024
+
+// syntax -> PARSE_FORMAT
+HASHTABLE *parse_formats = NULL;
+
+// the arena of the format we're in the middle of compiling
+ARENA      *token_arena = NULL;
+
+
+//
+// create a new parse token of the specified type, in the arena of the format
+// we're compiling
 PARSE_TOKEN *newParseToken(int type) {
-  PARSE_TOKEN *token = calloc(1, sizeof(PARSE_TOKEN));
+  PARSE_TOKEN *token = arenaCalloc(token_arena, sizeof(PARSE_TOKEN));
   token->type = type;
   if(type == PARSE_TOKEN_MULTI)
-    token->token_list = newList();
+    token->token_list = newListArena(token_arena);
   else if(type == PARSE_TOKEN_OBJ) {
     SET_BIT(token->scope, FIND_SCOPE_VISIBLE);
   }
@@ -87,21 +111,12 @@ PARSE_TOKEN *newParseTokenDescriptive(int type, const char *format) {
   // do we have a describer between ( and )?
   if(endswith(format, ")") && strchr(format, '(')) {
     format = format + next_letter_in(format, '(') + 1;
-    token->flavor = strdup(format);
+    token->flavor = arenaStrdup(token_arena, format);
     token->flavor[strlen(token->flavor)-1] = '\0';
   }
   return token;
 }
 
-//
-// free a token from memory
-void deleteParseToken(PARSE_TOKEN *arg) {
-  if(arg->token_list)
-    deleteListWith(arg->token_list, deleteParseToken);
-  if(arg->flavor)
-    free(arg->flavor);
-  free(arg);
-}
 
 
 
@@ -121,22 +136,17 @@ typedef struct {
 
 
 //
-// create a new parse var of the specified type
+// create a new parse var of the specified type. Like tokens, vars come from
+// the scratch arena. Lists of things we found are still malloc'd, since
+// whoever asked for them gets to keep them
 PARSE_VAR *newParseVar(int type) {
-  PARSE_VAR          *var = calloc(1, sizeof(PARSE_VAR));
+  PARSE_VAR          *var = arenaCalloc(scratch_arena(), sizeof(PARSE_VAR));
   var->disambiguated_type = PARSE_NONE;
   var->type               = type;
   return var;
 }  
 
 
-//
-// delete a parse var
-void deleteParseVar(PARSE_VAR *var) {
-  free(var);
-}
-
-
 
 //*****************************************************************************
 // local functions
@@ -174,7 +184,6 @@ PARSE_TOKEN *parse_token_char(const char *options) {
       break;
     // didn't recognize the option
     else {
-      deleteParseToken(token);
       token = NULL;
       break;
     }
@@ -182,7 +191,6 @@ PARSE_TOKEN *parse_token_char(const char *options) {
 
   // if we successfully parsed the token, make sure there's a scope to look in
   if(token != NULL && !IS_SET(token->scope, FIND_SCOPE_ROOM|FIND_SCOPE_WORLD)) {
-    deleteParseToken(token);
     token = NULL;
   }
 
@@ -226,7 +234,6 @@ PARSE_TOKEN *parse_token_obj(const char *options) {
       break;
     // didn't recognize the option
     else {
-      deleteParseToken(token);
       token = NULL;
       break;
     }
@@ -235,7 +242,6 @@ PARSE_TOKEN *parse_token_obj(const char *options) {
   // if we successfully parsed the token, make sure there's a scope to look in
   if(token != NULL && !IS_SET(token->scope, FIND_SCOPE_ROOM | FIND_SCOPE_WORLD |
 			                    FIND_SCOPE_INV  | FIND_SCOPE_WORN)){
-    deleteParseToken(token);
     token = NULL;
   }
 
@@ -263,7 +269,6 @@ PARSE_TOKEN *parse_token_exit(const char *options) {
       break;
     // didn't recognize the option
     else {
-      deleteParseToken(token);
       token = NULL;
       break;
     }
@@ -363,7 +368,6 @@ PARSE_TOKEN *parse_multi_token(const char **format) {
   // if we never found a close, or we didn't parse any arguments,
   // delete the token because it was not finished
   if(close_found == FALSE || listSize(multi_token->token_list) == 0) {
-    deleteParseToken(multi_token);
     multi_token = NULL;
   }
   // otherwise, skip the closing bracket and up the position of format
@@ -410,12 +414,11 @@ PARSE_TOKEN *parse_flavor_token(const char **format, bool optional) {
 
   // make sure we closed everything off
   if(open_count > 0) {
-    deleteParseToken(token);
     token = NULL;
   }
   // move our format up and copy over the flavor string
   else {
-    token->flavor = strdup(buf);
+    token->flavor = arenaStrdup(token_arena, buf);
     *format = fmt;
   }
 
@@ -475,7 +478,7 @@ PARSE_TOKEN *parse_one_token(const char **format) {
 LIST *decompose_parse_format(const char *format) {
   const char  *fmt = format; 
   bool       error = FALSE;
-  LIST *token_list = newList();
+  LIST *token_list = newListArena(token_arena);
 
   // try to parse all of our format down into tokens
   while(*fmt != '\0' && !error) {
@@ -489,10 +492,8 @@ LIST *decompose_parse_format(const char *format) {
   }
 
   // did we encounter an error?
-  if(error == TRUE) {
-    deleteListWith(token_list, deleteParseToken);
+  if(error == TRUE)
     token_list = NULL;
-  }
 
   return token_list;
 }
@@ -611,7 +612,6 @@ PARSE_VAR *use_one_parse_token_char(CHAR_DATA *looker, PARSE_TOKEN *tok,
       if(tok->self_ok || looker != found)
 	var->ptr_val = found;
       else {
-	deleteParseVar(var);
 	var = NULL;
       }
     }
@@ -630,13 +630,11 @@ PARSE_VAR *use_one_parse_token_char(CHAR_DATA *looker, PARSE_TOKEN *tok,
       }
       else {
 	deleteList(found);
-	deleteParseVar(var);
 	var = NULL;
       }
     }
     // this shouldn't happen...
     else {
-      deleteParseVar(var);
       var = NULL;
     }
 
@@ -679,14 +677,12 @@ PARSE_VAR *use_one_parse_token_obj(CHAR_DATA *looker, PARSE_TOKEN *tok,
       }
       else {
 	deleteList(found);
-	deleteParseVar(var);
 	var = NULL;
       }
     }
 
     // We should never reach this case
     else {
-      deleteParseVar(var);
       var = NULL;
     }
 
@@ -729,14 +725,12 @@ PARSE_VAR *use_one_parse_token_exit(CHAR_DATA *looker, PARSE_TOKEN *tok,
       }
       else {
 	deleteList(found);
-	deleteParseVar(var);
 	var = NULL;
       }
     }
 
     // We should never reach this case
     else {
-      deleteParseVar(var);
       var = NULL;
     }
 
@@ -992,7 +986,7 @@ const char *get_datatype_format_error_mssg(PARSE_TOKEN *tok) {
 // Takes a list of tokens, and builds the proper syntax for the command and
 // then sends it to the character.
 void show_parse_syntax_error(CHAR_DATA *ch, const char *cmd, LIST *tokens) {
-  BUFFER            *buf = newBuffer(1);
+  BUFFER            *buf = newBufferArena(scratch_arena(), 1);
   LIST_ITERATOR   *tok_i = newListIterator(tokens);
   PARSE_TOKEN       *tok = NULL;
   bool    optional_found = FALSE;
@@ -1054,7 +1048,7 @@ void show_parse_syntax_error(CHAR_DATA *ch, const char *cmd, LIST *tokens) {
 // encounter an error and we need to show it to the looker, do so.
 LIST *compose_variable_list(CHAR_DATA *looker, LIST *tokens, char *args,
 			    char *err_buf) {
-  LIST      *variables = newList();
+  LIST      *variables = newListArena(scratch_arena());
   LIST_ITERATOR *tok_i = newListIterator(tokens);
   PARSE_TOKEN     *tok = NULL;
   bool           error = FALSE;
@@ -1085,7 +1079,6 @@ LIST *compose_variable_list(CHAR_DATA *looker, LIST *tokens, char *args,
       listQueue(variables, var);
     // if we enountered an error, tell the person if neccessary
     else if(error == TRUE) {
-      deleteListWith(variables, deleteParseVar);
       variables = NULL;
       break;
     }
@@ -1225,13 +1218,9 @@ PyObject *parse_create_py_vars(LIST *variables) {
 
 
 
-//*****************************************************************************
-// implementation of parse.h
-//*****************************************************************************
-int parse_expected_py_args(const char *syntax) {
-  LIST *tokens = NULL;
-  if((tokens = decompose_parse_format(syntax)) == NULL)
-    return -1;
+//
+// how many values Py_parse_args returns for a list of tokens
+int parse_expected_py_args(LIST *tokens) {
   int count = 0;
   LIST_ITERATOR *token_i = newListIterator(tokens);
   PARSE_TOKEN     *token = NULL;
@@ -1250,97 +1239,146 @@ int parse_expected_py_args(const char *syntax) {
     if(token->all_ok)
       count++;
   } deleteListIterator(token_i);
-  deleteListWith(tokens, deleteParseToken);
-
   return count;
 }
 
-void *Py_parse_args(CHAR_DATA *looker, bool show_errors, const char *cmd, 
-		    char *args, const char *syntax) {
+//
+// compile a syntax into a new format
+PARSE_FORMAT *compile_parse_format(const char *syntax) {
+  PARSE_FORMAT *format = calloc(1, sizeof(PARSE_FORMAT));
+  format->arena        = newArena(512);
+  format->refs         = 1;
+  token_arena          = format->arena;
+  format->tokens       = decompose_parse_format(syntax);
+  token_arena          = NULL;
+  if(format->tokens != NULL)
+    format->py_args    = parse_expected_py_args(format->tokens);
+  return format;
+}
+
+//
+// turn our variables into Python values for Py_parse_args, filling up the
+// optional spots at the end we didn't parse args for
+PyObject *parse_make_py_vars(PARSE_FORMAT *format, LIST *variables) {
+  PyObject *list = parse_create_py_vars(variables);
+  while(PyList_Size(list) < format->py_args)
+    PyList_Append(list, Py_None);
+  return list;
+}
+
+//
+// parse args with a compiled format. If we parse OK and vars isn't NULL, it
+// is given a list of what we parsed, from the scratch arena. Errors are sent to
+// the looker if show_errors is TRUE
+bool parse_with_format(CHAR_DATA *looker, bool show_errors, const char *cmd,
+		       char *args, PARSE_FORMAT *format, LIST **vars) {
   char err_buf[SMALL_BUFFER] = "";
-  bool       parse_ok = TRUE;
-  LIST        *tokens = NULL;
   LIST     *variables = NULL;
-  PyObject      *list = NULL;
 
-  // get our list of tokens
-  if((tokens = decompose_parse_format(syntax)) == NULL) {
-    log_string("Command '%s', format error in argument parsing: %s",cmd,syntax);
-    parse_ok = FALSE;
-  }
-  // try to use our tokens to compose a variable list
-  else if((variables = compose_variable_list(looker, tokens, args, err_buf))
-	  == NULL)
-    parse_ok = FALSE;
-  else {
-    // go through all of our vars and make python forms for them
-    list = parse_create_py_vars(variables);
+  // a bad format has already been logged, when it was compiled
+  if(format->tokens == NULL)
+    return FALSE;
 
-    // fill up optional spots at the end we didn't parse args for
-    int expected = parse_expected_py_args(syntax);
-    while(PyList_Size(list) < expected)
-      PyList_Append(list, Py_None);
+  // try to use our tokens to compose a variable list
+  if((variables = compose_variable_list(looker, format->tokens, args, err_buf))
+     != NULL) {
+    *vars = variables;
+    return TRUE;
   }
 
   // did we encounter an error with the arguments and need to mssg someone?
-  if(tokens != NULL && !parse_ok && show_errors) {
+  if(show_errors) {
     // do we have a specific error message?
     if(*err_buf)
       send_to_char(looker, "%s\r\n", err_buf);
     // assume a syntax error
     else
-      show_parse_syntax_error(looker, cmd, tokens);
+      show_parse_syntax_error(looker, cmd, format->tokens);
+  }
+  return FALSE;
+}
+
+
+
+//*****************************************************************************
+// implementation of parse.h
+//*****************************************************************************
+PARSE_FORMAT *parseFormatGet(const char *syntax) {
+  if(parse_formats == NULL)
+    parse_formats = newHashtable();
+
+  PARSE_FORMAT *format = hashGet(parse_formats, syntax);
+  if(format == NULL) {
+    // if we're full, start over. Anyone still using an old format has a
+    // reference to it, so it is kept until they're done with it
+    if(hashSize(parse_formats) >= MAX_PARSE_FORMATS)
+      hashClearWith(parse_formats, parseFormatRelease);
+    format = compile_parse_format(syntax);
+    if(format->tokens == NULL)
+      log_string("Format error in argument parsing: %s", syntax);
+    hashPut(parse_formats, syntax, format);
+  }
+  format->refs++;
+  return format;
+}
+
+void parseFormatRelease(PARSE_FORMAT *format) {
+  if(--format->refs == 0) {
+    deleteArena(format->arena);
+    free(format);
   }
+}
 
-  // clean up our mess
-  if(tokens != NULL)
-    deleteListWith(tokens, deleteParseToken);
-  if(variables != NULL)
-    deleteListWith(variables, deleteParseVar);
+bool parseFormatOk(PARSE_FORMAT *format) {
+  return (format->tokens != NULL);
+}
 
-  // return our parse status
+void *Py_parse_args_format(CHAR_DATA *looker, bool show_errors,const char *cmd,
+			   char *args, PARSE_FORMAT *format) {
+  ARENA_MARK     mark = arenaMark(scratch_arena());
+  LIST     *variables = NULL;
+  PyObject      *list = NULL;
+
+  // hold onto the format, in case parsing runs something that compiles
+  // enough formats for ours to be thrown out of the cache
+  format->refs++;
+  if(parse_with_format(looker, show_errors, cmd, args, format, &variables))
+    list = parse_make_py_vars(format, variables);
+  parseFormatRelease(format);
+
+  // clean up our mess. Variables all came from the scratch arena
+  arenaRelease(scratch_arena(), mark);
+  return list;
+}
+
+void *Py_parse_args(CHAR_DATA *looker, bool show_errors, const char *cmd, 
+		    char *args, const char *syntax) {
+  PARSE_FORMAT *format = parseFormatGet(syntax);
+  PyObject       *list = Py_parse_args_format(looker, show_errors, cmd, args,
+					      format);
+  parseFormatRelease(format);
   return list;
 }
 
 bool parse_args(CHAR_DATA *looker, bool show_errors, const char *cmd,
 		char *args, const char *syntax, ...) {
-  char err_buf[SMALL_BUFFER] = "";
-  bool       parse_ok = TRUE;
-  LIST       *tokens  = NULL;
+  ARENA_MARK     mark = arenaMark(scratch_arena());
+  PARSE_FORMAT *format = parseFormatGet(syntax);
   LIST     *variables = NULL;
+  bool       parse_ok = parse_with_format(looker, show_errors, cmd, args,
+					  format, &variables);
 
-  // get our list of tokens
-  if((tokens = decompose_parse_format(syntax)) == NULL) {
-    log_string("Command '%s', format error in argument parsing: %s",cmd,syntax);
-    parse_ok = FALSE;
-  }
-  // try to use our tokens to compose a variable list
-  else if((variables = compose_variable_list(looker, tokens, args, err_buf))
-	  == NULL)
-    parse_ok = FALSE;
-  else {
-    // go through all of our vars and assign them to the proper args
+  // go through all of our vars and assign them to the proper args
+  if(parse_ok) {
     va_list vargs;
     va_start(vargs, syntax);
     parse_assign_vars(variables, vargs);
     va_end(vargs);
   }
+  parseFormatRelease(format);
 
-  // did we encounter an error with the arguments and need to mssg someone?
-  if(tokens != NULL && !parse_ok && show_errors) {
-    // do we have a specific error message?
-    if(*err_buf)
-      send_to_char(looker, "%s\r\n", err_buf);
-    // assume a syntax error
-    else
-      show_parse_syntax_error(looker, cmd, tokens);
-  }
-
-  // clean up our mess
-  if(tokens != NULL)
-    deleteListWith(tokens, deleteParseToken);
-  if(variables != NULL)
-    deleteListWith(variables, deleteParseVar);
+  // clean up our mess. Variables all came from the scratch arena
+  arenaRelease(scratch_arena(), mark);
 
   // return our parse status
   return parse_ok;
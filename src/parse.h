@@ -118,4 +118,18 @@ bool parse_args(CHAR_DATA *looker, bool show_errors, const char *cmd,
 void *Py_parse_args(CHAR_DATA *looker, bool show_errors, const char *cmd, 
 		    char *args, const char *syntax);
 
+//
+// Syntaxes are compiled the first time they are used, and the compiled form
+// is kept for the next time. parseFormatGet returns the compiled form of a
+// syntax, which whoever asked for it must release when they're done with it.
+// If the syntax has an error in it, it is logged, parseFormatOk returns FALSE,
+// and parsing with it always fails. Py_parse_args_format is the same as
+// Py_parse_args, but uses a format that has already been compiled
+typedef struct parse_format PARSE_FORMAT;
+PARSE_FORMAT *parseFormatGet(const char *syntax);
+void      parseFormatRelease(PARSE_FORMAT *format);
+bool           parseFormatOk(PARSE_FORMAT *format);
+void   *Py_parse_args_format(CHAR_DATA *looker, bool show_errors,
+			     const char *cmd, char *args, PARSE_FORMAT *format);
+
 #endif // PARSE_H
@@ -0,0 +1,373 @@
+//*****************************************************************************
+//
+// poller.c
+//
+// a small abstraction over the operating system's socket readiness
+// notification. See poller.h for the interface. Three backends live in here:
+// epoll (Linux), kqueue (BSD, OSX) and select (everything else). Whatever the
+// backend, we keep a table of the descriptors we are watching, indexed by the
+// descriptor itself, so we can hand the right data back for ready ones.
+//
+//*****************************************************************************
+
+#include "mud.h"
+#include "poller.h"
+
+#if !defined(POLLER_USE_SELECT) && defined(__linux__)
+#define POLLER_EPOLL
+#include <sys/epoll.h>
+#elif !defined(POLLER_USE_SELECT) && (defined(__APPLE__)   || \
+				      defined(__FreeBSD__) || \
+				      defined(__OpenBSD__) || \
+				      defined(__NetBSD__)  || \
+				      defined(__DragonFly__))
+#define POLLER_KQUEUE
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#else
+#define POLLER_SELECT
+#include <sys/select.h>
+#include <sys/time.h>
+#endif
+
+// how many ready descriptors we have room for before we grow
+#define POLLER_START_READY      64
+
+
+
+//*****************************************************************************
+// local datastructures and variables
+//*****************************************************************************
+typedef struct {
+  void *data;   // the data we hand back when the descriptor is ready
+  int events;   // what we are watching for. 0 if we're not watching it
+} POLL_ENTRY;
+
+typedef struct {
+  int     fd;
+  int events;
+  void *data;
+} POLL_READY;
+
+POLL_ENTRY *poll_entries = NULL; // indexed by descriptor
+int     num_poll_entries = 0;    // how big is poll_entries?
+int      num_watched_fds = 0;    // how many descriptors are we watching?
+
+POLL_READY  *poll_ready  = NULL; // the results of our last pollerWait
+int      poll_ready_size = 0;    // how much room do we have for results?
+int       num_poll_ready = 0;    // how many results did we get?
+
+#if defined(POLLER_EPOLL)
+int                       epoll_fd = -1;
+struct epoll_event *epoll_events   = NULL;
+#elif defined(POLLER_KQUEUE)
+int                       kqueue_fd = -1;
+struct kevent      *kqueue_events   = NULL;
+#else
+fd_set              select_read_set;
+fd_set             select_write_set;
+int                   select_max_fd = -1;
+#endif
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// make sure we have a table entry for the descriptor
+void poller_reserve_entry(int fd) {
+  if(fd < num_poll_entries)
+    return;
+  int new_size = (num_poll_entries > 0 ? num_poll_entries : 64);
+  while(new_size <= fd)
+    new_size *= 2;
+  poll_entries = realloc(poll_entries, sizeof(POLL_ENTRY) * new_size);
+  memset(poll_entries + num_poll_entries, 0,
+	 sizeof(POLL_ENTRY) * (new_size - num_poll_entries));
+  num_poll_entries = new_size;
+}
+
+//
+// make sure we have room to report every descriptor we watch as ready. kqueue
+// can report reading and writing as separate events, so we need double there
+void poller_reserve_ready(void) {
+  int needed = num_watched_fds * 2;
+  if(needed <= poll_ready_size)
+    return;
+  int new_size = (poll_ready_size > 0 ? poll_ready_size : POLLER_START_READY);
+  while(new_size < needed)
+    new_size *= 2;
+  poll_ready = realloc(poll_ready, sizeof(POLL_READY) * new_size);
+#if defined(POLLER_EPOLL)
+  epoll_events  = realloc(epoll_events, sizeof(struct epoll_event) * new_size);
+#elif defined(POLLER_KQUEUE)
+  kqueue_events = realloc(kqueue_events, sizeof(struct kevent) * new_size);
+#endif
+  poll_ready_size = new_size;
+}
+
+//
+// record a descriptor as ready in our results
+void poller_add_ready(int fd, int events) {
+  POLL_READY *ready = &poll_ready[num_poll_ready++];
+  ready->fd     = fd;
+  ready->events = events;
+  ready->data   = (fd < num_poll_entries ? poll_entries[fd].data : NULL);
+}
+
+#if defined(POLLER_KQUEUE)
+//
+// add or remove one kqueue filter for a descriptor
+bool poller_kqueue_change(int fd, int filter, bool add) {
+  struct kevent change;
+  EV_SET(&change, fd, filter, (add ? EV_ADD | EV_ENABLE : EV_DELETE), 0,0,NULL);
+  return (kevent(kqueue_fd, &change, 1, NULL, 0, NULL) != -1);
+}
+
+//
+// bring a descriptor's kqueue filters in line with the events we want
+bool poller_kqueue_update(int fd, int old_events, int new_events) {
+  bool success = TRUE;
+  if((old_events & POLLER_READ) != (new_events & POLLER_READ))
+    success = poller_kqueue_change(fd, EVFILT_READ,
+				   (new_events & POLLER_READ) != 0) && success;
+  if((old_events & POLLER_WRITE) != (new_events & POLLER_WRITE))
+    success = poller_kqueue_change(fd, EVFILT_WRITE,
+				   (new_events & POLLER_WRITE) != 0) && success;
+  return success;
+}
+#endif
+
+#if defined(POLLER_EPOLL)
+//
+// convert our event flags into epoll's
+unsigned int poller_to_epoll(int events) {
+  unsigned int flags = 0;
+  if(events & POLLER_READ)  flags |= EPOLLIN;
+  if(events & POLLER_WRITE) flags |= EPOLLOUT;
+  return flags;
+}
+#endif
+
+
+
+//*****************************************************************************
+// implementation of poller.h
+//*****************************************************************************
+void init_poller(void) {
+#if defined(POLLER_EPOLL)
+  if((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    perror("init_poller: epoll_create1");
+    exit(1);
+  }
+#elif defined(POLLER_KQUEUE)
+  if((kqueue_fd = kqueue()) < 0) {
+    perror("init_poller: kqueue");
+    exit(1);
+  }
+#else
+  FD_ZERO(&select_read_set);
+  FD_ZERO(&select_write_set);
+  select_max_fd = -1;
+#endif
+  poller_reserve_ready();
+}
+
+const char *pollerGetBackend(void) {
+#if defined(POLLER_EPOLL)
+  return "epoll";
+#elif defined(POLLER_KQUEUE)
+  return "kqueue";
+#else
+  return "select";
+#endif
+}
+
+bool pollerAdd(int fd, void *data, int events) {
+  if(fd < 0 || events == 0)
+    return FALSE;
+#if defined(POLLER_SELECT)
+  if(fd >= FD_SETSIZE) {
+    log_string("pollerAdd: descriptor %d is beyond FD_SETSIZE (%d)",
+	       fd, FD_SETSIZE);
+    return FALSE;
+  }
+#endif
+  poller_reserve_entry(fd);
+
+  // we're already watching it. Just change what we're watching for
+  if(poll_entries[fd].events != 0)
+    return pollerModify(fd, data, events);
+
+#if defined(POLLER_EPOLL)
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events  = poller_to_epoll(events);
+  ev.data.fd = fd;
+  if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    perror("pollerAdd: epoll_ctl");
+    return FALSE;
+  }
+#elif defined(POLLER_KQUEUE)
+  if(!poller_kqueue_update(fd, 0, events)) {
+    perror("pollerAdd: kevent");
+    return FALSE;
+  }
+#else
+  if(events & POLLER_READ)  FD_SET(fd, &select_read_set);
+  if(events & POLLER_WRITE) FD_SET(fd, &select_write_set);
+  if(fd > select_max_fd)
+    select_max_fd = fd;
+#endif
+
+  poll_entries[fd].data   = data;
+  poll_entries[fd].events = events;
+  num_watched_fds++;
+  poller_reserve_ready();
+  return TRUE;
+}
+
+bool pollerModify(int fd, void *data, int events) {
+  if(fd < 0 || fd >= num_poll_entries || poll_entries[fd].events == 0)
+    return (events == 0 ? TRUE : pollerAdd(fd, data, events));
+  if(events == 0) {
+    pollerRemove(fd);
+    return TRUE;
+  }
+
+  int old_events = poll_entries[fd].events;
+  poll_entries[fd].data = data;
+  if(old_events == events)
+    return TRUE;
+
+#if defined(POLLER_EPOLL)
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events  = poller_to_epoll(events);
+  ev.data.fd = fd;
+  if(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+    perror("pollerModify: epoll_ctl");
+    return FALSE;
+  }
+#elif defined(POLLER_KQUEUE)
+  if(!poller_kqueue_update(fd, old_events, events)) {
+    perror("pollerModify: kevent");
+    return FALSE;
+  }
+#else
+  if(events & POLLER_READ)  FD_SET(fd, &select_read_set);
+  else                      FD_CLR(fd, &select_read_set);
+  if(events & POLLER_WRITE) FD_SET(fd, &select_write_set);
+  else                      FD_CLR(fd, &select_write_set);
+#endif
+
+  poll_entries[fd].events = events;
+  return TRUE;
+}
+
+void pollerRemove(int fd) {
+  if(fd < 0 || fd >= num_poll_entries || poll_entries[fd].events == 0)
+    return;
+
+#if defined(POLLER_EPOLL)
+  // older kernels require a non-NULL event, even though it is ignored
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+#elif defined(POLLER_KQUEUE)
+  poller_kqueue_update(fd, poll_entries[fd].events, 0);
+#else
+  FD_CLR(fd, &select_read_set);
+  FD_CLR(fd, &select_write_set);
+#endif
+
+  poll_entries[fd].data   = NULL;
+  poll_entries[fd].events = 0;
+  num_watched_fds--;
+
+#if defined(POLLER_SELECT)
+  // find our new highest descriptor
+  while(select_max_fd >= 0 && poll_entries[select_max_fd].events == 0)
+    select_max_fd--;
+#endif
+}
+
+int pollerWait(int timeout) {
+  int i, found;
+  num_poll_ready = 0;
+
+#if defined(POLLER_EPOLL)
+  found = epoll_wait(epoll_fd, epoll_events, poll_ready_size, timeout);
+  if(found < 0)
+    return -1;
+  for(i = 0; i < found; i++) {
+    int events = 0;
+    // errors and hangups are reported as readable, so the reader notices them
+    if(epoll_events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+      events |= POLLER_READ;
+    if(epoll_events[i].events & EPOLLOUT)
+      events |= POLLER_WRITE;
+    poller_add_ready(epoll_events[i].data.fd, events);
+  }
+
+#elif defined(POLLER_KQUEUE)
+  struct timespec ts, *tsp = NULL;
+  if(timeout >= 0) {
+    ts.tv_sec  = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000;
+    tsp = &ts;
+  }
+  found = kevent(kqueue_fd, NULL, 0, kqueue_events, poll_ready_size, tsp);
+  if(found < 0)
+    return -1;
+  for(i = 0; i < found; i++) {
+    if(kqueue_events[i].flags & EV_ERROR)
+      continue;
+    poller_add_ready((int)kqueue_events[i].ident,
+		     (kqueue_events[i].filter == EVFILT_WRITE ?
+		      POLLER_WRITE : POLLER_READ));
+  }
+
+#else
+  struct timeval tv, *tvp = NULL;
+  fd_set read_set, write_set;
+  memcpy(&read_set,  &select_read_set,  sizeof(fd_set));
+  memcpy(&write_set, &select_write_set, sizeof(fd_set));
+  if(timeout >= 0) {
+    tv.tv_sec  = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    tvp = &tv;
+  }
+  found = select(select_max_fd + 1, &read_set, &write_set, NULL, tvp);
+  if(found < 0)
+    return -1;
+  for(i = 0; i <= select_max_fd; i++) {
+    int events = 0;
+    if(FD_ISSET(i, &read_set))  events |= POLLER_READ;
+    if(FD_ISSET(i, &write_set)) events |= POLLER_WRITE;
+    if(events != 0)
+      poller_add_ready(i, events);
+  }
+#endif
+
+  return num_poll_ready;
+}
+
+int pollerReadyCount(void) {
+  return num_poll_ready;
+}
+
+int pollerReadyFd(int i) {
+  return poll_ready[i].fd;
+}
+
+int pollerReadyEvents(int i) {
+  return poll_ready[i].events;
+}
+
+void *pollerReadyData(int i) {
+  return poll_ready[i].data;
+}
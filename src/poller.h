@@ -0,0 +1,56 @@
+#ifndef __POLLER_H
+#define __POLLER_H
+//*****************************************************************************
+//
+// poller.h
+//
+// a small abstraction over the operating system's socket readiness
+// notification. On Linux we use epoll, on the BSDs (and OSX) kqueue, and
+// everywhere else we fall back to plain old select(). Descriptors are
+// registered once, along with a piece of data (usually the SOCKET_DATA the
+// descriptor belongs to), and every call to pollerWait() collects the set
+// of descriptors that are ready for reading or writing. Only those need to
+// be visited by the game loop. You can force the select() backend by
+// compiling with -DPOLLER_USE_SELECT
+//
+//*****************************************************************************
+
+// the kinds of readiness we can ask to be told about
+#define POLLER_READ        (1 << 0)
+#define POLLER_WRITE       (1 << 1)
+
+//
+// set up the poller. Must be called before any descriptors are added
+void init_poller(void);
+
+//
+// returns the name of the backend we are using (epoll, kqueue, select)
+const char *pollerGetBackend(void);
+
+//
+// start watching a descriptor for the given events (POLLER_READ, etc...).
+// data is handed back to us by pollerReadyData when the descriptor is ready.
+// Returns TRUE on success, FALSE otherwise
+bool pollerAdd(int fd, void *data, int events);
+
+//
+// change the events we are watching a descriptor for
+bool pollerModify(int fd, void *data, int events);
+
+//
+// stop watching a descriptor. Must be called before the descriptor is closed
+void pollerRemove(int fd);
+
+//
+// wait up to timeout milliseconds (0 for no waiting, -1 for indefinitely) for
+// one of our descriptors to become ready. Returns the number of descriptors
+// that are ready, or -1 on error. The ready descriptors can be iterated over
+// with the accessors below until the next call to pollerWait()
+int pollerWait(int timeout);
+
+int   pollerReadyCount (void);
+int   pollerReadyFd    (int i);
+int   pollerReadyEvents(int i);
+void *pollerReadyData  (int i);
+
+#endif // __POLLER_H
@@ -20,16 +20,61 @@
 #include "utils.h"
 #include "property_table.h"
 
+//
+// property tables are used to look things up by their UID, which are handed
+// out in increasing order and never reused. So, rather than hashing keys, a
+// table is a directory of pages, each holding the elements for a run of
+// PROPERTY_PAGE_SIZE consecutive keys, and a lookup is just two array
+// indexes. Pages are made when something is first put in them and freed
+// once they empty out, so the keys of long-gone things cost nothing but a
+// NULL directory entry. Since keys are never reused, looking up the key of
+// something that has been extracted simply finds an empty slot.
+//
+// Negative keys can't be paged, and go in a small open-addressed hash of
+// (key, elem) slots instead. Removed hash slots leave a tombstone behind,
+// so it is safe to remove the current element while iterating.
+//
+
+// how many keys does one page cover? Must be a power of 2
+#define PROPERTY_PAGE_SHIFT           8
+#define PROPERTY_PAGE_SIZE           (1 << PROPERTY_PAGE_SHIFT)
+#define PROPERTY_PAGE_MASK           (PROPERTY_PAGE_SIZE - 1)
+
+// the number of hash buckets must always be a power of 2
+#define PROPERTY_MIN_BUCKETS         16
+
+// what a hash slot holds after its element has been removed
+#define PROPERTY_DELETED   ((void *)&property_deleted)
+char property_deleted;
+
+typedef struct property_page {
+  int                           count; // how many elements are in the page
+  void *elems[PROPERTY_PAGE_SIZE];
+} PROPERTY_PAGE;
+
+typedef struct property_slot {
+  int    key;
+  void *elem; // NULL if the slot is empty, or PROPERTY_DELETED
+} PROPERTY_SLOT;
+
 struct property_table {
-  int num_buckets;
+  int        size; // how many elements are in the table
   int (* key_function)(void *elem);
-  LIST **buckets;
+
+  // elements with non-negative keys
+  int   num_pages;
+  PROPERTY_PAGE **pages;
+
+  // elements with negative keys
+  int num_buckets;
+  int      hashed; // how many elements are in the hash
+  int        used; // how many slots are full or tombstones
+  PROPERTY_SLOT *buckets;
 };
 
 struct property_table_iterator {
-  int curr_bucket;
+  int curr_bucket; // counts through page slots, then hash buckets
   PROPERTY_TABLE *table;
-  LIST_ITERATOR *bucket_i;
 };
 
 
@@ -38,11 +83,101 @@ struct property_table_iterator {
 //*****************************************************************************
 
 //
-// Find the bucket the key belongs to
-int find_bucket(int key, int num_buckets) {
-  // simple for now: just take the modulo. Make sure it's always positive
-  return (key < 0 ? -key : key) % num_buckets;
-};
+// Find the bucket a negative key belongs to. Spread keys out with a
+// multiplicative hash before masking
+unsigned int find_bucket(int key, int num_buckets) {
+  return ((unsigned int)key * 2654435761u) & (num_buckets - 1);
+}
+
+//
+// find the hash slot a key lives in, or NULL if it isn't in the table
+PROPERTY_SLOT *property_find_slot(PROPERTY_TABLE *table, int key) {
+  unsigned int mask = table->num_buckets - 1;
+  unsigned int    i = find_bucket(key, table->num_buckets);
+  for(;; i = (i + 1) & mask) {
+    PROPERTY_SLOT *slot = &table->buckets[i];
+    if(slot->elem == NULL)
+      return NULL;
+    if(slot->key == key && slot->elem != PROPERTY_DELETED)
+      return slot;
+  }
+}
+
+//
+// rebuild the hash with a new number of buckets, dropping tombstones
+void property_rebuild(PROPERTY_TABLE *table, int num_buckets) {
+  PROPERTY_SLOT *old = table->buckets;
+  int        old_num = table->num_buckets;
+  unsigned int  mask = num_buckets - 1;
+  int i;
+
+  table->buckets     = calloc(num_buckets, sizeof(PROPERTY_SLOT));
+  table->num_buckets = num_buckets;
+  table->used        = 0;
+
+  for(i = 0; i < old_num; i++) {
+    if(old[i].elem == NULL || old[i].elem == PROPERTY_DELETED)
+      continue;
+    unsigned int j = find_bucket(old[i].key, num_buckets);
+    while(table->buckets[j].elem != NULL)
+      j = (j + 1) & mask;
+    table->buckets[j] = old[i];
+    table->used++;
+  }
+  free(old);
+}
+
+void property_hash_put(PROPERTY_TABLE *table, int key, void *elem) {
+  PROPERTY_SLOT *slot = property_find_slot(table, key);
+
+  // only one element per key. The newest one wins
+  if(slot != NULL) {
+    slot->elem = elem;
+    return;
+  }
+
+  // keep us no more than 3/4 full, counting tombstones. If it's mostly
+  // tombstones, we can rebuild at the same size
+  if((table->used + 1) * 4 > table->num_buckets * 3)
+    property_rebuild(table, ((table->hashed + 1) * 2 > table->num_buckets ?
+			     table->num_buckets * 2 : table->num_buckets));
+
+  unsigned int mask = table->num_buckets - 1;
+  unsigned int    i = find_bucket(key, table->num_buckets);
+  while(table->buckets[i].elem != NULL &&
+	table->buckets[i].elem != PROPERTY_DELETED)
+    i = (i + 1) & mask;
+  if(table->buckets[i].elem == NULL)
+    table->used++;
+  table->buckets[i].key  = key;
+  table->buckets[i].elem = elem;
+  table->hashed++;
+  table->size++;
+}
+
+void property_page_put(PROPERTY_TABLE *table, int key, void *elem) {
+  int page_i = key >> PROPERTY_PAGE_SHIFT;
+
+  // make sure the directory reaches our page
+  if(page_i >= table->num_pages) {
+    int num_pages = MAX(page_i + 1, table->num_pages * 2);
+    table->pages  = realloc(table->pages, sizeof(PROPERTY_PAGE *) * num_pages);
+    memset(table->pages + table->num_pages, 0, 
+	   sizeof(PROPERTY_PAGE *) * (num_pages - table->num_pages));
+    table->num_pages = num_pages;
+  }
+
+  if(table->pages[page_i] == NULL)
+    table->pages[page_i] = calloc(1, sizeof(PROPERTY_PAGE));
+  PROPERTY_PAGE *page = table->pages[page_i];
+
+  // only one element per key. The newest one wins
+  if(page->elems[key & PROPERTY_PAGE_MASK] == NULL) {
+    page->count++;
+    table->size++;
+  }
+  page->elems[key & PROPERTY_PAGE_MASK] = elem;
+}
 
 
 
@@ -51,104 +186,85 @@ int find_bucket(int key, int num_buckets) {
 // documentation in property_table.h
 //*****************************************************************************
 PROPERTY_TABLE *newPropertyTable(void *key_function, int num_buckets) {
-  int i;
-
   PROPERTY_TABLE *table = malloc(sizeof(PROPERTY_TABLE));
-  table->buckets = malloc(sizeof(LIST *) * num_buckets);
-
-  // all NULL until they actually get a content
-  for(i = 0; i < num_buckets; i++)
-    table->buckets[i] = NULL;
-
-  table->num_buckets = num_buckets;
+  table->size         = 0;
   table->key_function = key_function;
-
+  table->num_pages    = 0;
+  table->pages        = NULL;
+  table->buckets      = calloc(PROPERTY_MIN_BUCKETS, sizeof(PROPERTY_SLOT));
+  table->num_buckets  = PROPERTY_MIN_BUCKETS;
+  table->hashed       = 0;
+  table->used         = 0;
   return table;
-};
+}
 
 
 void deletePropertyTable(PROPERTY_TABLE *table) {
   int i;
-
-  for(i = 0; i < table->num_buckets; i++)
-    if(table->buckets[i] != NULL)
-      deleteList(table->buckets[i]);
-
+  for(i = 0; i < table->num_pages; i++)
+    if(table->pages[i] != NULL)
+      free(table->pages[i]);
+  if(table->pages)
+    free(table->pages);
   free(table->buckets);
   free(table);
-};
+}
 
 
 void propertyTablePut(PROPERTY_TABLE *table, void *elem) {
-  // find out what bucket we belong to
-  int hash_bucket = find_bucket(table->key_function(elem), table->num_buckets);
-
-  // see if we already exist
-  if(table->buckets[hash_bucket] != NULL && 
-     listIn(table->buckets[hash_bucket], elem))
-    return;
-
-  // add us to the bucket
-  if(table->buckets[hash_bucket] == NULL)
-    table->buckets[hash_bucket] = newList();
-  // listPut ensures only one copy is in the list
-  listPut(table->buckets[hash_bucket], elem);
-};
+  int key = table->key_function(elem);
+  if(key < 0)
+    property_hash_put(table, key, elem);
+  else
+    property_page_put(table, key, elem);
+}
 
 
 void *propertyTableRemove(PROPERTY_TABLE *table, int key) {
-  // find out what bucket we belong to
-  int hash_bucket = find_bucket(key, table->num_buckets);
-
-  // see if the bucket exists
-  if(table->buckets[hash_bucket] == NULL)
-    return NULL;
-  else {
-    LIST_ITERATOR *list_i = newListIterator(table->buckets[hash_bucket]);
-    void *elem = NULL;
-
-    // iterate across the list until we find what we need.
-    ITERATE_LIST(elem, list_i) {
-      // we found it!
-      if(key == table->key_function(elem)) {
-	listRemove(table->buckets[hash_bucket], elem);
-	break;
+  void *elem = NULL;
+  if(key < 0) {
+    PROPERTY_SLOT *slot = property_find_slot(table, key);
+    if(slot != NULL) {
+      elem       = slot->elem;
+      slot->elem = PROPERTY_DELETED;
+      table->hashed--;
+      table->size--;
+    }
+  }
+  else if((key >> PROPERTY_PAGE_SHIFT) < table->num_pages) {
+    PROPERTY_PAGE *page = table->pages[key >> PROPERTY_PAGE_SHIFT];
+    if(page != NULL && (elem = page->elems[key & PROPERTY_PAGE_MASK]) != NULL){
+      page->elems[key & PROPERTY_PAGE_MASK] = NULL;
+      table->size--;
+      // nothing will ever be put in here again if everything's been 
+      // extracted, so let the page go
+      if(--page->count == 0) {
+	free(page);
+	table->pages[key >> PROPERTY_PAGE_SHIFT] = NULL;
       }
     }
-
-    deleteListIterator(list_i);
-    return elem;
   }
-};
+  return elem;
+}
 
 
 void *propertyTableGet(PROPERTY_TABLE *table, int key) {
-  // find out what bucket we belong to
-  int hash_bucket = find_bucket(key, table->num_buckets);
-
-  // see if the bucket exists
-  if(table->buckets[hash_bucket] == NULL)
+  if(key < 0) {
+    PROPERTY_SLOT *slot = property_find_slot(table, key);
+    return (slot ? slot->elem : NULL);
+  }
+  else if((key >> PROPERTY_PAGE_SHIFT) >= table->num_pages)
     return NULL;
   else {
-    LIST_ITERATOR *list_i = newListIterator(table->buckets[hash_bucket]);
-    void *elem = NULL;
-
-    // iterate across the list until we find what we need.
-    ITERATE_LIST(elem, list_i) {
-      // we found it!
-      if(key == table->key_function(elem))
-	break;
-    }
-
-    deleteListIterator(list_i);
-    return elem;
+    PROPERTY_PAGE *page = table->pages[key >> PROPERTY_PAGE_SHIFT];
+    return (page ? page->elems[key & PROPERTY_PAGE_MASK] : NULL);
   }
-};
+}
 
 
 bool propertyTableIn(PROPERTY_TABLE *table, int key) {
   return (propertyTableGet(table, key) != NULL);
-};
+}
 
 
 //*****************************************************************************
@@ -157,92 +273,76 @@ bool propertyTableIn(PROPERTY_TABLE *table, int key) {
 // we may sometimes want to iterate across all of the elements in a table.
 // this lets us do so.
 //*****************************************************************************
+
+//
+// returns the element at an iterator position, or NULL if there isn't one
+void *property_iterator_elem(PROPERTY_TABLE *table, int pos) {
+  int paged = table->num_pages * PROPERTY_PAGE_SIZE;
+  if(pos < paged) {
+    PROPERTY_PAGE *page = table->pages[pos >> PROPERTY_PAGE_SHIFT];
+    return (page ? page->elems[pos & PROPERTY_PAGE_MASK] : NULL);
+  }
+  void *elem = table->buckets[pos - paged].elem;
+  return (elem == PROPERTY_DELETED ? NULL : elem);
+}
+
+//
+// move the iterator up to the next position with an element in it, starting
+// with the position it's on now
+void property_iterator_skip(PROPERTY_TABLE_ITERATOR *I) {
+  PROPERTY_TABLE *table = I->table;
+  int             paged = table->num_pages * PROPERTY_PAGE_SIZE;
+  int               end = paged + table->num_buckets;
+  while(I->curr_bucket < end) {
+    // skip over missing pages all at once
+    if(I->curr_bucket < paged && 
+       table->pages[I->curr_bucket >> PROPERTY_PAGE_SHIFT] == NULL)
+      I->curr_bucket = (I->curr_bucket | PROPERTY_PAGE_MASK) + 1;
+    else if(property_iterator_elem(table, I->curr_bucket) == NULL)
+      I->curr_bucket++;
+    else
+      break;
+  }
+}
+
+//
+// the end of the table's iterator positions
+int property_iterator_end(PROPERTY_TABLE *table) {
+  return table->num_pages * PROPERTY_PAGE_SIZE + table->num_buckets;
+}
+
 PROPERTY_TABLE_ITERATOR *newPropertyTableIterator(PROPERTY_TABLE *T) {
   PROPERTY_TABLE_ITERATOR *I = malloc(sizeof(PROPERTY_TABLE_ITERATOR));
-
   I->table = T;
-  I->curr_bucket = 0;
-  I->bucket_i = NULL;
   propertyTableIteratorReset(I);
-
   return I;
 }
 
 
 void deletePropertyTableIterator(PROPERTY_TABLE_ITERATOR *I) {
-  if(I->bucket_i) deleteListIterator(I->bucket_i);
   free(I);
 }
 
 
 void propertyTableIteratorReset(PROPERTY_TABLE_ITERATOR *I) {
-  int i;
-
-  if(I->bucket_i) 
-    deleteListIterator(I->bucket_i);
-  I->bucket_i = NULL;
   I->curr_bucket = 0;
-
-  for(i = 0; i < I->table->num_buckets; i++) {
-    if(I->table->buckets[i] == NULL)
-      continue;
-    if(isListEmpty(I->table->buckets[i]))
-      continue;
-    else {
-      I->curr_bucket = i;
-      I->bucket_i = newListIterator(I->table->buckets[i]);
-      break;
-    }
-  }
+  property_iterator_skip(I);
 }
 
 
 void *propertyTableIteratorNext(PROPERTY_TABLE_ITERATOR *I) {
-  // we have no iterator ... we have no elements left to iterate over!
-  if(I->bucket_i == NULL)
-    return NULL;
-  else {
-    void *elem = listIteratorNext(I->bucket_i);
-    // we're okay ... we have an element
-    if(elem != NULL)
-      return elem;
-    // otherwise, we need to move onto a new bucket
-    else {
-      deleteListIterator(I->bucket_i);
-      I->bucket_i = NULL;
-
-      I->curr_bucket++;
-      // find the next non-empty list
-      for(; I->curr_bucket < I->table->num_buckets; I->curr_bucket++) {
-	if(I->table->buckets[I->curr_bucket] == NULL)
-	  continue;
-	if(isListEmpty(I->table->buckets[I->curr_bucket]))
-	  continue;
-	I->bucket_i = newListIterator(I->table->buckets[I->curr_bucket]);
-	break;
-      }
-
-      // we've ran out of buckets!
-      if(I->curr_bucket == I->table->num_buckets)
-	return NULL;
-      else
-	return listIteratorCurrent(I->bucket_i);
-    }
+  if(I->curr_bucket < property_iterator_end(I->table)) {
+    I->curr_bucket++;
+    property_iterator_skip(I);
   }
+  return propertyTableIteratorCurrent(I);
 }
 
 
 void *propertyTableIteratorCurrent(PROPERTY_TABLE_ITERATOR *I) {
-  // we have no elements!
-  if(I->bucket_i == NULL)
+  // the current element may have been removed since we last moved
+  property_iterator_skip(I);
+  if(I->curr_bucket >= property_iterator_end(I->table))
     return NULL;
-  /* we're at the end of a list ... gotta find the next element
-   * WAIT! We should never encounter this situation, because whenever
-   * we go to get the next element, we ensure that if we're at the end
-   * of a list, we go on to find the next list with elements.
-  else if(listIteratorCurrent(I->bucket_i) == NULL)
-    return propertyTableIteratorNext(I);
-  */
-  else
-    return listIteratorCurrent(I->bucket_i);
+  return property_iterator_elem(I->table, I->curr_bucket);
 }
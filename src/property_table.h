@@ -23,9 +23,11 @@ typedef struct property_table_iterator    PROPERTY_TABLE_ITERATOR;
 
 
 //
-// Create a new property table with the specified number of buckets
-// (more buckets = faster lookup, but more memory). The key function must
-// be a function that returns a positive integer (no upper bound)
+// Create a new property table. The key function must be a function that
+// returns a positive integer (no upper bound). Tables are laid out for keys
+// that are handed out in increasing order and never reused, like UIDs; the
+// number of buckets is no longer used, and is only kept for compatibility.
+// An element's key must not change while it is in the table
 //
 PROPERTY_TABLE *newPropertyTable(void *key_function, int buckets);
 
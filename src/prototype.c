@@ -17,6 +17,9 @@
 #include "world.h"
 #include "zone.h"
 #include "handler.h"
+#include "body.h"
+#include "pulse.h"
+#include "memstat.h"
 
 
 
@@ -25,6 +28,7 @@
 //*****************************************************************************
 #include "scripts/scripts.h"
 #include "scripts/pyplugs.h"
+#include "scripts/script_prof.h"
 #include "scripts/pychar.h"
 #include "scripts/pyroom.h"
 #include "scripts/pyobj.h"
@@ -37,32 +41,201 @@
 struct prototype_data {
   char       *key;
   char   *parents;
+  LIST *parent_keys; // our parents, resolved. Made when we're first run
   bool   abstract;
   BUFFER  *script;
   PyObject  *code;
+  LIST     *chain; // every prototype we run when we're run, parents first
+  int chain_generation; // what proto_generation was when we made our chain
+
+  // snapshot prototypes run their scripts once, and copy what came out of
+  // them every time after that
+  bool         snapshot;
+  OBJ_DATA    *obj_snap;
+  CHAR_DATA   *mob_snap;
+  int  snap_generation; // what proto_generation was when we took our snapshot
 };
 
+// goes up whenever any prototype is changed or deleted. Chains made before
+// then might not be right anymore, and have to be made over
+int proto_generation = 0;
+
+// how deeply prototypes can inherit from one another, to catch loops
+#define PROTO_MAX_DEPTH      32
+
+//
+// forget our resolved parents, for when our key or parents change
+void proto_clear_parent_keys(PROTO_DATA *data) {
+  if(data->parent_keys != NULL)
+    deleteList(data->parent_keys);
+  data->parent_keys = NULL;
+  proto_generation++;
+}
+
+//
+// resolve our parents' keys. Parents without a locale share ours. If any of
+// them can't be resolved (e.g. their zone doesn't exist yet), it is reported
+// and NULL is returned; we'll try again next time
+LIST *proto_get_parent_keys(PROTO_DATA *data, const char *type) {
+  if(data->parent_keys == NULL) {
+    LIST    *parents = parse_keywords(data->parents);
+    LIST       *keys = newList();
+    char *one_parent = NULL;
+    bool          ok = TRUE;
+    while((one_parent = listPop(parents)) != NULL) {
+      WORLD_KEY *wkey = worldResolveKey(gameworld,
+	  get_fullkey_relative(one_parent, get_key_locale(data->key)));
+      if(wkey == NULL && ok) {
+	log_string("ERROR: could not find parent %s for %s %s.", one_parent,
+		   type, protoGetKey(data));
+	ok = FALSE;
+      }
+      else if(wkey != NULL)
+	listQueue(keys, wkey);
+      free(one_parent);
+    }
+    deleteList(parents);
+    if(ok)
+      data->parent_keys = keys;
+    else
+      deleteList(keys);
+  }
+  return data->parent_keys;
+}
+
+//
+// add every prototype that runs when data is run to the chain, in the order
+// they run: each parent's chain, in order, and then data itself. Parents that
+// show up more than once run more than once, just like if each were walked
+// every time
+bool proto_build_chain(PROTO_DATA *data, const char *type, LIST *chain,
+		       int depth) {
+  LIST *parent_keys = proto_get_parent_keys(data, type);
+  if(parent_keys == NULL)
+    return FALSE;
+  if(depth >= PROTO_MAX_DEPTH) {
+    log_string("ERROR: %s %s inherits too deeply. Is there a loop?", type,
+	       protoGetKey(data));
+    return FALSE;
+  }
+
+  LIST_ITERATOR *key_i = newListIterator(parent_keys);
+  WORLD_KEY      *wkey = NULL;
+  bool              ok = TRUE;
+  ITERATE_LIST(wkey, key_i) {
+    PROTO_DATA *parent = worldGetTypeKey(gameworld, type, wkey);
+    if(parent == NULL) {
+      log_string("ERROR: could not find parent %s for %s %s.",
+		 worldKeyGetKey(wkey), type, protoGetKey(data));
+      ok = FALSE;
+    }
+    else
+      ok = proto_build_chain(parent, type, chain, depth + 1);
+    if(ok == FALSE)
+      break;
+  } deleteListIterator(key_i);
+
+  if(ok)
+    listQueue(chain, data);
+  return ok;
+}
+
+//
+// the chain of prototypes we run, made over if any prototype has changed
+// since we last made it. Returns NULL if one of our ancestors can't be found
+LIST *proto_get_chain(PROTO_DATA *data, const char *type) {
+  if(data->chain != NULL && data->chain_generation == proto_generation)
+    return data->chain;
+
+  if(data->chain != NULL)
+    deleteList(data->chain);
+  data->chain            = newList();
+  data->chain_generation = proto_generation;
+  // looking up our ancestors can load them, which changes the generation. So
+  // remember the generation from before we started
+  if(!proto_build_chain(data, type, data->chain, 0)) {
+    deleteList(data->chain);
+    data->chain = NULL;
+  }
+  return data->chain;
+}
+
+//
+// throw out our snapshot. The next spawn will make a new one
+void proto_clear_snapshot(PROTO_DATA *data) {
+  if(data->obj_snap != NULL)
+    deleteObj(data->obj_snap);
+  if(data->mob_snap != NULL)
+    deleteChar(data->mob_snap);
+  data->obj_snap = NULL;
+  data->mob_snap = NULL;
+}
+
+//
+// hold on to a code object for our script, or let go of the one we have.
+// Code objects are counted by the length of the script they came from
+void proto_set_code(PROTO_DATA *data, PyObject *code) {
+  if(data->code != NULL) {
+    memNote(MEM_PROTO_CODE, -1, -bufferLength(data->script));
+    Py_DECREF(data->code);
+  }
+  data->code = code;
+  if(code != NULL)
+    memNote(MEM_PROTO_CODE, 1, bufferLength(data->script));
+}
+
+//
+// copies don't get anything their original is carrying or wearing, so only
+// mobs with nothing on them can be snapshotted
+bool proto_can_snapshot_mob(CHAR_DATA *ch) {
+  if(listSize(charGetInventory(ch)) > 0)
+    return FALSE;
+  return (listSize(bodyGetEqList(charGetBody(ch))) == 0);
+}
+
+//
+// is our snapshot, if we have one, still good? It isn't if any prototype has
+// changed since it was taken; we, or one of our parents, might have been
+// edited
+bool proto_snapshot_ok(PROTO_DATA *data) {
+  if(!data->snapshot)
+    return FALSE;
+  if(data->snap_generation != proto_generation)
+    proto_clear_snapshot(data);
+  return (data->obj_snap != NULL || data->mob_snap != NULL);
+}
+
 
 
 //*****************************************************************************
 // implementation of prototype.h
 //*****************************************************************************
 PROTO_DATA *newProto(void) {
-  PROTO_DATA *data = malloc(sizeof(PROTO_DATA));
+  PROTO_DATA *data = memAlloc(MEM_PROTO, sizeof(PROTO_DATA));
   data->key      = strdup("");
   data->parents  = strdup("");
+  data->parent_keys = NULL;
   data->abstract = TRUE;
   data->script   = newBuffer(1);
   data->code     = NULL;
+  data->chain    = NULL;
+  data->chain_generation = 0;
+  data->snapshot = FALSE;
+  data->obj_snap = NULL;
+  data->mob_snap = NULL;
+  data->snap_generation = 0;
   return data;
 }
 
 void deleteProto(PROTO_DATA *data) {
+  proto_set_code(data, NULL);
   if(data->key)     free(data->key);
   if(data->parents) free(data->parents);
   if(data->script)  deleteBuffer(data->script);
-  Py_XDECREF(data->code);
-  free(data);
+  proto_clear_parent_keys(data);
+  if(data->chain)   deleteList(data->chain);
+  proto_clear_snapshot(data);
+  memFree(MEM_PROTO, data, sizeof(PROTO_DATA));
 }
 
 void protoCopyTo(PROTO_DATA *from, PROTO_DATA *to) {
@@ -70,9 +243,9 @@ void protoCopyTo(PROTO_DATA *from, PROTO_DATA *to) {
   protoSetParents(to,  protoGetParents(from));
   protoSetScript(to,   protoGetScript(from));
   protoSetAbstract(to, protoIsAbstract(from));
-  Py_XDECREF(to->code);
+  protoSetSnapshot(to, protoIsSnapshot(from));
   Py_XINCREF(from->code);
-  to->code = from->code;
+  proto_set_code(to, from->code);
 }
 
 PROTO_DATA *protoCopy(PROTO_DATA *data) {
@@ -85,6 +258,8 @@ STORAGE_SET   *protoStore(PROTO_DATA *data) {
   STORAGE_SET *set = new_storage_set();
   store_string(set, "parents",  data->parents);
   store_bool  (set, "abstract", data->abstract);
+  if(data->snapshot)
+    store_bool(set, "snapshot", data->snapshot);
   store_string(set, "script",   bufferString(data->script));
   return set;
 }
@@ -93,6 +268,7 @@ PROTO_DATA *protoRead(STORAGE_SET *set) {
   PROTO_DATA *data = newProto();
   protoSetParents(data,  read_string(set, "parents"));
   protoSetAbstract(data, read_bool  (set, "abstract"));
+  protoSetSnapshot(data, read_bool  (set, "snapshot"));
   protoSetScript(data,   read_string(set, "script"));
   return data;
 }
@@ -100,24 +276,31 @@ PROTO_DATA *protoRead(STORAGE_SET *set) {
 void protoSetKey(PROTO_DATA *data, const char *key) {
   if(data->key) free(data->key);
   data->key = strdupsafe(key);
+  proto_clear_parent_keys(data);
 }
 
 void  protoSetParents(PROTO_DATA *data, const char *parents) {
   if(data->parents) free(data->parents);
   data->parents = strdupsafe(parents);
+  proto_clear_parent_keys(data);
 }
 
 void   protoSetScript(PROTO_DATA *data, const char *script) {
+  proto_set_code(data, NULL);
   bufferClear(data->script);
   bufferCat(data->script, script);
-  Py_XDECREF(data->code);
-  data->code = NULL;
+  proto_generation++;
 }
 
 void protoSetAbstract(PROTO_DATA *data, bool abstract) {
   data->abstract = abstract;
 }
 
+void protoSetSnapshot(PROTO_DATA *data, bool snapshot) {
+  data->snapshot = snapshot;
+  proto_clear_snapshot(data);
+}
+
 const char *protoGetKey(PROTO_DATA *data) {
   return data->key;
 }
@@ -130,6 +313,10 @@ bool protoIsAbstract(PROTO_DATA *data) {
   return data->abstract;
 }
 
+bool protoIsSnapshot(PROTO_DATA *data) {
+  return data->snapshot;
+}
+
 const char   *protoGetScript(PROTO_DATA *data) {
   return bufferString(data->script);
 }
@@ -138,79 +325,99 @@ BUFFER *protoGetScriptBuffer(PROTO_DATA *data) {
   return data->script;
 }
 
-bool protoRunAs(PROTO_DATA *proto, const char *type, const char *as, 
-		void *pynewfunc, void *protoaddfunc, void *protoclassfunc, 
-		void *me) {
-  // parse and run all of our parents
-  LIST           *parents = parse_keywords(proto->parents);
-  LIST_ITERATOR *parent_i = newListIterator(parents);
-  char        *one_parent = NULL;
-  bool         parents_ok = TRUE;
-
-  // try to run each parent
-  ITERATE_LIST(one_parent, parent_i) {
-    PROTO_DATA *parent = NULL;
-    // does our parent have a locale? If so, find it. If not, use ours
-    int separator_pos = next_letter_in(one_parent, '@');
-    if(separator_pos == -1)
-      parent = worldGetType(gameworld, type, 
-			    get_fullkey(one_parent,get_key_locale(proto->key)));
-    else
-      parent = worldGetType(gameworld, type, one_parent);
+//
+// run a chain of prototypes on me, the last of them as something else. Every
+// prototype in the chain runs in a dictionary that starts out the same as
+// base. Rather than building dict from scratch for each, it is put back the
+// way base is between prototypes, and when we're done
+bool proto_run_chain(PROTO_DATA *proto, LIST *chain, const char *as, 
+		     void *pynewfunc, void *protoaddfunc, void *protoclassfunc, 
+		     void *me, PyObject *dict, PyObject *base) {
+  PyObject        *pyme = ((PyObject *(*)(void *))pynewfunc)(me);
+  LIST_ITERATOR *link_i = newListIterator(chain);
+  PROTO_DATA       *one = NULL;
+  bool               ok = TRUE;
+
+  ITERATE_LIST(one, link_i) {
+    // we're the last in our chain, and might be running as something else
+    const char *one_as = (one == proto ? as : protoGetKey(one));
+    if(protoaddfunc)
+      ((void (*)(void *, const char *))protoaddfunc)(me, protoGetKey(one));
+    if(protoclassfunc)
+      ((void (*)(void *, const char *))protoclassfunc)(me, one_as);
+
+    PyDict_SetItemString(dict, "me", pyme);
+
+    // do we have our own code already, or do we need to compile from source?
+    long long start = (scriptProfIsOn() ? pulse_clock() : 0);
+    if(one->code == NULL) {
+      proto_set_code(one, run_script_forcode(dict, bufferString(one->script),
+					     get_key_locale(one_as)));
+    }
+    // we already have a code object. Evaluate it.
+    else {
+      run_code(one->code, dict, get_key_locale(one_as));
     
-    if(parent == NULL) {
-      log_string("ERROR: could not find parent %s for %s %s.", one_parent,
-		 type, protoGetKey(proto));
-      parents_ok = FALSE;
+      if(!last_script_ok())
+	log_pyerr("Prototype %s terminated with an error:\r\n%s",
+		  one->key, bufferString(one->script));
     }
-    else if(!protoRun(parent, type, pynewfunc, protoaddfunc, protoclassfunc,me))
-      parents_ok = FALSE;
 
-    // if we had a problem running the proto, report it
-    if(parents_ok == FALSE)
-      break;
-  } deleteListIterator(parent_i);
+    if(start != 0)
+      scriptProfRecord("proto", protoGetKey(one), one_as,pulse_clock()-start);
 
-  // do garbage collection for our parent list
-  deleteListWith(parents, free);
+    // remove us from the dictionary just incase it doesn't GC immediately. It
+    // happens sometimes if we define a new method in the prototype
+    PyDict_DelItemString(dict, "me");
+    ok = last_script_ok();
+    PyDict_Clear(dict);
+    PyDict_Update(dict, base);
 
-  // did we encounter a problem w/ our parents?
-  if(parents_ok == FALSE)
-    return FALSE;
+    // if one of our ancestors failed, we don't go on
+    if(!ok)
+      break;
+  } deleteListIterator(link_i);
 
-  // now, do us
-  PyObject *dict = restricted_script_dict();
-  PyObject *pyme = ((PyObject *(*)(void *))pynewfunc)(me);
-  if(protoaddfunc)
-    ((void (*)(void *, const char *))protoaddfunc)(me, protoGetKey(proto));
-  if(protoclassfunc)
-    ((void (*)(void *, const char *))protoclassfunc)(me, as);
+  return ok;
+}
 
-  PyDict_SetItemString(dict, "me", pyme);
+//
+// where spawning things from a prototype keeps what it only needs once: the
+// prototype's chain, and the dictionary its scripts run in
+typedef struct {
+  LIST     *chain;
+  PyObject  *dict;
+  PyObject  *base;
+} PROTO_SPAWN;
 
-  // do we have our own code already, or do we need to compile from source?
-  if(proto->code == NULL) {
-    proto->code = run_script_forcode(dict, bufferString(proto->script), 
-				     get_key_locale(as));
-  }
-  // we already have a code object. Evaluate it.
-  else {
-    run_code(proto->code, dict, get_key_locale(as));
-    
-    if(!last_script_ok())
-      log_pyerr("Prototype %s terminated with an error:\r\n%s",
-		proto->key, bufferString(proto->script));
-  }
+//
+// get ready to spawn, if we haven't already. Returns FALSE if the prototype's
+// chain can't be made
+bool proto_spawn_start(PROTO_SPAWN *spawn, PROTO_DATA *proto, const char *type){
+  if(spawn->dict != NULL)
+    return TRUE;
+  if((spawn->chain = proto_get_chain(proto, type)) == NULL)
+    return FALSE;
+  spawn->dict = restricted_script_dict();
+  spawn->base = PyDict_Copy(spawn->dict);
+  return TRUE;
+}
 
-  // remove us from the dictionary just incase it doesn't GC immediately. It
-  // happens sometimes if we define a new method in the prototype
-  PyDict_DelItemString(dict, "me");
-  // PyDict_SetItemString(dict, "me", Py_None);
+void proto_spawn_end(PROTO_SPAWN *spawn) {
+  Py_XDECREF(spawn->base);
+  Py_XDECREF(spawn->dict);
+}
 
-  // garbage collection
-  Py_DECREF(dict);
-  // Py_DECREF(pyme);
-  return last_script_ok();
+bool protoRunAs(PROTO_DATA *proto, const char *type, const char *as, 
+		void *pynewfunc, void *protoaddfunc, void *protoclassfunc, 
+		void *me) {
+  PROTO_SPAWN spawn = { NULL, NULL, NULL };
+  bool           ok = (proto_spawn_start(&spawn, proto, type) &&
+		       proto_run_chain(proto, spawn.chain, as, pynewfunc,
+				       protoaddfunc, protoclassfunc, me,
+				       spawn.dict, spawn.base));
+  proto_spawn_end(&spawn);
+  return ok;
 }
 
 bool protoRun(PROTO_DATA *proto, const char *type, void *pynewfunc, 
@@ -219,35 +426,104 @@ bool protoRun(PROTO_DATA *proto, const char *type, void *pynewfunc,
   return protoRunAs(proto,type,as,pynewfunc,protoaddfunc,protoclassfunc,me);
 }
 
-CHAR_DATA *protoMobRun(PROTO_DATA *proto) {
+int protoMobRunBatch(PROTO_DATA *proto, int num, LIST *out) {
+  PROTO_SPAWN spawn = { NULL, NULL, NULL };
+  int         count = 0;
   if(protoIsAbstract(proto))
-    return NULL;
-  CHAR_DATA *ch = newMobile();
-  char_exist(ch);
-  if(protoRun(proto, "mproto", charGetPyFormBorrowed, charAddPrototype, charSetClass, ch))
+    return 0;
+
+  for(; count < num; count++) {
+    CHAR_DATA *ch = NULL;
+
+    // copy our snapshot if we have one. The copy gets a new UID of its own
+    if(proto_snapshot_ok(proto) && proto->mob_snap != NULL) {
+      ch = charCopy(proto->mob_snap);
+      charSetBirth(ch, current_time);
+      char_exist(ch);
+    }
+    else {
+      if(!proto_spawn_start(&spawn, proto, "mproto"))
+	break;
+      ch = newMobile();
+      char_exist(ch);
+      if(!proto_run_chain(proto, spawn.chain, protoGetKey(proto),
+			  charGetPyFormBorrowed, charAddPrototype,
+			  charSetClass, ch, spawn.dict, spawn.base)) {
+	// should this be char_unexist? Check to see what difference it makes
+	extract_mobile(ch);
+	break;
+      }
+
+      // take our snapshot before anything outside of our scripts gets at us
+      if(proto->snapshot && proto_can_snapshot_mob(ch)) {
+	proto->mob_snap        = charCopy(ch);
+	proto->snap_generation = proto_generation;
+      }
+    }
+
     char_to_game(ch);
-  else {
-    // should this be char_unexist? Check to see what difference it makes
-    extract_mobile(ch);
-    ch = NULL;
+    listQueue(out, ch);
   }
 
-  return ch;
+  proto_spawn_end(&spawn);
+  return count;
 }
 
-OBJ_DATA *protoObjRun(PROTO_DATA *proto) {
+int protoObjRunBatch(PROTO_DATA *proto, int num, LIST *out) {
+  PROTO_SPAWN spawn = { NULL, NULL, NULL };
+  int         count = 0;
   if(protoIsAbstract(proto))
-    return NULL;
-  OBJ_DATA *obj = newObj();
-  obj_exist(obj);
-  if(protoRun(proto, "oproto", objGetPyFormBorrowed, objAddPrototype, objSetClass, obj))
+    return 0;
+
+  for(; count < num; count++) {
+    OBJ_DATA *obj = NULL;
+
+    // copy our snapshot if we have one. The copy gets a new UID of its own
+    if(proto_snapshot_ok(proto) && proto->obj_snap != NULL) {
+      obj = objCopy(proto->obj_snap);
+      objSetBirth(obj, current_time);
+      obj_exist(obj);
+    }
+    else {
+      if(!proto_spawn_start(&spawn, proto, "oproto"))
+	break;
+      obj = newObj();
+      obj_exist(obj);
+      if(!proto_run_chain(proto, spawn.chain, protoGetKey(proto),
+			  objGetPyFormBorrowed, objAddPrototype,
+			  objSetClass, obj, spawn.dict, spawn.base)) {
+	// should this be obj_unexist? Check to see what difference it makes
+	extract_obj(obj);
+	break;
+      }
+
+      // take our snapshot before anything outside of our scripts gets at us.
+      // Copies don't get our contents, so we can't have any
+      if(proto->snapshot && listSize(objGetContents(obj)) == 0) {
+	proto->obj_snap        = objCopy(obj);
+	proto->snap_generation = proto_generation;
+      }
+    }
+
     obj_to_game(obj);
-  else {
-    // should this be obj_unexist? Check to see what difference it makes
-    extract_obj(obj);
-    obj = NULL;
+    listQueue(out, obj);
   }
 
+  proto_spawn_end(&spawn);
+  return count;
+}
+
+CHAR_DATA *protoMobRun(PROTO_DATA *proto) {
+  LIST    *out = newList();
+  CHAR_DATA *ch = (protoMobRunBatch(proto, 1, out) ? listPop(out) : NULL);
+  deleteList(out);
+  return ch;
+}
+
+OBJ_DATA *protoObjRun(PROTO_DATA *proto) {
+  LIST    *out = newList();
+  OBJ_DATA *obj = (protoObjRunBatch(proto, 1, out) ? listPop(out) : NULL);
+  deleteList(out);
   return obj;
 }
 
@@ -256,8 +532,10 @@ ROOM_DATA *protoRoomRun(PROTO_DATA *proto) {
     return NULL;
   ROOM_DATA *room = newRoom();
   room_exist(room);
-  if(protoRun(proto, "rproto", roomGetPyFormBorrowed, roomAddPrototype,roomSetClass,room))
+  if(protoRun(proto, "rproto", roomGetPyFormBorrowed, roomAddPrototype,roomSetClass,room)) {
     room_to_game(room);
+    roomShareCmds(room);
+  }
   else {
     // should this be room_unexist? Check to see what difference it makes
     extract_room(room);
@@ -276,6 +554,7 @@ ROOM_DATA *protoRoomInstance(PROTO_DATA *proto, const char *as) {
 	      roomSetClass, room)) {
     roomSetClass(room, as);
     room_to_game(room);
+    roomShareCmds(room);
   }
   else {
     // should this be room_unexist? Check to see what difference it makes
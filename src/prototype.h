@@ -23,6 +23,15 @@ OBJ_DATA   *protoObjRun(PROTO_DATA *proto);
 ROOM_DATA *protoRoomRun(PROTO_DATA *proto);
 ROOM_DATA *protoRoomInstance(PROTO_DATA *proto, const char *as);
 
+//
+// spawn num mobs or objects from a prototype at once, and queue them up in
+// out. Finding the prototype's parents and setting up the dictionary its
+// scripts run in is only done once for all of them. Each one is put into the
+// game (and the usual hooks run) like protoMobRun and protoObjRun do. If a
+// script fails, we stop there. Returns how many were spawned
+int    protoMobRunBatch(PROTO_DATA *proto, int num, LIST *out);
+int    protoObjRunBatch(PROTO_DATA *proto, int num, LIST *out);
+
 //
 // setters
 void      protoSetKey(PROTO_DATA *data, const char *key);
@@ -30,12 +39,21 @@ void  protoSetParents(PROTO_DATA *data, const char *parents);
 void   protoSetScript(PROTO_DATA *data, const char *script);
 void protoSetAbstract(PROTO_DATA *data, bool abstract);
 
+//
+// a prototype marked as a snapshot runs its scripts (and its parents') the
+// first time it is spawned, and every spawn after that is a copy of what came
+// out of them, with a UID of its own. Only mark prototypes whose scripts do
+// the same thing every time, and don't load anything else. The snapshot is
+// thrown out whenever any prototype is changed. Rooms are never snapshotted
+void protoSetSnapshot(PROTO_DATA *data, bool snapshot);
+
 //
 // getters
 const char      *protoGetKey(PROTO_DATA *data);
 const char  *protoGetParents(PROTO_DATA *data);
 const char   *protoGetScript(PROTO_DATA *data);
 bool         protoIsAbstract(PROTO_DATA *data);
+bool         protoIsSnapshot(PROTO_DATA *data);
 BUFFER *protoGetScriptBuffer(PROTO_DATA *data);
 
 #endif // PROTOTYPE_H
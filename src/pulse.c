@@ -0,0 +1,199 @@
+//*****************************************************************************
+//
+// pulse.c
+//
+// keeps track of how long each pulse of the game loop takes, and how that
+// time splits up between its phases. See pulse.h for more information.
+//
+//*****************************************************************************
+
+#include <time.h>
+#include <sys/time.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "pulse.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+typedef struct {
+  long long count;                     // how many times has the phase run?
+  long long total;                     // how long has it run all together?
+  long long max;                       // the longest it's ever taken
+  long long last;                      // how long it took most recently
+  long long buckets[NUM_PULSE_BUCKETS];// durations, histogram-style
+} PULSE_PHASE_STATS;
+
+PULSE_PHASE_STATS pulse_stats[NUM_PULSE_PHASES];
+long long        pulse_catchups = 0; // how many catch-up pulses have we run?
+long long         pulse_dropped = 0; // how many pulses did we never run?
+
+const char *pulse_phase_names[NUM_PULSE_PHASES] = {
+  "input",
+  "update",
+  "output",
+  "total",
+};
+
+// the upper bounds of our histogram buckets, in microseconds. The last
+// bucket has no upper bound
+const long long pulse_bucket_bounds[NUM_PULSE_BUCKETS] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, -1
+};
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// display our pulse timings. Supplying "reset" clears our statistics
+//   usage: pulsestats [reset]
+COMMAND(cmd_pulsestats) {
+  if(*arg && !strcasecmp(arg, "reset")) {
+    pulseResetStats();
+    send_to_char(ch, "Pulse statistics reset.\r\n");
+    return;
+  }
+
+  BUFFER *buf = newBuffer(MAX_BUFFER);
+  int phase, bucket;
+  bprintf(buf, "Pulse budget: %d usec (%d pulses per second). "
+	  "Catch-up pulses: %lld. Dropped pulses: %lld.\r\n\r\n",
+	  1000000 / PULSES_PER_SECOND, PULSES_PER_SECOND, 
+	  pulse_catchups, pulse_dropped);
+  bprintf(buf, "{c%-8s %10s %10s %10s %10s{n\r\n", 
+	  "Phase", "Count", "Avg usec", "Max usec", "Last usec");
+  for(phase = 0; phase < NUM_PULSE_PHASES; phase++) {
+    PULSE_PHASE_STATS *stats = &pulse_stats[phase];
+    bprintf(buf, "%-8s %10lld %10lld %10lld %10lld\r\n",
+	    pulse_phase_names[phase], stats->count, 
+	    (stats->count > 0 ? stats->total / stats->count : 0),
+	    stats->max, stats->last);
+  }
+
+  // the histogram, one column per phase
+  bprintf(buf, "\r\n{c%-12s", "usec");
+  for(phase = 0; phase < NUM_PULSE_PHASES; phase++)
+    bprintf(buf, " %10s", pulse_phase_names[phase]);
+  bprintf(buf, "{n\r\n");
+  for(bucket = 0; bucket < NUM_PULSE_BUCKETS; bucket++) {
+    if(pulse_bucket_bounds[bucket] < 0)
+      bprintf(buf, ">= %-9lld", pulse_bucket_bounds[bucket - 1]);
+    else
+      bprintf(buf, "<  %-9lld", pulse_bucket_bounds[bucket]);
+    for(phase = 0; phase < NUM_PULSE_PHASES; phase++)
+      bprintf(buf, " %10lld", pulse_stats[phase].buckets[bucket]);
+    bprintf(buf, "\r\n");
+  }
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    text_to_char(ch, bufferString(buf));
+  deleteBuffer(buf);
+}
+
+
+
+//*****************************************************************************
+// implementation of pulse.h
+//*****************************************************************************
+void init_pulse_timing(void) {
+  pulseResetStats();
+  add_cmd("pulsestats", NULL, cmd_pulsestats, "admin", FALSE);
+}
+
+long long pulse_clock(void) {
+#ifdef CLOCK_MONOTONIC
+  struct timespec now;
+  if(clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+    return (long long)now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+#endif
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (long long)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+void pulseRecordPhase(int phase, long long usecs) {
+  if(phase < 0 || phase >= NUM_PULSE_PHASES)
+    return;
+  PULSE_PHASE_STATS *stats = &pulse_stats[phase];
+  int bucket = 0;
+  if(usecs < 0)
+    usecs = 0;
+  stats->count++;
+  stats->total += usecs;
+  stats->last   = usecs;
+  if(usecs > stats->max)
+    stats->max = usecs;
+  while(bucket < NUM_PULSE_BUCKETS - 1 && usecs >= pulse_bucket_bounds[bucket])
+    bucket++;
+  stats->buckets[bucket]++;
+}
+
+void pulseRecordCatchup(int pulses) {
+  pulse_catchups += pulses;
+}
+
+void pulseRecordDropped(int pulses) {
+  pulse_dropped += pulses;
+}
+
+const char *pulsePhaseGetName(int phase) {
+  if(phase < 0 || phase >= NUM_PULSE_PHASES)
+    return "";
+  return pulse_phase_names[phase];
+}
+
+long long pulsePhaseGetCount(int phase) {
+  return (phase >= 0 && phase < NUM_PULSE_PHASES ? 
+	  pulse_stats[phase].count : 0);
+}
+
+long long pulsePhaseGetTotal(int phase) {
+  return (phase >= 0 && phase < NUM_PULSE_PHASES ? 
+	  pulse_stats[phase].total : 0);
+}
+
+long long pulsePhaseGetMax(int phase) {
+  return (phase >= 0 && phase < NUM_PULSE_PHASES ? 
+	  pulse_stats[phase].max : 0);
+}
+
+long long pulsePhaseGetLast(int phase) {
+  return (phase >= 0 && phase < NUM_PULSE_PHASES ? 
+	  pulse_stats[phase].last : 0);
+}
+
+long long pulsePhaseGetBucket(int phase, int bucket) {
+  if(phase < 0 || phase >= NUM_PULSE_PHASES || 
+     bucket < 0 || bucket >= NUM_PULSE_BUCKETS)
+    return 0;
+  return pulse_stats[phase].buckets[bucket];
+}
+
+long long pulseBucketGetBound(int bucket) {
+  if(bucket < 0 || bucket >= NUM_PULSE_BUCKETS)
+    return -1;
+  return pulse_bucket_bounds[bucket];
+}
+
+long long pulseGetCatchupCount(void) {
+  return pulse_catchups;
+}
+
+long long pulseGetDroppedCount(void) {
+  return pulse_dropped;
+}
+
+void pulseResetStats(void) {
+  memset(pulse_stats, 0, sizeof(pulse_stats));
+  pulse_catchups = 0;
+  pulse_dropped  = 0;
+}
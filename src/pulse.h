@@ -0,0 +1,63 @@
+#ifndef __PULSE_H
+#define __PULSE_H
+//*****************************************************************************
+//
+// pulse.h
+//
+// keeps track of how long each pulse of the game loop takes, and how that
+// time splits up between its phases (reading input, updating the world, and
+// sending output). Each phase gets a histogram of its durations, so we can
+// see where our frame budget goes. The game loop also reports here whenever
+// it has to run catch-up pulses after lagging, or gives up on catching up.
+// Admins can view these timings with the pulsestats command.
+//
+//*****************************************************************************
+
+// the phases of a pulse we keep timings for
+#define PULSE_PHASE_INPUT        0
+#define PULSE_PHASE_UPDATE       1
+#define PULSE_PHASE_OUTPUT       2
+#define PULSE_PHASE_TOTAL        3
+#define NUM_PULSE_PHASES         4
+
+// how many buckets our histograms have. Each bucket holds the number of
+// durations that were less than its upper bound, and at least the previous
+// bucket's. The last bucket holds everything past the one before it
+#define NUM_PULSE_BUCKETS       12
+
+//
+// prepare pulse timing for use
+void init_pulse_timing(void);
+
+//
+// return a monotonic timestamp, in microseconds. Good for measuring
+// durations, not for telling the time of day
+long long pulse_clock(void);
+
+//
+// record how long a phase of the current pulse took, in microseconds
+void pulseRecordPhase(int phase, long long usecs);
+
+//
+// note that we ran catch-up pulses, or had to drop pulses because we were
+// too far behind to catch up
+void pulseRecordCatchup(int pulses);
+void pulseRecordDropped(int pulses);
+
+//
+// accessors for our statistics. Durations are in microseconds
+const char *pulsePhaseGetName   (int phase);
+long long   pulsePhaseGetCount  (int phase);
+long long   pulsePhaseGetTotal  (int phase);
+long long   pulsePhaseGetMax    (int phase);
+long long   pulsePhaseGetLast   (int phase);
+long long   pulsePhaseGetBucket (int phase, int bucket);
+long long   pulseBucketGetBound (int bucket);
+long long   pulseGetCatchupCount(void);
+long long   pulseGetDroppedCount(void);
+
+//
+// forget all the statistics we've gathered so far
+void pulseResetStats(void);
+
+#endif // __PULSE_H
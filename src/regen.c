@@ -0,0 +1,244 @@
+//*****************************************************************************
+//
+// regen.c
+//
+// ticking the pools that fill back up over time. See regen.h. Regenerators
+// that have a pool below max, an owner, and aren't paused are kept in one
+// list, and each keeps the node it is on so it can be taken back off
+// without searching for it. The tick only goes over that list.
+//
+//*****************************************************************************
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "socket.h"
+#include "event.h"
+#include "hooks.h"
+#include "gmcp.h"
+#include "regen.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the fractions of max that running the regen_threshold hook is done at
+#define REGEN_NUM_THRESHOLDS 4
+const double regen_thresholds[REGEN_NUM_THRESHOLDS] = { 0.25, 0.5, 0.75, 1.0 };
+
+struct regen_data {
+  REGEN_POOL pools[REGEN_MAX_POOLS];
+  char      *names[REGEN_MAX_POOLS];
+  int    num_pools;
+  char    *package; // the GMCP package the pools are sent with, or NULL
+  int        owner; // the UID of who we belong to
+  bool      paused;
+  LIST_NODE  *node; // where we are in regen_active, or NULL
+};
+
+// a pool that crossed one of the thresholds on a tick
+typedef struct {
+  int          uid;
+  char pool[SMALL_BUFFER];
+  double        at;
+} REGEN_CROSSING;
+
+// the regenerators that need ticking
+LIST *regen_active = NULL;
+
+// the tick event belongs to this
+int regen_owner = 0;
+
+// what pools gain is multiplied by, for each position
+double regen_pos_mods[NUM_POSITIONS];
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// does the regenerator have a pool that isn't full yet?
+bool regen_needs_tick(REGEN_DATA *regen) {
+  int i;
+  if(regen->paused || regen->owner == NOBODY)
+    return FALSE;
+  for(i = 0; i < regen->num_pools; i++)
+    if(regen->pools[i].cur < regen->pools[i].max &&
+       regen->pools[i].rate > 0)
+      return TRUE;
+  return FALSE;
+}
+
+void regen_deactivate(REGEN_DATA *regen) {
+  if(regen->node != NULL) {
+    listRemoveNode(regen_active, regen->node);
+    regen->node = NULL;
+  }
+}
+
+//
+// set a pool's values as fields of the regenerator's GMCP package
+void regen_send_gmcp(REGEN_DATA *regen, SOCKET_DATA *sock, int pool) {
+  char field[SMALL_BUFFER], json[SMALL_BUFFER];
+  snprintf(field, sizeof(field), "%s", regen->names[pool]);
+  snprintf(json,  sizeof(json),  "%d", (int)regen->pools[pool].cur);
+  gmcpSetField(sock, regen->package, field, json);
+  snprintf(field, sizeof(field), "max%s", regen->names[pool]);
+  snprintf(json,  sizeof(json),  "%d", (int)regen->pools[pool].max);
+  gmcpSetField(sock, regen->package, field, json);
+}
+
+//
+// fill up each of a regenerator's pools, and note which quarters of the way
+// to max they crossed, to run regen_threshold for once the tick is done
+void regen_tick_one(REGEN_DATA *regen, CHAR_DATA *ch, LIST *crossed) {
+  int         pos = charGetPos(ch);
+  double      mod = (pos >= 0 && pos < NUM_POSITIONS ? regen_pos_mods[pos]:1.0);
+  SOCKET_DATA *sock = charGetSocket(ch);
+  int i, j;
+
+  if(sock != NULL && (regen->package == NULL || !socketGMCPEnabled(sock)))
+    sock = NULL;
+
+  for(i = 0; i < regen->num_pools; i++) {
+    REGEN_POOL *pool = &regen->pools[i];
+    if(pool->cur >= pool->max || pool->rate <= 0 || mod <= 0)
+      continue;
+    double old = pool->cur;
+    pool->cur  = MIN(pool->max, pool->cur + pool->rate * mod);
+    if(sock != NULL && (int)old != (int)pool->cur)
+      regen_send_gmcp(regen, sock, i);
+    for(j = 0; j < REGEN_NUM_THRESHOLDS; j++) {
+      double at = pool->max * regen_thresholds[j];
+      if(old < at && pool->cur >= at) {
+	REGEN_CROSSING *cross = malloc(sizeof(REGEN_CROSSING));
+	cross->uid = regen->owner;
+	cross->at  = regen_thresholds[j];
+	snprintf(cross->pool, sizeof(cross->pool), "%s", regen->names[i]);
+	listQueue(crossed, cross);
+      }
+    }
+  }
+}
+
+//
+// tick everyone that needs it. Anyone that's full, or whose owner has left
+// the game, comes off the list until they are changed again. No scripts run
+// until everyone has been ticked, since they could change the list under us
+void regen_tick(void *owner, void *data, const char *arg) {
+  LIST            *done = newList();
+  LIST         *crossed = newList();
+  LIST_ITERATOR *regen_i = newListIterator(regen_active);
+  REGEN_DATA      *regen = NULL;
+  REGEN_CROSSING  *cross = NULL;
+
+  ITERATE_LIST(regen, regen_i) {
+    CHAR_DATA *ch = propertyTableGet(mob_table, regen->owner);
+    if(ch != NULL)
+      regen_tick_one(regen, ch, crossed);
+    if(ch == NULL || !regen_needs_tick(regen))
+      listQueue(done, regen);
+  } deleteListIterator(regen_i);
+
+  while((regen = listPop(done)) != NULL)
+    regen_deactivate(regen);
+  deleteList(done);
+
+  while((cross = listPop(crossed)) != NULL) {
+    CHAR_DATA *ch = propertyTableGet(mob_table, cross->uid);
+    if(ch != NULL)
+      hookRunArgs("regen_threshold", "ch str dbl", ch, cross->pool, cross->at);
+    free(cross);
+  }
+  deleteList(crossed);
+}
+
+
+
+//*****************************************************************************
+// implementation of regen.h
+//*****************************************************************************
+void init_regen(void) {
+  int i;
+  regen_active = newList();
+  for(i = 0; i < NUM_POSITIONS; i++)
+    regen_pos_mods[i] = 1.0;
+  start_update(&regen_owner, MAX(1, mudsettingGetInt("regen_seconds")) SECOND,
+	       regen_tick, NULL, NULL, NULL);
+}
+
+REGEN_DATA *newRegen(int num_pools, const char **names, const char *package) {
+  REGEN_DATA *regen = calloc(1, sizeof(REGEN_DATA));
+  int i;
+  regen->num_pools = MAX(0, MIN(REGEN_MAX_POOLS, num_pools));
+  regen->package   = (package ? strdup(package) : NULL);
+  regen->owner     = NOBODY;
+  for(i = 0; i < regen->num_pools; i++) {
+    regen->names[i]     = strdup(names[i]);
+    regen->pools[i].cur = regen->pools[i].max = 100;
+  }
+  return regen;
+}
+
+void deleteRegen(REGEN_DATA *regen) {
+  int i;
+  regen_deactivate(regen);
+  for(i = 0; i < regen->num_pools; i++)
+    free(regen->names[i]);
+  if(regen->package) free(regen->package);
+  free(regen);
+}
+
+int regenGetNumPools(REGEN_DATA *regen) {
+  return regen->num_pools;
+}
+
+const char *regenGetPoolName(REGEN_DATA *regen, int pool) {
+  return regen->names[pool];
+}
+
+REGEN_POOL *regenGetPool(REGEN_DATA *regen, int pool) {
+  return &regen->pools[pool];
+}
+
+void regenChanged(REGEN_DATA *regen) {
+  if(regen->node == NULL && regen_needs_tick(regen))
+    regen->node = listQueueNode(regen_active, regen);
+  else if(regen->node != NULL && !regen_needs_tick(regen))
+    regen_deactivate(regen);
+}
+
+void regenSetOwner(REGEN_DATA *regen, int uid) {
+  regen->owner = uid;
+  regenChanged(regen);
+}
+
+int regenGetOwner(REGEN_DATA *regen) {
+  return regen->owner;
+}
+
+void regenSetPaused(REGEN_DATA *regen, bool paused) {
+  regen->paused = paused;
+  regenChanged(regen);
+}
+
+bool regenIsPaused(REGEN_DATA *regen) {
+  return regen->paused;
+}
+
+void regenSetPositionMod(int pos, double mod) {
+  if(pos >= 0 && pos < NUM_POSITIONS)
+    regen_pos_mods[pos] = mod;
+}
+
+double regenGetPositionMod(int pos) {
+  return (pos >= 0 && pos < NUM_POSITIONS ? regen_pos_mods[pos] : 1.0);
+}
+
+int count_regens(void) {
+  return listSize(regen_active);
+}
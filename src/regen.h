@@ -0,0 +1,72 @@
+#ifndef __REGEN_H
+#define __REGEN_H
+//*****************************************************************************
+//
+// regen.h
+//
+// pools (health, spell points, energy, and the like) that fill back up over
+// time. A regenerator holds a character's pools, each with its current and
+// max value and how much it gains a tick, and is ticked every regen_seconds
+// seconds, for as long as one of its pools is below max. Full, paused, and
+// unowned regenerators aren't looked at until they are changed, so the tick
+// costs nothing for the characters that don't need it. What a pool gains is
+// its rate times the multiplier for its owner's position.
+//
+// Scripts are not run on each tick. When a pool crosses a quarter of its way
+// to max, the regen_threshold hook is run with the owner, the pool's name,
+// and the fraction it crossed (0.25, 0.5, 0.75, or 1.0). If the regenerator
+// has a GMCP package, its pools are also sent as fields of it, as <name> and
+// max<name>.
+//
+//*****************************************************************************
+
+// the most pools one regenerator can have
+#define REGEN_MAX_POOLS     4
+
+typedef struct regen_data REGEN_DATA;
+
+typedef struct {
+  double  cur;
+  double  max;
+  double rate; // how much it gains a tick, before the position multiplier
+} REGEN_POOL;
+
+//
+// start ticking the regenerators that need it
+void init_regen(void);
+
+//
+// make a regenerator with the given pool names, each full at 100, and gaining
+// nothing. package is the GMCP package they are sent as fields of, or NULL
+REGEN_DATA *newRegen(int num_pools, const char **names, const char *package);
+void     deleteRegen(REGEN_DATA *regen);
+
+//
+// the values of one pool, which can be read and changed in place. Call
+// regenChanged after changing them, so it can start ticking if it has to
+int         regenGetNumPools(REGEN_DATA *regen);
+const char *regenGetPoolName(REGEN_DATA *regen, int pool);
+REGEN_POOL *regenGetPool    (REGEN_DATA *regen, int pool);
+void        regenChanged    (REGEN_DATA *regen);
+
+//
+// the character a regenerator belongs to, by UID, or NOBODY. Regenerators
+// only tick while their owner is in the game
+void regenSetOwner(REGEN_DATA *regen, int uid);
+int  regenGetOwner(REGEN_DATA *regen);
+
+//
+// paused regenerators (e.g. for the dead) don't tick
+void regenSetPaused(REGEN_DATA *regen, bool paused);
+bool regenIsPaused (REGEN_DATA *regen);
+
+//
+// what pools gain is multiplied by this while their owner is in a position
+void   regenSetPositionMod(int pos, double mod);
+double regenGetPositionMod(int pos);
+
+//
+// how many regenerators are waiting on a tick
+int count_regens(void);
+
+#endif // __REGEN_H
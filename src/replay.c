@@ -0,0 +1,430 @@
+//*****************************************************************************
+//
+// replay.c
+//
+// recording the input that comes into the mud, and playing it back. See
+// replay.h for how it is used. A recording is plain text, one thing that
+// happened per line, each with the pulse it happened on:
+//
+//   seed <n>                     what srand was given
+//   pulses_per_second <n>        how fast the game loop was running
+//   time <pulse> <time>          current_time changed
+//   connect <pulse> <id>         a connection was accepted
+//   input <pulse> <id> <line>    a line of input was taken in
+//   close <pulse> <id>           a connection was closed
+//   catchup <pulse> <n>          n catch-up pulses were run after the pulse
+//   end <pulse>                  the recording stopped
+//
+// Replayed connections are one end of a socketpair, so the mud reads their
+// input and writes their output exactly as it would for a real connection.
+//
+//*****************************************************************************
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "socket.h"
+#include "hooks.h"
+#include "pulse.h"
+#include "replay.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how many of the slowest pulses the report lists
+#define REPLAY_SLOWEST        10
+
+typedef enum {
+  REPLAY_TIME,
+  REPLAY_CONNECT,
+  REPLAY_INPUT,
+  REPLAY_CLOSE,
+  REPLAY_CATCHUP,
+} REPLAY_TYPE;
+
+typedef struct {
+  REPLAY_TYPE     type;
+  int            pulse;
+  int               id; // the connection, for connect, input, and close
+  long long        val; // the time, or how many catch-up pulses
+  char           *line; // the input, for input
+} REPLAY_EVENT;
+
+// a connection we're replaying input for
+typedef struct {
+  int              uid; // the socket the mud made for it
+  int             peer; // our end of its socketpair
+} REPLAY_PEER;
+
+// what we're recording to, and the pulse we're on
+FILE        *record_fl = NULL;
+int       record_pulse = 0;
+time_t     record_time = 0;
+
+// what we're replaying, and how far into it we are
+REPLAY_EVENT *replay_events = NULL;
+int        replay_num_events = 0;
+int             replay_next = 0; // the next event replayFeed looks at
+int      replay_finish_next = 0; // the next event replayFinish looks at
+int           replay_pulses = 0;
+unsigned int    replay_seed = 0;
+int              replay_pps = 0;
+char     *replay_fname = NULL;
+HASHTABLE *replay_peers = NULL;
+
+// how long each replayed pulse took, and how much output it sent out
+long long *replay_usecs = NULL;
+long long replay_output = 0;
+long long replay_wall_start = 0;
+long long  replay_cpu_start = 0;
+int     replay_catchups = 0;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// flush the recording every heartbeat, so a crash loses at most a few seconds
+void replay_flush_heartbeat(const char *info) {
+  if(record_fl != NULL)
+    fflush(record_fl);
+}
+
+//
+// the recording stops when the mud shuts down
+void replay_shutdown(const char *info) {
+  replayRecordStop();
+}
+
+//
+// add an event to the replay
+REPLAY_EVENT *replay_add_event(REPLAY_TYPE type, int pulse) {
+  static int size = 0;
+  if(replay_num_events == size) {
+    size = MAX(1024, size * 2);
+    replay_events = realloc(replay_events, sizeof(REPLAY_EVENT) * size);
+  }
+  REPLAY_EVENT *event = &replay_events[replay_num_events++];
+  event->type  = type;
+  event->pulse = pulse;
+  event->id    = 0;
+  event->val   = 0;
+  event->line  = NULL;
+  replay_pulses = MAX(replay_pulses, pulse);
+  return event;
+}
+
+//
+// find the connection a recorded id is being replayed as
+REPLAY_PEER *replay_get_peer(int id) {
+  char key[SMALL_BUFFER];
+  snprintf(key, sizeof(key), "%d", id);
+  return hashGet(replay_peers, key);
+}
+
+//
+// open a new fake connection for a recorded one
+void replay_connect(int id) {
+  int fds[2], argp = 1;
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    perror("replay: socketpair");
+    return;
+  }
+
+  SOCKET_DATA *sock = new_socket(fds[0], 0);
+  if(sock == NULL) {
+    close(fds[1]);
+    return;
+  }
+  ioctl(fds[1], FIONBIO, &argp);
+  hookRunArgs("receive_connection", "sk", sock);
+  socketBustPrompt(sock);
+
+  char key[SMALL_BUFFER];
+  REPLAY_PEER *peer = malloc(sizeof(REPLAY_PEER));
+  peer->uid  = socketGetUID(sock);
+  peer->peer = fds[1];
+  snprintf(key, sizeof(key), "%d", id);
+  hashPut(replay_peers, key, peer);
+}
+
+//
+// read (and forget) everything the mud has sent to our end of a connection
+void replay_drain(REPLAY_PEER *peer) {
+  char buf[MAX_BUFFER];
+  int  got;
+  while((got = read(peer->peer, buf, sizeof(buf))) > 0)
+    replay_output += got;
+}
+
+//
+// the recorded connection went away. If the mud still has it open (it
+// wasn't closed by something that was replayed, like quit), close it
+void replay_close(int id) {
+  char key[SMALL_BUFFER];
+  snprintf(key, sizeof(key), "%d", id);
+  REPLAY_PEER *peer = hashRemove(replay_peers, key);
+  if(peer == NULL)
+    return;
+  SOCKET_DATA *sock = propertyTableGet(sock_table, peer->uid);
+  if(sock != NULL && !socketIsClosed(sock))
+    close_socket(sock, FALSE);
+  replay_drain(peer);
+  close(peer->peer);
+  free(peer);
+}
+
+//
+// used for sorting pulse durations
+int replay_cmp_usecs(const void *a, const void *b) {
+  long long x = *(const long long *)a, y = *(const long long *)b;
+  return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+//
+// microseconds of CPU time the process has used
+long long replay_cpu_usecs(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL +
+    usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+
+
+//*****************************************************************************
+// implementation of replay.h
+//*****************************************************************************
+bool replayRecordStart(const char *fname, unsigned int seed) {
+  if((record_fl = fopen(fname, "w")) == NULL)
+    return FALSE;
+  fprintf(record_fl, "# NakedMud input recording of %s\n", MUDLIB_PATH);
+  fprintf(record_fl, "seed %u\n", seed);
+  fprintf(record_fl, "pulses_per_second %d\n", PULSES_PER_SECOND);
+  record_pulse = 0;
+  record_time  = 0;
+  hookAdd("heartbeat", replay_flush_heartbeat);
+  hookAdd("shutdown",  replay_shutdown);
+  return TRUE;
+}
+
+void replayRecordStop(void) {
+  if(record_fl == NULL)
+    return;
+  fprintf(record_fl, "end %d\n", record_pulse);
+  fclose(record_fl);
+  record_fl = NULL;
+}
+
+void replayPulseBegin(void) {
+  if(record_fl == NULL)
+    return;
+  record_pulse++;
+  if(current_time != record_time) {
+    record_time = current_time;
+    fprintf(record_fl, "time %d %ld\n", record_pulse, (long)current_time);
+  }
+}
+
+void replayRecordConnect(SOCKET_DATA *sock) {
+  if(record_fl != NULL)
+    fprintf(record_fl, "connect %d %d\n", record_pulse, socketGetUID(sock));
+}
+
+void replayRecordInput(SOCKET_DATA *sock, const char *line) {
+  if(record_fl != NULL)
+    fprintf(record_fl, "input %d %d %s\n", record_pulse, socketGetUID(sock),
+	    line);
+}
+
+void replayRecordClose(SOCKET_DATA *sock) {
+  if(record_fl != NULL)
+    fprintf(record_fl, "close %d %d\n", record_pulse, socketGetUID(sock));
+}
+
+void replayRecordCatchup(int pulses) {
+  if(record_fl != NULL && pulses > 0)
+    fprintf(record_fl, "catchup %d %d\n", record_pulse, pulses);
+}
+
+bool replayLoad(const char *fname) {
+  FILE *fl = fopen(fname, "r");
+  if(fl == NULL)
+    return FALSE;
+
+  char    line[MAX_INPUT_LEN + SMALL_BUFFER], type[SMALL_BUFFER];
+  int    pulse, id, used;
+  long long val;
+  while(fgets(line, sizeof(line), fl) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if(*line == '#' || sscanf(line, "%31s", type) != 1)
+      continue;
+    else if(!strcmp(type, "seed"))
+      sscanf(line, "seed %u", &replay_seed);
+    else if(!strcmp(type, "pulses_per_second"))
+      sscanf(line, "pulses_per_second %d", &replay_pps);
+    else if(!strcmp(type, "time") &&
+	    sscanf(line, "time %d %lld", &pulse, &val) == 2)
+      replay_add_event(REPLAY_TIME, pulse)->val = val;
+    else if(!strcmp(type, "connect") &&
+	    sscanf(line, "connect %d %d", &pulse, &id) == 2)
+      replay_add_event(REPLAY_CONNECT, pulse)->id = id;
+    else if(!strcmp(type, "close") &&
+	    sscanf(line, "close %d %d", &pulse, &id) == 2)
+      replay_add_event(REPLAY_CLOSE, pulse)->id = id;
+    else if(!strcmp(type, "catchup") &&
+	    sscanf(line, "catchup %d %lld", &pulse, &val) == 2)
+      replay_add_event(REPLAY_CATCHUP, pulse)->val = val;
+    else if(!strcmp(type, "end") && sscanf(line, "end %d", &pulse) == 1)
+      replay_pulses = MAX(replay_pulses, pulse);
+    else if(!strcmp(type, "input") &&
+	    sscanf(line, "input %d %d %n", &pulse, &id, &used) == 2) {
+      REPLAY_EVENT *event = replay_add_event(REPLAY_INPUT, pulse);
+      event->id   = id;
+      event->line = strdup(line + used);
+    }
+  }
+  fclose(fl);
+
+  replay_fname      = strdup(fname);
+  replay_peers      = newHashtable();
+  replay_usecs      = calloc(replay_pulses + 1, sizeof(long long));
+  return TRUE;
+}
+
+unsigned int replayGetSeed(void) {
+  return replay_seed;
+}
+
+int replayGetPulses(void) {
+  return replay_pulses;
+}
+
+void replayFeed(int pulse) {
+  // the clock starts with the first pulse, not when we started booting. We
+  // were loaded before the mud's settings were, so set the pulse rate now
+  if(replay_wall_start == 0) {
+    if(replay_pps > 0)
+      mudsettingSetInt("pulses_per_second", replay_pps);
+    replay_wall_start = pulse_clock();
+    replay_cpu_start  = replay_cpu_usecs();
+  }
+
+  // closes and catch-ups are left for replayFinish
+  for(; replay_next < replay_num_events; replay_next++) {
+    REPLAY_EVENT *event = &replay_events[replay_next];
+    if(event->pulse > pulse)
+      break;
+    else if(event->type == REPLAY_TIME)
+      current_time = (time_t)event->val;
+    else if(event->type == REPLAY_CONNECT)
+      replay_connect(event->id);
+    else if(event->type == REPLAY_INPUT) {
+      REPLAY_PEER *peer = replay_get_peer(event->id);
+      if(peer != NULL) {
+	replay_drain(peer);
+	if(write(peer->peer, event->line, strlen(event->line)) < 0 ||
+	   write(peer->peer, "\n", 1) < 0)
+	  perror("replay: write");
+      }
+    }
+  }
+}
+
+int replayFinish(int pulse, long long usecs) {
+  HASH_ITERATOR *peer_i = newHashIterator(replay_peers);
+  REPLAY_PEER     *peer = NULL;
+  const char       *key = NULL;
+  int          catchups = 0;
+
+  if(pulse >= 0 && pulse <= replay_pulses)
+    replay_usecs[pulse] = usecs;
+  ITERATE_HASH(key, peer, peer_i) {
+    replay_drain(peer);
+  } deleteHashIterator(peer_i);
+
+  // everything else was handled by replayFeed
+  for(; replay_finish_next < replay_num_events; replay_finish_next++) {
+    REPLAY_EVENT *event = &replay_events[replay_finish_next];
+    if(event->pulse > pulse)
+      break;
+    else if(event->type == REPLAY_CLOSE)
+      replay_close(event->id);
+    else if(event->type == REPLAY_CATCHUP)
+      catchups += (int)event->val;
+  }
+  replay_catchups += catchups;
+  return catchups;
+}
+
+void replayReport(BUFFER *buf) {
+  long long wall = pulse_clock() - replay_wall_start;
+  long long  cpu = replay_cpu_usecs() - replay_cpu_start;
+  long long  sum = 0;
+  int pulses = replay_pulses, i;
+
+  // write out how long every pulse took, in the order they ran
+  char fname[MAX_BUFFER];
+  snprintf(fname, sizeof(fname), "%s.pulses", replay_fname);
+  FILE *fl = fopen(fname, "w");
+  if(fl != NULL) {
+    fprintf(fl, "pulse\tusecs\n");
+    for(i = 1; i <= pulses; i++)
+      fprintf(fl, "%d\t%lld\n", i, replay_usecs[i]);
+    fclose(fl);
+  }
+
+  // find the slowest pulses before we sort the durations
+  int slowest[REPLAY_SLOWEST], num_slowest = 0, j;
+  for(i = 1; i <= pulses; i++) {
+    for(j = num_slowest; j > 0 &&
+	  replay_usecs[slowest[j-1]] < replay_usecs[i]; j--)
+      if(j < REPLAY_SLOWEST)
+	slowest[j] = slowest[j-1];
+    if(j < REPLAY_SLOWEST) {
+      slowest[j] = i;
+      num_slowest = MIN(REPLAY_SLOWEST, num_slowest + 1);
+    }
+  }
+
+  long long *sorted = malloc(sizeof(long long) * MAX(1, pulses));
+  for(i = 0; i < pulses; i++) {
+    sorted[i] = replay_usecs[i + 1];
+    sum      += sorted[i];
+  }
+  qsort(sorted, pulses, sizeof(long long), replay_cmp_usecs);
+
+  bprintf(buf, "Replayed %d pulses of %s, plus %d catch-up pulses.\r\n",
+	  pulses, replay_fname, replay_catchups);
+  bprintf(buf, "  wall %.3f s, cpu %.3f s, output %lld bytes\r\n",
+	  wall / 1000000.0, cpu / 1000000.0, replay_output);
+  if(pulses > 0) {
+    bprintf(buf, "  pulse usecs: mean %lld, p50 %lld, p90 %lld, p99 %lld, "
+	    "max %lld\r\n", sum / pulses, sorted[pulses / 2],
+	    sorted[pulses * 90 / 100], sorted[pulses * 99 / 100],
+	    sorted[pulses - 1]);
+    bprintf(buf, "  slowest pulses:");
+    for(i = 0; i < num_slowest; i++)
+      bprintf(buf, " %d (%lld)", slowest[i], replay_usecs[slowest[i]]);
+    bprintf(buf, "\r\n");
+  }
+  bprintf(buf, "  durations written to %s\r\n", fname);
+  free(sorted);
+
+  // hang up the connections still open
+  HASH_ITERATOR *peer_i = newHashIterator(replay_peers);
+  REPLAY_PEER     *peer = NULL;
+  const char       *key = NULL;
+  ITERATE_HASH(key, peer, peer_i) {
+    close(peer->peer);
+  } deleteHashIterator(peer_i);
+}
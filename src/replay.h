@@ -0,0 +1,75 @@
+#ifndef __REPLAY_H
+#define __REPLAY_H
+//*****************************************************************************
+//
+// replay.h
+//
+// recording what players send the mud, and playing it back later as a
+// benchmark. Started with --record <file>, the mud notes the seed it gave
+// the random number generators, every connection it accepts, every line of
+// input it takes in, every connection that goes away, and every catch-up
+// pulse it runs, each with the number of the pulse it happened on.
+//
+// Started with --replay <file> on a copy of the mudlib as it was when the
+// recording began, the mud boots that world, seeds its random number
+// generators the same way, and feeds the recorded input to fake sockets on
+// the pulses it came in on. Pulses are run back-to-back without sleeping in
+// between, and the game's clock is set to what it was on the recorded pulse.
+// When the recording runs out, the CPU time used and how long the pulses
+// took are printed, and each pulse's duration is written to <file>.pulses.
+//
+// Telnet negotiation is not recorded, so replayed sockets never turn on
+// compression or GMCP, and copyovers end a recording.
+//
+//*****************************************************************************
+
+//
+// start recording to a file, noting the seed the random number generators
+// were given. Returns FALSE if the file couldn't be opened
+bool replayRecordStart(const char *fname, unsigned int seed);
+
+//
+// stop recording, and write out whatever hasn't been written yet
+void replayRecordStop(void);
+
+//
+// a new pulse is starting. Called every time around the game loop, before
+// anything is read, after current_time is set
+void replayPulseBegin(void);
+
+//
+// note that a connection was accepted, that a line of input came in off of
+// one, that one was closed, or that catch-up pulses were run. These do
+// nothing if we aren't recording
+void replayRecordConnect(SOCKET_DATA *sock);
+void replayRecordInput  (SOCKET_DATA *sock, const char *line);
+void replayRecordClose  (SOCKET_DATA *sock);
+void replayRecordCatchup(int pulses);
+
+//
+// read in a recording to replay. Returns FALSE if it couldn't be read
+bool replayLoad(const char *fname);
+
+//
+// the seed the recording's random number generators were given, and how
+// many pulses it covers
+unsigned int replayGetSeed(void);
+int          replayGetPulses(void);
+
+//
+// set the clock, open connections, and feed input for a replayed pulse.
+// Called before the pulse's input is handled
+void replayFeed(int pulse);
+
+//
+// finish up a replayed pulse that took usecs microseconds: read back what
+// the fake sockets were sent, and close the ones that went away in the
+// recording. Returns how many catch-up pulses the recording ran after it
+int replayFinish(int pulse, long long usecs);
+
+//
+// print how the replay went, write out each pulse's duration, and close
+// down the fake sockets
+void replayReport(BUFFER *buf);
+
+#endif // __REPLAY_H
@@ -0,0 +1,220 @@
+//*****************************************************************************
+//
+// resolver.c
+//
+// looks up the hostnames of the addresses people connect to us from, on a
+// resolver thread of its own. See resolver.h for how it is used. The game
+// thread and the resolver thread only share the two queues below; the cache
+// belongs to the game thread alone.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "spsc_queue.h"
+#include "listener.h"
+#include "resolver.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how many lookups can be waiting for an answer at once
+#define RESOLVER_QUEUE_SIZE    256
+
+// how many hostnames we'll remember before we start throwing them out
+#define RESOLVER_CACHE_SIZE   4096
+
+typedef struct resolver_request {
+  struct sockaddr_storage addr; // the address we want the hostname of
+  char  numeric[INET6_ADDRSTRLEN]; // and how it's written
+  void                   *data; // what the game thread wants back with it
+  char               *hostname; // what we found
+} RESOLVER_REQUEST;
+
+typedef struct resolver_entry {
+  char *hostname;
+  time_t expires;
+} RESOLVER_ENTRY;
+
+// requests go to the resolver thread through one queue, and come back through
+// the other. We never let more than RESOLVER_QUEUE_SIZE be out at once, so
+// neither queue can fill up
+SPSC_QUEUE      *resolver_requests = NULL;
+SPSC_QUEUE     *resolver_completed = NULL;
+int              resolver_pending  = 0;
+
+// the resolver thread sleeps on this when it has nothing to do
+pthread_mutex_t      resolver_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t      resolver_ready = PTHREAD_COND_INITIALIZER;
+
+// maps addresses (as strings) to what we found for them
+HASHTABLE         *resolver_cache = NULL;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+void deleteResolverEntry(RESOLVER_ENTRY *entry) {
+  if(entry->hostname) free(entry->hostname);
+  free(entry);
+}
+
+//
+// throw out everything in the cache that has expired. If that still leaves
+// us with too much, throw out everything
+void resolver_cache_prune(void) {
+  LIST          *expired = newList();
+  HASH_ITERATOR  *hash_i = newHashIterator(resolver_cache);
+  RESOLVER_ENTRY  *entry = NULL;
+  const char        *key = NULL;
+  char          *oldkey = NULL;
+  time_t             now = time(NULL);
+
+  ITERATE_HASH(key, entry, hash_i) {
+    if(entry->expires <= now)
+      listPut(expired, strdup(key));
+  } deleteHashIterator(hash_i);
+
+  while((oldkey = listPop(expired)) != NULL) {
+    deleteResolverEntry(hashRemove(resolver_cache, oldkey));
+    free(oldkey);
+  }
+  deleteList(expired);
+
+  if(hashSize(resolver_cache) >= RESOLVER_CACHE_SIZE)
+    hashClearWith(resolver_cache, deleteResolverEntry);
+}
+
+//
+// remember the hostname we found for the numeric address, key
+void resolver_cache_put(const char *key, const char *hostname) {
+  RESOLVER_ENTRY *entry = NULL;
+  int               ttl = mudsettingGetInt("dns_cache_ttl");
+
+  if(ttl <= 0)
+    return;
+  if((entry = hashRemove(resolver_cache, key)) != NULL)
+    deleteResolverEntry(entry);
+  else if(hashSize(resolver_cache) >= RESOLVER_CACHE_SIZE)
+    resolver_cache_prune();
+
+  entry           = malloc(sizeof(RESOLVER_ENTRY));
+  entry->hostname = strdup(hostname);
+  entry->expires  = time(NULL) + ttl;
+  hashPut(resolver_cache, key, entry);
+}
+
+//
+// the loop our resolver thread runs: take a request, look it up, hand the
+// answer back, repeat. Sleeps when there are no requests
+void *resolver_loop(void *arg) {
+  RESOLVER_REQUEST *req = NULL;
+  for(;;) {
+    while((req = spscQueuePop(resolver_requests)) != NULL) {
+      socklen_t len = (req->addr.ss_family == AF_INET6 ?
+		       sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+      char host[NI_MAXHOST];
+
+      if(getnameinfo((struct sockaddr *) &req->addr, len, host, sizeof(host),
+		     NULL, 0, NI_NAMEREQD) == 0)
+	req->hostname = strdup(host);
+      spscQueuePush(resolver_completed, req);
+    }
+
+    pthread_mutex_lock(&resolver_lock);
+    while(spscQueueIsEmpty(resolver_requests))
+      pthread_cond_wait(&resolver_ready, &resolver_lock);
+    pthread_mutex_unlock(&resolver_lock);
+  }
+  return NULL;
+}
+
+
+
+//*****************************************************************************
+// implementation of resolver.h
+//*****************************************************************************
+void init_resolver(void) {
+  pthread_attr_t attr;
+  pthread_t    thread;
+
+  resolver_cache     = newHashtable();
+  resolver_requests  = newSPSCQueue(RESOLVER_QUEUE_SIZE);
+  resolver_completed = newSPSCQueue(RESOLVER_QUEUE_SIZE);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if(pthread_create(&thread, &attr, resolver_loop, NULL) != 0) {
+    log_string("Could not start the resolver thread. Hostnames will not be "
+	       "looked up.");
+    deleteSPSCQueue(resolver_requests);
+    deleteSPSCQueue(resolver_completed);
+    resolver_requests  = NULL;
+    resolver_completed = NULL;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+const char *resolverCacheGet(const char *addr) {
+  RESOLVER_ENTRY *entry = NULL;
+  if(resolver_cache == NULL || (entry = hashGet(resolver_cache, addr)) == NULL)
+    return NULL;
+  if(entry->expires <= time(NULL)) {
+    deleteResolverEntry(hashRemove(resolver_cache, addr));
+    return NULL;
+  }
+  return entry->hostname;
+}
+
+bool resolverLookup(const struct sockaddr_storage *addr, void *data) {
+  RESOLVER_REQUEST *req = NULL;
+
+  if(resolver_requests == NULL || resolver_pending >= RESOLVER_QUEUE_SIZE)
+    return FALSE;
+
+  req           = malloc(sizeof(RESOLVER_REQUEST));
+  if(addrToString(addr, req->numeric, sizeof(req->numeric)) == NULL) {
+    free(req);
+    return FALSE;
+  }
+  req->addr     = *addr;
+  req->data     = data;
+  req->hostname = NULL;
+  spscQueuePush(resolver_requests, req);
+  resolver_pending++;
+
+  pthread_mutex_lock(&resolver_lock);
+  pthread_cond_signal(&resolver_ready);
+  pthread_mutex_unlock(&resolver_lock);
+  return TRUE;
+}
+
+bool resolverNextResult(void **data, char **hostname) {
+  RESOLVER_REQUEST *req = NULL;
+  if(resolver_completed == NULL ||
+     (req = spscQueuePop(resolver_completed)) == NULL)
+    return FALSE;
+  resolver_pending--;
+
+  // we couldn't find a name, so the address will have to do
+  if(req->hostname == NULL)
+    req->hostname = strdup(req->numeric);
+  resolver_cache_put(req->numeric, req->hostname);
+
+  *data     = req->data;
+  *hostname = req->hostname;
+  free(req);
+  return TRUE;
+}
+
+int resolverGetPending(void) {
+  return resolver_pending;
+}
@@ -0,0 +1,46 @@
+#ifndef __RESOLVER_H
+#define __RESOLVER_H
+//*****************************************************************************
+//
+// resolver.h
+//
+// looks up the hostnames of the addresses people connect to us from. Lookups
+// are done by a single resolver thread, so a flood of connections can't have
+// us starting hundreds of threads. Requests are handed to it through a
+// bounded queue, and its answers come back to the game thread through a
+// completion queue. Answers are also cached, keyed by address, for
+// dns_cache_ttl seconds; failed lookups are cached too, with the address
+// itself as the hostname.
+//
+// Everything here is to be used from the game thread only.
+//
+//*****************************************************************************
+
+//
+// start up the resolver thread
+void init_resolver(void);
+
+//
+// if we know the hostname for addr, a numeric address (see addrToString in
+// listener.h), and our answer hasn't expired yet, return it. Otherwise,
+// return NULL
+const char *resolverCacheGet(const char *addr);
+
+//
+// ask the resolver thread to look up the hostname of addr, IPv4 or IPv6. data
+// is handed back along with the answer. Returns FALSE if the resolver is not
+// running, or has too many lookups waiting already
+bool resolverLookup(const struct sockaddr_storage *addr, void *data);
+
+//
+// take the next answer the resolver thread has for us. Returns FALSE if there
+// are none waiting. Otherwise, data is what the lookup was asked for with, and
+// hostname is a newly allocated copy of what we found (or the address, if we
+// couldn't find anything). The answer is added to our cache
+bool resolverNextResult(void **data, char **hostname);
+
+//
+// how many lookups have we asked for that haven't been answered yet?
+int resolverGetPending(void);
+
+#endif // __RESOLVER_H
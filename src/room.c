@@ -13,6 +13,8 @@
 
 #include "mud.h"
 #include "utils.h"
+#include "intern.h"
+#include "memstat.h"
 #include "handler.h"
 #include "extra_descs.h"
 #include "auxiliary.h"
@@ -21,20 +23,27 @@
 #include "room.h"
 #include "character.h"
 #include "object.h"
+#include "world.h"
+#include "hooks.h"
+
+typedef struct room_edge ROOM_EDGE;
+typedef struct exit_listing EXIT_LISTING;
+typedef struct room_cmds ROOM_CMDS;
 
 struct room_data {
   int         uid;               // what is our unique room ID number?
   time_t      birth;             // the time we were created
   int         terrain;           // what kind of terrain do we have?
-  char       *name;              // what is the name of our room?
+  const char *name;              // what is the name of our room?
   BUFFER     *desc;              // our description
 
-  HASHTABLE  *exits;             // a dir:exit mapping
-  NEAR_MAP   *cmd_table;         // a listing for all our room-only commands
+  EXIT_DATA  *dir_exits[NUM_DIRS]; // our exits in the normal directions
+  HASHTABLE  *special_exits;     // a dir:exit mapping for the rest, or NULL
+  ROOM_CMDS  *cmds;              // our room-only commands, maybe shared
   EDESC_SET  *edescs;            // the extra descriptions in the room
   BITVECTOR  *bits;              // the bits we have turned on
-  char       *class;             // what prototype do we directly inherit?
-  char       *prototypes;        // what prototypes are we instances of?
+  const char *class;             // what prototype do we directly inherit?
+  const char *prototypes;        // what prototypes are we instances of?
 
   LIST       *contents;          // what objects do we contain in the room?
   LIST       *characters;        // who is in our room?
@@ -42,8 +51,211 @@ struct room_data {
   AUX_TABLE  *auxiliary_data;    // data modules have installed in us
 
   bool        extracted;         // have we been extracted from the game?
+
+  // our exits, and the rooms they lead to, laid out so that walking the
+  // world doesn't need a hashtable lookup and a key resolved for every step.
+  // Built when first asked for, and thrown out whenever our exits change
+  ROOM_EDGE  *edges;
+  int         num_edges;         // -1 if we haven't built our edges yet
+  int         edge_generation;   // room_edge_generation our dests are from
+
+  // our exits as they were last listed, one for each kind of viewer who has
+  // looked at us since. Thrown out whenever what they show might change
+  LIST       *exit_listings;
+  int         listing_generation; // exit_listing_generation they're from
+};
+
+struct room_edge {
+  const char *dir;               // interned, as are the rest of our keys
+  const char *to;                // the full key of the room we lead to
+  EXIT_DATA  *exit;
+  ROOM_DATA  *dest;              // NULL until it's been looked up
 };
 
+struct exit_listing {
+  unsigned long key;             // what kind of viewer saw us this way
+  char        *text;
+};
+
+//
+// a table of room-only commands. Rooms spawned from the same prototypes, and
+// copies of a room, share one table until one of them adds, removes, or gets
+// a command to change, and only then gets a table of its own
+struct room_cmds {
+  int         refcount;          // how many rooms (and caches) use us?
+  NEAR_MAP   *table;
+};
+
+// the last table of commands built for rooms of each set of prototypes.
+// Prototypes -> ROOM_CMDS
+HASHTABLE *room_proto_cmds = NULL;
+
+// goes up whenever a room is deleted, so edges know that the rooms they
+// lead to might be gone
+int room_edge_generation = 0;
+
+// goes up whenever any room's edges might lead somewhere new
+int room_graph_generation = 0;
+
+// how many different kinds of viewer we remember exit listings for
+#define MAX_EXIT_LISTINGS      8
+
+// goes up whenever something that could change any room's exit listings
+// does: a room's name changing, a room being deleted, new exit see checks
+int exit_listing_generation = 0;
+
+//
+// throw out the exit listings we have remembered
+void room_clear_exit_listings(ROOM_DATA *room) {
+  EXIT_LISTING *listing = NULL;
+  if(room->exit_listings == NULL)
+    return;
+  while((listing = listPop(room->exit_listings)) != NULL) {
+    free(listing->text);
+    free(listing);
+  }
+}
+
+//
+// throw out our edges. They're built again when they are next wanted
+void room_clear_edges(ROOM_DATA *room) {
+  int i;
+  if(room->num_edges >= 0)
+    room_graph_generation++;
+  for(i = 0; i < room->num_edges; i++) {
+    strRelease(room->edges[i].dir);
+    strRelease(room->edges[i].to);
+  }
+  if(room->edges != NULL)
+    free(room->edges);
+  room->edges     = NULL;
+  room->num_edges = -1;
+  room_clear_exit_listings(room);
+}
+
+void room_put_edge(ROOM_DATA *room, int i, const char *dir, EXIT_DATA *ex) {
+  room->edges[i].dir  = strIntern(dir);
+  room->edges[i].to   = strIntern(exitGetToFull(ex));
+  room->edges[i].exit = ex;
+  room->edges[i].dest = NULL;
+}
+
+//
+// our edges are in the order our exits are listed: the normal directions in
+// order, and then the special exits
+void room_build_edges(ROOM_DATA *room) {
+  int specials = (room->special_exits ? hashSize(room->special_exits) : 0);
+  int i = 0, dir;
+
+  room_clear_edges(room);
+  room->edges = malloc(sizeof(ROOM_EDGE) * (NUM_DIRS + specials));
+  for(dir = 0; dir < NUM_DIRS; dir++)
+    if(room->dir_exits[dir] != NULL)
+      room_put_edge(room, i++, dirGetName(dir), room->dir_exits[dir]);
+  if(specials > 0) {
+    HASH_ITERATOR *ex_i = newHashIterator(room->special_exits);
+    const char  *special = NULL;
+    EXIT_DATA        *ex = NULL;
+    ITERATE_HASH(special, ex, ex_i) {
+      room_put_edge(room, i++, special, ex);
+    } deleteHashIterator(ex_i);
+  }
+  room->num_edges       = i;
+  room->edge_generation = room_edge_generation;
+}
+
+//
+// let go of a command table, and delete it if nothing else uses it
+void room_cmds_release(ROOM_CMDS *cmds) {
+  if(--cmds->refcount > 0)
+    return;
+  NEAR_ITERATOR *cmd_i = newNearIterator(cmds->table);
+  const char   *abbrev = NULL;
+  CMD_DATA        *cmd = NULL;
+  ITERATE_NEARMAP(abbrev, cmd, cmd_i)
+    deleteCmd(cmd);
+  deleteNearIterator(cmd_i);
+  deleteNearMap(cmds->table);
+  free(cmds);
+}
+
+ROOM_CMDS *newRoomCmds(void) {
+  ROOM_CMDS *cmds = malloc(sizeof(ROOM_CMDS));
+  cmds->refcount  = 1;
+  cmds->table     = newNearMap();
+  return cmds;
+}
+
+//
+// make sure we have a command table, and that no one else uses it, before
+// something in it changes
+void room_own_cmds(ROOM_DATA *room) {
+  if(room->cmds == NULL)
+    room->cmds = newRoomCmds();
+  else if(room->cmds->refcount > 1) {
+    ROOM_CMDS     *own = newRoomCmds();
+    NEAR_ITERATOR *cmd_i = newNearIterator(room->cmds->table);
+    const char   *abbrev = NULL;
+    CMD_DATA        *cmd = NULL;
+    ITERATE_NEARMAP(abbrev, cmd, cmd_i) {
+      nearMapPut(own->table, cmdGetName(cmd), abbrev, cmdCopy(cmd));
+    } deleteNearIterator(cmd_i);
+    room_cmds_release(room->cmds);
+    room->cmds = own;
+  }
+}
+
+//
+// do the two tables have the same commands, under the same abbreviations?
+// Keys and abbreviations are interned, and both tables list them in order
+bool room_cmds_same(ROOM_CMDS *cmds1, ROOM_CMDS *cmds2) {
+  if(nearMapSize(cmds1->table) != nearMapSize(cmds2->table))
+    return FALSE;
+  NEAR_ITERATOR *cmd1_i = newNearIterator(cmds1->table);
+  NEAR_ITERATOR *cmd2_i = newNearIterator(cmds2->table);
+  const char   *abbrev = NULL;
+  CMD_DATA       *cmd1 = NULL;
+  bool           same = TRUE;
+  ITERATE_NEARMAP(abbrev, cmd1, cmd1_i) {
+    CMD_DATA *cmd2 = nearIteratorCurrentVal(cmd2_i);
+    if(abbrev != nearIteratorCurrentAbbrev(cmd2_i) ||
+       nearIteratorCurrentKey(cmd1_i) != nearIteratorCurrentKey(cmd2_i) ||
+       !cmdSame(cmd1, cmd2)) {
+      same = FALSE;
+      break;
+    }
+    nearIteratorNext(cmd2_i);
+  }
+  deleteNearIterator(cmd1_i);
+  deleteNearIterator(cmd2_i);
+  return same;
+}
+
+//
+// delete every exit we have
+void room_delete_exits(ROOM_DATA *room, bool from_game) {
+  int dir;
+  for(dir = 0; dir < NUM_DIRS; dir++) {
+    if(room->dir_exits[dir] != NULL) {
+      if(from_game) exit_from_game(room->dir_exits[dir]);
+      deleteExit(room->dir_exits[dir]);
+      room->dir_exits[dir] = NULL;
+    }
+  }
+  if(room->special_exits != NULL) {
+    HASH_ITERATOR *ex_i = newHashIterator(room->special_exits);
+    const char  *special = NULL;
+    EXIT_DATA        *ex = NULL;
+    ITERATE_HASH(special, ex, ex_i) {
+      if(from_game) exit_from_game(ex);
+      deleteExit(ex);
+    } deleteHashIterator(ex_i);
+    deleteHashtable(room->special_exits);
+    room->special_exits = NULL;
+  }
+  room_clear_edges(room);
+}
+
 
 //*****************************************************************************
 //
@@ -51,13 +263,13 @@ struct room_data {
 //
 //*****************************************************************************
 ROOM_DATA *newRoom() {
-  ROOM_DATA *room = malloc(sizeof(ROOM_DATA));
+  ROOM_DATA *room = memAlloc(MEM_ROOM, sizeof(ROOM_DATA));
 
   room->uid       = next_uid();
   room->birth     = current_time;
-  room->prototypes= strdup("");
-  room->name      = strdup("");
-  room->class     = strdup("");
+  room->prototypes= strIntern("");
+  room->name      = strShare("");
+  room->class     = strIntern("");
   room->desc      = newBuffer(1);
 
   room->terrain = TERRAIN_INDOORS;
@@ -65,12 +277,18 @@ ROOM_DATA *newRoom() {
   room->bits           = bitvectorInstanceOf("room_bits");
   room->auxiliary_data = newAuxiliaryData(AUXILIARY_TYPE_ROOM);
 
-  room->exits      = newHashtable();
   room->edescs     = newEdescSet();
   room->contents   = newList();
   room->characters = newList();
   room->extracted  = FALSE;
-  room->cmd_table  = NULL;
+  room->cmds       = NULL;
+  room->special_exits = NULL;
+  memset(room->dir_exits, 0, sizeof(room->dir_exits));
+  room->edges      = NULL;
+  room->num_edges  = -1;
+  room->edge_generation = 0;
+  room->exit_listings   = NULL;
+  room->listing_generation = 0;
 
   return room;
 }
@@ -102,24 +320,11 @@ void deleteRoom(ROOM_DATA *room) {
   deleteList(room->characters);
 
   // delete all of our exits
-  HASH_ITERATOR *ex_i = newHashIterator(room->exits);
-  const char     *dir = NULL;
-  EXIT_DATA       *ex = NULL;
-  ITERATE_HASH(dir, ex, ex_i)
-    deleteExit(ex);
-  deleteHashIterator(ex_i);
-  deleteHashtable(room->exits);
-
-  // delete all of our commands
-  if(room->cmd_table != NULL) {
-    NEAR_ITERATOR *cmd_i = newNearIterator(room->cmd_table);
-    const char      *key = NULL;
-    CMD_DATA        *cmd = NULL;
-    ITERATE_NEARMAP(key, cmd, cmd_i)
-      deleteCmd(cmd);
-    deleteNearIterator(cmd_i);
-    deleteNearMap(room->cmd_table);
-  }
+  room_delete_exits(room, FALSE);
+
+  // let go of our commands
+  if(room->cmds != NULL)
+    room_cmds_release(room->cmds);
     
   // delete extra descriptions
   if(room->edescs) deleteEdescSet(room->edescs);
@@ -128,13 +333,21 @@ void deleteRoom(ROOM_DATA *room) {
   if(room->bits) deleteBitvector(room->bits);
 
   // delete strings
-  if(room->prototypes) free(room->prototypes);
-  if(room->class)      free(room->class);
-  if(room->name)       free(room->name);
+  strRelease(room->prototypes);
+  strRelease(room->class);
+  strRelease(room->name);
   if(room->desc)       deleteBuffer(room->desc);
   deleteAuxiliaryData(room->auxiliary_data);
 
-  free(room);
+  // anyone leading to us has to look their dests up again
+  room_clear_edges(room);
+  room_edge_generation++;
+  room_graph_generation++;
+  exit_listing_generation++;
+  if(room->exit_listings != NULL)
+    deleteList(room->exit_listings);
+
+  memFree(MEM_ROOM, room, sizeof(ROOM_DATA));
 }
 
 
@@ -155,14 +368,12 @@ STORAGE_SET *roomStore(ROOM_DATA *room) {
   // in different storage sets, and nested in another key:val pair storage set.
   // But this is the way we started doing it, and for the sake of compatibility,
   // we're going to keep at it...
-  HASH_ITERATOR *ex_i = newHashIterator(room->exits);
-  const char     *dir = NULL;
-  EXIT_DATA       *ex = NULL;
-  ITERATE_HASH(dir, ex, ex_i) {
-    STORAGE_SET *ex_set = exitStore(ex);
-    store_string(ex_set, "direction", dir);
+  int i;
+  for(i = 0; i < roomCountEdges(room); i++) {
+    STORAGE_SET *ex_set = exitStore(room->edges[i].exit);
+    store_string(ex_set, "direction", room->edges[i].dir);
     storage_list_put(ex_list, ex_set);
-  } deleteHashIterator(ex_i);
+  }
   
   // store our auxiliary data
   store_set(set, "auxiliary", auxiliaryDataStore(room->auxiliary_data));
@@ -268,45 +479,24 @@ void roomCopyTo(ROOM_DATA *from, ROOM_DATA *to) {
   bool room_in_game    = listIn(room_list, to);
 
   // first, delete all of our old exits
-  HASH_ITERATOR *ex_i = newHashIterator(to->exits);
-  const char     *dir = NULL;
-  EXIT_DATA       *ex = NULL;
-  ITERATE_HASH(dir, ex, ex_i) {
-    hashRemove(to->exits, dir);
-    if(does_room_exist) exit_from_game(ex);
-    deleteExit(ex);
-  } deleteHashIterator(ex_i);
+  room_delete_exits(to, does_room_exist);
 
   // now, copy all of our new exits
-  ex_i = newHashIterator(from->exits);
-  ITERATE_HASH(dir, ex, ex_i) {
+  int i;
+  for(i = 0; i < roomCountEdges(from); i++) {
+    const char *dir = from->edges[i].dir;
+    EXIT_DATA   *ex = from->edges[i].exit;
     roomSetExit(to, dir, exitCopy(ex));
     if(does_room_exist) exit_exist(ex);
     if(room_in_game)    exit_to_game(roomGetExit(to, dir));
-  } deleteHashIterator(ex_i);
-
-  // delete all of our old commands
-  if(to->cmd_table != NULL) {
-    NEAR_ITERATOR *cmd_i = newNearIterator(to->cmd_table);
-    const char   *abbrev = NULL;
-    CMD_DATA        *cmd = NULL;
-    ITERATE_NEARMAP(abbrev, cmd, cmd_i) {
-      nearMapRemove(to->cmd_table, cmdGetName(cmd));
-      deleteCmd(cmd);
-    } deleteNearIterator(cmd_i);
   }
 
-  // now, copy in all of our new commands
-  if(from->cmd_table != NULL) {
-    if(to->cmd_table == NULL)
-      to->cmd_table = newNearMap();
-    NEAR_ITERATOR *cmd_i = newNearIterator(from->cmd_table);
-    const char   *abbrev = NULL;
-    CMD_DATA        *cmd = NULL;
-    ITERATE_NEARMAP(abbrev, cmd, cmd_i) {
-      nearMapPut(to->cmd_table, cmdGetName(cmd), abbrev, cmdCopy(cmd));
-    } deleteNearIterator(cmd_i);
-  }
+  // share their commands, instead of our old ones
+  if(from->cmds != NULL)
+    from->cmds->refcount++;
+  if(to->cmds != NULL)
+    room_cmds_release(to->cmds);
+  to->cmds = from->cmds;
   
   // copy all of our auxiliary data
   auxiliaryDataCopyTo(from->auxiliary_data, to->auxiliary_data);
@@ -321,7 +511,7 @@ bool roomIsExtracted(ROOM_DATA *room) {
 }
 
 bool roomIsInstance(ROOM_DATA *room, const char *prototype) {
-  return is_keyword(room->prototypes, prototype, FALSE);
+  return strInternHasWord(room->prototypes, strInternFind(prototype));
 }
 
 const char *roomGetPrototypes(ROOM_DATA *room) {
@@ -329,12 +519,16 @@ const char *roomGetPrototypes(ROOM_DATA *room) {
 }
 
 void roomAddPrototype(ROOM_DATA *room, const char *prototype) {
-  add_keyword(&room->prototypes, prototype);
+  char *prototypes = strdup(room->prototypes);
+  add_keyword(&prototypes, prototype);
+  roomSetPrototypes(room, prototypes);
+  free(prototypes);
 }
 
 void roomSetPrototypes(ROOM_DATA *room, const char *prototypes) {
-  if(room->prototypes) free(room->prototypes);
-  room->prototypes = strdupsafe(prototypes);
+  const char *old = room->prototypes;
+  room->prototypes = strIntern(prototypes);
+  strRelease(old);
 }
 
 
@@ -342,20 +536,32 @@ void roomSetPrototypes(ROOM_DATA *room, const char *prototypes) {
 //*****************************************************************************
 // add and remove functions
 //*****************************************************************************
-void roomRemoveChar(ROOM_DATA *room, const CHAR_DATA *ch) {
-  listRemove(room->characters, ch);
+//
+// characters and objects remember the node they were put into the room with,
+// so they can be taken back out without searching the whole room for them.
+// Things loaded along with the room don't have a node, and get searched for
+void roomRemoveChar(ROOM_DATA *room, CHAR_DATA *ch) {
+  if(charGetRoomNode(ch) != NULL)
+    listRemoveNode(room->characters, charGetRoomNode(ch));
+  else
+    listRemove(room->characters, ch);
+  charSetRoomNode(ch, NULL);
 }
 
-void roomRemoveObj(ROOM_DATA *room, const OBJ_DATA *obj) {
-  listRemove(room->contents, obj);
+void roomRemoveObj(ROOM_DATA *room, OBJ_DATA *obj) {
+  if(objGetListNode(obj) != NULL)
+    listRemoveNode(room->contents, objGetListNode(obj));
+  else
+    listRemove(room->contents, obj);
+  objSetListNode(obj, NULL);
 }
 
 void roomAddChar(ROOM_DATA *room, CHAR_DATA *ch) {
-  listPut(room->characters, ch);
+  charSetRoomNode(ch, listPutNode(room->characters, ch));
 }
 
 void roomAddObj(ROOM_DATA *room, OBJ_DATA *obj) {
-  listPut(room->contents, obj);
+  objSetListNode(obj, listPutNode(room->contents, obj));
 }
 
 
@@ -364,36 +570,146 @@ void roomAddObj(ROOM_DATA *room, OBJ_DATA *obj) {
 // exit functions
 //*****************************************************************************
 void roomSetExit(ROOM_DATA *room, const char *dir, EXIT_DATA *exit) {
-  hashPut(room->exits, dir, exit);
+  int num = dirGetNum(dir);
+  if(num != DIR_NONE)
+    room->dir_exits[num] = exit;
+  else {
+    if(room->special_exits == NULL)
+      room->special_exits = newHashtableSize(1);
+    hashPut(room->special_exits, dir, exit);
+  }
   exitSetRoom(exit, room);
+  room_clear_edges(room);
 }
 
 EXIT_DATA *roomGetExit(ROOM_DATA *room, const char *dir) {
-  return hashGet(room->exits, dir);
+  int num = dirGetNum(dir);
+  if(num != DIR_NONE)
+    return room->dir_exits[num];
+  return (room->special_exits ? hashGet(room->special_exits, dir) : NULL);
 }
 
 EXIT_DATA *roomRemoveExit(ROOM_DATA *room, const char *dir) {
-  EXIT_DATA *exit = hashRemove(room->exits, dir);
+  EXIT_DATA *exit = NULL;
+  int         num = dirGetNum(dir);
+  if(num != DIR_NONE) {
+    exit = room->dir_exits[num];
+    room->dir_exits[num] = NULL;
+  }
+  else if(room->special_exits != NULL)
+    exit = hashRemove(room->special_exits, dir);
   if(exit != NULL) exitSetRoom(exit, NULL);
+  room_clear_edges(room);
   return exit;
 }
 
 const char *roomGetExitDir(ROOM_DATA *room, EXIT_DATA *exit) {
-  // go through all of our key:val pairs, and see which key matches this exit
-  HASH_ITERATOR *ex_i = newHashIterator(room->exits);
-  const char     *dir = NULL;
-  EXIT_DATA       *ex = NULL;
-  ITERATE_HASH(dir, ex, ex_i) {
-    if(ex == exit) {
-      deleteHashIterator(ex_i);
-      return dir;
-    }
-  } deleteHashIterator(ex_i);
+  int i;
+  for(i = 0; i < roomCountEdges(room); i++)
+    if(room->edges[i].exit == exit)
+      return room->edges[i].dir;
   return NULL;
 }
 
 LIST *roomGetExitNames(ROOM_DATA *room) {
-  return hashCollect(room->exits);
+  LIST *names = newList();
+  int       i = 0;
+  for(i = 0; i < roomCountEdges(room); i++)
+    listQueue(names, strdup(room->edges[i].dir));
+  return names;
+}
+
+int roomCountEdges(ROOM_DATA *room) {
+  if(room->num_edges < 0)
+    room_build_edges(room);
+  return room->num_edges;
+}
+
+const char *roomGetEdgeDir(ROOM_DATA *room, int i) {
+  return (i >= 0 && i < roomCountEdges(room) ? room->edges[i].dir : NULL);
+}
+
+EXIT_DATA *roomGetEdgeExit(ROOM_DATA *room, int i) {
+  return (i >= 0 && i < roomCountEdges(room) ? room->edges[i].exit : NULL);
+}
+
+ROOM_DATA *roomGetEdgeDest(ROOM_DATA *room, int i, bool load) {
+  if(i < 0 || i >= roomCountEdges(room))
+    return NULL;
+
+  // rooms have been deleted since we looked our dests up. Look them up again
+  if(room->edge_generation != room_edge_generation) {
+    int j;
+    for(j = 0; j < room->num_edges; j++)
+      room->edges[j].dest = NULL;
+    room->edge_generation = room_edge_generation;
+  }
+
+  ROOM_EDGE *edge = &room->edges[i];
+  if(edge->dest != NULL && roomIsExtracted(edge->dest))
+    edge->dest = NULL;
+  if(edge->dest == NULL && (load || worldRoomLoaded(gameworld, edge->to)))
+    edge->dest = worldGetRoom(gameworld, edge->to);
+  return edge->dest;
+}
+
+void roomForgetEdges(ROOM_DATA *room) {
+  room_clear_edges(room);
+}
+
+int roomGraphGeneration(void) {
+  return room_graph_generation;
+}
+
+void roomGraphChanged(void) {
+  room_graph_generation++;
+}
+
+const char *roomGetExitListing(ROOM_DATA *room, unsigned long key) {
+  if(room->exit_listings == NULL)
+    return NULL;
+  if(room->listing_generation != exit_listing_generation) {
+    room_clear_exit_listings(room);
+    return NULL;
+  }
+
+  LIST_ITERATOR *list_i = newListIterator(room->exit_listings);
+  EXIT_LISTING *listing = NULL;
+  ITERATE_LIST(listing, list_i) {
+    if(listing->key == key)
+      break;
+  } deleteListIterator(list_i);
+  return (listing ? listing->text : NULL);
+}
+
+void roomSetExitListing(ROOM_DATA *room, unsigned long key, const char *text){
+  EXIT_LISTING *listing = NULL;
+  if(room->exit_listings == NULL)
+    room->exit_listings = newList();
+  else if(room->listing_generation != exit_listing_generation)
+    room_clear_exit_listings(room);
+  room->listing_generation = exit_listing_generation;
+
+  // forget the oldest listing if we're remembering too many
+  if(listSize(room->exit_listings) >= MAX_EXIT_LISTINGS &&
+     (listing = listRemoveNum(room->exit_listings,
+			      listSize(room->exit_listings) - 1)) != NULL) {
+    free(listing->text);
+    free(listing);
+  }
+
+  listing       = malloc(sizeof(EXIT_LISTING));
+  listing->key  = key;
+  listing->text = strdupsafe(text);
+  listPut(room->exit_listings, listing);
+}
+
+void roomForgetExitListings(ROOM_DATA *room) {
+  room_clear_exit_listings(room);
+}
+
+void roomForgetAllExitListings(void) {
+  exit_listing_generation++;
 }
 
 
@@ -406,8 +722,11 @@ const char *roomGetClass(ROOM_DATA *room) {
 }
 
 void roomSetClass(ROOM_DATA *room, const char *prototype) {
-  if(room->class) free(room->class);
-  room->class = strdupsafe(prototype);
+  const char *old = room->class;
+  room->class = strIntern(prototype);
+  strRelease(old);
+  // our exits' keys are relative to our locale
+  room_clear_edges(room);
 }
 
 LIST       *roomGetContents    (const ROOM_DATA *room) {
@@ -456,23 +775,35 @@ void *roomGetAuxiliaryData     (const ROOM_DATA *room, const char *name) {
   return auxiliaryGet(room->auxiliary_data, name);
 }
 
+void *roomGetAuxiliarySlot     (const ROOM_DATA *room, int slot) {
+  return auxiliaryGetSlot(room->auxiliary_data, slot);
+}
+
 void        roomSetEdescs      (ROOM_DATA *room, EDESC_SET *edescs) {
   if(room->edescs) deleteEdescSet(room->edescs);
   room->edescs = edescs;
 }
 
 void        roomSetName        (ROOM_DATA *room, const char *name) {
-  if(room->name) free(room->name);
-  room->name = strdupsafe(name);
+  const char *old = room->name;
+  room->name = strShare(name);
+  // rooms leading to us show our name in their exit listings. Rooms that
+  // are only now getting their first name haven't been listed yet
+  if(old != room->name && *old)
+    exit_listing_generation++;
+  strRelease(old);
 }
 
 void        roomSetDesc (ROOM_DATA *room, const char *desc) {
-  bufferClear(room->desc);
-  bufferCat(room->desc, (desc ? desc : ""));
+  bufferShare(room->desc, desc);
 }
 
 void        roomSetTerrain     (ROOM_DATA *room, int terrain_type) {
+  bool changed = (room->terrain != terrain_type);
   room->terrain = terrain_type;
+  // let anyone keeping track of where people are know
+  if(changed && listSize(room->characters) > 0)
+    hookRunArgs("room_terrain", "rm", room);
 }
 
 BITVECTOR *roomGetBits(const ROOM_DATA *room) {
@@ -480,41 +811,63 @@ BITVECTOR *roomGetBits(const ROOM_DATA *room) {
 }
 
 NEAR_MAP *roomGetCmdTable(const ROOM_DATA *room) {
-  return room->cmd_table;
+  return (room->cmds ? room->cmds->table : NULL);
 }
 
 bool roomHasCmds(const ROOM_DATA *room) {
-  return room->cmd_table != NULL;
+  return room->cmds != NULL;
 }
 
 bool roomHasCmd(const ROOM_DATA *room, const char *name) {
-  return room->cmd_table != NULL && nearMapKeyExists(room->cmd_table, name);
+  return room->cmds != NULL && nearMapKeyExists(room->cmds->table, name);
 }
 
 CMD_DATA *roomRemoveCmd(ROOM_DATA *room, const char *name) {
-  if(room->cmd_table != NULL)
-    return nearMapRemove(room->cmd_table, name);
-  return NULL;
+  if(!roomHasCmd(room, name))
+    return NULL;
+  room_own_cmds(room);
+  return nearMapRemove(room->cmds->table, name);
 }
 
 CMD_DATA *roomGetCmd(ROOM_DATA *room, const char *name, bool abbr_ok) {
-  if(room->cmd_table != NULL)
-    return nearMapGet(room->cmd_table, name, abbr_ok);
-  return NULL;
+  if(room->cmds == NULL || !nearMapGet(room->cmds->table, name, abbr_ok))
+    return NULL;
+  // whoever asks may change the command, so it has to be ours alone
+  room_own_cmds(room);
+  return nearMapGet(room->cmds->table, name, abbr_ok);
 }
 
 void roomAddCmd(ROOM_DATA *room, const char *name, 
 		const char *abbr, CMD_DATA *cmd) {
-  CMD_DATA *old = NULL;
-  if(room->cmd_table == NULL)
-    room->cmd_table = newNearMap();
-  else
-    old = nearMapRemove(room->cmd_table, name);
-  nearMapPut(room->cmd_table, name, abbr, cmd);
+  room_own_cmds(room);
+  CMD_DATA *old = nearMapRemove(room->cmds->table, name);
+  nearMapPut(room->cmds->table, name, abbr, cmd);
   if(old != NULL)
     deleteCmd(old);
 }
 
+void roomShareCmds(ROOM_DATA *room) {
+  if(room->cmds == NULL || room->cmds->refcount > 1 || !*room->prototypes)
+    return;
+  if(room_proto_cmds == NULL)
+    room_proto_cmds = newHashtable();
+
+  ROOM_CMDS *shared = hashGet(room_proto_cmds, room->prototypes);
+  if(shared != NULL && room_cmds_same(shared, room->cmds)) {
+    room_cmds_release(room->cmds);
+    room->cmds = shared;
+    shared->refcount++;
+  }
+  // the first room of its kind, or the prototypes have changed since. Rooms
+  // spawned after us share our table
+  else {
+    if(shared != NULL)
+      room_cmds_release(shared);
+    hashPut(room_proto_cmds, room->prototypes, room->cmds);
+    room->cmds->refcount++;
+  }
+}
+
 
 
 //*****************************************************************************
@@ -563,9 +916,10 @@ int dirGetOpposite(int dir) {
 }
 
 int dirGetNum(const char *dir) {
-  int i;
+  // only directions that start with the same letter need comparing
+  int i, first = tolower(*dir);
   for(i = 0; i < NUM_DIRS; i++)
-    if(!strcasecmp(dir, dir_names[i]))
+    if(first == *dir_names[i] && !strcasecmp(dir, dir_names[i]))
       return i;
   return DIR_NONE;
 }
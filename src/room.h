@@ -91,8 +91,8 @@ void        roomSetPrototypes(ROOM_DATA *room, const char *prototypes);
 //*****************************************************************************
 // add and remove functions
 //*****************************************************************************
-void       roomRemoveChar     (ROOM_DATA *room, const CHAR_DATA *ch);
-void       roomRemoveObj      (ROOM_DATA *room, const OBJ_DATA *obj);
+void       roomRemoveChar     (ROOM_DATA *room, CHAR_DATA *ch);
+void       roomRemoveObj      (ROOM_DATA *room, OBJ_DATA *obj);
 
 void       roomAddChar        (ROOM_DATA *room, CHAR_DATA *ch);
 void       roomAddObj         (ROOM_DATA *room, OBJ_DATA *obj);
@@ -113,9 +113,48 @@ EXIT_DATA  *roomRemoveExit(ROOM_DATA *room, const char *dir);
 const char *roomGetExitDir(ROOM_DATA *room, EXIT_DATA *exit);
 LIST     *roomGetExitNames(ROOM_DATA *room);
 
+//
+// a room's exits laid out as edges of the world's room graph, for walking
+// from room to room without looking every exit and destination up by key.
+// Edges are numbered 0 to roomCountEdges - 1, in the order exits are listed:
+// the normal directions first, north to northwest, and then special exits.
+// Walking them allocates nothing, and is how exits should be iterated over.
+// They are built the first time they are asked for. Changing a room's exits (or where one leads, or the
+// room's key) rebuilds them. roomGetEdgeDest returns the room an edge leads
+// to, remembering it for next time; if load is FALSE, rooms that aren't in
+// memory are not loaded to find out, and NULL is returned
+int         roomCountEdges (ROOM_DATA *room);
+const char *roomGetEdgeDir (ROOM_DATA *room, int i);
+EXIT_DATA  *roomGetEdgeExit(ROOM_DATA *room, int i);
+ROOM_DATA  *roomGetEdgeDest(ROOM_DATA *room, int i, bool load);
+void        roomForgetEdges(ROOM_DATA *room);
+
+//
+// goes up whenever any room's edges might lead somewhere new: exits change,
+// rooms are deleted, or rooms come into the game. Anything that keeps its
+// own copy of the room graph can check it to see if the copy is out of date
+int         roomGraphGeneration(void);
+void        roomGraphChanged   (void);
+
+//
+// a room's exits, already written out the way list_room_exits shows them, for
+// each kind of viewer that has looked at the room. What kind of viewer
+// someone is comes down to key, which the caller works out (inform.c uses
+// which of the exits they can see). Returns NULL if nothing is remembered
+// for key. Listings are forgotten whenever the room's exits change, a door
+// is opened or closed, a room is renamed or deleted, or a new exit see
+// check is registered; roomForgetExitListings forgets one room's listings,
+// and roomForgetAllExitListings forgets every room's
+const char *roomGetExitListing(ROOM_DATA *room, unsigned long key);
+void        roomSetExitListing(ROOM_DATA *room, unsigned long key,
+			       const char *text);
+void        roomForgetExitListings(ROOM_DATA *room);
+void        roomForgetAllExitListings(void);
+
 EDESC_SET  *roomGetEdescs       (const ROOM_DATA *room);
 const char *roomGetEdesc        (const ROOM_DATA *room, const char *keyword);
 void       *roomGetAuxiliaryData(const ROOM_DATA *room, const char *name);
+void       *roomGetAuxiliarySlot(const ROOM_DATA *room, int slot);
 LIST       *roomGetCharacters   (const ROOM_DATA *room);
 LIST       *roomGetContents     (const ROOM_DATA *room);
 BITVECTOR  *roomGetBits         (const ROOM_DATA *room);
@@ -130,6 +169,14 @@ CMD_DATA   *roomRemoveCmd       (ROOM_DATA *room, const char *name);
 CMD_DATA   *roomGetCmd          (ROOM_DATA *room, const char *name, 
 				 bool abbr_ok);
 
+//
+// rooms spawned from the same prototypes usually end up with the same
+// commands. Called once a room's prototypes have run; if its commands are the
+// same as the last room of its prototypes', it shares that room's table
+// instead of keeping its own. Changing a shared table's commands through the
+// functions above first gives the room a table of its own
+void        roomShareCmds       (ROOM_DATA *room);
+
 
 const char *roomGetClass       (ROOM_DATA *room);
 void        roomSetClass       (ROOM_DATA *room, const char *prototype);
@@ -0,0 +1,183 @@
+//*****************************************************************************
+//
+// room_graph.c
+//
+// copies of the room graph for worker threads to walk. See room_graph.h.
+// Rooms are kept sorted by uid, so a uid's room can be found without a
+// table, and where each edge leads is the index of the room it leads to.
+//
+//*****************************************************************************
+
+#include <stdatomic.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "room.h"
+#include "room_graph.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+typedef struct {
+  int   uid;
+  int  zone; // rooms in the same zone have the same number
+  int edges; // where this room's edges start in the graph's list of them
+} GRAPH_ROOM;
+
+struct room_graph {
+  GRAPH_ROOM  *rooms; // one more than there are, so the last one's edges end
+  int     num_rooms;
+  int        *edges; // the room each edge leads to
+  int    generation; // roomGraphGeneration when we were made
+  atomic_int   refs;
+};
+
+// the newest copy we have made
+ROOM_GRAPH *room_graph = NULL;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// used for sorting rooms by uid
+int graph_cmp_room(const void *a, const void *b) {
+  return ((const GRAPH_ROOM *)a)->uid - ((const GRAPH_ROOM *)b)->uid;
+}
+
+//
+// find where the room with a uid is in the graph, or -1 if it isn't
+int graph_find(ROOM_GRAPH *graph, int uid) {
+  int lo = 0, hi = graph->num_rooms - 1;
+  while(lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if(graph->rooms[mid].uid == uid)
+      return mid;
+    else if(graph->rooms[mid].uid < uid)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+//
+// copy the rooms in memory, and where their edges lead
+ROOM_GRAPH *graph_build(void) {
+  ROOM_GRAPH   *graph = calloc(1, sizeof(ROOM_GRAPH));
+  HASHTABLE    *zones = newHashtable();
+  LIST_ITERATOR *room_i = newListIterator(room_list);
+  ROOM_DATA     *room = NULL;
+  int   max_edges = 16, num_edges = 0, i, j;
+
+  graph->rooms = malloc(sizeof(GRAPH_ROOM) * (listSize(room_list) + 1));
+  graph->edges = malloc(sizeof(int) * max_edges);
+
+  // number the zones, and sort the rooms by uid
+  ITERATE_LIST(room, room_i) {
+    if(roomIsExtracted(room))
+      continue;
+    const char *zone = get_key_locale(roomGetClass(room));
+    if(!hashIn(zones, zone))
+      hashPut(zones, zone, (void *)(long)(hashSize(zones) + 1));
+    graph->rooms[graph->num_rooms].uid  = roomGetUID(room);
+    graph->rooms[graph->num_rooms].zone = (int)(long)hashGet(zones, zone);
+    graph->num_rooms++;
+  } deleteListIterator(room_i);
+  qsort(graph->rooms, graph->num_rooms, sizeof(GRAPH_ROOM), graph_cmp_room);
+
+  // now see where everyone's edges go
+  for(i = 0; i < graph->num_rooms; i++) {
+    room = propertyTableGet(room_table, graph->rooms[i].uid);
+    graph->rooms[i].edges = num_edges;
+    for(j = 0; room != NULL && j < roomCountEdges(room); j++) {
+      ROOM_DATA *dest = roomGetEdgeDest(room, j, FALSE);
+      int         to = (dest ? graph_find(graph, roomGetUID(dest)) : -1);
+      if(to < 0)
+	continue;
+      if(num_edges == max_edges) {
+	max_edges   *= 2;
+	graph->edges = realloc(graph->edges, sizeof(int) * max_edges);
+      }
+      graph->edges[num_edges++] = to;
+    }
+  }
+  graph->rooms[graph->num_rooms].edges = num_edges;
+
+  deleteHashtable(zones);
+  graph->generation = roomGraphGeneration();
+  atomic_init(&graph->refs, 1);
+  return graph;
+}
+
+
+
+//*****************************************************************************
+// implementation of room_graph.h
+//*****************************************************************************
+ROOM_GRAPH *roomGraphGet(void) {
+  if(room_graph == NULL || room_graph->generation != roomGraphGeneration()) {
+    if(room_graph != NULL)
+      roomGraphRelease(room_graph);
+    room_graph = graph_build();
+  }
+  atomic_fetch_add(&room_graph->refs, 1);
+  return room_graph;
+}
+
+void roomGraphRelease(ROOM_GRAPH *graph) {
+  if(atomic_fetch_sub(&graph->refs, 1) == 1) {
+    free(graph->rooms);
+    free(graph->edges);
+    free(graph);
+  }
+}
+
+int roomGraphPath(ROOM_GRAPH *graph, int from, int to, int max_depth,
+		  bool stay_zone, int **path) {
+  int start = graph_find(graph, from), end = graph_find(graph, to);
+  int  head = 0, tail = 0, len = 0, i, j;
+  *path = NULL;
+  if(start < 0 || end < 0)
+    return 0;
+
+  // walk breadth first, noting where we came to each room from
+  int *parent = malloc(sizeof(int) * graph->num_rooms);
+  int  *depth = malloc(sizeof(int) * graph->num_rooms);
+  int  *queue = malloc(sizeof(int) * graph->num_rooms);
+  for(i = 0; i < graph->num_rooms; i++)
+    parent[i] = -2;
+  parent[start] = -1;
+  depth[start]  = 0;
+  queue[tail++] = start;
+  while(head < tail && parent[end] == -2) {
+    i = queue[head++];
+    if(max_depth > 0 && depth[i] >= max_depth)
+      continue;
+    for(j = graph->rooms[i].edges; j < graph->rooms[i+1].edges; j++) {
+      int dest = graph->edges[j];
+      if(parent[dest] != -2 ||
+	 (stay_zone && graph->rooms[dest].zone != graph->rooms[start].zone))
+	continue;
+      parent[dest]  = i;
+      depth[dest]   = depth[i] + 1;
+      queue[tail++] = dest;
+    }
+  }
+
+  // go back from the end, filling in the path from its end to its start
+  if(parent[end] != -2) {
+    len   = depth[end] + 1;
+    *path = malloc(sizeof(int) * len);
+    for(i = end, j = len - 1; i >= 0; i = parent[i], j--)
+      (*path)[j] = graph->rooms[i].uid;
+  }
+  free(parent);
+  free(depth);
+  free(queue);
+  return len;
+}
@@ -0,0 +1,36 @@
+#ifndef __ROOM_GRAPH_H
+#define __ROOM_GRAPH_H
+//*****************************************************************************
+//
+// room_graph.h
+//
+// a copy of how the rooms in memory lead to each other, that worker threads
+// can walk without touching the rooms themselves. The copy is made by the
+// game thread the first time it is wanted after the room graph changes (see
+// roomGraphGeneration), and is shared by everyone who wants it until then.
+// Anyone still walking an old copy keeps it until they release it.
+//
+// Only rooms that are in memory are in the copy, and doors are not: paths
+// go through closed exits, the same as room.path_to does by default.
+//
+//*****************************************************************************
+
+typedef struct room_graph ROOM_GRAPH;
+
+//
+// get the current copy of the room graph, making it if we have to. Must be
+// called from the game thread, and released when it isn't needed anymore.
+// Releasing can be done from any thread
+ROOM_GRAPH *roomGraphGet(void);
+void    roomGraphRelease(ROOM_GRAPH *graph);
+
+//
+// find the shortest path from the room with one uid to the room with
+// another, no more than max_depth steps long (0 for no limit), and staying
+// in the first room's zone if stay_zone is TRUE. Returns how many rooms are
+// on the path, both ends included, and fills path with their uids; path must
+// be freed. Returns 0 if there is no path. Safe to call from any thread
+int roomGraphPath(ROOM_GRAPH *graph, int from, int to, int max_depth,
+		  bool stay_zone, int **path);
+
+#endif // __ROOM_GRAPH_H
@@ -22,6 +22,7 @@
 #include "handler.h"
 #include "prototype.h"
 #include "hooks.h"
+#include "intern.h"
 #include "room_reset.h"
 
 
@@ -38,29 +39,247 @@
 
 
 
+//*****************************************************************************
+// reset tracking
+//*****************************************************************************
+
+//
+// zone resets only touch rooms that need resetting. A room needs it until it
+// has been reset once, and again once anything its resets loaded has been
+// taken away, killed, or has wandered off. Rooms with resets that might do
+// something different every time (ones that failed their chance, were held
+// back by a max, run scripts, or open and close things) always need it.
+
+// the rooms that don't need resetting. Their keys are the only thing kept
+HASHTABLE    *reset_clean = NULL;
+
+// thing we loaded -> the interned key of the room whose resets loaded it
+MAP        *reset_spawned = NULL;
+
+// zones a player has been in since they were last reset
+HASHTABLE  *reset_visited = NULL;
+
+// rooms the world unloaded for being idle. They are reset when they are next
+// loaded, instead of being loaded just to be reset
+HASHTABLE  *reset_evicted = NULL;
+
+// the room we're running resets for, and whether it will need them again
+const char *resetting_room = NULL;
+bool          reset_again = FALSE;
+
+//
+// remember that a room's resets loaded something
+void reset_tag_spawned(void *thing) {
+  if(resetting_room != NULL && !mapIn(reset_spawned, thing))
+    mapPut(reset_spawned, thing, (void *)strIntern(resetting_room));
+}
+
+//
+// something left where its room's resets put it. The room needs resetting
+void reset_spawned_left(void *thing) {
+  const char *room_key = mapRemove(reset_spawned, thing);
+  if(room_key != NULL) {
+    hashRemove(reset_clean, room_key);
+    strRelease(room_key);
+  }
+}
+
+//
+// for hooks whose first argument is the thing leaving: obj_from_room,
+// char_from_game, and so on. Some have a second argument we don't need
+void reset_left_hook(HOOK_ARGS *args) {
+  void *thing = NULL, *from = NULL;
+  hookParseArgs(args, &thing, &from);
+  reset_spawned_left(thing);
+}
+
+void reset_unequip_hook(HOOK_ARGS *args) {
+  CHAR_DATA  *ch = NULL;
+  OBJ_DATA  *obj = NULL;
+  hookParseArgs(args, &ch, &obj);
+  reset_spawned_left(obj);
+}
+
+//
+// rooms unloaded for being idle lose what their resets loaded, and get it
+// back when they are made again
+void do_resets(ROOM_DATA *room);
+
+void reset_evict_hook(HOOK_ARGS *args) {
+  ROOM_DATA *room = NULL;
+  hookParseArgs(args, &room);
+  hashPut(reset_evicted, roomGetClass(room), reset_evicted);
+}
+
+void reset_reload_hook(HOOK_ARGS *args) {
+  ROOM_DATA *room = NULL;
+  hookParseArgs(args, &room);
+  if(hashRemove(reset_evicted, roomGetClass(room)) != NULL)
+    do_resets(room);
+}
+
+//
+// when resets are changed, every room might need resetting; we don't know
+// which rooms inherit the changed ones
+void reset_forget_clean(void) {
+  if(reset_clean != NULL)
+    hashClear(reset_clean);
+}
+
+//
+// players note which zones they have been in, for reset_visited_only
+void reset_visit_hook(HOOK_ARGS *args) {
+  CHAR_DATA  *ch = NULL;
+  ROOM_DATA *room = NULL;
+  hookParseArgs(args, &ch, &room);
+  if(!charIsNPC(ch) && !hashIn(reset_visited, get_key_locale(roomGetClass(room))))
+    hashPut(reset_visited, get_key_locale(roomGetClass(room)), reset_visited);
+}
+
+
+
 //*****************************************************************************
 // reset list
 //*****************************************************************************
+
+//
+// before a reset list is run, it is compiled into one array of ops, one for
+// each reset in it. A list's own resets come first. The resets attached to
+// each one are laid out together after that, and the op remembers where they
+// start and how many there are. Prototype keys are resolved ahead of time, so
+// running the list doesn't have to touch the reset's strings at all
+typedef struct reset_op {
+  RESET_DATA     *reset;
+  const char   *fullkey; // our arg, relative to the list's locale. Interned
+  WORLD_KEY       *wkey; // the prototype we load, if we're a load
+  int                on; // where our on, in, and then resets start
+  int            num_on;
+  int                in;
+  int            num_in;
+  int              then;
+  int          num_then;
+} RESET_OP;
+
 struct reset_list {
   char       *key; // our key in the world
   LIST    *resets; // our list of resets
+  RESET_OP   *ops; // our resets, compiled. NULL if they need to be compiled
+  int     num_ops;
+  int     max_ops;
+  const char *locale; // the locale our keys are relative to. Interned
 };
 
+//
+// throw out our compiled ops. They're made again the next time we're run
+void reset_list_clear_ops(RESET_LIST *list) {
+  int i;
+  for(i = 0; i < list->num_ops; i++)
+    strRelease(list->ops[i].fullkey);
+  if(list->ops != NULL)
+    free(list->ops);
+  strRelease(list->locale);
+  list->ops     = NULL;
+  list->num_ops = 0;
+  list->max_ops = 0;
+  list->locale  = NULL;
+}
+
+//
+// make room for num more ops at the end of a list's ops, and return where
+// they start
+int reset_list_reserve_ops(RESET_LIST *list, int num) {
+  int first = list->num_ops;
+  if(list->num_ops + num > list->max_ops) {
+    list->max_ops = MAX(list->max_ops * 2, list->num_ops + num);
+    list->ops     = realloc(list->ops, sizeof(RESET_OP) * list->max_ops);
+  }
+  list->num_ops += num;
+  return first;
+}
+
+//
+// compile a list of resets into the ops starting at first, and then compile
+// everything attached to each of them
+void reset_list_compile_resets(RESET_LIST *list, LIST *resets, int first) {
+  LIST_ITERATOR *reset_i = newListIterator(resets);
+  RESET_DATA      *reset = NULL;
+  int                  i = first;
+  ITERATE_LIST(reset, reset_i) {
+    RESET_OP *op = &list->ops[i++];
+    op->reset    = reset;
+    op->fullkey  = NULL;
+    op->wkey     = NULL;
+    switch(resetGetType(reset)) {
+    case RESET_LOAD_OBJECT:
+    case RESET_LOAD_MOBILE:
+    case RESET_FIND_OBJECT:
+    case RESET_FIND_MOBILE:
+    case RESET_PURGE_OBJECT:
+    case RESET_PURGE_MOBILE:
+      op->fullkey = strIntern(get_fullkey_relative(resetGetArg(reset),
+						   list->locale));
+      op->wkey    = worldResolveKey(gameworld, op->fullkey);
+      break;
+    default:
+      break;
+    }
+  } deleteListIterator(reset_i);
+
+  // our ops can move around as we add more, so always re-find them
+  int num = i - first;
+  for(i = first; i < first + num; i++) {
+    RESET_DATA *reset = list->ops[i].reset;
+    int            on = reset_list_reserve_ops(list, listSize(resetGetOn(reset)));
+    int            in = reset_list_reserve_ops(list, listSize(resetGetIn(reset)));
+    int          then = reset_list_reserve_ops(list, listSize(resetGetThen(reset)));
+    list->ops[i].on       = on;
+    list->ops[i].num_on   = listSize(resetGetOn(reset));
+    list->ops[i].in       = in;
+    list->ops[i].num_in   = listSize(resetGetIn(reset));
+    list->ops[i].then     = then;
+    list->ops[i].num_then = listSize(resetGetThen(reset));
+    reset_list_compile_resets(list, resetGetOn(reset),   on);
+    reset_list_compile_resets(list, resetGetIn(reset),   in);
+    reset_list_compile_resets(list, resetGetThen(reset), then);
+  }
+}
+
+//
+// compile our resets, if they need it. Our own resets are the first ops
+void reset_list_compile(RESET_LIST *list) {
+  if(list->ops != NULL)
+    return;
+  list->locale = strIntern(get_key_locale(list->key ? list->key : ""));
+  reset_list_reserve_ops(list, MAX(1, listSize(list->resets)));
+  list->num_ops = listSize(list->resets);
+  reset_list_compile_resets(list, list->resets, 0);
+}
+
+//
+// the prototype a load op loads. If its zone didn't exist when we were
+// compiled, we try finding it again
+PROTO_DATA *reset_op_get_proto(RESET_OP *op, const char *type) {
+  if(op->wkey == NULL)
+    op->wkey = worldResolveKey(gameworld, op->fullkey);
+  return (op->wkey ? worldGetTypeKey(gameworld, type, op->wkey) : NULL);
+}
+
 RESET_LIST *newResetList(void) {
-  RESET_LIST *list = malloc(sizeof(RESET_LIST));
+  RESET_LIST *list = calloc(1, sizeof(RESET_LIST));
   list->resets = newList();
   list->key    = strdup("");
   return list;
 }
 
 void deleteResetList(RESET_LIST *list) {
+  reset_list_clear_ops(list);
   if(list->resets) deleteListWith(list->resets, deleteReset);
   if(list->key)    free(list->key);
   free(list);
 }
 
 RESET_LIST *resetListCopy(RESET_LIST *list) {
-  RESET_LIST *newlist = malloc(sizeof(RESET_LIST));
+  RESET_LIST *newlist = calloc(1, sizeof(RESET_LIST));
   if(list->resets) newlist->resets = listCopyWith(list->resets, resetCopy);
   else             newlist->resets = newList();
   newlist->key =   strdupsafe(list->key);
@@ -68,6 +287,8 @@ RESET_LIST *resetListCopy(RESET_LIST *list) {
 }
 
 void resetListCopyTo(RESET_LIST *from, RESET_LIST *to) {
+  reset_list_clear_ops(to);
+  reset_forget_clean();
   if(to->resets)   deleteListWith(to->resets, deleteReset);
   if(from->resets) to->resets = listCopyWith(from->resets, resetCopy);
   else             to->resets = newList();
@@ -92,14 +313,19 @@ LIST *resetListGetResets(RESET_LIST *list) {
 }
 
 void resetListAdd(RESET_LIST *list, RESET_DATA *reset) {
+  reset_list_clear_ops(list);
+  reset_forget_clean();
   listPut(list->resets, reset);
 }
 
 void resetListRemove(RESET_LIST *list, RESET_DATA *reset) {
+  reset_list_clear_ops(list);
+  reset_forget_clean();
   listRemove(list->resets, reset);
 }
 
 void resetListSetKey(RESET_LIST *list, const char *key) {
+  reset_list_clear_ops(list);
   if(list->key) free(list->key);
   list->key = strdupsafe(key);
 }
@@ -311,47 +537,32 @@ void           resetAddThen     (RESET_DATA *reset, RESET_DATA *then) {
 //*****************************************************************************
 
 // needs to be declared...
-bool resetRun(RESET_DATA *reset, void *initiator, int initiator_type,
-	      const char *locale);
-
-//
-// Perform resetRun on all the reset commands in the list, using
-// initiator and initiator_type
-void resetRunOn(LIST *list, void *initiator, int initiator_type, 
-		const char *locale) {
-  if(listSize(list) > 0) {
-    LIST_ITERATOR *list_i = newListIterator(list);
-    RESET_DATA     *reset = NULL;
-    ITERATE_LIST(reset, list_i)
-      resetRun(reset, initiator, initiator_type, locale);
-    deleteListIterator(list_i);
-  }
-}
+bool reset_run_op(RESET_LIST *list, RESET_OP *op, void *initiator,
+		  int initiator_type);
 
 //
-// try performing an object load, based on the reset data we have
-bool try_reset_load_object(RESET_DATA *reset, void *initiator, 
-			   int initiator_type, const char *locale) {
-  const char *fullkey = get_fullkey_relative(resetGetArg(reset), locale);
-  PROTO_DATA   *proto = worldGetType(gameworld, "oproto", fullkey);
-  // if there's no prototype, break out
-  if(proto == NULL || protoIsAbstract(proto))
-    return FALSE;
-
-  // see if we're already at our max
-  if(resetGetMax(reset) != 0 && 
-     count_objs(NULL, object_list, NULL, fullkey, FALSE) >= 
-     resetGetMax(reset))
-    return FALSE;
-  if(initiator_type == INITIATOR_ROOM && resetGetRoomMax(reset) != 0 &&
-     (count_objs(NULL, roomGetContents(initiator), NULL, fullkey,
-		 FALSE) >= resetGetRoomMax(reset)))
-    return FALSE;
+// Perform reset_run_op on num of a reset list's compiled ops, starting at
+// first, using initiator and initiator_type
+void reset_run_ops(RESET_LIST *list, int first, int num, void *initiator,
+		   int initiator_type) {
+  int i;
+  for(i = first; i < first + num; i++)
+    reset_run_op(list, &list->ops[i], initiator, initiator_type);
+}
 
-  OBJ_DATA *obj = protoObjRun(proto);
-  if(obj == NULL)
-    return FALSE;
+//
+// how many of something we can load, if we want to load times of them, have
+// count already, and can have no more than max. A max of 0 is no max
+int reset_load_limit(int times, int count, int max) {
+  if(max != 0 && count + times > max)
+    return MAX(0, max - count);
+  return times;
+}
 
+//
+// put an object we've loaded where it goes, and run all of our stuff on it
+bool reset_place_object(RESET_LIST *list, RESET_OP *op, OBJ_DATA *obj,
+			void *initiator, int initiator_type) {
   // to the room
   if(initiator_type == INITIATOR_ROOM)
     obj_to_room(obj, initiator);
@@ -402,37 +613,54 @@ bool try_reset_load_object(RESET_DATA *reset, void *initiator,
   }
 
   // now, run all of our stuff
-  resetRunOn(reset->on,   obj, INITIATOR_ON_OBJ,   locale);
-  resetRunOn(reset->in,   obj, INITIATOR_IN_OBJ,   locale);
-  resetRunOn(reset->then, obj, INITIATOR_THEN_OBJ, locale);
+  reset_run_ops(list, op->on, op->num_on, obj, INITIATOR_ON_OBJ);
+  reset_run_ops(list, op->in, op->num_in, obj, INITIATOR_IN_OBJ);
+  reset_run_ops(list, op->then, op->num_then, obj, INITIATOR_THEN_OBJ);
 
+  // if we're taken from here, our room will need resetting
+  reset_tag_spawned(obj);
   return TRUE;
 }
 
-
 //
-// try performing a mobile load, based on the reset data we have
-bool try_reset_load_mobile(RESET_DATA *reset, void *initiator, 
-			   int initiator_type, const char *locale) {
-  const char *fullkey = get_fullkey_relative(resetGetArg(reset), locale);
-  PROTO_DATA   *proto = worldGetType(gameworld, "mproto", fullkey);
+// try performing an object load, based on the reset data we have, times
+// times. The prototype is looked up and our maxes are checked once, and all
+// of the objects are spawned together
+bool try_reset_load_object(RESET_LIST *list, RESET_OP *op, int times,
+			   void *initiator, int initiator_type) {
+  RESET_DATA   *reset = op->reset;
+  const char *fullkey = op->fullkey;
+  PROTO_DATA   *proto = reset_op_get_proto(op, "oproto");
   // if there's no prototype, break out
   if(proto == NULL || protoIsAbstract(proto))
     return FALSE;
 
   // see if we're already at our max
-  if(resetGetMax(reset) != 0 && 
-     count_chars(NULL, mobile_list, NULL, fullkey, FALSE) >= resetGetMax(reset))
-    return FALSE;
-  if(initiator_type == INITIATOR_ROOM && resetGetRoomMax(reset) != 0 &&
-     (count_chars(NULL, roomGetCharacters(initiator), NULL, fullkey,
-		  FALSE) >= resetGetRoomMax(reset)))
+  times = reset_load_limit(times, count_obj_instances(fullkey),
+			   resetGetMax(reset));
+  if(initiator_type == INITIATOR_ROOM && resetGetRoomMax(reset) != 0)
+    times = reset_load_limit(times, count_objs(NULL, roomGetContents(initiator),
+					       NULL, fullkey, FALSE),
+			     resetGetRoomMax(reset));
+  if(times <= 0)
     return FALSE;
 
-  CHAR_DATA *mob = protoMobRun(proto);
-  if(mob == NULL)
-    return FALSE;
+  // like when we loaded one at a time, whether we succeeded is whether the
+  // last one did
+  LIST      *objs = newList();
+  OBJ_DATA   *obj = NULL;
+  int     loaded = protoObjRunBatch(proto, times, objs);
+  bool   ret_val = FALSE;
+  while((obj = listPop(objs)) != NULL)
+    ret_val = reset_place_object(list, op, obj, initiator, initiator_type);
+  deleteList(objs);
+  return (ret_val && loaded == times);
+}
 
+//
+// put a mobile we've loaded where it goes, and run all of our followup stuff
+bool reset_place_mobile(RESET_LIST *list, RESET_OP *op, CHAR_DATA *mob,
+			void *initiator, int initiator_type) {
   // to the room
   if(initiator_type == INITIATOR_ROOM)
     char_to_room(mob, initiator);
@@ -464,45 +692,118 @@ bool try_reset_load_mobile(RESET_DATA *reset, void *initiator,
   }
 
   // now, run all of our followup stuff
-  resetRunOn(reset->on,   mob, INITIATOR_ON_MOB,   locale);
-  resetRunOn(reset->in,   mob, INITIATOR_IN_MOB,   locale);
-  resetRunOn(reset->then, mob, INITIATOR_THEN_MOB, locale);
+  reset_run_ops(list, op->on, op->num_on, mob, INITIATOR_ON_MOB);
+  reset_run_ops(list, op->in, op->num_in, mob, INITIATOR_IN_MOB);
+  reset_run_ops(list, op->then, op->num_then, mob, INITIATOR_THEN_MOB);
 
+  // if we leave or die, our room will need resetting
+  reset_tag_spawned(mob);
   return TRUE;
 }
 
 
+//
+// try performing a mobile load, based on the reset data we have, times times.
+// Like object loads, everything that only has to be done once is
+bool try_reset_load_mobile(RESET_LIST *list, RESET_OP *op, int times,
+			   void *initiator, int initiator_type) {
+  RESET_DATA   *reset = op->reset;
+  const char *fullkey = op->fullkey;
+  PROTO_DATA   *proto = reset_op_get_proto(op, "mproto");
+  // if there's no prototype, break out
+  if(proto == NULL || protoIsAbstract(proto))
+    return FALSE;
+
+  // see if we're already at our max
+  times = reset_load_limit(times, count_char_instances(fullkey),
+			   resetGetMax(reset));
+  if(initiator_type == INITIATOR_ROOM && resetGetRoomMax(reset) != 0)
+    times = reset_load_limit(times,
+			     count_chars(NULL, roomGetCharacters(initiator),
+					 NULL, fullkey, FALSE),
+			     resetGetRoomMax(reset));
+  if(times <= 0)
+    return FALSE;
+
+  // like when we loaded one at a time, whether we succeeded is whether the
+  // last one did
+  LIST      *mobs = newList();
+  CHAR_DATA  *mob = NULL;
+  int     loaded = protoMobRunBatch(proto, times, mobs);
+  bool   ret_val = FALSE;
+  while((mob = listPop(mobs)) != NULL)
+    ret_val = reset_place_mobile(list, op, mob, initiator, initiator_type);
+  deleteList(mobs);
+  return (ret_val && loaded == times);
+}
+
+
+//
+// is the object where the initiator keeps the things it looks through?
+bool reset_obj_is_at(OBJ_DATA *obj, void *initiator, int initiator_type) {
+  switch(initiator_type) {
+  case INITIATOR_ROOM:   return (objGetRoom(obj)      == initiator);
+  case INITIATOR_IN_OBJ: return (objGetContainer(obj) == initiator);
+  case INITIATOR_IN_MOB: return (objGetCarrier(obj)   == initiator);
+  case INITIATOR_ON_MOB: return (objGetWearer(obj)    == initiator);
+  default:               return FALSE;
+  }
+}
+
+//
+// is the mobile where the initiator keeps the people it looks through?
+bool reset_mob_is_at(CHAR_DATA *mob, void *where, int initiator_type) {
+  if(initiator_type == INITIATOR_ON_OBJ)
+    return (charGetFurniture(mob) == where);
+  return (charGetRoom(mob) == where);
+}
+
 //
 // handles "find" and "purge" in one function
-bool try_reset_old_object(RESET_DATA *reset, void *initiator,int initiator_type,
-			  int reset_cmd, const char *locale) {
-  const char *fullkey = get_fullkey_relative(resetGetArg(reset), locale);
+bool try_reset_old_object(RESET_LIST *list, RESET_OP *op, void *initiator,
+			  int initiator_type, int reset_cmd) {
+  const char *fullkey = op->fullkey;
   OBJ_DATA       *obj = NULL;
+  SET      *instances = obj_instances_of(fullkey);
+  LIST         *where = NULL;
+
+  // if there are none in the game, there are none here
+  if(instances == NULL)
+    return FALSE;
 
   // is it the room?
   if(initiator_type == INITIATOR_ROOM)
-    obj = find_obj(NULL, roomGetContents(initiator),  1, NULL, fullkey, FALSE);
+    where = roomGetContents(initiator);
   // is it in a container?
   else if(initiator_type == INITIATOR_IN_OBJ)
-    obj = find_obj(NULL, objGetContents(initiator),   1, NULL, fullkey, FALSE);
+    where = objGetContents(initiator);
   // is it in a person's inventory?
   else if(initiator_type == INITIATOR_IN_MOB)
-    obj = find_obj(NULL, charGetInventory(initiator), 1, NULL, fullkey, FALSE);
+    where = charGetInventory(initiator);
   // is it in a person's equipment?
-  else if(initiator_type == INITIATOR_ON_MOB) {
-    LIST *eq = bodyGetAllEq(charGetBody(initiator));
-    obj = find_obj(NULL, eq, 1, NULL, fullkey, FALSE);
-    deleteList(eq);
+  else if(initiator_type == INITIATOR_ON_MOB)
+    where = bodyGetEqList(charGetBody(initiator));
+
+  // look through whichever is shorter: what's here, or the prototype's
+  // instances in the whole game
+  if(where != NULL && setSize(instances) < listSize(where)) {
+    LOCAL_SET_ITERATOR(inst_i, instances);
+    ITERATE_SET(obj, inst_i) {
+      if(reset_obj_is_at(obj, initiator, initiator_type))
+	break;
+    } setIteratorFinish(inst_i);
   }
+  else if(where != NULL)
+    obj = find_obj(NULL, where, 1, NULL, fullkey, FALSE);
 
   // if we didn't find it, return false
   if(obj == NULL)
     return FALSE;
 
   // now, run our reset sscripts
-  resetRunOn(reset->on,   obj, INITIATOR_ON_OBJ,   locale);
-  resetRunOn(reset->in,   obj, INITIATOR_IN_OBJ,   locale);
-  resetRunOn(reset->then, obj, INITIATOR_THEN_OBJ, locale);
+  reset_run_ops(list, op->on, op->num_on, obj, INITIATOR_ON_OBJ);
+  reset_run_ops(list, op->in, op->num_in, obj, INITIATOR_IN_OBJ);
+  reset_run_ops(list, op->then, op->num_then, obj, INITIATOR_THEN_OBJ);
 
   // if this is a purge and it wasn't our initiator, kill it
   // if we purge our initiator, we might run into some problems
@@ -515,55 +816,73 @@ bool try_reset_old_object(RESET_DATA *reset, void *initiator,int initiator_type,
 
 //
 // find an object
-bool try_reset_find_object(RESET_DATA *reset, void *initiator, 
-			   int initiator_type, const char *locale) {
-  return try_reset_old_object(reset, initiator, initiator_type, 
-			      RESET_FIND_OBJECT, locale);
+bool try_reset_find_object(RESET_LIST *list, RESET_OP *op, void *initiator, 
+			   int initiator_type) {
+  return try_reset_old_object(list, op, initiator, initiator_type, 
+			      RESET_FIND_OBJECT);
 }
 
 
 //
 // purge an object
-bool try_reset_purge_object(RESET_DATA *reset, void *initiator, 
-			    int initiator_type, const char *locale) {
-  return try_reset_old_object(reset, initiator, initiator_type, 
-			      RESET_PURGE_OBJECT, locale);
+bool try_reset_purge_object(RESET_LIST *list, RESET_OP *op, void *initiator, 
+			    int initiator_type) {
+  return try_reset_old_object(list, op, initiator, initiator_type, 
+			      RESET_PURGE_OBJECT);
 }
 
 
 //
 // handles "find" and "purge" in one function
-bool try_reset_old_mobile(RESET_DATA *reset, void *initiator,int initiator_type,
-			  int reset_cmd, const char *locale) {
-  const char *fullkey = get_fullkey_relative(resetGetArg(reset), locale);
+bool try_reset_old_mobile(RESET_LIST *list, RESET_OP *op, void *initiator,
+			  int initiator_type, int reset_cmd) {
+  const char *fullkey = op->fullkey;
   CHAR_DATA      *mob = NULL;
+  SET      *instances = char_instances_of(fullkey);
+  void     *where_at = NULL;
+  LIST        *where = NULL;
 
-  // is it the room?
-  if(initiator_type == INITIATOR_ROOM)
-    mob = find_char(NULL, roomGetCharacters(initiator),1, NULL, fullkey, FALSE);
-  // is it furniture?
-  else if(initiator_type == INITIATOR_ON_OBJ)
-    mob = find_char(NULL, objGetUsers(initiator), 1, NULL, fullkey, FALSE);
+  // if there are none in the game, there are none here
+  if(instances == NULL)
+    return FALSE;
+
+  // is it the room, or furniture?
+  if(initiator_type == INITIATOR_ROOM || initiator_type == INITIATOR_ON_OBJ)
+    where_at = initiator;
   // after an object
   else if(initiator_type == INITIATOR_THEN_OBJ) {
     if(objGetRoom(initiator) == NULL)
       return FALSE;
-    mob = find_char(NULL, roomGetCharacters(objGetRoom(initiator)), 1, NULL,
-		    fullkey, FALSE);
+    where_at = objGetRoom(initiator);
   }
   // after another mob
   else if(initiator_type == INITIATOR_THEN_MOB)
-    mob = find_char(NULL, roomGetCharacters(charGetRoom(initiator)), 1, NULL,
-		    fullkey, FALSE);
+    where_at = charGetRoom(initiator);
+
+  if(where_at != NULL)
+    where = (initiator_type == INITIATOR_ON_OBJ ? objGetUsers(where_at) :
+	     roomGetCharacters(where_at));
+
+  // look through whichever is shorter: who's here, or the prototype's
+  // instances in the whole game
+  if(where != NULL && setSize(instances) < listSize(where)) {
+    LOCAL_SET_ITERATOR(inst_i, instances);
+    ITERATE_SET(mob, inst_i) {
+      if(reset_mob_is_at(mob, where_at, initiator_type))
+	break;
+    } setIteratorFinish(inst_i);
+  }
+  else if(where != NULL)
+    mob = find_char(NULL, where, 1, NULL, fullkey, FALSE);
 
   // if we didn't find it, return FALSE
   if(mob == NULL)
     return FALSE;
 
   // if we found it, do the reset of the commands
-  resetRunOn(reset->on,   mob, INITIATOR_ON_MOB,   locale);
-  resetRunOn(reset->in,   mob, INITIATOR_IN_MOB,   locale);
-  resetRunOn(reset->then, mob, INITIATOR_THEN_MOB, locale);
+  reset_run_ops(list, op->on, op->num_on, mob, INITIATOR_ON_MOB);
+  reset_run_ops(list, op->in, op->num_in, mob, INITIATOR_IN_MOB);
+  reset_run_ops(list, op->then, op->num_then, mob, INITIATOR_THEN_MOB);
 
   // if this is a purge and it wasn't our initiator, kill it
   // if we purge our initiator, we might run into some problems
@@ -576,17 +895,19 @@ bool try_reset_old_mobile(RESET_DATA *reset, void *initiator,int initiator_type,
 
 //
 // find a mobile
-bool try_reset_find_mobile(RESET_DATA *reset, void *initiator, 
-			   int initiator_type, const char *locale) {
-  return try_reset_old_mobile(reset, initiator, initiator_type, RESET_FIND_MOBILE, locale);
+bool try_reset_find_mobile(RESET_LIST *list, RESET_OP *op, void *initiator, 
+			   int initiator_type) {
+  return try_reset_old_mobile(list, op, initiator, initiator_type,
+			      RESET_FIND_MOBILE);
 }
 
 
 //
 // purge a mobile
-bool try_reset_purge_mobile(RESET_DATA *reset, void *initiator, 
-			    int initiator_type, const char *locale) {
-  return try_reset_old_mobile(reset, initiator, initiator_type, RESET_PURGE_MOBILE, locale);
+bool try_reset_purge_mobile(RESET_LIST *list, RESET_OP *op, void *initiator, 
+			    int initiator_type) {
+  return try_reset_old_mobile(list, op, initiator, initiator_type,
+			      RESET_PURGE_MOBILE);
 }
 
 
@@ -693,37 +1014,58 @@ bool try_reset_script(RESET_DATA *reset, void *initiator, int initiator_type,
 
 //
 // run the reset data
-bool resetRun(RESET_DATA *reset, void *initiator, int initiator_type,
-	      const char *locale) {
+bool reset_run_op(RESET_LIST *list, RESET_OP *op, void *initiator,
+		  int initiator_type) {
+  RESET_DATA *reset = op->reset;
   //
   // possible problem: how do we know what to return if we're
   // running the reset data multiple times?
   bool ret_val = FALSE;
 
+  // loads are done all at once. See how many of them make their chance, and
+  // load that many together
+  int i, times = 0;
+  if(resetGetType(reset) == RESET_LOAD_OBJECT ||
+     resetGetType(reset) == RESET_LOAD_MOBILE) {
+    for(i = 0; i < resetGetTimes(reset); i++)
+      if(rand_number(1, 100) <= resetGetChance(reset))
+	times++;
+    if(times == 0)
+      ret_val = FALSE;
+    else if(resetGetType(reset) == RESET_LOAD_OBJECT)
+      ret_val = try_reset_load_object(list,op,times,initiator,initiator_type);
+    else
+      ret_val = try_reset_load_mobile(list,op,times,initiator,initiator_type);
+
+    // if we didn't load everything we could have, try again next time
+    if(!ret_val || times < resetGetTimes(reset))
+      reset_again = TRUE;
+    return ret_val;
+  }
+
+  // scripts and doors can be different every time we come back, so rooms
+  // that have them are always reset
+  if(resetGetType(reset) == RESET_SCRIPT || resetGetType(reset) == RESET_OPEN ||
+     resetGetType(reset) == RESET_CLOSE  || resetGetType(reset) == RESET_LOCK)
+    reset_again = TRUE;
+
   // go through for however many times we need to
-  int i;
   for(i = 0; i < resetGetTimes(reset); i++) {
     // If we don't make our reset chance, continue onto the next check
     if(rand_number(1, 100) > resetGetChance(reset))
       continue;
     switch(resetGetType(reset)) {
-    case RESET_LOAD_OBJECT:
-      ret_val = try_reset_load_object(reset, initiator, initiator_type, locale);
-      break;
-    case RESET_LOAD_MOBILE:
-      ret_val = try_reset_load_mobile(reset, initiator, initiator_type, locale);
-      break;
     case RESET_FIND_OBJECT:
-      ret_val = try_reset_find_object(reset, initiator, initiator_type, locale);
+      ret_val = try_reset_find_object(list, op, initiator, initiator_type);
       break;
     case RESET_FIND_MOBILE:
-      ret_val = try_reset_find_mobile(reset, initiator, initiator_type, locale);
+      ret_val = try_reset_find_mobile(list, op, initiator, initiator_type);
       break;
     case RESET_PURGE_OBJECT:
-      ret_val = try_reset_purge_object(reset, initiator, initiator_type,locale);
+      ret_val = try_reset_purge_object(list, op, initiator, initiator_type);
       break;
     case RESET_PURGE_MOBILE:
-      ret_val = try_reset_purge_mobile(reset, initiator, initiator_type,locale);
+      ret_val = try_reset_purge_mobile(list, op, initiator, initiator_type);
       break;
     case RESET_OPEN:
       ret_val = try_reset_open(reset, initiator, initiator_type);
@@ -738,7 +1080,8 @@ bool resetRun(RESET_DATA *reset, void *initiator, int initiator_type,
       ret_val = try_reset_position(reset, initiator, initiator_type);
       break;
     case RESET_SCRIPT:
-      ret_val = try_reset_script(reset, initiator, initiator_type, locale);
+      ret_val = try_reset_script(reset, initiator, initiator_type,
+				 list->locale);
       break;
     default:
       return FALSE;
@@ -756,18 +1099,35 @@ bool resetRun(RESET_DATA *reset, void *initiator, int initiator_type,
 //
 // run all of the resets for a specified room
 void do_resets(ROOM_DATA *room) {
-  // first apply all of our prototype resets
-  LIST            *protos = parse_keywords(roomGetPrototypes(room));
-  LIST_ITERATOR  *proto_i = newListIterator(protos);
-  char             *proto = NULL;
-  RESET_LIST        *list = NULL;
+  // first apply all of our prototype resets. Our prototypes are interned, so
+  // they are already split up into words for us
+  const char  *protos = roomGetPrototypes(room);
+  int       num_protos = strInternNumWords(protos);
+  RESET_LIST     *list = NULL;
+  int i;
+
+  // resets can reset other rooms through scripts; remember where we were
+  const char *old_room = resetting_room;
+  bool       old_again = reset_again;
+  resetting_room       = roomGetClass(room);
+  reset_again          = FALSE;
 
   // try to run each parent reset, and finally our own
-  ITERATE_LIST(proto, proto_i) {
-    if((list = worldGetType(gameworld, "reset", proto)) != NULL)
-      resetRunOn(resetListGetResets(list), room, INITIATOR_ROOM, get_key_locale(proto));
-  } deleteListIterator(proto_i);
-  deleteListWith(protos, free);
+  for(i = 0; i < num_protos; i++) {
+    if((list = worldGetType(gameworld, "reset",
+			    strInternWord(protos, i))) != NULL) {
+      reset_list_compile(list);
+      reset_run_ops(list, 0, listSize(list->resets), room, INITIATOR_ROOM);
+    }
+  }
+
+  // we won't need resetting until something we loaded goes away
+  if(reset_again)
+    hashRemove(reset_clean, roomGetClass(room));
+  else if(!hashIn(reset_clean, roomGetClass(room)))
+    hashPut(reset_clean, roomGetClass(room), reset_clean);
+  resetting_room = old_room;
+  reset_again    = old_again;
 }
 
 //
@@ -788,12 +1148,23 @@ void zone_reset_hook(const char *info) {
   hookParseInfo(info, &zone_key);
   ZONE_DATA *zone = worldGetZone(gameworld, zone_key);
 
+  // if we only reset zones players have been to, see if one has
+  if(mudsettingGetInt("reset_visited_only") && 
+     hashRemove(reset_visited, zone_key) == NULL) {
+    free(zone_key);
+    return;
+  }
+
   LIST_ITERATOR *res_i = newListIterator(zoneGetResettable(zone));
   char           *name = NULL;
   const char   *locale = zone_key;
   ROOM_DATA      *room = NULL;
   ITERATE_LIST(name, res_i) {
-    if((room = worldGetRoom(gameworld, get_fullkey(name, locale))) != NULL) {
+    // rooms that don't need resetting aren't loaded in just to check
+    const char *key = get_fullkey(name, locale);
+    if(!hashIn(reset_clean, key) &&
+       (!hashIn(reset_evicted, key) || worldRoomLoaded(gameworld, key)) &&
+       (room = worldGetRoom(gameworld, key)) != NULL) {
       do_resets(room);
     }
   } deleteListIterator(res_i);
@@ -803,6 +1174,27 @@ void zone_reset_hook(const char *info) {
 }
 
 void init_room_reset(void) {
+  reset_clean   = newHashtable();
+  reset_spawned = newMap(NULL, NULL);
+  reset_visited = newHashtable();
+  reset_evicted = newHashtable();
+
   hookAdd("reset_zone", zone_reset_hook);
   hookAdd("reset_room", room_reset_hook);
+
+  // watch for the things our resets loaded going away
+  hookAddArgs("obj_from_room",  reset_left_hook);
+  hookAddArgs("obj_from_obj",   reset_left_hook);
+  hookAddArgs("obj_from_char",  reset_left_hook);
+  hookAddArgs("obj_from_game",  reset_left_hook);
+  hookAddArgs("char_from_room", reset_left_hook);
+  hookAddArgs("char_from_game", reset_left_hook);
+  hookAddArgs("unequip",        reset_unequip_hook);
+  hookAddArgs("char_to_room",   reset_visit_hook);
+  hookAddArgs("room_evict",     reset_evict_hook);
+  hookAddArgs("room_reload",    reset_reload_hook);
+}
+
+bool resetIsSpawned(void *thing) {
+  return mapIn(reset_spawned, thing);
 }
@@ -36,6 +36,10 @@
 // must be called before room resets are usable. Attaches a reset hook
 void init_room_reset(void);
 
+//
+// was something loaded by its room's resets, and still where they put it?
+bool resetIsSpawned(void *thing);
+
 const char    *resetTypeGetName (int type);
 
 RESET_DATA    *newReset         (void);
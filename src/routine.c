@@ -0,0 +1,291 @@
+//*****************************************************************************
+//
+// routine.c
+//
+// the steps characters go through over time. See routine.h. Routines wait
+// on a timing wheel with one slot per pulse. Those that are due more than
+// one turn of the wheel away count down the turns they have left each time
+// their slot comes up. Each routine keeps the node it is on, so it can be
+// taken off of the wheel without searching for it.
+//
+//*****************************************************************************
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "handler.h"
+#include "action.h"
+#include "event.h"
+#include "hooks.h"
+#include "routine.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how many pulses one turn of the wheel is
+#define ROUTINE_WHEEL_SLOTS     512
+
+typedef struct {
+  CHAR_DATA       *ch;
+  int              id; // tells routines apart, if one replaces another
+  ROUTINE_STEP *steps;
+  int       num_steps;
+  int            step; // the step we do next
+  bool         repeat;
+  ROUTINE_CHECK check;
+  void   *check_data;
+  void (* free_data)(void *data);
+  int            slot; // where we wait on the wheel...
+  int           turns; // how many more times our slot comes up first...
+  LIST_NODE     *node; // and where in the slot we are, or NULL if we're due
+} ROUTINE_DATA;
+
+typedef struct {
+  ROUTINE_CHECK check;
+  void          *data;
+} ROUTINE_CHECK_DATA;
+
+LIST *routine_wheel[ROUTINE_WHEEL_SLOTS];
+int   routine_cursor = 0;
+
+// everyone that has a routine -> their ROUTINE_DATA
+MAP *routine_table = NULL;
+
+// the checks every routine makes before a step
+LIST *routine_checks = NULL;
+
+// the id the next routine gets
+int next_routine_id = 1;
+
+// the tick event belongs to this
+int routine_owner = 0;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// wait on the wheel for delay pulses
+void routine_schedule(ROUTINE_DATA *routine, int delay) {
+  delay          = MAX(1, delay);
+  routine->slot  = (routine_cursor + delay) % ROUTINE_WHEEL_SLOTS;
+  routine->turns = (delay - 1) / ROUTINE_WHEEL_SLOTS;
+  routine->node  = listQueueNode(routine_wheel[routine->slot], routine);
+}
+
+void routine_unschedule(ROUTINE_DATA *routine) {
+  if(routine->node != NULL) {
+    listRemoveNode(routine_wheel[routine->slot], routine->node);
+    routine->node = NULL;
+  }
+}
+
+void deleteRoutine(ROUTINE_DATA *routine) {
+  int i;
+  routine_unschedule(routine);
+  for(i = 0; i < routine->num_steps; i++) {
+    if(routine->steps[i].cmd)
+      free(routine->steps[i].cmd);
+    if(routine->steps[i].data && routine->free_data)
+      routine->free_data(routine->steps[i].data);
+  }
+  if(routine->check_data && routine->free_data)
+    routine->free_data(routine->check_data);
+  if(routine->steps)
+    free(routine->steps);
+  free(routine);
+}
+
+//
+// is the character's routine still the one we were running? Steps and
+// checks can change or end it, or take the character out of the game
+bool routine_still(CHAR_DATA *ch, int uid, int id) {
+  ROUTINE_DATA *routine = NULL;
+  return (propertyTableGet(mob_table, uid) == ch &&
+	  (routine = mapGet(routine_table, ch)) != NULL && routine->id == id);
+}
+
+//
+// should the routine wait before doing its next step?
+bool routine_held(ROUTINE_DATA *routine) {
+  CHAR_DATA *ch = routine->ch;
+  int       uid = charGetUID(ch);
+  int        id = routine->id;
+  if(is_acting(ch, 1))
+    return TRUE;
+
+  LIST_ITERATOR *chk_i = newListIterator(routine_checks);
+  ROUTINE_CHECK_DATA *chk = NULL;
+  bool             held = FALSE;
+  ITERATE_LIST(chk, chk_i) {
+    if(chk->check(ch, chk->data) || !routine_still(ch, uid, id)) {
+      held = TRUE;
+      break;
+    }
+  } deleteListIterator(chk_i);
+
+  if(!held && routine->check != NULL)
+    held = routine->check(ch, routine->check_data);
+  return held;
+}
+
+//
+// do the routine's next step, if nothing holds it, and wait for the next
+void routine_step(ROUTINE_DATA *routine) {
+  CHAR_DATA *ch = routine->ch;
+  int       uid = charGetUID(ch);
+  int        id = routine->id;
+
+  bool held = routine_held(routine);
+  if(!routine_still(ch, uid, id) || routine->node != NULL)
+    return;
+  else if(held) {
+    routine_schedule(routine, routine->steps[routine->step].delay);
+    return;
+  }
+
+  ROUTINE_STEP *step = &routine->steps[routine->step];
+  if(++routine->step == routine->num_steps && routine->repeat)
+    routine->step = 0;
+
+  if(step->cmd != NULL) {
+    // commands can't be done without a room to do them in, and do_cmd is
+    // allowed to change what it's given
+    if(charGetRoom(ch) != NULL) {
+      char buf[MAX_BUFFER];
+      snprintf(buf, sizeof(buf), "%s", step->cmd);
+      do_cmd(ch, buf, FALSE);
+    }
+  }
+  else if(step->func != NULL)
+    step->func(ch, step->data);
+
+  // the step may have done away with us
+  if(!routine_still(ch, uid, id) || routine->node != NULL)
+    return;
+  if(routine->step < routine->num_steps)
+    routine_schedule(routine, routine->steps[routine->step].delay);
+  else
+    charClearRoutine(ch);
+}
+
+//
+// turn the wheel one slot, and do the steps of everyone who is due. Who is
+// due is collected first, since their steps can change the wheel under us
+void routine_tick(void *owner, void *data, const char *arg) {
+  routine_cursor = (routine_cursor + 1) % ROUTINE_WHEEL_SLOTS;
+  LIST *slot = routine_wheel[routine_cursor];
+  if(listSize(slot) == 0)
+    return;
+
+  LIST                *due = newList();
+  LIST_ITERATOR *routine_i = newListIterator(slot);
+  ROUTINE_DATA    *routine = NULL;
+  ITERATE_LIST(routine, routine_i) {
+    if(routine->turns > 0)
+      routine->turns--;
+    else
+      listQueue(due, routine);
+  } deleteListIterator(routine_i);
+
+  // take them all off the wheel, and remember who they are by UID and id, so
+  // we can tell if one of them is done away with by an earlier one's step
+  LIST *ids = newList();
+  while((routine = listPop(due)) != NULL) {
+    routine_unschedule(routine);
+    int *uid_id = malloc(sizeof(int) * 2);
+    uid_id[0] = charGetUID(routine->ch);
+    uid_id[1] = routine->id;
+    listQueue(ids, uid_id);
+  }
+  deleteList(due);
+
+  int *uid_id = NULL;
+  while((uid_id = listPop(ids)) != NULL) {
+    CHAR_DATA *ch = propertyTableGet(mob_table, uid_id[0]);
+    if(ch != NULL && routine_still(ch, uid_id[0], uid_id[1]) &&
+       (routine = mapGet(routine_table, ch))->node == NULL)
+      routine_step(routine);
+    free(uid_id);
+  }
+  deleteList(ids);
+}
+
+//
+// routines end when the character leaves the game
+void routine_from_game_hook(HOOK_ARGS *args) {
+  CHAR_DATA *ch = NULL;
+  hookParseArgs(args, &ch);
+  charClearRoutine(ch);
+}
+
+
+
+//*****************************************************************************
+// implementation of routine.h
+//*****************************************************************************
+void init_routines(void) {
+  int i;
+  for(i = 0; i < ROUTINE_WHEEL_SLOTS; i++)
+    routine_wheel[i] = newList();
+  routine_table  = newMap(NULL, NULL);
+  routine_checks = newList();
+  hookAddArgs("char_from_game", routine_from_game_hook);
+  start_update(&routine_owner, 1, routine_tick, NULL, NULL, NULL);
+}
+
+void charSetRoutine(CHAR_DATA *ch, const ROUTINE_STEP *steps, int num_steps,
+		    bool repeat, ROUTINE_CHECK check, void *check_data,
+		    void (* free_data)(void *data)) {
+  int i;
+  charClearRoutine(ch);
+
+  ROUTINE_DATA *routine = calloc(1, sizeof(ROUTINE_DATA));
+  routine->ch         = ch;
+  routine->id         = next_routine_id++;
+  routine->num_steps  = MAX(0, num_steps);
+  routine->steps      = calloc(MAX(1, routine->num_steps),sizeof(ROUTINE_STEP));
+  routine->repeat     = repeat;
+  routine->check      = check;
+  routine->check_data = check_data;
+  routine->free_data  = free_data;
+  for(i = 0; i < routine->num_steps; i++) {
+    routine->steps[i]     = steps[i];
+    routine->steps[i].cmd = (steps[i].cmd ? strdup(steps[i].cmd) : NULL);
+  }
+
+  // routines with nothing to do are done before they start
+  if(routine->num_steps == 0)
+    deleteRoutine(routine);
+  else {
+    mapPut(routine_table, ch, routine);
+    routine_schedule(routine, routine->steps[0].delay);
+  }
+}
+
+void charClearRoutine(CHAR_DATA *ch) {
+  ROUTINE_DATA *routine = mapRemove(routine_table, ch);
+  if(routine != NULL)
+    deleteRoutine(routine);
+}
+
+int charGetRoutineStep(CHAR_DATA *ch) {
+  ROUTINE_DATA *routine = mapGet(routine_table, ch);
+  return (routine ? routine->step : -1);
+}
+
+void routineAddCheck(ROUTINE_CHECK check, void *data) {
+  ROUTINE_CHECK_DATA *chk = malloc(sizeof(ROUTINE_CHECK_DATA));
+  chk->check = check;
+  chk->data  = data;
+  listQueue(routine_checks, chk);
+}
+
+int count_routines(void) {
+  return mapSize(routine_table);
+}
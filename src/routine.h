@@ -0,0 +1,64 @@
+#ifndef __ROUTINE_H
+#define __ROUTINE_H
+//*****************************************************************************
+//
+// routine.h
+//
+// routines are lists of steps that NPCs (or anyone) go through, one at a
+// time, with a delay before each one: walking a path, forging a sword,
+// singing the verses of a song. A step is either a command the character
+// does, or a function that is called with them. Routines can repeat once
+// they reach their end.
+//
+// Everyone's routines wait on one timing wheel, ticked every pulse, instead
+// of each having an event of their own. Before a step is done, a check is
+// made that the character isn't busy acting, along with any checks added
+// with routineAddCheck, and any the routine was given. If one of them says
+// no, the step waits another delay and tries again.
+//
+//*****************************************************************************
+
+// what functions routines are handed for their steps and checks look like.
+// Checks return TRUE if the step should NOT be done yet
+typedef void (* ROUTINE_FUNC)(CHAR_DATA *ch, void *data);
+typedef bool (* ROUTINE_CHECK)(CHAR_DATA *ch, void *data);
+
+typedef struct {
+  int        delay; // in pulses, before the step is done
+  char        *cmd; // a command for the character to do, or NULL...
+  ROUTINE_FUNC func; // or a function to call with them,
+  void       *data; // and what it is called with
+} ROUTINE_STEP;
+
+//
+// start ticking routines
+void init_routines(void);
+
+//
+// give someone a routine, and start it. Anything they were doing before is
+// stopped. The steps are copied (commands along with them), but step data
+// and check_data is taken over, and handed to free_data once the routine is
+// done with it. check and check_data can be NULL; so can free_data if there
+// is no data to free
+void charSetRoutine(CHAR_DATA *ch, const ROUTINE_STEP *steps, int num_steps,
+		    bool repeat, ROUTINE_CHECK check, void *check_data,
+		    void (* free_data)(void *data));
+
+//
+// stop someone's routine, if they have one
+void charClearRoutine(CHAR_DATA *ch);
+
+//
+// the step someone's routine is on next, or -1 if they have no routine
+int  charGetRoutineStep(CHAR_DATA *ch);
+
+//
+// a check that is made before anyone's routine does a step. data is handed
+// to the check, and never freed
+void routineAddCheck(ROUTINE_CHECK check, void *data);
+
+//
+// how many routines are running
+int count_routines(void);
+
+#endif // __ROUTINE_H
@@ -7,6 +7,9 @@
 //
 //*****************************************************************************
 
+#include <dirent.h>
+#include <sys/stat.h>
+
 #include "mud.h"
 #include "utils.h"
 #include "socket.h"
@@ -18,6 +21,10 @@
 #include "object.h"
 #include "room.h"
 #include "storage.h"
+#include "save_queue.h"
+#include "journal.h"
+#include "hooks.h"
+#include "stats.h"
 #include "save.h"
 
 
@@ -33,12 +40,18 @@ HASHTABLE *player_table  = NULL;
 typedef struct {
   int refcnt;
   void *data;
+  long  size; // about how many bytes the files we were loaded from have
+  bool cache; // can we be cached once we have no references?
+  LIST_NODE *node; // where we are in the cache, if we're in it
 } SAVE_REF_DATA;
 
 SAVE_REF_DATA *newSaveRefData(void *data) {
   SAVE_REF_DATA *ref_data = malloc(sizeof(SAVE_REF_DATA));
   ref_data->refcnt = 1;
   ref_data->data   = data;
+  ref_data->size   = 0;
+  ref_data->cache  = TRUE;
+  ref_data->node   = NULL;
   return ref_data;
 }
 
@@ -46,6 +59,110 @@ void deleteSaveRefData(SAVE_REF_DATA *ref_data) {
   free(ref_data);
 }
 
+//
+// players and accounts that have lost all of their references are kept around
+// for a while, in case a script wants them again soon. They stay in their
+// table with a reference count of 0, and are kept on a list with the most
+// recently used at the front. Once there are too many of them, or they take
+// up too much memory, the least recently used ones are deleted
+typedef struct {
+  HASHTABLE     *table; // the table of references they are kept in
+  LIST            *lru; // SAVE_REF_DATA, newest first
+  long           bytes; // how much their files took up on disk, together
+  void (* deleter)(void *data);
+  const char *(* namer)(void *data);
+} SAVE_CACHE;
+
+SAVE_CACHE player_cache  = { NULL, NULL, 0, NULL, NULL };
+SAVE_CACHE account_cache = { NULL, NULL, 0, NULL, NULL };
+
+//
+// how big a file is, or 0 if it doesn't exist
+long save_file_size(const char *fname) {
+  struct stat st;
+  return (stat(fname, &st) == 0 ? st.st_size : 0);
+}
+
+//
+// delete a cached reference for good
+void save_cache_drop(SAVE_CACHE *cache, SAVE_REF_DATA *ref_data) {
+  listRemoveNode(cache->lru, ref_data->node);
+  cache->bytes -= ref_data->size;
+  hashRemove(cache->table, cache->namer(ref_data->data));
+  cache->deleter(ref_data->data);
+  deleteSaveRefData(ref_data);
+}
+
+//
+// a reference has lost its last user. Cache it, and then throw out the oldest
+// cached references until we're within our limits
+void save_cache_put(SAVE_CACHE *cache, SAVE_REF_DATA *ref_data) {
+  int  max_size = mudsettingGetInt("save_cache_size");
+  long max_bytes = (long)mudsettingGetInt("save_cache_kb") * 1024;
+  ref_data->node = listPutNode(cache->lru, ref_data);
+  cache->bytes  += ref_data->size;
+  if(!ref_data->cache)
+    save_cache_drop(cache, ref_data);
+  while(listSize(cache->lru) > 0 &&
+	(listSize(cache->lru) > max_size || cache->bytes > max_bytes))
+    save_cache_drop(cache, listTail(cache->lru));
+}
+
+//
+// a cached reference is wanted again. Take it off our list
+void save_cache_take(SAVE_CACHE *cache, SAVE_REF_DATA *ref_data) {
+  listRemoveNode(cache->lru, ref_data->node);
+  ref_data->node = NULL;
+  cache->bytes  -= ref_data->size;
+}
+
+//
+// something with our name is being saved. If it isn't the copy we have
+// cached, our copy is out of date
+void save_cache_saved(SAVE_CACHE *cache, const char *name, void *data) {
+  SAVE_REF_DATA *ref_data = hashGet(cache->table, name);
+  if(ref_data != NULL && ref_data->refcnt == 0 && ref_data->data != data)
+    save_cache_drop(cache, ref_data);
+}
+
+void save_delete_char(void *data) {
+  deleteChar(data);
+}
+
+void save_delete_account(void *data) {
+  deleteAccount(data);
+}
+
+const char *save_char_name(void *data) {
+  return charGetName(data);
+}
+
+const char *save_account_name(void *data) {
+  return accountGetName(data);
+}
+
+// where the index of every player and account is kept
+#define SAVE_INDEX_FILE       "%s/players/index"
+
+// every player and account that has been registered, so we can tell who
+// exists without going to the disk. name -> SAVE_INDEX_ENTRY
+HASHTABLE *player_index  = NULL;
+HASHTABLE *account_index = NULL;
+
+typedef struct {
+  char        *name; // with the capitalization its file has
+  char     *account; // the account a player belongs to, if we know it
+  long   last_login; // when a player last entered the game
+} SAVE_INDEX_ENTRY;
+
+SAVE_INDEX_ENTRY *newSaveIndexEntry(const char *name) {
+  SAVE_INDEX_ENTRY *entry = malloc(sizeof(SAVE_INDEX_ENTRY));
+  entry->name       = strdup(name);
+  entry->account    = strdup("");
+  entry->last_login = 0;
+  return entry;
+}
+
 
 
 //*****************************************************************************
@@ -89,6 +206,154 @@ const char *get_save_filename(const char *name, int filetype) {
   return buf;
 }
 
+//
+// queue a set up to be written to the file for the given name and file type
+void save_write(STORAGE_SET *set, const char *name, int filetype,
+		const char *type) {
+  saveQueuePut(set, get_save_filename(name, filetype),
+	       storage_type_format(type));
+}
+
+//
+// read the file for the given name and file type, once any save of it that
+// is waiting to be written has been
+STORAGE_SET *save_read(const char *name, int filetype) {
+  const char *fname = get_save_filename(name, filetype);
+  saveQueueWaitFor(fname);
+  return storage_read(fname);
+}
+
+//
+// write the index out. It's small, and only changes when someone registers,
+// logs in, or has their account saved, so the whole thing is written each time
+void save_index_write(void) {
+  STORAGE_SET           *set = new_storage_set();
+  STORAGE_SET_LIST  *players = new_storage_list();
+  STORAGE_SET_LIST *accounts = new_storage_list();
+  HASH_ITERATOR      *hash_i = newHashIterator(player_index);
+  const char            *key = NULL;
+  SAVE_INDEX_ENTRY    *entry = NULL;
+  char                 fname[MAX_BUFFER];
+
+  ITERATE_HASH(key, entry, hash_i) {
+    STORAGE_SET *one = new_storage_set();
+    store_string(one, "name",       entry->name);
+    store_string(one, "account",    entry->account);
+    store_long  (one, "last_login", entry->last_login);
+    storage_list_put(players, one);
+  } deleteHashIterator(hash_i);
+
+  hash_i = newHashIterator(account_index);
+  ITERATE_HASH(key, entry, hash_i) {
+    STORAGE_SET *one = new_storage_set();
+    store_string(one, "name", entry->name);
+    storage_list_put(accounts, one);
+  } deleteHashIterator(hash_i);
+
+  store_list(set, "players",  players);
+  store_list(set, "accounts", accounts);
+  snprintf(fname, MAX_BUFFER, SAVE_INDEX_FILE, MUDLIB_PATH);
+  saveQueuePut(set, fname, storage_type_format("index"));
+}
+
+//
+// add everyone with a file in dir (one folder for each letter) and the given
+// extension to an index. Used to build the index when there isn't one yet
+void save_index_scan(HASHTABLE *index, const char *dir, const char *ext) {
+  char path[MAX_BUFFER];
+  char letter;
+  for(letter = 'A'; letter <= 'Z'; letter++) {
+    snprintf(path, MAX_BUFFER, "%s/%s/%c", MUDLIB_PATH, dir, letter);
+    DIR *d = opendir(path);
+    struct dirent *file = NULL;
+    if(d == NULL)
+      continue;
+    for(file = readdir(d); file; file = readdir(d)) {
+      if(startswith(file->d_name, ".") || !endswith(file->d_name, ext))
+	continue;
+      int len = strlen(file->d_name) - strlen(ext);
+      char name[len + 1];
+      strncpy(name, file->d_name, len);
+      name[len] = '\0';
+      hashPut(index, name, newSaveIndexEntry(name));
+    }
+    closedir(d);
+  }
+}
+
+//
+// load up the index of players and accounts, or build it from the player
+// and account files if it doesn't exist
+void init_save_index(void) {
+  char fname[MAX_BUFFER];
+  STORAGE_SET *set = NULL;
+  player_index  = newHashtable();
+  account_index = newHashtable();
+  snprintf(fname, MAX_BUFFER, SAVE_INDEX_FILE, MUDLIB_PATH);
+
+  if((set = storage_read(fname)) == NULL) {
+    log_string("No player index found. Building one.");
+    save_index_scan(player_index,  "players/pfiles", ".pfile");
+    save_index_scan(account_index, "accounts",       ".acct");
+    save_index_write();
+    return;
+  }
+
+  STORAGE_SET_LIST *list = read_list(set, "players");
+  STORAGE_SET      *one  = NULL;
+  while((one = storage_list_next(list)) != NULL) {
+    SAVE_INDEX_ENTRY *entry = newSaveIndexEntry(read_string(one, "name"));
+    free(entry->account);
+    entry->account    = strdup(read_string(one, "account"));
+    entry->last_login = read_long(one, "last_login");
+    hashPut(player_index, entry->name, entry);
+  }
+  list = read_list(set, "accounts");
+  while((one = storage_list_next(list)) != NULL) {
+    SAVE_INDEX_ENTRY *entry = newSaveIndexEntry(read_string(one, "name"));
+    hashPut(account_index, entry->name, entry);
+  }
+  storage_close(set);
+}
+
+//
+// note that each of an account's characters belongs to it
+void save_index_account(ACCOUNT_DATA *account) {
+  LIST_ITERATOR *name_i = newListIterator(accountGetChars(account));
+  const char      *name = NULL;
+  bool          changed = FALSE;
+  ITERATE_LIST(name, name_i) {
+    SAVE_INDEX_ENTRY *entry = hashGet(player_index, name);
+    if(entry != NULL && strcasecmp(entry->account, accountGetName(account))) {
+      free(entry->account);
+      entry->account = strdup(accountGetName(account));
+      changed        = TRUE;
+    }
+  } deleteListIterator(name_i);
+  if(changed)
+    save_index_write();
+}
+
+//
+// players entering the game have their last login updated
+void save_index_login_hook(HOOK_ARGS *args) {
+  CHAR_DATA *ch = NULL;
+  hookParseArgs(args, &ch);
+  SAVE_INDEX_ENTRY *entry = (charIsNPC(ch) ? NULL :
+			     hashGet(player_index, charGetName(ch)));
+  SAVE_REF_DATA *ref_data = (charIsNPC(ch) ? NULL :
+			     hashGet(player_table, charGetName(ch)));
+
+  // players who have been in the game pick up all sorts of state that a
+  // freshly loaded player does not have, so they are never cached
+  if(ref_data != NULL && ref_data->data == ch)
+    ref_data->cache = FALSE;
+  if(entry != NULL) {
+    entry->last_login = current_time;
+    save_index_write();
+  }
+}
+
 bool player_creating(const char *name) {
   // a player is being created if it's attached to a socket and does not exist
   bool char_found       = FALSE;
@@ -124,32 +389,43 @@ bool account_creating(const char *name) {
 }
 
 bool player_exists(const char *name) {
-  // there's two ways a character can exists. Either someone is already making
-  // a character with that name, or there is a character with that name in
-  // storage. We'll check both of these.
-  const char *fname = get_save_filename(name, FILETYPE_PFILE);
-  return file_exists(fname);
+  // everyone who has been registered is in the index
+  return hashIn(player_index, name);
 }
 
 bool account_exists(const char *name) {
-  const char *fname = get_save_filename(name, FILETYPE_ACCOUNT);
-  return file_exists(fname);
+  return hashIn(account_index, name);
+}
+
+const char *player_account(const char *name) {
+  SAVE_INDEX_ENTRY *entry = hashGet(player_index, name);
+  return (entry ? entry->account : "");
+}
+
+time_t player_last_login(const char *name) {
+  SAVE_INDEX_ENTRY *entry = hashGet(player_index, name);
+  return (entry ? (time_t)entry->last_login : 0);
 }
 
 void save_pfile(CHAR_DATA *ch) {
+  // everything in the journal up to now is in the pfile. Once it is on disk,
+  // the journal can let go of it
   STORAGE_SET *set = charStore(ch);
-  storage_write(set, get_save_filename(charGetName(ch), FILETYPE_PFILE));
-  storage_close(set);
+  long         seq = journalGetSeq();
+  store_long(set, "journal_seq", seq);
+  saveQueuePutThen(set, get_save_filename(charGetName(ch), FILETYPE_PFILE),
+		   storage_type_format("pfile"), journalSaved, charGetName(ch),
+		   seq);
 }
 
 void load_ofile(CHAR_DATA *ch) {
-  STORAGE_SET *set = storage_read(get_save_filename(charGetName(ch), 
-						    FILETYPE_OFILE));
+  STORAGE_SET *set = save_read(charGetName(ch), FILETYPE_OFILE);
   if(set == NULL)
     return;
 
   STORAGE_SET   *obj_set = NULL;
   OBJ_DATA          *obj = NULL;
+  bool          equipped = FALSE;
 
   // inventory first
   STORAGE_SET_LIST *list = read_list(set, "inventory");
@@ -158,15 +434,24 @@ void load_ofile(CHAR_DATA *ch) {
     obj_to_char(obj, ch);
   }
 
-  // and then equipped items
+  // then equipped items go straight onto the body, where they were saved as
+  // being. What the character wears only has to be worked out again once,
+  // after everything is on. Anything that doesn't fit anymore is carried
   list = read_list(set, "equipment");
   while( (obj_set = storage_list_next(list)) != NULL) {
-    if(storage_contains(obj_set, "object")) {
-      obj = objRead(read_set(obj_set, "object"));
-      if(!do_equip(ch, obj, read_string(obj_set, "equipped"), TRUE))
-	obj_to_char(obj, ch);
+    if(!storage_contains(obj_set, "object"))
+      continue;
+    obj = objRead(read_set(obj_set, "object"));
+    if(bodyEquipPosnamesEx(charGetBody(ch), obj, 
+			   read_string(obj_set, "equipped"), "worn", FALSE)) {
+      objSetWearer(obj, ch);
+      equipped = TRUE;
     }
+    else
+      obj_to_char(obj, ch);
   }
+  if(equipped)
+    charForgetDerivedOn(ch, DERIVED_ON_EQUIPMENT);
 
   storage_close(set);
 }
@@ -179,36 +464,40 @@ void save_objfile(CHAR_DATA *ch) {
   // for equipped items, it's not so easy - we also have to record
   // whereabouts on the body the equipment was worn on
   STORAGE_SET_LIST *list = new_storage_list();
-  LIST *eq_list = bodyGetAllEq(charGetBody(ch));
-  OBJ_DATA *obj = NULL;
-  while((obj = listPop(eq_list)) != NULL) {
+  LIST_ITERATOR *eq_i = newListIterator(bodyGetEqList(charGetBody(ch)));
+  OBJ_DATA       *obj = NULL;
+  ITERATE_LIST(obj, eq_i) {
     STORAGE_SET *eq_set = new_storage_set();
     store_string(eq_set, "equipped", bodyEquippedWhere(charGetBody(ch), obj));
     store_set   (eq_set, "object",   objStore(obj));
     storage_list_put(list, eq_set);
   }
-  deleteList(eq_list);
+  deleteListIterator(eq_i);
 
   store_list(set, "equipment", list);
-  storage_write(set, get_save_filename(charGetName(ch), FILETYPE_OFILE));
-  storage_close(set);
+  save_write(set, charGetName(ch), FILETYPE_OFILE, "ofile");
 }
 
 CHAR_DATA *load_player(const char *player) {
-  STORAGE_SET *set = storage_read(get_save_filename(player, FILETYPE_PFILE));
+  if(!player_exists(player))
+    return NULL;
+  STORAGE_SET *set = save_read(player, FILETYPE_PFILE);
   if(set == NULL)
     return NULL;
   else {
     CHAR_DATA   *ch  = charRead(set);
+    long         seq = read_long(set, "journal_seq");
     storage_close(set);
+    journalReplay(ch, seq);
     load_ofile(ch);
     return ch;
   }
 }
 
 ACCOUNT_DATA *load_account(const char *account) {
-  STORAGE_SET   *set = storage_read(get_save_filename(account,
-						      FILETYPE_ACCOUNT));
+  if(!account_exists(account))
+    return NULL;
+  STORAGE_SET   *set = save_read(account, FILETYPE_ACCOUNT);
   if(set == NULL)
     return NULL;
   else {
@@ -225,6 +514,18 @@ ACCOUNT_DATA *load_account(const char *account) {
 void init_save(void) {
   account_table = newHashtable();
   player_table  = newHashtable();
+  init_save_queue();
+  init_save_index();
+
+  player_cache.table    = player_table;
+  player_cache.lru      = newList();
+  player_cache.deleter  = save_delete_char;
+  player_cache.namer    = save_char_name;
+  account_cache.table   = account_table;
+  account_cache.lru     = newList();
+  account_cache.deleter = save_delete_account;
+  account_cache.namer   = save_account_name;
+  hookAddArgs("char_to_game", save_index_login_hook);
 }
 
 ACCOUNT_DATA *get_account(const char *account) {
@@ -236,12 +537,17 @@ ACCOUNT_DATA *get_account(const char *account) {
     if(acct == NULL)
       return NULL;
     else {
-      hashPut(account_table, account, newSaveRefData(acct));
+      ref_data       = newSaveRefData(acct);
+      ref_data->size = save_file_size(get_save_filename(account,
+							FILETYPE_ACCOUNT));
+      hashPut(account_table, account, ref_data);
       return acct;
     }
   }
   // up our reference count and return
   else {
+    if(ref_data->refcnt == 0)
+      save_cache_take(&account_cache, ref_data);
     ref_data->refcnt++;
     return ref_data->data;
   }
@@ -256,12 +562,18 @@ CHAR_DATA *get_player(const char *player) {
     if(ch == NULL)
       return NULL;
     else {
-      hashPut(player_table, player, newSaveRefData(ch));
+      ref_data       = newSaveRefData(ch);
+      ref_data->size =
+	save_file_size(get_save_filename(player, FILETYPE_PFILE)) +
+	save_file_size(get_save_filename(player, FILETYPE_OFILE));
+      hashPut(player_table, player, ref_data);
       return ch;
     }
   }
   // up our reference count and return
   else {
+    if(ref_data->refcnt == 0)
+      save_cache_take(&player_cache, ref_data);
     ref_data->refcnt++;
     return ref_data->data;
   }
@@ -275,11 +587,8 @@ void unreference_account(ACCOUNT_DATA *account) {
   else {
     ref_data->refcnt--;
     // are we at 0 references?
-    if(ref_data->refcnt == 0) {
-      hashRemove(account_table, accountGetName(account));
-      deleteAccount(account);
-      deleteSaveRefData(ref_data);
-    }
+    if(ref_data->refcnt == 0)
+      save_cache_put(&account_cache, ref_data);
   }
 }
 
@@ -291,11 +600,8 @@ void unreference_player(CHAR_DATA *ch) {
   else {
     ref_data->refcnt--;
     // are we at 0 references?
-    if(ref_data->refcnt == 0) {
-      hashRemove(player_table, charGetName(ch));
-      deleteChar(ch);
-      deleteSaveRefData(ref_data);
-    }
+    if(ref_data->refcnt == 0)
+      save_cache_put(&player_cache, ref_data);
   }
 }
 
@@ -305,8 +611,11 @@ void reference_account(ACCOUNT_DATA *account) {
   if(ref_data == NULL)
     log_string("ERROR: Tried referencing account '%s' that is not loaded!",
 	       accountGetName(account));
-  else
+  else {
+    if(ref_data->refcnt == 0)
+      save_cache_take(&account_cache, ref_data);
     ref_data->refcnt++;
+  }
 }
 
 void reference_player(CHAR_DATA *ch) {
@@ -314,8 +623,11 @@ void reference_player(CHAR_DATA *ch) {
   if(ref_data == NULL)
     log_string("ERROR: Tried referencing player '%s' that is not loaded!",
 	       charGetName(ch));
-  else
+  else {
+    if(ref_data->refcnt == 0)
+      save_cache_take(&player_cache, ref_data);
     ref_data->refcnt++;
+  }
 }
 
 void register_account(ACCOUNT_DATA *account) {
@@ -324,7 +636,10 @@ void register_account(ACCOUNT_DATA *account) {
 	       accountGetName(account));
   else {
     hashPut(account_table, accountGetName(account), newSaveRefData(account));
+    hashPut(account_index, accountGetName(account),
+	    newSaveIndexEntry(accountGetName(account)));
     save_account(account);
+    save_index_write();
   }
 }
 
@@ -334,20 +649,29 @@ void register_player(CHAR_DATA *ch) {
 	       charGetName(ch));
   else {
     hashPut(player_table, charGetName(ch), newSaveRefData(ch));
+    hashPut(player_index, charGetName(ch), newSaveIndexEntry(charGetName(ch)));
     save_player(ch);
+    save_index_write();
   }
 }
 
 void save_account(ACCOUNT_DATA *account) {
   if(!account) return;
-  STORAGE_SET *set = accountStore(account);
-  storage_write(set, get_save_filename(accountGetName(account),
-				       FILETYPE_ACCOUNT));
-  storage_close(set);
+  save_cache_saved(&account_cache, accountGetName(account), account);
+  save_write(accountStore(account), accountGetName(account), FILETYPE_ACCOUNT,
+	     "account");
+  save_index_account(account);
+}
+
+void save_player_objects(const char *player) {
+  SAVE_REF_DATA *ref_data = hashGet(player_table, player);
+  if(ref_data != NULL)
+    save_objfile(ref_data->data);
 }
 
 void save_player(CHAR_DATA *ch) {
   if (ch == NULL) return;
+  save_cache_saved(&player_cache, charGetName(ch), ch);
 
   // make sure we have a UID for the character before we start saving
   if(charGetUID(ch) == NOBODY) {
@@ -42,9 +42,25 @@ void      register_player(CHAR_DATA    *ch);
 void         save_account(ACCOUNT_DATA *account);
 void          save_player(CHAR_DATA    *ch);
 
+//
+// save just the objects of a player, if they are loaded. The journal uses
+// this to save players whose inventory or equipment has changed
+void  save_player_objects(const char *player);
+
+//
+// whether a player or account has been registered. These are answered from
+// an index of everyone, kept in memory and in lib/players/index, so they never
+// go to the disk. If the index file is deleted, it is rebuilt from the player
+// and account files at the next boot
 bool       account_exists(const char *name);
 bool        player_exists(const char *name);
 
+//
+// what we know about a player without loading them: the account they belong
+// to ("" if we don't know), and when they last entered the game (0 if never)
+const char *player_account(const char *name);
+time_t   player_last_login(const char *name);
+
 bool     account_creating(const char *name);
 bool      player_creating(const char *name);
 
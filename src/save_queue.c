@@ -0,0 +1,256 @@
+//*****************************************************************************
+//
+// save_queue.c
+//
+// a write-behind queue for storage sets. See save_queue.h for how it is used.
+// Waiting saves are kept in the order they were queued, and in a table keyed
+// by filename so a newer save of the same file can take the place of one that
+// hasn't been written yet. A save is taken out of the table when the writer
+// starts on it; saving the file again after that queues up a new save.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "storage.h"
+#include "save_queue.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+typedef struct save_job {
+  STORAGE_SET  *set; // what we're writing
+  char       *fname; // where it goes
+  int        format; // and in what storage format
+  void (* func)(const char *key, long arg); // run once it's been written
+  char         *key;
+  long          arg;
+} SAVE_JOB;
+
+// everything below is protected by save_lock
+pthread_mutex_t          save_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t          save_ready = PTHREAD_COND_INITIALIZER; // job queued
+pthread_cond_t           save_done = PTHREAD_COND_INITIALIZER; // job written
+LIST                   *save_queue = NULL; // jobs, in the order they came in
+HASHTABLE            *save_pending = NULL; // fname -> job not yet started on
+SAVE_JOB             *save_writing = NULL; // the job being written right now
+bool                  save_running = FALSE;
+int                 save_coalesced = 0;
+int                   save_written = 0;
+int                    save_failed = 0;
+
+SAVE_JOB *newSaveJob(STORAGE_SET *set, const char *fname, int format) {
+  SAVE_JOB *job = malloc(sizeof(SAVE_JOB));
+  job->set      = set;
+  job->fname    = strdup(fname);
+  job->format   = format;
+  job->func     = NULL;
+  job->key      = NULL;
+  job->arg      = 0;
+  return job;
+}
+
+void deleteSaveJob(SAVE_JOB *job) {
+  if(job->set) storage_close(job->set);
+  if(job->key) free(job->key);
+  free(job->fname);
+  free(job);
+}
+
+//
+// set what a job runs once it has been written
+void save_job_set_func(SAVE_JOB *job, void *func, const char *key, long arg) {
+  if(job->key) free(job->key);
+  job->func = func;
+  job->key  = (key ? strdup(key) : NULL);
+  job->arg  = arg;
+}
+
+//
+// write a set to a file beside fname, make sure it is on the disk, and then
+// move it into place. Returns FALSE if the file could not be written
+bool save_job_write(SAVE_JOB *job) {
+  char tmp[MAX_BUFFER];
+  int   fd = -1;
+  snprintf(tmp, MAX_BUFFER, "%s.tmp", job->fname);
+  if(!storage_write_format(job->set, tmp, job->format) ||
+     (fd = open(tmp, O_RDONLY)) < 0) {
+    unlink(tmp);
+    return FALSE;
+  }
+  if(fsync(fd) != 0 || close(fd) != 0 || rename(tmp, job->fname) != 0) {
+    unlink(tmp);
+    return FALSE;
+  }
+  if(job->func != NULL)
+    job->func(job->key, job->arg);
+  return TRUE;
+}
+
+//
+// our writer must not hold the lock when someone forks, or the child could
+// never take it. The queue's hashtable interns its keys, so this has to be
+// locked before the intern pools are
+void save_atfork_prepare(void) {
+  pthread_mutex_lock(&save_lock);
+}
+
+void save_atfork_release(void) {
+  pthread_mutex_unlock(&save_lock);
+}
+
+//
+// the loop our writer thread runs: take the oldest save, write it, repeat.
+// Sleeps when there is nothing to write
+void *save_queue_loop(void *arg) {
+  SAVE_JOB *job = NULL;
+  pthread_mutex_lock(&save_lock);
+  for(;;) {
+    while(listSize(save_queue) == 0)
+      pthread_cond_wait(&save_ready, &save_lock);
+    job = listPop(save_queue);
+    hashRemove(save_pending, job->fname);
+    save_writing = job;
+    pthread_mutex_unlock(&save_lock);
+
+    bool written = save_job_write(job);
+
+    pthread_mutex_lock(&save_lock);
+    save_writing = NULL;
+    if(written)
+      save_written++;
+    else
+      save_failed++;
+    pthread_cond_broadcast(&save_done);
+    pthread_mutex_unlock(&save_lock);
+
+    // the set is ours alone now, so it can be closed without the lock
+    deleteSaveJob(job);
+    pthread_mutex_lock(&save_lock);
+  }
+  pthread_mutex_unlock(&save_lock);
+  return NULL;
+}
+
+
+
+//*****************************************************************************
+// implementation of save_queue.h
+//*****************************************************************************
+void init_save_queue(void) {
+  pthread_attr_t attr;
+  pthread_t    thread;
+
+  save_queue   = newList();
+  save_pending = newHashtable();
+  pthread_atfork(save_atfork_prepare, save_atfork_release,
+		 save_atfork_release);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if(pthread_create(&thread, &attr, save_queue_loop, NULL) != 0)
+    log_string("Could not start the save writer thread. Players will be "
+	       "saved right away.");
+  else
+    save_running = TRUE;
+  pthread_attr_destroy(&attr);
+}
+
+void saveQueuePut(STORAGE_SET *set, const char *fname, int format) {
+  saveQueuePutThen(set, fname, format, NULL, NULL, 0);
+}
+
+void saveQueuePutThen(STORAGE_SET *set, const char *fname, int format,
+		      void *func, const char *key, long arg) {
+  SAVE_JOB *job = NULL;
+  if(!save_running) {
+    job = newSaveJob(set, fname, format);
+    save_job_set_func(job, func, key, arg);
+    // there is no writer to race for the counters
+    if(save_job_write(job))
+      save_written++;
+    else
+      save_failed++;
+    deleteSaveJob(job);
+    return;
+  }
+
+  pthread_mutex_lock(&save_lock);
+  // if we already have a save of this file waiting, this one replaces it
+  if((job = hashGet(save_pending, fname)) != NULL) {
+    STORAGE_SET *old = job->set;
+    job->set         = set;
+    job->format      = format;
+    save_job_set_func(job, func, key, arg);
+    save_coalesced++;
+    pthread_mutex_unlock(&save_lock);
+    storage_close(old);
+    return;
+  }
+
+  job = newSaveJob(set, fname, format);
+  save_job_set_func(job, func, key, arg);
+  listQueue(save_queue, job);
+  hashPut(save_pending, job->fname, job);
+  pthread_cond_signal(&save_ready);
+  pthread_mutex_unlock(&save_lock);
+}
+
+void saveQueueDetach(void) {
+  // the writer didn't come with us when we were forked
+  save_running = FALSE;
+}
+
+void saveQueueWaitFor(const char *fname) {
+  if(!save_running)
+    return;
+  pthread_mutex_lock(&save_lock);
+  while(hashIn(save_pending, fname) ||
+	(save_writing != NULL && !strcasecmp(save_writing->fname, fname)))
+    pthread_cond_wait(&save_done, &save_lock);
+  pthread_mutex_unlock(&save_lock);
+}
+
+void saveQueueFlush(void) {
+  if(!save_running)
+    return;
+  pthread_mutex_lock(&save_lock);
+  while(listSize(save_queue) > 0 || save_writing != NULL)
+    pthread_cond_wait(&save_done, &save_lock);
+  pthread_mutex_unlock(&save_lock);
+}
+
+int saveQueueGetPending(void) {
+  pthread_mutex_lock(&save_lock);
+  int pending = (save_queue ? listSize(save_queue) : 0) +
+    (save_writing != NULL ? 1 : 0);
+  pthread_mutex_unlock(&save_lock);
+  return pending;
+}
+
+int saveQueueGetCoalesced(void) {
+  pthread_mutex_lock(&save_lock);
+  int coalesced = save_coalesced;
+  pthread_mutex_unlock(&save_lock);
+  return coalesced;
+}
+
+int saveQueueGetWritten(void) {
+  pthread_mutex_lock(&save_lock);
+  int written = save_written;
+  pthread_mutex_unlock(&save_lock);
+  return written;
+}
+
+int saveQueueGetFailed(void) {
+  pthread_mutex_lock(&save_lock);
+  int failed = save_failed;
+  pthread_mutex_unlock(&save_lock);
+  return failed;
+}
@@ -0,0 +1,62 @@
+#ifndef __SAVE_QUEUE_H
+#define __SAVE_QUEUE_H
+//*****************************************************************************
+//
+// save_queue.h
+//
+// a write-behind queue for storage sets. The game thread builds a set and
+// hands it over, and a writer thread of our own turns it into text (or
+// binary), writes it next to where it belongs, syncs it to disk, and renames
+// it into place, so a crash mid-save never leaves a half-written file behind.
+// If a file is saved again before its last save has been written, the newer
+// set replaces the older one, and the file is only written once.
+//
+// Anything that reads a file that might be waiting to be written must call
+// saveQueueWaitFor on it first. Everything must be written out with
+// saveQueueFlush before the mud shuts down or copyovers.
+//
+// Everything here is to be used from the game thread only.
+//
+//*****************************************************************************
+
+//
+// start up the writer thread. If it can't be started, sets are written out
+// right away by saveQueuePut instead
+void init_save_queue(void);
+
+//
+// queue up a set to be written to fname, in the given storage format. The
+// queue takes the set over, and closes it once it has been written
+void saveQueuePut(STORAGE_SET *set, const char *fname, int format);
+
+//
+// the same as saveQueuePut, but once the file is in place, func(key, arg) is
+// called from the writer thread. If a newer save replaces this one before it
+// is written, only the newer save's func is called. func must be thread-safe
+void saveQueuePutThen(STORAGE_SET *set, const char *fname, int format,
+		      void *func, const char *key, long arg);
+
+//
+// for a forked child, which has none of our threads: from now on, sets are
+// written out right away by saveQueuePut, as if the writer never started.
+// Whatever the parent had queued is the parent's to write
+void saveQueueDetach(void);
+
+//
+// wait until fname has no save waiting to be written
+void saveQueueWaitFor(const char *fname);
+
+//
+// wait until every save that has been queued up has been written
+void saveQueueFlush(void);
+
+//
+// how many files are waiting to be written, how many writes have been
+// merged into a later one, how many files have been written, and how many
+// could not be
+int saveQueueGetPending  (void);
+int saveQueueGetCoalesced(void);
+int saveQueueGetWritten  (void);
+int saveQueueGetFailed   (void);
+
+#endif // __SAVE_QUEUE_H
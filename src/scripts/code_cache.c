@@ -0,0 +1,296 @@
+//*****************************************************************************
+//
+// code_cache.c
+//
+// remembers the code objects that script source compiles to. See
+// code_cache.h for more information. Each file on disk holds a header that
+// says which version of Python wrote it, the source and file name the code
+// was compiled from, and then the marshalled code object itself.
+//
+//*****************************************************************************
+
+#include <Python.h>
+#include <marshal.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "pyplugs.h"
+#include "code_cache.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the first thing in every file we write
+#define CODE_FILE_TAG       "NMCODE1"
+
+typedef struct {
+  char  *src;       // what we were compiled from
+  char  *fname;
+  int    start;
+  PyObject *code;
+} CACHED_CODE;
+
+typedef struct {
+  char *data;
+  long   len;
+} CODE_BLOB;
+
+// "key" -> CACHED_CODE. Only used by the game thread
+HASHTABLE *cached_code = NULL;
+
+// "key" -> CODE_BLOB, read in by the warmup thread. Protected by blob_lock
+pthread_mutex_t blob_lock = PTHREAD_MUTEX_INITIALIZER;
+HASHTABLE      *code_blobs = NULL;
+
+// the magic number of the Python we are running, so we never use code
+// marshalled by some other version of it
+long code_magic = 0;
+
+char code_dir[SMALL_BUFFER];
+
+void deleteCachedCode(CACHED_CODE *entry) {
+  Py_XDECREF(entry->code);
+  free(entry->src);
+  free(entry->fname);
+  free(entry);
+}
+
+void deleteCodeBlob(CODE_BLOB *blob) {
+  free(blob->data);
+  free(blob);
+}
+
+//
+// the key source is kept under, in memory and on disk. A 64 bit FNV-1a hash
+// of everything we were compiled from
+void code_cache_key(char *key, const char *src, const char *fname, int start) {
+  unsigned long long hash = 14695981039346656037ULL;
+  const char        *str = NULL;
+  for(str = src;   *str; str++)
+    hash = (hash ^ (unsigned char)*str) * 1099511628211ULL;
+  for(str = fname; *str; str++)
+    hash = (hash ^ (unsigned char)*str) * 1099511628211ULL;
+  sprintf(key, "%016llx%d", hash, start);
+}
+
+//
+// is this the name of one of our files? Our keys are short enough that the
+// hashtable never interns them, which keeps code_blobs safe to fill from the
+// warmup thread. Anything else in the directory is ignored
+bool code_cache_key_ok(const char *name) {
+  int len = strlen(name), i;
+  if(len < 17 || len > 20)
+    return FALSE;
+  for(i = 0; i < len; i++)
+    if(!isxdigit((unsigned char)name[i]))
+      return FALSE;
+  return TRUE;
+}
+
+//
+// read in a whole file. Returns NULL if it can't be read
+CODE_BLOB *read_code_blob(const char *path) {
+  FILE *fl = fopen(path, "rb");
+  if(fl == NULL)
+    return NULL;
+  CODE_BLOB *blob = NULL;
+  struct stat  st;
+  if(fstat(fileno(fl), &st) == 0 && st.st_size > 0) {
+    blob       = malloc(sizeof(CODE_BLOB));
+    blob->len  = st.st_size;
+    blob->data = malloc(blob->len);
+    if(fread(blob->data, 1, blob->len, fl) != (size_t)blob->len) {
+      deleteCodeBlob(blob);
+      blob = NULL;
+    }
+  }
+  fclose(fl);
+  return blob;
+}
+
+//
+// make code out of a blob, if it is the code for what we want compiled.
+// Returns NULL, with no Python error set, if the blob can't be used
+PyObject *code_from_blob(CODE_BLOB *blob, const char *src, const char *fname,
+			 int start) {
+  int      tag_len = strlen(CODE_FILE_TAG) + 1;
+  int      src_len = strlen(src)   + 1;
+  int    fname_len = strlen(fname) + 1;
+  long header_len  = tag_len + sizeof(long) + sizeof(int) + src_len + fname_len;
+  const char  *pos = blob->data;
+  long       magic = 0;
+  int    blob_start = 0;
+
+  if(blob->len <= header_len || strcmp(pos, CODE_FILE_TAG))
+    return NULL;
+  pos += tag_len;
+  memcpy(&magic, pos, sizeof(long));           pos += sizeof(long);
+  memcpy(&blob_start, pos, sizeof(int));       pos += sizeof(int);
+  if(magic != code_magic || blob_start != start)
+    return NULL;
+  if(memcmp(pos, src, src_len))
+    return NULL;
+  pos += src_len;
+  if(memcmp(pos, fname, fname_len))
+    return NULL;
+  pos += fname_len;
+
+  PyObject *code = PyMarshal_ReadObjectFromString(pos, blob->len - header_len);
+  if(code == NULL || !PyCode_Check(code)) {
+    Py_XDECREF(code);
+    PyErr_Clear();
+    return NULL;
+  }
+  return code;
+}
+
+//
+// write code out to disk. We write to a temporary file first, so a file with
+// our name is always a whole one
+void write_code_file(const char *key, PyObject *code, const char *src,
+		     const char *fname, int start) {
+  PyObject *data = PyMarshal_WriteObjectToString(code, Py_MARSHAL_VERSION);
+  if(data == NULL) {
+    PyErr_Clear();
+    return;
+  }
+
+  char path[MAX_BUFFER], tmp[MAX_BUFFER];
+  sprintf(path, "%s/%s", code_dir, key);
+  sprintf(tmp,  "%s/%s.tmp", code_dir, key);
+  FILE *fl = fopen(tmp, "wb");
+  if(fl != NULL) {
+    bool ok =
+      fwrite(CODE_FILE_TAG, 1, strlen(CODE_FILE_TAG) + 1, fl) > 0 &&
+      fwrite(&code_magic, sizeof(long), 1, fl) == 1 &&
+      fwrite(&start, sizeof(int), 1, fl) == 1 &&
+      fwrite(src,   1, strlen(src)   + 1, fl) == strlen(src)   + 1 &&
+      fwrite(fname, 1, strlen(fname) + 1, fl) == strlen(fname) + 1 &&
+      fwrite(PyBytes_AS_STRING(data), 1, PyBytes_GET_SIZE(data), fl) ==
+      (size_t)PyBytes_GET_SIZE(data);
+    if(fclose(fl) != 0 || !ok || rename(tmp, path) != 0)
+      unlink(tmp);
+  }
+  Py_DECREF(data);
+}
+
+//
+// the warmup thread. Reads in every file in our directory, for the game
+// thread to unmarshal when their code is wanted
+void *code_cache_warmup(void *arg) {
+  DIR             *dir = opendir(code_dir);
+  struct dirent *entry = NULL;
+  char   path[MAX_BUFFER];
+
+  if(dir == NULL)
+    return NULL;
+  for(entry = readdir(dir); entry; entry = readdir(dir)) {
+    if(!code_cache_key_ok(entry->d_name))
+      continue;
+    sprintf(path, "%s/%s", code_dir, entry->d_name);
+    CODE_BLOB *blob = read_code_blob(path);
+    if(blob == NULL)
+      continue;
+    pthread_mutex_lock(&blob_lock);
+    if(hashIn(code_blobs, entry->d_name))
+      deleteCodeBlob(blob);
+    else
+      hashPut(code_blobs, entry->d_name, blob);
+    pthread_mutex_unlock(&blob_lock);
+  }
+  closedir(dir);
+  return NULL;
+}
+
+//
+// Python writes .pyc files for our modules under a directory of our own
+void code_cache_pycache(void) {
+  char prefix[MAX_BUFFER];
+  sprintf(prefix, "%s/pycache", code_dir);
+  PyObject *val = PyUnicode_FromString(prefix);
+  if(val == NULL || PySys_SetObject("pycache_prefix", val) != 0 ||
+     PySys_SetObject("dont_write_bytecode", Py_False) != 0) {
+    log_pyerr("Could not set where compiled Python modules are kept");
+  }
+  Py_XDECREF(val);
+}
+
+
+
+//*****************************************************************************
+// implementation of code_cache.h
+//*****************************************************************************
+void init_code_cache(void) {
+  cached_code = newHashtable();
+  code_blobs  = newHashtable();
+  code_magic  = PyImport_GetMagicNumber();
+  sprintf(code_dir, "%s/%s", MUDLIB_PATH, CODE_CACHE_DIR);
+  if(!dir_exists(code_dir))
+    mkdir(code_dir, S_IRWXU | S_IRWXG);
+
+  code_cache_pycache();
+
+  pthread_t warmup;
+  if(pthread_create(&warmup, NULL, code_cache_warmup, NULL) == 0)
+    pthread_detach(warmup);
+  else
+    log_string("Could not start the code cache warmup thread.");
+}
+
+PyObject *cachedCompileString(const char *src, const char *fname, int start) {
+  char key[SMALL_BUFFER];
+  code_cache_key(key, src, fname, start);
+
+  // have we compiled it since we booted?
+  CACHED_CODE *entry = hashGet(cached_code, key);
+  if(entry != NULL && entry->start == start && !strcmp(entry->src, src) &&
+     !strcmp(entry->fname, fname))
+    return Py_NewRef(entry->code);
+
+  // was it read in by our warmup, or is it on disk?
+  pthread_mutex_lock(&blob_lock);
+  CODE_BLOB *blob = hashRemove(code_blobs, key);
+  pthread_mutex_unlock(&blob_lock);
+  if(blob == NULL) {
+    char path[MAX_BUFFER];
+    sprintf(path, "%s/%s", code_dir, key);
+    blob = read_code_blob(path);
+  }
+
+  PyObject *code = NULL;
+  if(blob != NULL) {
+    code = code_from_blob(blob, src, fname, start);
+    deleteCodeBlob(blob);
+  }
+
+  // we have to compile it ourself
+  if(code == NULL) {
+    // scripts may await at their top level, and come back as coroutines
+    PyCompilerFlags flags = _PyCompilerFlags_INIT;
+    flags.cf_flags = PyCF_ALLOW_TOP_LEVEL_AWAIT;
+    code = Py_CompileStringExFlags(src, fname, start, &flags, -1);
+    if(code == NULL)
+      return NULL;
+    write_code_file(key, code, src, fname, start);
+  }
+
+  // remember it for next time. If we're full, start over
+  if(hashSize(cached_code) >= MAX_CACHED_CODE)
+    hashClearWith(cached_code, deleteCachedCode);
+  if((entry = hashRemove(cached_code, key)) != NULL)
+    deleteCachedCode(entry);
+  entry        = malloc(sizeof(CACHED_CODE));
+  entry->src   = strdup(src);
+  entry->fname = strdup(fname);
+  entry->start = start;
+  entry->code  = Py_NewRef(code);
+  hashPut(cached_code, key, entry);
+  return code;
+}
@@ -0,0 +1,42 @@
+#ifndef __CODE_CACHE_H
+#define __CODE_CACHE_H
+//*****************************************************************************
+//
+// code_cache.h
+//
+// remembers the code objects that script source compiles to, so the same
+// source never has to be compiled twice. Code is kept in memory for reuse
+// (reset scripts, for instance, used to be compiled every time they ran), and
+// written to disk so it survives reboots and copyovers. On disk, code is kept
+// in CODE_CACHE_DIR, one file per bit of source, named by a hash of the
+// source and checked against the source itself before it is used. When the
+// mud boots, a background thread reads everything in the directory into
+// memory, so the first run of a trigger after a restart only has to unmarshal
+// its code instead of compiling it. Files written by a different version of
+// Python are ignored, and replaced the next time their source is compiled.
+//
+// Python modules are compiled to .pyc files by Python itself. We point its
+// pycache_prefix at a directory of our own, so this works even if the
+// pymodules directory can't be written to.
+//
+//*****************************************************************************
+
+// where compiled code is kept on disk, under MUDLIB_PATH
+#define CODE_CACHE_DIR      "misc/code_cache"
+
+// how many code objects we keep in memory before we start over
+#define MAX_CACHED_CODE     4096
+
+//
+// set up the cache, set Python up to write .pyc files for our modules, and
+// start reading in what was cached on disk. Must be called after Python is
+// initialized, and before any of our modules are imported
+void init_code_cache(void);
+
+//
+// works like Py_CompileString, but source we have seen before comes back out
+// of the cache. Returns a new reference, or NULL with a Python error set if
+// the source could not be compiled
+PyObject *cachedCompileString(const char *src, const char *fname, int start);
+
+#endif // __CODE_CACHE_H
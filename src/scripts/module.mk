@@ -113,10 +113,22 @@ SRC  += scripts/scripts.c   \
 	scripts/pyplugs.c       \
 	scripts/pyevent.c       \
 	scripts/pystorage.c     \
+	scripts/pylistview.c    \
 	scripts/pyauxiliary.c   \
 	scripts/triggers.c      \
 	scripts/trigedit.c      \
 	scripts/trighooks.c     \
+	scripts/script_prof.c   \
+	scripts/script_budget.c \
+	scripts/sampler.c       \
+	scripts/script_heap.c   \
+	scripts/script_gc.c     \
+	scripts/pyoffload.c     \
+	scripts/pycoro.c        \
+	scripts/pyregen.c       \
+	scripts/pyroutine.c     \
+	scripts/pystats.c       \
+	scripts/code_cache.c    \
 	scripts/pyolc.c         \
     scripts/pyskills_verbs.c
 
@@ -124,14 +124,18 @@ PyObject *pyAuxiliaryDataRead(const char *keyword, STORAGE_SET *set) {
 //   copyTo     the values of the auxiliary data to another auxiliary data
 //              supplied as an argument to the function
 //   store      returns a storage set representation of the auxiliary data
-PyObject *PyAuxiliary_install(PyObject *self, PyObject *args) {
+// Stored data is read back in when it's first asked for, unless eager is true
+PyObject *PyAuxiliary_install(PyObject *self, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = { "name", "proto", "installs_on", "eager", NULL };
   PyObject   *proto = NULL; // the class proto
   char        *name = NULL; // the name of the auxiliary data
   char *installs_on = NULL; // a list of datatypes it installs onto
   bitvector_t  type = 0;    // bitvector representation of we we install on
+  bool        eager = FALSE;// read it in along with whatever it's on?
 
   // try parsing the install
-  if(!PyArg_ParseTuple(args, "sOs", &name, &proto, &installs_on)) {
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "sOs|b", kwlist,
+				  &name, &proto, &installs_on, &eager)) {
     PyErr_Format(PyExc_TypeError,
 		 "Installed auxiliaries require a name, a proto class, and "
 		 "a comma-separated list of datatypes to install onto");
@@ -166,14 +170,15 @@ PyObject *PyAuxiliary_install(PyObject *self, PyObject *args) {
 	pyAuxiliaryDataCopyTo, pyAuxiliaryDataCopy,
 	pyAuxiliaryDataStore, pyAuxiliaryDataRead);
   auxiliaryFuncSetIsPy(funcs, TRUE);
+  auxiliaryFuncSetEager(funcs, eager);
 					     
   auxiliariesInstall(name, funcs);
   return Py_BuildValue("i", 1);
 }
 
 PyMethodDef pyauxiliary_module_methods[] = {
-  { "install", PyAuxiliary_install, METH_VARARGS,
-    "install(name, AuxClass, installs_on)\n\n"
+  { "install", (PyCFunction)PyAuxiliary_install, METH_VARARGS | METH_KEYWORDS,
+    "install(name, AuxClass, installs_on, eager = False)\n\n"
     "Register new auxiliary data to the given name. Auxiliary data can be\n"
     "installed on: character, object, room, account, socket. Auxiliary data\n"
     "must be a class object of the following form:\n\n"
@@ -189,7 +194,9 @@ PyMethodDef pyauxiliary_module_methods[] = {
     "The Store method returns a storage set representation of the data. If\n"
     "the auxiliary data is not persistent, an empty storage set can be\n"
     "returned. The class's init function must be able to handle reading in\n"
-    "data from a storage set, or creating a fresh instance if set = None.\n" },
+    "data from a storage set, or creating a fresh instance if set = None.\n"
+    "Data that was stored is read back in the first time it is used. If\n"
+    "eager is True, it is read in along with whatever it is on instead.\n" },
   {NULL, NULL, 0, NULL}  /* Sentinel */
 };
 
@@ -33,7 +33,11 @@
 #include "pyexit.h"
 #include "pyaccount.h"
 #include "pyauxiliary.h"
+#include "pylistview.h"
 #include "pystorage.h"
+#include "trighooks.h"
+#include "pyskills_verbs.h"
+#include "pystats.h"
 
 
 
@@ -187,195 +191,172 @@ long PyChar_Hash(PyChar *ch) {
 //*****************************************************************************
 // getters and setters for the Char class
 //*****************************************************************************
+
+//
+// find the character a getter is for. If they no longer exist, raise an
+// error instead of handing Python back a NULL with no error set
+#define PYCHAR_GET_CHAR(self, ch)                                      \
+  CHAR_DATA *ch = PyChar_AsChar((PyObject *)(self));                   \
+  if(ch == NULL) {                                                     \
+    PyErr_Format(PyExc_TypeError,                                      \
+		 "Tried to read from nonexistent character, %d",       \
+		 PyChar_AsUid((PyObject *)(self)));                    \
+    return NULL;                                                       \
+  }
+
 PyObject *PyChar_getname(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetName(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetName(ch));
 }
 
 PyObject *PyChar_getkeywords(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetKeywords(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetKeywords(ch));
 }
 
 PyObject *PyChar_getmname(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetMultiName(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetMultiName(ch));
 }
 
 PyObject *PyChar_getdesc(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetDesc(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetDesc(ch));
 }
 
 PyObject *PyChar_getlookbuf(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", bufferString(charGetLookBuffer(ch)));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(bufferString(charGetLookBuffer(ch)));
 }  
 
 PyObject *PyChar_getrdesc(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetRdesc(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetRdesc(ch));
 }
 
 PyObject *PyChar_getmdesc(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetMultiRdesc(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetMultiRdesc(ch));
 }
 
 PyObject *PyChar_getrace(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetRace(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetRace(ch));
 }
 
 PyObject *PyChar_getsex(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", sexGetName(charGetSex(ch)));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(sexGetName(charGetSex(ch)));
 }
 
 PyObject *PyChar_getposition(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", posGetName(charGetPos(ch)));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(posGetName(charGetPos(ch)));
 }
 
 PyObject *PyChar_getbodysize(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch == NULL)
-    return NULL;
+  PYCHAR_GET_CHAR(self, ch);
   BODY_DATA *body = charGetBody(ch);
   if(body == NULL)
-    return Py_BuildValue("");
+    return Py_NewRef(Py_None);
   int sz = bodyGetSize(body);
-  return Py_BuildValue("s", bodysizeGetName(sz));
+  return makePyString(bodysizeGetName(sz));
 }
 
 PyObject *PyChar_getroom(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch == NULL)
-    return NULL;
-  else if(charGetRoom(ch) != NULL)
-    return Py_BuildValue("O", roomGetPyFormBorrowed(charGetRoom(ch)));
+  PYCHAR_GET_CHAR(self, ch);
+  if(charGetRoom(ch) != NULL)
+    return Py_NewRef(roomGetPyFormBorrowed(charGetRoom(ch)));
   else {
-    return Py_BuildValue("");
+    return Py_NewRef(Py_None);
   }
 }
 
 PyObject *PyChar_getlastroom(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch == NULL)
-    return NULL;
-  else if(charGetLastRoom(ch) != NULL)
-    return Py_BuildValue("O", roomGetPyFormBorrowed(charGetLastRoom(ch)));
+  PYCHAR_GET_CHAR(self, ch);
+  if(charGetLastRoom(ch) != NULL)
+    return Py_NewRef(roomGetPyFormBorrowed(charGetLastRoom(ch)));
   else {
-    return Py_BuildValue("");
+    return Py_NewRef(Py_None);
   }
 }
 
 PyObject *PyChar_getisnpc(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("i", charIsNPC(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return PyLong_FromLong(charIsNPC(ch));
 }
 
 PyObject *PyChar_getispc(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("i", !charIsNPC(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return PyLong_FromLong(!charIsNPC(ch));
 }
 
 PyObject *PyChar_gethisher(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", HISHER(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(HISHER(ch));
 }
 
 PyObject *PyChar_gethimher(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", HIMHER(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(HIMHER(ch));
 }
 
 PyObject *PyChar_getheshe(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", HESHE(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(HESHE(ch));
 }
 
 PyObject *PyChar_geton(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch == NULL) 
-    return NULL;
-  else if(charGetFurniture(ch) == NULL)
-    return Py_BuildValue("");
+  PYCHAR_GET_CHAR(self, ch);
+  if(charGetFurniture(ch) == NULL)
+    return Py_NewRef(Py_None);
   else 
-    return Py_BuildValue("O", objGetPyFormBorrowed(charGetFurniture(ch)));
+    return Py_NewRef(objGetPyFormBorrowed(charGetFurniture(ch)));
 }
 
 PyObject *PyChar_getuid(PyChar *self, void *closure) {
-  return Py_BuildValue("i", self->uid);
+  return PyLong_FromLong(self->uid);
 }
 
 PyObject *PyChar_gethidden(PyObject *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar(self);
-  if(ch != NULL)  return Py_BuildValue("i", charGetHidden(ch));
-  else            return NULL;  
+  PYCHAR_GET_CHAR(self, ch);
+  return PyLong_FromLong(charGetHidden(ch));
 }
 
 PyObject *PyChar_getweight(PyObject *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar(self);
-  if(ch != NULL)  return Py_BuildValue("d", charGetWeight(ch));
-  else            return NULL;  
+  PYCHAR_GET_CHAR(self, ch);
+  return PyFloat_FromDouble(charGetWeight(ch));
+}
+
+PyObject *PyChar_getcarriedweight(PyObject *self, void *closure) {
+  PYCHAR_GET_CHAR(self, ch);
+  return PyFloat_FromDouble(charGetCarriedWeight(ch));
 }
 
 PyObject *PyChar_getbirth(PyObject *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar(self);
-  if(ch != NULL)  return Py_BuildValue("i", charGetBirth(ch));
-  else            return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return PyLong_FromLong(charGetBirth(ch));
 }
 
 PyObject *PyChar_getage(PyObject *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar(self);
-  if(ch != NULL)  return Py_BuildValue("d", difftime(current_time, charGetBirth(ch)));
-  else            return NULL;  
+  PYCHAR_GET_CHAR(self, ch);
+  return PyFloat_FromDouble(difftime(current_time, charGetBirth(ch)));
 }
 
 PyObject *PyChar_getprototypes(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetPrototypes(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetPrototypes(ch));
 }
 
 PyObject *PyChar_getclass(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetClass(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetClass(ch));
 }
 
 PyObject *PyChar_getinv(PyChar *self, PyObject *args) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch == NULL) 
-    return NULL;
-
-  LIST_ITERATOR *inv_i = newListIterator(charGetInventory(ch));
-  PyObject *list = PyList_New(0);
-  OBJ_DATA *obj;
-  
-  // for each obj in the inventory, add it to the Python list
-  ITERATE_LIST(obj, inv_i)
-    PyList_Append(list, objGetPyFormBorrowed(obj));
-  deleteListIterator(inv_i);
-  PyObject *retval = Py_BuildValue("O", list);
-  Py_DECREF(list);
-  return retval;
+  PYCHAR_GET_CHAR(self, ch);
+  return newPyListView(mob_table, charGetUID(ch),
+		       (void *)charGetInventory, LISTVIEW_OBJS);
 }
 
 PyObject *PyChar_geteq(PyChar *self, PyObject *args) {
@@ -384,7 +365,7 @@ PyObject *PyChar_geteq(PyChar *self, PyObject *args) {
     return NULL;
 
   PyObject      *list = PyList_New(0);
-  LIST      *equipped = bodyGetAllEq(charGetBody(ch));
+  LIST      *equipped = bodyGetEqList(charGetBody(ch));
   LIST_ITERATOR *eq_i = newListIterator(equipped);
   OBJ_DATA        *eq = NULL;
   ITERATE_LIST(eq, eq_i) {
@@ -392,7 +373,6 @@ PyObject *PyChar_geteq(PyChar *self, PyObject *args) {
   } deleteListIterator(eq_i);
   PyObject *retval = Py_BuildValue("O", list);
   Py_DECREF(list);
-  deleteList(equipped);
   return retval;
 }
 
@@ -415,9 +395,8 @@ PyObject *PyChar_getbodyparts(PyChar *self, PyObject *args) {
 
 // Hair Color
 PyObject *PyChar_gethaircolor(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetHairColor(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetHairColor(ch));
 }
 
 int PyChar_sethaircolor(PyChar *self, PyObject *value, void *closure) {
@@ -440,9 +419,8 @@ int PyChar_sethaircolor(PyChar *self, PyObject *value, void *closure) {
 
 // Hair Style
 PyObject *PyChar_gethairstyle(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetHairStyle(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetHairStyle(ch));
 }
 
 int PyChar_sethairstyle(PyChar *self, PyObject *value, void *closure) {
@@ -465,9 +443,8 @@ int PyChar_sethairstyle(PyChar *self, PyObject *value, void *closure) {
 
 // Fur Color
 PyObject *PyChar_getfurcolor(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetFurColor(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetFurColor(ch));
 }
 
 int PyChar_setfurcolor(PyChar *self, PyObject *value, void *closure) {
@@ -490,9 +467,8 @@ int PyChar_setfurcolor(PyChar *self, PyObject *value, void *closure) {
 
 // Feather Color
 PyObject *PyChar_getfeathercolor(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetFeatherColor(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetFeatherColor(ch));
 }
 
 int PyChar_setfeathercolor(PyChar *self, PyObject *value, void *closure) {
@@ -515,9 +491,8 @@ int PyChar_setfeathercolor(PyChar *self, PyObject *value, void *closure) {
 
 // Scale Color
 PyObject *PyChar_getscalecolor(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetScaleColor(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetScaleColor(ch));
 }
 
 int PyChar_setscalecolor(PyChar *self, PyObject *value, void *closure) {
@@ -540,9 +515,8 @@ int PyChar_setscalecolor(PyChar *self, PyObject *value, void *closure) {
 
 // Scale Marking
 PyObject *PyChar_getscalemarking(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetScaleMarking(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetScaleMarking(ch));
 }
 
 int PyChar_setscalemarking(PyChar *self, PyObject *value, void *closure) {
@@ -565,9 +539,8 @@ int PyChar_setscalemarking(PyChar *self, PyObject *value, void *closure) {
 
 // Marking Color
 PyObject *PyChar_getmarkingcolor(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetMarkingColor(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetMarkingColor(ch));
 }
 
 int PyChar_setmarkingcolor(PyChar *self, PyObject *value, void *closure) {
@@ -590,9 +563,8 @@ int PyChar_setmarkingcolor(PyChar *self, PyObject *value, void *closure) {
 
 // Tail Style
 PyObject *PyChar_gettailstyle(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetTailStyle(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetTailStyle(ch));
 }
 
 int PyChar_settailstyle(PyChar *self, PyObject *value, void *closure) {
@@ -615,9 +587,8 @@ int PyChar_settailstyle(PyChar *self, PyObject *value, void *closure) {
 
 // Mane Style
 PyObject *PyChar_getmanestyle(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetManeStyle(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetManeStyle(ch));
 }
 
 int PyChar_setmanestyle(PyChar *self, PyObject *value, void *closure) {
@@ -640,9 +611,8 @@ int PyChar_setmanestyle(PyChar *self, PyObject *value, void *closure) {
 
 // Build
 PyObject *PyChar_getbuild(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetBuild(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetBuild(ch));
 }
 
 int PyChar_setbuild(PyChar *self, PyObject *value, void *closure) {
@@ -665,9 +635,8 @@ int PyChar_setbuild(PyChar *self, PyObject *value, void *closure) {
 
 // Skin Tone
 PyObject *PyChar_getskintone(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetSkinTone(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetSkinTone(ch));
 }
 
 int PyChar_setskintone(PyChar *self, PyObject *value, void *closure) {
@@ -690,9 +659,8 @@ int PyChar_setskintone(PyChar *self, PyObject *value, void *closure) {
 
 // Eye Color (Left)
 PyObject *PyChar_geteyecolor(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetEyeColor(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetEyeColor(ch));
 }
 
 int PyChar_seteyecolor(PyChar *self, PyObject *value, void *closure) {
@@ -715,9 +683,8 @@ int PyChar_seteyecolor(PyChar *self, PyObject *value, void *closure) {
 
 // Eye Color Right (for heterochromia)
 PyObject *PyChar_geteyecolorright(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetEyeColorRight(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetEyeColorRight(ch));
 }
 
 int PyChar_seteyecolorright(PyChar *self, PyObject *value, void *closure) {
@@ -740,9 +707,8 @@ int PyChar_seteyecolorright(PyChar *self, PyObject *value, void *closure) {
 
 // Heterochromia (boolean flag)
 PyObject *PyChar_getheterochromia(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("i", charGetHeterochromia(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return PyLong_FromLong(charGetHeterochromia(ch));
 }
 
 int PyChar_setheterochromia(PyChar *self, PyObject *value, void *closure) {
@@ -765,9 +731,8 @@ int PyChar_setheterochromia(PyChar *self, PyObject *value, void *closure) {
 
 // Beard Style
 PyObject *PyChar_getbeardstyle(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) return Py_BuildValue("s", charGetBeardStyle(ch));
-  else           return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(charGetBeardStyle(ch));
 }
 
 int PyChar_setbeardstyle(PyChar *self, PyObject *value, void *closure) {
@@ -900,23 +865,16 @@ PyObject *PyChar_reset_body(PyChar *self, PyObject *args) {
 }
 
 PyObject *PyChar_getusergroups(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch != NULL) 
-    return Py_BuildValue("s", bitvectorGetBits(charGetUserGroups(ch)));
-  else           
-    return NULL;
+  PYCHAR_GET_CHAR(self, ch);
+  return makePyString(bitvectorGetBits(charGetUserGroups(ch)));
 }
 
 PyObject *PyChar_getsocket(PyChar *self, void *closure) {
-  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
-  if(ch == NULL)
-    return NULL;
-  else {
-    SOCKET_DATA *sock = charGetSocket(ch);
-    if(sock == NULL)
-      return Py_BuildValue("");
-    return Py_BuildValue("O", socketGetPyFormBorrowed(sock));
-  }
+  PYCHAR_GET_CHAR(self, ch);
+  SOCKET_DATA *sock = charGetSocket(ch);
+  if(sock == NULL)
+    return Py_NewRef(Py_None);
+  return Py_NewRef(socketGetPyFormBorrowed(sock));
 }
 
 
@@ -1699,15 +1657,11 @@ PyObject *PyChar_getbodypct(PyChar *self, PyObject *args) {
 
 
 //
-// equips a character with an item
-PyObject *PyChar_equip(PyChar *self, PyObject *args) {  
-  OBJ_DATA      *obj = NULL;
-  CHAR_DATA      *ch = NULL;
-  PyObject     *pobj = NULL;
-  char          *pos = NULL;
+// equip ch with obj at pos (or wherever it goes, if pos is NULL). If we can't,
+// put the object back wherever it came from, tell ch, and return FALSE
+bool char_equip_obj(CHAR_DATA *ch, OBJ_DATA *obj, const char *pos, bool forced,
+		    const char *equipment_type) {
   const char *needed = NULL;
-  bool        forced = FALSE;
-  char *equipment_type = NULL;
 
   // incase the equip fails, keep item in the original place.. here's the vars
   CHAR_DATA *old_carrier = NULL;
@@ -1716,6 +1670,54 @@ PyObject *PyChar_equip(PyChar *self, PyObject *args) {
   ROOM_DATA    *old_room = NULL;
   OBJ_DATA     *old_cont = NULL;
 
+  // remove the object from whatever it's in/on currently
+  if((old_room = objGetRoom(obj)) != NULL)
+    obj_from_room(obj);
+  if((old_cont = objGetContainer(obj)) != NULL)
+    obj_from_obj(obj);
+  if((old_carrier = objGetCarrier(obj)) != NULL)
+    obj_from_char(obj);
+  if((old_wearer = objGetWearer(obj)) != NULL) {
+    old_pos = bodyEquippedWhere(charGetBody(old_wearer), obj);
+    try_unequip(old_wearer, obj);
+  }
+
+  if(objIsType(obj, "worn"))
+    needed = wornGetPositions(obj);
+
+  // try equipping the object. If we fail, put it back wherever it came from
+  // Allow equipping if: forced=True OR object is "worn" OR object matches equipment_type
+  bool can_equip_type = (equipment_type && objIsType(obj, equipment_type));
+  bool should_try_equip = forced || objIsType(obj, "worn") || can_equip_type;
+  
+  if(!should_try_equip || !try_equip_ex(ch,obj,pos,needed,equipment_type,forced)) {
+    if(old_room != NULL)
+      obj_to_room(obj, old_room);
+    else if(old_cont != NULL)
+      obj_to_obj(obj, old_cont);
+    else if(old_carrier != NULL)
+      obj_to_char(obj, old_carrier);
+    else if(old_wearer != NULL)
+      try_equip_ex(ch, obj, old_pos, NULL, equipment_type, forced);
+    if(pos == NULL)
+      message(ch, NULL, obj, NULL, TRUE, TO_CHAR, "You are already equipped in all possible positions for $o.");
+    else
+      message(ch, NULL, obj, NULL, TRUE, TO_CHAR, "You could not equip $o there.");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+//
+// equips a character with an item
+PyObject *PyChar_equip(PyChar *self, PyObject *args) {  
+  OBJ_DATA      *obj = NULL;
+  CHAR_DATA      *ch = NULL;
+  PyObject     *pobj = NULL;
+  char          *pos = NULL;
+  bool        forced = FALSE;
+  char *equipment_type = NULL;
+
   if (!PyArg_ParseTuple(args, "O|zbs", &pobj, &pos, &forced, &equipment_type)) {
     PyErr_Format(PyExc_TypeError, 
 		 "Character equip must be supplied with an item to equip!");
@@ -1747,48 +1749,147 @@ PyObject *PyChar_equip(PyChar *self, PyObject *args) {
     return NULL;
   }
 
-  // remove the object from whatever it's in/on currently
-  if((old_room = objGetRoom(obj)) != NULL)
-    obj_from_room(obj);
-  if((old_cont = objGetContainer(obj)) != NULL)
-    obj_from_obj(obj);
-  if((old_carrier = objGetCarrier(obj)) != NULL)
-    obj_from_char(obj);
-  if((old_wearer = objGetWearer(obj)) != NULL) {
-    old_pos = bodyEquippedWhere(charGetBody(old_wearer), obj);
-    try_unequip(old_wearer, obj);
+  return Py_BuildValue("i", char_equip_obj(ch, obj, pos, forced,
+					   equipment_type));
+}
+
+//
+// equips a character with a list of items, each either an object or an
+// (object, positions) pair, in one go. Positions given by type are resolved
+// against what the character is wearing when each item's turn comes, so
+// earlier items' slots aren't picked again. Returns the items equipped
+PyObject *PyChar_equip_many(PyChar *self, PyObject *args) {
+  PyObject     *items = NULL;
+  bool         forced = FALSE;
+  char *equipment_type = "worn";
+
+  if(!PyArg_ParseTuple(args, "O|bs", &items, &forced, &equipment_type)) {
+    PyErr_Format(PyExc_TypeError,
+		 "equip_many must be supplied with a list of items to equip!");
+    return NULL;
   }
 
-  if(objIsType(obj, "worn"))
-    needed = wornGetPositions(obj);
+  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
+  if(ch == NULL) {
+    PyErr_Format(PyExc_Exception, "Tried to equip nonexistant character!");
+    return NULL;
+  }
 
-  // try equipping the object. If we fail, put it back wherever it came from
-  // Allow equipping if: forced=True OR object is "worn" OR object matches equipment_type
-  bool can_equip_type = (equipment_type && objIsType(obj, equipment_type));
-  bool should_try_equip = forced || objIsType(obj, "worn") || can_equip_type;
-  
-  if(!should_try_equip || !try_equip_ex(ch,obj,pos,needed,equipment_type,forced)) {
-    if(old_room != NULL)
-      obj_to_room(obj, old_room);
-    else if(old_cont != NULL)
-      obj_to_obj(obj, old_cont);
-    else if(old_carrier != NULL)
-      obj_to_char(obj, old_carrier);
-    else if(old_wearer != NULL)
-      try_equip_ex(ch, obj, old_pos, NULL, equipment_type, forced);
-    if(pos == NULL)
-      message(ch, NULL, obj, NULL, TRUE, TO_CHAR, "You are already equipped in all possible positions for $o.");
-    else
-      message(ch, NULL, obj, NULL, TRUE, TO_CHAR, "You could not equip $o there.");
+  PyObject *seq = PySequence_Fast(items, "equip_many needs a list of items");
+  if(seq == NULL)
+    return NULL;
+
+  PyObject *equipped = PyList_New(0);
+  Py_ssize_t i, num = PySequence_Fast_GET_SIZE(seq);
+  for(i = 0; i < num; i++) {
+    PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+    PyObject *pobj = item;
+    PyObject *pwhere = Py_None;
+    if(PyTuple_Check(item) && PyTuple_Size(item) == 2) {
+      pobj   = PyTuple_GET_ITEM(item, 0);
+      pwhere = PyTuple_GET_ITEM(item, 1);
+    }
+    if(!PyObj_Check(pobj) || (pwhere != Py_None && !PyUnicode_Check(pwhere))) {
+      PyErr_Format(PyExc_TypeError,
+		   "equip_many items must be objects, or (object, positions)");
+      Py_DECREF(equipped);
+      Py_DECREF(seq);
+      return NULL;
+    }
 
-    return Py_BuildValue("i", 0);
-    //    PyErr_Format(PyExc_Exception,
-    //		 "Character is already equipped in all possible positions!");
-    //    return NULL;
+    OBJ_DATA *obj = PyObj_AsObj(pobj);
+    if(obj == NULL)
+      continue;
+
+    char *pos = NULL;
+    if(pwhere != Py_None)
+      pos = bodyResolvePositions(charGetBody(ch), PyUnicode_AsUTF8(pwhere));
+    if(char_equip_obj(ch, obj, pos, forced, equipment_type))
+      PyList_Append(equipped, pobj);
+    if(pos) free(pos);
   }
-  // success
-  else 
-    return Py_BuildValue("i", 1);
+  Py_DECREF(seq);
+  return equipped;
+}
+
+//
+// takes a list of items off of a character, and puts them in the character's
+// inventory. Returns the items removed
+PyObject *PyChar_unequip_many(PyChar *self, PyObject *args) {
+  PyObject *items = NULL;
+
+  if(!PyArg_ParseTuple(args, "O", &items)) {
+    PyErr_Format(PyExc_TypeError,
+		 "unequip_many must be supplied with a list of items to remove!");
+    return NULL;
+  }
+
+  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
+  if(ch == NULL) {
+    PyErr_Format(PyExc_Exception, "Tried to unequip nonexistant character!");
+    return NULL;
+  }
+
+  PyObject *seq = PySequence_Fast(items, "unequip_many needs a list of items");
+  if(seq == NULL)
+    return NULL;
+
+  PyObject *removed = PyList_New(0);
+  Py_ssize_t i, num = PySequence_Fast_GET_SIZE(seq);
+  for(i = 0; i < num; i++) {
+    PyObject *pobj = PySequence_Fast_GET_ITEM(seq, i);
+    OBJ_DATA  *obj = (PyObj_Check(pobj) ? PyObj_AsObj(pobj) : NULL);
+    if(obj != NULL && objGetWearer(obj) == ch && try_unequip(ch, obj)) {
+      obj_to_char(obj, ch);
+      PyList_Append(removed, pobj);
+    }
+  }
+  Py_DECREF(seq);
+  return removed;
+}
+
+//
+// resolves a list of positions to the names of the character's bodyparts
+PyObject *PyChar_resolve_positions(PyChar *self, PyObject *args) {
+  char *positions = NULL;
+  if(!PyArg_ParseTuple(args, "s", &positions)) {
+    PyErr_Format(PyExc_TypeError, "A list of positions must be supplied.");
+    return NULL;
+  }
+
+  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
+  if(ch == NULL) {
+    PyErr_Format(PyExc_Exception, "Nonexistant character");
+    return NULL;
+  }
+
+  char *resolved = bodyResolvePositions(charGetBody(ch), positions);
+  PyObject *retval = Py_BuildValue("s", resolved);
+  free(resolved);
+  return retval;
+}
+
+//
+// the names of all of the character's bodyparts of one type
+PyObject *PyChar_get_bodyparts_of_type(PyChar *self, PyObject *args) {
+  char *type = NULL;
+  if(!PyArg_ParseTuple(args, "s", &type)) {
+    PyErr_Format(PyExc_TypeError, "A bodypart type must be supplied.");
+    return NULL;
+  }
+
+  CHAR_DATA *ch = PyChar_AsChar((PyObject *)self);
+  if(ch == NULL) {
+    PyErr_Format(PyExc_Exception, "Nonexistant character");
+    return NULL;
+  }
+
+  int i, num_parts = 0;
+  const char **parts = bodyGetPartsOfType(charGetBody(ch), type, &num_parts);
+  PyObject *list = PyList_New(num_parts);
+  for(i = 0; i < num_parts; i++)
+    PyList_SET_ITEM(list, i, PyUnicode_FromString(parts[i]));
+  return list;
 }
 
 
@@ -1908,6 +2009,7 @@ PyObject *PyChar_attach(PyChar *self, PyObject *args) {
 		 get_fullkey_relative(key, get_script_locale()));
   if(trig != NULL) {
     triggerListAdd(charGetTriggers(ch), triggerGetKey(trig));
+    heartbeat_trighooks_update(ch, TRIGVAR_CHAR);
     return Py_BuildValue("i", 1);
   }
   else {
@@ -1934,6 +2036,7 @@ PyObject *PyChar_detach(PyChar *self, PyObject *args) {
   if(ch != NULL) {
     const char *fkey = get_fullkey_relative(key, get_script_locale());
     triggerListRemove(charGetTriggers(ch), fkey);
+    heartbeat_trighooks_update(ch, TRIGVAR_CHAR);
     return Py_BuildValue("i", 1);
   }
   else {
@@ -2290,14 +2393,46 @@ PyTypeObject PyChar_Type = {
 //*****************************************************************************
 // methods in the char module
 //*****************************************************************************/
-PyObject *PyChar_load_mob(PyObject *self, PyObject *args) {
+//
+// put a mob we've loaded into its room, and onto some furniture if it's going
+// there. Default position on furniture is POS_SITTING
+void load_mob_to(CHAR_DATA *mob, ROOM_DATA *room, OBJ_DATA *on,
+		 const char *posname) {
+  char_to_room(mob, room);
+
+  // now check if we need to put the char onto some furniture
+  if(on) {
+    int pos = POS_SITTING;
+    char_to_furniture(mob, on);
+    if(posname)
+      pos = posGetNum(posname);
+
+    // if the position is none, or greater 
+    // than sitting, default to sitting.
+    if(pos == POS_NONE || poscmp(pos, POS_SITTING) > 0)
+      pos = POS_SITTING;
+    charSetPos(mob, pos);
+  }
+  else if(posname) {
+    int pos = posGetNum(posname);
+    // if it was an invalid name, set it to standing
+    if(pos == POS_NONE)
+      pos = POS_STANDING;
+    charSetPos(mob, pos);
+  }
+}
+
+PyObject *PyChar_load_mob(PyObject *self, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = { "proto", "room", "pos", "count", NULL };
   char      *mob_key = NULL;
   PyObject       *to = NULL;
   ROOM_DATA    *room = NULL;
   OBJ_DATA       *on = NULL;
   char      *posname = NULL;
+  int          count = 0;
   
-  if (!PyArg_ParseTuple(args, "sO|s", &mob_key, &to, &posname)) {
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|si", kwlist, 
+				   &mob_key, &to, &posname, &count)) {
     PyErr_Format(PyExc_TypeError, 
 		 "Load char failed - it needs prototype and destination.");
     return NULL;
@@ -2337,40 +2472,29 @@ PyObject *PyChar_load_mob(PyObject *self, PyObject *args) {
     return NULL;
   }
 
-  // copy the mob, and put it into the game
-  CHAR_DATA *mob = protoMobRun(mob_proto);
-  if(mob == NULL) {
+  // copy the mob as many times as we were asked to, and put them into the game
+  LIST   *mobs = newList();
+  int   loaded = protoMobRunBatch(mob_proto, MAX(1, count), mobs);
+  if(loaded == 0) {
     PyErr_Format(PyExc_TypeError,
 		 "Load char failed: proto script terminated with an error.");
+    deleteList(mobs);
     return NULL;
   }
 
-  char_to_room(mob, room);
-
-  // now check if we need to put the char onto some furniture
-  // default position is POS_SITTING
-  if(on) {
-    int pos = POS_SITTING;
-    char_to_furniture(mob, on);
-    if(posname)
-      pos = posGetNum(posname);
-
-    // if the position is none, or greater 
-    // than sitting, default to sitting.
-    if(pos == POS_NONE || poscmp(pos, POS_SITTING) > 0)
-      pos = POS_SITTING;
-    charSetPos(mob, pos);
-  }
-  else if(posname) {
-    int pos = posGetNum(posname);
-    // if it was an invalid name, set it to standing
-    if(pos == POS_NONE)
-      pos = POS_STANDING;
-    charSetPos(mob, pos);
+  // if we were given a count, we return a list of everything we loaded.
+  // Otherwise, just the mob
+  PyObject *retval = (count > 0 ? PyList_New(0) : NULL);
+  CHAR_DATA   *mob = NULL;
+  while((mob = listPop(mobs)) != NULL) {
+    load_mob_to(mob, room, on, posname);
+    if(retval != NULL)
+      PyList_Append(retval, charGetPyFormBorrowed(mob));
+    else
+      retval = Py_BuildValue("O", charGetPyFormBorrowed(mob));
   }
-
-  // create a python object for the new char, and return it
-  return Py_BuildValue("O", charGetPyFormBorrowed(mob));
+  deleteList(mobs);
+  return retval;
 }
 
 PyObject *PyChar_find_char_key(PyObject *self, PyObject *args) {
@@ -2468,8 +2592,7 @@ PyObject *PyChar_count_mobs(PyObject *self, PyObject *args) {
 
   // if we didn't supply something to look in, assume it means the world
   if(in == NULL)
-    return Py_BuildValue("i", count_chars(NULL, mobile_list, NULL, prototype, 
-					  FALSE));
+    return Py_BuildValue("i", count_char_instances(prototype));
 
   // see what we're looking in
   if(PyUnicode_Check(in))
@@ -2492,6 +2615,26 @@ PyObject *PyChar_count_mobs(PyObject *self, PyObject *args) {
   return Py_BuildValue("i", count_chars(NULL, list, NULL, prototype, FALSE));
 }
 
+PyObject *PyChar_instances(PyObject *self, PyObject *args) {
+  char *proto = NULL;
+  if(!PyArg_ParseTuple(args, "s", &proto)) {
+    PyErr_Format(PyExc_TypeError, "instances needs a mob prototype.");
+    return NULL;
+  }
+
+  PyObject       *list = PyList_New(0);
+  SET       *instances = 
+    char_instances_of(get_fullkey_relative(proto, get_script_locale()));
+  if(instances != NULL) {
+    LOCAL_SET_ITERATOR(ch_i, instances);
+    CHAR_DATA *ch = NULL;
+    ITERATE_SET(ch, ch_i)
+      PyList_Append(list, charGetPyFormBorrowed(ch));
+    setIteratorFinish(ch_i);
+  }
+  return list;
+}
+
 PyObject *PyChar_all_chars(PyObject *self) {
   PyObject      *list = PyList_New(0);
   LIST_ITERATOR *ch_i = newListIterator(mobile_list);
@@ -2543,11 +2686,17 @@ PyMethodDef char_module_methods[] = {
     "char_list()\n"
     "\n"
     "Return a list of every character in game." },
-  { "load_mob", PyChar_load_mob, METH_VARARGS,
-    "load_mob(proto, room, pos = 'standing')\n"
+  { "instances", PyChar_instances, METH_VARARGS,
+    "instances(proto)\n"
+    "\n"
+    "Return a list of every mobile in game that is an instance of the\n"
+    "prototype, or of a prototype that inherits from it." },
+  { "load_mob", (PyCFunction)PyChar_load_mob, METH_VARARGS | METH_KEYWORDS,
+    "load_mob(proto, room, pos = 'standing', count = 0)\n"
     "\n"
     "Generate a new mobile from the specified prototype. Add it to the\n"
-    "given room. Return the created mobile." },
+    "given room. Return the created mobile. If a count is given, that many\n"
+    "mobiles are generated at once, and a list of them is returned instead." },
   { "count_mobs", PyChar_count_mobs, METH_VARARGS,
     "count_mobs(keyword, loc = None)\n"
     "\n"
@@ -2617,6 +2766,9 @@ static struct PyModuleDef pychar_moduledef = {
 PyMODINIT_FUNC PyInit_PyChar(void) {
   PyObject* m;
 
+  // stat blocks, for stats read by number instead of by name
+  init_pystats();
+
   // add in our setters and getters for the char class
   PyChar_addGetSetter("inv", PyChar_getinv, NULL,
     "An immutable list of objects in the character's inventory.\n"
@@ -2695,6 +2847,9 @@ PyMODINIT_FUNC PyInit_PyChar(void) {
     "Integer value representing how hidden the character is. Default is 0.");
   PyChar_addGetSetter("weight", PyChar_getweight, PyChar_setweight,
     "Floating point value representing how heavy the character is.");
+  PyChar_addGetSetter("carried_weight", PyChar_getcarriedweight, NULL,
+    "How much everything the character is carrying and wearing weighs,\n"
+    "contents and all. Immutable.");
   PyChar_addGetSetter("bodysize", PyChar_getbodysize, PyChar_setbodysize,
     "The character body's size. One of: diminuitive, tiny, small, medium, large, huge, gargantuan, collosal.");
   PyChar_addGetSetter("age", PyChar_getage, NULL,
@@ -2795,6 +2950,25 @@ PyMODINIT_FUNC PyInit_PyChar(void) {
     "to be equipped, or worn objects to be equipped to their non-default\n"
     "positions. equipment_type controls layering - items only conflict with\n"
     "other items of the same type. Returns success of attempt.");
+  PyChar_addMethod("equip_many", PyChar_equip_many, METH_VARARGS,
+    "equip_many(items, forced=False, equipment_type='worn')\n"
+    "\n"
+    "Like equip, for a whole list of items at once. Each item is an object,\n"
+    "or an (object, positions) pair. Position types are resolved to free\n"
+    "bodyparts as each item's turn comes, so no two items are sent to the\n"
+    "same one while another is free. Returns a list of the items equipped.");
+  PyChar_addMethod("unequip_many", PyChar_unequip_many, METH_VARARGS,
+    "unequip_many(items)\n"
+    "\n"
+    "Takes each of the items off, and puts it in the character's inventory.\n"
+    "Returns a list of the items that were removed.");
+  PyChar_addMethod("resolve_positions", PyChar_resolve_positions, METH_VARARGS,
+    "resolve_positions(positions)\n"
+    "\n"
+    "Turns a comma-separated list of position names and types into names\n"
+    "of the character's bodyparts. Each type becomes a free bodypart of the\n"
+    "type if there is one, or one not already in the list if not. Anything\n"
+    "that is neither is kept as it is.");
   PyChar_addMethod("get_equip", PyChar_getequip, METH_VARARGS,
     "get_equip(bodypart)\n"
     "\n"
@@ -2895,6 +3069,12 @@ PyMODINIT_FUNC PyInit_PyChar(void) {
     "get_bodypart_type(name)\n"
     "\n"
     "Return the type of the specified body part, or None if it doesn't exist.");
+  PyChar_addMethod("get_bodyparts_of_type", PyChar_get_bodyparts_of_type,
+    METH_VARARGS,
+    "get_bodyparts_of_type(type)\n"
+    "\n"
+    "Return a list of the names of the character's body parts of a type, in\n"
+    "the order bodyparts lists them.");
   PyChar_addMethod("get_random_bodypart", PyChar_get_random_bodypart, METH_NOARGS,
     "get_random_bodypart()\n"
     "\n"
@@ -2910,6 +3090,7 @@ PyMODINIT_FUNC PyInit_PyChar(void) {
     "trigger owner is 'me'. Other variables can be specified. The opts\n"
     "variable can be a dictionary that maps optional variable names to their\n"
     "values.");
+  PySkillsVerbs_registerCharMethods();
 
   // add in all the getsetters and methods
   makePyType(&PyChar_Type, pychar_getsetters, pychar_methods);
@@ -0,0 +1,372 @@
+//*****************************************************************************
+//
+// pycoro.c
+//
+// Python coroutines, run on the event queue. See pycoro.h. A coroutine that
+// is waiting always has exactly one event in the queue: the one that goes
+// off when its sleep or timeout is over, or the zero-delay one that hands it
+// the hook it was waiting for. The event belongs to the coroutine's owner,
+// so interrupting the owner's events (as happens when it leaves the game)
+// interrupts the coroutine too, and is indexed under the coroutine's task,
+// so we can take it back out when a hook comes first.
+//
+//*****************************************************************************
+
+#include <Python.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../event.h"
+#include "../hooks.h"
+
+#include "scripts.h"
+#include "pyplugs.h"
+#include "pychar.h"
+#include "pyroom.h"
+#include "pyobj.h"
+#include "pymud.h"
+#include "sampler.h"
+#include "pycoro.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how many pulses forever is, for hooks waited on with no timeout
+#define CORO_FOREVER         (1 << 30)
+
+#define CORO_SLEEP           0
+#define CORO_HOOK            1
+
+//
+// what a coroutine awaits. Awaiting one hands it to us, and the await is
+// over once we put a result in it and resume the coroutine
+typedef struct {
+  PyObject_HEAD
+  int            kind;
+  int           delay; // how many pulses to wait, or -1 for forever
+  char          *hook; // the hook to wait for
+  PyObject    *result; // what the await comes back with
+  bool        yielded; // have we been handed to the scheduler yet?
+} PyCoroWait;
+
+//
+// a coroutine we're running
+typedef struct {
+  PyObject       *coro;
+  void          *owner; // what the coroutine belongs to, or NULL
+  char         *locale; // the locale it runs in
+  PyCoroWait     *wait; // what it's waiting on
+  bool    rescheduling; // are we taking its event back out ourself?
+} CORO_TASK;
+
+PyTypeObject PyCoroWait_Type;
+
+// the tasks waiting on each type of hook
+HASHTABLE *coro_waiters = NULL;
+
+// coroutines that were interrupted are closed by an event of their own,
+// owned by this, instead of in the middle of interrupting events
+int coro_reaper = 0;
+
+
+
+//*****************************************************************************
+// the awaitable type
+//*****************************************************************************
+void PyCoroWait_dealloc(PyCoroWait *self) {
+  if(self->hook) free(self->hook);
+  Py_XDECREF(self->result);
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+PyObject *PyCoroWait_await(PyCoroWait *self) {
+  return Py_NewRef((PyObject *)self);
+}
+
+//
+// the first time we're asked for our next value, we hand ourself to the
+// scheduler. The second time, the wait is over, and we return our result
+PyObject *PyCoroWait_next(PyCoroWait *self) {
+  if(!self->yielded) {
+    self->yielded = TRUE;
+    return Py_NewRef((PyObject *)self);
+  }
+  if(self->result != NULL && self->result != Py_None)
+    PyErr_SetObject(PyExc_StopIteration, self->result);
+  return NULL;
+}
+
+PyAsyncMethods PyCoroWait_async = {
+  (unaryfunc)PyCoroWait_await, // am_await
+  NULL,                        // am_aiter
+  NULL,                        // am_anext
+  NULL,                        // am_send
+};
+
+PyCoroWait *newPyCoroWait(int kind, int delay, const char *hook) {
+  PyCoroWait *wait = PyObject_New(PyCoroWait, &PyCoroWait_Type);
+  wait->kind    = kind;
+  wait->delay   = delay;
+  wait->hook    = (hook ? strdup(hook) : NULL);
+  wait->result  = NULL;
+  wait->yielded = FALSE;
+  return wait;
+}
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+void coro_step(CORO_TASK *task, PyObject *value);
+
+//
+// find the thing a Python owner stands for. Returns FALSE if it isn't a
+// char, obj, room, or None, or if it doesn't exist
+bool coro_get_owner(PyObject *owner, void **thing) {
+  *thing = NULL;
+  if(owner == NULL || owner == Py_None)
+    return TRUE;
+  else if(PyChar_Check(owner))
+    *thing = PyChar_AsChar(owner);
+  else if(PyObj_Check(owner))
+    *thing = PyObj_AsObj(owner);
+  else if(PyRoom_Check(owner))
+    *thing = PyRoom_AsRoom(owner);
+  return (*thing != NULL);
+}
+
+void deleteCoroTask(CORO_TASK *task) {
+  Py_XDECREF(task->wait);
+  Py_XDECREF(task->coro);
+  if(task->locale) free(task->locale);
+  free(task);
+}
+
+//
+// stop waiting on a hook, if that's what we're doing
+void coro_stop_waiting(CORO_TASK *task) {
+  if(task->wait == NULL || task->wait->kind != CORO_HOOK)
+    return;
+  LIST *waiters = hashGet(coro_waiters, task->wait->hook);
+  if(waiters != NULL && listRemove(waiters, task))
+    hookUnwatch(task->wait->hook);
+}
+
+//
+// the coroutine was interrupted. Close it the next chance we get
+void coro_reap(void *owner, CORO_TASK *task, char *arg) {
+  PyObject *ret = PyObject_CallMethod(task->coro, "close", NULL);
+  if(ret == NULL)
+    log_pyerr("Error closing an interrupted Python coroutine");
+  Py_XDECREF(ret);
+  deleteCoroTask(task);
+}
+
+void coro_interrupted(void *owner, CORO_TASK *task, char *arg) {
+  if(task->rescheduling)
+    return;
+  coro_stop_waiting(task);
+  start_event(&coro_reaper, 0, coro_reap, NULL, task, NULL);
+}
+
+//
+// our sleep (or our timeout) is over
+void coro_wake(void *owner, CORO_TASK *task, char *arg) {
+  coro_stop_waiting(task);
+  coro_step(task, Py_None);
+}
+
+//
+// the hook we were waiting on was run
+void coro_hooked(void *owner, CORO_TASK *task, char *arg) {
+  PyObject *info = PyUnicode_FromString(arg ? arg : "");
+  coro_step(task, info);
+  Py_XDECREF(info);
+}
+
+//
+// put an event in the queue for the task, owned by its owner and indexed
+// under the task
+void coro_schedule(CORO_TASK *task, int delay, void *func, const char *arg) {
+  LIST *involves = newList();
+  listPut(involves, task);
+  start_event_interruptible(task->owner, delay, func, coro_interrupted,
+			    involves, task, arg);
+  deleteList(involves);
+}
+
+//
+// hears about the hooks coroutines are waiting on, and hands them over
+void coro_monitor(HOOK_ARGS *args) {
+  LIST *waiters = hashGet(coro_waiters, hookArgsType(args));
+  if(waiters == NULL || listSize(waiters) == 0)
+    return;
+
+  CORO_TASK *task = NULL;
+  LIST       *woken = listCopyWith(waiters, NULL);
+  while((task = listPop(woken)) != NULL) {
+    coro_stop_waiting(task);
+    // swap the timeout out for an event that hands over the hook's info
+    task->rescheduling = TRUE;
+    interrupt_events_involving(task);
+    task->rescheduling = FALSE;
+    coro_schedule(task, 0, coro_hooked, hookArgsInfo(args));
+  }
+  deleteList(woken);
+}
+
+//
+// resume the coroutine, with value as what its await comes back with, and
+// run it until it waits again or is done
+void coro_step(CORO_TASK *task, PyObject *value) {
+  PyObject *yielded = NULL;
+  if(task->wait != NULL) {
+    Py_XSETREF(task->wait->result, Py_NewRef(value));
+  }
+
+  script_locale_push(task->locale);
+  samplerEnter("coroutine", ((PyCoroObject *)task->coro)->cr_qualname ?
+	       PyUnicode_AsUTF8(((PyCoroObject *)task->coro)->cr_qualname) :
+	       "<coroutine>");
+  PySendResult res = PyIter_Send(task->coro, Py_None, &yielded);
+  samplerLeave();
+  script_locale_pop();
+  Py_CLEAR(task->wait);
+
+  if(res == PYGEN_ERROR) {
+    log_pyerr("Error running a Python coroutine");
+    deleteCoroTask(task);
+  }
+  else if(res == PYGEN_RETURN) {
+    Py_XDECREF(yielded);
+    deleteCoroTask(task);
+  }
+  else if(!PyObject_TypeCheck(yielded, &PyCoroWait_Type)) {
+    Py_XDECREF(yielded);
+    log_string("A Python coroutine awaited something other than mud.sleep "
+	       "or mud.wait_for, and was closed.");
+    coro_reap(NULL, task, NULL);
+  }
+  else {
+    task->wait = (PyCoroWait *)yielded;
+    if(task->wait->kind == CORO_HOOK) {
+      LIST *waiters = hashGet(coro_waiters, task->wait->hook);
+      if(waiters == NULL) {
+	waiters = newList();
+	hashPut(coro_waiters, task->wait->hook, waiters);
+      }
+      listQueue(waiters, task);
+      hookWatch(task->wait->hook);
+    }
+    coro_schedule(task, (task->wait->delay < 0 ? CORO_FOREVER :
+			 task->wait->delay), coro_wake, NULL);
+  }
+}
+
+
+
+//*****************************************************************************
+// methods for the mud module
+//*****************************************************************************
+
+//
+// sleep(seconds)
+PyObject *PyCoro_sleep(PyObject *self, PyObject *args) {
+  double seconds = 0;
+  if(!PyArg_ParseTuple(args, "d", &seconds)) {
+    PyErr_Format(PyExc_TypeError, "sleep takes a number of seconds.");
+    return NULL;
+  }
+  return (PyObject *)newPyCoroWait(CORO_SLEEP, MAX(0, (int)(seconds SECONDS)),
+				   NULL);
+}
+
+//
+// wait_for(hook, timeout = None)
+PyObject *PyCoro_wait_for(PyObject *self, PyObject *args) {
+  char         *hook = NULL;
+  PyObject *timeout = Py_None;
+  if(!PyArg_ParseTuple(args, "s|O", &hook, &timeout) ||
+     (timeout != Py_None && !PyNumber_Check(timeout))) {
+    PyErr_Clear();
+    PyErr_Format(PyExc_TypeError, "wait_for takes a hook type, and optionally "
+		 "a timeout in seconds.");
+    return NULL;
+  }
+  int delay = -1;
+  if(timeout != Py_None)
+    delay = MAX(0, (int)(PyFloat_AsDouble(timeout) SECONDS));
+  return (PyObject *)newPyCoroWait(CORO_HOOK, delay, hook);
+}
+
+//
+// spawn(coro, owner = None)
+PyObject *PyCoro_spawn(PyObject *self, PyObject *args) {
+  PyObject  *coro = NULL;
+  PyObject *owner = Py_None;
+  if(!PyArg_ParseTuple(args, "O|O", &coro, &owner))
+    return NULL;
+  if(!pyCoroStart(coro, owner, get_script_locale()))
+    return NULL;
+  return Py_BuildValue("");
+}
+
+
+
+//*****************************************************************************
+// implementation of pycoro.h
+//*****************************************************************************
+void init_pycoro(void) {
+  coro_waiters = newHashtable();
+  hookAddArgsMonitor(coro_monitor);
+
+  PyCoroWait_Type = (PyTypeObject) { PyVarObject_HEAD_INIT(NULL, 0) };
+  PyCoroWait_Type.tp_name      = "mud.CoroWait";
+  PyCoroWait_Type.tp_basicsize = sizeof(PyCoroWait);
+  PyCoroWait_Type.tp_dealloc   = (destructor)PyCoroWait_dealloc;
+  PyCoroWait_Type.tp_flags     = Py_TPFLAGS_DEFAULT;
+  PyCoroWait_Type.tp_doc       = "Something a coroutine awaits.";
+  PyCoroWait_Type.tp_as_async  = &PyCoroWait_async;
+  PyCoroWait_Type.tp_iter      = (getiterfunc)PyCoroWait_await;
+  PyCoroWait_Type.tp_iternext  = (iternextfunc)PyCoroWait_next;
+  PyType_Ready(&PyCoroWait_Type);
+
+  PyMud_addMethod("sleep", PyCoro_sleep, METH_VARARGS,
+    "sleep(seconds)\n\n"
+    "For coroutines: await mud.sleep(seconds) to wait that long.");
+  PyMud_addMethod("wait_for", PyCoro_wait_for, METH_VARARGS,
+    "wait_for(hook, timeout = None)\n\n"
+    "For coroutines: await mud.wait_for(hook) to wait until a type of hook\n"
+    "is run. Returns the hook's info string, or None if timeout seconds go\n"
+    "by first.");
+  PyMud_addMethod("spawn", PyCoro_spawn, METH_VARARGS,
+    "spawn(coro, owner = None)\n\n"
+    "Start running a coroutine. It runs until it first awaits sleep or\n"
+    "wait_for, and carries on each time what it awaited happens. owner is a\n"
+    "char, obj, room, or None; when the owner leaves the game, the coroutine\n"
+    "is closed.");
+}
+
+bool pyCoroStart(PyObject *coro, PyObject *owner, const char *locale) {
+  void *thing = NULL;
+  if(!PyCoro_CheckExact(coro)) {
+    PyErr_Format(PyExc_TypeError, "Only coroutines can be spawned.");
+    return FALSE;
+  }
+  if(!coro_get_owner(owner, &thing)) {
+    PyErr_Format(PyExc_TypeError, "A coroutine's owner must be a char, obj, "
+		 "room, or None that exists.");
+    return FALSE;
+  }
+
+  CORO_TASK *task    = calloc(1, sizeof(CORO_TASK));
+  task->coro         = Py_NewRef(coro);
+  task->owner        = thing;
+  task->locale       = strdupsafe(locale);
+  coro_step(task, Py_None);
+  return TRUE;
+}
@@ -0,0 +1,36 @@
+#ifndef __PYCORO_H
+#define __PYCORO_H
+//*****************************************************************************
+//
+// pycoro.h
+//
+// running Python coroutines on the event queue, so behaviors that take more
+// than one step can be written as one function instead of a chain of events:
+//
+//   async def wander(ch):
+//     ch.act("say I'll be right back.")
+//     await mud.sleep(10)
+//     info = await mud.wait_for("char_to_room", 60)
+//
+// mud.sleep(seconds) waits that long. mud.wait_for(hook, timeout = None)
+// waits for a hook to be run, and returns its info string, or None if the
+// timeout ran out first. Coroutines are started with mud.spawn(coro, owner),
+// or by returning one from an event function or a hook listener, and
+// triggers and scripts can await at their top level. Each coroutine belongs
+// to an owner (a character, object, room, or None); when the owner leaves
+// the game its coroutines are closed, the same as its events are
+// interrupted. Triggers' coroutines belong to whoever the trigger is on.
+//
+//*****************************************************************************
+
+//
+// add sleep, wait_for, and spawn to the mud module
+void init_pycoro(void);
+
+//
+// run a coroutine until it first waits, and keep running it each time what
+// it waited for happens. owner is the Python form of what it belongs to, or
+// None. Returns FALSE, with a Python exception set, if it couldn't be started
+bool pyCoroStart(PyObject *coro, PyObject *owner, const char *locale);
+
+#endif // __PYCORO_H
@@ -19,6 +19,7 @@
 #include "pyroom.h"
 #include "pyobj.h"
 #include "pyplugs.h"
+#include "pycoro.h"
 
 
 
@@ -45,6 +46,9 @@ void PyEvent_on_complete(void *owner, PyObject *tuple, const char *arg) {
     PyObject *ret = PyObject_CallFunction(efunc, "OOs", PyOwner, edata, arg);
     if(ret == NULL)
       log_pyerr("Error finishing Python event");
+    // an async event function carries on as a coroutine of the owner's
+    else if(PyCoro_CheckExact(ret) && !pyCoroStart(ret, PyOwner, NULL))
+      log_pyerr("Error starting Python event's coroutine");
     Py_XDECREF(ret);
   }
 
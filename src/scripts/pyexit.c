@@ -575,7 +575,7 @@ PyObject *PyExit_open(PyExit *self, PyObject *value) {
   exitSetLocked(ex, FALSE);
 
   if(was_closed && exitGetRoom(ex))
-    hookRun("room_change", hookBuildInfo("rm", exitGetRoom(ex)));
+    hookRunArgs("room_change", "rm", exitGetRoom(ex));
 
   return Py_BuildValue("i", 1);
 }
@@ -594,7 +594,7 @@ PyObject *PyExit_close(PyExit *self, PyObject *value) {
   exitSetClosed(ex, TRUE);
 
   if(was_open && exitGetRoom(ex))
-    hookRun("room_change", hookBuildInfo("rm", exitGetRoom(ex)));
+    hookRunArgs("room_change", "rm", exitGetRoom(ex));
 
   return Py_BuildValue("i", 1);
 }
@@ -614,7 +614,7 @@ PyObject *PyExit_lock(PyExit *self, PyObject *value) {
   exitSetLocked(ex, TRUE);
 
   if((was_open || was_unlocked) && exitGetRoom(ex))
-    hookRun("room_change", hookBuildInfo("rm", exitGetRoom(ex)));
+    hookRunArgs("room_change", "rm", exitGetRoom(ex));
 
   return Py_BuildValue("i", 1);
 }
@@ -632,7 +632,7 @@ PyObject *PyExit_unlock(PyExit *self, PyObject *value) {
   exitSetLocked(ex, FALSE);
 
   if(was_locked && exitGetRoom(ex))
-    hookRun("room_change", hookBuildInfo("rm", exitGetRoom(ex)));
+    hookRunArgs("room_change", "rm", exitGetRoom(ex));
 
   return Py_BuildValue("i", 1);
 }
@@ -8,6 +8,7 @@
 #include "../mud.h"
 #include "../utils.h"
 #include "../hooks.h"
+#include "../pulse.h"
 
 #include "scripts.h"
 #include "pyroom.h"
@@ -17,6 +18,7 @@
 #include "pysocket.h"
 #include "pyplugs.h"
 #include "pyhooks.h"
+#include "pycoro.h"
 
 
 //*****************************************************************************
@@ -25,9 +27,25 @@
 // a list of methods to add to the hooks module
 LIST *pyhooks_methods = NULL;
 
-// a table of python hooks we have installed
+// a table of python hooks we have installed. Each is a list of PY_HOOKs
 HASHTABLE *pyhook_table = NULL;
 
+// a Python hook function, and whether it wants its info parsed for it
+typedef struct {
+  PyObject *func;
+  bool    parsed;
+} PY_HOOK;
+
+// the info string of the hook being run right now, as Python has it, and
+// what it parses into once someone parses it. Every listener is handed the
+// same string, and parse_info hands back the same tuple for it, so the info
+// is only parsed once however many listeners parse it
+PyObject  *running_info = NULL;
+PyObject *running_parsed = NULL;
+
+// a table of python batch hooks we have installed
+HASHTABLE *pybatch_table = NULL;
+
 
 //*****************************************************************************
 // local methods
@@ -149,15 +167,12 @@ PyObject *PyHooks_BuildInfo(PyObject *self, PyObject *args) {
 }
 
 
-PyObject *PyHooks_ParseInfo(PyObject *self, PyObject *args) {
-  // parse out our info
-  char             *info = NULL;
-  if(!PyArg_ParseTuple(args, "s", &info)) {
-    PyErr_Format(PyExc_TypeError, "PyHook_ParseInfo must be supplied a string");
-    return NULL;
-  }
-
+//
+// parse an info string into a tuple of the things in it. Things that no
+// longer exist are None
+PyObject *pyhooks_parse(const char *info) {
   // parse out all of our tokens
+  ARENA_MARK        mark = arenaMark(scratch_arena());
   LIST           *tokens = parse_hook_info_tokens(info);
   LIST_ITERATOR *token_i = newListIterator(tokens);
   char            *token = NULL;
@@ -172,42 +187,44 @@ PyObject *PyHooks_ParseInfo(PyObject *self, PyObject *args) {
     if(startswith(token, "ch")) {
       sscanf(token, "ch.%d", &id);
       CHAR_DATA *ch = propertyTableGet(mob_table, id);
-      PyTuple_SetItem(list, i, (ch ? charGetPyForm(ch) : Py_None));
+      PyTuple_SetItem(list, i, (ch ? charGetPyForm(ch) : Py_NewRef(Py_None)));
     }
     else if(startswith(token, "obj")) {
       sscanf(token, "obj.%d", &id);
       OBJ_DATA *obj = propertyTableGet(obj_table, id);
-      PyTuple_SetItem(list, i, (obj ? objGetPyForm(obj) : Py_None));
+      PyTuple_SetItem(list, i, (obj ? objGetPyForm(obj) : Py_NewRef(Py_None)));
     }
     else if(startswith(token, "rm")) {
       sscanf(token, "rm.%d", &id);
       ROOM_DATA *rm = propertyTableGet(room_table, id);
-      PyTuple_SetItem(list, i, (rm ? roomGetPyForm(rm) : Py_None));
+      PyTuple_SetItem(list, i, (rm ? roomGetPyForm(rm) : Py_NewRef(Py_None)));
     }
     else if(startswith(token, "room")) {
       sscanf(token, "room.%d", &id);
       ROOM_DATA *rm = propertyTableGet(room_table, id);
-      PyTuple_SetItem(list, i, (rm ? roomGetPyForm(rm) : Py_None));
+      PyTuple_SetItem(list, i, (rm ? roomGetPyForm(rm) : Py_NewRef(Py_None)));
     }
     else if(startswith(token, "exit")) {
       sscanf(token, "exit.%d", &id);
       EXIT_DATA *ex = propertyTableGet(exit_table, id);
-      PyTuple_SetItem(list, i, (ex ? newPyExit(ex) : Py_None));
+      PyTuple_SetItem(list, i, (ex ? newPyExit(ex) : Py_NewRef(Py_None)));
     }
     else if(startswith(token, "ex")) {
       sscanf(token, "ex.%d", &id);
       EXIT_DATA *ex = propertyTableGet(exit_table, id);
-      PyTuple_SetItem(list, i, (ex ? newPyExit(ex) : Py_None));
+      PyTuple_SetItem(list, i, (ex ? newPyExit(ex) : Py_NewRef(Py_None)));
     }
     else if(startswith(token, "sk")) {
       sscanf(token, "sk.%d", &id);
       SOCKET_DATA *sock = propertyTableGet(sock_table, id);
-      PyTuple_SetItem(list,i, (sock ? socketGetPyForm(sock) : Py_None));
+      PyTuple_SetItem(list,i, (sock ? socketGetPyForm(sock) :
+				 Py_NewRef(Py_None)));
     }
     else if(startswith(token, "sock")) {
       sscanf(token, "sock.%d", &id);
       SOCKET_DATA *sock = propertyTableGet(sock_table, id);
-      PyTuple_SetItem(list,i, (sock ? socketGetPyForm(sock) : Py_None));
+      PyTuple_SetItem(list,i, (sock ? socketGetPyForm(sock) :
+				 Py_NewRef(Py_None)));
     }
     else if(*token == HOOK_STR_MARKER) {
       char *str = strdup(token + 1);
@@ -249,13 +266,34 @@ PyObject *PyHooks_ParseInfo(PyObject *self, PyObject *args) {
       else
 	PyTuple_SetItem(list,i, Py_BuildValue("i", atoi(token)));
     }
+    // listeners may be handed the tuple's items as their arguments, so none
+    // of them can be left empty
+    if(PyTuple_GET_ITEM(list, i) == NULL)
+      PyTuple_SetItem(list, i, Py_NewRef(Py_None));
     i++;
   } deleteListIterator(token_i);
-  deleteListWith(tokens, free);
+  arenaRelease(scratch_arena(), mark);
 
   return list;
 }
 
+PyObject *PyHooks_ParseInfo(PyObject *self, PyObject *args) {
+  // parse out our info
+  char             *info = NULL;
+  if(!PyArg_ParseTuple(args, "s", &info)) {
+    PyErr_Format(PyExc_TypeError, "PyHook_ParseInfo must be supplied a string");
+    return NULL;
+  }
+
+  // a listener of the hook that's running, parsing what it was handed
+  if(running_info != NULL && PyTuple_GET_ITEM(args, 0) == running_info) {
+    if(running_parsed == NULL)
+      running_parsed = pyhooks_parse(info);
+    return Py_XNewRef(running_parsed);
+  }
+  return pyhooks_parse(info);
+}
+
 
 PyObject *PyHooks_Run(PyObject *self, PyObject *args) {
   char *type = NULL;
@@ -274,7 +312,8 @@ PyObject *PyHooks_Run(PyObject *self, PyObject *args) {
 PyObject *PyHooks_Add(PyObject *self, PyObject *args) {
   char     *type = NULL;
   PyObject *hook = NULL;
-  if(!PyArg_ParseTuple(args, "sO", &type, &hook)) {
+  int     parsed = FALSE;
+  if(!PyArg_ParseTuple(args, "sO|p", &type, &hook, &parsed)) {
     PyErr_Format(PyExc_TypeError, "Must supply with a type and function");
     return NULL;
   }
@@ -284,13 +323,17 @@ PyObject *PyHooks_Add(PyObject *self, PyObject *args) {
     return NULL;
   }
 
+  PY_HOOK *pyhook = malloc(sizeof(PY_HOOK));
+  pyhook->func    = hook;
+  pyhook->parsed  = parsed;
   Py_INCREF(hook);
   LIST *list = hashGet(pyhook_table, type);
   if(list == NULL) {
     list = newList();
     hashPut(pyhook_table, type, list);
   }
-  listQueue(list, hook);  
+  listQueue(list, pyhook);
+  hookWatch(type);
   return Py_BuildValue("i", 1);
 }
 
@@ -303,36 +346,199 @@ PyObject *PyHooks_Remove(PyObject *self, PyObject *args) {
     return NULL;
   }
 
-  LIST *list = hashGet(pyhook_table, type);
+  LIST       *list = hashGet(pyhook_table, type);
+  PY_HOOK  *pyhook = NULL;
+  if(list != NULL) {
+    LIST_ITERATOR *list_i = newListIterator(list);
+    ITERATE_LIST(pyhook, list_i) {
+      if(pyhook->func == hook)
+	break;
+    } deleteListIterator(list_i);
+  }
+  if(pyhook != NULL && listRemove(list, pyhook)) {
+    hookUnwatch(type);
+    Py_DECREF(pyhook->func);
+    free(pyhook);
+  }
+  return Py_BuildValue("i", 1);
+}
+
+
+void PyHooks_profile(const char *type, PyObject *func, long long usecs);
+
+//
+// hands a batch of hook runs to the Python functions waiting on them
+void PyHooks_RunBatch(const char *type, LIST *batch) {
+  LIST *list = hashGet(pybatch_table, type);
+  if(list == NULL || listSize(list) == 0)
+    return;
+
+  PyObject   *infos = PyList_New(0);
+  LIST_ITERATOR *info_i = newListIterator(batch);
+  const char  *info = NULL;
+  ITERATE_LIST(info, info_i) {
+    PyObject *str = PyUnicode_FromString(info);
+    if(str != NULL) {
+      PyList_Append(infos, str);
+      Py_DECREF(str);
+    }
+  } deleteListIterator(info_i);
+
+  LIST_ITERATOR *list_i = newListIterator(list);
+  PyObject        *func = NULL;
+  ITERATE_LIST(func, list_i) {
+    long long start   = (hookGetProfiling() ? pulse_clock() : 0);
+    PyObject *retval  = PyObject_CallFunctionObjArgs(func, infos, NULL);
+    if(retval == NULL)
+      log_pyerr("Error running Python batch hook %s", type);
+    Py_XDECREF(retval);
+    if(hookGetProfiling())
+      PyHooks_profile(type, func, pulse_clock() - start);
+  } deleteListIterator(list_i);
+  Py_DECREF(infos);
+}
+
+PyObject *PyHooks_AddBatch(PyObject *self, PyObject *args) {
+  char     *type = NULL;
+  PyObject *hook = NULL;
+  if(!PyArg_ParseTuple(args, "sO", &type, &hook)) {
+    PyErr_Format(PyExc_TypeError, "Must supply with a type and function");
+    return NULL;
+  }
+
+  if(!PyFunction_Check(hook)) {
+    PyErr_Format(PyExc_TypeError, "Only functions may be supplied as hooks.");
+    return NULL;
+  }
+
+  Py_INCREF(hook);
+  LIST *list = hashGet(pybatch_table, type);
+  if(list == NULL) {
+    list = newList();
+    hashPut(pybatch_table, type, list);
+  }
+  // start batching the hook up, if we aren't already
+  if(listSize(list) == 0)
+    hookAddBatch(type, PyHooks_RunBatch);
+  listQueue(list, hook);  
+  return Py_BuildValue("i", 1);
+}
+
+PyObject *PyHooks_RemoveBatch(PyObject *self, PyObject *args) {
+  char     *type = NULL;
+  PyObject *hook = NULL;
+  if(!PyArg_ParseTuple(args, "sO", &type, &hook)) {
+    PyErr_Format(PyExc_TypeError, "Must supply with a type and function");
+    return NULL;
+  }
+
+  LIST *list = hashGet(pybatch_table, type);
   if(list != NULL && listRemove(list, hook)) {
     Py_DECREF(hook);
+    // stop batching the hook up if nobody's waiting on it anymore. The list
+    // stays, in case we're in the middle of running it
+    if(listSize(list) == 0)
+      hookRemoveBatch(type, PyHooks_RunBatch);
   }
   return Py_BuildValue("i", 1);
 }
 
 
 //
-// monitors hook activity, and handles the ones on the Python end
-void PyHooks_Monitor(const char *type, const char *info) {
-  LIST *list = hashGet(pyhook_table, type);
-  if(list != NULL) {
-    char *info_dup = strdup(info);
+// record how long a Python hook took, under its module and qualname
+void PyHooks_profile(const char *type, PyObject *func, long long usecs) {
+  PyObject *qualname = PyObject_GetAttrString(func, "__qualname__");
+  PyObject   *module = PyObject_GetAttrString(func, "__module__");
+  char name[SMALL_BUFFER];
+  snprintf(name, sizeof(name), "%s.%s",
+	   (module && PyUnicode_Check(module) ? 
+	    PyUnicode_AsUTF8(module) : "?"),
+	   (qualname && PyUnicode_Check(qualname) ? 
+	    PyUnicode_AsUTF8(qualname) : "?"));
+  PyErr_Clear();
+  Py_XDECREF(qualname);
+  Py_XDECREF(module);
+  hookProfileListener(type, name, usecs);
+}
+
+//
+// adds one hook stat onto the end of a Python list
+void PyHooks_add_stat(const char *type, const char *listener, long long calls,
+		      long long total, long long max, void *data) {
+  PyObject *stat = Py_BuildValue("{s:s,s:s,s:L,s:L,s:L}", 
+				 "hook", type, "listener", listener, 
+				 "calls", calls, "total_usec", total,
+				 "max_usec", max);
+  if(stat != NULL) {
+    PyList_Append((PyObject *)data, stat);
+    Py_DECREF(stat);
+  }
+}
+
+PyObject *PyHooks_Stats(PyObject *self, PyObject *args) {
+  PyObject *stats = PyList_New(0);
+  hookForeachStat(PyHooks_add_stat, stats);
+  return stats;
+}
+
+//
+// monitors hook activity, and handles the ones on the Python end. The info
+// string is only built for hooks Python is actually listening to, and only
+// made into a Python string and parsed once, however many listeners there are
+void PyHooks_Monitor(HOOK_ARGS *args) {
+  const char *type = hookArgsType(args);
+  load_deferred_for_hook(type);
+  LIST       *list = hashGet(pyhook_table, type);
+  if(list != NULL && listSize(list) > 0) {
+    // listeners can run hooks of their own, so put back what we replace
+    PyObject   *outer_info = running_info;
+    PyObject *outer_parsed = running_parsed;
+    running_info   = PyUnicode_FromString(hookArgsInfo(args));
+    running_parsed = NULL;
+    if(running_info == NULL) {
+      log_pyerr("Error making Python hook %s's info", type);
+      running_info   = outer_info;
+      running_parsed = outer_parsed;
+      return;
+    }
+
+    // listeners can remove themselves while they run, so hold on to each
+    // function until it's done
     LIST_ITERATOR *list_i = newListIterator(list);
-    PyObject *func = NULL;
-    ITERATE_LIST(func, list_i) {
-      PyObject *arglist = Py_BuildValue("(s)", info_dup);
-      //  PyObject *retval  = PyEval_CallObject(func, arglist);
-      PyObject *retval = PyObject_CallObject(func, arglist);
-      //PyObject *retval = PyEval_CallObjectWithKeywords(func, arglist, NULL);
+    PY_HOOK       *pyhook = NULL;
+    ITERATE_LIST(pyhook, list_i) {
+      long long start  = (hookGetProfiling() ? pulse_clock() : 0);
+      PyObject *func   = Py_NewRef(pyhook->func);
+      PyObject *retval = NULL;
+      if(!pyhook->parsed)
+	retval = PyObject_Vectorcall(func, &running_info, 1, NULL);
+      else {
+	if(running_parsed == NULL)
+	  running_parsed = pyhooks_parse(PyUnicode_AsUTF8(running_info));
+	if(running_parsed != NULL) {
+	  PyObject *parsed = Py_NewRef(running_parsed);
+	  retval = PyObject_Vectorcall(func, &PyTuple_GET_ITEM(parsed, 0),
+				       PyTuple_GET_SIZE(parsed), NULL);
+	  Py_DECREF(parsed);
+	}
+      }
       // check for an error:
       if(retval == NULL)
 	log_pyerr("Error running Python hook %s", type);
+      else if(PyCoro_CheckExact(retval) && !pyCoroStart(retval, Py_None, NULL))
+	log_pyerr("Error starting Python hook %s's coroutine", type);
+      if(hookGetProfiling())
+	PyHooks_profile(type, func, pulse_clock() - start);
 
       // garbage collection
       Py_XDECREF(retval);
-      Py_XDECREF(arglist);
+      Py_DECREF(func);
     } deleteListIterator(list_i);
-    free(info_dup);
+
+    Py_DECREF(running_info);
+    Py_XDECREF(running_parsed);
+    running_info   = outer_info;
+    running_parsed = outer_parsed;
   }
 }
 
@@ -361,13 +567,30 @@ PyInit_PyHooks(void) {
     "Returns hook information from a string format and a tuple of values for\n"
     "the format. Format arguments must be space-separated. They include:\n"
     "ch, rm, obj, ex, sk, str, int, dbl.");
+  PyHooks_addMethod("add_batch", PyHooks_AddBatch, METH_VARARGS,
+    "add_batch(hooktype, function)\n\n"
+    "Register a batch hook function. Instead of being run every time the\n"
+    "hook is, it is run once at the end of the pulse, with a list of the\n"
+    "information strings of every time the hook was run during the pulse.\n"
+    "Things in the information strings may no longer exist when it is run.");
+  PyHooks_addMethod("remove_batch", PyHooks_RemoveBatch, METH_VARARGS,
+    "remove_batch(hooktype, function)\n\n"
+    "Unregister a batch hook function.");
+  PyHooks_addMethod("stats", PyHooks_Stats, METH_NOARGS,
+    "stats()\n\n"
+    "Returns a list of dicts with the hook profiling statistics gathered so\n"
+    "far: hook, listener (None for totals of a whole hook type), calls,\n"
+    "total_usec and max_usec. Profiling is turned on with hookstat on.");
   PyHooks_addMethod("run", PyHooks_Run, METH_VARARGS,
     "run(hooktypes)\n\n"
     "Runs hooks registered to the given type.");
   PyHooks_addMethod("add", PyHooks_Add, METH_VARARGS,
-    "add(type, function)\n\n"
+    "add(type, function, parsed = False)\n\n"
     "Register a new hook function. Hook functions should take one argument:\n"
-    "an information string that can be parsed with hooks.parse_info");
+    "an information string that can be parsed with hooks.parse_info. If\n"
+    "parsed is True, the function is instead called with what the string\n"
+    "parses into, as its arguments. Either way, the information is only\n"
+    "parsed once each time the hook is run, however many functions parse it.");
   PyHooks_addMethod("remove", PyHooks_Remove, METH_VARARGS,
     "remove(type, function)\n\n"
     "Unregister a hook function.");
@@ -382,7 +605,8 @@ PyInit_PyHooks(void) {
 
   // set up our hook monitor
   pyhook_table = newHashtable();
-  hookAddMonitor(PyHooks_Monitor);
+  pybatch_table = newHashtable();
+  hookAddArgsMonitor(PyHooks_Monitor);
   return module;
 }
 
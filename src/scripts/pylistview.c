@@ -0,0 +1,292 @@
+//*****************************************************************************
+//
+// pylistview.c
+//
+// a read-only Python view of the characters or objects in one of a thing's
+// lists. See pylistview.h for more information.
+//
+//*****************************************************************************
+
+#include <Python.h>
+#include <structmember.h>
+
+#include "../mud.h"
+
+#include "scripts.h"
+#include "pylistview.h"
+
+
+
+//*****************************************************************************
+// local data structures
+//*****************************************************************************
+typedef struct {
+  PyObject_HEAD
+  PROPERTY_TABLE *owner_table;
+  int               owner_uid;
+  LIST *(* list_of)(void *owner);
+  int                   elems;
+} PyListView;
+
+extern PyTypeObject PyListView_Type;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// returns the list we are a view of, or NULL if our owner is gone
+LIST *PyListView_list(PyListView *self) {
+  void *owner = propertyTableGet(self->owner_table, self->owner_uid);
+  return (owner == NULL ? NULL : self->list_of(owner));
+}
+
+//
+// the Python form of one element of our list. A borrowed reference
+PyObject *PyListView_elem(PyListView *self, void *elem) {
+  if(self->elems == LISTVIEW_CHARS)
+    return charGetPyFormBorrowed(elem);
+  return objGetPyFormBorrowed(elem);
+}
+
+//
+// make a new tuple of what is in our list right now
+PyObject *PyListView_snapshot(PyListView *self) {
+  LIST           *list = PyListView_list(self);
+  PyObject      *tuple = PyTuple_New(list == NULL ? 0 : listSize(list));
+  if(tuple == NULL || list == NULL)
+    return tuple;
+
+  LIST_ITERATOR *list_i = newListIterator(list);
+  void            *elem = NULL;
+  int                 i = 0;
+  ITERATE_LIST(elem, list_i) {
+    PyTuple_SET_ITEM(tuple, i++, Py_NewRef(PyListView_elem(self, elem)));
+  } deleteListIterator(list_i);
+  return tuple;
+}
+
+//
+// make a plain list copy of what is in our list right now
+PyObject *PyListView_copy(PyListView *self) {
+  PyObject *tuple = PyListView_snapshot(self);
+  if(tuple == NULL)
+    return NULL;
+  PyObject *copy = PySequence_List(tuple);
+  Py_DECREF(tuple);
+  return copy;
+}
+
+//
+// for operations we share with lists; views are turned into list copies and
+// anything else is handed back with a new reference
+PyObject *PyListView_asList(PyObject *value) {
+  if(PyListView_Check(value))
+    return PyListView_copy((PyListView *)value);
+  return Py_NewRef(value);
+}
+
+
+
+//*****************************************************************************
+// sequence, mapping, and number methods
+//*****************************************************************************
+Py_ssize_t PyListView_length(PyListView *self) {
+  LIST *list = PyListView_list(self);
+  return (list == NULL ? 0 : listSize(list));
+}
+
+//
+// there is only ever one Python form of a char or obj, so membership can be
+// checked without calling back into Python
+int PyListView_contains(PyListView *self, PyObject *value) {
+  LIST           *list = PyListView_list(self);
+  if(list == NULL)
+    return 0;
+
+  LIST_ITERATOR *list_i = newListIterator(list);
+  void            *elem = NULL;
+  int            found = 0;
+  ITERATE_LIST(elem, list_i) {
+    if(PyListView_elem(self, elem) == value) {
+      found = 1;
+      break;
+    }
+  } deleteListIterator(list_i);
+  return found;
+}
+
+//
+// indexes are looked up in the list directly. Slices come from a copy
+PyObject *PyListView_subscript(PyListView *self, PyObject *key) {
+  if(PyIndex_Check(key)) {
+    Py_ssize_t   i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if(i == -1 && PyErr_Occurred())
+      return NULL;
+    LIST      *list = PyListView_list(self);
+    Py_ssize_t size = (list == NULL ? 0 : listSize(list));
+    if(i < 0)
+      i += size;
+    if(i < 0 || i >= size) {
+      PyErr_Format(PyExc_IndexError, "list index out of range");
+      return NULL;
+    }
+    return Py_NewRef(PyListView_elem(self, listGet(list, i)));
+  }
+
+  PyObject *copy = PyListView_copy(self);
+  if(copy == NULL)
+    return NULL;
+  PyObject *retval = PyObject_GetItem(copy, key);
+  Py_DECREF(copy);
+  return retval;
+}
+
+//
+// ch.inv + ch.eq and the like. Either side may be the view
+PyObject *PyListView_add(PyObject *left, PyObject *right) {
+  PyObject  *lcopy = PyListView_asList(left);
+  PyObject  *rcopy = (lcopy == NULL ? NULL : PyListView_asList(right));
+  PyObject *retval = (rcopy == NULL ? NULL : PySequence_Concat(lcopy, rcopy));
+  Py_XDECREF(lcopy);
+  Py_XDECREF(rcopy);
+  return retval;
+}
+
+PySequenceMethods PyListView_as_sequence = {
+  (lenfunc)PyListView_length,         /* sq_length */
+  0,                                  /* sq_concat */
+  0,                                  /* sq_repeat */
+  0,                                  /* sq_item */
+  0,                                  /* was_sq_slice */
+  0,                                  /* sq_ass_item */
+  0,                                  /* was_sq_ass_slice */
+  (objobjproc)PyListView_contains,    /* sq_contains */
+};
+
+PyMappingMethods PyListView_as_mapping = {
+  (lenfunc)PyListView_length,         /* mp_length */
+  (binaryfunc)PyListView_subscript,   /* mp_subscript */
+  0,                                  /* mp_ass_subscript */
+};
+
+PyNumberMethods PyListView_as_number = {
+  PyListView_add,                     /* nb_add */
+};
+
+
+
+//*****************************************************************************
+// everything else
+//*****************************************************************************
+
+//
+// iterate over what was in the list when the loop began
+PyObject *PyListView_iter(PyListView *self) {
+  PyObject *tuple = PyListView_snapshot(self);
+  if(tuple == NULL)
+    return NULL;
+  PyObject *iter = PyObject_GetIter(tuple);
+  Py_DECREF(tuple);
+  return iter;
+}
+
+PyObject *PyListView_repr(PyListView *self) {
+  PyObject *copy = PyListView_copy(self);
+  if(copy == NULL)
+    return NULL;
+  PyObject *repr = PyObject_Repr(copy);
+  Py_DECREF(copy);
+  return repr;
+}
+
+//
+// compare as a list would, against lists or other views
+PyObject *PyListView_richcompare(PyObject *left, PyObject *right, int op) {
+  PyObject  *lcopy = PyListView_asList(left);
+  PyObject  *rcopy = (lcopy == NULL ? NULL : PyListView_asList(right));
+  PyObject *retval = (rcopy == NULL ? NULL :
+		      PyObject_RichCompare(lcopy, rcopy, op));
+  Py_XDECREF(lcopy);
+  Py_XDECREF(rcopy);
+  return retval;
+}
+
+//
+// anything we do not have ourself, we look for on a list copy of ourself
+PyObject *PyListView_getattro(PyObject *self, PyObject *name) {
+  PyObject *attr = PyObject_GenericGetAttr(self, name);
+  if(attr != NULL || !PyErr_ExceptionMatches(PyExc_AttributeError))
+    return attr;
+  PyErr_Clear();
+
+  PyObject *copy = PyListView_copy((PyListView *)self);
+  if(copy == NULL)
+    return NULL;
+  attr = PyObject_GetAttr(copy, name);
+  Py_DECREF(copy);
+  return attr;
+}
+
+void PyListView_dealloc(PyListView *self) {
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+PyTypeObject PyListView_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "mudsys.ListView",                /*tp_name*/
+    sizeof(PyListView),               /*tp_basicsize*/
+    0,                                /*tp_itemsize*/
+    (destructor)PyListView_dealloc,   /*tp_dealloc*/
+    0,                                /*tp_print*/
+    0,                                /*tp_getattr*/
+    0,                                /*tp_setattr*/
+    0,                                /*tp_compare*/
+    (reprfunc)PyListView_repr,        /*tp_repr*/
+    &PyListView_as_number,            /*tp_as_number*/
+    &PyListView_as_sequence,          /*tp_as_sequence*/
+    &PyListView_as_mapping,           /*tp_as_mapping*/
+    PyObject_HashNotImplemented,      /*tp_hash */
+    0,                                /*tp_call*/
+    0,                                /*tp_str*/
+    PyListView_getattro,              /*tp_getattro*/
+    0,                                /*tp_setattro*/
+    0,                                /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,               /*tp_flags*/
+    "A read-only view of the characters or objects in a list. Anything a\n"
+    "view cannot do itself is done on a list copy of it.",
+    0,		                      /* tp_traverse */
+    0,		                      /* tp_clear */
+    PyListView_richcompare,           /* tp_richcompare */
+    0,		                      /* tp_weaklistoffset */
+    (getiterfunc)PyListView_iter,     /* tp_iter */
+    0,		                      /* tp_iternext */
+};
+
+
+
+//*****************************************************************************
+// implementation of pylistview.h
+//*****************************************************************************
+void init_pylistview(void) {
+  if(PyType_Ready(&PyListView_Type) < 0)
+    log_string("Error: could not ready the ListView class");
+}
+
+PyObject *newPyListView(PROPERTY_TABLE *owner_table, int owner_uid,
+			LIST *(* list_of)(void *owner), int elems) {
+  PyListView *view = PyObject_New(PyListView, &PyListView_Type);
+  if(view == NULL)
+    return NULL;
+  view->owner_table = owner_table;
+  view->owner_uid   = owner_uid;
+  view->list_of     = list_of;
+  view->elems       = elems;
+  return (PyObject *)view;
+}
+
+int PyListView_Check(PyObject *value) {
+  return PyObject_TypeCheck(value, &PyListView_Type);
+}
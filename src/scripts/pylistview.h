@@ -0,0 +1,40 @@
+#ifndef __PYLISTVIEW_H
+#define __PYLISTVIEW_H
+//*****************************************************************************
+//
+// pylistview.h
+//
+// a read-only Python view of the characters or objects in one of a thing's
+// lists, like a room's characters or a character's inventory. Getters hand
+// these out instead of building a new Python list every time they're used.
+// Views look their owner up by uid whenever they are used, so they see the
+// list as it is right now, and are empty once the owner is gone.
+//
+// Iterating over a view goes over what was in the list when the loop began,
+// so scripts can move or extract things as they go, like they always could.
+// Anything done to a view that isn't supported by the view itself (sorting
+// it, appending to it, and so on) first turns it into a plain list copy of
+// its own, just as if the getter had handed back a list.
+//
+//*****************************************************************************
+
+// the kinds of things a view can hold
+#define LISTVIEW_CHARS   0
+#define LISTVIEW_OBJS    1
+
+//
+// get the ListView class ready for use
+void init_pylistview(void);
+
+//
+// make a view of one of an owner's lists. The owner is found in owner_table
+// with owner_uid, and list_of returns the list of its we are a view of. elems
+// is one of the kinds of things a view can hold
+PyObject *newPyListView(PROPERTY_TABLE *owner_table, int owner_uid,
+			LIST *(* list_of)(void *owner), int elems);
+
+//
+// returns whether the python object is a ListView
+int PyListView_Check(PyObject *value);
+
+#endif // __PYLISTVIEW_H
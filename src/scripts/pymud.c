@@ -21,6 +21,7 @@
 #include "../handler.h"
 #include "../parse.h"
 #include "../races.h"
+#include "../colour.h"
 
 #include "scripts.h"
 #include "pyroom.h"
@@ -28,7 +29,12 @@
 #include "pyobj.h"
 #include "pyplugs.h"
 #include "pyexit.h"
+#include "trighooks.h"
 #include "pysocket.h"
+#include "pylistview.h"
+#include "pycoro.h"
+#include "pyregen.h"
+#include "pyroutine.h"
 
 
 
@@ -126,19 +132,111 @@ PyObject *mud_format_string(PyObject *self, PyObject *args) {
 
 
 //
-// parses arguments for character commands
+// a syntax for parse_args, compiled ahead of time by mud.compile_args
+typedef struct {
+  PyObject_HEAD
+  PARSE_FORMAT *format;
+  PyObject     *syntax;
+} PyParseFormat;
+
+void PyParseFormat_dealloc(PyParseFormat *self) {
+  if(self->format != NULL)
+    parseFormatRelease(self->format);
+  Py_XDECREF(self->syntax);
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+PyObject *PyParseFormat_repr(PyParseFormat *self) {
+  return PyUnicode_FromFormat("<ParseFormat %R>", self->syntax);
+}
+
+PyObject *PyParseFormat_getsyntax(PyParseFormat *self, void *closure) {
+  return Py_NewRef(self->syntax);
+}
+
+PyGetSetDef PyParseFormat_getseters[] = {
+  {"syntax", (getter)PyParseFormat_getsyntax, NULL,
+   "The syntax this format was compiled from. Immutable.", NULL},
+  {NULL}  /* Sentinel */
+};
+
+PyTypeObject PyParseFormat_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "mud.ParseFormat",                /*tp_name*/
+    sizeof(PyParseFormat),            /*tp_basicsize*/
+    0,                                /*tp_itemsize*/
+    (destructor)PyParseFormat_dealloc,/*tp_dealloc*/
+    0,                                /*tp_print*/
+    0,                                /*tp_getattr*/
+    0,                                /*tp_setattr*/
+    0,                                /*tp_compare*/
+    (reprfunc)PyParseFormat_repr,     /*tp_repr*/
+    0,                                /*tp_as_number*/
+    0,                                /*tp_as_sequence*/
+    0,                                /*tp_as_mapping*/
+    0,                                /*tp_hash */
+    0,                                /*tp_call*/
+    0,                                /*tp_str*/
+    0,                                /*tp_getattro*/
+    0,                                /*tp_setattro*/
+    0,                                /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,               /*tp_flags*/
+    "A parse_args syntax, compiled by mud.compile_args.",
+    0,		                      /* tp_traverse */
+    0,		                      /* tp_clear */
+    0,		                      /* tp_richcompare */
+    0,		                      /* tp_weaklistoffset */
+    0,		                      /* tp_iter */
+    0,		                      /* tp_iternext */
+    0,                                /* tp_methods */
+    0,                                /* tp_members */
+    PyParseFormat_getseters,          /* tp_getset */
+};
+
+//
+// compile a syntax for parse_args ahead of time
+PyObject *mud_compile_args(PyObject *self, PyObject *args) {
+  PyObject *syntax = NULL;
+  if(!PyArg_ParseTuple(args, "U", &syntax)) {
+    PyErr_Format(PyExc_TypeError, "compile_args must be supplied a syntax");
+    return NULL;
+  }
+
+  PARSE_FORMAT *format = parseFormatGet(PyUnicode_AsUTF8(syntax));
+  if(!parseFormatOk(format)) {
+    parseFormatRelease(format);
+    PyErr_Format(PyExc_ValueError, "Format error in argument syntax: %U",
+		 syntax);
+    return NULL;
+  }
+
+  PyParseFormat *pyformat = PyObject_New(PyParseFormat, &PyParseFormat_Type);
+  if(pyformat == NULL) {
+    parseFormatRelease(format);
+    return NULL;
+  }
+  pyformat->format = format;
+  pyformat->syntax = Py_NewRef(syntax);
+  return (PyObject *)pyformat;
+}
+
+//
+// parses arguments for character commands. The syntax can be a string, or a
+// format made by compile_args
 PyObject *mud_parse_args(PyObject *self, PyObject *args) {
   PyObject   *pych = NULL;
   bool show_errors = FALSE;
   char        *cmd = NULL;
   char     *pyargs = NULL;
-  char     *syntax = NULL;
+  PyObject *syntax = NULL;
   char *parse_args = NULL;
   CHAR_DATA    *ch = NULL;
 
   // parse our arguments
-  if(!PyArg_ParseTuple(args, "Obsss", &pych, &show_errors, 
-		       &cmd, &pyargs, &syntax)) {
+  if(!PyArg_ParseTuple(args, "ObssO", &pych, &show_errors, 
+		       &cmd, &pyargs, &syntax) ||
+     !(PyUnicode_Check(syntax) ||
+       PyObject_TypeCheck(syntax, &PyParseFormat_Type))) {
     PyErr_Format(PyExc_TypeError, "Invalid arguments to parse_args");
     return NULL;
   }
@@ -154,7 +252,13 @@ PyObject *mud_parse_args(PyObject *self, PyObject *args) {
   parse_args = strdup(pyargs);
 
   // finish up and garbage collections
-  PyObject *retval = Py_parse_args(ch, show_errors, cmd, parse_args, syntax);
+  PyObject *retval = NULL;
+  if(PyUnicode_Check(syntax))
+    retval = Py_parse_args(ch, show_errors, cmd, parse_args,
+			   PyUnicode_AsUTF8(syntax));
+  else
+    retval = Py_parse_args_format(ch, show_errors, cmd, parse_args,
+				  ((PyParseFormat *)syntax)->format);
   free(parse_args);
   return retval;
 }
@@ -419,6 +523,8 @@ PyObject *mud_message(PyObject *self, PyObject *args) {
     SET_BIT(range, TO_ROOM);
   if(is_keyword(pyrange, "to_world", FALSE))
     SET_BIT(range, TO_WORLD);
+  if(is_keyword(pyrange, "to_zone", FALSE))
+    SET_BIT(range, TO_ZONE);
 
   // finally, send out the message
   message(ch, vict, obj, vobj, hide_nosee, range, mssg);
@@ -474,6 +580,52 @@ PyObject *mud_extract(PyObject *self, PyObject *args) {
   return Py_BuildValue("i", 1);
 }
 
+//
+// moves a group of characters from one room to another together
+PyObject *mud_move_group(PyObject *self, PyObject *args) {
+  PyObject *pychars = NULL;
+  PyObject  *pydest = NULL;
+  PyObject  *pyexit = Py_None;
+  if(!PyArg_ParseTuple(args, "OO|O", &pychars, &pydest, &pyexit) ||
+     !PyList_Check(pychars) || !PyRoom_Check(pydest) ||
+     (pyexit != Py_None && !PyExit_Check(pyexit))) {
+    PyErr_Clear();
+    PyErr_Format(PyExc_TypeError, "move_group takes a list of characters, the "
+		 "room they are going to, and optionally the exit they use.");
+    return NULL;
+  }
+
+  ROOM_DATA *dest = PyRoom_AsRoom(pydest);
+  EXIT_DATA *exit = (pyexit == Py_None ? NULL : PyExit_AsExit(pyexit));
+  if(dest == NULL) {
+    PyErr_Format(PyExc_Exception, "Tried to move a group to a nonexistent "
+		 "room.");
+    return NULL;
+  }
+
+  LIST  *chars = newList();
+  ROOM_DATA *from = NULL;
+  Py_ssize_t    i = 0;
+  for(i = 0; i < PyList_Size(pychars); i++) {
+    PyObject *pych = PyList_GetItem(pychars, i);
+    CHAR_DATA  *ch = (PyChar_Check(pych) ? PyChar_AsChar(pych) : NULL);
+    if(ch == NULL || charGetRoom(ch) == NULL ||
+       (from != NULL && charGetRoom(ch) != from)) {
+      deleteList(chars);
+      PyErr_Format(PyExc_Exception, "Everyone moving in a group must exist, "
+		   "and start out in the same room.");
+      return NULL;
+    }
+    from = charGetRoom(ch);
+    if(!listIn(chars, ch))
+      listQueue(chars, ch);
+  }
+
+  do_group_move(chars, dest, exit);
+  deleteList(chars);
+  return Py_BuildValue("");
+}
+
 //
 // functional form of if/then/else
 PyObject *mud_ite(PyObject *self, PyObject *args) {
@@ -525,6 +677,44 @@ PyObject *mud_get_greeting(PyObject *self, PyObject *args) {
   return Py_BuildValue("s", bufferString(greeting));
 }
 
+//
+// set what a colour code is translated into
+PyObject *mud_set_colour(PyObject *self, PyObject *args) {
+  char  *code = NULL;
+  char  *ansi = NULL;
+  char *xterm = NULL;
+  if(!PyArg_ParseTuple(args, "sz|z", &code, &ansi, &xterm)) {
+    PyErr_Format(PyExc_TypeError, 
+		 "set_colour takes a code, and its ANSI and 256-colour forms");
+    return NULL;
+  }
+  if(strlen(code) != 1 || *code == COLOUR_MARKER) {
+    PyErr_Format(PyExc_ValueError, 
+		 "colour codes must be one character, and not the marker");
+    return NULL;
+  }
+  colourSetCode(*code, ansi, xterm);
+  return Py_BuildValue("");
+}
+
+PyObject *mud_get_colour(PyObject *self, PyObject *args) {
+  char *code = NULL;
+  char *mode = "ansi";
+  if(!PyArg_ParseTuple(args, "s|s", &code, &mode)) {
+    PyErr_Format(PyExc_TypeError, "get_colour takes a code and a mode");
+    return NULL;
+  }
+  int mode_num = colourModeFromName(mode);
+  if(mode_num == -1) {
+    PyErr_Format(PyExc_ValueError, "%s is not a colour mode", mode);
+    return NULL;
+  }
+  const char *seq = (strlen(code) == 1 ? colourGetCode(*code, mode_num):NULL);
+  if(seq == NULL)
+    return Py_BuildValue("");
+  return Py_BuildValue("s", seq);
+}
+
 PyObject *mud_log_string(PyObject *self, PyObject *args) {
   char *mssg = NULL;
   if(!PyArg_ParseTuple(args, "s", &mssg)) {
@@ -587,11 +777,18 @@ PyObject *mud_send(PyObject *self, PyObject *args, PyObject *kwds) {
     return NULL;
   }
 
-  // make sure the list is a list
-  if(!PyList_Check(list)) {
+  // make sure the list is a list. Views, like room.chars, are sent to as a
+  // copy, since sending can run scripts that move people around
+  if(PyListView_Check(list))
+    list = PySequence_List(list);
+  else if(PyList_Check(list))
+    Py_INCREF(list);
+  else {
     PyErr_Format(PyExc_TypeError, "mud.send expects first argument to be a list of characters.");
     return NULL;
   }
+  if(list == NULL)
+    return NULL;
 
   // go through our list of characters, and send each of them the message
   int i = 0;
@@ -607,9 +804,139 @@ PyObject *mud_send(PyObject *self, PyObject *args, PyObject *kwds) {
       PyDict_SetItemString(dict, "ch", charGetPyFormBorrowed(ch));
     expand_to_char(ch, text, dict, get_script_locale(), newline);
   }
+  Py_DECREF(list);
+  return Py_BuildValue("");
+}
+
+//
+// send text to everyone outdoors, in a zone, or on a channel. The text is sent
+// as-is; % does not need to be escaped
+PyObject *mud_send_outdoors(PyObject *self, PyObject *args) {
+  char *mssg = NULL;
+  if(!PyArg_ParseTuple(args, "s", &mssg)) {
+    PyErr_Format(PyExc_TypeError, "send_outdoors must be supplied a message");
+    return NULL;
+  }
+  send_outdoors("%s", mssg);
+  return Py_BuildValue("");
+}
+
+PyObject *mud_send_to_zone(PyObject *self, PyObject *args) {
+  char *zone = NULL, *mssg = NULL;
+  if(!PyArg_ParseTuple(args, "ss", &zone, &mssg)) {
+    PyErr_Format(PyExc_TypeError, "send_to_zone takes a zone key and message");
+    return NULL;
+  }
+  send_to_zone(zone, "%s", mssg);
+  return Py_BuildValue("");
+}
+
+PyObject *mud_send_to_channel(PyObject *self, PyObject *args) {
+  char *channel = NULL, *mssg = NULL;
+  if(!PyArg_ParseTuple(args, "ss", &channel, &mssg)) {
+    PyErr_Format(PyExc_TypeError, "send_to_channel takes a channel and message");
+    return NULL;
+  }
+  send_to_channel(channel, "%s", mssg);
+  return Py_BuildValue("");
+}
+
+//
+// join a character to a channel, or take them off of it
+PyObject *mud_channel_join_or_leave(PyObject *args, bool join) {
+  char   *channel = NULL;
+  PyObject  *pych = NULL;
+  CHAR_DATA   *ch = NULL;
+  if(!PyArg_ParseTuple(args, "sO", &channel, &pych) ||
+     !PyChar_Check(pych) || (ch = PyChar_AsChar(pych)) == NULL) {
+    PyErr_Format(PyExc_TypeError, "a channel and existent character must be "
+		 "supplied");
+    return NULL;
+  }
+  if(join)
+    channelJoin(channel, ch);
+  else
+    channelLeave(channel, ch);
   return Py_BuildValue("");
 }
 
+PyObject *mud_join_channel(PyObject *self, PyObject *args) {
+  return mud_channel_join_or_leave(args, TRUE);
+}
+
+PyObject *mud_leave_channel(PyObject *self, PyObject *args) {
+  return mud_channel_join_or_leave(args, FALSE);
+}
+
+PyObject *mud_channel_members(PyObject *self, PyObject *args) {
+  char *channel = NULL;
+  if(!PyArg_ParseTuple(args, "s", &channel)) {
+    PyErr_Format(PyExc_TypeError, "channel_members must be supplied a channel");
+    return NULL;
+  }
+  LIST    *members = channelGetMembers(channel);
+  PyObject   *list = PyList_New(0);
+  CHAR_DATA    *ch = NULL;
+  while((ch = listPop(members)) != NULL)
+    PyList_Append(list, charGetPyFormBorrowed(ch));
+  deleteList(members);
+  return list;
+}
+
+//
+// channel_message(channel, ch, mssg, history = None)
+PyObject *mud_channel_message(PyObject *self, PyObject *args, PyObject *kwds) {
+  static char *kwlist[ ] = { "channel", "ch", "mssg", "history", NULL };
+  char   *channel = NULL, *mssg = NULL, *history = NULL;
+  PyObject  *pych = NULL;
+  CHAR_DATA   *ch = NULL;
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "sOs|z", kwlist,
+				  &channel, &pych, &mssg, &history)) {
+    PyErr_Format(PyExc_TypeError, "channel_message takes a channel, character, "
+		 "and message, and optionally a line of history");
+    return NULL;
+  }
+  if(pych != Py_None &&
+     (!PyChar_Check(pych) || (ch = PyChar_AsChar(pych)) == NULL)) {
+    PyErr_Format(PyExc_TypeError, "channel_message must be supplied an "
+		 "existent character or None");
+    return NULL;
+  }
+  channelMessage(channel, ch, NULL, NULL, NULL, FALSE, mssg);
+  if(history != NULL)
+    channelAddHistory(channel, history);
+  return Py_BuildValue("");
+}
+
+PyObject *mud_set_channel_group(PyObject *self, PyObject *args) {
+  char *channel = NULL, *group = NULL;
+  if(!PyArg_ParseTuple(args, "sz", &channel, &group)) {
+    PyErr_Format(PyExc_TypeError, "set_channel_group takes a channel and a "
+		 "user group, or None");
+    return NULL;
+  }
+  channelSetGroup(channel, group);
+  return Py_BuildValue("");
+}
+
+PyObject *mud_channel_history(PyObject *self, PyObject *args) {
+  char *channel = NULL;
+  if(!PyArg_ParseTuple(args, "s", &channel)) {
+    PyErr_Format(PyExc_TypeError, "channel_history must be supplied a channel");
+    return NULL;
+  }
+  LIST   *mssgs = channelGetHistory(channel);
+  PyObject *list = PyList_New(0);
+  char     *mssg = NULL;
+  while((mssg = listPop(mssgs)) != NULL) {
+    PyObject *str = PyUnicode_FromString(mssg);
+    PyList_Append(list, str);
+    Py_DECREF(str);
+  }
+  deleteList(mssgs);
+  return list;
+}
+
 PyObject *mud_expand_text(PyObject *self, PyObject *args, PyObject *kwds) {
   static char *kwlist[ ] = { "text", "dict", "newline", NULL };
   char     *text = NULL;
@@ -684,6 +1011,15 @@ static struct PyModuleDef mud_moduledef = {
 
 PyMODINIT_FUNC
 PyInit_PyMud(void) {
+  // sleep, wait_for, and spawn, for coroutines
+  init_pycoro();
+
+  // regenerators, for pools that fill back up over time
+  init_pyregen();
+
+  // routines, for the steps characters go through over time
+  init_pyroutine();
+
   // add all of our methods
   PyMud_addMethod("get_global", mud_get_global, METH_VARARGS,
     "get_global(name)\n\n"
@@ -697,7 +1033,7 @@ PyInit_PyMud(void) {
   PyMud_addMethod("message", mud_message, METH_VARARGS,
     "message(ch, vict, obj, vobj, show_invis, range, mssg)\n\n"
     "Send a message via the mud messaging system using $ expansions. Range\n"
-    "can be 'to_room', 'to_char', 'to_vict', or 'to_world'.");
+    "can be 'to_room', 'to_char', 'to_vict', 'to_zone', or 'to_world'.");
   PyMud_addMethod("format_string", mud_format_string, METH_VARARGS,
     "format_string(text, indent=True, width=80)\n\n"
     "Format a block of text to be of the specified width, possibly indenting\n"
@@ -719,6 +1055,12 @@ PyInit_PyMud(void) {
   PyMud_addMethod("extract", mud_extract, METH_VARARGS,
     "extract(thing)\n\n"
     "Extracts an object, character, or room from the game.");
+  PyMud_addMethod("move_group", mud_move_group, METH_VARARGS,
+    "move_group(chars, room, exit = None)\n\n"
+    "Move a list of characters in the same room into another room together,\n"
+    "as if through exit. Everyone's exit and enter hooks are run, but enter\n"
+    "and exit triggers are set off once for the group, and people in it\n"
+    "don't set off each other's. Messages and looking are up to the caller.");
   PyMud_addMethod("keys_equal", mud_keys_equal, METH_VARARGS,
     "keys_equal(key1, key2)\n\n"
     "Returns whether two world database keys are equal, relative to the\n"
@@ -728,13 +1070,29 @@ PyInit_PyMud(void) {
     "A functional form of if/then/else.");
   PyMud_addMethod("parse_args", mud_parse_args, METH_VARARGS,
     "parse_args(ch, show_usage_errors, cmd, args, format)\n\n"
-    "equivalent to parse_args written in C. See parse.h for information.");
+    "equivalent to parse_args written in C. See parse.h for information.\n"
+    "format can be a string, or a format made by compile_args.");
+  PyMud_addMethod("compile_args", mud_compile_args, METH_VARARGS,
+    "compile_args(format)\n\n"
+    "Compile a parse_args format ahead of time, for modules that want to\n"
+    "hold onto their parsers. Raises a ValueError if the format has an\n"
+    "error in it.");
   PyMud_addMethod("get_motd", mud_get_motd, METH_NOARGS,
     "get_motd()\n\n"
     "Returns the mud's message of the day.");
   PyMud_addMethod("get_greeting", mud_get_greeting, METH_NOARGS,
     "get_greeting()\n\n"
     "returns the mud's connection greeting.");
+  PyMud_addMethod("set_colour", mud_set_colour, METH_VARARGS,
+    "set_colour(code, ansi, xterm = None)\n\n"
+    "Set what a colour code (the character after {) is turned into before\n"
+    "text is sent to sockets. xterm is used for sockets that can show 256\n"
+    "colours, and defaults to the ANSI form. If ansi is None, the code stops\n"
+    "being a colour code.");
+  PyMud_addMethod("get_colour", mud_get_colour, METH_VARARGS,
+    "get_colour(code, mode = 'ansi')\n\n"
+    "Returns what a colour code is turned into in the given mode ('none',\n"
+    "'ansi', or '256'), or None if it is not a colour code.");
   PyMud_addMethod("log_string", mud_log_string, METH_VARARGS,
     "log_string(mssg)\n"
     "Send a message to the mud's log.");
@@ -752,6 +1110,38 @@ PyInit_PyMud(void) {
     "embedded in them, using [ and ]. If so, a variable dictionary must be\n"
     "provided. By default, 'ch' references each character being sent the\n"
     "message, for embedded scripts.");
+  PyMud_addMethod("send_outdoors", mud_send_outdoors, METH_VARARGS,
+    "send_outdoors(mssg)\n\n"
+    "Send a message to everyone who is outdoors.");
+  PyMud_addMethod("send_to_zone", mud_send_to_zone, METH_VARARGS,
+    "send_to_zone(zone, mssg)\n\n"
+    "Send a message to everyone in the zone with the given key.");
+  PyMud_addMethod("send_to_channel", mud_send_to_channel, METH_VARARGS,
+    "send_to_channel(channel, mssg)\n\n"
+    "Send a message to everyone who has joined a channel.");
+  PyMud_addMethod("join_channel", mud_join_channel, METH_VARARGS,
+    "join_channel(channel, ch)\n\n"
+    "Join a character to a channel. Characters leave all of their channels\n"
+    "when they leave the game.");
+  PyMud_addMethod("leave_channel", mud_leave_channel, METH_VARARGS,
+    "leave_channel(channel, ch)\n\n"
+    "Take a character off of a channel.");
+  PyMud_addMethod("channel_members", mud_channel_members, METH_VARARGS,
+    "channel_members(channel)\n\n"
+    "Return a list of everyone who has joined a channel.");
+  PyMud_addMethod("channel_message", mud_channel_message,
+		  METH_VARARGS | METH_KEYWORDS,
+    "channel_message(channel, ch, mssg, history = None)\n\n"
+    "Send a message, with $n and the like standing for ch as in message(),\n"
+    "to everyone on a channel but ch. If history is given, it is added to\n"
+    "the lines the channel remembers.");
+  PyMud_addMethod("set_channel_group", mud_set_channel_group, METH_VARARGS,
+    "set_channel_group(channel, group)\n\n"
+    "Keep a channel for a user group: everyone in it is on the channel while\n"
+    "they are in the game. None stops keeping it for a group.");
+  PyMud_addMethod("channel_history", mud_channel_history, METH_VARARGS,
+    "channel_history(channel)\n\n"
+    "Return the last lines added to a channel's history, oldest first.");
   PyMud_addMethod("expand_text", mud_expand_text, METH_VARARGS | METH_KEYWORDS,
     "expand_text(text, dict={}, newline=False)\n\n"
     "Take text with embedded Python statements. Statements can be embedded\n"
@@ -773,6 +1163,12 @@ PyInit_PyMud(void) {
 
 }
 
+  // make sure our compiled parse formats are ready to be made
+  if(PyType_Ready(&PyParseFormat_Type) < 0)
+    return NULL;
+  Py_INCREF(&PyParseFormat_Type);
+  PyModule_AddObject(module, "ParseFormat", (PyObject *)&PyParseFormat_Type);
+
   globals = PyDict_New();
   Py_INCREF(globals);
 
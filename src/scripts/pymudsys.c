@@ -18,7 +18,12 @@
 #include "../account.h"
 #include "../storage.h"
 #include "../world.h"
+#include "../room.h"
 #include "../zone.h"
+#include "../pulse.h"
+#include "../offload.h"
+#include "../upgrade.h"
+#include "../social.h"
 
 #include "pymudsys.h"
 #include "scripts.h"
@@ -30,6 +35,8 @@
 #include "pyexit.h"
 #include "pyobj.h"
 #include "pystorage.h"
+#include "script_prof.h"
+#include "pyoffload.h"
 
 
 
@@ -93,10 +100,19 @@ PyObject *mudsys_shutdown(PyObject *self, PyObject *args) {
 }
 
 PyObject *mudsys_copyover(PyObject *self, PyObject *args) {
-  do_copyover();
+  int hot = FALSE;
+  if(!PyArg_ParseTuple(args, "|i", &hot)) {
+    PyErr_Format(PyExc_TypeError, "do_copyover takes an optional hot flag.");
+    return NULL;
+  }
+  do_copyover(hot);
   return Py_BuildValue("i", 1);
 }
 
+PyObject *mudsys_upgrade(PyObject *self, PyObject *args) {
+  return Py_BuildValue("i", upgradeStart());
+}
+
 PyObject *mudsys_create_account(PyObject *self, PyObject *args) {
   char *name = NULL;
   if(!PyArg_ParseTuple(args, "s", &name)) {
@@ -450,6 +466,27 @@ PyObject *mudsys_load_char(PyObject *self, PyObject *args) {
   return Py_BuildValue("O", charGetPyFormBorrowed(ch));
 }
 
+//
+// returns the PC in the game with the name, or None
+PyObject *mudsys_find_player(PyObject *self, PyObject *args) {
+  char *name = NULL;
+  if(!PyArg_ParseTuple(args, "s", &name)) {
+    PyErr_Format(PyExc_TypeError, "A character name must be supplied.");
+    return NULL;
+  }
+
+  CHAR_DATA *ch = find_player(name);
+  if(ch == NULL)
+    return Py_BuildValue("O", Py_None);
+  return Py_BuildValue("O", charGetPyFormBorrowed(ch));
+}
+
+//
+// how many PCs are in the game
+PyObject *mudsys_count_players(PyObject *self, void *closure) {
+  return PyLong_FromLong(count_players());
+}
+
 //
 // tries to put the player into the game
 PyObject *mudsys_try_enter_game(PyObject *self, PyObject *args) {
@@ -474,7 +511,7 @@ PyObject *mudsys_try_enter_game(PyObject *self, PyObject *args) {
   }
 
   // only enter game if we're not already in the game
-  if(listIn(mobile_list, ch))
+  if(setIn(mobile_set, ch))
     return Py_BuildValue("i", 0);
   else
     return Py_BuildValue("i", try_enter_game(ch));
@@ -513,54 +550,157 @@ PyObject *mudsys_do_disconnect(PyObject *self, PyObject *args) {
   return Py_BuildValue("i", 1);
 }
 
-PyObject *mudsys_password_matches(PyObject *self, PyObject *args) {
-  PyObject   *pyacct = NULL;
-  char          *pwd = NULL;
-  ACCOUNT_DATA *acct = NULL;
+//
+// a password being checked or set off of the game thread
+typedef struct {
+  PyObject   *pyacct; // only touched on the game thread
+  PyObject *callback;
+  char         *name;
+  char     *password;
+  char         *hash; // what the account's hash was
+  char      *setting; // what to hash the password with, if it needs it
+  char     *new_hash; // the password hashed, if it was
+  bool       matches;
+  bool       upgrade; // is new_hash replacing an old kind of hash?
+} PASSWORD_JOB;
 
-  if(!PyArg_ParseTuple(args, "Os", &pyacct, &pwd)) {
+//
+// parse (acct, password, callback = None) for password_matches and
+// set_password, and return the account
+ACCOUNT_DATA *password_parse_args(PyObject *args, const char *what,
+				  PyObject **pyacct, char **pwd,
+				  PyObject **callback) {
+  ACCOUNT_DATA *acct = NULL;
+  if(!PyArg_ParseTuple(args, "Os|O", pyacct, pwd, callback)) {
     PyErr_Format(PyExc_TypeError, "an account and password must be supplied.");
     return NULL;
   }
 
-  if(!PyAccount_Check(pyacct)) {
-    PyErr_Format(PyExc_TypeError, "only accounts may have passwords checked.");
+  if(!PyAccount_Check(*pyacct)) {
+    PyErr_Format(PyExc_TypeError, "only accounts may have passwords %s.", 
+		 what);
     return NULL;
   }
 
-  if( (acct = PyAccount_AsAccount(pyacct)) == NULL) {
+  if( (acct = PyAccount_AsAccount(*pyacct)) == NULL) {
     PyErr_Format(PyExc_Exception,
-		 "Tried to check password for nonexistant account.");
+		 "Tried to %s password for nonexistant account.", what);
+    return NULL;
+  }
+
+  if(*callback == Py_None)
+    *callback = NULL;
+  if(*callback != NULL && !PyCallable_Check(*callback)) {
+    PyErr_Format(PyExc_TypeError, "password callbacks must be callable.");
     return NULL;
   }
+  return acct;
+}
 
-  return Py_BuildValue("i", compares(crypt(pwd, accountGetName(acct)), 
-				     accountGetPassword(acct)));
+PASSWORD_JOB *newPasswordJob(PyObject *pyacct, ACCOUNT_DATA *acct,
+			     const char *pwd, PyObject *callback) {
+  PASSWORD_JOB *job = calloc(1, sizeof(PASSWORD_JOB));
+  job->pyacct       = pyacct;
+  job->callback     = callback;
+  job->name         = strdupsafe(accountGetName(acct));
+  job->password     = strdup(pwd);
+  job->hash         = strdupsafe(accountGetPassword(acct));
+  job->setting      = passwordNewSetting();
+  Py_INCREF(pyacct);
+  Py_INCREF(callback);
+  return job;
 }
 
-PyObject *mudsys_set_password(PyObject *self, PyObject *args) {
-  PyObject   *pyacct = NULL;
-  char          *pwd = NULL;
-  ACCOUNT_DATA *acct = NULL;
+void deletePasswordJob(PASSWORD_JOB *job) {
+  // don't leave the password lying around in freed memory
+  memset(job->password, 0, strlen(job->password));
+  free(job->password);
+  free(job->name);
+  free(job->hash);
+  free(job->setting);
+  if(job->new_hash) free(job->new_hash);
+  Py_DECREF(job->pyacct);
+  Py_DECREF(job->callback);
+  free(job);
+}
 
-  if(!PyArg_ParseTuple(args, "Os", &pyacct, &pwd)) {
-    PyErr_Format(PyExc_TypeError, "an account and password must be supplied.");
-    return NULL;
+//
+// off of the game thread. Old hashes are replaced once we know the password
+void password_check_run(PASSWORD_JOB *job) {
+  job->matches = passwordMatches(job->password, job->hash, job->name);
+  if(job->matches && !passwordIsCurrent(job->hash)) {
+    job->new_hash = passwordHash(job->password, job->setting);
+    job->upgrade  = TRUE;
   }
+}
 
-  if(!PyAccount_Check(pyacct)) {
-    PyErr_Format(PyExc_TypeError, "only accounts may have passwords set.");
+void password_set_run(PASSWORD_JOB *job) {
+  job->new_hash = passwordHash(job->password, job->setting);
+  job->matches  = TRUE;
+}
+
+//
+// back on the game thread. Store the new hash, if the account is still here,
+// and tell whoever asked how it went
+void password_done(PASSWORD_JOB *job) {
+  ACCOUNT_DATA *acct = PyAccount_AsAccount(job->pyacct);
+  if(acct == NULL)
+    PyErr_Clear();
+  // only if nothing else changed the password in the meantime
+  else if(job->new_hash != NULL && 
+	  !strcmp(job->hash, accountGetPassword(acct) ? 
+		  accountGetPassword(acct) : "")) {
+    accountSetPassword(acct, job->new_hash);
+    // new passwords are saved by whoever set them, along with the account
+    if(job->upgrade)
+      save_account(acct);
+  }
+
+  PyObject *ret = PyObject_CallFunction(job->callback, "O", 
+					(job->matches ? Py_True : Py_False));
+  if(ret == NULL)
+    log_pyerr("Error in the callback of a password check:");
+  Py_XDECREF(ret);
+  deletePasswordJob(job);
+}
+
+PyObject *mudsys_password_matches(PyObject *self, PyObject *args) {
+  PyObject   *pyacct = NULL;
+  PyObject *callback = NULL;
+  char          *pwd = NULL;
+  ACCOUNT_DATA *acct = 
+    password_parse_args(args, "checked", &pyacct, &pwd, &callback);
+  if(acct == NULL)
     return NULL;
-  }
 
-  if( (acct = PyAccount_AsAccount(pyacct)) == NULL) {
-    PyErr_Format(PyExc_Exception,
-		 "Tried to set password for nonexistant account.");
+  if(callback == NULL)
+    return Py_BuildValue("i", passwordMatches(pwd, accountGetPassword(acct),
+					      accountGetName(acct)));
+  offloadSubmit(password_check_run, password_done,
+		newPasswordJob(pyacct, acct, pwd, callback));
+  return Py_BuildValue("");
+}
+
+PyObject *mudsys_set_password(PyObject *self, PyObject *args) {
+  PyObject   *pyacct = NULL;
+  PyObject *callback = NULL;
+  char          *pwd = NULL;
+  ACCOUNT_DATA *acct = 
+    password_parse_args(args, "set", &pyacct, &pwd, &callback);
+  if(acct == NULL)
     return NULL;
-  }
 
-  accountSetPassword(acct, crypt(pwd, accountGetName(acct)));
-  return Py_BuildValue("i", 1);
+  if(callback == NULL) {
+    char *setting = passwordNewSetting();
+    char    *hash = passwordHash(pwd, setting);
+    accountSetPassword(acct, hash);
+    free(setting);
+    free(hash);
+    return Py_BuildValue("i", 1);
+  }
+  offloadSubmit(password_set_run, password_done,
+		newPasswordJob(pyacct, acct, pwd, callback));
+  return Py_BuildValue("");
 }
 
 // checks if a command exists, via a python script or module. Takes in a
@@ -655,6 +795,65 @@ PyObject *mudsys_remove_cmd(PyObject *self, PyObject *args) {
 }
 
 
+//
+// hand a social over to the social table, from anything with the attributes
+// the socials module's Social objects have
+PyObject *mudsys_add_social(PyObject *self, PyObject *args) {
+  // our messages, in the order socialAdd wants them, and everything else
+  enum { CMDS = NUM_SOCIAL_MSSGS, ADVERB, ADJECTIVE, MIN_POS, MAX_POS,
+	 NUM_ATTRS };
+  static const char *attrs[NUM_ATTRS] = {
+    "to_char_notgt", "to_room_notgt", "to_char_self", "to_room_self",
+    "to_char_tgt",   "to_vict_tgt",   "to_room_tgt",
+    "cmds", "adverb", "adjective", "min_pos", "max_pos"
+  };
+  PyObject        *social = NULL;
+  PyObject *vals[NUM_ATTRS] = { NULL };
+  const char *strs[NUM_ATTRS] = { NULL };
+  bool                   ok = TRUE;
+  int                     i;
+
+  if(!PyArg_ParseTuple(args, "O", &social)) {
+    PyErr_Format(PyExc_TypeError, "add_social must be supplied a social.");
+    return NULL;
+  }
+
+  // anything missing or None is something the social doesn't have
+  for(i = 0; i < NUM_ATTRS && ok; i++) {
+    if((vals[i] = PyObject_GetAttrString(social, attrs[i])) == NULL)
+      PyErr_Clear();
+    else if(PyUnicode_Check(vals[i]))
+      strs[i] = PyUnicode_AsUTF8(vals[i]);
+    else if(vals[i] != Py_None) {
+      PyErr_Format(PyExc_TypeError, "A social's %s must be a string.",
+		   attrs[i]);
+      ok = FALSE;
+    }
+  }
+
+  if(ok && (strs[CMDS] == NULL || !*strs[CMDS])) {
+    PyErr_Format(PyExc_ValueError, "A social needs at least one command.");
+    ok = FALSE;
+  }
+  if(ok)
+    socialAdd(strs[CMDS], strs, strs[ADVERB], strs[ADJECTIVE],
+	      (strs[MIN_POS] ? posGetNum(strs[MIN_POS]) : POS_NONE),
+	      (strs[MAX_POS] ? posGetNum(strs[MAX_POS]) : POS_NONE));
+
+  for(i = 0; i < NUM_ATTRS; i++)
+    Py_XDECREF(vals[i]);
+  return (ok ? Py_BuildValue("") : NULL);
+}
+
+PyObject *mudsys_remove_social(PyObject *self, PyObject *args) {
+  char *name = NULL;
+  if(!PyArg_ParseTuple(args, "s", &name)) {
+    PyErr_Format(PyExc_TypeError, "function requires string argument.");
+    return NULL;
+  }
+  return Py_BuildValue("i", socialRemove(name));
+}
+
 PyObject *mudsys_handle_cmd_input(PyObject *self, PyObject *args) {
   PyObject  *pysock = NULL;
   SOCKET_DATA *sock = NULL;
@@ -904,6 +1103,7 @@ PyObject *mudsys_register_char_cansee(PyObject *self, PyObject *args) {
     pychar_see_checks = newList();
   Py_INCREF(check);
   listPut(pychar_see_checks, check);
+  sightChanged();
 
   return Py_BuildValue("O", Py_None);
 }
@@ -919,6 +1119,7 @@ PyObject *mudsys_register_obj_cansee(PyObject *self, PyObject *args) {
     pyobj_see_checks = newList();
   Py_INCREF(check);
   listPut(pyobj_see_checks, check);
+  sightChanged();
 
   return Py_BuildValue("O", Py_None);
 }
@@ -934,9 +1135,15 @@ PyObject *mudsys_register_exit_cansee(PyObject *self, PyObject *args) {
     pyexit_see_checks = newList();
   Py_INCREF(check);
   listPut(pyexit_see_checks, check);
+  sightChanged();
+  roomForgetAllExitListings();
 
   return Py_BuildValue("O", Py_None);
 }
+PyObject *mudsys_sight_changed(PyObject *self, PyObject *args) {
+  sightChanged();
+  return Py_BuildValue("O", Py_None);
+}
 
 
 
@@ -1145,6 +1352,125 @@ PyObject *mudsys_can_edit_zone(PyObject *self, PyObject *args) {
 }
 
 
+//
+// returns a dictionary of the game loop's pulse timings, by phase
+PyObject *mudsys_pulse_stats(PyObject *self, PyObject *args) {
+  PyObject *stats = PyDict_New();
+  PyObject *entry = NULL;
+  int phase, bucket;
+
+  for(phase = 0; phase < NUM_PULSE_PHASES; phase++) {
+    PyObject *phasedict = PyDict_New();
+    PyObject *histogram = PyList_New(0);
+    long long     count = pulsePhaseGetCount(phase);
+
+    entry = Py_BuildValue("L", count);
+    PyDict_SetItemString(phasedict, "count", entry); Py_DECREF(entry);
+    entry = Py_BuildValue("L", pulsePhaseGetTotal(phase));
+    PyDict_SetItemString(phasedict, "total_usecs", entry); Py_DECREF(entry);
+    entry = Py_BuildValue("L", (count > 0 ? pulsePhaseGetTotal(phase)/count:0));
+    PyDict_SetItemString(phasedict, "avg_usecs", entry); Py_DECREF(entry);
+    entry = Py_BuildValue("L", pulsePhaseGetMax(phase));
+    PyDict_SetItemString(phasedict, "max_usecs", entry); Py_DECREF(entry);
+    entry = Py_BuildValue("L", pulsePhaseGetLast(phase));
+    PyDict_SetItemString(phasedict, "last_usecs", entry); Py_DECREF(entry);
+
+    // each histogram bucket is a (upper bound, count) pair. The last bucket
+    // has no upper bound, and uses None
+    for(bucket = 0; bucket < NUM_PULSE_BUCKETS; bucket++) {
+      if(pulseBucketGetBound(bucket) < 0)
+	entry = Py_BuildValue("(OL)", Py_None, 
+			      pulsePhaseGetBucket(phase, bucket));
+      else
+	entry = Py_BuildValue("(LL)", pulseBucketGetBound(bucket),
+			      pulsePhaseGetBucket(phase, bucket));
+      PyList_Append(histogram, entry);
+      Py_DECREF(entry);
+    }
+    PyDict_SetItemString(phasedict, "histogram", histogram);
+    Py_DECREF(histogram);
+
+    PyDict_SetItemString(stats, pulsePhaseGetName(phase), phasedict);
+    Py_DECREF(phasedict);
+  }
+
+  entry = Py_BuildValue("L", pulseGetCatchupCount());
+  PyDict_SetItemString(stats, "catchup_pulses", entry); Py_DECREF(entry);
+  entry = Py_BuildValue("L", pulseGetDroppedCount());
+  PyDict_SetItemString(stats, "dropped_pulses", entry); Py_DECREF(entry);
+  return stats;
+}
+
+//
+// clears the game loop's pulse timings
+PyObject *mudsys_reset_pulse_stats(PyObject *self, PyObject *args) {
+  pulseResetStats();
+  return Py_BuildValue("i", 1);
+}
+
+PyObject *mudsys_script_stats(PyObject *self, PyObject *args) {
+  PyObject *stats = PyDict_New();
+  PyObject *pystats = PyList_New(0);
+  PyObject *pyslow  = PyList_New(0);
+  PyObject *entry   = NULL;
+  LIST     *list    = scriptProfGetStats();
+  LIST_ITERATOR *stat_i = newListIterator(list);
+  SCRIPT_STAT  *stat = NULL;
+  const char *kind = NULL, *key = NULL, *owner = NULL;
+  long long usecs = 0;
+  time_t     when = 0;
+  int i;
+
+  ITERATE_LIST(stat, stat_i) {
+    entry = Py_BuildValue("{s:s,s:s,s:s,s:L,s:L,s:L,s:L}",
+			  "kind", stat->kind, "key", stat->key,
+			  "last_owner", stat->last_owner,
+			  "calls", stat->calls, "total_usecs", stat->total,
+			  "avg_usecs", (stat->calls > 0 ?
+					stat->total / stat->calls : 0),
+			  "max_usecs", stat->max);
+    PyList_Append(pystats, entry);
+    Py_DECREF(entry);
+  } deleteListIterator(stat_i);
+  deleteListWith(list, deleteScriptStat);
+
+  for(i = 0; scriptProfGetSlowRun(i, &kind, &key, &owner, &usecs, &when);i++){
+    entry = Py_BuildValue("{s:s,s:s,s:s,s:L,s:l}", "kind", kind, "key", key,
+			  "owner", owner, "usecs", usecs, "time", (long)when);
+    PyList_Append(pyslow, entry);
+    Py_DECREF(entry);
+  }
+
+  entry = PyBool_FromLong(scriptProfIsOn());
+  PyDict_SetItemString(stats, "profiling", entry); Py_DECREF(entry);
+  entry = Py_BuildValue("L", scriptProfGetSlowUsecs());
+  PyDict_SetItemString(stats, "slow_usecs", entry); Py_DECREF(entry);
+  PyDict_SetItemString(stats, "scripts", pystats);  Py_DECREF(pystats);
+  PyDict_SetItemString(stats, "slow", pyslow);      Py_DECREF(pyslow);
+  return stats;
+}
+
+PyObject *mudsys_set_script_profiling(PyObject *self, PyObject *args) {
+  PyObject     *on = NULL;
+  long long  usecs = -1;
+  if(!PyArg_ParseTuple(args, "O|L", &on, &usecs)) {
+    PyErr_Format(PyExc_TypeError,
+		 "set_script_profiling takes True or False, and optionally "
+		 "a slow threshold in microseconds.");
+    return NULL;
+  }
+  scriptProfSetOn(PyObject_IsTrue(on));
+  if(usecs >= 0)
+    scriptProfSetSlowUsecs(usecs);
+  return Py_BuildValue("i", 1);
+}
+
+PyObject *mudsys_reset_script_stats(PyObject *self, PyObject *args) {
+  scriptProfReset();
+  return Py_BuildValue("i", 1);
+}
+
+
 
 //*****************************************************************************
 // MudSys module
@@ -1188,13 +1514,24 @@ PyInit_PyMudSys(void) {
   register_obj_see(pycan_see_obj);
   register_exit_see(pycan_see_exit);
 
+  // running native kernels off of the game thread
+  init_pyoffload();
+
   // add all of our methods
   PyMudSys_addMethod("do_shutdown", mudsys_shutdown, METH_VARARGS,
 		     "do_shutdown()\n\n"
 		     "shuts the mud down.");
   PyMudSys_addMethod("do_copyover", mudsys_copyover, METH_VARARGS,
-		     "do_copyover()\n\n"
-		     "performs a copyover on the mud.");
+		     "do_copyover(hot = False)\n\n"
+		     "performs a copyover on the mud. A hot copyover keeps the world as\n"
+		     "it is, including the mobs and objects in every loaded room, and\n"
+		     "keeps MCCP streams going, instead of reloading and resetting.");
+  PyMudSys_addMethod("do_upgrade", mudsys_upgrade, METH_NOARGS,
+		     "do_upgrade()\n\n"
+		     "starts the mud binary up alongside us, and once it has booted,\n"
+		     "hands it our listeners and everyone's connection, and exits.\n"
+		     "Nobody is disconnected or refused while it boots. Returns\n"
+		     "whether the new process was started.");
   PyMudSys_addMethod("sys_setval", mudsys_set_sys_val, METH_VARARGS,
 		     "set_sysval(name, val)\n"
 		     "\n"
@@ -1233,6 +1570,16 @@ PyInit_PyMudSys(void) {
 		     "Return a saved character of specified name, or None.");
   PyMudSys_addMethod("load_char", mudsys_load_char, METH_VARARGS,
 		     "Alias for mudsys.get_player(name).");
+  PyMudSys_addMethod("find_player", mudsys_find_player, METH_VARARGS,
+		     "find_player(name)\n"
+		     "\n"
+		     "Return the player in the game with the name, or None. Unlike\n"
+		     "get_player, never loads anyone from disk.");
+  PyMudSys_addMethod("count_players", mudsys_count_players, METH_NOARGS,
+		     "count_players()\n"
+		     "\n"
+		     "Return how many PCs are in the game, without going through\n"
+		     "the character list.");
   PyMudSys_addMethod("load_account", mudsys_load_account, METH_VARARGS,
 		     "load_account(name)\n"
 		     "\n"
@@ -1269,13 +1616,18 @@ PyInit_PyMudSys(void) {
 		     "\n"
 		     "call detach_char_socket, then close the socket.");
   PyMudSys_addMethod("password_matches", mudsys_password_matches, METH_VARARGS,
-		     "password_matches(acct, psswd)\n"
+		     "password_matches(acct, psswd, callback = None)\n"
 		     "\n"
-		     "Returns True or False if the given password matches the account's password.");
+		     "Returns True or False if the given password matches the account's password.\n"
+		     "If a callback is given, the check is done off of the game thread\n"
+		     "instead, and callback is called with True or False once it is. Old\n"
+		     "password hashes are replaced with new ones when they match.");
   PyMudSys_addMethod("set_password", mudsys_set_password, METH_VARARGS,
-		     "set_password(acct, passwd)\n"
+		     "set_password(acct, passwd, callback = None)\n"
 		     "\n"
-		     "Set an account's password.");
+		     "Set an account's password. If a callback is given, the password is\n"
+		     "hashed off of the game thread, and callback is called with True\n"
+		     "once the account has it.");
   PyMudSys_addMethod("cmd_exists", mudsys_cmd_exists, METH_VARARGS,
          "cmd_exists(cmd_name)\n"
          "\n"
@@ -1301,6 +1653,17 @@ PyInit_PyMudSys(void) {
     "remove_cmd(name)\n"
     "\n"
     "Removes a command from the master command table.");
+  PyMudSys_addMethod("add_social", mudsys_add_social, METH_VARARGS,
+    "add_social(social)\n"
+    "\n"
+    "Add a social, or replace it. social has the attributes of a\n"
+    "socials.Social: cmds, the seven to_ messages, adverb, adjective,\n"
+    "min_pos and max_pos. Each of its comma-separated cmds can then be used\n"
+    "to perform it, if no command goes by the same name.");
+  PyMudSys_addMethod("remove_social", mudsys_remove_social, METH_VARARGS,
+    "remove_social(cmd)\n"
+    "\n"
+    "Stops cmd from being a social. Returns whether it was one.");
   PyMudSys_addMethod("handle_cmd_input", mudsys_handle_cmd_input, METH_VARARGS,
     "handle_cmd_input(sock, cmd)\n"
     "\n"
@@ -1366,6 +1729,13 @@ PyInit_PyMudSys(void) {
     METH_VARARGS, "Same as register_char_cansee for objects.");
   PyMudSys_addMethod("register_exit_cansee", mudsys_register_exit_cansee,
     METH_VARARGS, "Same as register_char_cansee for exits.");
+  PyMudSys_addMethod("sight_changed", mudsys_sight_changed, METH_NOARGS,
+    "sight_changed()\n"
+    "\n"
+    "What the cansee checks answer is remembered until something changes\n"
+    "what can be seen. Positions, hiding, and moving things are noticed on\n"
+    "their own, as is every command and pulse. Call this after changing\n"
+    "anything else a cansee check looks at, like lighting or invisibility.");
   PyMudSys_addMethod("set_cmd_move", mudsys_set_cmd_move, METH_VARARGS,
     "set_cmd_move(cmd_func)\n"
     "\n"
@@ -1400,6 +1770,31 @@ PyInit_PyMudSys(void) {
   PyMudSys_addMethod("can_edit_zone", mudsys_can_edit_zone, METH_VARARGS,
     "can_edit_zone(ch, zone)\n\n"
     "True or False if a character has permission to edit a zone.");
+  PyMudSys_addMethod("pulse_stats", mudsys_pulse_stats, METH_NOARGS,
+    "pulse_stats()\n\n"
+    "Returns a dictionary of game loop timings, in microseconds. Keys are the\n"
+    "pulse phases (input, update, output, total), each a dictionary of count,\n"
+    "total_usecs, avg_usecs, max_usecs, last_usecs and a histogram list of\n"
+    "(upper bound, count) pairs. Also has catchup_pulses and dropped_pulses.");
+  PyMudSys_addMethod("reset_pulse_stats", mudsys_reset_pulse_stats,METH_NOARGS,
+    "reset_pulse_stats()\n\n"
+    "Forget all the game loop timings gathered so far.");
+  PyMudSys_addMethod("script_stats", mudsys_script_stats, METH_NOARGS,
+    "script_stats()\n\n"
+    "Returns a dictionary of what the script profiler has seen: profiling\n"
+    "(whether it is on), slow_usecs (the slow run threshold), scripts (a list\n"
+    "of dictionaries of kind, key, last_owner, calls, total_usecs, avg_usecs\n"
+    "and max_usecs, most time taken first) and slow (a list of dictionaries\n"
+    "of kind, key, owner, usecs and time for recent slow runs, newest first).");
+  PyMudSys_addMethod("set_script_profiling", mudsys_set_script_profiling,
+    METH_VARARGS,
+    "set_script_profiling(on, slow_usecs = None)\n\n"
+    "Turn timing of triggers and prototype scripts on or off. If slow_usecs\n"
+    "is given, runs taking at least that long are remembered as slow.");
+  PyMudSys_addMethod("reset_script_stats", mudsys_reset_script_stats,
+    METH_NOARGS,
+    "reset_script_stats()\n\n"
+    "Forget all the script timings gathered so far.");
 
 
   
@@ -27,8 +27,10 @@
 #include "pyroom.h"
 #include "pyobj.h"
 #include "pyauxiliary.h"
+#include "pylistview.h"
 #include "pystorage.h"
 #include "pyskills_verbs.h"
+#include "trighooks.h"
 
 
 
@@ -181,159 +183,127 @@ PyObject* PyObj_richcompare(PyObject *pyobj1, PyObject *pyobj2, int op) {
 //*****************************************************************************
 // getters and setters for the Obj class
 //*****************************************************************************
+
+//
+// find the object a getter is for. If it no longer exists, raise an
+// error instead of handing Python back a NULL with no error set
+#define PYOBJ_GET_OBJ(self, obj)                                       \
+  OBJ_DATA *obj = PyObj_AsObj((PyObject *)(self));                     \
+  if(obj == NULL) {                                                    \
+    PyErr_Format(PyExc_TypeError,                                      \
+		 "Tried to read from nonexistent object, %d",          \
+		 PyObj_AsUid((PyObject *)(self)));                     \
+    return NULL;                                                       \
+  }
+
 PyObject *PyObj_getname(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("s", objGetName(obj));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return makePyString(objGetName(obj));
 }
 
 PyObject *PyObj_getmname(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("s", objGetMultiName(obj));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return makePyString(objGetMultiName(obj));
 }
 
 PyObject *PyObj_getbits(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("s", bitvectorGetBits(objGetBits(obj)));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return makePyString(bitvectorGetBits(objGetBits(obj)));
 }
 
 PyObject *PyObj_getkeywords(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("s", objGetKeywords(obj));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return makePyString(objGetKeywords(obj));
 }
 
 PyObject *PyObj_getdesc(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("s", objGetDesc(obj));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return makePyString(objGetDesc(obj));
 }
 
 PyObject *PyObj_getrdesc(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("s", objGetRdesc(obj));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return makePyString(objGetRdesc(obj));
 }
 
 PyObject *PyObj_getmdesc(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("s", objGetMultiRdesc(obj));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return makePyString(objGetMultiRdesc(obj));
 }
 
 PyObject *PyObj_getuid(PyObj *self, void *closure) {
-  return Py_BuildValue("i", self->uid);
+  return PyLong_FromLong(self->uid);
 }
 
 PyObject *PyObj_getprototypes(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("s", objGetPrototypes(obj));
-  else           return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return makePyString(objGetPrototypes(obj));
 }
 
 PyObject *PyObj_getweight(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("d", objGetWeight(obj));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return PyFloat_FromDouble(objGetWeight(obj));
 }
 
 
 PyObject *PyObj_get_weight_raw(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj != NULL) return Py_BuildValue("d", objGetWeightRaw(obj));
-  else            return NULL;
+  PYOBJ_GET_OBJ(self, obj);
+  return PyFloat_FromDouble(objGetWeightRaw(obj));
 }
 
 PyObject *PyObj_gethidden(PyObject *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj(self);
-  if(obj != NULL) return Py_BuildValue("i", objGetHidden(obj));
-  else            return NULL;  
+  PYOBJ_GET_OBJ(self, obj);
+  return PyLong_FromLong(objGetHidden(obj));
 }
 
 PyObject *PyObj_getbirth(PyObject *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj(self);
-  if(obj != NULL) return Py_BuildValue("i", objGetBirth(obj));
-  else            return NULL;  
+  PYOBJ_GET_OBJ(self, obj);
+  return PyLong_FromLong(objGetBirth(obj));
 }
 
 PyObject *PyObj_getage(PyObject *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj(self);
-  if(obj != NULL) return Py_BuildValue("d", difftime(current_time, objGetBirth(obj)));
-  else            return NULL;  
+  PYOBJ_GET_OBJ(self, obj);
+  return PyFloat_FromDouble(difftime(current_time, objGetBirth(obj)));
 }
 
 PyObject *PyObj_getcontents(PyObj *self, PyObject *args) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj == NULL) 
-    return NULL;
-
-  LIST_ITERATOR *cont_i = newListIterator(objGetContents(obj));
-  PyObject *list = PyList_New(0);
-  OBJ_DATA *cont;
-  
-  // for each obj in the contentory, add it to the Python list
-  ITERATE_LIST(cont, cont_i)
-    PyList_Append(list, objGetPyFormBorrowed(cont));
-  deleteListIterator(cont_i);
-  PyObject *retval = Py_BuildValue("O", list);
-  Py_DECREF(list);
-  return retval;
+  PYOBJ_GET_OBJ(self, obj);
+  return newPyListView(obj_table, objGetUID(obj),
+		       (void *)objGetContents, LISTVIEW_OBJS);
 }
 
 PyObject *PyObj_getchars(PyObj *self, PyObject *args) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj == NULL) 
-    return NULL;
-
-  LIST_ITERATOR *char_i = newListIterator(objGetUsers(obj));
-  PyObject *list = PyList_New(0);
-  CHAR_DATA *ch;
-  
-  // for each obj in the contentory, add it to the Python list
-  ITERATE_LIST(ch, char_i)
-    PyList_Append(list, charGetPyFormBorrowed(ch));
-  deleteListIterator(char_i);
-  PyObject *retval = Py_BuildValue("O", list);
-  Py_DECREF(list);
-  return retval;
+  PYOBJ_GET_OBJ(self, obj);
+  return newPyListView(obj_table, objGetUID(obj),
+		       (void *)objGetUsers, LISTVIEW_CHARS);
 }
 
 PyObject *PyObj_getcarrier(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj == NULL)
-    return NULL;
+  PYOBJ_GET_OBJ(self, obj);
   if(objGetCarrier(obj) == NULL)
-    return Py_BuildValue("O", Py_None);
-  return Py_BuildValue("O", charGetPyFormBorrowed(objGetCarrier(obj)));
+    return Py_NewRef(Py_None);
+  return Py_NewRef(charGetPyFormBorrowed(objGetCarrier(obj)));
 }
 
 PyObject *PyObj_getwearer(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj == NULL)
-    return NULL;
+  PYOBJ_GET_OBJ(self, obj);
   if(objGetWearer(obj) == NULL)
-    return Py_BuildValue("O", Py_None);
-  return Py_BuildValue("O", charGetPyFormBorrowed(objGetWearer(obj)));
+    return Py_NewRef(Py_None);
+  return Py_NewRef(charGetPyFormBorrowed(objGetWearer(obj)));
 }
 
 PyObject *PyObj_getroom(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj == NULL)
-    return NULL;
+  PYOBJ_GET_OBJ(self, obj);
   if(objGetRoom(obj) == NULL)
-    return Py_BuildValue("O", Py_None);
-  return Py_BuildValue("O", roomGetPyFormBorrowed(objGetRoom(obj)));
+    return Py_NewRef(Py_None);
+  return Py_NewRef(roomGetPyFormBorrowed(objGetRoom(obj)));
 }
 
 PyObject *PyObj_getcontainer(PyObj *self, void *closure) {
-  OBJ_DATA *obj = PyObj_AsObj((PyObject *)self);
-  if(obj == NULL)
-    return NULL;
+  PYOBJ_GET_OBJ(self, obj);
   if(objGetContainer(obj) == NULL)
-    return Py_BuildValue("O", Py_None);
-  return Py_BuildValue("O", objGetPyFormBorrowed(objGetContainer(obj)));
+    return Py_NewRef(Py_None);
+  return Py_NewRef(objGetPyFormBorrowed(objGetContainer(obj)));
 }
 
 //
@@ -674,6 +644,7 @@ PyObject *PyObj_attach(PyObj *self, PyObject *args) {
 		 get_fullkey_relative(key, get_script_locale()));
   if(trig != NULL) {
     triggerListAdd(objGetTriggers(obj), triggerGetKey(trig));
+    heartbeat_trighooks_update(obj, TRIGVAR_OBJ);
     return Py_BuildValue("i", 1);
   }
   else {
@@ -724,6 +695,7 @@ PyObject *PyObj_detach(PyObj *self, PyObject *args) {
   if(obj != NULL) {
     const char *fkey = get_fullkey_relative(key, get_script_locale());
     triggerListRemove(objGetTriggers(obj), fkey);
+    heartbeat_trighooks_update(obj, TRIGVAR_OBJ);
     return Py_BuildValue("i", 1);
   }
   else {
@@ -1039,15 +1011,46 @@ PyTypeObject PyObj_Type = {
 //*****************************************************************************
 // the obj module
 //*****************************************************************************
-PyObject *PyObj_load_obj(PyObject *self, PyObject *args) {
+//
+// figure out where we're trying to load an object to, and put it there
+void load_obj_to(OBJ_DATA *obj, ROOM_DATA *room, OBJ_DATA *cont,
+		 CHAR_DATA *ch, const char *equip_to) {
+  if(room != NULL)
+    obj_to_room(obj, room);
+  else if(cont != NULL)
+    obj_to_obj(obj, cont);
+  else if(ch != NULL) {
+    // we're just trying to send it to our inventory
+    if(equip_to == NULL)
+      obj_to_char(obj, ch);
+    // trying to equip to our default slots
+    else if(!*equip_to && objIsType(obj, "worn")) {
+      if(!try_equip(ch, obj, NULL, wornGetPositions(obj)))
+	obj_to_char(obj, ch);
+    }
+    // trying to equip to specific slots
+    else if(*equip_to) {
+      if(!try_equip(ch, obj, equip_to, NULL))
+	obj_to_char(obj, ch);
+    }
+    // can't equip it in any other case -- send it to the inventory
+    else
+      obj_to_char(obj, ch);
+  }
+}
+
+PyObject *PyObj_load_obj(PyObject *self, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = { "prototype", "where", "equip_to", "count", NULL };
   char          *key = NULL;
   PyObject       *in = Py_None;
   ROOM_DATA    *room = NULL; // are we loading to a room?
   OBJ_DATA     *cont = NULL; // are we loading to a container?
   CHAR_DATA      *ch = NULL; // are we loading to a character?
   char     *equip_to = NULL; // are we trying to equip the character?
+  int          count = 0;    // are we loading more than one?
 
-  if (!PyArg_ParseTuple(args, "s|Os", &key, &in, &equip_to)) {
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|Osi", kwlist, 
+				   &key, &in, &equip_to, &count)) {
     PyErr_Format(PyExc_TypeError, 
 		 "Load obj failed - it needs a key and destination.");
     return NULL;
@@ -1081,40 +1084,29 @@ PyObject *PyObj_load_obj(PyObject *self, PyObject *args) {
     return NULL;
   }
 
-  // copy the object
-  OBJ_DATA *obj = protoObjRun(obj_proto);
-  if(obj == NULL) {
+  // copy the object, as many times as we were asked to
+  LIST   *objs = newList();
+  int   loaded = protoObjRunBatch(obj_proto, MAX(1, count), objs);
+  if(loaded == 0) {
     //    PyErr_Format(PyExc_TypeError,
     //		 "Load obj failed: proto script terminated with an error.");
+    deleteList(objs);
     return NULL;
   }
 
-  // figure out where we're trying to load the object to
-  if(room != NULL)
-    obj_to_room(obj, room);
-  else if(cont != NULL)
-    obj_to_obj(obj, cont);
-  else if(ch != NULL) {
-    // we're just trying to send it to our inventory
-    if(equip_to == NULL)
-      obj_to_char(obj, ch);
-    // trying to equip to our default slots
-    else if(!*equip_to && objIsType(obj, "worn")) {
-      if(!try_equip(ch, obj, NULL, wornGetPositions(obj)))
-	obj_to_char(obj, ch);
-    }
-    // trying to equip to specific slots
-    else if(*equip_to) {
-      if(!try_equip(ch, obj, equip_to, NULL))
-	obj_to_char(obj, ch);
-    }
-    // can't equip it in any other case -- send it to the inventory
+  // put each one where it goes. If we were given a count, we return a list of
+  // everything we loaded. Otherwise, just the object
+  PyObject *retval = (count > 0 ? PyList_New(0) : NULL);
+  OBJ_DATA    *obj = NULL;
+  while((obj = listPop(objs)) != NULL) {
+    load_obj_to(obj, room, cont, ch, equip_to);
+    if(retval != NULL)
+      PyList_Append(retval, objGetPyFormBorrowed(obj));
     else
-      obj_to_char(obj, ch);
+      retval = Py_BuildValue("O", objGetPyFormBorrowed(obj));
   }
-
-  // create a python object for the new obj, and return it
-  return Py_BuildValue("O", objGetPyFormBorrowed(obj));
+  deleteList(objs);
+  return retval;
 }
 
 
@@ -1137,8 +1129,7 @@ PyObject *PyObj_count_objs(PyObject *self, PyObject *args) {
 
   // if we didn't supply something to look in, assume it means the world
   if(in == NULL)
-    return Py_BuildValue("i", count_objs(NULL, object_list, NULL, prototype, 
-					 FALSE));
+    return Py_BuildValue("i", count_obj_instances(prototype));
 
   // see what we're looking in
   if(PyUnicode_Check(in))
@@ -1282,6 +1273,26 @@ PyObject *PyObj_find_obj_key(PyObject *self, PyObject *args) {
   }
 }
 
+PyObject *PyObj_instances(PyObject *self, PyObject *args) {
+  char *proto = NULL;
+  if(!PyArg_ParseTuple(args, "s", &proto)) {
+    PyErr_Format(PyExc_TypeError, "instances needs an object prototype.");
+    return NULL;
+  }
+
+  PyObject        *list = PyList_New(0);
+  SET        *instances = 
+    obj_instances_of(get_fullkey_relative(proto, get_script_locale()));
+  if(instances != NULL) {
+    LOCAL_SET_ITERATOR(obj_i, instances);
+    OBJ_DATA *obj = NULL;
+    ITERATE_SET(obj, obj_i)
+      PyList_Append(list, objGetPyFormBorrowed(obj));
+    setIteratorFinish(obj_i);
+  }
+  return list;
+}
+
 PyObject *PyObj_all_objs(PyObject *self) {
   PyObject      *list = PyList_New(0);
   LIST_ITERATOR *obj_i = newListIterator(object_list);
@@ -1317,13 +1328,20 @@ PyMethodDef obj_module_methods[] = {
     "obj_list()\n"
     "\n"
     "Return a list containing every object in the game." },
-  { "load_obj", PyObj_load_obj, METH_VARARGS,
-    "load_obj(prototype, where=None, equip_to='')\n"
+  { "instances", PyObj_instances, METH_VARARGS,
+    "instances(proto)\n"
+    "\n"
+    "Return a list of every object in the game that is an instance of the\n"
+    "prototype, or of a prototype that inherits from it." },
+  { "load_obj", (PyCFunction)PyObj_load_obj, METH_VARARGS | METH_KEYWORDS,
+    "load_obj(prototype, where=None, equip_to='', count=0)\n"
     "\n"
     "Generate a new object from the specified prototype. Add it to where.\n"
     "Where can be a room, character, or container. If where is a character,\n"
     "add the object to the character's inventory unless a comma-separated\n"
-    "list of bodypart name of positions is specified. Return the created object." },
+    "list of bodypart name of positions is specified. Return the created object.\n"
+    "If a count is given, that many objects are generated at once, and a list\n"
+    "of them is returned instead." },
   { "count_objs", PyObj_count_objs, METH_VARARGS,
     "count_objs(keyword, loc = None)\n"
     "\n"
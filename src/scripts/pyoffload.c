@@ -0,0 +1,199 @@
+//*****************************************************************************
+//
+// pyoffload.c
+//
+// mudsys.submit, and the kernels that come with the mud. See pyoffload.h
+//
+//*****************************************************************************
+
+#include <Python.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../room.h"
+#include "../room_graph.h"
+#include "../offload.h"
+#include "scripts.h"
+#include "pyplugs.h"
+#include "pyroom.h"
+#include "pymudsys.h"
+#include "pyoffload.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+typedef struct {
+  OFFLOAD_PREPARE prepare;
+  OFFLOAD_RUN         run;
+  OFFLOAD_FINISH   finish;
+} OFFLOAD_KERNEL;
+
+// a piece of work a script submitted
+typedef struct {
+  OFFLOAD_KERNEL *kernel;
+  void             *data;
+  PyObject     *callback;
+} PY_OFFLOAD;
+
+// kernels, by name
+HASHTABLE *offload_kernels = NULL;
+
+// what the path kernel works on
+typedef struct {
+  ROOM_GRAPH *graph;
+  int          from;
+  int            to;
+  int     max_depth;
+  bool    stay_zone;
+  int         *path; // the uids of the rooms on the path, once we've run
+  int      path_len;
+} PATH_JOB;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// run the kernel off of the game thread
+void pyoffload_run(PY_OFFLOAD *job) {
+  job->kernel->run(job->data);
+}
+
+//
+// back on the game thread. Hand the result to whoever asked for it
+void pyoffload_done(PY_OFFLOAD *job) {
+  PyObject *result = job->kernel->finish(job->data);
+  PyObject    *ret = NULL;
+  if(result == NULL)
+    log_pyerr("Error finishing offloaded work:");
+  else if((ret = PyObject_CallFunctionObjArgs(job->callback, result, NULL))
+	  == NULL)
+    log_pyerr("Error in the callback of offloaded work:");
+  Py_XDECREF(ret);
+  Py_XDECREF(result);
+  Py_DECREF(job->callback);
+  free(job);
+}
+
+//
+// submit(kernel, args, callback)
+PyObject *mudsys_submit(PyObject *self, PyObject *args) {
+  char          *name = NULL;
+  PyObject    *kargs = NULL;
+  PyObject *callback = NULL;
+  if(!PyArg_ParseTuple(args, "sO!O", &name, &PyTuple_Type, &kargs,
+		       &callback)) {
+    PyErr_Format(PyExc_TypeError, "submit takes the name of a native kernel, "
+		 "a tuple of arguments, and a callback.");
+    return NULL;
+  }
+  if(!PyCallable_Check(callback)) {
+    PyErr_Format(PyExc_TypeError, "submit's callback must be callable.");
+    return NULL;
+  }
+
+  OFFLOAD_KERNEL *kernel = hashGet(offload_kernels, name);
+  if(kernel == NULL) {
+    PyErr_Format(PyExc_KeyError, "There is no native kernel named %s.", name);
+    return NULL;
+  }
+  void *data = kernel->prepare(kargs);
+  if(data == NULL)
+    return NULL;
+
+  PY_OFFLOAD *job = malloc(sizeof(PY_OFFLOAD));
+  job->kernel     = kernel;
+  job->data       = data;
+  job->callback   = callback;
+  Py_INCREF(callback);
+  offloadSubmit(pyoffload_run, pyoffload_done, job);
+  return Py_BuildValue("");
+}
+
+//
+// the path kernel: (from, to, stay_zone = True, max_depth = 0)
+void *path_prepare(PyObject *args) {
+  PyObject *from = NULL, *to = NULL;
+  int  stay_zone = 1, max_depth = 0;
+  if(!PyArg_ParseTuple(args, "OO|ii", &from, &to, &stay_zone, &max_depth) ||
+     !PyRoom_Check(from) || !PyRoom_Check(to)) {
+    PyErr_Clear();
+    PyErr_Format(PyExc_TypeError, "path takes two rooms, and optionally "
+		 "whether to stay in the first one's zone and how deep to go.");
+    return NULL;
+  }
+  if(PyRoom_AsRoom(from) == NULL || PyRoom_AsRoom(to) == NULL) {
+    PyErr_Format(PyExc_TypeError, "Tried to find a path with nonexistent "
+		 "rooms.");
+    return NULL;
+  }
+
+  PATH_JOB *job  = calloc(1, sizeof(PATH_JOB));
+  job->graph     = roomGraphGet();
+  job->from      = PyRoom_AsUid(from);
+  job->to        = PyRoom_AsUid(to);
+  job->stay_zone = stay_zone;
+  job->max_depth = max_depth;
+  return job;
+}
+
+void path_run(PATH_JOB *job) {
+  job->path_len = roomGraphPath(job->graph, job->from, job->to, job->max_depth,
+				job->stay_zone, &job->path);
+  roomGraphRelease(job->graph);
+}
+
+PyObject *path_finish(PATH_JOB *job) {
+  PyObject *list = (job->path_len > 0 ? PyList_New(job->path_len) : NULL);
+  int i;
+  // rooms can go away while we were working. If one did, so did the path
+  for(i = 0; list != NULL && i < job->path_len; i++) {
+    ROOM_DATA *room = propertyTableGet(room_table, job->path[i]);
+    if(room == NULL || roomIsExtracted(room)) {
+      Py_DECREF(list);
+      list = NULL;
+    }
+    else
+      PyList_SET_ITEM(list, i, roomGetPyForm(room));
+  }
+  if(job->path != NULL)
+    free(job->path);
+  free(job);
+  return (list != NULL ? list : Py_BuildValue(""));
+}
+
+
+
+//*****************************************************************************
+// implementation of pyoffload.h
+//*****************************************************************************
+void init_pyoffload(void) {
+  PyMudSys_addMethod("submit", mudsys_submit, METH_VARARGS,
+    "submit(kernel, args, callback)\n\n"
+    "Run the native kernel with the given name on a worker thread, with\n"
+    "the arguments in the args tuple. When it is done, callback is called\n"
+    "on the game thread with its result. Kernels that come with the mud:\n"
+    "  path (from, to, stay_zone = True, max_depth = 0)\n"
+    "    the shortest path between two rooms in memory, as a list of rooms\n"
+    "    with both ends included, or None. Doors do not stop the path.");
+  pyOffloadAddKernel("path", path_prepare, (OFFLOAD_RUN)path_run,
+		     (OFFLOAD_FINISH)path_finish);
+}
+
+void pyOffloadAddKernel(const char *name, OFFLOAD_PREPARE prepare,
+			OFFLOAD_RUN run, OFFLOAD_FINISH finish) {
+  if(offload_kernels == NULL)
+    offload_kernels = newHashtable();
+  OFFLOAD_KERNEL *kernel = hashGet(offload_kernels, name);
+  if(kernel == NULL) {
+    kernel = malloc(sizeof(OFFLOAD_KERNEL));
+    hashPut(offload_kernels, name, kernel);
+  }
+  kernel->prepare = prepare;
+  kernel->run     = run;
+  kernel->finish  = finish;
+}
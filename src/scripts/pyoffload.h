@@ -0,0 +1,37 @@
+#ifndef __PYOFFLOAD_H
+#define __PYOFFLOAD_H
+//*****************************************************************************
+//
+// pyoffload.h
+//
+// mudsys.submit(kernel, args, callback), for running heavy computations off
+// of the game thread (see offload.h). Python can't run on the workers, so
+// what runs there is a native kernel, registered by name. A kernel is three
+// functions: prepare turns the Python arguments into plain C data on the game
+// thread, run does the work on a worker without touching Python or the game,
+// and finish turns what run left in the data into a Python value back on the
+// game thread, and frees the data. callback is then called with that value.
+//
+// One kernel comes with the mud:
+//   path (from, to, stay_zone = True, max_depth = 0)
+//     the shortest path from one room to another over the rooms in memory,
+//     as a list of rooms with both ends included, or None. See room_graph.h
+//
+//*****************************************************************************
+
+//
+// prepare returns NULL, with a Python exception set, if args are no good
+typedef void    *(* OFFLOAD_PREPARE)(PyObject *args);
+typedef void     (* OFFLOAD_RUN)    (void *data);
+typedef PyObject *(* OFFLOAD_FINISH)(void *data);
+
+//
+// add submit to mudsys, and the kernels that come with the mud
+void init_pyoffload(void);
+
+//
+// register a native kernel scripts can submit work to by name
+void pyOffloadAddKernel(const char *name, OFFLOAD_PREPARE prepare,
+			OFFLOAD_RUN run, OFFLOAD_FINISH finish);
+
+#endif // __PYOFFLOAD_H
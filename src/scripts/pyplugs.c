@@ -19,7 +19,11 @@
 #include "../utils.h"
 #include "../character.h"
 #include "../strings.h"
+#include "../hooks.h"
+#include "../pulse.h"
+#include "scripts.h"
 #include "pyplugs.h"
+#include "code_cache.h"
 
 
 
@@ -35,6 +39,23 @@ char *get_pymod_lib(void) {
 }
 #define PYMOD_LIB get_pymod_lib()
 
+//
+// modules named in this file are not imported at boot. Each line names one
+// of the module's commands or hooks, and the module is imported the first
+// time any of them is used:
+//   <module> cmd  <command> <user group>
+//   <module> hook <hook type>
+#define DEFERRED_MANIFEST "deferred.manifest"
+
+typedef struct {
+  char  *name;
+  bool loaded;
+} DEFERRED_MOD;
+
+HASHTABLE  *deferred_mods = NULL; // module name -> DEFERRED_MOD
+HASHTABLE  *deferred_cmds = NULL; // command     -> DEFERRED_MOD
+HASHTABLE *deferred_hooks = NULL; // hook type   -> LIST of DEFERRED_MOD
+
 
 //
 // Similar to Py_CompileString (in the Python API), but a file is compiled
@@ -109,13 +130,14 @@ PyObject *Py_CompileFile(char *fname) {
     // Close the file now that we have read its content
     fclose(fl);
 
-    // Compile the file content string into a code object using Py_CompileString
-    PyObject *code_obj = Py_CompileString(source, fname, Py_file_input);
+    // Compile the file content string into a code object, or get it back out
+    // of the cache if we have compiled this source before
+    PyObject *code_obj = cachedCompileString(source, fname, Py_file_input);
     free(source); // Free the allocated memory for the file content
 
     if (code_obj == NULL) {
         // If compilation fails, handle the error and return NULL
-        // (compilation error will be set by Py_CompileString)
+        // (compilation error will be set by cachedCompileString)
         return NULL;
     }
 
@@ -164,6 +186,9 @@ bool PyModule_Reload(char *fname, char *mname) {
     else
       Py_DECREF(module);
     Py_DECREF(code);
+
+    // anything our scripts were handed from the old module is out of date
+    forget_script_dicts();
     return TRUE;
   }
 }
@@ -185,6 +210,159 @@ COMMAND(cmd_pyload) {
   }
 }
 
+
+//*****************************************************************************
+// deferred modules
+//*****************************************************************************
+
+//
+// import a module, and note how long it took, in usecs
+PyObject *import_py_module_timed(const char *mname, long long *usecs) {
+  long long start = pulse_clock();
+  PyObject   *mod = PyImport_ImportModule(mname);
+  *usecs = pulse_clock() - start;
+  return mod;
+}
+
+//
+// import a deferred module, if it hasn't been yet. why is what asked for it
+void load_deferred_mod(DEFERRED_MOD *mod, const char *why) {
+  if(mod->loaded)
+    return;
+  mod->loaded = TRUE;
+
+  long long usecs = 0;
+  PyObject  *pymod = import_py_module_timed(mod->name, &usecs);
+  if(pymod == NULL)
+    log_pyerr("Error loading deferred module, %s, for %s:", mod->name, why);
+  else {
+    log_string("Loaded deferred module: %s, for %s (%.1f ms)", mod->name, why,
+	       usecs / 1000.0);
+    Py_DECREF(pymod);
+  }
+}
+
+//
+// stands in for a deferred module's command. The module replaces us with the
+// real command when it is imported, and then the command is tried again
+COMMAND(cmd_deferred) {
+  DEFERRED_MOD *mod = hashGet(deferred_cmds, cmd);
+  if(mod == NULL || mod->loaded) {
+    log_string("ERROR: %s did not add the %s command deferred.manifest says "
+	       "it does", (mod ? mod->name : "a deferred module"), cmd);
+    send_to_char(ch, "That command is not available right now.\r\n");
+    return;
+  }
+
+  // our command is deleted once the module replaces it, which takes cmd
+  // along with it
+  char buf[MAX_BUFFER];
+  snprintf(buf, sizeof(buf), "%s%s%s", cmd, (*arg ? " " : ""), arg);
+  char why[SMALL_BUFFER];
+  snprintf(why, sizeof(why), "command %s", cmd);
+  load_deferred_mod(mod, why);
+  do_cmd(ch, buf, FALSE);
+}
+
+void load_deferred_for_hook(const char *type) {
+  LIST *mods = (deferred_hooks ? hashRemove(deferred_hooks, type) : NULL);
+  if(mods == NULL)
+    return;
+  char why[SMALL_BUFFER];
+  snprintf(why, sizeof(why), "hook %s", type);
+  DEFERRED_MOD *mod = NULL;
+  while((mod = listPop(mods)) != NULL) {
+    load_deferred_mod(mod, why);
+    hookUnwatch(type);
+  }
+  deleteList(mods);
+}
+
+//
+// is a module one that the mud won't run without?
+bool is_required_module(const char *mname, string *required, int count) {
+  bool is_required = FALSE;
+  string mname_str = str_new(mname);
+  for (int j = 0; j < count; j++) {
+    if (str_compare(mname_str, required[j]) == 0) {
+      is_required = TRUE;
+      break;
+    }
+  }
+  str_free(mname_str);
+  return is_required;
+}
+
+//
+// read in which modules are deferred, and put stand-ins for their commands
+// and hooks in place. Required modules are never deferred
+void read_deferred_manifest(string *required, int required_count) {
+  char fname[SMALL_BUFFER], line[SMALL_BUFFER];
+  char mname[SMALL_BUFFER], kind[SMALL_BUFFER];
+  char  name[SMALL_BUFFER], group[SMALL_BUFFER];
+  sprintf(fname, "%s/%s", PYMOD_LIB, DEFERRED_MANIFEST);
+  deferred_mods  = newHashtable();
+  deferred_cmds  = newHashtable();
+  deferred_hooks = newHashtable();
+
+  FILE *fl = fopen(fname, "r");
+  if(fl == NULL)
+    return;
+  while(fgets(line, sizeof(line), fl) != NULL) {
+    *group = '\0';
+    int num = sscanf(line, "%s %s %s %s", mname, kind, name, group);
+    if(num < 1 || *mname == '#')
+      continue;
+    if(num < 3 || (strcmp(kind, "cmd") && strcmp(kind, "hook"))) {
+      log_string("ERROR: bad line in %s: %s", DEFERRED_MANIFEST, line);
+      continue;
+    }
+    if(is_required_module(mname, required, required_count)) {
+      log_string("WARNING: required module %s cannot be deferred", mname);
+      continue;
+    }
+
+    DEFERRED_MOD *mod = hashGet(deferred_mods, mname);
+    if(mod == NULL) {
+      mod = calloc(1, sizeof(DEFERRED_MOD));
+      mod->name = strdup(mname);
+      hashPut(deferred_mods, mname, mod);
+    }
+
+    if(!strcmp(kind, "cmd")) {
+      hashPut(deferred_cmds, name, mod);
+      add_cmd(name, NULL, cmd_deferred, (*group ? group : "player"), FALSE);
+    }
+    else {
+      LIST *mods = hashGet(deferred_hooks, name);
+      if(mods == NULL) {
+	mods = newList();
+	hashPut(deferred_hooks, name, mods);
+      }
+      listQueue(mods, mod);
+      hookWatch(name);
+    }
+  }
+  fclose(fl);
+}
+
+//
+// deferred modules some other module imported at boot are already loaded;
+// there is nothing left to wait on for them
+void note_imported_deferred_mods(void) {
+  PyObject *sys_mods = PyImport_GetModuleDict();
+  LOCAL_HASH_ITERATOR(mod_i, deferred_mods);
+  const char   *name = NULL;
+  DEFERRED_MOD  *mod = NULL;
+  ITERATE_HASH(name, mod, mod_i) {
+    if(PyDict_GetItemString(sys_mods, name) != NULL) {
+      mod->loaded = TRUE;
+      log_string("Deferred module %s was imported by another module", name);
+    }
+  } hashIteratorFinish(mod_i);
+}
+
+
 //
 // NakedMud allows you to extend the codebase in Python. These extensions must
 // take the form of Python modules, and must be stored in the PYMOD_LIB
@@ -209,6 +387,11 @@ void init_py_modules() {
     required_tokens[i] = str_trim_chars(required_tokens[i], " \t\r\n");
   }
   
+  // modules that will be imported later, instead of now
+  read_deferred_manifest(required_tokens, required_count);
+  int   num_loaded = 0, num_deferred = 0;
+  long long total_usecs = 0;
+
   // add our PYMOD_LIB directory to the sys path, 
   // so the modules can access each other
   PyObject *sys  = PyImport_ImportModule("sys");
@@ -242,39 +425,28 @@ void init_py_modules() {
     else
       continue;
 
+    // modules that are deferred wait for something to ask for them
+    if(hashIn(deferred_mods, mname)) {
+      num_deferred++;
+      continue;
+    }
+
     // Load the module if it hasn't been loaded yet
-    PyObject *mod = PyImport_ImportModule(mname);
+    long long usecs = 0;
+    PyObject *mod = import_py_module_timed(mname, &usecs);
+    total_usecs += usecs;
+    bool is_required = is_required_module(mname, required_tokens,
+					  required_count);
     if(mod != NULL) {
-      // Check if this is a required module using exact string matching
-      bool is_required = FALSE;
-      string mname_str = str_new(mname);
-      for (int j = 0; j < required_count; j++) {
-        if (str_compare(mname_str, required_tokens[j]) == 0) {
-          is_required = TRUE;
-          break;
-        }
-      }
-      str_free(mname_str);
-      
-      log_string("Loaded %s module: %s", 
-                 is_required ? "required" : "optional", mname);
+      num_loaded++;
+      log_string("Loaded %s module: %s (%.1f ms)", 
+                 is_required ? "required" : "optional", mname, usecs / 1000.0);
       Py_DECREF(mod);
     }
     // oops... something went wrong. Let's get the traceback
     else {
       log_pyerr("Error loading module, %s:", mname);
       
-      // Check if this module is in the required list using exact matching
-      bool is_required = FALSE;
-      string mname_str = str_new(mname);
-      for (int j = 0; j < required_count; j++) {
-        if (str_compare(mname_str, required_tokens[j]) == 0) {
-          is_required = TRUE;
-          break;
-        }
-      }
-      str_free(mname_str);
-      
       if (is_required) {
         log_string("CRITICAL: Required module '%s' failed to load. MUD shutting down.", mname);
         // Cleanup before exit
@@ -289,6 +461,9 @@ void init_py_modules() {
       }
     }
   }
+  log_string("Loaded %d python modules in %.1f ms, %d deferred", num_loaded,
+	     total_usecs / 1000.0, num_deferred);
+  note_imported_deferred_mods();
   
   // Cleanup STRLib resources
   str_free_splitres(required_tokens, required_count);
@@ -429,10 +604,14 @@ char* getPythonTraceback(void) {
     return chrRetval;
 }
 
+// how many Python errors log_pyerr has logged
+long long pyerr_count = 0;
+
 void log_pyerr(const char *format, ...) {
   // get the traceback, and print our message
   char *tb = getPythonTraceback();
   if(tb != NULL) {
+    pyerr_count++;
     static char buf[MAX_BUFFER];
     va_list args;
     va_start(args, format);
@@ -444,6 +623,10 @@ void log_pyerr(const char *format, ...) {
   }
 }
 
+long long count_pyerrs(void) {
+  return pyerr_count;
+}
+
 
 PyGetSetDef *makePyGetSetters(LIST *getsetters) {
   PyGetSetDef *getsets = calloc(listSize(getsetters)+1,sizeof(PyGetSetDef));
@@ -469,6 +652,12 @@ PyMethodDef *makePyMethods(LIST *methods) {
   return meth;
 }
 
+PyObject *makePyString(const char *str) {
+  if(str == NULL)
+    return Py_NewRef(Py_None);
+  return PyUnicode_FromString(str);
+}
+
 void makePyType(PyTypeObject *type, LIST *getsetters, LIST *methods) {
   // build up the array of getsetters for this object
   if(getsetters != NULL)
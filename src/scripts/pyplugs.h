@@ -22,10 +22,20 @@ char *getPythonTraceback(void);
 void log_pyerr(const char *mssg, ...)
 __attribute__ ((format (printf, 1, 2)));
 
+//
+// how many Python errors have been logged with log_pyerr since boot
+long long count_pyerrs(void);
+
 //
 // initialize all of our plugs with python
 void init_pyplugs();
 
+//
+// import the modules deferred.manifest says are waiting on a type of hook to
+// be run. Python hooks are handed out after this, so whatever the modules
+// add for the hook hears the run that imported them
+void load_deferred_for_hook(const char *type);
+
 //
 // Takes in a PyType, and adds lists of get/setters and methods to it. The
 // lists can each be NULL if there are no getsetters or methods, respectively
@@ -39,4 +49,10 @@ PyGetSetDef *makePyGetSetters(LIST *getsetters);
 // makes an array of python methods
 PyMethodDef *makePyMethods(LIST *methods);
 
+//
+// makes a Python string from a C one, or None if str is NULL. The same as
+// Py_BuildValue("s", str), minus parsing a format string on every call, for
+// getters that are used often
+PyObject *makePyString(const char *str);
+
 #endif // PYPLUGS_H
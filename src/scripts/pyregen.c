@@ -0,0 +1,306 @@
+//*****************************************************************************
+//
+// pyregen.c
+//
+// regenerators for scripts. See pyregen.h. A Python regenerator owns the C
+// one it wraps, and deletes it when it goes away, which also takes it off of
+// the tick.
+//
+//*****************************************************************************
+
+#include <Python.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../character.h"
+#include "../regen.h"
+
+#include "scripts.h"
+#include "pyplugs.h"
+#include "pychar.h"
+#include "pymud.h"
+#include "pyregen.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+typedef struct {
+  PyObject_HEAD
+  REGEN_DATA *regen;
+} PyRegen;
+
+PyTypeObject PyRegen_Type;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// find the pool a script means, by name or number. Returns NULL, with an
+// exception set, if there isn't one
+REGEN_POOL *pyregen_get_pool(PyRegen *self, PyObject *pool) {
+  int i, num_pools = regenGetNumPools(self->regen);
+  if(PyLong_Check(pool)) {
+    i = (int)PyLong_AsLong(pool);
+    if(i >= 0 && i < num_pools)
+      return regenGetPool(self->regen, i);
+  }
+  else if(PyUnicode_Check(pool)) {
+    const char *name = PyUnicode_AsUTF8(pool);
+    for(i = 0; i < num_pools; i++)
+      if(!strcmp(name, regenGetPoolName(self->regen, i)))
+	return regenGetPool(self->regen, i);
+  }
+  PyErr_Format(PyExc_KeyError, "The regenerator has no pool %R.", pool);
+  return NULL;
+}
+
+//
+// the values one of a pool's getters or setters works on
+#define REGEN_CUR  0
+#define REGEN_MAX  1
+#define REGEN_RATE 2
+
+double *pyregen_field(REGEN_POOL *pool, int field) {
+  return (field == REGEN_CUR ? &pool->cur :
+	  field == REGEN_MAX ? &pool->max : &pool->rate);
+}
+
+PyObject *pyregen_get(PyRegen *self, PyObject *args, int field) {
+  PyObject *name = NULL;
+  if(!PyArg_ParseTuple(args, "O", &name))
+    return NULL;
+  REGEN_POOL *pool = pyregen_get_pool(self, name);
+  return (pool ? PyFloat_FromDouble(*pyregen_field(pool, field)) : NULL);
+}
+
+PyObject *pyregen_set(PyRegen *self, PyObject *args, int field) {
+  PyObject *name = NULL;
+  double    val  = 0;
+  if(!PyArg_ParseTuple(args, "Od", &name, &val))
+    return NULL;
+  REGEN_POOL *pool = pyregen_get_pool(self, name);
+  if(pool == NULL)
+    return NULL;
+  *pyregen_field(pool, field) = val;
+  regenChanged(self->regen);
+  Py_RETURN_NONE;
+}
+
+
+
+//*****************************************************************************
+// the regenerator type
+//*****************************************************************************
+void PyRegen_dealloc(PyRegen *self) {
+  if(self->regen != NULL)
+    deleteRegen(self->regen);
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+PyObject *PyRegen_repr(PyRegen *self) {
+  BUFFER *buf = newBuffer(SMALL_BUFFER);
+  int i;
+  bprintf(buf, "<Regenerator");
+  for(i = 0; i < regenGetNumPools(self->regen); i++) {
+    REGEN_POOL *pool = regenGetPool(self->regen, i);
+    bprintf(buf, " %s=%g/%g", regenGetPoolName(self->regen, i),
+	    pool->cur, pool->max);
+  }
+  bprintf(buf, ">");
+  PyObject *ret = PyUnicode_FromString(bufferString(buf));
+  deleteBuffer(buf);
+  return ret;
+}
+
+PyObject *PyRegen_get(PyRegen *self, PyObject *args) {
+  return pyregen_get(self, args, REGEN_CUR);
+}
+
+PyObject *PyRegen_get_max(PyRegen *self, PyObject *args) {
+  return pyregen_get(self, args, REGEN_MAX);
+}
+
+PyObject *PyRegen_get_rate(PyRegen *self, PyObject *args) {
+  return pyregen_get(self, args, REGEN_RATE);
+}
+
+PyObject *PyRegen_set(PyRegen *self, PyObject *args) {
+  return pyregen_set(self, args, REGEN_CUR);
+}
+
+PyObject *PyRegen_set_max(PyRegen *self, PyObject *args) {
+  return pyregen_set(self, args, REGEN_MAX);
+}
+
+PyObject *PyRegen_set_rate(PyRegen *self, PyObject *args) {
+  return pyregen_set(self, args, REGEN_RATE);
+}
+
+PyObject *PyRegen_getowner(PyRegen *self, void *closure) {
+  CHAR_DATA *ch = propertyTableGet(mob_table, regenGetOwner(self->regen));
+  if(ch == NULL)
+    Py_RETURN_NONE;
+  return newPyChar(ch);
+}
+
+int PyRegen_setowner(PyRegen *self, PyObject *value, void *closure) {
+  if(value == NULL || value == Py_None)
+    regenSetOwner(self->regen, NOBODY);
+  else if(PyChar_Check(value))
+    regenSetOwner(self->regen, PyChar_AsUid(value));
+  else {
+    PyErr_Format(PyExc_TypeError, "A regenerator's owner must be a char.");
+    return -1;
+  }
+  return 0;
+}
+
+PyObject *PyRegen_getpaused(PyRegen *self, void *closure) {
+  return PyBool_FromLong(regenIsPaused(self->regen));
+}
+
+int PyRegen_setpaused(PyRegen *self, PyObject *value, void *closure) {
+  if(value == NULL) {
+    PyErr_Format(PyExc_TypeError, "Cannot delete a regenerator's paused.");
+    return -1;
+  }
+  regenSetPaused(self->regen, PyObject_IsTrue(value));
+  return 0;
+}
+
+PyObject *PyRegen_getpools(PyRegen *self, void *closure) {
+  int i, num_pools = regenGetNumPools(self->regen);
+  PyObject *pools = PyTuple_New(num_pools);
+  for(i = 0; i < num_pools; i++)
+    PyTuple_SET_ITEM(pools, i,
+		     PyUnicode_FromString(regenGetPoolName(self->regen, i)));
+  return pools;
+}
+
+PyMethodDef PyRegen_methods[] = {
+  {"get", (PyCFunction)PyRegen_get, METH_VARARGS,
+   "get(pool)\n\nReturn a pool's current value."},
+  {"get_max", (PyCFunction)PyRegen_get_max, METH_VARARGS,
+   "get_max(pool)\n\nReturn a pool's max value."},
+  {"get_rate", (PyCFunction)PyRegen_get_rate, METH_VARARGS,
+   "get_rate(pool)\n\nReturn how much a pool gains a tick."},
+  {"set", (PyCFunction)PyRegen_set, METH_VARARGS,
+   "set(pool, val)\n\nSet a pool's current value."},
+  {"set_max", (PyCFunction)PyRegen_set_max, METH_VARARGS,
+   "set_max(pool, val)\n\nSet a pool's max value."},
+  {"set_rate", (PyCFunction)PyRegen_set_rate, METH_VARARGS,
+   "set_rate(pool, val)\n\nSet how much a pool gains a tick, before its\n"
+   "owner's position is taken into account."},
+  {NULL}  /* Sentinel */
+};
+
+PyGetSetDef PyRegen_getseters[] = {
+  {"owner", (getter)PyRegen_getowner, (setter)PyRegen_setowner,
+   "The char the regenerator belongs to, or None. It only ticks while its\n"
+   "owner is in the game.", NULL},
+  {"paused", (getter)PyRegen_getpaused, (setter)PyRegen_setpaused,
+   "Paused regenerators don't tick.", NULL},
+  {"pools", (getter)PyRegen_getpools, NULL,
+   "The names of the regenerator's pools. Immutable.", NULL},
+  {NULL}  /* Sentinel */
+};
+
+
+
+//*****************************************************************************
+// mud methods
+//*****************************************************************************
+
+//
+// regenerator(pools, package = None)
+PyObject *mud_regenerator(PyObject *self, PyObject *args) {
+  PyObject     *pools = NULL;
+  char       *package = NULL;
+  const char *names[REGEN_MAX_POOLS];
+  int i, num_pools;
+  if(!PyArg_ParseTuple(args, "O|z", &pools, &package) ||
+     !PySequence_Check(pools)) {
+    PyErr_Clear();
+    PyErr_Format(PyExc_TypeError, "regenerator takes a sequence of pool names, "
+		 "and optionally a GMCP package.");
+    return NULL;
+  }
+  if((num_pools = PySequence_Size(pools)) > REGEN_MAX_POOLS) {
+    PyErr_Format(PyExc_ValueError, "Regenerators have at most %d pools.",
+		 REGEN_MAX_POOLS);
+    return NULL;
+  }
+
+  PyObject *fast = PySequence_Fast(pools, "pools must be a sequence");
+  if(fast == NULL)
+    return NULL;
+  for(i = 0; i < num_pools; i++) {
+    PyObject *name = PySequence_Fast_GET_ITEM(fast, i);
+    if(!PyUnicode_Check(name)) {
+      Py_DECREF(fast);
+      PyErr_Format(PyExc_TypeError, "Pool names must be strings.");
+      return NULL;
+    }
+    names[i] = PyUnicode_AsUTF8(name);
+  }
+
+  PyRegen *regen = PyObject_New(PyRegen, &PyRegen_Type);
+  if(regen != NULL)
+    regen->regen = newRegen(num_pools, names, package);
+  Py_DECREF(fast);
+  return (PyObject *)regen;
+}
+
+//
+// regen_position_mod(pos, mod)
+PyObject *mud_regen_position_mod(PyObject *self, PyObject *args) {
+  char *pos = NULL;
+  double mod = 1.0;
+  if(!PyArg_ParseTuple(args, "sd", &pos, &mod)) {
+    PyErr_Format(PyExc_TypeError, "regen_position_mod takes a position and a "
+		 "multiplier.");
+    return NULL;
+  }
+  int num = posGetNum(pos);
+  if(num == POS_NONE) {
+    PyErr_Format(PyExc_ValueError, "There is no position %s.", pos);
+    return NULL;
+  }
+  regenSetPositionMod(num, mod);
+  Py_RETURN_NONE;
+}
+
+
+
+//*****************************************************************************
+// implementation of pyregen.h
+//*****************************************************************************
+void init_pyregen(void) {
+  PyRegen_Type = (PyTypeObject) { PyVarObject_HEAD_INIT(NULL, 0) };
+  PyRegen_Type.tp_name      = "mud.Regenerator";
+  PyRegen_Type.tp_basicsize = sizeof(PyRegen);
+  PyRegen_Type.tp_dealloc   = (destructor)PyRegen_dealloc;
+  PyRegen_Type.tp_repr      = (reprfunc)PyRegen_repr;
+  PyRegen_Type.tp_flags     = Py_TPFLAGS_DEFAULT;
+  PyRegen_Type.tp_doc       = "Pools that fill back up over time.";
+  PyRegen_Type.tp_methods   = PyRegen_methods;
+  PyRegen_Type.tp_getset    = PyRegen_getseters;
+  PyType_Ready(&PyRegen_Type);
+
+  PyMud_addMethod("regenerator", mud_regenerator, METH_VARARGS,
+    "regenerator(pools, package = None)\n\n"
+    "Make a regenerator with the named pools, each full at 100 and gaining\n"
+    "nothing. If package is given, the pools are sent to the owner's client\n"
+    "as fields of that GMCP package, as <pool> and max<pool>. The\n"
+    "regen_threshold hook is run, with the owner, the pool's name, and the\n"
+    "fraction, when a tick takes a pool up past a quarter of its way to max.");
+  PyMud_addMethod("regen_position_mod", mud_regen_position_mod, METH_VARARGS,
+    "regen_position_mod(pos, mod)\n\n"
+    "Set what regenerators' pools gain is multiplied by while their owners\n"
+    "are in a position.");
+}
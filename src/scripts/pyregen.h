@@ -0,0 +1,26 @@
+#ifndef __PYREGEN_H
+#define __PYREGEN_H
+//*****************************************************************************
+//
+// pyregen.h
+//
+// regenerators for scripts (see regen.h). mud.regenerator(pools, package =
+// None) makes one with the named pools, each full at 100. Their values live
+// in the regenerator itself, so scripts that keep one around (e.g. as part of
+// a character's auxiliary data) read and write them in place:
+//
+//   regen = mud.regenerator(("hp", "sp"), "Char.Vitals")
+//   regen.set("hp", 40)
+//   regen.set_rate("hp", 2.5)
+//   regen.owner = ch
+//
+// Pools are named or numbered. mud.regen_position_mod(pos, mod) sets what
+// pools gain is multiplied by while their owner is in a position.
+//
+//*****************************************************************************
+
+//
+// add regenerator and regen_position_mod to the mud module
+void init_pyregen(void);
+
+#endif // __PYREGEN_H
@@ -31,6 +31,7 @@
 #include "pyroom.h"
 #include "pymudsys.h"
 #include "pyauxiliary.h"
+#include "pylistview.h"
 
 
 
@@ -289,112 +290,84 @@ PyObject *PyRoom_is_abstract(PyObject *self, PyObject *args) {
 //*****************************************************************************
 // getters and setters for the Room class
 //*****************************************************************************
+
+//
+// find the room a getter is for. If it no longer exists, raise an
+// error instead of handing Python back a NULL with no error set
+#define PYROOM_GET_ROOM(self, room)                                    \
+  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)(self));                 \
+  if(room == NULL) {                                                   \
+    PyErr_Format(PyExc_TypeError,                                      \
+		 "Tried to read from nonexistent room, %d",            \
+		 PyRoom_AsUid((PyObject *)(self)));                    \
+    return NULL;                                                       \
+  }
+
 PyObject *PyRoom_getclass(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room != NULL) return Py_BuildValue("s", roomGetClass(room));
-  else             return NULL;
+  PYROOM_GET_ROOM(self, room);
+  return makePyString(roomGetClass(room));
 }
 
 PyObject *PyRoom_getlocale(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room != NULL) return Py_BuildValue("s",get_key_locale(roomGetClass(room)));
-  else             return NULL;
+  PYROOM_GET_ROOM(self, room);
+  return makePyString(get_key_locale(roomGetClass(room)));
 }
 
 PyObject *PyRoom_getprotoname(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room != NULL) return Py_BuildValue("s",get_key_name(roomGetClass(room)));
-  else             return NULL;
+  PYROOM_GET_ROOM(self, room);
+  return makePyString(get_key_name(roomGetClass(room)));
 }
 
 PyObject *PyRoom_getprotos(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room != NULL) return Py_BuildValue("s", roomGetPrototypes(room));
-  else             return NULL;
+  PYROOM_GET_ROOM(self, room);
+  return makePyString(roomGetPrototypes(room));
 }
 
 PyObject *PyRoom_getuid(PyRoom *self, void *closure) {
-  return Py_BuildValue("i", self->uid);
+  return PyLong_FromLong(self->uid);
 }
 
 PyObject *PyRoom_getname(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room != NULL)  return Py_BuildValue("s", roomGetName(room));
-  else              return NULL;
+  PYROOM_GET_ROOM(self, room);
+  return makePyString(roomGetName(room));
 }
 
 PyObject *PyRoom_getterrain(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room != NULL)  
-    return Py_BuildValue("s", terrainGetName(roomGetTerrain(room)));
-  else
-    return NULL;
+  PYROOM_GET_ROOM(self, room);
+  return makePyString(terrainGetName(roomGetTerrain(room)));
 }
 
 PyObject *PyRoom_getdesc(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room != NULL)  return Py_BuildValue("s", roomGetDesc(room));
-  else              return NULL;
+  PYROOM_GET_ROOM(self, room);
+  return makePyString(roomGetDesc(room));
 }
 
 PyObject *PyRoom_getexnames(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
+  PYROOM_GET_ROOM(self, room);
   if(room == NULL)  return NULL;
 
-  PyObject      *list = PyList_New(0);
-  LIST       *ex_list = roomGetExitNames(room);
-  LIST_ITERATOR *ex_i = newListIterator(ex_list);
-  char           *dir = NULL;
-  ITERATE_LIST(dir, ex_i) {
-    PyObject    *cont = Py_BuildValue("s", dir);
-    PyList_Append(list, cont);
-    Py_DECREF(cont);
-  } deleteListIterator(ex_i);
-  deleteListWith(ex_list, free);
+  PyObject *list = PyList_New(roomCountEdges(room));
+  int          i = 0;
+  for(i = 0; i < roomCountEdges(room); i++)
+    PyList_SET_ITEM(list, i, makePyString(roomGetEdgeDir(room, i)));
   return list;
 }
 
 PyObject *PyRoom_getchars(PyRoom *self, PyObject *args) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room == NULL)
-    return NULL;
-  else {
-    LIST_ITERATOR *char_i = newListIterator(roomGetCharacters(room));
-    PyObject *list = PyList_New(0);
-    CHAR_DATA *ch;
-
-    // for each char in the room list, add him to a Python list
-    ITERATE_LIST(ch, char_i)
-      PyList_Append(list, charGetPyFormBorrowed(ch));
-    deleteListIterator(char_i);
-    PyObject *retval = Py_BuildValue("O", list);
-    Py_DECREF(list);
-    return retval;
-  }
+  PYROOM_GET_ROOM(self, room);
+  return newPyListView(room_table, roomGetUID(room),
+		       (void *)roomGetCharacters, LISTVIEW_CHARS);
 }
 
 PyObject *PyRoom_getobjs(PyRoom *self, PyObject *args) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room == NULL)
-    return NULL;
-  else {
-    LIST_ITERATOR *obj_i = newListIterator(roomGetContents(room));
-    PyObject *list = PyList_New(0);
-    OBJ_DATA *obj;
-
-    // for each obj in the room list, add him to a Python list
-    ITERATE_LIST(obj, obj_i)
-      PyList_Append(list, objGetPyFormBorrowed(obj));
-    deleteListIterator(obj_i);
-    PyObject *retval = Py_BuildValue("O", list);
-    Py_DECREF(list);
-    return retval;
-  }
+  PYROOM_GET_ROOM(self, room);
+  return newPyListView(room_table, roomGetUID(room),
+		       (void *)roomGetContents, LISTVIEW_OBJS);
 }
 
 PyObject *PyRoom_getbits(PyRoom *self, void *closure) {
-  ROOM_DATA *room = PyRoom_AsRoom((PyObject *)self);
-  if(room!=NULL) return Py_BuildValue("s", bitvectorGetBits(roomGetBits(room)));
+  PYROOM_GET_ROOM(self, room);
+  if(room!=NULL) return makePyString(bitvectorGetBits(roomGetBits(room)));
   else           return NULL;
 }
 
@@ -601,6 +574,138 @@ PyObject *PyRoom_get_exit(PyRoom *self, PyObject *value) {
     return Py_BuildValue("O", Py_None);
 }
 
+//
+// turn a list of rooms into a Python list of them
+PyObject *room_list_to_py(LIST *rooms) {
+  PyObject     *list = PyList_New(0);
+  LIST_ITERATOR *rm_i = newListIterator(rooms);
+  ROOM_DATA    *room = NULL;
+  ITERATE_LIST(room, rm_i) {
+    PyList_Append(list, roomGetPyFormBorrowed(room));
+  } deleteListIterator(rm_i);
+  return list;
+}
+
+PyObject *PyRoom_within(PyRoom *self, PyObject *args, PyObject *kwds) {
+  char *kwlist[] = { "depth", "ignore_doors", "stay_zone", "loaded_only",
+		     NULL };
+  int          depth = 0;
+  int   ignore_doors = 1, stay_zone = 0, loaded_only = 0;
+  ROOM_DATA    *room = NULL;
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "i|iii", kwlist, &depth,
+				  &ignore_doors, &stay_zone, &loaded_only)) {
+    PyErr_Format(PyExc_TypeError, "within takes a depth, in steps.");
+    return NULL;
+  }
+  if((room = PyRoom_AsRoom((PyObject *)self)) == NULL) {
+    PyErr_Format(PyExc_TypeError, "Tried to walk from nonexistent room, %d.",
+		 self->uid);
+    return NULL;
+  }
+
+  LIST    *rooms = rooms_within(room, depth,
+				(ignore_doors ? 0 : WALK_NO_DOORS) |
+				(stay_zone    ? WALK_STAY_ZONE   : 0) |
+				(loaded_only  ? WALK_LOADED_ONLY : 0));
+  PyObject *list = room_list_to_py(rooms);
+  deleteList(rooms);
+  return list;
+}
+
+//
+// turn a path of rooms into the directions taken to walk it
+PyObject *room_path_to_dirs(LIST *path) {
+  PyObject      *list = PyList_New(0);
+  LIST_ITERATOR *rm_i = newListIterator(path);
+  ROOM_DATA     *room = NULL, *prev = NULL;
+  ITERATE_LIST(room, rm_i) {
+    const char *dir = (prev ? room_dir_to(prev, room) : NULL);
+    if(dir != NULL) {
+      PyObject *pydir = PyUnicode_FromString(dir);
+      PyList_Append(list, pydir);
+      Py_DECREF(pydir);
+    }
+    prev = room;
+  } deleteListIterator(rm_i);
+  return list;
+}
+
+PyObject *PyRoom_path_to(PyRoom *self, PyObject *args, PyObject *kwds) {
+  char *kwlist[] = { "dest", "ignore_doors", "stay_zone", "max_depth",
+		     "ignore", "dirs", NULL };
+  PyObject     *pydest = NULL;
+  PyObject   *pyignore = NULL;
+  int     ignore_doors = 1, stay_zone = 1, max_depth = 0, dirs = 0;
+  ROOM_DATA      *room = NULL;
+  ROOM_DATA      *dest = NULL;
+  LIST           *path = NULL;
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiiOp", kwlist, &pydest,
+				  &ignore_doors, &stay_zone, &max_depth,
+				  &pyignore, &dirs) ||
+     !PyRoom_Check(pydest)) {
+    PyErr_Format(PyExc_TypeError, "path_to takes a destination room.");
+    return NULL;
+  }
+  if((room = PyRoom_AsRoom((PyObject *)self)) == NULL ||
+     (dest = PyRoom_AsRoom(pydest)) == NULL) {
+    PyErr_Format(PyExc_TypeError, "Tried to find a path with nonexistent "
+		 "rooms.");
+    return NULL;
+  }
+
+  int flags = ((ignore_doors ? 0 : WALK_NO_DOORS) |
+	       (stay_zone    ? WALK_STAY_ZONE : 0));
+  if(pyignore == NULL || pyignore == Py_None)
+    path = room_path(room, dest, max_depth, flags);
+  else {
+    PyObject *iter = PyObject_GetIter(pyignore);
+    PyObject *item = NULL;
+    SET     *avoid = newSet();
+    if(iter == NULL) {
+      deleteSet(avoid);
+      return NULL;
+    }
+    while((item = PyIter_Next(iter)) != NULL) {
+      ROOM_DATA *rm = (PyRoom_Check(item) ? PyRoom_AsRoom(item) : NULL);
+      if(rm != NULL && rm != room)
+	setPut(avoid, rm);
+      Py_DECREF(item);
+    }
+    Py_DECREF(iter);
+    if(PyErr_Occurred()) {
+      deleteSet(avoid);
+      return NULL;
+    }
+    path = room_path_avoiding(room, dest, max_depth, flags, avoid);
+    deleteSet(avoid);
+  }
+
+  if(path == NULL)
+    return Py_BuildValue("O", Py_None);
+  PyObject *list = (dirs ? room_path_to_dirs(path) : room_list_to_py(path));
+  deleteList(path);
+  return list;
+}
+
+PyObject *PyRoom_dir_to(PyRoom *self, PyObject *args) {
+  PyObject *pydest = NULL;
+  ROOM_DATA  *room = NULL;
+  ROOM_DATA  *dest = NULL;
+  if(!PyArg_ParseTuple(args, "O", &pydest) || !PyRoom_Check(pydest)) {
+    PyErr_Format(PyExc_TypeError, "dir_to takes a room.");
+    return NULL;
+  }
+  if((room = PyRoom_AsRoom((PyObject *)self)) == NULL) {
+    PyErr_Format(PyExc_TypeError, "Tried to get exit dir of nonexistent room"
+		 ", %d.", PyRoom_AsUid((PyObject *)self));
+    return NULL;
+  }
+  dest = PyRoom_AsRoom(pydest);
+  return Py_BuildValue("z", (dest ? room_dir_to(room, dest) : NULL));
+}
+
 
 //
 // Returns the direction of the exit
@@ -1061,7 +1166,7 @@ PyObject *PyRoom_reset(PyRoom *self, void *closure) {
 		 self->uid);
     return NULL;
   }
-  hookRun("reset_room", hookBuildInfo("rm", room));
+  hookRunArgs("reset_room", "rm", room);
   return Py_BuildValue("");
 }
 
@@ -1267,6 +1372,29 @@ PyInit_PyRoom(void) {
       "exit(dir)\n"
       "\n"
       "Returns an exit for the specified direction, or None.");
+    PyRoom_addMethod("within", PyRoom_within, METH_VARARGS | METH_KEYWORDS,
+      "within(depth, ignore_doors=True, stay_zone=False, loaded_only=False)\n"
+      "\n"
+      "Return a list of every room no more than depth steps away from this\n"
+      "one, nearest first, starting with this room. If ignore_doors is\n"
+      "False, closed exits are not passed through. If stay_zone is True,\n"
+      "the walk never leaves this room's zone. If loaded_only is True, rooms\n"
+      "that are not in memory are not loaded to walk through them.");
+    PyRoom_addMethod("path_to", PyRoom_path_to, METH_VARARGS | METH_KEYWORDS,
+      "path_to(dest, ignore_doors=True, stay_zone=True, max_depth=0,\n"
+      "        ignore=None, dirs=False)\n"
+      "\n"
+      "Return the list of rooms on the shortest path from this room to dest,\n"
+      "both included, or None if there is no path. A max_depth above 0 gives\n"
+      "up on paths longer than that many steps. Paths never go through the\n"
+      "rooms in ignore. If dirs is True, the directions to walk the path are\n"
+      "returned instead of its rooms. See within for the rest. Paths are\n"
+      "remembered until the rooms or exits they go through change.");
+    PyRoom_addMethod("dir_to", PyRoom_dir_to, METH_VARARGS,
+      "dir_to(room)\n"
+      "\n"
+      "Returns the direction of the exit that leads straight to room, or\n"
+      "None if none does.");
     PyRoom_addMethod("exdir", PyRoom_get_exit_dir, METH_VARARGS,
       "exdir(exit)\n"
       "\n"
@@ -0,0 +1,224 @@
+//*****************************************************************************
+//
+// pyroutine.c
+//
+// routines for scripts. See pyroutine.h. Steps that are Python functions,
+// and the checks routines are given, hold a reference to what they call, and
+// let it go when the routine is done with them.
+//
+//*****************************************************************************
+
+#include <Python.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../character.h"
+#include "../routine.h"
+
+#include "scripts.h"
+#include "pyplugs.h"
+#include "pychar.h"
+#include "pymud.h"
+#include "pyroutine.h"
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// what the routine a script hands us waits between steps if it doesn't say
+#define PYROUTINE_DFLT_DELAY    10
+
+void pyroutine_decref(void *data) {
+  Py_XDECREF((PyObject *)data);
+}
+
+//
+// call a function with a character. Takes a reference for the call, since
+// the function could end the routine that holds it
+PyObject *pyroutine_call(PyObject *func, CHAR_DATA *ch) {
+  Py_INCREF(func);
+  PyObject *ret = PyObject_CallFunctionObjArgs(func, charGetPyFormBorrowed(ch),
+					       NULL);
+  if(ret == NULL)
+    log_pyerr("Error running a routine for %s", charGetName(ch));
+  Py_DECREF(func);
+  return ret;
+}
+
+void pyroutine_step(CHAR_DATA *ch, void *data) {
+  PyObject *ret = pyroutine_call(data, ch);
+  Py_XDECREF(ret);
+}
+
+//
+// a check is held back if it returns True
+bool pyroutine_check_one(CHAR_DATA *ch, PyObject *check) {
+  PyObject *ret = pyroutine_call(check, ch);
+  bool     held = (ret != NULL && PyObject_IsTrue(ret) == 1);
+  Py_XDECREF(ret);
+  return held;
+}
+
+bool pyroutine_check(CHAR_DATA *ch, void *data) {
+  return pyroutine_check_one(ch, data);
+}
+
+//
+// the checks a routine is given are kept as a tuple
+bool pyroutine_checks(CHAR_DATA *ch, void *data) {
+  PyObject *checks = data;
+  Py_ssize_t i;
+  bool    held = FALSE;
+  Py_INCREF(checks);
+  for(i = 0; i < PyTuple_Size(checks) && !held; i++)
+    held = pyroutine_check_one(ch, PyTuple_GetItem(checks, i));
+  Py_DECREF(checks);
+  return held;
+}
+
+//
+// fill in a step from what a script gave us. Returns FALSE, with an
+// exception set, if it isn't one
+bool pyroutine_read_step(PyObject *item, ROUTINE_STEP *step) {
+  double delay = PYROUTINE_DFLT_DELAY;
+  if(PyTuple_Check(item)) {
+    if(PyTuple_Size(item) != 2 || !PyNumber_Check(PyTuple_GetItem(item, 0))){
+      PyErr_Format(PyExc_TypeError, "Routine steps given as tuples must be "
+		   "(delay, step).");
+      return FALSE;
+    }
+    delay = PyFloat_AsDouble(PyTuple_GetItem(item, 0));
+    item  = PyTuple_GetItem(item, 1);
+  }
+
+  step->delay = MAX(1, (int)(delay SECONDS));
+  if(PyUnicode_Check(item))
+    step->cmd  = (char *)PyUnicode_AsUTF8(item);
+  else if(PyCallable_Check(item)) {
+    Py_INCREF(item);
+    step->func = pyroutine_step;
+    step->data = item;
+  }
+  else {
+    PyErr_Format(PyExc_TypeError, "Routine steps must be commands or "
+		 "functions.");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+
+//*****************************************************************************
+// mud methods
+//*****************************************************************************
+
+//
+// set_routine(ch, routine, repeat = False, checks = None)
+PyObject *mud_set_routine(PyObject *self, PyObject *args, PyObject *kwds) {
+  static char *kwlist[ ] = { "ch", "routine", "repeat", "checks", NULL };
+  PyObject     *pych = NULL;
+  PyObject  *routine = NULL;
+  PyObject   *checks = NULL;
+  int         repeat = FALSE;
+  CHAR_DATA      *ch = NULL;
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|pO", kwlist, &pych,
+				  &routine, &repeat, &checks))
+    return NULL;
+  if(!PyChar_Check(pych) || (ch = PyChar_AsChar(pych)) == NULL) {
+    PyErr_Format(PyExc_TypeError, "set_routine must be given an existent "
+		 "character.");
+    return NULL;
+  }
+
+  // no routine stops the one they have
+  if(routine == Py_None) {
+    charClearRoutine(ch);
+    Py_RETURN_NONE;
+  }
+
+  PyObject *fast = PySequence_Fast(routine, "A routine must be a sequence.");
+  if(fast == NULL)
+    return NULL;
+  PyObject *check_tuple = NULL;
+  if(checks != NULL && checks != Py_None &&
+     (check_tuple = PySequence_Tuple(checks)) == NULL) {
+    Py_DECREF(fast);
+    return NULL;
+  }
+
+  int i, num_steps = PySequence_Fast_GET_SIZE(fast);
+  ROUTINE_STEP *steps = calloc(MAX(1, num_steps), sizeof(ROUTINE_STEP));
+  bool ok = TRUE;
+  for(i = 0; i < num_steps && ok; i++)
+    ok = pyroutine_read_step(PySequence_Fast_GET_ITEM(fast, i), &steps[i]);
+
+  if(ok)
+    charSetRoutine(ch, steps, num_steps, repeat,
+		   (check_tuple ? pyroutine_checks : NULL), check_tuple,
+		   pyroutine_decref);
+  else {
+    for(i = 0; i < num_steps; i++)
+      Py_XDECREF((PyObject *)steps[i].data);
+    Py_XDECREF(check_tuple);
+  }
+  free(steps);
+  Py_DECREF(fast);
+  if(!ok)
+    return NULL;
+  Py_RETURN_NONE;
+}
+
+PyObject *mud_routine_step(PyObject *self, PyObject *args) {
+  PyObject *pych = NULL;
+  CHAR_DATA  *ch = NULL;
+  if(!PyArg_ParseTuple(args, "O", &pych) || !PyChar_Check(pych) ||
+     (ch = PyChar_AsChar(pych)) == NULL) {
+    PyErr_Format(PyExc_TypeError, "routine_step must be given an existent "
+		 "character.");
+    return NULL;
+  }
+  int step = charGetRoutineStep(ch);
+  if(step < 0)
+    Py_RETURN_NONE;
+  return PyLong_FromLong(step);
+}
+
+PyObject *mud_add_routine_check(PyObject *self, PyObject *args) {
+  PyObject *check = NULL;
+  if(!PyArg_ParseTuple(args, "O", &check) || !PyCallable_Check(check)) {
+    PyErr_Format(PyExc_TypeError, "add_routine_check must be given a "
+		 "function.");
+    return NULL;
+  }
+  Py_INCREF(check);
+  routineAddCheck(pyroutine_check, check);
+  Py_RETURN_NONE;
+}
+
+
+
+//*****************************************************************************
+// implementation of pyroutine.h
+//*****************************************************************************
+void init_pyroutine(void) {
+  PyMud_addMethod("set_routine", mud_set_routine, METH_VARARGS | METH_KEYWORDS,
+    "set_routine(ch, routine, repeat = False, checks = None)\n\n"
+    "Give a character a routine, replacing any they had. Steps are commands,\n"
+    "functions taking the character, or (delay, step) tuples; the delay is in\n"
+    "seconds, and is 10 if not given. checks are functions taking the\n"
+    "character that return True if the next step should wait. A routine of\n"
+    "None stops the character's routine.");
+  PyMud_addMethod("routine_step", mud_routine_step, METH_VARARGS,
+    "routine_step(ch)\n\n"
+    "Return the step a character's routine does next, or None if they have\n"
+    "no routine.");
+  PyMud_addMethod("add_routine_check", mud_add_routine_check, METH_VARARGS,
+    "add_routine_check(check)\n\n"
+    "Add a function, taking a character, that is asked before anyone's\n"
+    "routine does a step. It returns True if the step should wait. Nobody\n"
+    "does a step while they are acting, whatever the checks say.");
+}
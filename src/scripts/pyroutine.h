@@ -0,0 +1,25 @@
+#ifndef __PYROUTINE_H
+#define __PYROUTINE_H
+//*****************************************************************************
+//
+// pyroutine.h
+//
+// routines for scripts (see routine.h). mud.set_routine(ch, routine,
+// repeat = False, checks = None) gives a character a routine. Each step is a
+// command (a string), a function that takes the character, or a tuple of
+// (delay in seconds, command or function). Commands are done straight from
+// C; only steps that are functions call back into Python:
+//
+//   mud.set_routine(ch, ["say hi", (3, "say I am a little teapot")], True)
+//
+// mud.add_routine_check(check) adds a function that is asked, with the
+// character, before anyone's routine does a step. Like the checks a routine
+// is given, it returns True if the step should wait.
+//
+//*****************************************************************************
+
+//
+// add set_routine, routine_step, and add_routine_check to the mud module
+void init_pyroutine(void);
+
+#endif // __PYROUTINE_H
@@ -9,9 +9,12 @@
 #include "../mud.h"
 #include "../utils.h"
 #include "../object.h"
+#include "../character.h"
+#include "../body.h"
 
 #include "scripts.h"
 #include "pyobj.h"
+#include "pychar.h"
 #include "pyskills_verbs.h"
 
 // Forward declarations
@@ -46,7 +49,7 @@ PyObject *PyObj_assign_skill(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux == NULL) {
     PyErr_Format(PyExc_Exception, 
       "Object does not have skills_verbs auxiliary data. Make sure skills_verbs_aux_init() was called at startup.");
@@ -75,7 +78,7 @@ PyObject *PyObj_get_skill(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux == NULL) {
     PyErr_Format(PyExc_Exception, 
       "Object does not have skills_verbs auxiliary data");
@@ -115,7 +118,7 @@ PyObject *PyObj_get_active_skill_slot(PyObject *self) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux == NULL) {
     PyErr_Format(PyExc_Exception, "Object does not have skills_verbs auxiliary data");
     return NULL;
@@ -148,7 +151,7 @@ PyObject *PyObj_set_active_skill_slot(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux == NULL) {
     PyErr_Format(PyExc_Exception, "Object does not have skills_verbs auxiliary data");
     return NULL;
@@ -169,7 +172,7 @@ PyObject *PyObj_get_all_skills(PyObject *self) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux == NULL) {
     PyErr_Format(PyExc_Exception, "Object does not have skills_verbs auxiliary data");
     return NULL;
@@ -212,7 +215,7 @@ PyObject *PyObj_clear_skill(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux == NULL) {
     PyErr_Format(PyExc_Exception, "Object does not have skills_verbs auxiliary data");
     return NULL;
@@ -251,7 +254,7 @@ PyObject *PyObj_add_verb(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux == NULL) {
     PyErr_Format(PyExc_Exception, 
       "Object does not have skills_verbs auxiliary data. Make sure skills_verbs_aux_init() was called at startup.");
@@ -280,7 +283,7 @@ PyObject *PyObj_remove_verb(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux != NULL) {
     svaux_remove_verb(aux, verb);
     Py_RETURN_TRUE;
@@ -307,7 +310,7 @@ PyObject *PyObj_get_verb_script(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux != NULL) {
     const char *script = svaux_get_verb_script(aux, verb);
     if (script && *script)
@@ -335,7 +338,7 @@ PyObject *PyObj_get_verb_charges(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux != NULL) {
     int charges = svaux_get_verb_charges(aux, verb);
     return Py_BuildValue("i", charges);
@@ -362,7 +365,7 @@ PyObject *PyObj_get_verb_cooldown(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux != NULL) {
     int cooldown = svaux_get_verb_cooldown(aux, verb);
     return Py_BuildValue("i", cooldown);
@@ -384,7 +387,7 @@ PyObject *PyObj_get_verbs(PyObject *self) {
   
   PyObject *list = PyList_New(0);
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux != NULL) {
     LIST *verbs = svaux_get_verb_list(aux);
     LIST_ITERATOR *iter = newListIterator(verbs);
@@ -420,7 +423,7 @@ PyObject *PyObj_verb_on_cooldown(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux != NULL) {
     if (svaux_verb_on_cooldown(aux, verb, current_time)) {
       Py_RETURN_TRUE;
@@ -449,7 +452,7 @@ PyObject *PyObj_use_verb(PyObject *self, PyObject *args) {
     return NULL;
   }
   
-  SKILLS_VERBS_AUX *aux = objGetAuxiliaryData(obj, "skills_verbs");
+  SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
   if (aux != NULL) {
     if (svaux_use_verb(aux, verb, current_time)) {
       Py_RETURN_TRUE;
@@ -460,6 +463,40 @@ PyObject *PyObj_use_verb(PyObject *self, PyObject *args) {
 }
 
 
+/**
+ * ch.get_ready_verbs()
+ * List every verb on the character's equipment that can be used right now
+ */
+PyObject *PyChar_get_ready_verbs(PyObject *self) {
+  CHAR_DATA *ch = PyChar_AsChar(self);
+  if (ch == NULL) {
+    PyErr_Format(PyExc_Exception, "Tried to get ready verbs for nonexistent character");
+    return NULL;
+  }
+  
+  PyObject *list = PyList_New(0);
+  LIST_ITERATOR *eq_i = newListIterator(bodyGetEqList(charGetBody(ch)));
+  OBJ_DATA *obj = NULL;
+  
+  ITERATE_LIST(obj, eq_i) {
+    SKILLS_VERBS_AUX *aux = svaux_obj_aux(obj);
+    if (aux == NULL)
+      continue;
+    LIST_ITERATOR *verb_i = newListIterator(svaux_get_ready_verbs(aux, current_time));
+    SVAUX_VERB *rec = NULL;
+    ITERATE_LIST(rec, verb_i) {
+      PyObject *pair = Py_BuildValue("Os", objGetPyFormBorrowed(obj), rec->verb);
+      PyList_Append(list, pair);
+      Py_DECREF(pair);
+    }
+    deleteListIterator(verb_i);
+  }
+  deleteListIterator(eq_i);
+  
+  return list;
+}
+
+
 //*****************************************************************************
 // Registration function
 //*****************************************************************************
@@ -545,4 +582,15 @@ void PySkillsVerbs_registerMethods(void) {
     "use_verb(verb)\n\n"
     "Attempt to use a verb. Returns True if successful (verb executed),\n"
     "False if on cooldown or out of charges.");
+}
+
+/**
+ * Register the skills/verbs methods with PyChar
+ * Call this from PyInit_PyChar, before its type is made
+ */
+void PySkillsVerbs_registerCharMethods(void) {
+  PyChar_addMethod("get_ready_verbs", (PyCFunction)PyChar_get_ready_verbs, METH_NOARGS,
+    "get_ready_verbs()\n\n"
+    "Get a list of (obj, verb) pairs for every verb on this character's\n"
+    "equipment that is not cooling down and has charges left.");
 }
\ No newline at end of file
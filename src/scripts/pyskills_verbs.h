@@ -15,4 +15,9 @@
 // Call this during PyObj initialization (from PyInit_PyObj or similar).
 void PySkillsVerbs_registerMethods(void);
 
+//
+// Register the skills/verbs methods with the PyChar class. Call this during
+// PyChar initialization, before its type is made.
+void PySkillsVerbs_registerCharMethods(void);
+
 #endif // __PYSKILLS_VERBS_H
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include "../auxiliary.h"
 #include "../account.h"
 #include "../character.h"
+#include "../colour.h"
 
 #include "scripts.h"
 #include "pystorage.h"
@@ -264,6 +265,30 @@ PyObject *PySocket_getidletime(PySocket *self, void *closure) {
     return Py_BuildValue("f", socketGetIdleTime(sock));
 }
 
+PyObject *PySocket_getafk(PySocket *self, void *closure) {
+  SOCKET_DATA *sock = PySocket_AsSocket((PyObject *)self);
+  if(sock == NULL)
+    return NULL;
+  else
+    return PyBool_FromLong(socketIsAfk(sock));
+}
+
+PyObject *PySocket_gettls(PySocket *self, void *closure) {
+  SOCKET_DATA *sock = PySocket_AsSocket((PyObject *)self);
+  if(sock == NULL)
+    return NULL;
+  else
+    return PyBool_FromLong(socketIsTls(sock));
+}
+
+PyObject *PySocket_getwebsocket(PySocket *self, void *closure) {
+  SOCKET_DATA *sock = PySocket_AsSocket((PyObject *)self);
+  if(sock == NULL)
+    return NULL;
+  else
+    return PyBool_FromLong(socketIsWebSocket(sock));
+}
+
 PyObject *PySocket_gethostname(PySocket *self, void *closure) {
   SOCKET_DATA *sock = PySocket_AsSocket((PyObject *)self);
   if(sock == NULL)
@@ -274,6 +299,31 @@ PyObject *PySocket_gethostname(PySocket *self, void *closure) {
     return Py_BuildValue("s", "unresolved");
 }
 
+PyObject *PySocket_get_colour_mode(PySocket *self, void *closure) {
+  SOCKET_DATA *sock = PySocket_AsSocket((PyObject *)self);
+  if(sock == NULL)
+    return NULL;
+  return Py_BuildValue("s", colourModeName(socketGetColourMode(sock)));
+}
+
+int PySocket_set_colour_mode(PySocket *self, PyObject *value, void *closure) {
+  if(!PyUnicode_Check(value)) {
+    PyErr_Format(PyExc_TypeError, "Colour modes must be strings.");
+    return -1;
+  }
+  int mode = colourModeFromName(PyUnicode_AsUTF8(value));
+  if(mode == -1) {
+    PyErr_Format(PyExc_ValueError, "Colour modes are none, ansi, or 256.");
+    return -1;
+  }
+
+  SOCKET_DATA *sock = PySocket_AsSocket((PyObject *)self);
+  if(sock == NULL)
+    return -1;
+  socketSetColourMode(sock, mode);
+  return 0;
+}
+
 PyObject *PySocket_bust_prompt(PySocket *self, PyObject *closure) {
   SOCKET_DATA *sock = PySocket_AsSocket((PyObject *)self);
   if(sock == NULL) {
@@ -657,6 +707,11 @@ PyInit_PySocket(void) {
     PySocket_addGetSetter("outbound_text",
        PySocket_get_outbound_text, PySocket_set_outbound_text,
        "The socket's outbound text.");
+    PySocket_addGetSetter("colour_mode",
+       PySocket_get_colour_mode, PySocket_set_colour_mode,
+       "What the socket's colour codes are turned into: 'ansi', '256' for\n"
+       "terminals that understand 256 colours, 'html' for web clients, or\n"
+       "'none' to strip them.");
     PySocket_addGetSetter("can_use", PySocket_get_can_use, NULL,
       "True or False if the socket is ready for use. Socket becomes available\n"
       "after its dns addresss resolves. Immutable.");
@@ -665,6 +720,15 @@ PyInit_PySocket(void) {
       "mudsock.Mudsock.push_ih");
     PySocket_addGetSetter("idle_time", PySocket_getidletime, NULL,
       "How long (in seconds) the socket's input handler has been idle for. Immutable.");
+    PySocket_addGetSetter("afk", PySocket_getafk, NULL,
+      "True if the socket has been idle for afk_seconds, and hasn't sent a\n"
+      "command since. Immutable.");
+    PySocket_addGetSetter("tls", PySocket_gettls, NULL,
+      "True if the socket connected to one of our tls_ports, and its\n"
+      "connection is encrypted. Immutable.");
+    PySocket_addGetSetter("websocket", PySocket_getwebsocket, NULL,
+      "True if the socket connected to one of our ws_ports or wss_ports.\n"
+      "Immutable.");
     PySocket_addGetSetter("hostname", PySocket_gethostname, NULL,
       "The dns address that the socket is connected from. Immutable.");
 
@@ -0,0 +1,262 @@
+//*****************************************************************************
+//
+// pystats.c
+//
+// character stat blocks for scripts. See pystats.h. Stats and derived values
+// can be named or numbered; numbers skip looking the name up.
+//
+//*****************************************************************************
+
+#include <Python.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../character.h"
+#include "../stats.h"
+
+#include "scripts.h"
+#include "pyplugs.h"
+#include "pychar.h"
+#include "pymud.h"
+#include "pystats.h"
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// find the stat or derived value a script means, by name or number. Returns
+// STAT_NONE, with an exception set, if there isn't one
+int pystats_get_num(PyObject *which, int count, int (* get_num)(const char *)){
+  int num = STAT_NONE;
+  if(PyLong_Check(which)) {
+    num = (int)PyLong_AsLong(which);
+    if(num < 0 || num >= count)
+      num = STAT_NONE;
+  }
+  else if(PyUnicode_Check(which))
+    num = get_num(PyUnicode_AsUTF8(which));
+  if(num == STAT_NONE)
+    PyErr_Format(PyExc_KeyError, "There is no stat %R.", which);
+  return num;
+}
+
+int pystats_stat(PyObject *which) {
+  return pystats_get_num(which, statCount(), statGetNum);
+}
+
+int pystats_derived(PyObject *which) {
+  return pystats_get_num(which, derivedCount(), derivedGetNum);
+}
+
+//
+// what a script names the things derived values can be worked out from
+const char *derived_on_names[NUM_DERIVED_ON] = {
+  "stats", "position", "equipment", "injuries",
+};
+
+//
+// turn a name, or sequence of names, from derived_on_names into DERIVED_ON_
+// bits. Returns -1, with an exception set, if one isn't a name
+bitvector_t pystats_derived_on(PyObject *names) {
+  bitvector_t on = 0;
+  PyObject  *seq = NULL;
+  Py_ssize_t   i = 0;
+  int          j = 0;
+
+  if(PyUnicode_Check(names))
+    seq = PyTuple_Pack(1, names);
+  else
+    seq = PySequence_Fast(names, "What derived values are worked out from "
+			  "must be a name, or a sequence of names.");
+  if(seq == NULL)
+    return -1;
+
+  for(i = 0; i < PySequence_Fast_GET_SIZE(seq) && on != -1; i++) {
+    PyObject   *name = PySequence_Fast_GET_ITEM(seq, i);
+    const char  *str = (PyUnicode_Check(name) ? PyUnicode_AsUTF8(name) : NULL);
+    for(j = 0; str != NULL && j < NUM_DERIVED_ON; j++)
+      if(!strcasecmp(str, derived_on_names[j]))
+	break;
+    if(str == NULL || j == NUM_DERIVED_ON) {
+      PyErr_Format(PyExc_ValueError, "Derived values can't be worked out "
+		   "from %R.", name);
+      on = -1;
+    }
+    else
+      SET_BIT(on, 1 << j);
+  }
+  Py_DECREF(seq);
+  return on;
+}
+
+//
+// the character a method was called on. NULL, with an exception set, if
+// it no longer exists
+CHAR_DATA *pystats_char(PyObject *self) {
+  CHAR_DATA *ch = PyChar_AsChar(self);
+  if(ch == NULL)
+    PyErr_Format(PyExc_Exception, "Tried to use the stats of a nonexistent "
+		 "character, %d.", PyChar_AsUid(self));
+  return ch;
+}
+
+
+
+//*****************************************************************************
+// char methods
+//*****************************************************************************
+PyObject *PyChar_stat(PyObject *self, PyObject *which) {
+  CHAR_DATA *ch = pystats_char(self);
+  int      stat = (ch ? pystats_stat(which) : STAT_NONE);
+  if(stat == STAT_NONE)
+    return NULL;
+  return PyLong_FromLong(charGetStat(ch, stat));
+}
+
+PyObject *PyChar_set_stat(PyObject *self, PyObject *args) {
+  PyObject *which = NULL;
+  int         val = 0;
+  if(!PyArg_ParseTuple(args, "Oi", &which, &val))
+    return NULL;
+  CHAR_DATA *ch = pystats_char(self);
+  int      stat = (ch ? pystats_stat(which) : STAT_NONE);
+  if(stat == STAT_NONE)
+    return NULL;
+  charSetStat(ch, stat, val);
+  Py_RETURN_NONE;
+}
+
+PyObject *PyChar_derived(PyObject *self, PyObject *which) {
+  CHAR_DATA *ch = pystats_char(self);
+  int   derived = (ch ? pystats_derived(which) : STAT_NONE);
+  double    val = 0;
+  if(derived == STAT_NONE)
+    return NULL;
+  if(!charGetDerived(ch, derived, &val))
+    Py_RETURN_NONE;
+  return PyFloat_FromDouble(val);
+}
+
+PyObject *PyChar_set_derived(PyObject *self, PyObject *args) {
+  PyObject *which = NULL;
+  double      val = 0;
+  if(!PyArg_ParseTuple(args, "Od", &which, &val))
+    return NULL;
+  CHAR_DATA *ch = pystats_char(self);
+  int   derived = (ch ? pystats_derived(which) : STAT_NONE);
+  if(derived == STAT_NONE)
+    return NULL;
+  charSetDerived(ch, derived, val);
+  Py_RETURN_NONE;
+}
+
+PyObject *PyChar_forget_derived(PyObject *self, PyObject *args) {
+  CHAR_DATA *ch = pystats_char(self);
+  if(ch == NULL)
+    return NULL;
+  if(PyTuple_Size(args) == 0)
+    charForgetDerived(ch);
+  else {
+    bitvector_t on = pystats_derived_on(args);
+    if(on == -1)
+      return NULL;
+    charForgetDerivedOn(ch, on);
+  }
+  Py_RETURN_NONE;
+}
+
+PyObject *PyChar_getstatversion(PyObject *self, void *closure) {
+  CHAR_DATA *ch = pystats_char(self);
+  if(ch == NULL)
+    return NULL;
+  return PyLong_FromUnsignedLong(charGetStatVersion(ch));
+}
+
+
+
+//*****************************************************************************
+// mud methods
+//*****************************************************************************
+
+//
+// register_stat(name, default = 0)
+PyObject *mud_register_stat(PyObject *self, PyObject *args) {
+  char *name = NULL;
+  int  dflt  = 0;
+  if(!PyArg_ParseTuple(args, "s|i", &name, &dflt))
+    return NULL;
+  int stat = statRegister(name, dflt);
+  if(stat == STAT_NONE) {
+    PyErr_Format(PyExc_ValueError, "There can be at most %d stats.",MAX_STATS);
+    return NULL;
+  }
+  return PyLong_FromLong(stat);
+}
+
+//
+// register_derived(name, on = "stats")
+PyObject *mud_register_derived(PyObject *self, PyObject *args, PyObject *kwds){
+  static char *kwlist[] = { "name", "on", NULL };
+  char      *name = NULL;
+  PyObject *pyon  = NULL;
+  bitvector_t  on = DERIVED_ON_STATS;
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", kwlist, &name, &pyon))
+    return NULL;
+  if(pyon != NULL && (on = pystats_derived_on(pyon)) == -1)
+    return NULL;
+  int derived = derivedRegister(name, on);
+  if(derived == STAT_NONE) {
+    PyErr_Format(PyExc_ValueError, "There can be at most %d derived values.",
+		 MAX_DERIVED);
+    return NULL;
+  }
+  return PyLong_FromLong(derived);
+}
+
+
+
+//*****************************************************************************
+// implementation of pystats.h
+//*****************************************************************************
+void init_pystats(void) {
+  PyChar_addMethod("stat", PyChar_stat, METH_O,
+    "stat(stat)\n\n"
+    "Return one of the character's stats, by name or by the number\n"
+    "mud.register_stat gave it.");
+  PyChar_addMethod("set_stat", PyChar_set_stat, METH_VARARGS,
+    "set_stat(stat, val)\n\n"
+    "Set one of the character's stats, by name or number. Forgets all of\n"
+    "the character's derived values.");
+  PyChar_addMethod("derived", PyChar_derived, METH_O,
+    "derived(name)\n\n"
+    "Return the derived value last set with set_derived, or None if\n"
+    "anything it is worked out from has changed since.");
+  PyChar_addMethod("set_derived", PyChar_set_derived, METH_VARARGS,
+    "set_derived(name, val)\n\n"
+    "Remember a value worked out from the character, until something it is\n"
+    "worked out from next changes.");
+  PyChar_addMethod("forget_derived", PyChar_forget_derived, METH_VARARGS,
+    "forget_derived(*on)\n\n"
+    "Forget the character's derived values that are worked out from any of\n"
+    "on (stats, position, equipment, injuries), because it has changed. With\n"
+    "nothing, forget all of them. Setting a stat, changing position, and\n"
+    "equipping or removing something already do this.");
+  PyChar_addGetSetter("stat_version", PyChar_getstatversion, NULL,
+    "Goes up every time one of the character's stats is set. Immutable.");
+
+  PyMud_addMethod("register_stat", mud_register_stat, METH_VARARGS,
+    "register_stat(name, default = 0)\n\n"
+    "Add an integer stat to every character, and return its number. Stats\n"
+    "are saved with characters by name. Registering a stat again keeps its\n"
+    "number, and changes its default.");
+  PyMud_addMethod("register_derived", mud_register_derived,
+		  METH_VARARGS | METH_KEYWORDS,
+    "register_derived(name, on = \"stats\")\n\n"
+    "Add a value characters can remember with set_derived, and return its\n"
+    "number. on is what the value is worked out from: one of, or a sequence\n"
+    "of, stats, position, equipment, and injuries. A character forgets the\n"
+    "value when any of them changes.");
+}
@@ -0,0 +1,28 @@
+#ifndef __PYSTATS_H
+#define __PYSTATS_H
+//*****************************************************************************
+//
+// pystats.h
+//
+// character stat blocks for scripts (see stats.h). mud.register_stat(name,
+// default = 0) adds a stat and returns its number; chars read and set them
+// by name or, faster, by that number:
+//
+//   WISDOM = mud.register_stat("wisdom", 10)
+//   ch.set_stat(WISDOM, ch.stat(WISDOM) + 1)
+//
+// mud.register_derived(name, on = "stats") adds a derived value, worked out
+// from any of stats, position, equipment, and injuries. ch.derived(name) is
+// what was last given to ch.set_derived(name, val), or None if any of those
+// has changed since. Modules that keep injuries tell chars when they change:
+//
+//   ch.forget_derived("injuries")
+//
+//*****************************************************************************
+
+//
+// add the stat methods to chars, and register_stat and register_derived to
+// the mud module. Must be called before the char module is made
+void init_pystats(void);
+
+#endif // __PYSTATS_H
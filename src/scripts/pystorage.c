@@ -38,6 +38,7 @@ typedef struct {
 PyObject *newPyStorageList(STORAGE_SET_LIST *list);
 int     PyStorageSet_Check(PyObject *value);
 int    PyStorageList_Check(PyObject *value);
+extern PyTypeObject PyStorageSet_Type;
 
 
 
@@ -399,6 +400,209 @@ PyObject *PyStorageSet_storeSet   (PyObject *self, PyObject *args) {
   return Py_BuildValue("i", 1);
 }
 
+//
+// schemas registered by name, for to_dict
+PyObject *storage_schemas = NULL;
+
+//
+// find the schema a to_dict argument stands for: a dict, or the name of one
+// that has been registered. Returns a borrowed reference
+PyObject *storage_lookup_schema(PyObject *schema) {
+  if(PyUnicode_Check(schema)) {
+    PyObject *found = (storage_schemas ? 
+		       PyDict_GetItem(storage_schemas, schema) : NULL);
+    if(found == NULL)
+      PyErr_Format(PyExc_KeyError, "No storage schema is registered as %s.",
+		   PyUnicode_AsUTF8(schema));
+    return found;
+  }
+  if(!PyDict_Check(schema)) {
+    PyErr_Format(PyExc_TypeError, "Storage schemas must be dicts, or the "
+		 "names of registered schemas.");
+    return NULL;
+  }
+  return schema;
+}
+
+//
+// is the schema something to_dict knows how to read? Types are int, float,
+// bool, str, StorageSet, StorageList, a nested schema for a set, [schema] for
+// a list of sets, or a (type, default) pair for values that may be missing
+bool storage_schema_ok(PyObject *schema) {
+  PyObject *key = NULL, *type = NULL;
+  Py_ssize_t pos = 0;
+  if(!PyDict_Check(schema))
+    return FALSE;
+  while(PyDict_Next(schema, &pos, &key, &type)) {
+    if(!PyUnicode_Check(key))
+      return FALSE;
+    if(PyTuple_Check(type) && PyTuple_Size(type) == 2)
+      type = PyTuple_GetItem(type, 0);
+    if(type == (PyObject *)&PyLong_Type     || 
+       type == (PyObject *)&PyFloat_Type    ||
+       type == (PyObject *)&PyBool_Type     || 
+       type == (PyObject *)&PyUnicode_Type  ||
+       type == (PyObject *)&PyStorageSet_Type  ||
+       type == (PyObject *)&PyStorageList_Type)
+      continue;
+    if(PyDict_Check(type) && storage_schema_ok(type))
+      continue;
+    if(PyList_Check(type) && PyList_Size(type) == 1 &&
+       storage_schema_ok(PyList_GetItem(type, 0)))
+      continue;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+//
+// read everything in the schema out of the set, into a new dict
+PyObject *storage_set_to_dict(STORAGE_SET *set, PyObject *schema) {
+  PyObject *dict = PyDict_New();
+  PyObject  *key = NULL, *type = NULL;
+  Py_ssize_t pos = 0;
+
+  while(dict != NULL && PyDict_Next(schema, &pos, &key, &type)) {
+    const char *name = PyUnicode_AsUTF8(key);
+    PyObject    *val = NULL;
+    if(PyTuple_Check(type)) {
+      if(!storage_contains(set, name)) {
+	PyDict_SetItem(dict, key, PyTuple_GetItem(type, 1));
+	continue;
+      }
+      type = PyTuple_GetItem(type, 0);
+    }
+
+    if(type == (PyObject *)&PyBool_Type)
+      val = PyBool_FromLong(read_bool(set, name));
+    else if(type == (PyObject *)&PyLong_Type)
+      val = PyLong_FromLong(read_long(set, name));
+    else if(type == (PyObject *)&PyFloat_Type)
+      val = PyFloat_FromDouble(read_double(set, name));
+    else if(type == (PyObject *)&PyUnicode_Type)
+      val = PyUnicode_FromString(read_string(set, name));
+    else if(type == (PyObject *)&PyStorageSet_Type)
+      val = newPyStorageSet(read_set(set, name));
+    else if(type == (PyObject *)&PyStorageList_Type)
+      val = newPyStorageList(read_list(set, name));
+    else if(PyDict_Check(type))
+      val = storage_set_to_dict(read_set(set, name), type);
+    else {
+      STORAGE_SET_LIST *list = read_list(set, name);
+      STORAGE_SET       *elem = NULL;
+      PyObject        *inner = PyList_GetItem(type, 0);
+      val = PyList_New(0);
+      while(val != NULL && (elem = storage_list_next(list)) != NULL) {
+	PyObject *elem_dict = storage_set_to_dict(elem, inner);
+	if(elem_dict == NULL || PyList_Append(val, elem_dict) < 0)
+	  Py_CLEAR(val);
+	Py_XDECREF(elem_dict);
+      }
+    }
+
+    if(val == NULL || PyDict_SetItem(dict, key, val) < 0)
+      Py_CLEAR(dict);
+    Py_XDECREF(val);
+  }
+  return dict;
+}
+
+//
+// store everything in the dict into the set, with types taken from the
+// values. Returns FALSE, with an exception set, if something can't be stored
+bool storage_set_from_dict(STORAGE_SET *set, PyObject *dict) {
+  PyObject  *key = NULL, *val = NULL;
+  Py_ssize_t pos = 0;
+
+  while(PyDict_Next(dict, &pos, &key, &val)) {
+    if(!PyUnicode_Check(key)) {
+      PyErr_Format(PyExc_TypeError, "Storage set keys must be strings.");
+      return FALSE;
+    }
+    const char *name = PyUnicode_AsUTF8(key);
+
+    if(PyBool_Check(val))
+      store_bool(set, name, (val == Py_True));
+    else if(PyLong_Check(val))
+      store_long(set, name, PyLong_AsLong(val));
+    else if(PyFloat_Check(val))
+      store_double(set, name, PyFloat_AsDouble(val));
+    else if(PyUnicode_Check(val))
+      store_string(set, name, PyUnicode_AsUTF8(val));
+    else if(PyStorageSet_Check(val))
+      store_set(set, name, PyStorageSet_AsSet(val));
+    else if(PyStorageList_Check(val))
+      store_list(set, name, ((PyStorageList *)val)->list);
+    else if(PyDict_Check(val)) {
+      STORAGE_SET *inner = new_storage_set();
+      store_set(set, name, inner);
+      if(!storage_set_from_dict(inner, val))
+	return FALSE;
+    }
+    else if(PyList_Check(val) || PyTuple_Check(val)) {
+      STORAGE_SET_LIST *list = new_storage_list();
+      Py_ssize_t i, size = PySequence_Size(val);
+      store_list(set, name, list);
+      for(i = 0; i < size; i++) {
+	PyObject *elem = PySequence_Fast_GET_ITEM(val, i);
+	STORAGE_SET *inner = NULL;
+	if(PyStorageSet_Check(elem))
+	  inner = PyStorageSet_AsSet(elem);
+	else if(PyDict_Check(elem)) {
+	  inner = new_storage_set();
+	  storage_list_put(list, inner);
+	  if(!storage_set_from_dict(inner, elem))
+	    return FALSE;
+	  continue;
+	}
+	else {
+	  PyErr_Format(PyExc_TypeError, "Lists stored in storage sets may only "
+		       "hold dicts and storage sets (%s).", name);
+	  return FALSE;
+	}
+	storage_list_put(list, inner);
+      }
+    }
+    else if(val != Py_None) {
+      PyErr_Format(PyExc_TypeError, "%s can't be stored in a storage set.",
+		   name);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+//
+// read the set into a dict, according to a schema
+PyObject *PyStorageSet_to_dict    (PyObject *self, PyObject *args) {
+  PyObject *schema = NULL;
+  if(!PyArg_ParseTuple(args, "O", &schema))
+    return NULL;
+  if((schema = storage_lookup_schema(schema)) == NULL)
+    return NULL;
+  if(!storage_schema_ok(schema)) {
+    PyErr_Format(PyExc_TypeError, "Invalid storage schema.");
+    return NULL;
+  }
+  return storage_set_to_dict(((PyStorageSet *)self)->set, schema);
+}
+
+//
+// make a new set out of a dict
+PyObject *PyStorageSet_from_dict  (PyObject *cls, PyObject *args) {
+  PyObject *dict = NULL;
+  if(!PyArg_ParseTuple(args, "O!", &PyDict_Type, &dict)) {
+    PyErr_Format(PyExc_TypeError, "from_dict must be supplied a dict.");
+    return NULL;
+  }
+  STORAGE_SET *set = new_storage_set();
+  if(!storage_set_from_dict(set, dict)) {
+    storage_close(set);
+    return NULL;
+  }
+  return newPyStorageSet(set);
+}
+
 //
 // write the set to file
 PyObject *PyStorageSet_write      (PyObject *self, PyObject *args) { 
@@ -471,6 +675,22 @@ PyMethodDef PyStorageSet_class_methods[] = {
   { "storeSet",    PyStorageSet_storeSet,    METH_VARARGS,
     "Same as storeString, for storage sets." },
 
+  // all at once
+  { "to_dict",     PyStorageSet_to_dict,     METH_VARARGS,
+    "to_dict(schema)\n\n"
+    "Read many values out of the storage set in one call, and return them\n"
+    "in a dict. The schema is a dict of names to types, or the name of one\n"
+    "registered with storage.register_schema. Types can be int, float, bool,\n"
+    "str, StorageSet, StorageList, a nested schema for a set, [schema] for a\n"
+    "list of sets, or (type, default) for values that may not be there.\n"
+    "Values that aren't there otherwise read the same as with readInt, etc." },
+  { "from_dict",   PyStorageSet_from_dict,   METH_VARARGS | METH_CLASS,
+    "from_dict(dict)\n\n"
+    "Make a new storage set out of a dict in one call. Values are stored by\n"
+    "their type: ints, floats, bools, strings, storage sets and lists, dicts\n"
+    "as nested sets, and lists of dicts or sets as storage lists. Values of\n"
+    "None are left out." },
+
   // other functions
   { "write",       PyStorageSet_write,       METH_VARARGS,
     "write(filename)\n\n"
@@ -537,7 +757,24 @@ PyTypeObject PyStorageSet_Type = {
 
 //
 // all of the methods assocciated with the storage module
+PyObject *PyStorage_register_schema(PyObject *self, PyObject *args) {
+  PyObject *name = NULL, *schema = NULL;
+  if(!PyArg_ParseTuple(args, "UO", &name, &schema))
+    return NULL;
+  if(!storage_schema_ok(schema)) {
+    PyErr_Format(PyExc_TypeError, "Invalid storage schema.");
+    return NULL;
+  }
+  if(storage_schemas == NULL)
+    storage_schemas = PyDict_New();
+  PyDict_SetItem(storage_schemas, name, schema);
+  return Py_BuildValue("");
+}
+
 PyMethodDef PyStorage_module_methods[] = {
+  { "register_schema", PyStorage_register_schema, METH_VARARGS,
+    "register_schema(name, schema)\n\n"
+    "Register a schema for StorageSet.to_dict to be called with by name." },
   {NULL, NULL, 0, NULL}  /* Sentinel */
 };
 
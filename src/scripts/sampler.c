@@ -0,0 +1,577 @@
+//*****************************************************************************
+//
+// sampler.c
+//
+// a sampling profiler for the game thread. See sampler.h for how it is used.
+// Samples are taken inside of a SIGPROF handler, so all it does is copy the
+// C backtrace and what the game thread says it is doing into a ring that was
+// set aside ahead of time. Python frames can't be looked at from a signal
+// handler, so it also asks Python to run our signal handler of its own,
+// which Python does on the game thread as soon as it next can -- right away,
+// if it was running a script, and it is handed the frame it is in. It fills
+// in the Python part of the sample, if the C backtrace shows Python was
+// running when the sample was taken. Samples in the ring are turned into
+// names and counted up on the game thread, with every heartbeat, and when
+// sampling stops.
+//
+//*****************************************************************************
+
+#include <Python.h>
+#include <frameobject.h>
+#include <signal.h>
+#include <pthread.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <sys/time.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../character.h"
+#include "../socket.h"
+#include "../hooks.h"
+#include "pyplugs.h"
+#include "sampler.h"
+#include "../trace.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+#define SAMPLE_RING_SIZE     4096 // samples waiting to be counted up
+#define SAMPLE_MAX_FRAMES      64 // C frames kept for each sample
+#define SAMPLE_SKIP_FRAMES      2 // our handler, and the way into it
+#define SAMPLE_MAX_PY_FRAMES   64 // Python frames kept for each sample
+#define SAMPLE_MAX_DEPTH       32 // how deep samplerEnter calls can nest
+#define SAMPLE_MAX_CONTEXTS     8 // how many of them a sample keeps
+#define SAMPLE_CONTEXT_LEN     48
+#define SAMPLE_MAX_STACKS   20000 // stacks kept apart before lumping the rest
+#define SAMPLE_MIN_USECS     1000
+#define SAMPLE_FILE          "../log/samples.txt"
+
+typedef struct {
+  void         *frames[SAMPLE_MAX_FRAMES];
+  int       num_frames;
+  char        contexts[SAMPLE_MAX_CONTEXTS][SAMPLE_CONTEXT_LEN];
+  int     num_contexts;
+  sig_atomic_t py_wanted; // has Python not told us where it is yet?
+  char       *py_stack; // its Python frames, outermost first, if it had any
+} SAMPLE;
+
+// what the game thread is doing right now. Written by the game thread, and
+// read by our signal handler
+const char           *sample_kinds[SAMPLE_MAX_DEPTH];
+const char           *sample_names[SAMPLE_MAX_DEPTH];
+volatile sig_atomic_t sample_depth  = 0;
+
+// samples waiting to be counted up. The handler only ever moves the head
+// forward, and the game thread only ever moves the tail forward
+SAMPLE               *sample_ring   = NULL;
+volatile sig_atomic_t sample_head   = 0;
+volatile sig_atomic_t sample_tail   = 0;
+volatile sig_atomic_t sample_dropped = 0; // the ring was full
+volatile sig_atomic_t sample_missed = 0; // the signal went to another thread
+
+pthread_t             sample_thread;
+bool                  sample_on     = FALSE;
+int                   sample_usecs  = DFLT_SAMPLE_USECS;
+long                  sample_count  = 0;
+HASHTABLE            *sample_stacks = NULL; // collapsed stack -> times seen
+HASHTABLE           *sample_symbols = NULL; // address -> function name
+
+// a function, and how many samples it was seen in, for displaying
+typedef struct {
+  const char *name;
+  long       count;
+} SAMPLE_TOTAL;
+
+//
+// the SIGPROF handler. Nothing in here can allocate memory or take a lock
+void sample_signal(int sig) {
+  int saved_errno = errno;
+  if(!pthread_equal(pthread_self(), sample_thread))
+    sample_missed++;
+  else if(sample_head - sample_tail >= SAMPLE_RING_SIZE)
+    sample_dropped++;
+  else {
+    SAMPLE *sample = &sample_ring[sample_head % SAMPLE_RING_SIZE];
+    int      depth = sample_depth, i, j;
+    sample->num_frames   = backtrace(sample->frames, SAMPLE_MAX_FRAMES);
+    sample->num_contexts = MIN(depth, SAMPLE_MAX_CONTEXTS);
+
+    // no snprintf in here; copy "kind name" over by hand
+    for(i = 0; i < sample->num_contexts; i++) {
+      char       *ctx = sample->contexts[i];
+      const char *str = sample_kinds[i];
+      for(j = 0; str && *str && j < SAMPLE_CONTEXT_LEN - 2; str++)
+	ctx[j++] = *str;
+      ctx[j++] = ' ';
+      for(str = sample_names[i]; str && *str && j < SAMPLE_CONTEXT_LEN-1; str++)
+	ctx[j++] = *str;
+      ctx[j] = '\0';
+    }
+    sample->py_stack  = NULL;
+    sample->py_wanted = TRUE;
+    sample_head++;
+
+    // have Python tell us where it is, the next chance it gets
+    PyErr_SetInterruptEx(SIGPROF);
+  }
+  errno = saved_errno;
+}
+
+//
+// the name of the function an address is in
+const char *sample_symbol(void *addr) {
+  char  key[SMALL_BUFFER];
+  char *name = NULL;
+  snprintf(key, sizeof(key), "%p", addr);
+  if((name = hashGet(sample_symbols, key)) == NULL) {
+    Dl_info info;
+    bool     found = (dladdr(addr, &info) != 0);
+    if(found && info.dli_sname != NULL)
+      name = strdup(info.dli_sname);
+    // functions that aren't exported are lumped in with the rest of the
+    // library they're in
+    else if(found && info.dli_fname != NULL) {
+      const char *file = strrchr(info.dli_fname, '/');
+      name = strdup(file ? file + 1 : info.dli_fname);
+    }
+    else
+      name = strdup(key);
+    hashPut(sample_symbols, key, name);
+  }
+  return name;
+}
+
+//
+// find the outermost and innermost C frames of a sample that are Python
+// running bytecode. Returns FALSE if Python wasn't running
+bool sample_eval_frames(SAMPLE *sample, int *outer, int *inner) {
+  bool found = FALSE;
+  int      i = SAMPLE_SKIP_FRAMES;
+  for(; i < sample->num_frames; i++) {
+    if(!strncmp(sample_symbol(sample->frames[i]), "_PyEval_EvalFrame", 17)) {
+      if(!found && inner)
+	*inner = i;
+      if(outer)
+	*outer = i;
+      found = TRUE;
+    }
+  }
+  return found;
+}
+
+//
+// add a frame to a collapsed stack. Semicolons separate frames, so none can
+// be in a frame's name
+void sample_cat_frame(BUFFER *buf, const char *name) {
+  char frame[MAX_BUFFER];
+  char   *ch = frame;
+  snprintf(frame, sizeof(frame), "%s", name);
+  for(; *ch; ch++)
+    if(*ch == ';' || *ch == '\n')
+      *ch = ':';
+  if(bufferLength(buf) > 0)
+    bufferCat(buf, ";");
+  bufferCat(buf, frame);
+}
+
+//
+// the frames Python is in, outermost first and separated by semicolons
+char *sample_py_stack(PyFrameObject *frame) {
+  LIST   *names = newList();
+  BUFFER   *buf = newBuffer(MAX_BUFFER);
+  char    *name = NULL;
+  int     count = 0;
+
+  Py_INCREF(frame);
+  while(frame != NULL && count++ < SAMPLE_MAX_PY_FRAMES) {
+    PyCodeObject *code = PyFrame_GetCode(frame);
+    PyFrameObject *back = PyFrame_GetBack(frame);
+    const char    *file = PyUnicode_AsUTF8(code->co_filename);
+    const char   *slash = (file ? strrchr(file, '/') : NULL);
+#if PY_VERSION_HEX >= 0x030B0000
+    const char    *func = PyUnicode_AsUTF8(code->co_qualname);
+#else
+    const char    *func = PyUnicode_AsUTF8(code->co_name);
+#endif
+    char frame_name[SMALL_BUFFER];
+    snprintf(frame_name, sizeof(frame_name), "%s:%s",
+	     (slash ? slash + 1 : (file ? file : "?")), (func ? func : "?"));
+    listPut(names, strdup(frame_name));
+    Py_DECREF(code);
+    Py_DECREF(frame);
+    frame = back;
+  }
+  Py_XDECREF(frame);
+  PyErr_Clear();
+
+  while((name = listPop(names)) != NULL) {
+    sample_cat_frame(buf, name);
+    free(name);
+  }
+  deleteList(names);
+  name = strdup(bufferString(buf));
+  deleteBuffer(buf);
+  return name;
+}
+
+//
+// the signal handler we give to Python. It is called on the game thread with
+// the frame Python was in when it got around to us
+PyObject *sample_py_signal(PyObject *self, PyObject *args) {
+  PyObject *frame = NULL;
+  int      signum = 0;
+  if(!PyArg_ParseTuple(args, "iO", &signum, &frame))
+    return NULL;
+
+  // only the newest sample can still be where Python is now
+  int head = sample_head;
+  if(sample_ring != NULL && head != sample_tail && PyFrame_Check(frame)) {
+    SAMPLE *sample = &sample_ring[(head - 1) % SAMPLE_RING_SIZE];
+    if(sample->py_wanted) {
+      sample->py_wanted = FALSE;
+      if(sample_eval_frames(sample, NULL, NULL))
+	sample->py_stack = sample_py_stack((PyFrameObject *)frame);
+    }
+  }
+  Py_RETURN_NONE;
+}
+
+PyMethodDef sample_py_method = {
+  "sample_signal", (PyCFunction)sample_py_signal, METH_VARARGS,
+  "the sampling profiler's SIGPROF handler."
+};
+
+//
+// have Python call sample_py_signal when it hears about SIGPROF, or have it
+// ignore SIGPROF again. Python puts in a C handler of its own when we do
+// this, so ours has to go in after
+bool sample_py_listen(bool on) {
+  PyObject *module = PyImport_ImportModule("signal");
+  PyObject *func   = NULL;
+  PyObject *ret    = NULL;
+  if(module != NULL) {
+    func = (on ? PyCFunction_New(&sample_py_method, NULL) :
+	    PyObject_GetAttrString(module, "SIG_IGN"));
+    if(func != NULL)
+      ret = PyObject_CallMethod(module, "signal", "iO", SIGPROF, func);
+  }
+  if(ret == NULL)
+    log_pyerr("The sampler could not set Python's SIGPROF handler:");
+  Py_XDECREF(ret);
+  Py_XDECREF(func);
+  Py_XDECREF(module);
+  return (ret != NULL);
+}
+
+//
+// turn the samples in the ring into collapsed stacks, and count them up
+void sample_collect(void) {
+  if(sample_ring == NULL || sample_tail == sample_head)
+    return;
+
+  BUFFER *stack = newBuffer(MAX_BUFFER);
+  while(sample_tail != sample_head) {
+    SAMPLE *sample = &sample_ring[sample_tail % SAMPLE_RING_SIZE];
+    int      outer = -1, inner = -1, i;
+    bool        py = (sample->py_stack != NULL &&
+		      sample_eval_frames(sample, &outer, &inner));
+    long     count = 0;
+
+    // what the game thread said it was doing goes at the root
+    bufferClear(stack);
+    if(sample->num_contexts == 0)
+      sample_cat_frame(stack, "[game]");
+    for(i = 0; i < sample->num_contexts; i++) {
+      char ctx[SAMPLE_CONTEXT_LEN + 2];
+      snprintf(ctx, sizeof(ctx), "[%s]", sample->contexts[i]);
+      sample_cat_frame(stack, ctx);
+    }
+
+    // then C from the outside in, with the Python frames standing in for the
+    // interpreter's. After the interpreter, Python's own machinery for calling
+    // back into C is left out
+    for(i = sample->num_frames - 1; i >= SAMPLE_SKIP_FRAMES; i--) {
+      const char *name = NULL;
+      if(py && i <= outer && i >= inner) {
+	if(i == outer) {
+	  bufferCat(stack, ";");
+	  bufferCat(stack, sample->py_stack);
+	}
+	continue;
+      }
+      name = sample_symbol(sample->frames[i]);
+      if(py && i < inner && (!strncmp(name, "_Py", 3) || !strncmp(name,"Py",2) ||
+			     !strncmp(name, "libpython", 9)))
+	continue;
+      sample_cat_frame(stack, name);
+    }
+
+    // count it up
+    if(!hashIn(sample_stacks, bufferString(stack)) &&
+       hashSize(sample_stacks) >= SAMPLE_MAX_STACKS) {
+      bufferClear(stack);
+      bufferCat(stack, "[other stacks]");
+    }
+    count = (long)hashGet(sample_stacks, bufferString(stack));
+    hashPut(sample_stacks, bufferString(stack), (void *)(count + 1));
+    sample_count++;
+
+    if(sample->py_stack != NULL)
+      free(sample->py_stack);
+    sample->py_stack = NULL;
+    sample_tail++;
+  }
+  deleteBuffer(stack);
+}
+
+//
+// count up samples every heartbeat, so the ring doesn't fill
+void sample_heartbeat(const char *info) {
+  if(sample_on)
+    sample_collect();
+}
+
+//
+// sort totals, most samples first
+int sample_total_cmp(SAMPLE_TOTAL *a, SAMPLE_TOTAL *b) {
+  return (a->count < b->count ? 1 : (a->count > b->count ? -1 : 0));
+}
+
+//
+// the number of samples each function was at the top of the stack in, or
+// each thing the game thread was doing was at the root of the stack in. Must
+// be deleted with deleteListWith(list, deleteSampleTotal)
+LIST *sample_totals(bool leaves) {
+  HASHTABLE   *counts = newHashtable();
+  LIST        *totals = newList();
+  HASH_ITERATOR *st_i = newHashIterator(sample_stacks);
+  const char  *stack  = NULL;
+  void        *count  = NULL;
+  SAMPLE_TOTAL *total = NULL;
+  char name[MAX_BUFFER];
+
+  ITERATE_HASH(stack, count, st_i) {
+    const char *sep = (leaves ? strrchr(stack, ';') : strchr(stack, ';'));
+    if(leaves)
+      snprintf(name, sizeof(name), "%s", (sep ? sep + 1 : stack));
+    else
+      snprintf(name, sizeof(name), "%.*s",
+	       (int)(sep ? sep - stack : strlen(stack)), stack);
+    if((total = hashGet(counts, name)) == NULL) {
+      total = calloc(1, sizeof(SAMPLE_TOTAL));
+      hashPut(counts, name, total);
+      listPut(totals, total);
+    }
+    total->count += (long)count;
+  } deleteHashIterator(st_i);
+
+  // the names are the keys of the table we counted with
+  st_i = newHashIterator(counts);
+  ITERATE_HASH(stack, total, st_i) {
+    total->name = strdup(stack);
+  } deleteHashIterator(st_i);
+  deleteHashtable(counts);
+  listSortWith(totals, sample_total_cmp);
+  return totals;
+}
+
+void deleteSampleTotal(SAMPLE_TOTAL *total) {
+  free((char *)total->name);
+  free(total);
+}
+
+//
+// show a list of totals, no more than max of them
+void sample_show_totals(BUFFER *buf, LIST *totals, const char *header,int max){
+  LIST_ITERATOR *tot_i = newListIterator(totals);
+  SAMPLE_TOTAL  *total = NULL;
+  int            count = 0;
+  bprintf(buf, "{c%-60s %8s %6s{n\r\n", header, "Samples", "%");
+  ITERATE_LIST(total, tot_i) {
+    if(count++ >= max)
+      break;
+    bprintf(buf, "%-60.60s %8ld %5.1f%%\r\n", total->name, total->count,
+	    (sample_count > 0 ? 100.0 * total->count / sample_count : 0.0));
+  } deleteListIterator(tot_i);
+}
+
+//
+// control the sampler, or see what it has seen
+//   usage: sample [on [usecs] | off | reset | save [file]]
+COMMAND(cmd_sample) {
+  char    sub[SMALL_BUFFER];
+  char   *rest = one_arg(arg, sub);
+  if(!strcasecmp(sub, "on")) {
+    int usecs = (isdigit(*rest) ? atoi(rest) : DFLT_SAMPLE_USECS);
+    if(samplerStart(usecs))
+      send_to_char(ch, "Sampling every %d usec of CPU time.\r\n", sample_usecs);
+    else
+      send_to_char(ch, "The sampler could not be started.\r\n");
+    return;
+  }
+  else if(!strcasecmp(sub, "off")) {
+    samplerStop();
+    send_to_char(ch, "Sampling stopped. %ld samples have been taken.\r\n",
+		 sample_count);
+    return;
+  }
+  else if(!strcasecmp(sub, "reset")) {
+    samplerReset();
+    send_to_char(ch, "Samples forgotten.\r\n");
+    return;
+  }
+  else if(!strcasecmp(sub, "save")) {
+    const char *fname = (*rest ? rest : SAMPLE_FILE);
+    int       written = samplerSave(fname);
+    if(written < 0)
+      send_to_char(ch, "Could not open %s.\r\n", fname);
+    else
+      send_to_char(ch, "Wrote %d stacks to %s.\r\n", written, fname);
+    return;
+  }
+  else if(*sub) {
+    send_to_char(ch, "Usage: sample [on [usecs] | off | reset | save [file]]"
+		 "\r\n");
+    return;
+  }
+
+  sample_collect();
+  BUFFER *buf = newBuffer(MAX_BUFFER);
+  LIST *totals = NULL;
+  bprintf(buf, "Sampling is %s, every %d usec. %ld samples taken, %d dropped, "
+	  "%d on other threads.\r\n\r\n", (sample_on ? "on" : "off"),
+	  sample_usecs, sample_count, (int)sample_dropped, (int)sample_missed);
+
+  totals = sample_totals(FALSE);
+  sample_show_totals(buf, totals, "Doing", 10);
+  deleteListWith(totals, deleteSampleTotal);
+  bufferCat(buf, "\r\n");
+  totals = sample_totals(TRUE);
+  sample_show_totals(buf, totals, "Function", 20);
+  deleteListWith(totals, deleteSampleTotal);
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
+}
+
+
+
+//*****************************************************************************
+// implementation of sampler.h
+//*****************************************************************************
+void init_sampler(void) {
+  sample_stacks  = newHashtable();
+  sample_symbols = newHashtable();
+  hookAdd("heartbeat", sample_heartbeat);
+  add_cmd("sample", NULL, cmd_sample, "admin", FALSE);
+}
+
+bool samplerStart(int usecs) {
+  struct sigaction   act;
+  struct itimerval timer;
+  void      *warmup[1];
+
+  if(sample_on)
+    samplerStop();
+  usecs = MAX(SAMPLE_MIN_USECS, usecs);
+
+  // the first backtrace loads what it needs to run, which can't be done from
+  // inside of a signal handler
+  backtrace(warmup, 1);
+  if(sample_ring == NULL)
+    sample_ring = calloc(SAMPLE_RING_SIZE, sizeof(SAMPLE));
+  sample_head = sample_tail = 0;
+  sample_thread = pthread_self();
+
+  // without Python's help, we still get C backtraces
+  sample_py_listen(TRUE);
+
+  memset(&act, 0, sizeof(act));
+  act.sa_handler = sample_signal;
+  act.sa_flags   = SA_RESTART;
+  sigemptyset(&act.sa_mask);
+  if(sigaction(SIGPROF, &act, NULL) < 0) {
+    sample_py_listen(FALSE);
+    return FALSE;
+  }
+
+  timer.it_interval.tv_sec  = usecs / 1000000;
+  timer.it_interval.tv_usec = usecs % 1000000;
+  timer.it_value            = timer.it_interval;
+  if(setitimer(ITIMER_PROF, &timer, NULL) < 0) {
+    sample_py_listen(FALSE);
+    return FALSE;
+  }
+
+  sample_usecs = usecs;
+  sample_on    = TRUE;
+  return TRUE;
+}
+
+void samplerStop(void) {
+  struct itimerval timer;
+  if(!sample_on)
+    return;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+  // this also has the OS ignore any SIGPROF that is still on its way
+  sample_py_listen(FALSE);
+  sample_collect();
+  sample_on = FALSE;
+  free(sample_ring);
+  sample_ring = NULL;
+}
+
+bool samplerIsOn(void) {
+  return sample_on;
+}
+
+void samplerReset(void) {
+  sample_collect();
+  hashClear(sample_stacks);
+  sample_count   = 0;
+  sample_dropped = 0;
+  sample_missed  = 0;
+}
+
+int samplerSave(const char *fname) {
+  FILE *fl = fopen(fname, "w");
+  if(fl == NULL)
+    return -1;
+
+  sample_collect();
+  HASH_ITERATOR *st_i = newHashIterator(sample_stacks);
+  const char   *stack = NULL;
+  void         *count = NULL;
+  int         written = 0;
+  ITERATE_HASH(stack, count, st_i) {
+    fprintf(fl, "%s %ld\n", stack, (long)count);
+    written++;
+  } deleteHashIterator(st_i);
+  fclose(fl);
+  return written;
+}
+
+void samplerEnter(const char *kind, const char *name) {
+  int depth = sample_depth;
+  if(depth < SAMPLE_MAX_DEPTH) {
+    sample_kinds[depth] = kind;
+    sample_names[depth] = name;
+  }
+  sample_depth = depth + 1;
+  traceBegin(kind, name);
+}
+
+void samplerLeave(void) {
+  if(sample_depth > 0)
+    sample_depth--;
+  traceEnd();
+}
@@ -0,0 +1,54 @@
+#ifndef __SAMPLER_H
+#define __SAMPLER_H
+//*****************************************************************************
+//
+// sampler.h
+//
+// a sampling profiler for the game thread. While it is on, a timer goes off
+// every so many microseconds of CPU time, and each time it does we note
+// where the game thread is: its C backtrace, the Python functions it is in
+// the middle of, if it is running Python, and what it is doing at the moment
+// -- the commands, triggers, and hooks that are running, outermost first.
+// The samples are counted up as collapsed stacks, one line per stack with
+// its frames separated by semicolons, which is what flame graph tools take.
+// Admins turn it on and off, and save what it has seen, with the sample
+// command.
+//
+// Anything worth telling apart in a profile can say what it is doing with
+// samplerEnter and samplerLeave. They cost next to nothing, sampling or not.
+// What they note is also put on the pulse timeline, if it is being traced
+// (see trace.h).
+//
+//*****************************************************************************
+
+// how many microseconds between samples, if not told otherwise
+#define DFLT_SAMPLE_USECS     10000
+
+//
+// set up the sampler, and its admin command
+void init_sampler(void);
+
+//
+// start taking a sample every usecs microseconds of CPU time, or stop. Stopping
+// keeps what has been seen so far. Returns FALSE if sampling couldn't start
+bool samplerStart(int usecs);
+void samplerStop(void);
+bool samplerIsOn(void);
+
+//
+// forget every sample taken so far
+void samplerReset(void);
+
+//
+// write what has been seen so far to a file as collapsed stacks. Returns how
+// many stacks were written, or -1 if the file couldn't be opened
+int samplerSave(const char *fname);
+
+//
+// note that the game thread has started doing something (kind is something
+// like "cmd", "trigger", or "hook", and name says which one), or has finished
+// the last thing it started. kind and name must last until samplerLeave
+void samplerEnter(const char *kind, const char *name);
+void samplerLeave(void);
+
+#endif // __SAMPLER_H
@@ -0,0 +1,181 @@
+//*****************************************************************************
+//
+// script_budget.c
+//
+// a limit on how long one script can run for. See script_budget.h for how it
+// is used. The game thread tells the watchdog when a script starts, and when
+// its budget will run out. If the watchdog wakes up at that time and the same
+// script is still running, it hands Python a pending call. Python runs it on
+// the game thread the next time it checks for them, which it does even in the
+// middle of the tightest loop, and our call raises an error in the script.
+//
+//*****************************************************************************
+
+#include <Python.h>
+#include <frameobject.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../pulse.h"
+#include "script_budget.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// if Python has no room for our pending call, how long we wait to try again
+#define BUDGET_RETRY_USECS   10000
+
+// everything below is protected by budget_lock
+pthread_mutex_t  budget_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t   budget_wake = PTHREAD_COND_INITIALIZER; // a budget started
+long long    budget_deadline = 0;     // when the script runs out. 0 if none
+long              budget_run = 0;     // which script, bumped for every one
+bool           budget_queued = FALSE; // has our pending call been handed out?
+
+// these are only used by the game thread
+bool          budget_running = FALSE; // is the watchdog up?
+bool          budget_stopped = FALSE; // has the current script been stopped?
+int             budget_msecs = 0;
+char     budget_type[SMALL_BUFFER];
+char     budget_what[MAX_BUFFER];
+
+//
+// once a script has been stopped, every line it tries to run raises another
+// error, so it can't catch the first one and carry on looping
+int budget_trace(PyObject *obj, PyFrameObject *frame, int what, PyObject *arg){
+  if((what == PyTrace_LINE || what == PyTrace_CALL) && !PyErr_Occurred()) {
+    PyErr_Format(PyExc_RuntimeError, "script ran past its budget of %d ms",
+		 budget_msecs);
+    return -1;
+  }
+  return 0;
+}
+
+//
+// the pending call the watchdog hands to Python. Run on the game thread
+int budget_expired(void *arg) {
+  pthread_mutex_lock(&budget_lock);
+  bool current = (budget_deadline != 0 && budget_run == (long)arg);
+  pthread_mutex_unlock(&budget_lock);
+
+  // the script may have returned before Python got around to calling us
+  if(!current || budget_stopped)
+    return 0;
+  budget_stopped = TRUE;
+  PyEval_SetTrace(budget_trace, NULL);
+  PyErr_Format(PyExc_RuntimeError, "script ran past its budget of %d ms",
+	       budget_msecs);
+  return -1;
+}
+
+//
+// wait on budget_wake for at most usecs. budget_lock must be held
+void budget_timedwait(long long usecs) {
+  struct timeval  now;
+  struct timespec until;
+  gettimeofday(&now, NULL);
+  usecs         += now.tv_usec;
+  until.tv_sec   = now.tv_sec + usecs / 1000000LL;
+  until.tv_nsec  = (usecs % 1000000LL) * 1000;
+  pthread_cond_timedwait(&budget_wake, &budget_lock, &until);
+}
+
+//
+// the loop our watchdog thread runs. Sleeps until a script starts, and then
+// until its budget runs out
+void *budget_watchdog(void *arg) {
+  pthread_mutex_lock(&budget_lock);
+  for(;;) {
+    if(budget_deadline == 0 || budget_queued) {
+      pthread_cond_wait(&budget_wake, &budget_lock);
+      continue;
+    }
+
+    long long now = pulse_clock();
+    if(now < budget_deadline)
+      budget_timedwait(budget_deadline - now);
+    else if(Py_AddPendingCall(budget_expired, (void *)budget_run) != 0)
+      budget_timedwait(BUDGET_RETRY_USECS);
+    else {
+      // some versions of Python only notice a call added from a thread of
+      // its own when the game thread next gives up the interpreter lock.
+      // Asking for the lock makes it do that. We can't hold ours while we
+      // wait, or the script returning would leave us both waiting forever
+      budget_queued = TRUE;
+      pthread_mutex_unlock(&budget_lock);
+      PyGILState_STATE gstate = PyGILState_Ensure();
+      PyGILState_Release(gstate);
+      pthread_mutex_lock(&budget_lock);
+    }
+  }
+  pthread_mutex_unlock(&budget_lock);
+  return NULL;
+}
+
+
+
+//*****************************************************************************
+// implementation of script_budget.h
+//*****************************************************************************
+void init_script_budget(void) {
+  pthread_attr_t attr;
+  pthread_t    thread;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if(pthread_create(&thread, &attr, budget_watchdog, NULL) != 0)
+    log_string("Could not start the script watchdog thread. Scripts will run "
+	       "with no time limit.");
+  else
+    budget_running = TRUE;
+  pthread_attr_destroy(&attr);
+}
+
+int scriptBudgetGetMsecs(const char *type) {
+  if(type != NULL && *type) {
+    char setting[SMALL_BUFFER];
+    snprintf(setting, SMALL_BUFFER, "script_budget_ms_%s", type);
+    if(*mudsettingGetString(setting))
+      return MAX(0, mudsettingGetInt(setting));
+  }
+  return MAX(0, mudsettingGetInt("script_budget_ms"));
+}
+
+void scriptBudgetStart(const char *type, const char *what) {
+  budget_stopped = FALSE;
+  budget_msecs   = (budget_running ? scriptBudgetGetMsecs(type) : 0);
+  if(budget_msecs == 0)
+    return;
+  snprintf(budget_type, SMALL_BUFFER, "%s", (type ? type : "script"));
+  snprintf(budget_what, MAX_BUFFER,   "%s", (what ? what : "<unknown>"));
+
+  pthread_mutex_lock(&budget_lock);
+  budget_deadline = pulse_clock() + (long long)budget_msecs * 1000LL;
+  budget_queued   = FALSE;
+  budget_run++;
+  pthread_cond_signal(&budget_wake);
+  pthread_mutex_unlock(&budget_lock);
+}
+
+bool scriptBudgetEnd(void) {
+  if(budget_msecs == 0)
+    return FALSE;
+
+  // the watchdog is left asleep until the next script starts
+  pthread_mutex_lock(&budget_lock);
+  budget_deadline = 0;
+  pthread_mutex_unlock(&budget_lock);
+
+  if(!budget_stopped)
+    return FALSE;
+  PyEval_SetTrace(NULL, NULL);
+  budget_stopped = FALSE;
+  log_string("Script budget: %s %s ran longer than %d ms and was stopped.",
+	     budget_type, budget_what, budget_msecs);
+  return TRUE;
+}
@@ -0,0 +1,43 @@
+#ifndef __SCRIPT_BUDGET_H
+#define __SCRIPT_BUDGET_H
+//*****************************************************************************
+//
+// script_budget.h
+//
+// a limit on how long one script can run for, so a builder's accidental
+// infinite loop can't stall the whole mud. When run_code starts a script
+// that isn't being run from within another one, a watchdog thread notes when
+// its budget runs out. If the script is still going then, the watchdog has
+// Python raise an error in it, and keeps raising one on every line it runs
+// after that (so a bare except can't keep it alive) until it returns.
+// Scripts stuck inside of C code, like time.sleep, are stopped once they come
+// back out of it.
+//
+// Budgets are set in milliseconds with the mud setting script_budget_ms, and
+// can be set for one type of trigger with script_budget_ms_<type> (for
+// instance, script_budget_ms_heartbeat). A budget of 0 means no limit.
+//
+//*****************************************************************************
+
+//
+// start up the watchdog thread. If it can't be started, scripts run with no
+// limit on how long they take
+void init_script_budget(void);
+
+//
+// how many milliseconds a script of the given type can run for. A NULL type
+// gets the default budget. 0 means no limit
+int scriptBudgetGetMsecs(const char *type);
+
+//
+// start the budget for a script that is about to run. type is the type of
+// trigger it is, or NULL if it is not one, and what identifies the script
+// for the log if it runs over
+void scriptBudgetStart(const char *type, const char *what);
+
+//
+// the script we started a budget for has returned. Returns TRUE, and logs
+// which script it was, if it ran out of time and was stopped
+bool scriptBudgetEnd(void);
+
+#endif // __SCRIPT_BUDGET_H
@@ -116,7 +116,7 @@ void scriptEditorAppend(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
 //
 // list the script buffer to the socket, but do all of our syntax highlighting
 void scriptEditorList(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
-  script_display(sock, bufferString(buf), TRUE);
+  script_display(sock, socketGetEditorText(sock), TRUE);
 }
 
 //
@@ -134,19 +134,16 @@ void socketInitScriptEditor(SOCKET_DATA *sock) {
 }
 
 //
-// bufferInsert appends a carriage return to the end of the argument, but this
-// makes Python choke. Soooo... we have to do the append, and then remove the
-// carriage return that was inserted.
+// the text editor ends the lines it puts in with a carriage return, but this
+// makes Python choke. Script lines only end with a newline.
 void scriptEditorInsert(SOCKET_DATA *sock, char *arg, BUFFER *buf) { 
   char tmp[SMALL_BUFFER];
   arg = one_arg(arg, tmp);
   int line = atoi(tmp);
-  if(!isdigit(*tmp) || !bufferInsert(buf, arg, line))
+  if(!isdigit(*tmp) || !socketEditorInsertLine(sock, line, arg, "\n"))
     text_to_buffer(sock, "Insertion failed.\r\n");
-  else {
+  else
     text_to_buffer(sock, "Line inserted.\r\n");
-    bufferReplace(buf, "\r", "", TRUE);    
-  }
 }
 
 //
@@ -155,12 +152,10 @@ void scriptEditorEditLine(SOCKET_DATA *sock, char *arg, BUFFER *buf) {
   char tmp[SMALL_BUFFER];
   arg = one_arg(arg, tmp);
   int line = atoi(tmp);
-  if(!isdigit(*tmp) || !bufferReplaceLine(buf, arg, line))
+  if(!isdigit(*tmp) || !socketEditorReplaceLine(sock, line, arg, "\n"))
     text_to_buffer(sock, "Line does not exist.\r\n");
-  else {
+  else
     text_to_buffer(sock, "Line replaced.\r\n");
-    bufferReplace(buf, "\r", "", TRUE);
-  }
 }
 
 
@@ -172,20 +167,20 @@ void init_script_editor() {
   script_editor = newEditor();
   editorSetAppend(script_editor, scriptEditorAppend);
   editorSetInit(script_editor, socketInitScriptEditor);
-  editorAddCommand(script_editor, "v", "        Indent down the script editor",
-		   scriptEditorUndent);
-  editorAddCommand(script_editor, "^", "        Indent up the script editor",
-		   scriptEditorIndent);
-  editorAddCommand(script_editor, "-", "        Toggle auto-indenting",
-		   scriptEditorToggleAutoindent);
-  editorAddCommand(script_editor, "l", "        List the current buffer contents",
-		   scriptEditorList);
+  editorAddLineCommand(script_editor, "v", "        Indent down the script editor",
+		       scriptEditorUndent);
+  editorAddLineCommand(script_editor, "^", "        Indent up the script editor",
+		       scriptEditorIndent);
+  editorAddLineCommand(script_editor, "-", "        Toggle auto-indenting",
+		       scriptEditorToggleAutoindent);
+  editorAddLineCommand(script_editor, "l", "        List the current buffer contents",
+		       scriptEditorList);
   editorAddCommand(script_editor, "f", "        Strips all bad characters out of the script",
 		   scriptEditorFormat);
-  editorAddCommand(script_editor, "i", "# <txt> Insert new text at the specified line number",
-		   scriptEditorInsert);
-  editorAddCommand(script_editor, "e", "# <txt> Sets the text at the specified line to the new text", 
-		   scriptEditorEditLine);
+  editorAddLineCommand(script_editor, "i", "# <txt> Insert new text at the specified line number",
+		       scriptEditorInsert);
+  editorAddLineCommand(script_editor, "e", "# <txt> Sets the text at the specified line to the new text", 
+		       scriptEditorEditLine);
 
   auxiliariesInstall("script_editor_aux_data", 
 		     newAuxiliaryFuncs(AUXILIARY_TYPE_SOCKET,
@@ -0,0 +1,252 @@
+//*****************************************************************************
+//
+// script_gc.c
+//
+// freezing Python's heap, and timing its garbage collections. See
+// script_gc.h
+//
+//*****************************************************************************
+
+#include <Python.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../character.h"
+#include "../socket.h"
+#include "../hooks.h"
+#include "../pulse.h"
+#include "../metrics.h"
+#include "script_gc.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the generations Python's collector has
+#define GC_GENERATIONS    3
+
+// what we know about the collections of one generation
+typedef struct {
+  long long collections;
+  long long   collected;
+  long long  total_usec;
+  long long    max_usec;
+} GC_STAT;
+
+GC_STAT gc_stats[GC_GENERATIONS];
+
+// when the collection going on now started, or 0 if there isn't one
+long long gc_start = 0;
+
+// have we frozen the heap after startup yet?
+bool gc_startup_frozen = FALSE;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// call one of the gc module's functions, and return what it returns
+PyObject *gc_call(const char *func, const char *format, ...) {
+  PyObject *gc = PyImport_ImportModule("gc");
+  PyObject *ret = NULL;
+  if(gc != NULL) {
+    PyObject *f = PyObject_GetAttrString(gc, func);
+    if(f != NULL) {
+      va_list args;
+      va_start(args, format);
+      PyObject *arglist = (format ? Py_VaBuildValue(format, args) :
+			   PyTuple_New(0));
+      va_end(args);
+      if(arglist != NULL && !PyTuple_Check(arglist)) {
+	PyObject *tuple = PyTuple_Pack(1, arglist);
+	Py_DECREF(arglist);
+	arglist = tuple;
+      }
+      if(arglist != NULL)
+	ret = PyObject_CallObject(f, arglist);
+      Py_XDECREF(arglist);
+      Py_DECREF(f);
+    }
+    Py_DECREF(gc);
+  }
+  if(ret == NULL)
+    PyErr_Clear();
+  return ret;
+}
+
+long long gc_call_long(const char *func) {
+  PyObject *ret = gc_call(func, NULL);
+  long long val = ((ret && PyLong_Check(ret)) ? PyLong_AsLongLong(ret) : -1);
+  Py_XDECREF(ret);
+  return val;
+}
+
+//
+// gc.callbacks calls this with "start" before each collection, and "stop"
+// after it, along with a dict saying which generation it was
+PyObject *gc_callback(PyObject *self, PyObject *args) {
+  const char *phase = NULL;
+  PyObject    *info = NULL;
+  if(!PyArg_ParseTuple(args, "sO", &phase, &info))
+    return NULL;
+
+  if(!strcmp(phase, "start"))
+    gc_start = pulse_clock();
+  else if(gc_start > 0) {
+    long long usecs = pulse_clock() - gc_start;
+    PyObject    *gen = PyDict_GetItemString(info, "generation");
+    PyObject   *coll = PyDict_GetItemString(info, "collected");
+    int   generation = (gen  ? (int)PyLong_AsLong(gen) : 0);
+    long long collected = (coll ? PyLong_AsLongLong(coll) : 0);
+    gc_start = 0;
+
+    if(generation >= 0 && generation < GC_GENERATIONS) {
+      GC_STAT *stat = &gc_stats[generation];
+      stat->collections++;
+      stat->collected  += collected;
+      stat->total_usec += usecs;
+      stat->max_usec    = MAX(stat->max_usec, usecs);
+    }
+
+    int log_msecs = mudsettingGetInt("gc_pause_log_msecs");
+    if(log_msecs > 0 && usecs >= log_msecs * 1000LL)
+      log_string("Python gc: generation %d collection took %.1f ms, and "
+		 "collected %lld objects", generation, usecs / 1000.0,
+		 collected);
+  }
+  if(PyErr_Occurred())
+    PyErr_Clear();
+  Py_RETURN_NONE;
+}
+
+PyMethodDef gc_callback_def = {
+  "nakedmud_gc_callback", gc_callback, METH_VARARGS,
+  "Times Python's garbage collections." };
+
+//
+// the mud is done booting. Everything made up to now is here to stay
+void gc_startup_batch(const char *type, LIST *infos) {
+  if(gc_startup_frozen)
+    return;
+  gc_startup_frozen = TRUE;
+  long long frozen = freeze_script_heap();
+  if(frozen >= 0)
+    log_string("Froze %lld Python objects after startup", frozen);
+}
+
+void script_gc_metrics(BUFFER *buf) {
+  char labels[SMALL_BUFFER];
+  int i;
+  metricsDeclare(buf, "nakedmud_python_gc_pause_usec_total", "counter",
+		 "Time spent in Python garbage collections, by generation.");
+  for(i = 0; i < GC_GENERATIONS; i++) {
+    snprintf(labels, sizeof(labels), "generation=\"%d\"", i);
+    metricsValue(buf, "nakedmud_python_gc_pause_usec_total", labels,
+		 gc_stats[i].total_usec);
+  }
+  metricsDeclare(buf, "nakedmud_python_gc_pause_max_usec", "gauge",
+		 "The longest Python garbage collection, by generation.");
+  for(i = 0; i < GC_GENERATIONS; i++) {
+    snprintf(labels, sizeof(labels), "generation=\"%d\"", i);
+    metricsValue(buf, "nakedmud_python_gc_pause_max_usec", labels,
+		 gc_stats[i].max_usec);
+  }
+}
+
+//
+// show how the collector has been doing, freeze the heap again, or forget
+// the times we've been keeping
+COMMAND(cmd_gcstat) {
+  if(!strcasecmp(arg, "freeze")) {
+    long long frozen = freeze_script_heap();
+    if(frozen < 0)
+      send_to_char(ch, "Python's heap could not be frozen.\r\n");
+    else
+      send_to_char(ch, "%lld Python objects are now frozen.\r\n", frozen);
+    return;
+  }
+  else if(!strcasecmp(arg, "reset")) {
+    memset(gc_stats, 0, sizeof(gc_stats));
+    send_to_char(ch, "Python gc times have been reset.\r\n");
+    return;
+  }
+  else if(*arg) {
+    send_to_char(ch, "Usage: gcstat [freeze | reset]\r\n");
+    return;
+  }
+
+  BUFFER *buf = newBuffer(MAX_BUFFER);
+  PyObject *thresh = gc_call("get_threshold", NULL);
+  PyObject *counts = gc_call("get_count", NULL);
+  int i;
+  bprintf(buf, "%lld Python objects are frozen.\r\n\r\n",
+	  gc_call_long("get_freeze_count"));
+  bprintf(buf, "%-4s %10s %10s %12s %12s %10s %10s\r\n", "Gen", "Threshold",
+	  "Pending", "Collections", "Collected", "Avg ms", "Max ms");
+  for(i = 0; i < GC_GENERATIONS; i++) {
+    GC_STAT *stat = &gc_stats[i];
+    long th = ((thresh && PyTuple_Check(thresh) && i < PyTuple_Size(thresh)) ?
+	       PyLong_AsLong(PyTuple_GetItem(thresh, i)) : -1);
+    long co = ((counts && PyTuple_Check(counts) && i < PyTuple_Size(counts)) ?
+	       PyLong_AsLong(PyTuple_GetItem(counts, i)) : -1);
+    bprintf(buf, "%-4d %10ld %10ld %12lld %12lld %10.2f %10.2f\r\n", i, th, co,
+	    stat->collections, stat->collected,
+	    (stat->collections ? stat->total_usec / 1000.0 / stat->collections
+	     : 0.0), stat->max_usec / 1000.0);
+  }
+  Py_XDECREF(thresh);
+  Py_XDECREF(counts);
+  if(PyErr_Occurred())
+    PyErr_Clear();
+  send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
+}
+
+
+
+//*****************************************************************************
+// implementation of script_gc.h
+//*****************************************************************************
+void init_script_gc(void) {
+  memset(gc_stats, 0, sizeof(gc_stats));
+
+  PyObject *ret = gc_call("set_threshold", "(iii)",
+			  mudsettingGetInt("gc_threshold0"),
+			  mudsettingGetInt("gc_threshold1"),
+			  mudsettingGetInt("gc_threshold2"));
+  if(ret == NULL)
+    log_string("ERROR: could not set Python's gc thresholds");
+  Py_XDECREF(ret);
+
+  // time every collection
+  PyObject    *gc = PyImport_ImportModule("gc");
+  PyObject *cbs = (gc ? PyObject_GetAttrString(gc, "callbacks") : NULL);
+  PyObject  *cb = PyCFunction_New(&gc_callback_def, NULL);
+  if(cbs == NULL || cb == NULL || PyList_Append(cbs, cb) < 0) {
+    log_string("ERROR: could not time Python's gc collections");
+    PyErr_Clear();
+  }
+  Py_XDECREF(cb);
+  Py_XDECREF(cbs);
+  Py_XDECREF(gc);
+
+  // batches are handed out at the end of the pulse, which is after all of
+  // startup's listeners, Python ones included, have had their turn
+  hookAddBatch("startup", gc_startup_batch);
+  metricsAddSource(script_gc_metrics);
+  add_cmd("gcstat", NULL, cmd_gcstat, "admin", FALSE);
+}
+
+long long freeze_script_heap(void) {
+  PyObject *ret = gc_call("collect", NULL);
+  Py_XDECREF(ret);
+  if(ret == NULL || (ret = gc_call("freeze", NULL)) == NULL)
+    return -1;
+  Py_DECREF(ret);
+  return gc_call_long("get_freeze_count");
+}
@@ -0,0 +1,29 @@
+#ifndef __SCRIPT_GC_H
+#define __SCRIPT_GC_H
+//*****************************************************************************
+//
+// script_gc.h
+//
+// keeping Python's garbage collector out of the game loop's way. Once the
+// mud is done booting, everything Python has made so far (modules, compiled
+// scripts, auxiliary data, help) is collected once and then frozen with
+// gc.freeze(), so later collections don't go over it again. The collector's
+// thresholds come from the gc_threshold0, gc_threshold1 and gc_threshold2
+// settings, and collections that take longer than gc_pause_log_msecs are
+// logged. The gcstat admin command shows how the collector has been doing,
+// and gcstat freeze freezes the heap again, e.g. after a lot of the world
+// has been reloaded.
+//
+//*****************************************************************************
+
+//
+// set the collector's thresholds, start timing its collections, and freeze
+// the heap once startup is done
+void init_script_gc(void);
+
+//
+// collect everything that can be, and freeze what is left. Returns how many
+// objects are frozen, or -1 if something went wrong
+long long freeze_script_heap(void);
+
+#endif // __SCRIPT_GC_H
@@ -0,0 +1,213 @@
+//*****************************************************************************
+//
+// script_heap.c
+//
+// memstat, and what Python's heap looks like. See script_heap.h
+//
+//*****************************************************************************
+
+#include <Python.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../character.h"
+#include "../socket.h"
+#include "../memstat.h"
+#include "../metrics.h"
+#include "script_heap.h"
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// call a function with no arguments, and return what it returns as a long
+// long, or -1 if something went wrong
+long long heap_call_long(PyObject *func) {
+  PyObject *ret = (func ? PyObject_CallObject(func, NULL) : NULL);
+  long long val = ((ret && PyLong_Check(ret)) ? PyLong_AsLongLong(ret) : -1);
+  Py_XDECREF(ret);
+  if(PyErr_Occurred())
+    PyErr_Clear();
+  return val;
+}
+
+//
+// how many memory blocks Python has allocated
+long long heap_allocated_blocks(void) {
+  return heap_call_long(PySys_GetObject("getallocatedblocks"));
+}
+
+//
+// is tracemalloc tracing? If so, fill in how much memory it is tracing now,
+// and how much it has ever traced at once
+bool heap_traced_memory(long long *now, long long *peak) {
+  PyObject *tm = PyImport_ImportModule("tracemalloc");
+  PyObject *ret = NULL;
+  bool   traced = FALSE;
+  if(tm != NULL) {
+    PyObject *on = PyObject_CallMethod(tm, "is_tracing", NULL);
+    if(on != NULL && PyObject_IsTrue(on))
+      ret = PyObject_CallMethod(tm, "get_traced_memory", NULL);
+    Py_XDECREF(on);
+  }
+  if(ret != NULL && PyTuple_Check(ret) && PyTuple_Size(ret) == 2) {
+    *now   = PyLong_AsLongLong(PyTuple_GetItem(ret, 0));
+    *peak  = PyLong_AsLongLong(PyTuple_GetItem(ret, 1));
+    traced = TRUE;
+  }
+  Py_XDECREF(ret);
+  Py_XDECREF(tm);
+  if(PyErr_Occurred())
+    PyErr_Clear();
+  return traced;
+}
+
+//
+// write the lines of Python source that are holding the most memory onto
+// buf, leaving out what tracemalloc itself is holding
+void heap_show_top(BUFFER *buf, int count) {
+  PyObject *tm = PyImport_ImportModule("tracemalloc");
+  PyObject *snap = NULL, *file = NULL, *filter = NULL, *stats = NULL;
+  int i;
+
+  if(tm != NULL)
+    snap = PyObject_CallMethod(tm, "take_snapshot", NULL);
+  if(snap != NULL)
+    file = PyObject_GetAttrString(tm, "__file__");
+  if(file != NULL)
+    filter = PyObject_CallMethod(tm, "Filter", "OO", Py_False, file);
+  if(filter != NULL) {
+    PyObject *filtered = PyObject_CallMethod(snap, "filter_traces", "[O]",
+					     filter);
+    if(filtered != NULL)
+      stats = PyObject_CallMethod(filtered, "statistics", "s", "lineno");
+    Py_XDECREF(filtered);
+  }
+
+  if(stats == NULL || !PyList_Check(stats))
+    bufferCat(buf, "A snapshot of the Python heap could not be taken.\r\n");
+  else {
+    bprintf(buf, "Python source holding the most memory:\r\n");
+    for(i = 0; i < count && i < PyList_Size(stats); i++) {
+      PyObject *str = PyObject_Str(PyList_GetItem(stats, i));
+      if(str != NULL)
+	bprintf(buf, "  %s\r\n", PyUnicode_AsUTF8(str));
+      Py_XDECREF(str);
+    }
+  }
+
+  Py_XDECREF(stats);
+  Py_XDECREF(filter);
+  Py_XDECREF(file);
+  Py_XDECREF(snap);
+  Py_XDECREF(tm);
+  if(PyErr_Occurred())
+    PyErr_Clear();
+}
+
+//
+// turn tracemalloc on, keeping frames frames of each allocation, or off.
+// Returns FALSE if it couldn't be done
+bool heap_trace(bool on, int frames) {
+  PyObject *tm  = PyImport_ImportModule("tracemalloc");
+  PyObject *ret = NULL;
+  if(tm != NULL)
+    ret = (on ? PyObject_CallMethod(tm, "start", "i", frames) :
+	   PyObject_CallMethod(tm, "stop", NULL));
+  bool ok = (ret != NULL);
+  Py_XDECREF(ret);
+  Py_XDECREF(tm);
+  if(PyErr_Occurred())
+    PyErr_Clear();
+  return ok;
+}
+
+//
+// the Python heap, for the metrics port
+void script_heap_metrics(BUFFER *buf) {
+  long long now = 0, peak = 0;
+  metricsDeclare(buf, "nakedmud_python_allocated_blocks", "gauge",
+		 "Memory blocks allocated by Python.");
+  metricsValue(buf, "nakedmud_python_allocated_blocks", NULL,
+	       heap_allocated_blocks());
+  if(heap_traced_memory(&now, &peak)) {
+    metricsDeclare(buf, "nakedmud_python_traced_bytes", "gauge",
+		   "Bytes allocated by Python, while tracemalloc is tracing.");
+    metricsValue(buf, "nakedmud_python_traced_bytes", NULL, now);
+    metricsDeclare(buf, "nakedmud_python_traced_peak_bytes", "gauge",
+		   "The most bytes Python has had allocated at once, while "
+		   "tracemalloc is tracing.");
+    metricsValue(buf, "nakedmud_python_traced_peak_bytes", NULL, peak);
+  }
+}
+
+//
+// show what the core datastructures and Python are holding on to, or turn
+// tracing Python's heap on and off
+COMMAND(cmd_memstat) {
+  char sub[SMALL_BUFFER];
+  char *rest = one_arg(arg, sub);
+  int   top  = DFLT_MEMSTAT_TOP;
+
+  if(!strcasecmp(sub, "trace")) {
+    char onoff[SMALL_BUFFER];
+    rest = one_arg(rest, onoff);
+    bool on = !strcasecmp(onoff, "on");
+    if(!on && strcasecmp(onoff, "off"))
+      send_to_char(ch, "Turn Python heap tracing on or off?\r\n");
+    else if(!heap_trace(on, (isdigit(*rest) ? MAX(1, atoi(rest)) : 1)))
+      send_to_char(ch, "Python heap tracing could not be turned %s.\r\n",
+		   onoff);
+    else
+      send_to_char(ch, "Python heap tracing is now %s.\r\n", onoff);
+    return;
+  }
+  else if(!strcasecmp(sub, "top") && isdigit(*rest))
+    top = atoi(rest);
+  else if(*sub && strcasecmp(sub, "top")) {
+    send_to_char(ch, "Usage: memstat [top [lines] | trace on [frames] | "
+		 "trace off]\r\n");
+    return;
+  }
+
+  BUFFER *buf = newBuffer(MAX_BUFFER);
+  long long now = 0, peak = 0, bytes = 0;
+  int tag;
+  bprintf(buf, "%-16s %12s %14s %14s\r\n", "Tag", "Live", "Bytes", "Made");
+  for(tag = 0; tag < NUM_MEM_TAGS; tag++) {
+    bprintf(buf, "%-16s %12lld %14lld %14lld\r\n", memTagName(tag),
+	    memTagLive(tag), memTagBytes(tag), memTagMade(tag));
+    bytes += memTagBytes(tag);
+  }
+  bprintf(buf, "%-16s %12s %14lld\r\n\r\n", "total", "", bytes);
+
+  bprintf(buf, "Python has %lld memory blocks allocated.\r\n",
+	  heap_allocated_blocks());
+  if(!heap_traced_memory(&now, &peak))
+    bufferCat(buf, "Python heap tracing is off; memstat trace on turns it "
+	      "on.\r\n");
+  else {
+    bprintf(buf, "Python is using %lld bytes, and has used at most %lld."
+	    "\r\n\r\n", now, peak);
+    heap_show_top(buf, top);
+  }
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
+}
+
+
+
+//*****************************************************************************
+// implementation of script_heap.h
+//*****************************************************************************
+void init_script_heap(void) {
+  metricsAddSource(script_heap_metrics);
+  add_cmd("memstat", NULL, cmd_memstat, "admin", FALSE);
+}
@@ -0,0 +1,23 @@
+#ifndef __SCRIPT_HEAP_H
+#define __SCRIPT_HEAP_H
+//*****************************************************************************
+//
+// script_heap.h
+//
+// the memstat admin command, which shows what the mud's core datastructures
+// are holding on to (see memstat.h) next to what Python's heap is. Python
+// only knows where its memory went if tracemalloc is tracing it, which slows
+// every allocation down, so it is off until an admin turns it on with
+// memstat trace on, or the mud is started with PYTHONTRACEMALLOC set. The
+// Python heap is also served on the metrics port.
+//
+//*****************************************************************************
+
+// how many lines of Python source memstat lists, if not told otherwise
+#define DFLT_MEMSTAT_TOP     10
+
+//
+// set up the memstat command, and the Python heap metrics
+void init_script_heap(void);
+
+#endif // __SCRIPT_HEAP_H
@@ -0,0 +1,234 @@
+//*****************************************************************************
+//
+// script_prof.c
+//
+// an opt-in profiler for triggers and prototype scripts. See script_prof.h
+// for more information.
+//
+//*****************************************************************************
+
+#include <time.h>
+
+#include "../mud.h"
+#include "../utils.h"
+#include "../character.h"
+#include "../socket.h"
+#include "script_prof.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+typedef struct {
+  char       *kind;
+  char        *key;
+  char      *owner;
+  long long  usecs;
+  time_t      when;
+} SLOW_RUN;
+
+bool        script_prof_on = FALSE;
+long long script_slow_usecs = DFLT_SCRIPT_SLOW_USECS;
+
+// "kind key" -> SCRIPT_STAT
+HASHTABLE     *script_stats = NULL;
+
+// the ring of slow runs. slow_next is where the next one goes
+SLOW_RUN slow_runs[SCRIPT_SLOW_RUNS];
+int             slow_next = 0;
+int            slow_count = 0;
+
+SCRIPT_STAT *newScriptStat(const char *kind, const char *key) {
+  SCRIPT_STAT *stat = calloc(1, sizeof(SCRIPT_STAT));
+  stat->kind        = strdupsafe(kind);
+  stat->key         = strdupsafe(key);
+  stat->last_owner  = strdup("");
+  return stat;
+}
+
+//
+// sort script stats by how much time they've taken, most first
+int script_stat_cmp(SCRIPT_STAT *a, SCRIPT_STAT *b) {
+  return (a->total < b->total ? 1 : (a->total > b->total ? -1 : 0));
+}
+
+//
+// display what the profiler has seen, or change how it works
+//   usage: scriptstat [on | off | reset | slow <usecs>]
+COMMAND(cmd_scriptstat) {
+  char    sub[SMALL_BUFFER];
+  const char *rest = one_arg(arg, sub);
+  if(!strcasecmp(sub, "on") || !strcasecmp(sub, "off")) {
+    scriptProfSetOn(!strcasecmp(sub, "on"));
+    send_to_char(ch, "Script profiling is now %s.\r\n", sub);
+    return;
+  }
+  else if(!strcasecmp(sub, "reset")) {
+    scriptProfReset();
+    send_to_char(ch, "Script statistics reset.\r\n");
+    return;
+  }
+  else if(!strcasecmp(sub, "slow") && isdigit(*rest)) {
+    scriptProfSetSlowUsecs(atoll(rest));
+    send_to_char(ch, "Script runs of %lld usec or more are now slow.\r\n",
+		 scriptProfGetSlowUsecs());
+    return;
+  }
+  else if(*sub) {
+    send_to_char(ch, "Usage: scriptstat [on | off | reset | slow <usecs>]\r\n");
+    return;
+  }
+
+  BUFFER      *buf = newBuffer(MAX_BUFFER);
+  LIST      *stats = scriptProfGetStats();
+  LIST_ITERATOR *stat_i = newListIterator(stats);
+  SCRIPT_STAT *stat = NULL;
+  int        count = 0, i;
+  const char *kind = NULL, *key = NULL, *owner = NULL;
+  long long  usecs = 0;
+  time_t      when = 0;
+
+  bprintf(buf, "Script profiling is %s. Runs of %lld usec or more are slow."
+	  "\r\n\r\n", (script_prof_on ? "on" : "off"), script_slow_usecs);
+  bprintf(buf, "{c%-7s %-32s %8s %12s %9s %9s{n\r\n",
+	  "Kind", "Key", "Calls", "Total usec", "Avg usec", "Max usec");
+  ITERATE_LIST(stat, stat_i) {
+    if(count++ >= 30)
+      break;
+    bprintf(buf, "%-7.7s %-32.32s %8lld %12lld %9lld %9lld\r\n",
+	    stat->kind, stat->key, stat->calls, stat->total,
+	    (stat->calls > 0 ? stat->total / stat->calls : 0), stat->max);
+  } deleteListIterator(stat_i);
+  deleteListWith(stats, deleteScriptStat);
+
+  bprintf(buf, "\r\n{c%-8s %-7s %-28s %-21s %9s{n\r\n",
+	  "When", "Kind", "Key", "Run for", "usec");
+  for(i = 0; scriptProfGetSlowRun(i, &kind, &key, &owner, &usecs, &when);i++){
+    char tbuf[SMALL_BUFFER];
+    strftime(tbuf, sizeof(tbuf), "%H:%M:%S", localtime(&when));
+    bprintf(buf, "%-8s %-7.7s %-28.28s %-21.21s %9lld\r\n",
+	    tbuf, kind, key, owner, usecs);
+  }
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
+}
+
+
+
+//*****************************************************************************
+// implementation of script_prof.h
+//*****************************************************************************
+void init_script_prof(void) {
+  script_stats = newHashtable();
+  memset(slow_runs, 0, sizeof(slow_runs));
+  add_cmd("scriptstat", NULL, cmd_scriptstat, "admin", FALSE);
+}
+
+void scriptProfSetOn(bool on) {
+  script_prof_on = on;
+}
+
+bool scriptProfIsOn(void) {
+  return script_prof_on;
+}
+
+void scriptProfSetSlowUsecs(long long usecs) {
+  script_slow_usecs = MAX(0, usecs);
+}
+
+long long scriptProfGetSlowUsecs(void) {
+  return script_slow_usecs;
+}
+
+void scriptProfRecord(const char *kind, const char *key, const char *owner,
+		      long long usecs) {
+  char   skey[MAX_BUFFER];
+  snprintf(skey, sizeof(skey), "%s %s", kind, key);
+  SCRIPT_STAT *stat = hashGet(script_stats, skey);
+  if(stat == NULL) {
+    stat = newScriptStat(kind, key);
+    hashPut(script_stats, skey, stat);
+  }
+  if(usecs < 0)
+    usecs = 0;
+  stat->calls++;
+  stat->total += usecs;
+  if(usecs > stat->max)
+    stat->max = usecs;
+  if(strcmp(stat->last_owner, owner ? owner : "")) {
+    free(stat->last_owner);
+    stat->last_owner = strdupsafe(owner);
+  }
+
+  if(usecs >= script_slow_usecs) {
+    SLOW_RUN *run = &slow_runs[slow_next];
+    if(run->kind)  free(run->kind);
+    if(run->key)   free(run->key);
+    if(run->owner) free(run->owner);
+    run->kind  = strdupsafe(kind);
+    run->key   = strdupsafe(key);
+    run->owner = strdupsafe(owner);
+    run->usecs = usecs;
+    run->when  = current_time;
+    slow_next  = (slow_next + 1) % SCRIPT_SLOW_RUNS;
+    slow_count = MIN(slow_count + 1, SCRIPT_SLOW_RUNS);
+  }
+}
+
+void scriptProfReset(void) {
+  hashClearWith(script_stats, deleteScriptStat);
+
+  int i;
+  for(i = 0; i < SCRIPT_SLOW_RUNS; i++) {
+    if(slow_runs[i].kind)  free(slow_runs[i].kind);
+    if(slow_runs[i].key)   free(slow_runs[i].key);
+    if(slow_runs[i].owner) free(slow_runs[i].owner);
+  }
+  memset(slow_runs, 0, sizeof(slow_runs));
+  slow_next  = 0;
+  slow_count = 0;
+}
+
+LIST *scriptProfGetStats(void) {
+  LIST           *stats = newList();
+  HASH_ITERATOR *stat_i = newHashIterator(script_stats);
+  const char       *key = NULL;
+  SCRIPT_STAT     *stat = NULL;
+  ITERATE_HASH(key, stat, stat_i) {
+    SCRIPT_STAT *copy = newScriptStat(stat->kind, stat->key);
+    free(copy->last_owner);
+    copy->last_owner  = strdup(stat->last_owner);
+    copy->calls       = stat->calls;
+    copy->total       = stat->total;
+    copy->max         = stat->max;
+    listPut(stats, copy);
+  } deleteHashIterator(stat_i);
+  listSortWith(stats, script_stat_cmp);
+  return stats;
+}
+
+void deleteScriptStat(SCRIPT_STAT *stat) {
+  if(stat->kind)       free(stat->kind);
+  if(stat->key)        free(stat->key);
+  if(stat->last_owner) free(stat->last_owner);
+  free(stat);
+}
+
+bool scriptProfGetSlowRun(int num, const char **kind, const char **key,
+			  const char **owner, long long *usecs, time_t *when) {
+  if(num < 0 || num >= slow_count)
+    return FALSE;
+  SLOW_RUN *run = &slow_runs[(slow_next - 1 - num + SCRIPT_SLOW_RUNS) %
+			     SCRIPT_SLOW_RUNS];
+  *kind  = run->kind;
+  *key   = run->key;
+  *owner = run->owner;
+  *usecs = run->usecs;
+  *when  = run->when;
+  return TRUE;
+}
@@ -0,0 +1,68 @@
+#ifndef __SCRIPT_PROF_H
+#define __SCRIPT_PROF_H
+//*****************************************************************************
+//
+// script_prof.h
+//
+// an opt-in profiler for the scripts we run: triggers, and the scripts of
+// prototypes as things are spawned from them. While profiling is on, every
+// run is timed and added to the totals for its key, and runs that take longer
+// than our slow threshold are remembered, along with who they were run for,
+// in a ring of the most recent ones. Admins can view these with the
+// scriptstat command, and scripts with mudsys.script_stats().
+//
+//*****************************************************************************
+
+// how many of the most recent slow runs we remember
+#define SCRIPT_SLOW_RUNS          50
+
+// how long a run has to take, in microseconds, to be slow, if not set
+#define DFLT_SCRIPT_SLOW_USECS 10000
+
+//
+// set up the profiler, and its admin command
+void init_script_prof(void);
+
+//
+// turn profiling on or off, and see if it is on. Runs only need timing if
+// it is
+void scriptProfSetOn(bool on);
+bool scriptProfIsOn (void);
+
+//
+// how long a run has to take to be remembered as slow, in microseconds
+void      scriptProfSetSlowUsecs(long long usecs);
+long long scriptProfGetSlowUsecs(void);
+
+//
+// note that a script of some kind ("trigger", "proto") with the given key took
+// usecs to run. owner describes what it was run for
+void scriptProfRecord(const char *kind, const char *key, const char *owner,
+		      long long usecs);
+
+//
+// forget everything we've recorded so far
+void scriptProfReset(void);
+
+//
+// our totals, most time taken first, as a list of the stats below. The list
+// and its stats must be deleted with deleteListWith(list, deleteScriptStat)
+typedef struct {
+  char       *kind;
+  char        *key;
+  char *last_owner; // who we were last run for
+  long long  calls;
+  long long  total;
+  long long    max;
+} SCRIPT_STAT;
+
+LIST *scriptProfGetStats(void);
+void    deleteScriptStat(SCRIPT_STAT *stat);
+
+//
+// the slow runs we remember, most recent first. num is from 0 to
+// SCRIPT_SLOW_RUNS - 1. Returns FALSE if there is no slow run that old
+bool scriptProfGetSlowRun(int num, const char **kind, const char **key,
+			  const char **owner, long long *usecs, time_t *when);
+
+#endif // __SCRIPT_PROF_H
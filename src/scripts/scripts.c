@@ -24,6 +24,8 @@
 #include "../storage.h"
 #include "../handler.h"
 #include "../hooks.h"
+#include "../intern.h"
+#include "../metrics.h"
 
 #include "scripts.h"
 #include "pyplugs.h"
@@ -40,8 +42,16 @@
 #include "pystorage.h"
 #include "pyauxiliary.h"
 #include "pyworld.h"
+#include "pylistview.h"
 #include "trighooks.h"
+#include "script_prof.h"
+#include "script_budget.h"
+#include "sampler.h"
+#include "script_heap.h"
+#include "script_gc.h"
+#include "code_cache.h"
 #include "pyolc.h"
+#include "pycoro.h"
 
 // online editor stuff
 #include "../editor/editor.h"
@@ -86,17 +96,142 @@ ModuleInfo modules[] = {
 typedef struct {
   LIST   *triggers;
   PyObject *pyform;
+
+  // the type of each of our triggers, so that an event can find the triggers
+  // it runs without looking all of them up in the world. index_keys is what
+  // our triggers list held when the index was built; if it no longer matches,
+  // or a trigger has changed since (see triggerGetGeneration), it is built
+  // again. Keys and types are interned, and types are NULL for triggers that
+  // don't exist
+  int            index_size; // -1 if we haven't built our index
+  int      index_generation;
+  const char   **index_keys;
+  const char  **index_types;
+
+  // for chars, whether we or anything we carry have pre_command triggers. For
+  // rooms, whether we or anything in us do. Remembered until something comes
+  // or goes, or triggers change (see trigger_list_generation)
+  bool     pc_present;
+  int      pc_generation;     // -1 if we need to look again
+  int      pc_list_generation;
 } TRIGGER_AUX_DATA;
 
+// goes up whenever anyone's trigger list is added to or removed from
+int trigger_list_generation = 0;
+
+// the auxiliary slot our trigger data is kept in
+int trigger_slot = -1;
+
+void trigger_index_clear(TRIGGER_AUX_DATA *data) {
+  int i;
+  for(i = 0; i < data->index_size; i++) {
+    strRelease(data->index_keys[i]);
+    strRelease(data->index_types[i]);
+  }
+  if(data->index_keys)  free(data->index_keys);
+  if(data->index_types) free(data->index_types);
+  data->index_keys  = NULL;
+  data->index_types = NULL;
+  data->index_size  = -1;
+}
+
+//
+// is our index still true to our trigger list and the triggers in it?
+bool trigger_index_ok(TRIGGER_AUX_DATA *data) {
+  if(data->index_size != listSize(data->triggers) ||
+     data->index_generation != triggerGetGeneration())
+    return FALSE;
+  LOCAL_LIST_ITERATOR(trig_i, data->triggers);
+  const char *key = NULL;
+  int           i = 0;
+  ITERATE_LIST(key, trig_i) {
+    if(key != data->index_keys[i++])
+      break;
+  } listIteratorFinish(trig_i);
+  return (key == NULL);
+}
+
+void trigger_index_build(TRIGGER_AUX_DATA *data) {
+  int          size = listSize(data->triggers);
+  int             i = 0;
+  const char   *key = NULL;
+  TRIGGER_DATA *trig = NULL;
+
+  trigger_index_clear(data);
+  data->index_keys  = malloc(sizeof(char *) * MAX(1, size));
+  data->index_types = malloc(sizeof(char *) * MAX(1, size));
+  // looking triggers up can load them, so get our generation afterwards
+  LOCAL_LIST_ITERATOR(trig_i, data->triggers);
+  ITERATE_LIST(key, trig_i) {
+    trig = worldGetType(gameworld, "trigger", key);
+    data->index_keys[i]  = strInternRef(key);
+    data->index_types[i] = (trig ? strIntern(triggerGetType(trig)) : NULL);
+    i++;
+  } listIteratorFinish(trig_i);
+  data->index_size       = i;
+  data->index_generation = triggerGetGeneration();
+}
+
+//
+// the keys of our triggers of the given type
+//
+// build our index if we need to, and find the interned form of type. NULL if
+// none of our triggers can be of it
+const char *trigger_aux_find_type(TRIGGER_AUX_DATA *data, const char *type) {
+  if(listSize(data->triggers) == 0)
+    return NULL;
+  if(!trigger_index_ok(data))
+    trigger_index_build(data);
+
+  // our index holds onto our types, so if this type isn't interned, none of
+  // our triggers can be of it
+  return strInternFind(type);
+}
+
+bool trigger_aux_has_type(TRIGGER_AUX_DATA *data, const char *type) {
+  const char *itype = trigger_aux_find_type(data, type);
+  int i;
+  if(itype != NULL)
+    for(i = 0; i < data->index_size; i++)
+      if(data->index_types[i] == itype)
+	return TRUE;
+  return FALSE;
+}
+
+LIST *trigger_aux_get_type(TRIGGER_AUX_DATA *data, const char *type) {
+  const char *itype = trigger_aux_find_type(data, type);
+  if(itype == NULL)
+    return NULL;
+
+  LIST *keys = NULL;
+  int      i;
+  for(i = 0; i < data->index_size; i++) {
+    if(data->index_types[i] == itype) {
+      if(keys == NULL)
+	keys = newList();
+      listQueue(keys, (char *)strInternRef(data->index_keys[i]));
+    }
+  }
+  return keys;
+}
+
 TRIGGER_AUX_DATA *newTriggerAuxData(void) {
   TRIGGER_AUX_DATA *data = malloc(sizeof(TRIGGER_AUX_DATA));
   data->triggers         = newList();
   data->pyform           = NULL;
+  data->index_size       = -1;
+  data->index_generation = 0;
+  data->index_keys       = NULL;
+  data->index_types      = NULL;
+  data->pc_present       = FALSE;
+  data->pc_generation    = -1;
+  data->pc_list_generation = 0;
   return data;
 }
 
 void deleteTriggerAuxData(TRIGGER_AUX_DATA *data) {
-  deleteListWith(data->triggers, free);
+  trigger_index_clear(data);
+  deleteListWith(data->triggers, strRelease);
   if(data->pyform && data->pyform->ob_refcnt > 1)
     log_string("LEAK: Memory leak (%d refcnt) on someone or something's pyform",
 	       (int)data->pyform->ob_refcnt);
@@ -105,8 +240,10 @@ void deleteTriggerAuxData(TRIGGER_AUX_DATA *data) {
 }
 
 void triggerAuxDataCopyTo(TRIGGER_AUX_DATA *from, TRIGGER_AUX_DATA *to) {
-  deleteListWith(to->triggers, free);
-  to->triggers = listCopyWith(from->triggers, strdup);
+  trigger_index_clear(to);
+  deleteListWith(to->triggers, strRelease);
+  to->triggers = listCopyWith(from->triggers, strInternRef);
+  trigger_list_generation++;
 }
 
 TRIGGER_AUX_DATA *triggerAuxDataCopy(TRIGGER_AUX_DATA *data) {
@@ -115,14 +252,14 @@ TRIGGER_AUX_DATA *triggerAuxDataCopy(TRIGGER_AUX_DATA *data) {
   return newdata;
 }
 
-char *read_one_trigger(STORAGE_SET *set) {
-  return strdup(read_string(set, "trigger"));
+const char *read_one_trigger(STORAGE_SET *set) {
+  return strIntern(read_string(set, "trigger"));
 }
 
 TRIGGER_AUX_DATA *triggerAuxDataRead(STORAGE_SET *set) {
-  TRIGGER_AUX_DATA *data = malloc(sizeof(TRIGGER_AUX_DATA));
+  TRIGGER_AUX_DATA *data = newTriggerAuxData();
+  deleteList(data->triggers);
   data->triggers = gen_read_list(read_list(set, "triggers"), read_one_trigger);
-  data->pyform   = NULL;
   return data;
 }
 
@@ -167,7 +304,7 @@ void expand_char_dynamic_descs(const char *info) {
   // if we're an NPC, do some special work for displaying us. We don't do 
   // dynamic descs for PCs because they will probably be describing themselves,
   // and we don't want to give them access to the scripting language.
-  if(charIsNPC(me)) {
+  if(charIsNPC(me) && strchr(bufferString(charGetLookBuffer(ch)), '[')) {
     PyObject *pyme = charGetPyForm(me);
     char   *locale = strdup(get_key_locale(charGetClass(me))); 
     expand_dynamic_descs(charGetLookBuffer(ch), pyme, ch, locale);
@@ -181,6 +318,10 @@ void  expand_obj_dynamic_descs(const char *info) {
   CHAR_DATA *ch = NULL;
   hookParseInfo(info, &me, &ch);
 
+  // nothing dynamic? Don't bother making the things we'd expand it with
+  if(!strchr(bufferString(charGetLookBuffer(ch)), '['))
+    return;
+
   PyObject *pyme = objGetPyForm(me);
   char   *locale = strdup(get_key_locale(objGetClass(me))); 
   expand_dynamic_descs(charGetLookBuffer(ch), pyme, ch, locale);
@@ -193,6 +334,10 @@ void expand_room_dynamic_descs(const char *info) {
   CHAR_DATA *ch = NULL;
   hookParseInfo(info, &me, &ch);
 
+  // nothing dynamic? Don't bother making the things we'd expand it with
+  if(!strchr(bufferString(charGetLookBuffer(ch)), '['))
+    return;
+
   PyObject *pyme = roomGetPyForm(me);
   char   *locale = strdup(get_key_locale(roomGetClass(me))); 
   expand_dynamic_descs(charGetLookBuffer(ch), pyme, ch, locale);
@@ -213,6 +358,7 @@ void expand_exit_dynamic_descs(const char *info) {
 }
 
 void finalize_scripts(void) {
+  forget_script_dicts();
   Py_Finalize();
 }
 
@@ -273,6 +419,7 @@ COMMAND(cmd_attach) {
     if(found_type == PARSE_CHAR) {
       send_to_char(ch, "Trigger %s attached to %s.\r\n", key, charGetName(tgt));
       triggerListAdd(charGetTriggers(tgt), triggerGetKey(trig));
+      heartbeat_trighooks_update(tgt, TRIGVAR_CHAR);
     }
     else if(found_type == PARSE_ROOM) {
       send_to_char(ch, "Trigger %s attached to %s.\r\n", key, roomGetName(tgt));
@@ -281,6 +428,7 @@ COMMAND(cmd_attach) {
     else {
       send_to_char(ch, "Trigger %s attached to %s.\r\n", key, objGetName(tgt));
       triggerListAdd(objGetTriggers(tgt), triggerGetKey(trig));
+      heartbeat_trighooks_update(tgt, TRIGVAR_OBJ);
     }
   }  
 }
@@ -310,6 +458,7 @@ COMMAND(cmd_detach) {
       send_to_char(ch, "Trigger %s detached from %s.\r\n", key,
 		   charGetName(tgt));
       triggerListRemove(charGetTriggers(tgt), triggerGetKey(trig));
+      heartbeat_trighooks_update(tgt, TRIGVAR_CHAR);
     }
     else if(found_type == PARSE_ROOM) {
       send_to_char(ch, "Trigger %s detached from %s.\r\n", key,
@@ -320,6 +469,7 @@ COMMAND(cmd_detach) {
       send_to_char(ch, "Trigger %s detached to %s.\r\n", key,
 		   objGetName(tgt));
       triggerListRemove(objGetTriggers(tgt), triggerGetKey(trig));
+      heartbeat_trighooks_update(tgt, TRIGVAR_OBJ);
     }
   }
 }
@@ -424,6 +574,62 @@ void printPythonPath() {
     }
 }
 */
+//
+// write out Python's side of the metrics: how many errors scripts have
+// logged, and how the garbage collector has been doing in each generation
+void script_metrics(BUFFER *buf) {
+  PyObject *gc = PyImport_ImportModule("gc");
+  PyObject *stats = NULL, *counts = NULL;
+  int i;
+
+  metricsDeclare(buf, "nakedmud_python_errors_total", "counter",
+		 "Python errors logged by scripts.");
+  metricsValue(buf, "nakedmud_python_errors_total", NULL, count_pyerrs());
+  if(gc == NULL) {
+    PyErr_Clear();
+    return;
+  }
+
+  stats  = PyObject_CallMethod(gc, "get_stats", NULL);
+  counts = PyObject_CallMethod(gc, "get_count", NULL);
+  if(stats != NULL && PyList_Check(stats)) {
+    const char *fields[] = { "collections", "collected", "uncollectable", NULL};
+    int field;
+    for(field = 0; fields[field] != NULL; field++) {
+      char name[SMALL_BUFFER], help[SMALL_BUFFER];
+      snprintf(name, sizeof(name), "nakedmud_python_gc_%s_total",
+	       fields[field]);
+      snprintf(help, sizeof(help), "Python garbage collector %s, by "
+	       "generation.", fields[field]);
+      metricsDeclare(buf, name, "counter", help);
+      for(i = 0; i < PyList_Size(stats); i++) {
+	PyObject *val = PyDict_GetItemString(PyList_GetItem(stats, i),
+					     fields[field]);
+	char labels[SMALL_BUFFER];
+	snprintf(labels, sizeof(labels), "generation=\"%d\"", i);
+	if(val != NULL && PyLong_Check(val))
+	  metricsValue(buf, name, labels, PyLong_AsLongLong(val));
+      }
+    }
+  }
+  if(counts != NULL && PyTuple_Check(counts)) {
+    metricsDeclare(buf, "nakedmud_python_gc_objects", "gauge",
+		   "Objects tracked by the Python garbage collector, waiting "
+		   "on each generation's next collection.");
+    for(i = 0; i < PyTuple_Size(counts); i++) {
+      char labels[SMALL_BUFFER];
+      snprintf(labels, sizeof(labels), "generation=\"%d\"", i);
+      metricsValue(buf, "nakedmud_python_gc_objects", labels,
+		   PyLong_AsLongLong(PyTuple_GetItem(counts, i)));
+    }
+  }
+  if(PyErr_Occurred())
+    PyErr_Clear();
+  Py_XDECREF(stats);
+  Py_XDECREF(counts);
+  Py_DECREF(gc);
+}
+
 //*****************************************************************************
 // implementation of scripts.h - triggers portion in triggers.c
 //*****************************************************************************/
@@ -440,6 +646,12 @@ void init_scripts(void) {
 
   Py_Initialize();
 
+  // Python's random numbers come from the same seed ours did, so a replayed
+  // recording (see replay.h) rolls the same dice it did the first time
+  char seed[SMALL_BUFFER];
+  snprintf(seed, sizeof(seed), "import random\nrandom.seed(%d)\n", rand());
+  PyRun_SimpleString(seed);
+
   for (ModuleInfo* mod = modules; mod->name != NULL; mod++) {
       PyObject* pmodule = PyImport_ImportModule(mod->name);
       if (!pmodule) {
@@ -451,12 +663,24 @@ void init_scripts(void) {
   // initialize all of our modules written in C
   PyObject *module = NULL;
 
+  // the lists scripts get from chars, objs, and rooms
+  init_pylistview();
+
+  // compiled code from before we were rebooted, and somewhere to put more
+  init_code_cache();
+
   // initialize all of our modules written in Python
   init_pyplugs();
 
   // initialize the other parts to this module
   init_script_editor();
   init_trighooks();
+  init_script_prof();
+  init_script_budget();
+  init_sampler();
+  init_script_heap();
+  init_script_gc();
+  metricsAddSource(script_metrics);
 
   // so triggers can be saved to/loaded from disk
   worldAddType(gameworld, "trigger", triggerRead, triggerStore, deleteTrigger,
@@ -470,6 +694,7 @@ void init_scripts(void) {
 				       newTriggerAuxData,  deleteTriggerAuxData,
 				       triggerAuxDataCopyTo, triggerAuxDataCopy,
 				       triggerAuxDataStore,triggerAuxDataRead));
+  trigger_slot = auxiliariesGetSlot("trigger_data");
 
   // add in some hooks for preprocessing scripts embedded in descs
   hookAdd("preprocess_room_desc", expand_room_dynamic_descs);
@@ -492,12 +717,21 @@ void init_scripts(void) {
   add_cmd("trename", NULL, cmd_trename,"scripter", FALSE);
 }
 
+//
+// the namespaces every script starts out with, built the first time they are
+// wanted. Importing and merging our modules for every trigger that is run is
+// far more work than the trigger itself, so a script instead gets a copy of
+// one of these. They are built again after a module is reloaded
+PyObject   *restricted_base = NULL;
+PyObject *unrestricted_base = NULL;
+
 //
 // makes a dictionary with all of the neccessary stuff in it, but without
-// a builtins module set
-PyObject *mud_script_dict(void) {
+// a builtins module set. ok is set to FALSE if something couldn't be added
+PyObject *mud_script_dict(bool *ok) {
     PyObject* dict = PyDict_New();
     if (!dict) return NULL;
+    *ok = TRUE;
 
     // Add exit() function from sys
     PyObject *sys = PyImport_ImportModule("sys");
@@ -512,6 +746,7 @@ PyObject *mud_script_dict(void) {
         log_string("mud_script_dict: failed to import 'sys'");
         PyErr_Print();
         PyErr_Clear();
+        *ok = FALSE;
     }
 
     // Helper macro to safely merge modules
@@ -520,6 +755,7 @@ PyObject *mud_script_dict(void) {
         if (!mod) { \
             log_string("mud_script_dict: failed to import module '%s'", name); \
             if (PyErr_Occurred()) { PyErr_Print(); PyErr_Clear(); } \
+            *ok = FALSE; \
             break; \
         } \
         PyObject *mod_dict = PyModule_GetDict(mod); \
@@ -543,6 +779,7 @@ PyObject *mud_script_dict(void) {
         log_string("mud_script_dict: failed to import 'random'");
         PyErr_Print();
         PyErr_Clear();
+        *ok = FALSE;
     }
 
     #undef SAFE_MERGE_MODULE
@@ -550,55 +787,91 @@ PyObject *mud_script_dict(void) {
     return dict;
 }
 
-PyObject *restricted_script_dict(void) {
-  // build up our basic dictionary
-  PyObject *dict = mud_script_dict();
-  
-  // add restricted builtin modules
-  PyObject *builtins = PyImport_ImportModule("__restricted_builtin__");
-  if(builtins != NULL) {
-    PyDict_SetItemString(dict, "__builtins__", builtins);
-    Py_DECREF(builtins);
+//
+// copy one of our base namespaces, building it first if we need to. A base
+// that could not be built completely is not kept, so that it is tried again
+PyObject *script_dict_from(PyObject **base, const char *builtins_name) {
+  if(*base == NULL) {
+    bool       ok = TRUE;
+    PyObject *dict = mud_script_dict(&ok);
+    if(dict == NULL)
+      return NULL;
+
+    PyObject *builtins = PyImport_ImportModule(builtins_name);
+    if(builtins != NULL) {
+      PyDict_SetItemString(dict, "__builtins__", builtins);
+      Py_DECREF(builtins);
+    }
+    else {
+      PyErr_Clear();
+      ok = FALSE;
+    }
+
+    if(!ok)
+      return dict;
+    *base = dict;
   }
+  return PyDict_Copy(*base);
+}
 
-  return dict;
+PyObject *restricted_script_dict(void) {
+  return script_dict_from(&restricted_base, "__restricted_builtin__");
 }
 
 PyObject *unrestricted_script_dict(void) {
-  PyObject *dict = mud_script_dict();
-
-  // add builtins
-  PyObject *builtins = PyImport_ImportModule("builtins");
-  if(builtins != NULL) {
-    PyDict_SetItemString(dict, "__builtins__", builtins);
-    Py_DECREF(builtins);
-  }
+  return script_dict_from(&unrestricted_base, "builtins");
+}
 
-  return dict;
+void forget_script_dicts(void) {
+  Py_XDECREF(restricted_base);
+  Py_XDECREF(unrestricted_base);
+  restricted_base   = NULL;
+  unrestricted_base = NULL;
 }
 
 void run_code(PyObject *code, PyObject *dict, const char *locale) {
-  if(script_loop_depth >= MAX_LOOP_DEPTH) {
-    // should we flag some sort of error, here?
-    //***********
-    // FINISH ME
-    //***********/
+  run_code_as(code, dict, locale, NULL, locale);
+}
 
+void run_code_as(PyObject *code, PyObject *dict, const char *locale,
+		 const char *type, const char *what) {
+  if(script_loop_depth >= MAX_LOOP_DEPTH) {
+    log_string("Script %s not run: scripts are already nested %d deep.",
+	       (what ? what : "<unknown>"), script_loop_depth);
     script_ok = FALSE;
   }
   else {
     listPush(locale_stack, strdupsafe(locale));
 
+    // only the outermost script gets a budget. Anything it runs in turn
+    // happens on its time
+    if(script_loop_depth == 0)
+      scriptBudgetStart(type, what);
+
     // try executing the code
     script_ok = TRUE;
     script_loop_depth++;
+    samplerEnter((type ? "trigger" : "script"), (what ? what : locale));
     PyObject *retval = PyEval_EvalCode(code, dict, dict);
+    samplerLeave();
     script_loop_depth--;
 
+    if(script_loop_depth == 0)
+      scriptBudgetEnd();
+
     // did we throw an error?
     if(retval == NULL && PyErr_Occurred() != PyExc_SystemExit)
       script_ok = FALSE;
 
+    // code that awaits at its top level comes back as a coroutine. It
+    // belongs to whoever the script is on
+    if(retval != NULL && PyCoro_CheckExact(retval) &&
+       !pyCoroStart(retval, PyDict_GetItemString(dict, "me"), locale)) {
+      log_pyerr("Script %s could not start its coroutine",
+		(what ? what : "<unknown>"));
+      script_ok = FALSE;
+    }
+
     // garbage collection
     free(listPop(locale_stack));
     Py_XDECREF(retval);
@@ -608,7 +881,7 @@ void run_code(PyObject *code, PyObject *dict, const char *locale) {
 PyObject *run_script_forcode(PyObject *dict, const char *script, 
 			     const char *locale) {
   // try compiling the code
-  PyObject *retval = Py_CompileString(script, "<string>", Py_file_input);
+  PyObject *retval = cachedCompileString(script, "<string>", Py_file_input);
 
   // try running the code
   if(retval != NULL)
@@ -642,187 +915,337 @@ PyObject *eval_script(PyObject *dict, const char *statement,const char *locale){
 }
 
 //
-// Tries to expand out a conditional statement. Returns whatever is expanded.
-// Moves i to the proper place after the conditional has been expanded in the
-// originating buffer.
-BUFFER *expand_dynamic_conditional(BUFFER *desc,     PyObject *dict, 
-				   PyObject *retval, const char *locale,
-				   int *pos) {
-  BUFFER *new_desc = newBuffer(bufferLength(desc)*2);
-  BUFFER     *code = newBuffer(1); // code we have to evaluate
-  int         j, i = *pos + 1;     // +1 to skip the current closing ]
-  bool       match = PyObject_IsTrue(retval);
+// Dynamic descriptions are compiled into templates the first time they are
+// seen: the text between our embedded [code] blocks, and the code itself
+// already compiled. Templates are remembered by the text they came from, so
+// expanding the same description again only has to run the code. Conditional
+// blocks are [if code]...[elif code]...[else]...[/if]; the text of the branch
+// that matches is expanded in turn, as a template of its own
+#define DESC_TEXT          0  // text that is copied over as it is
+#define DESC_EXPR          1  // code whose value is printed
+#define DESC_COND          2  // a conditional block
+
+// how many templates are remembered before we start over
+#define MAX_DESC_TEMPLATES 2048
+
+typedef struct desc_branch {
+  bool          is_else;
+  const char       *src; // the code we check, shared. NULL for an else
+  PyObject        *code; // NULL if it couldn't be compiled
+  const char      *body; // what's expanded if we match, shared
+} DESC_BRANCH;
+
+typedef struct desc_piece {
+  int              type;
+  char            *text; // our text, or the code for an expression
+  PyObject        *code;
+  int      num_branches;
+  DESC_BRANCH *branches;
+} DESC_PIECE;
+
+typedef struct desc_template {
+  const char      *text; // what we were compiled from, shared
+  int        num_pieces;
+  DESC_PIECE    *pieces;
+} DESC_TEMPLATE;
+
+// shared text -> the template compiled from it
+MAP *desc_templates = NULL;
+
+// how deep in expanding templates are we? They can only be thrown out when
+// none are being expanded
+int desc_template_depth = 0;
+
+//
+// compile a bit of code that is to be evaluated. Errors are logged once, here
+PyObject *desc_compile(const char *src) {
+  PyObject *code = cachedCompileString(src, "<string>", Py_eval_input);
+  if(code == NULL)
+    log_pyerr("eval_script terminated with an error:\r\n%s", src);
+  return code;
+}
+
+//
+// copy the code between a [ and the ] len characters later. Newlines become
+// spaces if we are the start of a block, and go away for elifs
+char *desc_code_copy(const char *str, int len, bool elif) {
+  BUFFER *buf = newBuffer(len + 1);
+  int       i;
+  for(i = 0; i < len; i++)
+    bprintf(buf, "%c", str[i]);
+  if(elif)
+    bufferReplace(buf, "\n", "", TRUE);
+  else {
+    bufferReplace(buf, "\n", " ", TRUE);
+    bufferReplace(buf, "\r", "", TRUE);
+  }
+  char *code = strdup(bufferString(buf));
+  deleteBuffer(buf);
+  return code;
+}
+
+DESC_PIECE *desc_template_add(DESC_TEMPLATE *tmpl, int type) {
+  tmpl->pieces = realloc(tmpl->pieces,sizeof(DESC_PIECE)*(tmpl->num_pieces+1));
+  DESC_PIECE *piece   = &tmpl->pieces[tmpl->num_pieces++];
+  piece->type         = type;
+  piece->text         = NULL;
+  piece->code         = NULL;
+  piece->num_branches = 0;
+  piece->branches     = NULL;
+  return piece;
+}
+
+DESC_BRANCH *desc_piece_add_branch(DESC_PIECE *piece, const char *src) {
+  piece->branches = realloc(piece->branches,
+			    sizeof(DESC_BRANCH) * (piece->num_branches + 1));
+  DESC_BRANCH *branch = &piece->branches[piece->num_branches++];
+  branch->is_else     = (src == NULL);
+  branch->src         = (src ? strShare(src) : NULL);
+  branch->code        = (src ? desc_compile(src) : NULL);
+  branch->body        = NULL;
+  return branch;
+}
+
+//
+// compile the branches of a conditional block, whose closing ] for its first
+// condition is at str[*pos]. Moves pos to the closing ] of its [/if], or the
+// end of the string if it has none
+void desc_compile_cond(DESC_PIECE *piece, const char *str, int *pos) {
+  int            i = *pos + 1; // +1 to skip the current closing ]
+  DESC_BRANCH *branch = &piece->branches[0];
 
   while(TRUE) {
-    // copy over all of our contents for the new desc and increment i
-    while(*(bufferString(desc)+i) &&
-	  !startswith(bufferString(desc)+i, "[else]") &&
-	  !startswith(bufferString(desc)+i, "[elif ") &&
-	  !startswith(bufferString(desc)+i, "[/if]")) {
-      if(match == TRUE)
-	bprintf(new_desc, "%c", *(bufferString(desc) + i));
+    // everything up until our next marker is the branch's body
+    int start = i;
+    while(str[i] && !startswith(str+i, "[else]") &&
+	  !startswith(str+i, "[elif ") && !startswith(str+i, "[/if]"))
       i++;
-    }
+    char *body   = strndup(str + start, i - start);
+    branch->body = strShare(body);
+    free(body);
 
     // did we terminate?
-    if(match == TRUE || startswith(bufferString(desc)+i, "[/if]"))
+    if(!str[i] || startswith(str+i, "[/if]"))
       break;
-    // we haven't had a match yet. Are we trying an else or elif?
-    else if(startswith(bufferString(desc)+i, "[else]")) {
-      match  = TRUE;
+    else if(startswith(str+i, "[else]")) {
+      branch = desc_piece_add_branch(piece, NULL);
       i     += 6;
     }
-    else if(startswith(bufferString(desc)+i, "[elif ")) {
+    else {
       // skip the elif and spaces
       i += 6;
-      while(isspace(*(bufferString(desc)+i)))
+      while(isspace(str[i]))
 	i++;
 
-      // find our end
-      int end = next_letter_in(bufferString(desc) + i, ']');
-
-      // make sure we have it
+      // find our end, and make sure we have it
+      int end = next_letter_in(str + i, ']');
       if(end == -1)
 	break;
 
-      // copy everything between start and end, and format the code
-      bufferClear(code);
-      for(j = 0; j < end; j++)
-	bprintf(code, "%c", *(bufferString(desc) + i + j));
-      bufferReplace(code, "\n", "", TRUE);
-
-      // skip i up to and beyond the ] marker
+      char *code = desc_code_copy(str + i, end, TRUE);
+      branch     = desc_piece_add_branch(piece, code);
+      free(code);
       i = i + end + 1;
-      
-      // evaluate the code
-      PyObject *retval = eval_script(dict, bufferString(code), locale);
-      match            = retval && PyObject_IsTrue(retval);
-
-      // did we encounter an error?
-      if(retval == NULL)
-	break;
     }
   }
 
   // skip everything up to our closing [/if]
-  while(*(bufferString(desc)+i) && !startswith(bufferString(desc)+i, "[/if]"))
+  while(str[i] && !startswith(str+i, "[/if]"))
     i++;
-  if(startswith(bufferString(desc)+i, "[/if]"))
+  if(startswith(str+i, "[/if]"))
     i += 4; // put us at the closing ], not the end of the ending if block
-
-  // garbage collection
-  deleteBuffer(code);
- 
-  // return our expansion and move our i
   *pos = i;
-  return new_desc;
 }
 
-void expand_dynamic_descs_dict(BUFFER *desc, PyObject *dict,const char *locale){
-  // make our new buffer
-  BUFFER *new_desc = newBuffer(bufferLength(desc)*2);
-  BUFFER     *code = newBuffer(1); // for things we have to evaluate
-  bool   proc_cond = FALSE; // are we processing a conditional statement?
+DESC_TEMPLATE *desc_template_compile(const char *str) {
+  DESC_TEMPLATE *tmpl = malloc(sizeof(DESC_TEMPLATE));
+  int  start, end, i, size = strlen(str);
+  tmpl->num_pieces = 0;
+  tmpl->pieces     = NULL;
 
-  // copy over all of our description that is not dynamic text
-  int start, end, i, j, size = bufferLength(desc);
   for(i = 0; i < size; i++) {
     // figure out when our next dynamic desc is.
-    start = next_letter_in(bufferString(desc) + i, '[');
+    start = next_letter_in(str + i, '[');
 
-    // no more
+    // no more. The rest is text
     if(start == -1) {
-      // copy the rest and skip to the end of the buffer
-      bprintf(new_desc, "%s", bufferString(desc) + i);
-      i = size - 1;
+      desc_template_add(tmpl, DESC_TEXT)->text = strdup(str + i);
+      break;
     }
-    // we have another desc
-    else {
-      // copy everything up to start
-      while(start > 0) {
-	bprintf(new_desc, "%c", *(bufferString(desc) + i));
-	start--;
-	i++;
-      }
 
-      // skip the start marker
-      i++;
-
-      // find our end
-      end = next_letter_in(bufferString(desc) + i, ']');
+    // copy everything up to start
+    if(start > 0) {
+      DESC_PIECE *piece = desc_template_add(tmpl, DESC_TEXT);
+      piece->text       = strndup(str + i, start);
+    }
 
-      // make sure we have it
-      if(end == -1)
-	break;
+    // skip the start marker, and find our end. Without one, we're done
+    i += start + 1;
+    if( (end = next_letter_in(str + i, ']')) == -1)
+      break;
+    char *code = desc_code_copy(str + i, end, FALSE);
+    i = i + end;
+
+    // are we a conditional statement? Strip the leading if and whitespace
+    if(!strncasecmp(code, "if ", 3)) {
+      DESC_PIECE *piece = desc_template_add(tmpl, DESC_COND);
+      const char   *ptr = code + 3;
+      while(isspace(*ptr)) ptr++;
+      desc_piece_add_branch(piece, ptr);
+      desc_compile_cond(piece, str, &i);
+    }
+    else {
+      DESC_PIECE *piece = desc_template_add(tmpl, DESC_EXPR);
+      piece->text       = strdup(code);
+      piece->code       = desc_compile(code);
+    }
+    free(code);
+  }
+  return tmpl;
+}
 
-      // copy everything between start and end, and format the code
-      bufferClear(code);
-      for(j = 0; j < end; j++)
-	bprintf(code, "%c", *(bufferString(desc) + i + j));
-      bufferReplace(code, "\n", " ", TRUE);
-      bufferReplace(code, "\r", "", TRUE);
-
-      // skip i up to the end
-      i = i + end;
-
-      // are we trying to process a conditional statement?
-      if(!strncasecmp(bufferString(code), "if ", 3)) {
-	// strip out the leading if and whitespace
-	char *code_copy = strdup(bufferString(code));
-	char       *ptr = code_copy + 3;
-	while(isspace(*ptr)) ptr++;
-	
-	// copy over the cleaned-up code, signal we're processing a conditional
-	bufferClear(code);
-	bufferCat(code, ptr);
-	proc_cond = TRUE;
-
-	// garbage collection
-	free(code_copy);
-      }
+void deleteDescTemplate(DESC_TEMPLATE *tmpl) {
+  int i, j;
+  for(i = 0; i < tmpl->num_pieces; i++) {
+    DESC_PIECE *piece = &tmpl->pieces[i];
+    if(piece->text) free(piece->text);
+    Py_XDECREF(piece->code);
+    for(j = 0; j < piece->num_branches; j++) {
+      strRelease(piece->branches[j].src);
+      strRelease(piece->branches[j].body);
+      Py_XDECREF(piece->branches[j].code);
+    }
+    if(piece->branches) free(piece->branches);
+  }
+  if(tmpl->pieces) free(tmpl->pieces);
+  strRelease(tmpl->text);
+  free(tmpl);
+}
 
-      // evaluate the code
-      PyObject *retval = eval_script(dict, bufferString(code), locale);
+//
+// find the template for some text, compiling it if it's new to us
+DESC_TEMPLATE *desc_template_get(const char *str) {
+  const char  *text = strShare(str);
+  DESC_TEMPLATE *tmpl = mapGet(desc_templates, text);
+  if(tmpl != NULL)
+    strRelease(text);
+  else {
+    tmpl       = desc_template_compile(text);
+    tmpl->text = text;
+    mapPut(desc_templates, text, tmpl);
+  }
+  return tmpl;
+}
 
-      // did we encounter an error?
-      if(retval == NULL)
-	break;
-      // are we evaluating a conditional or no?
-      else if(proc_cond) {
-	BUFFER *cond_retval =
-	  expand_dynamic_conditional(desc, dict, retval, locale, &i);
+//
+// throw out every template we have compiled
+void desc_templates_clear(void) {
+  MAP_ITERATOR *tmpl_i = newMapIterator(desc_templates);
+  const char     *text = NULL;
+  DESC_TEMPLATE  *tmpl = NULL;
+  LIST           *dead = newList();
+  ITERATE_MAP(text, tmpl, tmpl_i)
+    listPut(dead, tmpl);
+  deleteMapIterator(tmpl_i);
+  while((tmpl = listPop(dead)) != NULL) {
+    mapRemove(desc_templates, tmpl->text);
+    deleteDescTemplate(tmpl);
+  }
+  deleteList(dead);
+}
 
-	// if we have something to print, expand its embedded python
-	if(*bufferString(cond_retval))
-	  expand_dynamic_descs_dict(cond_retval, dict, locale);
+//
+// evaluate a compiled bit of code. Returns a new reference, or NULL if there
+// was an error
+PyObject *desc_eval(PyObject *code, const char *src, PyObject *dict,
+		    const char *locale) {
+  if(code == NULL)
+    return NULL;
+  listPush(locale_stack, strdupsafe(locale));
+  PyObject *retval = PyEval_EvalCode(code, dict, dict);
+  if(retval == NULL)
+    log_pyerr("eval_script terminated with an error:\r\n%s", src);
+  free(listPop(locale_stack));
+  return retval;
+}
 
-	bufferCat(new_desc, bufferString(cond_retval));
-	deleteBuffer(cond_retval);
-	proc_cond = FALSE;
-      }
-      // append the output
+//
+// expand a template out onto the end of buf. If any of its code runs into an
+// error, nothing after it is expanded
+void desc_template_run(DESC_TEMPLATE *tmpl, BUFFER *buf, PyObject *dict,
+		       const char *locale) {
+  int i, j;
+  for(i = 0; i < tmpl->num_pieces; i++) {
+    DESC_PIECE *piece = &tmpl->pieces[i];
+    PyObject  *retval = NULL;
+
+    if(piece->type == DESC_TEXT)
+      bufferCat(buf, piece->text);
+    else if(piece->type == DESC_EXPR) {
+      if( (retval = desc_eval(piece->code, piece->text, dict, locale)) == NULL)
+	return;
       else if(PyUnicode_Check(retval))
-	bprintf(new_desc, "%s", PyUnicode_AsUTF8(retval));
+	bprintf(buf, "%s", PyUnicode_AsUTF8(retval));
       else if(PyLong_Check(retval))
-	bprintf(new_desc, "%ld", PyLong_AsLong(retval));
+	bprintf(buf, "%ld", PyLong_AsLong(retval));
       else if(PyFloat_Check(retval))
-	bprintf(new_desc, "%lf", PyFloat_AsDouble(retval));
+	bprintf(buf, "%lf", PyFloat_AsDouble(retval));
       // invalid return type...
       else if(retval != Py_None)
-	log_string("dynamic desc had invalid evaluation: %s", 
-		   bufferString(code));
+	log_string("dynamic desc had invalid evaluation: %s", piece->text);
+      Py_DECREF(retval);
+    }
+    else {
+      // an error in our first condition ends the expansion. One in a later
+      // condition only ends the conditional block
+      DESC_BRANCH *first = &piece->branches[0];
+      if( (retval = desc_eval(first->code, first->src, dict, locale)) == NULL)
+	return;
+      bool match = PyObject_IsTrue(retval);
+      Py_DECREF(retval);
+
+      for(j = 0; j < piece->num_branches; j++) {
+	DESC_BRANCH *branch = &piece->branches[j];
+	if(j > 0 && branch->is_else)
+	  match = TRUE;
+	else if(j > 0) {
+	  retval = desc_eval(branch->code, branch->src, dict, locale);
+	  if(retval == NULL)
+	    break;
+	  match = PyObject_IsTrue(retval);
+	  Py_DECREF(retval);
+	}
 
-      // oddly, freeing retval here corrupt memory. 
-      // And not freeing it doesn't cause a memory leak. So bizarre...
-      //   Py_XDECREF(retval);
+	// if we have something to print, expand its embedded python
+	if(match) {
+	  if(*branch->body)
+	    desc_template_run(desc_template_get(branch->body),buf,dict,locale);
+	  break;
+	}
+      }
     }
   }
+}
+
+void expand_dynamic_descs_dict(BUFFER *desc, PyObject *dict,const char *locale){
+  // nothing dynamic in it? Then there's nothing to expand
+  if(!strchr(bufferString(desc), '['))
+    return;
+
+  if(desc_templates == NULL)
+    desc_templates = newMap(NULL, NULL);
+  else if(desc_template_depth == 0 && mapSize(desc_templates) >=
+	  MAX_DESC_TEMPLATES)
+    desc_templates_clear();
+
+  BUFFER *new_desc = newBuffer(bufferLength(desc)*2);
+  desc_template_depth++;
+  desc_template_run(desc_template_get(bufferString(desc)),
+		    new_desc, dict, locale);
+  desc_template_depth--;
 
   // copy over our contents
   bufferCopyTo(new_desc, desc);
-
-  // garbage collection
-  deleteBuffer(code);
   deleteBuffer(new_desc);
 }
 
@@ -1021,6 +1444,14 @@ const char *get_script_locale(void) {
   return listHead(locale_stack);
 }
 
+void script_locale_push(const char *locale) {
+  listPush(locale_stack, strdupsafe(locale));
+}
+
+void script_locale_pop(void) {
+  free(listPop(locale_stack));
+}
+
 const char *get_smart_locale(CHAR_DATA *ch) {
   const char *locale = get_script_locale();
   if(locale == NULL && charGetRoom(ch) != NULL)
@@ -1037,50 +1468,128 @@ void format_script_buffer(BUFFER *script) {
 }
 
 LIST *charGetTriggers(CHAR_DATA *ch) {
-  TRIGGER_AUX_DATA *data = charGetAuxiliaryData(ch, "trigger_data");
+  TRIGGER_AUX_DATA *data = charGetAuxiliarySlot(ch, trigger_slot);
   return data->triggers;
 }
 
 LIST *objGetTriggers (OBJ_DATA  *obj) {
-  TRIGGER_AUX_DATA *data = objGetAuxiliaryData(obj, "trigger_data");
+  TRIGGER_AUX_DATA *data = objGetAuxiliarySlot(obj, trigger_slot);
   return data->triggers;
 }
 
 LIST *roomGetTriggers(ROOM_DATA *room) {
-  TRIGGER_AUX_DATA *data = roomGetAuxiliaryData(room, "trigger_data");
+  TRIGGER_AUX_DATA *data = roomGetAuxiliarySlot(room, trigger_slot);
   return data->triggers;
 }
 
+LIST *charGetTypeTriggers(CHAR_DATA *ch, const char *type) {
+  return trigger_aux_get_type(charGetAuxiliarySlot(ch, trigger_slot), type);
+}
+
+LIST *objGetTypeTriggers(OBJ_DATA *obj, const char *type) {
+  return trigger_aux_get_type(objGetAuxiliarySlot(obj, trigger_slot), type);
+}
+
+LIST *roomGetTypeTriggers(ROOM_DATA *room, const char *type) {
+  return trigger_aux_get_type(roomGetAuxiliarySlot(room, trigger_slot),type);
+}
+
+//
+// is what we remember about pre_command triggers still good?
+bool pc_presence_ok(TRIGGER_AUX_DATA *data) {
+  return (data->pc_generation == triggerGetGeneration() &&
+	  data->pc_list_generation == trigger_list_generation);
+}
+
+void pc_presence_set(TRIGGER_AUX_DATA *data, bool present) {
+  data->pc_present         = present;
+  data->pc_generation      = triggerGetGeneration();
+  data->pc_list_generation = trigger_list_generation;
+}
+
+bool charHasPreCommandTriggers(CHAR_DATA *ch) {
+  TRIGGER_AUX_DATA *data = charGetAuxiliarySlot(ch, trigger_slot);
+  if(!pc_presence_ok(data)) {
+    bool present = trigger_aux_has_type(data, "pre_command");
+    LOCAL_LIST_ITERATOR(obj_i, charGetInventory(ch));
+    OBJ_DATA *obj = NULL;
+    ITERATE_LIST(obj, obj_i) {
+      if(present)
+	break;
+      present = trigger_aux_has_type(objGetAuxiliarySlot(obj, trigger_slot),
+				     "pre_command");
+    } listIteratorFinish(obj_i);
+    pc_presence_set(data, present);
+  }
+  return data->pc_present;
+}
+
+bool roomHasPreCommandTriggers(ROOM_DATA *room) {
+  TRIGGER_AUX_DATA *data = roomGetAuxiliarySlot(room, trigger_slot);
+  if(!pc_presence_ok(data)) {
+    bool present = trigger_aux_has_type(data, "pre_command");
+    LOCAL_LIST_ITERATOR(ch_i, roomGetCharacters(room));
+    CHAR_DATA *ch = NULL;
+    ITERATE_LIST(ch, ch_i) {
+      if(present)
+	break;
+      present = trigger_aux_has_type(charGetAuxiliarySlot(ch, trigger_slot),
+				     "pre_command");
+    } listIteratorFinish(ch_i);
+
+    LOCAL_LIST_ITERATOR(obj_i, roomGetContents(room));
+    OBJ_DATA *obj = NULL;
+    ITERATE_LIST(obj, obj_i) {
+      if(present)
+	break;
+      present = trigger_aux_has_type(objGetAuxiliarySlot(obj, trigger_slot),
+				     "pre_command");
+    } listIteratorFinish(obj_i);
+    pc_presence_set(data, present);
+  }
+  return data->pc_present;
+}
+
+void charForgetPreCommandTriggers(CHAR_DATA *ch) {
+  TRIGGER_AUX_DATA *data = charGetAuxiliarySlot(ch, trigger_slot);
+  data->pc_generation    = -1;
+}
+
+void roomForgetPreCommandTriggers(ROOM_DATA *room) {
+  TRIGGER_AUX_DATA *data = roomGetAuxiliarySlot(room, trigger_slot);
+  data->pc_generation    = -1;
+}
+
 PyObject *charGetPyFormBorrowed(CHAR_DATA *ch) {
-  TRIGGER_AUX_DATA *data = charGetAuxiliaryData(ch, "trigger_data");
+  TRIGGER_AUX_DATA *data = charGetAuxiliarySlot(ch, trigger_slot);
   if(data->pyform == NULL)
     data->pyform = newPyChar(ch);
   return data->pyform;
 }
 
 PyObject *objGetPyFormBorrowed(OBJ_DATA  *obj) {
-  TRIGGER_AUX_DATA *data = objGetAuxiliaryData(obj, "trigger_data");
+  TRIGGER_AUX_DATA *data = objGetAuxiliarySlot(obj, trigger_slot);
   if(data->pyform == NULL)
     data->pyform = newPyObj(obj);
   return data->pyform;
 }
 
 PyObject *roomGetPyFormBorrowed(ROOM_DATA *room) {
-  TRIGGER_AUX_DATA *data = roomGetAuxiliaryData(room, "trigger_data");
+  TRIGGER_AUX_DATA *data = roomGetAuxiliarySlot(room, trigger_slot);
   if(data->pyform == NULL)
     data->pyform = newPyRoom(room);
   return data->pyform;
 }
 
 PyObject *accountGetPyFormBorrowed(ACCOUNT_DATA *acc) {
-  TRIGGER_AUX_DATA *data = accountGetAuxiliaryData(acc, "trigger_data");
+  TRIGGER_AUX_DATA *data = accountGetAuxiliarySlot(acc, trigger_slot);
   if(data->pyform == NULL)
     data->pyform = newPyAccount(acc);
   return data->pyform;
 }
 
 PyObject *socketGetPyFormBorrowed(SOCKET_DATA *sock) {
-  TRIGGER_AUX_DATA *data = socketGetAuxiliaryData(sock, "trigger_data");
+  TRIGGER_AUX_DATA *data = socketGetAuxiliarySlot(sock, trigger_slot);
   if(data->pyform == NULL)
     data->pyform = newPySocket(sock);
   return data->pyform;
@@ -1129,14 +1638,24 @@ PyObject *PyList_fromList(LIST *list, void *convertor) {
   return pylist;
 }
 
+//
+// trigger keys are interned, so we can look for them by pointer
 void triggerListAdd(LIST *list, const char *trigger) {
-  if(!listGetWith(list, trigger, strcasecmp))
-    listPut(list, strdup(trigger));
+  const char *key = strIntern(trigger);
+  if(listIn(list, key))
+    strRelease(key);
+  else {
+    listPut(list, (char *)key);
+    trigger_list_generation++;
+  }
 }
 
 void triggerListRemove(LIST *list, const char *trigger) {
-  char *val = listRemoveWith(list, trigger, strcasecmp);
-  if(val) free(val);
+  const char *key = strInternFind(trigger);
+  if(key != NULL && listRemove(list, key)) {
+    strRelease(key);
+    trigger_list_generation++;
+  }
 }
 
 
@@ -72,6 +72,11 @@ BUFFER *triggerGetCodeBuffer(TRIGGER_DATA *trigger);
 // run a trigger
 void triggerRun(TRIGGER_DATA *trigger, PyObject *dict);
 
+//
+// goes up whenever a trigger's type or key changes, or a trigger is deleted,
+// so anything that remembers what type triggers are knows to look again
+int triggerGetGeneration(void);
+
 //
 // for getting lists of triggers installed on various things. Returns the
 // trigger's key, and not the actual trigger. If an entry is removed from one
@@ -80,6 +85,37 @@ LIST *charGetTriggers(CHAR_DATA *ch);
 LIST *objGetTriggers (OBJ_DATA  *obj);
 LIST *roomGetTriggers(ROOM_DATA *room);
 
+//
+// the keys of the triggers of a given type installed on something, in the
+// order they were installed. Returns NULL if there are none. Otherwise, the
+// list must be deleted with deleteListWith(list, strRelease). What type each
+// trigger is is remembered between calls, so only events that something has
+// triggers for cost more than a lookup or two
+LIST *charGetTypeTriggers(CHAR_DATA *ch,   const char *type);
+LIST  *objGetTypeTriggers(OBJ_DATA  *obj,  const char *type);
+LIST *roomGetTypeTriggers(ROOM_DATA *room, const char *type);
+
+//
+// does a character, or anything they carry, have pre_command triggers? Does
+// a room, or anyone or anything in it? The answers are remembered until
+// triggers are attached, detached, or edited, or until the Forget functions
+// are called, which they must be whenever something enters or leaves
+bool charHasPreCommandTriggers(CHAR_DATA *ch);
+bool roomHasPreCommandTriggers(ROOM_DATA *room);
+void charForgetPreCommandTriggers(CHAR_DATA *ch);
+void roomForgetPreCommandTriggers(ROOM_DATA *room);
+
+//
+// run the pre_command hook for a command ch is about to do, or tried to do
+// if it is not valid. Returns TRUE if something handling it blocked it
+bool run_pre_command(CHAR_DATA *ch, const char *cmd, const char *arg,
+		     bool valid);
+
+//
+// keep the command ch is doing from being done. Only means anything from
+// pre_command triggers and hooks
+void block_command(CHAR_DATA *ch);
+
 //
 // get the python form for a character, object, or room. These are persistent
 // from the first time the python form is created. Before the pyform is 
@@ -139,10 +175,18 @@ bool trigger_list_parser (SOCKET_DATA *sock, LIST *triggers, int choice,
 
 //
 // create different sorts of dictionaries, depending on how secure we want them
-// to be. Dictionaries must be deleted (Py_DECREF) after being used.
+// to be. Dictionaries must be deleted (Py_DECREF) after being used. Each is a
+// fresh copy of a namespace that is only built once; scripts can change their
+// copy however they please without it touching anyone else's
 PyObject   *restricted_script_dict(void);
 PyObject *unrestricted_script_dict(void);
 
+//
+// throw out the namespaces script dictionaries are copied from, so they are
+// built again the next time one is wanted. Must be called whenever one of our
+// modules has been reloaded
+void forget_script_dicts(void);
+
 //
 // Runs an arbitrary block of python code using the given dictionary. If the
 // script has a locale (i.e. zone) associated with it (for instance, running
@@ -161,6 +205,14 @@ PyObject *run_script_forcode(PyObject *dict, const char *script,
 // proto) locale can be set. Otherwise, locale should be NULL.
 void run_code(PyObject *code, PyObject *dict, const char *locale);
 
+//
+// the same as run_code, but if the code isn't being run from within another
+// script, it gets the time budget for scripts of the given type (usually a
+// trigger type, or NULL for the default budget). what identifies the script
+// in the log if it runs out of time. See script_budget.h
+void run_code_as(PyObject *code, PyObject *dict, const char *locale,
+		 const char *type, const char *what);
+
 //
 // Evaluates a Python statement. If the statement has a locale (i.e. a zone)
 // associated with it, locale can be set. Otherwise, locale should be NULL
@@ -184,6 +236,17 @@ PyObject *eval_script(PyObject *dict, const char *statement,const char *locale);
 void expand_dynamic_descs(BUFFER *desc, PyObject *me, CHAR_DATA *ch, 
 			  const char *locale);
 
+//
+// the preprocess_room_desc listener that expands a room's dynamic description
+// for whoever is looking at it
+void expand_room_dynamic_descs(const char *info);
+
+//
+// and the preprocess_char_desc and preprocess_obj_desc ones that do the same
+// for NPCs and objects
+void expand_char_dynamic_descs(const char *info);
+void  expand_obj_dynamic_descs(const char *info);
+
 //
 // same as expand_dynamic_descs, but takes a dictionary instead of "me" and "ch"
 void expand_dynamic_descs_dict(BUFFER *desc, PyObject *dict,const char *locale);
@@ -200,6 +263,12 @@ void expand_to_char(CHAR_DATA *ch, const char *mssg, PyObject *dict,
 // and an empty string if there is no locale for the script
 const char *get_script_locale(void);
 
+//
+// run the scripts that follow in a locale, until the matching pop. For
+// Python that is picked back up later, such as coroutines
+void script_locale_push(const char *locale);
+void script_locale_pop(void);
+
 //
 // returns a smart locale for a script. If there is a locale on the script
 // stack, return that. Otherwise, return the locale for the character's room
@@ -10,6 +10,7 @@
 #include "../character.h"
 #include "../utils.h"
 #include "../world.h"
+#include "../intern.h"
 #include "scripts.h"
 #include "trighooks.h"
 
@@ -64,15 +65,17 @@ int trigger_list_chooser(SOCKET_DATA *sock, LIST *triggers, const char *option){
 bool trigger_list_parser(SOCKET_DATA *sock, LIST *triggers, int choice,
 		    const char *arg) {
   switch(choice) {
-  case TRIGLIST_NEW:
-    if(!listGetWith(triggers, arg, strcasecmp))
-      listPutWith(triggers, strdup(arg), strcasecmp);
-    return TRUE;
-  case TRIGLIST_DELETE: {
-    char *found = listRemoveWith(triggers, arg, strcasecmp);
-    if(found) free(found);
+  case TRIGLIST_NEW: {
+    const char *key = strIntern(arg);
+    if(listIn(triggers, key))
+      strRelease(key);
+    else
+      listPutWith(triggers, (char *)key, strcasecmp);
     return TRUE;
   }
+  case TRIGLIST_DELETE:
+    triggerListRemove(triggers, arg);
+    return TRUE;
   default: return FALSE;
   }
 }
@@ -13,6 +13,7 @@
 
 #include "scripts.h"
 #include "pyplugs.h"
+#include "code_cache.h"
 
 
 
@@ -27,6 +28,9 @@ struct trigger_data {
   PyObject *pycode; // the compiled version of our python code
 };
 
+// see triggerGetGeneration
+int trigger_generation = 0;
+
 
 
 //*****************************************************************************
@@ -49,6 +53,7 @@ void deleteTrigger(TRIGGER_DATA *trigger) {
   deleteBuffer(trigger->code);
   Py_XDECREF(trigger->pycode);
   free(trigger);
+  trigger_generation++;
 }
 
 STORAGE_SET *triggerStore(TRIGGER_DATA *trigger) {
@@ -88,11 +93,13 @@ void triggerSetName(TRIGGER_DATA *trigger, const char *name) {
 void triggerSetType(TRIGGER_DATA *trigger, const char *type) {
   if(trigger->type) free(trigger->type);
   trigger->type = strdupsafe(type);
+  trigger_generation++;
 }
 
 void triggerSetKey(TRIGGER_DATA *trigger, const char *key) {
   if(trigger->key) free(trigger->key);
   trigger->key = strdupsafe(key);
+  trigger_generation++;
 }
 
 void triggerSetCode(TRIGGER_DATA *trigger, const char *code) {
@@ -102,6 +109,10 @@ void triggerSetCode(TRIGGER_DATA *trigger, const char *code) {
   trigger->pycode = NULL;
 }
 
+int triggerGetGeneration(void) {
+  return trigger_generation;
+}
+
 const char *triggerGetName(TRIGGER_DATA *trigger) {
   return trigger->name;
 }
@@ -124,15 +135,20 @@ BUFFER *triggerGetCodeBuffer(TRIGGER_DATA *trigger) {
 
 void triggerRun(TRIGGER_DATA *trigger, PyObject *dict) {
   // if we haven't yet run the trigger, compile the source code
-  if(trigger->pycode == NULL)
-    trigger->pycode = run_script_forcode(dict, bufferString(trigger->code),
-					 get_key_locale(triggerGetKey(trigger)));
-  // run right from the code
-  else {
-    run_code(trigger->pycode, dict, get_key_locale(triggerGetKey(trigger)));
-
-    if(!last_script_ok())
-      log_pyerr("Trigger %s terminated with an error:\r\n%s",
+  if(trigger->pycode == NULL) {
+    trigger->pycode = cachedCompileString(bufferString(trigger->code),
+					  "<string>", Py_file_input);
+    if(trigger->pycode == NULL) {
+      log_pyerr("Trigger %s could not be compiled:\r\n%s",
 		trigger->key, bufferString(trigger->code));
+      return;
+    }
   }
+
+  // run right from the code, on the budget for our type of trigger
+  run_code_as(trigger->pycode, dict, get_key_locale(triggerGetKey(trigger)),
+	      trigger->type, trigger->key);
+  if(!last_script_ok())
+    log_pyerr("Trigger %s terminated with an error:\r\n%s",
+	      trigger->key, bufferString(trigger->code));
 }
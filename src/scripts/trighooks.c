@@ -26,8 +26,11 @@
 #include "../zone.h"
 #include "../save.h"
 #include "../action.h"
+#include "../event.h"
 #include "../dyn_vars/dyn_vars.h"
 #include "../parse.h"
+#include "../pulse.h"
+#include "../intern.h"
 #include "scripts.h"
 #include "pychar.h"
 #include "pyobj.h"
@@ -35,6 +38,7 @@
 #include "pyexit.h"
 #include "pymudsys.h"
 #include "trighooks.h"
+#include "script_prof.h"
 
 
 
@@ -45,6 +49,10 @@
 // a table matching trigger types to what they can attach to (obj, mob, room)
 HASHTABLE *tedit_opts = NULL;
 
+// the group do_group_move is moving. Their own enter and exit triggers are
+// dispatched together, and not as each of their hooks is run
+LIST *group_movers = NULL;
+
 // used for providing additional variables to gen_do_trig that are not standard
 struct opt_var {
   char *name;
@@ -81,6 +89,61 @@ void register_tedit_opt(const char *type, const char *desc) {
 // trigger handlers
 //*****************************************************************************/
 
+//
+// the names of the variables triggers are given, made into Python strings
+// once so that setting them is just a dictionary insert
+enum {
+  TRIGKEY_CMD, TRIGKEY_ARG, TRIGKEY_CH, TRIGKEY_ROOM, TRIGKEY_OBJ, TRIGKEY_EX,
+  TRIGKEY_ME, NUM_TRIGKEYS
+};
+
+const char *trigkey_names[NUM_TRIGKEYS] = {
+  "cmd", "arg", "ch", "room", "obj", "ex", "me"
+};
+PyObject *trigkeys[NUM_TRIGKEYS] = { NULL };
+
+//
+// put a variable in a trigger's dictionary, and let go of our reference to it
+void trig_dict_set(PyObject *dict, int key, PyObject *val) {
+  if(trigkeys[key] == NULL)
+    trigkeys[key] = PyUnicode_InternFromString(trigkey_names[key]);
+  if(val != NULL) {
+    PyDict_SetItem(dict, trigkeys[key], val);
+    Py_DECREF(val);
+  }
+}
+
+PyObject *trig_pyform(void *data, int type) {
+  switch(type) {
+  case TRIGVAR_CHAR:  return charGetPyForm(data);
+  case TRIGVAR_OBJ:   return objGetPyForm(data);
+  case TRIGVAR_ROOM:  return roomGetPyForm(data);
+  }
+  return NULL;
+}
+
+//
+// describe what a trigger is attached to, for the profiler
+const char *trig_owner(void *me, int me_type) {
+  static char buf[SMALL_BUFFER];
+  *buf = '\0';
+  if(me == NULL)
+    return buf;
+  switch(me_type) {
+  case TRIGVAR_CHAR:
+    snprintf(buf, sizeof(buf), "mob %s", (charIsNPC(me) ? charGetClass(me) :
+					  charGetName(me)));
+    break;
+  case TRIGVAR_OBJ:
+    snprintf(buf, sizeof(buf), "obj %s", objGetClass(me));
+    break;
+  case TRIGVAR_ROOM:
+    snprintf(buf, sizeof(buf), "room %s", roomGetClass(me));
+    break;
+  }
+  return buf;
+}
+
 //
 // generalized function for setting up a dictionary and running a trigger. The
 // common types of variables can be supplied in the function. Additional ones
@@ -91,112 +154,74 @@ void gen_do_trig(TRIGGER_DATA *trig,
 		 const char *arg, LIST *optional) {
   // make our basic dictionary, and fill it up with these new variables
   PyObject *dict = restricted_script_dict();
-  LIST *varnames = newList(); 
-  // now, import all of our variables
-  if(command) {
-    PyObject *pycmd = PyUnicode_FromString(command);
-    PyDict_SetItemString(dict, "cmd", pycmd);
-    listPut(varnames, strdup("cmd"));
-    Py_DECREF(pycmd);
-  }
-  if(arg) {
-    PyObject *pyarg = PyUnicode_FromString(arg);
-    PyDict_SetItemString(dict, "arg", pyarg);
-    listPut(varnames, strdup("arg"));
-    Py_DECREF(pyarg);
-  }
-  if(ch) {
-    PyObject *pych = charGetPyForm(ch);
-    PyDict_SetItemString(dict, "ch", pych);
-    listPut(varnames, strdup("ch"));
-    Py_DECREF(pych);
-  }
-  if(room) {
-    PyObject *pyroom = roomGetPyForm(room);
-    PyDict_SetItemString(dict, "room", pyroom);
-    listPut(varnames, strdup("room"));
-    Py_DECREF(pyroom);
-  }    
-  if(obj) {
-    PyObject *pyobj = objGetPyForm(obj);
-    PyDict_SetItemString(dict, "obj", pyobj);
-    listPut(varnames, strdup("obj"));
-    Py_DECREF(pyobj);
-  }
-  if(exit) {
-    PyObject *pyexit = newPyExit(exit);
-    PyDict_SetItemString(dict, "ex", pyexit);
-    listPut(varnames, strdup("ex"));
-    Py_DECREF(pyexit);
-  }
+  if(command) trig_dict_set(dict, TRIGKEY_CMD,  PyUnicode_FromString(command));
+  if(arg)     trig_dict_set(dict, TRIGKEY_ARG,  PyUnicode_FromString(arg));
+  if(ch)      trig_dict_set(dict, TRIGKEY_CH,   charGetPyForm(ch));
+  if(room)    trig_dict_set(dict, TRIGKEY_ROOM, roomGetPyForm(room));
+  if(obj)     trig_dict_set(dict, TRIGKEY_OBJ,  objGetPyForm(obj));
+  if(exit)    trig_dict_set(dict, TRIGKEY_EX,   newPyExit(exit));
 
   // add the thing the trigger is attached to
-  if(me) {
-    PyObject *pyme = NULL;
-    switch(me_type) {
-    case TRIGVAR_CHAR:  pyme = charGetPyForm(me); break;
-    case TRIGVAR_OBJ:   pyme = objGetPyForm(me);  break;
-    case TRIGVAR_ROOM:  pyme = roomGetPyForm(me); break;
-    }
-    PyDict_SetItemString(dict, "me", pyme);
-    listPut(varnames, strdup("me"));
-    Py_DECREF(pyme);
-  }
+  if(me)      trig_dict_set(dict, TRIGKEY_ME,   trig_pyform(me, me_type));
 
   // now, add any optional variables
   if(optional) {
-    LIST_ITERATOR *opt_i = newListIterator(optional);
+    LOCAL_LIST_ITERATOR(opt_i, optional);
     OPT_VAR         *opt = NULL;
     PyObject      *pyopt = NULL;
     ITERATE_LIST(opt, opt_i) {
-      pyopt = NULL;
-      switch(opt->type) {
-      case TRIGVAR_CHAR:  pyopt = charGetPyForm(opt->data); break;
-      case TRIGVAR_OBJ:   pyopt = objGetPyForm(opt->data);  break;
-      case TRIGVAR_ROOM:  pyopt = roomGetPyForm(opt->data); break;
+      if( (pyopt = trig_pyform(opt->data, opt->type)) != NULL) {
+	PyDict_SetItemString(dict, opt->name, pyopt);
+	Py_DECREF(pyopt);
       }
-      PyDict_SetItemString(dict, opt->name, pyopt);
-      listPut(varnames, strdup(opt->name));
-      Py_XDECREF(pyopt);
-    } deleteListIterator(opt_i);
+    } listIteratorFinish(opt_i);
   }
 
   // run the script, then kill our dictionary
+  long long start = (scriptProfIsOn() ? pulse_clock() : 0);
   triggerRun(trig, dict);
+  if(start != 0)
+    scriptProfRecord("trigger", triggerGetKey(trig),
+		     trig_owner(me, me_type), pulse_clock() - start);
 
   // Clean out the contents of the dictionary, decreasing the
   // reference of the contents.
   PyDict_Clear(dict);
-
-  deleteListWith(varnames, free);
   Py_XDECREF(dict);
 }
 
 //
 // generalized function for running all triggers of a specified type.
-void gen_do_trigs(void *me, int me_type, const char *type,
-		  CHAR_DATA *ch,OBJ_DATA *obj, ROOM_DATA *room, EXIT_DATA *exit,
-		  const char *command, const char *arg, LIST *optional) {
-  // find our list of triggers
+int gen_do_trigs(void *me, int me_type, const char *type,
+		 CHAR_DATA *ch,OBJ_DATA *obj, ROOM_DATA *room, EXIT_DATA *exit,
+		 const char *command, const char *arg, LIST *optional) {
+  // find the triggers of our type. Most events have none
   LIST *trig_keys = NULL;
   if(me_type == TRIGVAR_CHAR)
-    trig_keys = charGetTriggers(me);
+    trig_keys = charGetTypeTriggers(me, type);
   else if(me_type == TRIGVAR_OBJ)
-    trig_keys = objGetTriggers(me);
+    trig_keys = objGetTypeTriggers(me, type);
   else if(me_type == TRIGVAR_ROOM)
-    trig_keys = roomGetTriggers(me);
+    trig_keys = roomGetTypeTriggers(me, type);
 
-  if(trig_keys == NULL || listSize(trig_keys) == 0)
-    return;
-  
-  char        *trig_key = NULL;
-  LIST_ITERATOR *trig_i = newListIterator(trig_keys);
+  if(trig_keys == NULL)
+    return 0;
+
+  // triggers are looked up as they are run, in case one that runs before
+  // them changes or deletes them
+  const char  *trig_key = NULL;
   TRIGGER_DATA    *trig = NULL;
-  ITERATE_LIST(trig_key, trig_i) {
+  int              runs = 0;
+  while((trig_key = listPop(trig_keys)) != NULL) {
     if((trig = worldGetType(gameworld, "trigger", trig_key)) != NULL &&
-       !strcasecmp(triggerGetType(trig), type))
+       !strcasecmp(triggerGetType(trig), type)) {
       gen_do_trig(trig,me,me_type,ch,obj,room,exit,command,arg,optional);
-  } deleteListIterator(trig_i);
+      runs++;
+    }
+    strRelease(trig_key);
+  }
+  deleteList(trig_keys);
+  return runs;
 }
 
 
@@ -242,13 +267,15 @@ void do_enter_trighooks(const char *info) {
   CHAR_DATA   *ch = NULL;
   ROOM_DATA *room = NULL;
   hookParseInfo(info, &ch, &room);
+  if(group_movers != NULL && listIn(group_movers, ch))
+    return;
 
-  LIST_ITERATOR *mob_i = newListIterator(roomGetCharacters(room));
+  LOCAL_LIST_ITERATOR(mob_i, roomGetCharacters(room));
   CHAR_DATA       *mob = NULL;
   ITERATE_LIST(mob, mob_i) {
     if(ch != mob)
       gen_do_trigs(mob,TRIGVAR_CHAR,"enter",ch,NULL,NULL,NULL,NULL,NULL,NULL);
-  } deleteListIterator(mob_i);
+  } listIteratorFinish(mob_i);
   gen_do_trigs(room,TRIGVAR_ROOM,"enter",ch,NULL,NULL,NULL,NULL,NULL,NULL);
   gen_do_trigs(ch,TRIGVAR_CHAR,"self enter",NULL,NULL,NULL,NULL,NULL,NULL,NULL);
 }
@@ -258,17 +285,96 @@ void do_exit_trighooks(const char *info) {
   ROOM_DATA *room = NULL;
   EXIT_DATA *exit = NULL;
   hookParseInfo(info, &ch, &room, &exit);
+  if(group_movers != NULL && listIn(group_movers, ch))
+    return;
 
-  LIST_ITERATOR *mob_i = newListIterator(roomGetCharacters(room));
+  LOCAL_LIST_ITERATOR(mob_i, roomGetCharacters(room));
   CHAR_DATA       *mob = NULL;
   ITERATE_LIST(mob, mob_i) {
     if(ch != mob)
       gen_do_trigs(mob,TRIGVAR_CHAR,"exit",ch,NULL,NULL,exit,NULL,NULL,NULL);
-  } deleteListIterator(mob_i);
+  } listIteratorFinish(mob_i);
   gen_do_trigs(room,TRIGVAR_ROOM,"exit",ch,NULL,NULL,exit,NULL,NULL,NULL);
   gen_do_trigs(ch,TRIGVAR_CHAR,"self exit",NULL,NULL,NULL,exit,NULL,NULL,NULL);
 }
 
+//
+// run enter or exit triggers for a group that moved together. Whoever in the
+// room has triggers for it is found once, for the whole group
+void do_group_trighooks(const char *type, LIST *movers, ROOM_DATA *room,
+			EXIT_DATA *exit) {
+  char self_type[SMALL_BUFFER];
+  snprintf(self_type, sizeof(self_type), "self %s", type);
+
+  LIST   *watchers = newList();
+  LIST       *keys = NULL;
+  CHAR_DATA   *mob = NULL;
+  LOCAL_LIST_ITERATOR(mob_i, roomGetCharacters(room));
+  ITERATE_LIST(mob, mob_i) {
+    if(!listIn(movers, mob) && (keys = charGetTypeTriggers(mob,type)) != NULL){
+      deleteListWith(keys, strRelease);
+      listQueue(watchers, mob);
+    }
+  } listIteratorFinish(mob_i);
+  bool room_trigs = FALSE;
+  if((keys = roomGetTypeTriggers(room, type)) != NULL) {
+    deleteListWith(keys, strRelease);
+    room_trigs = TRUE;
+  }
+
+  LOCAL_LIST_ITERATOR(ch_i, movers);
+  CHAR_DATA   *ch = NULL;
+  ITERATE_LIST(ch, ch_i) {
+    if(charIsExtracted(ch))
+      continue;
+    LOCAL_LIST_ITERATOR(watch_i, watchers);
+    ITERATE_LIST(mob, watch_i) {
+      // an earlier trigger may have taken them away
+      if(!charIsExtracted(mob) && charGetRoom(mob) == room)
+	gen_do_trigs(mob,TRIGVAR_CHAR,type,ch,NULL,NULL,exit,NULL,NULL,NULL);
+    } listIteratorFinish(watch_i);
+    if(room_trigs)
+      gen_do_trigs(room,TRIGVAR_ROOM,type,ch,NULL,NULL,exit,NULL,NULL,NULL);
+    gen_do_trigs(ch,TRIGVAR_CHAR,self_type,NULL,NULL,NULL,exit,NULL,NULL,NULL);
+  } listIteratorFinish(ch_i);
+  deleteList(watchers);
+}
+
+void do_group_move(LIST *chars, ROOM_DATA *to, EXIT_DATA *exit) {
+  CHAR_DATA    *ch = listGet(chars, 0);
+  ROOM_DATA  *from = (ch ? charGetRoom(ch) : NULL);
+  LIST *last_group = group_movers;
+  if(from == NULL)
+    return;
+
+  // everyone's exit hooks, and then the exit triggers for all of us at once
+  group_movers = chars;
+  LOCAL_LIST_ITERATOR(exit_i, chars);
+  ITERATE_LIST(ch, exit_i) {
+    hookRunArgs("exit", "ch rm ex", ch, from, exit);
+  } listIteratorFinish(exit_i);
+  do_group_trighooks("exit", chars, from, exit);
+
+  // hooks could move us, or take us out of the game. Anyone still where we
+  // started from goes on
+  LIST *moving = newList();
+  LOCAL_LIST_ITERATOR(ch_i, chars);
+  ITERATE_LIST(ch, ch_i) {
+    if(!charIsExtracted(ch) && charGetRoom(ch) == from)
+      listQueue(moving, ch);
+  } listIteratorFinish(ch_i);
+  chars_to_room(moving, to);
+
+  group_movers = moving;
+  LOCAL_LIST_ITERATOR(enter_i, moving);
+  ITERATE_LIST(ch, enter_i) {
+    hookRunArgs("enter", "ch rm", ch, to);
+  } listIteratorFinish(enter_i);
+  do_group_trighooks("enter", moving, to, NULL);
+  group_movers = last_group;
+  deleteList(moving);
+}
+
 void do_ask_trighooks(const char *info) {
   CHAR_DATA       *ch = NULL;
   CHAR_DATA *listener = NULL;
@@ -285,12 +391,12 @@ void do_say_trighooks(const char *info) {
   char  *speech = NULL;
   hookParseInfo(info, &ch, &speech);
 
-  LIST_ITERATOR *mob_i = newListIterator(roomGetCharacters(charGetRoom(ch)));
+  LOCAL_LIST_ITERATOR(mob_i, roomGetCharacters(charGetRoom(ch)));
   CHAR_DATA       *mob = NULL;
   ITERATE_LIST(mob, mob_i) {
     if(ch != mob)
      gen_do_trigs(mob,TRIGVAR_CHAR,"speech",ch,NULL,NULL,NULL,NULL,speech,NULL);
-  } deleteListIterator(mob_i);
+  } listIteratorFinish(mob_i);
   gen_do_trigs(charGetRoom(ch),TRIGVAR_ROOM,"speech",ch,NULL,NULL,NULL,NULL,speech,NULL);
 
   // garbage collection
@@ -325,7 +431,7 @@ void do_reset_trighooks(const char *info) {
   hookParseInfo(info, &zone_key);
   ZONE_DATA *zone = worldGetZone(gameworld, zone_key);
 
-  LIST_ITERATOR *res_i = newListIterator(zoneGetResettable(zone));
+  LOCAL_LIST_ITERATOR(res_i, zoneGetResettable(zone));
   char           *name = NULL;
   const char   *locale = zoneGetKey(zone);
   ROOM_DATA      *room = NULL;
@@ -333,7 +439,7 @@ void do_reset_trighooks(const char *info) {
     room = worldGetRoom(gameworld, get_fullkey(name, locale));
     if(room != NULL)
      gen_do_trigs(room,TRIGVAR_ROOM,"reset",NULL,NULL,NULL,NULL,NULL,NULL,NULL);
-  } deleteListIterator(res_i);
+  } listIteratorFinish(res_i);
 
   // garbage collection
   free(zone_key);
@@ -406,108 +512,281 @@ void do_room_to_game_trighooks(const char *info) {
   gen_do_trigs(rm,TRIGVAR_ROOM,"to_game",NULL,NULL,NULL,NULL,NULL,NULL,NULL);
 }
 
-void do_heartbeat_trighooks(const char *info) {
+//*****************************************************************************
+// heartbeat registry
+//
+// only NPCs and objects carrying a heartbeat trigger are ever visited on a
+// heartbeat. They are kept in buckets; normally every bucket is run when the
+// heartbeat hook goes off. If the heartbeat_spread setting is on, the
+// buckets are instead run one after another across the heartbeat period, so
+// all of the heartbeat triggers don't land on the same pulse
+//*****************************************************************************
+#define HEARTBEAT_BUCKETS     20
+
+LIST *heartbeat_chars[HEARTBEAT_BUCKETS];
+LIST  *heartbeat_objs[HEARTBEAT_BUCKETS];
+MAP  *heartbeat_bucket = NULL; // which bucket each registered thing is in
+int    heartbeat_next  = 0;    // the bucket the next registration goes in
+int    heartbeat_tick  = 0;    // how far through the period we are spread
+
+//
+// does the thing carry a trigger of the heartbeat type?
+bool has_heartbeat_trig(LIST *trig_keys) {
+  if(trig_keys == NULL || listSize(trig_keys) == 0)
+    return FALSE;
+
+  bool               found = FALSE;
+  char           *trig_key = NULL;
+  LOCAL_LIST_ITERATOR(trig_i, trig_keys);
+  TRIGGER_DATA       *trig = NULL;
+  ITERATE_LIST(trig_key, trig_i) {
+    if((trig = worldGetType(gameworld, "trigger", trig_key)) != NULL &&
+       !strcasecmp(triggerGetType(trig), "heartbeat")) {
+      found = TRUE;
+      break;
+    }
+  } listIteratorFinish(trig_i);
+  return found;
+}
+
+void heartbeat_unregister(void *me, int me_type) {
+  int bucket = (int)(long)mapRemove(heartbeat_bucket, me) - 1;
+  if(bucket < 0)
+    return;
+  if(me_type == TRIGVAR_CHAR)
+    listRemove(heartbeat_chars[bucket], me);
+  else
+    listRemove(heartbeat_objs[bucket], me);
+}
+
+void heartbeat_register(void *me, int me_type) {
+  if(mapIn(heartbeat_bucket, me))
+    return;
+  int bucket     = heartbeat_next;
+  heartbeat_next = (heartbeat_next + 1) % HEARTBEAT_BUCKETS;
+  mapPut(heartbeat_bucket, me, (void *)(long)(bucket + 1));
+  if(me_type == TRIGVAR_CHAR)
+    listQueue(heartbeat_chars[bucket], me);
+  else
+    listQueue(heartbeat_objs[bucket], me);
+}
+
+void heartbeat_trighooks_update(void *me, int me_type) {
+  bool in_game = FALSE, has_trig = FALSE;
+  if(me_type == TRIGVAR_CHAR) {
+    in_game  = (propertyTableGet(mob_table, charGetUID(me)) == me);
+    has_trig = has_heartbeat_trig(charGetTriggers(me));
+  }
+  else if(me_type == TRIGVAR_OBJ) {
+    in_game  = (propertyTableGet(obj_table, objGetUID(me)) == me);
+    has_trig = has_heartbeat_trig(objGetTriggers(me));
+  }
+  else
+    return;
+
+  if(in_game && has_trig)
+    heartbeat_register(me, me_type);
+  else
+    heartbeat_unregister(me, me_type);
+}
+
+void do_char_to_game_heartbeat(const char *info) {
+  CHAR_DATA *ch = NULL;
+  hookParseInfo(info, &ch);
+  heartbeat_trighooks_update(ch, TRIGVAR_CHAR);
+}
+
+void do_obj_to_game_heartbeat(const char *info) {
+  OBJ_DATA *obj = NULL;
+  hookParseInfo(info, &obj);
+  heartbeat_trighooks_update(obj, TRIGVAR_OBJ);
+}
+
+void do_char_from_game_heartbeat(const char *info) {
+  CHAR_DATA *ch = NULL;
+  hookParseInfo(info, &ch);
+  heartbeat_unregister(ch, TRIGVAR_CHAR);
+}
+
+void do_obj_from_game_heartbeat(const char *info) {
+  OBJ_DATA *obj = NULL;
+  hookParseInfo(info, &obj);
+  heartbeat_unregister(obj, TRIGVAR_OBJ);
+}
+
+//
+// run the heartbeat triggers of everything in one bucket
+void run_heartbeat_bucket(int bucket) {
   // heartbeat triggers run on NPCs and objects only
-  // iterate through all NPCs in the game
-  LIST_ITERATOR *npc_i = newListIterator(mobile_list);
+  LOCAL_LIST_ITERATOR(npc_i, heartbeat_chars[bucket]);
   CHAR_DATA *npc = NULL;
   ITERATE_LIST(npc, npc_i) {
-    // only run heartbeat on NPCs (not players) that have triggers
-    if(charGetSocket(npc) == NULL && listSize(charGetTriggers(npc)) > 0) {
+    // only run heartbeat on NPCs (not players)
+    if(charGetSocket(npc) == NULL)
       gen_do_trigs(npc, TRIGVAR_CHAR, "heartbeat", NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    }
-  } deleteListIterator(npc_i);
+  } listIteratorFinish(npc_i);
   
-  // iterate through all objects in the game
-  LIST_ITERATOR *obj_i = newListIterator(object_list);
+  LOCAL_LIST_ITERATOR(obj_i, heartbeat_objs[bucket]);
   OBJ_DATA *obj = NULL;
   ITERATE_LIST(obj, obj_i) {
-    // only run heartbeat on objects that have triggers
-    if(listSize(objGetTriggers(obj)) > 0) {
-      gen_do_trigs(obj, TRIGVAR_OBJ, "heartbeat", NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    }
-  } deleteListIterator(obj_i);
+    gen_do_trigs(obj, TRIGVAR_OBJ, "heartbeat", NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+  } listIteratorFinish(obj_i);
+}
+
+void do_heartbeat_trighooks(const char *info) {
+  // we're being spread across the period by heartbeat_spread_update instead
+  if(mudsettingGetInt("heartbeat_spread"))
+    return;
+  int bucket;
+  for(bucket = 0; bucket < HEARTBEAT_BUCKETS; bucket++)
+    run_heartbeat_bucket(bucket);
+}
+
+//
+// runs every pulse. If heartbeats are being spread out, run whichever buckets
+// fall on this pulse of the heartbeat period
+void heartbeat_spread_update(void *owner, void *data, const char *arg) {
+  if(!mudsettingGetInt("heartbeat_spread"))
+    return;
+  int period = MAX(1, 2 SECONDS);
+  int   tick = heartbeat_tick % period;
+  int bucket;
+  heartbeat_tick = (tick + 1) % period;
+  for(bucket = 0; bucket < HEARTBEAT_BUCKETS; bucket++)
+    if(bucket * period / HEARTBEAT_BUCKETS == tick)
+      run_heartbeat_bucket(bucket);
 }
 
 
 
+//
+// pre_command triggers run for every command anyone does, so we go out of
+// our way to not look at anything that doesn't have them. Each command that
+// is having its pre_command hook run gets a context of its own
+typedef struct pre_command_ctx {
+  CHAR_DATA                *ch;
+  bool                 blocked;
+  bool             dispatching; // are its triggers being run?
+  struct pre_command_ctx *prev; // the command we were run in the middle of
+} PRE_COMMAND_CTX;
+
+PRE_COMMAND_CTX *pre_command_ctx = NULL;
+
+//
+// run the pre_command triggers on something. Returns TRUE if the command was
+// blocked. Scripts block commands with block_command(), or by setting
+// pc_block_command on the character, which only has to be checked if
+// triggers were actually run
+bool pre_command_dispatch(PRE_COMMAND_CTX *ctx, void *me, int me_type,
+			  CHAR_DATA *ch, const char *cmd, const char *arg) {
+  if(gen_do_trigs(me, me_type, "pre_command", ch, NULL, NULL, NULL, cmd, arg,
+		  NULL) > 0 && charGetInt(ctx->ch, "pc_block_command")) {
+    charDeleteVar(ctx->ch, "pc_block_command");
+    ctx->blocked = TRUE;
+  }
+  return ctx->blocked;
+}
+
 void do_pre_command_trighooks(const char *info) {
   CHAR_DATA *ch = NULL;
   char *cmd = NULL;
   char *arg = NULL;
   int valid = 0;
+  PRE_COMMAND_CTX *ctx = NULL, local = { NULL, FALSE, FALSE, NULL };
   
   // Parse the hook info first to get character
   hookParseInfo(info, &ch, &cmd, &arg, &valid);
-  
+
   // Prevent infinite recursion from act() calls - per character
-  if(charGetInt(ch, "pc_in_pre_command")) return;
-  charSetInt(ch, "pc_in_pre_command", 1);
-  
-  // 1. Self (the character executing the command)
-  gen_do_trigs(ch, TRIGVAR_CHAR, "pre_command", NULL, NULL, NULL, NULL, cmd, arg, NULL);
-  if(charGetInt(ch, "pc_block_command")) {
-    charDeleteVar(ch, "pc_block_command");
-    charDeleteVar(ch, "pc_in_pre_command");
-    return; // Command handled, stop processing
+  for(ctx = pre_command_ctx; ctx != NULL; ctx = ctx->prev)
+    if(ctx->ch == ch && ctx->dispatching)
+      return;
+
+  // nothing here has pre_command triggers? Then there's nothing to run
+  ROOM_DATA *room = charGetRoom(ch);
+  if(!charHasPreCommandTriggers(ch) &&
+     (room == NULL || !roomHasPreCommandTriggers(room)))
+    return;
+
+  // someone ran the hook without run_pre_command. Nobody will see our block
+  if((ctx = pre_command_ctx) == NULL || ctx->ch != ch) {
+    local.ch = ch;
+    ctx      = &local;
   }
-  
+  ctx->dispatching = TRUE;
+
+  // 1. Self (the character executing the command)
   // 2. Inventory items
-  LIST_ITERATOR *obj_i = newListIterator(charGetInventory(ch));
-  OBJ_DATA *obj = NULL;
-  ITERATE_LIST(obj, obj_i) {
-    gen_do_trigs(obj, TRIGVAR_OBJ, "pre_command", ch, NULL, NULL, NULL, cmd, arg, NULL);
-    if(charGetInt(ch, "pc_block_command")) {
-      deleteListIterator(obj_i);
-      charDeleteVar(ch, "pc_block_command");
-      charDeleteVar(ch, "pc_in_pre_command");
-      return; // Command handled, stop processing
-    }
-  } deleteListIterator(obj_i);
-  
+  if(charHasPreCommandTriggers(ch) &&
+     !pre_command_dispatch(ctx, ch, TRIGVAR_CHAR, NULL, cmd, arg)) {
+    LOCAL_LIST_ITERATOR(obj_i, charGetInventory(ch));
+    OBJ_DATA *obj = NULL;
+    ITERATE_LIST(obj, obj_i) {
+      if(pre_command_dispatch(ctx, obj, TRIGVAR_OBJ, ch, cmd, arg))
+	break;
+    } listIteratorFinish(obj_i);
+  }
+
   // 3. Room inventory (NPCs and objects in the room)
-  ROOM_DATA *room = charGetRoom(ch);
-  if(room) {
-    // Check other characters in the room
-    LIST_ITERATOR *char_i = newListIterator(roomGetCharacters(room));
+  // 4. Room itself (last priority)
+  if(!ctx->blocked && room != NULL && roomHasPreCommandTriggers(room)) {
+    LOCAL_LIST_ITERATOR(char_i, roomGetCharacters(room));
     CHAR_DATA *rch = NULL;
     ITERATE_LIST(rch, char_i) {
-      if(rch != ch) { // Don't check self again
-        gen_do_trigs(rch, TRIGVAR_CHAR, "pre_command", ch, NULL, NULL, NULL, cmd, arg, NULL);
-        if(charGetInt(ch, "pc_block_command")) {
-          deleteListIterator(char_i);
-          charSetInt(ch, "pc_block_command", 0);
-          charSetInt(ch, "pc_in_pre_command", 0);
-          return; // Command handled, stop processing
-        }
-      }
-    } deleteListIterator(char_i);
-    
-    // Check objects in the room
-    LIST_ITERATOR *room_obj_i = newListIterator(roomGetContents(room));
-    OBJ_DATA *room_obj = NULL;
-    ITERATE_LIST(room_obj, room_obj_i) {
-      gen_do_trigs(room_obj, TRIGVAR_OBJ, "pre_command", ch, NULL, NULL, NULL, cmd, arg, NULL);
-      if(charGetInt(ch, "pc_block_command")) {
-        deleteListIterator(room_obj_i);
-        charSetInt(ch, "pc_block_command", 0);
-        charSetInt(ch, "pc_in_pre_command", 0);
-        return; // Command handled, stop processing
-      }
-    } deleteListIterator(room_obj_i);
-    
-    // 4. Room itself (last priority)
-    gen_do_trigs(room, TRIGVAR_ROOM, "pre_command", ch, NULL, NULL, NULL, cmd, arg, NULL);
+      if(rch != ch && // Don't check self again
+	 pre_command_dispatch(ctx, rch, TRIGVAR_CHAR, ch, cmd, arg))
+	break;
+    } listIteratorFinish(char_i);
+
+    if(!ctx->blocked) {
+      LOCAL_LIST_ITERATOR(room_obj_i, roomGetContents(room));
+      OBJ_DATA *room_obj = NULL;
+      ITERATE_LIST(room_obj, room_obj_i) {
+	if(pre_command_dispatch(ctx, room_obj, TRIGVAR_OBJ, ch, cmd, arg))
+	  break;
+      } listIteratorFinish(room_obj_i);
+    }
+
+    if(!ctx->blocked)
+      pre_command_dispatch(ctx, room, TRIGVAR_ROOM, ch, cmd, arg);
   }
   
-  // Clear recursion flag
-  charDeleteVar(ch, "pc_in_pre_command");
+  ctx->dispatching = FALSE;
 }
 
+//
+// things coming and going change who has pre_command triggers nearby
+void pre_command_room_changed(const char *info) {
+  void      *thing = NULL;
+  ROOM_DATA  *room = NULL;
+  hookParseInfo(info, &thing, &room);
+  if(room != NULL)
+    roomForgetPreCommandTriggers(room);
+}
+
+void pre_command_char_changed(const char *info) {
+  OBJ_DATA  *obj = NULL;
+  CHAR_DATA  *ch = NULL;
+  hookParseInfo(info, &obj, &ch);
+  if(ch != NULL)
+    charForgetPreCommandTriggers(ch);
+}
+
+
+
 //*****************************************************************************
 // implementation of trighooks.h
 //*****************************************************************************
 void init_trighooks(void) {
+  // set up our heartbeat registry
+  int bucket;
+  heartbeat_bucket = newMap(NULL, NULL);
+  for(bucket = 0; bucket < HEARTBEAT_BUCKETS; bucket++) {
+    heartbeat_chars[bucket] = newList();
+    heartbeat_objs[bucket]  = newList();
+  }
+  start_update(NULL, 1, heartbeat_spread_update, NULL, NULL, NULL);
+
   // add all of our hooks to the game
   hookAdd("give",           do_give_trighooks);
   hookAdd("get",            do_get_trighooks);
@@ -531,7 +810,17 @@ void init_trighooks(void) {
   hookAdd("char_to_game",   do_char_to_game_trighooks);
   hookAdd("room_to_game",   do_room_to_game_trighooks);
   hookAdd("heartbeat",      do_heartbeat_trighooks);
+  hookAdd("char_to_game",   do_char_to_game_heartbeat);
+  hookAdd("obj_to_game",    do_obj_to_game_heartbeat);
+  hookAdd("char_from_game", do_char_from_game_heartbeat);
+  hookAdd("obj_from_game",  do_obj_from_game_heartbeat);
   hookAdd("pre_command",    do_pre_command_trighooks);
+  hookAdd("char_to_room",   pre_command_room_changed);
+  hookAdd("char_from_room", pre_command_room_changed);
+  hookAdd("obj_to_room",    pre_command_room_changed);
+  hookAdd("obj_from_room",  pre_command_room_changed);
+  hookAdd("obj_to_char",    pre_command_char_changed);
+  hookAdd("obj_from_char",  pre_command_char_changed);
 
   // add our trigger displays
   register_tedit_opt("speech",         "mob, room" );
@@ -554,3 +843,22 @@ void init_trighooks(void) {
   register_tedit_opt("heartbeat",      "obj, mob" );
   register_tedit_opt("pre_command",    "obj, mob, room" );
 }
+
+bool run_pre_command(CHAR_DATA *ch, const char *cmd, const char *arg,
+		     bool valid) {
+  PRE_COMMAND_CTX ctx = { ch, FALSE, FALSE, pre_command_ctx };
+  pre_command_ctx = &ctx;
+  hookRunArgs("pre_command", "ch str str int", ch, cmd, arg, (valid ? 1 : 0));
+  pre_command_ctx = ctx.prev;
+  return ctx.blocked;
+}
+
+void block_command(CHAR_DATA *ch) {
+  PRE_COMMAND_CTX *ctx = NULL;
+  for(ctx = pre_command_ctx; ctx != NULL; ctx = ctx->prev) {
+    if(ctx->ch == ch) {
+      ctx->blocked = TRUE;
+      break;
+    }
+  }
+}
@@ -36,10 +36,19 @@ void  deleteOptVar(OPT_VAR *var);
 // specifies the owner. Type is the class of triggers to be run. Other variables
 // appear as the same name in the trigger. Each can be NULL. If other variables
 // are needed, a list of optionals can be provided, which must be deleted after
-// use
-void gen_do_trigs(void *me, int me_type, const char *type,
-		  CHAR_DATA *ch,OBJ_DATA *obj, ROOM_DATA *room, EXIT_DATA *exit,
-		  const char *cmd, const char *arg, LIST *optional);
+// use. Returns how many triggers were run
+int gen_do_trigs(void *me, int me_type, const char *type,
+		 CHAR_DATA *ch,OBJ_DATA *obj, ROOM_DATA *room, EXIT_DATA *exit,
+		 const char *cmd, const char *arg, LIST *optional);
+
+//
+// move a group of characters that are in the same room through an exit (or
+// NULL) into another room, together. Each of them runs the exit and enter
+// hooks as usual, but enter and exit triggers are dispatched once for the
+// whole group: the people in each room that have triggers for it are found
+// once, and then run for each person in the group. People in the group don't
+// set off each other's triggers. Messages and looking are up to the caller
+void do_group_move(LIST *chars, ROOM_DATA *to, EXIT_DATA *exit);
 
 //
 // the trigger edit (tedit) menu displays a list of possible trigger types
@@ -48,6 +57,13 @@ void gen_do_trigs(void *me, int me_type, const char *type,
 // (obj, mob, room, in that order)
 void register_tedit_opt(const char *type, const char *desc); 
 
+//
+// heartbeat triggers are only run for the NPCs and objects in the game that
+// carry one. Must be called whenever triggers are attached to or detached
+// from a character or object so it can be added to or taken out of the
+// heartbeat registry. Entering and leaving the game is handled automatically
+void heartbeat_trighooks_update(void *me, int me_type);
+
 // returns a table of the available tedit opts
 HASHTABLE *get_tedit_opts(void);
 
@@ -4,79 +4,97 @@
 //
 // a non-ordered container that has constant lookup time.
 //
+// sets are flat arrays of elements, with open addressing and linear probing.
+// Almost every set holds plain pointers, so unless custom hashing has been
+// set up with setChangeHashing, elements are hashed and compared by address
+// directly instead of through function pointers. Removed elements leave a
+// tombstone behind, so removing elements while iterating over a set is safe.
+//
 //*****************************************************************************
 
 #include <stdlib.h>
 #include "list.h"
 #include "set.h"
 
-// how big of a size do our set start out at?
-#define DEFAULT_SET_SIZE        5
+// how big of a size do our set start out at? Must be a power of 2
+#define DEFAULT_SET_SIZE        8
 
-struct set_data {
-  int    num_buckets;
-  int           size;
-  LIST     **buckets;
-  int  (* cmp)(const void *, const void *);
-  int (* hash)(const void *);
-};
+// what a bucket holds after its element has been removed
+#define SET_DELETED        ((void *)&set_deleted)
+char set_deleted;
 
-struct set_iterator {
-  int         curr_bucket; // the bucket number we're currently on
-  struct set_data    *set; // the set we're iterating over
-  LIST_ITERATOR *bucket_i; // the iterator for our current bucket
+struct set_data {
+  int    num_buckets; // always a power of 2
+  int           size; // how many elements we hold
+  int           used; // how many buckets are full or tombstones
+  void     **buckets; // NULL if empty, SET_DELETED if removed
+  int  (* cmp)(const void *, const void *); // NULL for pointer comparison
+  int (* hash)(const void *);               // NULL for pointer hashing
 };
 
 
-
 //*****************************************************************************
 // local functions
 //*****************************************************************************
 
 //
-// compre two elements for equality
-int gen_set_cmp(const void *key1, const void *key2) {
-  int val = (key2 - key1);
-  if(val < 0)      return -1;
-  else if(val > 0) return  1;
-  else             return  0;
-  return val;
+// spread the bits of a pointer out. The low bits are mostly alignment
+static inline unsigned long set_ptr_hash(const void *elem) {
+  unsigned long h = ((unsigned long)elem >> 3) * 0x9E3779B97F4A7C15ULL;
+  return h ^ (h >> 29);
+}
+
+static inline unsigned long set_hash(SET *set, const void *elem) {
+  return (set->hash ? (unsigned long)set->hash(elem) : set_ptr_hash(elem));
 }
 
 //
-// hash an item
-int gen_set_hash(const void *key) {
-  int val = (int)key;
-  if(val < 0) return -val;
-  else        return  val;
+// find the bucket an element is in, or -1 if it isn't in the set
+static inline int set_find(SET *set, const void *elem) {
+  unsigned int mask = set->num_buckets - 1;
+  unsigned int    i = set_hash(set, elem) & mask;
+  if(set->cmp == NULL) {
+    for(; set->buckets[i] != NULL; i = (i + 1) & mask)
+      if(set->buckets[i] == elem)
+	return i;
+  }
+  else {
+    for(; set->buckets[i] != NULL; i = (i + 1) & mask)
+      if(set->buckets[i] != SET_DELETED && !set->cmp(elem, set->buckets[i]))
+	return i;
+  }
+  return -1;
 }
 
 //
-// expand a set to the new number of buckets
+// put an element we know isn't in the set into its bucket
+void set_insert(SET *set, void *elem) {
+  unsigned int mask = set->num_buckets - 1;
+  unsigned int    i = set_hash(set, elem) & mask;
+  while(set->buckets[i] != NULL && set->buckets[i] != SET_DELETED)
+    i = (i + 1) & mask;
+  if(set->buckets[i] == NULL)
+    set->used++;
+  set->buckets[i] = elem;
+  set->size++;
+}
+
+//
+// expand a set to the new number of buckets, dropping tombstones
 void setExpand(SET *set, int size) {
-  // collect all of the key:value pairs
-  LIST *entries = setCollect(set);
-  void *entry = NULL;
+  void **old     = set->buckets;
+  int    old_num = set->num_buckets;
   int i;
 
-  // delete all of the current buckets
-  for(i = 0; i < set->num_buckets; i++) {
-    if(set->buckets[i] == NULL) continue;
-    deleteList(set->buckets[i]);
-  }
-  free(set->buckets);
-
-  // now, make new buckets and set them to NULL
-  set->buckets = calloc(size, sizeof(LIST *));
+  set->buckets     = calloc(size, sizeof(void *));
   set->num_buckets = size;
+  set->size        = 0;
+  set->used        = 0;
 
-  // now, we put all of our entries back into the new buckets
-  while((entry = listPop(entries)) != NULL) {
-    int bucket = set->hash(entry) % set->num_buckets;
-    if(set->buckets[bucket] == NULL) set->buckets[bucket] = newList();
-    listPut(set->buckets[bucket], entry);
-  }
-  deleteList(entries);
+  for(i = 0; i < old_num; i++)
+    if(old[i] != NULL && old[i] != SET_DELETED)
+      set_insert(set, old[i]);
+  free(old);
 }
 
 
@@ -86,21 +104,16 @@ void setExpand(SET *set, int size) {
 //*****************************************************************************
 SET *newSet(void) {
   SET *set         = calloc(1, sizeof(SET));
-  set->buckets     = calloc(DEFAULT_SET_SIZE, sizeof(LIST *));
+  set->buckets     = calloc(DEFAULT_SET_SIZE, sizeof(void *));
   set->num_buckets = DEFAULT_SET_SIZE;
   set->size        = 0;
-  set->cmp         = gen_set_cmp;
-  set->hash        = gen_set_hash;
+  set->used        = 0;
+  set->cmp         = NULL;
+  set->hash        = NULL;
   return set;
 }
 
 void deleteSet(SET *set) {
-  int i;
-
-  for(i = 0; i < set->num_buckets; i++)
-    if(set->buckets[i] != NULL)
-      deleteList(set->buckets[i]);
-
   free(set->buckets);
   free(set);
 };
@@ -111,61 +124,36 @@ int setSize(SET *set) {
 
 void setPut(SET *set, void *elem) {
   // only one copy per set
-  if(setIn(set, elem))
+  if(set_find(set, elem) != -1)
     return;
 
-  // first, see if we'll need to expand the table
-  if((set->size * 80)/100 > set->num_buckets)
-    setExpand(set, (set->num_buckets * 150)/100);
-
-  // find out what bucket we belong to
-  int hash_bucket = set->hash(elem) % set->num_buckets;
-
-  // add us to the bucket
-  if(set->buckets[hash_bucket] == NULL)
-    set->buckets[hash_bucket] = newList();
-  // listPut ensures only one copy is in the list
-  listPut(set->buckets[hash_bucket], elem);
-  set->size++;
+  // keep us no more than 3/4 full, counting tombstones. If we are mostly
+  // tombstones, we can clean up without growing
+  if((set->used + 1) * 4 > set->num_buckets * 3)
+    setExpand(set, ((set->size + 1) * 2 > set->num_buckets ?
+		    set->num_buckets * 2 : set->num_buckets));
+  set_insert(set, elem);
 }
 
 void *setRemove(SET *set, void *elem) {
-  // find out what bucket we belong to
-  int hash_bucket = set->hash(elem) % set->num_buckets;
-
-  // see if the bucket exists
-  if(set->buckets[hash_bucket] != NULL) {
-    if(listRemoveWith(set->buckets[hash_bucket], elem, set->cmp)) {
-      set->size--;
-      return elem;
-    }
-  }
-
-  return NULL;
+  int i = set_find(set, elem);
+  if(i == -1)
+    return NULL;
+  set->buckets[i] = SET_DELETED;
+  set->size--;
+  return elem;
 }
 
 int setIn(SET *set, const void *elem) {
-  // find out what bucket we belong to
-  int hash_bucket = set->hash(elem) % set->num_buckets;
-
-  if(set->buckets[hash_bucket] != NULL)
-    return (listGetWith(set->buckets[hash_bucket], elem, set->cmp) != NULL);
-  else
-    return 0;
+  return (set_find(set, elem) != -1);
 }
 
 LIST *setCollect(SET *set) {
   LIST *list = newList();
   int i;
-
-  for(i = 0; i < set->num_buckets; i++) {
-    if(set->buckets[i] == NULL) continue;
-    LIST_ITERATOR *list_i = newListIterator(set->buckets[i]);
-    void            *elem = NULL;
-    ITERATE_LIST(elem, list_i) {
-      listPut(list, elem);
-    } deleteListIterator(list_i);
-  }
+  for(i = 0; i < set->num_buckets; i++)
+    if(set->buckets[i] != NULL && set->buckets[i] != SET_DELETED)
+      listPut(list, set->buckets[i]);
   return list;
 }
 
@@ -173,11 +161,10 @@ SET  *setCopy(SET *set) {
   SET *newset = newSet();
   setChangeHashing(newset, set->cmp, set->hash);
   setExpand(newset, set->num_buckets);
-  SET_ITERATOR *set_i = newSetIterator(set);
-  void          *elem = NULL;
-  ITERATE_SET(elem, set_i) {
-    setPut(newset, elem);
-  } deleteSetIterator(set_i);
+  int i;
+  for(i = 0; i < set->num_buckets; i++)
+    if(set->buckets[i] != NULL && set->buckets[i] != SET_DELETED)
+      set_insert(newset, set->buckets[i]);
   return newset;
 }
 
@@ -194,11 +181,11 @@ SET  *setUnion(SET *set1, SET *set2) {
   }
 
   // copy all of the remaining elements
-  SET_ITERATOR *set_i = newSetIterator(copyfrom);
+  LOCAL_SET_ITERATOR(set_i, copyfrom);
   void          *elem = NULL;
   ITERATE_SET(elem, set_i) {
     setPut(newset, elem);
-  } deleteSetIterator(set_i);
+  } setIteratorFinish(set_i);
 
   return newset;
 }
@@ -216,18 +203,20 @@ SET  *setIntersection(SET *set1, SET *set2) {
   }
 
   // remove everything not in the intersection
-  SET_ITERATOR *set_i = newSetIterator(intersection);
+  LOCAL_SET_ITERATOR(set_i, intersection);
   void          *elem = NULL;
   ITERATE_SET(elem, set_i) {
     if(!setIn(compagainst, elem))
       setRemove(intersection, elem);
-  } deleteSetIterator(set_i);
+  } setIteratorFinish(set_i);
   return intersection;
 }
 
 void setChangeHashing(SET *set, void *cmp_func, void *hash_func) {
   set->cmp  = cmp_func;
   set->hash = hash_func;
+  // everything has to be put back where the new hash function says it goes
+  setExpand(set, set->num_buckets);
 }
 
 
@@ -238,85 +227,59 @@ void setChangeHashing(SET *set, void *cmp_func, void *hash_func) {
 // we may sometimes want to iterate across all of the elements in a set.
 // this lets us do so.
 //*****************************************************************************
-SET_ITERATOR *newSetIterator(SET *S) {
-  SET_ITERATOR *I = malloc(sizeof(SET_ITERATOR));
 
+//
+// move the iterator up to the next bucket with an element in it, starting
+// with the bucket it's on now
+void set_iterator_skip(SET_ITERATOR *I) {
+  while(I->curr_bucket < I->set->num_buckets &&
+	(I->set->buckets[I->curr_bucket] == NULL ||
+	 I->set->buckets[I->curr_bucket] == SET_DELETED))
+    I->curr_bucket++;
+}
+
+SET_ITERATOR *setIteratorInit(SET_ITERATOR *I, SET *S) {
   I->set = S;
-  I->curr_bucket = 0;
-  I->bucket_i = NULL;
   setIteratorReset(I);
-
   return I;
 }
 
 
+void setIteratorFinish(SET_ITERATOR *I) {
+  // nothing to clean up; we don't allocate anything
+}
+
+
+SET_ITERATOR *newSetIterator(SET *S) {
+  return setIteratorInit(malloc(sizeof(SET_ITERATOR)), S);
+}
+
+
 void deleteSetIterator(SET_ITERATOR *I) {
-  if(I->bucket_i) deleteListIterator(I->bucket_i);
+  setIteratorFinish(I);
   free(I);
 }
 
 
 void setIteratorReset(SET_ITERATOR *I) {
-  int i;
-
-  if(I->bucket_i) 
-    deleteListIterator(I->bucket_i);
-  I->bucket_i = NULL;
   I->curr_bucket = 0;
-
-  for(i = 0; i < I->set->num_buckets; i++) {
-    if(I->set->buckets[i] == NULL)
-      continue;
-    if(isListEmpty(I->set->buckets[i]))
-      continue;
-    else {
-      I->curr_bucket = i;
-      I->bucket_i = newListIterator(I->set->buckets[i]);
-      break;
-    }
-  }
+  set_iterator_skip(I);
 }
 
 
 void *setIteratorNext(SET_ITERATOR *I) {
-  // we have no iterator ... we have no elements left to iterate over!
-  if(I->bucket_i == NULL)
-    return NULL;
-  else {
-    void *elem = listIteratorNext(I->bucket_i);
-    // we're okay ... we have an element
-    if(elem != NULL)
-      return elem;
-    // otherwise, we need to move onto a new bucket
-    else {
-      deleteListIterator(I->bucket_i);
-      I->bucket_i = NULL;
-
-      I->curr_bucket++;
-      // find the next non-empty list
-      for(; I->curr_bucket < I->set->num_buckets; I->curr_bucket++) {
-	if(I->set->buckets[I->curr_bucket] == NULL)
-	  continue;
-	if(isListEmpty(I->set->buckets[I->curr_bucket]))
-	  continue;
-	I->bucket_i = newListIterator(I->set->buckets[I->curr_bucket]);
-	break;
-      }
-
-      // we've ran out of buckets!
-      if(I->curr_bucket == I->set->num_buckets)
-	return NULL;
-      else
-	return listIteratorCurrent(I->bucket_i);
-    }
+  if(I->curr_bucket < I->set->num_buckets) {
+    I->curr_bucket++;
+    set_iterator_skip(I);
   }
+  return setIteratorCurrent(I);
 }
 
 
 void *setIteratorCurrent(SET_ITERATOR *I) {
-  // we have no elements!
-  if(I->bucket_i == NULL)
+  // the current element may have been removed since we last moved
+  set_iterator_skip(I);
+  if(I->curr_bucket >= I->set->num_buckets)
     return NULL;
-  else
-    return listIteratorCurrent(I->bucket_i);
+  return I->set->buckets[I->curr_bucket];
 }
@@ -40,9 +40,25 @@ void setChangeHashing(SET *set, void *cmp_func, void *hash_func);
       elem != NULL; \
       setIteratorNext(it), elem = setIteratorCurrent(it))
 
+//
+// laid out here only so set iterators can live on the stack. Don't touch the
+// fields, and don't copy one once it has been started
+struct set_iterator {
+  int         curr_bucket; // the bucket number we're currently on
+  struct set_data    *set; // the set we're iterating over
+};
+
+//
+// declares a set iterator named name that lives on the stack. It must be
+// finished with setIteratorFinish instead of deleteSetIterator
+#define LOCAL_SET_ITERATOR(name, set) \
+  SET_ITERATOR name##_local; \
+  SET_ITERATOR *name = setIteratorInit(&name##_local, set)
 
 SET_ITERATOR *newSetIterator    (SET *S);
 void          deleteSetIterator (SET_ITERATOR *I);
+SET_ITERATOR *setIteratorInit   (SET_ITERATOR *I, SET *S);
+void          setIteratorFinish (SET_ITERATOR *I);
 void          setIteratorReset  (SET_ITERATOR *I);
 void         *setIteratorNext   (SET_ITERATOR *I);
 void         *setIteratorCurrent(SET_ITERATOR *I);
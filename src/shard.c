@@ -0,0 +1,294 @@
+//*****************************************************************************
+//
+// shard.c
+//
+// measuring how the game's work is spread over its zones, and planning how
+// they could be split up over shards. Zones are not actually run on shards;
+// every one of them still runs on the game thread. See shard.h
+//
+//*****************************************************************************
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "room.h"
+#include "socket.h"
+#include "pulse.h"
+#include "shard.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the most zones the shards command lists as the busiest
+#define SHARD_TOP_ZONES      10
+
+// how much work has been charged to one zone
+typedef struct {
+  char      *key;
+  long long usecs; // time spent on the zone's commands, actions, and resets
+  long long  runs; // how many pieces of work that was
+  int       shard; // where the last plan put it
+} ZONE_LOAD;
+
+// the zones we've charged work to, and the moves between pairs of them
+HASHTABLE *shard_zones = NULL;
+HASHTABLE *shard_moves = NULL;
+
+// are we measuring, and for how long have we been?
+bool       shard_on = FALSE;
+long long  shard_pulses = 0;
+long long  shard_pulse_usecs = 0;
+long long  shard_num_moves = 0;
+
+// the work going on now, and which zone it is being charged to
+int        shard_depth = 0;
+long long  shard_start = 0;
+char       shard_zone[SMALL_BUFFER];
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// get the load of a zone, making it if we have to
+ZONE_LOAD *shard_get_zone(const char *key) {
+  ZONE_LOAD *load = hashGet(shard_zones, key);
+  if(load == NULL) {
+    load = calloc(1, sizeof(ZONE_LOAD));
+    load->key = strdup(key);
+    hashPut(shard_zones, key, load);
+  }
+  return load;
+}
+
+//
+// the zone a room belongs to
+const char *shard_room_zone(ROOM_DATA *room) {
+  return get_key_locale(roomGetClass(room));
+}
+
+//
+// sorts zones, busiest first
+int shard_cmp_load(const void *a, const void *b) {
+  const ZONE_LOAD *x = *(ZONE_LOAD * const *)a, *y = *(ZONE_LOAD * const *)b;
+  if(x->usecs != y->usecs)
+    return (x->usecs > y->usecs ? -1 : 1);
+  return strcmp(x->key, y->key);
+}
+
+void shard_delete_load(ZONE_LOAD *load) {
+  free(load->key);
+  free(load);
+}
+
+//
+// start, stop, or clear measuring, or see how the zones would be dealt out
+//   usage: shards [start | stop | clear | <shards>]
+COMMAND(cmd_shards) {
+  if(!strcasecmp(arg, "start")) {
+    shardStart();
+    send_to_char(ch, "Charging work to the zones it happens in.\r\n");
+  }
+  else if(!strcasecmp(arg, "stop")) {
+    shardStop();
+    send_to_char(ch, "Stopped measuring. What was measured can still be "
+		 "planned over.\r\n");
+  }
+  else if(!strcasecmp(arg, "clear")) {
+    shardClear();
+    send_to_char(ch, "Forgot everything that was measured.\r\n");
+  }
+  else if(*arg && !isdigit(*arg))
+    send_to_char(ch, "Usage: shards [start | stop | clear | <shards>]\r\n");
+  else {
+    BUFFER *buf = newBuffer(MAX_BUFFER);
+    shardPlan(buf, (*arg ? atoi(arg) : mudsettingGetInt("zone_shards")));
+    if(charGetSocket(ch))
+      page_string(charGetSocket(ch), bufferString(buf));
+    else
+      send_to_char(ch, "%s", bufferString(buf));
+    deleteBuffer(buf);
+  }
+}
+
+
+
+//*****************************************************************************
+// implementation of shard.h
+//*****************************************************************************
+void init_shards(void) {
+  shard_zones = newHashtable();
+  shard_moves = newHashtable();
+  add_cmd("shards", NULL, cmd_shards, "admin", FALSE);
+}
+
+void shardStart(void) {
+  shard_on    = TRUE;
+  shard_depth = 0;
+}
+
+void shardStop(void) {
+  shard_on = FALSE;
+}
+
+bool shardIsMeasuring(void) {
+  return shard_on;
+}
+
+void shardClear(void) {
+  hashClearWith(shard_zones, shard_delete_load);
+  hashClearWith(shard_moves, free);
+  shard_pulses      = 0;
+  shard_pulse_usecs = 0;
+  shard_num_moves   = 0;
+}
+
+void shardBeginZone(const char *zone) {
+  if(!shard_on)
+    return;
+  if(shard_depth++ == 0) {
+    snprintf(shard_zone, sizeof(shard_zone), "%s", zone);
+    shard_start = pulse_clock();
+  }
+}
+
+void shardBegin(ROOM_DATA *room) {
+  if(shard_on)
+    shardBeginZone(room ? shard_room_zone(room) : "");
+}
+
+void shardEnd(void) {
+  if(!shard_on || shard_depth == 0 || --shard_depth > 0)
+    return;
+  // work done outside of any room stays global
+  if(*shard_zone) {
+    ZONE_LOAD *load = shard_get_zone(shard_zone);
+    load->usecs += pulse_clock() - shard_start;
+    load->runs++;
+  }
+}
+
+void shardNoteMove(ROOM_DATA *from, ROOM_DATA *to) {
+  if(!shard_on || from == NULL || to == NULL)
+    return;
+  const char *from_zone = shard_room_zone(from);
+  const char   *to_zone = shard_room_zone(to);
+  if(!strcmp(from_zone, to_zone))
+    return;
+
+  // a pair of zones is counted the same whichever way it is crossed
+  char key[SMALL_BUFFER * 2];
+  if(strcmp(from_zone, to_zone) < 0)
+    snprintf(key, sizeof(key), "%s %s", from_zone, to_zone);
+  else
+    snprintf(key, sizeof(key), "%s %s", to_zone, from_zone);
+  long long *moves = hashGet(shard_moves, key);
+  if(moves == NULL) {
+    moves = calloc(1, sizeof(long long));
+    hashPut(shard_moves, key, moves);
+    // zones people only walk through still need a shard
+    shard_get_zone(from_zone);
+    shard_get_zone(to_zone);
+  }
+  (*moves)++;
+  shard_num_moves++;
+}
+
+void shardNotePulse(long long usecs) {
+  if(!shard_on)
+    return;
+  shard_pulses++;
+  shard_pulse_usecs += usecs;
+}
+
+void shardPlan(BUFFER *buf, int shards) {
+  int         num_zones = hashSize(shard_zones), i, j;
+  ZONE_LOAD      **zones = malloc(sizeof(ZONE_LOAD *) * MAX(1, num_zones));
+  long long *shard_usecs = NULL;
+  int       *shard_count = NULL;
+  long long   zone_usecs = 0, busiest = 0, crossing = 0;
+  HASH_ITERATOR  *hash_i = newHashIterator(shard_zones);
+  const char        *key = NULL;
+  ZONE_LOAD        *load = NULL;
+  long long       *moves = NULL;
+
+  shards      = MAX(1, shards);
+  shard_usecs = calloc(shards, sizeof(long long));
+  shard_count = calloc(shards, sizeof(int));
+
+  // busiest first, each onto whichever shard is least busy so far
+  i = 0;
+  ITERATE_HASH(key, load, hash_i) {
+    zones[i++]  = load;
+    zone_usecs += load->usecs;
+  } deleteHashIterator(hash_i);
+  qsort(zones, num_zones, sizeof(ZONE_LOAD *), shard_cmp_load);
+  for(i = 0; i < num_zones; i++) {
+    int least = 0;
+    for(j = 1; j < shards; j++)
+      if(shard_usecs[j] < shard_usecs[least] ||
+	 (shard_usecs[j] == shard_usecs[least] &&
+	  shard_count[j] < shard_count[least]))
+	least = j;
+    zones[i]->shard = least;
+    shard_usecs[least] += zones[i]->usecs;
+    shard_count[least]++;
+  }
+  for(i = 0; i < shards; i++)
+    busiest = MAX(busiest, shard_usecs[i]);
+
+  // which moves would cross from one shard to another?
+  hash_i = newHashIterator(shard_moves);
+  ITERATE_HASH(key, moves, hash_i) {
+    char from[SMALL_BUFFER * 2], *to = NULL;
+    snprintf(from, sizeof(from), "%s", key);
+    if((to = strchr(from, ' ')) == NULL)
+      continue;
+    *to++ = '\0';
+    ZONE_LOAD *from_load = hashGet(shard_zones, from);
+    ZONE_LOAD   *to_load = hashGet(shard_zones, to);
+    if(from_load && to_load && from_load->shard != to_load->shard)
+      crossing += *moves;
+  } deleteHashIterator(hash_i);
+
+  // the work we couldn't charge to any zone has to run on its own
+  long long global = MAX(0, shard_pulse_usecs - zone_usecs);
+  bprintf(buf, "Measured %lld pulses%s, taking %lld usecs. %lld of them "
+	  "(%.1f%%) were charged to %d zones.\r\n", shard_pulses,
+	  (shard_on ? " so far" : ""), shard_pulse_usecs, zone_usecs,
+	  (shard_pulse_usecs ? 100.0 * zone_usecs / shard_pulse_usecs : 0.0),
+	  num_zones);
+  bprintf(buf, "\r\nIf dealt out over %d shards (a plan only; every zone "
+	  "still runs on the game thread):\r\n", shards);
+  bprintf(buf, "%5s %6s %14s\r\n", "Shard", "Zones", "Usecs");
+  for(i = 0; i < shards; i++)
+    if(shard_count[i] > 0)
+      bprintf(buf, "%5d %6d %14lld\r\n", i, shard_count[i], shard_usecs[i]);
+  bprintf(buf, "%5s %6s %14lld\r\n", "glob", "", global);
+  bprintf(buf, "\r\nA pulse could take %.1f%% as long, if the shards ran at "
+	  "once (%.2fx faster).\r\n",
+	  (shard_pulse_usecs ? 100.0 * (global + busiest) / shard_pulse_usecs :
+	   100.0),
+	  (global + busiest ? (double)shard_pulse_usecs / (global + busiest) :
+	   1.0));
+  bprintf(buf, "%lld moves between zones, %lld of them between shards "
+	  "(%.2f a pulse).\r\n", shard_num_moves, crossing,
+	  (shard_pulses ? (double)crossing / shard_pulses : 0.0));
+
+  if(num_zones > 0) {
+    bprintf(buf, "\r\nBusiest zones:\r\n");
+    bprintf(buf, "%-20s %5s %12s %14s\r\n", "Zone", "Shard", "Runs", "Usecs");
+    for(i = 0; i < num_zones && i < SHARD_TOP_ZONES; i++)
+      bprintf(buf, "%-20s %5d %12lld %14lld\r\n", zones[i]->key,
+	      zones[i]->shard, zones[i]->runs, zones[i]->usecs);
+  }
+
+  free(shard_usecs);
+  free(shard_count);
+  free(zones);
+}
@@ -0,0 +1,70 @@
+#ifndef __SHARD_H
+#define __SHARD_H
+//*****************************************************************************
+//
+// shard.h
+//
+// planning for running zones on more than one core. Nothing here runs zones
+// on shards; it only measures, and says what a split would look like.
+// Everything the game does happens on one thread, under the Python
+// interpreter lock, and almost everything it touches (mobile_list, the event
+// and action heaps, the Python that scripts share) is global, so zones can't
+// simply be handed out to worker threads yet. Before any of that is pulled
+// apart, this finds out whether it would pay: while it is measuring, the time
+// spent on commands, actions, and resets is charged to the zone they happened
+// in, movement between zones is counted, and the shards admin command deals
+// the zones out over zone_shards shards, heaviest first onto the lightest
+// shard. It then reports how busy each shard would be, how much work stays
+// global and has to run on its own, how much faster a pulse could be if the
+// shards ran at once, and how many moves would have to cross from one shard
+// to another.
+//
+// If the numbers say it pays, running zones on shards would go like so:
+//   - each shard owns the rooms, characters, objects, events, and actions of
+//     the zones planned onto it, and runs them on its own thread.
+//     mobile_list, object_list, and the event and action heaps become one
+//     per shard
+//   - anything that reaches out of a shard (a move into another shard's
+//     zone, global chat, a lookup over every character) is queued to its
+//     target as a message, and the queues are drained at pulse boundaries,
+//     while no shard is running
+//   - work that can't be charged to a zone (sockets, accounts, saving) stays
+//     on the game thread, which runs between pulses
+//   - scripts run in one Python subinterpreter per shard, or without the
+//     interpreter lock on free-threaded builds
+//
+//*****************************************************************************
+
+//
+// set up the shards command
+void init_shards(void);
+
+//
+// start or stop measuring, or forget what has been measured so far
+void shardStart(void);
+void shardStop(void);
+void shardClear(void);
+bool shardIsMeasuring(void);
+
+//
+// note that work belonging to a room's zone (or a zone, by its key) is
+// starting, or that the last work started is done. Work started inside other
+// work is charged to the outermost zone. Both cost one check when we aren't
+// measuring
+void shardBegin    (ROOM_DATA *room);
+void shardBeginZone(const char *zone);
+void shardEnd      (void);
+
+//
+// note that a character moved from one room to another
+void shardNoteMove(ROOM_DATA *from, ROOM_DATA *to);
+
+//
+// a pulse is over, and took this many microseconds
+void shardNotePulse(long long usecs);
+
+//
+// write out how the zones would be dealt out over the given number of shards
+void shardPlan(BUFFER *buf, int shards);
+
+#endif // __SHARD_H
@@ -0,0 +1,277 @@
+//*****************************************************************************
+//
+// social.c
+//
+// the table of socials do_cmd falls back on, and doing them. See social.h.
+// Performing one is a copy of what the socials Python module used to do for
+// itself, as a command per social.
+//
+//*****************************************************************************
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "handler.h"
+#include "inform.h"
+#include "command.h"
+#include "social.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+//
+// a message, in the pieces that go either side of each $X, with the
+// adjective already put in. A message with no $X is one piece
+typedef struct {
+  char **pieces;
+  int    num_pieces;
+} SOCIAL_MSSG;
+
+typedef struct {
+  SOCIAL_MSSG *mssgs[NUM_SOCIAL_MSSGS]; // NULL for ones it doesn't send
+  char        *adverb;
+  int          min_pos;
+  int          max_pos;
+  int          refs;                    // how many of our cmds it is for
+} SOCIAL_DATA;
+
+// every social, by each of its cmds
+NEAR_MAP *social_table = NULL;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// split a message at its $Xs, after putting the adjective in for its $xs
+SOCIAL_MSSG *newSocialMssg(const char *mssg, const char *adjective) {
+  if(mssg == NULL || !*mssg)
+    return NULL;
+
+  BUFFER *buf = newBuffer(1);
+  bufferCat(buf, mssg);
+  if(adjective && *adjective)
+    bufferReplace(buf, "$x", adjective, TRUE);
+
+  SOCIAL_MSSG *smssg = calloc(1, sizeof(SOCIAL_MSSG));
+  const char    *str = bufferString(buf);
+  const char    *mod = NULL;
+  while(TRUE) {
+    mod     = strstr(str, "$X");
+    int len = (mod ? (int)(mod - str) : (int)strlen(str));
+    smssg->pieces = realloc(smssg->pieces,
+			    sizeof(char *) * (smssg->num_pieces + 1));
+    smssg->pieces[smssg->num_pieces++] = strndup(str, len);
+    if(mod == NULL)
+      break;
+    str = mod + 2;
+  }
+  deleteBuffer(buf);
+  return smssg;
+}
+
+void deleteSocialMssg(SOCIAL_MSSG *smssg) {
+  int i;
+  for(i = 0; i < smssg->num_pieces; i++)
+    free(smssg->pieces[i]);
+  free(smssg->pieces);
+  free(smssg);
+}
+
+void social_unref(SOCIAL_DATA *social) {
+  int i;
+  if(--social->refs > 0)
+    return;
+  for(i = 0; i < NUM_SOCIAL_MSSGS; i++)
+    if(social->mssgs[i]) deleteSocialMssg(social->mssgs[i]);
+  if(social->adverb) free(social->adverb);
+  free(social);
+}
+
+//
+// send one of a social's messages, with the modifier in it. Does nothing if
+// the social has no such message
+void social_send(SOCIAL_DATA *social, int num, const char *modifier,
+		 CHAR_DATA *ch, CHAR_DATA *vict, bitvector_t range) {
+  SOCIAL_MSSG *smssg = social->mssgs[num];
+  int              i = 0;
+  if(smssg == NULL)
+    return;
+  if(smssg->num_pieces == 1)
+    message(ch, vict, NULL, NULL, TRUE, range, smssg->pieces[0]);
+  else {
+    BUFFER *buf = newBuffer(1);
+    for(i = 0; i < smssg->num_pieces; i++) {
+      if(i > 0)
+	bufferCat(buf, modifier);
+      bufferCat(buf, smssg->pieces[i]);
+    }
+    message(ch, vict, NULL, NULL, TRUE, range, bufferString(buf));
+    deleteBuffer(buf);
+  }
+}
+
+//
+// split what someone typed after a social into its modifier and the name of
+// its target. Either "modifier at target", or the last word is the target
+// and the words before it are the modifier. Returns whether it was the first
+bool social_parse_arg(const char *arg, char *modifier, char *target) {
+  const char *at = strstr(arg, " at ");
+  *modifier = *target = '\0';
+
+  if(at != NULL) {
+    strncat(modifier, arg, UMIN(at - arg, MAX_BUFFER - 1));
+    strncat(target, at + 4, MAX_BUFFER - 1);
+    trim(modifier);
+    trim(target);
+    return TRUE;
+  }
+
+  // go word by word, so the modifier ends up with one space between each
+  char word[MAX_BUFFER];
+  const char *rest = arg;
+  while(TRUE) {
+    while(isspace(*rest))
+      rest++;
+    if(!*rest)
+      break;
+    int len = 0;
+    while(rest[len] && !isspace(rest[len]))
+      len++;
+    snprintf(word, MAX_BUFFER, "%.*s", len, rest);
+    rest += len;
+    // the last word we found goes onto the modifier, to make room for this
+    if(*target) {
+      if(*modifier)
+	strncat(modifier, " ", MAX_BUFFER - strlen(modifier) - 1);
+      strncat(modifier, target, MAX_BUFFER - strlen(modifier) - 1);
+    }
+    strcpy(target, word);
+  }
+  return FALSE;
+}
+
+
+
+//*****************************************************************************
+// implementation of social.h
+//*****************************************************************************
+void init_social_table(void) {
+  social_table = newNearMap();
+}
+
+void socialAdd(const char *cmds, const char **mssgs,
+	       const char *adverb, const char *adjective,
+	       int min_pos, int max_pos) {
+  SOCIAL_DATA *social = calloc(1, sizeof(SOCIAL_DATA));
+  int                i = 0;
+  for(i = 0; i < NUM_SOCIAL_MSSGS; i++)
+    social->mssgs[i] = newSocialMssg(mssgs[i], adjective);
+  social->adverb  = (adverb && *adverb ? strdup(adverb) : NULL);
+  social->min_pos = min_pos;
+  social->max_pos = max_pos;
+
+  LIST       *names = parse_keywords(cmds);
+  LIST_ITERATOR *name_i = newListIterator(names);
+  char        *name = NULL;
+  ITERATE_LIST(name, name_i) {
+    if(!*name)
+      continue;
+    socialRemove(name);
+    nearMapPut(social_table, name, NULL, social);
+    social->refs++;
+  } deleteListIterator(name_i);
+  deleteListWith(names, free);
+
+  // none of our cmds were usable
+  if(social->refs == 0) {
+    social->refs = 1;
+    social_unref(social);
+  }
+}
+
+bool socialRemove(const char *cmd) {
+  SOCIAL_DATA *social = nearMapRemove(social_table, cmd);
+  if(social == NULL)
+    return FALSE;
+  social_unref(social);
+  return TRUE;
+}
+
+//
+// the first social that matches is the best, as nearMapGet would pick it
+bool social_match(const char *key, SOCIAL_DATA *social, const char **cmd) {
+  *cmd = key;
+  return FALSE;
+}
+
+const char *socialGetCmd(const char *name) {
+  const char *cmd = NULL;
+  nearMapForeachMatch(social_table, name, (void *)social_match, &cmd);
+  return cmd;
+}
+
+bool socialPerform(CHAR_DATA *ch, const char *cmd, const char *arg) {
+  SOCIAL_DATA *social = nearMapGet(social_table, cmd, FALSE);
+  char   modifier[MAX_BUFFER];
+  char     target[MAX_BUFFER];
+  CHAR_DATA   *tgt = NULL;
+  void      *found = NULL;
+  int   found_type = FOUND_NONE;
+
+  if(social == NULL)
+    return FALSE;
+  if(social->min_pos != POS_NONE && !min_pos_ok(ch, social->min_pos))
+    return FALSE;
+  if(social->max_pos != POS_NONE && !max_pos_ok(ch, social->max_pos))
+    return FALSE;
+
+  bool explicit_at = social_parse_arg((arg ? arg : ""), modifier, target);
+  if(*target)
+    found = generic_find(ch, target, FIND_TYPE_OBJ  | FIND_TYPE_CHAR |
+			 FIND_TYPE_EXIT | FIND_TYPE_IN_OBJ,
+			 FIND_SCOPE_IMMEDIATE, FALSE, &found_type);
+
+  // a lone word that isn't anyone here is how we're to do it, instead
+  if(found == NULL) {
+    if(!explicit_at && !*modifier)
+      strcpy(modifier, target);
+  }
+  else if(found_type != FOUND_CHAR) {
+    send_to_char(ch, "That individual does not seem to be here.\r\n");
+    return TRUE;
+  }
+  else
+    tgt = found;
+
+  // a modifier of our own takes the place of the social's
+  if(!*modifier && social->adverb)
+    snprintf(modifier, MAX_BUFFER, "%s", social->adverb);
+
+  // there's no target; the social is to ourself
+  if(tgt == NULL) {
+    social_send(social, SOCIAL_CHAR_NOTGT, modifier, ch, NULL, TO_CHAR);
+    social_send(social, SOCIAL_ROOM_NOTGT, modifier, ch, NULL, TO_ROOM);
+  }
+  // the target is us
+  else if(tgt == ch) {
+    social_send(social, (social->mssgs[SOCIAL_CHAR_SELF] ?
+			 SOCIAL_CHAR_SELF : SOCIAL_CHAR_NOTGT),
+		modifier, ch, NULL, TO_CHAR);
+    social_send(social, (social->mssgs[SOCIAL_ROOM_SELF] ?
+			 SOCIAL_ROOM_SELF : SOCIAL_ROOM_NOTGT),
+		modifier, ch, NULL, TO_ROOM);
+  }
+  // the target is someone else
+  else {
+    social_send(social, SOCIAL_CHAR_TGT, modifier, ch, tgt, TO_CHAR);
+    social_send(social, SOCIAL_VICT_TGT, modifier, ch, tgt, TO_VICT);
+    social_send(social, SOCIAL_ROOM_TGT, modifier, ch, tgt, TO_ROOM);
+  }
+  return TRUE;
+}
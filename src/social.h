@@ -0,0 +1,58 @@
+#ifndef __SOCIAL_H
+#define __SOCIAL_H
+//*****************************************************************************
+//
+// social.h
+//
+// socials are pre-made emotes (e.g. smile, grin, laugh) that can be aimed at
+// someone, or not, and given a modifier of one's own (grin evilly at bob).
+// There are hundreds of them, so they are kept out of the command table,
+// where every command lookup would have to go past them. Once nothing in the
+// command tables goes by a word, do_cmd sees if a social does.
+//
+// Which socials there are is up to the socials Python module. It hands each
+// one over with mudsys.add_social, and we keep its messages ready to send:
+// the adjective is already in them, and they are split wherever the modifier
+// goes. Positions are checked here as well, before anything is sent.
+//
+//*****************************************************************************
+
+// the messages a social sends
+#define SOCIAL_CHAR_NOTGT      0 // to us, when there is no target
+#define SOCIAL_ROOM_NOTGT      1 // to the room, when there is no target
+#define SOCIAL_CHAR_SELF       2 // to us, when we are the target
+#define SOCIAL_ROOM_SELF       3 // to the room, when we are the target
+#define SOCIAL_CHAR_TGT        4 // to us, when someone else is the target
+#define SOCIAL_VICT_TGT        5 // to them
+#define SOCIAL_ROOM_TGT        6 // and to the room
+#define NUM_SOCIAL_MSSGS       7
+
+//
+// set up the social table
+void init_social_table(void);
+
+//
+// add a social under each of the comma-separated cmds, replacing whatever
+// social they were for before. mssgs has NUM_SOCIAL_MSSGS entries, any of
+// which can be NULL or empty. In each, $x is the adjective and $X the
+// modifier the social is done with (adverb, if none is given). min_pos and
+// max_pos can be POS_NONE
+void socialAdd(const char *cmds, const char **mssgs,
+	       const char *adverb, const char *adjective,
+	       int min_pos, int max_pos);
+
+//
+// stop cmd from being a social. Returns FALSE if it wasn't one
+bool socialRemove(const char *cmd);
+
+//
+// the full name of the social a word is for, abbreviations and all, or NULL
+// if there is none. The name is only good until the socials change
+const char *socialGetCmd(const char *name);
+
+//
+// do the social cmd (by its full name), with the given argument. Returns
+// FALSE if the character wasn't in a position to, or there is no such social
+bool socialPerform(CHAR_DATA *ch, const char *cmd, const char *arg);
+
+#endif // __SOCIAL_H
@@ -10,36 +10,82 @@
 #include "wrapsock.h"
 #include <netdb.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h> 
 #include <zlib.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "mud.h"
 #include "character.h"
 #include "account.h"
 #include "save.h"
+#include "save_queue.h"
+#include "log_queue.h"
+#include "journal.h"
 #include "utils.h"
 #include "socket.h"
 #include "auxiliary.h"
 #include "hooks.h"
+#include "poller.h"
+#include "spsc_queue.h"
+#include "worker_pool.h"
+#include "listener.h"
+#include "resolver.h"
+#include "tls.h"
+#include "websocket.h"
+#include "world.h"
+#include "room.h"
+#include "action.h"
+#include "pulse.h"
+#include "replay.h"
+#include "colour.h"
+#include "storage.h"
 #include "scripts/scripts.h"
 #include "scripts/pyplugs.h"
 #include "dyn_vars/dyn_vars.h"
 
 
 
-//*****************************************************************************
-// optional modules
-//*****************************************************************************
-#ifdef MODULE_ALIAS
-#include "alias/alias.h"
-#endif
-
 // provides a unique identifier number to every socket that connects to the
 // mud. Used mostly for referring to sockets in Python
 #define START_SOCK_UID           1
 int next_sock_uid = START_SOCK_UID;
 
+// where in socket_list the next pulse's input pass starts
+unsigned int input_rotation = 0;
+
+
+// how much shared output a socket can have queued before it is copied into
+// its outbuf
+#define MAX_SHARED_FRAGS        16
+
+//
+// output that is the same for many sockets (e.g. a message to everyone in a
+// room), made once and queued to each of them without being copied
+struct out_frag {
+  char     *text;
+  int        len;
+  int       refs;
+  // our text with its colour codes translated, for each colour mode. NULL
+  // if it hasn't been yet, or if there was nothing to translate
+  BUFFER   *rendered[NUM_COLOUR_MODES];
+  bool  translated[NUM_COLOUR_MODES];
+};
+
+// commands this long or shorter are kept right in their command history
+// slot. Longer ones are copied off to the heap
+#define CMD_HIST_SLOT_LEN       64
+
+typedef struct {
+  char     text[CMD_HIST_SLOT_LEN];
+  char *long_text;
+} HIST_SLOT;
+
+// how many buckets our command latency histograms have. The last holds
+// everything that took longer than about 8 seconds
+#define CMD_LATENCY_BUCKETS     24
 
 //
 // Here it is... the big ol' datastructure for sockets. Yum.
@@ -47,32 +93,114 @@ struct socket_data {
   CHAR_DATA     * player;
   ACCOUNT_DATA  * account;
   char          * hostname;
-  char            inbuf[MAX_INPUT_LEN];
+  char            inbuf[MAX_INPUT_LEN]; // a ring of input waiting to be
+  int             in_start;      //   decoded. in_start is where the oldest
+  int             in_len;        //   byte is, and in_len how many there are
   BUFFER        * next_command;
   BUFFER        * iac_sequence;
   // char            next_command[MAX_BUFFER];
   bool            cmd_read;
+  bool            cmd_expanded;  // did our command come from an expansion?
   bool            bust_prompt;
+  int             colour_mode;   // what our colour codes are translated to
   bool            closed;
   int             lookup_status;
   int             control;
+  TLS_CONN      * tls;           // if we connected to a tls_port
+  WS_CONN       * ws;            // if we connected to a ws_port or wss_port
   int             uid;
-  double          idle;          // how many pulses have we been idle for?
+  long long       active_pulse;  // the pulse we last sent a command on
+  bool            afk;           // have we been idle for afk_seconds?
+  bool            handed_off;    // is an upgrade taking us over?
+  long long       idle_due;      // the second we're due on the idle wheel,
+  LIST_NODE     * idle_node;     //   and where we wait on it, if we are
+
+  // how long, from the start of the pulse's input pass, our commands took
+  // to finish. Bucket N holds the ones that took under 2^N microseconds
+  unsigned int    latency[CMD_LATENCY_BUCKETS];
+  long long       latency_cmds;
+  long long       latency_max;
+
+  // how many lines we can send before we are throttled, in 1/PULSES_PER_SECOND
+  // of a line, as of the pulse in_refilled names. See input flood control
+  long long       in_tokens;
+  long long       in_refilled;
+  bool            in_held;       // is next_command waiting on a token?
+  bool            in_unwatched;  // have we stopped reading from the socket?
+  bool            in_last_noop;  // did our last command change nothing?
+  int             in_strikes;    // seconds in a row we have been throttled,
+  long long       in_strike_sec; //   and the last of them
+  long long       in_snooze_end; // the pulse our snooze is over on, if any
+  long long       in_dropped;    // repeats we haven't run, and how many
+  long long       in_snoozes;    //   times we have been snoozed
 
   char          * page_string;   // the string that has been paged to us
+  int           * page_offsets;  // where each page starts in page_string,
+                                 //   followed by where the last one ends
   int             curr_page;     // the current page we're on
   int             tot_pages;     // the total number of pages the string has
   
   BUFFER        * text_editor;   // where we do our actual work
   BUFFER        * outbuf;        // our buffer of pending output
+  BUFFER        * sendbuf;       // finished output, set aside while we build
+                                 // our prompt in outbuf during a flush
+  OUT_FRAG      * frags[MAX_SHARED_FRAGS]; // shared output that comes after
+  int             num_frags;     //   what is in outbuf, in the order we got it
+
+  long long       out_since;     // when our oldest held back output was made
+
+  // the writes we've made and bytes we've written. The counts for the
+  // second that io_second names build up in io_writes and io_bytes, and the
+  // last full second's are moved to writes_per_sec and bytes_per_sec
+  long long       io_second;
+  int             io_writes;
+  long long       io_bytes;
+  int             writes_per_sec;
+  long long       bytes_per_sec;
+  long long       tot_writes;
+  long long       tot_bytes;
+
+  char          * outq;          // a ring buffer of output the client has not
+  int             outq_size;     //   accepted from us yet, because its end of
+  int             outq_start;    //   the connection is full. We send the rest
+  int             outq_len;      //   when the poller says we are writable
+  bool            outq_writing;  // are we watching for writability?
+
+  // when input threads are running, a worker reads and decodes our input
+  // (inbuf, iac_sequence and io_line belong to it), and hands the game thread
+  // complete lines and IAC sequences through io_queue
+  SPSC_QUEUE    * io_queue;      // decoded input waiting for the game thread
+  LIST          * io_backlog;    // decoded input that didn't fit in io_queue
+  BUFFER        * io_line;       // the line a worker is in the middle of
+  atomic_int      io_busy;       // is a worker handling our input right now?
+  atomic_int      io_stalled;    // is there input left that we must go back
+                                 // for even if no more arrives on the socket?
 
   LIST          * input_handlers;// a stack of our input handlers and prompts
   LIST          * input;         // lines of input we have received
-  LIST          * command_hist;  // the commands we've executed in the past
+  HIST_SLOT     * hist;          // a ring of the commands we've executed in
+  int             hist_size;     //   the past. hist_next is where the next
+  int             hist_next;     //   one goes, and hist_len how many of the
+  int             hist_len;      //   slots are filled
 
   unsigned char   compressing;                 /* MCCP support */
   z_stream      * out_compress;                /* MCCP support */
   unsigned char * out_compress_buf;            /* MCCP support */
+  int             compress_level;              /* MCCP support */
+  bool            compress_raw;  // are we continuing a stream someone else
+                                 // started, e.g. before a hot copyover?
+  unsigned long   compress_adler;// if so, the checksum of everything in it
+  atomic_llong    comp_raw;      // how much output has gone into deflate,
+  atomic_llong    comp_bytes;    //   how much came out of it, and how many
+  atomic_llong    comp_usec;     //   usec of CPU time it took
+
+  // when compression threads are running, our output is compressed by a
+  // worker (which owns out_compress while comp_busy is set). Output goes to
+  // it in order through comp_in, and comes back compressed through comp_out
+  SPSC_QUEUE    * comp_in;       // output waiting to be compressed
+  SPSC_QUEUE    * comp_out;      // compressed output waiting to be sent
+  LIST          * comp_backlog;  // output that didn't fit in comp_in
+  atomic_int      comp_busy;     // is a worker compressing our output?
 
   AUX_TABLE     * auxiliary;     // auxiliary data installed by other modules
 };
@@ -91,23 +219,108 @@ typedef struct input_handler_data {
 
 
 //
-// required for looking up a socket's IP in a new thread
-typedef struct lookup_data {
-  SOCKET_DATA    * dsock;   // the socket we wish to do a hostlookup on
-  char           * buf;     // the buffer it should be stored in 
-} LOOKUP_DATA;
+// a command waiting in our input list, to be used before whatever is in
+// inbuf. Expanded commands were put there by something like an alias
+typedef struct queued_cmd {
+  bool expanded;
+  char    cmd[];
+} QUEUED_CMD;
+
+
+//
+// a piece of decoded input, handed from an input worker to the game thread
+typedef struct input_item {
+  int    type;   // one of the INPUT_ types below
+  int     len;   // how long is data?
+  char data[];   // a line of input, or an IAC sequence
+} INPUT_ITEM;
+
+#define INPUT_LINE             0 // a complete line of input
+#define INPUT_IAC              1 // a complete IAC sequence
+#define INPUT_CLOSE            2 // the socket was closed, or had an error
+#define INPUT_OVERFLOW         3 // the socket sent a line that was too long
 
+// how much decoded input a socket can have waiting for the game thread
+#define INPUT_QUEUE_SIZE     256
 
+// a piece of output going to or coming back from a compression worker
+typedef struct compress_item {
+  int   len;   // how long is data? -1 if compressing it failed
+  int level;   // the deflate level to compress data at
+  char data[];
+} COMPRESS_ITEM;
 
-/* global variables */
-fd_set        fSet;             /* the socket list for polling       */
-fd_set        rFd;
+// how many pieces of output a socket can have waiting to be compressed
+#define COMPRESS_QUEUE_SIZE   64
+
+// the i'th byte of input waiting in a socket's inbuf
+#define INBUF_CH(dsock, i) \
+  ((dsock)->inbuf[((dsock)->in_start + (i)) % MAX_INPUT_LEN])
+
+// the results of trying to read input from a socket
+#define INPUT_READ_OK          0
+#define INPUT_READ_CLOSED      1
+#define INPUT_READ_OVERFLOW    2
+
+
+
+// the pool of threads that read and decode input, if we are using one
+WORKER_POOL *input_pool = NULL;
+
+// is the socket's input read and decoded by a worker? TLS and WebSocket
+// sockets are read on the game thread, which also uses their state to send
+// to them
+#define INPUT_THREADED(dsock)   (input_pool != NULL && (dsock)->tls == NULL &&\
+				 (dsock)->ws == NULL)
+
+// the pool of threads that compress output for MCCP, if we are using one
+WORKER_POOL *compress_pool = NULL;
+
+// where WebSocket frames are put together on their way out
+BUFFER *ws_frames = NULL;
+
+// how many bytes every socket has read and written since boot, and how many
+// bytes of MCCP output went into deflate, and how many came out. Input is
+// read, and output compressed, on worker threads, so these are atomic
+atomic_llong total_bytes_read        = 0;
+atomic_llong total_bytes_written     = 0;
+atomic_llong total_mccp_raw          = 0;
+atomic_llong total_mccp_compressed   = 0;
+atomic_llong total_mccp_usec         = 0;
+
+// did the last pulse run long enough that we should compress less?
+bool compress_busy = FALSE;
 
 /* mccp support */
 const unsigned char compress_will   [] = { IAC, WILL, TELOPT_COMPRESS,  '\0' };
 const unsigned char compress_will2  [] = { IAC, WILL, TELOPT_COMPRESS2, '\0' };
 const unsigned char go_ahead [] = { IAC, GA, '\0' };
 
+//
+// the hooks we run for every socket, every pulse, are run by id
+int flush_hook                    = -1;
+int process_outbound_text_hook    = -1;
+int finalize_outbound_text_hook   = -1;
+int process_outbound_prompt_hook  = -1;
+int finalize_outbound_prompt_hook = -1;
+
+// local functions
+void deleteSocket(SOCKET_DATA *sock);
+SOCKET_DATA *socket_pool_get(void);
+void socket_pool_put(SOCKET_DATA *sock);
+bool processCompressed(SOCKET_DATA *dsock);
+bool outq_drain(SOCKET_DATA *dsock);
+void input_push(SOCKET_DATA *dsock, int type, const char *data, int len);
+bool vector_to_socket(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt);
+void compress_prepare(SOCKET_DATA *dsock, int length);
+bool compress_queue(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt);
+bool compress_collect(SOCKET_DATA *dsock);
+bool compress_sync(SOCKET_DATA *dsock);
+void input_pop_command(SOCKET_DATA *dsock);
+void socket_idle_schedule(SOCKET_DATA *sock);
+void socket_idle_unschedule(SOCKET_DATA *sock);
+bool socket_ws_reply(SOCKET_DATA *dsock);
+
 // used to delete an input handler pair
 void deleteInputHandler(IH_PAIR *pair) {
   if(!pair) return;
@@ -119,76 +332,52 @@ void deleteInputHandler(IH_PAIR *pair) {
   free(pair);
 }
 
-/*
- * Init_socket()
- *
- * Used at bootup to get a free
- * socket to run the server from.
- */
-int init_socket()
-{
-  struct sockaddr_in my_addr;
-  int sockfd, reuse = 1;
-
-  /* let's grab a socket */
-  sockfd = socket(AF_INET, SOCK_STREAM, 0);
-
-  /* setting the correct values */
-  my_addr.sin_family = AF_INET;
-  my_addr.sin_addr.s_addr = INADDR_ANY;
-  my_addr.sin_port = htons(mudport);
-
-  /* this actually fixes any problems with threads */
-  if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(int)) == -1)
-  {
-    perror("Error in setsockopt()");
-    exit(1);
-  } 
-
-  /* bind the port */
-  bind(sockfd, (struct sockaddr *) &my_addr, sizeof(struct sockaddr));
-
-  /* start listening already :) */
-  listen(sockfd, 3);
-
-  /* return the socket */
-  return sockfd;
-}
-
-
 /* 
  * New_socket()
  *
  * Initializes a new socket, get's the hostname
  * and puts it in the active socket_list.
  */
-SOCKET_DATA *new_socket(int sock)
+SOCKET_DATA *new_socket(int sock, int flags)
 {
-  struct sockaddr_in   sock_addr;
-  pthread_attr_t       attr;
-  pthread_t            thread_lookup;
-  LOOKUP_DATA        * lData;
-  SOCKET_DATA        * sock_new;
-  int                  argp = 1;
-  socklen_t            size;
-
-  /* initialize threads */
-  pthread_attr_init(&attr);   
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  struct sockaddr_storage sock_addr;
+  char                    addr[INET6_ADDRSTRLEN];
+  SOCKET_DATA           * sock_new;
+  const char            * cached;
+  int                     argp = 1;
+  socklen_t               size;
 
   /* create and clear the socket */
-  sock_new = calloc(1, sizeof(SOCKET_DATA));
-
-  /* attach the new connection to the socket list */
-  FD_SET(sock, &fSet);
+  sock_new = socket_pool_get();
 
   /* clear out the socket */
   clear_socket(sock_new, sock);
   sock_new->closed = FALSE;
 
+  /* start watching the new connection for input */
+  if(!pollerAdd(sock, sock_new, POLLER_READ)) {
+    close(sock);
+    socket_pool_put(sock_new);
+    return NULL;
+  }
+
   /* set the socket as non-blocking */
   ioctl(sock, FIONBIO, &argp);
 
+  /* everything we send waits until the handshake is done */
+  if ((flags & LISTENER_TLS) && (sock_new->tls = newTlsConn(sock)) == NULL)
+  {
+    socket_idle_unschedule(sock_new);
+    pollerRemove(sock);
+    close(sock);
+    socket_pool_put(sock_new);
+    return NULL;
+  }
+
+  /* and, on top of TLS if there is any, until the upgrade is done */
+  if (flags & LISTENER_WS)
+    sock_new->ws = newWsConn();
+
   /* update the socket list and table */
   listPut(socket_list, sock_new);
   propertyTablePut(sock_table, sock_new);
@@ -200,28 +389,29 @@ SOCKET_DATA *new_socket(int sock)
     perror("New_socket: getpeername");
     sock_new->hostname = strdup("unknown");
   }
+  /* not a network connection (e.g. one end of a socketpair) */
+  else if (addrToString(&sock_addr, addr, sizeof(addr)) == NULL)
+  {
+    sock_new->hostname = strdup("localhost");
+    sock_new->lookup_status++;
+  }
   else
   {
     /* set the IP number as the temporary hostname */
-    sock_new->hostname = strdup(inet_ntoa(sock_addr.sin_addr));
+    sock_new->hostname = strdup(addr);
 
-    if (!compares(sock_new->hostname, "127.0.0.1"))
+    if (addrIsLoopback(addr))
+      sock_new->lookup_status++;
+    /* have we looked this address up recently? */
+    else if ((cached = resolverCacheGet(addr)) != NULL)
     {
-      /* allocate some memory for the lookup data */
-      if ((lData = malloc(sizeof(*lData))) == NULL)
-      {
-        bug("New_socket: Cannot allocate memory for lookup data.");
-        abort();
-      }
-
-      /* Set the lookup_data for use in lookup_address() */
-      lData->buf    =  strdup((char *) &sock_addr.sin_addr);
-      lData->dsock  =  sock_new;
-
-      /* dispatch the lookup thread */
-      pthread_create(&thread_lookup, &attr, &lookup_address, (void*) lData);
+      free(sock_new->hostname);
+      sock_new->hostname = strdup(cached);
+      sock_new->lookup_status++;
     }
-    else sock_new->lookup_status++;
+    /* ask the resolver. If it's too busy, the IP will have to do */
+    else if (!resolverLookup(&sock_addr, sock_new))
+      sock_new->lookup_status++;
   }
 
   /* negotiate compression */
@@ -247,9 +437,11 @@ void close_socket(SOCKET_DATA *dsock, bool reconnect)
 {
   if (dsock->lookup_status > TSTATE_DONE) return;
   dsock->lookup_status += 2;
+  replayRecordClose(dsock);
+  socket_idle_unschedule(dsock);
 
   /* remove the socket from the polling list */
-  FD_CLR(dsock->control, &fSet);
+  pollerRemove(dsock->control);
 
   /* remove ourself from the list */
   //
@@ -290,190 +482,569 @@ void close_socket(SOCKET_DATA *dsock, bool reconnect)
 }
 
 
+//
+// is there input that has been read off the socket, but not handed back to
+// us yet? The poller won't tell us about it, so it has to be read without
+// waiting for an event
+bool socket_input_pending(SOCKET_DATA *dsock) {
+  return ((dsock->ws  && wsPending(dsock->ws)) ||
+	  (dsock->tls && tlsPending(dsock->tls)));
+}
+
+//
+// like readv, but through TLS if the socket has it
+ssize_t socket_readv_wire(SOCKET_DATA *dsock, const struct iovec *iov,
+			  int iovcnt) {
+  if(dsock->tls)
+    return tlsReadv(dsock->tls, iov, iovcnt);
+  return readv(dsock->control, iov, iovcnt);
+}
+
+//
+// like readv, but for a WebSocket, whose frames are read off the wire and
+// decoded into iov. Returns 0 when the client has closed the connection
+ssize_t socket_ws_readv(SOCKET_DATA *dsock, const struct iovec *iov,
+			int iovcnt) {
+  struct iovec wire;
+  ssize_t   sInput = 0;
+  int         room = 0;
+
+  // only read more once we're done with the frames we already have
+  if (!wsPending(dsock->ws))
+  {
+    wire.iov_base = wsReadBuf(dsock->ws, &room);
+    wire.iov_len  = room;
+    if ((sInput = socket_readv_wire(dsock, &wire, 1)) <= 0)
+      return sInput;
+    wsReadDone(dsock->ws, sInput);
+  }
+
+  // answer the handshake, pings, and closes
+  sInput = wsDecode(dsock->ws, iov, iovcnt);
+  if (!socket_ws_reply(dsock) || sInput == WS_CLOSED)
+    return 0;
+  if (sInput == 0)
+  {
+    errno = EAGAIN;
+    return -1;
+  }
+  return sInput;
+}
+
+//
+// like readv, but through whatever the socket speaks
+ssize_t socket_readv(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt) {
+  if(dsock->ws)
+    return socket_ws_readv(dsock, iov, iovcnt);
+  return socket_readv_wire(dsock, iov, iovcnt);
+}
+
+
 /* 
- * Read_from_socket()
+ * Read_socket_input()
  *
- * Reads one line from the socket, storing it
- * in a buffer for later use. Will also close
- * the socket if it tries a buffer overflow.
+ * Reads whatever input is waiting on the socket, storing
+ * it in the inbuf for decoding. Returns INPUT_READ_OK if
+ * all went well, INPUT_READ_CLOSED if the socket closed or
+ * had an error, or INPUT_READ_OVERFLOW if someone tries a
+ * buffer overflow. Safe to call from an input worker.
  */
-bool read_from_socket(SOCKET_DATA *dsock)
+int read_socket_input(SOCKET_DATA *dsock)
 {
-  int size;
   extern int errno;
 
-  /* check for buffer overflows, and drop connection in that case */
-  size = strlen(dsock->inbuf);
-  if (size >= sizeof(dsock->inbuf) - 2)
-  {
-    text_to_socket(dsock, "\n\r!!!! Input Overflow !!!!\n\r");
-    return FALSE;
-  }
+  /* check for buffer overflows */
+  if (dsock->in_len >= MAX_INPUT_LEN - 2)
+    return INPUT_READ_OVERFLOW;
 
   /* start reading from the socket */
   for (;;)
   {
-    int sInput;
-    int wanted = sizeof(dsock->inbuf) - 2 - size;
+    struct iovec iov[2];
+    int sInput, iovcnt = 1;
+    int wanted = MAX_INPUT_LEN - 2 - dsock->in_len;
+    int   tail = (dsock->in_start + dsock->in_len) % MAX_INPUT_LEN;
 
-    sInput = read(dsock->control, dsock->inbuf + size, wanted);
+    /* full up; whatever is left can wait for the next read */
+    if (wanted <= 0)
+      break;
 
-    if (sInput > 0)
+    /* the free space in our ring may wrap around the end of inbuf */
+    iov[0].iov_base = dsock->inbuf + tail;
+    iov[0].iov_len  = MIN(wanted, MAX_INPUT_LEN - tail);
+    if (iov[0].iov_len < wanted)
     {
-      size += sInput;
+      iov[1].iov_base = dsock->inbuf;
+      iov[1].iov_len  = wanted - iov[0].iov_len;
+      iovcnt++;
+    }
+
+    sInput = socket_readv(dsock, iov, iovcnt);
 
-      if (dsock->inbuf[size-1] == '\n' || dsock->inbuf[size-1] == '\r')
+    if (sInput > 0)
+    {
+      dsock->in_len += sInput;
+      atomic_fetch_add(&total_bytes_read, sInput);
+
+      /* TLS and WebSockets may have read more than they have */
+      /* given us, and the poller won't tell us about it      */
+      if ((INBUF_CH(dsock, dsock->in_len-1) == '\n' || 
+	   INBUF_CH(dsock, dsock->in_len-1) == '\r') &&
+	  !socket_input_pending(dsock))
         break;
     }
     else if (sInput == 0)
     {
       log_string("Read_from_socket: EOF");
-      return FALSE;
+      return INPUT_READ_CLOSED;
     }
     else if (errno == EAGAIN || sInput == wanted)
       break;
     else
     {
       perror("Read_from_socket");
-      return FALSE;
+      return INPUT_READ_CLOSED;
     }
   }
-  dsock->inbuf[size] = '\0';
-  return TRUE;
+  return INPUT_READ_OK;
 }
 
 
-/*
- * Text_to_socket()
+/* 
+ * Read_from_socket()
  *
- * Sends text directly to the socket,
- * will compress the data if needed.
+ * Reads one line from the socket, storing it
+ * in a buffer for later use. Will also close
+ * the socket if it tries a buffer overflow.
  */
-bool text_to_socket(SOCKET_DATA *dsock, const char *txt)
+bool read_from_socket(SOCKET_DATA *dsock)
 {
-  int iBlck, iPtr, iWrt = 0, length, control = dsock->control;
+  int status = read_socket_input(dsock);
+  if (status == INPUT_READ_OVERFLOW)
+    text_to_socket(dsock, "\n\r!!!! Input Overflow !!!!\n\r");
+  return (status == INPUT_READ_OK);
+}
 
-  length = strlen(txt);
 
-  /* write compressed */
-  if (dsock && dsock->out_compress)
-  {
-    dsock->out_compress->next_in  = (unsigned char *) txt;
-    dsock->out_compress->avail_in = length;
+//*****************************************************************************
+// outbound queue
+//
+// sockets are non-blocking, so a client that is slow to read what we send it
+// cannot hold up the game loop. Whatever the kernel won't take right away
+// gets queued up on the socket, and is sent when the socket becomes writable
+// again. A client that lets too much output pile up is either cut off from
+// new output, or disconnected, depending on the output_overflow setting.
+// Compressed, WebSocket, and TLS streams can't have output cut out of them,
+// so those clients are always disconnected.
+//*****************************************************************************
+#define OUTQ_START_SIZE       4096
 
-    while (dsock->out_compress->avail_in)
-    {
-      dsock->out_compress->avail_out = COMPRESS_BUF_SIZE - (dsock->out_compress->next_out - dsock->out_compress_buf);
+//
+// start or stop watching the socket for writability, depending on whether
+// we have any output queued up for it. During a TLS handshake, our output
+// waits, and it's the handshake's own writes we watch for
+void outq_update_interest(SOCKET_DATA *dsock) {
+  bool want_write = (dsock->tls && tlsHandshaking(dsock->tls) ?
+		     tlsWantsWrite(dsock->tls) : dsock->outq_len > 0);
+  bool  want_read = !(dsock->in_held || dsock->in_snooze_end > 0);
+  // closed sockets have already been removed from the poller
+  if((want_write == dsock->outq_writing && want_read != dsock->in_unwatched)||
+     dsock->lookup_status > TSTATE_DONE)
+    return;
+  dsock->outq_writing = want_write;
+  dsock->in_unwatched = !want_read;
+  pollerModify(dsock->control, dsock, (want_read ? POLLER_READ : 0) |
+	       (want_write ? POLLER_WRITE : 0));
+}
 
-      if (dsock->out_compress->avail_out)
-      {
-        int status = deflate(dsock->out_compress, Z_SYNC_FLUSH);
+//
+// make sure the queue has room for len more bytes. When we have to grow, the
+// contents are unwrapped so they start at the beginning of the new queue
+void outq_reserve(SOCKET_DATA *dsock, int len) {
+  if(dsock->outq_len + len <= dsock->outq_size)
+    return;
 
-        if (status != Z_OK)
-        return FALSE;
-      }
+  int new_size = (dsock->outq_size > 0 ? dsock->outq_size : OUTQ_START_SIZE);
+  while(new_size < dsock->outq_len + len)
+    new_size *= 2;
 
-      length = dsock->out_compress->next_out - dsock->out_compress_buf;
-      if (length > 0)
-      {
-        for (iPtr = 0; iPtr < length; iPtr += iWrt)
-        {
-          iBlck = UMIN(length - iPtr, 4096);
-          if ((iWrt = write(control, dsock->out_compress_buf + iPtr, iBlck)) < 0)
-          {
-            perror("Text_to_socket (compressed):");
-            return FALSE;
-          }
-        }
-        if (iWrt <= 0) break;
-        if (iPtr > 0)
-        {
-          if (iPtr < length)
-            memmove(dsock->out_compress_buf, dsock->out_compress_buf + iPtr, length - iPtr);
-
-          dsock->out_compress->next_out = dsock->out_compress_buf + length - iPtr;
-        }
+  char *new_q = malloc(new_size);
+  if(dsock->outq_len > 0) {
+    int first = UMIN(dsock->outq_len, dsock->outq_size - dsock->outq_start);
+    memcpy(new_q, dsock->outq + dsock->outq_start, first);
+    memcpy(new_q + first, dsock->outq, dsock->outq_len - first);
+  }
+  if(dsock->outq) free(dsock->outq);
+  dsock->outq       = new_q;
+  dsock->outq_size  = new_size;
+  dsock->outq_start = 0;
+}
+
+//
+// add data to the end of the outbound queue
+void outq_append(SOCKET_DATA *dsock, const char *data, int len) {
+  outq_reserve(dsock, len);
+  int tail  = (dsock->outq_start + dsock->outq_len) % dsock->outq_size;
+  int first = UMIN(len, dsock->outq_size - tail);
+  memcpy(dsock->outq + tail, data, first);
+  memcpy(dsock->outq, data + first, len - first);
+  dsock->outq_len += len;
+}
+
+//
+// if the second our write counts are for is over, move them to our rates
+void socket_io_roll(SOCKET_DATA *dsock) {
+  long long second = pulse_clock() / 1000000;
+  if(second != dsock->io_second) {
+    // if a whole second went by with nothing written, our rate was 0
+    dsock->writes_per_sec = (second == dsock->io_second+1 ? dsock->io_writes:0);
+    dsock->bytes_per_sec  = (second == dsock->io_second+1 ? dsock->io_bytes :0);
+    dsock->io_second      = second;
+    dsock->io_writes      = 0;
+    dsock->io_bytes       = 0;
+  }
+}
+
+//
+// count a write we made to the socket, and how much of our output it took
+void socket_note_write(SOCKET_DATA *dsock, int bytes) {
+  socket_io_roll(dsock);
+  dsock->io_writes++;
+  dsock->tot_writes++;
+  if(bytes > 0) {
+    dsock->io_bytes  += bytes;
+    dsock->tot_bytes += bytes;
+    atomic_fetch_add(&total_bytes_written, bytes);
+  }
+}
+
+//
+// is the socket's output waiting for its TLS handshake to finish?
+bool socket_tls_waiting(SOCKET_DATA *dsock) {
+  return (dsock->tls != NULL && tlsHandshaking(dsock->tls));
+}
+
+//
+// like writev, but through TLS if the socket has it
+ssize_t socket_writev(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt){
+  if(dsock->tls)
+    return tlsWritev(dsock->tls, iov, iovcnt);
+  return writev(dsock->control, iov, iovcnt);
+}
+
+//
+// send as much of our queued output as the client will accept. Returns FALSE
+// if there was an error writing to the socket
+bool outq_drain(SOCKET_DATA *dsock) {
+  while(dsock->outq_len > 0 && !socket_tls_waiting(dsock)) {
+    struct iovec iov;
+    int chunk = UMIN(dsock->outq_len, dsock->outq_size - dsock->outq_start);
+    iov.iov_base = dsock->outq + dsock->outq_start;
+    iov.iov_len  = chunk;
+    int wrote = socket_writev(dsock, &iov, 1);
+    socket_note_write(dsock, wrote);
+    if(wrote < 0) {
+      if(errno == EINTR)
+	continue;
+      if(errno == EAGAIN || errno == EWOULDBLOCK)
+	break;
+      perror("outq_drain");
+      return FALSE;
+    }
+    if(wrote == 0)
+      break;
+    dsock->outq_start = (dsock->outq_start + wrote) % dsock->outq_size;
+    dsock->outq_len  -= wrote;
+  }
+  if(dsock->outq_len == 0)
+    dsock->outq_start = 0;
+  outq_update_interest(dsock);
+  return TRUE;
+}
+
+//
+// carry on a TLS socket's handshake, after the poller said it could. Once
+// it's done, send the output that was waiting on it, and read anything the
+// client sent along with the end of it. Returns FALSE if the handshake failed
+bool socket_tls_handshake(SOCKET_DATA *dsock) {
+  switch(tlsHandshake(dsock->tls)) {
+  case TLS_HANDSHAKE_ERROR:
+    return FALSE;
+  case TLS_HANDSHAKE_DONE:
+    return (outq_drain(dsock) && read_from_socket(dsock));
+  default:
+    outq_update_interest(dsock);
+    return TRUE;
+  }
+}
+
+//
+// can output the client is too far behind on be thrown away? Not if we were
+// told to disconnect them, and not out of the middle of a compressed, framed,
+// or encrypted stream, where the rest of it would stop making sense
+bool outq_can_drop(SOCKET_DATA *dsock) {
+  return (!dsock->out_compress && dsock->ws == NULL && dsock->tls == NULL &&
+	  !strcasecmp(OUTPUT_OVERFLOW, "drop"));
+}
+
+//
+// queue up what the client wouldn't take of a write, the first sent bytes of
+// which did make it out, unless they are already too far behind. Writes are
+// only ever dropped whole; once part of one has been sent, the rest of it
+// must follow. Returns FALSE if the socket has too much output queued up and
+// must be closed
+bool outq_queue(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt,
+		size_t sent) {
+  size_t length = 0;
+  int         i = 0;
+  for(i = 0; i < iovcnt; i++)
+    length += iov[i].iov_len;
+  if(length <= sent)
+    return TRUE;
+  length -= sent;
+
+  // the client isn't keeping up with us. Are they too far behind?
+  if(dsock->outq_len + length > (size_t)OUTPUT_HIGH_WATER) {
+    if(sent == 0 && outq_can_drop(dsock))
+      return TRUE;
+    log_string("Socket %d (%s) exceeded its output high water mark of %d "
+	       "bytes. Disconnecting.", dsock->uid, dsock->hostname,
+	       OUTPUT_HIGH_WATER);
+    return FALSE;
+  }
+
+  for(i = 0; i < iovcnt; i++) {
+    if(sent >= iov[i].iov_len) {
+      sent -= iov[i].iov_len;
+      continue;
+    }
+    outq_append(dsock, (char *)iov[i].iov_base + sent, iov[i].iov_len - sent);
+    sent = 0;
+  }
+  outq_update_interest(dsock);
+  return TRUE;
+}
+
+//
+// write a list of data segments to the socket with one system call, without
+// ever blocking. Whatever the kernel won't take right now is queued up to be
+// sent later. Returns FALSE if there was an error, or the socket has too much
+// output queued up and must be closed. WebSocket output must already be
+// framed; see socket_send_vec
+bool socket_send_wire(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt){
+  ssize_t wrote = 0;
+
+  // we can only write directly if there's nothing queued ahead of us
+  if(dsock->outq_len > 0 && !outq_drain(dsock))
+    return FALSE;
+
+  if(dsock->outq_len == 0 && !socket_tls_waiting(dsock)) {
+    do {
+      wrote = socket_writev(dsock, iov, iovcnt);
+      socket_note_write(dsock, wrote);
+    } while(wrote < 0 && errno == EINTR);
+
+    if(wrote < 0) {
+      if(errno != EAGAIN && errno != EWOULDBLOCK) {
+	perror("socket_send_wire");
+	return FALSE;
       }
+      wrote = 0;
     }
+  }
+
+  // queue up whatever didn't make it out
+  return outq_queue(dsock, iov, iovcnt, wrote);
+}
+
+//
+// like socket_send_wire, but frames WebSocket output on its way out. Until
+// the handshake is done, it is held back
+bool socket_send_vec(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt) {
+  struct iovec framed;
+  if (!dsock->ws)
+    return socket_send_wire(dsock, iov, iovcnt);
+  if (!wsIsOpen(dsock->ws))
+    return wsHold(dsock->ws, iov, iovcnt);
+
+  bufferClear(ws_frames);
+  wsFrame(dsock->ws, ws_frames, iov, iovcnt);
+  if (bufferLength(ws_frames) == 0)
+    return TRUE;
+  framed.iov_base = (void *) bufferString(ws_frames);
+  framed.iov_len  = bufferLength(ws_frames);
+  return socket_send_wire(dsock, &framed, 1);
+}
+
+//
+// write data to the socket without ever blocking. See socket_send_vec
+bool socket_send_raw(SOCKET_DATA *dsock, const char *data, int length) {
+  struct iovec iov;
+  iov.iov_base = (void *) data;
+  iov.iov_len  = length;
+  return socket_send_vec(dsock, &iov, 1);
+}
+
+//
+// send what a WebSocket has to say for itself. Once its handshake is done,
+// the output we held back until then can go, too. Returns FALSE if sending
+// failed
+bool socket_ws_reply(SOCKET_DATA *dsock) {
+  struct iovec iov;
+  BUFFER     *held = NULL;
+  bool    success = TRUE;
+
+  bufferClear(ws_frames);
+  if (!wsTakeReply(dsock->ws, ws_frames))
     return TRUE;
+  iov.iov_base = (void *) bufferString(ws_frames);
+  iov.iov_len  = bufferLength(ws_frames);
+  if (!socket_send_wire(dsock, &iov, 1))
+    return FALSE;
+
+  if (wsIsOpen(dsock->ws) && (held = wsTakeHeld(dsock->ws)) != NULL)
+  {
+    success = socket_send_raw(dsock, bufferString(held), bufferLength(held));
+    deleteBuffer(held);
   }
+  // JSON clients get their colour as HTML
+  if (wsIsOpen(dsock->ws) && wsIsJSON(dsock->ws))
+    dsock->colour_mode = COLOUR_HTML;
+  return success;
+}
+
+//
+// send whatever deflate has put in our compression buffer
+bool processCompressed(SOCKET_DATA *dsock)
+{
+  int len;
+
+  if (!dsock->out_compress)
+    return TRUE;
 
-  /* write uncompressed */
-  for (iPtr = 0; iPtr < length; iPtr += iWrt)
+  len = dsock->out_compress->next_out - dsock->out_compress_buf;
+  if (len > 0)
   {
-    iBlck = UMIN(length - iPtr, 4096);
-    if ((iWrt = write(control, txt + iPtr, iBlck)) < 0)
-    {
-      perror("Text_to_socket:");
+    if (!socket_send_raw(dsock, (char *) dsock->out_compress_buf, len))
       return FALSE;
-    }
+    dsock->out_compress->next_out = dsock->out_compress_buf;
   }
 
+  /* success */
   return TRUE;
 }
 
+
 /*
- * Sends binary data directly to the socket with specified length,
- * will compress the data if needed. Handles embedded null bytes.
+ * Text_to_socket()
+ *
+ * Sends text directly to the socket,
+ * will compress the data if needed.
  */
-bool binary_to_socket(SOCKET_DATA *dsock, const char *data, int length)
+bool text_to_socket(SOCKET_DATA *dsock, const char *txt)
 {
-  int iBlck, iPtr, iWrt = 0, control = dsock->control;
+  return binary_to_socket(dsock, txt, strlen(txt));
+}
 
-  /* write compressed */
-  if (dsock && dsock->out_compress)
-  {
-    dsock->out_compress->next_in  = (unsigned char *) data;
-    dsock->out_compress->avail_in = length;
+//
+// how much CPU time the calling thread has used, in microseconds. Output is
+// compressed on workers as well as the game thread, and wall time would
+// count what they spent waiting
+long long compress_cpu_clock(void) {
+  struct timespec now;
+  if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0)
+    return 0;
+  return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
 
-    while (dsock->out_compress->avail_in)
-    {
-      dsock->out_compress->avail_out = COMPRESS_BUF_SIZE - (dsock->out_compress->next_out - dsock->out_compress_buf);
+//
+// count output the socket compressed, what it came out as, and what it cost
+void compress_note(SOCKET_DATA *dsock, int raw, int compressed, long long usec){
+  atomic_fetch_add(&dsock->comp_raw,   raw);
+  atomic_fetch_add(&dsock->comp_bytes, compressed);
+  atomic_fetch_add(&dsock->comp_usec,  usec);
+  atomic_fetch_add(&total_mccp_raw,        raw);
+  atomic_fetch_add(&total_mccp_compressed, compressed);
+  atomic_fetch_add(&total_mccp_usec,       usec);
+}
 
-      if (dsock->out_compress->avail_out)
-      {
-        int status = deflate(dsock->out_compress, Z_SYNC_FLUSH);
+//
+// run data through our compression stream, and send whatever comes out the
+// other end. flush is the zlib flush mode; Z_NO_FLUSH can be used when more
+// data is going to follow right away, and Z_SYNC_FLUSH after the last of it
+bool compress_to_socket(SOCKET_DATA *dsock, const char *data, int length,
+			int flush) {
+  uLong out_before = dsock->out_compress->total_out;
+  long long   usec = 0;
+  dsock->out_compress->next_in  = (unsigned char *) data;
+  dsock->out_compress->avail_in = length;
+  if (dsock->compress_raw)
+    dsock->compress_adler = adler32(dsock->compress_adler, 
+				    (unsigned char *) data, length);
+
+  do {
+    dsock->out_compress->avail_out = COMPRESS_BUF_SIZE - (dsock->out_compress->next_out - dsock->out_compress_buf);
+
+    if (dsock->out_compress->avail_out)
+    {
+      long long start = compress_cpu_clock();
+      int status = deflate(dsock->out_compress, flush);
+      usec += compress_cpu_clock() - start;
 
-        if (status != Z_OK)
+      if (status != Z_OK && status != Z_BUF_ERROR)
         return FALSE;
-      }
-
-      length = dsock->out_compress->next_out - dsock->out_compress_buf;
-      if (length > 0)
-      {
-        for (iPtr = 0; iPtr < length; iPtr += iWrt)
-        {
-          iBlck = UMIN(length - iPtr, 4096);
-          if ((iWrt = write(control, dsock->out_compress_buf + iPtr, iBlck)) < 0)
-          {
-            perror("Binary_to_socket (compressed):");
-            return FALSE;
-          }
-        }
-        if (iWrt <= 0) break;
-        if (iPtr > 0)
-        {
-          if (iPtr < length)
-            memmove(dsock->out_compress_buf, dsock->out_compress_buf + iPtr, length - iPtr);
-
-          dsock->out_compress->next_out = dsock->out_compress_buf + length - iPtr;
-        }
-      }
     }
-    return TRUE;
-  }
 
-  /* write uncompressed */
-  for (iPtr = 0; iPtr < length; iPtr += iWrt)
-  {
-    iBlck = UMIN(length - iPtr, 4096);
-    if ((iWrt = write(control, data + iPtr, iBlck)) < 0)
-    {
-      perror("Binary_to_socket:");
+    if (!processCompressed(dsock))
       return FALSE;
-    }
+
+    // keep going until deflate has taken all our input, and has no more
+    // output pending for us (it fills up the whole buffer when it does)
+  } while (dsock->out_compress->avail_in > 0 || 
+	   dsock->out_compress->avail_out == 0);
+
+  compress_note(dsock, length, dsock->out_compress->total_out - out_before,
+		usec);
+  return TRUE;
+}
+
+/*
+ * Sends binary data directly to the socket with specified length,
+ * will compress the data if needed. Handles embedded null bytes.
+ */
+bool binary_to_socket(SOCKET_DATA *dsock, const char *data, int length)
+{
+  if (dsock->out_compress) {
+    struct iovec iov;
+    iov.iov_base = (void *) data;
+    iov.iov_len  = length;
+    return vector_to_socket(dsock, &iov, 1);
   }
+  return socket_send_raw(dsock, data, length);
+}
+
+//
+// send a list of data segments to the socket. When we're compressing, they
+// all go through deflate and are only flushed at the end. Otherwise, they go
+// out with a single writev, without being copied together first
+bool vector_to_socket(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt)
+{
+  int i, length = 0;
+  if (!dsock->out_compress)
+    return socket_send_vec(dsock, iov, iovcnt);
+
+  // let a compression worker deal with it
+  if (dsock->comp_in)
+    return compress_queue(dsock, iov, iovcnt);
 
+  for (i = 0; i < iovcnt; i++)
+    length += iov[i].iov_len;
+  compress_prepare(dsock, length);
+
+  for (i = 0; i < iovcnt; i++)
+    if (!compress_to_socket(dsock, iov[i].iov_base, iov[i].iov_len,
+			    (i == iovcnt - 1 ? Z_SYNC_FLUSH : Z_NO_FLUSH)))
+      return FALSE;
   return TRUE;
 }
 
@@ -490,16 +1061,94 @@ void  send_to_socket( SOCKET_DATA *dsock, const char *format, ...) {
 }
 
 
-/*
- * Text_to_buffer()
- *
- * Stores outbound text in a buffer, where it will
- * stay untill it is flushed in the gameloop.
- *
- * Will also parse ANSI colors and other tags.
- */
+//
+// shared output
+//
+// when something is sent to many sockets at once, it is made into an
+// OUT_FRAG, which each socket holds a reference to instead of its own copy.
+// If nothing comes along that needs a socket's output to be all in one piece
+// (its own text, or a hook that wants to see or edit what it is sending),
+// the fragment goes out as it is, and its colour codes are only translated
+// once for everyone who can see the same colours
+OUT_FRAG *newOutFrag(const char *txt) {
+  OUT_FRAG *frag = calloc(1, sizeof(OUT_FRAG));
+  frag->len      = strlen(txt);
+  frag->text     = malloc(frag->len + 1);
+  frag->refs     = 1;
+  memcpy(frag->text, txt, frag->len + 1);
+  return frag;
+}
+
+void outFragUnref(OUT_FRAG *frag) {
+  int mode;
+  if(--frag->refs > 0)
+    return;
+  for(mode = 0; mode < NUM_COLOUR_MODES; mode++)
+    if(frag->rendered[mode])
+      deleteBuffer(frag->rendered[mode]);
+  free(frag->text);
+  free(frag);
+}
+
+const char *outFragGetText(OUT_FRAG *frag) {
+  return frag->text;
+}
+
+//
+// point an iovec at our text, as it is sent to sockets with the colour mode
+void out_frag_render(OUT_FRAG *frag, int mode, struct iovec *iov) {
+  if(!frag->translated[mode]) {
+    BUFFER *buf = newBuffer(frag->len + 1);
+    frag->translated[mode] = TRUE;
+    if(colourTranslate(frag->text, frag->len, buf, mode))
+      frag->rendered[mode] = buf;
+    else
+      deleteBuffer(buf);
+  }
+  if(frag->rendered[mode] != NULL) {
+    iov->iov_base = (void *) bufferString(frag->rendered[mode]);
+    iov->iov_len  = bufferLength(frag->rendered[mode]);
+  }
+  else {
+    iov->iov_base = frag->text;
+    iov->iov_len  = frag->len;
+  }
+}
+
+//
+// copy our shared output into our outbuf, so it's all in one piece
+void socket_flatten_frags(SOCKET_DATA *dsock) {
+  int i;
+  for(i = 0; i < dsock->num_frags; i++) {
+    bufferCatLen(dsock->outbuf, dsock->frags[i]->text, dsock->frags[i]->len);
+    outFragUnref(dsock->frags[i]);
+  }
+  dsock->num_frags = 0;
+}
+
+//
+// let go of our shared output without sending it
+void socket_release_frags(SOCKET_DATA *dsock) {
+  int i;
+  for(i = 0; i < dsock->num_frags; i++)
+    outFragUnref(dsock->frags[i]);
+  dsock->num_frags = 0;
+}
+
+/*
+ * Text_to_buffer()
+ *
+ * Stores outbound text in a buffer, where it will
+ * stay untill it is flushed in the gameloop.
+ *
+ * Will also parse ANSI colors and other tags.
+ */
 void text_to_buffer(SOCKET_DATA *dsock, const char *txt)
 {
+  // anything we have that is shared goes before us
+  if(dsock->num_frags > 0)
+    socket_flatten_frags(dsock);
+
   // if we're at the head of the outbuf and haven't entered a command, 
   // also copy a newline so we're not printing in front of the prompt
   if(bufferLength(dsock->outbuf) == 0 && !dsock->bust_prompt)
@@ -509,6 +1158,16 @@ void text_to_buffer(SOCKET_DATA *dsock, const char *txt)
   bufferCat(dsock->outbuf, txt);
 }
 
+void text_to_buffer_shared(SOCKET_DATA *dsock, OUT_FRAG *frag) {
+  if(bufferLength(dsock->outbuf) == 0 && dsock->num_frags == 0 && 
+     !dsock->bust_prompt)
+    bufferCat(dsock->outbuf, "\r\n");
+  if(dsock->num_frags == MAX_SHARED_FRAGS)
+    socket_flatten_frags(dsock);
+  frag->refs++;
+  dsock->frags[dsock->num_frags++] = frag;
+}
+
 //
 // read an IAC sequence from the socket's input buffer. When we hit a
 // termination point, send a hook and clear he buffer. Return how many
@@ -519,11 +1178,11 @@ int read_iac_sequence(SOCKET_DATA *dsock, int start) {
   int       i = start;
   bool   done = FALSE;
 
-  for(; dsock->inbuf[i] != '\0'; i++) {
+  for(; i < dsock->in_len; i++) {
     // are we looking for IAC?
     if(bufferLength(dsock->iac_sequence) == 0) {
       // Oops! Something is broken
-      if(dsock->inbuf[i] != (signed char) IAC)
+      if(INBUF_CH(dsock, i) != (signed char) IAC)
 	return 0;
       else
 	bufferCatCh(dsock->iac_sequence, IAC);
@@ -532,17 +1191,17 @@ int read_iac_sequence(SOCKET_DATA *dsock, int start) {
     // are we looking for a command?
     else if(bufferLength(dsock->iac_sequence) == 1) {
       // did we find subnegotiation?
-      if(dsock->inbuf[i] == (signed char) SB) {
-	bufferCatCh(dsock->iac_sequence, dsock->inbuf[i]);
+      if(INBUF_CH(dsock, i) == (signed char) SB) {
+	bufferCatCh(dsock->iac_sequence, INBUF_CH(dsock, i));
 	subneg = TRUE;
       }
 
       // basic three-character command
-      else if(dsock->inbuf[i] == (signed char) WILL || 
-	      dsock->inbuf[i] == (signed char) WONT || 
-	      dsock->inbuf[i] == (signed char) DO   || 
-	      dsock->inbuf[i] == (signed char) DONT)
-	bufferCatCh(dsock->iac_sequence, dsock->inbuf[i]);
+      else if(INBUF_CH(dsock, i) == (signed char) WILL || 
+	      INBUF_CH(dsock, i) == (signed char) WONT || 
+	      INBUF_CH(dsock, i) == (signed char) DO   || 
+	      INBUF_CH(dsock, i) == (signed char) DONT)
+	bufferCatCh(dsock->iac_sequence, INBUF_CH(dsock, i));
 
       // something went wrong
       else {
@@ -555,10 +1214,10 @@ int read_iac_sequence(SOCKET_DATA *dsock, int start) {
     else if(subneg) {
       int       last_i = bufferLength(dsock->iac_sequence) - 2;
       signed char last = bufferString(dsock->iac_sequence)[last_i];
-      bufferCatCh(dsock->iac_sequence, dsock->inbuf[i]);
+      bufferCatCh(dsock->iac_sequence, INBUF_CH(dsock, i));
 
       // have hit the end of the subnegotiation? Break out if so
-      if(last == (signed char) IAC && dsock->inbuf[i] == (signed char) SE) {
+      if(last == (signed char) IAC && INBUF_CH(dsock, i) == (signed char) SE) {
 	done = TRUE;
 	break;
       }
@@ -566,120 +1225,383 @@ int read_iac_sequence(SOCKET_DATA *dsock, int start) {
 
     // this is the end
     else {
-      bufferCatCh(dsock->iac_sequence, dsock->inbuf[i]);
+      bufferCatCh(dsock->iac_sequence, INBUF_CH(dsock, i));
       done = TRUE;
       break;
     }
   }
   
-  int len = i - start + (dsock->inbuf[i] == '\0' ? 0 : 1);
+  int len = i - start + (i >= dsock->in_len ? 0 : 1);
 
-  // broadcast the message we parsed, and prepare for the next sequence
+  // broadcast the message we parsed, and prepare for the next sequence. If
+  // we're an input worker, the game thread has to do the broadcasting
   if(done == TRUE) {
-    hookRun("receive_iac", 
-	    hookBuildInfo("sk bytes", dsock, bufferString(dsock->iac_sequence), bufferLength(dsock->iac_sequence)));
+    if(INPUT_THREADED(dsock))
+      input_push(dsock, INPUT_IAC, bufferString(dsock->iac_sequence),
+		 bufferLength(dsock->iac_sequence));
+    else
+      hookRunArgs("receive_iac", 
+	      "sk bytes", dsock, bufferString(dsock->iac_sequence), bufferLength(dsock->iac_sequence));
     bufferClear(dsock->iac_sequence);
   }
   return len;
 }
 
+//
+// pull characters out of inbuf and onto the end of line, until we hit the end
+// of a line or run out of input. IAC sequences are handled as we come across
+// them. Returns TRUE if we found the end of a line
+bool decode_next_line(SOCKET_DATA *dsock, BUFFER *line) {
+  int i = 0, cmd_end = -1;
+
+  // are we building an IAC command? Try to continue it
+  if(bufferLength(dsock->iac_sequence) > 0)
+    i += read_iac_sequence(dsock, 0);
+
+  // copy over characters until we hit a newline, an IAC command, or run out
+  for(; i < dsock->in_len && cmd_end < 0; i++) {
+    switch(INBUF_CH(dsock, i)) {
+    default:
+      // append us to the command
+      bufferCatCh(line, INBUF_CH(dsock, i));
+      break;
+    case '\n':
+      // command end found
+      cmd_end = ++i;
+    case '\r':
+    case '\0':
+      // ignore \r ... only pay attention to \n
+      break;
+    case (signed char) IAC:
+      i += read_iac_sequence(dsock, i) - 1;
+      break;
+    }
+    if(cmd_end >= 0)
+      break;
+  }
+
+  // we're done with everything we've read so far. Nothing needs to be moved
+  i = MIN(i, dsock->in_len);
+  dsock->in_start = (dsock->in_start + i) % MAX_INPUT_LEN;
+  dsock->in_len  -= i;
+
+  return (cmd_end >= 0);
+}
+
 void next_cmd_from_buffer(SOCKET_DATA *dsock) {
   // do we have stuff in our input list? If so, use that instead of inbuf
-  dsock->cmd_read = FALSE;
+  dsock->cmd_read     = FALSE;
+  dsock->cmd_expanded = FALSE;
   if(listSize(dsock->input) > 0) {
-    char *cmd = listPop(dsock->input);
+    QUEUED_CMD *cmd = listPop(dsock->input);
     bufferClear(dsock->next_command);
-    bufferCat(dsock->next_command, cmd);
+    bufferCat(dsock->next_command, cmd->cmd);
+    dsock->cmd_read     = TRUE;
+    dsock->cmd_expanded = cmd->expanded;
+    dsock->bust_prompt  = TRUE;
+    free(cmd);
+  }
+  // an input worker has already decoded our input for us. Handle any IAC
+  // sequences that came before our next line, and take the line
+  else if(INPUT_THREADED(dsock))
+    input_pop_command(dsock);
+  // did we find a command?
+  else if(decode_next_line(dsock, dsock->next_command)) {
     dsock->cmd_read    = TRUE;
     dsock->bust_prompt = TRUE;
-    free(cmd);
+    replayRecordInput(dsock, bufferString(dsock->next_command));
   }
-  else {
-    int i = 0, cmd_end = -1;
-
-    // are we building an IAC command? Try to continue it
-    if(bufferLength(dsock->iac_sequence) > 0)
-      i += read_iac_sequence(dsock, 0);
-
-    // copy over characters until we hit a newline, an IAC command, or \0
-    for(; dsock->inbuf[i] != '\0' && cmd_end < 0; i++) {
-      switch(dsock->inbuf[i]) {
-      default:
-	// append us to the command
-	bufferCatCh(dsock->next_command, dsock->inbuf[i]);
-	break;
-      case '\n':
-	// command end found
-	cmd_end = ++i;
-      case '\r':
-	// ignore \r ... only pay attention to \n
-	break;
-      case (signed char) IAC:
-	i += read_iac_sequence(dsock, i) - 1;
-	break;
-      }
-      if(cmd_end >= 0)
-	break;
+}
+
+
+
+//*****************************************************************************
+// threaded input
+//
+// if the input_threads setting is above zero, reading from sockets and
+// decoding what they send us (telnet IAC sequences, splitting it into lines)
+// happens on a pool of worker threads. When the poller says a socket has
+// input, it is handed to a worker, which reads it, decodes it, and queues up
+// the results for the game thread. The game thread only ever has to pop
+// complete lines off the queue. Only one worker handles a socket at a time.
+//*****************************************************************************
+
+//
+// hand decoded input over to the game thread. If its queue is full, the
+// input waits in our backlog until there is room
+void input_push(SOCKET_DATA *dsock, int type, const char *data, int len) {
+  INPUT_ITEM *item = malloc(sizeof(INPUT_ITEM) + len + 1);
+  item->type = type;
+  item->len  = len;
+  if(len > 0)
+    memcpy(item->data, data, len);
+  item->data[len] = '\0';
+  if(listSize(dsock->io_backlog) > 0 || !spscQueuePush(dsock->io_queue, item))
+    listQueue(dsock->io_backlog, item);
+}
+
+//
+// move as much of our backlog into the game thread's queue as will fit.
+// Returns TRUE if the backlog is now empty
+bool input_flush_backlog(SOCKET_DATA *dsock) {
+  INPUT_ITEM *item = NULL;
+  while((item = listHead(dsock->io_backlog)) != NULL) {
+    if(!spscQueuePush(dsock->io_queue, item))
+      return FALSE;
+    listPop(dsock->io_backlog);
+  }
+  return TRUE;
+}
+
+//
+// decode as many lines as we can from the socket's inbuf. We stop when we run
+// out of input, or the game thread has too much of our input to get through
+void input_decode_lines(SOCKET_DATA *dsock) {
+  while(listSize(dsock->io_backlog) == 0 && 
+	decode_next_line(dsock, dsock->io_line)) {
+    input_push(dsock, INPUT_LINE, bufferString(dsock->io_line),
+	       bufferLength(dsock->io_line));
+    bufferClear(dsock->io_line);
+  }
+}
+
+//
+// the job an input worker runs for a socket with input waiting
+void input_worker_job(SOCKET_DATA *dsock) {
+  int status = INPUT_READ_OK;
+
+  // get through what we already have before reading any more, so a client
+  // that sends lots of commands at once doesn't look like a buffer overflow
+  if(input_flush_backlog(dsock)) {
+    input_decode_lines(dsock);
+    if(listSize(dsock->io_backlog) == 0) {
+      status = read_socket_input(dsock);
+      input_decode_lines(dsock);
+      if(status == INPUT_READ_CLOSED)
+	input_push(dsock, INPUT_CLOSE, NULL, 0);
+      else if(status == INPUT_READ_OVERFLOW)
+	input_push(dsock, INPUT_OVERFLOW, NULL, 0);
     }
+  }
 
-    // move the context of inbuf down
-    int begin = 0;
-    while(dsock->inbuf[i] != '\0')
-      dsock->inbuf[begin++] = dsock->inbuf[i++];
-    dsock->inbuf[begin] = '\0';
-    
-    // did we find a command?
-    if(cmd_end >= 0) {
+  // if we couldn't get through everything, the game thread has to send us
+  // back once it's made some room
+  atomic_store(&dsock->io_stalled, listSize(dsock->io_backlog) > 0);
+  atomic_store(&dsock->io_busy, FALSE);
+}
+
+//
+// have an input worker handle the socket's input, unless one already is
+void input_dispatch(SOCKET_DATA *dsock) {
+  if(atomic_exchange(&dsock->io_busy, TRUE))
+    return;
+  atomic_store(&dsock->io_stalled, FALSE);
+  workerPoolAdd(input_pool, input_worker_job, dsock);
+}
+
+//
+// take the next command an input worker has decoded for the socket, running
+// the hooks for any IAC sequences that came before it
+void input_pop_command(SOCKET_DATA *dsock) {
+  INPUT_ITEM *item = NULL;
+  while(!dsock->cmd_read && !dsock->closed &&
+	(item = spscQueuePop(dsock->io_queue)) != NULL) {
+    switch(item->type) {
+    case INPUT_LINE:
+      bufferClear(dsock->next_command);
+      bufferCat(dsock->next_command, item->data);
       dsock->cmd_read    = TRUE;
       dsock->bust_prompt = TRUE;
+      replayRecordInput(dsock, item->data);
+      break;
+    case INPUT_IAC:
+      hookRunArgs("receive_iac",
+	      "sk bytes", dsock, item->data, item->len);
+      break;
+    case INPUT_OVERFLOW:
+      text_to_socket(dsock, "\n\r!!!! Input Overflow !!!!\n\r");
+      close_socket(dsock, FALSE);
+      break;
+    case INPUT_CLOSE:
+      close_socket(dsock, FALSE);
+      break;
     }
+    free(item);
   }
+
+  // did the worker leave input behind because we were full?
+  if(!dsock->closed && atomic_load(&dsock->io_stalled))
+    input_dispatch(dsock);
 }
 
+void init_input_threads(void) {
+  int threads = mudsettingGetInt("input_threads");
+  if(threads <= 0)
+    return;
+  if((input_pool = newWorkerPool("input", threads)) != NULL)
+    log_string("Reading socket input on %d worker threads.", 
+	       workerPoolGetSize(input_pool));
+}
 
 
-bool flush_output(SOCKET_DATA *dsock) {
-  bool  success = TRUE;
-  BUFFER   *buf = NULL;
+
+//
+// colour codes are translated into a scratch buffer, which then trades
+// places with the socket's outbuf
+BUFFER *colour_scratch = NULL;
+
+//
+// translate the colour codes in a socket's outbuf
+void socket_colourize(SOCKET_DATA *dsock) {
+  if(colour_scratch == NULL)
+    colour_scratch = newBuffer(MAX_OUTPUT);
+  if(colourTranslate(bufferString(dsock->outbuf), bufferLength(dsock->outbuf),
+		     colour_scratch, dsock->colour_mode)) {
+    BUFFER *swap   = dsock->outbuf;
+    dsock->outbuf  = colour_scratch;
+    colour_scratch = swap;
+    bufferClear(colour_scratch);
+  }
+}
+
+//
+// should output that isn't an answer to a command wait for more to go with
+// it? Small bits of it are held back until enough is waiting, or the oldest
+// of it has waited long enough, so a trickle of messages doesn't cost a
+// write every pulse
+bool socket_hold_output(SOCKET_DATA *dsock) {
+  int min_bytes = mudsettingGetInt("output_coalesce_bytes");
+  if(dsock->bust_prompt || min_bytes <= 0)
+    return FALSE;
+
+  int i, pending = bufferLength(dsock->outbuf);
+  for(i = 0; i < dsock->num_frags && pending < min_bytes; i++)
+    pending += dsock->frags[i]->len;
+  if(pending >= min_bytes)
+    return FALSE;
+
+  long long now = pulse_clock();
+  if(dsock->out_since == 0)
+    dsock->out_since = now;
+  return (now - dsock->out_since < mudsettingGetInt("output_coalesce_usec"));
+}
+
+//
+// send a JSON WebSocket client the text in the first text_iovs of iov, and
+// the prompt in the rest of them, each as its own message
+bool socket_send_json(SOCKET_DATA *dsock, const struct iovec *iov,
+		      int text_iovs, int iovcnt) {
+  struct iovec framed;
+  bufferClear(ws_frames);
+  if(text_iovs > 0)
+    wsFrameJSON(dsock->ws, ws_frames, "text", iov, text_iovs);
+  if(iovcnt > text_iovs)
+    wsFrameJSON(dsock->ws, ws_frames, "prompt", iov + text_iovs,
+		iovcnt - text_iovs);
+  if(bufferLength(ws_frames) == 0)
+    return TRUE;
+  framed.iov_base = (void *) bufferString(ws_frames);
+  framed.iov_len  = bufferLength(ws_frames);
+  return socket_send_wire(dsock, &framed, 1);
+}
+
+//
+// send the socket its pending output and prompt. If we're coalescing, output
+// that isn't an answer to a command may be held back for a later call
+bool socket_flush(SOCKET_DATA *dsock, bool coalesce) {
+  struct iovec iov[3 + MAX_SHARED_FRAGS];
+  OUT_FRAG  *frags[MAX_SHARED_FRAGS];
+  int       iovcnt = 0, text_iovs = 0;
+  BUFFER     *swap = NULL;
+  bool     success = TRUE;
+  bool        json = (dsock->ws != NULL && wsIsJSON(dsock->ws));
+  int    num_frags = 0, i;
+
+  // a WebSocket's output waits until we know what it wants it as
+  if(dsock->ws && !wsIsOpen(dsock->ws))
+    return success;
 
   // run any hooks prior to flushing our text
-  hookRun("flush", hookBuildInfo("sk", dsock));
+  hookRunArgsId(flush_hook, "sk", dsock);
 
   // quit if we have no output and don't need/can't have a prompt
-  if(bufferLength(dsock->outbuf) <= 0 && 
+  if(bufferLength(dsock->outbuf) <= 0 && dsock->num_frags == 0 &&
      (!dsock->bust_prompt || !socketHasPrompt(dsock)))
     return success;
 
-  buf = newBuffer(1);
-
-  // send our outbound text
-  if(bufferLength(dsock->outbuf) > 0) {
-    hookRun("process_outbound_text",  hookBuildInfo("sk", dsock));
-    hookRun("finalize_outbound_text", hookBuildInfo("sk", dsock));
-    //success = text_to_socket(dsock, bufferString(dsock->outbuf));
-    bufferCat(buf, bufferString(dsock->outbuf));
-    bufferClear(dsock->outbuf);
+  // wait for more output to go with what we have?
+  if(coalesce && socket_hold_output(dsock))
+    return success;
+  dsock->out_since = 0;
+
+  // hooks on our outbound text need to see all of it
+  if(dsock->num_frags > 0 && 
+     (hookHasListenersId(process_outbound_text_hook) ||
+      hookHasListenersId(finalize_outbound_text_hook)))
+    socket_flatten_frags(dsock);
+
+  // send our outbound text. Once its hooks have run, it is set aside so our
+  // prompt can be built (and have its own hooks run) in an empty outbuf.
+  // Shared output goes right after it, as it is. It's taken off the socket
+  // until it's sent, so building the prompt doesn't flatten it into outbuf
+  num_frags = dsock->num_frags;
+  memcpy(frags, dsock->frags, sizeof(OUT_FRAG *) * num_frags);
+  dsock->num_frags = 0;
+  if(bufferLength(dsock->outbuf) > 0 || num_frags > 0) {
+    hookRunArgsId(process_outbound_text_hook,  "sk", dsock);
+    socket_colourize(dsock);
+    hookRunArgsId(finalize_outbound_text_hook, "sk", dsock);
+    swap           = dsock->sendbuf;
+    dsock->sendbuf = dsock->outbuf;
+    dsock->outbuf  = swap;
+    if(bufferLength(dsock->sendbuf) > 0) {
+      iov[iovcnt].iov_base = (void *) bufferString(dsock->sendbuf);
+      iov[iovcnt].iov_len  = bufferLength(dsock->sendbuf);
+      iovcnt++;
+    }
+    for(i = 0; i < num_frags; i++)
+      out_frag_render(frags[i], dsock->colour_mode, &iov[iovcnt++]);
   }
+  text_iovs = iovcnt;
 
   // send our prompt
   if(dsock->bust_prompt && success) {
     socketShowPrompt(dsock);
-    hookRun("process_outbound_prompt",  hookBuildInfo("sk", dsock));
-    hookRun("finalize_outbound_prompt", hookBuildInfo("sk", dsock));
-    //success = text_to_socket(dsock, bufferString(dsock->outbuf));
-    text_to_buffer(dsock, (char *) go_ahead);
-    bufferCat(buf, bufferString(dsock->outbuf));
-    bufferClear(dsock->outbuf);
+    hookRunArgsId(process_outbound_prompt_hook,  "sk", dsock);
+    socket_colourize(dsock);
+    hookRunArgsId(finalize_outbound_prompt_hook, "sk", dsock);
+    if(bufferLength(dsock->outbuf) > 0) {
+      iov[iovcnt].iov_base = (void *) bufferString(dsock->outbuf);
+      iov[iovcnt].iov_len  = bufferLength(dsock->outbuf);
+      iovcnt++;
+    }
+    // JSON clients know where the prompt ends without being told
+    if(!json) {
+      iov[iovcnt].iov_base = (void *) go_ahead;
+      iov[iovcnt].iov_len  = sizeof(go_ahead) - 1;
+      iovcnt++;
+    }
     dsock->bust_prompt = FALSE;
   }
 
-  success = text_to_socket(dsock, bufferString(buf));
-  deleteBuffer(buf);
+  if(json)
+    success = socket_send_json(dsock, iov, text_iovs, iovcnt);
+  else if(iovcnt > 0)
+    success = vector_to_socket(dsock, iov, iovcnt);
+  bufferClear(dsock->sendbuf);
+  bufferClear(dsock->outbuf);
+  socket_release_frags(dsock);
+  for(i = 0; i < num_frags; i++)
+    outFragUnref(frags[i]);
 
   // return our success
   return success;
 }
 
+bool flush_output(SOCKET_DATA *dsock) {
+  return socket_flush(dsock, FALSE);
+}
+
 
 
 //*****************************************************************************
@@ -691,79 +1613,461 @@ bool flush_output(SOCKET_DATA *dsock) {
 // getting their addresses, etc...)
 //
 //*****************************************************************************
+
+//
+// forget all of the commands in our history
+void socket_hist_clear(SOCKET_DATA *sock) {
+  int i;
+  for(i = 0; i < sock->hist_size; i++) {
+    if(sock->hist[i].long_text)
+      free(sock->hist[i].long_text);
+    sock->hist[i].long_text = NULL;
+    *sock->hist[i].text     = '\0';
+  }
+  sock->hist_next = sock->hist_len = 0;
+}
+
+//
+// the nth newest command in our history, or NULL if we don't have that many
+const char *socket_hist_get(SOCKET_DATA *sock, int n) {
+  if(n < 0 || n >= sock->hist_len)
+    return NULL;
+  HIST_SLOT *slot = &sock->hist[(sock->hist_next - 1 - n + sock->hist_size) %
+				sock->hist_size];
+  return (slot->long_text ? slot->long_text : slot->text);
+}
+
+//
+// add a command to our history, over top of our oldest one if we're full
+void socket_hist_add(SOCKET_DATA *sock, const char *cmd) {
+  if(sock->hist_size == 0)
+    return;
+  HIST_SLOT *slot = &sock->hist[sock->hist_next];
+  if(slot->long_text) {
+    free(slot->long_text);
+    slot->long_text = NULL;
+  }
+  if(strlen(cmd) < CMD_HIST_SLOT_LEN)
+    strcpy(slot->text, cmd);
+  else
+    slot->long_text = strdup(cmd);
+  sock->hist_next = (sock->hist_next + 1) % sock->hist_size;
+  if(sock->hist_len < sock->hist_size)
+    sock->hist_len++;
+}
+
+//
+// change how many commands our history holds, keeping the newest ones
+void socket_hist_resize(SOCKET_DATA *sock, int size) {
+  HIST_SLOT *hist = calloc(MAX(size, 1), sizeof(HIST_SLOT));
+  int         len = MIN(sock->hist_len, size), i;
+  // the oldest of the ones we keep goes first
+  for(i = 0; i < len; i++) {
+    HIST_SLOT *slot = &sock->hist[(sock->hist_next - len + i + sock->hist_size)
+				  % sock->hist_size];
+    hist[i] = *slot;
+    slot->long_text = NULL;
+  }
+  if(sock->hist) {
+    socket_hist_clear(sock);
+    free(sock->hist);
+  }
+  sock->hist      = hist;
+  sock->hist_size = size;
+  sock->hist_len  = len;
+  sock->hist_next = (size > 0 ? len % size : 0);
+}
+
 void deleteSocket(SOCKET_DATA *sock) {
   if(sock->hostname)      free(sock->hostname);
   if(sock->page_string)   free(sock->page_string);
+  if(sock->page_offsets)  free(sock->page_offsets);
   if(sock->text_editor)   deleteBuffer(sock->text_editor);
   if(sock->outbuf)        deleteBuffer(sock->outbuf);
+  socket_release_frags(sock);
+  if(sock->sendbuf)       deleteBuffer(sock->sendbuf);
+  if(sock->outq)          free(sock->outq);
   if(sock->next_command)  deleteBuffer(sock->next_command);
   if(sock->iac_sequence)  deleteBuffer(sock->iac_sequence);
   if(sock->input_handlers)deleteListWith(sock->input_handlers,deleteInputHandler);
   if(sock->input)         deleteListWith(sock->input, free);
-  if(sock->command_hist)  deleteListWith(sock->command_hist, free);
+  if(sock->io_queue)      deleteSPSCQueueWith(sock->io_queue, free);
+  if(sock->io_backlog)    deleteListWith(sock->io_backlog, free);
+  if(sock->io_line)       deleteBuffer(sock->io_line);
+  if(sock->hist) {
+    socket_hist_clear(sock);
+    free(sock->hist);
+  }
   if(sock->auxiliary)     deleteAuxiliaryData(sock->auxiliary);
   free(sock);
 }
 
+//
+// empty out a list, deleting its contents with func
+void empty_list_with(LIST *list, void (* func)(void *)) {
+  void *elem = NULL;
+  while((elem = listPop(list)) != NULL)
+    func(elem);
+}
+
+//
+// free everything the socket was holding on to for its last connection. Its
+// buffers and lists are emptied, but kept around so they can be used again
+void socket_release(SOCKET_DATA *sock) {
+  void *elem = NULL;
+
+  if(sock->hostname)       free(sock->hostname);
+  if(sock->page_string)    free(sock->page_string);
+  if(sock->page_offsets)   free(sock->page_offsets);
+  if(sock->outq)           free(sock->outq);
+  if(sock->auxiliary)      deleteAuxiliaryData(sock->auxiliary);
+  sock->hostname    = NULL;
+  sock->page_string = NULL;
+  sock->page_offsets = NULL;
+  sock->outq        = NULL;
+  sock->auxiliary   = NULL;
+
+  if(sock->text_editor)    bufferClear(sock->text_editor);
+  if(sock->outbuf)         bufferClear(sock->outbuf);
+  socket_release_frags(sock);
+  if(sock->sendbuf)        bufferClear(sock->sendbuf);
+  if(sock->next_command)   bufferClear(sock->next_command);
+  if(sock->iac_sequence)   bufferClear(sock->iac_sequence);
+  if(sock->io_line)        bufferClear(sock->io_line);
+  if(sock->input_handlers) empty_list_with(sock->input_handlers, 
+					   (void *) deleteInputHandler);
+  if(sock->input)          empty_list_with(sock->input, free);
+  if(sock->hist)           socket_hist_clear(sock);
+  if(sock->io_backlog)     empty_list_with(sock->io_backlog, free);
+  if(sock->io_queue) {
+    while((elem = spscQueuePop(sock->io_queue)) != NULL)
+      free(elem);
+  }
+}
+
+//
+// make sure the socket has all of the buffers and lists it needs
+void socket_alloc_buffers(SOCKET_DATA *sock) {
+  if(!sock->input_handlers) sock->input_handlers = newList();
+  if(!sock->input)          sock->input          = newList();
+  if(!sock->hist)
+    socket_hist_resize(sock, MAX(0, mudsettingGetInt("command_history")));
+  if(!sock->text_editor)    sock->text_editor    = newBuffer(1);
+  if(!sock->outbuf)         sock->outbuf         = newBuffer(MAX_OUTPUT);
+  if(!sock->sendbuf)        sock->sendbuf        = newBuffer(MAX_OUTPUT);
+  if(!sock->next_command)   sock->next_command   = newBuffer(1);
+  if(!sock->iac_sequence)   sock->iac_sequence   = newBuffer(1);
+
+  if(input_pool != NULL) {
+    if(!sock->io_queue)     sock->io_queue       = newSPSCQueue(INPUT_QUEUE_SIZE);
+    if(!sock->io_backlog)   sock->io_backlog     = newList();
+    if(!sock->io_line)      sock->io_line        = newBuffer(1);
+  }
+}
+
+//*****************************************************************************
+// idle timers
+//
+// sockets wait on a coarse timing wheel, with one slot per second, for the
+// next idle threshold they could pass: login_timeout if they aren't playing a
+// character yet, or afk_seconds and idle_disconnect if they are. Sending a
+// command doesn't move a socket on the wheel. When its slot comes up, we see
+// how long it has really been idle, do whatever it has earned, and put it
+// back for the next threshold it could pass. That way we only ever look at
+// the sockets that are due, instead of every socket on every pulse.
+//*****************************************************************************
+
+// how many seconds one turn of the wheel is
+#define IDLE_WHEEL_SLOTS     256
+
+LIST   *idle_wheel[IDLE_WHEEL_SLOTS];
+long long  idle_pulses = 0; // how many pulses we've handled input for
+long long idle_seconds = 0; // and how many times the wheel has turned
+
+//
+// how many seconds the socket has been idle for, rounded down
+long long socket_idle_seconds(SOCKET_DATA *sock) {
+  return (idle_pulses - sock->active_pulse) / MAX(1, PULSES_PER_SECOND);
+}
+
+//
+// is the socket playing a character that's in the game?
+bool socket_idle_playing(SOCKET_DATA *sock) {
+  return (sock->player != NULL && charGetRoom(sock->player) != NULL);
+}
+
+//
+// the next idle threshold, in seconds, the socket could pass, or 0 if there
+// aren't any left for it
+long long socket_idle_next(SOCKET_DATA *sock) {
+  if(!socket_idle_playing(sock))
+    return MAX(0, mudsettingGetInt("login_timeout"));
+  long long   afk = MAX(0, mudsettingGetInt("afk_seconds"));
+  long long leave = MAX(0, mudsettingGetInt("idle_disconnect"));
+  if(sock->afk || afk == 0)
+    return leave;
+  if(leave == 0)
+    return afk;
+  return MIN(afk, leave);
+}
+
+void socket_idle_schedule(SOCKET_DATA *sock) {
+  long long next = socket_idle_next(sock);
+  if(sock->idle_node != NULL || next == 0 || idle_wheel[0] == NULL)
+    return;
+  sock->idle_due  = idle_seconds + MAX(1, next - socket_idle_seconds(sock));
+  sock->idle_node = listQueueNode(idle_wheel[sock->idle_due % IDLE_WHEEL_SLOTS],
+				  sock);
+}
+
+void socket_idle_unschedule(SOCKET_DATA *sock) {
+  if(sock->idle_node != NULL) {
+    listRemoveNode(idle_wheel[sock->idle_due % IDLE_WHEEL_SLOTS],
+		   sock->idle_node);
+    sock->idle_node = NULL;
+  }
+}
+
+//
+// the socket has sent us a command
+void socket_idle_active(SOCKET_DATA *sock) {
+  sock->active_pulse = idle_pulses;
+  if(sock->afk) {
+    sock->afk = FALSE;
+    hookRunArgs("socket_back", "sk", sock);
+  }
+  socket_idle_schedule(sock);
+}
+
+//
+// the socket's slot came up. Deal with every idle threshold it has passed
+void socket_idle_check(SOCKET_DATA *sock) {
+  long long idle = socket_idle_seconds(sock);
+  int      limit = 0;
+
+  if(!socket_idle_playing(sock)) {
+    if((limit = mudsettingGetInt("login_timeout")) > 0 && idle >= limit) {
+      text_to_socket(sock, "\r\nYou took too long to log in. Goodbye.\r\n");
+      close_socket(sock, FALSE);
+      return;
+    }
+  }
+  else {
+    if((limit = mudsettingGetInt("idle_disconnect")) > 0 && idle >= limit) {
+      text_to_socket(sock, "\r\nYou have been idle too long. Goodbye.\r\n");
+      close_socket(sock, FALSE);
+      return;
+    }
+    if(!sock->afk &&
+       (limit = mudsettingGetInt("afk_seconds")) > 0 && idle >= limit) {
+      sock->afk = TRUE;
+      hookRunArgs("socket_afk", "sk", sock);
+    }
+  }
+  if(!sock->closed)
+    socket_idle_schedule(sock);
+}
+
+//
+// turn the wheel one slot, and check everyone who is due. Who is due is
+// collected first, since closing sockets changes the wheel under us
+void socket_idle_tick(void) {
+  LIST            *slot = idle_wheel[++idle_seconds % IDLE_WHEEL_SLOTS];
+  LIST             *due = NULL;
+  LIST_ITERATOR *sock_i = NULL;
+  SOCKET_DATA     *sock = NULL;
+  if(listSize(slot) == 0)
+    return;
+
+  due    = newList();
+  sock_i = newListIterator(slot);
+  ITERATE_LIST(sock, sock_i) {
+    if(sock->idle_due <= idle_seconds)
+      listQueue(due, sock);
+  } deleteListIterator(sock_i);
+
+  while((sock = listPop(due)) != NULL) {
+    socket_idle_unschedule(sock);
+    socket_idle_check(sock);
+  }
+  deleteList(due);
+}
+
 void clear_socket(SOCKET_DATA *sock_new, int sock)
 {
-  if(sock_new->page_string)    free(sock_new->page_string);
-  if(sock_new->text_editor)    deleteBuffer(sock_new->text_editor);
-  if(sock_new->outbuf)         deleteBuffer(sock_new->outbuf);
-  if(sock_new->next_command)   deleteBuffer(sock_new->next_command);
-  if(sock_new->iac_sequence)   deleteBuffer(sock_new->iac_sequence);
-  if(sock_new->input_handlers) deleteListWith(sock_new->input_handlers, deleteInputHandler);
-  if(sock_new->auxiliary)      deleteAuxiliaryData(sock_new->auxiliary);
-  if(sock_new->input)          deleteListWith(sock_new->input, free);
-  if(sock_new->command_hist)   deleteListWith(sock_new->command_hist, free);
-
+  // hang on to the buffers and lists we already have
+  LIST          *input_handlers = sock_new->input_handlers;
+  LIST                   *input = sock_new->input;
+  HIST_SLOT               *hist = sock_new->hist;
+  int                 hist_size = sock_new->hist_size;
+  LIST              *io_backlog = sock_new->io_backlog;
+  SPSC_QUEUE          *io_queue = sock_new->io_queue;
+  BUFFER           *text_editor = sock_new->text_editor;
+  BUFFER                *outbuf = sock_new->outbuf;
+  BUFFER               *sendbuf = sock_new->sendbuf;
+  BUFFER          *next_command = sock_new->next_command;
+  BUFFER          *iac_sequence = sock_new->iac_sequence;
+  BUFFER               *io_line = sock_new->io_line;
+
+  socket_release(sock_new);
   bzero(sock_new, sizeof(*sock_new));
+
+  sock_new->input_handlers = input_handlers;
+  sock_new->input          = input;
+  sock_new->hist           = hist;
+  sock_new->hist_size      = hist_size;
+  sock_new->io_backlog     = io_backlog;
+  sock_new->io_queue       = io_queue;
+  sock_new->text_editor    = text_editor;
+  sock_new->outbuf         = outbuf;
+  sock_new->sendbuf        = sendbuf;
+  sock_new->next_command   = next_command;
+  sock_new->iac_sequence   = iac_sequence;
+  sock_new->io_line        = io_line;
+  sock_new->colour_mode    = COLOUR_ANSI;
+  socket_alloc_buffers(sock_new);
+
   sock_new->auxiliary = newAuxiliaryData(AUXILIARY_TYPE_SOCKET);
-  sock_new->input_handlers = newList();
-  sock_new->input          = newList();
-  sock_new->command_hist   = newList();
   sock_new->control        = sock;
   sock_new->lookup_status  = TSTATE_LOOKUP;
+
+  // we do our own batching of output. Don't let the kernel sit on it, too
+  int nodelay = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
   sock_new->uid            = next_sock_uid++;
+  sock_new->active_pulse   = idle_pulses;
+  socket_idle_schedule(sock_new);
+}
 
-  sock_new->text_editor    = newBuffer(1);
-  sock_new->outbuf         = newBuffer(MAX_OUTPUT);
 
+//*****************************************************************************
+// socket pool
+//
+// short-lived connections (crawlers, MSSP pollers, people checking if we're
+// up) would otherwise have us allocating and freeing a socket and all of its
+// buffers every time. Instead, closed sockets are kept in a pool, up to
+// socket_pool_size of them, and handed out again to new connections with
+// their buffers already allocated.
+//*****************************************************************************
+LIST *socket_pool = NULL;
 
-  sock_new->next_command   = newBuffer(1);
-  sock_new->iac_sequence   = newBuffer(1);
+//
+// get a socket to use for a new connection. It still needs to be cleared
+SOCKET_DATA *socket_pool_get(void) {
+  SOCKET_DATA *sock = NULL;
+  if(socket_pool != NULL && (sock = listPop(socket_pool)) != NULL)
+    return sock;
+  return calloc(1, sizeof(SOCKET_DATA));
 }
 
+//
+// we're done with a socket. Keep it for later if there's room in the pool
+void socket_pool_put(SOCKET_DATA *sock) {
+  if(socket_pool == NULL || 
+     listSize(socket_pool) >= mudsettingGetInt("socket_pool_size"))
+    deleteSocket(sock);
+  else {
+    socket_release(sock);
+    listPut(socket_pool, sock);
+  }
+}
 
-/* does the lookup, changes the hostname, and dies */
-void *lookup_address(void *arg)
-{
-  LOOKUP_DATA *lData = (LOOKUP_DATA *) arg;
-  struct hostent *from = 0;
-  //  struct hostent ent;
-  //  char buf[16384];
-  //  int err;
+void init_socket_hooks(void) {
+  flush_hook                    = hookRegister("flush");
+  process_outbound_text_hook    = hookRegister("process_outbound_text");
+  finalize_outbound_text_hook   = hookRegister("finalize_outbound_text");
+  process_outbound_prompt_hook  = hookRegister("process_outbound_prompt");
+  finalize_outbound_prompt_hook = hookRegister("finalize_outbound_prompt");
+}
 
-  /* do the lookup and store the result at &from */
-  from = gethostbyaddr(lData->buf, sizeof(lData->buf), AF_INET);
+void init_socket_idle(void) {
+  int i;
+  for(i = 0; i < IDLE_WHEEL_SLOTS; i++)
+    idle_wheel[i] = newList();
+}
 
-  /* did we get anything ? */
-  if (from && from->h_name)
-  {
-    free(lData->dsock->hostname);
-    lData->dsock->hostname = strdup(from->h_name);
+void init_socket_pool(void) {
+  int i, size = mudsettingGetInt("socket_pool_size");
+  socket_pool = newList();
+  ws_frames   = newBuffer(MAX_BUFFER);
+
+  // warm up the pool, so the first connections don't have to allocate
+  for(i = 0; i < size; i++) {
+    SOCKET_DATA *sock = calloc(1, sizeof(SOCKET_DATA));
+    socket_alloc_buffers(sock);
+    listPut(socket_pool, sock);
   }
+}
 
-  /* set it ready to be closed or used */
-  lData->dsock->lookup_status++;
 
-  /* free the lookup data */
-  free(lData->buf);
-  free(lData);
+//
+// the sockets of in-game characters with a set of user groups, for broadcasts
+// to the groups. Kept in a small direct-mapped cache keyed by the groups, and
+// rebuilt when which sockets are playing which characters, or which groups
+// anyone is in, has changed since the entry was made
+#define GROUP_INDEX_SIZE     32
+
+typedef struct {
+  char          *groups;
+  LIST         *sockets;
+  int     index_version; // socket_index_version when we were built
+  int    groups_version; // and the version of the user_groups bitvectors
+} GROUP_INDEX;
+
+GROUP_INDEX group_index[GROUP_INDEX_SIZE];
+int socket_index_version = 0;
+
+void socketIndexChanged(void) {
+  socket_index_version++;
+}
+
+LIST *socketsInUserGroups(const char *groups) {
+  GROUP_INDEX *entry = 
+    &group_index[string_hash(groups) % GROUP_INDEX_SIZE];
+  int   grp_version = bitvectorGetVersion("user_groups");
+  if(entry->groups != NULL && !strcmp(entry->groups, groups) &&
+     entry->index_version  == socket_index_version &&
+     entry->groups_version == grp_version)
+    return entry->sockets;
+
+  if(entry->groups != NULL) {
+    free(entry->groups);
+    deleteList(entry->sockets);
+  }
+  entry->sockets        = newList();
+  entry->groups         = strdup(groups);
+  entry->index_version  = socket_index_version;
+  entry->groups_version = grp_version;
 
-  /* and kill the thread */
-  pthread_exit(0);
-  return NULL;
+  // list sockets in the order socket_list has them, like a walk over it would
+  LIST_ITERATOR *sock_i = newListIterator(socket_list);
+  SOCKET_DATA     *sock = NULL;
+  ITERATE_LIST(sock, sock_i) {
+    CHAR_DATA *ch = sock->player;
+    if(ch != NULL && charGetSocket(ch) == sock && setIn(mobile_set, ch) &&
+       bitIsSet(charGetUserGroups(ch), groups))
+      listQueue(entry->sockets, sock);
+  } deleteListIterator(sock_i);
+  return entry->sockets;
+}
+
+
+//
+// take the hostnames the resolver has found for us, and hand them to their
+// sockets. Sockets stay around until their lookup is answered, even if they
+// are closed in the meantime
+void lookup_handler() {
+  SOCKET_DATA *dsock = NULL;
+  char     *hostname = NULL;
+
+  while (resolverNextResult((void **) &dsock, &hostname))
+  {
+    free(dsock->hostname);
+    dsock->hostname = hostname;
+
+    /* set it ready to be closed or used */
+    dsock->lookup_status++;
+  }
 }
 
 
@@ -773,21 +2077,46 @@ void recycle_sockets()
   LIST_ITERATOR *sock_i = newListIterator(socket_list);
 
   ITERATE_LIST(dsock, sock_i) {
-    if (dsock->lookup_status != TSTATE_CLOSED) 
+    // wait for any input worker to finish with us, too
+    if (dsock->lookup_status != TSTATE_CLOSED || atomic_load(&dsock->io_busy))
       continue;
 
     /* remove the socket from the main list */
     listRemove(socket_list, dsock);
     propertyTableRemove(sock_table, dsock->uid);
-
-    /* close the socket */
-    close(dsock->control);
+    socketIndexChanged();
 
     /* stop compression */
     compressEnd(dsock, dsock->compressing, TRUE);
 
-    /* delete the socket from memory */
-    deleteSocket(dsock);
+    /* say goodbye over WebSockets, after what's queued up ahead of it */
+    if (dsock->ws) {
+      struct iovec iov;
+      bufferClear(ws_frames);
+      wsFrameClose(dsock->ws, ws_frames, WS_CLOSE_GOING_AWAY);
+      if (bufferLength(ws_frames) > 0) {
+	iov.iov_base = (void *) bufferString(ws_frames);
+	iov.iov_len  = bufferLength(ws_frames);
+	socket_send_wire(dsock, &iov, 1);
+      }
+      deleteWsConn(dsock->ws);
+      dsock->ws = NULL;
+    }
+
+    /* send whatever queued output the client will still take */
+    outq_drain(dsock);
+
+    /* say goodbye over TLS while we still can */
+    if (dsock->tls) {
+      deleteTlsConn(dsock->tls);
+      dsock->tls = NULL;
+    }
+
+    /* close the socket */
+    close(dsock->control);
+
+    /* put the socket away to be used again, or delete it */
+    socket_pool_put(dsock);
   } deleteListIterator(sock_i);
 }
 
@@ -796,22 +2125,16 @@ void recycle_sockets()
 void reconnect_copyover_sockets() {
   LIST_ITERATOR *sock_i = newListIterator(socket_list);
   SOCKET_DATA     *sock = NULL; 
-  ITERATE_LIST(sock, sock_i)
-    FD_SET(sock->control, &fSet);
-  deleteListIterator(sock_i);
+  ITERATE_LIST(sock, sock_i) {
+    if(!sock->closed)
+      pollerAdd(sock->control, sock, POLLER_READ);
+  } deleteListIterator(sock_i);
 }
 
 
 /* Recover from a copyover - load players */
 void copyover_recover() {     
-  CHAR_DATA    *dMob;
-  ACCOUNT_DATA *account;
-  SOCKET_DATA  *dsock;
   FILE *fp;
-  char acct[100];
-  char name[100];
-  char host[MAX_BUFFER];
-  int desc;
       
   log_string("Copyover recovery initiated");
 
@@ -823,10 +2146,31 @@ void copyover_recover() {
   /* In case something crashes - doesn't prevent reading */
   unlink(COPYOVER_FILE);
 
+  copyover_recover_fds(fp, NULL, 0);
+  fclose(fp);
+}
+
+void copyover_recover_fds(FILE *fp, const int *fds, int num_fds) {
+  CHAR_DATA    *dMob;
+  ACCOUNT_DATA *account;
+  SOCKET_DATA  *dsock;
+  char acct[100];
+  char name[100];
+  char host[MAX_BUFFER];
+  int desc, compressing;
+  unsigned long adler;
+
   for (;;) {  
-    fscanf(fp, "%d %s %s %s\n", &desc, acct, name, host);
-    if (desc == -1)
+    if (fscanf(fp, "%d", &desc) != 1 || desc == -1)
       break;
+    fscanf(fp, " %s %s %s %d %lu\n", acct, name, host, &compressing, &adler);
+
+    // on an upgrade, desc is where the socket is in what was handed to us
+    if (fds != NULL) {
+      if (desc < 0 || desc >= num_fds)
+	continue;
+      desc = fds[desc];
+    }
 
     // Many thanks to Rhaelar for the help in finding this bug; clear_socket
     // does not like receiving freshly malloc'd data. We have to make sure
@@ -839,6 +2183,12 @@ void copyover_recover() {
     listPut(socket_list, dsock);
     propertyTablePut(sock_table, dsock);
 
+    // pick up the compression stream we had going before the copyover
+    if (compressing && !compressResume(dsock, compressing, adler)) {
+      close_socket(dsock, FALSE);
+      continue;
+    }
+
     // load account data
     if((account = get_account(acct)) != NULL)
       socketSetAccount(dsock, account);
@@ -870,8 +2220,10 @@ void copyover_recover() {
       continue;
     }
    
-    // Write something, and check if it goes error-free
-    if (!text_to_socket(dsock, "\n\r <*>  And before you know it, everything has changed  <*>\n\r")) { 
+    // Write something, and check if it goes error-free. Nothing seems to
+    // have happened to someone who was upgraded, though
+    if (fds == NULL &&
+	!text_to_socket(dsock, "\n\r <*>  And before you know it, everything has changed  <*>\n\r")) { 
       close_socket(dsock, FALSE);
       continue;
     }
@@ -881,143 +2233,421 @@ void copyover_recover() {
     dsock->lookup_status  =  TSTATE_DONE;
 
     // let our modules know we've finished copying over a socket
-    hookRun("copyover_complete", hookBuildInfo("sk", dsock));
+    hookRunArgs("copyover_complete", "sk", dsock);
 
-    // negotiate compression
-    text_to_socket(dsock, (char *) compress_will2);
-    text_to_socket(dsock, (char *) compress_will);
+    // negotiate compression, unless we're still using the stream we had
+    if (!dsock->out_compress) {
+      text_to_socket(dsock, (char *) compress_will2);
+      text_to_socket(dsock, (char *) compress_will);
+    }
   }
-  fclose(fp);
 
-  // now, set all of the sockets' control to the new fSet
+  // now, start watching all of the sockets we recovered
   reconnect_copyover_sockets();
 }     
 
 void output_handler() {
-  LIST_ITERATOR *sock_i = newListIterator(socket_list);
+  LIST_ITERATOR *sock_i = NULL;
   SOCKET_DATA     *sock = NULL; 
+  int                 i = 0;
+
+  // first, send queued output to the sockets that can take more of it
+  for(i = 0; i < pollerReadyCount(); i++) {
+    if(!(pollerReadyEvents(i) & POLLER_WRITE) ||
+       (sock = pollerReadyData(i)) == NULL || sock->closed)
+      continue;
+    if(socket_tls_waiting(sock) ? !socket_tls_handshake(sock) :
+       !outq_drain(sock))
+      close_socket(sock, FALSE);
+  }
 
+  sock_i = newListIterator(socket_list);
   ITERATE_LIST(sock, sock_i) {
     /* if the player quits or get's disconnected */
     if(sock->closed)
       continue;
     
     /* Send all new data to the socket and close it if any errors occour */
-    if (!flush_output(sock))
+    if (!socket_flush(sock, TRUE))
       close_socket(sock, FALSE);
   } deleteListIterator(sock_i);
+
+  // if our output is being compressed on other threads, wait for them to
+  // finish with this pulse's output, and send it along
+  if(compress_pool != NULL) {
+    workerPoolWait(compress_pool);
+    sock_i = newListIterator(socket_list);
+    ITERATE_LIST(sock, sock_i) {
+      if(!sock->closed && sock->comp_in != NULL && !compress_collect(sock))
+	close_socket(sock, FALSE);
+    } deleteListIterator(sock_i);
+  }
 }
 
-void input_handler() {
-  LIST_ITERATOR *sock_i = newListIterator(socket_list);
-  SOCKET_DATA     *sock = NULL; 
+//*****************************************************************************
+// input flood control
+//
+// each socket has a bucket of tokens, input_burst lines deep, that fills up
+// at input_lines_per_second. Every line the client sends costs a token (what
+// aliases and the like queue up for it doesn't). Once the bucket is empty,
+// the next line is held until there is a token for it, and we stop reading
+// from the socket, so the rest waits with the kernel instead of overflowing
+// our inbuf. While a socket is throttled, a line that repeats its last
+// command is dropped if running that command again would change nothing: one
+// of the input_coalesce_cmds commands, or a move that didn't go anywhere.
+//
+// A socket that is throttled for input_snooze_strikes seconds in a row is
+// snoozed for input_snooze_seconds: nothing it sends is read or run, and it
+// is passed over on every pulse until it wakes up.
+//*****************************************************************************
 
-  ITERATE_LIST(sock, sock_i) {
-    // Close sockects we are unable to read from, or if we have no handler
-    // to take in input
-    if ((FD_ISSET(sock->control, &rFd) && !read_from_socket(sock)) ||
-	listSize(sock->input_handlers) == 0) {
-      close_socket(sock, FALSE);
+//
+// the settings above, read once a pulse
+typedef struct {
+  int         rate;     // 0 is no limit
+  int         burst;
+  int         strikes;  // 0 never snoozes anyone
+  int         snooze;
+  const char *coalesce;
+} INPUT_LIMITS;
+
+INPUT_LIMITS input_limits;
+
+void input_limits_refresh(void) {
+  input_limits.rate     = mudsettingGetInt("input_lines_per_second");
+  input_limits.burst    = MAX(1, mudsettingGetInt("input_burst"));
+  input_limits.strikes  = mudsettingGetInt("input_snooze_strikes");
+  input_limits.snooze   = MAX(1, mudsettingGetInt("input_snooze_seconds"));
+  input_limits.coalesce = mudsettingGetString("input_coalesce_cmds");
+}
+
+//
+// add whatever tokens the socket has earned since it was last topped up. A
+// full bucket means it hasn't been pushing its limits lately
+void input_refill(SOCKET_DATA *sock) {
+  long long full = (long long)input_limits.burst * PULSES_PER_SECOND;
+  sock->in_tokens  += (idle_pulses - sock->in_refilled) * input_limits.rate;
+  sock->in_refilled = idle_pulses;
+  if(sock->in_tokens >= full) {
+    sock->in_tokens  = full;
+    sock->in_strikes = 0;
+  }
+}
+
+//
+// hold the line we just read until we have a token for it, or let it go.
+// Whether we read from the socket catches up at the end of its input pass
+void input_hold(SOCKET_DATA *sock, bool hold) {
+  if(hold && !sock->in_held && sock->in_strike_sec != idle_seconds) {
+    sock->in_strike_sec = idle_seconds;
+    sock->in_strikes++;
+  }
+  sock->in_held = hold;
+}
+
+//
+// stop reading from the socket, or running its commands, for a while
+void input_snooze(SOCKET_DATA *sock) {
+  sock->in_snooze_end = idle_pulses + 
+    (long long)input_limits.snooze * MAX(1, PULSES_PER_SECOND);
+  sock->in_strikes    = 0;
+  sock->in_tokens     = 0;
+  sock->in_snoozes++;
+  outq_update_interest(sock);
+  send_to_socket(sock, "\r\nYou are sending commands faster than they can "
+		 "be handled. Nothing you send will be read for %d seconds."
+		 "\r\n", input_limits.snooze);
+  log_string("Snoozing socket %d (%s) for %d seconds of input flooding.",
+	     sock->uid, (sock->hostname ? sock->hostname : "unknown"),
+	     input_limits.snooze);
+}
+
+//
+// is the socket still snoozing? Wakes it up, if its time is up
+bool input_snoozing(SOCKET_DATA *sock) {
+  if(sock->in_snooze_end == 0)
+    return FALSE;
+  if(idle_pulses < sock->in_snooze_end)
+    return TRUE;
+  sock->in_snooze_end = 0;
+  sock->in_refilled   = idle_pulses;
+  outq_update_interest(sock);
+  return FALSE;
+}
+
+//
+// would running the command the socket just ran again change nothing? room
+// is where its character was before the command was run
+bool input_cmd_noop(SOCKET_DATA *sock, ROOM_DATA *room) {
+  const char *cmd = socket_hist_get(sock, 0);
+  char       word[SMALL_BUFFER];
+  int         len = 0;
+  // the command may have taken the socket out of its character (e.g. quit)
+  if(cmd == NULL || room == NULL || sock->player == NULL ||
+     charGetRoom(sock->player) != room ||
+     strcmp(socketGetState(sock), "playing"))
+    return FALSE;
+  while(isspace(*cmd))
+    cmd++;
+  while(cmd[len] && !isspace(cmd[len]) && len < SMALL_BUFFER - 1) {
+    word[len] = cmd[len];
+    len++;
+  }
+  word[len] = '\0';
+  return (*word && (dirGetNum(word) != DIR_NONE ||
+		    dirGetAbbrevNum(word) != DIR_NONE ||
+		    is_keyword(input_limits.coalesce, word, FALSE)));
+}
+
+//
+// read the socket's next command, if it has one it can run right now. Lines
+// we have no token for are held, or dropped if they repeat a command that
+// changed nothing
+void input_next_cmd(SOCKET_DATA *sock) {
+  while(TRUE) {
+    if(!sock->in_held) {
+      bool queued = (listSize(sock->input) > 0);
+      next_cmd_from_buffer(sock);
+      if(!sock->cmd_read || queued || input_limits.rate <= 0)
+	return;
+    }
+
+    input_refill(sock);
+    if(sock->in_tokens >= PULSES_PER_SECOND) {
+      sock->in_tokens -= PULSES_PER_SECOND;
+      sock->cmd_read   = TRUE;
+      input_hold(sock, FALSE);
+      return;
+    }
+
+    // running it again would do nothing new. Drop it and try the next one
+    const char *last = socket_hist_get(sock, 0);
+    if(sock->in_last_noop && last != NULL &&
+       !strcmp(last, bufferString(sock->next_command))) {
+      sock->in_dropped++;
+      bufferClear(sock->next_command);
+      input_hold(sock, FALSE);
       continue;
     }
 
-    /* Ok, check for a new command */
-    next_cmd_from_buffer(sock);
+    sock->cmd_read = FALSE;
+    input_hold(sock, TRUE);
+    if(input_limits.strikes > 0 && sock->in_strikes >= input_limits.strikes)
+      input_snooze(sock);
+    return;
+  }
+}
+
+//
+// run the command that was just read with the socket's current input handler
+void run_next_cmd(SOCKET_DATA *sock, IH_PAIR *pair) {
+  if(pair->python == FALSE) {
+    void (* handler)(SOCKET_DATA *, char *) = pair->handler;
+    char *cmddup = strdup(bufferString(sock->next_command));
+    handler(sock, cmddup);
+    free(cmddup);
+  }
+  else {
+    PyObject *arglist = Py_BuildValue("Os", socketGetPyFormBorrowed(sock),
+				      bufferString(sock->next_command));
+    PyObject *retval  = PyEval_CallObject(pair->handler, arglist);
+
+    // check for an error:
+    if(retval == NULL)
+      log_pyerr("Error with a Python input handler");
     
-    // are we idling?
-    if(!sock->cmd_read)
-      sock->idle +=  1.0 / PULSES_PER_SECOND;
-    /* Is there a new command pending ? */
-    else if (sock->cmd_read) {
-      sock->idle = 0.0;
-      IH_PAIR *pair = listGet(sock->input_handlers, 0);
-      if(pair->python == FALSE) {
-	void (* handler)(SOCKET_DATA *, char *) = pair->handler;
-	char *cmddup = strdup(bufferString(sock->next_command));
-	handler(sock, cmddup);
-	free(cmddup);
-      }
-      else {
-	PyObject *arglist = Py_BuildValue("Os", socketGetPyFormBorrowed(sock),
-					  bufferString(sock->next_command));
-	PyObject *retval  = PyEval_CallObject(pair->handler, arglist);
-
-	// check for an error:
-	if(retval == NULL)
-	  log_pyerr("Error with a Python input handler");
-	
-	// garbage collection
-	Py_XDECREF(retval);
-	Py_XDECREF(arglist);
-      }
+    // garbage collection
+    Py_XDECREF(retval);
+    Py_XDECREF(arglist);
+  }
 
-      // append our last command to the command history. History buffer is
-      // 100 commands, so pop off the earliest command if we're going over
-      listPut(sock->command_hist, strdup(bufferString(sock->next_command)));
-      if(listSize(sock->command_hist) > 100)
-	free(listRemoveNum(sock->command_hist, 100));
-      bufferClear(sock->next_command);
+  // append our last command to the command history. Once it's full, the
+  // newest command takes the place of the oldest
+  socket_hist_add(sock, bufferString(sock->next_command));
+  bufferClear(sock->next_command);
+}
+
+//
+// remember how long after the input pass began one of our commands finished
+void socket_note_latency(SOCKET_DATA *sock, long long usec) {
+  int bucket = 0;
+  while(bucket < CMD_LATENCY_BUCKETS - 1 && (1LL << bucket) <= usec)
+    bucket++;
+  sock->latency[bucket]++;
+  sock->latency_cmds++;
+  if(usec > sock->latency_max)
+    sock->latency_max = usec;
+}
 
-      // we save whether or not we read a command until our next call to
-      // input_handler(), at which time it is reset to FALSE if we didn't read
-      // sock->cmd_read = FALSE;
+//
+// the number of microseconds that pct percent of our commands finished in,
+// rounded up to the top of its bucket
+long long socket_latency_pct(SOCKET_DATA *sock, int pct) {
+  long long want = (sock->latency_cmds * pct + 99) / 100, seen = 0;
+  int bucket;
+  for(bucket = 0; bucket < CMD_LATENCY_BUCKETS - 1; bucket++) {
+    seen += sock->latency[bucket];
+    if(seen >= want)
+      break;
+  }
+  return MIN(1LL << bucket, sock->latency_max);
+}
+
+//
+// check a socket for new commands, and run as many of them as it can this
+// pulse. start is when the pulse's input pass began
+void input_handle_socket(SOCKET_DATA *sock, int max_cmds, long long budget,
+			 long long start) {
+  // Close sockets we have no handler to take in input for
+  if (listSize(sock->input_handlers) == 0) {
+    close_socket(sock, FALSE);
+    return;
+  }
+
+  // flooders are passed over until they wake up
+  if(input_snoozing(sock))
+    return;
+
+  /* Ok, check for a new command */
+  input_next_cmd(sock);
+    
+  /* Is there a new command pending ? */
+  if(sock->cmd_read) {
+    socket_idle_active(sock);
+    long long   began = pulse_clock();
+    int          cmds = 0;
+    while(sock->cmd_read) {
+      IH_PAIR  *pair = listGet(sock->input_handlers, 0);
+      ROOM_DATA *room = (sock->player ? charGetRoom(sock->player) : NULL);
+      run_next_cmd(sock, pair);
+      sock->in_last_noop = input_cmd_noop(sock, room);
+      long long now = pulse_clock();
+      socket_note_latency(sock, now - start);
+
+      // keep going if we have time left and nothing has changed that we
+      // should wait a pulse for: a new input handler (menus, editors) needs
+      // its prompt seen first, and an action should be given time to happen
+      if(++cmds >= max_cmds || sock->closed || 
+	 listSize(sock->input_handlers) == 0 ||
+	 listGet(sock->input_handlers, 0) != pair ||
+	 (budget > 0 && now - began >= budget) ||
+	 (sock->player != NULL && is_acting(sock->player, ~0L)))
+	break;
+      input_next_cmd(sock);
     }
 
-#ifdef MODULE_ALIAS
-    // ACK!! this is so yucky, but I can't think of a better way to do it...
-    // if this command was put in place by an alias, decrement the alias_queue
-    // counter by one. This counter is in place mainly so aliases do not end
-    // up calling eachother and making us get stuck in an infinite loop.
-    if(sock->player) {
-      int alias_queue = charGetAliasesQueued(sock->player);
-      if(alias_queue > 0)
-	charSetAliasesQueued(sock->player, --alias_queue);
+    // we did read a command this pulse, even if the last look found none
+    sock->cmd_read = TRUE;
+  }
+
+  // start or stop reading from the socket, if we're now holding a line or
+  // have let one go
+  if(!sock->closed)
+    outq_update_interest(sock);
+
+  // TLS or WebSockets read more than would fit in our inbuf. Now there's
+  // room for it, unless we are holding off on reading
+  if(!sock->closed && !sock->in_unwatched && socket_input_pending(sock) &&
+     !read_from_socket(sock))
+    close_socket(sock, FALSE);
+}
+
+void input_handler() {
+  LIST_ITERATOR *sock_i = NULL;
+  SOCKET_DATA     *sock = NULL; 
+  int                 i = 0;
+
+  // see if any of our hostname lookups have come back
+  lookup_handler();
+
+  // a second's worth of pulses has gone by; see who has been idle too long
+  if(++idle_pulses % MAX(1, PULSES_PER_SECOND) == 0)
+    socket_idle_tick();
+
+  // only visit sockets the poller told us have input waiting. Close the ones
+  // we are unable to read from
+  for(i = 0; i < pollerReadyCount(); i++) {
+    if(!(pollerReadyEvents(i) & POLLER_READ) || 
+       (sock = pollerReadyData(i)) == NULL || sock->closed)
+      continue;
+    if(socket_tls_waiting(sock)) {
+      if(!socket_tls_handshake(sock))
+	close_socket(sock, FALSE);
     }
-#endif
-  } deleteListIterator(sock_i);
+    else if(INPUT_THREADED(sock))
+      input_dispatch(sock);
+    else if(!read_from_socket(sock))
+      close_socket(sock, FALSE);
+  }
+
+  // how many commands a socket can run this pulse, and for how long
+  input_limits_refresh();
+  int       max_cmds = mudsettingGetInt("commands_per_pulse");
+  long long   budget = mudsettingGetInt("command_budget_usec");
+  long long    start = pulse_clock();
+  if(max_cmds < 1)
+    max_cmds = 1;
+
+  // whoever goes first sees the freshest world and never waits on anyone
+  // else's handlers, so who that is rotates. We go through the list twice:
+  // first from the rotation point to the end, and then from the beginning
+  int size = listSize(socket_list);
+  int first = (size > 0 ? (int)(input_rotation++ % size) : 0);
+  int pass;
+  for(pass = 0; pass < 2; pass++) {
+    sock_i = newListIterator(socket_list);
+    i      = 0;
+    ITERATE_LIST(sock, sock_i) {
+      if((pass == 0) == (i++ >= first))
+	input_handle_socket(sock, max_cmds, budget, start);
+    } deleteListIterator(sock_i);
+  }
 }
 
 
-int count_pages(const char *string) {
-  int num_newlines = count_letters(string, '\n', strlen(string));
-  
+//
+// copy the string to be paged to the socket, and find where each of its pages
+// start as we go, so we never have to look for them again. Every page is
+// NUM_LINES_PER_PAGE lines long, except maybe the last
+void page_build(SOCKET_DATA *dsock, const char *string) {
+  int len = strlen(string), i, newlines = 0, pages = 1, size = 8;
+
+  dsock->page_string  = malloc(len + 1);
+  dsock->page_offsets = malloc(sizeof(int) * size);
+  dsock->page_offsets[0] = 0;
+  for(i = 0; i < len; i++) {
+    dsock->page_string[i] = string[i];
+    if(string[i] != '\n' || ++newlines % NUM_LINES_PER_PAGE != 0 || i+1 == len)
+      continue;
+    // we need room for this page, and the end of the last one
+    if(pages + 1 >= size) {
+      size *= 2;
+      dsock->page_offsets = realloc(dsock->page_offsets, sizeof(int) * size);
+    }
+    dsock->page_offsets[pages++] = i + 1;
+  }
+  dsock->page_string[len] = '\0';
+
   // if we just have one extra line, ignore the paging prompt and just send
   // the entire thing
-  if(num_newlines <= NUM_LINES_PER_PAGE + 1)
-    return 1;
-
-  return ((num_newlines / NUM_LINES_PER_PAGE) + 
-	  (num_newlines % NUM_LINES_PER_PAGE != 0));
+  if(newlines <= NUM_LINES_PER_PAGE + 1)
+    pages = 1;
+  dsock->page_offsets[pages] = len;
+  dsock->tot_pages = pages;
 }
 
 void show_page(SOCKET_DATA *dsock, int page_num) {
-  static char buf[MAX_BUFFER];
-  char *page = dsock->page_string;
-  *buf = '\0';
-  int buf_i = 0, newline_count = 0, curr_page = 1;
-
-  // skip to our page
-  while(*page && curr_page < page_num) {
-    if(*page == '\n')
-      newline_count++;
-    if(newline_count >= NUM_LINES_PER_PAGE) {
-      curr_page++;
-      newline_count = 0;
-    }
-    page++;
-  }
+  int start = dsock->page_offsets[page_num - 1];
+  int   end = dsock->page_offsets[page_num];
 
-  // copy our page to the buf
-  while(*page && newline_count < NUM_LINES_PER_PAGE) {
-    if(*page == '\n')
-      newline_count++;
-    buf[buf_i] = *page;
-    page++;
-    buf_i++;
-  }
+  // if we're at the head of the outbuf and haven't entered a command, 
+  // also copy a newline so we're not printing in front of the prompt
+  if(dsock->num_frags > 0)
+    socket_flatten_frags(dsock);
+  if(bufferLength(dsock->outbuf) == 0 && !dsock->bust_prompt)
+    bufferCat(dsock->outbuf, "\r\n");
+  bufferCatLen(dsock->outbuf, dsock->page_string + start, end - start);
 
-  buf[buf_i] = '\0';
-  text_to_buffer(dsock, buf);
   if(dsock->tot_pages != 1)
     send_to_socket(dsock, "{c[{ypage %d of %d. Use MORE to view next page or BACK to view previous{c]{n\r\n",
 		   page_num, dsock->tot_pages);
@@ -1025,17 +2655,17 @@ void show_page(SOCKET_DATA *dsock, int page_num) {
 
 
 void delete_page(SOCKET_DATA *dsock) {
-  if(dsock->page_string) free(dsock->page_string);
-  dsock->page_string = NULL;
+  if(dsock->page_string)  free(dsock->page_string);
+  if(dsock->page_offsets) free(dsock->page_offsets);
+  dsock->page_string  = NULL;
+  dsock->page_offsets = NULL;
   dsock->tot_pages = 0;
   dsock->curr_page = 0;
 }
 
 void  page_string(SOCKET_DATA *dsock, const char *string) {
-  if(dsock->page_string) 
-    free(dsock->page_string);
-  dsock->page_string = strdup(string);
-  dsock->tot_pages   = count_pages(string);
+  delete_page(dsock);
+  page_build(dsock, string);
   
   if(dsock->tot_pages == 1) {
     text_to_buffer(dsock, dsock->page_string);
@@ -1105,64 +2735,197 @@ void  start_reader(SOCKET_DATA *dsock, const char *text) {
 }
 
 
-void do_copyover(void) {
+//
+// can the socket be carried over to the next process? Only if it's playing a
+// character, and it isn't relying on TLS or WebSocket state we'd lose
+bool copyover_keeps(SOCKET_DATA *sock) {
+  return (socketGetChar(sock) && socketGetAccount(sock) &&
+	  charGetRoom(socketGetChar(sock)) && !sock->tls && !sock->ws);
+}
+
+//
+// save a playing socket's character and account, and write the line
+// copyover_recover_fds reads it back from, with desc as its descriptor. When
+// we're hot, its compression stream is handed off, too
+void copyover_save_socket(SOCKET_DATA *sock, FILE *fp, int desc, bool hot) {
+  unsigned char compressing = 0;
+  unsigned long       adler = 0;
+
+  save_player(sock->player);
+  save_account(sock->account);
+  if (hot && sock->out_compress) {
+    compressing = sock->compressing;
+    if (!compressSuspend(sock, &adler)) {
+      compressEnd(sock, sock->compressing, TRUE);
+      compressing = 0;
+    }
+  }
+  fprintf(fp, "%d %s %s %s %d %lu\n", desc, accountGetName(sock->account), 
+	  charGetName(sock->player), sock->hostname, compressing, adler);
+}
+
+//
+// tell a socket we can't carry over that we're rebooting, and close it.
+// Anyone playing is saved first. The next process can't pick up where our
+// TLS or WebSocket leaves off, so they have to reconnect; a TLS session
+// ticket makes that quick
+void copyover_drop_socket(SOCKET_DATA *sock) {
+  if (!socketGetChar(sock) || !socketGetAccount(sock) || 
+      !charGetRoom(socketGetChar(sock)))
+    text_to_socket(sock, "\r\nSorry, we are rebooting. Come back in a few minutes.\r\n");
+  else {
+    save_player(sock->player);
+    save_account(sock->account);
+    text_to_socket(sock, "\r\nWe are rebooting. Reconnect in a moment.\r\n");
+  }
+  close_socket(sock, FALSE);
+}
+
+void do_copyover(bool hot) {
   LIST_ITERATOR *sock_i = newListIterator(socket_list);
   SOCKET_DATA     *sock = NULL;
   FILE *fp;
   char buf[100];
-  char control_buf[20];
   char port_buf[20];
+  char *args[8];
+  int nargs = 0;
 
   if ((fp = fopen(COPYOVER_FILE, "w+")) == NULL)
     return;
 
-  sprintf(buf, "\n\r <*>            The world starts spinning             <*>\n\r");
+  sprintf(buf, "\n\r <*>            The world starts spinning             <*>\n\r");
+
+  // For each playing descriptor, save its character and account
+  ITERATE_LIST(sock, sock_i) {
+    // on a hot copyover, compression carries on where we leave off
+    if (!hot)
+      compressEnd(sock, sock->compressing, FALSE);
+    // save account and player info to file
+    if (copyover_keeps(sock)) {
+      text_to_socket(sock, buf);
+      copyover_save_socket(sock, fp, sock->control, hot);
+    }
+    else
+      copyover_drop_socket(sock);
+    // anything still queued up is lost when we exec, so try once more
+    outq_drain(sock);
+  } deleteListIterator(sock_i);
+  
+  fprintf (fp, "-1\n");
+  fclose (fp);
+
+  // everything saved has to be on disk before the next process reads it
+  journalFlush();
+  worldFlushDirty(gameworld);
+  saveQueueFlush();
+
+  // on a hot copyover, the world comes back as it is rather than being reset
+  if (hot) {
+    STORAGE_SET *set = worldStoreRooms(gameworld);
+    storage_write(set, COPYOVER_WORLD_FILE);
+    storage_close(set);
+  }
+
+  // close any pending sockets
+  recycle_sockets();
+
+#ifdef MODULE_WEBSERVER
+  // if we have a webserver set up, finalize that
+  finalize_webserver();
+#endif
+  
+  // exec - descriptors are inherited, our listeners included
+  sprintf(port_buf, "%d", mudport);
+  
+  args[nargs++] = "NakedMud";
+  args[nargs++] = "-copyover";
+  args[nargs++] = (char *) listenersGetFds();
+  if(hot)
+    args[nargs++] = "-hot";
+
+  // check if a custom mudlib path was set and preserve it
+  const char *current_mudlib = get_mudlib_path();
+  if(current_mudlib && strcmp(current_mudlib, "../lib") != 0) {
+    args[nargs++] = "--mudlib-path";
+    args[nargs++] = (char *) current_mudlib;
+  }
+  args[nargs++] = port_buf;
+  args[nargs]   = NULL;
+
+  // the log writer doesn't survive the exec either
+  logQueueFlush();
+  execv(EXE_FILE, args);
+}
+
+
+
+int socketsHandoff(FILE *fp, int *fds, int num_fds, int max_fds) {
+  LIST_ITERATOR *sock_i = newListIterator(socket_list);
+  SOCKET_DATA     *sock = NULL;
+
+  ITERATE_LIST(sock, sock_i) {
+    if (sock->closed)
+      continue;
+    // everyone playing is saved now, so the new process can load the ones
+    // it takes over, and the ones it doesn't can reconnect to it right away
+    if (!copyover_keeps(sock) || num_fds >= max_fds || !outq_drain(sock)) {
+      if (socketGetChar(sock) && socketGetAccount(sock) &&
+	  charGetRoom(socketGetChar(sock))) {
+	save_player(sock->player);
+	save_account(sock->account);
+      }
+      continue;
+    }
+    copyover_save_socket(sock, fp, num_fds, TRUE);
+    sock->handed_off = TRUE;
+    fds[num_fds++]   = sock->control;
+  } deleteListIterator(sock_i);
+  fprintf(fp, "-1\n");
+
+  journalFlush();
+  worldFlushDirty(gameworld);
+  saveQueueFlush();
+  return num_fds;
+}
+
+void socketsHandoffAbort(FILE *fp, const int *fds, int num_fds) {
+  LIST_ITERATOR *sock_i = newListIterator(socket_list);
+  SOCKET_DATA     *sock = NULL;
+  char acct[100], name[100], host[MAX_BUFFER];
+  int desc, compressing;
+  unsigned long adler;
+
+  // pick the compression streams we suspended up again
+  while (fscanf(fp, "%d", &desc) == 1 && desc != -1) {
+    fscanf(fp, " %s %s %s %d %lu\n", acct, name, host, &compressing, &adler);
+    if (!compressing || desc < 0 || desc >= num_fds)
+      continue;
+    ITERATE_LIST(sock, sock_i) {
+      if (sock->handed_off && sock->control == fds[desc] &&
+	  !compressResume(sock, compressing, adler))
+	close_socket(sock, FALSE);
+    }
+    listIteratorReset(sock_i);
+  }
+
+  ITERATE_LIST(sock, sock_i) {
+    sock->handed_off = FALSE;
+  } deleteListIterator(sock_i);
+}
+
+void socketsHandoffDone(void) {
+  LIST_ITERATOR *sock_i = newListIterator(socket_list);
+  SOCKET_DATA     *sock = NULL;
 
-  // For each playing descriptor, save its character and account
+  // the sockets that were handed off belong to the new process now, and we
+  // leave them be. Everyone else has to reconnect to it
   ITERATE_LIST(sock, sock_i) {
-    compressEnd(sock, sock->compressing, FALSE);
-    // kick off anyone who hasn't yet logged in a character
-    if (!socketGetChar(sock) || !socketGetAccount(sock) || 
-	!charGetRoom(socketGetChar(sock))) {
-      text_to_socket(sock, "\r\nSorry, we are rebooting. Come back in a few minutes.\r\n");
+    if (!sock->handed_off && !sock->closed) {
+      text_to_socket(sock, "\r\nWe are rebooting. Reconnect in a moment.\r\n");
       close_socket(sock, FALSE);
     }
-    // save account and player info to file
-    else {
-      fprintf(fp, "%d %s %s %s\n",
-	      sock->control, accountGetName(sock->account), 
-	      charGetName(sock->player), sock->hostname);
-      // save the player
-      save_player(sock->player);
-      save_account(sock->account);
-      text_to_socket(sock, buf);
-    }
   } deleteListIterator(sock_i);
-  
-  fprintf (fp, "-1\n");
-  fclose (fp);
-
-  // close any pending sockets
   recycle_sockets();
-
-#ifdef MODULE_WEBSERVER
-  // if we have a webserver set up, finalize that
-  finalize_webserver();
-#endif
-  
-  // exec - descriptors are inherited
-  sprintf(control_buf, "%d", control);
-  sprintf(port_buf, "%d", mudport);
-  
-  // check if a custom mudlib path was set and preserve it
-  const char *current_mudlib = get_mudlib_path();
-  if(current_mudlib && strcmp(current_mudlib, "../lib") != 0) {
-    // custom mudlib path was set, preserve it in copyover
-    execl(EXE_FILE, "NakedMud", "-copyover", control_buf, "--mudlib-path", current_mudlib, port_buf, NULL);
-  } else {
-    // using default mudlib path
-    execl(EXE_FILE, "NakedMud", "-copyover", control_buf, port_buf, NULL);
-  }
 }
 
 
@@ -1176,6 +2939,7 @@ CHAR_DATA *socketGetChar     ( SOCKET_DATA *dsock) {
 
 void       socketSetChar     ( SOCKET_DATA *dsock, CHAR_DATA *ch) {
   dsock->player = ch;
+  socketIndexChanged();
 }
 
 ACCOUNT_DATA *socketGetAccount ( SOCKET_DATA *dsock) {
@@ -1190,7 +2954,18 @@ BUFFER *socketGetTextEditor   ( SOCKET_DATA *sock) {
   return sock->text_editor;
 }
 
+int socketGetColourMode(SOCKET_DATA *sock) {
+  return sock->colour_mode;
+}
+
+void socketSetColourMode(SOCKET_DATA *sock, int mode) {
+  if(mode >= 0 && mode < NUM_COLOUR_MODES)
+    sock->colour_mode = mode;
+}
+
 BUFFER *socketGetOutbound    ( SOCKET_DATA *sock) {
+  if(sock->num_frags > 0)
+    socket_flatten_frags(sock);
   return sock->outbuf;
 }
 
@@ -1225,10 +3000,20 @@ void socketReplacePyInputHandler(SOCKET_DATA *sock, void *handler,void *prompt,
 }
 
 const char *socketGetLastCmd(SOCKET_DATA *sock) {
-  if(listSize(sock->command_hist) == 0)
-    return "";
-  else
-    return listHead(sock->command_hist);
+  const char *cmd = socket_hist_get(sock, 0);
+  return (cmd ? cmd : "");
+}
+
+const char *socketGetHistoryCmd(SOCKET_DATA *sock, int n) {
+  return socket_hist_get(sock, n);
+}
+
+int socketGetHistorySize(SOCKET_DATA *sock) {
+  return sock->hist_size;
+}
+
+void socketSetHistorySize(SOCKET_DATA *sock, int size) {
+  socket_hist_resize(sock, MAX(0, size));
 }
 
 void socketPopInputHandler   ( SOCKET_DATA *socket) {
@@ -1245,8 +3030,31 @@ void socketReplaceInputHandler( SOCKET_DATA *socket,
   socketPushInputHandler(socket, handler, prompt, state);
 }
 
+//
+// put a command at the end of our input list. The whole thing is one
+// allocation, so the list can still be emptied with free
+void socket_queue_cmd(SOCKET_DATA *sock, const char *cmd, bool expanded) {
+  int         len = strlen(cmd);
+  QUEUED_CMD *queued = malloc(sizeof(QUEUED_CMD) + len + 1);
+  queued->expanded = expanded;
+  memcpy(queued->cmd, cmd, len + 1);
+  listQueue(sock->input, queued);
+}
+
 void socketQueueCommand( SOCKET_DATA *sock, const char *cmd) {
-  listQueue(sock->input, strdup(cmd));
+  socket_queue_cmd(sock, cmd, FALSE);
+}
+
+void socketQueueExpansion(SOCKET_DATA *sock, LIST *cmds) {
+  LOCAL_LIST_ITERATOR(cmd_i, cmds);
+  const char *cmd = NULL;
+  ITERATE_LIST(cmd, cmd_i) {
+    socket_queue_cmd(sock, cmd, TRUE);
+  } listIteratorFinish(cmd_i);
+}
+
+bool socketCmdIsExpanded(SOCKET_DATA *sock) {
+  return sock->cmd_expanded;
 }
 
 bool socketHasCommand(SOCKET_DATA *sock) {
@@ -1257,6 +3065,10 @@ int socketGetUID( SOCKET_DATA *dsock) {
   return dsock->uid;
 }
 
+bool socketIsClosed(SOCKET_DATA *sock) {
+  return sock->closed;
+}
+
 bool socketHasPrompt(SOCKET_DATA *sock) {
   IH_PAIR *pair = listGet(sock->input_handlers, 0);
   return (pair != NULL && pair->prompt != NULL);
@@ -1286,6 +3098,10 @@ void *socketGetAuxiliaryData  ( SOCKET_DATA *sock, const char *name) {
   return auxiliaryGet(sock->auxiliary, name);
 }
 
+void *socketGetAuxiliarySlot  ( SOCKET_DATA *sock, int slot) {
+  return auxiliaryGetSlot(sock->auxiliary, slot);
+}
+
 const char *socketGetHostname(SOCKET_DATA *sock) {
   return sock->hostname;
 }
@@ -1307,7 +3123,43 @@ const char *socketGetState(SOCKET_DATA *sock) {
 }
 
 double socketGetIdleTime(SOCKET_DATA *sock) {
-  return sock->idle;
+  return (double)(idle_pulses - sock->active_pulse) / MAX(1,PULSES_PER_SECOND);
+}
+
+bool socketIsAfk(SOCKET_DATA *sock) {
+  return sock->afk;
+}
+
+bool socketIsTls(SOCKET_DATA *sock) {
+  return (sock->tls != NULL);
+}
+
+bool socketIsWebSocket(SOCKET_DATA *sock) {
+  return (sock->ws != NULL);
+}
+
+long long socketGetBytesSent(SOCKET_DATA *sock) {
+  return sock->tot_bytes;
+}
+
+long long socketTotalBytesRead(void) {
+  return atomic_load(&total_bytes_read);
+}
+
+long long socketTotalBytesWritten(void) {
+  return atomic_load(&total_bytes_written);
+}
+
+long long socketTotalMCCPRaw(void) {
+  return atomic_load(&total_mccp_raw);
+}
+
+long long socketTotalMCCPCompressed(void) {
+  return atomic_load(&total_mccp_compressed);
+}
+
+long long socketTotalMCCPUsec(void) {
+  return atomic_load(&total_mccp_usec);
 }
 
 
@@ -1337,9 +3189,6 @@ double socketGetIdleTime(SOCKET_DATA *sock) {
 #include "utils.h"
 */
 
-/* local functions */
-bool  processCompressed       ( SOCKET_DATA *dsock );
-
 const unsigned char enable_compress  [] = { IAC, SB, TELOPT_COMPRESS, WILL, SE, 0 };
 const unsigned char enable_compress2 [] = { IAC, SB, TELOPT_COMPRESS2, IAC, SE, 0 };
 
@@ -1357,17 +3206,13 @@ void zlib_free(void *opaque, void *address)
   free(address);
 }
 
-/*
- * Begin compressing data on `desc'
- */
-bool compressStart(SOCKET_DATA *dsock, unsigned char teleopt)
+//
+// set up a compression stream for the socket. A raw stream has no header or
+// trailer, for carrying on one that someone else started
+bool compress_init(SOCKET_DATA *dsock, bool raw)
 {
   z_stream *s;
 
-  /* already compressing */
-  if (dsock->out_compress)
-    return TRUE;
-
   /* allocate and init stream, buffer */
   s = (z_stream *) malloc(sizeof(*s));
   dsock->out_compress_buf = (unsigned char *) malloc(COMPRESS_BUF_SIZE);
@@ -1380,34 +3225,128 @@ bool compressStart(SOCKET_DATA *dsock, unsigned char teleopt)
   s->zfree      =  zlib_free;
   s->opaque     =  NULL;
 
-  if (deflateInit(s, 9) != Z_OK)
+  if (deflateInit2(s, COMPRESS_LEVEL, Z_DEFLATED,
+		   (raw ? -COMPRESS_WINDOW_BITS : COMPRESS_WINDOW_BITS),
+		   COMPRESS_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
   {
     free(dsock->out_compress_buf);
     free(s);
+    dsock->out_compress_buf = NULL;
     return FALSE;
   }
 
-  /* version 1 or 2 support */
-  if (teleopt == TELOPT_COMPRESS)
-    text_to_socket(dsock, (char *) enable_compress);
-  else if (teleopt == TELOPT_COMPRESS2)
-    text_to_socket(dsock, (char *) enable_compress2);
-  else
+  dsock->out_compress   = s;
+  dsock->compress_level = COMPRESS_LEVEL;
+
+  /* hand our compression off to the worker threads, if we have them */
+  if (compress_pool != NULL)
+  {
+    dsock->comp_in      = newSPSCQueue(COMPRESS_QUEUE_SIZE);
+    dsock->comp_out     = newSPSCQueue(COMPRESS_QUEUE_SIZE);
+    dsock->comp_backlog = newList();
+  }
+  return TRUE;
+}
+
+//
+// throw away a compression stream we set up, without finishing it
+void compress_discard(SOCKET_DATA *dsock)
+{
+  if (dsock->comp_in != NULL)
+  {
+    deleteSPSCQueueWith(dsock->comp_in, free);
+    deleteSPSCQueueWith(dsock->comp_out, free);
+    deleteListWith(dsock->comp_backlog, free);
+    dsock->comp_in      = NULL;
+    dsock->comp_out     = NULL;
+    dsock->comp_backlog = NULL;
+  }
+  deflateEnd(dsock->out_compress);
+  free(dsock->out_compress_buf);
+  free(dsock->out_compress);
+  dsock->compressing      = 0;
+  dsock->out_compress     = NULL;
+  dsock->out_compress_buf = NULL;
+  dsock->compress_raw     = FALSE;
+  dsock->compress_adler   = 0;
+}
+
+/*
+ * Begin compressing data on `desc'
+ */
+bool compressStart(SOCKET_DATA *dsock, unsigned char teleopt)
+{
+  /* already compressing */
+  if (dsock->out_compress)
+    return TRUE;
+
+  if (teleopt != TELOPT_COMPRESS && teleopt != TELOPT_COMPRESS2)
   {
     bug("Bad teleoption %d passed", teleopt);
-    free(dsock->out_compress_buf);
-    free(s);
     return FALSE;
   }
 
+  if (!compress_init(dsock, FALSE))
+    return FALSE;
+
+  /* version 1 or 2 support. This goes out ahead of the stream, uncompressed */
+  if (teleopt == TELOPT_COMPRESS)
+    socket_send_raw(dsock, (char *) enable_compress, 
+		    strlen((char *) enable_compress));
+  else
+    socket_send_raw(dsock, (char *) enable_compress2, 
+		    strlen((char *) enable_compress2));
+
   /* now we're compressing */
   dsock->compressing = teleopt;
-  dsock->out_compress = s;
 
   /* success */
   return TRUE;
 }
 
+//
+// stop compressing on the socket without ending the stream, so another
+// process (e.g. us, after a hot copyover) can pick up where we left off with
+// compressResume. Everything we've compressed is sent, and adler is set to
+// the checksum the stream will need at its end.
+bool compressSuspend(SOCKET_DATA *dsock, unsigned long *adler)
+{
+  if (!dsock->out_compress)
+    return FALSE;
+
+  /* finish with everything we've handed off to the worker threads */
+  if (dsock->comp_in != NULL && !compress_sync(dsock))
+    return FALSE;
+
+  /* flush everything out, so the stream ends on a byte boundary */
+  dsock->out_compress->next_out  = dsock->out_compress_buf;
+  if (!compress_to_socket(dsock, "", 0, Z_SYNC_FLUSH))
+    return FALSE;
+
+  *adler = (dsock->compress_raw ? dsock->compress_adler : 
+	    dsock->out_compress->adler);
+  compress_discard(dsock);
+  return TRUE;
+}
+
+//
+// carry on with a compression stream that was suspended by compressSuspend.
+// The client already has the stream's header, so we continue it with raw
+// deflate blocks, keep its checksum ourselves, and write its trailer when
+// compression ends
+bool compressResume(SOCKET_DATA *dsock, unsigned char teleopt, 
+		    unsigned long adler)
+{
+  if (dsock->out_compress)
+    return FALSE;
+  if (!compress_init(dsock, TRUE))
+    return FALSE;
+  dsock->compressing    = teleopt;
+  dsock->compress_raw   = TRUE;
+  dsock->compress_adler = adler;
+  return TRUE;
+}
+
 /* Cleanly shut down compression on `desc' */
 bool compressEnd(SOCKET_DATA *dsock, unsigned char teleopt, bool forced)
 {
@@ -1419,6 +3358,12 @@ bool compressEnd(SOCKET_DATA *dsock, unsigned char teleopt, bool forced)
   if (dsock->compressing != teleopt)
     return FALSE;
 
+  /* finish compressing everything we've handed off to the worker threads */
+  if (dsock->comp_in != NULL && !compress_sync(dsock) && !forced)
+    return FALSE;
+
+  dsock->out_compress->next_out = dsock->out_compress_buf;
+  dsock->out_compress->avail_out = COMPRESS_BUF_SIZE;
   dsock->out_compress->avail_in = 0;
   dsock->out_compress->next_in = dummy;
 
@@ -1430,57 +3375,449 @@ bool compressEnd(SOCKET_DATA *dsock, unsigned char teleopt, bool forced)
   if (!processCompressed(dsock) && !forced)
     return FALSE;
 
+  /* a raw stream has no trailer of its own, so we have to supply the one */
+  /* the stream we're continuing would have ended with                     */
+  if (dsock->compress_raw)
+  {
+    unsigned char trailer[4];
+    trailer[0] = (dsock->compress_adler >> 24) & 0xFF;
+    trailer[1] = (dsock->compress_adler >> 16) & 0xFF;
+    trailer[2] = (dsock->compress_adler >>  8) & 0xFF;
+    trailer[3] =  dsock->compress_adler        & 0xFF;
+    if (!socket_send_raw(dsock, (char *) trailer, 4) && !forced)
+      return FALSE;
+  }
+
   /* reset compression values */
-  deflateEnd(dsock->out_compress);
-  free(dsock->out_compress_buf);
-  free(dsock->out_compress);
-  dsock->compressing      = 0;
-  dsock->out_compress     = NULL;
-  dsock->out_compress_buf = NULL;
+  compress_discard(dsock);
 
   /* success */
   return TRUE;
 }
 
-/* Try to send any pending compressed-but-not-sent data in `desc' */
-bool processCompressed(SOCKET_DATA *dsock)
-{
-  int iStart, nBlock, nWrite, len;
+//
+// the deflate level we should compress a flush of the given length at. Small
+// flushes barely compress, and aren't worth the time, so they go into the
+// stream as stored blocks instead. When the game is running behind, we
+// trade bandwidth for the CPU time
+int compress_level_for(int length) {
+  long long budget = 1000000 / MAX(1, PULSES_PER_SECOND);
+  long long   last = pulsePhaseGetLast(PULSE_PHASE_TOTAL);
+  if (length < COMPRESS_MIN_BYTES)
+    return Z_NO_COMPRESSION;
+
+  // don't flip back and forth around the line; each switch costs a flush
+  if (COMPRESS_BUSY_PERCENT <= 0)
+    compress_busy = FALSE;
+  else if (last * 100 > budget * COMPRESS_BUSY_PERCENT)
+    compress_busy = TRUE;
+  else if (last * 200 < budget * COMPRESS_BUSY_PERCENT)
+    compress_busy = FALSE;
+  return (compress_busy ? MIN(COMPRESS_LEVEL, COMPRESS_BUSY_LEVEL) :
+	  COMPRESS_LEVEL);
+}
 
-  if (!dsock->out_compress)
-    return TRUE;
-    
-  len = dsock->out_compress->next_out - dsock->out_compress_buf;
-  if (len > 0)
-  {
-    for (iStart = 0; iStart < len; iStart += nWrite)
+//
+// switch the socket's compression stream to a new level, if it isn't already
+// at it. Whatever zlib has to flush out goes into the compression buffer,
+// which must have been set up for output
+void compress_set_level(SOCKET_DATA *dsock, int level) {
+  if (dsock->compress_level == level)
+    return;
+  dsock->out_compress->avail_out = COMPRESS_BUF_SIZE - 
+    (dsock->out_compress->next_out - dsock->out_compress_buf);
+  // if zlib can't switch right now, stay where we are and try again later
+  if (deflateParams(dsock->out_compress, level, Z_DEFAULT_STRATEGY) == Z_OK)
+    dsock->compress_level = level;
+}
+
+//
+// get ready to compress a flush of the given length on the game thread
+void compress_prepare(SOCKET_DATA *dsock, int length) {
+  compress_set_level(dsock, compress_level_for(length));
+}
+
+//
+// compress a piece of output for the socket, and return what comes out of
+// it. Runs on a compression worker
+COMPRESS_ITEM *compress_run(SOCKET_DATA *dsock, COMPRESS_ITEM *in) {
+  z_stream        *z = dsock->out_compress;
+  int           size = in->len + 64;
+  long long    start = compress_cpu_clock();
+  COMPRESS_ITEM *out = malloc(sizeof(COMPRESS_ITEM) + size);
+  out->len   = 0;
+  out->level = in->level;
+
+  z->next_out = dsock->out_compress_buf;
+  compress_set_level(dsock, in->level);
+  z->next_in  = (unsigned char *) in->data;
+  z->avail_in = in->len;
+  if (dsock->compress_raw)
+    dsock->compress_adler = adler32(dsock->compress_adler, 
+				    (unsigned char *) in->data, in->len);
+
+  do {
+    int len;
+    z->avail_out = COMPRESS_BUF_SIZE - (z->next_out - dsock->out_compress_buf);
+    if (z->avail_out) 
     {
-      nBlock = UMIN (len - iStart, 4096);
-      if ((nWrite = write(dsock->control, dsock->out_compress_buf + iStart, nBlock)) < 0)
+      int status = deflate(z, Z_SYNC_FLUSH);
+      if (status != Z_OK && status != Z_BUF_ERROR)
       {
-        if (errno == EAGAIN/* || errno == ENOSR*/)
-          break;
-
-        /* write error */
-        return FALSE;
+	out->len = -1;
+	break;
       }
-      if (nWrite <= 0)
-        break;
     }
 
-    if (iStart)
+    // move what came out of deflate over to our output
+    len = z->next_out - dsock->out_compress_buf;
+    if (out->len + len > size)
     {
-      if (iStart < len)
-        memmove(dsock->out_compress_buf, dsock->out_compress_buf+iStart, len - iStart);
-
-      dsock->out_compress->next_out = dsock->out_compress_buf + len - iStart;
+      size = MAX(size * 2, out->len + len);
+      out  = realloc(out, sizeof(COMPRESS_ITEM) + size);
     }
+    memcpy(out->data + out->len, dsock->out_compress_buf, len);
+    out->len   += len;
+    z->next_out = dsock->out_compress_buf;
+  } while (z->avail_in > 0 || z->avail_out == 0);
+
+  z->next_in  = NULL;
+  z->avail_in = 0;
+  if (out->len > 0)
+    compress_note(dsock, in->len, out->len, compress_cpu_clock() - start);
+  return out;
+}
+
+//
+// the job a compression worker runs for a socket with output waiting. We
+// compress pieces in the order they were queued, until we run out or the
+// game thread has too many waiting to be sent
+void compress_worker_job(SOCKET_DATA *dsock) {
+  COMPRESS_ITEM *item = NULL;
+  while (!spscQueueIsFull(dsock->comp_out) &&
+	 (item = spscQueuePop(dsock->comp_in)) != NULL)
+  {
+    spscQueuePush(dsock->comp_out, compress_run(dsock, item));
+    free(item);
   }
+  atomic_store(&dsock->comp_busy, FALSE);
+}
 
-  /* success */
+//
+// move what we can from the socket's backlog to its compression queue, and
+// have a worker start compressing it, unless one already is
+void compress_dispatch(SOCKET_DATA *dsock) {
+  COMPRESS_ITEM *item = NULL;
+  while ((item = listHead(dsock->comp_backlog)) != NULL &&
+	 spscQueuePush(dsock->comp_in, item))
+    listPop(dsock->comp_backlog);
+
+  if (spscQueueIsEmpty(dsock->comp_in) ||
+      atomic_exchange(&dsock->comp_busy, TRUE))
+    return;
+  workerPoolAdd(compress_pool, compress_worker_job, dsock);
+}
+
+//
+// queue up a flush of output to be compressed by a worker
+bool compress_queue(SOCKET_DATA *dsock, const struct iovec *iov, int iovcnt) {
+  COMPRESS_ITEM *item = NULL;
+  int i, length = 0;
+
+  for (i = 0; i < iovcnt; i++)
+    length += iov[i].iov_len;
+
+  item = malloc(sizeof(COMPRESS_ITEM) + length);
+  item->len   = length;
+  item->level = compress_level_for(length);
+  for (length = 0, i = 0; i < iovcnt; i++)
+  {
+    memcpy(item->data + length, iov[i].iov_base, iov[i].iov_len);
+    length += iov[i].iov_len;
+  }
+
+  // everything has to go through the backlog once anything is in it, or
+  // pieces would go out of order
+  if (listSize(dsock->comp_backlog) > 0 || 
+      !spscQueuePush(dsock->comp_in, item))
+    listQueue(dsock->comp_backlog, item);
+  compress_dispatch(dsock);
   return TRUE;
 }
 
+//
+// send along whatever our compression worker has finished, and hand it more
+// if there is still some waiting. Returns FALSE if compression or sending
+// failed
+bool compress_collect(SOCKET_DATA *dsock) {
+  COMPRESS_ITEM *item = NULL;
+  bool         status = TRUE;
+  while ((item = spscQueuePop(dsock->comp_out)) != NULL)
+  {
+    if (status && 
+	(item->len < 0 || !socket_send_raw(dsock, item->data, item->len)))
+      status = FALSE;
+    free(item);
+  }
+  if (status)
+    compress_dispatch(dsock);
+  return status;
+}
+
+//
+// wait for everything the socket has handed off to be compressed and sent.
+// Afterwards, the game thread has the compression stream to itself again
+bool compress_sync(SOCKET_DATA *dsock) {
+  bool status = TRUE;
+  do {
+    compress_dispatch(dsock);
+    workerPoolWait(compress_pool);
+    if (!compress_collect(dsock))
+      status = FALSE;
+  } while (status && (!spscQueueIsEmpty(dsock->comp_in) || 
+		      listSize(dsock->comp_backlog) > 0));
+
+  // make sure no worker is still holding on to us
+  workerPoolWait(compress_pool);
+  return status;
+}
+
+void init_compress_threads(void) {
+  int threads = mudsettingGetInt("compress_threads");
+  if (threads <= 0)
+    return;
+  if ((compress_pool = newWorkerPool("compress", threads)) != NULL)
+    log_string("Compressing socket output on %d worker threads.",
+	       workerPoolGetSize(compress_pool));
+}
+
+//
+// sort sockets by how long their slowest commands took to finish, most first
+int inputstat_cmp(SOCKET_DATA *a, SOCKET_DATA *b) {
+  long long a99 = socket_latency_pct(a, 99), b99 = socket_latency_pct(b, 99);
+  return (a99 < b99 ? 1 : (a99 > b99 ? -1 : 0));
+}
+
+//
+// show how long after the start of each pulse's input pass the commands of
+// each socket finished. Sockets that go first every time would show up here
+COMMAND(cmd_inputstat) {
+  LIST_ITERATOR *sock_i = NULL;
+  SOCKET_DATA     *sock = NULL;
+  if(!strcasecmp(arg, "reset")) {
+    sock_i = newListIterator(socket_list);
+    ITERATE_LIST(sock, sock_i) {
+      memset(sock->latency, 0, sizeof(sock->latency));
+      sock->latency_cmds = sock->latency_max = 0;
+      sock->in_dropped   = sock->in_snoozes  = 0;
+    } deleteListIterator(sock_i);
+    send_to_char(ch, "Input statistics reset.\r\n");
+    return;
+  }
+  else if(*arg) {
+    send_to_char(ch, "Usage: inputstat [reset]\r\n");
+    return;
+  }
+
+  BUFFER    *buf = newBuffer(MAX_BUFFER);
+  LIST *sockets = newList();
+  sock_i = newListIterator(socket_list);
+  ITERATE_LIST(sock, sock_i) {
+    if(!sock->closed && (sock->latency_cmds > 0 || sock->in_dropped > 0 ||
+			 sock->in_snoozes > 0))
+      listPut(sockets, sock);
+  } deleteListIterator(sock_i);
+  listSortWith(sockets, inputstat_cmp);
+
+  bprintf(buf, "Sockets run %d commands per pulse for at most %d usec.\r\n"
+	  "They can send %d lines a second, %d at once, and are snoozed "
+	  "after %d seconds of that.\r\n"
+	  "Latency is from the start of the input pass, in usec.\r\n\r\n",
+	  mudsettingGetInt("commands_per_pulse"),
+	  mudsettingGetInt("command_budget_usec"),
+	  mudsettingGetInt("input_lines_per_second"),
+	  mudsettingGetInt("input_burst"),
+	  mudsettingGetInt("input_snooze_strikes"));
+  bprintf(buf, "{c%-20s %-20s %10s %8s %8s %8s %10s %8s %7s{n\r\n",
+	  "Character", "Host", "Commands", "50%", "90%", "99%", "Max",
+	  "Dropped", "Snoozes");
+  int count = 0;
+  sock_i = newListIterator(sockets);
+  ITERATE_LIST(sock, sock_i) {
+    if(count++ >= 30)
+      break;
+    bprintf(buf, "%-20.20s %-20.20s %10lld %8lld %8lld %8lld %10lld %8lld "
+	    "%6lld%s\r\n",
+	    (sock->player ? charGetName(sock->player) : "(none)"),
+	    (sock->hostname ? sock->hostname : "(unknown)"),
+	    sock->latency_cmds, socket_latency_pct(sock, 50),
+	    socket_latency_pct(sock, 90), socket_latency_pct(sock, 99),
+	    sock->latency_max, sock->in_dropped, sock->in_snoozes,
+	    (sock->in_snooze_end > 0 ? "*" : " "));
+  } deleteListIterator(sock_i);
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
+  deleteList(sockets);
+}
+
+//
+// sort sockets by how many writes they made in the last second, most first
+int outputstat_cmp(SOCKET_DATA *a, SOCKET_DATA *b) {
+  if(a->writes_per_sec != b->writes_per_sec)
+    return (a->writes_per_sec < b->writes_per_sec ? 1 : -1);
+  return (a->bytes_per_sec < b->bytes_per_sec ? 1 :
+	  a->bytes_per_sec > b->bytes_per_sec ? -1 : 0);
+}
+
+//
+// show how many writes sockets are making, and how much they're writing
+COMMAND(cmd_outputstat) {
+  LIST_ITERATOR *sock_i = NULL;
+  SOCKET_DATA     *sock = NULL;
+  if(!strcasecmp(arg, "reset")) {
+    sock_i = newListIterator(socket_list);
+    ITERATE_LIST(sock, sock_i) {
+      sock->tot_writes = sock->tot_bytes = 0;
+    } deleteListIterator(sock_i);
+    send_to_char(ch, "Output statistics reset.\r\n");
+    return;
+  }
+  else if(*arg) {
+    send_to_char(ch, "Usage: outputstat [reset]\r\n");
+    return;
+  }
+
+  BUFFER    *buf = newBuffer(MAX_BUFFER);
+  LIST *sockets = newList();
+  long long writes = 0, bytes = 0;
+  sock_i = newListIterator(socket_list);
+  ITERATE_LIST(sock, sock_i) {
+    if(sock->closed)
+      continue;
+    socket_io_roll(sock);
+    listPut(sockets, sock);
+    writes += sock->writes_per_sec;
+    bytes  += sock->bytes_per_sec;
+  } deleteListIterator(sock_i);
+  listSortWith(sockets, outputstat_cmp);
+
+  bprintf(buf, "Output under %d bytes that isn't a reply to a command is "
+	  "held for up to %d usec.\r\n"
+	  "All sockets made %lld writes of %lld bytes in the last second."
+	  "\r\n\r\n", 
+	  mudsettingGetInt("output_coalesce_bytes"),
+	  mudsettingGetInt("output_coalesce_usec"), writes, bytes);
+  bprintf(buf, "{c%-20s %-20s %8s %10s %10s %12s{n\r\n",
+	  "Character", "Host", "Writes/s", "Bytes/s", "Writes", "Bytes");
+  int count = 0;
+  sock_i = newListIterator(sockets);
+  ITERATE_LIST(sock, sock_i) {
+    if(count++ >= 30)
+      break;
+    bprintf(buf, "%-20.20s %-20.20s %8d %10lld %10lld %12lld\r\n",
+	    (sock->player ? charGetName(sock->player) : "(none)"),
+	    (sock->hostname ? sock->hostname : "(unknown)"),
+	    sock->writes_per_sec, sock->bytes_per_sec,
+	    sock->tot_writes, sock->tot_bytes);
+  } deleteListIterator(sock_i);
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
+  deleteList(sockets);
+}
+
+//
+// sort sockets by how much CPU time compressing their output has taken, most
+// first
+int compressstat_cmp(SOCKET_DATA *a, SOCKET_DATA *b) {
+  long long a_usec = atomic_load(&a->comp_usec);
+  long long b_usec = atomic_load(&b->comp_usec);
+  return (a_usec < b_usec ? 1 : a_usec > b_usec ? -1 : 0);
+}
+
+//
+// show how well each socket's output is compressing, and what it costs us
+COMMAND(cmd_compressstat) {
+  LIST_ITERATOR *sock_i = NULL;
+  SOCKET_DATA     *sock = NULL;
+  if(!strcasecmp(arg, "reset")) {
+    sock_i = newListIterator(socket_list);
+    ITERATE_LIST(sock, sock_i) {
+      atomic_store(&sock->comp_raw,   0);
+      atomic_store(&sock->comp_bytes, 0);
+      atomic_store(&sock->comp_usec,  0);
+    } deleteListIterator(sock_i);
+    send_to_char(ch, "Compression statistics reset.\r\n");
+    return;
+  }
+  else if(*arg) {
+    send_to_char(ch, "Usage: compressstat [reset]\r\n");
+    return;
+  }
+
+  BUFFER    *buf = newBuffer(MAX_BUFFER);
+  LIST *sockets = newList();
+  int       streams = 0;
+  sock_i = newListIterator(socket_list);
+  ITERATE_LIST(sock, sock_i) {
+    if(sock->closed)
+      continue;
+    if(sock->out_compress)
+      streams++;
+    if(sock->out_compress || atomic_load(&sock->comp_raw) > 0)
+      listPut(sockets, sock);
+  } deleteListIterator(sock_i);
+  listSortWith(sockets, compressstat_cmp);
+
+  long long raw = socketTotalMCCPRaw(), out = socketTotalMCCPCompressed();
+  bprintf(buf, "Compressing at level %d (%d when the game is behind), with "
+	  "a 2^%d byte window and memory level %d.\r\n"
+	  "%d stream%s open, using about %d KB each. The game is %s.\r\n"
+	  "Since boot: %lld bytes in, %lld out (%.2f:1), %lld usec of CPU."
+	  "\r\n\r\n",
+	  COMPRESS_LEVEL, MIN(COMPRESS_LEVEL, COMPRESS_BUSY_LEVEL),
+	  COMPRESS_WINDOW_BITS, COMPRESS_MEM_LEVEL, streams,
+	  (streams == 1 ? "" : "s"),
+	  ((1 << (COMPRESS_WINDOW_BITS + 2)) + (1 << (COMPRESS_MEM_LEVEL + 9))) /
+	  1024, (compress_busy ? "behind" : "keeping up"),
+	  raw, out, (out > 0 ? (double) raw / out : 0.0),
+	  socketTotalMCCPUsec());
+  bprintf(buf, "{c%-20s %-20s %5s %12s %12s %7s %10s %8s{n\r\n",
+	  "Character", "Host", "Level", "Raw", "Compressed", "Ratio",
+	  "CPU usec", "usec/KB");
+  int count = 0;
+  sock_i = newListIterator(sockets);
+  ITERATE_LIST(sock, sock_i) {
+    long long s_raw  = atomic_load(&sock->comp_raw);
+    long long s_out  = atomic_load(&sock->comp_bytes);
+    long long s_usec = atomic_load(&sock->comp_usec);
+    if(count++ >= 30)
+      break;
+    bprintf(buf, "%-20.20s %-20.20s %5s %12lld %12lld %6.2f: %10lld %8.1f\r\n",
+	    (sock->player ? charGetName(sock->player) : "(none)"),
+	    (sock->hostname ? sock->hostname : "(unknown)"),
+	    (!sock->out_compress ? "off" : 
+	     sock->compress_level == Z_NO_COMPRESSION ? "none" :
+	     sock->compress_level < COMPRESS_LEVEL ? "busy" : "full"),
+	    s_raw, s_out, (s_out > 0 ? (double) s_raw / s_out : 0.0), s_usec,
+	    (s_raw > 0 ? s_usec * 1024.0 / s_raw : 0.0));
+  } deleteListIterator(sock_i);
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    send_to_char(ch, "%s", bufferString(buf));
+  deleteBuffer(buf);
+  deleteList(sockets);
+}
+
 //
 // compress output
 //
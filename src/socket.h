@@ -6,14 +6,34 @@
 // all of the functions needed for working with character sockets
 //*****************************************************************************
 
-int   init_socket           ( void );
-SOCKET_DATA  *new_socket    ( int sock );
+void  init_input_threads    ( void );
+void  init_compress_threads ( void );
+void  init_socket_pool      ( void );
+void  init_socket_idle      ( void );
+void  init_socket_hooks     ( void );
+SOCKET_DATA  *new_socket    ( int sock, int flags );
 void  close_socket          ( SOCKET_DATA *dsock, bool reconnect );
 bool  read_from_socket      ( SOCKET_DATA *dsock );
 void  input_handler         ( void );
 void  output_handler        ( void );
 void  copyover_recover      ( void );
-void  do_copyover           ( void );
+void  do_copyover           ( bool hot );
+
+//
+// recover the sockets in a copyover file. If fds is not NULL, the file was
+// written by socketsHandoff, and the descriptors in it are indexes into fds
+void  copyover_recover_fds  ( FILE *fp, const int *fds, int num_fds );
+
+//
+// hand our sockets over to a new process (see upgrade.h). socketsHandoff
+// saves everyone, writes a copyover file for the sockets that can be handed
+// over to fp, and appends their descriptors to fds, up to max_fds. Returns
+// how many fds there are now. If the new process took them, socketsHandoffDone
+// closes everyone else and lets go of the rest without closing them; if it
+// didn't, socketsHandoffAbort takes the file back and carries on as before
+int   socketsHandoff        ( FILE *fp, int *fds, int num_fds, int max_fds );
+void  socketsHandoffAbort   ( FILE *fp, const int *fds, int num_fds );
+void  socketsHandoffDone    ( void );
 
 /* sends the output directly */
 bool  text_to_socket        ( SOCKET_DATA *dsock, const char *txt );
@@ -22,12 +42,31 @@ void  send_to_socket        ( SOCKET_DATA *dsock, const char *format, ...) __att
 
 /* buffers the output        */
 void  text_to_buffer        ( SOCKET_DATA *dsock, const char *txt );
+
+//
+// output that goes to many sockets at once can be made into a fragment, and
+// queued to each of them without copying it. Fragments are refcounted; each
+// socket a fragment is queued to takes its own reference, and the maker
+// should let go of theirs with outFragUnref when they're done queueing it
+OUT_FRAG   *newOutFrag        ( const char *txt);
+void        outFragUnref      ( OUT_FRAG *frag);
+const char *outFragGetText    ( OUT_FRAG *frag);
+void  text_to_buffer_shared   ( SOCKET_DATA *dsock, OUT_FRAG *frag);
 void  next_cmd_from_buffer  ( SOCKET_DATA *dsock );
 bool  flush_output          ( SOCKET_DATA *dsock );
 void  handle_new_connections( SOCKET_DATA *dsock, char *arg );
 void  clear_socket          ( SOCKET_DATA *sock_new, int sock );
 void  recycle_sockets       ( void );
-void *lookup_address        ( void *arg );
+
+//
+// the sockets of every in-game character in any of the given user groups.
+// The list is kept in an index and must not be changed or deleted; it is good
+// until something changes which sockets have which characters, who is in the
+// game, or anyone's user groups. socketIndexChanged must be called whenever
+// a socket or character is attached, detached, or leaves or enters the game
+LIST *socketsInUserGroups     ( const char *groups);
+void  socketIndexChanged      ( void );
+void  lookup_handler        ( void );
 
 
 
@@ -56,18 +95,71 @@ void socketReplacePyInputHandler(SOCKET_DATA *sock, void *handler,void *prompt,
 				 const char *state);
 void socketPopInputHandler    ( SOCKET_DATA *socket);
 void *socketGetAuxiliaryData  ( SOCKET_DATA *sock, const char *name);
+void *socketGetAuxiliarySlot  ( SOCKET_DATA *sock, int slot);
 const char *socketGetHostname ( SOCKET_DATA *sock);
 BUFFER *socketGetTextEditor   ( SOCKET_DATA *sock);
 BUFFER *socketGetOutbound     ( SOCKET_DATA *sock);
+
+//
+// what the socket's colour codes are translated to before they are sent:
+// COLOUR_NONE, COLOUR_ANSI, or COLOUR_256 (see colour.h). Defaults to ANSI
+int  socketGetColourMode      ( SOCKET_DATA *sock);
+void socketSetColourMode      ( SOCKET_DATA *sock, int mode);
 void socketQueueCommand       ( SOCKET_DATA *sock, const char *cmd);
+
+//
+// queue every command in the list, in order, as the expansion of one command
+// someone typed (e.g. by an alias). While one of them is being handled,
+// socketCmdIsExpanded returns TRUE, so it is not expanded all over again
+void socketQueueExpansion     ( SOCKET_DATA *sock, LIST *cmds);
+bool socketCmdIsExpanded      ( SOCKET_DATA *sock);
+
 int               socketGetUID( SOCKET_DATA *sock);
+bool socketIsClosed           ( SOCKET_DATA *sock);
 
 bool socketHasPrompt          ( SOCKET_DATA *sock);
 void socketBustPrompt         ( SOCKET_DATA *sock);
 void socketShowPrompt         ( SOCKET_DATA *sock);
 bool socketHasCommand         ( SOCKET_DATA *sock);
 const char *socketGetLastCmd  ( SOCKET_DATA *sock);
+
+//
+// the socket keeps a history of the last commands it ran, as many as the
+// command_history setting says unless it is told otherwise. The 0th
+// command is the newest. Returns NULL if the history doesn't go back that far
+const char *socketGetHistoryCmd(SOCKET_DATA *sock, int n);
+int socketGetHistorySize      ( SOCKET_DATA *sock);
+void socketSetHistorySize     ( SOCKET_DATA *sock, int size);
+
 const char *socketGetState    ( SOCKET_DATA *sock);
 double socketGetIdleTime      ( SOCKET_DATA *sock);
 
+//
+// has the socket been idle for afk_seconds, without sending a command since?
+bool   socketIsAfk            ( SOCKET_DATA *sock);
+
+//
+// did the socket connect to one of our tls_ports?
+bool   socketIsTls            ( SOCKET_DATA *sock);
+
+//
+// did the socket connect to one of our ws_ports or wss_ports?
+bool   socketIsWebSocket      ( SOCKET_DATA *sock);
+
+//
+// how many bytes have been written to the socket since it connected (or its
+// counts were last reset by outputstat)
+long long socketGetBytesSent  ( SOCKET_DATA *sock);
+
+//
+// how many bytes all sockets have read and written since boot, and how many
+// bytes of output went into MCCP compression, how many came out of it, and
+// how many usec of CPU time it took. Unlike socketGetBytesSent, outputstat
+// doesn't reset these
+long long socketTotalBytesRead     (void);
+long long socketTotalBytesWritten  (void);
+long long socketTotalMCCPRaw       (void);
+long long socketTotalMCCPCompressed(void);
+long long socketTotalMCCPUsec      (void);
+
 #endif // SOCKET_H
@@ -0,0 +1,82 @@
+//*****************************************************************************
+//
+// spsc_queue.c
+//
+// a fixed-capacity, lock-free queue for handing pointers from one thread to
+// another. See spsc_queue.h for the rules on using it. The queue is a ring of
+// slots, with one slot always left empty so full and empty can be told apart.
+// The producer only ever writes tail, and the consumer only ever writes head.
+//
+//*****************************************************************************
+
+#include <stdatomic.h>
+
+#include "mud.h"
+#include "spsc_queue.h"
+
+struct spsc_queue {
+  void       **slots;
+  int       capacity; // how many slots do we have? One more than we can hold
+  atomic_int    head; // the next slot to pop from
+  atomic_int    tail; // the next slot to push into
+};
+
+SPSC_QUEUE *newSPSCQueue(int capacity) {
+  SPSC_QUEUE *queue = malloc(sizeof(SPSC_QUEUE));
+  if(capacity < 1)
+    capacity = 1;
+  queue->capacity = capacity + 1;
+  queue->slots    = calloc(queue->capacity, sizeof(void *));
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+  return queue;
+}
+
+void deleteSPSCQueue(SPSC_QUEUE *queue) {
+  free(queue->slots);
+  free(queue);
+}
+
+void deleteSPSCQueueWith(SPSC_QUEUE *queue, void *func) {
+  void (* free_func)(void *) = func;
+  void *elem = NULL;
+  while((elem = spscQueuePop(queue)) != NULL)
+    free_func(elem);
+  deleteSPSCQueue(queue);
+}
+
+bool spscQueuePush(SPSC_QUEUE *queue, void *elem) {
+  int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  int next = (tail + 1) % queue->capacity;
+  if(next == atomic_load_explicit(&queue->head, memory_order_acquire))
+    return FALSE;
+  queue->slots[tail] = elem;
+  atomic_store_explicit(&queue->tail, next, memory_order_release);
+  return TRUE;
+}
+
+void *spscQueuePeek(SPSC_QUEUE *queue) {
+  int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  if(head == atomic_load_explicit(&queue->tail, memory_order_acquire))
+    return NULL;
+  return queue->slots[head];
+}
+
+void *spscQueuePop(SPSC_QUEUE *queue) {
+  int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  if(head == atomic_load_explicit(&queue->tail, memory_order_acquire))
+    return NULL;
+  void *elem = queue->slots[head];
+  atomic_store_explicit(&queue->head, (head + 1) % queue->capacity,
+			memory_order_release);
+  return elem;
+}
+
+bool spscQueueIsEmpty(SPSC_QUEUE *queue) {
+  return (atomic_load(&queue->head) == atomic_load(&queue->tail));
+}
+
+bool spscQueueIsFull(SPSC_QUEUE *queue) {
+  return (((atomic_load(&queue->tail) + 1) % queue->capacity) ==
+	  atomic_load(&queue->head));
+}
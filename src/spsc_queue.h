@@ -0,0 +1,50 @@
+#ifndef __SPSC_QUEUE_H
+#define __SPSC_QUEUE_H
+//*****************************************************************************
+//
+// spsc_queue.h
+//
+// a fixed-capacity, lock-free queue for handing pointers from one thread to
+// another. Exactly one thread may push onto the queue at a time, and exactly
+// one thread may pop from it at a time (they can be different threads). If
+// the job of pushing is passed between threads, the hand-off must be done
+// with some other form of synchronization (e.g. a mutex or an atomic flag).
+//
+//*****************************************************************************
+
+typedef struct spsc_queue SPSC_QUEUE;
+
+//
+// create a new queue that can hold up to capacity elements at once
+SPSC_QUEUE *newSPSCQueue(int capacity);
+
+//
+// delete the queue. Its contents are not deleted
+void deleteSPSCQueue(SPSC_QUEUE *queue);
+
+//
+// delete the queue, and call func on each element still in it
+void deleteSPSCQueueWith(SPSC_QUEUE *queue, void *func);
+
+//
+// add an element to the end of the queue. Returns FALSE if the queue is full.
+// Only to be called by the producing thread
+bool spscQueuePush(SPSC_QUEUE *queue, void *elem);
+
+//
+// remove and return the element at the front of the queue, or NULL if the
+// queue is empty. Only to be called by the consuming thread
+void *spscQueuePop(SPSC_QUEUE *queue);
+
+//
+// return the element at the front of the queue without removing it, or NULL
+// if the queue is empty. Only to be called by the consuming thread
+void *spscQueuePeek(SPSC_QUEUE *queue);
+
+//
+// is the queue empty/full? Can be called by either thread, but the answer
+// may be out of date by the time it is used
+bool spscQueueIsEmpty(SPSC_QUEUE *queue);
+bool spscQueueIsFull (SPSC_QUEUE *queue);
+
+#endif // __SPSC_QUEUE_H
@@ -0,0 +1,219 @@
+//*****************************************************************************
+//
+// stats.c
+//
+// fixed blocks of integer stats on characters. See stats.h. Each character's
+// block is auxiliary data, found by its slot instead of its name, and holds
+// one value for every stat that can be registered, so that reading a stat
+// never has to look anything up.
+//
+//*****************************************************************************
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "storage.h"
+#include "auxiliary.h"
+#include "stats.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the stats and derived values that have been registered, by number
+const char *stat_names[MAX_STATS];
+int         stat_dflts[MAX_STATS];
+int          num_stats = 0;
+
+const char *derived_names[MAX_DERIVED];
+int          num_derived = 0;
+
+// for each DERIVED_ON_ bit, which derived values are worked out from it
+unsigned int derived_on[NUM_DERIVED_ON];
+
+// the auxiliary slot stat blocks are kept in
+int stat_slot = -1;
+
+typedef struct {
+  int                vals[MAX_STATS];
+  unsigned int        version; // how many times we've been set
+  unsigned int     derived_ok; // one bit for each derived value we remember
+  double derived[MAX_DERIVED];
+} STAT_DATA;
+
+
+
+//*****************************************************************************
+// auxiliary data
+//*****************************************************************************
+STAT_DATA *newStatData(void) {
+  STAT_DATA *data = calloc(1, sizeof(STAT_DATA));
+  memcpy(data->vals, stat_dflts, sizeof(int) * num_stats);
+  return data;
+}
+
+void deleteStatData(STAT_DATA *data) {
+  free(data);
+}
+
+void statDataCopyTo(STAT_DATA *from, STAT_DATA *to) {
+  memcpy(to->vals, from->vals, sizeof(from->vals));
+  to->version++;
+  to->derived_ok = 0;
+}
+
+STAT_DATA *statDataCopy(STAT_DATA *data) {
+  STAT_DATA *newdata = newStatData();
+  statDataCopyTo(data, newdata);
+  return newdata;
+}
+
+STORAGE_SET *statDataStore(STAT_DATA *data) {
+  STORAGE_SET *set = new_storage_set();
+  int i;
+  for(i = 0; i < num_stats; i++)
+    store_int(set, stat_names[i], data->vals[i]);
+  return set;
+}
+
+STAT_DATA *statDataRead(STORAGE_SET *set) {
+  STAT_DATA *data = newStatData();
+  int i;
+  for(i = 0; i < num_stats; i++)
+    if(storage_contains(set, stat_names[i]))
+      data->vals[i] = read_int(set, stat_names[i]);
+  return data;
+}
+
+STAT_DATA *char_stats(CHAR_DATA *ch) {
+  return charGetAuxiliarySlot(ch, stat_slot);
+}
+
+
+
+//*****************************************************************************
+// implementation of stats.h
+//*****************************************************************************
+void init_stats(void) {
+  auxiliariesInstall("stat_data",
+		     newAuxiliaryFuncs(AUXILIARY_TYPE_CHAR,
+				       newStatData, deleteStatData,
+				       statDataCopyTo, statDataCopy,
+				       statDataStore, statDataRead));
+  stat_slot = auxiliariesGetSlot("stat_data");
+}
+
+int statRegister(const char *name, int dflt) {
+  int stat = statGetNum(name);
+  if(stat == STAT_NONE) {
+    if(num_stats == MAX_STATS)
+      return STAT_NONE;
+    stat = num_stats++;
+    stat_names[stat] = strdup(name);
+  }
+  stat_dflts[stat] = dflt;
+  return stat;
+}
+
+int statGetNum(const char *name) {
+  int i;
+  for(i = 0; i < num_stats; i++)
+    if(!strcasecmp(stat_names[i], name))
+      return i;
+  return STAT_NONE;
+}
+
+const char *statGetName(int stat) {
+  return (stat >= 0 && stat < num_stats ? stat_names[stat] : NULL);
+}
+
+int statCount(void) {
+  return num_stats;
+}
+
+int derivedRegister(const char *name, bitvector_t on) {
+  int derived = derivedGetNum(name);
+  if(derived == STAT_NONE) {
+    if(num_derived == MAX_DERIVED)
+      return STAT_NONE;
+    derived = num_derived++;
+    derived_names[derived] = strdup(name);
+  }
+
+  int i;
+  for(i = 0; i < NUM_DERIVED_ON; i++) {
+    if(IS_SET(on, 1 << i))
+      SET_BIT(derived_on[i], 1U << derived);
+    else
+      REMOVE_BIT(derived_on[i], 1U << derived);
+  }
+  return derived;
+}
+
+int derivedGetNum(const char *name) {
+  int i;
+  for(i = 0; i < num_derived; i++)
+    if(!strcasecmp(derived_names[i], name))
+      return i;
+  return STAT_NONE;
+}
+
+const char *derivedGetName(int derived) {
+  return (derived >= 0 && derived < num_derived ? derived_names[derived]:NULL);
+}
+
+int derivedCount(void) {
+  return num_derived;
+}
+
+int charGetStat(CHAR_DATA *ch, int stat) {
+  if(stat < 0 || stat >= num_stats)
+    return 0;
+  return char_stats(ch)->vals[stat];
+}
+
+void charSetStat(CHAR_DATA *ch, int stat, int val) {
+  if(stat < 0 || stat >= num_stats)
+    return;
+  STAT_DATA *data = char_stats(ch);
+  data->vals[stat] = val;
+  data->version++;
+  data->derived_ok &= ~derived_on[0]; // DERIVED_ON_STATS
+}
+
+unsigned int charGetStatVersion(CHAR_DATA *ch) {
+  return char_stats(ch)->version;
+}
+
+bool charGetDerived(CHAR_DATA *ch, int derived, double *val) {
+  STAT_DATA *data = char_stats(ch);
+  if(derived < 0 || derived >= num_derived ||
+     !(data->derived_ok & (1U << derived)))
+    return FALSE;
+  *val = data->derived[derived];
+  return TRUE;
+}
+
+void charSetDerived(CHAR_DATA *ch, int derived, double val) {
+  if(derived < 0 || derived >= num_derived)
+    return;
+  STAT_DATA *data = char_stats(ch);
+  data->derived[derived] = val;
+  data->derived_ok |= (1U << derived);
+}
+
+void charForgetDerivedOn(CHAR_DATA *ch, bitvector_t on) {
+  STAT_DATA *data = char_stats(ch);
+  int i;
+  if(data == NULL)
+    return;
+  for(i = 0; i < NUM_DERIVED_ON; i++)
+    if(IS_SET(on, 1 << i))
+      data->derived_ok &= ~derived_on[i];
+}
+
+void charForgetDerived(CHAR_DATA *ch) {
+  char_stats(ch)->derived_ok = 0;
+}
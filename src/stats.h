@@ -0,0 +1,82 @@
+#ifndef __STATS_H
+#define __STATS_H
+//*****************************************************************************
+//
+// stats.h
+//
+// a fixed block of integer stats (strength, wisdom, and the like) kept on
+// every character, and read by number instead of being looked up by name.
+// Modules register the stats they use when they start up, and each gets the
+// next number; find a stat's number once, and every read after that is a
+// lookup in an array. Stats are saved with the character, by name, so the
+// numbers they are given only have to be the same within one boot.
+//
+// Values worked out from stats (max HP, regen rates) can be remembered with
+// the character as derived values. Each says what it is worked out from when
+// it is registered -- stats, position, equipment, injuries -- and is
+// forgotten only when one of those changes, so it is only worked out again
+// after something it comes from does.
+//
+//*****************************************************************************
+
+// the most stats, and derived values, there can be
+#define MAX_STATS          24
+#define MAX_DERIVED        16
+
+#define STAT_NONE          -1
+
+// what a derived value can be worked out from
+#define DERIVED_ON_STATS      (1 << 0)
+#define DERIVED_ON_POSITION   (1 << 1)
+#define DERIVED_ON_EQUIPMENT  (1 << 2)
+#define DERIVED_ON_INJURIES   (1 << 3)
+#define NUM_DERIVED_ON        4
+
+//
+// install stat blocks on characters
+void init_stats(void);
+
+//
+// add a new stat, which characters start out with at dflt, and return its
+// number. A stat that already exists keeps its number and takes the new
+// default. Returns STAT_NONE if there are already MAX_STATS
+int         statRegister(const char *name, int dflt);
+int         statGetNum  (const char *name);
+const char *statGetName (int stat);
+int         statCount   (void);
+
+//
+// the same, for derived values. on is what the value is worked out from, as
+// DERIVED_ON_ bits. Registering a value again replaces what it is worked out
+// from
+int          derivedRegister(const char *name, bitvector_t on);
+int          derivedGetNum  (const char *name);
+const char  *derivedGetName (int derived);
+int          derivedCount   (void);
+
+//
+// read or set a character's stat. Reading a stat that doesn't exist gives 0
+int  charGetStat(CHAR_DATA *ch, int stat);
+void charSetStat(CHAR_DATA *ch, int stat, int val);
+
+//
+// how many times the character's stats have been set. Anything that keeps
+// what it worked out from them can tell if they've changed since
+unsigned int charGetStatVersion(CHAR_DATA *ch);
+
+//
+// get a derived value that was remembered since the character's stats last
+// changed. Returns FALSE, and leaves val alone, if there isn't one
+bool charGetDerived(CHAR_DATA *ch, int derived, double *val);
+void charSetDerived(CHAR_DATA *ch, int derived, double val);
+
+//
+// forget the character's derived values that are worked out from any of on,
+// because it has changed. Setting a stat forgets DERIVED_ON_STATS itself
+void charForgetDerivedOn(CHAR_DATA *ch, bitvector_t on);
+
+//
+// forget all of the character's derived values
+void charForgetDerived(CHAR_DATA *ch);
+
+#endif // __STATS_H
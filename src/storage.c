@@ -16,8 +16,16 @@
 #include <time.h>
 #include <unistd.h>  // for getcwd
 #include <errno.h>   // for errno and strerror
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <ctype.h>
 #include "mud.h"
-#include "utils.h"    // trim
+#include "utils.h"
+#include "intern.h"
+#include "memstat.h"
+#include "character.h"
 #include "storage.h"
 
 
@@ -32,11 +40,39 @@
 #define STRING_MARKER         '~'
 #define TYPELESS_MARKER       ' '
 
+// the kinds of values storage data can hold. Strings we parsed out of text
+// files are untyped; the binary writer works out whether they are numbers
+#define STORAGE_TYPE_UNKNOWN   0
+#define STORAGE_TYPE_STRING    1
+#define STORAGE_TYPE_INT       2
+#define STORAGE_TYPE_DOUBLE    3
+#define STORAGE_TYPE_BOOL      4
+#define STORAGE_TYPE_SET       5
+#define STORAGE_TYPE_LIST      6
+
+// binary files start with this. Text files never start with a NUL
+#define STORAGE_BINARY_MAGIC     "\0NMS"
+#define STORAGE_BINARY_MAGIC_LEN 4
+#define STORAGE_BINARY_VERSION   1
+
+// how deeply sets can nest in a binary file before we think it's corrupt
+#define STORAGE_BINARY_MAX_DEPTH 256
+
+
+//
+// a file we parsed storage sets out of
+typedef struct storage_source {
+  char                 *data; // the contents of the file
+  size_t                 len; // how long they are
+  bool                mapped; // is data mapped, or malloc'd?
+  int                   refs; // how many sets still point into it
+} STORAGE_SOURCE;
 
 struct storage_set {
   HASHTABLE *entries;
   int    longest_key;
   int      top_entry;
+  STORAGE_SOURCE *source; // the file we were parsed from, if any
 };
 
 struct storage_set_list {
@@ -44,12 +80,21 @@ struct storage_set_list {
   LIST_ITERATOR *list_i;
 };
 
+//
+// str_val, list_val, and set_val are all made when they are first needed. If
+// we were parsed from a file, our string value is a slice of it until then
 typedef struct storage_data {
-  char                  *key; // what is the variable name we're known by?
+  const char            *key; // what is the variable name we're known by?
   char              *str_val; // what is the data's string value?
   STORAGE_SET_LIST *list_val; // list value?
   STORAGE_SET       *set_val; // set value?
   int              entry_num; // used by storage_set to keep track of order
+  const char            *raw; // where our value is in the file we came from
+  int                raw_len; // how long it is there
+  int             raw_indent; // the indent of its lines, or -1 for one line
+  int                   type; // STORAGE_TYPE_xxx, if we know what we hold
+  long               int_val; // our value, if we're an int, long, or bool
+  double             dbl_val; // our value, if we're a double
 } STORAGE_DATA;
 
 
@@ -58,6 +103,9 @@ typedef struct storage_data {
 void delete_storage_set (STORAGE_SET *set);
 void delete_storage_list(STORAGE_SET_LIST *list);
 void delete_storage_data(STORAGE_DATA *data);
+void storage_put(STORAGE_SET *set, STORAGE_DATA *data);
+void storage_source_release(STORAGE_SOURCE *src);
+void storage_data_materialize(STORAGE_DATA *data);
 
 bool list_is_empty(STORAGE_SET_LIST *list);
 bool set_is_empty (STORAGE_SET *set);
@@ -77,7 +125,8 @@ void delete_storage_set(STORAGE_SET *set) {
   deleteHashIterator(hash_i);
 
   deleteHashtable(set->entries);
-  free(set);
+  if(set->source) storage_source_release(set->source);
+  memFree(MEM_STORAGE_SET, set, sizeof(STORAGE_SET));
 }
 
 void delete_storage_list(STORAGE_SET_LIST *list) {
@@ -87,7 +136,7 @@ void delete_storage_list(STORAGE_SET_LIST *list) {
 }
 
 void delete_storage_data(STORAGE_DATA *data) {
-  if(data->key)      free(data->key);
+  strRelease(data->key);
   if(data->str_val)  free(data->str_val);
   if(data->list_val) delete_storage_list(data->list_val);
   if(data->set_val)  delete_storage_set(data->set_val);
@@ -96,52 +145,79 @@ void delete_storage_data(STORAGE_DATA *data) {
 
 STORAGE_DATA *new_storage_data(const char *key) {
   STORAGE_DATA *data = calloc(1, sizeof(STORAGE_DATA));
-  data->key     = strdup(key);
+  data->key        = strShare(key);
+  data->raw_indent = -1;
   return data;
 }
 
 STORAGE_DATA *new_data_set(STORAGE_SET *val, const char *key) {
   STORAGE_DATA *data = new_storage_data(key);
   data->set_val  = val;
-  data->list_val = new_storage_list();
-  data->str_val  = strdup("");
   return data;
 }
 
 STORAGE_DATA   *new_data_list(STORAGE_SET_LIST *val, const char *key) {
   STORAGE_DATA *data = new_storage_data(key);
   data->list_val = val;
-  data->set_val  = new_storage_set();
-  data->str_val  = strdup("");
   return data;
 }
 
 STORAGE_DATA *new_data_string(const char *val, const char *key) {
   STORAGE_DATA *data = new_storage_data(key);
   data->str_val      = strdup(val);
-  data->list_val     = new_storage_list();
-  data->set_val      = new_storage_set();
   return data;
 }
 
+//
+// returns the data's string value, copying it out of the file it was
+// parsed from if that hasn't been done yet
+const char *storage_data_str(STORAGE_DATA *data) {
+  if(data->str_val == NULL) {
+    char str_val[20];
+    if(data->raw != NULL)
+      storage_data_materialize(data);
+    else if(data->type == STORAGE_TYPE_BOOL)
+      data->str_val = strdup(data->int_val ? "yes" : "no");
+    else if(data->type == STORAGE_TYPE_INT) {
+      snprintf(str_val, 20, "%ld", data->int_val);
+      data->str_val = strdup(str_val);
+    }
+    else if(data->type == STORAGE_TYPE_DOUBLE) {
+      snprintf(str_val, 20, "%lf", data->dbl_val);
+      data->str_val = strdup(str_val);
+    }
+    else
+      data->str_val = strdup("");
+  }
+  return data->str_val;
+}
+
 STORAGE_DATA    *new_data_bool(bool val, const char *key) {
-  char str_val[4]; sprintf(str_val, (val ? "yes" : "no"));
-  return new_data_string(str_val, key);
+  STORAGE_DATA *data = new_storage_data(key);
+  data->type         = STORAGE_TYPE_BOOL;
+  data->int_val      = (val ? TRUE : FALSE);
+  return data;
 }
 
 STORAGE_DATA    *new_data_int(int val, const char *key) {
-  char str_val[20]; snprintf(str_val, 20, "%d", val);
-  return new_data_string(str_val, key);
+  STORAGE_DATA *data = new_storage_data(key);
+  data->type         = STORAGE_TYPE_INT;
+  data->int_val      = val;
+  return data;
 }
 
 STORAGE_DATA    *new_data_long(long val, const char *key) {
-  char str_val[20]; snprintf(str_val, 20, "%ld", val);
-  return new_data_string(str_val, key);
+  STORAGE_DATA *data = new_storage_data(key);
+  data->type         = STORAGE_TYPE_INT;
+  data->int_val      = val;
+  return data;
 }
 
 STORAGE_DATA *new_data_double(double val, const char *key) {
-  char str_val[20]; snprintf(str_val, 20, "%lf", val);
-  return new_data_string(str_val, key);
+  STORAGE_DATA *data = new_storage_data(key);
+  data->type         = STORAGE_TYPE_DOUBLE;
+  data->dbl_val      = val;
+  return data;
 }
 
 
@@ -195,13 +271,13 @@ void write_string_data(const char *string, FILEBUF *fb, int indent) {
 //
 bool set_is_empty(STORAGE_SET *set) {
   // if the hashtable has a size of 0, we know for sure it's empty
-  if(hashSize(set->entries) > 0) {
+  if(set != NULL && hashSize(set->entries) > 0) {
     HASH_ITERATOR *hash_i = newHashIterator(set->entries);
     STORAGE_DATA    *data = NULL;
     const char       *key = NULL;
 
     ITERATE_HASH(key, data, hash_i) {
-      if(*data->str_val || 
+      if(*storage_data_str(data) || 
 	 !set_is_empty(data->set_val) || !list_is_empty(data->list_val)) {
 	deleteHashIterator(hash_i);
 	return FALSE;
@@ -219,7 +295,7 @@ bool set_is_empty(STORAGE_SET *set) {
 //
 bool list_is_empty(STORAGE_SET_LIST *list) {
   // if the list size is 0, we know for sure it's empty
-  if(listSize(list->list) > 0) {
+  if(list != NULL && listSize(list->list) > 0) {
     LIST_ITERATOR *list_i = newListIterator(list->list);
     STORAGE_SET      *set = NULL;
     ITERATE_LIST(set, list_i) {
@@ -236,7 +312,7 @@ bool list_is_empty(STORAGE_SET_LIST *list) {
 
 void write_storage_data(STORAGE_DATA *data, FILEBUF *fb, int key_width,int indent){
   // first, we see if we have a string value. If we do, print it
-  if(*data->str_val) {
+  if(*storage_data_str(data)) {
     print_key(fb, data->key, key_width, indent);
     // if we have a newline in our string, we have to write
     // it in a special way so as to preserve the lines
@@ -322,30 +398,53 @@ void write_storage_list(STORAGE_SET_LIST *list, FILEBUF *fb, int indent) {
 //
 //*****************************************************************************
 
+//
+// files are mapped into memory and parsed in one pass. String values aren't
+// copied out while parsing; their data just notes where in the file they are,
+// and they are only copied out the first time someone reads them. Every set
+// parsed out of a file holds a reference to it, so it stays mapped until the
+// last of them is closed
+typedef struct storage_cursor {
+  const char         *pos; // where we are in the file
+  const char         *end; // where the file ends
+  STORAGE_SOURCE     *src; // the file we are parsing
+} STORAGE_CURSOR;
+
+STORAGE_SOURCE *new_storage_source(char *data, size_t len, bool mapped) {
+  STORAGE_SOURCE *src = malloc(sizeof(STORAGE_SOURCE));
+  src->data   = data;
+  src->len    = len;
+  src->mapped = mapped;
+  src->refs   = 0;
+  return src;
+}
+
+void storage_source_release(STORAGE_SOURCE *src) {
+  if(--src->refs > 0)
+    return;
+  if(src->mapped)
+    munmap(src->data, src->len);
+  else if(src->data)
+    free(src->data);
+  free(src);
+}
+
 /* local functions */
-STORAGE_SET      *parse_storage_set(FILEBUF *fb, int indent);
-STORAGE_SET_LIST *parse_storage_list(FILEBUF *fb, int indent);
+STORAGE_SET      *parse_storage_set(STORAGE_CURSOR *cur, int indent);
+STORAGE_SET_LIST *parse_storage_list(STORAGE_CURSOR *cur, int indent);
 
 
 //
 // skip ahead in our indent. If we can skip that far ahead,
-// return TRUE. otherwise, return FALSE.
+// return TRUE. otherwise, return FALSE and stay where we are.
 //
-bool skip_indent(FILEBUF *fb, int indent) {
+bool skip_indent(STORAGE_CURSOR *cur, int indent) {
   int i;
-  char c;
-  for(i = 0; i < indent; i++) {
-    c = fbgetc(fb);
-    if(c != ' ')
-      break;
-  }
-
-  if(i != indent) {
-    fbseek(fb, -(i+1), SEEK_CUR);
-    return FALSE;
-  }
-  else
-    return TRUE;
+  for(i = 0; i < indent; i++)
+    if(cur->pos + i >= cur->end || cur->pos[i] != ' ')
+      return FALSE;
+  cur->pos += indent;
+  return TRUE;
 }
 
 
@@ -353,17 +452,15 @@ bool skip_indent(FILEBUF *fb, int indent) {
 // Check to see if we're at the end of a storage entry. If we are,
 // return true. otherwise, return false.
 //
-bool storage_end(FILEBUF *fb) {
-  char c = fbgetc(fb);
-  if(c == SET_MARKER || c == EOF) {
+bool storage_end(STORAGE_CURSOR *cur) {
+  if(cur->pos >= cur->end)
+    return TRUE;
+  if(*cur->pos == SET_MARKER) {
     // also skip the newline that comes after us
-    fbgetc(fb);
+    cur->pos = MIN(cur->pos + 2, cur->end);
     return TRUE;
   }
-  else {
-    fbseek(fb, -1, SEEK_CUR);
-    return FALSE;
-  }
+  return FALSE;
 }
 
 
@@ -371,97 +468,107 @@ bool storage_end(FILEBUF *fb) {
 // return the type of the data we're dealing with. It is assumed
 // this will be called IMMEDIATELY after parse_key is called
 //
-char parse_type(FILEBUF *fb) {
-  return fbgetc(fb);
+char parse_type(STORAGE_CURSOR *cur) {
+  return (cur->pos < cur->end ? *cur->pos++ : EOF);
 }
 
 
 //
-// Parse the name of the key that is immediately in front of us
+// skip past the rest of the line we are on, and its newline
 //
-char *parse_key(FILEBUF *fb) {
-  static char buf[SMALL_BUFFER];
-  char c;
-  int  i = 0;
-  // parse up to the colon, which is the marker for the end of the key
-  while((c = fbgetc(fb)) != EOF) {
-    if(c == ':') {
-      buf[i] = '\0';
-      break;
-    }
-    buf[i++] = c;
-  }
-  // trim off all of the trailing spaces and return a copy
-  trim(buf);
-  return strdup(buf);
+void skip_line(STORAGE_CURSOR *cur) {
+  const char *nl = memchr(cur->pos, '\n', cur->end - cur->pos);
+  cur->pos = (nl ? nl + 1 : cur->end);
 }
 
 
 //
-// Read until we hit a newline. Return a copy of what we find
+// Parse the name of the key that is immediately in front of us. Keys come
+// from a small vocabulary, so they are shared instead of copied
 //
-char *parse_line(FILEBUF *fb) {
-  static BUFFER *buf = NULL;
-  static char   sbuf[SMALL_BUFFER];
-  int              i = 0;
-  if(buf == NULL)
-    buf = newBuffer(1);
-  bufferClear(buf);
-  *sbuf = 0;
+const char *parse_key(STORAGE_CURSOR *cur) {
+  const char *colon = memchr(cur->pos, ':', cur->end - cur->pos);
+  const char *start = cur->pos;
+  const char   *end = (colon ? colon : cur->end);
+  cur->pos = (colon ? colon + 1 : cur->end);
+
+  // trim off all of the leading and trailing spaces
+  while(start < end && isspace(*start))
+    start++;
+  while(end > start && isspace(end[-1]))
+    end--;
+
+  int  len = MIN(end - start, SMALL_BUFFER - 1);
+  char buf[len + 1];
+  memcpy(buf, start, len);
+  buf[len] = '\0';
+  return strShare(buf);
+}
 
-  // fill up our small buffer to max, then copy it over
-  for(i = 0; (sbuf[i] = fbgetc(fb)) != EOF && sbuf[i] != '\n';) {
-    if(i < SMALL_BUFFER-2)
-      i++;
-    else {
-      sbuf[++i] = '\0';
-      bufferCat(buf, sbuf);
-      i = 0;
-      sbuf[i] = '\0';
-    }
-  }
 
-  // we found the newline
-  if(sbuf[i] == '\n')
-    sbuf[i] = '\0';
-  bufferCat(buf, sbuf);
-  return strdup(bufferString(buf));
+//
+// note where the rest of the line is. It is copied out when it is read
+//
+void parse_line(STORAGE_CURSOR *cur, STORAGE_DATA *data) {
+  const char *nl = memchr(cur->pos, '\n', cur->end - cur->pos);
+  data->raw      = cur->pos;
+  data->raw_len  = (nl ? nl : cur->end) - cur->pos;
+  data->raw_indent = -1;
+  cur->pos       = (nl ? nl + 1 : cur->end);
 }
 
 
 //
-// read in a string that may possibly have multiple newlines in it
+// note where a string that may possibly have multiple newlines in it is. As
+// long as we can skip up our indent, the string goes on. Once we can no
+// longer skip up our indent, then we have come to the end of our string
 //
-char *parse_string(FILEBUF *fb, int indent) {
-  static BUFFER *buf = NULL;
-  char          *ptr = NULL;
-  if(buf == NULL)
-    buf = newBuffer(1);
-  bufferClear(buf);
+void parse_string(STORAGE_CURSOR *cur, STORAGE_DATA *data, int indent) {
+  data->raw        = cur->pos;
+  data->raw_indent = indent;
+  while(skip_indent(cur, indent))
+    skip_line(cur);
+  data->raw_len    = cur->pos - data->raw;
+}
+
 
-  // as long as we can skip up our indent, we can read in data and
-  // all is good. Once we can no longer skip up our indent, then
-  // we have come to the end of our string
-  while(skip_indent(fb, indent)) {
-    ptr = parse_line(fb);
-    bufferCat(buf, ptr);
-    bufferCat(buf, "\n");
-    free(ptr);
+//
+// copy a value out of the file it was parsed from. Multi-line strings get
+// their indents taken off, and each line ends with a newline
+//
+void storage_data_materialize(STORAGE_DATA *data) {
+  if(data->raw_indent < 0) {
+    data->str_val = strndup(data->raw, data->raw_len);
+    return;
   }
 
-  return strdup(bufferString(buf));
+  char         *str = malloc(data->raw_len + 2);
+  char         *out = str;
+  const char   *pos = data->raw;
+  const char   *end = data->raw + data->raw_len;
+  while(pos < end) {
+    pos += data->raw_indent;
+    const char *nl = memchr(pos, '\n', end - pos);
+    int        len = (nl ? nl : end) - pos;
+    memcpy(out, pos, len);
+    out   += len;
+    *out++ = '\n';
+    pos    = (nl ? nl + 1 : end);
+  }
+  *out = '\0';
+  data->str_val = str;
 }
 
 
 //
 // Read in a list of storage sets. Return what we find.
 //
-STORAGE_SET_LIST *parse_storage_list(FILEBUF *fb, int indent) {
+STORAGE_SET_LIST *parse_storage_list(STORAGE_CURSOR *cur, int indent) {
   STORAGE_SET_LIST *list = new_storage_list();
   STORAGE_SET       *set = NULL;
 
   // read in each set in our list
-  while( (set = parse_storage_set(fb, indent)) != NULL)
+  while( (set = parse_storage_set(cur, indent)) != NULL)
     storage_list_put(list, set);
   return list;
 }
@@ -470,45 +577,48 @@ STORAGE_SET_LIST *parse_storage_list(FILEBUF *fb, int indent) {
 //
 // Parse one storage set and return it
 //
-STORAGE_SET *parse_storage_set(FILEBUF *fb, int indent) {
+STORAGE_SET *parse_storage_set(STORAGE_CURSOR *cur, int indent) {
   STORAGE_SET *set = new_storage_set();
   int        loops = 0;
 
-  while(skip_indent(fb, indent)) {
+  // we need the file to stay around as long as we have slices of it
+  set->source = cur->src;
+  set->source->refs++;
+
+  while(skip_indent(cur, indent)) {
     loops++;
-    if(storage_end(fb))
+    if(storage_end(cur))
       break;
 
-    char *key = parse_key(fb);
-    char type = parse_type(fb);
+    const char *key = parse_key(cur);
+    char       type = parse_type(cur);
+    STORAGE_DATA *data = NULL;
 
     switch(type) {
-    case TYPELESS_MARKER: {
-      char *line = parse_line(fb);
-      store_string(set, key, line);
-      free(line);
+    case TYPELESS_MARKER:
+      data = new_storage_data(key);
+      parse_line(cur, data);
+      storage_put(set, data);
       break;
-    }
 
-    case STRING_MARKER: {
-      fbgetc(fb); // kill the newline
-      char *string = parse_string(fb, indent+2);
-      store_string(set, key, string);
-      free(string);
+    case STRING_MARKER:
+      skip_line(cur); // kill the newline
+      data = new_storage_data(key);
+      parse_string(cur, data, indent+2);
+      storage_put(set, data);
       break;
-    }
 
     case SET_MARKER:
-      fbgetc(fb); // kill the newline
-      store_set(set, key, parse_storage_set(fb, indent+2));
+      skip_line(cur); // kill the newline
+      store_set(set, key, parse_storage_set(cur, indent+2));
       break;
 
     case LIST_MARKER:
-      fbgetc(fb); // kill the newline
-      store_list(set, key, parse_storage_list(fb, indent+2));
+      skip_line(cur); // kill the newline
+      store_list(set, key, parse_storage_list(cur, indent+2));
       break;
     }
-    free(key);
+    strRelease(key);
   }
 
   if(loops == 0) {
@@ -520,6 +630,372 @@ STORAGE_SET *parse_storage_set(FILEBUF *fb, int indent) {
 
 
 
+//*****************************************************************************
+//
+// The binary storage format. A file begins with STORAGE_BINARY_MAGIC and a
+// version byte, followed by a table of every key used in the file, and then
+// the top-level set. Numbers are written as varints (signed ones zigzagged).
+//
+//   file:   magic version <num keys> { <len> <key bytes> }* set
+//   set:    <num entries> { <key index> <type byte> value }*
+//   value:  string: <len> <bytes>     int:  <zigzag varint>
+//           double: <8 bytes>         bool: <1 byte>
+//           set:    set               list: <num sets> set*
+//
+// Entries are written in the same order they are in the text format, so
+// converting a file back and forth gives the same text.
+//
+//*****************************************************************************
+void bin_put_varint(BUFFER *buf, unsigned long val) {
+  char bytes[10];
+  int      len = 0;
+  do {
+    bytes[len]  = val & 0x7F;
+    val       >>= 7;
+    if(val != 0)
+      bytes[len] |= 0x80;
+    len++;
+  } while(val != 0);
+  bufferCatLen(buf, bytes, len);
+}
+
+void bin_put_long(BUFFER *buf, long val) {
+  bin_put_varint(buf, ((unsigned long)val << 1) ^ (unsigned long)(val >> 63));
+}
+
+//
+// work out what an untyped string really is, so numbers can be written as
+// numbers. Only strings that would print back out exactly the same way count
+int storage_guess_type(const char *str, long *int_val, double *dbl_val) {
+  char *end = NULL;
+  char  buf[20];
+  if(!strcmp(str, "yes") || !strcmp(str, "no")) {
+    *int_val = (*str == 'y');
+    return STORAGE_TYPE_BOOL;
+  }
+  if(*str == '\0' || isspace(*str))
+    return STORAGE_TYPE_STRING;
+
+  errno    = 0;
+  *int_val = strtol(str, &end, 10);
+  if(errno == 0 && *end == '\0') {
+    snprintf(buf, 20, "%ld", *int_val);
+    if(!strcmp(buf, str))
+      return STORAGE_TYPE_INT;
+  }
+  *dbl_val = strtod(str, &end);
+  if(*end == '\0') {
+    snprintf(buf, 20, "%lf", *dbl_val);
+    if(!strcmp(buf, str))
+      return STORAGE_TYPE_DOUBLE;
+  }
+  return STORAGE_TYPE_STRING;
+}
+
+//
+// write the index of a key, adding it to our key table if it's new. Keys are
+// shared strings, so the same key is always the same pointer
+void bin_put_key(BUFFER *buf, const char *key, MAP *key_map, BUFFER *keys,
+		 int *num_keys) {
+  long index = (long)mapGet(key_map, key);
+  if(index == 0) {
+    index = ++(*num_keys);
+    mapPut(key_map, key, (void *)index);
+    bin_put_varint(keys, strlen(key));
+    bufferCat(keys, key);
+  }
+  bin_put_varint(buf, index - 1);
+}
+
+void write_binary_set(STORAGE_SET *set, BUFFER *buf, MAP *key_map,
+		      BUFFER *keys, int *num_keys);
+
+void write_binary_list(STORAGE_SET_LIST *list, BUFFER *buf, MAP *key_map,
+		       BUFFER *keys, int *num_keys) {
+  bin_put_varint(buf, listSize(list->list));
+  LIST_ITERATOR *list_i = newListIterator(list->list);
+  STORAGE_SET      *set = NULL;
+  ITERATE_LIST(set, list_i)
+    write_binary_set(set, buf, key_map, keys, num_keys);
+  deleteListIterator(list_i);
+}
+
+void write_binary_set(STORAGE_SET *set, BUFFER *buf, MAP *key_map,
+		      BUFFER *keys, int *num_keys) {
+  // collect and sort our entries. Empty ones are kept as empty strings; the
+  // text format doesn't write them, but their keys still count towards how
+  // wide the key column is
+  LIST           *elems = newList();
+  HASH_ITERATOR *hash_i = newHashIterator(set->entries);
+  STORAGE_DATA    *data = NULL;
+  const char       *key = NULL;
+  ITERATE_HASH(key, data, hash_i)
+    listPut(elems, data);
+  deleteHashIterator(hash_i);
+  listSortWith(elems, cmp_storage_vars);
+
+  bin_put_varint(buf, listSize(elems));
+  while( (data = listPop(elems)) != NULL) {
+    bin_put_key(buf, data->key, key_map, keys, num_keys);
+
+    // sets and lists are only written if we have no string value
+    if(*storage_data_str(data) ||
+       (set_is_empty(data->set_val) && list_is_empty(data->list_val))) {
+      int    type = data->type;
+      long int_val = data->int_val;
+      double dbl_val = data->dbl_val;
+      if(type == STORAGE_TYPE_UNKNOWN || type == STORAGE_TYPE_STRING)
+	type = storage_guess_type(data->str_val, &int_val, &dbl_val);
+      bufferCatCh(buf, type);
+      if(type == STORAGE_TYPE_INT)
+	bin_put_long(buf, int_val);
+      else if(type == STORAGE_TYPE_BOOL)
+	bufferCatCh(buf, (int_val ? 1 : 0));
+      else if(type == STORAGE_TYPE_DOUBLE)
+	bufferCatLen(buf, (const char *)&dbl_val, sizeof(double));
+      else {
+	bin_put_varint(buf, strlen(data->str_val));
+	bufferCat(buf, data->str_val);
+      }
+    }
+    else if(!set_is_empty(data->set_val)) {
+      bufferCatCh(buf, STORAGE_TYPE_SET);
+      write_binary_set(data->set_val, buf, key_map, keys, num_keys);
+    }
+    else {
+      bufferCatCh(buf, STORAGE_TYPE_LIST);
+      write_binary_list(data->list_val, buf, key_map, keys, num_keys);
+    }
+  }
+  deleteList(elems);
+}
+
+bool bin_get_varint(STORAGE_CURSOR *cur, unsigned long *val) {
+  int shift = 0;
+  *val      = 0;
+  while(cur->pos < cur->end && shift < 64) {
+    unsigned char byte = *cur->pos++;
+    *val  |= (unsigned long)(byte & 0x7F) << shift;
+    shift += 7;
+    if(!(byte & 0x80))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+STORAGE_SET *parse_binary_set(STORAGE_CURSOR *cur, const char **keys,
+			      unsigned long num_keys, int depth);
+
+STORAGE_SET_LIST *parse_binary_list(STORAGE_CURSOR *cur, const char **keys,
+				    unsigned long num_keys, int depth) {
+  STORAGE_SET_LIST *list = new_storage_list();
+  STORAGE_SET       *set = NULL;
+  unsigned long    count = 0, i;
+  if(!bin_get_varint(cur, &count)) {
+    delete_storage_list(list);
+    return NULL;
+  }
+  for(i = 0; i < count; i++) {
+    if((set = parse_binary_set(cur, keys, num_keys, depth)) == NULL) {
+      delete_storage_list(list);
+      return NULL;
+    }
+    storage_list_put(list, set);
+  }
+  return list;
+}
+
+//
+// parse a set out of a binary file. Returns NULL if the file is corrupt
+STORAGE_SET *parse_binary_set(STORAGE_CURSOR *cur, const char **keys,
+			      unsigned long num_keys, int depth) {
+  STORAGE_SET *set = new_storage_set();
+  unsigned long count = 0, i, index = 0, val = 0;
+  set->source = cur->src;
+  set->source->refs++;
+
+  if(depth > STORAGE_BINARY_MAX_DEPTH || !bin_get_varint(cur, &count))
+    goto corrupt;
+
+  for(i = 0; i < count; i++) {
+    STORAGE_DATA *data = NULL;
+    if(!bin_get_varint(cur, &index) || index >= num_keys ||cur->pos >= cur->end)
+      goto corrupt;
+    data       = new_storage_data(keys[index]);
+    data->type = *cur->pos++;
+    storage_put(set, data);
+
+    switch(data->type) {
+    case STORAGE_TYPE_STRING:
+      if(!bin_get_varint(cur, &val) || val > (unsigned long)(cur->end-cur->pos))
+	goto corrupt;
+      data->raw     = cur->pos;
+      data->raw_len = val;
+      cur->pos     += val;
+      break;
+    case STORAGE_TYPE_INT:
+      if(!bin_get_varint(cur, &val))
+	goto corrupt;
+      data->int_val = (long)(val >> 1) ^ -(long)(val & 1);
+      break;
+    case STORAGE_TYPE_BOOL:
+      if(cur->pos >= cur->end)
+	goto corrupt;
+      data->int_val = *cur->pos++;
+      break;
+    case STORAGE_TYPE_DOUBLE:
+      if(cur->end - cur->pos < (int)sizeof(double))
+	goto corrupt;
+      memcpy(&data->dbl_val, cur->pos, sizeof(double));
+      cur->pos += sizeof(double);
+      break;
+    case STORAGE_TYPE_SET:
+      data->type = STORAGE_TYPE_UNKNOWN;
+      if((data->set_val = parse_binary_set(cur,keys,num_keys,depth+1)) == NULL)
+	goto corrupt;
+      break;
+    case STORAGE_TYPE_LIST:
+      data->type = STORAGE_TYPE_UNKNOWN;
+      if((data->list_val = parse_binary_list(cur,keys,num_keys,depth+1))==NULL)
+	goto corrupt;
+      break;
+    default:
+      goto corrupt;
+    }
+  }
+  return set;
+
+ corrupt:
+  delete_storage_set(set);
+  return NULL;
+}
+
+//
+// parse a whole binary file. The cursor starts just past the magic
+STORAGE_SET *parse_binary_file(STORAGE_CURSOR *cur, const char *fname) {
+  STORAGE_SET     *set = NULL;
+  unsigned long  num_keys = 0, i, len = 0;
+  const char    **keys = NULL;
+
+  if(cur->pos >= cur->end || *cur->pos++ != STORAGE_BINARY_VERSION) {
+    log_string("ERROR: %s is in an unknown binary storage version.", fname);
+    return NULL;
+  }
+  if(!bin_get_varint(cur, &num_keys) ||
+     num_keys > (unsigned long)(cur->end - cur->pos)) {
+    log_string("ERROR: binary storage file %s is corrupt.", fname);
+    return NULL;
+  }
+
+  keys = calloc(num_keys + 1, sizeof(char *));
+  for(i = 0; i < num_keys; i++) {
+    if(!bin_get_varint(cur, &len) || len > (unsigned long)(cur->end-cur->pos))
+      break;
+    char key[len + 1];
+    memcpy(key, cur->pos, len);
+    key[len]  = '\0';
+    keys[i]   = strShare(key);
+    cur->pos += len;
+  }
+
+  if(i == num_keys)
+    set = parse_binary_set(cur, keys, num_keys, 0);
+  if(set == NULL)
+    log_string("ERROR: binary storage file %s is corrupt.", fname);
+
+  for(i = 0; i < num_keys; i++)
+    strRelease(keys[i]);
+  free(keys);
+  return set;
+}
+
+//
+// does this file look like it holds a storage set? Text storage files have a
+// key on their first line and end with the end-of-set marker
+bool storage_file_looks_like_set(const char *fname) {
+  struct stat st;
+  char       buf[SMALL_BUFFER];
+  FILE       *fl = NULL;
+  int        len = 0;
+  bool        ok = FALSE;
+  if(stat(fname, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < 2 ||
+     (fl = fopen(fname, "r")) == NULL)
+    return FALSE;
+
+  len = fread(buf, 1, sizeof(buf) - 1, fl);
+  buf[len] = '\0';
+  if(len >= STORAGE_BINARY_MAGIC_LEN &&
+     !memcmp(buf, STORAGE_BINARY_MAGIC, STORAGE_BINARY_MAGIC_LEN))
+    ok = TRUE;
+  else {
+    char *colon = strchr(buf, ':');
+    char    *nl = strchr(buf, '\n');
+    if(colon != NULL && (nl == NULL || colon < nl) && *buf != ' ' &&
+       fseek(fl, -2, SEEK_END) == 0 && fread(buf, 1, 2, fl) == 2)
+      ok = (buf[0] == SET_MARKER && buf[1] == '\n');
+  }
+  fclose(fl);
+  return ok;
+}
+
+//
+// convert every storage file under path to the given format. Returns how
+// many files were converted
+int storage_convert_tree(const char *path, int format, int *failed) {
+  struct stat st;
+  int converted = 0;
+  if(stat(path, &st) < 0)
+    return 0;
+
+  if(S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path);
+    struct dirent *entry = NULL;
+    if(dir == NULL)
+      return 0;
+    while((entry = readdir(dir)) != NULL) {
+      if(*entry->d_name == '.')
+	continue;
+      char buf[MAX_BUFFER];
+      snprintf(buf, MAX_BUFFER, "%s/%s", path, entry->d_name);
+      converted += storage_convert_tree(buf, format, failed);
+    }
+    closedir(dir);
+  }
+  else if(storage_file_looks_like_set(path) &&
+	  storage_file_format(path) != format) {
+    // write to the side and move it into place, so a failure can't leave us
+    // with half a file
+    STORAGE_SET *set = storage_read(path);
+    char     tmp[MAX_BUFFER];
+    snprintf(tmp, MAX_BUFFER, "%s.convert", path);
+    if(set != NULL && storage_write_format(set, tmp, format) &&
+       rename(tmp, path) == 0)
+      converted++;
+    else {
+      unlink(tmp);
+      (*failed)++;
+    }
+    if(set != NULL)
+      storage_close(set);
+  }
+  return converted;
+}
+
+COMMAND(cmd_storageconvert) {
+  char format_name[SMALL_BUFFER];
+  int  format = -1, failed = 0;
+  arg = one_arg(arg, format_name);
+  if(!*arg || (format = storage_format_by_name(format_name)) < 0) {
+    send_to_char(ch, "Usage: storageconvert <text|binary> <file or directory>\r\n"
+		 "Converts every storage file found to the given format.\r\n");
+    return;
+  }
+  int converted = storage_convert_tree(arg, format, &failed);
+  send_to_char(ch, "%d file%s converted to %s, %d failed.\r\n", converted,
+	       (converted == 1 ? "" : "s"), format_name, failed);
+}
+
+
 
 //*****************************************************************************
 //
@@ -527,21 +1003,107 @@ STORAGE_SET *parse_storage_set(FILEBUF *fb, int indent) {
 // documentation contained in storage.h
 //
 //*****************************************************************************
+void init_storage(void) {
+  add_cmd("storageconvert", NULL, cmd_storageconvert, "admin", FALSE);
+}
+
 void storage_write(STORAGE_SET *set, const char *fname) {
-  FILEBUF *fb = NULL;
-  // we wanted to open a file, but we couldn't ... abort
-  if((fb = fbopen(fname, "w+")) == NULL)
-    return;
-  write_storage_set(set, fb, 0);
-  fbclose(fb);
+  storage_write_format(set, fname, STORAGE_FORMAT_TEXT);
+}
+
+bool storage_write_format(STORAGE_SET *set, const char *fname, int format) {
+  // sets read from a file may still have strings in its mapping that haven't
+  // been copied out, and truncating the file would pull them out from under
+  // us. So, we write beside the file and move over it once we're done; the
+  // mapping keeps the old one around until it is let go of
+  char tmp[MAX_BUFFER + sizeof(".tmp")];
+  bool  ok = FALSE;
+  if(snprintf(tmp, sizeof(tmp), "%s.tmp", fname) >= (int)sizeof(tmp)) {
+    log_string("ERROR: storage path %s is too long to write", fname);
+    return FALSE;
+  }
+
+  if(format == STORAGE_FORMAT_BINARY) {
+    BUFFER   *body = newBuffer(MAX_BUFFER);
+    BUFFER   *keys = newBuffer(SMALL_BUFFER);
+    BUFFER    *out = newBuffer(1);
+    MAP   *key_map = newMap(NULL, NULL);
+    int   num_keys = 0;
+    FILE       *fl = NULL;
+
+    write_binary_set(set, body, key_map, keys, &num_keys);
+    bufferCatLen(out, STORAGE_BINARY_MAGIC, STORAGE_BINARY_MAGIC_LEN);
+    bufferCatCh(out, STORAGE_BINARY_VERSION);
+    bin_put_varint(out, num_keys);
+    bufferCatLen(out, bufferString(keys), bufferLength(keys));
+    bufferCatLen(out, bufferString(body), bufferLength(body));
+    if((fl = fopen(tmp, "w")) != NULL) {
+      ok = (fwrite(bufferString(out), 1, bufferLength(out), fl) ==
+	    (size_t)bufferLength(out));
+      ok = (fclose(fl) == 0 && ok);
+    }
+    deleteMap(key_map);
+    deleteBuffer(body);
+    deleteBuffer(keys);
+    deleteBuffer(out);
+  }
+  else {
+    FILEBUF *fb = NULL;
+    // we wanted to open a file, but we couldn't ... abort
+    if((fb = fbopen(tmp, "w+")) == NULL)
+      return FALSE;
+    write_storage_set(set, fb, 0);
+    fbclose(fb);
+    ok = TRUE;
+  }
+
+  if(ok && rename(tmp, fname) == 0)
+    return TRUE;
+  unlink(tmp);
+  return FALSE;
+}
+
+void storage_write_type(STORAGE_SET *set, const char *fname, const char *type){
+  storage_write_format(set, fname, storage_type_format(type));
+}
+
+int storage_format_by_name(const char *name) {
+  if(!strcasecmp(name, "text"))
+    return STORAGE_FORMAT_TEXT;
+  else if(!strcasecmp(name, "binary"))
+    return STORAGE_FORMAT_BINARY;
+  return -1;
+}
+
+int storage_type_format(const char *type) {
+  char setting[SMALL_BUFFER];
+  snprintf(setting, SMALL_BUFFER, "storage_format_%s", type);
+  int format = storage_format_by_name(mudsettingGetString(setting));
+  if(format < 0)
+    format = storage_format_by_name(mudsettingGetString("storage_format"));
+  return (format < 0 ? STORAGE_FORMAT_TEXT : format);
+}
+
+int storage_file_format(const char *fname) {
+  char magic[STORAGE_BINARY_MAGIC_LEN];
+  FILE   *fl = fopen(fname, "r");
+  int format = STORAGE_FORMAT_TEXT;
+  if(fl == NULL)
+    return -1;
+  if(fread(magic, 1, STORAGE_BINARY_MAGIC_LEN, fl) == STORAGE_BINARY_MAGIC_LEN &&
+     !memcmp(magic, STORAGE_BINARY_MAGIC, STORAGE_BINARY_MAGIC_LEN))
+    format = STORAGE_FORMAT_BINARY;
+  fclose(fl);
+  return format;
 }
 
 
 STORAGE_SET *new_storage_set() {
-  STORAGE_SET *set = malloc(sizeof(STORAGE_SET));
+  STORAGE_SET *set = memAlloc(MEM_STORAGE_SET, sizeof(STORAGE_SET));
   set->entries     = newHashtableSize(20);
   set->longest_key = 0;
   set->top_entry   = 0;
+  set->source      = NULL;
   return set;
 }
 
@@ -552,30 +1114,45 @@ void storage_close(STORAGE_SET *set) {
 
 
 STORAGE_SET *storage_read(const char *fname) {
-  FILEBUF *fb = NULL;
-  
+  struct stat st;
+  int         fd = open(fname, O_RDONLY);
+
   // Try to open the file
-  if((fb = fbopen(fname, "r")) == NULL) {
+  if(fd < 0 || fstat(fd, &st) < 0) {
     // Log detailed error information
     log_string("ERROR: Could not open file %s: %s", fname, strerror(errno));
     log_string("Current working directory: %s", getcwd(NULL, 0));
+    if(fd >= 0) close(fd);
     return NULL;
   }
 
-  // track how long it takes us to parse a storage set
-  // struct timeval start_time;
-  // gettimeofday(&start_time, NULL);
-
-  STORAGE_SET *set = parse_storage_set(fb, 0);
-
-  // finish tracking
-  // struct timeval end_time;
-  // gettimeofday(&end_time, NULL);
-  // int usecs = (int)(end_time.tv_usec - start_time.tv_usec);
-  // int secs  = (int)(end_time.tv_sec  - start_time.tv_sec);
-  // log_string("storage read time %d %s", (int)(secs*1000000 + usecs), fname);
-
-  fbclose(fb);
+  // map the file in. Empty files can't be mapped, and we don't need them to be
+  STORAGE_SOURCE *src = NULL;
+  if(st.st_size == 0)
+    src = new_storage_source(NULL, 0, FALSE);
+  else {
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED) {
+      log_string("ERROR: Could not map file %s: %s", fname, strerror(errno));
+      close(fd);
+      return NULL;
+    }
+    src = new_storage_source(data, st.st_size, TRUE);
+  }
+  // the mapping stays around after the file is closed
+  close(fd);
+
+  STORAGE_CURSOR cur = { src->data, src->data + src->len, src };
+  STORAGE_SET   *set = NULL;
+  src->refs++;
+  if(src->len >= STORAGE_BINARY_MAGIC_LEN &&
+     !memcmp(src->data, STORAGE_BINARY_MAGIC, STORAGE_BINARY_MAGIC_LEN)) {
+    cur.pos += STORAGE_BINARY_MAGIC_LEN;
+    set = parse_binary_file(&cur, fname);
+  }
+  else
+    set = parse_storage_set(&cur, 0);
+  storage_source_release(src);
   return set;
 }
 
@@ -641,8 +1218,11 @@ void store_long(STORAGE_SET *set, const char *key, long val) {
 
 STORAGE_SET *read_set(STORAGE_SET *set, const char *key) {
   STORAGE_DATA *data = hashGet(set->entries, key);
-  if(data) 
+  if(data) {
+    if(data->set_val == NULL)
+      data->set_val = new_storage_set();
     return data->set_val;
+  }
   else {
     store_set(set, key, new_storage_set());
     return read_set(set, key);
@@ -651,8 +1231,11 @@ STORAGE_SET *read_set(STORAGE_SET *set, const char *key) {
 
 STORAGE_SET_LIST *read_list(STORAGE_SET *set, const char *key) {
   STORAGE_DATA *data = hashGet(set->entries, key);
-  if(data) 
+  if(data) {
+    if(data->list_val == NULL)
+      data->list_val = new_storage_list();
     return data->list_val;
+  }
   else {
     store_list(set, key, new_storage_list());
     return read_list(set, key);
@@ -661,7 +1244,7 @@ STORAGE_SET_LIST *read_list(STORAGE_SET *set, const char *key) {
 
 const char *read_string(STORAGE_SET *set, const char *key) {
   STORAGE_DATA *data = hashGet(set->entries, key);
-  if(data) return data->str_val;
+  if(data) return storage_data_str(data);
   else     return "";
 }
 
@@ -669,9 +1252,11 @@ bool read_bool(STORAGE_SET *set, const char *key) {
   STORAGE_DATA *data = hashGet(set->entries, key);
   if(data == NULL) 
     return FALSE;
-  else if(!strcasecmp(data->str_val, "Yes"))
+  else if(data->type == STORAGE_TYPE_BOOL || data->type == STORAGE_TYPE_INT)
+    return (data->int_val != 0);
+  else if(!strcasecmp(storage_data_str(data), "Yes"))
     return TRUE;
-  else if(atoi(data->str_val) != 0)
+  else if(atoi(storage_data_str(data)) != 0)
     return TRUE;
   else
     return FALSE;
@@ -679,19 +1264,25 @@ bool read_bool(STORAGE_SET *set, const char *key) {
 
 double read_double(STORAGE_SET *set, const char *key) {
   STORAGE_DATA *data = hashGet(set->entries, key);
-  if(data) return atof(data->str_val);
+  if(data && data->type == STORAGE_TYPE_DOUBLE)
+    return data->dbl_val;
+  else if(data) return atof(storage_data_str(data));
   else     return 0;
 }
 
 int read_int(STORAGE_SET *set, const char *key) {
   STORAGE_DATA *data = hashGet(set->entries, key);
-  if(data) return atoi(data->str_val);
+  if(data && data->type == STORAGE_TYPE_INT)
+    return (int)data->int_val;
+  else if(data) return atoi(storage_data_str(data));
   else     return 0;
 }
 
 long read_long(STORAGE_SET *set, const char *key) {
   STORAGE_DATA *data = hashGet(set->entries, key);
-  if(data) return atol(data->str_val);
+  if(data && data->type == STORAGE_TYPE_INT)
+    return data->int_val;
+  else if(data) return atol(storage_data_str(data));
   else     return 0;
 }
 
@@ -699,6 +1290,39 @@ bool storage_contains(STORAGE_SET *set, const char *key) {
   return (hashGet(set->entries, key) != NULL);
 }
 
+STORAGE_SET *storage_set_copy(STORAGE_SET *set) {
+  STORAGE_SET   *newset = new_storage_set();
+  HASH_ITERATOR *hash_i = newHashIterator(set->entries);
+  STORAGE_DATA    *data = NULL;
+  const char       *key = NULL;
+
+  ITERATE_HASH(key, data, hash_i) {
+    STORAGE_DATA *newdata = new_storage_data(data->key);
+    newdata->type      = data->type;
+    newdata->int_val   = data->int_val;
+    newdata->dbl_val   = data->dbl_val;
+    newdata->entry_num = data->entry_num;
+    if(data->str_val != NULL || data->raw != NULL)
+      newdata->str_val = strdup(storage_data_str(data));
+    if(data->set_val)
+      newdata->set_val = storage_set_copy(data->set_val);
+    if(data->list_val) {
+      LIST_ITERATOR *list_i = newListIterator(data->list_val->list);
+      STORAGE_SET    *elem = NULL;
+      newdata->list_val = new_storage_list();
+      ITERATE_LIST(elem, list_i)
+	storage_list_put(newdata->list_val, storage_set_copy(elem));
+      deleteListIterator(list_i);
+    }
+    hashPut(newset->entries, newdata->key, newdata);
+  } deleteHashIterator(hash_i);
+
+  // keep everything in the same order, and lined up the same way
+  newset->longest_key = set->longest_key;
+  newset->top_entry   = set->top_entry;
+  return newset;
+}
+
 //
 // make a storage list out of a normal MUD list
 //
@@ -33,7 +33,55 @@ void storage_write(STORAGE_SET *set, const char *fname);
 
 
 //
-// read the storage set from the specified file
+// the formats a storage set can be written in. Text is the one described
+// above. Binary is a compact encoding of the same thing that is much faster
+// to read; it keeps every key once in a table at the front of the file, and
+// numbers as numbers. storage_read tells the two apart on its own
+//
+#define STORAGE_FORMAT_TEXT       0
+#define STORAGE_FORMAT_BINARY     1
+
+
+//
+// write the storage set in the specified format. Returns FALSE if the file
+// could not be written
+//
+bool storage_write_format(STORAGE_SET *set, const char *fname, int format);
+
+
+//
+// write the storage set in whatever format the given type of data (e.g.
+// "pfile", "zone", "mproto") is meant to be saved in. That is picked with
+// the storage_format_<type> mud setting, or storage_format if the type has
+// no setting of its own. Either may be "text" or "binary"
+//
+void storage_write_type(STORAGE_SET *set, const char *fname, const char *type);
+int  storage_type_format(const char *type);
+
+
+//
+// returns the format of a storage file, or -1 if it could not be opened
+//
+int storage_file_format(const char *fname);
+
+
+//
+// returns the format with the given name ("text" or "binary"), or -1
+//
+int storage_format_by_name(const char *name);
+
+
+//
+// sets up the storageconvert command, for converting storage files from
+// one format to the other
+//
+void init_storage(void);
+
+
+//
+// read the storage set from the specified file. The file is mapped into
+// memory, and string values are only copied out of it when they are first
+// read; the mapping is let go of when the set is closed
 //
 STORAGE_SET *storage_read(const char *fname);
 
@@ -89,6 +137,13 @@ bool                read_bool(STORAGE_SET *set, const char *key);
 //
 bool storage_contains(STORAGE_SET *set, const char *key);
 
+//
+// return a copy of a storage set and everything in it, to be closed after use.
+// The copy doesn't depend on the file the set was read from, if it was, so it
+// can be kept after the set is closed
+//
+STORAGE_SET *storage_set_copy(STORAGE_SET *set);
+
 
 //
 // utilities to speed up the reading/saving of lists
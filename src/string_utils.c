@@ -11,6 +11,7 @@
 /* include main header file */
 #include "mud.h"
 #include "utils.h"
+#include "strscan.h"
 
 /*
  * Compares two strings, and returns TRUE
@@ -18,20 +19,15 @@
  */
 bool compares(const char *aStr, const char *bStr)
 {
-  int i = 0;
-
   /* NULL strings never compares */
   if (aStr == NULL || bStr == NULL) return FALSE;
 
-  while (aStr[i] != '\0' && bStr[i] != '\0' && toupper(aStr[i]) == toupper(bStr[i]))
-    i++;
-
-  /* if we terminated for any reason except the end of both strings return FALSE */
-  if (aStr[i] != '\0' || bStr[i] != '\0')
+  /* both strings have to end at the same place */
+  int len = strlen(aStr);
+  if ((int)strlen(bStr) != len)
     return FALSE;
 
-  /* success */
-  return TRUE;
+  return scan_caseeq(aStr, bStr, len);
 }
 
 /*
@@ -46,22 +42,15 @@ bool is_prefix(const char *aStr, const char *bStr)
   if (aStr[0] == '\0' || bStr[0] == '\0') return FALSE;
 
   /* check if aStr is a prefix of bStr */
-  while (*aStr)
-  {
-    if (tolower(*aStr++) != tolower(*bStr++))
-      return FALSE;
-  }
-
-  /* success */
-  return TRUE;
+  int len = strlen(aStr);
+  return ((int)strnlen(bStr, len) == len && scan_caseeq(aStr, bStr, len));
 }
 
 
 // same as one_arg, but can take constants
 const char *one_arg_safe(const char *fStr, char *bStr) {
   /* skip leading spaces */
-  while (isspace(*fStr))
-    fStr++; 
+  fStr = scan_skip_space(fStr);
 
   /* copy the beginning of the string */
   while (*fStr != '\0')
@@ -80,20 +69,15 @@ const char *one_arg_safe(const char *fStr, char *bStr) {
   /* terminate string */
   *bStr = '\0';
 
-  /* skip past any leftover spaces */
-  while (isspace(*fStr))
-    fStr++;
-
-  /* return the leftovers */
-  return fStr;
+  /* skip past any leftover spaces, and return the leftovers */
+  return scan_skip_space(fStr);
 }
 
 
 char *one_arg(char *fStr, char *bStr)
 {
   /* skip leading spaces */
-  while (isspace(*fStr))
-    fStr++; 
+  fStr = (char *)scan_skip_space(fStr);
 
   char arg_end = ' ';
 
@@ -103,7 +87,8 @@ char *one_arg(char *fStr, char *bStr)
     fStr++;
   }
 
-  /* copy the beginning of the string */
+  /* copy the beginning of the string. Arguments are short enough that
+     copying as we look for the end beats finding it first */
   while (*fStr != '\0')
   {
     /* have we reached the end of the first word ? */
@@ -120,12 +105,8 @@ char *one_arg(char *fStr, char *bStr)
   /* terminate string */
   *bStr = '\0';
 
-  /* skip past any leftover spaces */
-  while (isspace(*fStr))
-    fStr++;
-
-  /* return the leftovers */
-  return fStr;
+  /* skip past any leftover spaces, and return the leftovers */
+  return (char *)scan_skip_space(fStr);
 }
 
 char *two_args(char *from, char *arg1, char *arg2) {
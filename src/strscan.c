@@ -0,0 +1,205 @@
+//*****************************************************************************
+//
+// strscan.c
+//
+// vectorized string scanning. See strscan.h. Most of what gets scanned is
+// short (words, and the arguments of commands), so scans of strings that end
+// in a \0 go a byte at a time to the end of the 16-byte block str starts in,
+// and only then load whole aligned blocks, stopping at the one the \0 is in.
+// An aligned block never crosses a page, so the bytes read past the end of
+// the string are always safe to read, but they aren't part of anything we
+// allocated, so address sanitizing is turned off for those scans.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+
+#include "mud.h"
+#include "strscan.h"
+
+#if defined(__SSE2__) && !defined(STRSCAN_SCALAR)
+#include <emmintrin.h>
+#define SCAN_SSE2
+#elif defined(__ARM_NEON) && !defined(STRSCAN_SCALAR)
+#include <arm_neon.h>
+#define SCAN_NEON
+#endif
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the kinds of characters a scan of a string can stop at. All of them stop
+// at the \0, if nothing comes before it
+#define SCAN_STOP_CHAR     0 // the character being looked for
+#define SCAN_STOP_SPACE    1 // whitespace
+#define SCAN_STOP_TEXT     2 // anything but whitespace
+
+#define SCAN_WIDTH        16 // how many bytes we look at at once
+
+// isspace() and the ASCII lowercase of a character, in the C locale
+#define SCAN_ISSPACE(c)   ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+#define SCAN_FOLD(c)      ((c) >= 'A' && (c) <= 'Z' ? (c) | 0x20 : (c))
+
+// does a scan of the given kind stop at c?
+#define SCAN_STOPS_AT(c, kind, ch)					\
+  ((kind) == SCAN_STOP_CHAR  ? ((c) == (ch) || (c) == '\0') :		\
+   (kind) == SCAN_STOP_SPACE ? ((c) == '\0' || SCAN_ISSPACE(c)) :	\
+   !SCAN_ISSPACE(c))
+
+#if defined(__GNUC__)
+#define SCAN_UNSANITIZED  __attribute__((no_sanitize_address))
+#else
+#define SCAN_UNSANITIZED
+#endif
+
+//
+// each vector extension's compares, and how they become a mask with
+// SCAN_BITS bits set for each byte that compared true. Compares of bytes are
+// signed, so nothing above 127 is ever whitespace or a letter
+#if defined(SCAN_SSE2)
+typedef __m128i SCAN_VEC;
+#define SCAN_BITS          1
+#define SCAN_FULL          0xFFFFULL
+#define scan_load(p)       _mm_load_si128((const __m128i *)(p))
+#define scan_loadu(p)      _mm_loadu_si128((const __m128i *)(p))
+#define scan_splat(c)      _mm_set1_epi8(c)
+#define scan_eq(a, b)      _mm_cmpeq_epi8(a, b)
+#define scan_gt(a, b)      _mm_cmpgt_epi8(a, b)
+#define scan_or(a, b)      _mm_or_si128(a, b)
+#define scan_and(a, b)     _mm_and_si128(a, b)
+#define scan_xor(a, b)     _mm_xor_si128(a, b)
+#define scan_mask(v)       ((unsigned long long)_mm_movemask_epi8(v))
+#elif defined(SCAN_NEON)
+typedef uint8x16_t SCAN_VEC;
+#define SCAN_BITS          4
+#define SCAN_FULL          (~0ULL)
+#define scan_load(p)       vld1q_u8((const uint8_t *)(p))
+#define scan_loadu(p)      vld1q_u8((const uint8_t *)(p))
+#define scan_splat(c)      vdupq_n_u8((uint8_t)(c))
+#define scan_eq(a, b)      vceqq_u8(a, b)
+#define scan_gt(a, b)      vcgtq_s8(vreinterpretq_s8_u8(a), \
+				    vreinterpretq_s8_u8(b))
+#define scan_or(a, b)      vorrq_u8(a, b)
+#define scan_and(a, b)     vandq_u8(a, b)
+#define scan_xor(a, b)     veorq_u8(a, b)
+#define scan_mask(v)							\
+  vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0)
+#endif
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+#if defined(SCAN_SSE2) || defined(SCAN_NEON)
+
+//
+// which bytes of v are whitespace
+static inline SCAN_VEC scan_vec_space(SCAN_VEC v) {
+  return scan_or(scan_eq(v, scan_splat(' ')),
+		 scan_and(scan_gt(v, scan_splat('\t' - 1)),
+			  scan_gt(scan_splat('\r' + 1), v)));
+}
+
+//
+// which bytes of a and b are the same, ignoring case. Two bytes can only
+// differ by case if they differ by nothing but 0x20, and one is a letter
+static inline SCAN_VEC scan_vec_caseeq(SCAN_VEC a, SCAN_VEC b) {
+  SCAN_VEC   bit = scan_splat(0x20);
+  SCAN_VEC lower = scan_or(a, bit);
+  SCAN_VEC alpha = scan_and(scan_gt(lower, scan_splat('a' - 1)),
+			    scan_gt(scan_splat('z' + 1), lower));
+  SCAN_VEC  diff = scan_xor(a, b);
+  return scan_eq(diff, scan_and(alpha, scan_and(diff, bit)));
+}
+
+//
+// which bytes of v a scan of the given kind would stop at
+static inline unsigned long long scan_stops(SCAN_VEC v, int kind,
+					    SCAN_VEC ch) {
+  SCAN_VEC zero = scan_splat(0);
+  switch(kind) {
+  case SCAN_STOP_CHAR:
+    return scan_mask(scan_or(scan_eq(v, ch), scan_eq(v, zero)));
+  case SCAN_STOP_SPACE:
+    return scan_mask(scan_or(scan_vec_space(v), scan_eq(v, zero)));
+  default:
+    // the \0 isn't whitespace, so it stops us here too
+    return scan_mask(scan_eq(scan_vec_space(v), zero));
+  }
+}
+
+SCAN_UNSANITIZED
+static inline const char *scan_until(const char *str, int kind, char ch) {
+  for(; ((uintptr_t)str & (SCAN_WIDTH - 1)) != 0; str++)
+    if(SCAN_STOPS_AT(*str, kind, ch))
+      return str;
+
+  SCAN_VEC want = scan_splat(ch);
+  for(; ; str += SCAN_WIDTH) {
+    unsigned long long mask = scan_stops(scan_load(str), kind, want);
+    if(mask != 0)
+      return str + __builtin_ctzll(mask) / SCAN_BITS;
+  }
+}
+
+#else
+
+static inline const char *scan_until(const char *str, int kind, char ch) {
+  while(!SCAN_STOPS_AT(*str, kind, ch))
+    str++;
+  return str;
+}
+
+#endif
+
+
+
+//*****************************************************************************
+// implementation of strscan.h
+//*****************************************************************************
+const char *scan_find(const char *str, char ch) {
+  return scan_until(str, SCAN_STOP_CHAR, ch);
+}
+
+const char *scan_to_space(const char *str) {
+  return scan_until(str, SCAN_STOP_SPACE, '\0');
+}
+
+const char *scan_skip_space(const char *str) {
+  // most of the time, there's nothing to skip
+  if(!SCAN_ISSPACE(*str))
+    return str;
+  return scan_until(str + 1, SCAN_STOP_TEXT, '\0');
+}
+
+int scan_count(const char *str, int len, char ch) {
+  int i = 0, n = 0;
+#if defined(SCAN_SSE2) || defined(SCAN_NEON)
+  SCAN_VEC want = scan_splat(ch);
+  for(; i + SCAN_WIDTH <= len; i += SCAN_WIDTH)
+    n += __builtin_popcountll(scan_mask(scan_eq(scan_loadu(str+i), want))) /
+      SCAN_BITS;
+#endif
+  for(; i < len; i++)
+    if(str[i] == ch)
+      n++;
+  return n;
+}
+
+bool scan_caseeq(const char *a, const char *b, int len) {
+  int i = 0;
+#if defined(SCAN_SSE2) || defined(SCAN_NEON)
+  for(; i + SCAN_WIDTH <= len; i += SCAN_WIDTH)
+    if(scan_mask(scan_vec_caseeq(scan_loadu(a+i), scan_loadu(b+i))) !=
+       SCAN_FULL)
+      return FALSE;
+#endif
+  for(; i < len; i++)
+    if(a[i] != b[i] && SCAN_FOLD(a[i]) != SCAN_FOLD(b[i]))
+      return FALSE;
+  return TRUE;
+}
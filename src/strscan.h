@@ -0,0 +1,38 @@
+#ifndef __STRSCAN_H
+#define __STRSCAN_H
+//*****************************************************************************
+//
+// strscan.h
+//
+// the scans the hot string helpers (one_arg, is_keyword, count_letters,
+// bufferFormat, and friends) are built on: finding a character, finding or
+// skipping whitespace, counting a character, and comparing without case. On
+// x86-64 they look at 16 bytes at a time with SSE2, on ARM with NEON, and a
+// byte at a time everywhere else (or if STRSCAN_SCALAR is defined).
+//
+// Whitespace is what isspace() calls whitespace in the C locale, and only
+// ASCII letters are folded when comparing, as strcasecmp does in it.
+//
+//*****************************************************************************
+
+//
+// return the first ch in str, or the \0 that ends it if there is none
+const char *scan_find(const char *str, char ch);
+
+//
+// return the first whitespace in str, or the \0 that ends it
+const char *scan_to_space(const char *str);
+
+//
+// return the first character in str that isn't whitespace (maybe the \0)
+const char *scan_skip_space(const char *str);
+
+//
+// how many times does ch occur in the first len characters of str?
+int scan_count(const char *str, int len, char ch);
+
+//
+// are the first len characters of a and b the same, ignoring case?
+bool scan_caseeq(const char *a, const char *b, int len);
+
+#endif // __STRSCAN_H
@@ -0,0 +1,195 @@
+//*****************************************************************************
+//
+// strutil.c
+//
+// the handful of string functions that our containers are built on: the
+// hash our hashtables use, and the helpers buffers and keyword sets need.
+// They are declared in utils.h like every other utility, but are kept apart
+// from utils.c so the containers can be built into programs that don't have
+// the rest of the mud in them, like the container benchmarks in bench/.
+// Nothing here may depend on anything but the containers themselves.
+//
+//*****************************************************************************
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "strscan.h"
+
+
+
+//
+// Calculates how many letters until we hit the next one
+// of a specified type
+//
+int next_letter_in(const char *string, char marker) {
+  const char *found = scan_find(string, marker);
+  return (*found != '\0' ? found - string : -1); // -1 if none found
+}
+
+
+//
+// a generic, case-insensitive function for hashing a string. Unlike the
+// pearson hashes in utils.c, we only walk the string once: characters are folded
+// to lowercase (ASCII only) and packed 8 to a word, each word is mixed in with
+// one multiply, and the result is run through a finalizer so every bit of the
+// output depends on every bit of the input.
+#define STRING_HASH_SEED        0x9E3779B97F4A7C15ULL
+#define STRING_HASH_MUL         0xFF51AFD7ED558CCDULL
+
+static inline unsigned long long string_hash_mix(unsigned long long h,
+						 unsigned long long word) {
+  h ^= word;
+  h *= STRING_HASH_MUL;
+  return h ^ (h >> 32);
+}
+
+unsigned long string_hash(const char *key) {
+  const unsigned char  *str = (const unsigned char *)key;
+  unsigned long long      h = STRING_HASH_SEED;
+  unsigned long long   word = 0;
+  int                 shift = 0;
+  unsigned long long    len = 0;
+
+  for(; *str; str++, len++) {
+    unsigned long long c = *str;
+    // fold A-Z down to a-z without branching (or a call to tolower)
+    c += ((c - 'A') < 26) << 5;
+    word |= c << shift;
+    if((shift += 8) == 64) {
+      h     = string_hash_mix(h, word);
+      word  = 0;
+      shift = 0;
+    }
+  }
+  h = string_hash_mix(h, word ^ (len << 56));
+
+  // the 64-bit finalizer from MurmurHash3
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return (unsigned long)h;
+}
+
+
+//
+// counts how many times word occurs in string. Assumes strlen(word) >= 1
+//
+int count_occurences(const char *string, const char *word) {
+  int count = 0, i = 0, word_len = strlen(word);
+  for(; string[i] != '\0'; i++) {
+    if(!strncmp(string+i, word, word_len)) {
+      count++;
+      i += word_len;
+    }
+  }
+  return count;
+}
+
+
+//
+// return a pointer to the start of the line num (lines are ended with \n's).
+// return NULL if the line does not exist
+//
+char *line_start(char *string, int line) {
+  // skip forward to the appropriate line
+  int i, count = 1;
+
+  // are we looking for the start?
+  if(line == 1) return string;
+
+  for(i = 0; string[i] != '\0'; i++) {
+    if(string[i] == '\n')
+      count++;
+    if(count == line)
+      return string+i+1;
+  }
+
+  return NULL;
+}
+
+
+//
+// trim trailing and leading whitespace
+//
+void trim(char *string) {
+  int len = strlen(string);
+  int max = len-1;
+  int min = 0;
+  int i;
+
+  // kill all whitespace to the right
+  for(max = len - 1; max >= 0; max--) {
+    if(isspace(string[max]))
+      string[max] = '\0';
+    else
+      break;
+  }
+
+  // find our first non-whitespace
+  while(isspace(string[min]))
+    min++;
+
+  // shift everything to the left
+  for(i = 0; i <= max-min; i++)
+    string[i] = string[i+min];
+  string[i] = '\0';
+}
+
+
+//
+// Return a list of all the strings in this list. String are separated by the
+// delimeter. The list and contents must be deleted after use.
+LIST *parse_strings(const char *string, char delimeter) {
+  // make our list that we will be returning
+  LIST *list = newList();
+
+  // first, we check if the string have any non-spaces
+  int i;
+  bool nonspace_found = FALSE;
+  for(i = 0; string[i] != '\0'; i++) {
+    if(!isspace(string[i])) {
+      nonspace_found = TRUE;
+      break;
+    }
+  }
+
+  // we didn't find any non-spaces. Return NULL
+  if(!nonspace_found)
+    return list;
+
+  // find all of our keywords
+  while(*string != '\0') {
+    i = 0;
+    // find the endpoint
+    while(string[i] != delimeter && string[i] != '\0')
+      i++;
+
+    char buf[i+1];
+    strncpy(buf, string, i); buf[i] = '\0';
+    trim(buf); // skip all whitespaces
+
+    // make sure something still exists. If it does, queue it
+    if(*buf != '\0')
+      listQueue(list, strdup(buf));
+
+    // skip everything we just copied, plus our delimeter
+    string = &string[i+(string[i] != '\0' ? 1 : 0)];
+  }
+
+  // return whatever we found
+  return list;
+}
+
+
+//
+// return a list of all the unique keywords found in the keywords string
+// keywords can be more than one word long (e.g. blue flame) and each
+// keyword must be separated by a comma
+LIST *parse_keywords(const char *keywords) {
+  return parse_strings(keywords, ',');
+}
@@ -18,6 +18,13 @@
 #define MUD_HOUR       * 5 MINUTES
 #define MUD_HOURS      * 5 MINUTES
 
+// the parts of the day
+#define TIME_MORNING          0
+#define TIME_AFTERNOON        1
+#define TIME_EVENING          2
+#define TIME_NIGHT            3
+#define NUM_TIMES_OF_DAY      4
+
 
 
 //
@@ -51,8 +58,14 @@ int get_year();
 
 
 //
-// What period of the day are we in?
+// What period of the day are we in? This is worked out once, when the hour
+// changes, so asking is cheap. When the hour changes, the hour_change hook is
+// run with the new hour and the name of the period ("int str"). When the day
+// changes, day_change is run with the day of the month, month, and year
+// ("int int int"), all counting from 0
 //
+int         get_time_of_day();
+const char *get_time_of_day_name();
 bool is_morning();
 bool is_afternoon();
 bool is_evening();
@@ -103,6 +103,15 @@ int curr_day_of_week  = 0; // what day of the week is it?
 int curr_day_of_month = 0; // what day is it in the month?
 int curr_month        = 0; // what month is it in the year?
 int curr_year         = 0; // what year is it?
+int curr_time_of_day  = TIME_NIGHT; // what part of the day is it?
+
+const char *time_of_day_names[NUM_TIMES_OF_DAY] = {
+  "morning", "afternoon", "evening", "night"
+};
+
+// the hooks we run when the hour and day change
+int hour_change_hook  = -1;
+int day_change_hook   = -1;
 
 
 
@@ -114,14 +123,7 @@ PyObject *PyMud_GetHour(PyObject *self) {
 }
 
 PyObject *PyMud_GetTime(PyObject *self) {
-  if(is_morning())
-    return Py_BuildValue("s", "morning");
-  else if(is_afternoon())
-    return Py_BuildValue("s", "afternoon");
-  else if(is_evening())
-    return Py_BuildValue("s", "evening");
-  else
-    return Py_BuildValue("s", "night");
+  return Py_BuildValue("s", get_time_of_day_name());
 }
 
 PyObject *PyMud_IsMorning(PyObject *self) {
@@ -146,10 +148,26 @@ PyObject *PyMud_IsNight(PyObject *self) {
 // time handling functions
 //*****************************************************************************
 
+//
+// work out what part of the day the current hour falls in. Only needs to be
+// done when the hour changes
+int calc_time_of_day(void) {
+  const struct month_data *month = &month_info[curr_month];
+  if(curr_hour >= month->night_starts || curr_hour < month->morning_starts)
+    return TIME_NIGHT;
+  else if(curr_hour >= month->evening_starts)
+    return TIME_EVENING;
+  else if(curr_hour >= month->afternoon_starts)
+    return TIME_AFTERNOON;
+  else
+    return TIME_MORNING;
+}
+
 //
 // Handle the hourly update of our times
 //
 void handle_time_update(void *self, void *data, char *arg) {
+  bool new_day = FALSE;
   curr_hour++;
 /*  log_string("Time update: hour=%d, day_week=%d, day_month=%d, month=%d, year=%d",
              curr_hour, curr_day_of_week, curr_day_of_month, curr_month, curr_year); */
@@ -158,6 +176,7 @@ void handle_time_update(void *self, void *data, char *arg) {
     curr_hour = 0;
     curr_day_of_week++;
     curr_day_of_month++;
+    new_day = TRUE;
   }
 
   if(curr_day_of_week >= DAYS_PER_WEEK)
@@ -172,6 +191,8 @@ void handle_time_update(void *self, void *data, char *arg) {
       curr_year++;
     }
 
+  curr_time_of_day = calc_time_of_day();
+
   // check to see if we've rolled over to a new time of day
   if(curr_hour == month_info[curr_month].morning_starts)
     send_outdoors("The morning sun slowly pokes its head up over the eastern horizon.\r\n");
@@ -191,6 +212,12 @@ void handle_time_update(void *self, void *data, char *arg) {
   store_int(set, "year",         curr_year);
   storage_write(set, TIME_FILE);
   storage_close(set);
+
+  // let anything that cares know, so it doesn't have to keep checking
+  hookRunArgsId(hour_change_hook, "int str", curr_hour, get_time_of_day_name());
+  if(new_day)
+    hookRunArgsId(day_change_hook, "int int int",
+		  curr_day_of_month, curr_month, curr_year);
 }
 
 
@@ -212,6 +239,10 @@ void init_time() {
     curr_hour = curr_day_of_week = curr_day_of_month = curr_month = curr_year = 0;
     log_string("TIME: No save file, starting at 0");
   }
+  curr_time_of_day = calc_time_of_day();
+  hour_change_hook = hookRegister("hour_change");
+  day_change_hook  = hookRegister("day_change");
+
   // add our mud methods
   PyMud_addMethod("get_hour",     PyMud_GetHour,     METH_NOARGS, 
 		  "get_hour()\n\n"
@@ -219,6 +250,13 @@ void init_time() {
   PyMud_addMethod("get_time",     PyMud_GetTime,     METH_NOARGS, 
 		  "get_time()\n\n"
 		  "Return time of day (morning, afternoon, evening, night).");
+  PyMud_addMethod("get_time_of_day", PyMud_GetTime,  METH_NOARGS,
+		  "get_time_of_day()\n\n"
+		  "The same as get_time(). The time of day is worked out once an\n"
+		  "hour, rather than each time it is asked for. To hear when it\n"
+		  "changes, listen to the hour_change hook, which is run with\n"
+		  "the new hour and time of day; day_change is run with the day\n"
+		  "of the month, month, and year, when the day changes.");
   PyMud_addMethod("is_morning",   PyMud_IsMorning,   METH_NOARGS, 
 		  "True or False if it is morning.");
   PyMud_addMethod("is_afternoon", PyMud_IsAfternoon, METH_NOARGS, 
@@ -258,27 +296,33 @@ int get_hour() {
 }
 
 
+int get_time_of_day() {
+  return curr_time_of_day;
+}
+
+
+const char *get_time_of_day_name() {
+  return time_of_day_names[curr_time_of_day];
+}
+
+
 bool is_morning() {
-  return (curr_hour >= month_info[curr_month].morning_starts &&
-	  curr_hour <  month_info[curr_month].afternoon_starts);
+  return (curr_time_of_day == TIME_MORNING);
 }
 
 
 bool is_afternoon() {
-  return (curr_hour >= month_info[curr_month].afternoon_starts &&
-	  curr_hour <  month_info[curr_month].evening_starts);
+  return (curr_time_of_day == TIME_AFTERNOON);
 }
 
 
 bool is_evening() {
-  return (curr_hour >= month_info[curr_month].evening_starts &&
-	  curr_hour <  month_info[curr_month].night_starts);
+  return (curr_time_of_day == TIME_EVENING);
 }
 
 
 bool is_night() {
-  return (curr_hour >= month_info[curr_month].night_starts ||
-	  curr_hour <  month_info[curr_month].morning_starts);
+  return (curr_time_of_day == TIME_NIGHT);
 }
 
 
@@ -306,9 +350,7 @@ COMMAND(cmd_time) {
 	       "which is the %d%s day of %s, year %d.\r\n",
 	       (USE_AMPM ? ampm_hour() : curr_hour+1),
 	       (USE_AMPM ? (is_am() ? " a.m" : " p.m") : ""),
-	       (is_morning() ? "morning" :
-		(is_afternoon() ? "afternoon" :
-		 (is_evening() ? "evening" : "night"))),
+	       get_time_of_day_name(),
 	       day_info[curr_day_of_week].name,
 	       curr_day_of_month+1, numth(curr_day_of_month+1),
 	       month_info[curr_month].name, curr_year);
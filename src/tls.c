@@ -0,0 +1,313 @@
+//*****************************************************************************
+//
+// tls.c
+//
+// TLS for the ports in tls_ports, through OpenSSL. See tls.h. Every
+// connection's SSL is given its socket directly, and run non-blocking; we
+// never let OpenSSL wait on anything.
+//
+//*****************************************************************************
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/rand.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "tls.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the most we encrypt at once when sending. One full record
+#define TLS_WRITE_MAX       16384
+
+// how long the keys in each session ticket are. The name of the key it was
+// made with, its HMAC key, and its AES key
+#define TLS_TICKET_KEY_LEN     80
+
+struct tls_conn {
+  SSL           *ssl;
+  int             fd;
+  bool   handshaking;
+  bool    want_write; // is the handshake waiting to write?
+  bool     kernel_tx; // is the kernel doing our encryption?
+  bool     kernel_rx; //    and our decryption?
+};
+
+// made once, and shared by all of our connections
+SSL_CTX *tls_ctx = NULL;
+
+// a writev's data, put together so it can go out in one record
+char tls_write_buf[TLS_WRITE_MAX];
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// log why OpenSSL last failed, after what we were doing
+void tls_log_error(const char *doing) {
+  char buf[256];
+  unsigned long err = ERR_get_error();
+  if(err == 0)
+    log_string("TLS: %s failed.", doing);
+  else {
+    ERR_error_string_n(err, buf, sizeof(buf));
+    log_string("TLS: %s failed (%s).", doing, buf);
+  }
+  ERR_clear_error();
+}
+
+//
+// read our session ticket keys from tls_ticket_file, or make new ones and
+// write them there if it doesn't have any. Tickets made before we rebooted
+// can only be used if we get back the same keys
+bool tls_load_ticket_keys(unsigned char *keys) {
+  const char *path = mudsettingGetString("tls_ticket_file");
+  int           fd = open(path, O_RDONLY);
+
+  if(fd >= 0) {
+    int got = read(fd, keys, TLS_TICKET_KEY_LEN);
+    close(fd);
+    if(got == TLS_TICKET_KEY_LEN)
+      return TRUE;
+    log_string("TLS: %s is not a ticket key file. Making new keys.", path);
+  }
+
+  if(RAND_bytes(keys, TLS_TICKET_KEY_LEN) != 1) {
+    tls_log_error("making session ticket keys");
+    return FALSE;
+  }
+  // anyone who can read these can decrypt our clients' sessions
+  if((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) < 0 ||
+     write(fd, keys, TLS_TICKET_KEY_LEN) != TLS_TICKET_KEY_LEN) {
+    log_string("TLS: could not write %s (%s). Session tickets will not "
+	       "outlast a reboot.", path, strerror(errno));
+  }
+  if(fd >= 0)
+    close(fd);
+  return TRUE;
+}
+
+//
+// after a handshake, see if it's the kernel that's doing our encryption
+void tls_check_kernel(TLS_CONN *conn) {
+  conn->kernel_tx = (BIO_get_ktls_send(SSL_get_wbio(conn->ssl)) == 1);
+  conn->kernel_rx = (BIO_get_ktls_recv(SSL_get_rbio(conn->ssl)) == 1);
+}
+
+//
+// turn what went wrong with SSL_read or SSL_write into what read and write
+// would have done. Returns 0 if the client closed the connection cleanly,
+// or -1 with errno set
+ssize_t tls_io_error(TLS_CONN *conn, int ret) {
+  switch(SSL_get_error(conn->ssl, ret)) {
+  case SSL_ERROR_WANT_READ:
+  case SSL_ERROR_WANT_WRITE:
+    errno = EAGAIN;
+    return -1;
+  case SSL_ERROR_ZERO_RETURN:
+    return 0;
+  case SSL_ERROR_SYSCALL:
+    // the client went away without telling us first
+    if(errno == 0)
+      errno = ECONNRESET;
+    ERR_clear_error();
+    return -1;
+  default:
+    tls_log_error("socket I/O");
+    errno = EIO;
+    return -1;
+  }
+}
+
+
+
+//*****************************************************************************
+// implementation of tls.h
+//*****************************************************************************
+bool init_tls(void) {
+  unsigned char keys[TLS_TICKET_KEY_LEN];
+  const char    *cert = mudsettingGetString("tls_cert_file");
+  const char     *key = mudsettingGetString("tls_key_file");
+
+  if(!*mudsettingGetString("tls_ports") && !*mudsettingGetString("wss_ports"))
+    return TRUE;
+
+  if((tls_ctx = SSL_CTX_new(TLS_server_method())) == NULL) {
+    tls_log_error("setting up");
+    return FALSE;
+  }
+  SSL_CTX_set_min_proto_version(tls_ctx, TLS1_2_VERSION);
+
+  // renegotiation buys a telnet client nothing, and costs us a handshake
+  // whenever they like. We write from wherever our output queue is, and
+  // sometimes write less than we were given
+  SSL_CTX_set_options(tls_ctx, SSL_OP_NO_RENEGOTIATION |
+		      SSL_OP_CIPHER_SERVER_PREFERENCE);
+  SSL_CTX_set_mode(tls_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+		   SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+		   SSL_MODE_RELEASE_BUFFERS);
+#ifdef SSL_OP_ENABLE_KTLS
+  if(mudsettingGetBool("tls_ktls"))
+    SSL_CTX_set_options(tls_ctx, SSL_OP_ENABLE_KTLS);
+#else
+  if(mudsettingGetBool("tls_ktls"))
+    log_string("TLS: tls_ktls is set, but this OpenSSL has no kernel TLS.");
+#endif
+
+  if(SSL_CTX_use_certificate_chain_file(tls_ctx, cert) != 1 ||
+     SSL_CTX_use_PrivateKey_file(tls_ctx, key, SSL_FILETYPE_PEM) != 1 ||
+     SSL_CTX_check_private_key(tls_ctx) != 1) {
+    tls_log_error("loading our certificate and key");
+    SSL_CTX_free(tls_ctx);
+    tls_ctx = NULL;
+    return FALSE;
+  }
+
+  // sessions are resumed from tickets the client holds. We keep no cache of
+  // our own, since it wouldn't outlast a reboot anyhow
+  SSL_CTX_set_session_cache_mode(tls_ctx, SSL_SESS_CACHE_OFF);
+  SSL_CTX_set_session_id_context(tls_ctx, (const unsigned char *) "NakedMud",
+				 8);
+  if(tls_load_ticket_keys(keys) &&
+     SSL_CTX_set_tlsext_ticket_keys(tls_ctx, keys, sizeof(keys)) != 1)
+    tls_log_error("setting session ticket keys");
+  memset(keys, 0, sizeof(keys));
+  return TRUE;
+}
+
+bool tlsEnabled(void) {
+  return (tls_ctx != NULL);
+}
+
+TLS_CONN *newTlsConn(int fd) {
+  TLS_CONN *conn = NULL;
+  SSL       *ssl = NULL;
+  if(tls_ctx == NULL || (ssl = SSL_new(tls_ctx)) == NULL)
+    return NULL;
+  if(SSL_set_fd(ssl, fd) != 1) {
+    tls_log_error("starting a connection");
+    SSL_free(ssl);
+    return NULL;
+  }
+  SSL_set_accept_state(ssl);
+  conn              = calloc(1, sizeof(TLS_CONN));
+  conn->ssl         = ssl;
+  conn->fd          = fd;
+  conn->handshaking = TRUE;
+  return conn;
+}
+
+void deleteTlsConn(TLS_CONN *conn) {
+  // a close_notify, if there's room for it. Don't wait to hear one back
+  if(!conn->handshaking)
+    SSL_shutdown(conn->ssl);
+  ERR_clear_error();
+  SSL_free(conn->ssl);
+  free(conn);
+}
+
+int tlsHandshake(TLS_CONN *conn) {
+  if(!conn->handshaking)
+    return TLS_HANDSHAKE_DONE;
+
+  int ret = SSL_do_handshake(conn->ssl);
+  if(ret == 1) {
+    conn->handshaking = FALSE;
+    conn->want_write  = FALSE;
+    tls_check_kernel(conn);
+    return TLS_HANDSHAKE_DONE;
+  }
+
+  switch(SSL_get_error(conn->ssl, ret)) {
+  case SSL_ERROR_WANT_READ:
+    conn->want_write = FALSE;
+    return TLS_HANDSHAKE_WANT;
+  case SSL_ERROR_WANT_WRITE:
+    conn->want_write = TRUE;
+    return TLS_HANDSHAKE_WANT;
+  default:
+    // port scanners and plaintext clients on the wrong port. Not worth a log
+    ERR_clear_error();
+    return TLS_HANDSHAKE_ERROR;
+  }
+}
+
+bool tlsHandshaking(TLS_CONN *conn) {
+  return conn->handshaking;
+}
+
+bool tlsWantsWrite(TLS_CONN *conn) {
+  return (conn->handshaking && conn->want_write);
+}
+
+ssize_t tlsReadv(TLS_CONN *conn, const struct iovec *iov, int iovcnt) {
+  ssize_t total = 0;
+  int         i = 0;
+  for(i = 0; i < iovcnt; i++) {
+    size_t got = 0;
+    int    ret = SSL_read_ex(conn->ssl, iov[i].iov_base, iov[i].iov_len, &got);
+    if(ret != 1) {
+      if(total > 0)
+	break;
+      return tls_io_error(conn, ret);
+    }
+    total += got;
+    if(got < iov[i].iov_len)
+      break;
+  }
+  return total;
+}
+
+ssize_t tlsWritev(TLS_CONN *conn, const struct iovec *iov, int iovcnt) {
+  size_t len = 0, wrote = 0;
+  int      i = 0;
+
+  // the kernel frames our records itself, so it can take iov as it is
+  if(conn->kernel_tx)
+    return writev(conn->fd, iov, iovcnt);
+
+  // one record is cheaper than one per segment
+  if(iovcnt == 1)
+    len = UMIN(iov[0].iov_len, TLS_WRITE_MAX);
+  else {
+    for(i = 0; i < iovcnt && len < TLS_WRITE_MAX; i++) {
+      size_t seg = UMIN(iov[i].iov_len, TLS_WRITE_MAX - len);
+      memcpy(tls_write_buf + len, iov[i].iov_base, seg);
+      len += seg;
+    }
+  }
+  if(len == 0)
+    return 0;
+
+  int ret = SSL_write_ex(conn->ssl, (iovcnt == 1 ? iov[0].iov_base :
+				     tls_write_buf), len, &wrote);
+  if(ret != 1)
+    return tls_io_error(conn, ret);
+  return wrote;
+}
+
+bool tlsPending(TLS_CONN *conn) {
+  return (!conn->handshaking && SSL_pending(conn->ssl) > 0);
+}
+
+bool tlsResumed(TLS_CONN *conn) {
+  return SSL_session_reused(conn->ssl);
+}
+
+bool tlsKernelSend(TLS_CONN *conn) {
+  return conn->kernel_tx;
+}
+
+bool tlsKernelRecv(TLS_CONN *conn) {
+  return conn->kernel_rx;
+}
@@ -0,0 +1,80 @@
+#ifndef __TLS_H
+#define __TLS_H
+//*****************************************************************************
+//
+// tls.h
+//
+// TLS for the ports in tls_ports (e.g. "4443"), so players can connect
+// securely without a proxy in front of us hiding where they come from. The
+// certificate chain and private key are read from tls_cert_file and
+// tls_key_file, both PEM.
+//
+// Handshakes never block: they are driven by the same poller events as the
+// rest of a socket's I/O, and the socket's output waits until theirs is done.
+// Clients that have connected before can resume their session from a ticket
+// instead of doing a full handshake. The keys tickets are made with are kept
+// in tls_ticket_file, so the tickets a client holds are still good after we
+// reboot and everyone reconnects at once. Where the kernel supports it, and
+// tls_ktls is set, encryption is handed to the kernel once the handshake is
+// done, and sending becomes an ordinary writev.
+//
+//*****************************************************************************
+
+#include <sys/uio.h>
+
+typedef struct tls_conn TLS_CONN;
+
+// what tlsHandshake can return
+#define TLS_HANDSHAKE_ERROR   -1
+#define TLS_HANDSHAKE_DONE     0
+#define TLS_HANDSHAKE_WANT     1 // call again on the next poller event
+
+//
+// set up TLS, if there are any tls_ports or wss_ports. Returns FALSE if there
+// are, but we can't use them (e.g. we have no certificate)
+bool init_tls(void);
+
+//
+// are we able to accept TLS connections?
+bool tlsEnabled(void);
+
+//
+// start the server side of a TLS connection on fd. NULL if we can't
+TLS_CONN *newTlsConn(int fd);
+
+//
+// tell the client we are done, if we can do so without waiting, and free the
+// connection. Must be called before fd is closed
+void deleteTlsConn(TLS_CONN *conn);
+
+//
+// carry the handshake on as far as it will go without blocking
+int tlsHandshake(TLS_CONN *conn);
+
+//
+// is the handshake still going? If so, is it waiting to write (rather than
+// to read)?
+bool tlsHandshaking(TLS_CONN *conn);
+bool tlsWantsWrite(TLS_CONN *conn);
+
+//
+// like readv and writev, but through the connection. A return of -1 with
+// errno set to EAGAIN means try again on the next poller event. After a
+// writev that couldn't finish, the next must start with the same bytes, and
+// have at least as many of them
+ssize_t tlsReadv (TLS_CONN *conn, const struct iovec *iov, int iovcnt);
+ssize_t tlsWritev(TLS_CONN *conn, const struct iovec *iov, int iovcnt);
+
+//
+// has more been read off the socket than we have handed back yet? The poller
+// won't tell us about it, so it has to be read without waiting for an event
+bool tlsPending(TLS_CONN *conn);
+
+//
+// did the client resume an old session? Is the kernel doing our encryption,
+// our decryption?
+bool tlsResumed(TLS_CONN *conn);
+bool tlsKernelSend(TLS_CONN *conn);
+bool tlsKernelRecv(TLS_CONN *conn);
+
+#endif // __TLS_H
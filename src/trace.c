@@ -0,0 +1,228 @@
+//*****************************************************************************
+//
+// trace.c
+//
+// a ring of spans the game thread has finished, saved as Chrome trace
+// events. See trace.h for how it is used. Spans are only put in the ring
+// when they end, as complete ("X") events with their start and duration, so
+// a ring that has wrapped around never holds half of a span.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "character.h"
+#include "pulse.h"
+#include "trace.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// how long a name we keep for a span
+#define TRACE_NAME_LEN        48
+
+// how deep spans can nest. Anything deeper is not noted
+#define TRACE_MAX_DEPTH       32
+
+// the fewest seconds between two traces saved because of spikes
+#define TRACE_SPIKE_INTERVAL  60
+
+typedef struct {
+  long long       start; // when the span started, in microseconds
+  long long         dur; // how long it lasted
+  const char       *cat; // what sort of thing it was
+  char name[TRACE_NAME_LEN];
+} TRACE_SPAN;
+
+// the spans that have ended, oldest first from ring_next once it has wrapped
+TRACE_SPAN  *trace_ring = NULL;
+int     trace_ring_size = 0;
+int          trace_next = 0;
+bool       trace_wrapped = FALSE;
+bool            trace_on = FALSE;
+
+// the spans that have begun and not ended yet
+const char *trace_cats [TRACE_MAX_DEPTH];
+const char *trace_names[TRACE_MAX_DEPTH];
+long long   trace_starts[TRACE_MAX_DEPTH];
+int         trace_depth = 0;
+
+// only the game thread is traced
+pthread_t  trace_thread;
+
+// when we last saved because of a spike
+time_t trace_last_spike = 0;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// write a string out as a JSON string
+void trace_write_string(FILE *fl, const char *str) {
+  fputc('"', fl);
+  for(; *str; str++) {
+    if(*str == '"' || *str == '\\')
+      fprintf(fl, "\\%c", *str);
+    else if((unsigned char)*str < ' ')
+      fprintf(fl, "\\u%04x", (unsigned char)*str);
+    else
+      fputc(*str, fl);
+  }
+  fputc('"', fl);
+}
+
+//
+// save the ring somewhere with the time in its name. Pulses that spike keep
+// their own trace, instead of writing over the last one
+void trace_save_spike(long long usecs) {
+  char fname[SMALL_BUFFER];
+  snprintf(fname, sizeof(fname), "../log/trace-%ld.json", (long)current_time);
+  int written = traceSave(fname);
+  if(written >= 0)
+    log_string("A pulse took %lld msec. Traced %d spans to %s.",
+	       usecs / 1000, written, fname);
+}
+
+//
+// turn tracing on or off, save the ring, or change the spike threshold
+//   usage: pulsetrace [on [events] | off | save [file] | spike <msecs>]
+COMMAND(cmd_pulsetrace) {
+  char    sub[SMALL_BUFFER];
+  char   *rest = one_arg(arg, sub);
+  if(!strcasecmp(sub, "on")) {
+    traceStart(isdigit(*rest) ? atoi(rest) : mudsettingGetInt("trace_events"));
+    send_to_char(ch, "Tracing the last %d spans.\r\n", trace_ring_size);
+  }
+  else if(!strcasecmp(sub, "off")) {
+    traceStop();
+    send_to_char(ch, "Tracing stopped. What was traced can still be "
+		 "saved.\r\n");
+  }
+  else if(!strcasecmp(sub, "save")) {
+    const char *fname = (*rest ? rest : TRACE_FILE);
+    int       written = traceSave(fname);
+    if(written < 0)
+      send_to_char(ch, "Could not open %s.\r\n", fname);
+    else
+      send_to_char(ch, "Wrote %d spans to %s.\r\n", written, fname);
+  }
+  else if(!strcasecmp(sub, "spike") && isdigit(*rest)) {
+    mudsettingSetInt("trace_spike_msecs", atoi(rest));
+    send_to_char(ch, "Pulses over %d msec will be saved while tracing.\r\n",
+		 atoi(rest));
+  }
+  else if(*sub)
+    send_to_char(ch, "Usage: pulsetrace [on [events] | off | save [file] | "
+		 "spike <msecs>]\r\n");
+  else
+    send_to_char(ch, "Tracing is %s, and holds %d of the last %d spans. "
+		 "Pulses over %d msec are saved while tracing.\r\n",
+		 (trace_on ? "on" : "off"),
+		 (trace_wrapped ? trace_ring_size : trace_next), trace_ring_size,
+		 mudsettingGetInt("trace_spike_msecs"));
+}
+
+
+
+//*****************************************************************************
+// implementation of trace.h
+//*****************************************************************************
+void init_trace(void) {
+  trace_thread = pthread_self();
+  add_cmd("pulsetrace", NULL, cmd_pulsetrace, "admin", FALSE);
+}
+
+void traceStart(int events) {
+  events = MAX(1, events);
+  if(events != trace_ring_size) {
+    if(trace_ring != NULL)
+      free(trace_ring);
+    trace_ring      = malloc(sizeof(TRACE_SPAN) * events);
+    trace_ring_size = events;
+  }
+  trace_next    = 0;
+  trace_wrapped = FALSE;
+  trace_depth   = 0;
+  trace_on      = TRUE;
+}
+
+void traceStop(void) {
+  trace_on = FALSE;
+}
+
+bool traceIsOn(void) {
+  return trace_on;
+}
+
+void traceBegin(const char *cat, const char *name) {
+  if(!trace_on || !pthread_equal(pthread_self(), trace_thread))
+    return;
+  if(trace_depth < TRACE_MAX_DEPTH) {
+    trace_cats  [trace_depth] = cat;
+    trace_names [trace_depth] = name;
+    trace_starts[trace_depth] = pulse_clock();
+  }
+  trace_depth++;
+}
+
+void traceEnd(void) {
+  if(!trace_on || trace_depth == 0 ||
+     !pthread_equal(pthread_self(), trace_thread))
+    return;
+  trace_depth--;
+  if(trace_depth >= TRACE_MAX_DEPTH)
+    return;
+
+  TRACE_SPAN *span = &trace_ring[trace_next];
+  span->start = trace_starts[trace_depth];
+  span->dur   = pulse_clock() - span->start;
+  span->cat   = trace_cats[trace_depth];
+  snprintf(span->name, TRACE_NAME_LEN, "%s",
+	   (trace_names[trace_depth] ? trace_names[trace_depth] : ""));
+  if(++trace_next == trace_ring_size) {
+    trace_next    = 0;
+    trace_wrapped = TRUE;
+  }
+}
+
+void tracePulseDone(long long usecs) {
+  int spike = mudsettingGetInt("trace_spike_msecs");
+  if(trace_on && spike > 0 && usecs >= spike * 1000LL &&
+     current_time - trace_last_spike >= TRACE_SPIKE_INTERVAL) {
+    trace_last_spike = current_time;
+    trace_save_spike(usecs);
+  }
+}
+
+int traceSave(const char *fname) {
+  FILE *fl = fopen(fname, "w");
+  if(fl == NULL)
+    return -1;
+
+  int count = (trace_wrapped ? trace_ring_size : trace_next);
+  int first = (trace_wrapped ? trace_next : 0);
+  int i;
+  fprintf(fl, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+	  "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+	  "\"args\":{\"name\":\"game\"}}");
+  for(i = 0; i < count; i++) {
+    TRACE_SPAN *span = &trace_ring[(first + i) % trace_ring_size];
+    fprintf(fl, ",\n{\"name\":");
+    trace_write_string(fl, span->name);
+    fprintf(fl, ",\"cat\":");
+    trace_write_string(fl, span->cat);
+    fprintf(fl, ",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":1}",
+	    span->start, span->dur);
+  }
+  fprintf(fl, "\n]}\n");
+  fclose(fl);
+  return count;
+}
@@ -0,0 +1,54 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+//*****************************************************************************
+//
+// trace.h
+//
+// a timeline of what the game thread did, for finding out why one pulse out
+// of thousands took 400ms when the averages in pulsestats look fine. While
+// tracing is on, every phase of every pulse, every command, hook, trigger,
+// and zone reset is noted as a span with a start and a duration, in a ring
+// that holds the last trace_events of them. The ring can be saved at any
+// time with the pulsetrace admin command, and is saved by itself whenever a
+// pulse takes longer than trace_spike_msecs (at most once a minute). Traces
+// are saved in the Chrome trace-event format, which chrome://tracing and
+// Perfetto open.
+//
+// Anything that notes what it is doing for the sampler (see samplerEnter) is
+// traced too; the rest can use traceBegin and traceEnd. Both cost one check
+// when tracing is off.
+//
+//*****************************************************************************
+
+// where traces are saved, if not told otherwise
+#define TRACE_FILE            "../log/trace.json"
+
+//
+// set up tracing, and the pulsetrace command
+void init_trace(void);
+
+//
+// start noting spans, into a ring that holds the given number of them, or
+// stop. Starting forgets everything noted before
+void traceStart(int events);
+void traceStop(void);
+bool traceIsOn(void);
+
+//
+// note that the game thread has started something of the given category
+// (like "cmd" or "hook"), or has finished the last thing it started. cat
+// must be a string that lasts forever; name only has to last until traceEnd
+void traceBegin(const char *cat, const char *name);
+void traceEnd(void);
+
+//
+// a pulse is over, and took this many microseconds. If it went past the
+// spike threshold, the ring is saved
+void tracePulseDone(long long usecs);
+
+//
+// save the ring to a file in the Chrome trace-event format. Returns how many
+// spans were saved, or -1 if the file couldn't be opened
+int traceSave(const char *fname);
+
+#endif // __TRACE_H
@@ -0,0 +1,392 @@
+//*****************************************************************************
+//
+// upgrade.c
+//
+// handing our listeners and sockets over to a new process. See upgrade.h.
+// The two processes talk over a SOCK_SEQPACKET socketpair, which the new
+// process gets as UPGRADE_FD, in messages that each start with what kind of
+// message they are:
+//
+//   new -> old   R          booted, and ready for the handover
+//   old -> new   L <list>   the listeners, as listenersGetFds writes them,
+//                           but numbered by where their fd is in what we send
+//   old -> new   D <data>   some of the copyover file for the sockets
+//   old -> new   F          descriptors, sent with SCM_RIGHTS
+//   old -> new   E          that's everything
+//   new -> old   K          got it all; the sockets are ours now
+//
+// Until the old process hears K, the sockets are still its own, and it hasn't
+// read or written them since it sent them, so it can carry on with them.
+//
+//*****************************************************************************
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "socket.h"
+#include "listener.h"
+#include "poller.h"
+#include "log_queue.h"
+#include "upgrade.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// where the new process finds its end of the socketpair
+#define UPGRADE_FD                3
+
+// the most descriptors we hand over, and how many go in one message
+#define UPGRADE_MAX_FDS       16384
+#define UPGRADE_FDS_PER_MSG     200
+
+// the most a message holds, and how long either side waits for the other
+// once the handover has started
+#define UPGRADE_MSG_MAX       32768
+#define UPGRADE_TAKEOVER_TIMEOUT 10 // seconds
+
+#define UPGRADE_READY           'R'
+#define UPGRADE_LISTENERS       'L'
+#define UPGRADE_DATA            'D'
+#define UPGRADE_FDS             'F'
+#define UPGRADE_END             'E'
+#define UPGRADE_OK              'K'
+
+// the old process's side: the new process, and our end of the socketpair
+pid_t  upgrade_pid = 0;
+int     upgrade_fd = -1;
+time_t upgrade_started = 0;
+
+// the new process's side: what the old process handed us
+int   *taken_fds = NULL;
+int    num_taken = 0;
+char *taken_data = NULL;
+size_t taken_len = 0;
+char taken_listeners[SMALL_BUFFER] = "";
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// send one message, with fds attached if there are any
+bool upgrade_send(char type, const char *data, size_t len,
+		  const int *fds, int num_fds) {
+  char   cbuf[CMSG_SPACE(sizeof(int) * UPGRADE_FDS_PER_MSG)];
+  struct iovec  iov[2] = { { &type, 1 }, { (void *) data, len } };
+  struct msghdr   msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = (len > 0 ? 2 : 1);
+  if(num_fds > 0) {
+    struct cmsghdr *cmsg = NULL;
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_control    = cbuf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+    cmsg               = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level   = SOL_SOCKET;
+    cmsg->cmsg_type    = SCM_RIGHTS;
+    cmsg->cmsg_len     = CMSG_LEN(sizeof(int) * num_fds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+  }
+  return (sendmsg(upgrade_fd, &msg, MSG_NOSIGNAL) == (ssize_t) (len + 1));
+}
+
+//
+// receive one message into buf, and the fds attached to it into taken_fds.
+// Returns how long the message is, or -1 if there's no message
+ssize_t upgrade_recv(char *buf, size_t len) {
+  char   cbuf[CMSG_SPACE(sizeof(int) * UPGRADE_FDS_PER_MSG)];
+  struct iovec    iov = { buf, len };
+  struct msghdr   msg;
+  struct cmsghdr *cmsg = NULL;
+  ssize_t         got = 0;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = cbuf;
+  msg.msg_controllen = sizeof(cbuf);
+  if((got = recvmsg(upgrade_fd, &msg, 0)) <= 0)
+    return -1;
+
+  for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+    int num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    taken_fds = realloc(taken_fds, sizeof(int) * (num_taken + num));
+    memcpy(taken_fds + num_taken, CMSG_DATA(cmsg), sizeof(int) * num);
+    num_taken += num;
+  }
+  return got;
+}
+
+//
+// write a list of listeners with each one's fd replaced: by where it is in
+// the list if map is NULL, or by map[where] if it is not
+void upgrade_renumber(const char *list, const int *map, int map_len,
+		      char *buf, size_t len) {
+  size_t at = 0;
+  int   num = 0;
+  *buf = '\0';
+  while(*list && at < len) {
+    int fd = atoi(list);
+    if(map != NULL)
+      fd = (fd >= 0 && fd < map_len ? map[fd] : -1);
+    else
+      fd = num;
+    while(isdigit(*list))
+      list++;
+    at += snprintf(buf + at, len - at, "%s%d", (num > 0 ? "," : ""), fd);
+    for(; *list && *list != ',' && at < len; list++)
+      buf[at++] = *list;
+    buf[UMIN(at, len - 1)] = '\0';
+    if(*list == ',')
+      list++;
+    num++;
+  }
+}
+
+//
+// give up on the new process
+void upgrade_cancel(void) {
+  if(upgrade_pid > 0) {
+    kill(upgrade_pid, SIGKILL);
+    waitpid(upgrade_pid, NULL, 0);
+  }
+  if(upgrade_fd >= 0)
+    close(upgrade_fd);
+  upgrade_pid = 0;
+  upgrade_fd  = -1;
+}
+
+//
+// the new process is ready. Hand everything over to it and exit, or if it
+// doesn't take it, get it all back
+void upgrade_handoff(void) {
+  static int fds[UPGRADE_MAX_FDS];
+  struct pollfd pfd = { upgrade_fd, POLLIN, 0 };
+  char list[SMALL_BUFFER];
+  char *data = NULL;
+  size_t len = 0, sent = 0;
+  int i, num_fds = 0;
+  bool ok = TRUE;
+  char reply = 0;
+
+  // our listeners go first, so they are numbered the way the list says
+  for(i = 0; i < listenerCount(); i++) {
+    fds[num_fds++] = listenerGetFd(i);
+    pollerRemove(listenerGetFd(i));
+  }
+  upgrade_renumber(listenersGetFds(), NULL, 0, list, sizeof(list));
+
+  FILE *fp = open_memstream(&data, &len);
+  num_fds  = socketsHandoff(fp, fds, num_fds, UPGRADE_MAX_FDS);
+  fclose(fp);
+
+  ok = upgrade_send(UPGRADE_LISTENERS, list, strlen(list), NULL, 0);
+  for(sent = 0; ok && sent < len; sent += UPGRADE_MSG_MAX)
+    ok = upgrade_send(UPGRADE_DATA, data + sent, UMIN(len - sent,
+						     UPGRADE_MSG_MAX), NULL, 0);
+  for(i = 0; ok && i < num_fds; i += UPGRADE_FDS_PER_MSG)
+    ok = upgrade_send(UPGRADE_FDS, NULL, 0, fds + i,
+		      UMIN(num_fds - i, UPGRADE_FDS_PER_MSG));
+  if(ok)
+    ok = upgrade_send(UPGRADE_END, NULL, 0, NULL, 0);
+  if(ok)
+    ok = (poll(&pfd, 1, UPGRADE_TAKEOVER_TIMEOUT * 1000) == 1 &&
+	  recv(upgrade_fd, &reply, 1, 0) == 1 && reply == UPGRADE_OK);
+
+  // the sockets are the new process's now
+  if(ok) {
+    log_string("Upgrade: process %d has taken over %d listeners and %d "
+	       "sockets.", (int) upgrade_pid, listenerCount(),
+	       num_fds - listenerCount());
+    socketsHandoffDone();
+    logQueueFlush();
+    exit(0);
+  }
+
+  log_string("Upgrade: process %d did not take over. Carrying on.",
+	     (int) upgrade_pid);
+  upgrade_cancel();
+  fp = fmemopen(data, len, "r");
+  socketsHandoffAbort(fp, fds, num_fds);
+  fclose(fp);
+  free(data);
+  for(i = 0; i < listenerCount(); i++)
+    pollerAdd(listenerGetFd(i), NULL, POLLER_READ);
+}
+
+
+
+//*****************************************************************************
+// implementation of upgrade.h
+//*****************************************************************************
+bool upgradeStart(void) {
+  char port_buf[20], fd_buf[20];
+  char *args[8];
+  int pair[2], nargs = 0;
+  pid_t pid;
+
+  if(upgrade_pid > 0)
+    return FALSE;
+  if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair) < 0) {
+    log_string("Upgrade: could not make a socketpair (%s).", strerror(errno));
+    return FALSE;
+  }
+
+  sprintf(port_buf, "%d", mudport);
+  sprintf(fd_buf,   "%d", UPGRADE_FD);
+  args[nargs++] = "NakedMud";
+  args[nargs++] = "-upgrade";
+  args[nargs++] = fd_buf;
+  const char *current_mudlib = get_mudlib_path();
+  if(current_mudlib && strcmp(current_mudlib, "../lib") != 0) {
+    args[nargs++] = "--mudlib-path";
+    args[nargs++] = (char *) current_mudlib;
+  }
+  args[nargs++] = port_buf;
+  args[nargs]   = NULL;
+
+  // what we've written to the log so far, the child shouldn't write again
+  logQueueFlush();
+  if((pid = fork()) < 0) {
+    log_string("Upgrade: could not fork (%s).", strerror(errno));
+    close(pair[0]);
+    close(pair[1]);
+    return FALSE;
+  }
+
+  // the new process gets none of our descriptors but its end of the pair;
+  // it's handed the ones it needs once it's ready for them
+  if(pid == 0) {
+    dup2(pair[1], UPGRADE_FD);
+#ifdef __NR_close_range
+    if(syscall(__NR_close_range, UPGRADE_FD + 1, ~0U, 0) != 0)
+#endif
+    {
+      int fd, max_fd = sysconf(_SC_OPEN_MAX);
+      for(fd = UPGRADE_FD + 1; fd < max_fd; fd++)
+	close(fd);
+    }
+    execv(EXE_FILE, args);
+    _exit(1);
+  }
+
+  struct timeval timeout = { UPGRADE_TAKEOVER_TIMEOUT, 0 };
+  close(pair[1]);
+  fcntl(pair[0], F_SETFD, FD_CLOEXEC);
+  setsockopt(pair[0], SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  upgrade_pid     = pid;
+  upgrade_fd      = pair[0];
+  upgrade_started = time(NULL);
+  log_string("Upgrade: started process %d to take over.", (int) pid);
+  return TRUE;
+}
+
+bool upgradeInProgress(void) {
+  return (upgrade_pid > 0);
+}
+
+void upgradePoll(void) {
+  char   msg = 0;
+  ssize_t got = 0;
+
+  if(upgrade_pid <= 0)
+    return;
+  if(waitpid(upgrade_pid, NULL, WNOHANG) == upgrade_pid) {
+    log_string("Upgrade: process %d exited before it took over.",
+	       (int) upgrade_pid);
+    upgrade_pid = 0;
+    upgrade_cancel();
+  }
+  else if(time(NULL) - upgrade_started >mudsettingGetInt("upgrade_timeout")){
+    log_string("Upgrade: process %d took too long to boot. Killing it.",
+	       (int) upgrade_pid);
+    upgrade_cancel();
+  }
+  else if((got = recv(upgrade_fd, &msg, 1, MSG_DONTWAIT)) == 1 &&
+	  msg == UPGRADE_READY)
+    upgrade_handoff();
+  else if(got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    log_string("Upgrade: lost touch with process %d. Killing it.",
+	       (int) upgrade_pid);
+    upgrade_cancel();
+  }
+}
+
+bool upgradeTakeover(int fd) {
+  struct timeval timeout = { UPGRADE_TAKEOVER_TIMEOUT, 0 };
+  char *buf = malloc(UPGRADE_MSG_MAX + 1);
+  char list[SMALL_BUFFER] = "";
+  ssize_t got = 0;
+  char ready = UPGRADE_READY, ok = UPGRADE_OK;
+
+  // we wait as long as the old process takes to finish its pulse, and no
+  // more than UPGRADE_TAKEOVER_TIMEOUT for each message after that
+  upgrade_fd = fd;
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  log_string("Upgrade: asking the old process for its sockets.");
+  if(send(fd, &ready, 1, MSG_NOSIGNAL) != 1) {
+    free(buf);
+    return FALSE;
+  }
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  while((got = upgrade_recv(buf, UPGRADE_MSG_MAX + 1)) > 0) {
+    if(*buf == UPGRADE_LISTENERS) {
+      snprintf(list, sizeof(list), "%.*s", (int) got - 1, buf + 1);
+    }
+    else if(*buf == UPGRADE_DATA) {
+      taken_data = realloc(taken_data, taken_len + got - 1);
+      memcpy(taken_data + taken_len, buf + 1, got - 1);
+      taken_len += got - 1;
+    }
+    else if(*buf == UPGRADE_END)
+      break;
+  }
+  free(buf);
+  if(got <= 0 || *list == '\0' || taken_len == 0)
+    return FALSE;
+
+  // once the old process hears this, it's gone, and everything is ours
+  if(send(fd, &ok, 1, MSG_NOSIGNAL) != 1)
+    return FALSE;
+  close(fd);
+  upgrade_fd = -1;
+  upgrade_renumber(list, taken_fds, num_taken, taken_listeners,
+		   sizeof(taken_listeners));
+  return TRUE;
+}
+
+const char *upgradeGetListeners(void) {
+  return taken_listeners;
+}
+
+void upgradeRecover(void) {
+  FILE *fp = NULL;
+  log_string("Upgrade: attaching the sockets we took over.");
+  if((fp = fmemopen(taken_data, taken_len, "r")) != NULL) {
+    copyover_recover_fds(fp, taken_fds, num_taken);
+    fclose(fp);
+  }
+  free(taken_data);
+  free(taken_fds);
+  taken_data = NULL;
+  taken_fds  = NULL;
+  taken_len  = num_taken = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef __UPGRADE_H
+#define __UPGRADE_H
+//*****************************************************************************
+//
+// upgrade.h
+//
+// upgrading to a new binary without anyone being disconnected, or anyone
+// being refused while it boots. Where a copyover stops the game while the
+// new binary loads its world, an upgrade starts the new binary alongside us,
+// and we carry on playing until it is ready. Then, in a single pulse, it is
+// handed our listeners and our players' sockets over a unix socket, and we
+// exit. Players see nothing but a pause while they are loaded back in; MCCP
+// streams carry on where they were.
+//
+// The world the new process plays is the one it booted, as after a copyover
+// that is not hot. Sockets that can't survive one (TLS, WebSockets, and
+// everyone who is not in the game yet) are asked to reconnect, and the new
+// process is already listening for them. If the new process fails to boot,
+// or to take over, we kill it and carry on as if nothing happened.
+//
+//*****************************************************************************
+
+//
+// start a new process from EXE_FILE to take over from us. Returns FALSE if
+// one is already on the way, or it couldn't be started
+bool upgradeStart(void);
+
+//
+// is a new process booting to take over from us?
+bool upgradeInProgress(void);
+
+//
+// called once a pulse, to hand over to the new process once it's ready. If
+// the handover works, we never return
+void upgradePoll(void);
+
+//
+// for the new process: take over from the old process over fd, listeners
+// and all. Returns FALSE if it didn't work out, in which case the old process
+// keeps going, and we should exit
+bool upgradeTakeover(int fd);
+
+//
+// the listeners we took over, in the form listenersResume wants them
+const char *upgradeGetListeners(void);
+
+//
+// attach the sockets we took over, once we're ready for them
+void upgradeRecover(void);
+
+#endif // __UPGRADE_H
@@ -14,6 +14,8 @@
 #include <unistd.h>
 #include <dirent.h> 
 #include <time.h>
+#include <fcntl.h>
+#include <sys/socket.h>
 
 // include main header file
 #include "mud.h"
@@ -33,6 +35,9 @@
 #include "event.h"
 #include "action.h"
 #include "hooks.h"
+#include "auxiliary.h"
+#include "pulse.h"
+#include "strscan.h"
 
 
 
@@ -51,16 +56,27 @@ void  extract_obj_final(OBJ_DATA *obj) {
   deleteObj(obj);
 }
 
-void extract_obj(OBJ_DATA *obj) {
-  // make sure we're not attached to anything
-  CHAR_DATA *sitter = NULL;
-  while( (sitter = (CHAR_DATA *)listGet(objGetUsers(obj), 0)) != NULL)
-    char_from_furniture(sitter);
+void extract_obj_tree_final(OBJ_DATA *obj) {
+  // takes everything inside of us out of the game, too
+  obj_from_game(obj);
 
-  OBJ_DATA *content = NULL;
-  while( (content = (OBJ_DATA *)listGet(objGetContents(obj), 0)) != NULL)
-    extract_obj(content);
+  OBJ_DATA *node = NULL;
+  LIST    *stack = newList();
+  listPush(stack, obj);
+  while( (node = listPop(stack)) != NULL) {
+    LOCAL_LIST_ITERATOR(cont_i, objGetContents(node));
+    OBJ_DATA *content = NULL;
+    ITERATE_LIST(content, cont_i) {
+      listPush(stack, content);
+    } listIteratorFinish(cont_i);
+    deleteObj(node);
+  }
+  deleteList(stack);
+}
 
+//
+// take an object out of whatever is holding it
+void obj_from_holder(OBJ_DATA *obj) {
   if(objGetRoom(obj))
     obj_from_room(obj);
   if(objGetWearer(obj))
@@ -69,29 +85,81 @@ void extract_obj(OBJ_DATA *obj) {
     obj_from_char(obj);
   if(objGetContainer(obj))
     obj_from_obj(obj);
+}
+
+void extract_obj(OBJ_DATA *obj) {
+  // anything extracted already is on its way out, along with its contents
+  if(objIsExtracted(obj))
+    return;
+  objSetExtracted(obj);
+
+  // make sure we're not attached to anything
+  CHAR_DATA *sitter = NULL;
+  while( (sitter = (CHAR_DATA *)listGet(objGetUsers(obj), 0)) != NULL)
+    char_from_furniture(sitter);
+
+  OBJ_DATA *content = NULL;
+  while( (content = (OBJ_DATA *)listGet(objGetContents(obj), 0)) != NULL) {
+    if(objIsExtracted(content))
+      obj_from_obj(content);
+    else
+      extract_obj(content);
+  }
 
-  if(!listIn(objs_to_delete, obj))
-    listPut(objs_to_delete, obj);
+  obj_from_holder(obj);
+  epochRetire(objs_to_delete, obj);
+}
+
+void extract_obj_tree(OBJ_DATA *obj) {
+  if(objIsExtracted(obj))
+    return;
+  obj_from_holder(obj);
+
+  // one pass over the tree, getting everyone off of the furniture in it
+  OBJ_DATA *node = NULL;
+  LIST    *stack = newList();
+  listPush(stack, obj);
+  while( (node = listPop(stack)) != NULL) {
+    CHAR_DATA *sitter = NULL;
+    while( (sitter = (CHAR_DATA *)listGet(objGetUsers(node), 0)) != NULL)
+      char_from_furniture(sitter);
+    objSetExtracted(node);
+
+    LOCAL_LIST_ITERATOR(cont_i, objGetContents(node));
+    OBJ_DATA *content = NULL;
+    ITERATE_LIST(content, cont_i) {
+      listPush(stack, content);
+    } listIteratorFinish(cont_i);
+  }
+  deleteList(stack);
+  epochRetire(trees_to_delete, obj);
 }
 
 void extract_mobile_final(CHAR_DATA *ch) {
   char_from_game(ch);
   if(charIsNPC(ch) || !player_exists(charGetName(ch)))
     deleteChar(ch);
-  else
+  else {
+    // players are kept around, and might come back into the game
+    charSetExtracted(ch, FALSE);
     unreference_player(ch);
+  }
 }
 
 void extract_mobile(CHAR_DATA *ch) {
+  if(charIsExtracted(ch))
+    return;
+  charSetExtracted(ch, TRUE);
+
   // unequip everything the character is wearing
   // and send it to inventory
   unequip_all(ch);
   // extract everything in the character's inventory
-  LIST_ITERATOR *obj_i = newListIterator(charGetInventory(ch));
+  LOCAL_LIST_ITERATOR(obj_i, charGetInventory(ch));
   OBJ_DATA        *obj = NULL;
   ITERATE_LIST(obj, obj_i) {
-    extract_obj(obj);
-  } deleteListIterator(obj_i);
+    extract_obj_tree(obj);
+  } listIteratorFinish(obj_i);
 
   // make sure we're not attached to anything
   if(charGetFurniture(ch))
@@ -105,8 +173,7 @@ void extract_mobile(CHAR_DATA *ch) {
     charSetSocket(ch, NULL);
   }
 
-  if(!listIn(mobs_to_delete, ch))
-    listPut(mobs_to_delete, ch);
+  epochRetire(mobs_to_delete, ch);
 }
 
 void extract_room_final(ROOM_DATA *room) {
@@ -125,7 +192,7 @@ void extract_room(ROOM_DATA *room) {
   // and the objects
   OBJ_DATA *obj = NULL;
   while( (obj = listGet(roomGetContents(room), 0)) != NULL)
-    extract_obj(obj);
+    extract_obj_tree(obj);
 
   // remove us from the world we're in ... the if should always be true if
   // we are in fact part of the world.
@@ -134,14 +201,14 @@ void extract_room(ROOM_DATA *room) {
     worldRemoveRoom(gameworld, roomGetClass(room));
 
   // If anyone's last room was us, make sure we set the last room to NULL
-  LIST_ITERATOR *ch_i = newListIterator(mobile_list);
+  LOCAL_LIST_ITERATOR(ch_i, mobile_list);
   ITERATE_LIST(ch, ch_i) {
     if(charGetLastRoom(ch) == room)
       charSetLastRoom(ch, NULL);
-  } deleteListIterator(ch_i);
+  } listIteratorFinish(ch_i);
 
-  if(!listIn(rooms_to_delete, room))
-    listPut(rooms_to_delete, room);
+  if(!epochIsRetired(room))
+    epochRetire(rooms_to_delete, room);
 }
 
 void communicate(CHAR_DATA *dMob, char *txt, int range)
@@ -239,41 +306,35 @@ bool try_enter_game(CHAR_DATA *ch) {
 }
 
 CHAR_DATA *check_reconnect(const char *player) {
-  CHAR_DATA *dMob;
-  LIST_ITERATOR *mob_i = newListIterator(mobile_list);
-
-  ITERATE_LIST(dMob, mob_i) {
-    if (!charIsNPC(dMob) && charIsName(dMob, player)) {
-      if (charGetSocket(dMob)) {
-        close_socket(charGetSocket(dMob), TRUE);
-	charSetSocket(dMob, NULL);
-      }
-      break;
-    }
-  } deleteListIterator(mob_i);
+  CHAR_DATA *dMob = find_player(player);
+  if (dMob && charGetSocket(dMob)) {
+    close_socket(charGetSocket(dMob), TRUE);
+    charSetSocket(dMob, NULL);
+  }
   return dMob;
 }
 
 void do_mass_transfer(ROOM_DATA *from, ROOM_DATA *to, bool chars, bool mobs,
 		      bool objs) {
   if(chars || mobs) {
-    LIST_ITERATOR *ch_i = newListIterator(roomGetCharacters(from));
-    CHAR_DATA       *ch = NULL;
+    LIST     *moving = newList();
+    LOCAL_LIST_ITERATOR(ch_i, roomGetCharacters(from));
+    CHAR_DATA    *ch = NULL;
     ITERATE_LIST(ch, ch_i) {
-      if(mobs || (chars && !charIsNPC(ch))) {
-	char_from_room(ch);
-	char_to_room(ch, to);
-      }
-    } deleteListIterator(ch_i);
+      if(mobs || (chars && !charIsNPC(ch)))
+	listQueue(moving, ch);
+    } listIteratorFinish(ch_i);
+    chars_to_room(moving, to);
+    deleteList(moving);
   }
 
   if(objs) {
-    LIST_ITERATOR *obj_i = newListIterator(roomGetContents(from));
+    LOCAL_LIST_ITERATOR(obj_i, roomGetContents(from));
     OBJ_DATA        *obj = NULL;
     ITERATE_LIST(obj, obj_i) {
       obj_from_room(obj);
       obj_to_room(obj, to);
-    } deleteListIterator(obj_i);
+    } listIteratorFinish(obj_i);
   }
 }
 
@@ -294,6 +355,199 @@ ROOM_DATA *objGetRootRoom(OBJ_DATA *obj) {
   return objGetRoom(obj);
 }
 
+//
+// a room we reached while walking the world, and the step that got us there
+typedef struct {
+  ROOM_DATA *room;
+  int      parent; // where we came from, or -1 for the room we started in
+  int       depth;
+} WALK_STEP;
+
+//
+// walk breadth first out from a room, until we reach to (if it isn't NULL)
+// or run out of rooms within max_depth steps, never going through the rooms
+// in avoid (if it isn't NULL). Returns the steps taken and how many there
+// were. If we found to, it is the last step
+WALK_STEP *walk_rooms(ROOM_DATA *from, ROOM_DATA *to, int max_depth, int flags,
+		      SET *avoid, int *num_steps) {
+  int        max_steps = 16;
+  WALK_STEP     *steps = malloc(sizeof(WALK_STEP) * max_steps);
+  SET           *seen = newSet();
+  int              num = 1, i, j;
+  bool           found = (from == to);
+  char  locale[SMALL_BUFFER];
+
+  snprintf(locale, SMALL_BUFFER, "%s", get_key_locale(roomGetClass(from)));
+  steps[0].room   = from;
+  steps[0].parent = -1;
+  steps[0].depth  = 0;
+  setPut(seen, from);
+
+  for(i = 0; i < num && !found; i++) {
+    ROOM_DATA *room = steps[i].room;
+    if(max_depth > 0 && steps[i].depth >= max_depth)
+      break;
+    for(j = 0; j < roomCountEdges(room); j++) {
+      EXIT_DATA *exit = roomGetEdgeExit(room, j);
+      ROOM_DATA *dest = NULL;
+      if(IS_SET(flags, WALK_NO_DOORS) && exitIsClosed(exit))
+	continue;
+      if((dest = roomGetEdgeDest(room, j, !IS_SET(flags, WALK_LOADED_ONLY)))
+	 == NULL || setIn(seen, dest) || (avoid != NULL && setIn(avoid, dest)))
+	continue;
+      if(IS_SET(flags, WALK_STAY_ZONE) &&
+	 strcasecmp(get_key_locale(roomGetClass(dest)), locale))
+	continue;
+      if(num == max_steps) {
+	max_steps *= 2;
+	steps = realloc(steps, sizeof(WALK_STEP) * max_steps);
+      }
+      steps[num].room   = dest;
+      steps[num].parent = i;
+      steps[num].depth  = steps[i].depth + 1;
+      num++;
+      setPut(seen, dest);
+      if((found = (dest == to)) == TRUE)
+	break;
+    }
+  }
+
+  deleteSet(seen);
+  *num_steps = num;
+  return steps;
+}
+
+//
+// the routes room_path has found lately, so NPCs asking for the same route
+// pulse after pulse don't walk the world for it every time. A route is good
+// until the room graph changes, or, for routes that can't pass closed doors,
+// until a door opens or closes. The least recently used are forgotten first
+#define ROUTE_CACHE_SIZE     512
+
+typedef struct {
+  char         *key; // "from to max_depth flags", by uid
+  int         *uids; // the rooms on the route, or NULL if there isn't one
+  int           len;
+  int     graph_gen; // roomGraphGeneration when we found it
+  int      door_gen; // exitDoorGeneration when we found it
+  LIST_NODE   *node;
+} ROUTE;
+
+HASHTABLE *route_table = NULL; // key -> ROUTE
+LIST        *route_lru = NULL; // ROUTEs, most recently used first
+
+void route_forget(ROUTE *route) {
+  hashRemove(route_table, route->key);
+  listRemoveNode(route_lru, route->node);
+  free(route->key);
+  if(route->uids) free(route->uids);
+  free(route);
+}
+
+//
+// the route we remember from one room to another, if it is still good. If
+// it is, *path is set to the rooms on it (NULL if there is no route)
+bool route_lookup(const char *key, int flags, LIST **path) {
+  ROUTE *route = (route_table ? hashGet(route_table, key) : NULL);
+  int        i;
+  if(route == NULL)
+    return FALSE;
+  if(route->graph_gen != roomGraphGeneration() ||
+     (IS_SET(flags, WALK_NO_DOORS) && route->door_gen != exitDoorGeneration())){
+    route_forget(route);
+    return FALSE;
+  }
+
+  *path = (route->uids ? newList() : NULL);
+  for(i = 0; i < route->len; i++) {
+    ROOM_DATA *room = propertyTableGet(room_table, route->uids[i]);
+    if(room == NULL) {
+      deleteList(*path);
+      route_forget(route);
+      return FALSE;
+    }
+    listQueue(*path, room);
+  }
+  listRemoveNode(route_lru, route->node);
+  route->node = listPutNode(route_lru, route);
+  return TRUE;
+}
+
+//
+// remember a route we just found
+void route_remember(const char *key, LIST *path) {
+  ROUTE    *route = calloc(1, sizeof(ROUTE));
+  ROOM_DATA *room = NULL;
+  if(route_table == NULL) {
+    route_table = newHashtable();
+    route_lru   = newList();
+  }
+  while(listSize(route_lru) >= ROUTE_CACHE_SIZE)
+    route_forget(listTail(route_lru));
+
+  route->key       = strdup(key);
+  route->graph_gen = roomGraphGeneration();
+  route->door_gen  = exitDoorGeneration();
+  if(path != NULL) {
+    LIST_ITERATOR *room_i = newListIterator(path);
+    route->uids = malloc(sizeof(int) * listSize(path));
+    ITERATE_LIST(room, room_i) {
+      route->uids[route->len++] = roomGetUID(room);
+    } deleteListIterator(room_i);
+  }
+  route->node = listPutNode(route_lru, route);
+  hashPut(route_table, route->key, route);
+}
+
+LIST *rooms_within(ROOM_DATA *from, int depth, int flags) {
+  LIST      *rooms = newList();
+  int    num_steps = 0, i;
+  WALK_STEP *steps = NULL;
+  // walk_rooms takes a max depth of 0 as no limit; we take it as just us
+  if(depth <= 0) {
+    listQueue(rooms, from);
+    return rooms;
+  }
+  steps = walk_rooms(from, NULL, depth, flags, NULL, &num_steps);
+  for(i = 0; i < num_steps; i++)
+    listQueue(rooms, steps[i].room);
+  free(steps);
+  return rooms;
+}
+
+LIST *room_path_avoiding(ROOM_DATA *from, ROOM_DATA *to, int max_depth,
+			 int flags, SET *avoid) {
+  int    num_steps = 0, i;
+  WALK_STEP *steps = walk_rooms(from, to, max_depth, flags, avoid,&num_steps);
+  LIST      *path = NULL;
+  if(steps[num_steps - 1].room == to) {
+    path = newList();
+    for(i = num_steps - 1; i >= 0; i = steps[i].parent)
+      listPut(path, steps[i].room);
+  }
+  free(steps);
+  return path;
+}
+
+LIST *room_path(ROOM_DATA *from, ROOM_DATA *to, int max_depth, int flags) {
+  char  key[SMALL_BUFFER];
+  LIST *path = NULL;
+  snprintf(key, sizeof(key), "%d %d %d %d", roomGetUID(from), roomGetUID(to),
+	   max_depth, flags);
+  if(route_lookup(key, flags, &path))
+    return path;
+  path = room_path_avoiding(from, to, max_depth, flags, NULL);
+  route_remember(key, path);
+  return path;
+}
+
+const char *room_dir_to(ROOM_DATA *from, ROOM_DATA *to) {
+  int i;
+  for(i = 0; i < roomCountEdges(from); i++)
+    if(roomGetEdgeDest(from, i, FALSE) == to)
+      return roomGetEdgeDir(from, i);
+  return NULL;
+}
 
 int can_see_hidden(CHAR_DATA *ch) {
   return 0;
@@ -303,26 +557,96 @@ int can_see_invis(CHAR_DATA *ch) {
   return 0;
 }
 
-LIST *char_see_checks = NULL;
-LIST *obj_see_checks  = NULL;
-LIST *exit_see_checks = NULL;
+//
+// registered see checks are kept in flat arrays, and checked newest first
+typedef struct {
+  void **checks;
+  int       num;
+} SEE_CHECKS;
+
+SEE_CHECKS char_see_checks = { NULL, 0 };
+SEE_CHECKS obj_see_checks  = { NULL, 0 };
+SEE_CHECKS exit_see_checks = { NULL, 0 };
+
+void see_checks_add(SEE_CHECKS *checks, void *check) {
+  checks->checks = realloc(checks->checks, sizeof(void *) * (checks->num + 1));
+  checks->checks[checks->num++] = check;
+  sightChanged();
+}
+
+//
+// what a viewer could see of a target, the last time we asked during the
+// current sight epoch. The cache is direct-mapped; a new answer simply
+// replaces whatever was in its slot
+#define SIGHT_CACHE_SIZE     4096   // must be a power of 2
+
+#define SIGHT_CHAR           0
+#define SIGHT_OBJ            1
+#define SIGHT_EXIT           2
+
+typedef struct {
+  void          *viewer;
+  void          *target;
+  unsigned long   epoch;
+  int              kind;
+  bool             sees;
+} SIGHT_ENTRY;
+
+SIGHT_ENTRY sight_cache[SIGHT_CACHE_SIZE];
+unsigned long sight_epoch = 1;
+
+SIGHT_ENTRY *sight_entry(void *viewer, void *target, int kind) {
+  unsigned long hash = (((unsigned long)viewer >> 4) * 31 +
+			((unsigned long)target >> 4)) * 3 + kind;
+  return &sight_cache[hash & (SIGHT_CACHE_SIZE - 1)];
+}
+
+//
+// run every check of one kind, newest first, unless we already know the
+// answer for this epoch
+bool sight_check(SEE_CHECKS *checks, CHAR_DATA *ch, void *target, int kind) {
+  if(checks->num == 0)
+    return TRUE;
+
+  SIGHT_ENTRY *entry = sight_entry(ch, target, kind);
+  if(entry->epoch == sight_epoch && entry->viewer == ch &&
+     entry->target == target && entry->kind == kind)
+    return entry->sees;
+
+  unsigned long epoch = sight_epoch;
+  bool            ret = TRUE;
+  int               i;
+  for(i = checks->num - 1; i >= 0 && ret; i--)
+    ret = ((bool (*)(CHAR_DATA *, void *))checks->checks[i])(ch, target);
+
+  // a check may have changed what can be seen while it ran. If so, we can't
+  // say what our answer goes with
+  if(epoch == sight_epoch) {
+    entry        = sight_entry(ch, target, kind);
+    entry->viewer = ch;
+    entry->target = target;
+    entry->kind   = kind;
+    entry->epoch  = epoch;
+    entry->sees   = ret;
+  }
+  return ret;
+}
+
+void sightChanged(void) {
+  sight_epoch++;
+}
 
 void register_char_see( bool (* check)(CHAR_DATA *ch, CHAR_DATA *target)) {
-  if(char_see_checks == NULL)
-    char_see_checks = newList();
-  listPut(char_see_checks, check);
+  see_checks_add(&char_see_checks, check);
 }
 
 void register_obj_see( bool (* check)(CHAR_DATA *ch, OBJ_DATA *target)) {
-  if(obj_see_checks == NULL)
-    obj_see_checks = newList();
-  listPut(obj_see_checks, check);
+  see_checks_add(&obj_see_checks, check);
 }
 
 void register_exit_see(bool (* check)(CHAR_DATA *ch, EXIT_DATA *target)) {
-  if(exit_see_checks == NULL)
-    exit_see_checks = newList();
-  listPut(exit_see_checks, check);
+  see_checks_add(&exit_see_checks, check);
+  roomForgetAllExitListings();
 }
 
 bool  can_see_char(CHAR_DATA *ch, CHAR_DATA *target) {
@@ -330,52 +654,19 @@ bool  can_see_char(CHAR_DATA *ch, CHAR_DATA *target) {
     return TRUE;
   if(poscmp(charGetPos(ch), POS_SLEEPING) <= 0)
     return FALSE;
-
-  bool ret = TRUE;
-  if(char_see_checks != NULL) {
-    LIST_ITERATOR *chk_i = newListIterator(char_see_checks);
-    bool (*chk)(CHAR_DATA *, CHAR_DATA *) = NULL;
-    ITERATE_LIST(chk, chk_i) {
-      ret = chk(ch, target);
-      if(ret == FALSE)
-	break;
-    } deleteListIterator(chk_i);
-  }
-  return ret;
+  return sight_check(&char_see_checks, ch, target, SIGHT_CHAR);
 }
 
 bool can_see_obj(CHAR_DATA *ch, OBJ_DATA  *target) {
   if(poscmp(charGetPos(ch), POS_SLEEPING) <= 0)
     return FALSE;
-
-  bool ret = TRUE;
-  if(obj_see_checks != NULL) {
-    LIST_ITERATOR *chk_i = newListIterator(obj_see_checks);
-    bool (*chk)(CHAR_DATA *, OBJ_DATA *) = NULL;
-    ITERATE_LIST(chk, chk_i) {
-      ret = chk(ch, target);
-      if(ret == FALSE)
-	break;
-    } deleteListIterator(chk_i);
-  }
-  return ret;
+  return sight_check(&obj_see_checks, ch, target, SIGHT_OBJ);
 }
 
 bool can_see_exit(CHAR_DATA *ch, EXIT_DATA *target) {
   if(poscmp(charGetPos(ch), POS_SLEEPING) <= 0)
     return FALSE;
-
-  bool ret = TRUE;
-  if(exit_see_checks != NULL) {
-    LIST_ITERATOR *chk_i = newListIterator(exit_see_checks);
-    bool (*chk)(CHAR_DATA *, EXIT_DATA *) = NULL;
-    ITERATE_LIST(chk, chk_i) {
-      ret = chk(ch, target);
-      if(ret == FALSE)
-	break;
-    } deleteListIterator(chk_i);
-  }
-  return ret;
+  return sight_check(&exit_see_checks, ch, target, SIGHT_EXIT);
 }
 
 const char *see_exit_as(CHAR_DATA *ch, EXIT_DATA *target) {
@@ -401,7 +692,7 @@ const char *see_exit_as(CHAR_DATA *ch, EXIT_DATA *target) {
     else
       bprintf(buf, "%s", SOMEWHERE);
 
-    listPush(bufs_to_delete, buf);
+    epochRetire(bufs_to_delete, buf);
     return bufferString(buf);
   }
 }
@@ -448,9 +739,30 @@ int name_as_uid(const char *name) {
   return uid;
 }
 
+//
+// is the character or object in the list? The lists we most often ask about
+// are the ones they are held in, and we can answer those without looking
+bool char_in_list(CHAR_DATA *ch, LIST *list) {
+  if(ch == NULL)
+    return FALSE;
+  if(charGetRoom(ch) != NULL && list == roomGetCharacters(charGetRoom(ch)))
+    return TRUE;
+  return listIn(list, ch);
+}
+
+bool obj_in_list(OBJ_DATA *obj, LIST *list) {
+  if(obj == NULL)
+    return FALSE;
+  if((objGetRoom(obj)      && list == roomGetContents(objGetRoom(obj))) ||
+     (objGetCarrier(obj)   && list == charGetInventory(objGetCarrier(obj))) ||
+     (objGetContainer(obj) && list == objGetContents(objGetContainer(obj))))
+    return TRUE;
+  return listIn(list, obj);
+}
+
 int count_objs(CHAR_DATA *looker, LIST *list, const char *name, 
 	       const char *prototype, bool must_see) {
-  LIST_ITERATOR *obj_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(obj_i, list);
   OBJ_DATA *obj;
   int count = 0;
   int   uid = name_as_uid(name);
@@ -465,13 +777,13 @@ int count_objs(CHAR_DATA *looker, LIST *list, const char *name,
     else if(prototype && *prototype && objIsInstance(obj, prototype))
       count++;
   }
-  deleteListIterator(obj_i);
+  listIteratorFinish(obj_i);
   return count;
 }
 
 int count_chars(CHAR_DATA *looker, LIST *list, const char *name,
 		const char *prototype, bool must_see) {
-  LIST_ITERATOR *char_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(char_i, list);
   CHAR_DATA *ch;
   int count = 0;
   int   uid = name_as_uid(name);
@@ -485,7 +797,7 @@ int count_chars(CHAR_DATA *looker, LIST *list, const char *name,
     // otherwise, search by prototype
     else if(prototype && *prototype && charIsInstance(ch, prototype))
       count++;
-  } deleteListIterator(char_i);
+  } listIteratorFinish(char_i);
 
   return count;
 }
@@ -505,12 +817,12 @@ CHAR_DATA *find_char(CHAR_DATA *looker, LIST *list, int num, const char *name,
   int uid = name_as_uid(name);
   if(uid != NOBODY) {
     ch = propertyTableGet(mob_table, uid);
-    if(listIn(list, ch) && can_see_char(looker, ch))
+    if(char_in_list(ch, list) && can_see_char(looker, ch))
       return ch;
     return NULL;
   }
 
-  LIST_ITERATOR *char_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(char_i, list);
   ITERATE_LIST(ch, char_i) {
     if(must_see && !can_see_char(looker, ch))
       continue;
@@ -522,7 +834,7 @@ CHAR_DATA *find_char(CHAR_DATA *looker, LIST *list, int num, const char *name,
       num--;
     if(num == 0)
       break;
-  } deleteListIterator(char_i);
+  } listIteratorFinish(char_i);
   return ch;
 }
 
@@ -541,12 +853,12 @@ OBJ_DATA *find_obj(CHAR_DATA *looker, LIST *list, int num,
   int uid = name_as_uid(name);
   if(uid != NOTHING) {
     obj = propertyTableGet(obj_table, uid);
-    if(listIn(list, obj) && can_see_obj(looker, obj))
+    if(obj_in_list(obj, list) && can_see_obj(looker, obj))
       return obj;
     return NULL;
   }
 
-  LIST_ITERATOR *obj_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(obj_i, list);
   ITERATE_LIST(obj, obj_i) {
     if(must_see && !can_see_obj(looker, obj))
       continue;
@@ -558,7 +870,7 @@ OBJ_DATA *find_obj(CHAR_DATA *looker, LIST *list, int num,
       num--;
     if(num == 0)
       break;
-  } deleteListIterator(obj_i);
+  } listIteratorFinish(obj_i);
   return obj;
 }
 
@@ -569,7 +881,7 @@ OBJ_DATA *find_obj(CHAR_DATA *looker, LIST *list, int num,
 //
 LIST *find_all_chars(CHAR_DATA *looker, LIST *list, const char *name,
 		     const char *prototype, bool must_see) {
-  LIST_ITERATOR *char_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(char_i, list);
   LIST *char_list = newList();
   int         uid = name_as_uid(name);
   CHAR_DATA *ch;
@@ -581,7 +893,7 @@ LIST *find_all_chars(CHAR_DATA *looker, LIST *list, const char *name,
       listPut(char_list, ch);
     else if(prototype && *prototype && charIsInstance(ch, prototype))
       listPut(char_list, ch);
-  } deleteListIterator(char_i);
+  } listIteratorFinish(char_i);
   return char_list;
 }
 
@@ -593,7 +905,7 @@ LIST *find_all_chars(CHAR_DATA *looker, LIST *list, const char *name,
 LIST *find_all_objs(CHAR_DATA *looker, LIST *list, const char *name, 
 		    const char *prototype, bool must_see) {
 
-  LIST_ITERATOR *obj_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(obj_i, list);
   LIST       *obj_list = newList();
   int              uid = name_as_uid(name);
   OBJ_DATA *obj;
@@ -605,7 +917,7 @@ LIST *find_all_objs(CHAR_DATA *looker, LIST *list, const char *name,
       listPut(obj_list, obj);
     else if(prototype && *prototype && objIsInstance(obj, prototype))
       listPut(obj_list, obj);
-  } deleteListIterator(obj_i);
+  } listIteratorFinish(obj_i);
   return obj_list;
 }
 
@@ -653,41 +965,20 @@ void print_count(char *buf, const char *target, int count) {
 }
 
 
-//
-// Calculates how many letters until we hit the next one
-// of a specified type
-//
-int next_letter_in(const char *string, char marker) {
-  int i = 0;
-  for(i = 0; string[i] != '\0'; i++)
-    if(string[i] == marker)
-      return i;
-  return -1; // none found
-}
-
-
 //
 // Calculates how many characters until we hit the next whitespace. Newlines,
 // tabs, and spaces are treated as whitespace.
 int next_space_in(const char *string) {
-  int i = 0;
-  for(i = 0; string[i] != '\0'; i++)
-    if(isspace(string[i]))
-      return i;
-  return -1; // none found
+  const char *space = scan_to_space(string);
+  return (*space != '\0' ? space - string : -1); // -1 if none found
 }
 
 //
 // If we're at the beginning of a new paragraph, return where the new paragraph
 // starts. Otherwise, return our current position (index)
 int is_paragraph_marker(const char *string, int index) {
-  int nl_count = 0;
-  int i = 0;
-  for(i = index; isspace(string[i]); i++) {
-    if(string[i] == '\n')
-      nl_count++;
-  }
-  if(nl_count > 1)
+  int i = scan_skip_space(string + index) - string;
+  if(scan_count(string + index, i - index, '\n') > 1)
     return i;
   else
     return index;
@@ -743,110 +1034,482 @@ unsigned long pearson_hash32(const char *string) {
 }
 
 //
-// just a generic function for hashing a string. This could be 
-// sped up tremendously if it's performance becoming a problem.
-unsigned long string_hash(const char *key) {
-  return pearson_hash32(key);
+// gather up the strings we actually hash during play: hook names, auxiliary
+// names, and the keys of every prototype and trigger in the world
+LIST *hash_bench_corpus(void) {
+  const char *types[] = { "mproto", "oproto", "rproto", "trigger", NULL };
+  LIST     *corpus = hookGetTypes();
+  LIST  *aux_names = auxiliariesGetNames();
+  LIST  *zone_keys = worldGetZoneKeys(gameworld);
+  char       *str  = NULL;
+  int            i;
+
+  while((str = listPop(aux_names)) != NULL)
+    listQueue(corpus, str);
+  deleteList(aux_names);
+
+  while((str = listPop(zone_keys)) != NULL) {
+    ZONE_DATA *zone = worldGetZone(gameworld, str);
+    for(i = 0; zone != NULL && types[i] != NULL; i++) {
+      LIST *keys = zoneGetTypeKeys(zone, types[i]);
+      char  *key = NULL;
+      while((key = listPop(keys)) != NULL) {
+	listQueue(corpus, strdup(get_fullkey(key, str)));
+	free(key);
+      }
+      deleteList(keys);
+    }
+    free(str);
+  }
+  deleteList(zone_keys);
+  return corpus;
 }
 
-bool endswith(const char *string, const char *end) {
-  int slen = strlen(string);
-  int elen = strlen(end);
-  return (slen >= elen && !strcasecmp(string + slen - elen, end));
+//
+// time a hash function over the corpus, and see how evenly it spreads the
+// keys out across a table sized the way our hashtables would size it
+void hash_bench_run(BUFFER *buf, const char *name, 
+		    unsigned long (* func)(const char *),
+		    char **keys, int num_keys) {
+  int      buckets = 16, rounds, i, j, used = 0, max_load = 0;
+  volatile unsigned long sink = 0;
+  while(buckets * 3 < num_keys * 4)
+    buckets *= 2;
+  rounds = MAX(1, 1000000 / num_keys);
+
+  long long start = pulse_clock();
+  for(j = 0; j < rounds; j++)
+    for(i = 0; i < num_keys; i++)
+      sink ^= func(keys[i]);
+  long long elapsed = pulse_clock() - start;
+
+  int *load = calloc(buckets, sizeof(int));
+  for(i = 0; i < num_keys; i++) {
+    int *slot = &load[func(keys[i]) & (buckets - 1)];
+    if((*slot)++ == 0)
+      used++;
+    max_load = MAX(max_load, *slot);
+  }
+  free(load);
+
+  bprintf(buf, "%-16s %10.1f %10d %10d %10d\r\n", name,
+	  (elapsed * 1000.0) / ((double)rounds * num_keys), 
+	  buckets, num_keys - used, max_load);
 }
 
-bool startswith(const char *string, const char *start) {
-  return !strncasecmp(string, start, strlen(start));
+COMMAND(cmd_hashbench) {
+  LIST   *corpus = hash_bench_corpus();
+  int   num_keys = listSize(corpus);
+  char     **keys = NULL;
+  char      *key = NULL;
+  int      i = 0;
+
+  if(num_keys == 0) {
+    send_to_char(ch, "There are no keys to benchmark against.\r\n");
+    deleteList(corpus);
+    return;
+  }
+
+  keys = malloc(sizeof(char *) * num_keys);
+  while((key = listPop(corpus)) != NULL)
+    keys[i++] = key;
+  deleteList(corpus);
+
+  BUFFER *buf = newBuffer(MAX_BUFFER);
+  bprintf(buf, "Benchmarking string hashes over %d keys (hook names, "
+	  "auxiliary names, prototype and trigger keys).\r\n\r\n", num_keys);
+  bprintf(buf, "{c%-16s %10s %10s %10s %10s{n\r\n",
+	  "Hash", "ns/key", "Buckets", "Collisions", "Max load");
+  hash_bench_run(buf, "pearson_hash32", pearson_hash32, keys, num_keys);
+  hash_bench_run(buf, "string_hash",    string_hash,    keys, num_keys);
+
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    text_to_char(ch, bufferString(buf));
+  deleteBuffer(buf);
+  for(i = 0; i < num_keys; i++)
+    free(keys[i]);
+  free(keys);
 }
 
-const char *strcpyto(char *to, const char *from, char end) {
-  // copy everything up to end, and then delimit our destination buffer
-  for(; *from != '\0' && *from != end; to++, from++)
-    *to = *from;
-  *to = '\0';
+//
+// time the list churn of a mass extraction: a list the size of object_list
+// has every element taken out while it is being iterated over, the way
+// extract_obj takes things out of object_list mid-pulse, and then the
+// deferred removals are cleaned up. Usage: listbench [size]
+COMMAND(cmd_listbench) {
+  int          size = (*arg ? atoi(arg) : 100000);
+  size              = MAX(1000, MIN(size, 1000000));
+  char      *things = malloc(size);
+  LIST_NODE **nodes = malloc(sizeof(LIST_NODE *) * size);
+  LIST        *list = newList();
+  void       *thing = NULL;
+  int             i = 0;
+
+  long long start = pulse_clock();
+  for(i = 0; i < size; i++)
+    nodes[i] = listQueueNode(list, things + i);
+  long long fill = pulse_clock() - start;
+
+  // extract everything while we're iterating
+  start = pulse_clock();
+  LOCAL_LIST_ITERATOR(list_i, list);
+  ITERATE_LIST(thing, list_i) {
+    listRemoveNode(list, nodes[(char *)thing - things]);
+  }
+  long long removal = pulse_clock() - start;
+  start = pulse_clock();
+  listIteratorFinish(list_i);
+  long long compact = pulse_clock() - start;
+
+  // and throw away a full list in one go
+  for(i = 0; i < size; i++)
+    listQueue(list, things + i);
+  start = pulse_clock();
+  deleteList(list);
+  long long teardown = pulse_clock() - start;
+
+  send_to_char(ch, "List churn over %d elements:\r\n"
+	       "  queue          %8lld usec (%6.1f ns each)\r\n"
+	       "  remove (iter)  %8lld usec (%6.1f ns each)\r\n"
+	       "  compact        %8lld usec (%6.1f ns each)\r\n"
+	       "  delete list    %8lld usec (%6.1f ns each)\r\n", size,
+	       fill,     fill     * 1000.0 / size,
+	       removal,  removal  * 1000.0 / size,
+	       compact,  compact  * 1000.0 / size,
+	       teardown, teardown * 1000.0 / size);
+  free(nodes);
+  free(things);
+}
 
-  // skip our end character and return whatever's left
-  if(*from != '\0')
-    from++;
-  return from;
+//
+// the synthetic world an inform benchmark is run in: a ring of rooms, each
+// holding some objects and mobiles, and players on fake sockets one end of
+// a socketpair each, with the other end held here so their output can be
+// read back and thrown away
+typedef struct {
+  int           num_rooms;
+  int           num_socks;
+  ROOM_DATA   **rooms;
+  CHAR_DATA   **players;
+  SOCKET_DATA **socks;
+  int          *peers;
+} INFORM_BENCH;
+
+// what we time, and how it went
+#define BENCH_LOOK          0
+#define BENCH_SAY           1
+#define BENCH_EMOTE         2
+#define BENCH_MOVE          3
+#define NUM_BENCH_OPS       4
+
+const char *bench_op_names[NUM_BENCH_OPS] = {
+  "look", "say", "emote", "move"
+};
+
+typedef struct {
+  long long count;
+  long long op_ns;
+  long long max_ns;
+  long long flush_ns;
+  long long bytes;
+} BENCH_STAT;
+
+// a few of each thing, so listings have to group them
+const char *bench_obj_rdescs[] = {
+  "A grey pebble lies here.",
+  "A battered tin cup has been left here.",
+  "Someone has dropped a length of frayed rope here.",
+};
+
+const char *bench_mob_rdescs[] = {
+  "A benchmark drone stands here, humming quietly.",
+  "A benchmark drone hovers here, blinking.",
+};
+
+long long bench_clock_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
 }
 
 //
-// counts how many times ch occurs in string
+// the input handler for the benchmark's players. Nothing is ever sent from
+// the other end of their sockets, so there is nothing to do
+void inform_bench_input(SOCKET_DATA *sock, char *input) {
+}
+
 //
-int count_letters(const char *string, const char ch, const int strlen) {
+// build a world of num_rooms rooms holding things objects and things mobiles
+// each, and num_socks players spread out through them
+INFORM_BENCH *newInformBench(int num_rooms, int num_socks, int things) {
+  INFORM_BENCH *bench = calloc(1, sizeof(INFORM_BENCH));
+  char            key[SMALL_BUFFER];
+  int          i, j;
+  bench->rooms   = calloc(num_rooms, sizeof(ROOM_DATA *));
+  bench->players = calloc(num_socks, sizeof(CHAR_DATA *));
+  bench->socks   = calloc(num_socks, sizeof(SOCKET_DATA *));
+  bench->peers   = calloc(num_socks, sizeof(int));
+
+  for(i = 0; i < num_rooms; i++) {
+    ROOM_DATA *room = bench->rooms[i] = newRoom();
+    sprintf(key, "room%d@informbench", i);
+    roomSetClass(room, key);
+    roomSetName(room, "A Featureless Corridor");
+    roomSetDesc(room, "The corridor runs east and west, its walls smooth and "
+		"grey and its floor worn down the middle by the passing of "
+		"many feet. Every few paces a dim lamp is set into the "
+		"ceiling, and between them the shadows pool.");
+    worldPutRoom(gameworld, key, room);
+    room_to_game(room);
+    bench->num_rooms++;
+  }
 
-  int i, n;
-  for(i = n = 0; i < strlen; i++)
-    if(string[i] == ch)
-      n++;
+  // link everything up into a ring, running east
+  for(i = 0; i < num_rooms; i++) {
+    EXIT_DATA *east = newExit(), *west = newExit();
+    sprintf(key, "room%d@informbench", (i + 1) % num_rooms);
+    exitSetTo(east, key);
+    sprintf(key, "room%d@informbench", (i + num_rooms - 1) % num_rooms);
+    exitSetTo(west, key);
+    roomSetExit(bench->rooms[i], "east", east);
+    roomSetExit(bench->rooms[i], "west", west);
+    exit_to_game(east);
+    exit_to_game(west);
+  }
+
+  // fill up our rooms
+  for(i = 0; i < num_rooms; i++) {
+    for(j = 0; j < things; j++) {
+      OBJ_DATA *obj = newObj();
+      objSetName(obj, "a benchmark prop");
+      objSetKeywords(obj, "prop, benchmark");
+      objSetRdesc(obj, bench_obj_rdescs[j % 3]);
+      obj_to_game(obj);
+      obj_to_room(obj, bench->rooms[i]);
+
+      CHAR_DATA *mob = newMobile();
+      charSetName(mob, "a benchmark drone");
+      charSetKeywords(mob, "drone, benchmark");
+      charSetRdesc(mob, bench_mob_rdescs[j % 2]);
+      char_to_game(mob);
+      char_to_room(mob, bench->rooms[i]);
+    }
+  }
+
+  // and add our players
+  for(i = 0; i < num_socks; i++) {
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+      perror("newInformBench: socketpair");
+      break;
+    }
+    SOCKET_DATA *sock = new_socket(fds[0], 0);
+    if(sock == NULL) {
+      close(fds[1]);
+      break;
+    }
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    socketPushInputHandler(sock, inform_bench_input, show_prompt, "playing");
+
+    CHAR_DATA *ch = newMobile();
+    sprintf(key, "Benchmarker%d", i);
+    charSetName(ch, key);
+    charSetKeywords(ch, key);
+    charSetRdesc(ch, "A benchmarker is standing here, taking notes.");
+    charSetSocket(ch, sock);
+    socketSetChar(sock, ch);
+    char_to_game(ch);
+    char_to_room(ch, bench->rooms[i % num_rooms]);
 
-  return n;
+    bench->socks[i]   = sock;
+    bench->peers[i]   = fds[1];
+    bench->players[i] = ch;
+    bench->num_socks++;
+  }
+  return bench;
 }
 
 //
-// counts how many times word occurs in string. Assumes strlen(word) >= 1
-//
-int count_occurences(const char *string, const char *word) {
-  int count = 0, i = 0, word_len = strlen(word);
-  for(; string[i] != '\0'; i++) {
-    if(!strncmp(string+i, word, word_len)) {
-      count++;
-      i += word_len;
-    }
+// take the benchmark's world back out of the game. The sockets are cleaned
+// up with the rest of the game's closed sockets
+void deleteInformBench(INFORM_BENCH *bench) {
+  int i;
+  for(i = 0; i < bench->num_socks; i++) {
+    socketSetChar(bench->socks[i], NULL);
+    charSetSocket(bench->players[i], NULL);
+    close_socket(bench->socks[i], FALSE);
+    close(bench->peers[i]);
+    extract_mobile(bench->players[i]);
   }
-  return count;
+  for(i = 0; i < bench->num_rooms; i++)
+    extract_room(bench->rooms[i]);
+  free(bench->rooms);
+  free(bench->players);
+  free(bench->socks);
+  free(bench->peers);
+  free(bench);
 }
 
 //
-// return a pointer to the start of the line num (lines are ended with \n's).
-// return NULL if the line does not exist
+// send everyone their output, and read it back out of the other end so
+// nobody's socket ever fills up. Returns how many bytes went out
+long long inform_bench_flush(INFORM_BENCH *bench, BENCH_STAT *stat) {
+  char      junk[MAX_BUFFER];
+  long long sent = 0;
+  int          i;
+  for(i = 0; i < bench->num_socks; i++) {
+    long long before = socketGetBytesSent(bench->socks[i]);
+    long long  start = bench_clock_ns();
+    flush_output(bench->socks[i]);
+    stat->flush_ns  += bench_clock_ns() - start;
+    sent += socketGetBytesSent(bench->socks[i]) - before;
+    while(read(bench->peers[i], junk, sizeof(junk)) > 0)
+      ;
+  }
+  stat->bytes += sent;
+  return sent;
+}
+
 //
-char *line_start(char *string, int line) {
-  // skip forward to the appropriate line
-  int i, count = 1;
+// have one player do one thing
+void inform_bench_op(INFORM_BENCH *bench, int op, CHAR_DATA *ch) {
+  ROOM_DATA *room = charGetRoom(ch);
+  switch(op) {
+  case BENCH_LOOK:
+    look_at_room(ch, room);
+    break;
+  case BENCH_SAY:
+    message(ch, NULL, NULL, NULL, FALSE, TO_CHAR,
+	    "{yYou say, 'Has anyone seen where the lamps go at night?'{n");
+    message(ch, NULL, NULL, NULL, FALSE, TO_ROOM,
+	    "{y$n says, 'Has anyone seen where the lamps go at night?'{n");
+    break;
+  case BENCH_EMOTE:
+    message(ch, NULL, NULL, NULL, FALSE, TO_ROOM | TO_CHAR,
+	    "$n scribbles something in a notebook, then frowns at it.");
+    break;
+  case BENCH_MOVE: {
+    EXIT_DATA *exit = roomGetExit(room, "east");
+    ROOM_DATA   *to = (exit ? worldGetRoom(gameworld,exitGetToFull(exit)):NULL);
+    if(to == NULL)
+      break;
+    message(ch, NULL, NULL, NULL, TRUE, TO_ROOM, "$n leaves east.");
+    char_from_room(ch);
+    char_to_room(ch, to);
+    message(ch, NULL, NULL, NULL, TRUE, TO_ROOM, "$n has arrived.");
+    look_at_room(ch, to);
+    break;
+  }
+  }
+}
 
-  // are we looking for the start?
-  if(line == 1) return string;
+//
+// build the world, have every player look, say, emote, and move rounds times,
+// and tear it back down
+void inform_benchmark(BUFFER *buf, int rooms, int socks, int things,
+		      int rounds) {
+  BENCH_STAT stats[NUM_BENCH_OPS];
+  int     op, round, i;
+  memset(stats, 0, sizeof(stats));
+
+  long long      start = bench_clock_ns();
+  INFORM_BENCH  *bench = newInformBench(rooms, socks, things);
+  long long    boot_ns = bench_clock_ns() - start;
+  BENCH_STAT      junk = { 0 };
+
+  // whatever went out while we were connecting isn't part of anything
+  inform_bench_flush(bench, &junk);
+
+  for(op = 0; op < NUM_BENCH_OPS; op++) {
+    BENCH_STAT *stat = &stats[op];
+    for(round = 0; round < rounds; round++) {
+      for(i = 0; i < bench->num_socks; i++) {
+	start = bench_clock_ns();
+	inform_bench_op(bench, op, bench->players[i]);
+	long long took = bench_clock_ns() - start;
+	stat->op_ns += took;
+	stat->max_ns = MAX(stat->max_ns, took);
+	stat->count++;
+      }
+      inform_bench_flush(bench, stat);
+    }
+  }
 
-  for(i = 0; string[i] != '\0'; i++) {
-    if(string[i] == '\n')
-      count++;
-    if(count == line)
-      return string+i+1;
+  bprintf(buf, "Inform benchmark: %d rooms, %d sockets, %d objects and %d "
+	  "mobiles a room, %d rounds (built in %lld usec).\r\n\r\n",
+	  bench->num_rooms, bench->num_socks, things, things, rounds,
+	  boot_ns / 1000);
+  bprintf(buf, "{c%-6s %8s %10s %10s %12s %12s %10s{n\r\n",
+	  "Op", "Count", "usec/op", "max usec", "flush usec", "bytes",
+	  "bytes/op");
+  for(op = 0; op < NUM_BENCH_OPS; op++) {
+    BENCH_STAT *stat = &stats[op];
+    long long count  = MAX(1, stat->count);
+    bprintf(buf, "%-6s %8lld %10.2f %10.1f %12lld %12lld %10.1f\r\n",
+	    bench_op_names[op], stat->count, stat->op_ns / 1000.0 / count,
+	    stat->max_ns / 1000.0, stat->flush_ns / 1000, stat->bytes,
+	    (double)stat->bytes / count);
   }
+  deleteInformBench(bench);
+}
 
-  return NULL;
+//
+// time the inform paths over a synthetic world. Usage:
+//   informbench [rooms] [sockets] [things per room] [rounds]
+COMMAND(cmd_informbench) {
+  int rooms = 100, socks = 50, things = 5, rounds = 20;
+  sscanf(arg, "%d %d %d %d", &rooms, &socks, &things, &rounds);
+  rooms  = MAX(1, MIN(rooms, 10000));
+  socks  = MAX(1, MIN(socks, 1000));
+  things = MAX(0, MIN(things, 100));
+  rounds = MAX(1, MIN(rounds, 1000));
+
+  BUFFER *buf = newBuffer(MAX_BUFFER);
+  inform_benchmark(buf, rooms, socks, things, rounds);
+  if(charGetSocket(ch))
+    page_string(charGetSocket(ch), bufferString(buf));
+  else
+    text_to_char(ch, bufferString(buf));
+  deleteBuffer(buf);
 }
 
+void init_benchmarks(void) {
+  add_cmd("hashbench", NULL, cmd_hashbench, "admin", FALSE);
+  add_cmd("listbench", NULL, cmd_listbench, "admin", FALSE);
+  add_cmd("informbench", NULL, cmd_informbench, "admin", FALSE);
+}
 
-//
-// trim trailing and leading whitespace
-//
-void trim(char *string) {
-  int len = strlen(string);
-  int max = len-1;
-  int min = 0;
-  int i;
+bool endswith(const char *string, const char *end) {
+  int slen = strlen(string);
+  int elen = strlen(end);
+  return (slen >= elen && !strcasecmp(string + slen - elen, end));
+}
 
-  // kill all whitespace to the right
-  for(max = len - 1; max >= 0; max--) {
-    if(isspace(string[max]))
-      string[max] = '\0';
-    else
-      break;
-  }
+bool startswith(const char *string, const char *start) {
+  return !strncasecmp(string, start, strlen(start));
+}
 
-  // find our first non-whitespace
-  while(isspace(string[min]))
-    min++;
+const char *strcpyto(char *to, const char *from, char end) {
+  // copy everything up to end, and then delimit our destination buffer
+  const char *stop = scan_find(from, end);
+  memcpy(to, from, stop - from);
+  to[stop - from] = '\0';
+  from = stop;
 
-  // shift everything to the left
-  for(i = 0; i <= max-min; i++)
-    string[i] = string[i+min];
-  string[i] = '\0';
+  // skip our end character and return whatever's left
+  if(*from != '\0')
+    from++;
+  return from;
 }
 
+//
+// counts how many times ch occurs in string
+//
+int count_letters(const char *string, const char ch, const int strlen) {
+  return scan_count(string, strlen, ch);
+}
 
 //
 // Returns true if "word" is found in the comma-separated list of
@@ -856,27 +1519,28 @@ bool is_keyword(const char *keywords, const char *word, bool abbrev_ok) {
   int word_len = strlen(word);
   if(word_len < 1)
     return FALSE;
+  const char *keywords_end = keywords + strlen(keywords);
 
   // while we haven't reached the end of the string
   while(*keywords != '\0') {
     // skip all spaces and commas
     while(isspace(*keywords) || *keywords == ',')
       keywords = keywords+1;
-    // figure out the length of the current keyword
-    int keyword_len = next_letter_in(keywords, ',');
-    if(keyword_len == -1)
-      keyword_len = strlen(keywords);
-
-    // see if we compare to the current keyword
-    if(!abbrev_ok && !strncasecmp(keywords, word, keyword_len) &&
-       keyword_len == word_len)
+    // figure out where the current keyword ends
+    const char *keyword_end = scan_find(keywords, ',');
+    int         keyword_len = keyword_end - keywords;
+
+    // see if we compare to the current keyword. Abbreviations are compared
+    // for as long as the word is, even if the keyword is shorter
+    if(!abbrev_ok && keyword_len == word_len &&
+       scan_caseeq(keywords, word, word_len))
       return TRUE;
-    if(abbrev_ok && !strncasecmp(keywords, word, word_len))
+    if(abbrev_ok && keywords_end - keywords >= word_len &&
+       scan_caseeq(keywords, word, word_len))
       return TRUE;
-    // we didn't. skip this current keyword, and find
-    // the start of the next keyword or the end of the string
-    else while(!(*keywords == '\0' || *keywords == ','))
-      keywords = keywords+1;
+    // we didn't. skip to the start of the next keyword or the end of the
+    // string
+    keywords = keyword_end;
   }
   return FALSE;
 }
@@ -887,7 +1551,7 @@ bool is_keyword(const char *keywords, const char *word, bool abbrev_ok) {
 // keywords. Returns the length of the keyword if it does match
 int find_keyword(const char *keywords, const char *string) {
   LIST           *words = parse_keywords(keywords);
-  LIST_ITERATOR *word_i = newListIterator(words);
+  LOCAL_LIST_ITERATOR(word_i, words);
   char            *word = NULL;
   int               len = 0;
 
@@ -896,7 +1560,7 @@ int find_keyword(const char *keywords, const char *string) {
     int word_len = strlen(word);
     if(!strncasecmp(word, string, word_len) && word_len > len)
       len = word_len;
-  } deleteListIterator(word_i);
+  } listIteratorFinish(word_i);
   deleteListWith(words, free);
 
   return len;
@@ -918,60 +1582,6 @@ bool dup_keywords_exist(const char *keywords) {
   return dup_found;
 }
 
-//
-// Return a list of all the strings in this list. String are separated by the
-// delimeter. The list and contents must be deleted after use.
-LIST *parse_strings(const char *string, char delimeter) {
-  // make our list that we will be returning
-  LIST *list = newList();
-
-  // first, we check if the string have any non-spaces
-  int i;
-  bool nonspace_found = FALSE;
-  for(i = 0; string[i] != '\0'; i++) {
-    if(!isspace(string[i])) {
-      nonspace_found = TRUE;
-      break;
-    }
-  }
-
-  // we didn't find any non-spaces. Return NULL
-  if(!nonspace_found)
-    return list;
-
-  // find all of our keywords
-  while(*string != '\0') {
-    i = 0;
-    // find the endpoint
-    while(string[i] != delimeter && string[i] != '\0')
-      i++;
-
-    char buf[i+1];
-    strncpy(buf, string, i); buf[i] = '\0';
-    trim(buf); // skip all whitespaces
-
-    // make sure something still exists. If it does, queue it
-    if(*buf != '\0')
-      listQueue(list, strdup(buf));
-
-    // skip everything we just copied, plus our delimeter
-    string = &string[i+(string[i] != '\0' ? 1 : 0)];
-  }
-
-  // return whatever we found
-  return list;
-}
-
-
-//
-// return a list of all the unique keywords found in the keywords string
-// keywords can be more than one word long (e.g. blue flame) and each
-// keyword must be separated by a comma
-LIST *parse_keywords(const char *keywords) {
-  return parse_strings(keywords, ',');
-}
-
-
 //
 // If the keyword does not already exist, add it to the keyword list
 // keywords may be freed and re-built in the process, to make room
@@ -1005,7 +1615,7 @@ void remove_keyword(char *keywords, const char *word) {
 
   // did we find a copy of the bad keyword?
   if(count > 0) {
-    LIST_ITERATOR *word_i = newListIterator(words);
+    LOCAL_LIST_ITERATOR(word_i, words);
     int             key_i = 0;
     count = 0;
 
@@ -1017,7 +1627,7 @@ void remove_keyword(char *keywords, const char *word) {
       key_i += sprintf(keywords+key_i, "%s", copy);
       if(count < listSize(words) - 1)
 	key_i += sprintf(keywords+key_i, ", ");
-    } deleteListIterator(word_i);
+    } listIteratorFinish(word_i);
   }
 
   // clean up our garbage
@@ -1138,8 +1748,9 @@ void strip_word(char *string, const char *word) {
   for(i = 0; string[i] != '\0'; i++) {
 
     // skip all spaces and newline stuff
-    while(isspace(string[i]) || string[i] == '\n' || string[i] == '\r')
-      i++;
+    i = scan_skip_space(string + i) - string;
+    if(string[i] == '\0')
+      break;
 
     // we've found a match
     if(!strncmp(string+i, word, word_len) &&
@@ -1252,6 +1863,39 @@ void print_bits(bitvector_t bits, const char **names, char *buf) {
 }
 
 
+int group_list(LIST *list, void *descriptor, void **things, int *counts) {
+  const char             *(* desc_func)(void *) = descriptor;
+  int size = listSize(list), table_size = 1, num_groups = 0, i;
+  while(table_size < size * 2)
+    table_size <<= 1;
+
+  // open-addressed table of group indexes, keyed by description. -1 is empty
+  int table[table_size];
+  const char *descs[size];
+  for(i = 0; i < table_size; i++)
+    table[i] = -1;
+
+  void *thing;
+  LOCAL_LIST_ITERATOR(thing_i, list);
+  ITERATE_LIST(thing, thing_i) {
+    const char *desc = desc_func(thing);
+    int       bucket = string_hash(desc) & (table_size - 1);
+    // find the group with our description, or the empty slot it'd go in
+    while(table[bucket] != -1 && strcmp(descs[table[bucket]], desc))
+      bucket = (bucket + 1) & (table_size - 1);
+    if(table[bucket] == -1) {
+      table[bucket]      = num_groups;
+      descs[num_groups]  = desc;
+      things[num_groups] = thing;
+      counts[num_groups] = 0;
+      num_groups++;
+    }
+    counts[table[bucket]]++;
+  } listIteratorFinish(thing_i);
+  return num_groups;
+}
+
+
 char *print_list(LIST *list, void *descriptor, void *multi_descriptor) {
   const char             *(* desc_func)(void *) = descriptor;
   const char            *(* multi_desc)(void *) = multi_descriptor;
@@ -1262,37 +1906,12 @@ char *print_list(LIST *list, void *descriptor, void *multi_descriptor) {
   char buf[MAX_BUFFER] = "";
   char one_thing[SMALL_BUFFER];
   int i;
-  int tot_things = 0;
   int size = listSize(list);
   int counts[size];
   void *things[size];
-  void *thing;
-  LIST_ITERATOR *thing_i = newListIterator(list);
-
-  for(i = 0; i < size; i++) {
-    counts[i] = 0;
-    things[i] = NULL;
-  }
 
   // first, collect groups of all the things in the list
-  ITERATE_LIST(thing, thing_i) {
-    // see if we have one with the current name already
-    for(i = 0; i < size; i++) {
-      // it's a thing with a new name
-      if(things[i] == NULL) {
-	things[i] = thing;
-	counts[i]++;
-	tot_things++;
-	break;
-      }
-      // it has the same name as something else
-      else if(!strcmp(desc_func(thing), desc_func(things[i]))) {
-	counts[i]++;
-	break;
-      }
-    }
-  } deleteListIterator(thing_i);
-
+  int tot_things = group_list(list, descriptor, things, counts);
 
   // now, print everything to the buffer
   for(i = 0; i < tot_things; i++) {
@@ -1325,50 +1944,24 @@ void show_list(CHAR_DATA *ch, LIST *list, void *descriptor,
 
   int i;
   int size = listSize(list);
+  if(size == 0)
+    return;
   int counts[size];
   void *things[size];
-  void *thing;
-  LIST_ITERATOR *thing_i = newListIterator(list);
-
-  for(i = 0; i < size; i++) {
-    counts[i] = 0;
-    things[i] = NULL;
-  }
 
   // find a list of all things with unique names
-  ITERATE_LIST(thing, thing_i) {
-    // see if we have one with the current name already
-    for(i = 0; i < size; i++) {
-      // it's a thing with a new name
-      if(things[i] == NULL) {
-	things[i] = thing;
-	counts[i]++;
-	break;
-      }
-      // it has the same name as something else
-      else if(!strcmp(desc_func(thing), desc_func(things[i]))) {
-	counts[i]++;
-	break;
-      }
-    }
-  } deleteListIterator(thing_i);
-
+  int tot_things = group_list(list, descriptor, things, counts);
 
   // print out all of the things
-  for(i = 0; i < size; i++) {
-    // we've run into the end of the list
-    if(things[i] == NULL)
-      break;
+  for(i = 0; i < tot_things; i++) {
+    if(counts[i] == 1)
+      send_to_char(ch, "{n%s\r\n", desc_func(things[i]));
+    else if(multi_desc == NULL || !*multi_desc(things[i]))
+      send_to_char(ch, "{n(%d) %s\r\n", counts[i], desc_func(things[i]));
     else {
-      if(counts[i] == 1)
-	send_to_char(ch, "{n%s\r\n", desc_func(things[i]));
-      else if(multi_desc == NULL || !*multi_desc(things[i]))
-	send_to_char(ch, "{n(%d) %s\r\n", counts[i], desc_func(things[i]));
-      else {
-	char fmt[SMALL_BUFFER];
-	sprintf(fmt, "{n%s\r\n", multi_desc(things[i]));
-	send_to_char(ch, fmt, counts[i]);
-      }
+      char fmt[SMALL_BUFFER];
+      sprintf(fmt, "{n%s\r\n", multi_desc(things[i]));
+      send_to_char(ch, fmt, counts[i]);
     }
   }
 }
@@ -1377,7 +1970,7 @@ void show_list(CHAR_DATA *ch, LIST *list, void *descriptor,
 LIST *get_unused_items(CHAR_DATA *ch, LIST *list, bool invis_ok) {
   OBJ_DATA *obj;
   LIST *newlist = newList();
-  LIST_ITERATOR *obj_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(obj_i, list);
 
   ITERATE_LIST(obj, obj_i) {
     if(listSize(objGetUsers(obj)) != 0)
@@ -1386,14 +1979,14 @@ LIST *get_unused_items(CHAR_DATA *ch, LIST *list, bool invis_ok) {
       continue;
 
     listPut(newlist, obj);
-  } deleteListIterator(obj_i);
+  } listIteratorFinish(obj_i);
   return newlist;
 }
 
 LIST *get_used_items(CHAR_DATA *ch, LIST *list, bool invis_ok) {
   OBJ_DATA *obj;
   LIST *newlist = newList();
-  LIST_ITERATOR *obj_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(obj_i, list);
 
   ITERATE_LIST(obj, obj_i) {
     if(listSize(objGetUsers(obj)) < 1)
@@ -1401,7 +1994,7 @@ LIST *get_used_items(CHAR_DATA *ch, LIST *list, bool invis_ok) {
     if(!(invis_ok || can_see_obj(ch, obj)))
       continue;
     listPut(newlist, obj);
-  } deleteListIterator(obj_i);
+  } listIteratorFinish(obj_i);
   return newlist;
 }
 
@@ -1420,11 +2013,11 @@ void *identity_func(void *data) {
 
 LIST *reverse_list(LIST *list) {
   LIST         *newlist = newList();
-  LIST_ITERATOR *list_i = newListIterator(list);
+  LOCAL_LIST_ITERATOR(list_i, list);
   void            *elem = NULL;
   ITERATE_LIST(elem, list_i) {
     listPut(newlist, elem);
-  } deleteListIterator(list_i);
+  } listIteratorFinish(list_i);
   return newlist;
 }
 
@@ -1553,10 +2146,8 @@ bool cmd_matches(const char *pattern, const char *cmd) {
 }
 
 bool charHasMoreUserGroups(CHAR_DATA *ch1, CHAR_DATA *ch2) {
-  return (bitIsAllSet(charGetUserGroups(ch1),
-		      bitvectorGetBits(charGetUserGroups(ch2))) &&
-	  !bitIsAllSet(charGetUserGroups(ch2),
-		       bitvectorGetBits(charGetUserGroups(ch1))));
+  return (bitvectorContains(charGetUserGroups(ch1), charGetUserGroups(ch2)) &&
+	  !bitvectorContains(charGetUserGroups(ch2), charGetUserGroups(ch1)));
 }
 
 bool canEditZone(ZONE_DATA *zone, CHAR_DATA *ch) {
@@ -1638,7 +2229,7 @@ void do_list(CHAR_DATA *ch, const char *locale, const char *type,
     const char *(* info_func)(void *) = informer;
     LIST *name_list = zoneGetTypeKeys(zone, type);
     listSortWith(name_list, strcasecmp);
-    LIST_ITERATOR *name_i = newListIterator(name_list);
+    LOCAL_LIST_ITERATOR(name_i, name_list);
     char            *name = NULL;
     BUFFER           *buf = newBuffer(1);
     void            *data = NULL;
@@ -1649,7 +2240,7 @@ void do_list(CHAR_DATA *ch, const char *locale, const char *type,
       if(data != NULL)
 	bprintf(buf, " {c%-20s %57s{n\r\n", name, 
 		(info_func ? info_func(zoneGetType(zone, type, name)) : ""));
-    } deleteListIterator(name_i);
+    } listIteratorFinish(name_i);
     deleteListWith(name_list, free);
     page_string(charGetSocket(ch), bufferString(buf));
     deleteBuffer(buf);
@@ -75,6 +75,15 @@ void  register_exit_see   ( bool (* check)(CHAR_DATA *ch, EXIT_DATA *target));
 bool  can_see_char        ( CHAR_DATA *ch, CHAR_DATA *target);
 bool  can_see_obj         ( CHAR_DATA *ch, OBJ_DATA  *target);
 bool  can_see_exit        ( CHAR_DATA *ch, EXIT_DATA *exit);
+
+//
+// the answers of see checks are remembered until the next time something
+// might change what can be seen. Positions, hidden-ness, and where things
+// are call this on their own, as does every pulse and command. Anything else
+// that changes what a see check would say (lighting a torch, going invisible)
+// should call it too
+void  sightChanged        ( void);
+
 bool  try_enter_game      ( CHAR_DATA *ch);
 int   can_see_hidden      ( CHAR_DATA *ch);
 int   can_see_invis       ( CHAR_DATA *ch);
@@ -149,9 +158,28 @@ unsigned long pearson_hash16_2(const char *string);
 unsigned long   pearson_hash32(const char *string);
 
 //
-// aliases pearson_hash32
+// a fast, case-insensitive hash for strings. Walks the string only once, and
+// is what our hashtables use to place their keys
 unsigned long string_hash(const char *key);
 
+//
+// adds the admin benchmarking commands: hashbench, which compares the speed
+// and spread of our string hashes over the keys the game is actually using,
+// listbench, which times the list churn of a mass extraction, and
+// informbench, which runs inform_benchmark
+void init_benchmarks(void);
+
+//
+// time the inform paths (look_at_room, message, and flush_output) over a
+// synthetic world: a ring of rooms, each holding things objects and things
+// mobiles, and socks players spread between them on socketpair-backed
+// sockets. Every player looks, says something, emotes, and moves east, rounds
+// times each, and the latency of each operation and the bytes it sent to
+// everyone's sockets are appended to buf as a table. The world is taken back
+// out of the game when it's done
+void inform_benchmark(BUFFER *buf, int rooms, int socks, int things,
+		      int rounds);
+
 bool endswith             (const char *string, const char *end);
 bool startswith           (const char *string, const char *start);
 const char *strcpyto      (char *to, const char *from, char end);
@@ -167,10 +195,18 @@ void         extract_mobile(CHAR_DATA *ch);
 void            extract_obj(OBJ_DATA  *obj);
 void           extract_room(ROOM_DATA *room);
 
+// remove an object and everything inside of it from the game, and delete
+// them. Only the object itself is taken out of what holds it; its contents
+// stay inside of it, and are all marked extracted in one pass over the tree,
+// so no obj_from_obj hooks are run for them. Each object still leaves the
+// game (and runs obj_from_game) when the tree is deleted
+void       extract_obj_tree(OBJ_DATA  *obj);
+
 // don't call these. These are for use by gameloop.c only. Use the non-final
 // versions, please!!
 void   extract_mobile_final(CHAR_DATA *ch);
 void      extract_obj_final(OBJ_DATA  *obj);
+void extract_obj_tree_final(OBJ_DATA  *obj);
 void     extract_room_final(ROOM_DATA *room);
 
 char *get_time             ( void );
@@ -189,6 +225,25 @@ const char *exitGetToFull(EXIT_DATA *exit);
 // find the root room of an object; traverse its containers and carriers
 ROOM_DATA *objGetRootRoom(OBJ_DATA *obj);
 
+// walk the world from room to room, breadth first, along rooms' edges (see
+// room.h). rooms_within returns every room no more than depth steps away,
+// nearest first, starting with from. room_path returns the rooms on the
+// shortest path from one room to another, both included, or NULL if no path
+// within max_depth steps exists (0 for no limit). Both lists must be deleted.
+// The last few hundred routes room_path has found are remembered, until the
+// room graph changes (or doors open or close, for WALK_NO_DOORS routes).
+// room_path_avoiding never goes through the rooms in avoid, and remembers
+// nothing. room_dir_to is the direction of the exit that leads from one
+// room straight to another, or NULL if none does
+#define WALK_NO_DOORS      (1 << 0) // don't go through closed exits
+#define WALK_STAY_ZONE     (1 << 1) // don't leave from's zone
+#define WALK_LOADED_ONLY   (1 << 2) // don't load rooms that aren't in memory
+LIST *rooms_within(ROOM_DATA *from, int depth, int flags);
+LIST *room_path   (ROOM_DATA *from, ROOM_DATA *to, int max_depth, int flags);
+LIST *room_path_avoiding(ROOM_DATA *from, ROOM_DATA *to, int max_depth,
+			 int flags, SET *avoid);
+const char *room_dir_to(ROOM_DATA *from, ROOM_DATA *to);
+
 
 
 //*****************************************************************************
@@ -296,6 +351,13 @@ LIST *find_all_chars(CHAR_DATA *looker, LIST *list, const char *name,
 LIST *find_all_objs(CHAR_DATA *looker, LIST *list, const char *name,
 		    const char *prototype, bool must_see);
 
+//
+// returns the name as a UID, or NOBODY if it isn't one. And, is the char or
+// obj in the list? Quick for the lists they are held in
+int   name_as_uid  (const char *name);
+bool  char_in_list (CHAR_DATA *ch, LIST *list);
+bool  obj_in_list  (OBJ_DATA *obj, LIST *list);
+
 // in the various find() routines, it may sometimes arise that someone
 // wants to find multiple things (e.g. all.cookies, all.women). This is
 // the numeric marker to represent all.
@@ -312,6 +374,14 @@ void get_count(const char *buf, char *target, int *count);
 void print_count(char *buf, const char *target, int count);
 
 
+//
+// collapse the things in a list that share a description into groups, in one
+// pass. things and counts must have room for listSize(list) entries; the first
+// thing of each group is put in things, in the order the groups first appear
+// in the list, and how many things are in the group goes in counts. Returns
+// the number of groups
+int group_list(LIST *list, void *descriptor, void **things, int *counts);
+
 //
 // return a comma-separated list of the list elements, as represented
 // by the descriptor function. If there is more than one element in the list,
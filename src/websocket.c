@@ -0,0 +1,795 @@
+//*****************************************************************************
+//
+// websocket.c
+//
+// WebSockets for web clients. See websocket.h. This only turns bytes into
+// frames and frames into bytes; socket.c decides when to read and write.
+//
+//*****************************************************************************
+
+#include <zlib.h>
+#include <openssl/evp.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "gmcp.h"
+#include "websocket.h"
+
+
+
+//*****************************************************************************
+// local datastructures, defines, and variables
+//*****************************************************************************
+
+// the most an upgrade request, and a message from a client, can be
+#define WS_MAX_REQUEST      8192
+#define WS_MAX_MESSAGE     65536
+
+// the longest a frame's header can be: 2 bytes, an 8-byte length, and a mask
+#define WS_MAX_HEADER         14
+#define WS_RX_START_SIZE    4096
+
+// what every handshake's key is hashed with (RFC 6455, section 1.3)
+#define WS_GUID            "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+// what clients ask for to get JSON instead of a telnet stream
+#define WS_PROTOCOL_JSON   "nakedmud.json"
+#define WS_PROTOCOL_TELNET "telnet"
+
+// frame opcodes, and the bits around them
+#define WS_OP_CONT           0x0
+#define WS_OP_TEXT           0x1
+#define WS_OP_BINARY         0x2
+#define WS_OP_CLOSE          0x8
+#define WS_OP_PING           0x9
+#define WS_OP_PONG           0xA
+#define WS_FIN              0x80
+#define WS_RSV1             0x40 // the message is compressed
+#define WS_RSVS             0x70
+#define WS_MASKED           0x80
+
+// what a close sends for a client breaking the protocol, sending bad data,
+// or sending too much of it
+#define WS_CLOSE_PROTOCOL   1002
+#define WS_CLOSE_BAD_DATA   1007
+#define WS_CLOSE_TOO_BIG    1009
+
+// what a connection is doing
+#define WS_STATE_HANDSHAKE     0
+#define WS_STATE_OPEN          1
+#define WS_STATE_CLOSED        2
+
+struct ws_conn {
+  int          state;
+  bool          json;
+  char          *rx;         // what we've read off the socket, from rx_start
+  int       rx_start;        //   to rx_len, that hasn't been decoded yet
+  int         rx_len;
+  int        rx_size;
+  BUFFER      *ready;        // decoded input, from ready_start on, that
+  int    ready_start;        //   hasn't been handed back yet
+  BUFFER        *msg;        // a message that is coming in fragments
+  int         msg_op;        //   its opcode, or -1 if there isn't one
+  bool  msg_deflated;        //   is it compressed?
+  BUFFER      *reply;        // what has to go out exactly as it is
+  BUFFER       *held;        // output from before the handshake finished
+  z_stream  *deflate;        // permessage-deflate, if we're using it, and
+  z_stream  *inflate;        //   whether we start each message afresh
+  bool  deflate_reset;
+  bool  inflate_reset;
+};
+
+// where messages are put together and compressed, before they're framed
+BUFFER *ws_scratch = NULL;
+BUFFER    *ws_zbuf = NULL;
+
+// what every compressed message ends with, which is left off when it's sent
+const unsigned char ws_deflate_tail[4] = { 0x00, 0x00, 0xFF, 0xFF };
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// trim the spaces and tabs from both ends of str, in place
+char *ws_trim(char *str) {
+  char *end = str + strlen(str);
+  while(*str == ' ' || *str == '\t')
+    str++;
+  while(end > str && (end[-1] == ' ' || end[-1] == '\t'))
+    *--end = '\0';
+  return str;
+}
+
+//
+// does a comma-separated header value have token in it?
+bool ws_has_token(const char *list, const char *token) {
+  char *copy = strdup(list), *next = copy, *item = NULL;
+  bool found = FALSE;
+  while(!found && (item = strsep(&next, ",")) != NULL)
+    found = !strcasecmp(ws_trim(item), token);
+  free(copy);
+  return found;
+}
+
+//
+// append a frame's header to out. Ours are never masked
+void ws_frame_header(BUFFER *out, int first, unsigned long long len) {
+  int i;
+  bufferCatCh(out, (char) first);
+  if(len < 126)
+    bufferCatCh(out, (char) len);
+  else if(len < 65536) {
+    bufferCatCh(out, (char) 126);
+    bufferCatCh(out, (char) (len >> 8));
+    bufferCatCh(out, (char) len);
+  }
+  else {
+    bufferCatCh(out, (char) 127);
+    for(i = 7; i >= 0; i--)
+      bufferCatCh(out, (char) (len >> (i * 8)));
+  }
+}
+
+//
+// a zlib stream for permessage-deflate. Returns NULL if zlib can't make one
+z_stream *ws_new_zstream(bool deflating, int window_bits) {
+  z_stream *z = calloc(1, sizeof(z_stream));
+  int     ret = (deflating ?
+		 deflateInit2(z, COMPRESS_LEVEL, Z_DEFLATED, -window_bits,
+			      COMPRESS_MEM_LEVEL, Z_DEFAULT_STRATEGY) :
+		 inflateInit2(z, -window_bits));
+  if(ret != Z_OK) {
+    free(z);
+    return NULL;
+  }
+  return z;
+}
+
+//
+// append iov to out as one message, compressing it if we've agreed to
+void ws_frame_message(WS_CONN *ws, BUFFER *out, int op,
+		      const struct iovec *iov, int iovcnt) {
+  unsigned char chunk[MAX_BUFFER];
+  long long len = 0;
+  int i;
+
+  for(i = 0; i < iovcnt; i++)
+    len += iov[i].iov_len;
+  if(len == 0)
+    return;
+
+  if(ws->deflate == NULL || len < COMPRESS_MIN_BYTES) {
+    ws_frame_header(out, WS_FIN | op, len);
+    for(i = 0; i < iovcnt; i++)
+      bufferCatLen(out, iov[i].iov_base, iov[i].iov_len);
+    return;
+  }
+
+  if(ws_zbuf == NULL)
+    ws_zbuf = newBuffer(MAX_BUFFER);
+  bufferClear(ws_zbuf);
+  for(i = 0; i < iovcnt; i++) {
+    ws->deflate->next_in  = iov[i].iov_base;
+    ws->deflate->avail_in = iov[i].iov_len;
+    do {
+      ws->deflate->next_out  = chunk;
+      ws->deflate->avail_out = sizeof(chunk);
+      deflate(ws->deflate, (i == iovcnt - 1 ? Z_SYNC_FLUSH : Z_NO_FLUSH));
+      bufferCatLen(ws_zbuf, (char *) chunk,
+		   sizeof(chunk) - ws->deflate->avail_out);
+    } while(ws->deflate->avail_out == 0);
+  }
+  if(ws->deflate_reset)
+    deflateReset(ws->deflate);
+
+  // the flush always ends with the same four bytes, which the client puts
+  // back itself
+  len = bufferLength(ws_zbuf) - sizeof(ws_deflate_tail);
+  ws_frame_header(out, WS_FIN | WS_RSV1 | op, len);
+  bufferCatLen(out, bufferString(ws_zbuf), len);
+}
+
+//
+// append len bytes of str to out, escaped for a JSON string. If html is set,
+// also make what HTML reserves into entities. Text frames must be UTF-8, so
+// anything that isn't is replaced
+void ws_json_escape(BUFFER *out, const char *str, int len, bool html) {
+  const unsigned char *s = (const unsigned char *) str;
+  int i = 0, j = 0;
+  while(i < len) {
+    unsigned char c = s[i];
+    if(c >= 0x80) {
+      // how many continuation bytes we need, and what the first can be
+      int need = 0, lo = 0x80, hi = 0xBF;
+      if(c >= 0xC2 && c <= 0xDF)      need = 1;
+      else if(c >= 0xE0 && c <= 0xEF) {
+	need = 2;
+	if(c == 0xE0) lo = 0xA0;
+	if(c == 0xED) hi = 0x9F;
+      }
+      else if(c >= 0xF0 && c <= 0xF4) {
+	need = 3;
+	if(c == 0xF0) lo = 0x90;
+	if(c == 0xF4) hi = 0x8F;
+      }
+      for(j = 1; need > 0 && j <= need; j++) {
+	if(i + j >= len || s[i+j] < lo || s[i+j] > hi)
+	  break;
+	lo = 0x80;
+	hi = 0xBF;
+      }
+      if(need == 0 || j <= need) {
+	bufferCat(out, "\\ufffd");
+	i++;
+      }
+      else {
+	bufferCatLen(out, str + i, need + 1);
+	i += need + 1;
+      }
+      continue;
+    }
+
+    switch(c) {
+    case '"':  bufferCat(out, "\\\""); break;
+    case '\\': bufferCat(out, "\\\\"); break;
+    case '\n': bufferCat(out, "\\n");  break;
+    case '\r': bufferCat(out, "\\r");  break;
+    case '\t': bufferCat(out, "\\t");  break;
+    case '<':  bufferCat(out, (html ? "&lt;"  : "<")); break;
+    case '>':  bufferCat(out, (html ? "&gt;"  : ">")); break;
+    case '&':  bufferCat(out, (html ? "&amp;" : "&")); break;
+    default:
+      if(c < 0x20)
+	bprintf(out, "\\u%04x", c);
+      else
+	bufferCatCh(out, (char) c);
+      break;
+    }
+    i++;
+  }
+}
+
+//
+// append a message holding plain text from a telnet stream to out
+void ws_json_text(WS_CONN *ws, BUFFER *out, const char *text, int len) {
+  struct iovec iov;
+  if(len <= 0)
+    return;
+  bufferClear(ws_scratch);
+  bufferCat(ws_scratch, "{\"text\":\"<span>");
+  ws_json_escape(ws_scratch, text, len, TRUE);
+  bufferCat(ws_scratch, "</span>\"}");
+  iov.iov_base = (void *) bufferString(ws_scratch);
+  iov.iov_len  = bufferLength(ws_scratch);
+  ws_frame_message(ws, out, WS_OP_TEXT, &iov, 1);
+}
+
+//
+// append a message holding a GMCP subnegotiation's package and data to out.
+// The data is already JSON. IACs in it are still doubled up
+void ws_json_gmcp(WS_CONN *ws, BUFFER *out, const char *mssg, int len) {
+  struct iovec iov;
+  int i, pkg_len = 0;
+  while(pkg_len < len && mssg[pkg_len] != ' ')
+    pkg_len++;
+
+  bufferClear(ws_scratch);
+  bufferCat(ws_scratch, "{\"gmcp\":\"");
+  ws_json_escape(ws_scratch, mssg, pkg_len, FALSE);
+  bufferCat(ws_scratch, "\",\"data\":");
+  if(pkg_len + 1 >= len)
+    bufferCat(ws_scratch, "null");
+  for(i = pkg_len + 1; i < len; i++) {
+    bufferCatCh(ws_scratch, mssg[i]);
+    if((unsigned char) mssg[i] == IAC && i + 1 < len &&
+       (unsigned char) mssg[i+1] == IAC)
+      i++;
+  }
+  bufferCatCh(ws_scratch, '}');
+  iov.iov_base = (void *) bufferString(ws_scratch);
+  iov.iov_len  = bufferLength(ws_scratch);
+  ws_frame_message(ws, out, WS_OP_TEXT, &iov, 1);
+}
+
+//
+// append a telnet stream to out as JSON messages: its text, and its GMCP
+void ws_frame_telnet_json(WS_CONN *ws, BUFFER *out, const char *data,int len){
+  int i = 0, text = 0;
+  while(i < len) {
+    if((unsigned char) data[i] != IAC) {
+      i++;
+      continue;
+    }
+    ws_json_text(ws, out, data + text, i - text);
+
+    // a subnegotiation runs until IAC SE. Anything else is two or three bytes
+    if(i + 2 < len && (unsigned char) data[i+1] == SB) {
+      int end = i + 3;
+      while(end + 1 < len && !((unsigned char) data[end] == IAC &&
+			       (unsigned char) data[end+1] == SE))
+	end += ((unsigned char) data[end] == IAC ? 2 : 1);
+      if((unsigned char) data[i+2] == TELOPT_GMCP && end + 1 < len)
+	ws_json_gmcp(ws, out, data + i + 3, end - i - 3);
+      i = end + 2;
+    }
+    else if(i + 1 < len && (unsigned char) data[i+1] >= WILL &&
+	    (unsigned char) data[i+1] <= DONT)
+      i += 3;
+    else
+      i += 2;
+    text = i;
+  }
+  if(text < len)
+    ws_json_text(ws, out, data + text, len - text);
+}
+
+//
+// start sending a client the close it asked for, or one for what it did.
+// Returns FALSE, so errors can be closed on with one return
+bool ws_close(WS_CONN *ws, int code) {
+  wsFrameClose(ws, ws->reply, code);
+  ws->state = WS_STATE_CLOSED;
+  return FALSE;
+}
+
+//
+// refuse an upgrade request, with an HTTP status line (e.g. 400 Bad Request)
+bool ws_refuse(WS_CONN *ws, const char *status) {
+  bprintf(ws->reply, "HTTP/1.1 %s\r\n"
+	  "Sec-WebSocket-Version: 13\r\n"
+	  "Connection: close\r\n"
+	  "Content-Length: 0\r\n\r\n", status);
+  ws->state = WS_STATE_CLOSED;
+  return FALSE;
+}
+
+//
+// look through the extensions a client offered for permessage-deflate, and
+// if we'll use it, set it up. Appends what we agreed to to reply
+void ws_negotiate_deflate(WS_CONN *ws, const char *offers, BUFFER *reply) {
+  char *copy = strdup(offers), *next = copy, *offer = NULL;
+
+  // each offer is the extension's name, followed by its parameters
+  while(ws->deflate == NULL && (offer = strsep(&next, ",")) != NULL) {
+    char *param = NULL, *name = ws_trim(strsep(&offer, ";"));
+    bool server_reset = FALSE, client_reset = FALSE, ok = TRUE;
+    int   server_bits = 15;
+    if(strcasecmp(name, "permessage-deflate"))
+      continue;
+
+    while(ok && (param = strsep(&offer, ";")) != NULL) {
+      char *val = strchr(param, '=');
+      if(val != NULL) {
+	*val++ = '\0';
+	val = ws_trim(val);
+	if(*val == '"')
+	  val++;
+      }
+      param = ws_trim(param);
+      if(!strcasecmp(param, "server_no_context_takeover"))
+	server_reset = TRUE;
+      else if(!strcasecmp(param, "client_no_context_takeover"))
+	client_reset = TRUE;
+      // zlib can't make its window any smaller than 2^9
+      else if(!strcasecmp(param, "server_max_window_bits"))
+	ok = (val != NULL && (server_bits = atoi(val)) >= 9 &&
+	      server_bits <= 15);
+      // we can inflate anything up to 2^15, so the client can use what it likes
+      else if(strcasecmp(param, "client_max_window_bits"))
+	ok = FALSE;
+    }
+    if(!ok)
+      continue;
+
+    ws->deflate = ws_new_zstream(TRUE, server_bits);
+    ws->inflate = ws_new_zstream(FALSE, 15);
+    if(ws->deflate == NULL || ws->inflate == NULL) {
+      if(ws->deflate) { deflateEnd(ws->deflate); free(ws->deflate); }
+      if(ws->inflate) { inflateEnd(ws->inflate); free(ws->inflate); }
+      ws->deflate = ws->inflate = NULL;
+      break;
+    }
+    ws->deflate_reset = server_reset;
+    ws->inflate_reset = client_reset;
+    bufferCat(reply, "Sec-WebSocket-Extensions: permessage-deflate");
+    if(server_reset)
+      bufferCat(reply, "; server_no_context_takeover");
+    if(client_reset)
+      bufferCat(reply, "; client_no_context_takeover");
+    if(server_bits != 15)
+      bprintf(reply, "; server_max_window_bits=%d", server_bits);
+    bufferCat(reply, "\r\n");
+  }
+  free(copy);
+}
+
+//
+// read the client's request to upgrade, once it's all here, and answer it.
+// Returns FALSE if we've refused it
+bool ws_handshake(WS_CONN *ws) {
+  char *request = ws->rx + ws->rx_start, *end = NULL, *line = NULL;
+  char *key = NULL, *version = NULL, *upgrade = NULL, *connection = NULL;
+  char *protocols = NULL, *extensions = NULL;
+
+  ws->rx[ws->rx_len] = '\0';
+  if((end = strstr(request, "\r\n\r\n")) == NULL) {
+    if(ws->rx_len - ws->rx_start >= WS_MAX_REQUEST)
+      return ws_refuse(ws, "431 Request Header Fields Too Large");
+    return TRUE;
+  }
+  *end = '\0';
+  ws->rx_start = end + 4 - ws->rx;
+
+  // GET <path> HTTP/1.1, followed by our headers
+  line = strsep(&request, "\r\n");
+  if(strncmp(line, "GET ", 4))
+    return ws_refuse(ws, "405 Method Not Allowed");
+  while((line = strsep(&request, "\n")) != NULL) {
+    char *val = strchr(line, ':');
+    if(val == NULL)
+      continue;
+    *val++ = '\0';
+    val = ws_trim(val);
+    if(*val && val[strlen(val) - 1] == '\r')
+      val[strlen(val) - 1] = '\0';
+    line = ws_trim(line);
+    if(!strcasecmp(line, "Sec-WebSocket-Key"))             key        = val;
+    else if(!strcasecmp(line, "Sec-WebSocket-Version"))    version    = val;
+    else if(!strcasecmp(line, "Upgrade"))                  upgrade    = val;
+    else if(!strcasecmp(line, "Connection"))               connection = val;
+    else if(!strcasecmp(line, "Sec-WebSocket-Protocol"))   protocols  = val;
+    else if(!strcasecmp(line, "Sec-WebSocket-Extensions")) extensions = val;
+  }
+
+  if(upgrade == NULL || !ws_has_token(upgrade, "websocket") ||
+     connection == NULL || !ws_has_token(connection, "upgrade") ||
+     key == NULL || strlen(key) > 64)
+    return ws_refuse(ws, "400 Bad Request");
+  if(version == NULL || strcmp(version, "13"))
+    return ws_refuse(ws, "426 Upgrade Required");
+
+  // prove we read their key
+  char           salted[128], accept[64];
+  unsigned char  digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_len = 0;
+  snprintf(salted, sizeof(salted), "%s%s", key, WS_GUID);
+  if(EVP_Digest(salted, strlen(salted), digest, &digest_len, EVP_sha1(),
+		NULL) != 1)
+    return ws_refuse(ws, "500 Internal Server Error");
+  EVP_EncodeBlock((unsigned char *) accept, digest, digest_len);
+
+  bprintf(ws->reply, "HTTP/1.1 101 Switching Protocols\r\n"
+	  "Upgrade: websocket\r\n"
+	  "Connection: Upgrade\r\n"
+	  "Sec-WebSocket-Accept: %s\r\n", accept);
+  if(protocols != NULL && ws_has_token(protocols, WS_PROTOCOL_JSON)) {
+    ws->json = TRUE;
+    bufferCat(ws->reply, "Sec-WebSocket-Protocol: "WS_PROTOCOL_JSON"\r\n");
+  }
+  else if(protocols != NULL && ws_has_token(protocols, WS_PROTOCOL_TELNET))
+    bufferCat(ws->reply, "Sec-WebSocket-Protocol: "WS_PROTOCOL_TELNET"\r\n");
+  if(extensions != NULL && mudsettingGetBool("ws_deflate"))
+    ws_negotiate_deflate(ws, extensions, ws->reply);
+  bufferCat(ws->reply, "\r\n");
+  ws->state = WS_STATE_OPEN;
+
+  // JSON clients get GMCP without having to negotiate for it; it's as if
+  // they'd asked for it before anything else
+  if(ws->json) {
+    bufferCatCh(ws->ready, (char) IAC);
+    bufferCatCh(ws->ready, (char) DO);
+    bufferCatCh(ws->ready, (char) TELOPT_GMCP);
+  }
+  return TRUE;
+}
+
+//
+// how long the frame at the front of what we've read is, if all of it is
+// here. 0 if it isn't yet. Sets the length of its header and payload
+long long ws_frame_size(WS_CONN *ws, int *header, long long *len) {
+  const unsigned char *p = (unsigned char *) ws->rx + ws->rx_start;
+  int               have = ws->rx_len - ws->rx_start, i;
+  if(have < 2)
+    return 0;
+  *len    = p[1] & 0x7F;
+  *header = 2;
+  if(*len == 126) {
+    if(have < 4)
+      return 0;
+    *len    = (p[2] << 8) | p[3];
+    *header = 4;
+  }
+  else if(*len == 127) {
+    if(have < 10)
+      return 0;
+    for(*len = 0, i = 2; i < 10; i++)
+      *len = (*len << 8) | p[i];
+    *header = 10;
+  }
+  if(p[1] & WS_MASKED)
+    *header += 4;
+  // too big to ever fit. Say it's here, so it gets refused
+  if(*len < 0 || *len > WS_MAX_MESSAGE)
+    return 1;
+  return (have >= *header + *len ? *header + *len : 0);
+}
+
+//
+// a whole message has come in. Put what's in it with our decoded input
+bool ws_message_done(WS_CONN *ws) {
+  if(ws->msg_deflated) {
+    unsigned char chunk[MAX_BUFFER];
+    int ret = Z_OK, made = 0;
+    bufferCatLen(ws->msg, (const char *) ws_deflate_tail,
+		 sizeof(ws_deflate_tail));
+    ws->inflate->next_in  = (unsigned char *) bufferString(ws->msg);
+    ws->inflate->avail_in = bufferLength(ws->msg);
+    do {
+      ws->inflate->next_out  = chunk;
+      ws->inflate->avail_out = sizeof(chunk);
+      ret = inflate(ws->inflate, Z_SYNC_FLUSH);
+      if(ret != Z_OK && ret != Z_BUF_ERROR)
+	return ws_close(ws, WS_CLOSE_BAD_DATA);
+      made += sizeof(chunk) - ws->inflate->avail_out;
+      if(made > WS_MAX_MESSAGE)
+	return ws_close(ws, WS_CLOSE_TOO_BIG);
+      bufferCatLen(ws->ready, (char *) chunk,
+		   sizeof(chunk) - ws->inflate->avail_out);
+    } while(ws->inflate->avail_out == 0 || ws->inflate->avail_in > 0);
+    if(ws->inflate_reset)
+      inflateReset(ws->inflate);
+  }
+  else
+    bufferCatLen(ws->ready, bufferString(ws->msg), bufferLength(ws->msg));
+
+  // a text message is a line, whether or not the client ended it
+  if(ws->msg_op == WS_OP_TEXT && bufferLength(ws->ready) > ws->ready_start &&
+     bufferString(ws->ready)[bufferLength(ws->ready) - 1] != '\n')
+    bufferCatCh(ws->ready, '\n');
+
+  bufferClear(ws->msg);
+  ws->msg_op = -1;
+  return TRUE;
+}
+
+//
+// decode the frame at the front of what we've read, if all of it is here.
+// Returns 1 if there was one, 0 if it isn't all here, and -1 if the
+// connection is over
+int ws_next_frame(WS_CONN *ws) {
+  long long len = 0;
+  int    header = 0, i;
+  if(ws_frame_size(ws, &header, &len) == 0)
+    return 0;
+
+  unsigned char   *p = (unsigned char *) ws->rx + ws->rx_start;
+  int             op = p[0] & 0x0F;
+  bool           fin = (p[0] & WS_FIN) != 0;
+  bool      deflated = (p[0] & WS_RSV1) != 0;
+  unsigned char *mask = p + header - 4;
+  char      *payload = (char *) p + header;
+
+  // clients must mask what they send us, and can only use RSV1 to say the
+  // first frame of a message is compressed, if we've agreed to compression
+  if(len > WS_MAX_MESSAGE)
+    return (ws_close(ws, WS_CLOSE_TOO_BIG) ? 1 : -1);
+  if(!(p[1] & WS_MASKED) || (p[0] & WS_RSVS & ~WS_RSV1) ||
+     (deflated && (ws->inflate == NULL || op == WS_OP_CONT || op >= 0x8)) ||
+     (op >= 0x8 && (!fin || len > 125)))
+    return (ws_close(ws, WS_CLOSE_PROTOCOL) ? 1 : -1);
+  for(i = 0; i < len; i++)
+    payload[i] ^= mask[i % 4];
+  ws->rx_start += header + len;
+
+  switch(op) {
+  case WS_OP_PING:
+    ws_frame_header(ws->reply, WS_FIN | WS_OP_PONG, len);
+    bufferCatLen(ws->reply, payload, len);
+    return 1;
+  case WS_OP_PONG:
+    return 1;
+  case WS_OP_CLOSE:
+    // answer with the code they closed with
+    return (ws_close(ws, (len >= 2 ? ((unsigned char) payload[0] << 8) |
+			  (unsigned char) payload[1] : WS_CLOSE_NORMAL)) ? 1:-1);
+  case WS_OP_TEXT:
+  case WS_OP_BINARY:
+    if(ws->msg_op != -1)
+      return (ws_close(ws, WS_CLOSE_PROTOCOL) ? 1 : -1);
+    ws->msg_op       = op;
+    ws->msg_deflated = deflated;
+    break;
+  case WS_OP_CONT:
+    if(ws->msg_op == -1)
+      return (ws_close(ws, WS_CLOSE_PROTOCOL) ? 1 : -1);
+    break;
+  default:
+    return (ws_close(ws, WS_CLOSE_PROTOCOL) ? 1 : -1);
+  }
+
+  if(bufferLength(ws->msg) + len > WS_MAX_MESSAGE)
+    return (ws_close(ws, WS_CLOSE_TOO_BIG) ? 1 : -1);
+  bufferCatLen(ws->msg, payload, len);
+  if(fin && !ws_message_done(ws))
+    return -1;
+  return 1;
+}
+
+
+
+//*****************************************************************************
+// implementation of websocket.h
+//*****************************************************************************
+WS_CONN *newWsConn(void) {
+  WS_CONN *ws = calloc(1, sizeof(WS_CONN));
+  ws->rx_size = WS_RX_START_SIZE;
+  ws->rx      = malloc(ws->rx_size + 1);
+  ws->ready   = newBuffer(SMALL_BUFFER);
+  ws->msg     = newBuffer(SMALL_BUFFER);
+  ws->reply   = newBuffer(SMALL_BUFFER);
+  ws->msg_op  = -1;
+  if(ws_scratch == NULL)
+    ws_scratch = newBuffer(MAX_BUFFER);
+  return ws;
+}
+
+void deleteWsConn(WS_CONN *ws) {
+  if(ws->deflate) {
+    deflateEnd(ws->deflate);
+    free(ws->deflate);
+  }
+  if(ws->inflate) {
+    inflateEnd(ws->inflate);
+    free(ws->inflate);
+  }
+  if(ws->held) deleteBuffer(ws->held);
+  deleteBuffer(ws->ready);
+  deleteBuffer(ws->msg);
+  deleteBuffer(ws->reply);
+  free(ws->rx);
+  free(ws);
+}
+
+char *wsReadBuf(WS_CONN *ws, int *room) {
+  // move what's left to the front, and make room for a whole frame
+  if(ws->rx_start > 0) {
+    memmove(ws->rx, ws->rx + ws->rx_start, ws->rx_len - ws->rx_start);
+    ws->rx_len  -= ws->rx_start;
+    ws->rx_start = 0;
+  }
+  if(ws->rx_len == ws->rx_size &&
+     ws->rx_size < WS_MAX_MESSAGE + WS_MAX_HEADER) {
+    ws->rx_size = UMIN(ws->rx_size * 2, WS_MAX_MESSAGE + WS_MAX_HEADER);
+    ws->rx      = realloc(ws->rx, ws->rx_size + 1);
+  }
+  *room = ws->rx_size - ws->rx_len;
+  return ws->rx + ws->rx_len;
+}
+
+void wsReadDone(WS_CONN *ws, int len) {
+  ws->rx_len += len;
+}
+
+int wsDecode(WS_CONN *ws, const struct iovec *iov, int iovcnt) {
+  int total = 0, i = 0, filled = 0;
+
+  if(ws->state == WS_STATE_HANDSHAKE && !ws_handshake(ws))
+    return WS_CLOSED;
+  if(ws->state == WS_STATE_HANDSHAKE)
+    return 0;
+
+  while(i < iovcnt) {
+    int have = bufferLength(ws->ready) - ws->ready_start;
+    if(have > 0) {
+      int take = UMIN(have, (int) iov[i].iov_len - filled);
+      memcpy((char *) iov[i].iov_base + filled,
+	     bufferString(ws->ready) + ws->ready_start, take);
+      ws->ready_start += take;
+      filled          += take;
+      total           += take;
+      if(filled == (int) iov[i].iov_len) {
+	i++;
+	filled = 0;
+      }
+      if(ws->ready_start == bufferLength(ws->ready)) {
+	bufferClear(ws->ready);
+	ws->ready_start = 0;
+      }
+    }
+    else if(ws->state != WS_STATE_OPEN || ws_next_frame(ws) <= 0)
+      break;
+  }
+
+  // hand back what we got before they closed, and tell them next time
+  if(total == 0 && ws->state == WS_STATE_CLOSED)
+    return WS_CLOSED;
+  return total;
+}
+
+bool wsPending(WS_CONN *ws) {
+  long long len = 0;
+  int    header = 0;
+  if(ws->state == WS_STATE_HANDSHAKE)
+    return FALSE;
+  return (bufferLength(ws->ready) > ws->ready_start ||
+	  (ws->state == WS_STATE_OPEN && ws_frame_size(ws, &header, &len) > 0));
+}
+
+bool wsTakeReply(WS_CONN *ws, BUFFER *out) {
+  if(bufferLength(ws->reply) == 0)
+    return FALSE;
+  bufferCatLen(out, bufferString(ws->reply), bufferLength(ws->reply));
+  bufferClear(ws->reply);
+  return TRUE;
+}
+
+bool wsIsOpen(WS_CONN *ws) {
+  return (ws->state == WS_STATE_OPEN);
+}
+
+bool wsIsJSON(WS_CONN *ws) {
+  return ws->json;
+}
+
+bool wsHold(WS_CONN *ws, const struct iovec *iov, int iovcnt) {
+  int i;
+  if(ws->held == NULL)
+    ws->held = newBuffer(SMALL_BUFFER);
+  for(i = 0; i < iovcnt; i++) {
+    if(bufferLength(ws->held) + (int) iov[i].iov_len > OUTPUT_HIGH_WATER)
+      return FALSE;
+    bufferCatLen(ws->held, iov[i].iov_base, iov[i].iov_len);
+  }
+  return TRUE;
+}
+
+BUFFER *wsTakeHeld(WS_CONN *ws) {
+  BUFFER *held = ws->held;
+  ws->held = NULL;
+  return held;
+}
+
+void wsFrame(WS_CONN *ws, BUFFER *out, const struct iovec *iov, int iovcnt) {
+  int i;
+  if(!ws->json) {
+    ws_frame_message(ws, out, WS_OP_BINARY, iov, iovcnt);
+    return;
+  }
+  // telnet sequences don't span what's sent at once, but can span segments
+  if(iovcnt == 1)
+    ws_frame_telnet_json(ws, out, iov[0].iov_base, iov[0].iov_len);
+  else {
+    BUFFER *flat = newBuffer(SMALL_BUFFER);
+    for(i = 0; i < iovcnt; i++)
+      bufferCatLen(flat, iov[i].iov_base, iov[i].iov_len);
+    ws_frame_telnet_json(ws, out, bufferString(flat), bufferLength(flat));
+    deleteBuffer(flat);
+  }
+}
+
+void wsFrameJSON(WS_CONN *ws, BUFFER *out, const char *key,
+		 const struct iovec *iov, int iovcnt) {
+  struct iovec msg;
+  int i;
+  bufferClear(ws_scratch);
+  bprintf(ws_scratch, "{\"%s\":\"", key);
+  for(i = 0; i < iovcnt; i++)
+    ws_json_escape(ws_scratch, iov[i].iov_base, iov[i].iov_len, FALSE);
+  bufferCat(ws_scratch, "\"}");
+  msg.iov_base = (void *) bufferString(ws_scratch);
+  msg.iov_len  = bufferLength(ws_scratch);
+  ws_frame_message(ws, out, WS_OP_TEXT, &msg, 1);
+}
+
+void wsFrameClose(WS_CONN *ws, BUFFER *out, int code) {
+  // once a close has gone out, nothing else can
+  if(ws->state != WS_STATE_OPEN)
+    return;
+  ws_frame_header(out, WS_FIN | WS_OP_CLOSE, 2);
+  bufferCatCh(out, (char) (code >> 8));
+  bufferCatCh(out, (char) code);
+  ws->state = WS_STATE_CLOSED;
+}
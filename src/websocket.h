@@ -0,0 +1,98 @@
+#ifndef __WEBSOCKET_H
+#define __WEBSOCKET_H
+//*****************************************************************************
+//
+// websocket.h
+//
+// WebSockets (RFC 6455) for the ports in ws_ports and wss_ports (the latter
+// over TLS), so web clients can connect to us without a proxy. A connection
+// starts as an HTTP request to upgrade, and after that, everything either way
+// is framed. The frames go in and out of a socket's usual buffers: what
+// clients send is unframed into its inbuf, and what we send it is framed on
+// its way out, so the telnet pipeline runs just as it does for everyone else.
+//
+// Clients pick what they are sent by the subprotocol they ask for:
+//   telnet          (or none) binary frames, holding the same stream of text,
+//                   ANSI colour and telnet negotiation a telnet client gets
+//   nakedmud.json   text frames, each one JSON object: {"text": html},
+//                   {"prompt": html}, or {"gmcp": package, "data": json}.
+//                   Colour codes are turned into HTML (see colour.h), and
+//                   GMCP is on without being negotiated
+// Either way, text frames from the client are lines of input, and binary
+// frames are a telnet stream, for clients that want to negotiate themselves.
+//
+// If the client offers it, and ws_deflate is set, messages are compressed
+// with permessage-deflate (RFC 7692). Unless the client asks otherwise, each
+// side keeps its compression window from one message to the next, so text
+// that repeats (room descriptions, prompts) is sent as a back-reference to
+// the last time it was.
+//
+//*****************************************************************************
+
+#include <sys/uio.h>
+
+typedef struct ws_conn WS_CONN;
+
+// what wsDecode returns when the connection is over
+#define WS_CLOSED             -1
+
+// close codes, for wsFrameClose
+#define WS_CLOSE_NORMAL     1000
+#define WS_CLOSE_GOING_AWAY 1001
+
+WS_CONN *newWsConn(void);
+void  deleteWsConn(WS_CONN *ws);
+
+//
+// where bytes read off the socket go, and how many will fit. Once they've
+// been read, say how many there were with wsReadDone
+char *wsReadBuf(WS_CONN *ws, int *room);
+void wsReadDone(WS_CONN *ws, int len);
+
+//
+// decode as much of what's been read as fits in iov. While the handshake is
+// going, that's nothing. Returns how many bytes of input were decoded, or
+// WS_CLOSED if the client closed the connection or broke the protocol
+int wsDecode(WS_CONN *ws, const struct iovec *iov, int iovcnt);
+
+//
+// is there input read or decoded that wsDecode hasn't handed back yet?
+bool wsPending(WS_CONN *ws);
+
+//
+// append what has to go out on the socket exactly as it is (our answer to
+// the handshake, pongs, closes) to out. Returns FALSE if there was nothing
+bool wsTakeReply(WS_CONN *ws, BUFFER *out);
+
+//
+// has the handshake finished? Did the client ask for nakedmud.json?
+bool wsIsOpen(WS_CONN *ws);
+bool wsIsJSON(WS_CONN *ws);
+
+//
+// hold on to output made before the handshake finished. Returns FALSE if
+// there's more than a client is allowed to have waiting
+bool wsHold(WS_CONN *ws, const struct iovec *iov, int iovcnt);
+
+//
+// once the handshake has finished, hand back what wsHold held on to, for the
+// caller to send and delete. NULL if there was nothing
+BUFFER *wsTakeHeld(WS_CONN *ws);
+
+//
+// append iov to out as one message: a binary frame for telnet clients, and
+// for JSON clients, the text and GMCP in it as JSON objects (other telnet
+// negotiation means nothing to them, and is dropped)
+void wsFrame(WS_CONN *ws, BUFFER *out, const struct iovec *iov, int iovcnt);
+
+//
+// append a JSON object holding one string, made from iov, to out as a text
+// frame (e.g. {"text": "..."})
+void wsFrameJSON(WS_CONN *ws, BUFFER *out, const char *key,
+		 const struct iovec *iov, int iovcnt);
+
+//
+// append a frame closing the connection to out
+void wsFrameClose(WS_CONN *ws, BUFFER *out, int code);
+
+#endif // __WEBSOCKET_H
@@ -0,0 +1,210 @@
+//*****************************************************************************
+//
+// worker_pool.c
+//
+// a pool of threads that run jobs handed to them by the game thread. See
+// worker_pool.h for the rules on what jobs may do. Waiting jobs are kept in
+// a simple linked queue, protected by the pool's mutex. Every pool is kept in
+// a list of its own, so that all their mutexes can be held while we fork.
+//
+//*****************************************************************************
+
+#include <pthread.h>
+
+#include "mud.h"
+#include "utils.h"
+#include "worker_pool.h"
+
+typedef struct worker_job WORKER_JOB;
+struct worker_job {
+  void (* func)(void *data);
+  void      *data;
+  WORKER_JOB *next;
+};
+
+struct worker_pool {
+  char             *name;
+  pthread_t     *threads;
+  int       num_threads;
+  pthread_mutex_t  lock;
+  pthread_cond_t  ready; // signalled when a job is added, or we're stopping
+  pthread_cond_t   idle; // signalled when the last running job finishes
+  WORKER_JOB      *head; // the next job to run
+  WORKER_JOB      *tail; // the last job
+  int       num_pending;
+  int       num_running;
+  bool         stopping;
+  WORKER_POOL     *next; // the next pool in all_pools
+};
+
+// every pool that has been made and not deleted yet
+pthread_mutex_t   pools_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_once_t    pools_once = PTHREAD_ONCE_INIT;
+WORKER_POOL       *all_pools = NULL;
+
+
+
+//*****************************************************************************
+// local functions
+//*****************************************************************************
+
+//
+// if another thread forks while one of our workers holds its pool's lock, the
+// child could never use the pool. Hold all of them while forking
+void worker_pool_atfork_prepare(void) {
+  WORKER_POOL *pool;
+  pthread_mutex_lock(&pools_lock);
+  for(pool = all_pools; pool != NULL; pool = pool->next)
+    pthread_mutex_lock(&pool->lock);
+}
+
+void worker_pool_atfork_release(void) {
+  WORKER_POOL *pool;
+  for(pool = all_pools; pool != NULL; pool = pool->next)
+    pthread_mutex_unlock(&pool->lock);
+  pthread_mutex_unlock(&pools_lock);
+}
+
+void worker_pool_init_atfork(void) {
+  pthread_atfork(worker_pool_atfork_prepare, worker_pool_atfork_release,
+		 worker_pool_atfork_release);
+}
+
+//
+// the loop each of our worker threads runs: wait for a job, run it, repeat.
+// When we're stopping, the threads finish whatever jobs are left first
+void *worker_pool_loop(void *arg) {
+  WORKER_POOL *pool = arg;
+  WORKER_JOB   *job = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  for(;;) {
+    while(pool->head == NULL && !pool->stopping)
+      pthread_cond_wait(&pool->ready, &pool->lock);
+    if(pool->head == NULL)
+      break;
+
+    job        = pool->head;
+    pool->head = job->next;
+    if(pool->head == NULL)
+      pool->tail = NULL;
+    pool->num_pending--;
+    pool->num_running++;
+
+    pthread_mutex_unlock(&pool->lock);
+    job->func(job->data);
+    free(job);
+    pthread_mutex_lock(&pool->lock);
+
+    pool->num_running--;
+    if(pool->num_running == 0 && pool->head == NULL)
+      pthread_cond_broadcast(&pool->idle);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+
+
+//*****************************************************************************
+// implementation of worker_pool.h
+//*****************************************************************************
+WORKER_POOL *newWorkerPool(const char *name, int threads) {
+  WORKER_POOL *pool = calloc(1, sizeof(WORKER_POOL));
+  int i;
+
+  pool->name    = strdupsafe(name);
+  pool->threads = calloc(MAX(threads, 1), sizeof(pthread_t));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->ready, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+
+  pthread_once(&pools_once, worker_pool_init_atfork);
+  pthread_mutex_lock(&pools_lock);
+  pool->next = all_pools;
+  all_pools  = pool;
+  pthread_mutex_unlock(&pools_lock);
+
+  for(i = 0; i < threads; i++) {
+    if(pthread_create(&pool->threads[i], NULL, worker_pool_loop, pool) != 0){
+      log_string("Could only start %d of %d threads for the %s worker pool.",
+		 i, threads, pool->name);
+      break;
+    }
+    pool->num_threads++;
+  }
+
+  if(pool->num_threads == 0) {
+    deleteWorkerPool(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+void deleteWorkerPool(WORKER_POOL *pool) {
+  WORKER_POOL **prev;
+  int i;
+  pthread_mutex_lock(&pools_lock);
+  for(prev = &all_pools; *prev != NULL; prev = &(*prev)->next) {
+    if(*prev == pool) {
+      *prev = pool->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&pools_lock);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = TRUE;
+  pthread_cond_broadcast(&pool->ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(i = 0; i < pool->num_threads; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->ready);
+  pthread_cond_destroy(&pool->idle);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool->name);
+  free(pool);
+}
+
+void workerPoolAdd(WORKER_POOL *pool, void *func, void *data) {
+  WORKER_JOB *job = malloc(sizeof(WORKER_JOB));
+  job->func = func;
+  job->data = data;
+  job->next = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  if(pool->tail != NULL)
+    pool->tail->next = job;
+  else
+    pool->head = job;
+  pool->tail = job;
+  pool->num_pending++;
+  pthread_cond_signal(&pool->ready);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void workerPoolWait(WORKER_POOL *pool) {
+  pthread_mutex_lock(&pool->lock);
+  while(pool->head != NULL || pool->num_running > 0)
+    pthread_cond_wait(&pool->idle, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+int workerPoolGetSize(WORKER_POOL *pool) {
+  return pool->num_threads;
+}
+
+int workerPoolGetPending(WORKER_POOL *pool) {
+  int pending;
+  pthread_mutex_lock(&pool->lock);
+  pending = pool->num_pending;
+  pthread_mutex_unlock(&pool->lock);
+  return pending;
+}
+
+const char *workerPoolGetName(WORKER_POOL *pool) {
+  return pool->name;
+}
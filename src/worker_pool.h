@@ -0,0 +1,52 @@
+#ifndef __WORKER_POOL_H
+#define __WORKER_POOL_H
+//*****************************************************************************
+//
+// worker_pool.h
+//
+// a pool of threads that run jobs handed to them by the game thread. Jobs are
+// queued up and run in the order they were added, by whichever worker is free
+// first; jobs that must not run at the same time as each other (e.g. two
+// jobs for the same socket) need to be kept apart by whoever adds them.
+//
+// Workers must NEVER touch Python, hooks, or anything else that is not safe
+// to use outside the game thread. Jobs should work on data they have been
+// given exclusive use of, and hand their results back through something
+// thread-safe (see spsc_queue.h).
+//
+//*****************************************************************************
+
+typedef struct worker_pool WORKER_POOL;
+
+//
+// create a new pool with the given number of worker threads. Returns NULL if
+// the threads could not be started
+WORKER_POOL *newWorkerPool(const char *name, int threads);
+
+//
+// finish all the jobs waiting in the pool, then stop its threads and delete it
+void deleteWorkerPool(WORKER_POOL *pool);
+
+//
+// queue up a job. func will be called with data as its only argument, from
+// one of the pool's threads
+void workerPoolAdd(WORKER_POOL *pool, void *func, void *data);
+
+//
+// wait until every job that has been added to the pool has finished. Jobs
+// must not add more jobs to the pool while someone is waiting
+void workerPoolWait(WORKER_POOL *pool);
+
+//
+// return the number of threads in the pool
+int workerPoolGetSize(WORKER_POOL *pool);
+
+//
+// return the number of jobs that are waiting for a free worker
+int workerPoolGetPending(WORKER_POOL *pool);
+
+//
+// return the name the pool was created with
+const char *workerPoolGetName(WORKER_POOL *pool);
+
+#endif // __WORKER_POOL_H
@@ -7,13 +7,31 @@
 //*****************************************************************************
 
 #include <sys/stat.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <sys/syscall.h>
 
 #include "mud.h"
 #include "utils.h"
 #include "zone.h"
 #include "storage.h"
 #include "prototype.h"
+#include "room.h"
+#include "handler.h"
+#include "pulse.h"
+#include "worker_pool.h"
+#include "save_queue.h"
+#include "character.h"
+#include "exit.h"
+#include "object.h"
+#include "event.h"
+#include "room_reset.h"
+#include "hooks.h"
+#include "intern.h"
 #include "world.h"
+#include "scripts/scripts.h"
 
 
 
@@ -23,6 +41,9 @@
 #ifdef MODULE_PERSISTENT
 #include "persistent/persistent.h"
 #endif
+#ifdef MODULE_DYN_VARS
+#include "dyn_vars/dyn_vars.h"
+#endif
 
 
 
@@ -49,8 +70,74 @@ struct world_data {
   HASHTABLE      *rooms; // this table is a communal table for rooms. Used for
   HASHTABLE *type_table; // types, and their functions
   HASHTABLE      *zones; // a table of all the zones we have
+
+  // zones are spread out across the minute between zone pulses, so they
+  // don't all pulse (and reset) on the same game pulse
+  LIST    **zone_slots; // the zones that pulse on each game pulse
+  int    num_zone_slots; // how many pulses long our minute is
+  bool zone_slots_dirty; // have zones been added or removed since we built?
+  int        zone_phase; // which slot we pulse next
+  LIST  *pending_resets; // keys of zones waiting for their turn to reset
+  int       flush_pulse; // pulses since we last wrote out dirty entries
+
+  // entries being read in ahead of when they are wanted
+  HASHTABLE *prefetching; // "type key" of every entry we're prefetching
+  LIST   *prefetch_queue; // files to parse in the pulse, if we have no pool
+  WORKER_POOL *prefetch_pool;
+  bool      prefetch_tried; // have we tried making our pool yet?
+
+  // every key that has been resolved, so it only ever needs to be once
+  HASHTABLE        *keys; // full key -> WORLD_KEY
+  int    key_generation; // goes up whenever a zone is added or removed
+
+  // rooms nothing is using are unloaded after a while, and made again from
+  // their prototypes when they are next wanted
+  HASHTABLE  *idle_rooms; // room key -> when we first saw it with nothing in it
+  HASHTABLE *evicted_rooms; // keys of the rooms we have unloaded
+  int         idle_pulse; // pulses since we last looked for idle rooms
+  int      rooms_evicted; // how many rooms have been unloaded for being idle
+  int     rooms_reloaded; // and how many of those have been made again
+
+  // a full save, being written by a child we forked, from its copy of us
+  pid_t         save_pid; // the child, or 0 if there isn't one
+  long long   save_start; // when it was forked
+  LIST       *save_dirty; // "type key" of the dirty entries it's writing
 };
 
+//
+// a key, split into its name and locale, and the zone it belongs to. Keys are
+// kept until the world is deleted, so anyone can hold on to one
+struct world_key {
+  const char  *key; // the full key, name@locale. All of these are interned
+  const char *name;
+  const char *locale;
+  ZONE_DATA  *zone;
+  int   generation; // the world's key generation when we found our zone
+};
+
+//
+// the zone a key belongs to. Zones can come and go, so if any have since we
+// last looked, look again
+ZONE_DATA *world_key_zone(WORLD_DATA *world, WORLD_KEY *wkey) {
+  if(wkey->generation != world->key_generation) {
+    wkey->zone       = hashGet(world->zones, wkey->locale);
+    wkey->generation = world->key_generation;
+  }
+  return wkey->zone;
+}
+
+//
+// resolve a key and find its zone. Returns NULL if there is none
+ZONE_DATA *world_resolve_zone(WORLD_DATA *world, const char *key,
+			      WORLD_KEY **wkey) {
+  *wkey = worldResolveKey(world, key);
+  return (*wkey ? world_key_zone(world, *wkey) : NULL);
+}
+
+// files our prefetch workers have parsed, waiting for the game thread
+pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+LIST          *prefetch_done = NULL;
+
 WORLD_TYPE_DATA *newWorldTypeData(void *reader, void *storer, void *deleter,
 				  void *keysetter, bool forgetful) {
   WORLD_TYPE_DATA *data = malloc(sizeof(WORLD_TYPE_DATA));
@@ -66,6 +153,178 @@ void deleteWorldTypeData(WORLD_TYPE_DATA *data) {
   free(data);
 }
 
+//
+// a file that is parsed on a worker thread while the world boots. The main
+// thread makes zones and type entries out of it once every file is parsed
+typedef struct {
+  char        *zone; // the zone the file belongs to
+  char        *type; // the type of the entry in it, or NULL for the zone file
+  char         *key; // the entry's key within its zone
+  char        *path;
+  STORAGE_SET  *set; // what was parsed out of the file
+} BOOT_FILE;
+
+BOOT_FILE *newBootFile(const char *zone, const char *type, const char *key,
+		       const char *path) {
+  BOOT_FILE *file = malloc(sizeof(BOOT_FILE));
+  file->zone      = strdup(zone);
+  file->type      = (type ? strdup(type) : NULL);
+  file->key       = strdup(key);
+  file->path      = strdup(path);
+  file->set       = NULL;
+  return file;
+}
+
+void deleteBootFile(BOOT_FILE *file) {
+  if(file->set)  storage_close(file->set);
+  if(file->type) free(file->type);
+  free(file->zone);
+  free(file->key);
+  free(file->path);
+  free(file);
+}
+
+//
+// the job our boot workers run. Parsing is plain C, and only touches the set
+// being made (and the shared key pool, which is locked)
+void boot_file_parse(BOOT_FILE *file) {
+  file->set = storage_read(file->path);
+}
+
+//
+// the job our prefetch workers run. Like boot_file_parse, but the file might
+// not exist, and the parsed file is handed back to the game thread
+void prefetch_file_parse(BOOT_FILE *file) {
+  if(file_exists(file->path))
+    boot_file_parse(file);
+  pthread_mutex_lock(&prefetch_lock);
+  listQueue(prefetch_done, file);
+  pthread_mutex_unlock(&prefetch_lock);
+}
+
+//
+// make entries out of the files that have been prefetched, unless someone
+// wanted them badly enough to load them in the meantime
+void world_prefetch_finish(WORLD_DATA *world) {
+  BOOT_FILE *file = NULL;
+  char   pkey[MAX_BUFFER];
+
+  // with no pool, the files are parsed here, between commands
+  while((file = listPop(world->prefetch_queue)) != NULL)
+    prefetch_file_parse(file);
+
+  pthread_mutex_lock(&prefetch_lock);
+  LIST *done    = prefetch_done;
+  prefetch_done = newList();
+  pthread_mutex_unlock(&prefetch_lock);
+
+  while((file = listPop(done)) != NULL) {
+    ZONE_DATA *zone = hashGet(world->zones, file->zone);
+    if(zone != NULL && file->set != NULL &&
+       !zoneTypeLoaded(zone, file->type, file->key))
+      zoneReadType(zone, file->type, file->key, file->set);
+    snprintf(pkey, MAX_BUFFER, "%s %s", file->type,
+	     get_fullkey(file->key, file->zone));
+    hashRemove(world->prefetching, pkey);
+    deleteBootFile(file);
+  }
+  deleteList(done);
+}
+
+//
+// players moving about have the rooms next to them read in ahead of time, so
+// whoever walks into them next doesn't have to wait on the disk
+void world_prefetch_exits_hook(HOOK_ARGS *args) {
+  CHAR_DATA  *ch = NULL;
+  ROOM_DATA *room = NULL;
+  hookParseArgs(args, &ch, &room);
+  if(ch == NULL || room == NULL || charIsNPC(ch))
+    return;
+
+  LIST      *dirs = roomGetExitNames(room);
+  LIST_ITERATOR *dir_i = newListIterator(dirs);
+  char            *dir = NULL;
+  ITERATE_LIST(dir, dir_i) {
+    EXIT_DATA  *ex = roomGetExit(room, dir);
+    const char *to = (ex ? exitGetToFull(ex) : "");
+    if(*to && !worldRoomLoaded(gameworld, to)) {
+      worldPrefetchType(gameworld, "rproto", to);
+      worldPrefetchType(gameworld, "reset",  to);
+    }
+  } deleteListIterator(dir_i);
+  deleteListWith(dirs, free);
+}
+
+//
+// log how long a phase of booting the world took, and start timing the next
+void world_boot_phase(const char *phase, long long *started) {
+  long long now = pulse_clock();
+  log_string("World boot: %-26s %6lld ms", phase, (now - *started) / 1000);
+  *started = now;
+}
+
+//
+// parse the zone file and every type file of each zone on a pool of worker
+// threads. The files to parse are queued up from the main thread, and the
+// parsed files are added to the list, zone files first
+void world_boot_parse(WORLD_DATA *world, LIST *zone_keys, LIST *files,
+		      int threads) {
+  WORKER_POOL    *pool = newWorkerPool("boot", threads);
+  LIST_ITERATOR *key_i = newListIterator(zone_keys);
+  LIST     *type_files = newList();
+  BOOT_FILE      *file = NULL;
+  const char      *key = NULL;
+  char        path[MAX_BUFFER];
+
+  ITERATE_LIST(key, key_i) {
+    sprintf(path, "%s/zone", worldGetZonePath(world, key));
+    listQueue(files, newBootFile(key, NULL, key, path));
+
+    // every type the world knows about has a directory of entries
+    HASH_ITERATOR *type_i = newHashIterator(world->type_table);
+    const char       *type = NULL;
+    for(; (type = hashIteratorCurrentKey(type_i)) != NULL;
+	hashIteratorNext(type_i)) {
+      // only types that are loaded whole at boot are parsed ahead of time
+      if(zoneTypeResidency(type) != RESIDENCY_EAGER)
+	continue;
+      sprintf(path, "%s/%s", worldGetZonePath(world, key), type);
+      DIR *dir = opendir(path);
+      struct dirent *entry = NULL;
+      if(dir == NULL)
+	continue;
+      while((entry = readdir(dir)) != NULL) {
+	if(startswith(entry->d_name, "."))
+	  continue;
+	sprintf(path, "%s/%s/%s", worldGetZonePath(world, key), type,
+		entry->d_name);
+	listQueue(type_files, newBootFile(key, type, entry->d_name, path));
+      }
+      closedir(dir);
+    } deleteHashIterator(type_i);
+  } deleteListIterator(key_i);
+
+  while((file = listPop(type_files)) != NULL)
+    listQueue(files, file);
+  deleteList(type_files);
+
+  // without a pool, everything is parsed right here instead
+  LIST_ITERATOR *file_i = newListIterator(files);
+  ITERATE_LIST(file, file_i) {
+    if(pool != NULL)
+      workerPoolAdd(pool, boot_file_parse, file);
+    else
+      boot_file_parse(file);
+  } deleteListIterator(file_i);
+
+  if(pool != NULL) {
+    workerPoolWait(pool);
+    log_string("Parsed %d world files on %d threads.", listSize(files),
+	       workerPoolGetSize(pool));
+    deleteWorkerPool(pool);
+  }
+}
+
 
 //
 // transfers all of the types from the world to the zone
@@ -88,15 +347,66 @@ void world_types_to_zone_types(WORLD_DATA *world, ZONE_DATA *zone) {
 
 
 
+//
+// get rid of the lists of zones that pulse on each game pulse
+void world_clear_zone_slots(WORLD_DATA *world) {
+  int i;
+  for(i = 0; i < world->num_zone_slots; i++)
+    deleteList(world->zone_slots[i]);
+  if(world->zone_slots) free(world->zone_slots);
+  world->zone_slots     = NULL;
+  world->num_zone_slots = 0;
+}
+
+
+
 //*****************************************************************************
 // implementation of world.h
 //*****************************************************************************
+COMMAND(cmd_worldflush);
+COMMAND(cmd_worldsave);
+COMMAND(cmd_worldrooms);
+
+void init_world_flush(void) {
+  add_cmd("worldflush", NULL, cmd_worldflush, "admin", FALSE);
+  add_cmd("worldsave",  NULL, cmd_worldsave,  "admin", FALSE);
+}
+
+void init_world_rooms(void) {
+  add_cmd("worldrooms", NULL, cmd_worldrooms, "admin", FALSE);
+}
+
+void init_world_prefetch(void) {
+  prefetch_done = newList();
+  hookAddArgs("char_to_room", world_prefetch_exits_hook);
+}
+
 WORLD_DATA *newWorld(void) {
   WORLD_DATA *world = malloc(sizeof(WORLD_DATA));
   world->type_table = newHashtable();
   world->zones      = newHashtable();
   world->rooms      = newHashtableSize(SMALL_WORLD);
   world->path       = strdup("");
+  world->zone_slots = NULL;
+  world->num_zone_slots   = 0;
+  world->zone_slots_dirty = TRUE;
+  world->zone_phase       = 0;
+  world->pending_resets   = newList();
+  world->flush_pulse      = 0;
+  world->prefetching      = newHashtable();
+  world->prefetch_queue   = newList();
+  world->prefetch_pool    = NULL;
+  world->prefetch_tried   = FALSE;
+  world->keys             = newHashtable();
+  world->key_generation   = 0;
+  world->idle_rooms       = newHashtable();
+  world->evicted_rooms    = newHashtable();
+  world->idle_pulse       = 0;
+  world->rooms_evicted    = 0;
+  world->rooms_reloaded   = 0;
+  world->save_pid         = 0;
+  world->save_start       = 0;
+  world->save_dirty       = newList();
   return world;
 }
 
@@ -120,17 +430,43 @@ void deleteWorld(WORLD_DATA *world) {
   deleteHashtable(world->zones);
 
   deleteHashtable(world->rooms);
+  deleteHashtable(world->idle_rooms);
+  deleteHashtable(world->evicted_rooms);
   free(world->path);
 
+  world_clear_zone_slots(world);
+  deleteListWith(world->pending_resets, free);
+  deleteListWith(world->save_dirty, free);
+
+  // let our prefetches finish, and throw them out
+  if(world->prefetch_pool != NULL)
+    deleteWorkerPool(world->prefetch_pool);
+  deleteListWith(world->prefetch_queue, deleteBootFile);
+  deleteHashtable(world->prefetching);
+
+  // and all of our resolved keys
+  HASH_ITERATOR *wkey_i = newHashIterator(world->keys);
+  WORLD_KEY       *wkey = NULL;
+  ITERATE_HASH(key, wkey, wkey_i) {
+    strRelease(wkey->key);
+    strRelease(wkey->name);
+    strRelease(wkey->locale);
+    free(wkey);
+  } deleteHashIterator(wkey_i);
+  deleteHashtable(world->keys);
+
   free(world);
 }
 
 ZONE_DATA *worldRemoveZone(WORLD_DATA *world, const char *key) {
+  world->zone_slots_dirty = TRUE;
+  world->key_generation++;
   return hashRemove(world->zones, key);
 }
 
 bool worldSave(WORLD_DATA *world, const char *dirpath) {
   char buf[MAX_BUFFER];
+  bool    ok = TRUE;
   STORAGE_SET       *set = new_storage_set();
   STORAGE_SET_LIST *list = new_storage_list();
   store_list(set, "zones", list);
@@ -146,43 +482,461 @@ bool worldSave(WORLD_DATA *world, const char *dirpath) {
       store_string(zone_set, "key", zoneGetKey(zone));
       storage_list_put(list, zone_set);
     }
+    else
+      ok = FALSE;
   } deleteHashIterator(zone_i);
 
+  // the queue closes the set once it's written
   sprintf(buf, "%s/world", dirpath);
-  storage_write(set, buf);
-  storage_close(set);
+  saveQueuePut(set, buf, STORAGE_FORMAT_TEXT);
+  return ok;
+}
+
+//
+// what a child forked by worldSaveBackground does: write the world out as it
+// was when we were forked, and exit. We have none of our parent's threads,
+// so everything is written here and now, and nothing is logged. If anything
+// could not be written, we exit with 1 so our parent keeps it dirty
+void world_save_child(WORLD_DATA *world, const char *dirpath) {
+  // the sockets we were handed must close when our parent closes them, not
+  // when we exit
+#ifdef __NR_close_range
+  if(syscall(__NR_close_range, 3, ~0U, 0) != 0)
+#endif
+  {
+    int fd, max_fd = sysconf(_SC_OPEN_MAX);
+    for(fd = 3; fd < max_fd; fd++)
+      close(fd);
+  }
+  world->save_pid = 0;
+  saveQueueDetach();
+  int failed = saveQueueGetFailed();
+  bool    ok = worldSave(world, dirpath);
+  _exit((ok && saveQueueGetFailed() == failed) ? 0 : 1);
+}
+
+//
+// see if the child writing our world has finished, or if block is set, wait
+// until it has. A child that hasn't finished world_save_wait_secs after it
+// was forked is killed, and its save counted as failed. Runs the world_saved
+// hook once it's done
+void world_save_reap(WORLD_DATA *world, bool block) {
+  int  status = 0;
+  char *entry = NULL;
+  pid_t   got = 0;
+
+  if(world->save_pid <= 0)
+    return;
+
+  got = waitpid(world->save_pid, &status, WNOHANG);
+  if(got == 0 && block) {
+    long long wait = mudsettingGetInt("world_save_wait_secs") * 1000000LL;
+    while((got = waitpid(world->save_pid, &status, WNOHANG)) == 0 &&
+	  pulse_clock() - world->save_start < wait)
+      usleep(10000);
+    if(got == 0) {
+      log_string("Background world save took more than %d seconds. "
+		 "Killing it.", mudsettingGetInt("world_save_wait_secs"));
+      kill(world->save_pid, SIGKILL);
+      got = waitpid(world->save_pid, &status, 0);
+    }
+  }
+  if(got == 0)
+    return;
+
+  bool     ok = (got == world->save_pid && WIFEXITED(status) &&
+		 WEXITSTATUS(status) == 0);
+  double secs = (pulse_clock() - world->save_start) / 1000000.0;
+  world->save_pid = 0;
+
+  // if it didn't get to write what was dirty, we still have to
+  while((entry = listPop(world->save_dirty)) != NULL) {
+    char *name = strchr(entry, ' ');
+    if(!ok && name != NULL) {
+      *name++ = '\0';
+      worldSaveType(world, entry, name);
+    }
+    free(entry);
+  }
+
+  if(ok)
+    log_string("World saved in the background in %.2f seconds.", secs);
+  else
+    log_string("Background world save failed after %.2f seconds.", secs);
+  hookRun("world_saved", hookBuildInfo("int dbl", ok, secs));
+}
+
+bool worldSaveBackground(WORLD_DATA *world, const char *dirpath) {
+  HASH_ITERATOR *zone_i = NULL;
+  const char       *key = NULL;
+  ZONE_DATA       *zone = NULL;
+  char           *entry = NULL;
+  pid_t             pid = 0;
+
+  if(world->save_pid > 0)
+    return FALSE;
+
+  // anything the writer has yet to write would race the child for its file
+  saveQueueFlush();
+  PyOS_BeforeFork();
+  if((pid = fork()) == 0) {
+    PyOS_AfterFork_Child();
+    world_save_child(world, dirpath);
+  }
+  PyOS_AfterFork_Parent();
+  if(pid < 0) {
+    log_string("Could not fork to save the world (%s).", strerror(errno));
+    return FALSE;
+  }
+
+  // the child writes out everything that is dirty now. We only have to write
+  // what is saved after this, once it's done
+  world->save_pid   = pid;
+  world->save_start = pulse_clock();
+  zone_i = newHashIterator(world->zones);
+  ITERATE_HASH(key, zone, zone_i) {
+    LIST *taken = zoneTakeDirty(zone);
+    while((entry = listPop(taken)) != NULL)
+      listQueue(world->save_dirty, entry);
+    deleteList(taken);
+  } deleteHashIterator(zone_i);
   return TRUE;
 }
 
+bool worldSaveInProgress(WORLD_DATA *world) {
+  return (world->save_pid > 0);
+}
+
+void worldSaveWait(WORLD_DATA *world) {
+  world_save_reap(world, TRUE);
+}
+
 void worldInit(WORLD_DATA *world) {
   char buf[MAX_BUFFER];
   sprintf(buf, "%s/world", world->path);
 
+  int            threads = mudsettingGetInt("boot_threads");
+  long long        start = pulse_clock();
+  long long        phase = start;
   STORAGE_SET       *set = storage_read(buf);
   STORAGE_SET_LIST *list = read_list(set, "zones");
   STORAGE_SET  *zone_set = NULL;
+  LIST        *zone_keys = newList();
+  LIST            *files = newList();
+  BOOT_FILE        *file = NULL;
+  char              *key = NULL;
+
+  while( (zone_set = storage_list_next(list)) != NULL)
+    listQueue(zone_keys, strdup(read_string(zone_set, "key")));
+  storage_close(set);
+  world_boot_phase("reading the zone list", &phase);
+
+  // if we have threads to spare, parse all of the zones' files on them first.
+  // Making zones and entries out of them still happens here, since readers
+  // can run Python
+  if(threads > 0) {
+    world_boot_parse(world, zone_keys, files, threads);
+    world_boot_phase("parsing zone files", &phase);
+  }
 
-  while( (zone_set = storage_list_next(list)) != NULL) {
+  // zone files are at the front of the list, in the same order as the keys
+  while( (key = listPop(zone_keys)) != NULL) {
     ZONE_DATA *zone = NULL;
-    const char *key = read_string(zone_set, "key");
-    zone = zoneLoad(world, key);
+    if(threads > 0) {
+      file = listPop(files);
+      zone = zoneRead(world, key, file->set);
+      deleteBootFile(file);
+    }
+    else
+      zone = zoneLoad(world, key);
 
     if(zone != NULL) {
       hashPut(world->zones, key, zone);
+      world->zone_slots_dirty = TRUE;
+      world->key_generation++;
       world_types_to_zone_types(world, zone);
     }
+    free(key);
   }
-  storage_close(set);
+  deleteList(zone_keys);
+  world_boot_phase("loading zones", &phase);
+
+  // everything left is a type entry that is loaded whole at boot. Without
+  // parsing ahead of time, those are read in one by one here instead
+  if(threads <= 0) {
+    HASH_ITERATOR *type_i = newHashIterator(world->type_table);
+    const char      *type = NULL;
+    for(; (type = hashIteratorCurrentKey(type_i)) != NULL;
+	hashIteratorNext(type_i)) {
+      if(zoneTypeResidency(type) != RESIDENCY_EAGER)
+	continue;
+      HASH_ITERATOR *zone_i = newHashIterator(world->zones);
+      ZONE_DATA       *zone = NULL;
+      const char      *zkey = NULL;
+      ITERATE_HASH(zkey, zone, zone_i) {
+	LIST *keys = zoneGetTypeKeys(zone, type);
+	char *tkey = NULL;
+	while((tkey = listPop(keys)) != NULL) {
+	  zoneGetType(zone, type, tkey);
+	  free(tkey);
+	}
+	deleteList(keys);
+      } deleteHashIterator(zone_i);
+    } deleteHashIterator(type_i);
+    world_boot_phase("reading zone contents", &phase);
+  }
+  else if(listSize(files) > 0) {
+    while( (file = listPop(files)) != NULL) {
+      ZONE_DATA *zone = hashGet(world->zones, file->zone);
+      if(zone != NULL && file->set != NULL)
+	zoneReadType(zone, file->type, file->key, file->set);
+      deleteBootFile(file);
+    }
+    world_boot_phase("reading zone contents", &phase);
+  }
+  deleteList(files);
+
+  log_string("World boot: %-26s %6lld ms", "total", (phase - start) / 1000);
+}
+
+//
+// put every zone in the pulse slot its key hashes to
+void world_build_zone_slots(WORLD_DATA *world, int num_slots) {
+  HASH_ITERATOR *zone_i = newHashIterator(world->zones);
+  const char       *key = NULL;
+  ZONE_DATA       *zone = NULL;
+  int                 i;
+
+  world_clear_zone_slots(world);
+  world->zone_slots     = malloc(sizeof(LIST *) * num_slots);
+  world->num_zone_slots = num_slots;
+  for(i = 0; i < num_slots; i++)
+    world->zone_slots[i] = newList();
+  ITERATE_HASH(key, zone, zone_i)
+    listPut(world->zone_slots[pearson_hash16_1(key) % num_slots], zone);
+  deleteHashIterator(zone_i);
+
+  world->zone_slots_dirty = FALSE;
+  world->zone_phase      %= num_slots;
+}
+
+//
+// can an object be thrown out along with its room? Only if the room's resets
+// will load it again, and nothing has been put in it or is waiting on it
+bool world_obj_idle(OBJ_DATA *obj) {
+  if(!resetIsSpawned(obj) || has_events_involving(obj))
+    return FALSE;
+  LOCAL_LIST_ITERATOR(cont_i, objGetContents(obj));
+  OBJ_DATA        *cont = NULL;
+  ITERATE_LIST(cont, cont_i) {
+    if(!world_obj_idle(cont)) {
+      listIteratorFinish(cont_i);
+      return FALSE;
+    }
+  } listIteratorFinish(cont_i);
+  return TRUE;
+}
+
+//
+// is a room in the same state its prototype and resets would make it in? If
+// so, nothing is lost by unloading it and making it again later
+bool world_room_idle(ROOM_DATA *room) {
+  if(roomIsExtracted(room) || listSize(roomGetCharacters(room)) > 0 ||
+     has_events_involving(room))
+    return FALSE;
+#ifdef MODULE_DYN_VARS
+  if(roomVarsDirty(room))
+    return FALSE;
+#endif
+#ifdef MODULE_PERSISTENT
+  if(roomIsPersistent(room))
+    return FALSE;
+#endif
+  LOCAL_LIST_ITERATOR(obj_i, roomGetContents(room));
+  OBJ_DATA        *obj = NULL;
+  ITERATE_LIST(obj, obj_i) {
+    if(!world_obj_idle(obj)) {
+      listIteratorFinish(obj_i);
+      return FALSE;
+    }
+  } listIteratorFinish(obj_i);
+  return TRUE;
+}
+
+//
+// unload rooms that have been idle for room_idle_minutes. A room's idle clock
+// starts the first time we see it idle, and stops as soon as it isn't
+void world_evict_idle_rooms(WORLD_DATA *world) {
+  int       minutes = mudsettingGetInt("room_idle_minutes");
+  LIST       *evict = NULL;
+  const char   *key = NULL;
+  ROOM_DATA   *room = NULL;
+
+  if(minutes <= 0) {
+    hashClear(world->idle_rooms);
+    return;
+  }
+
+  evict = newList();
+  HASH_ITERATOR *room_i = newHashIterator(world->rooms);
+  ITERATE_HASH(key, room, room_i) {
+    if(!world_room_idle(room))
+      hashRemove(world->idle_rooms, key);
+    else if(!hashIn(world->idle_rooms, key))
+      hashPut(world->idle_rooms, key, (void *)(long)current_time);
+    else if(current_time - (long)hashGet(world->idle_rooms, key) >= 
+	    minutes * 60)
+      listPut(evict, room);
+  } deleteHashIterator(room_i);
+
+  // only rooms that can be made again from their prototype are unloaded
+  while((room = listPop(evict)) != NULL) {
+    if(worldGetType(world, "rproto", roomGetClass(room)) == NULL)
+      hashRemove(world->idle_rooms, roomGetClass(room));
+    else {
+      hookRunArgs("room_evict", "rm", room);
+      hashPut(world->evicted_rooms, roomGetClass(room), world);
+      extract_room(room);
+      world->rooms_evicted++;
+    }
+  }
+  deleteList(evict);
 }
 
 void worldPulse(WORLD_DATA *world) {
+  int    num_slots = MAX(1, 1 MINUTE);
+  int  max_resets = mudsettingGetInt("zone_resets_per_pulse");
+  int     resets = 0;
+  char      *key = NULL;
+  ZONE_DATA *zone = NULL;
+
+  // zones may have come or gone, or our pulses per second may have changed
+  if(world->zone_slots_dirty || world->num_zone_slots != num_slots)
+    world_build_zone_slots(world, num_slots);
+
+  // pulse all of the zones in this slot. Ones that are due to reset will
+  // wait their turn
+  LIST_ITERATOR *zone_i = newListIterator(world->zone_slots[world->zone_phase]);
+  ITERATE_LIST(zone, zone_i) {
+    if(zoneTick(zone) && 
+       !listGetWith(world->pending_resets, zoneGetKey(zone), strcasecmp))
+      listQueue(world->pending_resets, strdup(zoneGetKey(zone)));
+  } deleteListIterator(zone_i);
+  world->zone_phase = (world->zone_phase + 1) % num_slots;
+
+  // reset as many zones as we're allowed to this pulse
+  while((max_resets <= 0 || resets < max_resets) &&
+	(key = listPop(world->pending_resets)) != NULL) {
+    if((zone = hashGet(world->zones, key)) != NULL) {
+      zoneReset(zone);
+      resets++;
+    }
+    free(key);
+  }
+
+  // take in what has been prefetched, and forget what hasn't been used in a
+  // while for types that are kept in an LRU
+  world_prefetch_finish(world);
+  zoneTrimResident();
+
+  // once a minute, look for rooms that have been idle long enough to unload
+  if(++world->idle_pulse >= num_slots) {
+    world->idle_pulse = 0;
+    world_evict_idle_rooms(world);
+  }
+
+  // every so often, write out the entries that have been saved since. Not
+  // while they might be written over by a background save, though
+  world_save_reap(world, FALSE);
+  int interval = mudsettingGetInt("world_flush_interval");
+  if(++world->flush_pulse >= MAX(1, interval SECONDS) &&
+     !worldSaveInProgress(world)) {
+    world->flush_pulse = 0;
+    worldFlushDirty(world);
+  }
+}
+
+int worldFlushDirty(WORLD_DATA *world) {
+  HASH_ITERATOR *zone_i = NULL;
+  const char       *key = NULL;
+  ZONE_DATA       *zone = NULL;
+  int           flushed = 0;
+
+  worldSaveWait(world);
+  zone_i = newHashIterator(world->zones);
+
+  ITERATE_HASH(key, zone, zone_i)
+    flushed += zoneFlushDirty(zone);
+  deleteHashIterator(zone_i);
+  return flushed;
+}
+
+int worldCountDirty(WORLD_DATA *world) {
   HASH_ITERATOR *zone_i = newHashIterator(world->zones);
   const char       *key = NULL;
   ZONE_DATA       *zone = NULL;
+  int             count = 0;
 
   ITERATE_HASH(key, zone, zone_i)
-    zonePulse(zone);
+    count += zoneCountDirty(zone);
   deleteHashIterator(zone_i);
+  return count;
+}
+
+//
+// show how many saved entries are waiting to be written out, or write them
+// out now
+COMMAND(cmd_worldflush) {
+  if(!strcasecmp(arg, "now")) {
+    int flushed = worldFlushDirty(gameworld);
+    send_to_char(ch, "%d dirty entr%s handed to the save queue.\r\n", flushed,
+		 (flushed == 1 ? "y" : "ies"));
+    return;
+  }
+
+  HASH_ITERATOR *zone_i = newHashIterator(gameworld->zones);
+  const char       *key = NULL;
+  ZONE_DATA       *zone = NULL;
+  ITERATE_HASH(key, zone, zone_i) {
+    if(zoneCountDirty(zone) > 0)
+      send_to_char(ch, "  %-20s %5d dirty\r\n", key, zoneCountDirty(zone));
+  } deleteHashIterator(zone_i);
+
+  send_to_char(ch, "%d dirty entries, flushed every %d seconds.\r\n"
+	       "Save queue: %d waiting, %d merged, %d written, %d failed.\r\n"
+	       "Use 'worldflush now' to write dirty entries out right away.\r\n",
+	       worldCountDirty(gameworld), mudsettingGetInt("world_flush_interval"),
+	       saveQueueGetPending(), saveQueueGetCoalesced(),
+	       saveQueueGetWritten(), saveQueueGetFailed());
+}
+
+//
+// save the whole world, in the background so the game can carry on
+COMMAND(cmd_worldsave) {
+  if(worldSaveInProgress(gameworld))
+    send_to_char(ch, "The world is already being saved.\r\n");
+  else if(worldSaveBackground(gameworld, WORLD_PATH))
+    send_to_char(ch, "Saving the world in the background.\r\n");
+  else {
+    worldSave(gameworld, WORLD_PATH);
+    send_to_char(ch, "Could not save in the background. World saved.\r\n");
+  }
+}
+
+//
+// show how many rooms are loaded, and how many have been unloaded for being
+// idle and made again since
+COMMAND(cmd_worldrooms) {
+  int minutes = mudsettingGetInt("room_idle_minutes");
+  send_to_char(ch, "%d rooms resident, %d of them idle.\r\n"
+	       "%d rooms unloaded for being idle, %d made again since.\r\n",
+	       worldCountRooms(gameworld), hashSize(gameworld->idle_rooms),
+	       gameworld->rooms_evicted, gameworld->rooms_reloaded);
+  if(minutes > 0)
+    send_to_char(ch, "Rooms are unloaded after %d minute%s idle.\r\n",
+		 minutes, (minutes == 1 ? "" : "s"));
+  else
+    send_to_char(ch, "Idle rooms are never unloaded.\r\n");
 }
 
 void worldForceReset(WORLD_DATA *world) {
@@ -227,6 +981,42 @@ void worldSetPath(WORLD_DATA *world, const char *path) {
   world->path    = strdupsafe(path);
 }
 
+STORAGE_SET *worldStoreRooms(WORLD_DATA *world) {
+  STORAGE_SET       *set = new_storage_set();
+  STORAGE_SET_LIST *list = new_storage_list();
+  HASH_ITERATOR  *room_i = newHashIterator(world->rooms);
+  const char        *key = NULL;
+  ROOM_DATA        *room = NULL;
+
+  ITERATE_HASH(key, room, room_i) {
+    STORAGE_SET *room_set = new_storage_set();
+    store_string(room_set, "key",  key);
+    store_set   (room_set, "room", roomStore(room));
+    storage_list_put(list, room_set);
+  } deleteHashIterator(room_i);
+
+  store_list(set, "rooms", list);
+  return set;
+}
+
+int worldReadRooms(WORLD_DATA *world, STORAGE_SET *set) {
+  STORAGE_SET_LIST *list = read_list(set, "rooms");
+  STORAGE_SET  *room_set = NULL;
+  int            count = 0;
+
+  while( (room_set = storage_list_next(list)) != NULL) {
+    const char *key = read_string(room_set, "key");
+    ROOM_DATA *room = NULL;
+    if(!*key || hashIn(world->rooms, key))
+      continue;
+    room = roomRead(read_set(room_set, "room"));
+    worldPutRoom(world, key, room);
+    room_to_game(room);
+    count++;
+  }
+  return count;
+}
+
 void worldPutRoom(WORLD_DATA *world, const char *key, ROOM_DATA *room) {
   hashPut(world->rooms, key, room);
 }
@@ -238,13 +1028,21 @@ ROOM_DATA *worldGetRoom(WORLD_DATA *world, const char *key) {
 #ifdef MODULE_PERSISTENT
     if( (room = worldGetPersistentRoom(world, key)) == NULL) {
 #endif
-      char name[SMALL_BUFFER], locale[SMALL_BUFFER];
-      if(parse_worldkey(key, name, locale)) {
-	ZONE_DATA *zone = hashGet(world->zones, locale);
-	if(zone != NULL) {
-	  PROTO_DATA *rproto = zoneGetType(zone, "rproto", name);
-	  if(rproto != NULL && (room = protoRoomRun(rproto)) != NULL)
-	    worldPutRoom(world, protoGetKey(rproto), room);
+      WORLD_KEY *wkey = NULL;
+      ZONE_DATA *zone = world_resolve_zone(world, key, &wkey);
+      if(zone != NULL) {
+	PROTO_DATA *rproto = zoneGetType(zone, "rproto", wkey->name);
+	if(rproto != NULL && (room = protoRoomRun(rproto)) != NULL) {
+	  worldPutRoom(world, protoGetKey(rproto), room);
+#ifdef MODULE_DYN_VARS
+	  // whatever variables our prototype gave us, it will give us again
+	  roomSetVarsClean(room);
+#endif
+	  // rooms we unloaded for being idle have their resets put back
+	  if(hashRemove(world->evicted_rooms, protoGetKey(rproto)) != NULL) {
+	    world->rooms_reloaded++;
+	    hookRunArgs("room_reload", "rm", room);
+	  }
 	}
       }
 #ifdef MODULE_PERSISTENT
@@ -256,6 +1054,7 @@ ROOM_DATA *worldGetRoom(WORLD_DATA *world, const char *key) {
 
 ROOM_DATA *worldRemoveRoom(WORLD_DATA *world, const char *key) {
   ROOM_DATA *room = hashRemove(world->rooms, key);
+  hashRemove(world->idle_rooms, key);
   return room;
 }
 
@@ -263,6 +1062,18 @@ bool worldRoomLoaded(WORLD_DATA *world, const char *key) {
   return hashIn(world->rooms, key);
 }
 
+int worldCountRooms(WORLD_DATA *world) {
+  return hashSize(world->rooms);
+}
+
+int worldGetRoomsEvicted(WORLD_DATA *world) {
+  return world->rooms_evicted;
+}
+
+int worldGetRoomsReloaded(WORLD_DATA *world) {
+  return world->rooms_reloaded;
+}
+
 void worldPutZone(WORLD_DATA *world, ZONE_DATA *zone) {
   // make sure there are no conflicts with other zones...
   if(hashIn(world->zones, zoneGetKey(zone))) {
@@ -273,6 +1084,8 @@ void worldPutZone(WORLD_DATA *world, ZONE_DATA *zone) {
 
   // connect the world and zone
   hashPut(world->zones, zoneGetKey(zone), zone);
+  world->zone_slots_dirty = TRUE;
+  world->key_generation++;
   zoneSetWorld(zone, world);
 
   // make the zone's directory
@@ -288,47 +1101,76 @@ void worldPutZone(WORLD_DATA *world, ZONE_DATA *zone) {
 // implementation of the new world interface
 //*****************************************************************************
 void *worldGetType(WORLD_DATA *world, const char *type, const char *key) {
-  char name[SMALL_BUFFER], locale[SMALL_BUFFER];
-  ZONE_DATA *zone = NULL;
-  if(parse_worldkey(key, name, locale) && 
-     (zone = hashGet(world->zones, locale)) != NULL)
-    return zoneGetType(zone, type, name);
+  WORLD_KEY *wkey = NULL;
+  ZONE_DATA *zone = world_resolve_zone(world, key, &wkey);
+  if(zone != NULL)
+    return zoneGetType(zone, type, wkey->name);
   return NULL;
 }
 
 void *worldRemoveType(WORLD_DATA *world, const char *type, const char *key) {
-  char name[SMALL_BUFFER], locale[SMALL_BUFFER];
-  ZONE_DATA *zone = NULL;
-  if(parse_worldkey(key, name, locale) && 
-     (zone = hashGet(world->zones, locale)) != NULL)
-    return zoneRemoveType(zone, type, name);
+  WORLD_KEY *wkey = NULL;
+  ZONE_DATA *zone = world_resolve_zone(world, key, &wkey);
+  if(zone != NULL)
+    return zoneRemoveType(zone, type, wkey->name);
   return NULL;
 }
 
 void *worldReloadType(WORLD_DATA *world, const char *type, const char *key) {
-  char name[SMALL_BUFFER], locale[SMALL_BUFFER];
-  ZONE_DATA *zone = NULL;
-  if(parse_worldkey(key, name, locale) && 
-     (zone = hashGet(world->zones, locale)) != NULL)
-    return zoneReloadType(zone, type, name);
+  WORLD_KEY *wkey = NULL;
+  ZONE_DATA *zone = world_resolve_zone(world, key, &wkey);
+  if(zone != NULL)
+    return zoneReloadType(zone, type, wkey->name);
   return NULL;
 }
 
+void worldPrefetchType(WORLD_DATA *world, const char *type, const char *key){
+  char  pkey[MAX_BUFFER];
+  char  path[MAX_BUFFER];
+  WORLD_KEY *wkey = NULL;
+  ZONE_DATA *zone = world_resolve_zone(world, key, &wkey);
+  if(zone == NULL || !hashIn(world->type_table, type) ||
+     zoneTypeLoaded(zone, type, wkey->name))
+    return;
+
+  const char *name   = wkey->name;
+  const char *locale = wkey->locale;
+
+  // already on its way in?
+  snprintf(pkey, MAX_BUFFER, "%s %s", type, wkey->key);
+  if(hashIn(world->prefetching, pkey))
+    return;
+  hashPut(world->prefetching, pkey, world);
+
+  if(!world->prefetch_tried) {
+    int threads = mudsettingGetInt("prefetch_threads");
+    world->prefetch_tried = TRUE;
+    if(threads > 0)
+      world->prefetch_pool = newWorkerPool("prefetch", threads);
+  }
+
+  snprintf(path, MAX_BUFFER, "%s/%s/%s", worldGetZonePath(world, locale),
+	   type, name);
+  BOOT_FILE *file = newBootFile(locale, type, name, path);
+  if(world->prefetch_pool != NULL)
+    workerPoolAdd(world->prefetch_pool, prefetch_file_parse, file);
+  else
+    listQueue(world->prefetch_queue, file);
+}
+
 void worldSaveType(WORLD_DATA *world, const char *type, const char *key) {
-  char name[SMALL_BUFFER], locale[SMALL_BUFFER];
-  ZONE_DATA *zone = NULL;
-  if(parse_worldkey(key, name, locale) && 
-     (zone = hashGet(world->zones, locale)) != NULL)
-    zoneSaveType(zone, type, name);
+  WORLD_KEY *wkey = NULL;
+  ZONE_DATA *zone = world_resolve_zone(world, key, &wkey);
+  if(zone != NULL)
+    zoneSaveType(zone, type, wkey->name);
 }
 
 void worldPutType(WORLD_DATA *world, const char *type, const char *key,
 		  void *data) {
-  char name[SMALL_BUFFER], locale[SMALL_BUFFER];
-  ZONE_DATA *zone = NULL;
-  if(parse_worldkey(key, name, locale) && 
-     (zone = hashGet(world->zones, locale)) != NULL)
-    zonePutType(zone, type, name, data);
+  WORLD_KEY *wkey = NULL;
+  ZONE_DATA *zone = world_resolve_zone(world, key, &wkey);
+  if(zone != NULL)
+    zonePutType(zone, type, wkey->name, data);
 }
 
 void worldAddType(WORLD_DATA *world, const char *type, void *reader,
@@ -361,6 +1203,46 @@ void worldAddForgetfulType(WORLD_DATA *world, const char *type, void *reader,
   }
 }
 
+WORLD_KEY *worldResolveKey(WORLD_DATA *world, const char *key) {
+  WORLD_KEY *wkey = hashGet(world->keys, key);
+  if(wkey == NULL) {
+    char name[SMALL_BUFFER], locale[SMALL_BUFFER];
+    // keys for zones that don't exist aren't kept, so bad keys typed in by
+    // players can't fill us up
+    if(!parse_worldkey(key, name, locale) || !hashIn(world->zones, locale))
+      return NULL;
+    wkey             = malloc(sizeof(WORLD_KEY));
+    wkey->key        = strIntern(get_fullkey(name, locale));
+    wkey->name       = strIntern(name);
+    wkey->locale     = strIntern(locale);
+    wkey->zone       = hashGet(world->zones, locale);
+    wkey->generation = world->key_generation;
+    hashPut(world->keys, key, wkey);
+  }
+  return wkey;
+}
+
+const char *worldKeyGetKey(WORLD_KEY *wkey) {
+  return wkey->key;
+}
+
+const char *worldKeyGetName(WORLD_KEY *wkey) {
+  return wkey->name;
+}
+
+const char *worldKeyGetLocale(WORLD_KEY *wkey) {
+  return wkey->locale;
+}
+
+ZONE_DATA *worldKeyGetZone(WORLD_DATA *world, WORLD_KEY *wkey) {
+  return world_key_zone(world, wkey);
+}
+
+void *worldGetTypeKey(WORLD_DATA *world, const char *type, WORLD_KEY *wkey) {
+  ZONE_DATA *zone = (wkey ? world_key_zone(world, wkey) : NULL);
+  return (zone ? zoneGetType(zone, type, wkey->name) : NULL);
+}
+
 ZONE_DATA *worldGetZone(WORLD_DATA *world, const char *key) {
   return hashGet(world->zones, key);
 }
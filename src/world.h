@@ -18,9 +18,26 @@ WORLD_DATA *newWorld(void);
 void deleteWorld(WORLD_DATA *world);
 
 //
-// Saves the world to disk at the specified directory path
+// Saves the world to disk at the specified directory path. Returns FALSE if
+// any of its zones could not be saved
 bool worldSave(WORLD_DATA *world, const char *dirpath);
 
+//
+// the same, but without stopping the game while it's done: we fork, and the
+// child writes out the world as it was when we forked, while we carry on.
+// Dirty entries are the child's to write; anything saved after the fork is
+// written once the child is done. If any file couldn't be written, the child
+// exits with 1, and everything it was given is marked dirty again. Once it
+// has finished, the world_saved hook is run with whether it worked, and how
+// many seconds it took. Returns FALSE if a save is already going, or we
+// couldn't fork. worldFlushDirty and zoneSave wait for the save to finish
+// before they write anything, so they never race it for a file. They never
+// wait more than world_save_wait_secs from when the save started; a child
+// that is still going then is killed, and its save counted as failed
+bool worldSaveBackground(WORLD_DATA *world, const char *dirpath);
+bool worldSaveInProgress(WORLD_DATA *world);
+void worldSaveWait      (WORLD_DATA *world);
+
 //
 // Initializes the world. This includes any stuff that might need to be done
 // when the world first starts up. e.g. reading in zones, or running startup
@@ -28,10 +45,42 @@ bool worldSave(WORLD_DATA *world, const char *dirpath);
 void worldInit(WORLD_DATA *world);
 
 //
-// Pulse all of the zones in the world
+// Pulse the zones in the world. Must be called every game pulse. Each zone is
+// pulsed once a minute, but zones are hashed across the minute so they are
+// not all pulsed (and reset) on the same game pulse. No more than the
+// zone_resets_per_pulse setting's worth of zones are reset per game pulse;
+// the rest wait for following pulses
 void worldPulse(WORLD_DATA *world);
 void worldForceReset(WORLD_DATA *world);
 
+//
+// entries saved with worldSaveType are written out later, every
+// world_flush_interval seconds (when the world is pulsed), when their zone is
+// saved, and before shutdown and copyover. worldFlushDirty hands them all to
+// the save queue now, and returns how many there were
+int  worldFlushDirty(WORLD_DATA *world);
+int  worldCountDirty(WORLD_DATA *world);
+
+//
+// sets up the worldflush command, for seeing and flushing dirty entries, and
+// the worldsave command, for saving everything in the background
+void init_world_flush(void);
+
+//
+// sets up prefetching of the rooms next to wherever players move to
+void init_world_prefetch(void);
+
+//
+// sets up the worldrooms command, for seeing how many rooms are loaded
+void init_world_rooms(void);
+
+//
+// start reading in an entry of the given type, if it isn't in memory already.
+// Its file is parsed on a prefetch worker (prefetch_threads of them), and the
+// entry is made out of it on the next world pulse. If it is asked for before
+// then, it is loaded right away as usual
+void worldPrefetchType(WORLD_DATA *world, const char *type, const char *key);
+
 //
 // new world interface
 void    *worldGetType(WORLD_DATA *world, const char *type, const char *key);
@@ -58,6 +107,29 @@ ROOM_DATA *worldRemoveRoom(WORLD_DATA *world, const char *key);
 bool       worldRoomLoaded(WORLD_DATA *world, const char *key);
 void          worldPutRoom(WORLD_DATA *world, const char *key, ROOM_DATA *room);
 
+//
+// rooms with nothing in them but what their resets loaded, no events waiting
+// on them, and no variables set since they were made, are unloaded once they
+// have been that way for room_idle_minutes (when the world is pulsed). The
+// next worldGetRoom makes them again from their prototype, and runs their
+// resets (through the room_reload hook); room_evict is run just before they
+// are unloaded. Anything holding on to an unloaded room or its contents must
+// look them up again. These count the rooms that are loaded right now, how
+// many have been unloaded for being idle, and how many of those have been
+// made again
+int        worldCountRooms(WORLD_DATA *world);
+int   worldGetRoomsEvicted(WORLD_DATA *world);
+int  worldGetRoomsReloaded(WORLD_DATA *world);
+
+//
+// store every room that is currently loaded, along with the mobs and objects
+// in it, so they can be brought back exactly as they are with worldReadRooms
+// (e.g. after a hot copyover) instead of being rebuilt from prototypes and
+// resets. Returns how many rooms were read. Rooms that are already loaded
+// are left alone
+STORAGE_SET *worldStoreRooms(WORLD_DATA *world);
+int           worldReadRooms(WORLD_DATA *world, STORAGE_SET *set);
+
 void            worldPutZone(WORLD_DATA *world, ZONE_DATA *zone);
 ZONE_DATA      *worldGetZone(WORLD_DATA *world, const char *key);
 LIST       *worldGetZoneKeys(WORLD_DATA *world);
@@ -65,4 +137,19 @@ const char *worldGetZonePath(WORLD_DATA *world, const char *key);
 void            worldSetPath(WORLD_DATA *world, const char *path);
 const char     *worldGetPath(WORLD_DATA *world);
 
+//
+// a key, resolved once into its name, locale, and zone. Resolving a key the
+// world has seen before is a single lookup, and whatever holds on to the
+// WORLD_KEY can skip even that. Keys belong to the world and last as long as
+// it does; if the key's zone is removed or replaced, the WORLD_KEY follows
+// along. Returns NULL if the key is not name@locale, or its zone does not
+// exist. Every world function that takes a key resolves it this way
+WORLD_KEY   *worldResolveKey(WORLD_DATA *world, const char *key);
+const char   *worldKeyGetKey(WORLD_KEY *wkey);
+const char  *worldKeyGetName(WORLD_KEY *wkey);
+const char *worldKeyGetLocale(WORLD_KEY *wkey);
+ZONE_DATA   *worldKeyGetZone(WORLD_DATA *world, WORLD_KEY *wkey);
+void       *worldGetTypeKey(WORLD_DATA *world, const char *type,
+			     WORLD_KEY *wkey);
+
 #endif // __WORLD_H
@@ -17,6 +17,9 @@
 #include "auxiliary.h"
 #include "world.h"
 #include "hooks.h"
+#include "save_queue.h"
+#include "trace.h"
+#include "shard.h"
 #include "zone.h"
 
 
@@ -37,6 +40,8 @@ typedef struct {
   void     *key_func;
   bool     forgetful;
   HASHTABLE *key_map;
+  HASHTABLE   *dirty; // keys of entries that were saved, but not yet written
+  HASHTABLE *resident; // key -> ZONE_LRU_ENTRY, for types kept in an LRU
   char         *type;
 } ZONE_TYPE_DATA;
 
@@ -49,6 +54,8 @@ ZONE_TYPE_DATA *newZoneType(const char *type, void *reader, void *storer,
   data->key_func       = keysetter;
   data->forgetful      = forgetful;
   data->key_map        = newHashtable();
+  data->dirty          = newHashtable();
+  data->resident       = newHashtable();
   data->type           = strdupsafe(type);
   return data;
 }
@@ -86,6 +93,140 @@ STORAGE_SET *do_zone_store(ZONE_TYPE_DATA *tdata, void *data) {
   }
 }
 
+void do_zone_delete(ZONE_TYPE_DATA *tdata, void *data) {
+  if(tdata->forgetful) {
+    void (* delete_func)(const char *, void *) = tdata->delete_func;
+    delete_func(tdata->type, data);
+  }
+  else {
+    void (* delete_func)(void *) = tdata->delete_func;
+    delete_func(data);
+  }
+}
+
+//
+// the file an entry of a zone's type is kept in
+const char *zone_type_file(ZONE_DATA *zone, const char *type, const char *key);
+
+
+
+//*****************************************************************************
+// type residency
+//
+// entries of types kept in an LRU are forgotten once their type's entries,
+// across every zone, take up more than their memory cap. How much memory an
+// entry takes up is guessed from the size of its file. Only entries that were
+// loaded from disk are tracked; ones put in by hand (e.g. by OLC) might not
+// be on disk yet, so they are never forgotten, and neither are dirty ones.
+// Entries are only forgotten between pulses, so nothing in the middle of
+// using one has it deleted out from under them
+//*****************************************************************************
+typedef struct {
+  LIST  *entries; // ZONE_LRU_ENTRY, most recently used first
+  long     bytes;
+} ZONE_LRU;
+
+typedef struct {
+  ZONE_DATA        *zone;
+  ZONE_TYPE_DATA  *tdata;
+  char             *key;
+  long             size;
+  LIST_NODE       *node;
+} ZONE_LRU_ENTRY;
+
+// type -> ZONE_LRU
+HASHTABLE *zone_lrus = NULL;
+
+ZONE_LRU *zone_lru_get(const char *type) {
+  if(zone_lrus == NULL)
+    zone_lrus = newHashtable();
+  ZONE_LRU *lru = hashGet(zone_lrus, type);
+  if(lru == NULL) {
+    lru          = malloc(sizeof(ZONE_LRU));
+    lru->entries = newList();
+    lru->bytes   = 0;
+    hashPut(zone_lrus, type, lru);
+  }
+  return lru;
+}
+
+//
+// stop tracking an entry, without doing anything to the entry itself
+void zone_lru_forget(ZONE_TYPE_DATA *tdata, const char *key) {
+  ZONE_LRU_ENTRY *entry = hashRemove(tdata->resident, key);
+  if(entry != NULL) {
+    ZONE_LRU *lru = zone_lru_get(tdata->type);
+    listRemoveNode(lru->entries, entry->node);
+    lru->bytes -= entry->size;
+    free(entry->key);
+    free(entry);
+  }
+}
+
+//
+// forget the least recently used entries of a type until it fits in its cap.
+// Dirty entries are moved to the front instead, since they must be written
+// before they can go
+void zone_lru_trim(ZONE_LRU *lru, const char *type) {
+  long   cap = zoneTypeMemoryCap(type);
+  int  tries = listSize(lru->entries);
+  while(lru->bytes > cap && tries-- > 0) {
+    ZONE_LRU_ENTRY *entry = listTail(lru->entries);
+    ZONE_TYPE_DATA *tdata = entry->tdata;
+    if(hashIn(tdata->dirty, entry->key)) {
+      listRemoveNode(lru->entries, entry->node);
+      entry->node = listPutNode(lru->entries, entry);
+      continue;
+    }
+    char key[strlen(entry->key) + 1];
+    strcpy(key, entry->key);
+    zone_lru_forget(tdata, key);
+    void *data = hashRemove(tdata->key_map, key);
+    if(data != NULL) {
+      do_zone_setkey(tdata, data, "");
+      do_zone_delete(tdata, data);
+    }
+  }
+}
+
+//
+// an entry of a type kept in an LRU was just loaded, or just used
+void zone_lru_touch(ZONE_DATA *zone, ZONE_TYPE_DATA *tdata, const char *key,
+		    bool loaded) {
+  ZONE_LRU        *lru = zone_lru_get(tdata->type);
+  ZONE_LRU_ENTRY *entry = hashGet(tdata->resident, key);
+  if(entry != NULL) {
+    listRemoveNode(lru->entries, entry->node);
+    entry->node = listPutNode(lru->entries, entry);
+  }
+  else if(loaded) {
+    struct stat st;
+    entry        = malloc(sizeof(ZONE_LRU_ENTRY));
+    entry->zone  = zone;
+    entry->tdata = tdata;
+    entry->key   = strdup(key);
+    entry->size  = (stat(zone_type_file(zone, tdata->type, key), &st) == 0 ?
+		    st.st_size : 0);
+    entry->node  = listPutNode(lru->entries, entry);
+    lru->bytes  += entry->size;
+    hashPut(tdata->resident, key, entry);
+  }
+}
+
+//
+// hand an entry that was saved off to the save queue to be written, and
+// forget that it was dirty
+void zone_type_flush(ZONE_DATA *zone, ZONE_TYPE_DATA *tdata, const char *key) {
+  void *data = hashGet(tdata->key_map, key);
+  if(data != NULL) {
+    STORAGE_SET *set = do_zone_store(tdata, data);
+    if(set != NULL)
+      saveQueuePut(set, zone_type_file(zone, tdata->type, key),
+		   storage_type_format(tdata->type));
+  }
+  hashRemove(tdata->dirty, key);
+}
+
 
 
 //*****************************************************************************
@@ -163,12 +304,26 @@ void deleteZone(ZONE_DATA *zone){
 //
 // Pulse a zone. i.e. decrement it's reset timer. When the timer hits 0,
 // set it back to the max, and reset everything in the zone
-void zonePulse(ZONE_DATA *zone) { 
+bool zoneTick(ZONE_DATA *zone) {
   zone->pulse--;
   if(zone->pulse == 0) {
     zone->pulse = zone->pulse_timer;
-    hookRun("reset_zone", hookBuildInfo("str", zoneGetKey(zone)));
+    return TRUE;
   }
+  return FALSE;
+}
+
+void zoneReset(ZONE_DATA *zone) {
+  traceBegin("reset", zoneGetKey(zone));
+  shardBeginZone(zoneGetKey(zone));
+  hookRunArgs("reset_zone", "str", zoneGetKey(zone));
+  shardEnd();
+  traceEnd();
+}
+
+void zonePulse(ZONE_DATA *zone) { 
+  if(zoneTick(zone))
+    zoneReset(zone);
 }
 
 void zoneForceReset(ZONE_DATA *zone) {
@@ -183,13 +338,19 @@ char *read_resettable_room(STORAGE_SET *set) {
 }
 
 ZONE_DATA *zoneLoad(WORLD_DATA *world, const char *key) {
-  ZONE_DATA *zone = newZone(key);
   char fname[SMALL_BUFFER];
+  sprintf(fname, "%s/zone", worldGetZonePath(world, key));
+  saveQueueWaitFor(fname);
+  STORAGE_SET  *set = storage_read(fname);
+  ZONE_DATA   *zone = zoneRead(world, key, set);
+  storage_close(set);
+  return zone;
+}
+
+ZONE_DATA *zoneRead(WORLD_DATA *world, const char *key, STORAGE_SET *set) {
+  ZONE_DATA *zone = newZone(key);
   zone->world = world;
 
-  // first, load all of the zone data
-  sprintf(fname, "%s/zone", worldGetZonePath(world, zone->key));
-  STORAGE_SET  *set = storage_read(fname);
   zone->pulse_timer = read_int   (set, "pulse_timer");
   zoneSetName(zone,   read_string(set, "name"));
   zoneSetDesc(zone,   read_string(set, "desc"));
@@ -203,8 +364,6 @@ ZONE_DATA *zoneLoad(WORLD_DATA *world, const char *key) {
   deleteAuxiliaryData(zone->auxiliary_data);
   zone->auxiliary_data = auxiliaryDataRead(read_set(set, "auxiliary"), 
 					   AUXILIARY_TYPE_ZONE);
-  storage_close(set);
-
   return zone;
 }
 
@@ -220,6 +379,12 @@ STORAGE_SET *store_resettable_room(char *key) {
 // the new zone saving function
 bool zoneSave(ZONE_DATA *zone) {
   char fname[MAX_BUFFER];
+
+  // anything in the zone that has been saved since we last wrote it out. A
+  // background save might be writing the same files
+  if(zone->world != NULL)
+    worldSaveWait(zone->world);
+  zoneFlushDirty(zone);
   
   // first, for our zone data
   sprintf(fname, "%s/zone", worldGetZonePath(zone->world, zone->key));
@@ -232,8 +397,8 @@ bool zoneSave(ZONE_DATA *zone) {
   store_list  (set, "resettable",  gen_store_list(zone->resettable,
 						  store_resettable_room));
 
-  storage_write(set, fname);
-  storage_close(set);
+  // the queue closes the set once it's written
+  saveQueuePut(set, fname, storage_type_format("zone"));
   return TRUE;
 }
 
@@ -246,6 +411,10 @@ void *zoneGetAuxiliaryData(const ZONE_DATA *zone, char *name) {
   return auxiliaryGet(zone->auxiliary_data, name);
 }
 
+void *zoneGetAuxiliarySlot(const ZONE_DATA *zone, int slot) {
+  return auxiliaryGetSlot(zone->auxiliary_data, slot);
+}
+
 int zoneGetPulseTimer(ZONE_DATA *zone) { 
   return zone->pulse_timer;
 }
@@ -341,21 +510,31 @@ void *zoneLoadType(ZONE_DATA *zone, const char *type, const char *key) {
   if(tdata == NULL) 
     return NULL;
   else {
-    char buf[MAX_BUFFER];
-    void *data = NULL;
-    sprintf(buf, "%s/%s/%s", worldGetZonePath(zone->world, zone->key), 
-	    type, key);
-    STORAGE_SET *set = storage_read(buf);
+    const char *fname = zone_type_file(zone, type, key);
+    void        *data = NULL;
+    saveQueueWaitFor(fname);
+    STORAGE_SET  *set = storage_read(fname);
     if(set != NULL) {
-      data = do_zone_read(tdata, set);
-      hashPut(tdata->key_map, key, data);
-      do_zone_setkey(tdata, data, get_fullkey(key, zone->key));
+      data = zoneReadType(zone, type, key, set);
       storage_close(set);
     }
     return data;
   }
 }
 
+void *zoneReadType(ZONE_DATA *zone, const char *type, const char *key,
+		   STORAGE_SET *set) {
+  ZONE_TYPE_DATA *tdata = hashGet(zone->type_table, type);
+  if(tdata == NULL)
+    return NULL;
+  void *data = do_zone_read(tdata, set);
+  hashPut(tdata->key_map, key, data);
+  do_zone_setkey(tdata, data, get_fullkey(key, zone->key));
+  if(data != NULL && zoneTypeResidency(type) == RESIDENCY_LRU)
+    zone_lru_touch(zone, tdata, key, TRUE);
+  return data;
+}
+
 void *zoneGetType(ZONE_DATA *zone, const char *type, const char *key) {
   ZONE_TYPE_DATA *tdata = hashGet(zone->type_table, type);
   if(tdata == NULL) 
@@ -365,33 +544,134 @@ void *zoneGetType(ZONE_DATA *zone, const char *type, const char *key) {
     // if we haven't loaded it into memory yet, do so
     if((data = hashGet(tdata->key_map, key)) == NULL)
       data = zoneLoadType(zone, type, key);
+    else if(hashSize(tdata->resident) > 0)
+      zone_lru_touch(zone, tdata, key, FALSE);
     return data;
   }
 }
 
+bool zoneTypeLoaded(ZONE_DATA *zone, const char *type, const char *key) {
+  ZONE_TYPE_DATA *tdata = hashGet(zone->type_table, type);
+  return (tdata != NULL && hashIn(tdata->key_map, key));
+}
+
+int zoneTypeResidency(const char *type) {
+  char setting[SMALL_BUFFER];
+  const char *policy = NULL;
+  snprintf(setting, SMALL_BUFFER, "world_residency_%s", type);
+  if(!*(policy = mudsettingGetString(setting)))
+    policy = mudsettingGetString("world_residency");
+
+  if(!strcasecmp(policy, "eager"))
+    return RESIDENCY_EAGER;
+  else if(!strcasecmp(policy, "lazy"))
+    return RESIDENCY_LAZY;
+  else if(!strcasecmp(policy, "lru"))
+    return RESIDENCY_LRU;
+  // with no policy, do what the world has always done: load everything when
+  // booting on threads, and load entries as they are asked for when not
+  return (mudsettingGetInt("boot_threads") > 0 ? RESIDENCY_EAGER :
+	  RESIDENCY_LAZY);
+}
+
+void zoneTrimResident(void) {
+  if(zone_lrus == NULL)
+    return;
+  HASH_ITERATOR *lru_i = newHashIterator(zone_lrus);
+  const char     *type = NULL;
+  ZONE_LRU        *lru = NULL;
+  ITERATE_HASH(type, lru, lru_i)
+    zone_lru_trim(lru, type);
+  deleteHashIterator(lru_i);
+}
+
+long zoneTypeMemoryCap(const char *type) {
+  char setting[SMALL_BUFFER];
+  snprintf(setting, SMALL_BUFFER, "world_lru_kb_%s", type);
+  if(!*mudsettingGetString(setting))
+    snprintf(setting, SMALL_BUFFER, "world_lru_kb");
+  return (long)mudsettingGetInt(setting) * 1024;
+}
+
+const char *zone_type_file(ZONE_DATA *zone, const char *type, const char *key){
+  static char buf[MAX_BUFFER];
+  sprintf(buf, "%s/%s/%s", worldGetZonePath(zone->world, zone->key), type,key);
+  return buf;
+}
+
 void zoneSaveType(ZONE_DATA *zone, const char *type, const char *key) {
-  void *data = zoneGetType(zone, type, key);
-  if(data != NULL) {
+  // entries are only marked as needing to be written here. They are written
+  // out when the world flushes, or the zone is saved
+  if(zoneGetType(zone, type, key) != NULL) {
     ZONE_TYPE_DATA *tdata = hashGet(zone->type_table, type);
-    STORAGE_SET      *set = do_zone_store(tdata, data);
-    if(set != NULL) {
-      char buf[MAX_BUFFER];
-      sprintf(buf,"%s/%s/%s",worldGetZonePath(zone->world,zone->key),type,key);
-      storage_write(set, buf);
-      storage_close(set);
-    }
+    hashPut(tdata->dirty, key, tdata);
   }
 }
 
+int zoneFlushDirty(ZONE_DATA *zone) {
+  HASH_ITERATOR *type_i = newHashIterator(zone->type_table);
+  ZONE_TYPE_DATA *tdata = NULL;
+  const char       *key = NULL;
+  int           flushed = 0;
+  ITERATE_HASH(key, tdata, type_i) {
+    // flushing takes keys out of the table, so we can't iterate over it
+    LIST *keys = hashCollect(tdata->dirty);
+    char *dkey = NULL;
+
+    while((dkey = listPop(keys)) != NULL) {
+      zone_type_flush(zone, tdata, dkey);
+      free(dkey);
+      flushed++;
+    }
+    deleteList(keys);
+  } deleteHashIterator(type_i);
+  return flushed;
+}
+
+LIST *zoneTakeDirty(ZONE_DATA *zone) {
+  HASH_ITERATOR *type_i = newHashIterator(zone->type_table);
+  ZONE_TYPE_DATA *tdata = NULL;
+  const char       *key = NULL;
+  LIST           *taken = newList();
+  char buf[MAX_BUFFER];
+  ITERATE_HASH(key, tdata, type_i) {
+    LIST *keys = hashCollect(tdata->dirty);
+    char *dkey = NULL;
+
+    while((dkey = listPop(keys)) != NULL) {
+      snprintf(buf, sizeof(buf), "%s %s@%s", tdata->type, dkey, zone->key);
+      listQueue(taken, strdup(buf));
+      hashRemove(tdata->dirty, dkey);
+      free(dkey);
+    }
+    deleteList(keys);
+  } deleteHashIterator(type_i);
+  return taken;
+}
+
+int zoneCountDirty(ZONE_DATA *zone) {
+  HASH_ITERATOR *type_i = newHashIterator(zone->type_table);
+  ZONE_TYPE_DATA *tdata = NULL;
+  const char       *key = NULL;
+  int             count = 0;
+  ITERATE_HASH(key, tdata, type_i)
+    count += hashSize(tdata->dirty);
+  deleteHashIterator(type_i);
+  return count;
+}
+
 void *zoneRemoveType(ZONE_DATA *zone, const char *type, const char *key) {
   ZONE_TYPE_DATA *tdata = hashGet(zone->type_table, type);
   if(tdata == NULL)
     return NULL;
   else {
-    // first, delete the file for it
-    char buf[MAX_BUFFER];
-    sprintf(buf, "%s/%s/%s",worldGetZonePath(zone->world,zone->key),type,key);
-    unlink(buf);
+    // first, delete the file for it. If it was waiting to be written, make
+    // sure it doesn't come back afterwards
+    const char *fname = zone_type_file(zone, type, key);
+    hashRemove(tdata->dirty, key);
+    zone_lru_forget(tdata, key);
+    saveQueueWaitFor(fname);
+    unlink(fname);
     // then remove it from the key map
     void *data = hashRemove(tdata->key_map, key);
     if(data != NULL)
@@ -409,7 +689,11 @@ void *zoneReloadType(ZONE_DATA *zone, const char *type, const char *key) {
   if(tdata == NULL)
     return NULL;
   else {
+    // if it was saved but has not been written yet, write it first
+    if(hashIn(tdata->dirty, key))
+      zone_type_flush(zone, tdata, key);
     // remove existing cached data if present (non-destructive to disk)
+    zone_lru_forget(tdata, key);
     void *old = hashRemove(tdata->key_map, key);
     if(old != NULL)
       do_zone_setkey(tdata, old, "");
@@ -422,6 +706,8 @@ void zonePutType(ZONE_DATA *zone, const char *type, const char *key,
 		 void *data) {
   ZONE_TYPE_DATA *tdata = hashGet(zone->type_table, type);
   if(tdata != NULL) {
+    // entries put in by hand stay until they are removed
+    zone_lru_forget(tdata, key);
     hashPut(tdata->key_map, key, data);
     do_zone_setkey(tdata, data, get_fullkey(key, zone->key));
   }
@@ -28,6 +28,10 @@ void deleteZone(ZONE_DATA *zone);
 // Load a zone from disk. 
 ZONE_DATA *zoneLoad(WORLD_DATA *world, const char *key);
 
+//
+// Make a zone from its already-parsed zone file. The set is not closed
+ZONE_DATA *zoneRead(WORLD_DATA *world, const char *key, STORAGE_SET *set);
+
 //
 // Save a zone to the specified directory path
 bool zoneSave(ZONE_DATA *zone);
@@ -38,6 +42,13 @@ bool zoneSave(ZONE_DATA *zone);
 void      zonePulse(ZONE_DATA *zone);
 void zoneForceReset(ZONE_DATA *zone);
 
+//
+// zonePulse, split in two. zoneTick decrements the zone's reset timer and
+// returns TRUE if the zone is due to reset (setting the timer back to the
+// max). zoneReset resets everything in the zone
+bool       zoneTick(ZONE_DATA *zone);
+void      zoneReset(ZONE_DATA *zone);
+
 //
 // Copy zone-specific data, but not contents in the zone (no rooms, mobs
 // objs, scripts, etc)
@@ -60,6 +71,7 @@ const char    *zoneGetDesc(ZONE_DATA *zone);
 const char *zoneGetEditors(ZONE_DATA *zone);
 BUFFER  *zoneGetDescBuffer(ZONE_DATA *zone);
 void *zoneGetAuxiliaryData(const ZONE_DATA *zone, char *name);
+void *zoneGetAuxiliarySlot(const ZONE_DATA *zone, int slot);
 LIST    *zoneGetResettable(ZONE_DATA *zone);
 
 
@@ -87,6 +99,52 @@ void       zoneAddType(ZONE_DATA *zone, const char *type, void *reader,
 		       void *storer, void *deleter, void *keysetter);
 LIST  *zoneGetTypeKeys(ZONE_DATA *zone, const char *type);
 
+//
+// zoneSaveType does not write the entry right away. It marks it as dirty,
+// and dirty entries are written out (through the save queue) when the zone
+// is saved, or when the world flushes them. zoneFlushDirty writes the zone's
+// dirty entries out now, and returns how many there were
+int      zoneFlushDirty(ZONE_DATA *zone);
+int      zoneCountDirty(ZONE_DATA *zone);
+
+//
+// forget which of the zone's entries are dirty, without writing them, and
+// return them as a list of "type name@zone" strings, for the caller to free
+// (or to mark dirty again with worldSaveType, if whoever was to write them
+// didn't)
+LIST    *zoneTakeDirty (ZONE_DATA *zone);
+
+//
+// how each type's entries are kept in memory, set in the mud settings with
+// world_residency_<type> (or world_residency, for every type):
+//   eager  every entry is loaded when the world boots
+//   lazy   entries are loaded when first asked for, and kept from then on
+//   lru    entries are loaded when first asked for, and the least recently
+//          used are forgotten once the type's entries take up more than
+//          world_lru_kb_<type> (or world_lru_kb) KB. Only for types whose
+//          entries are looked up by key each time, and not held on to
+#define RESIDENCY_EAGER       0
+#define RESIDENCY_LAZY        1
+#define RESIDENCY_LRU         2
+int  zoneTypeResidency(const char *type);
+long zoneTypeMemoryCap(const char *type);
+
+//
+// forget the least recently used entries of each LRU type that is over its
+// cap. Called by the world between pulses
+void  zoneTrimResident(void);
+
+//
+// is the entry of the given type already in memory?
+bool    zoneTypeLoaded(ZONE_DATA *zone, const char *type, const char *key);
+
+//
+// read in an entry of the given type from its already-parsed file, and put
+// it in the zone, as if zoneGetType had just loaded it. The set is not
+// closed. Used when the world's files are parsed ahead of time at boot
+void     *zoneReadType(ZONE_DATA *zone, const char *type, const char *key,
+		       STORAGE_SET *set);
+
 //
 // some types can 'forget' what they are. This is a fudge so Python can add
 // types to zones, and we can do a lookup on the functions that need to
@@ -0,0 +1,558 @@
+#!/usr/bin/env python3
+"""
+Pymodule Hot Path Microbenchmarks for NakedMud
+
+Times the parts of the mudlib's Python modules that run often enough to
+matter, without booting the mud:
+
+1. Puts stand-ins for the mud's own modules (mud, mudsys, hooks, storage,
+   char, room, ...) in sys.modules, so lib/pymodules can be imported as is
+2. Runs each hot path against fixed fixtures: stub characters, objects, and
+   rooms, and the class files under lib/config/classes
+3. Reports how many times a second each one ran, and how much it costs
+   relative to a fixed pure Python workload timed on the same machine, so
+   results from different machines can be compared
+4. Compares those costs to the ones in bench_baselines.json, and fails if
+   any hot path got more than --threshold slower
+
+Some of what these modules used to do in Python is done by the mud itself
+now (colour translation, the breadth-first search behind path.py, handing
+out gear slots, and performing socials). What is left in Python around
+those is what gets timed here.
+
+Usage:
+    python3 tests/bench_hotpaths.py
+    python3 tests/bench_hotpaths.py --only yaml,path --threshold 0.25
+    python3 tests/bench_hotpaths.py --update     # record new baselines
+    python3 tests/bench_hotpaths.py --json out.json
+
+Nothing but the standard library is needed.
+"""
+
+import os
+import sys
+import glob
+import json
+import time
+import types
+import argparse
+import tempfile
+import importlib
+from typing import Callable, Dict, List, Tuple
+
+REPO_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PYMODULES = os.path.join(REPO_ROOT, "lib", "pymodules")
+CLASS_DIR = os.path.join(REPO_ROOT, "lib", "config", "classes")
+BASELINES = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                         "bench_baselines.json")
+
+# how much slower than its baseline a hot path can get before we fail
+DFLT_THRESHOLD = 0.50
+
+# the mud's own modules, which only exist inside the server
+MUD_MODULES = ["mud", "mudsys", "hooks", "storage", "auxiliary", "char",
+               "room", "exit", "obj", "event", "olc", "mudsock", "account",
+               "movement"]
+
+
+################################################################################
+# stand-ins for the mud
+################################################################################
+class Stub:
+    """Stands in for anything the mud would hand back. Every attribute is
+    another Stub, calling one gives a Stub back, and it holds nothing"""
+
+    def __getattr__(self, name):
+        if name.startswith("__"):
+            raise AttributeError(name)
+        return Stub()
+
+    def __call__(self, *args, **kwargs):
+        return Stub()
+
+    def __iter__(self):
+        return iter(())
+
+    def __len__(self):
+        return 0
+
+    def __bool__(self):
+        return False
+
+
+class StubModule(types.ModuleType):
+    """A mud module whose functions all do nothing, except the ones we set"""
+
+    def __getattr__(self, name):
+        if name.startswith("__"):
+            raise AttributeError(name)
+        return Stub()
+
+
+def install_stubs():
+    """Put the mud's modules in sys.modules, and fill in the few functions
+    whose results the hot paths depend on"""
+    for name in MUD_MODULES:
+        sys.modules[name] = StubModule(name)
+
+    derived = []
+    def register_derived(name, *depends):
+        derived.append(name)
+        return len(derived) - 1
+    sys.modules["mud"].register_derived = register_derived
+    sys.modules["movement"].positions = ["unconscious", "sleeping",
+                                         "resting", "sitting", "standing"]
+
+    # attributes is a whole package of its own; the regen rates only need
+    # to look a character's attributes up
+    attrs = types.ModuleType("attributes")
+    attrs.__path__ = []
+    attr_aux = types.ModuleType("attributes.attribute_aux")
+    attr_aux.get_attributes = lambda ch: ch.attributes
+    attrs.attribute_aux = attr_aux
+    attrs.attribute_data = types.ModuleType("attributes.attribute_data")
+    sys.modules["attributes"] = attrs
+    sys.modules["attributes.attribute_aux"] = attr_aux
+    sys.modules["attributes.attribute_data"] = attrs.attribute_data
+
+
+def import_from_package(package: str, module: str):
+    """Import one module out of a pymodules package, without running the
+    package's __init__, which would import and set up all of the others"""
+    if package not in sys.modules:
+        pkg = types.ModuleType(package)
+        pkg.__path__ = [os.path.join(PYMODULES, package)]
+        sys.modules[package] = pkg
+    return importlib.import_module(package + "." + module)
+
+
+class BenchAttributes:
+    def __init__(self):
+        self.stamina = 14
+        self.discipline = 12
+        self.intelligence = 10
+        self.wisdom = 11
+
+
+class BenchRegen:
+    def set_rate(self, pool, rate):
+        pass
+
+
+class BenchVitality:
+    def __init__(self):
+        self.is_dead = False
+        self.regen = BenchRegen()
+
+
+class BenchChar:
+    """A character, as far as the hot paths look at one"""
+
+    def __init__(self, pos="standing"):
+        self.pos = pos
+        self.attributes = BenchAttributes()
+        self.vitality = BenchVitality()
+        self.derived_vals = {}
+        self.sent = 0
+
+    def derived(self, key):
+        return self.derived_vals.get(key)
+
+    def set_derived(self, key, val):
+        self.derived_vals[key] = val
+
+    def getAuxiliary(self, name):
+        return self.vitality if name == "vitality_data" else None
+
+    def send(self, mssg):
+        self.sent += 1
+
+
+class BenchEquippedData:
+    def __init__(self, worn_type):
+        self.worn_type = worn_type
+
+
+class BenchObj:
+    def __init__(self, worn_type):
+        self.data = BenchEquippedData(worn_type)
+
+    def istype(self, type):
+        return type == "equipped"
+
+    def get_type_data(self, type):
+        return self.data if type == "equipped" else None
+
+
+class BenchExit:
+    def __init__(self, dest):
+        self.dest = dest
+        self.is_closed = False
+
+
+class BenchRoom:
+    """A room in a grid. Routes between rooms are worked out ahead of time,
+    the way the mud's own route cache would have them"""
+
+    def __init__(self, x, y):
+        self.x, self.y = x, y
+        self.locale = "bench"
+        self.exits = {}
+        self.routes = {}
+
+    @property
+    def exnames(self):
+        return list(self.exits.keys())
+
+    def exit(self, dir):
+        return self.exits.get(dir)
+
+    def dir_to(self, room):
+        for dir, ex in self.exits.items():
+            if ex.dest is room:
+                return dir
+        return None
+
+    def path_to(self, room, ignore_doors=False, stay_zone=True, ignore=None):
+        return self.routes.get(room)
+
+
+def build_grid(size: int) -> List[List[BenchRoom]]:
+    """A size x size grid of rooms, and the routes along its edges"""
+    grid = [[BenchRoom(x, y) for y in range(size)] for x in range(size)]
+    for x in range(size):
+        for y in range(size):
+            room = grid[x][y]
+            if x > 0:        room.exits["west"]  = BenchExit(grid[x-1][y])
+            if x < size - 1: room.exits["east"]  = BenchExit(grid[x+1][y])
+            if y > 0:        room.exits["south"] = BenchExit(grid[x][y-1])
+            if y < size - 1: room.exits["north"] = BenchExit(grid[x][y+1])
+
+    # east along the bottom, then north up the side, and back again
+    corners = [grid[0][0], grid[size-1][0], grid[size-1][size-1]]
+    legs    = [[grid[x][0] for x in range(size)],
+               [grid[size-1][y] for y in range(size)]]
+    for (frm, to), leg in zip(zip(corners, corners[1:]), legs):
+        frm.routes[to] = leg
+        to.routes[frm] = list(reversed(leg))
+    return grid
+
+
+################################################################################
+# the benchmarks
+################################################################################
+def class_fixtures() -> List[str]:
+    """The contents of the class files, in a fixed order"""
+    texts = []
+    for path in sorted(glob.glob(os.path.join(CLASS_DIR, "**", "*.yaml"),
+                                 recursive=True)):
+        with open(path) as f:
+            texts.append(f.read())
+    return texts
+
+
+def setup_yaml():
+    yaml_parser = import_from_package("progression", "yaml_parser")
+    texts = class_fixtures()
+    def run():
+        for text in texts:
+            yaml_parser.parse_yaml(text)
+    return run, len(texts)
+
+
+def setup_yaml_values():
+    yaml_parser = import_from_package("progression", "yaml_parser")
+    values = ['"Warrior"', "16", "0.125", "true", "False", "null", "~",
+              "'quoted'", "plain words", "[1, 2, 3]", "-4", "1e3"]
+    def run():
+        for value in values:
+            yaml_parser._convert_value(value)
+    return run, len(values)
+
+
+def setup_path_dirs():
+    path = importlib.import_module("path")
+    grid  = build_grid(16)
+    route = [grid[x][0] for x in range(16)] + [grid[15][y] for y in range(1,16)]
+    def run():
+        path.path_to_dirs(route)
+    return run, 1
+
+
+def setup_path_patrol():
+    path = importlib.import_module("path")
+    grid = build_grid(16)
+    rms  = [grid[0][0], grid[15][0], grid[15][15]]
+    def run():
+        path.build_patrol(rms)
+    return run, 1
+
+
+def setup_regen_rates():
+    regen = import_from_package("vitality", "vitality_regen")
+    chars = [BenchChar(pos) for pos in
+             ("standing", "sitting", "resting", "sleeping", "fighting")]
+    def run():
+        for ch in chars:
+            ch.derived_vals.clear()
+            regen.update_regen_rates(ch)
+            regen.get_position_modifier(ch)
+    return run, len(chars)
+
+
+def setup_regen_cached():
+    regen = import_from_package("vitality", "vitality_regen")
+    chars = [BenchChar(pos) for pos in
+             ("standing", "sitting", "resting", "sleeping", "fighting")]
+    for ch in chars:
+        regen.update_regen_rates(ch)
+    def run():
+        for ch in chars:
+            regen.update_regen_rates(ch)
+            regen.get_position_modifier(ch)
+    return run, len(chars)
+
+
+def setup_gear_slots():
+    gear_config = import_from_package("gear", "gear_config")
+    equipped    = import_from_package("gear", "equipped")
+    ch   = BenchChar()
+    objs = [BenchObj(name) for name in sorted(gear_config.get_worn_types())]
+    def run():
+        for obj in objs:
+            equipped.equip_positions(ch, obj)
+            equipped.get_equipped_positions(obj)
+    return run, len(objs)
+
+
+def setup_socials_table():
+    socials = import_from_package("socials", "socials")
+    names = ["smile", "grin", "laugh", "nod", "wave", "bow", "shrug", "sigh",
+             "wink", "frown", "cheer", "clap", "cry", "dance", "giggle", "hug"]
+    def run():
+        socials.social_table.clear()
+        socials.socials.clear()
+        for name in names:
+            socials.add_social(socials.Social(
+                cmds=name + "," + name + "s", to_char_notgt="You " + name +
+                " $X.", to_room_notgt="$n " + name + "s $X.", adverb="happily"),
+                               save=False)
+        for name in names:
+            socials.get_social(name)
+            socials.get_social(name + "s")
+            socials.get_social("not" + name)
+    return run, len(names)
+
+
+def setup_socials_link():
+    socials = import_from_package("socials", "socials")
+    def run():
+        socials.social_table.clear()
+        socials.socials.clear()
+        socials.add_social(socials.Social(cmds="smile", to_char_notgt="You "
+                                          "smile.", adverb="happily"),
+                           save=False)
+        for alias in ("beam", "smirk", "simper", "grin"):
+            socials.link_social(alias, "smile", save=False)
+        for alias in ("beam", "smirk", "simper", "grin"):
+            socials.unlink_social(alias, save=False)
+    return run, 8
+
+
+# name -> (what it times, how to set it up)
+BENCHMARKS: Dict[str, Tuple[str, Callable]] = {
+    "yaml.parse":      ("progression/yaml_parser.py parse_yaml, per class file",
+                        setup_yaml),
+    "yaml.values":     ("progression/yaml_parser.py _convert_value, per value",
+                        setup_yaml_values),
+    "path.dirs":       ("path.py path_to_dirs, over a 31 room route",
+                        setup_path_dirs),
+    "path.patrol":     ("path.py build_patrol, there and back over 3 rooms",
+                        setup_path_patrol),
+    "regen.rates":     ("vitality regen rates and position mod, uncached",
+                        setup_regen_rates),
+    "regen.cached":    ("vitality regen rates and position mod, cached",
+                        setup_regen_cached),
+    "gear.slots":      ("gear/equipped.py slots to equip to, per worn type",
+                        setup_gear_slots),
+    "socials.table":   ("socials.py add_social and get_social, per social",
+                        setup_socials_table),
+    "socials.link":    ("socials.py link_social and unlink_social, per call",
+                        setup_socials_link),
+}
+
+
+################################################################################
+# timing
+################################################################################
+def calibrate() -> int:
+    """A fixed amount of plain Python work, that every benchmark's cost is
+    measured against"""
+    table = {}
+    for i in range(2000):
+        key = "k%d" % (i % 97)
+        table[key] = table.get(key, 0) + i
+    words = " ".join(sorted(table)).split()
+    return len(words)
+
+
+def batch_size(func: Callable, secs: float) -> int:
+    """How many calls of func take about secs"""
+    calls, start = 0, time.perf_counter()
+    while time.perf_counter() - start < secs / 4 or calls < 3:
+        func()
+        calls += 1
+    return max(1, int(secs / ((time.perf_counter() - start) / calls)))
+
+
+def time_batch(func: Callable, calls: int) -> float:
+    """The seconds one call of func took, on average over calls of them"""
+    start = time.perf_counter()
+    for _ in range(calls):
+        func()
+    return (time.perf_counter() - start) / calls
+
+
+def time_it(func: Callable, min_secs: float,
+            repeats: int) -> Tuple[float, float]:
+    """The seconds one call of func takes, and what that costs relative to
+    the calibration loop. The calibration loop is timed right alongside
+    each run of func, so the machine getting busier or quieter partway
+    through moves both, and the median of the runs is taken"""
+    run_calls   = batch_size(func, min_secs / repeats / 2)
+    calib_calls = batch_size(calibrate, min_secs / repeats / 4)
+
+    secs, costs = [], []
+    for _ in range(repeats):
+        before = time_batch(calibrate, calib_calls)
+        took   = time_batch(func, run_calls)
+        after  = time_batch(calibrate, calib_calls)
+        secs.append(took)
+        costs.append(took / min(before, after))
+    secs.sort()
+    costs.sort()
+    return secs[0], costs[len(costs) // 2]
+
+
+def run_benchmarks(names: List[str], min_secs: float,
+                   repeats: int) -> Dict[str, Dict[str, float]]:
+    results = {}
+    for name in names:
+        run, ops = BENCHMARKS[name][1]()
+        secs, cost = time_it(run, min_secs, repeats)
+        results[name] = {
+            "ops_per_sec": ops / secs,
+            "usec_per_op": secs * 1e6 / ops,
+            "cost":        cost,
+        }
+    return results
+
+
+def load_baselines(path: str) -> Dict[str, float]:
+    if not os.path.exists(path):
+        return {}
+    with open(path) as f:
+        return json.load(f).get("cost", {})
+
+
+def save_baselines(path: str, results: Dict[str, Dict[str, float]],
+                   old: Dict[str, float]):
+    cost = dict(old)
+    for name, result in results.items():
+        cost[name] = round(result["cost"], 4)
+    with open(path, "w") as f:
+        json.dump({"about": "what each hot path costs, relative to the "
+                           "calibration loop in bench_hotpaths.py",
+                   "cost": dict(sorted(cost.items()))}, f, indent=2)
+        f.write("\n")
+
+
+def report(results: Dict[str, Dict[str, float]], baselines: Dict[str, float],
+           threshold: float) -> List[str]:
+    """Print what we found, and return the names of what regressed"""
+    regressed = []
+    print(f"{'Benchmark':<16} {'ops/sec':>12} {'usec/op':>9} {'cost':>9} "
+          f"{'baseline':>9} {'change':>8}")
+    for name, result in results.items():
+        base = baselines.get(name)
+        if base:
+            change = result["cost"] / base - 1.0
+            verdict = ""
+            if change > threshold:
+                verdict = "  REGRESSED"
+                regressed.append(name)
+            changed = f"{change * 100:+7.1f}%"
+        else:
+            changed, verdict = "     new", ""
+        print(f"{name:<16} {result['ops_per_sec']:>12.0f} "
+              f"{result['usec_per_op']:>9.2f} {result['cost']:>9.4f} "
+              f"{(base or 0):>9.4f} {changed}{verdict}")
+    return regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("--only",
+                        help="comma-separated benchmarks, or their prefixes "
+                        "(e.g. yaml,regen.cached)")
+    parser.add_argument("--threshold", type=float, default=DFLT_THRESHOLD,
+                        help="how much slower than baseline is a regression "
+                        f"(default {DFLT_THRESHOLD} for {DFLT_THRESHOLD:.0%})")
+    parser.add_argument("--secs", type=float, default=1.0,
+                        help="seconds to spend timing each benchmark")
+    parser.add_argument("--repeats", type=int, default=9,
+                        help="runs to take the best of")
+    parser.add_argument("--baselines", default=BASELINES)
+    parser.add_argument("--update", action="store_true",
+                        help="record these results as the new baselines")
+    parser.add_argument("--list", action="store_true",
+                        help="list the benchmarks and what they time")
+    parser.add_argument("--json", help="also write the results here")
+    args = parser.parse_args()
+
+    if args.list:
+        for name, (about, _) in BENCHMARKS.items():
+            print(f"{name:<16} {about}")
+        return 0
+
+    names = list(BENCHMARKS)
+    if args.only:
+        wanted = [w.strip() for w in args.only.split(",") if w.strip()]
+        names  = [n for n in names
+                  if any(n == w or n.startswith(w + ".") for w in wanted)]
+        if not names:
+            print(f"no benchmarks match '{args.only}'; see --list")
+            return 1
+
+    # modules that write their data files (socials, gear) do it relative to
+    # where we are, like they would in the mudlib. Keep that out of the repo
+    baselines = load_baselines(os.path.abspath(args.baselines))
+    args.baselines = os.path.abspath(args.baselines)
+    json_out = os.path.abspath(args.json) if args.json else None
+    install_stubs()
+    sys.path.insert(0, PYMODULES)
+    with tempfile.TemporaryDirectory(prefix="nm_bench_") as scratch:
+        os.chdir(scratch)
+        results = run_benchmarks(names, args.secs, max(1, args.repeats))
+        os.chdir(REPO_ROOT)
+
+    regressed = report(results, baselines, args.threshold)
+    if json_out:
+        with open(json_out, "w") as f:
+            json.dump({"results": results, "baselines": baselines,
+                       "threshold": args.threshold,
+                       "regressed": regressed}, f, indent=2)
+    if args.update:
+        save_baselines(args.baselines, results, baselines)
+        print(f"\nBaselines written to {args.baselines}")
+        return 0
+    if regressed:
+        print(f"\n{len(regressed)} hot path(s) more than "
+              f"{args.threshold:.0%} slower than baseline: "
+              f"{', '.join(regressed)}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,574 @@
+#!/usr/bin/env python3
+"""
+Synthetic Player Swarm Load Test for NakedMud
+
+Boots a private copy of the mud and drives it with a swarm of scripted
+players, to see how the game loop holds up under load:
+
+1. Copies the mudlib to a scratch directory, and turns on its metrics port
+2. Boots the server on that copy with --mudlib-path
+3. Opens hundreds (or thousands) of telnet connections, each of which
+   creates an account and a character through account_handler, char_gen,
+   and the race and appearance menus of char_gen_enhancements
+4. Has every player run a weighted mix of commands -- movement, look, say,
+   get/drop, and combat -- for a while
+5. Reports per-command round-trip latency percentiles, measured from sending
+   a command to seeing the next prompt, plus the server's own count of
+   pulses it fell behind on, scraped from the metrics port
+
+The mudlib has no kill command, so the "combat" category is made of the
+commands a fight leans on: wield, unwield, gear, equipment, and wounds.
+
+Usage:
+    python3 tests/load_swarm.py --clients 500 --duration 60
+    python3 tests/load_swarm.py --clients 2000 --ramp 200 --json out.json
+    python3 tests/load_swarm.py --mix move=5,look=3,say=1,getdrop=1,combat=1
+
+Nothing but the standard library is needed. Run it from the repository root,
+or point --binary and --mudlib at the right places.
+"""
+
+import os
+import re
+import sys
+import json
+import time
+import shutil
+import random
+import socket
+import signal
+import asyncio
+import argparse
+import tempfile
+import subprocess
+import urllib.request
+from typing import Dict, List, Optional, Tuple
+
+REPO_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# what the server ends its prompts with, once colours are stripped off
+GAME_PROMPT   = "prompt> "
+LOGIN_PROMPT  = "Choose an option: "
+MENU_PROMPT   = "Enter choice, or Q to quit: "
+NAME_PROMPT   = "What is your character's name? "
+SEX_PROMPT    = "What is your sex (M/F/N/O)? "
+RACE_PROMPT   = "Choose a race (or enter [H]elp <race> for details): "
+FINISH_PROMPT = "Press enter to finish character generation:"
+
+# the race listing char_gen_enhancements shows before RACE_PROMPT. Each race
+# is on its own line, its name padded out before a dash and its description
+RACE_LIST_START = "Available races:"
+RACE_LIST_END   = "[H] for detailed help"
+RACE_LINE_RE    = re.compile(r"^ {2}(\S.*?)\s+- ", re.MULTILINE)
+
+# the appearance menus that come after picking a race. Which ones are asked
+# depends on the race, so they're answered as they come up, until chargen is
+# finished
+NUMBERED_RE = re.compile(r"Select [^\n]*\(1-(\d+)\): ")
+VARIANT_RE  = re.compile(r"Select Memti variant \(1 or 2\): ")
+ODD_EYES_RE = re.compile(r"Do you want different colored eyes\? \(Y/N\): ")
+ACCEPT_RE   = re.compile(r"Accept this appearance\? \(Y/N\): ")
+RACE_RE     = re.compile(re.escape(RACE_PROMPT))
+FINISH_RE   = re.compile(re.escape(FINISH_PROMPT))
+
+# how many times we'll be told a race isn't available before giving up
+MAX_RACE_TRIES = 20
+
+# a menu that has nothing to ask (e.g. beards, for some races) takes itself
+# off without showing the next one. An empty line gets the next one shown
+NUDGE_AFTER = 2.0
+MAX_NUDGES  = 3
+
+# the commands each category draws from. Players pick a category by weight,
+# and then one of its commands at random
+COMMAND_MIX = {
+    "move":    ["north", "south", "east", "west", "up", "down",
+                "northeast", "northwest", "southeast", "southwest"],
+    "look":    ["look", "exits", "inventory", "who"],
+    "say":     ["say hello there", "say anyone around?",
+                "say load testing, pay no mind", "emote stretches."],
+    "getdrop": ["get all", "drop all"],
+    "combat":  ["wield all", "unwield all", "gear", "equipment", "wounds"],
+}
+DFLT_MIX = "move=4,look=3,say=2,getdrop=1,combat=1"
+
+# the metrics we compare before and after a run
+PULSE_METRICS = ["nakedmud_pulse_catchup_total",
+                 "nakedmud_pulse_dropped_total"]
+
+ANSI_RE   = re.compile(r"\x1b\[[0-9;]*[A-Za-z]")
+TELNET_RE = re.compile(rb"\xff(?:[\xfb-\xfe].|\xfa.*?\xff\xf0|[^\xff])",
+                       re.DOTALL)
+
+
+def percentile(sorted_vals: List[float], pct: float) -> float:
+    """Nearest-rank percentile of an already sorted list"""
+    if not sorted_vals:
+        return 0.0
+    rank = max(0, min(len(sorted_vals) - 1,
+                      int(round(pct / 100.0 * len(sorted_vals) + 0.5)) - 1))
+    return sorted_vals[rank]
+
+
+def parse_mix(arg: str) -> Dict[str, int]:
+    """Parse a category=weight,... list"""
+    mix = {}
+    for part in arg.split(","):
+        if not part.strip():
+            continue
+        name, _, weight = part.partition("=")
+        name = name.strip()
+        if name not in COMMAND_MIX:
+            raise ValueError(f"unknown command category '{name}'; "
+                             f"pick from {', '.join(COMMAND_MIX)}")
+        mix[name] = int(weight) if weight else 1
+    if not mix or sum(mix.values()) <= 0:
+        raise ValueError("the command mix needs at least one positive weight")
+    return mix
+
+
+def alpha_tag(num: int, length: int) -> str:
+    """Spell a number with letters only, since character names can't have
+    digits in them"""
+    letters = []
+    for _ in range(length):
+        letters.append(chr(ord('a') + num % 26))
+        num //= 26
+    return "".join(reversed(letters))
+
+
+class SwarmStats:
+    """Latencies and failures, collected across every player"""
+
+    def __init__(self):
+        self.latency: Dict[Tuple[str, str], List[float]] = {}
+        self.login_times: List[float] = []
+        self.timeouts = 0
+        self.login_failures = 0
+        self.disconnects = 0
+
+    def note(self, category: str, cmd: str, secs: float):
+        self.latency.setdefault((category, cmd), []).append(secs)
+
+    def by_category(self) -> Dict[str, List[float]]:
+        cats: Dict[str, List[float]] = {}
+        for (category, _), vals in self.latency.items():
+            cats.setdefault(category, []).extend(vals)
+        return cats
+
+
+class SwarmPlayer:
+    """One scripted player on one telnet connection"""
+
+    def __init__(self, num: int, run_tag: str, args, stats: SwarmStats):
+        self.num = num
+        self.args = args
+        self.stats = stats
+        self.acct = "sw" + run_tag + str(num)
+        self.passwd = "pw" + run_tag + str(num)
+        self.name = "Swarm" + alpha_tag(num, 4)
+        self.reader: Optional[asyncio.StreamReader] = None
+        self.writer: Optional[asyncio.StreamWriter] = None
+        self.pending = ""
+
+    async def connect(self):
+        self.reader, self.writer = await asyncio.wait_for(
+            asyncio.open_connection(self.args.host, self.args.port),
+            timeout=self.args.timeout)
+
+    def close(self):
+        if self.writer is not None:
+            self.writer.close()
+
+    async def send(self, line: str):
+        self.writer.write((line + "\r\n").encode("utf-8"))
+        await self.writer.drain()
+
+    async def discard(self):
+        """Throw away whatever has already come in, so prompts left over from
+        chargen or from other players' messages aren't taken as a reply"""
+        self.pending = ""
+        while True:
+            try:
+                data = await asyncio.wait_for(self.reader.read(8192),
+                                              timeout=0.01)
+            except asyncio.TimeoutError:
+                return
+            if not data:
+                raise ConnectionResetError("server closed the connection")
+
+    async def expect(self, *markers: str) -> Tuple[str, str]:
+        """Read until one of the markers shows up. Returns which one, and
+        everything that came before it"""
+        match, seen = await self.expect_re(*[re.compile(re.escape(m))
+                                             for m in markers])
+        return match.group(0), seen
+
+    async def expect_re(self, *patterns,
+                        timeout: Optional[float] = None) -> Tuple["re.Match", str]:
+        """Read until one of the patterns matches. Returns the earliest
+        match, and everything that came before it"""
+        deadline = time.monotonic() + (timeout or self.args.timeout)
+        while True:
+            hits = [p.search(self.pending) for p in patterns]
+            hits = [m for m in hits if m is not None]
+            if hits:
+                match = min(hits, key=lambda m: m.start())
+                seen = self.pending[:match.start()]
+                self.pending = self.pending[match.end():]
+                return match, seen
+            left = deadline - time.monotonic()
+            if left <= 0:
+                raise asyncio.TimeoutError()
+            data = await asyncio.wait_for(self.reader.read(8192), timeout=left)
+            if not data:
+                raise ConnectionResetError("server closed the connection")
+            data = TELNET_RE.sub(b"", data)
+            text = data.decode("utf-8", errors="replace")
+            self.pending += ANSI_RE.sub("", text).replace("\r", "")
+
+    async def login(self):
+        """Make an account and a character, and enter the game"""
+        start = time.monotonic()
+        await self.expect(LOGIN_PROMPT)
+        await self.send(f"create {self.acct} {self.passwd}")
+        marker, _ = await self.expect(MENU_PROMPT, LOGIN_PROMPT)
+        if marker == LOGIN_PROMPT:
+            # left over from an earlier run against the same mudlib
+            await self.send(f"load {self.acct} {self.passwd}")
+            await self.expect(MENU_PROMPT)
+        await self.send("N")
+        await self.expect(NAME_PROMPT)
+        await self.send(self.name)
+        marker, _ = await self.expect(SEX_PROMPT, NAME_PROMPT)
+        if marker == NAME_PROMPT:
+            raise RuntimeError(f"name {self.name} was refused")
+        await self.send(random.choice("MFNO"))
+        _, seen = await self.expect(RACE_PROMPT)
+        races = self.list_races(seen)
+        race  = self.pick_race(races, None)
+        await self.send(race)
+        await self.appearance(races, race)
+        await self.expect(GAME_PROMPT)
+        self.stats.login_times.append(time.monotonic() - start)
+
+    def list_races(self, seen: str) -> List[str]:
+        """The races char_gen_enhancements lists before asking for one"""
+        listing = seen.split(RACE_LIST_START)[-1].split(RACE_LIST_END)[0]
+        return RACE_LINE_RE.findall(listing)
+
+    def pick_race(self, races: List[str], refused: Optional[str]) -> str:
+        """Pick one of the races we were offered, other than one that was
+        just refused"""
+        if refused in races:
+            races.remove(refused)
+        if not races:
+            raise RuntimeError("no race we were offered was available")
+        return random.choice(races)
+
+    async def appearance(self, races: List[str], last_race: str):
+        """Answer the appearance menus until chargen is finished. Numbered
+        menus get a random choice, and odd eyes are turned down"""
+        tries  = 0
+        nudges = 0
+        while True:
+            try:
+                match, seen = await self.expect_re(
+                    NUMBERED_RE, VARIANT_RE, ODD_EYES_RE, ACCEPT_RE, RACE_RE,
+                    FINISH_RE, timeout=min(NUDGE_AFTER, self.args.timeout))
+            except asyncio.TimeoutError:
+                nudges += 1
+                if nudges > MAX_NUDGES:
+                    raise
+                await self.send("")
+                continue
+            pattern = match.re
+            if pattern is FINISH_RE:
+                await self.send("")
+                return
+            elif pattern is NUMBERED_RE:
+                await self.send(str(random.randint(1, int(match.group(1)))))
+            elif pattern is VARIANT_RE:
+                await self.send(random.choice("12"))
+            elif pattern is ODD_EYES_RE:
+                await self.send("N")
+            elif pattern is ACCEPT_RE:
+                await self.send("Y")
+            else:
+                # the race we picked wasn't available; try another one
+                tries += 1
+                if tries > MAX_RACE_TRIES:
+                    raise RuntimeError("never got a race that was available")
+                last_race = self.pick_race(races, last_race)
+                await self.send(last_race)
+
+    async def play(self, mix: Dict[str, int], until: float):
+        """Run commands from the mix until time runs out"""
+        categories = list(mix)
+        weights = [mix[c] for c in categories]
+        while time.monotonic() < until:
+            category = random.choices(categories, weights)[0]
+            cmd = random.choice(COMMAND_MIX[category])
+            await self.discard()
+            start = time.monotonic()
+            await self.send(cmd)
+            try:
+                await self.expect(GAME_PROMPT)
+            except asyncio.TimeoutError:
+                self.stats.timeouts += 1
+                continue
+            self.stats.note(category, cmd.split()[0],
+                            time.monotonic() - start)
+            if self.args.think > 0:
+                await asyncio.sleep(random.uniform(0, 2 * self.args.think))
+
+    async def run(self, mix: Dict[str, int], until: float):
+        try:
+            await self.connect()
+            try:
+                await self.login()
+            except (asyncio.TimeoutError, RuntimeError, OSError):
+                self.stats.login_failures += 1
+                return
+            await self.play(mix, until)
+            await self.send("quit")
+        except (ConnectionError, OSError, asyncio.TimeoutError):
+            self.stats.disconnects += 1
+        finally:
+            self.close()
+
+
+class LoadSwarm:
+    """Boots the mud on a scratch mudlib, and sets a swarm of players on it"""
+
+    def __init__(self, args):
+        self.args = args
+        self.stats = SwarmStats()
+        self.mud_process: Optional[subprocess.Popen] = None
+        self.mudlib_copy: Optional[str] = None
+        self.run_tag = alpha_tag(int(time.time()) % (26 ** 3), 3)
+
+    def prepare_mudlib(self):
+        """Copy the mudlib somewhere we can make a mess of, turn its metrics
+        port on, and its connection limit off"""
+        self.mudlib_copy = tempfile.mkdtemp(prefix="nm_swarm_")
+        lib = os.path.join(self.mudlib_copy, "lib")
+        shutil.copytree(self.args.mudlib, lib, symlinks=True)
+
+        # the mud logs to ../log, from the mudlib
+        os.mkdir(os.path.join(self.mudlib_copy, "log"))
+
+        # settings we don't mention are filled in with their defaults when
+        # the mud boots. Every player connects from the same address, so it
+        # can't be limited in how often it connects
+        ours = {"metrics_port": self.args.metrics_port, "connect_rate": 0}
+        muddata = os.path.join(lib, "muddata")
+        lines = []
+        if os.path.exists(muddata):
+            with open(muddata) as f:
+                lines = [l for l in f.read().splitlines()
+                         if l.split(":")[0].strip() not in ours]
+            # drop the end-of-set marker; it goes back on after our line
+            if lines and lines[-1] == "-":
+                lines.pop()
+        lines += [f"{key} : {val}" for key, val in ours.items()]
+        lines.append("-")
+        with open(muddata, "w") as f:
+            f.write("\n".join(lines) + "\n")
+        return lib
+
+    def boot(self, lib: str):
+        """Start the server, and wait for it to take connections"""
+        log = open(os.path.join(self.mudlib_copy, "mud.log"), "w")
+        cmd = [self.args.binary, "--mudlib-path", lib, str(self.args.port)]
+        self.mud_process = subprocess.Popen(
+            cmd, cwd=os.path.dirname(self.args.binary),
+            stdout=log, stderr=subprocess.STDOUT, stdin=subprocess.DEVNULL)
+
+        deadline = time.monotonic() + self.args.boot_timeout
+        while time.monotonic() < deadline:
+            if self.mud_process.poll() is not None:
+                raise RuntimeError(f"the mud exited while booting; see "
+                                   f"{self.mudlib_copy}/mud.log")
+            try:
+                with socket.create_connection((self.args.host, self.args.port),
+                                              timeout=1):
+                    return
+            except OSError:
+                time.sleep(0.25)
+        raise RuntimeError("the mud never started listening")
+
+    def shutdown(self):
+        if self.mud_process is not None and self.mud_process.poll() is None:
+            self.mud_process.send_signal(signal.SIGTERM)
+            try:
+                self.mud_process.wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                self.mud_process.kill()
+        if self.mudlib_copy and not self.args.keep:
+            shutil.rmtree(self.mudlib_copy, ignore_errors=True)
+
+    def scrape(self) -> Dict[str, float]:
+        """Read the server's metrics, keyed by name and labels"""
+        url = f"http://{self.args.host}:{self.args.metrics_port}/metrics"
+        try:
+            with urllib.request.urlopen(url, timeout=5) as resp:
+                body = resp.read().decode("utf-8", errors="replace")
+        except OSError:
+            return {}
+
+        metrics: Dict[str, float] = {}
+        for line in body.splitlines():
+            if not line or line.startswith("#"):
+                continue
+            name, _, val = line.rpartition(" ")
+            try:
+                metrics[name] = float(val)
+            except ValueError:
+                pass
+        return metrics
+
+    async def swarm(self, mix: Dict[str, int]):
+        """Connect everyone, a batch at a time, and let them play"""
+        players = [SwarmPlayer(i, self.run_tag, self.args, self.stats)
+                   for i in range(self.args.clients)]
+        until = time.monotonic() + self.args.duration
+        tasks = []
+        for i in range(0, len(players), self.args.ramp):
+            for player in players[i:i + self.args.ramp]:
+                tasks.append(asyncio.ensure_future(player.run(mix, until)))
+            await asyncio.sleep(1.0)
+        await asyncio.gather(*tasks)
+
+    def report(self, before: Dict[str, float], after: Dict[str, float],
+               wall: float) -> dict:
+        """Print the results, and return them for --json"""
+        result = {"clients": self.args.clients, "duration": wall,
+                  "logins": len(self.stats.login_times),
+                  "login_failures": self.stats.login_failures,
+                  "timeouts": self.stats.timeouts,
+                  "disconnects": self.stats.disconnects,
+                  "categories": {}, "commands": {}, "server": {}}
+
+        def summarize(vals: List[float]) -> dict:
+            vals = sorted(vals)
+            return {"count": len(vals),
+                    "p50_ms": percentile(vals, 50) * 1000,
+                    "p90_ms": percentile(vals, 90) * 1000,
+                    "p99_ms": percentile(vals, 99) * 1000,
+                    "max_ms": (vals[-1] * 1000 if vals else 0.0)}
+
+        print("=" * 72)
+        print(f"{self.args.clients} clients, {wall:.1f}s, "
+              f"{result['logins']} logged in, "
+              f"{self.stats.login_failures} failed to log in, "
+              f"{self.stats.timeouts} timeouts, "
+              f"{self.stats.disconnects} disconnects")
+        if self.stats.login_times:
+            login = summarize(self.stats.login_times)
+            result["login"] = login
+            print(f"login: p50 {login['p50_ms']:.1f}ms "
+                  f"p99 {login['p99_ms']:.1f}ms")
+
+        header = f"{'':<22}{'count':>8}{'p50ms':>10}{'p90ms':>10}" \
+                 f"{'p99ms':>10}{'maxms':>10}"
+        print("-" * 72)
+        print(header)
+        for category, vals in sorted(self.stats.by_category().items()):
+            row = result["categories"][category] = summarize(vals)
+            self.print_row(category, row)
+        print("-" * 72)
+        for (category, cmd), vals in sorted(self.stats.latency.items()):
+            row = result["commands"][f"{category}/{cmd}"] = summarize(vals)
+            self.print_row(f"  {category}/{cmd}", row)
+
+        print("-" * 72)
+        if not after:
+            print("server: no metrics (is the metrics port open?)")
+        else:
+            for name in PULSE_METRICS:
+                delta = after.get(name, 0.0) - before.get(name, 0.0)
+                result["server"][name] = delta
+                print(f"server: {name:<36} {delta:>10.0f}")
+            # how long each phase of the pulse took, on average, while the
+            # swarm was on
+            prefix = "nakedmud_pulse_phase_seconds_count{"
+            for key in sorted(k for k in after if k.startswith(prefix)):
+                labels = key[len(prefix) - 1:]
+                sum_key = "nakedmud_pulse_phase_seconds_sum" + labels
+                count = after[key] - before.get(key, 0.0)
+                total = after.get(sum_key, 0.0) - before.get(sum_key, 0.0)
+                if count <= 0:
+                    continue
+                phase = labels.split('"')[1] if '"' in labels else labels
+                mean_ms = total / count * 1000
+                result["server"][f"mean_{phase}_ms"] = mean_ms
+                print(f"server: {'mean ' + phase + ' phase (ms)':<36} "
+                      f"{mean_ms:>10.3f}")
+        print("=" * 72)
+        return result
+
+    @staticmethod
+    def print_row(label: str, row: dict):
+        print(f"{label:<22}{row['count']:>8}{row['p50_ms']:>10.1f}"
+              f"{row['p90_ms']:>10.1f}{row['p99_ms']:>10.1f}"
+              f"{row['max_ms']:>10.1f}")
+
+    def run(self) -> int:
+        mix = parse_mix(self.args.mix)
+        try:
+            lib = self.prepare_mudlib()
+            print(f"booting {self.args.binary} on port {self.args.port}, "
+                  f"mudlib {lib}")
+            self.boot(lib)
+            before = self.scrape()
+            start = time.monotonic()
+            asyncio.run(self.swarm(mix))
+            wall = time.monotonic() - start
+            after = self.scrape()
+            result = self.report(before, after, wall)
+            if self.args.json:
+                with open(self.args.json, "w") as f:
+                    json.dump(result, f, indent=2)
+        finally:
+            self.shutdown()
+        return 0 if result["logins"] > 0 else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("--clients", type=int, default=200,
+                        help="how many players to connect (default 200)")
+    parser.add_argument("--duration", type=float, default=30.0,
+                        help="seconds of play after the first connect")
+    parser.add_argument("--ramp", type=int, default=50,
+                        help="players connected per second")
+    parser.add_argument("--think", type=float, default=0.5,
+                        help="mean seconds a player waits between commands")
+    parser.add_argument("--mix", default=DFLT_MIX,
+                        help=f"category=weight list (default {DFLT_MIX})")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=4400)
+    parser.add_argument("--metrics-port", type=int, default=4401)
+    parser.add_argument("--timeout", type=float, default=30.0,
+                        help="seconds to wait for any one reply")
+    parser.add_argument("--boot-timeout", type=float, default=60.0)
+    parser.add_argument("--binary",
+                        default=os.path.join(REPO_ROOT, "src", "NakedMud"))
+    parser.add_argument("--mudlib", default=os.path.join(REPO_ROOT, "lib"),
+                        help="mudlib to copy for the run")
+    parser.add_argument("--keep", action="store_true",
+                        help="keep the copied mudlib and its log afterwards")
+    parser.add_argument("--json", help="also write the results here")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.binary):
+        print(f"no server binary at {args.binary}; build it first")
+        return 1
+    args.binary = os.path.abspath(args.binary)
+    args.ramp = max(1, args.ramp)
+    return LoadSwarm(args).run()
+
+
+if __name__ == "__main__":
+    sys.exit(main())